@@ -34,6 +34,8 @@ FOUNDATION_EXPORT const unsigned char IJKMediaFrameworkVersionString[];
 #import <IJKMediaFramework/IJKMPMoviePlayerController.h>
 #import <IJKMediaFramework/IJKFFOptions.h>
 #import <IJKMediaFramework/IJKFFMoviePlayerController.h>
+#import <IJKMediaFramework/IJKMediaPreloader.h>
+#import <IJKMediaFramework/IJKMediaDataSource.h>
 #import <IJKMediaFramework/IJKAVMoviePlayerController.h>
 #import <IJKMediaFramework/IJKMediaModule.h>
 #import <IJKMediaFramework/IJKMediaPlayer.h>
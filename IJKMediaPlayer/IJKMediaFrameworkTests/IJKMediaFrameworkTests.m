@@ -8,6 +8,345 @@
 
 #import <UIKit/UIKit.h>
 #import <XCTest/XCTest.h>
+#import <IJKMediaFramework/IJKMediaFramework.h>
+#import <IJKMediaFramework/IJKFFMonitor.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <mach/mach.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+// Playback benchmark
+//
+// Plays the corpus of tools/make-benchmark-corpus.sh, served over HTTP from
+// this process, with VideoToolbox and with the software decoder, and writes
+// one JSON record per run. The corpus directory comes from the environment
+// variable IJK_BENCH_CORPUS_DIR, the benchmark is skipped without it.
+//
+// IJK_BENCH_OUTPUT     where to write the results, a temporary file otherwise
+// IJK_BENCH_BASELINE   results of a former run: a metric worse than its
+//                      threshold fails the test; the baseline may carry its
+//                      own "thresholds", in the format of g_bench_thresholds
+// IJK_BENCH_SECONDS    playback measured after the first frame, 10 by default
+// IJK_BENCH_NET_TRACE  a network trace (libavformat/net_trace.h) the local
+//                      server is shaped to, replayed from the start for
+//                      each run, so startup and rebuffering compare offline
+
+#define IJK_BENCH_DEFAULT_SECONDS   10
+#define IJK_BENCH_SAMPLE_INTERVAL   0.25
+#define IJK_BENCH_FIRST_FRAME_TIMEOUT 20
+
+#pragma mark - http server
+
+// Serves the files of a directory on 127.0.0.1, GET with byte ranges, a
+// connection per request: enough for the demuxers, nothing more.
+@interface IJKBenchHTTPServer : NSObject
+- (instancetype)initWithRoot:(NSString *)root;
+- (BOOL)start;
+- (void)stop;
+@property(nonatomic, readonly) uint16_t port;
+@end
+
+@implementation IJKBenchHTTPServer {
+    NSString           *_root;
+    int                 _socket;
+    dispatch_source_t   _acceptSource;
+    dispatch_queue_t    _queue;
+}
+
+- (instancetype)initWithRoot:(NSString *)root
+{
+    self = [super init];
+    if (self) {
+        _root   = root;
+        _socket = -1;
+        _queue  = dispatch_queue_create("tv.danmaku.ijk.bench-http", DISPATCH_QUEUE_CONCURRENT);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+- (BOOL)start
+{
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket < 0)
+        return NO;
+
+    int yes = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_len         = sizeof(addr);
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen    = sizeof(addr);
+    if (bind(_socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(_socket, 16) != 0 ||
+        getsockname(_socket, (struct sockaddr *)&addr, &addrLen) != 0) {
+        [self stop];
+        return NO;
+    }
+    _port = ntohs(addr.sin_port);
+
+    int listenSocket = _socket;
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listenSocket, 0, _queue);
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        int client = accept(listenSocket, NULL, NULL);
+        if (client < 0)
+            return;
+        int noSigPipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+        [weakSelf serveClient:client];
+    });
+    dispatch_source_set_cancel_handler(_acceptSource, ^{
+        close(listenSocket);
+    });
+    dispatch_resume(_acceptSource);
+    return YES;
+}
+
+- (void)stop
+{
+    if (_acceptSource) {
+        dispatch_source_cancel(_acceptSource);
+        _acceptSource = nil;
+    } else if (_socket >= 0) {
+        close(_socket);
+    }
+    _socket = -1;
+}
+
+static BOOL bench_write_all(int fd, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0)
+            return NO;
+        bytes += written;
+        size  -= written;
+    }
+    return YES;
+}
+
+static NSString *bench_content_type(NSString *path)
+{
+    NSString *ext = path.pathExtension.lowercaseString;
+    if ([ext isEqualToString:@"m3u8"])
+        return @"application/vnd.apple.mpegurl";
+    if ([ext isEqualToString:@"ts"])
+        return @"video/mp2t";
+    if ([ext isEqualToString:@"flv"])
+        return @"video/x-flv";
+    return @"video/mp4";
+}
+
+- (void)serveClient:(int)client
+{
+    NSMutableData *request = [NSMutableData data];
+    char buffer[4096];
+    while ([request length] < 64 * 1024) {
+        ssize_t got = read(client, buffer, sizeof(buffer));
+        if (got <= 0)
+            break;
+        [request appendBytes:buffer length:got];
+        if (strnstr([request bytes], "\r\n\r\n", [request length]))
+            break;
+    }
+
+    NSString *header = [[NSString alloc] initWithData:request encoding:NSISOLatin1StringEncoding];
+    NSArray  *lines  = [header componentsSeparatedByString:@"\r\n"];
+    NSArray  *parts  = [[lines firstObject] componentsSeparatedByString:@" "];
+    NSString *path   = parts.count >= 2 ? [parts[1] stringByRemovingPercentEncoding] : nil;
+    path = [[path componentsSeparatedByString:@"?"] firstObject];
+
+    NSString *file = path ? [[_root stringByAppendingPathComponent:path] stringByStandardizingPath] : nil;
+    NSFileHandle *handle = nil;
+    if (file && [file hasPrefix:[_root stringByStandardizingPath]])
+        handle = [NSFileHandle fileHandleForReadingAtPath:file];
+    if (!handle) {
+        const char *notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        bench_write_all(client, notFound, strlen(notFound));
+        close(client);
+        return;
+    }
+
+    unsigned long long size  = [handle seekToEndOfFile];
+    unsigned long long start = 0;
+    unsigned long long end   = size > 0 ? size - 1 : 0;
+    BOOL               range = NO;
+    for (NSString *line in lines) {
+        if (![line.lowercaseString hasPrefix:@"range: bytes="])
+            continue;
+        NSArray *bounds = [[line substringFromIndex:13] componentsSeparatedByString:@"-"];
+        if (bounds.count == 2) {
+            start = strtoull([bounds[0] UTF8String], NULL, 10);
+            if ([bounds[1] length] > 0)
+                end = MIN(strtoull([bounds[1] UTF8String], NULL, 10), end);
+            range = YES;
+        }
+    }
+
+    if (range && start >= size) {
+        NSString *response = [NSString stringWithFormat:@"HTTP/1.1 416 Range Not Satisfiable\r\n"
+                              "Content-Range: bytes */%llu\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", size];
+        bench_write_all(client, response.UTF8String, strlen(response.UTF8String));
+        close(client);
+        return;
+    }
+
+    unsigned long long length = size > 0 ? end - start + 1 : 0;
+    NSMutableString *response = [NSMutableString string];
+    [response appendString:range ? @"HTTP/1.1 206 Partial Content\r\n" : @"HTTP/1.1 200 OK\r\n"];
+    [response appendFormat:@"Content-Type: %@\r\n", bench_content_type(file)];
+    [response appendFormat:@"Content-Length: %llu\r\n", length];
+    if (range)
+        [response appendFormat:@"Content-Range: bytes %llu-%llu/%llu\r\n", start, end, size];
+    [response appendString:@"Accept-Ranges: bytes\r\nConnection: close\r\n\r\n"];
+
+    if (bench_write_all(client, response.UTF8String, strlen(response.UTF8String)) &&
+        ![[lines firstObject] hasPrefix:@"HEAD "]) {
+        [handle seekToFileOffset:start];
+        while (length > 0) {
+            @autoreleasepool {
+                NSData *chunk = [handle readDataOfLength:(NSUInteger)MIN(length, 256 * 1024)];
+                if (chunk.length == 0 || !bench_write_all(client, chunk.bytes, chunk.length))
+                    break;
+                length -= chunk.length;
+            }
+        }
+    }
+    [handle closeFile];
+    close(client);
+}
+
+@end
+
+#pragma mark - process metrics
+
+static double bench_cpu_seconds(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// the footprint jetsam judges the app by
+static double bench_footprint_mb(void)
+{
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.phys_footprint / (1024.0 * 1024.0);
+}
+
+#pragma mark - benchmark
+
+// metric: {"worse": "higher" | "lower", "tolerance": relative, "slack": absolute}
+static NSDictionary *g_bench_thresholds(void)
+{
+    return @{
+        @"ttff_ms":          @{@"worse": @"higher", @"tolerance": @0.25, @"slack": @50},
+        @"prepare_ms":       @{@"worse": @"higher", @"tolerance": @0.25, @"slack": @50},
+        @"decode_fps":       @{@"worse": @"lower",  @"tolerance": @0.10, @"slack": @1},
+        @"output_fps":       @{@"worse": @"lower",  @"tolerance": @0.10, @"slack": @1},
+        @"dropped_presents": @{@"worse": @"higher", @"tolerance": @0.50, @"slack": @5},
+        @"cpu_percent":      @{@"worse": @"higher", @"tolerance": @0.20, @"slack": @5},
+        @"cpu_seconds":      @{@"worse": @"higher", @"tolerance": @0.20, @"slack": @0.5},
+        @"peak_memory_mb":   @{@"worse": @"higher", @"tolerance": @0.20, @"slack": @10},
+        @"rebuffer_count":   @{@"worse": @"higher", @"tolerance": @0.50, @"slack": @1},
+        @"rebuffer_ms":      @{@"worse": @"higher", @"tolerance": @0.50, @"slack": @500},
+    };
+}
+
+#pragma mark - checkasm
+
+// checkasm of the arm64 ffmpeg build: every NEON kernel against its C
+// version, then timed. tools/do-compile-ffmpeg.sh builds libcheckasm.a,
+// linked only when the tests are built with IJK_CHECKASM=YES; the test is
+// skipped otherwise, and on the simulator.
+//
+// IJK_CHECKASM_ARGS    arguments of checkasm, "--bench" by default: a seed,
+//                      --test=<name>, --bench=<function prefix>
+// IJK_CHECKASM_OUTPUT  where to write the timings, a temporary file otherwise
+//
+// The cycle counter is not readable by apps: timings are in nanoseconds, the
+// ratio to the C version is what compares across devices.
+extern int checkasm_main(int argc, char *argv[]) __attribute__((weak_import));
+
+static NSString *const g_checkasm_suffixes[] = { @"c", @"armv8", @"neon" };
+
+// "<function>_<suffix>: <time>" lines into {function: {suffix: time}}
+static NSDictionary *checkasm_parse_timings(NSString *output)
+{
+    NSMutableDictionary *timings = [NSMutableDictionary dictionary];
+    for (NSString *line in [output componentsSeparatedByString:@"\n"]) {
+        NSArray *parts = [line componentsSeparatedByString:@": "];
+        if (parts.count != 2)
+            continue;
+
+        NSString *name = parts[0];
+        NSRange   sep  = [name rangeOfString:@"_" options:NSBackwardsSearch];
+        if (sep.location == NSNotFound)
+            continue;
+        NSString *function = [name substringToIndex:sep.location];
+        NSString *suffix   = [name substringFromIndex:sep.location + 1];
+
+        BOOL known = NO;
+        for (size_t i = 0; i < sizeof(g_checkasm_suffixes) / sizeof(g_checkasm_suffixes[0]); i++)
+            known |= [suffix isEqualToString:g_checkasm_suffixes[i]];
+        if (!known)
+            continue;
+
+        NSMutableDictionary *versions = timings[function];
+        if (!versions) {
+            versions = [NSMutableDictionary dictionary];
+            timings[function] = versions;
+        }
+        versions[suffix] = @([parts[1] doubleValue]);
+    }
+    return timings;
+}
+
+#pragma mark - decoder benchmark
+
+// Decodes each file of the playback corpus, read from disk, as fast as the
+// decoder goes: VideoToolbox async, VideoToolbox sync and software, no view
+// and no audio (IJKFFDecoderBenchmark). Skipped without IJK_BENCH_CORPUS_DIR.
+//
+// IJK_BENCH_DECODER_OUTPUT   where to write the results, a temporary file
+//                            otherwise
+// IJK_BENCH_DECODER_TIMEOUT  seconds a file may take to decode, 120 by default
+#define IJK_BENCH_DECODER_DEFAULT_TIMEOUT 120
+
+// Capture replay: the same over the packet captures (.pktcap) of
+// IJK_BENCH_CAPTURE_DIR, written with av_packet_capture_open() and friends
+// so that a decode stutter reproduces on a bench device. Skipped without it.
+//
+// IJK_BENCH_CAPTURE_PACE     "none", "dts" or "capture" (default): when the
+//                            packets reach the decoder, see IJKFFDecoderBenchmarkPace
+// IJK_BENCH_CAPTURE_OUTPUT   where to write the results, a temporary file
+//                            otherwise
+
+static NSString *decoder_benchmark_mode_name(IJKFFDecoderBenchmarkMode mode)
+{
+    switch (mode) {
+        case IJKFFDecoderBenchmarkModeVideoToolboxAsync:    return @"videotoolbox_async";
+        case IJKFFDecoderBenchmarkModeVideoToolboxSync:     return @"videotoolbox_sync";
+        case IJKFFDecoderBenchmarkModeSoftware:             return @"avcodec";
+    }
+    return @"unknown";
+}
 
 @interface IJKMediaFrameworkTests : XCTestCase
 
@@ -37,4 +376,399 @@
     }];
 }
 
+// name, path under the corpus directory
++ (NSArray *)benchmarkCorpus
+{
+    return @[
+        @[@"h264_480p",              @"h264_480p.mp4"],
+        @[@"h264_720p",              @"h264_720p.mp4"],
+        @[@"h264_1080p",             @"h264_1080p.mp4"],
+        @[@"h264_1080p60",           @"h264_1080p60.mp4"],
+        @[@"hevc_1080p",             @"hevc_1080p.mp4"],
+        @[@"hevc_2160p",             @"hevc_2160p.mp4"],
+        @[@"h264_1080p_moov_at_end", @"h264_1080p_moov_at_end.mp4"],
+        @[@"flv_720p",               @"h264_720p.flv"],
+        @[@"hls_720p",               @"hls_720p/index.m3u8"],
+    ];
+}
+
+- (NSDictionary *)runBenchmark:(NSString *)name url:(NSURL *)url videoToolbox:(BOOL)videoToolbox seconds:(double)seconds
+                      netTrace:(NSString *)netTrace
+{
+    IJKFFOptions *options = [IJKFFOptions optionsByDefault];
+    [options setPlayerOptionIntValue:videoToolbox ? 1 : 0 forKey:@"videotoolbox"];
+    [options setPlayerOptionIntValue:4096                 forKey:@"videotoolbox-max-frame-width"];
+    [options setPlayerOptionIntValue:0                    forKey:@"max-fps"];
+    [options setPlayerOptionIntValue:1                    forKey:@"framedrop"];
+    [options setFormatOptionIntValue:0                    forKey:@"http_pool"];
+    [options setFormatOptionIntValue:0                    forKey:@"http2"];
+    [options setFormatOptionIntValue:0                    forKey:@"http3"];
+
+    IJKFFMoviePlayerController *player = [[IJKFFMoviePlayerController alloc] initWithContentURL:url withOptions:options];
+    player.view.frame = CGRectMake(0, 0, 640, 360);
+    player.shouldAutoplay = YES;
+
+    XCTestExpectation *firstFrame = [self expectationWithDescription:[NSString stringWithFormat:@"first frame of %@", name]];
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:IJKMPMoviePlayerFirstVideoFrameRenderedNotification
+                                                                    object:player
+                                                                     queue:[NSOperationQueue mainQueue]
+                                                                usingBlock:^(NSNotification *note) {
+        [firstFrame fulfill];
+    }];
+
+    if (netTrace.length > 0)
+        XCTAssertTrue([IJKFFMoviePlayerController startReplayingNetworkTrace:netTrace], @"unreadable network trace %@", netTrace);
+
+    double peakMemory = bench_footprint_mb();
+    CFTimeInterval prepareTime = CACurrentMediaTime();
+    [player prepareToPlay];
+    [self waitForExpectationsWithTimeout:IJK_BENCH_FIRST_FRAME_TIMEOUT handler:nil];
+    double ttff = (CACurrentMediaTime() - prepareTime) * 1000;
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+
+    double cpuStart  = bench_cpu_seconds();
+    double wallStart = CACurrentMediaTime();
+    int64_t droppedStart = player.droppedPresentsAtOutput;
+    double decodeFpsSum = 0;
+    double outputFpsSum = 0;
+    int    samples      = 0;
+    while (CACurrentMediaTime() - wallStart < seconds) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:IJK_BENCH_SAMPLE_INTERVAL]];
+        peakMemory    = MAX(peakMemory, bench_footprint_mb());
+        decodeFpsSum += player.fpsAtDecoder;
+        outputFpsSum += player.fpsAtOutput;
+        samples++;
+    }
+    double cpuSeconds = bench_cpu_seconds() - cpuStart;
+    double wall       = CACurrentMediaTime() - wallStart;
+    IJKFFStatistics statistics = player.statistics;
+
+    NSDictionary *result = @{
+        @"name":             name,
+        @"decoder":          videoToolbox ? @"videotoolbox" : @"software",
+        @"decoder_opened":   player.isVideoToolboxOpen ? @"videotoolbox" : @"software",
+        @"ttff_ms":          @(ttff),
+        @"prepare_ms":       @(player.monitor.prepareDuration),
+        @"decode_fps":       @(samples > 0 ? decodeFpsSum / samples : 0),
+        @"output_fps":       @(samples > 0 ? outputFpsSum / samples : 0),
+        @"dropped_presents": @(player.droppedPresentsAtOutput - droppedStart),
+        @"drop_frame_rate":  @(player.dropFrameRate),
+        @"cpu_seconds":      @(cpuSeconds),
+        @"cpu_percent":      @(wall > 0 ? cpuSeconds * 100 / wall : 0),
+        @"peak_memory_mb":   @(peakMemory),
+        @"rebuffer_count":   @(statistics.rebufferCount),
+        @"rebuffer_ms":      @(statistics.rebufferDuration),
+        // no energy counter is readable in process: CPU time stands for it,
+        // the thermal state tells when the figures are throttled
+        @"thermal_state":    @([NSProcessInfo processInfo].thermalState),
+    };
+
+    [player shutdown];
+    if (netTrace.length > 0)
+        [IJKFFMoviePlayerController stopNetworkTrace];
+    return result;
+}
+
+- (void)compareResults:(NSArray *)results withBaseline:(NSDictionary *)baseline
+{
+    NSDictionary *thresholds = baseline[@"thresholds"] ?: g_bench_thresholds();
+    NSMutableDictionary *baselineRuns = [NSMutableDictionary dictionary];
+    for (NSDictionary *run in baseline[@"results"])
+        baselineRuns[[NSString stringWithFormat:@"%@/%@", run[@"name"], run[@"decoder"]]] = run;
+
+    for (NSDictionary *run in results) {
+        NSString     *key  = [NSString stringWithFormat:@"%@/%@", run[@"name"], run[@"decoder"]];
+        NSDictionary *base = baselineRuns[key];
+        if (!base)
+            continue;
+
+        [thresholds enumerateKeysAndObjectsUsingBlock:^(NSString *metric, NSDictionary *rule, BOOL *stop) {
+            NSNumber *value = run[metric];
+            NSNumber *was   = base[metric];
+            if (!value || !was)
+                return;
+
+            double tolerance = [rule[@"tolerance"] doubleValue];
+            double slack     = [rule[@"slack"] doubleValue];
+            BOOL   higher    = [rule[@"worse"] isEqualToString:@"higher"];
+            double limit     = higher ? was.doubleValue * (1 + tolerance) + slack
+                                      : was.doubleValue * (1 - tolerance) - slack;
+            BOOL   regressed = higher ? value.doubleValue > limit : value.doubleValue < limit;
+            XCTAssertFalse(regressed, @"%@ %@: %.2f, baseline %.2f, limit %.2f",
+                           key, metric, value.doubleValue, was.doubleValue, limit);
+        }];
+    }
+}
+
+- (void)testPlaybackBenchmark {
+    NSDictionary *env = [NSProcessInfo processInfo].environment;
+    NSString *corpus = env[@"IJK_BENCH_CORPUS_DIR"];
+    XCTSkipUnless(corpus.length > 0, @"IJK_BENCH_CORPUS_DIR not set, see tools/make-benchmark-corpus.sh");
+
+    double seconds = [env[@"IJK_BENCH_SECONDS"] doubleValue];
+    if (seconds <= 0)
+        seconds = IJK_BENCH_DEFAULT_SECONDS;
+    NSString *netTrace = env[@"IJK_BENCH_NET_TRACE"];
+
+    IJKBenchHTTPServer *server = [[IJKBenchHTTPServer alloc] initWithRoot:corpus];
+    XCTAssertTrue([server start], @"http server failed to start");
+
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSArray *entry in [[self class] benchmarkCorpus]) {
+        NSString *file = [corpus stringByAppendingPathComponent:entry[1]];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:file]) {
+            NSLog(@"benchmark: %@ missing, skipped\n", file);
+            continue;
+        }
+
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u/%@", server.port, entry[1]]];
+        for (NSNumber *videoToolbox in @[@YES, @NO]) {
+            @autoreleasepool {
+                NSDictionary *result = [self runBenchmark:entry[0] url:url videoToolbox:videoToolbox.boolValue
+                                                  seconds:seconds netTrace:netTrace];
+                NSLog(@"benchmark: %@\n", result);
+                [results addObject:result];
+            }
+        }
+    }
+    [server stop];
+
+    UIDevice *device = [UIDevice currentDevice];
+    NSDictionary *report = @{
+        @"date":      [NSISO8601DateFormatter stringFromDate:[NSDate date]
+                                                    timeZone:[NSTimeZone timeZoneWithAbbreviation:@"UTC"]
+                                               formatOptions:NSISO8601DateFormatWithInternetDateTime],
+        @"device":    device.model,
+        @"system":    [NSString stringWithFormat:@"%@ %@", device.systemName, device.systemVersion],
+        @"seconds":   @(seconds),
+        @"net_trace": netTrace.lastPathComponent ?: @"",
+        @"results":   results,
+    };
+
+    NSString *output = env[@"IJK_BENCH_OUTPUT"];
+    if (output.length == 0)
+        output = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ijk-benchmark.json"];
+    NSData *json = [NSJSONSerialization dataWithJSONObject:report
+                                                   options:NSJSONWritingPrettyPrinted | NSJSONWritingSortedKeys
+                                                     error:nil];
+    XCTAssertTrue([json writeToFile:output atomically:YES], @"failed to write %@", output);
+    NSLog(@"benchmark: results written to %@\n", output);
+
+    NSString *baselinePath = env[@"IJK_BENCH_BASELINE"];
+    if (baselinePath.length > 0) {
+        NSData *data = [NSData dataWithContentsOfFile:baselinePath];
+        NSDictionary *baseline = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        XCTAssertNotNil(baseline, @"unreadable baseline %@", baselinePath);
+        if (baseline)
+            [self compareResults:results withBaseline:baseline];
+    }
+}
+
+- (void)testCheckasm {
+    XCTSkipUnless(checkasm_main != NULL, @"libcheckasm.a not linked, build with IJK_CHECKASM=YES");
+
+    NSDictionary *env  = [NSProcessInfo processInfo].environment;
+    NSString     *args = env[@"IJK_CHECKASM_ARGS"];
+    if (args.length == 0)
+        args = @"--bench";
+
+    NSMutableArray *argStrings = [NSMutableArray arrayWithObject:@"checkasm"];
+    for (NSString *arg in [args componentsSeparatedByString:@" "]) {
+        if (arg.length > 0)
+            [argStrings addObject:arg];
+    }
+    int    argc = (int)argStrings.count;
+    char **argv = calloc(argc + 1, sizeof(char *));
+    for (int i = 0; i < argc; i++)
+        argv[i] = strdup([argStrings[i] UTF8String]);
+
+    // the timings go to stdout, the verdicts to stderr and so to the log
+    NSString *capture = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ijk-checkasm.txt"];
+    int captureFd = open(capture.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    XCTAssertTrue(captureFd >= 0, @"failed to open %@", capture);
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(captureFd, STDOUT_FILENO);
+    close(captureFd);
+
+    int ret = checkasm_main(argc, argv);
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    for (int i = 0; i < argc; i++)
+        free(argv[i]);
+    free(argv);
+
+    XCTAssertEqual(ret, 0, @"checkasm failed, see the log");
+
+    NSString     *output  = [NSString stringWithContentsOfFile:capture encoding:NSUTF8StringEncoding error:nil];
+    NSDictionary *timings = checkasm_parse_timings(output ?: @"");
+    if (timings.count == 0)
+        return;
+
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSString *function in [timings.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NSDictionary *versions = timings[function];
+        double c    = [versions[@"c"] doubleValue];
+        double neon = [versions[@"neon"] doubleValue];
+        double speedup = c > 0 && neon > 0 ? c / neon : 0;
+        NSLog(@"checkasm: %-40s c %10.1f ns  neon %10.1f ns  x%.2f\n",
+              function.UTF8String, c, neon, speedup);
+
+        NSMutableDictionary *result = [NSMutableDictionary dictionaryWithDictionary:versions];
+        result[@"name"]    = function;
+        result[@"speedup"] = @(speedup);
+        [results addObject:result];
+    }
+
+    UIDevice *device = [UIDevice currentDevice];
+    NSDictionary *report = @{
+        @"date":    [NSISO8601DateFormatter stringFromDate:[NSDate date]
+                                                  timeZone:[NSTimeZone timeZoneWithAbbreviation:@"UTC"]
+                                             formatOptions:NSISO8601DateFormatWithInternetDateTime],
+        @"device":  device.model,
+        @"system":  [NSString stringWithFormat:@"%@ %@", device.systemName, device.systemVersion],
+        @"args":    args,
+        @"units":   @"ns",
+        @"results": results,
+    };
+
+    NSString *outputPath = env[@"IJK_CHECKASM_OUTPUT"];
+    if (outputPath.length == 0)
+        outputPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ijk-checkasm.json"];
+    NSData *json = [NSJSONSerialization dataWithJSONObject:report
+                                                   options:NSJSONWritingPrettyPrinted | NSJSONWritingSortedKeys
+                                                     error:nil];
+    XCTAssertTrue([json writeToFile:outputPath atomically:YES], @"failed to write %@", outputPath);
+    NSLog(@"checkasm: timings written to %@\n", outputPath);
+}
+
+
+- (NSArray *)runDecoderBenchmarkOn:(NSString *)file name:(NSString *)name
+                              pace:(IJKFFDecoderBenchmarkPace)pace timeout:(double)timeout
+{
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSNumber *mode in @[@(IJKFFDecoderBenchmarkModeVideoToolboxAsync),
+                             @(IJKFFDecoderBenchmarkModeVideoToolboxSync),
+                             @(IJKFFDecoderBenchmarkModeSoftware)]) {
+        @autoreleasepool {
+            IJKFFDecoderBenchmark *benchmark = [[IJKFFDecoderBenchmark alloc] initWithContentURL:[NSURL fileURLWithPath:file]
+                                                                                           mode:mode.integerValue];
+            benchmark.pace = pace;
+            IJKFFDecoderBenchmarkResult r = [benchmark runWithTimeout:timeout];
+            XCTAssertEqual(r.error, 0, @"%@ %@: error", name, decoder_benchmark_mode_name(mode.integerValue));
+
+            NSDictionary *result = @{
+                @"name":              name,
+                @"decoder":           decoder_benchmark_mode_name(mode.integerValue),
+                // NO for the VideoToolbox modes when it fell back to software
+                @"videotoolbox":      @(r.videoToolbox),
+                @"completed":         @(r.completed),
+                @"frames":            @(r.frames),
+                @"seconds":           @(r.seconds),
+                @"fps":               @(r.framesPerSecond),
+                @"latency_p50_us":    @(r.latencyP50),
+                @"latency_p95_us":    @(r.latencyP95),
+                @"latency_p99_us":    @(r.latencyP99),
+                @"session_create_ms": @(r.sessionCreateMilliseconds),
+                @"session_count":     @(r.sessionCount),
+                @"thermal_state":     @([NSProcessInfo processInfo].thermalState),
+            };
+            NSLog(@"decoder benchmark: %@\n", result);
+            [results addObject:result];
+        }
+    }
+    return results;
+}
+
+- (void)writeDecoderBenchmarkResults:(NSArray *)results to:(NSString *)output
+{
+    UIDevice *device = [UIDevice currentDevice];
+    NSDictionary *report = @{
+        @"date":    [NSISO8601DateFormatter stringFromDate:[NSDate date]
+                                                  timeZone:[NSTimeZone timeZoneWithAbbreviation:@"UTC"]
+                                             formatOptions:NSISO8601DateFormatWithInternetDateTime],
+        @"device":  device.model,
+        @"system":  [NSString stringWithFormat:@"%@ %@", device.systemName, device.systemVersion],
+        @"results": results,
+    };
+
+    NSData *json = [NSJSONSerialization dataWithJSONObject:report
+                                                   options:NSJSONWritingPrettyPrinted | NSJSONWritingSortedKeys
+                                                     error:nil];
+    XCTAssertTrue([json writeToFile:output atomically:YES], @"failed to write %@", output);
+    NSLog(@"decoder benchmark: results written to %@\n", output);
+}
+
+- (void)testDecoderBenchmark {
+    NSDictionary *env = [NSProcessInfo processInfo].environment;
+    NSString *corpus = env[@"IJK_BENCH_CORPUS_DIR"];
+    XCTSkipUnless(corpus.length > 0, @"IJK_BENCH_CORPUS_DIR not set, see tools/make-benchmark-corpus.sh");
+
+    double timeout = [env[@"IJK_BENCH_DECODER_TIMEOUT"] doubleValue];
+    if (timeout <= 0)
+        timeout = IJK_BENCH_DECODER_DEFAULT_TIMEOUT;
+
+    NSMutableArray *results = [NSMutableArray array];
+    for (NSArray *entry in [[self class] benchmarkCorpus]) {
+        NSString *file = [corpus stringByAppendingPathComponent:entry[1]];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:file]) {
+            NSLog(@"decoder benchmark: %@ missing, skipped\n", file);
+            continue;
+        }
+
+        [results addObjectsFromArray:[self runDecoderBenchmarkOn:file name:entry[0]
+                                                            pace:IJKFFDecoderBenchmarkPaceNone timeout:timeout]];
+    }
+
+    NSString *output = env[@"IJK_BENCH_DECODER_OUTPUT"];
+    if (output.length == 0)
+        output = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ijk-decoder-benchmark.json"];
+    [self writeDecoderBenchmarkResults:results to:output];
+}
+
+- (void)testCaptureReplay {
+    NSDictionary *env = [NSProcessInfo processInfo].environment;
+    NSString *dir = env[@"IJK_BENCH_CAPTURE_DIR"];
+    XCTSkipUnless(dir.length > 0, @"IJK_BENCH_CAPTURE_DIR not set");
+
+    NSDictionary *paces = @{
+        @"none":    @(IJKFFDecoderBenchmarkPaceNone),
+        @"dts":     @(IJKFFDecoderBenchmarkPaceTimestamps),
+        @"capture": @(IJKFFDecoderBenchmarkPaceCapture),
+    };
+    NSString *paceName = env[@"IJK_BENCH_CAPTURE_PACE"] ?: @"capture";
+    NSNumber *pace = paces[paceName];
+    XCTAssertNotNil(pace, @"unknown IJK_BENCH_CAPTURE_PACE %@", paceName);
+    if (!pace)
+        return;
+
+    double timeout = [env[@"IJK_BENCH_DECODER_TIMEOUT"] doubleValue];
+    if (timeout <= 0)
+        timeout = IJK_BENCH_DECODER_DEFAULT_TIMEOUT;
+
+    NSMutableArray *results = [NSMutableArray array];
+    NSArray *files = [[[NSFileManager defaultManager] contentsOfDirectoryAtPath:dir error:nil]
+                      sortedArrayUsingSelector:@selector(compare:)];
+    for (NSString *name in files) {
+        if (![name.pathExtension isEqualToString:@"pktcap"])
+            continue;
+
+        for (NSDictionary *result in [self runDecoderBenchmarkOn:[dir stringByAppendingPathComponent:name]
+                                                             name:name.stringByDeletingPathExtension
+                                                             pace:pace.integerValue timeout:timeout]) {
+            NSMutableDictionary *paced = [result mutableCopy];
+            paced[@"pace"] = paceName;
+            [results addObject:paced];
+        }
+    }
+    XCTAssertTrue(results.count > 0, @"no .pktcap in %@", dir);
+
+    NSString *output = env[@"IJK_BENCH_CAPTURE_OUTPUT"];
+    if (output.length == 0)
+        output = [NSTemporaryDirectory() stringByAppendingPathComponent:@"ijk-capture-replay.json"];
+    [self writeDecoderBenchmarkResults:results to:output];
+}
+
 @end
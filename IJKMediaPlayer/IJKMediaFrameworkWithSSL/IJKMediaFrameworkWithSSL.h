@@ -20,6 +20,8 @@ FOUNDATION_EXPORT const unsigned char IJKMediaFrameworkWithSSLVersionString[];
 #import <IJKMediaFrameworkWithSSL/IJKMPMoviePlayerController.h>
 #import <IJKMediaFrameworkWithSSL/IJKFFOptions.h>
 #import <IJKMediaFrameworkWithSSL/IJKFFMoviePlayerController.h>
+#import <IJKMediaFrameworkWithSSL/IJKMediaPreloader.h>
+#import <IJKMediaFrameworkWithSSL/IJKMediaDataSource.h>
 #import <IJKMediaFrameworkWithSSL/IJKAVMoviePlayerController.h>
 #import <IJKMediaFrameworkWithSSL/IJKMediaModule.h>
 #import <IJKMediaFrameworkWithSSL/IJKMediaPlayer.h>
@@ -70,6 +70,7 @@
 
 #import "IJKAVMoviePlayerController.h"
 #import "IJKAVPlayerLayerView.h"
+#import "IJKAVResourceLoader.h"
 #import "IJKAudioKit.h"
 #import "IJKMediaModule.h"
 #import "IJKMediaUtils.h"
@@ -116,6 +117,7 @@ static void *KVO_AVPlayerItem_playbackBufferEmpty       = &KVO_AVPlayerItem_play
 @implementation IJKAVMoviePlayerController {
     NSURL           *_playUrl;
     AVURLAsset      *_playAsset;
+    IJKAVResourceLoader *_resourceLoader;
     AVPlayerItem    *_playerItem;
     AVPlayer        *_player;
     IJKAVPlayerLayerView * _avView;
@@ -244,7 +246,9 @@ static IJKAVMoviePlayerController* instance;
 
 - (void)prepareToPlay
 {
-    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:_playUrl options:nil];
+    // through the disk cache of the ffmpeg players when one is configured
+    _resourceLoader = [[IJKAVResourceLoader alloc] initWithURL:_playUrl];
+    AVURLAsset *asset = _resourceLoader ? _resourceLoader.asset : [AVURLAsset URLAssetWithURL:_playUrl options:nil];
     NSArray *requestedKeys = @[@"playable"];
     
     _playAsset = asset;
@@ -319,6 +323,8 @@ static IJKAVMoviePlayerController* instance;
     if (_avView != nil) {
         [_avView setPlayer:nil];
     }
+
+    [_resourceLoader invalidate];
     
     self.view = nil;
 }
@@ -0,0 +1,43 @@
+/*
+ * IJKAVResourceLoader.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+ */
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+
+// Serves an AVURLAsset of a progressive http(s) file from the disk cache of
+// the ffmpeg players, downloading the ranges it misses into it: both players
+// and IJKMediaPreloader share the same entries. HLS is left to AVFoundation.
+@interface IJKAVResourceLoader : NSObject <AVAssetResourceLoaderDelegate>
+
+// nil if the url is not a progressive http(s) file or no disk cache is
+// configured, see +[IJKFFMoviePlayerController setDiskCacheDirectory:maxSize:]
+- (instancetype)initWithURL:(NSURL *)url;
+
+// loaded through the receiver
+@property(nonatomic, readonly) AVURLAsset *asset;
+
+// cancels the downloads and breaks the retain cycle of the session
+- (void)invalidate;
+
+@end
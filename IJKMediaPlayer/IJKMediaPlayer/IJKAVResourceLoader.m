@@ -0,0 +1,347 @@
+/*
+ * IJKAVResourceLoader.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+ */
+
+#import "IJKAVResourceLoader.h"
+#import <MobileCoreServices/MobileCoreServices.h>
+#include "libavformat/disk_cache.h"
+
+#define RESOURCE_LOADER_SCHEME_PREFIX   @"ijkcache-"
+#define RESOURCE_LOADER_CHUNK           (256 * 1024)
+
+@interface IJKAVResourceLoaderTask : NSObject
+@property(nonatomic, strong) AVAssetResourceLoadingRequest *request;
+@property(nonatomic, strong) NSURLSessionDataTask *dataTask;
+@property(nonatomic) int64_t pos;
+@property(nonatomic) int64_t end;           // -1 up to the end of the resource
+@property(nonatomic) int64_t downloadStart;
+@end
+
+@implementation IJKAVResourceLoaderTask
+@end
+
+@interface IJKAVResourceLoader () <NSURLSessionDataDelegate>
+@end
+
+@implementation IJKAVResourceLoader {
+    NSURL           *_url;
+    NSString        *_contentType;
+    DiskCacheFile   *_file;
+    dispatch_queue_t _queue;
+    NSURLSession    *_session;
+    NSMutableArray<IJKAVResourceLoaderTask *> *_tasks;
+}
+
+static NSString *typeForExtension(NSString *ext)
+{
+    if (ext.length == 0)
+        return nil;
+    NSString *uti = (__bridge_transfer NSString *)UTTypeCreatePreferredIdentifierForTag(kUTTagClassFilenameExtension, (__bridge CFStringRef)ext, NULL);
+    return [uti hasPrefix:@"dyn."] ? nil : uti;
+}
+
+static NSString *typeForMIMEType(NSString *mime)
+{
+    if (mime.length == 0)
+        return nil;
+    NSString *uti = (__bridge_transfer NSString *)UTTypeCreatePreferredIdentifierForTag(kUTTagClassMIMEType, (__bridge CFStringRef)mime, NULL);
+    return [uti hasPrefix:@"dyn."] ? nil : uti;
+}
+
+- (instancetype)initWithURL:(NSURL *)url
+{
+    NSString *scheme = url.scheme.lowercaseString;
+    if (![scheme isEqualToString:@"http"] && ![scheme isEqualToString:@"https"])
+        return nil;
+    if ([url.pathExtension.lowercaseString isEqualToString:@"m3u8"])
+        return nil;
+
+    self = [super init];
+    if (self) {
+        // keyed by the url as the http protocol sees it, as in cache.c
+        if (ff_disk_cache_open(&_file, url.absoluteString.UTF8String, NULL) < 0)
+            return nil;
+
+        _url         = url;
+        _contentType = typeForExtension(url.pathExtension);
+        _tasks       = [NSMutableArray array];
+        _queue       = dispatch_queue_create("tv.danmaku.ijkplayer.resourceloader", DISPATCH_QUEUE_SERIAL);
+
+        NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.underlyingQueue = _queue;
+        delegateQueue.maxConcurrentOperationCount = 1;
+        _session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                                                 delegate:self
+                                            delegateQueue:delegateQueue];
+
+        // the loader is only asked for the schemes AVFoundation cannot load itself
+        NSURLComponents *components = [NSURLComponents componentsWithURL:url resolvingAgainstBaseURL:NO];
+        components.scheme = [RESOURCE_LOADER_SCHEME_PREFIX stringByAppendingString:scheme];
+        _asset = [AVURLAsset URLAssetWithURL:components.URL options:nil];
+        [_asset.resourceLoader setDelegate:self queue:_queue];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    ff_disk_cache_close(&_file);
+}
+
+- (void)invalidate
+{
+    [_session invalidateAndCancel];
+}
+
+#pragma mark serving
+
+- (BOOL)fillContentInformation:(AVAssetResourceLoadingRequest *)request
+{
+    AVAssetResourceLoadingContentInformationRequest *info = request.contentInformationRequest;
+    int64_t size = ff_disk_cache_get_size(_file);
+
+    if (!info || info.contentLength > 0)
+        return YES;
+    if (size < 0)
+        return NO;
+
+    info.contentType = _contentType ?: AVFileTypeMPEG4;
+    info.contentLength = size;
+    info.byteRangeAccessSupported = YES;
+    return YES;
+}
+
+- (void)finishTask:(IJKAVResourceLoaderTask *)task error:(NSError *)error
+{
+    NSURLSessionDataTask *dataTask = task.dataTask;
+
+    task.dataTask = nil;
+    [dataTask cancel];
+    [_tasks removeObject:task];
+    if (task.request.isFinished || task.request.isCancelled)
+        return;
+    if (error)
+        [task.request finishLoadingWithError:error];
+    else
+        [task.request finishLoading];
+}
+
+- (BOOL)isTaskDone:(IJKAVResourceLoaderTask *)task
+{
+    int64_t size = ff_disk_cache_get_size(_file);
+
+    if (task.end >= 0)
+        return task.pos >= task.end;
+    return size >= 0 && task.pos >= size;
+}
+
+// one chunk at a time off the cache, then back on the queue so the other
+// requests and the downloads get their turn
+- (void)serveTask:(IJKAVResourceLoaderTask *)task
+{
+    if (![_tasks containsObject:task] || task.dataTask)
+        return;
+    if (task.request.isCancelled) {
+        [self finishTask:task error:nil];
+        return;
+    }
+
+    BOOL hasInfo = [self fillContentInformation:task.request];
+    if (hasInfo && (!task.request.dataRequest || [self isTaskDone:task])) {
+        [self finishTask:task error:nil];
+        return;
+    }
+
+    int64_t avail = hasInfo ? ff_disk_cache_available(_file, task.pos) : 0;
+    if (avail > 0) {
+        int size = (int)MIN(avail, RESOURCE_LOADER_CHUNK);
+        if (task.end >= 0)
+            size = (int)MIN(size, task.end - task.pos);
+
+        NSMutableData *data = [NSMutableData dataWithLength:size];
+        int ret = ff_disk_cache_read(_file, task.pos, data.mutableBytes, size);
+        if (ret > 0) {
+            data.length = ret;
+            task.pos += ret;
+            [task.request.dataRequest respondWithData:data];
+            dispatch_async(_queue, ^{
+                [self serveTask:task];
+            });
+            return;
+        }
+    }
+
+    [self downloadTask:task];
+}
+
+- (void)downloadTask:(IJKAVResourceLoaderTask *)task
+{
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:_url];
+    NSString *range = task.end >= 0
+        ? [NSString stringWithFormat:@"bytes=%lld-%lld", task.pos, task.end - 1]
+        : [NSString stringWithFormat:@"bytes=%lld-", task.pos];
+
+    [request setValue:range forHTTPHeaderField:@"Range"];
+    task.downloadStart = task.pos;
+    task.dataTask = [_session dataTaskWithRequest:request];
+    [task.dataTask resume];
+}
+
+- (IJKAVResourceLoaderTask *)taskForDataTask:(NSURLSessionTask *)dataTask
+{
+    for (IJKAVResourceLoaderTask *task in _tasks) {
+        if (task.dataTask == dataTask)
+            return task;
+    }
+    return nil;
+}
+
+- (IJKAVResourceLoaderTask *)taskForRequest:(AVAssetResourceLoadingRequest *)request
+{
+    for (IJKAVResourceLoaderTask *task in _tasks) {
+        if (task.request == request)
+            return task;
+    }
+    return nil;
+}
+
+#pragma mark AVAssetResourceLoaderDelegate
+
+- (BOOL)resourceLoader:(AVAssetResourceLoader *)resourceLoader shouldWaitForLoadingOfRequestedResource:(AVAssetResourceLoadingRequest *)loadingRequest
+{
+    AVAssetResourceLoadingDataRequest *dataRequest = loadingRequest.dataRequest;
+    IJKAVResourceLoaderTask *task = [[IJKAVResourceLoaderTask alloc] init];
+
+    task.request = loadingRequest;
+    if (dataRequest) {
+        task.pos = dataRequest.currentOffset;
+        if (dataRequest.requestsAllDataToEndOfResource)
+            task.end = -1;
+        else
+            task.end = dataRequest.requestedOffset + dataRequest.requestedLength;
+    } else {
+        // only the content information: the first bytes bring the size
+        task.pos = 0;
+        task.end = 2;
+    }
+
+    [_tasks addObject:task];
+    [self serveTask:task];
+    return YES;
+}
+
+- (void)resourceLoader:(AVAssetResourceLoader *)resourceLoader didCancelLoadingRequest:(AVAssetResourceLoadingRequest *)loadingRequest
+{
+    IJKAVResourceLoaderTask *task = [self taskForRequest:loadingRequest];
+    if (task)
+        [self finishTask:task error:nil];
+}
+
+#pragma mark NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    IJKAVResourceLoaderTask *task = [self taskForDataTask:dataTask];
+    NSHTTPURLResponse *http = [response isKindOfClass:[NSHTTPURLResponse class]] ? (NSHTTPURLResponse *)response : nil;
+    int64_t size = -1;
+
+    if (!task || !http) {
+        completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+
+    if (http.statusCode == 206) {
+        // bytes <first>-<last>/<size>
+        NSString *contentRange = http.allHeaderFields[@"Content-Range"];
+        long long first = -1, total = -1;
+        NSScanner *scanner = [NSScanner scannerWithString:contentRange ?: @""];
+        [scanner scanString:@"bytes" intoString:NULL];
+        if ([scanner scanLongLong:&first] &&
+            [scanner scanUpToString:@"/" intoString:NULL] &&
+            [scanner scanString:@"/" intoString:NULL] &&
+            [scanner scanLongLong:&total])
+            size = total;
+        if (first != task.pos) {
+            completionHandler(NSURLSessionResponseCancel);
+            [self finishTask:task error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil]];
+            return;
+        }
+    } else if (http.statusCode == 200 && task.pos == 0) {
+        size = response.expectedContentLength;
+    } else {
+        // a server ignoring the range would send what is not asked for
+        completionHandler(NSURLSessionResponseCancel);
+        [self finishTask:task error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:nil]];
+        return;
+    }
+
+    if (size > 0)
+        ff_disk_cache_set_size(_file, size);
+    if (!_contentType)
+        _contentType = typeForMIMEType(response.MIMEType);
+    [self fillContentInformation:task.request];
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+    IJKAVResourceLoaderTask *task = [self taskForDataTask:dataTask];
+    if (!task)
+        return;
+
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        ff_disk_cache_write(_file, task.pos + byteRange.location, bytes, (int)byteRange.length);
+    }];
+
+    if (task.request.dataRequest) {
+        NSData *reply = data;
+        if (task.end >= 0 && task.pos + (int64_t)data.length > task.end)
+            reply = [data subdataWithRange:NSMakeRange(0, (NSUInteger)(task.end - task.pos))];
+        [task.request.dataRequest respondWithData:reply];
+    }
+    task.pos += data.length;
+
+    if ([self fillContentInformation:task.request] && (!task.request.dataRequest || [self isTaskDone:task]))
+        [self finishTask:task error:nil];
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)dataTask didCompleteWithError:(NSError *)error
+{
+    IJKAVResourceLoaderTask *task = [self taskForDataTask:dataTask];
+    if (!task)
+        return;
+
+    task.dataTask = nil;
+    if (error) {
+        [self finishTask:task error:error];
+    } else if (task.pos == task.downloadStart) {
+        [self finishTask:task error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorZeroByteResource userInfo:nil]];
+    } else {
+        // ended short: the rest from the cache or another download
+        [self serveTask:task];
+    }
+}
+
+@end
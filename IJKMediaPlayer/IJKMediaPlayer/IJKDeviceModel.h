@@ -39,6 +39,37 @@
 #define kIJKDeviceRank_LatestUnknown                    90
 #define kIJKDeviceRank_Simulator                        100
 
+#define IJK_DECODE_REFUSED_MAX                          4
+
+// a picture of a codec, level in its own units: level_idc for H.264,
+// general_level_idc for HEVC, 0 if unknown
+typedef struct IJKDecodeFormat {
+    int     width;
+    int     height;
+    int     level;
+    BOOL    tenBit;
+} IJKDecodeFormat;
+
+typedef NS_OPTIONS(uint32_t, IJKDecodeOutputFormats) {
+    IJKDecodeOutputNV12     = 1 << 0,   // kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange
+    IJKDecodeOutputNV12Full = 1 << 1,   // kCVPixelFormatType_420YpCbCr8BiPlanarFullRange
+    IJKDecodeOutputBGRA     = 1 << 2,   // kCVPixelFormatType_32BGRA
+    IJKDecodeOutputP010     = 1 << 3,   // kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange
+};
+
+// what VideoToolbox decodes in hardware for a codec, on this device model
+// and OS version
+typedef struct IJKDecodeCapability {
+    BOOL                    hardware;
+    BOOL                    tenBit;
+    IJKDecodeFormat         largest;        // the largest probed a session opened for, 0 if none
+    IJKDecodeOutputFormats  outputFormats;  // 0 if not probed
+    // the smallest formats a session was refused for, by the probe or by
+    // a player since; a format at least as large as one of them is too
+    int                     refusedCount;
+    IJKDecodeFormat         refused[IJK_DECODE_REFUSED_MAX];
+} IJKDecodeCapability;
+
 @interface IJKDeviceModel : NSObject
 
 @property(nonatomic) NSString   *platform;
@@ -47,4 +78,24 @@
 
 + (instancetype)currentModel;
 
+// cores of the running device, whatever the model: the performance cluster,
+// and the efficiency cluster, 0 when the cores are all alike
++ (NSInteger)performanceCoreCount;
++ (NSInteger)efficiencyCoreCount;
+
+// AV1, which VideoToolbox does not decode here, decoded in software by
+// dav1d at 1080p and 30 fps: the devices newer than the A9 class, with two
+// performance cores at least. Players on the others skip AV1 variants
++ (BOOL)decodesAV1InSoftware;
+
+// Probed once per device model and OS version, on a background queue, by
+// opening VideoToolbox sessions for synthetic H.264 parameter sets of a
+// ladder of sizes, levels and bit depths, then kept in the Caches for the
+// next launches. NO until known, the decoder is then tried as before
++ (void)probeDecodeCapabilities;
++ (BOOL)getDecodeCapability:(IJKDecodeCapability *)capability forCodecType:(FourCharCode)codecType;
+// a session was refused format as unsupported, persisted with the table
++ (void)addDecodeRefusal:(IJKDecodeFormat)format forCodecType:(FourCharCode)codecType;
++ (BOOL)isDecodeFormat:(IJKDecodeFormat)format supportedBy:(const IJKDecodeCapability *)capability;
+
 @end
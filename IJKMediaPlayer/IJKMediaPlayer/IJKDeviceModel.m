@@ -22,7 +22,12 @@
  */
 
 #import "IJKDeviceModel.h"
+#import <CoreMedia/CoreMedia.h>
+#import <VideoToolbox/VideoToolbox.h>
+#include "ijkplayer/ios/pipeline/h264_ps_writer.h"
 
+#include <pthread.h>
+#include <sys/sysctl.h>
 #include <sys/utsname.h>
 
 @implementation IJKDeviceModel
@@ -185,4 +190,387 @@ inline static void IJKDeviceRegister(NSMutableDictionary *dict,
     return [IJKDeviceModel modelWithName:[IJKDeviceModel currentModelName]];
 }
 
+static NSInteger IJKSysctlInt(const char *name)
+{
+    int    value = 0;
+    size_t size  = sizeof(value);
+
+    if (sysctlbyname(name, &value, &size, NULL, 0) != 0)
+        return 0;
+    return value;
+}
+
+static void IJKCoreCounts(NSInteger *performance, NSInteger *efficiency)
+{
+    static NSInteger       sPerformance = 0;
+    static NSInteger       sEfficiency  = 0;
+    static dispatch_once_t sOnceToken   = 0;
+    dispatch_once(&sOnceToken, ^{
+        // perflevel0 is the fastest cluster, iOS 15 on
+        NSInteger levels = IJKSysctlInt("hw.nperflevels");
+        if (levels > 1) {
+            sPerformance = IJKSysctlInt("hw.perflevel0.physicalcpu");
+            sEfficiency  = IJKSysctlInt("hw.perflevel1.physicalcpu");
+        }
+        if (sPerformance <= 0) {
+            sPerformance = IJKSysctlInt("hw.physicalcpu");
+            sEfficiency  = 0;
+        }
+        if (sPerformance <= 0)
+            sPerformance = 1;
+    });
+    *performance = sPerformance;
+    *efficiency  = sEfficiency;
+}
+
++ (NSInteger)performanceCoreCount
+{
+    NSInteger performance, efficiency;
+    IJKCoreCounts(&performance, &efficiency);
+    return performance;
+}
+
++ (NSInteger)efficiencyCoreCount
+{
+    NSInteger performance, efficiency;
+    IJKCoreCounts(&performance, &efficiency);
+    return efficiency;
+}
+
++ (BOOL)decodesAV1InSoftware
+{
+    IJKDeviceModel *model = [IJKDeviceModel currentModel];
+    NSInteger       rank  = model ? model.rank : kIJKDeviceRank_LatestUnknown;
+
+    return rank >= kIJKDeviceRank_LatestUnknown && [IJKDeviceModel performanceCoreCount] >= 2;
+}
+
+#pragma mark decode capabilities
+
+// bumped when the probe changes, the tables kept are probed again
+#define IJK_DECODE_CAPS_VERSION     1
+#define IJK_DECODE_CAPS_FILE        @"IJKDecodeCapabilities.plist"
+#define IJK_DECODE_CAPS_CODECS      2
+
+static const FourCharCode g_decodeCapsCodecTypes[IJK_DECODE_CAPS_CODECS] = {
+    kCMVideoCodecType_H264,
+    kCMVideoCodecType_HEVC,
+};
+
+static pthread_mutex_t     g_decodeCapsMutex = PTHREAD_MUTEX_INITIALIZER;
+static BOOL                g_decodeCapsKnown = NO;
+static IJKDecodeCapability g_decodeCaps[IJK_DECODE_CAPS_CODECS];
+
+static int IJKDecodeCapsIndex(FourCharCode codecType)
+{
+    for (int i = 0; i < IJK_DECODE_CAPS_CODECS; i++) {
+        if (g_decodeCapsCodecTypes[i] == codecType)
+            return i;
+    }
+    return -1;
+}
+
+static dispatch_queue_t IJKDecodeCapsQueue(void)
+{
+    static dispatch_queue_t sQueue     = nil;
+    static dispatch_once_t  sOnceToken = 0;
+    dispatch_once(&sOnceToken, ^{
+        sQueue = dispatch_queue_create("tv.danmaku.ijk.decode-caps", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(sQueue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    });
+    return sQueue;
+}
+
+// a picture at least as large as r in both directions, of its level and depth on
+static BOOL IJKDecodeFormatCovers(const IJKDecodeFormat *f, const IJKDecodeFormat *r)
+{
+    return MAX(f->width, f->height) >= MAX(r->width, r->height) &&
+           MIN(f->width, f->height) >= MIN(r->width, r->height) &&
+           (f->level <= 0 || f->level >= r->level) &&
+           (f->tenBit || !r->tenBit);
+}
+
+// the refusals kept are the smallest ones, a new one covering none of them
+static BOOL IJKDecodeCapabilityAddRefusal(IJKDecodeCapability *capability, const IJKDecodeFormat *format)
+{
+    for (int i = 0; i < capability->refusedCount; i++) {
+        if (IJKDecodeFormatCovers(format, &capability->refused[i]))
+            return NO;
+    }
+
+    int count = 0;
+    for (int i = 0; i < capability->refusedCount; i++) {
+        if (!IJKDecodeFormatCovers(&capability->refused[i], format))
+            capability->refused[count++] = capability->refused[i];
+    }
+    if (count == IJK_DECODE_REFUSED_MAX)
+        count--;
+    capability->refused[count++] = *format;
+    capability->refusedCount = count;
+    return YES;
+}
+
+#pragma mark decode capabilities, probe
+
+static void IJKDecodeProbeOutput(void *decompressionOutputRefCon, void *sourceFrameRefCon,
+                                 OSStatus status, VTDecodeInfoFlags infoFlags,
+                                 CVImageBufferRef imageBuffer, CMTime presentationTimeStamp,
+                                 CMTime presentationDuration)
+{
+}
+
+// the status of a session created for format, nothing decoded
+static OSStatus IJKProbeH264Session(const IJKDecodeFormat *format, OSType pixelFormat)
+{
+    CMVideoFormatDescriptionRef formatDescription = NULL;
+    OSStatus status = h264_ps_create_format_description(format->width, format->height, format->level,
+                                                        format->tenBit, &formatDescription);
+    if (status != noErr)
+        return status;
+
+    NSDictionary *attributes = @{(id)kCVPixelBufferPixelFormatTypeKey: @(pixelFormat)};
+    VTDecompressionOutputCallbackRecord callback = {IJKDecodeProbeOutput, NULL};
+    VTDecompressionSessionRef session = NULL;
+    status = VTDecompressionSessionCreate(kCFAllocatorDefault, formatDescription, NULL,
+                                          (__bridge CFDictionaryRef)attributes, &callback, &session);
+    if (session) {
+        VTDecompressionSessionInvalidate(session);
+        CFRelease(session);
+    }
+    CFRelease(formatDescription);
+    return status;
+}
+
+static void IJKProbeH264(IJKDecodeCapability *capability)
+{
+    // up the ladder until a session is refused
+    static const IJKDecodeFormat ladder[] = {
+        {1920, 1088, 41, NO},
+        {3840, 2160, 51, NO},
+        {4096, 2304, 52, NO},
+        {7680, 4320, 61, NO},
+    };
+    for (int i = 0; i < sizeof(ladder) / sizeof(ladder[0]); i++) {
+        if (IJKProbeH264Session(&ladder[i], kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange) != noErr) {
+            IJKDecodeCapabilityAddRefusal(capability, &ladder[i]);
+            break;
+        }
+        capability->hardware = YES;
+        capability->largest  = ladder[i];
+    }
+    if (!capability->hardware)
+        return;
+
+    // High 10 from 720p on
+    static const IJKDecodeFormat tenBit = {1280, 720, 31, YES};
+    capability->tenBit = IJKProbeH264Session(&tenBit, kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange) == noErr;
+    if (!capability->tenBit)
+        IJKDecodeCapabilityAddRefusal(capability, &tenBit);
+
+    static const struct {
+        OSType                 pixelFormat;
+        IJKDecodeOutputFormats output;
+    } outputs[] = {
+        {kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange,   IJKDecodeOutputNV12},
+        {kCVPixelFormatType_420YpCbCr8BiPlanarFullRange,    IJKDecodeOutputNV12Full},
+        {kCVPixelFormatType_32BGRA,                         IJKDecodeOutputBGRA},
+        {kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange,  IJKDecodeOutputP010},
+    };
+    for (int i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
+        if (IJKProbeH264Session(&ladder[0], outputs[i].pixelFormat) == noErr)
+            capability->outputFormats |= outputs[i].output;
+    }
+}
+
+// without synthetic parameter sets: VideoToolbox tells the hardware, whose
+// HEVC decoders all take Main 10; bounds come from the sessions refused
+static void IJKProbeHEVC(IJKDecodeCapability *capability)
+{
+    if (@available(iOS 11.0, *)) {
+        capability->hardware = VTIsHardwareDecodeSupported(kCMVideoCodecType_HEVC);
+        capability->tenBit   = capability->hardware;
+    }
+}
+
+#pragma mark decode capabilities, persistence
+
+static NSString *IJKDecodeCapsPath(void)
+{
+    NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+    return [caches stringByAppendingPathComponent:IJK_DECODE_CAPS_FILE];
+}
+
+// the table holds for one device model, OS version and probe
+static NSString *IJKDecodeCapsKey(void)
+{
+    NSOperatingSystemVersion os = [NSProcessInfo processInfo].operatingSystemVersion;
+    return [NSString stringWithFormat:@"%@/%ld.%ld.%ld/%d",
+            [IJKDeviceModel currentModelName],
+            (long)os.majorVersion, (long)os.minorVersion, (long)os.patchVersion,
+            IJK_DECODE_CAPS_VERSION];
+}
+
+static NSArray *IJKDecodeFormatToPlist(const IJKDecodeFormat *format)
+{
+    return @[@(format->width), @(format->height), @(format->level), @(format->tenBit)];
+}
+
+static BOOL IJKDecodeFormatFromPlist(id plist, IJKDecodeFormat *format)
+{
+    if (![plist isKindOfClass:[NSArray class]] || [plist count] != 4)
+        return NO;
+
+    format->width  = [plist[0] intValue];
+    format->height = [plist[1] intValue];
+    format->level  = [plist[2] intValue];
+    format->tenBit = [plist[3] boolValue];
+    return YES;
+}
+
+static NSDictionary *IJKDecodeCapabilityToPlist(const IJKDecodeCapability *capability)
+{
+    NSMutableArray *refused = [NSMutableArray array];
+    for (int i = 0; i < capability->refusedCount; i++)
+        [refused addObject:IJKDecodeFormatToPlist(&capability->refused[i])];
+
+    return @{
+        @"hardware":        @(capability->hardware),
+        @"tenBit":          @(capability->tenBit),
+        @"largest":         IJKDecodeFormatToPlist(&capability->largest),
+        @"outputFormats":   @(capability->outputFormats),
+        @"refused":         refused,
+    };
+}
+
+static BOOL IJKDecodeCapabilityFromPlist(id plist, IJKDecodeCapability *capability)
+{
+    if (![plist isKindOfClass:[NSDictionary class]])
+        return NO;
+
+    memset(capability, 0, sizeof(*capability));
+    capability->hardware      = [plist[@"hardware"] boolValue];
+    capability->tenBit        = [plist[@"tenBit"] boolValue];
+    capability->outputFormats = [plist[@"outputFormats"] unsignedIntValue];
+    IJKDecodeFormatFromPlist(plist[@"largest"], &capability->largest);
+
+    NSArray *refused = plist[@"refused"];
+    if ([refused isKindOfClass:[NSArray class]]) {
+        for (id format in refused) {
+            if (capability->refusedCount < IJK_DECODE_REFUSED_MAX &&
+                IJKDecodeFormatFromPlist(format, &capability->refused[capability->refusedCount]))
+                capability->refusedCount++;
+        }
+    }
+    return YES;
+}
+
+static BOOL IJKDecodeCapsLoad(IJKDecodeCapability *caps)
+{
+    NSDictionary *plist = [NSDictionary dictionaryWithContentsOfFile:IJKDecodeCapsPath()];
+    if (![plist[@"key"] isEqual:IJKDecodeCapsKey()])
+        return NO;
+
+    NSDictionary *codecs = plist[@"codecs"];
+    if (![codecs isKindOfClass:[NSDictionary class]])
+        return NO;
+    for (int i = 0; i < IJK_DECODE_CAPS_CODECS; i++) {
+        if (!IJKDecodeCapabilityFromPlist(codecs[[@(g_decodeCapsCodecTypes[i]) stringValue]], &caps[i]))
+            return NO;
+    }
+    return YES;
+}
+
+// on the queue of the probe
+static void IJKDecodeCapsSave(void)
+{
+    IJKDecodeCapability caps[IJK_DECODE_CAPS_CODECS];
+    pthread_mutex_lock(&g_decodeCapsMutex);
+    memcpy(caps, g_decodeCaps, sizeof(caps));
+    pthread_mutex_unlock(&g_decodeCapsMutex);
+
+    NSMutableDictionary *codecs = [NSMutableDictionary dictionary];
+    for (int i = 0; i < IJK_DECODE_CAPS_CODECS; i++)
+        codecs[[@(g_decodeCapsCodecTypes[i]) stringValue]] = IJKDecodeCapabilityToPlist(&caps[i]);
+
+    NSDictionary *plist = @{@"key": IJKDecodeCapsKey(), @"codecs": codecs};
+    if (![plist writeToFile:IJKDecodeCapsPath() atomically:YES])
+        NSLog(@"IJKDeviceModel: failed to save the decode capabilities\n");
+}
+
++ (void)probeDecodeCapabilities
+{
+    static dispatch_once_t sOnceToken = 0;
+    dispatch_once(&sOnceToken, ^{
+        dispatch_async(IJKDecodeCapsQueue(), ^{
+            IJKDecodeCapability caps[IJK_DECODE_CAPS_CODECS];
+            BOOL loaded = IJKDecodeCapsLoad(caps);
+            if (!loaded) {
+                memset(caps, 0, sizeof(caps));
+                IJKProbeH264(&caps[IJKDecodeCapsIndex(kCMVideoCodecType_H264)]);
+                IJKProbeHEVC(&caps[IJKDecodeCapsIndex(kCMVideoCodecType_HEVC)]);
+            }
+
+            pthread_mutex_lock(&g_decodeCapsMutex);
+            // refusals of the players meanwhile are kept
+            for (int i = 0; g_decodeCapsKnown && i < IJK_DECODE_CAPS_CODECS; i++) {
+                for (int j = 0; j < g_decodeCaps[i].refusedCount; j++)
+                    IJKDecodeCapabilityAddRefusal(&caps[i], &g_decodeCaps[i].refused[j]);
+            }
+            memcpy(g_decodeCaps, caps, sizeof(caps));
+            g_decodeCapsKnown = YES;
+            pthread_mutex_unlock(&g_decodeCapsMutex);
+
+            if (!loaded)
+                IJKDecodeCapsSave();
+        });
+    });
+}
+
++ (BOOL)getDecodeCapability:(IJKDecodeCapability *)capability forCodecType:(FourCharCode)codecType
+{
+    int index = IJKDecodeCapsIndex(codecType);
+    if (index < 0)
+        return NO;
+
+    pthread_mutex_lock(&g_decodeCapsMutex);
+    BOOL known = g_decodeCapsKnown;
+    if (known)
+        *capability = g_decodeCaps[index];
+    pthread_mutex_unlock(&g_decodeCapsMutex);
+    return known;
+}
+
++ (void)addDecodeRefusal:(IJKDecodeFormat)format forCodecType:(FourCharCode)codecType
+{
+    int index = IJKDecodeCapsIndex(codecType);
+    if (index < 0)
+        return;
+
+    pthread_mutex_lock(&g_decodeCapsMutex);
+    BOOL added = g_decodeCapsKnown && IJKDecodeCapabilityAddRefusal(&g_decodeCaps[index], &format);
+    pthread_mutex_unlock(&g_decodeCapsMutex);
+
+    if (added) {
+        NSLog(@"IJKDeviceModel: VideoToolbox refused %dx%d level %d%s\n",
+              format.width, format.height, format.level, format.tenBit ? " 10 bit" : "");
+        dispatch_async(IJKDecodeCapsQueue(), ^{
+            IJKDecodeCapsSave();
+        });
+    }
+}
+
++ (BOOL)isDecodeFormat:(IJKDecodeFormat)format supportedBy:(const IJKDecodeCapability *)capability
+{
+    if (!capability->hardware)
+        return NO;
+    if (format.tenBit && !capability->tenBit)
+        return NO;
+
+    for (int i = 0; i < capability->refusedCount; i++) {
+        if (IJKDecodeFormatCovers(&format, &capability->refused[i]))
+            return NO;
+    }
+    return YES;
+}
+
 @end
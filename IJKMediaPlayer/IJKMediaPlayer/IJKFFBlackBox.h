@@ -0,0 +1,41 @@
+/*
+ * IJKFFBlackBox.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+// Black box of the playback telemetry: buffer levels, decode and present
+// rates, main thread stalls, memory and network events of every player, the
+// last minute of them kept in a file mapped from Library/Caches, so they
+// outlive a kill of the process. Always on once started; a record costs an
+// atomic increment and 64 bytes written.
+@interface IJKFFBlackBox : NSObject
+
+// once, by the first player
++ (void)start;
+
+// What the launch before recorded over its last minute, one line a record,
+// oldest first, if it was killed with a player open: by the watchdog,
+// jetsam or a crash. nil otherwise, or before +start
++ (NSArray<NSString *> *)previousSessionReport;
+
+@end
@@ -0,0 +1,130 @@
+/*
+ * IJKFFBlackBox.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#import "IJKFFBlackBox.h"
+#include <mach/mach.h>
+#include <os/proc.h>
+#include <stdatomic.h>
+#include "ijksdl/ios/ijksdl_blackbox_ios.h"
+
+#define IJK_BLACKBOX_TICK_MS        500
+// the main thread answering later than this is a stall
+#define IJK_BLACKBOX_STALL_MS       250
+// ticks between memory records
+#define IJK_BLACKBOX_MEMORY_TICKS   2
+
+static NSArray<NSString *> *g_previousReport;
+static dispatch_source_t    g_timer;
+static _Atomic(int64_t)     g_pingSent;     // ms, 0 once the main thread answered
+
+static int64_t IJKBlackBoxNow(void)
+{
+    return (int64_t)([[NSDate date] timeIntervalSince1970] * 1000);
+}
+
+static void IJKBlackBoxWriteMemory(void)
+{
+    task_vm_info_data_t    info  = {0};
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    int64_t values[2] = { -1, -1 };
+
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+        values[0] = info.phys_footprint;
+    if (@available(iOS 13.0, *))
+        values[1] = os_proc_available_memory();
+    ijk_blackbox_write(IJK_BB_MEMORY, 0, values, 2);
+}
+
+// A ping to the main queue each tick; one still unanswered at the next is
+// recorded as late, again each tick while the stall lasts, so a watchdog
+// kill leaves how long the main thread had hung.
+static void IJKBlackBoxTick(void)
+{
+    static unsigned ticks;
+    int64_t now  = IJKBlackBoxNow();
+    int64_t sent = atomic_load(&g_pingSent);
+
+    if (++ticks % IJK_BLACKBOX_MEMORY_TICKS == 0)
+        IJKBlackBoxWriteMemory();
+
+    if (sent) {
+        if (now - sent >= IJK_BLACKBOX_STALL_MS) {
+            int64_t late = now - sent;
+            ijk_blackbox_write(IJK_BB_THREAD_STALL, 0, &late, 1);
+        }
+        return;
+    }
+
+    atomic_store(&g_pingSent, now);
+    dispatch_async(dispatch_get_main_queue(), ^{
+        int64_t late = IJKBlackBoxNow() - atomic_exchange(&g_pingSent, 0);
+        if (late >= IJK_BLACKBOX_STALL_MS)
+            ijk_blackbox_write(IJK_BB_THREAD_STALL, 0, &late, 1);
+    });
+}
+
+@implementation IJKFFBlackBox
+
++ (void)start
+{
+    static dispatch_once_t sOnceToken = 0;
+    dispatch_once(&sOnceToken, ^{
+        NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+        NSString *path   = [caches stringByAppendingPathComponent:@"ijkblackbox"];
+        IJKBlackBoxRecord *previous = NULL;
+        int nbPrevious = 0;
+
+        int ret = ijk_blackbox_open(path.fileSystemRepresentation, &previous, &nbPrevious);
+        if (ret < 0) {
+            NSLog(@"IJKFFBlackBox: %@ not mapped: %d\n", path, ret);
+            return;
+        }
+        if (previous) {
+            NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:nbPrevious];
+            char line[512];
+            for (int i = 0; i < nbPrevious; i++) {
+                ijk_blackbox_format(&previous[i], line, sizeof(line));
+                [lines addObject:@(line)];
+            }
+            free(previous);
+            g_previousReport = lines;
+            NSLog(@"IJKFFBlackBox: the last launch was killed while playing, %d records\n", nbPrevious);
+        }
+
+        dispatch_queue_t queue = dispatch_queue_create("tv.danmaku.ijk.blackbox", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+        g_timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(g_timer, DISPATCH_TIME_NOW, IJK_BLACKBOX_TICK_MS * NSEC_PER_MSEC,
+                                  IJK_BLACKBOX_TICK_MS / 10 * NSEC_PER_MSEC);
+        dispatch_source_set_event_handler(g_timer, ^{
+            IJKBlackBoxTick();
+        });
+        dispatch_resume(g_timer);
+    });
+}
+
++ (NSArray<NSString *> *)previousSessionReport
+{
+    return g_previousReport;
+}
+
+@end
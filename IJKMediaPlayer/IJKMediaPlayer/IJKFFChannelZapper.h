@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import "IJKFFOptions.h"
+
+@class IJKFFMoviePlayerController;
+
+// Switches between live channels without the connect and probe of a new
+// player. The channels next to the current one are kept connected: an
+// HTTP-FLV channel is read on by a standby connection, which holds the
+// stream header, the codec configuration and the tags since the latest key
+// frame, nothing older. A zap plays what the standby holds through an
+// IJKMediaDataSource: the key frame is shown as soon as it is decoded, and
+// playback goes on live with the tags the same connection reads after it.
+// The player starts up to a GOP behind live; "liveMaxLatency" and
+// "liveMaxCatchUpRate" of the options bring it back.
+//
+// Other channels, e.g. HLS, are warmed with IJKMediaPreloader (dns, http
+// pool) and opened as usual on zap. So is an FLV channel whose standby
+// failed.
+@interface IJKFFChannelZapper : NSObject
+
+- (instancetype)initWithChannelURLStrings:(NSArray<NSString *> *)urlStrings
+                              withOptions:(IJKFFOptions *)options;
+
+// the player of the current channel is added to it, filling it
+@property(nonatomic, readonly) UIView *view;
+// a new player at every zap, nil before the first one
+@property(nonatomic, readonly) IJKFFMoviePlayerController *player;
+@property(nonatomic, readonly) NSInteger currentChannel;    // -1 before the first zap
+
+// channels kept on standby on each side of the current one, wrapping around;
+// default 1, 0 for none
+@property(nonatomic) NSInteger standbyRange;
+// of a standby connection: a longer GOP is not held, the zap then waits for
+// the next key frame; once zapped to, the bytes the player has yet to read.
+// Default 8 MB, applies to the standbys started after it is set
+@property(nonatomic) int64_t standbyMaxBytes;
+
+// prepares and plays the new channel at once, shuts the former player down;
+// its view stays under the new one until the first frame of the new one
+- (void)zapToChannel:(NSInteger)channel;
+- (void)zapUp;
+- (void)zapDown;
+
+- (void)shutdown;
+
+@end
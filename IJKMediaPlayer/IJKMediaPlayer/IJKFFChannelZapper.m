@@ -0,0 +1,572 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFChannelZapper.h"
+#import "IJKFFMoviePlayerController.h"
+#import "IJKMediaDataSource.h"
+#import "IJKMediaPreloader.h"
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+#include "libavutil/intreadwrite.h"
+
+#define IJK_ZAP_DEFAULT_MAX_BYTES   (8 * 1024 * 1024)
+#define IJK_ZAP_MAX_TAG_SIZE        (16 * 1024 * 1024)
+// the bytes lent to the player at most per read
+#define IJK_ZAP_MAX_LEND            (256 * 1024)
+// the bytes read by the player are dropped past IJK_ZAP_TRIM_BEHIND, all
+// but the last IJK_ZAP_KEEP_BEHIND, which the probe may read again
+#define IJK_ZAP_TRIM_BEHIND         (1024 * 1024)
+#define IJK_ZAP_KEEP_BEHIND         (256 * 1024)
+// an audio only channel has no key frame, the standby holds its last second
+#define IJK_ZAP_AUDIO_ONLY_HOLD_MS  1000
+
+#define IJK_FLV_TAG_AUDIO           8
+#define IJK_FLV_TAG_VIDEO           9
+#define IJK_FLV_TAG_SCRIPT          18
+
+// An HTTP-FLV connection read tag by tag on a thread of its own. Until a
+// player attaches it holds the header, the last script and configuration
+// tags and the tags since the last key frame; once attached, the player
+// reads that, then every tag as it comes.
+@interface IJKFFChannelStandby : NSObject <IJKMediaDataSource>
+{
+@public
+    volatile int _abortRequest;
+}
+
+- (instancetype)initWithURLString:(NSString *)urlString
+                    formatOptions:(AVDictionary *)formatOptions
+                         maxBytes:(int64_t)maxBytes;
+
+- (void)start;
+- (void)cancel;
+// NO if the header is not read yet, or the connection failed
+- (BOOL)attachToLink:(IJKMediaDataSourceLink *)link;
+
+@property(nonatomic, readonly, getter=isFinished) BOOL finished;
+
+@end
+
+static int ijkzap_interrupt_cb(void *opaque)
+{
+    IJKFFChannelStandby *standby = (__bridge IJKFFChannelStandby *)opaque;
+    return standby->_abortRequest;
+}
+
+@implementation IJKFFChannelStandby {
+    NSString        *_urlString;
+    AVDictionary    *_formatOptions;
+    int64_t          _maxBytes;
+
+    NSCondition     *_cond;
+    int              _error;        // of the read thread once finished
+
+    NSData          *_header;       // with the first previous tag size
+    NSData          *_script;
+    NSData          *_videoConfig;
+    NSData          *_audioConfig;
+    NSMutableData   *_gop;          // nil until a key frame
+    uint32_t         _gopTimestamp;
+    BOOL             _hasVideo;
+
+    // attached: the bytes [_streamBase, _streamBase + _stream.length)
+    BOOL             _attached;
+    NSMutableData   *_stream;
+    int64_t          _streamBase;
+    int64_t          _readOffset;
+    __weak IJKMediaDataSourceLink *_link;
+}
+
+- (instancetype)initWithURLString:(NSString *)urlString
+                    formatOptions:(AVDictionary *)formatOptions
+                         maxBytes:(int64_t)maxBytes
+{
+    self = [super init];
+    if (self) {
+        _urlString = [urlString copy];
+        _maxBytes  = maxBytes;
+        _cond      = [[NSCondition alloc] init];
+        av_dict_copy(&_formatOptions, formatOptions, 0);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    av_dict_free(&_formatOptions);
+}
+
+- (void)start
+{
+    // the thread retains the standby until the connection is closed
+    NSThread *thread = [[NSThread alloc] initWithTarget:self selector:@selector(readLoop) object:nil];
+    thread.name = @"tv.danmaku.ijkplayer.zapper";
+    [thread start];
+}
+
+- (void)cancel
+{
+    [_cond lock];
+    _abortRequest = 1;
+    [_cond broadcast];
+    [_cond unlock];
+}
+
+- (BOOL)isFinished
+{
+    [_cond lock];
+    BOOL finished = _error != 0;
+    [_cond unlock];
+    return finished;
+}
+
+#pragma mark read thread
+
+static int ijkzap_read_fully(AVIOContext *pb, uint8_t *buf, int size)
+{
+    int ret = avio_read(pb, buf, size);
+    if (ret == size)
+        return 0;
+    if (ret >= 0 || ret == AVERROR_EOF)
+        return pb->error < 0 ? pb->error : AVERROR_EOF;
+    return ret;
+}
+
+- (void)readLoop
+{
+    AVIOInterruptCB int_cb  = { ijkzap_interrupt_cb, (__bridge void *)self };
+    AVIOContext    *pb      = NULL;
+    AVDictionary   *options = NULL;
+    uint8_t         head[11];
+    int             ret;
+
+    av_dict_copy(&options, _formatOptions, 0);
+    ret = avio_open2(&pb, _urlString.UTF8String, AVIO_FLAG_READ, &int_cb, &options);
+    av_dict_free(&options);
+
+    if (ret >= 0)
+        ret = [self readHeader:pb];
+    while (ret >= 0 && !_abortRequest) {
+        @autoreleasepool {
+            uint32_t       size;
+            NSMutableData *tag;
+
+            ret = ijkzap_read_fully(pb, head, sizeof(head));
+            if (ret < 0)
+                break;
+            size = AV_RB24(head + 1);
+            if (size > IJK_ZAP_MAX_TAG_SIZE) {
+                ret = AVERROR_INVALIDDATA;
+                break;
+            }
+            // the tag with the previous tag size after it
+            tag = [NSMutableData dataWithLength:sizeof(head) + size + 4];
+            memcpy(tag.mutableBytes, head, sizeof(head));
+            ret = ijkzap_read_fully(pb, (uint8_t *)tag.mutableBytes + sizeof(head), size + 4);
+            if (ret < 0)
+                break;
+            [self takeTag:tag];
+        }
+    }
+    avio_closep(&pb);
+
+    IJKMediaDataSourceLink *link;
+    [_cond lock];
+    _error = _abortRequest ? AVERROR_EXIT : (ret < 0 ? ret : AVERROR_EOF);
+    link = _attached ? _link : nil;
+    [_cond unlock];
+    // the player reads to the end, then gets the error
+    [link dataAvailable];
+}
+
+- (int)readHeader:(AVIOContext *)pb
+{
+    uint8_t  buf[9];
+    uint32_t offset;
+    int      ret;
+
+    ret = ijkzap_read_fully(pb, buf, sizeof(buf));
+    if (ret < 0)
+        return ret;
+    offset = AV_RB32(buf + 5);
+    if (memcmp(buf, "FLV", 3) || offset < sizeof(buf) || offset > 1024)
+        return AVERROR_INVALIDDATA;
+
+    NSMutableData *header = [NSMutableData dataWithLength:offset + 4];
+    memcpy(header.mutableBytes, buf, sizeof(buf));
+    ret = ijkzap_read_fully(pb, (uint8_t *)header.mutableBytes + sizeof(buf), offset + 4 - sizeof(buf));
+    if (ret < 0)
+        return ret;
+
+    [_cond lock];
+    _header   = header;
+    _hasVideo = (buf[4] & 0x01) != 0;
+    [_cond unlock];
+    return 0;
+}
+
+- (void)takeTag:(NSData *)tag
+{
+    const uint8_t *p    = tag.bytes;
+    int            type = p[0] & 0x1f;
+    uint32_t       size = AV_RB24(p + 1);
+    uint32_t       ts   = AV_RB24(p + 4) | ((uint32_t)p[7] << 24);
+    const uint8_t *data = p + 11;
+
+    [_cond lock];
+    if (_attached) {
+        IJKMediaDataSourceLink *link;
+
+        // no further ahead of the player than the socket buffers would be
+        while (!_abortRequest && _streamBase + (int64_t)_stream.length - _readOffset > _maxBytes)
+            [_cond waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+        [_stream appendData:tag];
+        link = _link;
+        [_cond unlock];
+        [link dataAvailable];
+        return;
+    }
+
+    switch (type) {
+    case IJK_FLV_TAG_SCRIPT:
+        _script = tag;
+        [_cond unlock];
+        return;
+    case IJK_FLV_TAG_VIDEO:
+        // AVC or HEVC sequence header
+        if (size >= 2 && ((data[0] & 0x0f) == 7 || (data[0] & 0x0f) == 12) && data[1] == 0) {
+            _videoConfig = tag;
+            [_cond unlock];
+            return;
+        }
+        if (size >= 1 && (data[0] >> 4) == 1)
+            _gop = [NSMutableData data];
+        break;
+    case IJK_FLV_TAG_AUDIO:
+        // AAC sequence header
+        if (size >= 2 && (data[0] >> 4) == 10 && data[1] == 0) {
+            _audioConfig = tag;
+            [_cond unlock];
+            return;
+        }
+        if (!_hasVideo && (!_gop || ts - _gopTimestamp > IJK_ZAP_AUDIO_ONLY_HOLD_MS)) {
+            _gop          = [NSMutableData data];
+            _gopTimestamp = ts;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (_gop) {
+        if (_gop.length + tag.length > _maxBytes)
+            _gop = nil;
+        else
+            [_gop appendData:tag];
+    }
+    [_cond unlock];
+}
+
+#pragma mark zap
+
+- (BOOL)attachToLink:(IJKMediaDataSourceLink *)link
+{
+    [_cond lock];
+    if (!_header || _error != 0 || _attached) {
+        [_cond unlock];
+        return NO;
+    }
+
+    _stream = [NSMutableData dataWithData:_header];
+    if (_script)
+        [_stream appendData:_script];
+    if (_videoConfig)
+        [_stream appendData:_videoConfig];
+    if (_audioConfig)
+        [_stream appendData:_audioConfig];
+    if (_gop)
+        [_stream appendData:_gop];
+    _gop        = nil;
+    _streamBase = 0;
+    _readOffset = 0;
+    _link       = link;
+    _attached   = YES;
+    [_cond unlock];
+    return YES;
+}
+
+- (NSData *)dataAtOffset:(int64_t)offset error:(NSError **)error
+{
+    NSData *data = nil;
+
+    [_cond lock];
+    if (offset < _streamBase) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ESPIPE userInfo:nil];
+    } else if (offset < _streamBase + (int64_t)_stream.length) {
+        NSUInteger from   = (NSUInteger)(offset - _streamBase);
+        NSUInteger length = MIN(_stream.length - from, (NSUInteger)IJK_ZAP_MAX_LEND);
+
+        // a copy, the stream is appended to and trimmed meanwhile
+        data = [_stream subdataWithRange:NSMakeRange(from, length)];
+        _readOffset = MAX(_readOffset, offset + (int64_t)length);
+        if (_readOffset - _streamBase > IJK_ZAP_TRIM_BEHIND) {
+            NSUInteger drop = (NSUInteger)(_readOffset - _streamBase - IJK_ZAP_KEEP_BEHIND);
+            [_stream replaceBytesInRange:NSMakeRange(0, drop) withBytes:NULL length:0];
+            _streamBase += drop;
+        }
+        [_cond broadcast];
+    } else if (_error == AVERROR_EOF) {
+        data = [NSData data];
+    } else if (_error != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+    }
+    [_cond unlock];
+    return data;
+}
+
+@end
+
+@implementation IJKFFChannelZapper {
+    NSArray<NSString *> *_channels;
+    IJKFFOptions        *_options;
+    AVDictionary        *_formatOptions;
+    UIView              *_zapView;
+
+    IJKFFChannelStandby *_currentStandby;   // the player reads from it
+    UIView              *_leavingView;      // of the former player, until the first frame
+
+    NSMutableDictionary<NSNumber *, IJKFFChannelStandby *> *_standbys;
+    NSMutableSet<NSNumber *> *_preloading;
+    IJKMediaPreloader   *_preloader;
+}
+
+- (instancetype)initWithChannelURLStrings:(NSArray<NSString *> *)urlStrings
+                              withOptions:(IJKFFOptions *)options
+{
+    if (urlStrings.count == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+
+        _channels        = [urlStrings copy];
+        _options         = options;
+        _currentChannel  = -1;
+        _standbyRange    = 1;
+        _standbyMaxBytes = IJK_ZAP_DEFAULT_MAX_BYTES;
+        _standbys        = [[NSMutableDictionary alloc] init];
+        _preloading      = [[NSMutableSet alloc] init];
+        _preloader       = [[IJKMediaPreloader alloc] initWithOptions:options];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        _zapView = [[UIView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+        _zapView.backgroundColor = [UIColor blackColor];
+        _zapView.clipsToBounds   = YES;
+
+        ijkmp_global_init();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    for (IJKFFChannelStandby *standby in _standbys.allValues)
+        [standby cancel];
+    [_currentStandby cancel];
+    av_dict_free(&_formatOptions);
+}
+
+- (UIView *)view
+{
+    return _zapView;
+}
+
+- (void)setStandbyRange:(NSInteger)standbyRange
+{
+    _standbyRange = MAX(standbyRange, 0);
+    if (_currentChannel >= 0)
+        [self refreshStandbys];
+}
+
+#pragma mark zap
+
+- (void)zapUp
+{
+    NSInteger count = (NSInteger)_channels.count;
+    [self zapToChannel:(_currentChannel + 1) % count];
+}
+
+- (void)zapDown
+{
+    NSInteger count = (NSInteger)_channels.count;
+    [self zapToChannel:(_currentChannel - 1 + count) % count];
+}
+
+- (void)zapToChannel:(NSInteger)channel
+{
+    if (channel < 0 || channel >= (NSInteger)_channels.count || channel == _currentChannel)
+        return;
+
+    IJKFFMoviePlayerController *player = nil;
+    IJKFFChannelStandby        *standby = _standbys[@(channel)];
+    NSString                   *urlString = _channels[channel];
+
+    if (standby) {
+        [_standbys removeObjectForKey:@(channel)];
+
+        // the link retains the standby for as long as the player reads it
+        IJKMediaDataSourceLink *link = [[IJKMediaDataSourceLink alloc] initWithDataSource:standby];
+        if (link && [standby attachToLink:link])
+            player = [[IJKFFMoviePlayerController alloc] initWithMediaDataSource:link withOptions:_options];
+        if (!player) {
+            [standby cancel];
+            standby = nil;
+        }
+    }
+    if (!player) {
+        [_preloader cancelPreloadForURL:[NSURL URLWithString:urlString]];
+        [_preloading removeObject:@(channel)];
+        player = [[IJKFFMoviePlayerController alloc] initWithContentURLString:urlString withOptions:_options];
+        if (!player)
+            return;
+    }
+
+    [self leaveCurrentChannel];
+
+    _player         = player;
+    _currentStandby = standby;
+    _currentChannel = channel;
+
+    player.shouldAutoplay        = YES;
+    player.scalingMode           = IJKMPMovieScalingModeAspectFit;
+    player.view.frame            = _zapView.bounds;
+    player.view.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    [_zapView addSubview:player.view];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(playerFirstVideoFrameRendered:)
+                                                 name:IJKMPMoviePlayerFirstVideoFrameRenderedNotification
+                                               object:player];
+    [player prepareToPlay];
+
+    [self refreshStandbys];
+}
+
+- (void)leaveCurrentChannel
+{
+    if (!_player)
+        return;
+
+    [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                    name:IJKMPMoviePlayerFirstVideoFrameRenderedNotification
+                                                  object:_player];
+    [_leavingView removeFromSuperview];
+    _leavingView = _player.view;
+    [_player shutdown];
+    [_currentStandby cancel];
+    _currentStandby = nil;
+    _player         = nil;
+}
+
+- (void)playerFirstVideoFrameRendered:(NSNotification *)notification
+{
+    if (notification.object != _player)
+        return;
+
+    [_leavingView removeFromSuperview];
+    _leavingView = nil;
+}
+
+#pragma mark standby
+
+- (BOOL)canStandbyChannel:(NSInteger)channel
+{
+    NSURL *url = [NSURL URLWithString:_channels[channel]];
+
+    if (![url.scheme isEqualToString:@"http"] && ![url.scheme isEqualToString:@"https"])
+        return NO;
+    return [url.path.pathExtension caseInsensitiveCompare:@"flv"] == NSOrderedSame;
+}
+
+- (void)refreshStandbys
+{
+    NSInteger      count  = (NSInteger)_channels.count;
+    NSMutableSet  *wanted = [NSMutableSet set];
+
+    for (NSInteger i = 1; i <= _standbyRange && i < count; ++i) {
+        [wanted addObject:@((_currentChannel + i) % count)];
+        [wanted addObject:@(((_currentChannel - i) % count + count) % count)];
+    }
+    [wanted removeObject:@(_currentChannel)];
+
+    for (NSNumber *channel in _standbys.allKeys) {
+        IJKFFChannelStandby *standby = _standbys[channel];
+        if (![wanted containsObject:channel] || standby.finished) {
+            [standby cancel];
+            [_standbys removeObjectForKey:channel];
+        }
+    }
+    for (NSNumber *channel in _preloading.allObjects) {
+        if (![wanted containsObject:channel]) {
+            [_preloader cancelPreloadForURL:[NSURL URLWithString:_channels[channel.integerValue]]];
+            [_preloading removeObject:channel];
+        }
+    }
+
+    for (NSNumber *channel in wanted) {
+        NSInteger index = channel.integerValue;
+
+        if ([self canStandbyChannel:index]) {
+            if (_standbys[channel])
+                continue;
+            IJKFFChannelStandby *standby = [[IJKFFChannelStandby alloc] initWithURLString:_channels[index]
+                                                                            formatOptions:_formatOptions
+                                                                                 maxBytes:_standbyMaxBytes];
+            _standbys[channel] = standby;
+            [standby start];
+        } else if (![_preloading containsObject:channel]) {
+            [_preloader preloadURL:[NSURL URLWithString:_channels[index]] duration:1 maxBytes:0];
+            [_preloading addObject:channel];
+        }
+    }
+}
+
+#pragma mark shutdown
+
+- (void)shutdown
+{
+    [self leaveCurrentChannel];
+    [_leavingView removeFromSuperview];
+    _leavingView    = nil;
+    _currentChannel = -1;
+
+    for (IJKFFChannelStandby *standby in _standbys.allValues)
+        [standby cancel];
+    [_standbys removeAllObjects];
+    [_preloading removeAllObjects];
+    [_preloader cancelAll];
+}
+
+@end
@@ -0,0 +1,78 @@
+/*
+ * IJKFFDecoderBenchmark.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+@class IJKFFOptions;
+
+typedef NS_ENUM(NSInteger, IJKFFDecoderBenchmarkMode) {
+    IJKFFDecoderBenchmarkModeVideoToolboxAsync,
+    IJKFFDecoderBenchmarkModeVideoToolboxSync,
+    IJKFFDecoderBenchmarkModeSoftware,
+};
+
+// when the packets of a capture (av_packet_capture_open()) reach the
+// decoder, see the "pace" option of the pktcap demuxer
+typedef NS_ENUM(NSInteger, IJKFFDecoderBenchmarkPace) {
+    IJKFFDecoderBenchmarkPaceNone,              // as fast as the decoder goes
+    IJKFFDecoderBenchmarkPaceTimestamps,        // in real time by their timestamps
+    IJKFFDecoderBenchmarkPaceCapture,           // as they were read when captured
+};
+
+typedef struct IJKFFDecoderBenchmarkResult {
+    BOOL            completed;                  // decoded to the end of the file
+    BOOL            videoToolbox;               // VideoToolbox did open, the fallback did not
+    int             error;                      // of FFP_MSG_ERROR, 0 without
+
+    int64_t         frames;
+    NSTimeInterval  seconds;                    // first packet to the last frame
+    double          framesPerSecond;
+
+    int64_t         latencyP50;                 // microseconds a frame takes in the decoder
+    int64_t         latencyP95;
+    int64_t         latencyP99;
+
+    double          sessionCreateMilliseconds;  // VideoToolbox sessions, summed
+    int             sessionCount;
+} IJKFFDecoderBenchmarkResult;
+
+// Decodes the video of a file as fast as the decoder goes, through the
+// pipeline the players use but with no view and no audio: the frames are
+// counted and released as they come out. For decoder comparisons on
+// devices, from a test host app.
+@interface IJKFFDecoderBenchmark : NSObject
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl mode:(IJKFFDecoderBenchmarkMode)mode;
+
+// applied before the benchmark options, nil for none
+@property(nonatomic, strong) IJKFFOptions *options;
+
+// for captures, IJKFFDecoderBenchmarkPaceNone by default; paced, frames
+// and latency tell how the decoder kept up rather than its speed
+@property(nonatomic) IJKFFDecoderBenchmarkPace pace;
+
+// blocks the calling thread, not the main one, until the end of the file,
+// an error or timeout; the result tells which
+- (IJKFFDecoderBenchmarkResult)runWithTimeout:(NSTimeInterval)timeout;
+
+@end
@@ -0,0 +1,186 @@
+/*
+ * IJKFFDecoderBenchmark.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFDecoderBenchmark.h"
+#import "IJKFFOptions.h"
+#include "ijkplayer/ios/ijkplayer_ios.h"
+
+// how often a run looks for the end of the decoding
+#define IJK_DECODER_BENCHMARK_POLL 0.05
+
+@implementation IJKFFDecoderBenchmark {
+    NSString                   *_urlString;
+    IJKFFDecoderBenchmarkMode   _mode;
+
+    // written by the message thread
+    dispatch_semaphore_t        _event;
+    volatile int                _error;
+    volatile BOOL               _videoToolbox;
+    volatile BOOL               _completed;
+}
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl mode:(IJKFFDecoderBenchmarkMode)mode
+{
+    if (aUrl == nil)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _urlString = [aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString];
+        _mode      = mode;
+        _event     = dispatch_semaphore_create(0);
+
+        ijkmp_global_init();
+    }
+    return self;
+}
+
+static int decoder_benchmark_msg_loop(void *arg)
+{
+    @autoreleasepool {
+        IjkMediaPlayer *mp = (IjkMediaPlayer *)arg;
+        IJKFFDecoderBenchmark *benchmark = (__bridge_transfer IJKFFDecoderBenchmark *)ijkmp_set_weak_thiz(mp, NULL);
+
+        while (benchmark) {
+            AVMessage msg;
+            int retval = ijkmp_get_msg(mp, &msg, 1);
+            if (retval < 0)
+                break;
+
+            switch (msg.what) {
+                case FFP_MSG_ERROR:
+                    benchmark->_error = msg.arg1 ? msg.arg1 : -1;
+                    dispatch_semaphore_signal(benchmark->_event);
+                    break;
+                case FFP_MSG_COMPLETED:
+                    benchmark->_completed = YES;
+                    dispatch_semaphore_signal(benchmark->_event);
+                    break;
+                case FFP_MSG_VIDEO_DECODER_OPEN:
+                    benchmark->_videoToolbox = msg.arg1;
+                    break;
+                default:
+                    break;
+            }
+            msg_free_res(&msg);
+        }
+
+        // retained in prepare_async, before SDL_CreateThreadEx
+        ijkmp_dec_ref_p(&mp);
+        return 0;
+    }
+}
+
+- (void)applyModeTo:(IjkMediaPlayer *)mp
+{
+    ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "decoder-benchmark", 1);
+    ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "an", 1);
+    ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "framedrop", 0);
+    ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "start-on-prepared", 1);
+
+    switch (_pace) {
+        case IJKFFDecoderBenchmarkPaceNone:
+            break;
+        case IJKFFDecoderBenchmarkPaceTimestamps:
+            ijkmp_set_option(mp, IJKMP_OPT_CATEGORY_FORMAT, "pace", "dts");
+            break;
+        case IJKFFDecoderBenchmarkPaceCapture:
+            ijkmp_set_option(mp, IJKMP_OPT_CATEGORY_FORMAT, "pace", "capture");
+            break;
+    }
+
+    switch (_mode) {
+        case IJKFFDecoderBenchmarkModeVideoToolboxAsync:
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox", 1);
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox-mode", 2);
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox-max-frame-width", 4096);
+            break;
+        case IJKFFDecoderBenchmarkModeVideoToolboxSync:
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox", 1);
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox-mode", 1);
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox-max-frame-width", 4096);
+            break;
+        case IJKFFDecoderBenchmarkModeSoftware:
+            ijkmp_set_option_int(mp, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox", 0);
+            break;
+    }
+}
+
+- (IJKFFDecoderBenchmarkResult)runWithTimeout:(NSTimeInterval)timeout
+{
+    IJKFFDecoderBenchmarkResult result = {0};
+
+    _error        = 0;
+    _videoToolbox = NO;
+    _completed    = NO;
+
+    // no view is set: the frames never reach the vout
+    IjkMediaPlayer *mp = ijkmp_ios_create(decoder_benchmark_msg_loop);
+    if (!mp) {
+        result.error = -1;
+        return result;
+    }
+    ijkmp_set_weak_thiz(mp, (__bridge_retained void *)self);
+
+    [_options applyTo:mp];
+    [self applyModeTo:mp];
+
+    FFDecoderBenchmarkResult stats = {0};
+    if (ijkmp_set_data_source(mp, [_urlString UTF8String]) == 0 && ijkmp_prepare_async(mp) == 0) {
+        // the core completes once the frame queue is empty, which the
+        // benchmark leaves to the decoder: the end of the decoding is polled
+        NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:timeout];
+        while (!_error && !_completed) {
+            dispatch_semaphore_wait(_event, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(IJK_DECODER_BENCHMARK_POLL * NSEC_PER_SEC)));
+            if (ijkmp_ios_get_decoder_benchmark_result(mp, &stats) == 0 && stats.finished)
+                break;
+            if ([deadline timeIntervalSinceNow] <= 0)
+                break;
+        }
+        ijkmp_ios_get_decoder_benchmark_result(mp, &stats);
+    } else {
+        _error = -1;
+    }
+
+    ijkmp_stop(mp);
+    ijkmp_shutdown(mp);
+    // the message loop has not started when preparing failed
+    __unused id weakSelf = (__bridge_transfer IJKFFDecoderBenchmark *)ijkmp_set_weak_thiz(mp, NULL);
+    ijkmp_dec_ref_p(&mp);
+
+    result.completed    = stats.finished || _completed;
+    result.videoToolbox = _videoToolbox;
+    result.error        = _error;
+    result.frames       = stats.frames;
+    result.seconds      = stats.elapsed_us / 1000000.0;
+    if (stats.elapsed_us > 0)
+        result.framesPerSecond = stats.frames * 1000000.0 / stats.elapsed_us;
+    result.latencyP50   = stats.latency_p50_us;
+    result.latencyP95   = stats.latency_p95_us;
+    result.latencyP99   = stats.latency_p99_us;
+    result.sessionCreateMilliseconds = stats.session_create_us / 1000.0;
+    result.sessionCount = stats.session_count;
+    return result;
+}
+
+@end
@@ -0,0 +1,42 @@
+/*
+ * IJKFFMediaMeta.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#import <Foundation/Foundation.h>
+#import "IJKFFMonitor.h"
+#include "ijkplayer/ijkmeta.h"
+
+// The meta of the core as the dictionary the controller always gave, with
+// the same keys. The C strings are copied in one block per dictionary while
+// the meta is locked, and a value only becomes an NSString once looked up.
+@interface IJKFFMediaMeta : NSDictionary
+
+// rawMeta locked by the caller; info gets the fields the monitor reads,
+// without going through any NSString
++ (instancetype)metaWithRawMeta:(IjkMediaMeta *)rawMeta info:(IJKFFMediaMetaInfo *)info;
+
+// the entries of kk_IJKM_KEY_STREAMS played, nil if none
+@property(nonatomic, readonly) IJKFFMediaMeta *videoStreamMeta;
+@property(nonatomic, readonly) IJKFFMediaMeta *audioStreamMeta;
+
+@end
@@ -0,0 +1,217 @@
+/*
+ * IJKFFMediaMeta.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#import "IJKFFMediaMeta.h"
+#import "IJKFFMoviePlayerController.h"
+
+#define IJK_META_MAX_FIELDS 16
+
+static const char *g_format_keys[] = {
+    IJKM_KEY_FORMAT, IJKM_KEY_DURATION_US, IJKM_KEY_START_US, IJKM_KEY_BITRATE,
+    IJKM_KEY_VIDEO_STREAM, IJKM_KEY_AUDIO_STREAM, NULL,
+};
+static const char *g_stream_keys[] = {
+    IJKM_KEY_CODEC_NAME, IJKM_KEY_CODEC_PROFILE, IJKM_KEY_CODEC_LONG_NAME, IJKM_KEY_BITRATE, NULL,
+};
+static const char *g_video_keys[] = {
+    IJKM_KEY_WIDTH, IJKM_KEY_HEIGHT, IJKM_KEY_FPS_NUM, IJKM_KEY_FPS_DEN,
+    IJKM_KEY_TBR_NUM, IJKM_KEY_TBR_DEN, IJKM_KEY_SAR_NUM, IJKM_KEY_SAR_DEN, NULL,
+};
+static const char *g_audio_keys[] = {
+    IJKM_KEY_SAMPLE_RATE, IJKM_KEY_CHANNEL_LAYOUT, NULL,
+};
+
+@implementation IJKFFMediaMeta
+{
+    char       *_arena;
+    int         _count;
+    const char *_keys[IJK_META_MAX_FIELDS];     // static strings
+    const char *_values[IJK_META_MAX_FIELDS];   // in _arena, or static
+    NSString   *_strings[IJK_META_MAX_FIELDS];  // converted so far
+    NSArray    *_streams;
+}
+
+// the values still point into the raw meta until -copyValues, called once
+- (void)collect:(const char **)keys from:(IjkMediaMeta *)rawMeta
+{
+    for (; *keys && _count < IJK_META_MAX_FIELDS; ++keys) {
+        const char *value = ijkmeta_get_string_l(rawMeta, *keys);
+        if (!value)
+            continue;
+        _keys[_count]   = *keys;
+        _values[_count] = value;
+        ++_count;
+    }
+}
+
+- (void)copyValues
+{
+    size_t size = 0;
+    for (int i = 0; i < _count; ++i)
+        size += strlen(_values[i]) + 1;
+    if (size == 0)
+        return;
+
+    _arena = malloc(size);
+    if (!_arena) {
+        _count = 0;
+        return;
+    }
+
+    char *p = _arena;
+    for (int i = 0; i < _count; ++i) {
+        size_t len = strlen(_values[i]) + 1;
+        memcpy(p, _values[i], len);
+        _values[i] = p;
+        p += len;
+    }
+}
+
++ (instancetype)streamWithRawMeta:(IjkMediaMeta *)rawMeta
+{
+    IJKFFMediaMeta *meta = [[IJKFFMediaMeta alloc] init];
+    if (!rawMeta)
+        return meta;
+
+    const char *type = ijkmeta_get_string_l(rawMeta, IJKM_KEY_TYPE);
+    if (!type) {
+        meta->_keys[0]   = IJKM_KEY_TYPE;
+        meta->_values[0] = IJKM_VAL_TYPE__UNKNOWN;
+        meta->_count     = 1;
+        return meta;
+    }
+
+    [meta collect:(const char *[]){IJKM_KEY_TYPE, NULL} from:rawMeta];
+    [meta collect:g_stream_keys from:rawMeta];
+    if (0 == strcmp(type, IJKM_VAL_TYPE__VIDEO))
+        [meta collect:g_video_keys from:rawMeta];
+    else if (0 == strcmp(type, IJKM_VAL_TYPE__AUDIO))
+        [meta collect:g_audio_keys from:rawMeta];
+    [meta copyValues];
+    return meta;
+}
+
++ (instancetype)metaWithRawMeta:(IjkMediaMeta *)rawMeta info:(IJKFFMediaMetaInfo *)info
+{
+    IJKFFMediaMeta *meta = [[IJKFFMediaMeta alloc] init];
+    memset(info, 0, sizeof(*info));
+    info->videoStream = -1;
+    info->audioStream = -1;
+    if (!rawMeta)
+        return meta;
+
+    [meta collect:g_format_keys from:rawMeta];
+    [meta copyValues];
+
+    info->duration    = ijkmeta_get_int64_l(rawMeta, IJKM_KEY_DURATION_US, 0) / 1000;
+    info->bitrate     = ijkmeta_get_int64_l(rawMeta, IJKM_KEY_BITRATE, 0);
+    info->videoStream = (int)ijkmeta_get_int64_l(rawMeta, IJKM_KEY_VIDEO_STREAM, -1);
+    info->audioStream = (int)ijkmeta_get_int64_l(rawMeta, IJKM_KEY_AUDIO_STREAM, -1);
+
+    size_t count = ijkmeta_get_children_count_l(rawMeta);
+    NSMutableArray *streams = [[NSMutableArray alloc] initWithCapacity:count];
+    for (size_t i = 0; i < count; ++i) {
+        IjkMediaMeta *streamRawMeta = ijkmeta_get_child_l(rawMeta, i);
+        IJKFFMediaMeta *stream = [IJKFFMediaMeta streamWithRawMeta:streamRawMeta];
+        [streams addObject:stream];
+        if (!streamRawMeta)
+            continue;
+
+        const char *type = ijkmeta_get_string_l(streamRawMeta, IJKM_KEY_TYPE);
+        if (!type)
+            continue;
+        const char *codec = ijkmeta_get_string_l(streamRawMeta, IJKM_KEY_CODEC_NAME);
+        if (info->videoStream == i && 0 == strcmp(type, IJKM_VAL_TYPE__VIDEO)) {
+            meta->_videoStreamMeta = stream;
+            info->width  = (int)ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_WIDTH, 0);
+            info->height = (int)ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_HEIGHT, 0);
+            info->fpsNum = (int)ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_FPS_NUM, 0);
+            info->fpsDen = (int)ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_FPS_DEN, 0);
+            if (codec)
+                strlcpy(info->vcodec, codec, sizeof(info->vcodec));
+        } else if (info->audioStream == i && 0 == strcmp(type, IJKM_VAL_TYPE__AUDIO)) {
+            meta->_audioStreamMeta = stream;
+            info->sampleRate    = (int)ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_SAMPLE_RATE, 0);
+            info->channelLayout = ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_CHANNEL_LAYOUT, 0);
+            if (codec)
+                strlcpy(info->acodec, codec, sizeof(info->acodec));
+        }
+    }
+    meta->_streams = streams;
+    return meta;
+}
+
+- (void)dealloc
+{
+    free(_arena);
+}
+
+- (NSString *)stringAtIndex:(int)i
+{
+    @synchronized (self) {
+        if (!_strings[i])
+            _strings[i] = [[NSString alloc] initWithUTF8String:_values[i]];
+        return _strings[i];
+    }
+}
+
+#pragma mark NSDictionary
+
+- (NSUInteger)count
+{
+    return _count + (_streams ? 1 : 0);
+}
+
+- (id)objectForKey:(id)aKey
+{
+    if (![aKey isKindOfClass:[NSString class]])
+        return nil;
+    if (_streams && [aKey isEqualToString:kk_IJKM_KEY_STREAMS])
+        return _streams;
+
+    const char *key = [aKey UTF8String];
+    for (int i = 0; i < _count; ++i) {
+        if (0 == strcmp(key, _keys[i]))
+            return [self stringAtIndex:i];
+    }
+    return nil;
+}
+
+- (NSEnumerator *)keyEnumerator
+{
+    NSMutableArray *keys = [[NSMutableArray alloc] initWithCapacity:[self count]];
+    for (int i = 0; i < _count; ++i)
+        [keys addObject:@(_keys[i])];
+    if (_streams)
+        [keys addObject:kk_IJKM_KEY_STREAMS];
+    return [keys objectEnumerator];
+}
+
+// immutable, the values converted so far stay shared
+- (id)copyWithZone:(NSZone *)zone
+{
+    return self;
+}
+
+@end
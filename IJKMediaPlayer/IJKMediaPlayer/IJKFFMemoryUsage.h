@@ -0,0 +1,45 @@
+/*
+ * IJKFFMemoryUsage.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+// What a player gives up, in order, to stay within its memoryBudget; each
+// level keeps those before it.
+typedef NS_ENUM(NSInteger, IJKFFMemoryShedLevel) {
+    IJKFFMemoryShedLevelNone,
+    IJKFFMemoryShedLevelRenderCaches,   // textures and buffers the view keeps for reuse
+    IJKFFMemoryShedLevelReadAhead,      // the async ring shrunk to 1 MiB
+    IJKFFMemoryShedLevelPacketQueues,   // max-buffer-size cut to a quarter of the packets queued
+    IJKFFMemoryShedLevelFrameQueue,     // one decoded frame waiting for display, VideoToolbox only
+};
+
+// Bytes held by each stage of a player; the sizes of decoded frames are
+// estimated from the video size, as 4:2:0 at 8 bits.
+typedef struct IJKFFMemoryUsage {
+    int64_t readAheadBytes;         // the async ring, 0 when it is backed by a file
+    int64_t packetQueueBytes;       // audio and video packets demuxed, not decoded yet
+    int64_t decoderBufferBytes;     // packets VideoToolbox keeps to restart from the last key frame
+    int64_t frameQueueBytes;        // decoded frames waiting for display
+    int64_t renderBytes;            // the frame the view holds on to
+    int64_t totalBytes;
+} IJKFFMemoryUsage;
@@ -21,6 +21,80 @@
 
 #import <Foundation/Foundation.h>
 
+// microseconds, 0 without frames
+typedef struct IJKFFLatencyPercentiles {
+    int64_t count;
+    int64_t p50;
+    int64_t p95;
+    int64_t p99;
+} IJKFFLatencyPercentiles;
+
+// time spent in the inject hook of an AVAPP message, microseconds
+typedef struct IJKFFInjectHookTime {
+    int64_t count;
+    int64_t blocking;       // on the io thread calling in, in total
+    int64_t maxBlocking;
+    int64_t deferred;       // handled afterwards on the inject queue, in total
+} IJKFFInjectHookTime;
+
+// the fields of the meta read the most, filled once prepared
+typedef struct IJKFFMediaMetaInfo {
+    int64_t duration;       // milliseconds
+    int64_t bitrate;        // bit / sec
+    int     videoStream;    // -1 if none
+    int     audioStream;    // -1 if none
+    int     width;
+    int     height;
+    int     fpsNum;
+    int     fpsDen;
+    int     sampleRate;
+    int64_t channelLayout;
+    char    vcodec[32];
+    char    acodec[32];
+} IJKFFMediaMetaInfo;
+
+// Energy of a session as modelled from what it did, millijoules: the CPU
+// time of its threads, the bytes it received by radio, the pixels it
+// decoded and put on screen. Not a measurement; the coefficients are those
+// of a typical device, so the figures are for telling one configuration
+// from another on the same device, not for adding up to the battery.
+typedef struct IJKFFEnergyEstimate {
+    double cpu;
+    double network;
+    double gpu;         // composition of the frames presented
+    double decoder;     // the VideoToolbox hardware; a software decoder is in cpu
+    double total;
+} IJKFFEnergyEstimate;
+
+// One HTTP request of the player: playlist, segment, key or progressive
+// read, a redirect being a request of its own. Times in microseconds, 0
+// for the phases it went without: dns, connect and tls on a reused
+// connection; over h2 and h3 connect is the whole stream setup.
+@interface IJKFFNetworkRequest : NSObject
+
+@property(nonatomic, copy) NSString *url;
+@property(nonatomic, copy) NSString *protocol;      // "http/1.1", "h2" or "h3"
+@property(nonatomic) int       httpCode;            // 0 without a response
+@property(nonatomic) int       error;               // AVERROR the request ended with, 0 if none
+@property(nonatomic) BOOL      complete;            // the body read to its end
+@property(nonatomic) BOOL      reused;              // on a connection open before
+@property(nonatomic) int64_t   offset;              // of the range asked for
+@property(nonatomic) int64_t   bytes;               // of the body read
+@property(nonatomic) NSDate   *startDate;
+@property(nonatomic) int64_t   dnsTime;
+@property(nonatomic) int64_t   connectTime;
+@property(nonatomic) int64_t   tlsTime;
+@property(nonatomic) int64_t   sendTime;            // of the request headers
+@property(nonatomic) int64_t   waitTime;            // request sent to the first byte of the response
+@property(nonatomic) int64_t   receiveTime;         // first byte to the last one read
+@property(nonatomic, readonly) int64_t timeToFirstByte;  // from the start, the phases before included
+@property(nonatomic, copy) NSString *cacheStatus;   // X-Cache or the like of the CDN, nil without
+@property(nonatomic) int64_t   age;                 // seconds of Age, -1 without
+@property(nonatomic, copy) NSString *edge;          // the CDN server answering, nil if unknown
+@property(nonatomic, readonly) BOOL cacheHit;       // cacheStatus tells a hit
+
+@end
+
 @interface IJKFFMonitor : NSObject
 
 - (instancetype)init;
@@ -28,6 +102,7 @@
 @property(nonatomic) NSDictionary *mediaMeta;
 @property(nonatomic) NSDictionary *videoMeta;
 @property(nonatomic) NSDictionary *audioMeta;
+@property(nonatomic) IJKFFMediaMetaInfo metaInfo;
 
 @property(nonatomic, readonly) int64_t   duration;   // milliseconds
 @property(nonatomic, readonly) int64_t   bitrate;    // bit / sec
@@ -40,9 +115,23 @@
 @property(nonatomic, readonly) int64_t   channelLayout;
 
 @property(nonatomic) NSString *vdecoder;
+@property(nonatomic) int64_t   pixelBufferAllocations;        // VideoToolbox output buffers allocated
+@property(nonatomic) int64_t   steadyPixelBufferAllocations;  // of those, once the first frames were out
+
+@property(nonatomic) int       audioOutputSampleRate;     // of the audio output opened, 0 before
+@property(nonatomic) int       audioHardwareSampleRate;   // of the AVAudioSession, 0 before
+@property(nonatomic, readonly) BOOL audioSampleRateMismatch;  // the system resamples the output
 
 @property(nonatomic) int       tcpError;
 @property(nonatomic) NSString *remoteIp;
+@property(nonatomic) int       tcpFamily;               // AF_INET or AF_INET6 of the connected address
+@property(nonatomic) int64_t   lastTcpConnectDuration;  // milliseconds
+
+@property(nonatomic) int64_t   dnsCacheHitCount;   // process wide, negative hits included
+@property(nonatomic) int64_t   dnsCacheMissCount;  // process wide
+@property(nonatomic) int64_t   lastDnsDuration;    // milliseconds
+
+@property(nonatomic, readonly) float packetPoolHitRate;  // process wide, packet payloads reused from the pools
 
 @property(nonatomic) int       httpError;
 @property(nonatomic) NSString *httpUrl;
@@ -52,13 +141,69 @@
 @property(nonatomic) int64_t   httpSeekTick;
 @property(nonatomic) int       httpOpenCount;
 @property(nonatomic) int       httpSeekCount;
+@property(nonatomic) int64_t   httpPoolOpenCount;   // process wide, new pooled connections
+@property(nonatomic) int64_t   httpPoolReuseCount;  // process wide, idle connections reused
+@property(nonatomic) int64_t   tlsHandshakeCount;   // process wide, client handshakes done
+@property(nonatomic) int64_t   tlsResumedCount;     // process wide, abbreviated handshakes
 @property(nonatomic) int64_t   lastHttpOpenDuration;
+@property(nonatomic) int64_t   http3RequestCount;          // through the HTTP/3 transport, once closed
+@property(nonatomic) int64_t   http3FallbackCount;         // of those, over another protocol than h3
+@property(nonatomic) int64_t   http3ReusedCount;           // of those, on a connection open before
+@property(nonatomic) int64_t   lastHttp3ConnectDuration;   // milliseconds, handshake included
+@property(nonatomic, copy) NSString *mirrorUrl;            // the last request to a mirror, see IJKFFOptions.mirrorURLs
+@property(nonatomic) int64_t   mirrorFailoverCount;        // requests moved to another mirror halfway
 @property(nonatomic) int64_t   lastHttpSeekDuration;
 
+// the HTTP requests of the media, see IJKFFNetworkRequest: the last 256
+// kept, oldest first, the phases of them all summarized; any thread
+- (void)addNetworkRequest:(IJKFFNetworkRequest *)request;
+@property(nonatomic, readonly) NSArray<IJKFFNetworkRequest *> *networkRequests;
+@property(nonatomic, readonly) int64_t   networkRequestCount;
+@property(nonatomic, readonly) int64_t   networkReusedCount;     // on a connection open before
+@property(nonatomic, readonly) int64_t   networkCacheHitCount;   // answered from the CDN cache
+@property(nonatomic, readonly) int64_t   networkErrorCount;      // failed, or cut short
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkDnsTime;          // of the requests resolving
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkConnectTime;      // of the requests connecting
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkTlsTime;          // of the requests handshaking
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkWaitTime;
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkTimeToFirstByte;
+@property(nonatomic, readonly) IJKFFLatencyPercentiles networkReceiveTime;
+// waitTime of the requests kept, by edge: a slow edge waits on its own,
+// a slow radio shows in connect and receive times everywhere
+@property(nonatomic, readonly) NSDictionary<NSString *, NSValue *> *networkWaitTimeByEdge;
+
+@property(nonatomic) int       hlsVariantBitrate;          // BANDWIDTH of the HLS variant played, 0 without abr
+@property(nonatomic) int       hlsVariantSwitchCount;
+@property(nonatomic) int64_t   hlsEstimatedBandwidth;      // bits per second at the last switch
+
 @property(nonatomic) int64_t   prepareStartTick;
 @property(nonatomic) int64_t   prepareDuration;
 @property(nonatomic) int64_t   firstVideoFrameLatency;
 @property(nonatomic) int64_t   lastPrerollStartTick;
 @property(nonatomic) int64_t   lastPrerollDuration;
+@property(nonatomic) int       lastAccurateSeekSkippedFrames;  // frames not decoded before the target
+
+// per stage latency of the VideoToolbox frames presented, from the decoder
+// taking the packet off the packet queue to the frame on screen
+@property(nonatomic) IJKFFLatencyPercentiles frameSubmitLatency;    // to VTDecompressionSessionDecodeFrame
+@property(nonatomic) IJKFFLatencyPercentiles frameDecodeLatency;    // in VideoToolbox
+@property(nonatomic) IJKFFLatencyPercentiles frameReorderLatency;   // in the reorder queue
+@property(nonatomic) IJKFFLatencyPercentiles framePresentLatency;   // in the picture queue, then rendered
+@property(nonatomic) IJKFFLatencyPercentiles frameTotalLatency;
+
+// by AVAPP message, NSValue of IJKFFInjectHookTime
+@property(nonatomic) NSDictionary<NSNumber *, NSValue *> *injectHookTimes;
+
+// microseconds of CPU of the threads of the core, by role: "demux",
+// "video_decode", "audio", "render", "message", "io", "other"
+@property(nonatomic) NSDictionary<NSString *, NSNumber *> *threadCPUTimes;
+
+// of the media, bytes received by interface and frames of the view
+@property(nonatomic) int64_t   wifiBytes;
+@property(nonatomic) int64_t   cellularBytes;
+@property(nonatomic) int64_t   presentedFrames;
+@property(nonatomic) int64_t   decodedFrames;      // presented or dropped at the output
+
+@property(nonatomic, readonly) IJKFFEnergyEstimate energyEstimate;
 
 @end
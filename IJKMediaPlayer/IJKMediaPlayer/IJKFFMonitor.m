@@ -21,14 +21,71 @@
 
 #import "IJKFFMonitor.h"
 #include "ijksdl/ijksdl_timer.h"
-#include "ijkplayer/ijkmeta.h"
-#import "NSString+IJKMedia.h"
+#include "libavcodec/packet_pool.h"
+#import "ijksdl/ios/IJKSDLFrameLatency.h"
 
 #define IJK_FFM_SAMPLE_RANGE 2000
 
+#define IJK_FFM_NETWORK_REQUESTS 256
+
+typedef NS_ENUM(NSInteger, IJKFFNetworkPhase) {
+    IJKFFNetworkPhaseDns,
+    IJKFFNetworkPhaseConnect,
+    IJKFFNetworkPhaseTls,
+    IJKFFNetworkPhaseWait,
+    IJKFFNetworkPhaseTimeToFirstByte,
+    IJKFFNetworkPhaseReceive,
+    IJKFFNetworkPhaseCount,
+};
+
+// the energy model, see IJKFFEnergyEstimate
+#define IJK_FFM_CPU_MW              1000.0  // a core busy
+#define IJK_FFM_WIFI_MJ_PER_MB      100.0
+#define IJK_FFM_CELLULAR_MJ_PER_MB  500.0   // tail time of the radio included
+#define IJK_FFM_GPU_MJ_PER_MPIXEL   1.0     // presented
+#define IJK_FFM_VTB_MJ_PER_MPIXEL   1.5     // decoded in hardware
+
+@implementation IJKFFNetworkRequest
+
+- (int64_t)timeToFirstByte
+{
+    return _dnsTime + _connectTime + _tlsTime + _sendTime + _waitTime;
+}
+
+// "HIT", "TCP_HIT", "Hit from cloudfront", "HIT, MISS" of a shield and an edge
+- (BOOL)cacheHit
+{
+    return [_cacheStatus rangeOfString:@"hit" options:NSCaseInsensitiveSearch].location != NSNotFound;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %d %@ %@%lld bytes, ttfb %lld us, receive %lld us%@%@>",
+            NSStringFromClass([self class]), _httpCode, _url, _reused ? @"reused, " : @"",
+            _bytes, self.timeToFirstByte, _receiveTime,
+            _cacheStatus ? [@", " stringByAppendingString:_cacheStatus] : @"",
+            _edge ? [@" at " stringByAppendingString:_edge] : @""];
+}
+
+@end
+
+inline static IJKFFLatencyPercentiles latencyPercentiles(IJKSDLLatencyHistogram *histogram)
+{
+    IJKSDLLatencyPercentiles p = IJKSDLLatencyHistogram_percentiles(histogram);
+    return (IJKFFLatencyPercentiles){p.count, p.p50, p.p95, p.p99};
+}
+
 @implementation IJKFFMonitor
 {
     SDL_SpeedSampler2 _tcpSpeedSampler;
+
+    // guarded by self, added to from the inject queue
+    NSMutableArray<IJKFFNetworkRequest *> *_networkRequests;
+    int64_t _networkRequestCount;
+    int64_t _networkReusedCount;
+    int64_t _networkCacheHitCount;
+    int64_t _networkErrorCount;
+    IJKSDLLatencyHistogram *_networkPhases[IJKFFNetworkPhaseCount];
 }
 
 - (instancetype)init
@@ -36,29 +93,153 @@
     self = [super init];
     if (self) {
         SDL_SpeedSampler2Reset(&_tcpSpeedSampler, IJK_FFM_SAMPLE_RANGE);
+        _metaInfo.videoStream = -1;
+        _metaInfo.audioStream = -1;
+        _networkRequests = [NSMutableArray array];
+        for (int i = 0; i < IJKFFNetworkPhaseCount; ++i)
+            _networkPhases[i] = IJKSDLLatencyHistogram_create();
     }
     return self;
 }
 
+- (void)dealloc
+{
+    for (int i = 0; i < IJKFFNetworkPhaseCount; ++i)
+        IJKSDLLatencyHistogram_freep(&_networkPhases[i]);
+}
+
 - (float)fps
 {
-    int fpsNum = [_videoMeta[@IJKM_KEY_FPS_NUM] intValue];
-    int fpsDen = [_videoMeta[@IJKM_KEY_FPS_DEN] intValue];
+    if (_metaInfo.fpsNum <= 0 || _metaInfo.fpsDen <= 0)
+        return 0;
+
+    return ((float)_metaInfo.fpsNum) / _metaInfo.fpsDen;
+}
+
+- (int64_t)     duration    {return _metaInfo.duration;}
+- (int64_t)     bitrate     {return _metaInfo.bitrate;}
+- (int)         width       {return _metaInfo.width;}
+- (int)         height      {return _metaInfo.height;}
+- (NSString *)  vcodec      {return @(_metaInfo.vcodec);}
+- (NSString *)  acodec      {return @(_metaInfo.acodec);}
+- (int)         sampleRate    {return _metaInfo.sampleRate;}
+- (int64_t)     channelLayout {return _metaInfo.channelLayout;}
 
-    if (fpsNum <= 0 || fpsDen <= 0)
+- (BOOL)audioSampleRateMismatch
+{
+    return _audioOutputSampleRate > 0 && _audioHardwareSampleRate > 0 &&
+           _audioOutputSampleRate != _audioHardwareSampleRate;
+}
+
+- (float)packetPoolHitRate
+{
+    AVPacketPoolStatistic stat;
+    av_packet_pool_get_statistic(&stat);
+
+    int64_t total = stat.hits + stat.misses + stat.oversized;
+    if (total <= 0)
         return 0;
 
-    return ((float)fpsNum) / fpsDen;
+    return ((float)stat.hits) / total;
+}
+
+- (void)addNetworkRequest:(IJKFFNetworkRequest *)request
+{
+    // a phase not gone through is not a phase done in no time
+    if (request.dnsTime > 0)
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseDns], request.dnsTime);
+    if (request.connectTime > 0)
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseConnect], request.connectTime);
+    if (request.tlsTime > 0)
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseTls], request.tlsTime);
+    if (request.httpCode > 0) {
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseWait], request.waitTime);
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseTimeToFirstByte], request.timeToFirstByte);
+    }
+    if (request.bytes > 0)
+        IJKSDLLatencyHistogram_add(_networkPhases[IJKFFNetworkPhaseReceive], request.receiveTime);
+
+    @synchronized (self) {
+        if (_networkRequests.count >= IJK_FFM_NETWORK_REQUESTS)
+            [_networkRequests removeObjectAtIndex:0];
+        [_networkRequests addObject:request];
+        _networkRequestCount++;
+        if (request.reused)
+            _networkReusedCount++;
+        if (request.cacheHit)
+            _networkCacheHitCount++;
+        if (request.error || !request.complete)
+            _networkErrorCount++;
+    }
+}
+
+- (NSArray<IJKFFNetworkRequest *> *)networkRequests
+{
+    @synchronized (self) {
+        return [_networkRequests copy];
+    }
+}
+
+- (int64_t)networkRequestCount  {@synchronized (self) {return _networkRequestCount;}}
+- (int64_t)networkReusedCount   {@synchronized (self) {return _networkReusedCount;}}
+- (int64_t)networkCacheHitCount {@synchronized (self) {return _networkCacheHitCount;}}
+- (int64_t)networkErrorCount    {@synchronized (self) {return _networkErrorCount;}}
+
+- (IJKFFLatencyPercentiles)networkDnsTime         {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseDns]);}
+- (IJKFFLatencyPercentiles)networkConnectTime     {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseConnect]);}
+- (IJKFFLatencyPercentiles)networkTlsTime         {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseTls]);}
+- (IJKFFLatencyPercentiles)networkWaitTime        {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseWait]);}
+- (IJKFFLatencyPercentiles)networkTimeToFirstByte {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseTimeToFirstByte]);}
+- (IJKFFLatencyPercentiles)networkReceiveTime     {return latencyPercentiles(_networkPhases[IJKFFNetworkPhaseReceive]);}
+
+// the nearest rank of the sorted waits
+static int64_t percentileOf(NSArray<NSNumber *> *sorted, int percent)
+{
+    NSUInteger rank = (sorted.count * percent + 99) / 100;
+    return sorted[MAX(rank, 1) - 1].longLongValue;
 }
 
-- (int64_t)     duration    {return [_mediaMeta[@IJKM_KEY_DURATION_US] longLongValue] / 1000;}
-- (int64_t)     bitrate     {return [_mediaMeta[@IJKM_KEY_BITRATE] longLongValue];}
-- (int)         width       {return [_videoMeta[@IJKM_KEY_WIDTH] intValue];}
-- (int)         height      {return [_videoMeta[@IJKM_KEY_HEIGHT] intValue];}
-- (NSString *)  vcodec      {return [NSString ijk_stringBeEmptyIfNil:_videoMeta[@IJKM_KEY_CODEC_NAME]];}
-- (NSString *)  acodec      {return [NSString ijk_stringBeEmptyIfNil:_audioMeta[@IJKM_KEY_CODEC_NAME]];}
-- (int)         sampleRate    {return [_audioMeta[@IJKM_KEY_SAMPLE_RATE] intValue];}
-- (int64_t)     channelLayout {return [_audioMeta[@IJKM_KEY_CHANNEL_LAYOUT] longLongValue];}
+- (NSDictionary<NSString *, NSValue *> *)networkWaitTimeByEdge
+{
+    NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *waits = [NSMutableDictionary dictionary];
+    for (IJKFFNetworkRequest *request in self.networkRequests) {
+        if (!request.edge || request.httpCode <= 0)
+            continue;
+        if (!waits[request.edge])
+            waits[request.edge] = [NSMutableArray array];
+        [waits[request.edge] addObject:@(request.waitTime)];
+    }
+
+    NSMutableDictionary *byEdge = [NSMutableDictionary dictionary];
+    [waits enumerateKeysAndObjectsUsingBlock:^(NSString *edge, NSMutableArray<NSNumber *> *edgeWaits, BOOL *stop) {
+        [edgeWaits sortUsingSelector:@selector(compare:)];
+        IJKFFLatencyPercentiles percentiles = {
+            edgeWaits.count,
+            percentileOf(edgeWaits, 50),
+            percentileOf(edgeWaits, 95),
+            percentileOf(edgeWaits, 99),
+        };
+        byEdge[edge] = [NSValue valueWithBytes:&percentiles objCType:@encode(IJKFFLatencyPercentiles)];
+    }];
+    return byEdge;
+}
 
+- (IJKFFEnergyEstimate)energyEstimate
+{
+    IJKFFEnergyEstimate energy = {0};
+    double megapixels = (double)_metaInfo.width * _metaInfo.height / 1000000;
+
+    int64_t cpuTime = 0;
+    for (NSNumber *time in _threadCPUTimes.allValues)
+        cpuTime += time.longLongValue;
+    energy.cpu     = cpuTime / 1000000.0 * IJK_FFM_CPU_MW;
+    energy.network = _wifiBytes / 1000000.0 * IJK_FFM_WIFI_MJ_PER_MB +
+                     _cellularBytes / 1000000.0 * IJK_FFM_CELLULAR_MJ_PER_MB;
+    energy.gpu     = _presentedFrames * megapixels * IJK_FFM_GPU_MJ_PER_MPIXEL;
+    if ([_vdecoder isEqualToString:@"VideoToolbox"])
+        energy.decoder = _decodedFrames * megapixels * IJK_FFM_VTB_MJ_PER_MPIXEL;
+    energy.total   = energy.cpu + energy.network + energy.gpu + energy.decoder;
+    return energy;
+}
 
 @end
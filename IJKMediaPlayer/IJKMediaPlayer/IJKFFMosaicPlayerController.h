@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import "IJKFFOptions.h"
+
+@class IJKFFMoviePlayerController;
+
+typedef NS_ENUM(NSInteger, IJKFFMosaicLayout) {
+    IJKFFMosaicLayoutFocus,     // the focused angle fills the view, the others in a strip over its bottom
+    IJKFFMosaicLayoutGrid,      // every angle in a tile of the same size
+};
+
+// Plays the live angles of one event, e.g. the cameras of a match, in one
+// view. Only the focused angle is heard and decoded in full; the others
+// play on muted, with their audio stream and audio output closed, at a
+// lower frame rate, bitrate and decoding cost, so focusing another angle
+// is a change of layout and of those caps, with no buffering.
+//
+// Each angle is an IJKFFMoviePlayerController of its own, not managed by
+// IJKMediaGovernor. Their downloads run on the shared io reactor and http
+// connection pool, and VideoToolbox decodes no more pixels than a tile
+// shows.
+@interface IJKFFMosaicPlayerController : NSObject
+
+- (instancetype)initWithContentURLStrings:(NSArray<NSString *> *)urlStrings
+                              withOptions:(IJKFFOptions *)options;
+
+@property(nonatomic, readonly) UIView *view;
+// by angle, in the order of the urls
+@property(nonatomic, readonly) NSArray<IJKFFMoviePlayerController *> *players;
+
+@property(nonatomic) NSInteger focusedAngle;
+@property(nonatomic) IJKFFMosaicLayout layout;
+
+// the caps of the angles out of focus, applied at once
+@property(nonatomic) CGFloat unfocusedMaximumFrameRate;      // default 15, 0 for none
+@property(nonatomic) int64_t unfocusedMaxBitrate;            // default 1, the lowest HLS variant; 0 for none
+@property(nonatomic) IJKFFDecodeDegradationLevel unfocusedDecodeDegradation;   // default IJKFFDecodeDegradationSkipNonRef
+
+- (void)prepareToPlay;
+- (void)play;
+- (void)pause;
+- (void)shutdown;
+
+@end
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFMosaicPlayerController.h"
+#import "IJKFFMoviePlayerController.h"
+
+// of the tiles in the strip, under the focused angle
+#define IJK_MOSAIC_STRIP_TILES      4
+#define IJK_MOSAIC_STRIP_MARGIN     8.0f
+
+@interface IJKFFMosaicView : UIView
+@property(nonatomic, weak) IJKFFMosaicPlayerController *controller;
+@end
+
+@interface IJKFFMosaicPlayerController ()
+- (void)layoutAngles;
+@end
+
+@implementation IJKFFMosaicView
+
+- (void)layoutSubviews
+{
+    [super layoutSubviews];
+    [self.controller layoutAngles];
+}
+
+@end
+
+@implementation IJKFFMosaicPlayerController {
+    IJKFFMosaicView *_mosaicView;
+    NSArray<IJKFFMoviePlayerController *> *_players;
+}
+
+- (instancetype)initWithContentURLStrings:(NSArray<NSString *> *)urlStrings
+                              withOptions:(IJKFFOptions *)options
+{
+    if (urlStrings.count == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _unfocusedMaximumFrameRate  = 15;
+        _unfocusedMaxBitrate        = 1;
+        _unfocusedDecodeDegradation = IJKFFDecodeDegradationSkipNonRef;
+
+        _mosaicView = [[IJKFFMosaicView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+        _mosaicView.controller      = self;
+        _mosaicView.backgroundColor = [UIColor blackColor];
+        _mosaicView.clipsToBounds   = YES;
+
+        NSMutableArray *players = [NSMutableArray arrayWithCapacity:urlStrings.count];
+        for (NSString *urlString in urlStrings) {
+            IJKFFMoviePlayerController *player = [[IJKFFMoviePlayerController alloc] initWithContentURLString:urlString
+                                                                                                   withOptions:options];
+            if (!player)
+                return nil;
+            player.shouldAutoplay = NO;
+            player.scalingMode    = IJKMPMovieScalingModeAspectFit;
+            [players addObject:player];
+            [_mosaicView addSubview:player.view];
+        }
+        _players = players;
+
+        [self applyFocus];
+    }
+    return self;
+}
+
+- (UIView *)view
+{
+    return _mosaicView;
+}
+
+- (NSArray<IJKFFMoviePlayerController *> *)players
+{
+    return _players;
+}
+
+#pragma mark focus
+
+- (void)setFocusedAngle:(NSInteger)focusedAngle
+{
+    if (focusedAngle < 0 || focusedAngle >= (NSInteger)_players.count || focusedAngle == _focusedAngle)
+        return;
+
+    _focusedAngle = focusedAngle;
+    [self applyFocus];
+    [self layoutAngles];
+}
+
+- (void)setUnfocusedMaximumFrameRate:(CGFloat)unfocusedMaximumFrameRate
+{
+    _unfocusedMaximumFrameRate = unfocusedMaximumFrameRate;
+    [self applyFocus];
+}
+
+- (void)setUnfocusedMaxBitrate:(int64_t)unfocusedMaxBitrate
+{
+    _unfocusedMaxBitrate = unfocusedMaxBitrate;
+    [self applyFocus];
+}
+
+- (void)setUnfocusedDecodeDegradation:(IJKFFDecodeDegradationLevel)unfocusedDecodeDegradation
+{
+    _unfocusedDecodeDegradation = unfocusedDecodeDegradation;
+    [self applyFocus];
+}
+
+// the focused angle first: its audio opens before the former one closes
+- (void)applyFocus
+{
+    IJKFFMoviePlayerController *focused = _players[_focusedAngle];
+    focused.audioEnabled                  = YES;
+    focused.maximumFrameRate              = 0;
+    focused.maxBitrate                    = 0;
+    focused.minimumDecodeDegradationLevel = IJKFFDecodeDegradationNone;
+
+    for (IJKFFMoviePlayerController *player in _players) {
+        if (player == focused)
+            continue;
+        player.audioEnabled                  = NO;
+        player.maximumFrameRate              = _unfocusedMaximumFrameRate;
+        player.maxBitrate                    = _unfocusedMaxBitrate;
+        player.minimumDecodeDegradationLevel = _unfocusedDecodeDegradation;
+    }
+}
+
+#pragma mark layout
+
+- (void)setLayout:(IJKFFMosaicLayout)layout
+{
+    _layout = layout;
+    [self layoutAngles];
+}
+
+- (void)layoutAngles
+{
+    CGRect   bounds = _mosaicView.bounds;
+    NSUInteger count = _players.count;
+
+    if (_layout == IJKFFMosaicLayoutGrid) {
+        NSUInteger columns = (NSUInteger)ceil(sqrt((double)count));
+        NSUInteger rows    = (count + columns - 1) / columns;
+        CGFloat    width   = bounds.size.width / columns;
+        CGFloat    height  = bounds.size.height / rows;
+        for (NSUInteger i = 0; i < count; ++i) {
+            _players[i].view.frame = CGRectMake(bounds.origin.x + (i % columns) * width,
+                                                bounds.origin.y + (i / columns) * height,
+                                                width, height);
+        }
+        return;
+    }
+
+    UIView *focusedView = _players[_focusedAngle].view;
+    focusedView.frame = bounds;
+    [_mosaicView sendSubviewToBack:focusedView];
+
+    CGFloat margin = IJK_MOSAIC_STRIP_MARGIN;
+    CGFloat width  = (bounds.size.width - margin * (IJK_MOSAIC_STRIP_TILES + 1)) / IJK_MOSAIC_STRIP_TILES;
+    CGFloat height = width * 9.0f / 16.0f;
+    CGFloat y      = CGRectGetMaxY(bounds) - margin - height;
+    NSUInteger tile = 0;
+    for (NSUInteger i = 0; i < count; ++i) {
+        if ((NSInteger)i == _focusedAngle)
+            continue;
+        _players[i].view.frame = CGRectMake(bounds.origin.x + margin + tile * (width + margin), y, width, height);
+        [_mosaicView bringSubviewToFront:_players[i].view];
+        ++tile;
+    }
+}
+
+#pragma mark playback
+
+- (void)prepareToPlay
+{
+    for (IJKFFMoviePlayerController *player in _players)
+        [player prepareToPlay];
+}
+
+- (void)play
+{
+    for (IJKFFMoviePlayerController *player in _players)
+        [player play];
+}
+
+- (void)pause
+{
+    for (IJKFFMoviePlayerController *player in _players)
+        [player pause];
+}
+
+- (void)shutdown
+{
+    for (IJKFFMoviePlayerController *player in _players) {
+        [player.view removeFromSuperview];
+        [player shutdown];
+    }
+}
+
+@end
@@ -21,9 +21,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#import <CoreVideo/CoreVideo.h>
 #import "IJKMediaPlayback.h"
 #import "IJKFFMonitor.h"
+#import "IJKFFStatistics.h"
+#import "IJKFFMemoryUsage.h"
+#import "IJKFFStartupReport.h"
 #import "IJKFFOptions.h"
+#import "IJKMediaDataSource.h"
+#import "IJKFFTimedMetadata.h"
+
+@class IJKMediaSpriteThumbnailer;
 
 // media meta
 #define k_IJKM_KEY_FORMAT         @"format"
@@ -69,6 +77,55 @@ typedef enum IJKLogLevel {
     k_IJK_LOG_SILENT  = 8,
 } IJKLogLevel;
 
+// How long -shutdown took, reported with IJKMPMoviePlayerShutdownReportNotification
+// once the core is torn down; milliseconds.
+typedef struct IJKFFShutdownReport {
+    int64_t stop;               // aborting the core and its io
+    int64_t join;               // its threads and decoders ending
+    int64_t total;              // from -shutdown to the core released
+    int     inFlight;           // other cores being torn down meanwhile, process wide
+    BOOL    timedOut;           // closed at the bound, before the core was torn down
+} IJKFFShutdownReport;
+
+#define IJKFF_AUDIO_ANALYSIS_BANDS 32
+
+// The audio output as rendered, the volume and the normalization gain left
+// out: a spectrum in bands spaced evenly in log frequency from 40 Hz to
+// 16 kHz, and EBU R128 loudness.
+typedef struct IJKFFAudioAnalysis {
+    float bands[IJKFF_AUDIO_ANALYSIS_BANDS];   // dBFS, a full scale sine at 0
+    float momentaryLoudness;                   // LUFS over 400 ms, -INFINITY in silence
+    float shortTermLoudness;                   // LUFS over 3 s
+    float integratedLoudness;                  // LUFS, gated, since the audio output opened
+    float normalizationGain;                   // dB, see loudnessNormalizationTarget
+} IJKFFAudioAnalysis;
+
+// A/V sync and frame pacing as played out, measured on a test stream which
+// starts each period with a white flash frame over black and a tone burst
+// over silence at the same pts. Milliseconds; times are when the frame
+// lands on the display and when the sample leaves the audio route.
+typedef struct IJKFFSyncReport {
+    int     flashes;
+    int     tones;
+    int     pairs;              // a flash with a tone within half a second
+
+    // the flash shown after the tone is heard, positive when the video is late
+    double  offsetMean;
+    double  offsetStdDev;
+    double  offsetMin;
+    double  offsetMedian;
+    double  offsetP95;          // of the absolute offsets
+    double  offsetMax;
+
+    // between the frames landing on the display, of any content
+    int     frames;
+    double  frameIntervalMean;
+    double  frameIntervalStdDev;
+    double  frameIntervalMedian;
+    double  frameIntervalP95;
+    double  frameIntervalMax;
+} IJKFFSyncReport;
+
 @interface IJKFFMoviePlayerController : NSObject <IJKMediaPlayback>
 
 - (id)initWithContentURL:(NSURL *)aUrl
@@ -77,6 +134,56 @@ typedef enum IJKLogLevel {
 - (id)initWithContentURLString:(NSString *)aUrlString
                    withOptions:(IJKFFOptions *)options;
 
+// The same player, built off the main thread but for its view: the global
+// init, the audio session and the player core with its options applied
+// are done on a background queue, then the view is made and bound on the
+// main thread, where completion is called. The view gets its GL or Metal
+// resources with the first frame it shows. Leave options unchanged until
+// completion.
++ (void)playerWithContentURLString:(NSString *)aUrlString
+                       withOptions:(IJKFFOptions *)options
+                        completion:(void (^)(IJKFFMoviePlayerController *player))completion;
+
+// A queue: the urls play back to back in this player, through the concat
+// demuxer. The next url is opened and probed while the current one plays,
+// and the decoders, audio output and view carry over at the handover; a
+// same codec stream goes on without a gap. enqueueContentURLString: appends
+// to the queue while it plays, the end of the last url ends playback. The
+// queue is seekable while the durations of all its urls are known.
+- (id)initWithContentURLStrings:(NSArray<NSString *> *)urlStrings
+                    withOptions:(IJKFFOptions *)options;
+- (void)enqueueContentURLString:(NSString *)urlString;
+
+// Play the bytes an app's IJKMediaDataSource lends, read in place; the
+// player keeps the link, keep it as well to call dataAvailable.
+- (id)initWithMediaDataSource:(IJKMediaDataSourceLink *)link
+                  withOptions:(IJKFFOptions *)options;
+
+// Play another url in this player: the former media is stopped and
+// released in the background, and a new player core is bound to the same
+// view, GL context and init options; options set with setOptionValue
+// since init are not carried over. Much cheaper than a new controller,
+// for players recycled while a feed scrolls.
+- (void)resetWithContentURL:(NSURL *)aUrl;
+- (void)resetWithContentURLString:(NSString *)aUrlString;
+
+// Park a paused or off screen player of a feed in a few hundred KB: its
+// core is torn down in the background, with the decoders, the read-ahead
+// ring, the packet and picture queues and the audio output, and the view
+// lets go of its GL or Metal resources, showing the last frame as a poster.
+// Kept are the url, the position, whether it played and the video size.
+// -resumeFromHibernation prepares a new core at the position, playing if
+// it was, with a VideoToolbox session of that size warmed up meanwhile;
+// -play and -prepareToPlay resume too, the rest is ignored until then.
+// The probe cache, the http pool, the HLS variant and key caches and the
+// disk cache the former core filled make it quicker than the first prepare.
+// Only a prepared or preparing player hibernates.
+- (void)hibernate;
+- (void)resumeFromHibernation;
+@property(nonatomic, readonly) BOOL isHibernating;
+// shown over the view until the first frame after resuming, nil otherwise
+@property(nonatomic, readonly) UIImage *hibernationPoster;
+
 - (void)prepareToPlay;
 - (void)play;
 - (void)pause;
@@ -88,16 +195,262 @@ typedef enum IJKLogLevel {
 - (void)setPauseInBackground:(BOOL)pause;
 - (BOOL)isVideoToolboxOpen;
 
+// Audio only listening in the background: while the app is not in the
+// foreground, only key frames are decoded, and VideoToolbox does not even
+// get the others. Back in the foreground, decoding resumes from the next
+// key frame. YES by default, except with the sample buffer view, whose
+// layer picture in picture keeps showing.
+@property(nonatomic) BOOL suspendsVideoInBackground;
+
+// Where the messages of the core are handled, and so where the playback
+// notifications are posted: the main queue by default, any serial queue
+// otherwise. Each wake up of the message thread hands it all the messages
+// pending as one block, with the buffering progress updates superseded
+// within it left out.
+@property(atomic, strong) dispatch_queue_t messageQueue;
+
+// The threads of the player at background QoS, for a player preloading
+// behind the one on screen; set by IJKMediaGovernor from its priority. The
+// threads started meanwhile are raised to their role once it is cleared.
+@property(nonatomic) BOOL runsAtBackgroundQoS;
+
+// The frame on screen as an image, taken from the decoded picture rather than
+// by rendering the view, so playback does not stall; completion is called on
+// the main thread, with nil if there is no frame. Prefer it to
+// thumbnailImageAtCurrentTime for frequent captures.
+- (void)captureFrameWithCompletion:(void (^)(UIImage *image))completion;
+
+// The decoded frames as they are displayed, for Vision, Core ML or effects:
+// the VideoToolbox buffer itself, or an IOSurface backed NV12 copy of
+// software frames, valid for the call. handler runs on queue, a global one
+// if nil; frames are dropped while it still runs, and to keep every
+// frameInterval-th one at most maximumFrameRate times a second (0: no limit).
+// pts is the frame's time for VideoToolbox frames, the playback time at
+// display otherwise. Pass a nil handler to stop.
+- (void)setFrameOutputHandler:(void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts))handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate;
+
+// Likely seek targets of the item, in seconds and most likely first:
+// chapter starts, the end of an intro, popular positions. Once prepared,
+// seconds of media from the key frame before each are read into the disk
+// cache at background priority, maxBytes in all, so a seek there starts
+// from local data. Replaces the targets set before, an empty array clears
+// them; the item changing does too. Needs the disk cache, as
+// IJKMediaPreloader does.
+- (void)setLikelySeekTargets:(NSArray<NSNumber *> *)times window:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes;
+
+// Scrubbing: between begin and end only key frames are decoded, and
+// scrubToTime: keeps a single seek in flight, the latest target waiting
+// for the former seek to complete; the view previews the key frame before
+// each target, thumbnailImageAtCurrentTime captures it. endScrubbingAtTime:
+// seeks to the exact time, with "enable-accurate-seek", and resumes normal
+// decoding.
+- (void)beginScrubbing;
+- (void)scrubToTime:(NSTimeInterval)time;
+- (void)endScrubbingAtTime:(NSTimeInterval)time;
+@property(nonatomic, readonly) BOOL isScrubbing;
+
+// Scrubbing previews from the thumbnail track of the url, if it publishes
+// one, without decoding video, see IJKMediaSpriteThumbnailer. With
+// prefetchesScrubPreviews, the track is looked for and downloaded once the
+// first video frame is shown; NO by default.
+@property(nonatomic) BOOL prefetchesScrubPreviews;
+@property(nonatomic, readonly) IJKMediaSpriteThumbnailer *scrubPreviews;
+
+// Trick play: fast forward, or rewind with a negative rate, at 2x to 64x.
+// Playback pauses, the audio is muted, and the player steps from key frame
+// to key frame through the scrubbing seeks, at most ten a second: only
+// key frames are decoded, and the demuxer's key frame index (mov stss, the
+// flv keyframes metadata, HLS I-frame playlists) points the reads at them,
+// so a range capable source does not download what is skipped. Calling it
+// again changes the rate. endTrickPlay seeks to the time reached and
+// resumes the former state; reaching either end of the media ends it.
+- (void)beginTrickPlayAtRate:(float)rate;
+- (void)endTrickPlay;
+@property(nonatomic, readonly) float trickPlayRate;     // 0 when off
+
+// Frame stepping: playback pauses and the frames are stepped one at a time,
+// forward or backward, by an IJKMediaFrameStepper of the url, and shown in
+// the view as they are decoded. It decodes whole GOPs and keeps them, so
+// that stepping backward does not decode again from the key frame for every
+// frame. endFrameStepping seeks the player to the frame stepped to, exactly
+// with "enable-accurate-seek", and resumes the former state.
+- (void)beginFrameStepping;
+- (void)stepFrames:(NSInteger)frames;   // backward if negative
+- (void)stepFrameForward;
+- (void)stepFrameBackward;
+- (void)endFrameStepping;
+@property(nonatomic, readonly) BOOL isFrameStepping;
+// of the frame shown, -1 when not stepping
+@property(nonatomic, readonly) NSTimeInterval frameSteppingTime;
+
+// Output views: the video shown in other views besides view, e.g. on an
+// external screen or in a mini player, from the one decoder instead of a
+// player each. The decoded pixel buffer is shared, every view renders it
+// at its own size, and at most at its own maximum frame rate. Software
+// decoded frames are shared from the next pictures the decoder allocates,
+// add the views before prepareToPlay to have all of them.
+- (UIView *)addOutputView;
+- (void)removeOutputView:(UIView *)view;
+// 0 for every frame
+- (void)setMaximumFrameRate:(CGFloat)frameRate forOutputView:(UIView *)view;
+@property(nonatomic, readonly) NSArray<UIView *> *outputViews;
+
+// with IJKFFOptions.liveTimeshiftSize: back to the newest key frame of the
+// live stream
+- (void)seekToLiveEdge;
+
+// Switch to the audio stream at streamIndex in kk_IJKM_KEY_STREAMS; the
+// audio is flushed and buffered again.
+- (void)selectAudioStream:(NSInteger)streamIndex;
+// NO closes the audio stream, its decoder and the audio output, the clock
+// going over to the video; YES opens them again, the audio buffered anew.
+// Default YES, kept across media.
+@property(nonatomic, getter=isAudioEnabled) BOOL audioEnabled;
+// Audio only playback: YES closes the video stream and its decoder, the
+// demuxer drops its packets and no longer fetches a video rendition, and
+// HLS switches at the next segment to an audio only variant, or to the
+// lowest one. NO opens the video again; HLS switches back at the next
+// segment, the picture following once playback reaches it. Default NO,
+// kept across media.
+@property(nonatomic) BOOL audioOnly;
+// audio only playback while the app is in the background, rather than
+// suspendsVideoInBackground. Default NO
+@property(nonatomic) BOOL audioOnlyInBackground;
+
+// bits per second of the highest HLS variant played, 0 for no cap, the
+// default; the thermal policy may cap lower
+@property(nonatomic) int64_t maxBitrate;
+// frames per second shown at most in view, 0 for no cap, the default; the
+// thermal policy may cap lower
+@property(nonatomic) CGFloat maximumFrameRate;
+// the software decoder leaves out at least this much, whatever the load;
+// adaptiveDecodeDegradation of IJKFFOptions degrades further from there.
+// Default IJKFFDecodeDegradationNone, kept across media
+@property(nonatomic) IJKFFDecodeDegradationLevel minimumDecodeDegradationLevel;
+
+// Spectrum and loudness of the audio output, measured on its render thread
+// block by block as it plays; handler gets the latest on the main thread,
+// at most rate times a second, nil stops it. The audio output renders
+// through an AudioUnit while either this or loudnessNormalizationTarget is
+// set: set them before prepareToPlay, an output already open through an
+// AudioQueue is not measured. Kept across media.
+- (void)setAudioAnalysisHandler:(void (^)(IJKFFAudioAnalysis analysis))handler rate:(double)rate;
+// EBU R128 normalization: the integrated loudness of the audio output is
+// brought to this target, e.g. -16 or -23 LUFS, by a gain applied in the
+// pass of the volume, moving at most 3 dB a second and boosting no further
+// than the recent peak allows. 0 for none, the default; kept across media
+@property(nonatomic) float loudnessNormalizationTarget;
+
+// Measures the A/V sync and frame pacing of what plays, see IJKFFSyncReport.
+// The audio output renders through an AudioUnit while on, set it before
+// prepareToPlay; flashes are seen in pixel buffer frames only, VideoToolbox
+// or usePixelBufferOverlays of IJKFFOptions. Off by default, kept across
+// media; the report covers what played since the last reset.
+@property(nonatomic) BOOL syncProbeEnabled;
+@property(nonatomic, readonly) IJKFFSyncReport syncReport;
+- (void)resetSyncReport;
+
+// Timed metadata: the SEI user data unregistered of H.264 and HEVC, found
+// by the VideoToolbox decoder. handler gets them on queue, the main one if
+// nil, as the frame of their time is presented, or the first one after it
+// when frames are dropped.
+// What was read before a seek is dropped. Off while nil, kept across media.
+- (void)setTimedMetadataHandler:(void (^)(NSArray<IJKFFTimedMetadata *> *metadata))handler
+                          queue:(dispatch_queue_t)queue;
+
 + (void)setLogReport:(BOOL)preferLogReport;
 + (void)setLogLevel:(IJKLogLevel)logLevel;
+// binary event log, off by default: the VideoToolbox and render paths and
+// av_log up to verbose, or up to the log level or debug with the log
+// report if more, write to a ring per thread, formatted only by
+// eventLogDump, so the history before a field issue can be kept for its
+// report. av_log messages up to the log level are printed as well. Enabling
+// it initializes ffmpeg, after setRegistrationAllowListFormats:codecs:
++ (void)setEventLogEnabled:(BOOL)enabled;
+// one line per event of every thread in time order: ms, thread, level, tag
++ (NSString *)eventLogDump;
++ (void)clearEventLog;
+// before the first player, preloader or thumbnailer: register only the
+// (de)muxers and codecs named, comma separated as in the registration of
+// ffmpeg ("mov,mpegts,hls", "h264,hevc,aac"), the others the first time a
+// stream needs one that is not among them. Cuts the cost of the first
+// ijkmp_global_init, IJKFFStartupReport.globalInit
++ (void)setRegistrationAllowListFormats:(NSString *)formats codecs:(NSString *)codecs;
+// resolve the host of aUrl in background,
+// used by players with format option "dns_cache" enabled
++ (void)prefetchDNSForURL:(NSURL *)aUrl;
+// create a VideoToolbox session for H.264 of that size in background, for
+// the next player with option "videotoolbox" to adopt instead of creating
+// one on its way to the first picture; kept 30 seconds, or until another
+// size is asked for. The default one is 1080p, 720p on the screens smaller
+// than that; IJKMediaPreloader asks for it
++ (void)prewarmVideoDecoder;
++ (void)prewarmVideoDecoderWithWidth:(int)width height:(int)height;
++ (void)releasePrewarmedVideoDecoder;
+// keep downloaded data in directory across sessions, at most maxSize bytes;
+// used by players with format option "disk_cache" enabled, for progressive
+// urls opened as "cache:<url>" and for the segments of http HLS streams
++ (BOOL)setDiskCacheDirectory:(NSString *)directory maxSize:(int64_t)maxSize;
++ (void)clearDiskCache;
+// for benchmarks: record the timing of the tcp connections of the process to
+// path, or shape them to a recorded or written trace, until stopped; the
+// trace format is in libavformat/net_trace.h
++ (BOOL)startRecordingNetworkTrace:(NSString *)path;
++ (BOOL)startReplayingNetworkTrace:(NSString *)path;
++ (void)stopNetworkTrace;
 + (BOOL)checkIfFFmpegVersionMatch:(BOOL)showAlert;
 + (BOOL)checkIfPlayerVersionMatch:(BOOL)showAlert
                             version:(NSString *)version;
 
 @property(nonatomic, readonly) CGFloat fpsInMeta;
+@property(nonatomic, readonly) CGFloat fpsAtDecoder;
 @property(nonatomic, readonly) CGFloat fpsAtOutput;
+// milliseconds the frames stay on screen away from the frame interval of the video
+@property(nonatomic, readonly) CGFloat judderAtOutput;
+// frames the render view was given but never put on screen
+@property(nonatomic, readonly) int64_t droppedPresentsAtOutput;
 @property(nonatomic) BOOL shouldShowHudView;
 
+// a sample taken now; prefer an observer to polling
+@property(nonatomic, readonly) IJKFFStatistics statistics;
+// block gets a sample every interval seconds on queue (main queue if nil) until
+// the observer returned is removed, or the player shut down; the HUD is one of them
+- (id)addStatisticsObserverWithInterval:(NSTimeInterval)interval
+                                  queue:(dispatch_queue_t)queue
+                                  block:(void (^)(IJKFFStatistics statistics))block;
+- (void)removeStatisticsObserver:(id)observer;
+
+// where the time to the first frame went, valid from
+// IJKMPMoviePlayerStartupReportNotification on, until the next media
+@property(nonatomic, readonly) IJKFFStartupReport startupReport;
+// -shutdown returns at once; the controller is closed, its delegates and
+// the core released, when the core is torn down or at most 500 ms later.
+// Posted with IJKMPMoviePlayerShutdownReportNotification.
+@property(nonatomic, readonly) IJKFFShutdownReport shutdownReport;
+
+// bytes the player holds now, by stage of the pipeline
+@property(nonatomic, readonly) IJKFFMemoryUsage memoryUsage;
+// bytes the player should get down to when the system warns of low memory,
+// by shedding level after level; 0, the default, sheds one level a warning
+@property(nonatomic) int64_t memoryBudget;
+// levels shed so far, back to none with each media
+@property(nonatomic, readonly) IJKFFMemoryShedLevel memoryShedLevel;
+// decoded frames let wait for display now; follows the decode jitter of
+// VideoToolbox with the player option "video-pictq-adaptive", capped by a
+// quarter of memoryBudget
+@property(nonatomic, readonly) int pictureQueueDepth;
+
+// what the software decoder leaves out now, see adaptiveDecodeDegradation
+// of IJKFFOptions; back to none with each media
+@property(nonatomic, readonly) IJKFFDecodeDegradationLevel decodeDegradationLevel;
+
+// what the thermal state and Low Power Mode cost the playback now, see
+// thermalPolicy of IJKFFOptions
+@property(nonatomic, readonly) IJKFFThermalPolicyLevel thermalPolicyLevel;
+
 - (void)setOptionValue:(NSString *)value
                 forKey:(NSString *)key
             ofCategory:(IJKFFOptionCategory)category;
@@ -119,9 +472,14 @@ typedef enum IJKLogLevel {
 - (void)setPlayerOptionIntValue:    (int64_t)value forKey:(NSString *)key;
 
 @property (nonatomic, retain) id<IJKMediaUrlOpenDelegate> segmentOpenDelegate;
+// IJKMediaCtrl_DidTcpOpen reaches it after the connection is made, from a
+// serial queue of the player: the fd may be closed by then, an error no
+// longer fails the connection
 @property (nonatomic, retain) id<IJKMediaUrlOpenDelegate> tcpOpenDelegate;
 @property (nonatomic, retain) id<IJKMediaUrlOpenDelegate> httpOpenDelegate;
 @property (nonatomic, retain) id<IJKMediaUrlOpenDelegate> liveOpenDelegate;
+// asked before a key is fetched or taken from the keys other players fetched
+@property (nonatomic, retain) id<IJKMediaKeyDelegate> keyDelegate;
 
 @property (nonatomic, retain) id<IJKMediaNativeInvokeDelegate> nativeInvokeDelegate;
 
@@ -28,10 +28,37 @@
 #import "IJKMediaPlayback.h"
 #import "IJKMediaModule.h"
 #import "IJKAudioKit.h"
+#import "IJKDeviceModel.h"
+#import "IJKNetworkMonitor.h"
+#import "IJKHTTP3Transport.h"
+#import "IJKFFBlackBox.h"
 #import "IJKNotificationManager.h"
+#import "IJKMediaGovernor.h"
+#import "IJKMediaThumbnailer.h"
+#import "IJKMediaSpriteThumbnailer.h"
+#import "IJKMediaFrameStepper.h"
+#import "IJKMediaPreloader.h"
+#import "IJKMediaDataSource.h"
+#import "IJKFFStatisticsSampler.h"
+#import "IJKFFStartupRecorder.h"
+#import "IJKFFMediaMeta.h"
 #import "NSString+IJKMedia.h"
 #import "ijkioapplication.h"
+#include "libavformat/avformat.h"
+#include "libavformat/dns_cache.h"
+#include "libavformat/disk_cache.h"
+#include "libavformat/net_trace.h"
+#include "libavformat/throughput.h"
+#include "ijksdl/ios/ijksdl_trace_ios.h"
+#include "ijksdl/ios/ijksdl_evlog_ios.h"
+#include "ijksdl/ios/ijksdl_blackbox_ios.h"
+#include "ijksdl/ios/ijksdl_thread_ios.h"
+#include "ijksdl/ios/ijksdl_vout_overlay_videotoolbox.h"
+#include "libavutil/time.h"
 #include "string.h"
+#include <sys/socket.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 static const char *kIJKFFRequiredFFmpegVersion = "ff3.3--ijk0.8.0--20170710--001";
 
@@ -43,15 +70,63 @@ static const char *kIJKFFRequiredFFmpegVersion = "ff3.3--ijk0.8.0--20170710--001
 @implementation IJKWeakHolder
 @end
 
+// the AVAPP messages of ijkff_inject_callback, timed each
+static const int g_inject_hooks[] = {
+    AVAPP_CTRL_WILL_CONCAT_SEGMENT_OPEN,
+    AVAPP_CTRL_WILL_TCP_OPEN,
+    AVAPP_CTRL_DID_TCP_OPEN,
+    AVAPP_CTRL_WILL_HTTP_OPEN,
+    AVAPP_CTRL_WILL_LIVE_OPEN,
+    AVAPP_CTRL_ASYNC_READ_AHEAD,
+    AVAPP_CTRL_HLS_BUFFER_LEVEL,
+    AVAPP_CTRL_HLS_KEY,
+    AVAPP_EVENT_ASYNC_STATISTIC,
+    AVAPP_EVENT_DNS_STATISTIC,
+    AVAPP_EVENT_HTTP_POOL_STATISTIC,
+    AVAPP_EVENT_TLS_STATISTIC,
+    AVAPP_EVENT_HTTP3_STATISTIC,
+    AVAPP_EVENT_HTTP_MIRROR,
+    AVAPP_EVENT_HTTP_REQUEST,
+    AVAPP_EVENT_HLS_VARIANT_SWITCH,
+    AVAPP_EVENT_WILL_DNS_RESOLVE,
+    AVAPP_EVENT_DID_DNS_RESOLVE,
+    AVAPP_EVENT_WILL_TLS_HANDSHAKE,
+    AVAPP_EVENT_DID_TLS_HANDSHAKE,
+    AVAPP_EVENT_WILL_HTTP_OPEN,
+    AVAPP_EVENT_DID_HTTP_OPEN,
+    AVAPP_EVENT_WILL_HTTP_SEEK,
+    AVAPP_EVENT_DID_HTTP_SEEK,
+    IJKIOAPP_EVENT_CACHE_STATISTIC,
+};
+#define IJK_INJECT_HOOK_COUNT (sizeof(g_inject_hooks) / sizeof(g_inject_hooks[0]))
+
+// microseconds, updated from any io thread
+typedef struct IJKInjectHookStat {
+    _Atomic(int64_t) count;
+    _Atomic(int64_t) blocking;
+    _Atomic(int64_t) maxBlocking;
+    _Atomic(int64_t) deferred;
+} IJKInjectHookStat;
+
 @interface IJKFFMoviePlayerController()
 
 @end
 
 @implementation IJKFFMoviePlayerController {
     IjkMediaPlayer *_mediaPlayer;
-    IJKSDLGLView *_glView;
+    UIView<IJKSDLRenderView> *_glView;
+    BOOL _useMetalView;
+    BOOL _useSampleBufferView;
+    IJKFFOptions *_options;
+    IJKWeakHolder *_weakHolder;
     IJKFFMoviePlayerMessagePool *_msgPool;
     NSString *_urlString;
+    IJKMediaThumbnailer *_thumbnailer;
+    IJKMediaSpriteThumbnailer *_scrubPreviews;
+    IJKMediaPreloader *_seekPrefetcher;
+    NSArray<NSNumber *> *_seekTargets;     // until prepared
+    NSTimeInterval _seekTargetWindow;
+    int64_t _seekTargetBytes;
 
     NSInteger _videoWidth;
     NSInteger _videoHeight;
@@ -59,11 +134,37 @@ static const char *kIJKFFRequiredFFmpegVersion = "ff3.3--ijk0.8.0--20170710--001
     NSInteger _sampleAspectRatioDenominator;
 
     BOOL      _seeking;
+    // the position reported from the seek on, until a sample taken after it
+    NSTimeInterval _seekTarget;
+    int64_t   _seekDoneTick;
+    BOOL      _firstVideoFrameRendered;
+    // audio or video, the only one of audio only streams
+    BOOL      _firstFrameRendered;
+    BOOL      _scrubbing;
+    NSTimeInterval _pendingScrubTime;
+
+    // trick play, over scrubbing
+    float     _trickPlayRate;
+    BOOL      _trickPlayResumes;
+    float     _trickPlayVolume;
+    NSTimeInterval _trickPlayTime;      // media time reached
+    NSTimeInterval _trickPlaySeekTime;  // of the last seek
+    CFTimeInterval _trickPlayTick;
+    NSTimer  *_trickPlayTimer;
+
+    IJKMediaFrameStepper *_frameStepper;
+    BOOL      _frameStepping;
+    BOOL      _frameSteppingResumes;
+    int       _frameSteppingGeneration;   // the handlers of a former stepping are ignored
+    NSTimeInterval _frameSteppingTime;
+
+    NSMutableArray<UIView<IJKSDLRenderView> *> *_outputViews;
     NSInteger _bufferingTime;
     NSInteger _bufferingPosition;
 
     BOOL _keepScreenOnWhilePlaying;
     BOOL _pauseInBackground;
+    BOOL _videoSuspended;
     BOOL _isVideoToolboxOpen;
     BOOL _playingBeforeInterruption;
 
@@ -72,7 +173,95 @@ static const char *kIJKFFRequiredFFmpegVersion = "ff3.3--ijk0.8.0--20170710--001
     AVAppAsyncStatistic _asyncStat;
     IjkIOAppCacheStatistic _cacheStat;
     BOOL _shouldShowHudView;
-    NSTimer *_hudTimer;
+    id   _hudObserver;
+    dispatch_queue_t _hudQueue;
+    // the player in the black box, sampled from the first core to shutdown
+    int      _blackBoxPlayer;
+    id       _blackBoxObserver;
+    int64_t  _blackBoxRebufferStart;
+    IJKFFStatisticsSampler *_statisticsSampler;
+    IJKFFStartupRecorder *_startupRecorder;
+
+    int64_t _memoryBudget;
+    IJKFFMemoryShedLevel _memoryShedLevel;
+    // read by the async ring on its io thread
+    volatile int64_t _maxReadAheadMemory;
+
+    NSTimer *_liveLatencyTimer;
+    int      _liveTargetLatency;
+    int      _liveMaxLatency;
+    float    _liveMaxCatchUpRate;
+    float    _liveCatchUpRate;
+    int64_t  _liveTimeshiftSize;
+
+    // the ffconcat script of a queue, appended to by enqueue
+    NSString *_queuePath;
+
+    // what an ijkmediadatasource: url reads, while the player lives
+    IJKMediaDataSourceLink *_mediaDataSourceLink;
+
+    BOOL     _adaptiveDecodeDegradation;
+    NSTimer *_decodeLoadTimer;
+    IJKFFDecodeDegradationLevel _decodeDegradationLevel;
+    IJKFFDecodeDegradationLevel _minimumDecodeDegradationLevel;
+    int      _decodeBehindSamples;
+    int      _decodeKeptUpSamples;
+    int      _decodeRecoveryBackoff;
+
+    BOOL     _thermalPolicy;
+    IJKFFThermalPolicyLevel _thermalPolicyLevel;
+    BOOL     _sharedThroughputEstimate;
+    // read by the hls demuxer on its io thread, 0 for no cap
+    volatile int64_t _thermalMaxBitrate;
+    volatile int64_t _maxBitrate;
+    CGFloat   _maximumFrameRate;
+
+    // the audio stream selected, closed while audio is disabled
+    NSInteger _audioStream;
+    BOOL      _audioDisabled;
+    // the video stream, closed while audio only; _audioOnlyActive is read
+    // by the hls demuxer on its io thread
+    NSInteger _videoStream;
+    BOOL      _audioOnly;
+    BOOL      _audioOnlyInBackground;
+    BOOL      _backgroundAudioOnly;
+    volatile BOOL _audioOnlyActive;
+
+    // polled on the main thread, at the rate the handler asked for
+    void    (^_audioAnalysisHandler)(IJKFFAudioAnalysis analysis);
+    NSTimer  *_audioAnalysisTimer;
+    unsigned  _audioAnalysisSerial;
+
+    // fed by the view and the audio output, see syncProbeEnabled
+    IJKSDLSyncProbe *_syncProbe;
+
+    // fired by the view as the VideoToolbox frames are presented
+    void    (^_timedMetadataHandler)(NSArray<IJKFFTimedMetadata *> *metadata);
+    dispatch_queue_t _timedMetadataQueue;
+
+    // see -hibernate: the core is released, the view shows the poster
+    BOOL            _hibernating;
+    BOOL            _hibernationPlaying;
+    NSTimeInterval  _hibernationTime;
+    UIImageView    *_posterView;
+
+    // the informational inject events, off the io threads
+    dispatch_queue_t  _injectQueue;
+    IJKInjectHookStat _injectHookStats[IJK_INJECT_HOOK_COUNT];
+
+    // the threads of the core, by role
+    IJKSDLThreadGroup *_threadGroup;
+    BOOL               _runsAtBackgroundQoS;
+
+    // of the media, for the energy estimate of the monitor: the bytes
+    // received split by the interface they came in on, accounted at each
+    // read of the monitor and each change of interface
+    int64_t _energyWifiBytes;
+    int64_t _energyCellularBytes;
+    int64_t _energyTrafficBase;
+    BOOL    _energyCellular;
+    int64_t _energyPresentedBase;   // of the view, when the media was set
+    int64_t _energyDroppedBase;
 }
 
 @synthesize view = _view;
@@ -97,9 +286,132 @@ static const char *kIJKFFRequiredFFmpegVersion = "ff3.3--ijk0.8.0--20170710--001
 @synthesize isDanmakuMediaAirPlay = _isDanmakuMediaAirPlay;
 
 @synthesize monitor = _monitor;
+@synthesize startupReport = _startupReport;
+@synthesize shutdownReport = _shutdownReport;
 
 #define FFP_IO_STAT_STEP (50 * 1024)
 
+// a stall with this much video queued is the decoder's, not the network's
+#define IJK_REBUFFER_DECODER_MIN_CACHED_MS 500
+
+// what the async ring and the packet queues are cut to when shedding memory
+#define IJK_MEMORY_SHED_READ_AHEAD       (1 * 1024 * 1024)
+#define IJK_MEMORY_SHED_MIN_PACKET_BYTES (2 * 1024 * 1024)
+
+// messages handed to the message queue in one block, at most
+#define IJK_MSG_BATCH_MAX 64
+
+// the controller is closed by then, whether or not its core is torn down
+#define IJK_SHUTDOWN_CLOSE_BOUND_MS 500
+
+// buffered before the first frame, the more the slower the network the
+// other sessions measured: the least at IJK_FIRST_BUFFER_FAST_BANDWIDTH
+#define IJK_FIRST_BUFFER_MIN_MS         100
+#define IJK_FIRST_BUFFER_MAX_MS         1000
+#define IJK_FIRST_BUFFER_FAST_BANDWIDTH (8 * 1000 * 1000)
+
+// seconds between the samples of a player written to the black box
+#define IJK_BLACKBOX_SAMPLE_INTERVAL    1.0
+
+static atomic_int g_reaping;    // cores being torn down
+
+// the format option "mirrors": the origins of the urls, separated by '|'
+static NSString *mirrorsOption(NSArray<NSURL *> *urls)
+{
+    NSMutableArray<NSString *> *origins = [NSMutableArray array];
+    for (NSURL *url in urls) {
+        NSString *scheme = url.scheme.lowercaseString;
+        if (!url.host.length || !([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"]))
+            continue;
+        [origins addObject:url.port ? [NSString stringWithFormat:@"%@://%@:%@", scheme, url.host, url.port]
+                                    : [NSString stringWithFormat:@"%@://%@", scheme, url.host]];
+    }
+    return [origins componentsJoinedByString:@"|"];
+}
+
+static BOOL useMetalViewFor(IJKFFOptions *options)
+{
+    return !options.useSampleBufferView && options.useMetalView && [IJKSDLMetalView isSupported];
+}
+
+// The codec options "threads" and "thread_type" of the software video
+// decoder for player option "video-threading", chosen before the stream and
+// its codec are known. Low delay slices each frame on every core, frame
+// threads holding back threads - 1 frames; a codec without slice threads
+// decodes on one. Throughput prefers frame threads on the performance
+// cores: a frame thread on an efficiency core holds back the frames
+// referencing it. A codec without frame threads slices on them instead.
+// Frame threads are capped to two on the 32-bit devices, each thread
+// keeping its own frames. With the slice threads pooled, frame threads,
+// which cannot be, give way to them while other players decode in software.
+static void setVideoThreading(IjkMediaPlayer *mediaPlayer, IJKVideoThreading threading, BOOL live, BOOL pooled)
+{
+    IJKDeviceModel *model       = [IJKDeviceModel currentModel];
+    int             performance = MAX((int)[IJKDeviceModel performanceCoreCount], 1);
+    int             efficiency  = MAX((int)[IJKDeviceModel efficiencyCoreCount], 0);
+    int             threads;
+    const char     *type;
+
+    if (threading == IJK_VIDEO_THREADING_MANUAL)
+        return;
+    if (threading == IJK_VIDEO_THREADING_LOW_DELAY || (threading == IJK_VIDEO_THREADING_AUTO && live) ||
+        (pooled && [IJKMediaGovernor sharedGovernor].softwareDecoderCount > 0)) {
+        threads = performance + efficiency;
+        type    = "slice";
+    } else {
+        threads = performance;
+        if (model && model.rank < kIJKDeviceRank_AppleA7Class)
+            threads = MIN(threads, 2);
+        type    = "frame+slice";
+    }
+    threads = MIN(threads, 8);
+
+    ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_CODEC, "threads", threads);
+    ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_CODEC, "thread_type", type);
+    NSLog(@"video decoder threads: %d %s\n", threads, type);
+}
+
+// Tear a core down off the main thread: stopped at once, which aborts its
+// io, then its threads joined, each core on a thread of its own so a
+// stuck one delays no other. The references the core keeps on the
+// controller and its holders are dropped on the main thread, with it.
+static void ijk_reap_player(IjkMediaPlayer *mp, int64_t begin, void (^done)(IJKFFShutdownReport report))
+{
+    static dispatch_queue_t reaper;
+    static dispatch_once_t  once;
+    dispatch_once(&once, ^{
+        reaper = dispatch_queue_create("tv.danmaku.ijk.reaper",
+                                       dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_UTILITY, 0));
+    });
+
+    IJKFFShutdownReport report = {0};
+    report.inFlight = atomic_fetch_add(&g_reaping, 1);
+    dispatch_async(reaper, ^{
+        IJKFFShutdownReport stats = report;
+        int64_t queued = (int64_t)SDL_GetTickHR();
+        ijkmp_stop(mp);
+        int64_t stopped = (int64_t)SDL_GetTickHR();
+        ijkmp_shutdown(mp);
+        int64_t joined = (int64_t)SDL_GetTickHR();
+        atomic_fetch_sub(&g_reaping, 1);
+
+        stats.stop = stopped - queued;
+        stats.join = joined - stopped;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            IJKFFShutdownReport final = stats;
+            final.total = (int64_t)SDL_GetTickHR() - begin;
+            if (done)
+                done(final);
+
+            IjkMediaPlayer *player = mp;
+            __unused id weakPlayer = (__bridge_transfer IJKFFMoviePlayerController*)ijkmp_set_weak_thiz(player, NULL);
+            __unused id weakHolder = (__bridge_transfer IJKWeakHolder*)ijkmp_set_inject_opaque(player, NULL);
+            __unused id weakijkHolder = (__bridge_transfer IJKWeakHolder*)ijkmp_set_ijkio_inject_opaque(player, NULL);
+            ijkmp_dec_ref_p(&player);
+        });
+    });
+}
+
 // as an example
 void IJKFFIOStatDebugCallback(const char *url, int type, int bytes)
 {
@@ -167,16 +479,86 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
     if (aUrlString == nil)
         return nil;
 
-    self = [super init];
-    if (self) {
-        ijkmp_global_init();
-        ijkmp_global_set_inject_callback(ijkff_inject_callback);
+    int64_t globalInit = [IJKFFMoviePlayerController setupProcess];
+    if (options == nil)
+        options = [IJKFFOptions optionsByDefault];
+
+    return [self initWithContentURLString:aUrlString
+                                  options:options
+                              mediaPlayer:NULL
+                               globalInit:globalInit];
+}
+
++ (void)playerWithContentURLString:(NSString *)aUrlString
+                       withOptions:(IJKFFOptions *)options
+                        completion:(void (^)(IJKFFMoviePlayerController *player))completion
+{
+    if (aUrlString == nil) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(nil);
+        });
+        return;
+    }
+    if (options == nil)
+        options = [IJKFFOptions optionsByDefault];
+
+    static dispatch_queue_t queue;
+    static dispatch_once_t  once;
+    dispatch_once(&once, ^{
+        queue = dispatch_queue_create("tv.danmaku.ijk.player-setup",
+                                      dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0));
+    });
+    // everything but UIKit: the view and its binding follow on the main thread
+    dispatch_async(queue, ^{
+        int64_t globalInit = [IJKFFMoviePlayerController setupProcess];
+        IjkMediaPlayer *mediaPlayer = [IJKFFMoviePlayerController createCoreWithOptions:options
+                                                                           useMetalView:useMetalViewFor(options)
+                                                                         shouldAutoplay:YES];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion([[IJKFFMoviePlayerController alloc] initWithContentURLString:aUrlString
+                                                                            options:options
+                                                                        mediaPlayer:mediaPlayer
+                                                                         globalInit:globalInit]);
+        });
+    });
+}
+
+// process-wide, on any thread; returns the time of the global init
++ (int64_t)setupProcess
+{
+    int64_t globalInitStart = (int64_t)SDL_GetTickHR();
+    ijkmp_global_init();
+    int64_t globalInit = (int64_t)SDL_GetTickHR() - globalInitStart;
+    ijkmp_global_set_inject_callback(ijkff_inject_callback);
 
-        [IJKFFMoviePlayerController checkIfFFmpegVersionMatch:NO];
+    [IJKFFMoviePlayerController checkIfFFmpegVersionMatch:NO];
 
-        if (options == nil)
-            options = [IJKFFOptions optionsByDefault];
+#ifdef DEBUG
+    [IJKFFMoviePlayerController setLogLevel:k_IJK_LOG_DEBUG];
+#else
+    [IJKFFMoviePlayerController setLogLevel:k_IJK_LOG_SILENT];
+#endif
+    // init audio sink
+    [[IJKAudioKit sharedInstance] setupAudioSession];
+    // consulted when the video decoder opens
+    [IJKDeviceModel probeDecodeCapabilities];
+    // the throughput estimate is forgotten on network changes
+    [IJKNetworkMonitor start];
+    // the format option "http3" goes through it
+    [IJKHTTP3Transport start];
+    // the last minute of telemetry outlives a kill of the process
+    [IJKFFBlackBox start];
+    return globalInit;
+}
 
+// mediaPlayer: a core made by createCoreWithOptions:, or NULL for one made here
+- (id)initWithContentURLString:(NSString *)aUrlString
+                       options:(IJKFFOptions *)options
+                   mediaPlayer:(IjkMediaPlayer *)mediaPlayer
+                    globalInit:(int64_t)globalInit
+{
+    self = [super init];
+    if (self) {
         // IJKFFIOStatRegister(IJKFFIOStatDebugCallback);
         // IJKFFIOStatCompleteRegister(IJKFFIOStatCompleteDebugCallback);
 
@@ -186,25 +568,45 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
         memset(&_asyncStat, 0, sizeof(_asyncStat));
         memset(&_cacheStat, 0, sizeof(_cacheStat));
         _monitor = [[IJKFFMonitor alloc] init];
+        _injectQueue = dispatch_queue_create("tv.danmaku.ijk.inject",
+                                             dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+        _liveTargetLatency  = options.liveTargetLatency;
+        _liveMaxLatency     = options.liveMaxLatency;
+        _liveMaxCatchUpRate = options.liveMaxCatchUpRate;
+        _liveCatchUpRate    = 1.0f;
+        _liveTimeshiftSize  = options.liveTimeshiftSize;
+        _adaptiveDecodeDegradation = options.adaptiveDecodeDegradation;
+        _audioStream        = -1;
+        _videoStream        = -1;
+        _thermalPolicy      = options.thermalPolicy;
+        _sharedThroughputEstimate = options.sharedThroughputEstimate;
 
         // init media resource
         _urlString = aUrlString;
 
-        // init player
-        _mediaPlayer = ijkmp_ios_create(media_player_msg_loop);
-        _msgPool = [[IJKFFMoviePlayerMessagePool alloc] init];
-        IJKWeakHolder *weakHolder = [IJKWeakHolder new];
-        weakHolder.object = self;
-
-        ijkmp_set_weak_thiz(_mediaPlayer, (__bridge_retained void *) self);
-        ijkmp_set_inject_opaque(_mediaPlayer, (__bridge_retained void *) weakHolder);
-        ijkmp_set_ijkio_inject_opaque(_mediaPlayer, (__bridge_retained void *)weakHolder);
-        ijkmp_set_option_int(_mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "start-on-prepared", _shouldAutoplay ? 1 : 0);
-
         // init video sink
-        _glView = [[IJKSDLGLView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+        _useSampleBufferView = options.useSampleBufferView;
+        _useMetalView = useMetalViewFor(options);
+        _msgPool = [[IJKFFMoviePlayerMessagePool alloc] init];
+        _messageQueue = dispatch_get_main_queue();
+        if (_useSampleBufferView)
+            _glView = [[IJKSDLSampleBufferView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+        else if (_useMetalView)
+            _glView = [[IJKSDLMetalView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
+        else
+            _glView = [[IJKSDLGLView alloc] initWithFrame:[[UIScreen mainScreen] bounds]];
         _glView.shouldShowHudView = NO;
+        _glView.prefersPixelBufferOverlays = options.usePixelBufferOverlays;
+        if (_useMetalView) {
+            IJKSDLMetalView *metalView = (IJKSDLMetalView *)_glView;
+            metalView.deinterlaceMode  = (IJKSDLMetalDeinterlaceMode)options.videoDeinterlaceMode;
+            metalView.scalingFilter    = (IJKSDLMetalScalingFilter)options.videoScalingFilter;
+            metalView.sharpness        = options.videoSharpness;
+        }
         _view   = _glView;
+        _statisticsSampler = [[IJKFFStatisticsSampler alloc] initWithView:_glView];
+        _startupRecorder   = [[IJKFFStartupRecorder alloc] init];
+        [_startupRecorder setGlobalInit:globalInit];
         [_glView setHudValue:nil forKey:@"scheme"];
         [_glView setHudValue:nil forKey:@"host"];
         [_glView setHudValue:nil forKey:@"path"];
@@ -220,18 +622,17 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
         
         self.shouldShowHudView = options.showHudView;
 
-        ijkmp_ios_set_glview(_mediaPlayer, _glView);
-        ijkmp_set_option(_mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "overlay-format", "fcc-_es2");
-#ifdef DEBUG
-        [IJKFFMoviePlayerController setLogLevel:k_IJK_LOG_DEBUG];
-#else
-        [IJKFFMoviePlayerController setLogLevel:k_IJK_LOG_SILENT];
-#endif
-        // init audio sink
-        [[IJKAudioKit sharedInstance] setupAudioSession];
+        _blackBoxPlayer = ijk_blackbox_new_player();
 
-        [options applyTo:_mediaPlayer];
+        // init player
+        _options = options;
+        if (mediaPlayer)
+            [self bindMediaPlayer:mediaPlayer];
+        else
+            [self createMediaPlayer];
         _pauseInBackground = NO;
+        // picture in picture keeps showing the sample buffer layer
+        _suspendsVideoInBackground = !_useSampleBufferView;
 
         // init extra
         _keepScreenOnWhilePlaying = YES;
@@ -239,10 +640,356 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
 
         _notificationManager = [[IJKNotificationManager alloc] init];
         [self registerApplicationObservers];
+        [self refreshThermalPolicy];
+    }
+    return self;
+}
+
+// a player core bound to the view, the one created by init or a fresh one after a reset
+- (void)createMediaPlayer
+{
+    [self bindMediaPlayer:[IJKFFMoviePlayerController createCoreWithOptions:_options
+                                                               useMetalView:_useMetalView
+                                                             shouldAutoplay:_shouldAutoplay]];
+}
+
+// a core with the options applied, on any thread: nothing of it waits for the view
++ (IjkMediaPlayer *)createCoreWithOptions:(IJKFFOptions *)options
+                             useMetalView:(BOOL)useMetalView
+                           shouldAutoplay:(BOOL)shouldAutoplay
+{
+    IjkMediaPlayer *mediaPlayer;
+
+    if (options.useSampleBufferView)
+        mediaPlayer = ijkmp_ios_create_for_sample_buffer(media_player_msg_loop);
+    else if (useMetalView)
+        mediaPlayer = ijkmp_ios_create_for_metal(media_player_msg_loop);
+    else
+        mediaPlayer = ijkmp_ios_create(media_player_msg_loop);
+
+    ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "start-on-prepared", shouldAutoplay ? 1 : 0);
+    if (options.useSampleBufferView || useMetalView) {
+        ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "overlay-format", "fcc-i420");
+        // the layer shows 10-bit and HDR frames itself
+        ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "videotoolbox-hdr", 1);
+    } else {
+        ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "overlay-format", "fcc-_es2");
+    }
+
+    // AV1 decodes in software only, its variants are left to the devices
+    // keeping up; set before the options, which may override it
+    if (!avcodec_find_decoder(AV_CODEC_ID_AV1) || ![IJKDeviceModel decodesAV1InSoftware])
+        ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "exclude_codecs", "av01");
+    [options applyTo:mediaPlayer];
+    if (!options.sharedThroughputEstimate)
+        ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "shared_estimate", 0);
+    NSString *mirrors = mirrorsOption(options.mirrorURLs);
+    if (mirrors.length > 0)
+        ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "mirrors", mirrors.UTF8String);
+    if (options.liveTimeshiftSize > 0) {
+        // the window is played back as it is, never skipped through
+        ijkmp_set_option(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "timeshift_dir", [NSTemporaryDirectory() fileSystemRepresentation]);
+        ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "timeshift_size", options.liveTimeshiftSize);
+    } else if (options.liveMaxLatency > 0) {
+        ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "live_max_latency", options.liveMaxLatency);
+        ijkmp_set_option_int(mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "live_target_latency", options.liveTargetLatency);
+    }
+    return mediaPlayer;
+}
+
+// main thread
+- (void)bindMediaPlayer:(IjkMediaPlayer *)mediaPlayer
+{
+    _mediaPlayer = mediaPlayer;
+    _weakHolder = [IJKWeakHolder new];
+    _weakHolder.object = self;
+    IJKSDLThreadGroup_releasep(&_threadGroup);
+    _threadGroup = IJKSDLThreadGroup_create();
+    IJKSDLThreadGroup_setBackground(_threadGroup, [self appliesBackgroundQoS]);
+    ijkmp_ios_set_decode_background(_mediaPlayer, [self appliesBackgroundQoS]);
+    ijkmp_ios_set_frame_queue_budget(_mediaPlayer, _memoryBudget / 4);
+
+    ijkmp_set_weak_thiz(_mediaPlayer, (__bridge_retained void *) self);
+    ijkmp_set_inject_opaque(_mediaPlayer, (__bridge_retained void *) _weakHolder);
+    ijkmp_set_ijkio_inject_opaque(_mediaPlayer, (__bridge_retained void *) _weakHolder);
+    [_statisticsSampler setMediaPlayer:_mediaPlayer];
+    [_statisticsSampler resetEvents];
+    [self startBlackBox];
+
+    if (_useSampleBufferView)
+        ijkmp_ios_set_sample_buffer_view(_mediaPlayer, (IJKSDLSampleBufferView *)_glView);
+    else if (_useMetalView)
+        ijkmp_ios_set_metal_view(_mediaPlayer, (IJKSDLMetalView *)_glView);
+    else
+        ijkmp_ios_set_glview(_mediaPlayer, (IJKSDLGLView *)_glView);
+
+    // VideoToolbox decodes no more pixels than the view shows, see
+    // "videotoolbox-scale-to-view"; called right away with the current size
+    __weak IJKFFMoviePlayerController *weakSelf = self;
+    _glView.displaySizeHandler = ^(CGSize pixelSize) {
+        IJKFFMoviePlayerController *strongSelf = weakSelf;
+        if (strongSelf && strongSelf->_mediaPlayer)
+            ijkmp_ios_set_video_output_size(strongSelf->_mediaPlayer, (int)pixelSize.width, (int)pixelSize.height);
+    };
+    if (_outputViews.count > 0)
+        ijkmp_ios_set_render_outputs(_mediaPlayer, _outputViews);
+    if (_minimumDecodeDegradationLevel > IJKFFDecodeDegradationNone)
+        ijkmp_ios_set_decode_degradation(_mediaPlayer, (int)_minimumDecodeDegradationLevel);
+    if (_audioAnalysisHandler || _loudnessNormalizationTarget != 0)
+        [self applyAudioAnalysis];
+    if (_syncProbe)
+        ijkmp_ios_set_sync_probe(_mediaPlayer, _syncProbe.probe);
+    if (_timedMetadataHandler)
+        [self applyTimedMetadata];
+}
+
+// ffconcat quoting: within quotes, a quote is written '\''
+static NSData *queueScriptLine(NSString *urlString)
+{
+    NSString *quoted = [urlString stringByReplacingOccurrencesOfString:@"'" withString:@"'\\''"];
+    return [[NSString stringWithFormat:@"file '%@'\n", quoted] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (id)initWithContentURLStrings:(NSArray<NSString *> *)urlStrings
+                    withOptions:(IJKFFOptions *)options
+{
+    if (urlStrings.count == 0)
+        return nil;
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:
+                      [NSString stringWithFormat:@"ijkqueue-%@.ffconcat", [[NSUUID UUID] UUIDString]]];
+    NSMutableData *script = [[@"ffconcat version 1.0\n" dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    for (NSString *urlString in urlStrings)
+        [script appendData:queueScriptLine(urlString)];
+    if (![script writeToFile:path atomically:YES])
+        return nil;
+
+    self = [self initWithContentURLString:path withOptions:options];
+    if (self) {
+        _queuePath = path;
+        // the demuxer reads the script again as the last url plays
+        [self setFormatOptionIntValue:1 forKey:@"follow"];
+    } else {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
     }
     return self;
 }
 
+- (id)initWithMediaDataSource:(IJKMediaDataSourceLink *)link
+                  withOptions:(IJKFFOptions *)options
+{
+    if (link == nil)
+        return nil;
+
+    self = [self initWithContentURLString:link.urlString withOptions:options];
+    if (self)
+        _mediaDataSourceLink = link;
+    return self;
+}
+
+- (void)enqueueContentURLString:(NSString *)urlString
+{
+    if (!_queuePath || urlString == nil)
+        return;
+
+    // one write, the demuxer skips a line until its end is there
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:_queuePath];
+    [handle seekToEndOfFile];
+    [handle writeData:queueScriptLine(urlString)];
+    [handle closeFile];
+}
+
+- (void)removeQueue
+{
+    if (!_queuePath)
+        return;
+
+    // the core may still read it while it is torn down, the file stays open
+    [[NSFileManager defaultManager] removeItemAtPath:_queuePath error:nil];
+    _queuePath = nil;
+}
+
+- (void)resetWithContentURL:(NSURL *)aUrl
+{
+    if (aUrl == nil)
+        return;
+
+    [self resetWithContentURLString:[aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString]];
+}
+
+- (void)resetWithContentURLString:(NSString *)aUrlString
+{
+    if ((!_mediaPlayer && !_hibernating) || aUrlString == nil)
+        return;
+
+    if (_mediaPlayer)
+        [self releaseMediaPlayer];
+    [self removeQueue];
+    [self removePoster];
+    _hibernating        = NO;
+
+    _urlString          = aUrlString;
+    [self resetPlaybackState];
+    _videoWidth         = 0;
+    _videoHeight        = 0;
+    _naturalSize        = CGSizeZero;
+    _fpsInMeta          = 0;
+    _glView.contentFrameRate = 0;
+    for (UIView<IJKSDLRenderView> *outputView in _outputViews)
+        outputView.contentFrameRate = 0;
+    // the variant the cap was halved from belongs to the former media
+    if (_thermalPolicyLevel == IJKFFThermalPolicyReducedQuality)
+        _thermalMaxBitrate  = 0;
+    _monitor = [[IJKFFMonitor alloc] init];
+    [_glView.frameLatency reset];
+    [self resetEnergyAccounting];
+
+    [self createMediaPlayer];
+}
+
+// the core torn down in the background, with what ran on it; the view and
+// the media stay
+- (void)releaseMediaPlayer
+{
+    [self stopHudTimer];
+    [self stopLiveLatencyTimer];
+    [self stopDecodeLoadTimer];
+    [self cancelTrickPlay];
+    [self cancelFrameStepping];
+    [self reportStartup:YES];
+
+    // the former core keeps running until it is stopped in the background,
+    // its messages and callbacks must not reach the new media
+    IjkMediaPlayer *formerPlayer = _mediaPlayer;
+    _mediaPlayer = NULL;
+    [_statisticsSampler setMediaPlayer:NULL];
+    _weakHolder.object = nil;
+    if (_useSampleBufferView)
+        ijkmp_ios_set_sample_buffer_view(formerPlayer, nil);
+    else if (_useMetalView)
+        ijkmp_ios_set_metal_view(formerPlayer, nil);
+    else
+        ijkmp_ios_set_glview(formerPlayer, nil);
+    ijk_reap_player(formerPlayer, (int64_t)SDL_GetTickHR(), nil);
+
+    [_thumbnailer cancelAll];
+    _thumbnailer        = nil;
+    [_scrubPreviews cancel];
+    _scrubPreviews      = nil;
+    _frameStepper       = nil;
+    [_seekPrefetcher cancelAll];
+    _seekTargets        = nil;
+}
+
+// what the next core starts from, the media aside
+- (void)resetPlaybackState
+{
+    _isPreparedToPlay   = NO;
+    _playbackState      = IJKMPMoviePlaybackStateStopped;
+    _loadState          = IJKMPMovieLoadStateUnknown;
+    _seeking            = NO;
+    _firstVideoFrameRendered = NO;
+    _firstFrameRendered = NO;
+    _scrubbing          = NO;
+    _pendingScrubTime   = -1;
+    _videoSuspended     = NO;
+    _bufferingProgress  = 0;
+    _bufferingTime      = 0;
+    _bufferingPosition  = 0;
+    _liveCatchUpRate    = 1.0f;
+    _decodeDegradationLevel = _minimumDecodeDegradationLevel;
+    _audioStream        = -1;
+    _videoStream        = -1;
+    _decodeBehindSamples    = 0;
+    _decodeKeptUpSamples    = 0;
+    _decodeRecoveryBackoff  = 0;
+    memset(&_asyncStat, 0, sizeof(_asyncStat));
+    memset(&_cacheStat, 0, sizeof(_cacheStat));
+    _memoryShedLevel    = IJKFFMemoryShedLevelNone;
+    _maxReadAheadMemory = 0;
+    memset(&_startupReport, 0, sizeof(_startupReport));
+}
+
+#pragma mark hibernation
+
+- (void)hibernate
+{
+    // a core never prepared holds nothing worth it
+    if (!_mediaPlayer || _hibernating || !_monitor.prepareStartTick)
+        return;
+
+    _hibernating        = YES;
+    _hibernationPlaying = ijkmp_is_playing(_mediaPlayer);
+    // a live stream resumes at its edge
+    _hibernationTime    = _isPreparedToPlay && [self duration] > 0 ? [self currentPlaybackTime] : 0;
+    [self setScreenOn:NO];
+
+    // the frame capture keeps the last frame past the core, the poster is
+    // grabbed from it before the view lets go of everything
+    __weak IJKFFMoviePlayerController *weakSelf = self;
+    [_glView captureFrame:^(UIImage *image) {
+        IJKFFMoviePlayerController *strongSelf = weakSelf;
+        if (!strongSelf || !strongSelf->_hibernating)
+            return;
+        [strongSelf showPoster:image];
+        [strongSelf->_glView releaseDrawables];
+        for (UIView<IJKSDLRenderView> *outputView in strongSelf->_outputViews)
+            [outputView releaseDrawables];
+    }];
+
+    [self releaseMediaPlayer];
+    [self resetPlaybackState];
+}
+
+- (void)resumeFromHibernation
+{
+    if (!_hibernating)
+        return;
+
+    _hibernating = NO;
+    // the session of the size the media had is ready by the first packet
+    if (_videoWidth > 0 && _videoHeight > 0)
+        ijkmp_ios_videotoolbox_warmup((int)_videoWidth, (int)_videoHeight);
+
+    [self createMediaPlayer];
+    ijkmp_set_option_int(_mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "start-on-prepared", _hibernationPlaying ? 1 : 0);
+    if (_hibernationTime > 0)
+        ijkmp_set_option_int(_mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "seek-at-start", (int64_t)(_hibernationTime * 1000));
+    [self prepareToPlay];
+    if (_hibernationPlaying)
+        [[IJKMediaGovernor sharedGovernor] playerWillPlay:self];
+}
+
+- (BOOL)isHibernating
+{
+    return _hibernating;
+}
+
+// over the view until the first frame of the core resumed
+- (void)showPoster:(UIImage *)image
+{
+    _hibernationPoster = image;
+    if (!image)
+        return;
+
+    if (!_posterView) {
+        _posterView = [[UIImageView alloc] initWithFrame:_view.bounds];
+        _posterView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+        _posterView.backgroundColor  = [UIColor blackColor];
+        _posterView.clipsToBounds    = YES;
+    }
+    _posterView.contentMode = _view.contentMode;
+    _posterView.image       = image;
+    [_view addSubview:_posterView];
+}
+
+- (void)removePoster
+{
+    [_posterView removeFromSuperview];
+    _posterView        = nil;
+    _hibernationPoster = nil;
+}
+
 - (void)setScreenOn: (BOOL)on
 {
     [IJKMediaModule sharedModule].mediaModuleIdleTimerDisabled = on;
@@ -252,6 +999,8 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
 - (void)dealloc
 {
 //    [self unregisterApplicationObservers];
+    [self removeQueue];
+    IJKSDLThreadGroup_releasep(&_threadGroup);
 }
 
 - (void)setShouldAutoplay:(BOOL)shouldAutoplay
@@ -269,18 +1018,102 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
     return _shouldAutoplay;
 }
 
+- (void)setRunsAtBackgroundQoS:(BOOL)runsAtBackgroundQoS
+{
+    _runsAtBackgroundQoS = runsAtBackgroundQoS;
+    [self updateBackgroundQoS];
+}
+
+// the governor's priority, or a hot device
+- (BOOL)appliesBackgroundQoS
+{
+    return _runsAtBackgroundQoS || _thermalPolicyLevel >= IJKFFThermalPolicyReducedQuality;
+}
+
+- (void)updateBackgroundQoS
+{
+    IJKSDLThreadGroup_setBackground(_threadGroup, [self appliesBackgroundQoS]);
+    if (_mediaPlayer)
+        ijkmp_ios_set_decode_background(_mediaPlayer, [self appliesBackgroundQoS]);
+}
+
+- (BOOL)runsAtBackgroundQoS
+{
+    return _runsAtBackgroundQoS;
+}
+
 - (void)prepareToPlay
 {
+    if (_hibernating) {
+        [self resumeFromHibernation];
+        return;
+    }
     if (!_mediaPlayer)
         return;
 
     [self setScreenOn:_keepScreenOnWhilePlaying];
 
-    ijkmp_set_data_source(_mediaPlayer, [_urlString UTF8String]);
+    NSString *urlString = _urlString;
+    if (_liveTimeshiftSize > 0 && ([urlString hasPrefix:@"http:"] ||
+                                   [urlString hasPrefix:@"https:"] ||
+                                   [urlString hasPrefix:@"rtmp:"]))
+        urlString = [@"timeshift:" stringByAppendingString:urlString];
+    ijkmp_set_data_source(_mediaPlayer, [urlString UTF8String]);
     ijkmp_set_option(_mediaPlayer, IJKMP_OPT_CATEGORY_FORMAT, "safe", "0"); // for concat demuxer
+    [self seedFirstBuffering];
+    [self applyVideoThreading];
 
     _monitor.prepareStartTick = (int64_t)SDL_GetTickHR();
+    _firstVideoFrameRendered  = NO;
+    _firstFrameRendered       = NO;
+    [_startupRecorder startAtTick:_monitor.prepareStartTick];
+    // every thread of the core descends from the ones started here
+    IJKSDLThreadGroup_enter(_threadGroup);
     ijkmp_prepare_async(_mediaPlayer);
+    IJKSDLThreadGroup_enter(NULL);
+}
+
+// "video-thread-pool": 1 (default) the slice threads of the player run on
+// its client of the process wide pool, so several players decoding at once
+// do not oversubscribe the cores; its priority follows appliesBackgroundQoS.
+// The threads are left alone if the app set the "threads" codec option
+- (void)applyVideoThreading
+{
+    id  pool   = [_options optionValueForKey:@"video-thread-pool" ofCategory:kIJKFFOptionCategoryPlayer];
+    int client = !pool || [pool intValue] ? ijkmp_ios_get_slice_pool_client(_mediaPlayer) : 0;
+    if (client)
+        ijkmp_set_option_int(_mediaPlayer, IJKMP_OPT_CATEGORY_CODEC, "thread_pool", client);
+
+    if ([_options optionValueForKey:@"threads" ofCategory:kIJKFFOptionCategoryCodec])
+        return;
+
+    id threading = [_options optionValueForKey:@"video-threading" ofCategory:kIJKFFOptionCategoryPlayer];
+    setVideoThreading(_mediaPlayer, threading ? (IJKVideoThreading)[threading intValue] : IJK_VIDEO_THREADING_MANUAL,
+                      [self likelyLive], client != 0);
+}
+
+// live by what is known before the stream opens: the live options, or a
+// protocol without a duration. A live HLS playlist is taken as on demand
+- (BOOL)likelyLive
+{
+    if (_liveTargetLatency > 0 || _liveMaxLatency > 0 || _liveTimeshiftSize > 0)
+        return YES;
+
+    NSString *scheme = [NSURL URLWithString:_urlString].scheme.lowercaseString;
+    return [scheme hasPrefix:@"rtmp"] || [scheme isEqualToString:@"rtsp"] || [scheme isEqualToString:@"rtp"] ||
+           [scheme isEqualToString:@"udp"] || [scheme isEqualToString:@"srt"];
+}
+
+- (void)seedFirstBuffering
+{
+    ThroughputEstimate estimate;
+    if (!_sharedThroughputEstimate || av_throughput_get_estimate(_urlString.UTF8String, &estimate) < 0 ||
+        !estimate.bandwidth)
+        return;
+
+    int64_t milli = IJK_FIRST_BUFFER_MIN_MS * IJK_FIRST_BUFFER_FAST_BANDWIDTH / estimate.bandwidth;
+    milli = MIN(MAX(milli, IJK_FIRST_BUFFER_MIN_MS), IJK_FIRST_BUFFER_MAX_MS);
+    ijkmp_set_option_int(_mediaPlayer, IJKMP_OPT_CATEGORY_PLAYER, "first-high-water-mark-ms", milli);
 }
 
 - (void)setHudUrl:(NSString *)urlString
@@ -299,17 +1132,24 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
 
 - (void)play
 {
+    if (_hibernating) {
+        _hibernationPlaying = YES;
+        [self resumeFromHibernation];
+        return;
+    }
     if (!_mediaPlayer)
         return;
 
     [self setScreenOn:_keepScreenOnWhilePlaying];
 
+    [[IJKMediaGovernor sharedGovernor] playerWillPlay:self];
     [self startHudTimer];
     ijkmp_start(_mediaPlayer);
 }
 
 - (void)pause
 {
+    _hibernationPlaying = NO;
     if (!_mediaPlayer)
         return;
 
@@ -325,6 +1165,11 @@ void IJKFFIOStatCompleteRegister(void (*cb)(const char *url,
     [self setScreenOn:NO];
 
     [self stopHudTimer];
+    [self stopLiveLatencyTimer];
+    [self stopDecodeLoadTimer];
+    [self cancelTrickPlay];
+    [self cancelFrameStepping];
+    [self reportStartup:YES];
     ijkmp_stop(_mediaPlayer);
 }
 
@@ -393,14 +1238,138 @@ inline static int getPlayerOption(IJKFFOptionCategory category)
     ijkmp_set_option_int(_mediaPlayer, getPlayerOption(category), [key UTF8String], value);
 }
 
+static BOOL g_logReport;
+
+// the event log keeps verbose at least, and whatever is printed
+static void updateEventLogLevel(void)
+{
+    int level = MAX(AV_LOG_VERBOSE, av_log_get_level());
+    if (g_logReport)
+        level = MAX(level, AV_LOG_DEBUG);
+    ijk_evlog_set_av_level(level);
+}
+
 + (void)setLogReport:(BOOL)preferLogReport
 {
+    g_logReport = preferLogReport;
     ijkmp_global_set_log_report(preferLogReport ? 1 : 0);
+    updateEventLogLevel();
+    if (ijk_evlog_is_enabled())
+        av_log_set_callback(ijk_evlog_av_log_callback);
+}
+
++ (void)setEventLogEnabled:(BOOL)enabled
+{
+    // the core installs its av_log callback at its first init
+    ijkmp_global_init();
+    updateEventLogLevel();
+    ijk_evlog_set_enabled(enabled);
+    if (enabled)
+        av_log_set_callback(ijk_evlog_av_log_callback);
+    else
+        ijkmp_global_set_log_report(g_logReport ? 1 : 0);
+}
+
+static void appendEventLogLine(void *opaque, const char *text)
+{
+    NSMutableString *dump = (__bridge NSMutableString *)opaque;
+    [dump appendFormat:@"%s\n", text];
+}
+
++ (NSString *)eventLogDump
+{
+    NSMutableString *dump = [NSMutableString string];
+    ijk_evlog_dump(appendEventLogLine, (__bridge void *)dump);
+    return dump;
+}
+
++ (void)clearEventLog
+{
+    ijk_evlog_clear();
 }
 
 + (void)setLogLevel:(IJKLogLevel)logLevel
 {
     ijkmp_global_set_log_level(logLevel);
+    updateEventLogLevel();
+}
+
++ (void)setRegistrationAllowListFormats:(NSString *)formats codecs:(NSString *)codecs
+{
+    av_register_allow_list(formats.UTF8String, codecs.UTF8String);
+}
+
++ (void)prefetchDNSForURL:(NSURL *)aUrl
+{
+    NSString *host = aUrl.host;
+    if (host.length == 0)
+        return;
+
+    int port = aUrl.port.intValue;
+    if (port <= 0) {
+        NSString *scheme = aUrl.scheme.lowercaseString;
+        if ([scheme isEqualToString:@"https"])
+            port = 443;
+        else if ([scheme hasPrefix:@"rtmp"])
+            port = 1935;
+        else
+            port = 80;
+    }
+
+    av_dns_cache_prefetch(host.UTF8String, port);
+}
+
++ (void)prewarmVideoDecoder
+{
+    CGSize size = [UIScreen mainScreen].nativeBounds.size;
+    if (MAX(size.width, size.height) >= 1920)
+        [self prewarmVideoDecoderWithWidth:1920 height:1080];
+    else
+        [self prewarmVideoDecoderWithWidth:1280 height:720];
+}
+
++ (void)prewarmVideoDecoderWithWidth:(int)width height:(int)height
+{
+    ijkmp_ios_videotoolbox_warmup(width, height);
+}
+
++ (void)releasePrewarmedVideoDecoder
+{
+    ijkmp_ios_videotoolbox_warmup_release();
+}
+
++ (BOOL)setDiskCacheDirectory:(NSString *)directory maxSize:(int64_t)maxSize
+{
+    if (directory.length == 0)
+        return NO;
+
+    return av_disk_cache_configure(directory.fileSystemRepresentation, maxSize) == 0;
+}
+
++ (void)clearDiskCache
+{
+    av_disk_cache_clear();
+}
+
++ (BOOL)startRecordingNetworkTrace:(NSString *)path
+{
+    if (path.length == 0)
+        return NO;
+
+    return av_net_trace_start_recording(path.fileSystemRepresentation) == 0;
+}
+
++ (BOOL)startReplayingNetworkTrace:(NSString *)path
+{
+    if (path.length == 0)
+        return NO;
+
+    return av_net_trace_start_replay(path.fileSystemRepresentation) == 0;
+}
+
++ (void)stopNetworkTrace
+{
+    av_net_trace_stop();
 }
 
 + (BOOL)checkIfFFmpegVersionMatch:(BOOL)showAlert;
@@ -448,208 +1417,1238 @@ inline static int getPlayerOption(IJKFFOptionCategory category)
 
 - (void)shutdown
 {
-    if (!_mediaPlayer)
+    if (!_mediaPlayer && !_hibernating)
         return;
 
     [self stopHudTimer];
+    [self stopLiveLatencyTimer];
+    [self stopDecodeLoadTimer];
+    [self cancelTrickPlay];
+    [self cancelFrameStepping];
+    [_audioAnalysisTimer invalidate];
+    _audioAnalysisTimer = nil;
+    _glView.presentHandler = nil;
+    [self reportStartup:YES];
+    [self stopBlackBox];
+    [_statisticsSampler removeAllObservers];
+    [_thumbnailer cancelAll];
+    [_scrubPreviews cancel];
+    [_frameStepper cancelAll];
+    [_seekPrefetcher cancelAll];
+    _seekTargets = nil;
+    [[IJKMediaGovernor sharedGovernor] removePlayer:self];
     [self unregisterApplicationObservers];
     [self setScreenOn:NO];
 
-    [self performSelectorInBackground:@selector(shutdownWaitStop:) withObject:self];
-}
-
-- (void)shutdownWaitStop:(IJKFFMoviePlayerController *) mySelf
-{
-    if (!_mediaPlayer)
+    if (_hibernating) {
+        // the core is gone already
+        [self removePoster];
+        [self shutdownClose:self];
         return;
+    }
 
-    ijkmp_stop(_mediaPlayer);
-    ijkmp_shutdown(_mediaPlayer);
-
-    [self performSelectorOnMainThread:@selector(shutdownClose:) withObject:self waitUntilDone:YES];
+    // closed when the core is torn down, or at the bound if that takes
+    // longer; the core then goes on being torn down in the background
+    int64_t     begin  = (int64_t)SDL_GetTickHR();
+    __block BOOL closed = NO;
+    ijk_reap_player(_mediaPlayer, begin, ^(IJKFFShutdownReport report) {
+        report.timedOut = closed;
+        if (!closed) {
+            closed = YES;
+            [self shutdownClose:self];
+        }
+        _shutdownReport = report;
+        [[NSNotificationCenter defaultCenter]
+         postNotificationName:IJKMPMoviePlayerShutdownReportNotification
+         object:self];
+    });
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, IJK_SHUTDOWN_CLOSE_BOUND_MS * NSEC_PER_MSEC),
+                   dispatch_get_main_queue(), ^{
+        if (!closed) {
+            closed = YES;
+            [self shutdownClose:self];
+        }
+    });
 }
 
+// the core is dropped by ijk_reap_player
 - (void)shutdownClose:(IJKFFMoviePlayerController *) mySelf
 {
-    if (!_mediaPlayer)
+    if (!_mediaPlayer && !_hibernating)
         return;
 
     _segmentOpenDelegate    = nil;
+    _keyDelegate            = nil;
     _tcpOpenDelegate        = nil;
     _httpOpenDelegate       = nil;
     _liveOpenDelegate       = nil;
     _nativeInvokeDelegate   = nil;
 
-    __unused id weakPlayer = (__bridge_transfer IJKFFMoviePlayerController*)ijkmp_set_weak_thiz(_mediaPlayer, NULL);
-    __unused id weakHolder = (__bridge_transfer IJKWeakHolder*)ijkmp_set_inject_opaque(_mediaPlayer, NULL);
-    __unused id weakijkHolder = (__bridge_transfer IJKWeakHolder*)ijkmp_set_ijkio_inject_opaque(_mediaPlayer, NULL);
-    ijkmp_dec_ref_p(&_mediaPlayer);
+    _weakHolder.object = nil;
+    [_statisticsSampler setMediaPlayer:NULL];
+    _mediaPlayer = NULL;
+    _hibernating = NO;
+
+    [self didShutdown];
+}
+
+- (void)didShutdown
+{
+}
+
+- (IJKMPMoviePlaybackState)playbackState
+{
+    if (!_mediaPlayer)
+        return NO;
+
+    IJKMPMoviePlaybackState mpState = IJKMPMoviePlaybackStateStopped;
+    int state = ijkmp_get_state(_mediaPlayer);
+    switch (state) {
+        case MP_STATE_STOPPED:
+        case MP_STATE_COMPLETED:
+        case MP_STATE_ERROR:
+        case MP_STATE_END:
+            mpState = IJKMPMoviePlaybackStateStopped;
+            break;
+        case MP_STATE_IDLE:
+        case MP_STATE_INITIALIZED:
+        case MP_STATE_ASYNC_PREPARING:
+        case MP_STATE_PAUSED:
+            mpState = IJKMPMoviePlaybackStatePaused;
+            break;
+        case MP_STATE_PREPARED:
+        case MP_STATE_STARTED: {
+            if (_seeking)
+                mpState = IJKMPMoviePlaybackStateSeekingForward;
+            else
+                mpState = IJKMPMoviePlaybackStatePlaying;
+            break;
+        }
+    }
+    // IJKMPMoviePlaybackStatePlaying,
+    // IJKMPMoviePlaybackStatePaused,
+    // IJKMPMoviePlaybackStateStopped,
+    // IJKMPMoviePlaybackStateInterrupted,
+    // IJKMPMoviePlaybackStateSeekingForward,
+    // IJKMPMoviePlaybackStateSeekingBackward
+    return mpState;
+}
+
+- (void)setCurrentPlaybackTime:(NSTimeInterval)aCurrentPlaybackTime
+{
+    if (!_mediaPlayer)
+        return;
+
+    _seeking = YES;
+    [[NSNotificationCenter defaultCenter]
+     postNotificationName:IJKMPMoviePlayerPlaybackStateDidChangeNotification
+     object:self];
+
+    _seekTarget = aCurrentPlaybackTime;
+    _bufferingPosition = 0;
+    ijkmp_seek_to(_mediaPlayer, aCurrentPlaybackTime * 1000);
+}
+
+// the timeshift protocol seeks past the end of its window to the newest
+// key frame
+- (void)seekToLiveEdge
+{
+    if (!_mediaPlayer || _liveTimeshiftSize <= 0)
+        return;
+
+    [self setCurrentPlaybackTime:INT32_MAX / 1000];
+}
+
+- (void)selectAudioStream:(NSInteger)streamIndex
+{
+    if (!_mediaPlayer || streamIndex < 0)
+        return;
+
+    _audioStream = streamIndex;
+    if (!_audioDisabled)
+        ijkmp_set_stream_selected(_mediaPlayer, (int)streamIndex, 1);
+}
+
+- (void)setAudioEnabled:(BOOL)audioEnabled
+{
+    if (_audioDisabled == !audioEnabled)
+        return;
+
+    _audioDisabled = !audioEnabled;
+    if (_mediaPlayer && _audioStream >= 0)
+        ijkmp_set_stream_selected(_mediaPlayer, (int)_audioStream, audioEnabled ? 1 : 0);
+}
+
+- (BOOL)isAudioEnabled
+{
+    return !_audioDisabled;
+}
+
+// the video stream is closed while the app or the background wants audio only
+- (void)updateAudioOnly
+{
+    BOOL audioOnly = _audioOnly || _backgroundAudioOnly;
+    if (_audioOnlyActive == audioOnly)
+        return;
+
+    _audioOnlyActive = audioOnly;
+    if (_mediaPlayer && _videoStream >= 0)
+        ijkmp_set_stream_selected(_mediaPlayer, (int)_videoStream, audioOnly ? 0 : 1);
+}
+
+- (void)setAudioOnly:(BOOL)audioOnly
+{
+    _audioOnly = audioOnly;
+    [self updateAudioOnly];
+}
+
+- (BOOL)audioOnly
+{
+    return _audioOnly;
+}
+
+- (void)setAudioOnlyInBackground:(BOOL)audioOnlyInBackground
+{
+    _audioOnlyInBackground = audioOnlyInBackground;
+}
+
+- (BOOL)audioOnlyInBackground
+{
+    return _audioOnlyInBackground;
+}
+
+#pragma mark audio analysis
+
+- (void)setAudioAnalysisHandler:(void (^)(IJKFFAudioAnalysis analysis))handler rate:(double)rate
+{
+    [_audioAnalysisTimer invalidate];
+    _audioAnalysisTimer   = nil;
+    _audioAnalysisHandler = [handler copy];
+    if (handler && rate > 0) {
+        _audioAnalysisTimer = [NSTimer scheduledTimerWithTimeInterval:1.0 / rate
+                                                               target:self
+                                                             selector:@selector(deliverAudioAnalysis)
+                                                             userInfo:nil
+                                                              repeats:YES];
+    }
+    [self applyAudioAnalysis];
+}
+
+- (void)setLoudnessNormalizationTarget:(float)loudnessNormalizationTarget
+{
+    _loudnessNormalizationTarget = MIN(loudnessNormalizationTarget, 0);
+    [self applyAudioAnalysis];
+}
+
+- (void)applyAudioAnalysis
+{
+    _audioAnalysisSerial = 0;
+    if (_mediaPlayer)
+        ijkmp_ios_set_audio_analysis(_mediaPlayer, _audioAnalysisHandler != nil, _loudnessNormalizationTarget);
+}
+
+- (void)deliverAudioAnalysis
+{
+    IJKAudioAnalysisResult result;
+
+    if (!_mediaPlayer || !_audioAnalysisHandler)
+        return;
+    if (!ijkmp_ios_get_audio_analysis(_mediaPlayer, &result) || result.serial == _audioAnalysisSerial)
+        return;
+    _audioAnalysisSerial = result.serial;
+
+    IJKFFAudioAnalysis analysis;
+    memcpy(analysis.bands, result.bands, sizeof(analysis.bands));
+    analysis.momentaryLoudness  = result.momentary;
+    analysis.shortTermLoudness  = result.short_term;
+    analysis.integratedLoudness = result.integrated;
+    analysis.normalizationGain  = result.normalization_gain;
+    _audioAnalysisHandler(analysis);
+}
+
+#pragma mark sync probe
+
+- (BOOL)syncProbeEnabled
+{
+    return _syncProbe != nil;
+}
+
+- (void)setSyncProbeEnabled:(BOOL)syncProbeEnabled
+{
+    if (syncProbeEnabled == (_syncProbe != nil))
+        return;
+
+    _syncProbe = syncProbeEnabled ? [[IJKSDLSyncProbe alloc] init] : nil;
+    _glView.syncProbe = _syncProbe;
+    if (_mediaPlayer)
+        ijkmp_ios_set_sync_probe(_mediaPlayer, _syncProbe.probe);
+}
+
+- (IJKFFSyncReport)syncReport
+{
+    IJKFFSyncReport report;
+    memset(&report, 0, sizeof(report));
+    if (!_syncProbe)
+        return report;
+
+    IJKSyncProbeResult result = [_syncProbe result];
+    report.flashes              = result.flashes;
+    report.tones                = result.onsets;
+    report.pairs                = result.pairs;
+    report.offsetMean           = result.offset_mean;
+    report.offsetStdDev         = result.offset_stddev;
+    report.offsetMin            = result.offset_min;
+    report.offsetMedian         = result.offset_p50;
+    report.offsetP95            = result.offset_p95;
+    report.offsetMax            = result.offset_max;
+    report.frames               = result.intervals;
+    report.frameIntervalMean    = result.interval_mean;
+    report.frameIntervalStdDev  = result.interval_stddev;
+    report.frameIntervalMedian  = result.interval_p50;
+    report.frameIntervalP95     = result.interval_p95;
+    report.frameIntervalMax     = result.interval_max;
+    return report;
+}
+
+- (void)resetSyncReport
+{
+    [_syncProbe reset];
+}
+
+#pragma mark timed metadata
+
+static void deliverTimedMetadata(IjkMediaPlayer *mediaPlayer, NSTimeInterval time,
+                                 void (^handler)(NSArray<IJKFFTimedMetadata *> *), dispatch_queue_t queue)
+{
+    CFArrayRef entries = ijkmp_ios_take_timed_metadata(mediaPlayer, time);
+    if (!entries)
+        return;
+
+    NSMutableArray<IJKFFTimedMetadata *> *metadata = [NSMutableArray arrayWithCapacity:CFArrayGetCount(entries)];
+    for (NSDictionary *entry in (__bridge NSArray *)entries) {
+        NSNumber *type = entry[(__bridge NSString *)FF_TIMED_METADATA_KEY_TYPE];
+        NSNumber *at   = entry[(__bridge NSString *)FF_TIMED_METADATA_KEY_TIME];
+        NSData   *data = entry[(__bridge NSString *)FF_TIMED_METADATA_KEY_DATA];
+        [metadata addObject:[[IJKFFTimedMetadata alloc] initWithType:type.integerValue
+                                                                time:at.doubleValue
+                                                                data:data]];
+    }
+    CFRelease(entries);
+
+    dispatch_async(queue, ^{
+        handler(metadata);
+    });
+}
+
+- (void)setTimedMetadataHandler:(void (^)(NSArray<IJKFFTimedMetadata *> *metadata))handler
+                          queue:(dispatch_queue_t)queue
+{
+    _timedMetadataHandler = [handler copy];
+    _timedMetadataQueue   = queue ?: dispatch_get_main_queue();
+    [self applyTimedMetadata];
+}
+
+- (void)applyTimedMetadata
+{
+    void (^handler)(NSArray<IJKFFTimedMetadata *> *) = _timedMetadataHandler;
+    dispatch_queue_t queue = _timedMetadataQueue;
+
+    _glView.presentHandler = nil;
+    if (!_mediaPlayer)
+        return;
+
+    ijkmp_ios_set_timed_metadata(_mediaPlayer, handler != nil);
+    if (!handler)
+        return;
+
+    // on the render thread, with each VideoToolbox frame presented
+    __weak IJKFFMoviePlayerController *weakSelf = self;
+    _glView.presentHandler = ^(NSTimeInterval pts) {
+        IJKFFMoviePlayerController *strongSelf = weakSelf;
+        if (strongSelf && strongSelf->_mediaPlayer)
+            deliverTimedMetadata(strongSelf->_mediaPlayer, pts, handler, queue);
+    };
+}
+
+- (void)setMaxBitrate:(int64_t)maxBitrate
+{
+    _maxBitrate = MAX(maxBitrate, 0);
+}
+
+- (int64_t)maxBitrate
+{
+    return _maxBitrate;
+}
+
+- (void)setMaximumFrameRate:(CGFloat)maximumFrameRate
+{
+    _maximumFrameRate = MAX(maximumFrameRate, 0);
+    [self updateMaximumFrameRate];
+}
+
+- (CGFloat)maximumFrameRate
+{
+    return _maximumFrameRate;
+}
+
+// the lower of the caps of the app and of the thermal policy
+- (void)updateMaximumFrameRate
+{
+    CGFloat cap = _thermalPolicyLevel >= IJKFFThermalPolicyFrameRateCap ? 30 : 0;
+    if (_maximumFrameRate > 0 && (cap <= 0 || _maximumFrameRate < cap))
+        cap = _maximumFrameRate;
+    _glView.maximumFrameRate = cap;
+}
+
+- (void)setMinimumDecodeDegradationLevel:(IJKFFDecodeDegradationLevel)level
+{
+    if (_minimumDecodeDegradationLevel == level)
+        return;
+
+    // to the floor right away either way, the adaptive degradation goes
+    // up again from there if the decoder falls behind
+    _minimumDecodeDegradationLevel = level;
+    _decodeRecoveryBackoff         = 0;
+    if (_mediaPlayer)
+        [self setDecodeDegradationLevel:level];
+    else
+        _decodeDegradationLevel = level;
+}
+
+- (IJKFFDecodeDegradationLevel)minimumDecodeDegradationLevel
+{
+    return _minimumDecodeDegradationLevel;
+}
+
+- (void)beginScrubbing
+{
+    if (!_mediaPlayer || _scrubbing)
+        return;
+
+    _scrubbing        = YES;
+    _pendingScrubTime = -1;
+    [self updateKeyframesOnly];
+}
+
+- (void)scrubToTime:(NSTimeInterval)time
+{
+    if (!_mediaPlayer)
+        return;
+
+    // each seek flushes the queues, a storm of them never shows a frame
+    if (_scrubbing && _seeking) {
+        _pendingScrubTime = time;
+        return;
+    }
+
+    [self setCurrentPlaybackTime:time];
+}
+
+- (void)endScrubbingAtTime:(NSTimeInterval)time
+{
+    if (!_mediaPlayer || !_scrubbing)
+        return;
+
+    _scrubbing        = NO;
+    _pendingScrubTime = -1;
+    [self updateKeyframesOnly];
+    [self setCurrentPlaybackTime:time];
+}
+
+- (BOOL)isScrubbing
+{
+    return _scrubbing;
+}
+
+#define IJK_TRICK_PLAY_INTERVAL     0.1
+// media between two seeks at least, the key frames of a seek closer to
+// the last one are likely the same
+#define IJK_TRICK_PLAY_MIN_STEP     1.0
+#define IJK_TRICK_PLAY_MAX_RATE     64.0f
+
+- (void)beginTrickPlayAtRate:(float)rate
+{
+    if (!_mediaPlayer || fabsf(rate) < 1.0f)
+        return;
+
+    rate = MAX(-IJK_TRICK_PLAY_MAX_RATE, MIN(rate, IJK_TRICK_PLAY_MAX_RATE));
+    if (_trickPlayRate != 0) {
+        _trickPlayRate = rate;
+        return;
+    }
+
+    _trickPlayResumes  = [self isPlaying];
+    _trickPlayVolume   = [self playbackVolume];
+    _trickPlayTime     = [self currentPlaybackTime];
+    _trickPlaySeekTime = _trickPlayTime;
+    _trickPlayTick     = CACurrentMediaTime();
+    _trickPlayRate     = rate;
+
+    [self setPlaybackVolume:0];
+    if (_trickPlayResumes)
+        [self pause];
+    [self beginScrubbing];
+
+    _trickPlayTimer = [NSTimer scheduledTimerWithTimeInterval:IJK_TRICK_PLAY_INTERVAL
+                                                       target:self
+                                                     selector:@selector(trickPlayStep)
+                                                     userInfo:nil
+                                                      repeats:YES];
+}
+
+- (void)trickPlayStep
+{
+    CFTimeInterval now      = CACurrentMediaTime();
+    NSTimeInterval duration = [self duration];
+
+    _trickPlayTime += (now - _trickPlayTick) * _trickPlayRate;
+    _trickPlayTick  = now;
+
+    if (_trickPlayTime <= 0 || (duration > 0 && _trickPlayTime >= duration)) {
+        _trickPlayTime = _trickPlayTime <= 0 ? 0 : duration;
+        [self endTrickPlay];
+        return;
+    }
+
+    if (fabs(_trickPlayTime - _trickPlaySeekTime) < IJK_TRICK_PLAY_MIN_STEP)
+        return;
+
+    _trickPlaySeekTime = _trickPlayTime;
+    [self scrubToTime:_trickPlayTime];
+}
+
+- (void)endTrickPlay
+{
+    if (!_mediaPlayer || _trickPlayRate == 0)
+        return;
+
+    [self cancelTrickPlay];
+    [self endScrubbingAtTime:_trickPlayTime];
+    if (_trickPlayResumes)
+        [self play];
+}
+
+// stop, reset and shutdown: no seek, the volume given back
+- (void)cancelTrickPlay
+{
+    if (_trickPlayRate == 0)
+        return;
+
+    _trickPlayRate = 0;
+    [_trickPlayTimer invalidate];
+    _trickPlayTimer = nil;
+    [self setPlaybackVolume:_trickPlayVolume];
+}
+
+- (float)trickPlayRate
+{
+    return _trickPlayRate;
+}
+
+- (void)beginFrameStepping
+{
+    if (!_mediaPlayer || _frameStepping || _urlString == nil)
+        return;
+
+    if (_trickPlayRate != 0)
+        [self endTrickPlay];
+
+    _frameStepping        = YES;
+    _frameSteppingResumes = [self isPlaying];
+    _frameSteppingTime    = [self currentPlaybackTime];
+    _frameSteppingGeneration++;
+    if (_frameSteppingResumes)
+        [self pause];
+
+    // the stepper is kept between steppings, with the GOPs it decoded
+    if (!_frameStepper)
+        _frameStepper = [[IJKMediaFrameStepper alloc] initWithContentURLString:_urlString options:_options];
+    [_frameStepper moveToTime:_frameSteppingTime handler:[self frameStepHandler]];
+}
+
+- (void)stepFrames:(NSInteger)frames
+{
+    if (!_frameStepping || frames == 0)
+        return;
+
+    [_frameStepper stepBy:frames handler:[self frameStepHandler]];
+}
+
+- (void)stepFrameForward
+{
+    [self stepFrames:1];
+}
+
+- (void)stepFrameBackward
+{
+    [self stepFrames:-1];
+}
+
+- (void)endFrameStepping
+{
+    if (!_mediaPlayer || !_frameStepping)
+        return;
+
+    [self cancelFrameStepping];
+    [self setCurrentPlaybackTime:_frameSteppingTime];
+    if (_frameSteppingResumes)
+        [self play];
+}
+
+// stop, reset and shutdown: no seek
+- (void)cancelFrameStepping
+{
+    if (!_frameStepping)
+        return;
+
+    _frameStepping = NO;
+    _frameSteppingGeneration++;
+    [_frameStepper cancelAll];
+}
+
+- (BOOL)isFrameStepping
+{
+    return _frameStepping;
+}
+
+- (NSTimeInterval)frameSteppingTime
+{
+    return _frameStepping ? _frameSteppingTime : -1;
+}
+
+- (UIView *)addOutputView
+{
+    UIView<IJKSDLRenderView> *view = [[[_glView class] alloc] initWithFrame:_glView.bounds];
+    if (!view)
+        return nil;
+
+    view.shouldShowHudView = NO;
+    // a software frame is shared as a pixel buffer, not uploaded by every view
+    view.prefersPixelBufferOverlays = YES;
+    view.contentFrameRate = _glView.contentFrameRate;
+    if (_useMetalView) {
+        IJKSDLMetalView *metalView = (IJKSDLMetalView *)view;
+        IJKSDLMetalView *mainView  = (IJKSDLMetalView *)_glView;
+        metalView.deinterlaceMode  = mainView.deinterlaceMode;
+        metalView.scalingFilter    = mainView.scalingFilter;
+        metalView.sharpness        = mainView.sharpness;
+    }
+
+    if (!_outputViews)
+        _outputViews = [NSMutableArray array];
+    [_outputViews addObject:view];
+    if (_mediaPlayer)
+        ijkmp_ios_set_render_outputs(_mediaPlayer, _outputViews);
+    return view;
+}
+
+- (void)removeOutputView:(UIView *)view
+{
+    if (![_outputViews containsObject:view])
+        return;
+
+    [_outputViews removeObject:view];
+    if (_mediaPlayer)
+        ijkmp_ios_set_render_outputs(_mediaPlayer, _outputViews);
+}
+
+- (void)setMaximumFrameRate:(CGFloat)frameRate forOutputView:(UIView *)view
+{
+    for (UIView<IJKSDLRenderView> *outputView in _outputViews) {
+        if (outputView == view)
+            outputView.maximumFrameRate = frameRate;
+    }
+}
+
+- (NSArray<UIView *> *)outputViews
+{
+    return _outputViews ? [_outputViews copy] : @[];
+}
+
+- (IJKMediaFrameStepHandler)frameStepHandler
+{
+    __weak IJKFFMoviePlayerController *weakSelf = self;
+    int generation = _frameSteppingGeneration;
+    return ^(CVPixelBufferRef pixelBuffer, NSTimeInterval time) {
+        IJKFFMoviePlayerController *strongSelf = weakSelf;
+        if (!strongSelf || !pixelBuffer || strongSelf->_frameSteppingGeneration != generation)
+            return;
+
+        strongSelf->_frameSteppingTime = time;
+        [strongSelf displayPixelBuffer:pixelBuffer];
+    };
+}
+
+// shown as a VideoToolbox frame of the player, the views retain it
+- (void)displayPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    int width  = (int)CVPixelBufferGetWidth(pixelBuffer);
+    int height = (int)CVPixelBufferGetHeight(pixelBuffer);
+    SDL_VoutOverlay *overlay = SDL_VoutVideoToolBox_CreateOverlay(width, height, NULL);
+    AVFrame         *frame   = av_frame_alloc();
+    if (overlay && frame) {
+        frame->format = IJK_AV_PIX_FMT__VIDEO_TOOLBOX;
+        frame->width  = width;
+        frame->height = height;
+        frame->opaque = pixelBuffer;
+        if (SDL_VoutFillFrameYUVOverlay(overlay, frame) == 0) {
+            [_glView display:overlay];
+            for (UIView<IJKSDLRenderView> *outputView in _outputViews)
+                [outputView display:overlay];
+        }
+    }
+    av_frame_free(&frame);
+    if (overlay)
+        SDL_VoutFreeYUVOverlay(overlay);
+}
+
+// scrubbing and the background both want key frames only
+- (void)updateKeyframesOnly
+{
+    if (!_mediaPlayer)
+        return;
+
+    ijkmp_ios_set_keyframes_only(_mediaPlayer, _scrubbing || _videoSuspended);
+}
+
+- (void)setVideoSuspended:(BOOL)suspended
+{
+    if (_videoSuspended == suspended)
+        return;
+
+    _videoSuspended = suspended;
+    [self updateKeyframesOnly];
+}
+
+// the hot properties as last sampled, without the player mutex; zeroed
+// when there is none
+- (BOOL)propertySnapshot:(FFPropertySnapshot *)snapshot
+{
+    if (!_mediaPlayer || !ijkmp_ios_get_property_snapshot(_mediaPlayer, snapshot)) {
+        memset(snapshot, 0, sizeof(*snapshot));
+        return NO;
+    }
+    return YES;
+}
+
+- (NSTimeInterval)currentPlaybackTime
+{
+    FFPropertySnapshot props;
+    if (![self propertySnapshot:&props])
+        return 0.0f;
+
+    // the clocks are of the former position until the seek is done
+    if (_seeking || props.tick < _seekDoneTick)
+        return _seekTarget;
+
+    int64_t position = props.position;
+    if (ijkmp_get_state(_mediaPlayer) == MP_STATE_STARTED)
+        position = ffprops_position_at(&props, (int64_t)SDL_GetTickHR());
+    return (NSTimeInterval)position / 1000;
+}
+
+- (NSTimeInterval)duration
+{
+    FFPropertySnapshot props;
+    if (![self propertySnapshot:&props])
+        return 0.0f;
+
+    return (NSTimeInterval)props.duration / 1000;
+}
+
+- (NSTimeInterval)playableDuration
+{
+    FFPropertySnapshot props;
+    if (![self propertySnapshot:&props])
+        return 0.0f;
+
+    NSTimeInterval demux_cache = ((NSTimeInterval)props.playable_duration) / 1000;
+
+    int64_t buf_forwards = _asyncStat.buf_forwards;
+    int64_t bit_rate = props.bit_rate;
+
+    if (buf_forwards > 0 && bit_rate > 0) {
+        NSTimeInterval io_cache = ((float)buf_forwards) * 8 / bit_rate;
+        demux_cache += io_cache;
+    }
+
+    return demux_cache;
+}
+
+- (CGSize)naturalSize
+{
+    return _naturalSize;
+}
+
+- (void)changeNaturalSize
+{
+    [self willChangeValueForKey:@"naturalSize"];
+    if (_sampleAspectRatioNumerator > 0 && _sampleAspectRatioDenominator > 0) {
+        self->_naturalSize = CGSizeMake(1.0f * _videoWidth * _sampleAspectRatioNumerator / _sampleAspectRatioDenominator, _videoHeight);
+    } else {
+        self->_naturalSize = CGSizeMake(_videoWidth, _videoHeight);
+    }
+    [self didChangeValueForKey:@"naturalSize"];
+
+    if (self->_naturalSize.width > 0 && self->_naturalSize.height > 0) {
+        [[NSNotificationCenter defaultCenter]
+         postNotificationName:IJKMPMovieNaturalSizeAvailableNotification
+         object:self];
+    }
+}
+
+- (void)setScalingMode: (IJKMPMovieScalingMode) aScalingMode
+{
+    IJKMPMovieScalingMode newScalingMode = aScalingMode;
+    switch (aScalingMode) {
+        case IJKMPMovieScalingModeNone:
+            [_view setContentMode:UIViewContentModeCenter];
+            break;
+        case IJKMPMovieScalingModeAspectFit:
+            [_view setContentMode:UIViewContentModeScaleAspectFit];
+            break;
+        case IJKMPMovieScalingModeAspectFill:
+            [_view setContentMode:UIViewContentModeScaleAspectFill];
+            break;
+        case IJKMPMovieScalingModeFill:
+            [_view setContentMode:UIViewContentModeScaleToFill];
+            break;
+        default:
+            newScalingMode = _scalingMode;
+    }
+
+    _scalingMode = newScalingMode;
+}
+
+- (void)setLikelySeekTargets:(NSArray<NSNumber *> *)times window:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes
+{
+    [_seekPrefetcher cancelAll];
+    _seekTargets      = times.count > 0 && seconds > 0 ? [times copy] : nil;
+    _seekTargetWindow = seconds;
+    _seekTargetBytes  = maxBytes;
+    if (_isPreparedToPlay)
+        [self prefetchSeekTargets];
+}
+
+// read by a demuxer of its own, into the disk cache the player reads from
+- (void)prefetchSeekTargets
+{
+    NSArray<NSNumber *> *times = _seekTargets;
+    _seekTargets = nil;
+    // local files need none
+    if (!times || !_urlString || [_urlString hasPrefix:@"/"])
+        return;
+
+    NSURL *url = [NSURL URLWithString:_urlString];
+    if (!url)
+        return;
+    if (!_seekPrefetcher)
+        _seekPrefetcher = [[IJKMediaPreloader alloc] initWithOptions:_options];
+    [_seekPrefetcher preloadURL:url seekTargets:times duration:_seekTargetWindow maxBytes:_seekTargetBytes];
+}
+
+// deprecated, for MPMoviePlayerController compatiable
+// decoded apart from playback, by a demuxer and a decoder of its own
+- (UIImage *)thumbnailImageAtTime:(NSTimeInterval)playbackTime timeOption:(IJKMPMovieTimeOption)option
+{
+    if (!_urlString)
+        return nil;
+
+    if (!_thumbnailer)
+        _thumbnailer = [[IJKMediaThumbnailer alloc] initWithContentURLString:_urlString options:_options];
+    return [_thumbnailer thumbnailAtTime:playbackTime
+                                   exact:option == IJKMPMovieTimeOptionExact
+                              actualTime:NULL];
+}
+
+- (IJKMediaSpriteThumbnailer *)scrubPreviews
+{
+    if (!_urlString)
+        return nil;
+
+    if (!_scrubPreviews)
+        _scrubPreviews = [[IJKMediaSpriteThumbnailer alloc] initWithContentURLString:_urlString options:_options];
+    return _scrubPreviews;
+}
+
+- (UIImage *)thumbnailImageAtCurrentTime
+{
+    if ([_view conformsToProtocol:@protocol(IJKSDLRenderView)]) {
+        UIView<IJKSDLRenderView> *renderView = (UIView<IJKSDLRenderView> *)_view;
+        return [renderView snapshot];
+    }
+
+    return nil;
+}
+
+- (void)captureFrameWithCompletion:(void (^)(UIImage *image))completion
+{
+    if (!completion)
+        return;
+
+    [_glView captureFrame:completion];
+}
+
+- (void)setFrameOutputHandler:(void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts))handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate
+{
+    void (^outputHandler)(CVPixelBufferRef, NSTimeInterval) = nil;
+    if (handler) {
+        __weak IJKFFMoviePlayerController *weakSelf = self;
+        outputHandler = ^(CVPixelBufferRef pixelBuffer, NSTimeInterval pts) {
+            // software frames carry no time, the clock is on it at display
+            if (isnan(pts))
+                pts = weakSelf.currentPlaybackTime;
+            handler(pixelBuffer, pts);
+        };
+    }
+
+    [_glView setFrameOutputHandler:outputHandler
+                             queue:queue
+                     frameInterval:frameInterval
+                  maximumFrameRate:maximumFrameRate];
+}
+
+- (CGFloat)fpsAtDecoder
+{
+    if (!_mediaPlayer)
+        return 0;
+
+    FFPropertySnapshot props;
+    [self propertySnapshot:&props];
+    return props.decode_frames_per_second;
+}
+
+- (CGFloat)fpsAtOutput
+{
+    return _glView.fps;
+}
+
+- (CGFloat)judderAtOutput
+{
+    return _glView.judder;
+}
+
+- (int64_t)droppedPresentsAtOutput
+{
+    return _glView.droppedPresents;
+}
+
+inline static IJKFFLatencyPercentiles latencyPercentiles(IJKSDLFrameLatency *latency, IJKSDLFrameStage stage)
+{
+    IJKSDLLatencyPercentiles p = [latency percentilesOfStage:stage];
+    return (IJKFFLatencyPercentiles){p.count, p.p50, p.p95, p.p99};
+}
+
+- (void)sampleAudioSampleRates
+{
+    int sourceRate, outputRate;
+    if (!_mediaPlayer || !ijkmp_ios_get_audio_sample_rates(_mediaPlayer, &sourceRate, &outputRate))
+        return;
+
+    _monitor.audioOutputSampleRate   = sourceRate;
+    _monitor.audioHardwareSampleRate = outputRate;
+}
+
+- (void)samplePixelBufferAllocations
+{
+    int64_t total = 0, steady = 0;
+    if (!_mediaPlayer)
+        return;
 
-    [self didShutdown];
+    ijkmp_ios_get_pixel_buffer_allocations(_mediaPlayer, &total, &steady);
+    _monitor.pixelBufferAllocations       = total;
+    _monitor.steadyPixelBufferAllocations = steady;
 }
 
-- (void)didShutdown
+// the histograms are kept by the view, copied when the monitor is asked for
+- (IJKFFMonitor *)monitor
 {
+    IJKSDLFrameLatency *latency = _glView.frameLatency;
+    _monitor.frameSubmitLatency  = latencyPercentiles(latency, IJKSDLFrameStageSubmit);
+    _monitor.frameDecodeLatency  = latencyPercentiles(latency, IJKSDLFrameStageDecode);
+    _monitor.frameReorderLatency = latencyPercentiles(latency, IJKSDLFrameStageReorder);
+    _monitor.framePresentLatency = latencyPercentiles(latency, IJKSDLFrameStagePresent);
+    _monitor.frameTotalLatency   = latencyPercentiles(latency, IJKSDLFrameStageTotal);
+
+    NSMutableDictionary *hookTimes = [NSMutableDictionary dictionary];
+    for (int i = 0; i < IJK_INJECT_HOOK_COUNT; ++i) {
+        IJKInjectHookStat *stat = &_injectHookStats[i];
+        IJKFFInjectHookTime time = {
+            atomic_load(&stat->count),
+            atomic_load(&stat->blocking),
+            atomic_load(&stat->maxBlocking),
+            atomic_load(&stat->deferred),
+        };
+        if (time.count > 0)
+            hookTimes[@(g_inject_hooks[i])] = [NSValue valueWithBytes:&time objCType:@encode(IJKFFInjectHookTime)];
+    }
+    _monitor.injectHookTimes = hookTimes;
+
+    int64_t cpuTimes[IJKSDLThreadRoleCount];
+    IJKSDLThreadGroup_getCPUTime(_threadGroup, cpuTimes);
+    NSMutableDictionary *threadCPUTimes = [NSMutableDictionary dictionary];
+    for (int role = 0; role < IJKSDLThreadRoleCount; ++role) {
+        if (cpuTimes[role] > 0)
+            threadCPUTimes[@(IJKSDLThreadRoleGetName(role))] = @(cpuTimes[role]);
+    }
+    _monitor.threadCPUTimes = threadCPUTimes;
+
+    [self accountTraffic];
+    _monitor.wifiBytes       = _energyWifiBytes;
+    _monitor.cellularBytes   = _energyCellularBytes;
+    _monitor.presentedFrames = _glView.presentedFrames - _energyPresentedBase;
+    _monitor.decodedFrames   = _monitor.presentedFrames + _glView.droppedPresents - _energyDroppedBase;
+
+    [self sampleAudioSampleRates];
+    [self samplePixelBufferAllocations];
+    return _monitor;
 }
 
-- (IJKMPMoviePlaybackState)playbackState
+- (void)resetEnergyAccounting
 {
-    if (!_mediaPlayer)
-        return NO;
-
-    IJKMPMoviePlaybackState mpState = IJKMPMoviePlaybackStateStopped;
-    int state = ijkmp_get_state(_mediaPlayer);
-    switch (state) {
-        case MP_STATE_STOPPED:
-        case MP_STATE_COMPLETED:
-        case MP_STATE_ERROR:
-        case MP_STATE_END:
-            mpState = IJKMPMoviePlaybackStateStopped;
-            break;
-        case MP_STATE_IDLE:
-        case MP_STATE_INITIALIZED:
-        case MP_STATE_ASYNC_PREPARING:
-        case MP_STATE_PAUSED:
-            mpState = IJKMPMoviePlaybackStatePaused;
-            break;
-        case MP_STATE_PREPARED:
-        case MP_STATE_STARTED: {
-            if (_seeking)
-                mpState = IJKMPMoviePlaybackStateSeekingForward;
-            else
-                mpState = IJKMPMoviePlaybackStatePlaying;
-            break;
-        }
-    }
-    // IJKMPMoviePlaybackStatePlaying,
-    // IJKMPMoviePlaybackStatePaused,
-    // IJKMPMoviePlaybackStateStopped,
-    // IJKMPMoviePlaybackStateInterrupted,
-    // IJKMPMoviePlaybackStateSeekingForward,
-    // IJKMPMoviePlaybackStateSeekingBackward
-    return mpState;
+    _energyWifiBytes     = 0;
+    _energyCellularBytes = 0;
+    _energyTrafficBase   = 0;
+    _energyCellular      = [IJKNetworkMonitor isCellular];
+    _energyPresentedBase = _glView.presentedFrames;
+    _energyDroppedBase   = _glView.droppedPresents;
 }
 
-- (void)setCurrentPlaybackTime:(NSTimeInterval)aCurrentPlaybackTime
+// the bytes since the last time to the interface of then
+- (void)accountTraffic
 {
-    if (!_mediaPlayer)
+    FFPropertySnapshot props;
+    if (![self propertySnapshot:&props])
         return;
 
-    _seeking = YES;
-    [[NSNotificationCenter defaultCenter]
-     postNotificationName:IJKMPMoviePlayerPlaybackStateDidChangeNotification
-     object:self];
+    int64_t bytes = MAX(props.traffic_bytes - _energyTrafficBase, 0);
+    if (_energyCellular)
+        _energyCellularBytes += bytes;
+    else
+        _energyWifiBytes += bytes;
+    _energyTrafficBase = MAX(props.traffic_bytes, _energyTrafficBase);
+    _energyCellular    = [IJKNetworkMonitor isCellular];
+}
 
-    _bufferingPosition = 0;
-    ijkmp_seek_to(_mediaPlayer, aCurrentPlaybackTime * 1000);
+- (void)networkInterfaceDidChange
+{
+    [self accountTraffic];
 }
 
-- (NSTimeInterval)currentPlaybackTime
+- (IJKFFStatistics)statistics
 {
-    if (!_mediaPlayer)
-        return 0.0f;
+    return _statisticsSampler.statistics;
+}
 
-    NSTimeInterval ret = ijkmp_get_current_position(_mediaPlayer);
-    if (isnan(ret) || isinf(ret))
-        return -1;
+- (id)addStatisticsObserverWithInterval:(NSTimeInterval)interval
+                                  queue:(dispatch_queue_t)queue
+                                  block:(void (^)(IJKFFStatistics statistics))block
+{
+    return [_statisticsSampler addObserverWithInterval:interval queue:queue block:block];
+}
 
-    return ret / 1000;
+- (void)removeStatisticsObserver:(id)observer
+{
+    [_statisticsSampler removeObserver:observer];
 }
 
-- (NSTimeInterval)duration
+#pragma mark black box
+
+static void writeBlackBoxStatistics(int player, const IJKFFStatistics *statistics)
 {
-    if (!_mediaPlayer)
-        return 0.0f;
+    int64_t buffer[5] = {
+        statistics->position,
+        statistics->videoCachedDuration, statistics->videoCachedBytes,
+        statistics->audioCachedDuration, statistics->audioCachedBytes,
+    };
+    int64_t rates[6] = {
+        llrintf(statistics->decodeFramesPerSecond * 100), llrintf(statistics->outputFramesPerSecond * 100),
+        llrintf(statistics->dropFrameRate * 10000), statistics->droppedPresents,
+        statistics->tcpSpeed, statistics->bitRate,
+    };
+
+    ijk_blackbox_write(IJK_BB_BUFFER, player, buffer, 5);
+    ijk_blackbox_write(IJK_BB_RATES, player, rates, 6);
+}
 
-    NSTimeInterval ret = ijkmp_get_duration(_mediaPlayer);
-    if (isnan(ret) || isinf(ret))
-        return -1;
+- (void)startBlackBox
+{
+    if (_blackBoxObserver != nil)
+        return;
 
-    return ret / 1000;
+    int player = _blackBoxPlayer;
+    ijk_blackbox_player_did_open(player);
+    _blackBoxObserver = [_statisticsSampler addObserverWithInterval:IJK_BLACKBOX_SAMPLE_INTERVAL
+                                                              queue:dispatch_get_global_queue(QOS_CLASS_UTILITY, 0)
+                                                              block:^(IJKFFStatistics statistics) {
+        writeBlackBoxStatistics(player, &statistics);
+    }];
 }
 
-- (NSTimeInterval)playableDuration
+- (void)stopBlackBox
 {
-    if (!_mediaPlayer)
-        return 0.0f;
+    if (_blackBoxObserver == nil)
+        return;
 
-    NSTimeInterval demux_cache = ((NSTimeInterval)ijkmp_get_playable_duration(_mediaPlayer)) / 1000;
+    [_statisticsSampler removeObserver:_blackBoxObserver];
+    _blackBoxObserver = nil;
+    ijk_blackbox_player_did_close(_blackBoxPlayer);
+}
 
-    int64_t buf_forwards = _asyncStat.buf_forwards;
-    int64_t bit_rate = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_BIT_RATE, 0);
+#pragma mark memory
 
-    if (buf_forwards > 0 && bit_rate > 0) {
-        NSTimeInterval io_cache = ((float)buf_forwards) * 8 / bit_rate;
-        demux_cache += io_cache;
+- (IJKFFMemoryUsage)memoryUsage
+{
+    IJKFFMemoryUsage usage = {0};
+
+    usage.readAheadBytes = _asyncStat.buf_memory;
+    usage.renderBytes    = _glView.textureBytes;
+    if (_mediaPlayer) {
+        usage.packetQueueBytes   = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_BYTES, 0) +
+                                   ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_BYTES, 0);
+        usage.decoderBufferBytes = ijkmp_ios_get_decoder_buffered_bytes(_mediaPlayer);
+        usage.frameQueueBytes    = ijkmp_ios_get_frame_queue_bytes(_mediaPlayer);
     }
-
-    return demux_cache;
+    usage.totalBytes = usage.readAheadBytes + usage.packetQueueBytes + usage.decoderBufferBytes +
+                       usage.frameQueueBytes + usage.renderBytes;
+    return usage;
 }
 
-- (CGSize)naturalSize
+- (void)setMemoryBudget:(int64_t)memoryBudget
 {
-    return _naturalSize;
+    _memoryBudget = memoryBudget;
+    if (_mediaPlayer)
+        ijkmp_ios_set_frame_queue_budget(_mediaPlayer, memoryBudget / 4);
 }
 
-- (void)changeNaturalSize
+- (int)pictureQueueDepth
 {
-    [self willChangeValueForKey:@"naturalSize"];
-    if (_sampleAspectRatioNumerator > 0 && _sampleAspectRatioDenominator > 0) {
-        self->_naturalSize = CGSizeMake(1.0f * _videoWidth * _sampleAspectRatioNumerator / _sampleAspectRatioDenominator, _videoHeight);
-    } else {
-        self->_naturalSize = CGSizeMake(_videoWidth, _videoHeight);
-    }
-    [self didChangeValueForKey:@"naturalSize"];
+    return _mediaPlayer ? ijkmp_ios_get_frame_queue_depth(_mediaPlayer) : 0;
+}
 
-    if (self->_naturalSize.width > 0 && self->_naturalSize.height > 0) {
-        [[NSNotificationCenter defaultCenter]
-         postNotificationName:IJKMPMovieNaturalSizeAvailableNotification
-         object:self];
-    }
+// the usage once level is shed, as far as it can be told beforehand
+static int64_t memoryAfterShedding(IJKFFMemoryUsage usage, IJKFFMemoryShedLevel level)
+{
+    if (level >= IJKFFMemoryShedLevelReadAhead)
+        usage.readAheadBytes = MIN(usage.readAheadBytes, IJK_MEMORY_SHED_READ_AHEAD);
+    if (level >= IJKFFMemoryShedLevelPacketQueues)
+        usage.packetQueueBytes = MIN(usage.packetQueueBytes, MAX(usage.packetQueueBytes / 4, IJK_MEMORY_SHED_MIN_PACKET_BYTES));
+    if (level >= IJKFFMemoryShedLevelFrameQueue && usage.frameQueueBytes > usage.renderBytes)
+        usage.frameQueueBytes = usage.renderBytes;
+    return usage.readAheadBytes + usage.packetQueueBytes + usage.decoderBufferBytes +
+           usage.frameQueueBytes + usage.renderBytes;
 }
 
-- (void)setScalingMode: (IJKMPMovieScalingMode) aScalingMode
+- (void)shedMemoryToLevel:(IJKFFMemoryShedLevel)level usage:(IJKFFMemoryUsage)usage
 {
-    IJKMPMovieScalingMode newScalingMode = aScalingMode;
-    switch (aScalingMode) {
-        case IJKMPMovieScalingModeNone:
-            [_view setContentMode:UIViewContentModeCenter];
-            break;
-        case IJKMPMovieScalingModeAspectFit:
-            [_view setContentMode:UIViewContentModeScaleAspectFit];
-            break;
-        case IJKMPMovieScalingModeAspectFill:
-            [_view setContentMode:UIViewContentModeScaleAspectFill];
-            break;
-        case IJKMPMovieScalingModeFill:
-            [_view setContentMode:UIViewContentModeScaleToFill];
-            break;
-        default:
-            newScalingMode = _scalingMode;
+    for (IJKFFMemoryShedLevel next = _memoryShedLevel + 1; next <= level; ++next) {
+        switch (next) {
+            case IJKFFMemoryShedLevelRenderCaches:
+                [_glView flushTextureCache];
+                break;
+            case IJKFFMemoryShedLevelReadAhead:
+                // taken by the ring on its next update
+                _maxReadAheadMemory = IJK_MEMORY_SHED_READ_AHEAD;
+                break;
+            case IJKFFMemoryShedLevelPacketQueues:
+                if (_mediaPlayer)
+                    ijkmp_ios_set_max_buffer_size(_mediaPlayer, (int)MIN(MAX(usage.packetQueueBytes / 4, IJK_MEMORY_SHED_MIN_PACKET_BYTES), INT_MAX));
+                break;
+            case IJKFFMemoryShedLevelFrameQueue:
+                if (_mediaPlayer)
+                    ijkmp_ios_set_frame_queue_limit(_mediaPlayer, 1);
+                break;
+            default:
+                break;
+        }
+    }
+    if (level > _memoryShedLevel) {
+        NSLog(@"IJKFFMoviePlayerController: shed memory to level %d, %"PRId64" bytes held\n", (int)level, usage.totalBytes);
+        _memoryShedLevel = level;
     }
+}
 
-    _scalingMode = newScalingMode;
+#pragma mark thermal policy
+
+// posted on any thread
+- (void)processInfoDidChangeState
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self refreshThermalPolicy];
+    });
 }
 
-// deprecated, for MPMoviePlayerController compatiable
-- (UIImage *)thumbnailImageAtTime:(NSTimeInterval)playbackTime timeOption:(IJKMPMovieTimeOption)option
+- (void)refreshThermalPolicy
 {
-    return nil;
+    if (!_thermalPolicy)
+        return;
+
+    IJKFFThermalPolicyLevel level = IJKFFThermalPolicyNone;
+    if (@available(iOS 11.0, *))
+        level = (IJKFFThermalPolicyLevel)[NSProcessInfo processInfo].thermalState;
+    if (@available(iOS 9.0, *)) {
+        if ([NSProcessInfo processInfo].lowPowerModeEnabled)
+            level = MAX(level, IJKFFThermalPolicyFrameRateCap);
+    }
+    level = MIN(level, IJKFFThermalPolicyLowestBitrate);
+    if (level == _thermalPolicyLevel)
+        return;
+
+    NSLog(@"IJKFFMoviePlayerController: thermal policy %d -> %d\n", (int)_thermalPolicyLevel, (int)level);
+    [self setThermalPolicyLevel:level];
+
+    [[NSNotificationCenter defaultCenter]
+     postNotificationName:IJKMPMoviePlayerThermalPolicyDidChangeNotification
+     object:self
+     userInfo:@{IJKMPMoviePlayerThermalPolicyLevelUserInfoKey: @(level)}];
 }
 
-- (UIImage *)thumbnailImageAtCurrentTime
+- (void)setThermalPolicyLevel:(IJKFFThermalPolicyLevel)level
 {
-    if ([_view isKindOfClass:[IJKSDLGLView class]]) {
-        IJKSDLGLView *glView = (IJKSDLGLView *)_view;
-        return [glView snapshot];
+    IJKFFThermalPolicyLevel former = _thermalPolicyLevel;
+    _thermalPolicyLevel = level;
+
+    [self updateMaximumFrameRate];
+
+    // the abr of the hls demuxer picks under the cap at its next segment;
+    // a cap of 1 leaves only the lowest variant
+    if (level >= IJKFFThermalPolicyLowestBitrate)
+        _thermalMaxBitrate = 1;
+    else if (level == IJKFFThermalPolicyReducedQuality && former != IJKFFThermalPolicyReducedQuality)
+        _thermalMaxBitrate = _monitor.hlsVariantBitrate / 2;
+    else if (level < IJKFFThermalPolicyReducedQuality)
+        _thermalMaxBitrate = 0;
+
+    if (_useMetalView) {
+        IJKSDLMetalView *metalView = (IJKSDLMetalView *)_glView;
+        BOOL reduced = level >= IJKFFThermalPolicyReducedQuality;
+        metalView.scalingFilter = reduced ? IJKSDLMetalScalingBilinear : (IJKSDLMetalScalingFilter)_options.videoScalingFilter;
+        metalView.sharpness     = reduced ? 0.0f : _options.videoSharpness;
     }
 
-    return nil;
+    [self updateBackgroundQoS];
 }
 
-- (CGFloat)fpsAtOutput
+- (void)applicationDidReceiveMemoryWarning
 {
-    return _glView.fps;
+    int64_t playerBytes = self.memoryUsage.totalBytes;
+    ijk_blackbox_write(IJK_BB_MEMORY_WARNING, _blackBoxPlayer, &playerBytes, 1);
+
+    if (!_mediaPlayer || _memoryShedLevel >= IJKFFMemoryShedLevelFrameQueue)
+        return;
+
+    IJKFFMemoryUsage usage = self.memoryUsage;
+    if (_memoryBudget > 0 && usage.totalBytes <= _memoryBudget)
+        return;
+
+    // the fewest levels that fit the budget, all of them otherwise
+    IJKFFMemoryShedLevel level = _memoryShedLevel + 1;
+    while (_memoryBudget > 0 && level < IJKFFMemoryShedLevelFrameQueue && memoryAfterShedding(usage, level) > _memoryBudget)
+        level++;
+    [self shedMemoryToLevel:level usage:usage];
 }
 
 inline static NSString *formatedDurationMilli(int64_t duration) {
@@ -696,20 +2695,18 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
     }
 }
 
-- (void)refreshHudView
+// one of the statistics observers, on _hudQueue: the core is read by the
+// sampler, the state of the controller as it stands
+- (void)refreshHudView:(const IJKFFStatistics *)statistics
 {
     if (_mediaPlayer == nil)
         return;
 
-    int64_t vdec = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_DECODER, FFP_PROPV_DECODER_UNKNOWN);
-    float   vdps = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_VIDEO_DECODE_FRAMES_PER_SECOND, .0f);
-    float   vfps = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_VIDEO_OUTPUT_FRAMES_PER_SECOND, .0f);
-
-    switch (vdec) {
-        case FFP_PROPV_DECODER_VIDEOTOOLBOX:
+    switch (statistics->videoDecoder) {
+        case IJKFFStatisticsDecoderVideoToolbox:
             [_glView setHudValue:@"VideoToolbox" forKey:@"vdec"];
             break;
-        case FFP_PROPV_DECODER_AVCODEC:
+        case IJKFFStatisticsDecoderAVCodec:
             [_glView setHudValue:[NSString stringWithFormat:@"avcodec %d.%d.%d",
                                   LIBAVCODEC_VERSION_MAJOR,
                                   LIBAVCODEC_VERSION_MINOR,
@@ -721,36 +2718,53 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
             break;
     }
 
-    [_glView setHudValue:[NSString stringWithFormat:@"%.2f / %.2f", vdps, vfps] forKey:@"fps"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%.2f / %.2f",
+                          statistics->decodeFramesPerSecond,
+                          statistics->outputFramesPerSecond]
+                  forKey:@"fps"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%.1f ms", statistics->judder] forKey:@"judder"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%"PRId64, statistics->droppedPresents] forKey:@"dropped-presents"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%d, %@",
+                          statistics->rebufferCount,
+                          formatedDurationMilli(statistics->rebufferDuration)]
+                  forKey:@"rebuffer"];
+
+    if (statistics->videoDecoder == IJKFFStatisticsDecoderVideoToolbox) {
+        [_glView setHudValue:[NSString stringWithFormat:@"%"PRId64" / %"PRId64,
+                              statistics->textureCacheHits,
+                              statistics->textureCacheMisses]
+                      forKey:@"vtb-tex-cache"];
+    }
 
-    int64_t vcacheb = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_BYTES, 0);
-    int64_t acacheb = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_BYTES, 0);
-    int64_t vcached = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_DURATION, 0);
-    int64_t acached = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_DURATION, 0);
-    int64_t vcachep = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_PACKETS, 0);
-    int64_t acachep = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_PACKETS, 0);
     [_glView setHudValue:[NSString stringWithFormat:@"%@, %@, %"PRId64" packets",
-                          formatedDurationMilli(vcached),
-                          formatedSize(vcacheb),
-                          vcachep]
+                          formatedDurationMilli(statistics->videoCachedDuration),
+                          formatedSize(statistics->videoCachedBytes),
+                          statistics->videoCachedPackets]
                   forKey:@"v-cache"];
     [_glView setHudValue:[NSString stringWithFormat:@"%@, %@, %"PRId64" packets",
-                          formatedDurationMilli(acached),
-                          formatedSize(acacheb),
-                          acachep]
+                          formatedDurationMilli(statistics->audioCachedDuration),
+                          formatedSize(statistics->audioCachedBytes),
+                          statistics->audioCachedPackets]
                   forKey:@"a-cache"];
 
-    float avdelay = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_AVDELAY, .0f);
-    float avdiff  = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_AVDIFF, .0f);
-    [_glView setHudValue:[NSString stringWithFormat:@"%.3f %.3f", avdelay, -avdiff] forKey:@"delay"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%.3f %.3f", statistics->avDelay, -statistics->avDiff] forKey:@"delay"];
 
-    int64_t bitRate = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_BIT_RATE, 0);
+    int64_t bitRate = statistics->bitRate;
     [_glView setHudValue:[NSString stringWithFormat:@"-%@, %@",
                          formatedSize(_cacheStat.cache_file_forwards),
                           formatedDurationBytesAndBitrate(_cacheStat.cache_file_forwards, bitRate)] forKey:@"cache-forwards"];
     [_glView setHudValue:formatedSize(_cacheStat.cache_physical_pos) forKey:@"cache-physical-pos"];
     [_glView setHudValue:formatedSize(_cacheStat.cache_file_pos) forKey:@"cache-file-pos"];
     [_glView setHudValue:formatedSize(_cacheStat.cache_count_bytes) forKey:@"cache-bytes"];
+
+    DiskCacheStatistic diskCacheStat;
+    av_disk_cache_get_statistic(&diskCacheStat);
+    [_glView setHudValue:[NSString stringWithFormat:@"hit %@ / miss %@, %@ of %@",
+                          formatedSize(diskCacheStat.hit_bytes),
+                          formatedSize(diskCacheStat.miss_bytes),
+                          formatedSize(diskCacheStat.size),
+                          formatedSize(diskCacheStat.max_size)]
+                  forKey:@"disk-cache"];
     [_glView setHudValue:[NSString stringWithFormat:@"-%@, %@",
                           formatedSize(_asyncStat.buf_backwards),
                           formatedDurationBytesAndBitrate(_asyncStat.buf_backwards, bitRate)]
@@ -760,10 +2774,16 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
                           formatedDurationBytesAndBitrate(_asyncStat.buf_forwards, bitRate)]
                   forKey:@"async-forward"];
 
-    int64_t tcpSpeed = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_TCP_SPEED, 0);
-    [_glView setHudValue:[NSString stringWithFormat:@"%@", formatedSpeed(tcpSpeed, 1000)]
+    [_glView setHudValue:[NSString stringWithFormat:@"%@", formatedSpeed(statistics->tcpSpeed, 1000)]
                   forKey:@"tcp-spd"];
 
+    IJKSDLLatencyPercentiles latency = [_glView.frameLatency percentilesOfStage:IJKSDLFrameStageTotal];
+    [_glView setHudValue:[NSString stringWithFormat:@"%.1f / %.1f / %.1f ms",
+                          latency.p50 / 1000.0,
+                          latency.p95 / 1000.0,
+                          latency.p99 / 1000.0]
+                  forKey:@"frame-latency"];
+
     [_glView setHudValue:formatedDurationMilli(_monitor.prepareDuration) forKey:@"t-prepared"];
     [_glView setHudValue:formatedDurationMilli(_monitor.firstVideoFrameLatency) forKey:@"t-render"];
     [_glView setHudValue:formatedDurationMilli(_monitor.lastPrerollDuration) forKey:@"t-preroll"];
@@ -771,10 +2791,60 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
                           formatedDurationMilli(_monitor.lastHttpOpenDuration),
                           _monitor.httpOpenCount]
                   forKey:@"t-http-open"];
+    [_glView setHudValue:[NSString stringWithFormat:@"reuse %lld / new %lld",
+                          _monitor.httpPoolReuseCount,
+                          _monitor.httpPoolOpenCount]
+                  forKey:@"http-pool"];
+    [_glView setHudValue:[NSString stringWithFormat:@"resumed %lld / %lld",
+                          _monitor.tlsResumedCount,
+                          _monitor.tlsHandshakeCount]
+                  forKey:@"tls-resume"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%@ / %d, est %@",
+                          formatedSpeed(statistics->variantBitrate / 8, 1000),
+                          statistics->bitrateSwitchCount,
+                          formatedSpeed(statistics->estimatedBandwidth / 8, 1000)]
+                  forKey:@"abr"];
     [_glView setHudValue:[NSString stringWithFormat:@"%@ / %d",
                           formatedDurationMilli(_monitor.lastHttpSeekDuration),
                           _monitor.httpSeekCount]
                   forKey:@"t-http-seek"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%@ / %lld:%lld",
+                          formatedDurationMilli(_monitor.lastDnsDuration),
+                          _monitor.dnsCacheHitCount,
+                          _monitor.dnsCacheMissCount]
+                  forKey:@"t-dns"];
+    [_glView setHudValue:[NSString stringWithFormat:@"%.1f%%", _monitor.packetPoolHitRate * 100]
+                  forKey:@"pkt-pool"];
+
+    if (statistics->pixelBufferAllocations > 0) {
+        [_glView setHudValue:[NSString stringWithFormat:@"%lld, %lld steady",
+                              statistics->pixelBufferAllocations,
+                              statistics->steadyPixelBufferAllocations]
+                      forKey:@"v-allocs"];
+    }
+    [_glView setHudValue:[NSString stringWithFormat:@"%d", statistics->pictureQueueDepth]
+                  forKey:@"pictq"];
+
+    int outputRate   = statistics->audioOutputSampleRate;
+    int hardwareRate = statistics->audioHardwareSampleRate;
+    if (outputRate > 0 && hardwareRate > 0 && outputRate != hardwareRate) {
+        [_glView setHudValue:[NSString stringWithFormat:@"%d -> %d Hz, resampled",
+                              outputRate, hardwareRate]
+                      forKey:@"a-rate"];
+    } else if (outputRate > 0) {
+        [_glView setHudValue:[NSString stringWithFormat:@"%d Hz", outputRate]
+                      forKey:@"a-rate"];
+    }
+
+    if (_liveLatencyTimer != nil) {
+        int64_t vcached = statistics->videoCachedDuration;
+        int64_t acached = statistics->audioCachedDuration;
+        [_glView setHudValue:[NSString stringWithFormat:@"%@ / %@, x%.2f",
+                              formatedDurationMilli(vcached > 0 && acached > 0 ? MIN(vcached, acached) : MAX(vcached, acached)),
+                              formatedDurationMilli(_liveTargetLatency),
+                              _liveCatchUpRate]
+                      forKey:@"live-latency"];
+    }
 }
 
 - (void)startHudTimer
@@ -782,16 +2852,27 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
     if (!_shouldShowHudView)
         return;
 
-    if (_hudTimer != nil)
+    if (_hudObserver != nil)
         return;
 
     if ([[NSThread currentThread] isMainThread]) {
         _glView.shouldShowHudView = YES;
-        _hudTimer = [NSTimer scheduledTimerWithTimeInterval:.5f
-                                                     target:self
-                                                   selector:@selector(refreshHudView)
-                                                   userInfo:nil
-                                                    repeats:YES];
+        if (!_hudQueue)
+            _hudQueue = dispatch_queue_create("tv.danmaku.ijk.hud-refresh",
+                                              dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+        __weak IJKFFMoviePlayerController *weakSelf = self;
+        _hudObserver = [_statisticsSampler addObserverWithInterval:.5f
+                                                             queue:_hudQueue
+                                                             block:^(IJKFFStatistics statistics) {
+            IJKFFMoviePlayerController *strongSelf = weakSelf;
+            if (!strongSelf)
+                return;
+            [strongSelf refreshHudView:&statistics];
+            // the last reference is not let go of off the main thread
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [strongSelf class];
+            });
+        }];
     } else {
         dispatch_async(dispatch_get_main_queue(), ^{
             [self startHudTimer];
@@ -801,13 +2882,13 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
 
 - (void)stopHudTimer
 {
-    if (_hudTimer == nil)
+    if (_hudObserver == nil)
         return;
 
     if ([[NSThread currentThread] isMainThread]) {
         _glView.shouldShowHudView = NO;
-        [_hudTimer invalidate];
-        _hudTimer = nil;
+        [_statisticsSampler removeObserver:_hudObserver];
+        _hudObserver = nil;
     } else {
         dispatch_async(dispatch_get_main_queue(), ^{
             [self stopHudTimer];
@@ -815,6 +2896,162 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
     }
 }
 
+- (int64_t)liveLatency
+{
+    int64_t vcached = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_DURATION, 0);
+    int64_t acached = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_DURATION, 0);
+    if (vcached > 0 && acached > 0)
+        return MIN(vcached, acached);
+    return MAX(vcached, acached);
+}
+
+// ramp the speed in small steps, proportionally to how far the buffer is
+// over the target, back to normal speed once it is down to the target
+- (void)refreshLiveLatency
+{
+    if (!_mediaPlayer || !ijkmp_is_playing(_mediaPlayer))
+        return;
+
+    int64_t latency = [self liveLatency];
+    float   rate    = 1.0f;
+    if (latency > _liveTargetLatency && (_liveCatchUpRate > 1.0f || latency > _liveTargetLatency + 500)) {
+        int64_t span = _liveMaxLatency > _liveTargetLatency ? _liveMaxLatency - _liveTargetLatency : 2000;
+        float   over = MIN((float)(latency - _liveTargetLatency) / span, 1.0f);
+        rate = 1.0f + (_liveMaxCatchUpRate - 1.0f) * over;
+    }
+
+    if (rate > _liveCatchUpRate)
+        rate = MIN(rate, _liveCatchUpRate + .02f);
+    else
+        rate = MAX(rate, _liveCatchUpRate - .02f);
+    if (fabsf(rate - _liveCatchUpRate) < .005f)
+        return;
+
+    _liveCatchUpRate = rate;
+    ijkmp_set_playback_rate(_mediaPlayer, rate);
+}
+
+- (void)startLiveLatencyTimer
+{
+    if (_liveTargetLatency <= 0 || _liveMaxCatchUpRate <= 1.0f || _liveTimeshiftSize > 0)
+        return;
+
+    if (_liveLatencyTimer != nil)
+        return;
+
+    if ([[NSThread currentThread] isMainThread]) {
+        _liveLatencyTimer = [NSTimer scheduledTimerWithTimeInterval:.25f
+                                                             target:self
+                                                           selector:@selector(refreshLiveLatency)
+                                                           userInfo:nil
+                                                            repeats:YES];
+    } else {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self startLiveLatencyTimer];
+        });
+    }
+}
+
+- (void)stopLiveLatencyTimer
+{
+    if (_liveLatencyTimer == nil)
+        return;
+
+    if ([[NSThread currentThread] isMainThread]) {
+        [_liveLatencyTimer invalidate];
+        _liveLatencyTimer = nil;
+    } else {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self stopLiveLatencyTimer];
+        });
+    }
+}
+
+- (void)setDecodeDegradationLevel:(IJKFFDecodeDegradationLevel)level
+{
+    NSLog(@"IJKFFMoviePlayerController: decode degradation %d -> %d\n", (int)_decodeDegradationLevel, (int)level);
+    _decodeDegradationLevel = level;
+    _decodeBehindSamples    = 0;
+    _decodeKeptUpSamples    = 0;
+    ijkmp_ios_set_decode_degradation(_mediaPlayer, (int)level);
+}
+
+// sampled twice a second: a level up once the software decoder has been
+// behind for a second, a level down once it kept up for five seconds,
+// twice as long for each level it fell back up to since
+- (void)refreshDecodeLoad
+{
+    if (!_mediaPlayer || !ijkmp_is_playing(_mediaPlayer) || _seeking || _scrubbing ||
+        (_loadState & IJKMPMovieLoadStateStalled) ||
+        ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_DECODER, 0) != FFP_PROPV_DECODER_AVCODEC) {
+        _decodeBehindSamples = 0;
+        _decodeKeptUpSamples = 0;
+        return;
+    }
+
+    float streamFps = _fpsInMeta * ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_PLAYBACK_RATE, 1.0f);
+    float decodeFps = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_VIDEO_DECODE_FRAMES_PER_SECOND, .0f);
+    float avDiff    = ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_AVDIFF, .0f);
+
+    // once the non reference frames are skipped, fewer frames come out of
+    // the decoder by design, and the lag of the video is all there is to go by
+    BOOL countsFrames = streamFps > 0 && _decodeDegradationLevel < IJKFFDecodeDegradationSkipNonRef;
+    BOOL behind       = avDiff < -.1f || (countsFrames && decodeFps < streamFps * .9f);
+    BOOL keptUp       = avDiff > -.03f && (!countsFrames || decodeFps >= streamFps * .98f);
+
+    if (behind) {
+        _decodeKeptUpSamples = 0;
+        if (++_decodeBehindSamples >= 2 && _decodeDegradationLevel < IJKFFDecodeDegradationSkipIDCT) {
+            if (_decodeRecoveryBackoff < 3 && _decodeDegradationLevel > IJKFFDecodeDegradationNone)
+                _decodeRecoveryBackoff++;
+            [self setDecodeDegradationLevel:_decodeDegradationLevel + 1];
+        }
+    } else if (keptUp) {
+        _decodeBehindSamples = 0;
+        if (++_decodeKeptUpSamples >= (10 << _decodeRecoveryBackoff) && _decodeDegradationLevel > _minimumDecodeDegradationLevel)
+            [self setDecodeDegradationLevel:_decodeDegradationLevel - 1];
+    } else {
+        _decodeBehindSamples = 0;
+        _decodeKeptUpSamples = 0;
+    }
+}
+
+- (void)startDecodeLoadTimer
+{
+    if (!_adaptiveDecodeDegradation)
+        return;
+
+    if (_decodeLoadTimer != nil)
+        return;
+
+    if ([[NSThread currentThread] isMainThread]) {
+        _decodeLoadTimer = [NSTimer scheduledTimerWithTimeInterval:.5f
+                                                            target:self
+                                                          selector:@selector(refreshDecodeLoad)
+                                                          userInfo:nil
+                                                           repeats:YES];
+    } else {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self startDecodeLoadTimer];
+        });
+    }
+}
+
+- (void)stopDecodeLoadTimer
+{
+    if (_decodeLoadTimer == nil)
+        return;
+
+    if ([[NSThread currentThread] isMainThread]) {
+        [_decodeLoadTimer invalidate];
+        _decodeLoadTimer = nil;
+    } else {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self stopDecodeLoadTimer];
+        });
+    }
+}
+
 - (void)setShouldShowHudView:(BOOL)shouldShowHudView
 {
     if (shouldShowHudView == _shouldShowHudView) {
@@ -842,10 +3079,9 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
 
 - (float)playbackRate
 {
-    if (!_mediaPlayer)
-        return 0.0f;
-
-    return ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_PLAYBACK_RATE, 0.0f);
+    FFPropertySnapshot props;
+    [self propertySnapshot:&props];
+    return props.playback_rate;
 }
 
 - (void)setPlaybackVolume:(float)volume
@@ -864,32 +3100,16 @@ inline static NSString *formatedSpeed(int64_t bytes, int64_t elapsed_milli) {
 
 - (int64_t)trafficStatistic
 {
-    if (!_mediaPlayer)
-        return 0;
-    return ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_TRAFFIC_STATISTIC_BYTE_COUNT, 0);
+    FFPropertySnapshot props;
+    [self propertySnapshot:&props];
+    return props.traffic_bytes;
 }
 
 - (float)dropFrameRate
 {
-    if (!_mediaPlayer)
-        return 0;
-    return ijkmp_get_property_float(_mediaPlayer, FFP_PROP_FLOAT_DROP_FRAME_RATE, 0.0f);
-}
-
-inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *rawMeta, const char *name, NSString *defaultValue)
-{
-    if (!meta || !rawMeta || !name)
-        return;
-
-    NSString *key = [NSString stringWithUTF8String:name];
-    const char *value = ijkmeta_get_string_l(rawMeta, name);
-    if (value) {
-        [meta setObject:[NSString stringWithUTF8String:value] forKey:key];
-    } else if (defaultValue) {
-        [meta setObject:defaultValue forKey:key];
-    } else {
-        [meta removeObjectForKey:key];
-    }
+    FFPropertySnapshot props;
+    [self propertySnapshot:&props];
+    return props.drop_frame_rate;
 }
 
 - (void)postEvent: (IJKFFMoviePlayerMessage *)msg
@@ -897,7 +3117,14 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
     if (!msg)
         return;
 
+    // posted by a core released since, by a reset or a shutdown
+    if (msg->_mediaPlayer != _mediaPlayer) {
+        [_msgPool recycle:msg];
+        return;
+    }
+
     AVMessage *avmsg = &msg->_msg;
+    [_startupRecorder didReceiveMessage:avmsg atTick:msg->_tick];
     switch (avmsg->what) {
         case FFP_MSG_FLUSH:
             break;
@@ -922,6 +3149,8 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             NSLog(@"FFP_MSG_PREPARED:\n");
 
             _monitor.prepareDuration = (int64_t)SDL_GetTickHR() - _monitor.prepareStartTick;
+            // audio only streams, the video decoder sets it as it opens
+            ijkmp_ios_update_buffering(_mediaPlayer, false);
             int64_t vdec = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_DECODER, FFP_PROPV_DECODER_UNKNOWN);
             switch (vdec) {
                 case FFP_PROPV_DECODER_VIDEOTOOLBOX:
@@ -940,82 +3169,43 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
 
             IjkMediaMeta *rawMeta = ijkmp_get_meta_l(_mediaPlayer);
             if (rawMeta) {
-                ijkmeta_lock(rawMeta);
+                IJKFFMediaMetaInfo info;
 
-                NSMutableDictionary *newMediaMeta = [[NSMutableDictionary alloc] init];
-
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_FORMAT, nil);
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_DURATION_US, nil);
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_START_US, nil);
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_BITRATE, nil);
-
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_VIDEO_STREAM, nil);
-                fillMetaInternal(newMediaMeta, rawMeta, IJKM_KEY_AUDIO_STREAM, nil);
-
-                int64_t video_stream = ijkmeta_get_int64_l(rawMeta, IJKM_KEY_VIDEO_STREAM, -1);
-                int64_t audio_stream = ijkmeta_get_int64_l(rawMeta, IJKM_KEY_AUDIO_STREAM, -1);
-
-                NSMutableArray *streams = [[NSMutableArray alloc] init];
-
-                size_t count = ijkmeta_get_children_count_l(rawMeta);
-                for(size_t i = 0; i < count; ++i) {
-                    IjkMediaMeta *streamRawMeta = ijkmeta_get_child_l(rawMeta, i);
-                    NSMutableDictionary *streamMeta = [[NSMutableDictionary alloc] init];
-
-                    if (streamRawMeta) {
-                        fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_TYPE, k_IJKM_VAL_TYPE__UNKNOWN);
-                        const char *type = ijkmeta_get_string_l(streamRawMeta, IJKM_KEY_TYPE);
-                        if (type) {
-                            fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_CODEC_NAME, nil);
-                            fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_CODEC_PROFILE, nil);
-                            fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_CODEC_LONG_NAME, nil);
-                            fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_BITRATE, nil);
-
-                            if (0 == strcmp(type, IJKM_VAL_TYPE__VIDEO)) {
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_WIDTH, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_HEIGHT, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_FPS_NUM, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_FPS_DEN, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_TBR_NUM, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_TBR_DEN, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_SAR_NUM, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_SAR_DEN, nil);
-
-                                if (video_stream == i) {
-                                    _monitor.videoMeta = streamMeta;
-
-                                    int64_t fps_num = ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_FPS_NUM, 0);
-                                    int64_t fps_den = ijkmeta_get_int64_l(streamRawMeta, IJKM_KEY_FPS_DEN, 0);
-                                    if (fps_num > 0 && fps_den > 0) {
-                                        _fpsInMeta = ((CGFloat)(fps_num)) / fps_den;
-                                        NSLog(@"fps in meta %f\n", _fpsInMeta);
-                                    }
-                                }
-
-                            } else if (0 == strcmp(type, IJKM_VAL_TYPE__AUDIO)) {
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_SAMPLE_RATE, nil);
-                                fillMetaInternal(streamMeta, streamRawMeta, IJKM_KEY_CHANNEL_LAYOUT, nil);
-
-                                if (audio_stream == i) {
-                                    _monitor.audioMeta = streamMeta;
-                                }
-                            }
-                        }
-                    }
+                // only copies the strings, the NSStrings come once looked up
+                ijkmeta_lock(rawMeta);
+                IJKFFMediaMeta *newMediaMeta = [IJKFFMediaMeta metaWithRawMeta:rawMeta info:&info];
+                ijkmeta_unlock(rawMeta);
 
-                    [streams addObject:streamMeta];
+                [_startupRecorder setHasVideo:info.videoStream >= 0 hasAudio:info.audioStream >= 0];
+                if (info.fpsNum > 0 && info.fpsDen > 0) {
+                    _fpsInMeta = ((CGFloat)(info.fpsNum)) / info.fpsDen;
+                    _glView.contentFrameRate = _fpsInMeta;
+                    for (UIView<IJKSDLRenderView> *outputView in _outputViews)
+                        outputView.contentFrameRate = _fpsInMeta;
+                    NSLog(@"fps in meta %f\n", _fpsInMeta);
                 }
 
-                [newMediaMeta setObject:streams forKey:kk_IJKM_KEY_STREAMS];
-
-                ijkmeta_unlock(rawMeta);
+                _monitor.metaInfo  = info;
+                _monitor.videoMeta = newMediaMeta.videoStreamMeta;
+                _monitor.audioMeta = newMediaMeta.audioStreamMeta;
                 _monitor.mediaMeta = newMediaMeta;
+
+                _audioStream = info.audioStream;
+                if (_audioDisabled && _audioStream >= 0)
+                    ijkmp_set_stream_selected(_mediaPlayer, (int)_audioStream, 0);
+                _videoStream = info.videoStream;
+                if (_audioOnlyActive && _videoStream >= 0)
+                    ijkmp_set_stream_selected(_mediaPlayer, (int)_videoStream, 0);
             }
             ijkmp_set_playback_rate(_mediaPlayer, [self playbackRate]);
             ijkmp_set_playback_volume(_mediaPlayer, [self playbackVolume]);
 
             [self startHudTimer];
+            [self startLiveLatencyTimer];
+            [self startDecodeLoadTimer];
             _isPreparedToPlay = YES;
+            [[IJKMediaGovernor sharedGovernor] playerDidPrepare:self];
+            [self prefetchSeekTargets];
 
             [[NSNotificationCenter defaultCenter] postNotificationName:IJKMPMediaPlaybackIsPreparedToPlayDidChangeNotification object:self];
             _loadState = IJKMPMovieLoadStatePlayable | IJKMPMovieLoadStatePlaythroughOK;
@@ -1060,6 +3250,17 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             NSLog(@"FFP_MSG_BUFFERING_START:\n");
 
             _monitor.lastPrerollStartTick = (int64_t)SDL_GetTickHR();
+            // the first buffering and those after a seek are not stalls
+            if (_firstVideoFrameRendered && !_seeking) {
+                [_statisticsSampler rebufferDidStart];
+                int64_t position = (int64_t)(self.currentPlaybackTime * 1000);
+                _blackBoxRebufferStart = (int64_t)SDL_GetTickHR();
+                ijk_blackbox_write(IJK_BB_REBUFFER_START, _blackBoxPlayer, &position, 1);
+            }
+            if (_firstVideoFrameRendered)
+                [self postRebuffer];
+            if (_firstFrameRendered)
+                ijkmp_ios_update_buffering(_mediaPlayer, true);
 
             _loadState = IJKMPMovieLoadStateStalled;
 
@@ -1072,6 +3273,12 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             NSLog(@"FFP_MSG_BUFFERING_END:\n");
 
             _monitor.lastPrerollDuration = (int64_t)SDL_GetTickHR() - _monitor.lastPrerollStartTick;
+            [_statisticsSampler rebufferDidEnd];
+            if (_blackBoxRebufferStart) {
+                int64_t stalled = (int64_t)SDL_GetTickHR() - _blackBoxRebufferStart;
+                _blackBoxRebufferStart = 0;
+                ijk_blackbox_write(IJK_BB_REBUFFER_END, _blackBoxPlayer, &stalled, 1);
+            }
 
             _loadState = IJKMPMovieLoadStatePlayable | IJKMPMovieLoadStatePlaythroughOK;
 
@@ -1108,6 +3315,12 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
              userInfo:@{IJKMPMoviePlayerDidSeekCompleteTargetKey: @(avmsg->arg1),
                         IJKMPMoviePlayerDidSeekCompleteErrorKey: @(avmsg->arg2)}];
             _seeking = NO;
+            _seekDoneTick = (int64_t)SDL_GetTickHR();
+            if (_scrubbing && _pendingScrubTime >= 0) {
+                NSTimeInterval scrubTime = _pendingScrubTime;
+                _pendingScrubTime = -1;
+                [self setCurrentPlaybackTime:scrubTime];
+            }
             break;
         }
         case FFP_MSG_VIDEO_DECODER_OPEN: {
@@ -1119,14 +3332,24 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             break;
         }
         case FFP_MSG_VIDEO_RENDERING_START: {
+            // posted twice with "fast-first-frame": early by the decoder, then by the player
+            if (_firstVideoFrameRendered)
+                break;
+            _firstVideoFrameRendered = YES;
+            _firstFrameRendered      = YES;
             NSLog(@"FFP_MSG_VIDEO_RENDERING_START:\n");
+            [self removePoster];
             _monitor.firstVideoFrameLatency = (int64_t)SDL_GetTickHR() - _monitor.prepareStartTick;
             [[NSNotificationCenter defaultCenter]
              postNotificationName:IJKMPMoviePlayerFirstVideoFrameRenderedNotification
              object:self];
+            // after startup, not competing with it
+            if (_prefetchesScrubPreviews)
+                [self.scrubPreviews prefetchWithCompletion:nil];
             break;
         }
         case FFP_MSG_AUDIO_RENDERING_START: {
+            _firstFrameRendered = YES;
             NSLog(@"FFP_MSG_AUDIO_RENDERING_START:\n");
             [[NSNotificationCenter defaultCenter]
              postNotificationName:IJKMPMoviePlayerFirstAudioFrameRenderedNotification
@@ -1134,11 +3357,14 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             break;
         }
         case FFP_MSG_ACCURATE_SEEK_COMPLETE: {
-            NSLog(@"FFP_MSG_ACCURATE_SEEK_COMPLETE:\n");
+            int skippedFrames = ijkmp_ios_get_seek_skipped_frames(_mediaPlayer);
+            NSLog(@"FFP_MSG_ACCURATE_SEEK_COMPLETE: %d frames skipped\n", skippedFrames);
+            _monitor.lastAccurateSeekSkippedFrames = skippedFrames;
             [[NSNotificationCenter defaultCenter]
              postNotificationName:IJKMPMoviePlayerAccurateSeekCompleteNotification
              object:self
-             userInfo:@{IJKMPMoviePlayerDidAccurateSeekCompleteCurPos: @(avmsg->arg1)}];
+             userInfo:@{IJKMPMoviePlayerDidAccurateSeekCompleteCurPos: @(avmsg->arg1),
+                        IJKMPMoviePlayerDidAccurateSeekCompleteSkippedFrames: @(skippedFrames)}];
             break;
         }
         default:
@@ -1146,37 +3372,278 @@ inline static void fillMetaInternal(NSMutableDictionary *meta, IjkMediaMeta *raw
             break;
     }
 
+    switch (avmsg->what) {
+        case FFP_MSG_ERROR:
+        case FFP_MSG_PREPARED:
+        case FFP_MSG_VIDEO_RENDERING_START:
+        case FFP_MSG_AUDIO_RENDERING_START:
+            [self reportStartup:NO];
+            break;
+    }
+
+    [_msgPool recycle:msg];
+}
+
+// a batch of the message loop, linked by _next
+- (void)postEventList: (IJKFFMoviePlayerMessage *)msg
+{
+    while (msg) {
+        IJKFFMoviePlayerMessage *next = (__bridge_transfer IJKFFMoviePlayerMessage *)msg->_next;
+        msg->_next = NULL;
+        [self postEvent:msg];
+        msg = next;
+    }
+}
+
+- (IJKMPMovieRebufferCause)rebufferCauseWithVideoCached:(int64_t)videoCached
+                                             throughput:(int64_t)throughput
+                                                bitrate:(int64_t)bitrate
+{
+    if (_seeking)
+        return IJKMPMovieRebufferCauseSeek;
+    if (videoCached >= IJK_REBUFFER_DECODER_MIN_CACHED_MS)
+        return IJKMPMovieRebufferCauseDecoderStarvation;
+    // reset by the did events, on the io thread
+    if (_monitor.httpOpenTick > 0 || _monitor.httpSeekTick > 0)
+        return IJKMPMovieRebufferCauseConnect;
+
+    NSString *format = _monitor.mediaMeta[k_IJKM_KEY_FORMAT];
+    if (throughput <= 0 && [format rangeOfString:@"hls"].location != NSNotFound)
+        return IJKMPMovieRebufferCauseSegmentGap;
+    if (bitrate > 0 && throughput < bitrate)
+        return IJKMPMovieRebufferCauseThroughput;
+    return IJKMPMovieRebufferCauseUnknown;
+}
+
+- (void)postRebuffer
+{
+    if (!_mediaPlayer)
+        return;
+
+    int64_t videoCached = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_DURATION, 0);
+    int64_t throughput  = ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_TCP_SPEED, 0) * 8;
+    // the variant played is what has to come in time
+    int64_t bitrate     = _monitor.hlsVariantBitrate > 0 ? _monitor.hlsVariantBitrate
+                                                          : ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_BIT_RATE, 0);
+    IJKMPMovieRebufferCause cause = [self rebufferCauseWithVideoCached:videoCached throughput:throughput bitrate:bitrate];
+
+    [[NSNotificationCenter defaultCenter]
+     postNotificationName:IJKMPMoviePlayerRebufferNotification
+     object:self
+     userInfo:@{
+        IJKMPMoviePlayerRebufferCauseUserInfoKey:               @(cause),
+        IJKMPMoviePlayerRebufferVideoCachedDurationUserInfoKey: @(videoCached),
+        IJKMPMoviePlayerRebufferAudioCachedDurationUserInfoKey: @(ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_DURATION, 0)),
+        IJKMPMoviePlayerRebufferVideoCachedBytesUserInfoKey:    @(ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_VIDEO_CACHED_BYTES, 0)),
+        IJKMPMoviePlayerRebufferAudioCachedBytesUserInfoKey:    @(ijkmp_get_property_int64(_mediaPlayer, FFP_PROP_INT64_AUDIO_CACHED_BYTES, 0)),
+        IJKMPMoviePlayerRebufferThroughputUserInfoKey:          @(throughput),
+        IJKMPMoviePlayerRebufferBitrateUserInfoKey:             @(bitrate)}];
+}
+
+// once per play: when its streams started, or force, as it ends before
+- (void)reportStartup:(BOOL)force
+{
+    if (_mediaPlayer)
+        [_startupRecorder didTakeFirstPacketAtTick:ijkmp_ios_get_first_packet_tick(_mediaPlayer)];
+
+    IJKFFStartupReport report;
+    if (![_startupRecorder finish:force report:&report])
+        return;
+
+    FFBufferingThresholds buffering;
+    if (_mediaPlayer && ijkmp_ios_get_buffering(_mediaPlayer, &buffering)) {
+        report.startBuffer      = buffering.start_ms;
+        report.resumeBuffer     = buffering.resume_ms;
+        report.bufferingRate    = buffering.rate;
+        report.bufferingBitRate = buffering.bit_rate;
+    } else {
+        report.startBuffer  = -1;
+        report.resumeBuffer = -1;
+    }
+
+    _startupReport = report;
+    [[NSNotificationCenter defaultCenter]
+     postNotificationName:IJKMPMoviePlayerStartupReportNotification
+     object:self];
+}
+
+- (IJKFFMoviePlayerMessage *) obtainMessageWithCache:(void **)cache {
+    return [_msgPool obtainWithCache:cache];
+}
+
+- (void) recycleMessage:(IJKFFMoviePlayerMessage *)msg {
     [_msgPool recycle:msg];
 }
 
-- (IJKFFMoviePlayerMessage *) obtainMessage {
-    return [_msgPool obtain];
+// the messages a batch delivers once, the latest one only
+static BOOL msg_is_progress(int what)
+{
+    switch (what) {
+        case FFP_MSG_BUFFERING_UPDATE:
+        case FFP_MSG_BUFFERING_BYTES_UPDATE:
+        case FFP_MSG_BUFFERING_TIME_UPDATE:
+            return YES;
+        default:
+            return NO;
+    }
 }
 
 inline static IJKFFMoviePlayerController *ffplayerRetain(void *arg) {
     return (__bridge_transfer IJKFFMoviePlayerController *) arg;
 }
 
+// The stages of a prepare, from the messages of the core: seen from the
+// message thread, which wakes up as soon as they are posted.
+#define IJK_TRACE_OPENED(stage) (1 << (stage))
+
+static void trace_stage_next(const void *player, uint32_t *opened, IJKTraceStage stage, IJKTraceStage next)
+{
+    if (*opened & IJK_TRACE_OPENED(stage)) {
+        ijk_trace_end(stage, player, player, 0);
+        *opened &= ~IJK_TRACE_OPENED(stage);
+    }
+    if (next != stage) {
+        ijk_trace_begin(next, player, player, NULL);
+        *opened |= IJK_TRACE_OPENED(next);
+    }
+}
+
+static void trace_player_message(const void *player, uint32_t *opened, const AVMessage *msg)
+{
+    switch (msg->what) {
+        case FFP_MSG_OPEN_INPUT:
+            trace_stage_next(player, opened, IJK_TRACE_OPEN_INPUT, IJK_TRACE_PROBE);
+            break;
+        case FFP_MSG_FIND_STREAM_INFO:
+            trace_stage_next(player, opened, IJK_TRACE_PROBE, IJK_TRACE_OPEN_COMPONENTS);
+            break;
+        case FFP_MSG_COMPONENT_OPEN:
+            trace_stage_next(player, opened, IJK_TRACE_OPEN_COMPONENTS, IJK_TRACE_OPEN_COMPONENTS);
+            break;
+        case FFP_MSG_PREPARED:
+            trace_stage_next(player, opened, IJK_TRACE_PREPARE, IJK_TRACE_PREPARE);
+            break;
+        case FFP_MSG_VIDEO_DECODED_START:
+            ijk_trace_event(IJK_TRACE_FIRST_DECODE, player, NULL);
+            break;
+        case FFP_MSG_VIDEO_RENDERING_START:
+            // posted twice with "fast-first-frame"
+            if (*opened & IJK_TRACE_OPENED(IJK_TRACE_FIRST_FRAME)) {
+                ijk_trace_event(IJK_TRACE_FIRST_PRESENT, player, NULL);
+                trace_stage_next(player, opened, IJK_TRACE_FIRST_FRAME, IJK_TRACE_FIRST_FRAME);
+            }
+            break;
+        case FFP_MSG_ERROR:
+            for (int stage = 0; stage < 32; ++stage) {
+                if (*opened & IJK_TRACE_OPENED(stage))
+                    ijk_trace_end((IJKTraceStage)stage, player, player, msg->arg1 ? msg->arg1 : -1);
+            }
+            *opened = 0;
+            break;
+    }
+}
+
+static void media_player_post_batch(void *context)
+{
+    IJKFFMoviePlayerMessage    *head       = (__bridge_transfer IJKFFMoviePlayerMessage *)context;
+    IJKFFMoviePlayerController *controller = head->_target;
+    head->_target = nil;
+    [controller postEventList:head];
+}
+
 int media_player_msg_loop(void* arg)
 {
     @autoreleasepool {
         IjkMediaPlayer *mp = (IjkMediaPlayer*)arg;
         __weak IJKFFMoviePlayerController *ffpController = ffplayerRetain(ijkmp_set_weak_thiz(mp, NULL));
-        while (ffpController) {
-            @autoreleasepool {
-                IJKFFMoviePlayerMessage *msg = [ffpController obtainMessage];
-                if (!msg)
-                    break;
 
-                int retval = ijkmp_get_msg(mp, &msg->_msg, 1);
-                if (retval < 0)
-                    break;
+        // started by prepare_async, opening the input is the first thing the core does
+        const void *tracePlayer = ijkmp_ios_get_trace_player(mp);
+        uint32_t    traceOpened = 0;
+        if (ijk_trace_enabled()) {
+            ijk_trace_begin(IJK_TRACE_FIRST_FRAME, tracePlayer, tracePlayer, NULL);
+            ijk_trace_begin(IJK_TRACE_PREPARE,     tracePlayer, tracePlayer, NULL);
+            ijk_trace_begin(IJK_TRACE_OPEN_INPUT,  tracePlayer, tracePlayer, NULL);
+            traceOpened = IJK_TRACE_OPENED(IJK_TRACE_FIRST_FRAME) |
+                          IJK_TRACE_OPENED(IJK_TRACE_PREPARE) |
+                          IJK_TRACE_OPENED(IJK_TRACE_OPEN_INPUT);
+        }
 
-                // block-get should never return 0
-                assert(retval > 0);
-                [ffpController performSelectorOnMainThread:@selector(postEvent:) withObject:msg waitUntilDone:NO];
+        // the getters of the controller read what it samples, lock free
+        ijkmp_ios_start_property_publisher(mp);
+
+        void *msgCache = NULL;
+        BOOL aborted = NO;
+        while (ffpController && !aborted) {
+            @autoreleasepool {
+                // blocks for the first message, then takes what else is
+                // pending; the batch is linked by _next, nothing allocated
+                IJKFFMoviePlayerMessage *head = nil;
+                __unsafe_unretained IJKFFMoviePlayerMessage *tail = nil;
+                int count = 0;
+                while (count < IJK_MSG_BATCH_MAX) {
+                    IJKFFMoviePlayerMessage *msg = [ffpController obtainMessageWithCache:&msgCache];
+                    if (!msg) {
+                        aborted = YES;
+                        break;
+                    }
+                    msg->_mediaPlayer = mp;
+
+                    int retval = ijkmp_get_msg(mp, &msg->_msg, count == 0);
+                    if (retval <= 0) {
+                        // block-get should never return 0
+                        assert(retval < 0 || count > 0);
+                        aborted = retval < 0;
+                        [ffpController recycleMessage:msg];
+                        break;
+                    }
+                    msg->_tick = (int64_t)SDL_GetTickHR();
+
+                    if (traceOpened)
+                        trace_player_message(tracePlayer, &traceOpened, &msg->_msg);
+                    if (msg_is_progress(msg->_msg.what)) {
+                        __unsafe_unretained IJKFFMoviePlayerMessage *prev = nil;
+                        for (__unsafe_unretained IJKFFMoviePlayerMessage *it = head; it;
+                             prev = it, it = (__bridge IJKFFMoviePlayerMessage *)it->_next) {
+                            if (it->_msg.what != msg->_msg.what)
+                                continue;
+                            if (tail == it)
+                                tail = prev;
+                            if (prev) {
+                                IJKFFMoviePlayerMessage *superseded = (__bridge_transfer IJKFFMoviePlayerMessage *)prev->_next;
+                                prev->_next = superseded->_next;
+                                superseded->_next = NULL;
+                                [ffpController recycleMessage:superseded];
+                            } else {
+                                IJKFFMoviePlayerMessage *superseded = head;
+                                head = (__bridge_transfer IJKFFMoviePlayerMessage *)superseded->_next;
+                                superseded->_next = NULL;
+                                [ffpController recycleMessage:superseded];
+                            }
+                            --count;
+                            break;
+                        }
+                    }
+                    if (tail)
+                        tail->_next = (__bridge_retained void *)msg;
+                    else
+                        head = msg;
+                    tail = msg;
+                    ++count;
+                }
+
+                IJKFFMoviePlayerController *controller = ffpController;
+                if (controller && head) {
+                    head->_target = controller;
+                    dispatch_async_f(controller.messageQueue ?: dispatch_get_main_queue(),
+                                     (__bridge_retained void *)head, media_player_post_batch);
+                } else {
+                    IJKFFMoviePlayerMessageListRelease(head ? (__bridge_retained void *)head : NULL);
+                }
             }
         }
+        IJKFFMoviePlayerMessageListRelease(msgCache);
+        ijkmp_ios_stop_property_publisher(mp);
 
         // retained in prepare_async, before SDL_CreateThreadEx
         ijkmp_dec_ref_p(&mp);
@@ -1228,19 +3695,10 @@ static int onInjectTcpIOControl(IJKFFMoviePlayerController *mpc, id<IJKMediaUrlO
     assert(realData);
     assert(sizeof(AVAppTcpIOControl) == data_size);
 
-    switch (type) {
-        case IJKMediaCtrl_WillTcpOpen:
-
-            break;
-        case IJKMediaCtrl_DidTcpOpen:
-            mpc->_monitor.tcpError = realData->error;
-            mpc->_monitor.remoteIp = [NSString stringWithUTF8String:realData->ip];
-            [mpc->_glView setHudValue: mpc->_monitor.remoteIp forKey:@"ip"];
-            break;
-        default:
-            assert(!"unexcepted type for tcp io control");
-            break;
-    }
+    // connect() runs on the thread that asked for it, which tells the
+    // attempts of concurrent opens apart
+    assert(type == IJKMediaCtrl_WillTcpOpen);
+    ijk_trace_begin(IJK_TRACE_TCP_CONNECT, pthread_self(), ijkmp_ios_get_trace_player(mpc->_mediaPlayer), NULL);
 
     if (delegate == nil)
         return 0;
@@ -1257,6 +3715,42 @@ static int onInjectTcpIOControl(IJKFFMoviePlayerController *mpc, id<IJKMediaUrlO
     [delegate willOpenUrl:openData];
     if (openData.error < 0)
         return -1;
+    return 0;
+}
+
+// deferred, the connection is open already
+static int onInjectTcpDidOpen(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppTcpIOControl *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppTcpIOControl) == data_size);
+
+    mpc->_monitor.tcpError = realData->error;
+    // a failed open, without a peer; the delegate hears of connections made
+    if (realData->error)
+        return 0;
+    mpc->_monitor.remoteIp = [NSString stringWithUTF8String:realData->ip];
+    mpc->_monitor.tcpFamily = realData->family;
+    mpc->_monitor.lastTcpConnectDuration = realData->elapsed_milli;
+    [mpc->_startupRecorder tcpDidConnectIn:realData->elapsed_milli];
+    [mpc->_glView setHudValue: mpc->_monitor.remoteIp forKey:@"ip"];
+    [mpc->_glView setHudValue:[NSString stringWithFormat:@"%@ %@",
+                               formatedDurationMilli(realData->elapsed_milli),
+                               realData->family == AF_INET6 ? @"IPv6" : @"IPv4"]
+                       forKey:@"t-tcp-connect"];
+
+    id<IJKMediaUrlOpenDelegate> delegate = mpc.tcpOpenDelegate;
+    if (delegate == nil)
+        return 0;
+
+    IJKMediaUrlOpenData *openData =
+    [[IJKMediaUrlOpenData alloc] initWithUrl:[NSString stringWithUTF8String:realData->ip]
+                                       event:(IJKMediaEvent)type
+                                segmentIndex:0
+                                retryCounter:0];
+    openData.fd = realData->fd;
+
+    [delegate willOpenUrl:openData];
     [mpc->_glView setHudValue: [NSString stringWithFormat:@"fd:%d %@", openData.fd, openData.msg?:@"unknown"] forKey:@"tcp-info"];
     return 0;
 }
@@ -1271,7 +3765,219 @@ static int onInjectAsyncStatistic(IJKFFMoviePlayerController *mpc, int type, voi
     return 0;
 }
 
-static int onInectIJKIOStatistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+static int onInjectAsyncReadAhead(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+{
+    AVAppAsyncReadAhead *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppAsyncReadAhead) == data_size);
+
+    IjkMediaPlayer *mp = mpc->_mediaPlayer;
+    if (mp)
+        realData->bit_rate = ijkmp_get_property_int64(mp, FFP_PROP_INT64_BIT_RATE, 0);
+    realData->max_io_rate = [[IJKMediaGovernor sharedGovernor] ioRateOfPlayer:mpc];
+    realData->max_memory  = mpc->_maxReadAheadMemory;
+    return 0;
+}
+
+static int onInjectDnsStatistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppDnsStatistic *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppDnsStatistic) == data_size);
+
+    mpc->_monitor.dnsCacheHitCount  = realData->hits + realData->negative_hits;
+    mpc->_monitor.dnsCacheMissCount = realData->misses;
+    mpc->_monitor.lastDnsDuration   = realData->elapsed_milli;
+    [mpc->_startupRecorder dnsDidLookUpFromCache:realData->cache_result != 0];
+    return 0;
+}
+
+static int onInjectHttpPoolStatistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppHttpPoolStatistic *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHttpPoolStatistic) == data_size);
+
+    mpc->_monitor.httpPoolOpenCount  = realData->opened;
+    mpc->_monitor.httpPoolReuseCount = realData->reused;
+    [mpc->_startupRecorder httpDidOpenOnReusedConnection:realData->is_reused];
+    return 0;
+}
+
+static int onInjectTlsStatistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppTlsStatistic *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppTlsStatistic) == data_size);
+
+    mpc->_monitor.tlsHandshakeCount = realData->handshakes;
+    mpc->_monitor.tlsResumedCount   = realData->resumed;
+    [mpc->_startupRecorder tlsDidHandshakeResumed:realData->is_resumed];
+    return 0;
+}
+
+static int onInjectHttp3Statistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppHttp3Statistic *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHttp3Statistic) == data_size);
+
+    IJKFFMonitor *monitor = mpc->_monitor;
+    monitor.http3RequestCount++;
+    if (strcmp(realData->protocol, "h3"))
+        monitor.http3FallbackCount++;
+    if (realData->reused)
+        monitor.http3ReusedCount++;
+    else if (realData->connect_time > 0)
+        monitor.lastHttp3ConnectDuration = realData->connect_time / 1000;
+    if (realData->remote_ip[0])
+        monitor.remoteIp = @(realData->remote_ip);
+    [mpc->_glView setHudValue:[NSString stringWithFormat:@"%s %@", realData->protocol,
+                               realData->reused ? @"reused" : formatedDurationMilli(realData->connect_time / 1000)]
+                       forKey:@"http3"];
+    return 0;
+}
+
+static int onInjectHttpMirror(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppHttpMirror *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHttpMirror) == data_size);
+
+    IJKFFMonitor *monitor = mpc->_monitor;
+    monitor.mirrorUrl = @(realData->url);
+    if (realData->reason == AVAPP_HTTP_MIRROR_FAILOVER)
+        monitor.mirrorFailoverCount++;
+    [mpc->_glView setHudValue:[NSString stringWithFormat:@"%@ %@", [NSURL URLWithString:monitor.mirrorUrl].host,
+                               formatedDurationMilli(realData->elapsed / 1000)]
+                       forKey:@"mirror"];
+    return 0;
+}
+
+static int onInjectHttpRequest(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppHttpRequest *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHttpRequest) == data_size);
+
+    IJKFFNetworkRequest *request = [[IJKFFNetworkRequest alloc] init];
+    request.url         = @(realData->url);
+    request.protocol    = @(realData->protocol);
+    request.httpCode    = realData->http_code;
+    request.error       = realData->error;
+    request.complete    = realData->is_complete;
+    request.reused      = realData->is_reused;
+    request.offset      = realData->offset;
+    request.bytes       = realData->bytes;
+    request.startDate   = [NSDate dateWithTimeIntervalSince1970:realData->start_time / 1000000.0];
+    request.dnsTime     = realData->dns_time;
+    request.connectTime = realData->connect_time;
+    request.tlsTime     = realData->tls_time;
+    request.sendTime    = realData->send_time;
+    request.waitTime    = realData->wait_time;
+    request.receiveTime = realData->receive_time;
+    request.cacheStatus = realData->cache_status[0] ? @(realData->cache_status) : nil;
+    request.age         = realData->age;
+    request.edge        = realData->edge[0] ? @(realData->edge) : nil;
+    [mpc->_monitor addNetworkRequest:request];
+
+    [mpc->_glView setHudValue:[NSString stringWithFormat:@"%@ %@%@", formatedDurationMilli(request.timeToFirstByte / 1000),
+                               formatedDurationMilli(request.receiveTime / 1000),
+                               request.cacheStatus ? [@" " stringByAppendingString:request.cacheStatus] : @""]
+                       forKey:@"request"];
+    return 0;
+}
+
+static int onInjectNetStage(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+{
+    AVAppNetStage *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppNetStage) == data_size);
+
+    const void *player = ijkmp_ios_get_trace_player(mpc->_mediaPlayer);
+
+    switch (type) {
+        case AVAPP_EVENT_WILL_DNS_RESOLVE:
+            ijk_trace_begin(IJK_TRACE_DNS, realData->obj, player, realData->host);
+            [mpc->_startupRecorder netStage:IJK_TRACE_DNS willStartWithObject:realData->obj];
+            break;
+        case AVAPP_EVENT_DID_DNS_RESOLVE:
+            ijk_trace_end(IJK_TRACE_DNS, realData->obj, player, realData->error);
+            [mpc->_startupRecorder netStage:IJK_TRACE_DNS didEndWithObject:realData->obj];
+            break;
+        case AVAPP_EVENT_WILL_TLS_HANDSHAKE:
+            ijk_trace_begin(IJK_TRACE_TLS_HANDSHAKE, realData->obj, player, realData->host);
+            [mpc->_startupRecorder netStage:IJK_TRACE_TLS_HANDSHAKE willStartWithObject:realData->obj];
+            break;
+        case AVAPP_EVENT_DID_TLS_HANDSHAKE:
+            ijk_trace_end(IJK_TRACE_TLS_HANDSHAKE, realData->obj, player, realData->error);
+            [mpc->_startupRecorder netStage:IJK_TRACE_TLS_HANDSHAKE didEndWithObject:realData->obj];
+            break;
+    }
+    return 0;
+}
+
+static int onInjectHlsBufferLevel(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+{
+    AVAppBufferLevel *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppBufferLevel) == data_size);
+
+    IjkMediaPlayer *mp = mpc->_mediaPlayer;
+    if (!mp)
+        return 0;
+
+    int64_t vcached = ijkmp_get_property_int64(mp, FFP_PROP_INT64_VIDEO_CACHED_DURATION, 0);
+    int64_t acached = ijkmp_get_property_int64(mp, FFP_PROP_INT64_AUDIO_CACHED_DURATION, 0);
+    if (vcached > 0 && acached > 0)
+        realData->cached_duration_milli = MIN(vcached, acached);
+    else
+        realData->cached_duration_milli = MAX(vcached, acached);
+    realData->audio_cached_duration_milli = acached;
+    realData->video_cached_duration_milli = vcached;
+    int64_t maxBitrate = mpc->_thermalMaxBitrate;
+    if (mpc->_maxBitrate > 0 && (maxBitrate <= 0 || mpc->_maxBitrate < maxBitrate))
+        maxBitrate = mpc->_maxBitrate;
+    realData->max_bitrate                 = maxBitrate;
+    realData->audio_only                  = mpc->_audioOnlyActive;
+    return 0;
+}
+
+static int onInjectHlsKey(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+{
+    AVAppHLSKey *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHLSKey) == data_size);
+
+    id<IJKMediaKeyDelegate> delegate = mpc.keyDelegate;
+    if (!delegate)
+        return 0;
+
+    NSData *key = [delegate keyForUrl:[NSString stringWithUTF8String:realData->url]];
+    if (key.length != sizeof(realData->key))
+        return 0;
+    memcpy(realData->key, key.bytes, sizeof(realData->key));
+    realData->is_handled = 1;
+    return 0;
+}
+
+static int onInjectHlsVariantSwitch(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
+{
+    AVAppVariantSwitch *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppVariantSwitch) == data_size);
+
+    mpc->_monitor.hlsVariantBitrate     = realData->to_bitrate;
+    mpc->_monitor.hlsEstimatedBandwidth = realData->estimated_bandwidth;
+    mpc->_monitor.hlsVariantSwitchCount++;
+    [mpc->_statisticsSampler variantDidSwitchToBitrate:realData->to_bitrate
+                                    estimatedBandwidth:realData->estimated_bandwidth];
+    int64_t values[3] = { realData->from_bitrate, realData->to_bitrate, realData->estimated_bandwidth };
+    ijk_blackbox_write(IJK_BB_VARIANT_SWITCH, mpc->_blackBoxPlayer, values, 3);
+    return 0;
+}
+
+static int onInectIJKIOStatistic(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
 {
     IjkIOAppCacheStatistic *realData = data;
     assert(realData);
@@ -1292,7 +3998,43 @@ static int64_t calculateElapsed(int64_t begin, int64_t end)
     return end - begin;
 }
 
-static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+// the trace and the startup stages, keyed by the URLContext, which is only
+// alive while the hook runs
+static int onInjectHttpStage(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size)
+{
+    AVAppHttpEvent *realData = data;
+    assert(realData);
+    assert(sizeof(AVAppHttpEvent) == data_size);
+
+    const void *player = ijkmp_ios_get_trace_player(mpc->_mediaPlayer);
+
+    switch (type) {
+        case AVAPP_EVENT_WILL_HTTP_OPEN:
+            [mpc->_startupRecorder netStage:IJK_TRACE_HTTP_OPEN willStartWithObject:realData->obj];
+            if (ijk_trace_enabled()) {
+                NSString *host = [NSURL URLWithString:[NSString stringWithUTF8String:realData->url]].host;
+                ijk_trace_begin(IJK_TRACE_HTTP_OPEN, realData->obj, player, [host UTF8String]);
+            }
+            break;
+        case AVAPP_EVENT_DID_HTTP_OPEN:
+            ijk_trace_end(IJK_TRACE_HTTP_OPEN, realData->obj, player, realData->error);
+            [mpc->_startupRecorder netStage:IJK_TRACE_HTTP_OPEN didEndWithObject:realData->obj];
+            break;
+        case AVAPP_EVENT_WILL_HTTP_SEEK:
+            if (ijk_trace_enabled())
+                ijk_trace_begin(IJK_TRACE_HTTP_SEEK, realData->obj, player,
+                                [[NSString stringWithFormat:@"%@ @%lld", mpc->_monitor.httpHost, realData->offset] UTF8String]);
+            break;
+        case AVAPP_EVENT_DID_HTTP_SEEK:
+            ijk_trace_end(IJK_TRACE_HTTP_SEEK, realData->obj, player, realData->error);
+            break;
+    }
+
+    return 0;
+}
+
+// deferred, tick is when the event happened
+static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick)
 {
     AVAppHttpEvent *realData = data;
     assert(realData);
@@ -1315,7 +4057,7 @@ static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *
 
             monitor.httpUrl      = url;
             monitor.httpHost     = host;
-            monitor.httpOpenTick = SDL_GetTickHR();
+            monitor.httpOpenTick = tick;
             [mpc setHudUrl:url];
 
             if (delegate != nil) {
@@ -1325,13 +4067,17 @@ static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *
             }
             break;
         case AVAPP_EVENT_DID_HTTP_OPEN:
-            elapsed = calculateElapsed(monitor.httpOpenTick, SDL_GetTickHR());
+            elapsed = calculateElapsed(monitor.httpOpenTick, tick);
             monitor.httpError = realData->error;
             monitor.httpCode  = realData->http_code;
             monitor.httpOpenCount++;
             monitor.httpOpenTick = 0;
             monitor.lastHttpOpenDuration = elapsed;
             [mpc->_glView setHudValue:@(realData->http_code).stringValue forKey:@"http"];
+            if (realData->error || realData->http_code >= 400) {
+                int64_t values[2] = { realData->error, realData->http_code };
+                ijk_blackbox_write(IJK_BB_NETWORK, mpc->_blackBoxPlayer, values, 2);
+            }
 
             if (delegate != nil) {
                 dict[IJKMediaEventAttrKey_time_of_event]    = @(elapsed).stringValue;
@@ -1343,7 +4089,7 @@ static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *
             }
             break;
         case AVAPP_EVENT_WILL_HTTP_SEEK:
-            monitor.httpSeekTick = SDL_GetTickHR();
+            monitor.httpSeekTick = tick;
 
             if (delegate != nil) {
                 dict[IJKMediaEventAttrKey_host]         = [NSString ijk_stringBeEmptyIfNil:host];
@@ -1352,7 +4098,7 @@ static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *
             }
             break;
         case AVAPP_EVENT_DID_HTTP_SEEK:
-            elapsed = calculateElapsed(monitor.httpSeekTick, SDL_GetTickHR());
+            elapsed = calculateElapsed(monitor.httpSeekTick, tick);
             monitor.httpError = realData->error;
             monitor.httpCode  = realData->http_code;
             monitor.httpSeekCount++;
@@ -1375,15 +4121,71 @@ static int onInjectOnHttpEvent(IJKFFMoviePlayerController *mpc, int type, void *
     return 0;
 }
 
-// NOTE: could be called from multiple thread
-static int ijkff_inject_callback(void *opaque, int message, void *data, size_t data_size)
+typedef int (*IJKInjectHandler)(IJKFFMoviePlayerController *mpc, int type, void *data, size_t data_size, int64_t tick);
+
+// an informational event, copied off the io thread
+typedef struct IJKInjectEvent {
+    void             *weakHolder;   // retained
+    IJKInjectHandler  handler;
+    int               message;
+    int64_t           tick;         // SDL_GetTickHR() when posted
+    size_t            data_size;
+    uint8_t           data[];
+} IJKInjectEvent;
+
+static int inject_hook_index(int message)
 {
-    IJKWeakHolder *weakHolder = (__bridge IJKWeakHolder*)opaque;
-    IJKFFMoviePlayerController *mpc = weakHolder.object;
-    if (!mpc)
+    for (int i = 0; i < IJK_INJECT_HOOK_COUNT; ++i) {
+        if (g_inject_hooks[i] == message)
+            return i;
+    }
+    return -1;
+}
+
+static void inject_deliver(void *context)
+{
+    IJKInjectEvent *event = context;
+
+    @autoreleasepool {
+        IJKWeakHolder *weakHolder = (__bridge_transfer IJKWeakHolder *)event->weakHolder;
+        IJKFFMoviePlayerController *mpc = weakHolder.object;
+        if (mpc) {
+            int64_t begin = av_gettime_relative();
+            event->handler(mpc, event->message, event->data, event->data_size, event->tick);
+
+            int index = inject_hook_index(event->message);
+            if (index >= 0)
+                atomic_fetch_add(&mpc->_injectHookStats[index].deferred, av_gettime_relative() - begin);
+        }
+    }
+    free(event);
+}
+
+// the io thread only pays for a copy and an enqueue, the serial queue keeps
+// the events of a player in order
+static int inject_async(IJKFFMoviePlayerController *mpc, IJKWeakHolder *weakHolder, int message,
+                        void *data, size_t data_size, IJKInjectHandler handler)
+{
+    IJKInjectEvent *event = malloc(sizeof(IJKInjectEvent) + data_size);
+    if (!event)
         return 0;
 
+    event->weakHolder = (__bridge_retained void *)weakHolder;
+    event->handler    = handler;
+    event->message    = message;
+    event->tick       = SDL_GetTickHR();
+    event->data_size  = data_size;
+    if (data_size > 0)
+        memcpy(event->data, data, data_size);
+
+    dispatch_async_f(mpc->_injectQueue, event, inject_deliver);
+    return 0;
+}
+
+static int inject_dispatch(IJKFFMoviePlayerController *mpc, IJKWeakHolder *weakHolder, int message, void *data, size_t data_size)
+{
     switch (message) {
+        // control, the caller waits for the answer
         case AVAPP_CTRL_WILL_CONCAT_SEGMENT_OPEN:
             return onInjectIOControl(mpc, mpc.segmentOpenDelegate, message, data, data_size);
         case AVAPP_CTRL_WILL_TCP_OPEN:
@@ -1392,23 +4194,80 @@ static int ijkff_inject_callback(void *opaque, int message, void *data, size_t d
             return onInjectIOControl(mpc, mpc.httpOpenDelegate, message, data, data_size);
         case AVAPP_CTRL_WILL_LIVE_OPEN:
             return onInjectIOControl(mpc, mpc.liveOpenDelegate, message, data, data_size);
-        case AVAPP_EVENT_ASYNC_STATISTIC:
-            return onInjectAsyncStatistic(mpc, message, data, data_size);
-        case IJKIOAPP_EVENT_CACHE_STATISTIC:
-            return onInectIJKIOStatistic(mpc, message, data, data_size);
-        case AVAPP_CTRL_DID_TCP_OPEN:
-            return onInjectTcpIOControl(mpc, mpc.tcpOpenDelegate, message, data, data_size);
+        case AVAPP_CTRL_ASYNC_READ_AHEAD:
+            return onInjectAsyncReadAhead(mpc, message, data, data_size);
+        case AVAPP_CTRL_HLS_BUFFER_LEVEL:
+            return onInjectHlsBufferLevel(mpc, message, data, data_size);
+        case AVAPP_CTRL_HLS_KEY:
+            return onInjectHlsKey(mpc, message, data, data_size);
+
+        // keyed by the calling thread or a context alive for the call only
+        case AVAPP_EVENT_WILL_DNS_RESOLVE:
+        case AVAPP_EVENT_DID_DNS_RESOLVE:
+        case AVAPP_EVENT_WILL_TLS_HANDSHAKE:
+        case AVAPP_EVENT_DID_TLS_HANDSHAKE:
+            return onInjectNetStage(mpc, message, data, data_size);
+        case AVAPP_CTRL_DID_TCP_OPEN: {
+            AVAppTcpIOControl *realData = data;
+            ijk_trace_end(IJK_TRACE_TCP_CONNECT, pthread_self(), ijkmp_ios_get_trace_player(mpc->_mediaPlayer), realData->error);
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectTcpDidOpen);
+        }
         case AVAPP_EVENT_WILL_HTTP_OPEN:
         case AVAPP_EVENT_DID_HTTP_OPEN:
         case AVAPP_EVENT_WILL_HTTP_SEEK:
         case AVAPP_EVENT_DID_HTTP_SEEK:
-            return onInjectOnHttpEvent(mpc, message, data, data_size);
+            onInjectHttpStage(mpc, message, data, data_size);
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectOnHttpEvent);
+
+        // informational
+        case AVAPP_EVENT_ASYNC_STATISTIC:
+            return onInjectAsyncStatistic(mpc, message, data, data_size);
+        case AVAPP_EVENT_DNS_STATISTIC:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectDnsStatistic);
+        case AVAPP_EVENT_HTTP_POOL_STATISTIC:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectHttpPoolStatistic);
+        case AVAPP_EVENT_TLS_STATISTIC:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectTlsStatistic);
+        case AVAPP_EVENT_HTTP3_STATISTIC:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectHttp3Statistic);
+        case AVAPP_EVENT_HTTP_MIRROR:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectHttpMirror);
+        case AVAPP_EVENT_HTTP_REQUEST:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectHttpRequest);
+        case AVAPP_EVENT_HLS_VARIANT_SWITCH:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInjectHlsVariantSwitch);
+        case IJKIOAPP_EVENT_CACHE_STATISTIC:
+            return inject_async(mpc, weakHolder, message, data, data_size, onInectIJKIOStatistic);
         default: {
             return 0;
         }
     }
 }
 
+// NOTE: could be called from multiple thread
+static int ijkff_inject_callback(void *opaque, int message, void *data, size_t data_size)
+{
+    IJKWeakHolder *weakHolder = (__bridge IJKWeakHolder*)opaque;
+    IJKFFMoviePlayerController *mpc = weakHolder.object;
+    if (!mpc)
+        return 0;
+
+    int64_t begin = av_gettime_relative();
+    int ret = inject_dispatch(mpc, weakHolder, message, data, data_size);
+    int64_t blocking = av_gettime_relative() - begin;
+
+    int index = inject_hook_index(message);
+    if (index >= 0) {
+        IJKInjectHookStat *stat = &mpc->_injectHookStats[index];
+        atomic_fetch_add(&stat->count, 1);
+        atomic_fetch_add(&stat->blocking, blocking);
+        int64_t max = atomic_load(&stat->maxBlocking);
+        while (blocking > max && !atomic_compare_exchange_weak(&stat->maxBlocking, &max, blocking))
+            ;
+    }
+    return ret;
+}
+
 #pragma mark Airplay
 
 -(BOOL)allowsMediaAirPlay
@@ -1536,6 +4395,30 @@ static int ijkff_inject_callback(void *opaque, int message, void *data, size_t d
                              selector:@selector(applicationWillTerminate)
                                  name:UIApplicationWillTerminateNotification
                                object:nil];
+
+    [_notificationManager addObserver:self
+                             selector:@selector(applicationDidReceiveMemoryWarning)
+                                 name:UIApplicationDidReceiveMemoryWarningNotification
+                               object:nil];
+
+    [_notificationManager addObserver:self
+                             selector:@selector(networkInterfaceDidChange)
+                                 name:IJKNetworkMonitorInterfaceDidChangeNotification
+                               object:nil];
+
+    if (@available(iOS 11.0, *)) {
+        [_notificationManager addObserver:self
+                                 selector:@selector(processInfoDidChangeState)
+                                     name:NSProcessInfoThermalStateDidChangeNotification
+                                   object:nil];
+    }
+
+    if (@available(iOS 9.0, *)) {
+        [_notificationManager addObserver:self
+                                 selector:@selector(processInfoDidChangeState)
+                                     name:NSProcessInfoPowerStateDidChangeNotification
+                                   object:nil];
+    }
 }
 
 - (void)unregisterApplicationObservers
@@ -1576,6 +4459,11 @@ static int ijkff_inject_callback(void *opaque, int message, void *data, size_t d
 - (void)applicationWillEnterForeground
 {
     NSLog(@"IJKFFMoviePlayerController:applicationWillEnterForeground: %d", (int)[UIApplication sharedApplication].applicationState);
+    dispatch_async(dispatch_get_main_queue(), ^{
+        _backgroundAudioOnly = NO;
+        [self updateAudioOnly];
+        [self setVideoSuspended:NO];
+    });
 }
 
 - (void)applicationDidBecomeActive
@@ -1599,6 +4487,11 @@ static int ijkff_inject_callback(void *opaque, int message, void *data, size_t d
     dispatch_async(dispatch_get_main_queue(), ^{
         if (_pauseInBackground) {
             [self pause];
+        } else if (_audioOnlyInBackground) {
+            _backgroundAudioOnly = YES;
+            [self updateAudioOnly];
+        } else if (_suspendsVideoInBackground) {
+            [self setVideoSuspended:YES];
         }
     });
 }
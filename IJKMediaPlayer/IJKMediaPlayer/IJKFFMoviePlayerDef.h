@@ -63,14 +63,28 @@ IJKSampleAspectRatioMake(NSInteger numerator, NSInteger denominator)
 @interface IJKFFMoviePlayerMessage : NSObject {
 @public
     AVMessage _msg;
+    IjkMediaPlayer *_mediaPlayer;   // the core that posted it, not retained
+    int64_t _tick;                  // SDL_GetTickHR() the message thread got it at
+    id _target;                     // on the first of a batch, who it goes to
+    // the next of a batch or of a free list, retained by this one
+    // (__bridge_retained), NULL for the last
+    void *_next;
 }
 @end
 
+// release a list of messages linked by _next, retained by the caller
+void IJKFFMoviePlayerMessageListRelease(void *list);
 
+
+// A lock-free free list, kept as long as the most messages out at once
+// have been. Any thread recycles. A thread obtaining takes the whole list
+// into a cache of its own, which it pops alone; popping the shared head
+// instead could be fooled by a message taken and given back meanwhile.
 @interface IJKFFMoviePlayerMessagePool : NSObject
 
 - (IJKFFMoviePlayerMessagePool *)init;
-- (IJKFFMoviePlayerMessage *) obtain;
+// cache: NULL at first, released with IJKFFMoviePlayerMessageListRelease
+- (IJKFFMoviePlayerMessage *) obtainWithCache:(void **)cache;
 - (void) recycle:(IJKFFMoviePlayerMessage *)msg;
 
 @end
@@ -23,37 +23,75 @@
 
 #import "IJKFFMoviePlayerDef.h"
 
+#include <stdatomic.h>
+
+// kept however few messages were out at once
+#define IJK_MSG_POOL_MIN 16
+#define IJK_MSG_POOL_MAX 1024
+
 @implementation IJKFFMoviePlayerMessage
 @end
 
-@implementation IJKFFMoviePlayerMessagePool{
-    NSMutableArray *_array;
+void IJKFFMoviePlayerMessageListRelease(void *list)
+{
+    while (list) {
+        IJKFFMoviePlayerMessage *msg = (__bridge_transfer IJKFFMoviePlayerMessage *)list;
+        list = msg->_next;
+        msg->_next = NULL;
+        msg_free_res(&msg->_msg);
+    }
+}
+
+@implementation IJKFFMoviePlayerMessagePool {
+    _Atomic(void *) _head;          // retained messages linked by _next
+    atomic_int      _count;         // in the list, about
+    atomic_int      _out;           // obtained and not recycled yet
+    atomic_int      _limit;
 }
 
 - (IJKFFMoviePlayerMessagePool *)init
 {
     self = [super init];
     if (self) {
-        _array = [[NSMutableArray alloc] init];
+        atomic_init(&_head, NULL);
+        atomic_init(&_count, 0);
+        atomic_init(&_out, 0);
+        atomic_init(&_limit, IJK_MSG_POOL_MIN);
     }
     return self;
 }
 
-- (IJKFFMoviePlayerMessage *) obtain
+- (void)dealloc
 {
-    IJKFFMoviePlayerMessage *msg = nil;
+    IJKFFMoviePlayerMessageListRelease(atomic_exchange(&_head, NULL));
+}
 
-    @synchronized(self) {
-        NSUInteger count = [_array count];
-        if (count > 0) {
-            msg = [_array objectAtIndex:count - 1];
-            [_array removeLastObject];
-        }
+- (IJKFFMoviePlayerMessage *) obtainWithCache:(void **)cache
+{
+    if (!*cache) {
+        *cache = atomic_exchange(&_head, NULL);
+        int taken = 0;
+        for (void *it = *cache; it; it = ((__bridge IJKFFMoviePlayerMessage *)it)->_next)
+            ++taken;
+        if (taken)
+            atomic_fetch_sub(&_count, taken);
     }
 
-    if (!msg)
+    IJKFFMoviePlayerMessage *msg = nil;
+    if (*cache) {
+        msg = (__bridge_transfer IJKFFMoviePlayerMessage *)*cache;
+        *cache = msg->_next;
+        msg->_next = NULL;
+    } else {
         msg = [[IJKFFMoviePlayerMessage alloc] init];
+    }
 
+    // the pool grows to the most messages out at once, queued in batches
+    int out   = atomic_fetch_add(&_out, 1) + 1;
+    int limit = atomic_load(&_limit);
+    while (out > limit && limit < IJK_MSG_POOL_MAX &&
+           !atomic_compare_exchange_weak(&_limit, &limit, MIN(out, IJK_MSG_POOL_MAX)))
+        ;
     return msg;
 }
 
@@ -62,10 +100,19 @@
     if (!msg)
         return;
     msg_free_res(&msg->_msg);
-    @synchronized(self) {
-        if ([_array count] <= 10)
-            [_array addObject:msg];
-    }
+    msg->_target = nil;
+    atomic_fetch_sub(&_out, 1);
+    if (atomic_load(&_count) >= atomic_load(&_limit))
+        return;
+
+    // pushing alone is safe: the head only ever changes under it by a push
+    // or by taking the whole list
+    atomic_fetch_add(&_count, 1);
+    void *ref  = (__bridge_retained void *)msg;
+    void *head = atomic_load(&_head);
+    do {
+        msg->_next = head;
+    } while (!atomic_compare_exchange_weak(&_head, &head, ref));
 }
 
 @end
@@ -43,13 +43,73 @@ typedef enum IJKAVDiscard {
     IJK_AVDISCARD_ALL     = 48, ///< discard all
 } IJKAVDiscard;
 
+// GPU post processing of the Metal view, see useMetalView
+typedef NS_ENUM(NSInteger, IJKVideoDeinterlaceMode) {
+    IJKVideoDeinterlaceNone  = 0,
+    IJKVideoDeinterlaceBob   = 1,
+    IJKVideoDeinterlaceBlend = 2,
+};
+
+typedef NS_ENUM(NSInteger, IJKVideoScalingFilter) {
+    IJKVideoScalingBilinear  = 0,
+    IJKVideoScalingBicubic   = 1,
+    IJKVideoScalingLanczos   = 2,
+};
+
+// for player option 'video-threading', how the software video decoder
+// threads when no 'threads' codec option is set; applied by prepareToPlay
+typedef enum IJKVideoThreading {
+    IJK_VIDEO_THREADING_MANUAL     = 0, ///< ffmpeg's automatic thread count
+    IJK_VIDEO_THREADING_AUTO       = 1, ///< low delay for live streams, throughput otherwise
+    IJK_VIDEO_THREADING_LOW_DELAY  = 2, ///< slice threads, no frame delay
+    IJK_VIDEO_THREADING_THROUGHPUT = 3, ///< frame threads on the performance cores
+} IJKVideoThreading;
+
+// for player option 'videotoolbox-hwaccel', with 'videotoolbox' on: the
+// VideoToolbox hwaccel of libavcodec for the codecs IJKVideoToolBox does not decode
+typedef enum IJKVideoToolboxHWAccel {
+    IJK_VTB_HWACCEL_OFF      = 0,
+    IJK_VTB_HWACCEL_FALLBACK = 1, ///< MPEG-4 Part 2, H.263, MPEG-1 and MPEG-2
+    IJK_VTB_HWACCEL_ALWAYS   = 2, ///< H.264 too, instead of IJKVideoToolBox
+} IJKVideoToolboxHWAccel;
+
+// what the software decoder leaves out while it cannot keep up, each
+// level adding to the one below, see adaptiveDecodeDegradation
+typedef NS_ENUM(NSInteger, IJKFFDecodeDegradationLevel) {
+    IJKFFDecodeDegradationNone,
+    IJKFFDecodeDegradationLoopFilterNonRef,     // no deblocking of non reference frames
+    IJKFFDecodeDegradationLoopFilterAll,        // no deblocking at all
+    IJKFFDecodeDegradationSkipNonRef,           // non reference frames not decoded
+    IJKFFDecodeDegradationSkipIDCT,             // MPEG video decoders only, not H.264 or HEVC
+};
+
+// what the player gives up while the device runs hot or in Low Power Mode,
+// each level adding to the one below, see thermalPolicy; the levels follow
+// NSProcessInfoThermalState, Low Power Mode counting as fair at least
+typedef NS_ENUM(NSInteger, IJKFFThermalPolicyLevel) {
+    IJKFFThermalPolicyNone,
+    IJKFFThermalPolicyFrameRateCap,     // 30 frames per second shown at most
+    IJKFFThermalPolicyReducedQuality,   // HLS variants under half the bitrate playing, bilinear
+                                        // Metal scaling unsharpened, threads at background QoS
+    IJKFFThermalPolicyLowestBitrate,    // the lowest HLS variant
+};
+
 struct IjkMediaPlayer;
+struct AVDictionary;
 
-@interface IJKFFOptions : NSObject
+@interface IJKFFOptions : NSObject <NSCopying>
 
 +(IJKFFOptions *)optionsByDefault;
 
+// Named presets: a copy of the options as they are now, their dictionaries
+// built and checked once. presetNamed: returns a new copy each time, which
+// shares them until it is changed, so creating many players from a preset
+// costs one call per player in applyTo:
++(void)registerPreset:(IJKFFOptions *)options named:(NSString *)name;
++(IJKFFOptions *)presetNamed:(NSString *)name;
+
 -(void)applyTo:(struct IjkMediaPlayer *)mediaPlayer;
+-(void)applyFormatOptionsTo:(struct AVDictionary **)dict;
 
 - (void)setOptionValue:(NSString *)value
                 forKey:(NSString *)key
@@ -59,6 +119,10 @@ struct IjkMediaPlayer;
                    forKey:(NSString *)key
                ofCategory:(IJKFFOptionCategory)category;
 
+// the NSString or NSNumber set for key, nil if none
+- (id)optionValueForKey:(NSString *)key
+             ofCategory:(IJKFFOptionCategory)category;
+
 
 -(void)setFormatOptionValue:       (NSString *)value forKey:(NSString *)key;
 -(void)setCodecOptionValue:        (NSString *)value forKey:(NSString *)key;
@@ -71,5 +135,60 @@ struct IjkMediaPlayer;
 -(void)setPlayerOptionIntValue:    (int64_t)value forKey:(NSString *)key;
 
 @property(nonatomic) BOOL showHudView;
+// present through a CAMetalLayer instead of OpenGL ES, if the device supports Metal
+@property(nonatomic) BOOL useMetalView;
+// enqueue frames into an AVSampleBufferDisplayLayer, shown by the system
+// compositor without a render pass, and usable for Picture in Picture;
+// preferred over useMetalView
+@property(nonatomic) BOOL useSampleBufferView;
+// software decoded YUV420P frames go into IOSurface backed pixel buffers,
+// drawn through the texture cache like VideoToolbox frames
+@property(nonatomic) BOOL usePixelBufferOverlays;
+
+// Metal view only, instead of the yadif and scale filters on the CPU:
+// interlaced frames are deinterlaced, the picture is scaled to the view
+// with the filter and sharpened, 0 for none to about 1
+@property(nonatomic) IJKVideoDeinterlaceMode videoDeinterlaceMode;
+@property(nonatomic) IJKVideoScalingFilter   videoScalingFilter;
+@property(nonatomic) float                   videoSharpness;
+
+// live streams, in milliseconds of buffered media: playback speeds up to
+// liveMaxCatchUpRate while more than liveTargetLatency is buffered, and
+// past liveMaxLatency the flv demuxer skips ahead to a later keyframe;
+// 0 disables either
+@property(nonatomic) int   liveTargetLatency;
+@property(nonatomic) int   liveMaxLatency;
+@property(nonatomic) float liveMaxCatchUpRate;
+
+// live http, https and rtmp streams: bytes of the stream kept in a memory
+// mapped file of the temporary directory, to pause, seek back within and
+// return to the live edge with -seekToLiveEdge; only FLV seeks by time.
+// Replaces the catch-up above; 0, the default, disables it
+@property(nonatomic) int64_t liveTimeshiftSize;
+
+// software decoding only: while the decoder falls behind the frame rate of
+// the stream or the video lags the audio, it skips more work level by level,
+// and steps back once it keeps up again; off by default
+@property(nonatomic) BOOL  adaptiveDecodeDegradation;
+
+// steps down the cost of playback level by level as the device heats up or
+// enters Low Power Mode, and back as it recovers; each step posts
+// IJKMPMoviePlayerThermalPolicyDidChangeNotification. On by default
+@property(nonatomic) BOOL  thermalPolicy;
+
+// a session starts from the throughput the other players of the process
+// measured to the same host: the first buffering is deeper on a slow
+// network, and HLS starts at the variant it fits and prefetches as deep as
+// it allows (format option "shared_estimate"). The estimate fades within
+// minutes and is forgotten when the device changes networks. On by default
+@property(nonatomic) BOOL  sharedThroughputEstimate;
+
+// http and https origins ("https://cdn2.example.com") serving the same paths
+// as the one of the url: each request is opened on the two ranked best at
+// once and read from the first to respond, and moves to the next one at the
+// same byte offset if it fails or stalls (format options "mirrors" and
+// "mirror_stall_timeout"). Ranks are kept by the process from the response
+// times and failures seen. Empty by default
+@property(nonatomic, copy) NSArray<NSURL *> *mirrorURLs;
 
 @end
@@ -23,9 +23,38 @@
 
 #import "IJKFFOptions.h"
 #include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavutil/dict.h"
+#include "libavutil/opt.h"
+#include "libavcodec/avcodec.h"
+#include "libswscale/swscale.h"
+#include "libswresample/swresample.h"
+
+#define IJKFF_OPT_CATEGORY_COUNT (IJKMP_OPT_CATEGORY_SWR + 1)
+
+// the options in the form the player keeps them, never changed once built
+@interface IJKFFOptionDicts : NSObject {
+@public
+    AVDictionary *_dicts[IJKFF_OPT_CATEGORY_COUNT];
+}
+@end
+
+@implementation IJKFFOptionDicts
+
+- (void)dealloc
+{
+    for (int i = 0; i < IJKFF_OPT_CATEGORY_COUNT; ++i)
+        av_dict_free(&_dicts[i]);
+}
+
+@end
+
+static NSMutableDictionary<NSString *, IJKFFOptions *> *g_presets;
 
 @implementation IJKFFOptions {
     NSMutableDictionary *_optionCategories;
+    // the dictionaries below are shared with a copy until either changes
+    BOOL                 _shared;
+    IJKFFOptionDicts    *_compiled;
 
     NSMutableDictionary *_playerOptions;
     NSMutableDictionary *_formatOptions;
@@ -34,22 +63,75 @@
     NSMutableDictionary *_swrOptions;
 }
 
+// built once, every player gets a copy sharing its dictionaries
 + (IJKFFOptions *)optionsByDefault
+{
+    static IJKFFOptions *defaults;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        // a copy, compiled and shared before any other thread sees it
+        defaults = [[IJKFFOptions buildDefaultOptions] copy];
+    });
+    return [defaults copy];
+}
+
++ (IJKFFOptions *)buildDefaultOptions
 {
     IJKFFOptions *options = [[IJKFFOptions alloc] init];
 
     [options setPlayerOptionIntValue:30     forKey:@"max-fps"];
     [options setPlayerOptionIntValue:0      forKey:@"framedrop"];
-    [options setPlayerOptionIntValue:3      forKey:@"video-pictq-size"];
+    // the frames allocated; VideoToolbox holds from "video-pictq-min" up to
+    // them as its decode times jitter, the software decoder fills them all
+    [options setPlayerOptionIntValue:6      forKey:@"video-pictq-size"];
+    [options setPlayerOptionIntValue:1      forKey:@"video-pictq-adaptive"];
+    [options setPlayerOptionIntValue:2      forKey:@"video-pictq-min"];
+    // the high water marks from the download rate, for no stall within
+    // 10 s 9 times out of 10
+    [options setPlayerOptionIntValue:1      forKey:@"dynamic-buffering"];
+    [options setPlayerOptionIntValue:10000  forKey:@"buffering-horizon-ms"];
+    [options setPlayerOptionIntValue:90     forKey:@"buffering-confidence"];
     [options setPlayerOptionIntValue:0      forKey:@"videotoolbox"];
     [options setPlayerOptionIntValue:960    forKey:@"videotoolbox-max-frame-width"];
+    [options setPlayerOptionIntValue:1      forKey:@"videotoolbox-scale-to-view"];
+    [options setPlayerOptionIntValue:IJK_VTB_HWACCEL_FALLBACK forKey:@"videotoolbox-hwaccel"];
+    [options setPlayerOptionIntValue:IJK_VIDEO_THREADING_AUTO forKey:@"video-threading"];
 
     [options setFormatOptionIntValue:0                  forKey:@"auto_convert"];
     [options setFormatOptionIntValue:1                  forKey:@"reconnect"];
+    [options setFormatOptionIntValue:1                  forKey:@"http_pool"];
+    [options setFormatOptionIntValue:1                  forKey:@"http2"];
+    [options setFormatOptionIntValue:1                  forKey:@"http3"];
+    [options setFormatOptionIntValue:30                 forKey:@"read_ahead_seconds"];
+    [options setFormatOptionIntValue:4                  forKey:@"parallel_connections"];
+    [options setFormatOptionIntValue:128 * 1024         forKey:@"avio_buffer_size"];
+    [options setFormatOptionIntValue:100 * 1000         forKey:@"io_traffic_interval"];
+    [options setFormatOptionIntValue:2048               forKey:@"lazy_index"];
+    [options setFormatOptionIntValue:1                  forKey:@"keep_fragments"];
+    [options setFormatOptionIntValue:2                  forKey:@"prefetch_segments"];
+    [options setFormatOptionIntValue:1                  forKey:@"abr"];
     [options setFormatOptionIntValue:30 * 1000 * 1000   forKey:@"timeout"];
     [options setFormatOptionValue:@"ijkplayer"          forKey:@"user-agent"];
+    [options setFormatOptionValue:@"fastopen"           forKey:@"fflags"];
+    [options setFormatOptionIntValue:1                  forKey:@"probe_cache"];
+    [options setFormatOptionIntValue:1                  forKey:@"mmap"];
 
     options.showHudView   = NO;
+    options.useMetalView  = NO;
+    options.useSampleBufferView = NO;
+    options.usePixelBufferOverlays = YES;
+    options.videoDeinterlaceMode   = IJKVideoDeinterlaceNone;
+    options.videoScalingFilter     = IJKVideoScalingBilinear;
+    options.videoSharpness         = 0.0f;
+
+    options.liveTargetLatency  = 0;
+    options.liveMaxLatency     = 0;
+    options.liveMaxCatchUpRate = 1.1f;
+    options.liveTimeshiftSize  = 0;
+
+    options.adaptiveDecodeDegradation = NO;
+    options.thermalPolicy             = YES;
+    options.sharedThroughputEstimate  = YES;
 
     return options;
 }
@@ -58,39 +140,162 @@
 {
     self = [super init];
     if (self) {
-        _playerOptions      = [[NSMutableDictionary alloc] init];
-        _formatOptions      = [[NSMutableDictionary alloc] init];
-        _codecOptions       = [[NSMutableDictionary alloc] init];
-        _swsOptions         = [[NSMutableDictionary alloc] init];
-        _swrOptions         = [[NSMutableDictionary alloc] init];
-
-        _optionCategories   = [[NSMutableDictionary alloc] init];
-        _optionCategories[@(IJKMP_OPT_CATEGORY_PLAYER)] = _playerOptions;
-        _optionCategories[@(IJKMP_OPT_CATEGORY_FORMAT)] = _formatOptions;
-        _optionCategories[@(IJKMP_OPT_CATEGORY_CODEC)]  = _codecOptions;
-        _optionCategories[@(IJKMP_OPT_CATEGORY_SWS)]    = _swsOptions;
-        _optionCategories[@(IJKMP_OPT_CATEGORY_SWR)]    = _swrOptions;
+        [self setOptionDictsPlayer:[[NSMutableDictionary alloc] init]
+                            format:[[NSMutableDictionary alloc] init]
+                             codec:[[NSMutableDictionary alloc] init]
+                               sws:[[NSMutableDictionary alloc] init]
+                               swr:[[NSMutableDictionary alloc] init]];
     }
     return self;
 }
 
-- (void)applyTo:(IjkMediaPlayer *)mediaPlayer
+- (void)setOptionDictsPlayer:(NSMutableDictionary *)player
+                      format:(NSMutableDictionary *)format
+                       codec:(NSMutableDictionary *)codec
+                         sws:(NSMutableDictionary *)sws
+                         swr:(NSMutableDictionary *)swr
 {
+    _playerOptions      = player;
+    _formatOptions      = format;
+    _codecOptions       = codec;
+    _swsOptions         = sws;
+    _swrOptions         = swr;
+
+    _optionCategories   = [[NSMutableDictionary alloc] init];
+    _optionCategories[@(IJKMP_OPT_CATEGORY_PLAYER)] = _playerOptions;
+    _optionCategories[@(IJKMP_OPT_CATEGORY_FORMAT)] = _formatOptions;
+    _optionCategories[@(IJKMP_OPT_CATEGORY_CODEC)]  = _codecOptions;
+    _optionCategories[@(IJKMP_OPT_CATEGORY_SWS)]    = _swsOptions;
+    _optionCategories[@(IJKMP_OPT_CATEGORY_SWR)]    = _swrOptions;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    IJKFFOptions *copy = [[IJKFFOptions allocWithZone:zone] init];
+    if (!copy)
+        return nil;
+
+    [self compiledOptions];
+    [copy setOptionDictsPlayer:_playerOptions
+                        format:_formatOptions
+                         codec:_codecOptions
+                           sws:_swsOptions
+                           swr:_swrOptions];
+    copy->_compiled = _compiled;
+    copy->_shared   = YES;
+    _shared         = YES;
+
+    copy.showHudView                = self.showHudView;
+    copy.useMetalView               = self.useMetalView;
+    copy.useSampleBufferView        = self.useSampleBufferView;
+    copy.usePixelBufferOverlays     = self.usePixelBufferOverlays;
+    copy.videoDeinterlaceMode       = self.videoDeinterlaceMode;
+    copy.videoScalingFilter         = self.videoScalingFilter;
+    copy.videoSharpness             = self.videoSharpness;
+    copy.liveTargetLatency          = self.liveTargetLatency;
+    copy.liveMaxLatency             = self.liveMaxLatency;
+    copy.liveMaxCatchUpRate         = self.liveMaxCatchUpRate;
+    copy.liveTimeshiftSize          = self.liveTimeshiftSize;
+    copy.adaptiveDecodeDegradation  = self.adaptiveDecodeDegradation;
+    copy.thermalPolicy              = self.thermalPolicy;
+    copy.sharedThroughputEstimate   = self.sharedThroughputEstimate;
+    copy.mirrorURLs                 = self.mirrorURLs;
+    return copy;
+}
+
++ (void)registerPreset:(IJKFFOptions *)options named:(NSString *)name
+{
+    if (!name)
+        return;
+
+    IJKFFOptions *preset = [options copy];
+    @synchronized (self) {
+        if (!g_presets)
+            g_presets = [[NSMutableDictionary alloc] init];
+        if (preset)
+            g_presets[name] = preset;
+        else
+            [g_presets removeObjectForKey:name];
+    }
+}
+
++ (IJKFFOptions *)presetNamed:(NSString *)name
+{
+    IJKFFOptions *preset = nil;
+    @synchronized (self) {
+        preset = name ? g_presets[name] : nil;
+    }
+    return [preset copy];
+}
+
+// before any change to the options
+- (void)willChangeOptions
+{
+    _compiled = nil;
+    if (!_shared)
+        return;
+
+    [self setOptionDictsPlayer:[_playerOptions mutableCopy]
+                        format:[_formatOptions mutableCopy]
+                         codec:[_codecOptions mutableCopy]
+                           sws:[_swsOptions mutableCopy]
+                           swr:[_swrOptions mutableCopy]];
+    _shared = NO;
+}
+
+// warns only: the format options also go to the protocols, and the player
+// options to the pipelines, which have no class to look them up in
+static void check_option(const AVClass *class, const char *category, const char *key)
+{
+    if (!av_opt_find(&class, key, NULL, 0, AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))
+        NSLog(@"IJKFFOptions: unknown %s option '%s'\n", category, key);
+}
+
+- (IJKFFOptionDicts *)compiledOptions
+{
+    if (_compiled)
+        return _compiled;
+
+    IJKFFOptionDicts *compiled = [[IJKFFOptionDicts alloc] init];
     [_optionCategories enumerateKeysAndObjectsUsingBlock:^(id categoryKey, id categoryDict, BOOL *stopOuter) {
+        int category = (int)[categoryKey integerValue];
+        AVDictionary **dict = &compiled->_dicts[category];
+
         [categoryDict enumerateKeysAndObjectsUsingBlock:^(id optKey, id optValue, BOOL *stop) {
+            const char *key = [optKey UTF8String];
             if ([optValue isKindOfClass:[NSNumber class]]) {
-                ijkmp_set_option_int(mediaPlayer,
-                                     (int)[categoryKey integerValue],
-                                     [optKey UTF8String],
-                                     [optValue longLongValue]);
+                av_dict_set_int(dict, key, [optValue longLongValue], 0);
             } else if ([optValue isKindOfClass:[NSString class]]) {
-                ijkmp_set_option(mediaPlayer,
-                                 (int)[categoryKey integerValue],
-                                 [optKey UTF8String],
-                                 [optValue UTF8String]);
+                av_dict_set(dict, key, [optValue UTF8String], 0);
+            } else {
+                return;
+            }
+
+            switch (category) {
+                case IJKMP_OPT_CATEGORY_CODEC:
+                    check_option(avcodec_get_class(), "codec", key);
+                    break;
+                case IJKMP_OPT_CATEGORY_SWS:
+                    check_option(sws_get_class(), "sws", key);
+                    break;
+                case IJKMP_OPT_CATEGORY_SWR:
+                    check_option(swr_get_class(), "swr", key);
+                    break;
             }
         }];
     }];
+    _compiled = compiled;
+    return compiled;
+}
+
+- (void)applyTo:(IjkMediaPlayer *)mediaPlayer
+{
+    ijkmp_ios_set_option_dicts(mediaPlayer, [self compiledOptions]->_dicts);
+}
+
+- (void)applyFormatOptionsTo:(AVDictionary **)dict
+{
+    av_dict_copy(dict, [self compiledOptions]->_dicts[IJKMP_OPT_CATEGORY_FORMAT], 0);
 }
 
 - (void)setOptionValue:(NSString *)value
@@ -100,13 +305,16 @@
     if (!key)
         return;
 
+    if (![_optionCategories objectForKey:@(category)])
+        return;
+
+    // may replace the dictionaries
+    [self willChangeOptions];
     NSMutableDictionary *options = [_optionCategories objectForKey:@(category)];
-    if (options) {
-        if (value) {
-            [options setObject:value forKey:key];
-        } else {
-            [options removeObjectForKey:key];
-        }
+    if (value) {
+        [options setObject:value forKey:key];
+    } else {
+        [options removeObjectForKey:key];
     }
 }
 
@@ -117,12 +325,21 @@
     if (!key)
         return;
 
-    NSMutableDictionary *options = [_optionCategories objectForKey:@(category)];
-    if (options) {
-        [options setObject:@(value) forKey:key];
-    }
+    if (![_optionCategories objectForKey:@(category)])
+        return;
+
+    [self willChangeOptions];
+    [[_optionCategories objectForKey:@(category)] setObject:@(value) forKey:key];
 }
 
+- (id)optionValueForKey:(NSString *)key
+             ofCategory:(IJKFFOptionCategory)category
+{
+    if (!key)
+        return nil;
+
+    return [[_optionCategories objectForKey:@(category)] objectForKey:key];
+}
 
 #pragma mark Common Helper
 
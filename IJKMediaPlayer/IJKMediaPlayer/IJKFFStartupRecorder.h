@@ -0,0 +1,53 @@
+/*
+ * IJKFFStartupRecorder.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import "IJKFFStartupReport.h"
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "ijksdl/ios/ijksdl_trace_ios.h"
+
+// Collects the IJKFFStartupReport of a play: the messages of the core from
+// the main thread, with the tick the message thread got them at, the
+// network from the io threads of the core.
+@interface IJKFFStartupRecorder : NSObject
+
+// main thread
+- (void)setGlobalInit:(int64_t)duration;
+- (void)startAtTick:(int64_t)tick;
+- (void)setHasVideo:(BOOL)hasVideo hasAudio:(BOOL)hasAudio;
+- (void)didReceiveMessage:(const AVMessage *)msg atTick:(int64_t)tick;
+- (void)didTakeFirstPacketAtTick:(int64_t)tick;
+
+// YES once per play, when the streams started or force is set, e.g. stopped
+// before they did
+- (BOOL)finish:(BOOL)force report:(IJKFFStartupReport *)report;
+
+// any thread; the first of each kind counts
+- (void)netStage:(IJKTraceStage)stage willStartWithObject:(const void *)obj;
+- (void)netStage:(IJKTraceStage)stage didEndWithObject:(const void *)obj;
+- (void)tcpDidConnectIn:(int64_t)elapsed;
+- (void)dnsDidLookUpFromCache:(BOOL)hit;
+- (void)httpDidOpenOnReusedConnection:(BOOL)reused;
+- (void)tlsDidHandshakeResumed:(BOOL)resumed;
+
+@end
@@ -0,0 +1,301 @@
+/*
+ * IJKFFStartupRecorder.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFStartupRecorder.h"
+#include "libavformat/disk_cache.h"
+#include <pthread.h>
+
+// network stages timed from their will and did events
+enum {
+    IJK_STARTUP_NET_DNS,
+    IJK_STARTUP_NET_TLS,
+    IJK_STARTUP_NET_HTTP_OPEN,
+    IJK_STARTUP_NET_COUNT,
+};
+
+typedef struct IJKStartupNetStage {
+    const void *obj;        // of the first will event
+    int64_t     start;
+    int64_t     duration;   // -1 until its did event
+} IJKStartupNetStage;
+
+static int startup_net_index(IJKTraceStage stage)
+{
+    switch (stage) {
+        case IJK_TRACE_DNS:             return IJK_STARTUP_NET_DNS;
+        case IJK_TRACE_TLS_HANDSHAKE:   return IJK_STARTUP_NET_TLS;
+        case IJK_TRACE_HTTP_OPEN:       return IJK_STARTUP_NET_HTTP_OPEN;
+        default:                        return -1;
+    }
+}
+
+static int64_t startup_since(int64_t start, int64_t tick)
+{
+    return tick > 0 && tick >= start ? tick - start : -1;
+}
+
+@implementation IJKFFStartupRecorder {
+    pthread_mutex_t     _mutex;
+    BOOL                _recording;         // from start to finish
+    int64_t             _start;
+    int64_t             _diskCacheHitBytes; // at start
+    int64_t             _globalInit;        // until the first report
+
+    BOOL                _prepared;
+    BOOL                _hasVideo;
+    BOOL                _hasAudio;
+
+    // ticks, 0 until reached
+    int64_t             _openInput;
+    int64_t             _findStreamInfo;
+    int64_t             _decoderOpen;
+    int64_t             _firstPacket;
+    int64_t             _firstDecodedFrame;
+    int64_t             _audioOpen;
+    int64_t             _firstPresent;
+
+    IJKStartupNetStage  _net[IJK_STARTUP_NET_COUNT];
+    int64_t             _tcpConnect;
+    int                 _dnsCacheHit;       // -1 until looked up
+    int                 _connectionReused;
+    int                 _tlsResumed;
+
+    BOOL                _videoToolbox;
+    int                 _error;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_mutex, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (void)setGlobalInit:(int64_t)duration
+{
+    pthread_mutex_lock(&_mutex);
+    _globalInit = duration;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)startAtTick:(int64_t)tick
+{
+    DiskCacheStatistic diskCacheStat;
+    av_disk_cache_get_statistic(&diskCacheStat);
+
+    pthread_mutex_lock(&_mutex);
+    _recording         = YES;
+    _start             = tick;
+    _diskCacheHitBytes = diskCacheStat.hit_bytes;
+    _prepared          = NO;
+    _hasVideo          = NO;
+    _hasAudio          = NO;
+    _openInput         = 0;
+    _findStreamInfo    = 0;
+    _decoderOpen       = 0;
+    _firstPacket       = 0;
+    _firstDecodedFrame = 0;
+    _audioOpen         = 0;
+    _firstPresent      = 0;
+    for (int i = 0; i < IJK_STARTUP_NET_COUNT; i++) {
+        _net[i].obj      = NULL;
+        _net[i].start    = 0;
+        _net[i].duration = -1;
+    }
+    _tcpConnect        = -1;
+    _dnsCacheHit       = -1;
+    _connectionReused  = -1;
+    _tlsResumed        = -1;
+    _videoToolbox      = NO;
+    _error             = 0;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)setHasVideo:(BOOL)hasVideo hasAudio:(BOOL)hasAudio
+{
+    pthread_mutex_lock(&_mutex);
+    _prepared = YES;
+    _hasVideo = hasVideo;
+    _hasAudio = hasAudio;
+    pthread_mutex_unlock(&_mutex);
+}
+
+#define IJK_STARTUP_REACHED(milestone, tick) \
+    do { if (!(milestone)) (milestone) = (tick); } while (0)
+
+- (void)didReceiveMessage:(const AVMessage *)msg atTick:(int64_t)tick
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording) {
+        switch (msg->what) {
+            case FFP_MSG_OPEN_INPUT:
+                IJK_STARTUP_REACHED(_openInput, tick);
+                break;
+            case FFP_MSG_FIND_STREAM_INFO:
+                IJK_STARTUP_REACHED(_findStreamInfo, tick);
+                break;
+            case FFP_MSG_VIDEO_DECODER_OPEN:
+                if (!_decoderOpen)
+                    _videoToolbox = msg->arg1;
+                IJK_STARTUP_REACHED(_decoderOpen, tick);
+                break;
+            case FFP_MSG_VIDEO_DECODED_START:
+                IJK_STARTUP_REACHED(_firstDecodedFrame, tick);
+                break;
+            case FFP_MSG_AUDIO_RENDERING_START:
+                IJK_STARTUP_REACHED(_audioOpen, tick);
+                break;
+            case FFP_MSG_VIDEO_RENDERING_START:
+                IJK_STARTUP_REACHED(_firstPresent, tick);
+                break;
+            case FFP_MSG_ERROR:
+                if (!_error)
+                    _error = msg->arg1 ? msg->arg1 : -1;
+                break;
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)didTakeFirstPacketAtTick:(int64_t)tick
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording && tick > 0)
+        IJK_STARTUP_REACHED(_firstPacket, tick);
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (BOOL)finish:(BOOL)force report:(IJKFFStartupReport *)report
+{
+    pthread_mutex_lock(&_mutex);
+    BOOL videoStarted = !_hasVideo || _firstPresent;
+    BOOL audioStarted = !_hasAudio || _audioOpen;
+    BOOL completed    = _prepared && (_hasVideo || _hasAudio) && videoStarted && audioStarted;
+    if (!_recording || (!completed && !_error && !force)) {
+        pthread_mutex_unlock(&_mutex);
+        return NO;
+    }
+    _recording = NO;
+
+    int64_t now = (int64_t)SDL_GetTickHR();
+    memset(report, 0, sizeof(*report));
+    report->completed         = completed;
+    report->error             = _error;
+    report->globalInit        = _globalInit;
+    _globalInit               = 0;
+
+    report->dns               = _net[IJK_STARTUP_NET_DNS].duration;
+    report->tcpConnect        = _tcpConnect;
+    report->tlsHandshake      = _net[IJK_STARTUP_NET_TLS].duration;
+    report->firstByte         = _net[IJK_STARTUP_NET_HTTP_OPEN].duration;
+
+    report->openInput         = startup_since(_start, _openInput);
+    report->findStreamInfo    = startup_since(_start, _findStreamInfo);
+    report->decoderOpen       = startup_since(_start, _decoderOpen);
+    report->firstPacket       = startup_since(_start, _firstPacket);
+    report->firstDecodedFrame = startup_since(_start, _firstDecodedFrame);
+    report->audioOpen         = startup_since(_start, _audioOpen);
+    report->firstPresent      = startup_since(_start, _firstPresent);
+    report->total             = startup_since(_start, now);
+
+    report->videoToolbox      = _videoToolbox;
+    report->dnsCacheHit       = _dnsCacheHit > 0;
+    report->connectionReused  = _connectionReused > 0;
+    report->tlsResumed        = _tlsResumed > 0;
+    int64_t diskCacheHitBytes = _diskCacheHitBytes;
+    pthread_mutex_unlock(&_mutex);
+
+    DiskCacheStatistic diskCacheStat;
+    av_disk_cache_get_statistic(&diskCacheStat);
+    report->diskCacheBytes = MAX(diskCacheStat.hit_bytes - diskCacheHitBytes, 0);
+    return YES;
+}
+
+#pragma mark network
+
+- (void)netStage:(IJKTraceStage)stage willStartWithObject:(const void *)obj
+{
+    int i = startup_net_index(stage);
+    if (i < 0)
+        return;
+
+    pthread_mutex_lock(&_mutex);
+    if (_recording && !_net[i].obj) {
+        _net[i].obj   = obj;
+        _net[i].start = (int64_t)SDL_GetTickHR();
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)netStage:(IJKTraceStage)stage didEndWithObject:(const void *)obj
+{
+    int i = startup_net_index(stage);
+    if (i < 0)
+        return;
+
+    pthread_mutex_lock(&_mutex);
+    if (_recording && _net[i].obj == obj && _net[i].duration < 0)
+        _net[i].duration = startup_since(_net[i].start, (int64_t)SDL_GetTickHR());
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)tcpDidConnectIn:(int64_t)elapsed
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording && _tcpConnect < 0)
+        _tcpConnect = elapsed;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)dnsDidLookUpFromCache:(BOOL)hit
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording && _dnsCacheHit < 0)
+        _dnsCacheHit = hit;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)httpDidOpenOnReusedConnection:(BOOL)reused
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording && _connectionReused < 0)
+        _connectionReused = reused;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)tlsDidHandshakeResumed:(BOOL)resumed
+{
+    pthread_mutex_lock(&_mutex);
+    if (_recording && _tlsResumed < 0)
+        _tlsResumed = resumed;
+    pthread_mutex_unlock(&_mutex);
+}
+
+@end
@@ -0,0 +1,72 @@
+/*
+ * IJKFFStartupReport.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+// Where the time to the first frame of a play went, reported once per play
+// with IJKMPMoviePlayerStartupReportNotification.
+//
+// Milestones are milliseconds from -prepareToPlay, network stages are
+// durations of the first of their kind in the play; -1 for what did not
+// happen, e.g. no dns, connect or tls for a pooled connection.
+typedef struct IJKFFStartupReport {
+    BOOL    completed;          // the first frame was presented, or the first samples played for audio only
+    int     error;              // FFP_MSG_ERROR before, 0 without
+
+    // ijkmp_global_init in the init of the player, before -prepareToPlay;
+    // about 0 once done by an earlier player or preloader, and for the later
+    // plays of the player
+    int64_t globalInit;
+
+    // network
+    int64_t dns;
+    int64_t tcpConnect;
+    int64_t tlsHandshake;
+    int64_t firstByte;          // http request to the response headers, dns, connect and tls included
+
+    // milestones
+    int64_t openInput;          // the format probed
+    int64_t findStreamInfo;
+    int64_t decoderOpen;        // video decoder
+    int64_t firstPacket;        // taken by the video decoder, VideoToolbox only
+    int64_t firstDecodedFrame;
+    int64_t audioOpen;          // the audio output played its first samples
+    int64_t firstPresent;       // first video frame on screen
+    int64_t total;              // to the report
+
+    // how the start was served
+    BOOL    videoToolbox;
+    BOOL    dnsCacheHit;        // negative hits included
+    BOOL    connectionReused;   // an idle connection of the http pool
+    BOOL    tlsResumed;         // a cached tls session
+    int64_t diskCacheBytes;     // read from the disk cache, where the preloads leave data; process wide
+
+    // media buffered before the start and after a stall, in milliseconds,
+    // from the download rate against the bit rate of the stream, bits per
+    // second; -1 when left to the high water mark options, see the player
+    // option "dynamic-buffering"
+    int64_t startBuffer;
+    int64_t resumeBuffer;
+    int64_t bufferingRate;
+    int64_t bufferingBitRate;
+} IJKFFStartupReport;
@@ -0,0 +1,73 @@
+/*
+ * IJKFFStatistics.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, IJKFFStatisticsDecoder) {
+    IJKFFStatisticsDecoderUnknown,
+    IJKFFStatisticsDecoderAVCodec,
+    IJKFFStatisticsDecoderVideoToolbox,
+};
+
+// One sample of the playback quality of a player, taken off the main thread.
+// Counters run from -prepareToPlay, or the last reset.
+typedef struct IJKFFStatistics {
+    NSTimeInterval          timestamp;                  // CACurrentMediaTime() of the sample
+    int64_t                 position;                   // milliseconds
+
+    IJKFFStatisticsDecoder  videoDecoder;
+    float                   decodeFramesPerSecond;
+    float                   outputFramesPerSecond;
+    float                   judder;                     // milliseconds the frames stay on screen away from the frame interval
+    int64_t                 droppedPresents;            // frames the render view was given but never put on screen
+    float                   dropFrameRate;              // frames dropped late by the decoder, of those decoded
+    int64_t                 decimatedFrames;            // frames left undecoded for max-fps, not late drops
+    int64_t                 textureCacheHits;           // VideoToolbox frames
+    int64_t                 textureCacheMisses;
+
+    int64_t                 videoCachedDuration;        // milliseconds
+    int64_t                 audioCachedDuration;        // milliseconds
+    int64_t                 videoCachedBytes;
+    int64_t                 audioCachedBytes;
+    int64_t                 videoCachedPackets;
+    int64_t                 audioCachedPackets;
+
+    float                   avDelay;                    // seconds
+    float                   avDiff;                     // seconds, video ahead of the master clock
+    int64_t                 bitRate;                    // bits per second of the media
+    int64_t                 tcpSpeed;                   // bytes per second downloaded
+
+    BOOL                    rebuffering;                // stalled after the first frame, seeks excluded
+    int                     rebufferCount;
+    int64_t                 rebufferDuration;           // milliseconds, the stall in progress included
+
+    int                     bitrateSwitchCount;         // HLS variant switches
+    int                     variantBitrate;             // BANDWIDTH of the variant played, 0 without abr
+    int64_t                 estimatedBandwidth;         // bits per second at the last switch
+
+    int                     pictureQueueDepth;          // frames decoded ahead of the display
+    int64_t                 pixelBufferAllocations;     // see IJKFFMonitor
+    int64_t                 steadyPixelBufferAllocations;
+    int                     audioOutputSampleRate;      // Hz, 0 before the output is open
+    int                     audioHardwareSampleRate;
+} IJKFFStatistics;
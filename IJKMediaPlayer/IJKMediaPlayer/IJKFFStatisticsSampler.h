@@ -0,0 +1,55 @@
+/*
+ * IJKFFStatisticsSampler.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import "IJKFFStatistics.h"
+#import "IJKSDLRenderView.h"
+#include "ijkplayer/ijkplayer.h"
+
+// Samples the statistics of a player on a private queue, once per tick of
+// the fastest observer, and hands the same snapshot to every observer due.
+// Nothing runs without observers. The events (stalls, variant switches)
+// are counted as they are reported, from any thread.
+@interface IJKFFStatisticsSampler : NSObject
+
+- (instancetype)initWithView:(UIView<IJKSDLRenderView> *)view;
+
+// the core sampled, a reference is held; NULL between players
+- (void)setMediaPlayer:(IjkMediaPlayer *)mp;
+
+- (id)addObserverWithInterval:(NSTimeInterval)interval
+                        queue:(dispatch_queue_t)queue
+                        block:(void (^)(IJKFFStatistics statistics))block;
+- (void)removeObserver:(id)observer;
+- (void)removeAllObservers;
+
+// a fresh sample, taken on the sampler queue
+- (IJKFFStatistics)statistics;
+
+// zeroes the event counters, for a new media
+- (void)resetEvents;
+- (void)rebufferDidStart;
+- (void)rebufferDidEnd;
+- (void)variantDidSwitchToBitrate:(int)bitrate estimatedBandwidth:(int64_t)bandwidth;
+
+@end
@@ -0,0 +1,316 @@
+/*
+ * IJKFFStatisticsSampler.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFStatisticsSampler.h"
+#import "IJKFFMoviePlayerDef.h"
+#import <QuartzCore/QuartzCore.h>
+#include <pthread.h>
+
+// an observer is due when its next sample is closer than this part of its interval
+#define IJK_STATISTICS_DUE_SLACK 0.1
+
+@interface IJKFFStatisticsObserver : NSObject
+
+@property(nonatomic) NSTimeInterval interval;
+@property(nonatomic) NSTimeInterval nextSample;
+@property(nonatomic, strong) dispatch_queue_t queue;
+@property(nonatomic, copy) void (^block)(IJKFFStatistics statistics);
+@property(atomic) BOOL removed;
+
+@end
+
+@implementation IJKFFStatisticsObserver
+@end
+
+@implementation IJKFFStatisticsSampler {
+    UIView<IJKSDLRenderView> *_view;
+
+    pthread_mutex_t   _mutex;
+    IjkMediaPlayer   *_mediaPlayer;
+    IJKFFStatistics   _events;          // the event fields only
+    NSTimeInterval    _rebufferStart;
+
+    // on _queue
+    dispatch_queue_t  _queue;
+    dispatch_source_t _timer;
+    NSTimeInterval    _timerInterval;
+    NSMutableArray<IJKFFStatisticsObserver *> *_observers;
+}
+
+- (instancetype)initWithView:(UIView<IJKSDLRenderView> *)view
+{
+    self = [super init];
+    if (self) {
+        _view      = view;
+        _queue     = dispatch_queue_create("tv.danmaku.ijk.statistics", DISPATCH_QUEUE_SERIAL);
+        _observers = [NSMutableArray array];
+        pthread_mutex_init(&_mutex, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_timer)
+        dispatch_source_cancel(_timer);
+    if (_mediaPlayer)
+        ijkmp_dec_ref_p(&_mediaPlayer);
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (void)setMediaPlayer:(IjkMediaPlayer *)mp
+{
+    if (mp)
+        ijkmp_inc_ref(mp);
+
+    pthread_mutex_lock(&_mutex);
+    IjkMediaPlayer *former = _mediaPlayer;
+    _mediaPlayer = mp;
+    pthread_mutex_unlock(&_mutex);
+
+    if (former)
+        ijkmp_dec_ref_p(&former);
+}
+
+#pragma mark observers
+
+- (id)addObserverWithInterval:(NSTimeInterval)interval
+                        queue:(dispatch_queue_t)queue
+                        block:(void (^)(IJKFFStatistics statistics))block
+{
+    IJKFFStatisticsObserver *observer = [[IJKFFStatisticsObserver alloc] init];
+    observer.interval = MAX(interval, 0.01);
+    observer.queue    = queue ?: dispatch_get_main_queue();
+    observer.block    = block;
+
+    dispatch_async(_queue, ^{
+        observer.nextSample = CACurrentMediaTime();
+        [self->_observers addObject:observer];
+        [self updateTimer];
+    });
+    return observer;
+}
+
+- (void)removeObserver:(id)observer
+{
+    if (![observer isKindOfClass:[IJKFFStatisticsObserver class]])
+        return;
+
+    // samples already on their way to the observer queue are dropped
+    ((IJKFFStatisticsObserver *)observer).removed = YES;
+    dispatch_async(_queue, ^{
+        [self->_observers removeObject:observer];
+        [self updateTimer];
+    });
+}
+
+- (void)removeAllObservers
+{
+    dispatch_async(_queue, ^{
+        for (IJKFFStatisticsObserver *observer in self->_observers)
+            observer.removed = YES;
+        [self->_observers removeAllObjects];
+        [self updateTimer];
+    });
+}
+
+// on _queue: ticks at the interval of the fastest observer
+- (void)updateTimer
+{
+    NSTimeInterval interval = 0;
+    for (IJKFFStatisticsObserver *observer in _observers) {
+        if (interval == 0 || observer.interval < interval)
+            interval = observer.interval;
+    }
+
+    if (interval == _timerInterval)
+        return;
+    _timerInterval = interval;
+
+    if (_timer) {
+        dispatch_source_cancel(_timer);
+        _timer = nil;
+    }
+    if (interval <= 0)
+        return;
+
+    __weak IJKFFStatisticsSampler *weakSelf = self;
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, 0),
+                              (uint64_t)(interval * NSEC_PER_SEC),
+                              (uint64_t)(interval * IJK_STATISTICS_DUE_SLACK * NSEC_PER_SEC));
+    dispatch_source_set_event_handler(_timer, ^{
+        [weakSelf tick];
+    });
+    dispatch_resume(_timer);
+}
+
+// on _queue
+- (void)tick
+{
+    NSTimeInterval  now     = CACurrentMediaTime();
+    BOOL            sampled = NO;
+    IJKFFStatistics statistics = {0};
+
+    for (IJKFFStatisticsObserver *observer in _observers) {
+        if (observer.nextSample - now > observer.interval * IJK_STATISTICS_DUE_SLACK)
+            continue;
+
+        if (!sampled) {
+            statistics = [self sample];
+            sampled    = YES;
+        }
+        observer.nextSample = now + observer.interval;
+
+        void (^block)(IJKFFStatistics statistics) = observer.block;
+        dispatch_async(observer.queue, ^{
+            if (!observer.removed)
+                block(statistics);
+        });
+    }
+}
+
+- (IJKFFStatistics)statistics
+{
+    __block IJKFFStatistics statistics;
+    dispatch_sync(_queue, ^{
+        statistics = [self sample];
+    });
+    return statistics;
+}
+
+#pragma mark sample
+
+// on _queue
+- (IJKFFStatistics)sample
+{
+    IJKFFStatistics statistics;
+    NSTimeInterval  now = CACurrentMediaTime();
+
+    pthread_mutex_lock(&_mutex);
+    statistics = _events;
+    if (statistics.rebuffering)
+        statistics.rebufferDuration += (int64_t)((now - _rebufferStart) * 1000);
+    IjkMediaPlayer *mp = _mediaPlayer;
+    if (mp)
+        ijkmp_inc_ref(mp);
+    pthread_mutex_unlock(&_mutex);
+
+    statistics.timestamp             = now;
+    statistics.outputFramesPerSecond = _view.fps;
+    statistics.judder                = _view.judder;
+    statistics.droppedPresents       = _view.droppedPresents;
+    statistics.textureCacheHits      = _view.textureCacheHits;
+    statistics.textureCacheMisses    = _view.textureCacheMisses;
+
+    if (!mp)
+        return statistics;
+
+    // published by a thread of the player, no wait on the player mutex
+    FFPropertySnapshot props;
+    if (!ijkmp_ios_get_property_snapshot(mp, &props)) {
+        ijkmp_dec_ref_p(&mp);
+        return statistics;
+    }
+
+    switch (props.video_decoder) {
+        case FFP_PROPV_DECODER_VIDEOTOOLBOX:
+            statistics.videoDecoder = IJKFFStatisticsDecoderVideoToolbox;
+            break;
+        case FFP_PROPV_DECODER_AVCODEC:
+            statistics.videoDecoder = IJKFFStatisticsDecoderAVCodec;
+            break;
+        default:
+            statistics.videoDecoder = IJKFFStatisticsDecoderUnknown;
+            break;
+    }
+
+    statistics.position              = props.position;
+    statistics.decodeFramesPerSecond = props.decode_frames_per_second;
+    statistics.dropFrameRate         = props.drop_frame_rate;
+    statistics.decimatedFrames       = ijkmp_ios_get_decimated_frames(mp);
+    statistics.videoCachedDuration   = props.video_cached_duration;
+    statistics.audioCachedDuration   = props.audio_cached_duration;
+    statistics.videoCachedBytes      = props.video_cached_bytes;
+    statistics.audioCachedBytes      = props.audio_cached_bytes;
+    statistics.videoCachedPackets    = props.video_cached_packets;
+    statistics.audioCachedPackets    = props.audio_cached_packets;
+    statistics.avDelay               = props.avdelay;
+    statistics.avDiff                = props.avdiff;
+    statistics.bitRate               = props.bit_rate;
+    statistics.tcpSpeed              = props.tcp_speed;
+
+    // these wait on the player mutex, here rather than on the main thread
+    int sourceRate, outputRate;
+    statistics.pictureQueueDepth     = ijkmp_ios_get_frame_queue_depth(mp);
+    ijkmp_ios_get_pixel_buffer_allocations(mp, &statistics.pixelBufferAllocations,
+                                           &statistics.steadyPixelBufferAllocations);
+    if (ijkmp_ios_get_audio_sample_rates(mp, &sourceRate, &outputRate)) {
+        statistics.audioOutputSampleRate   = sourceRate;
+        statistics.audioHardwareSampleRate = outputRate;
+    }
+
+    ijkmp_dec_ref_p(&mp);
+    return statistics;
+}
+
+#pragma mark events
+
+- (void)resetEvents
+{
+    pthread_mutex_lock(&_mutex);
+    memset(&_events, 0, sizeof(_events));
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)rebufferDidStart
+{
+    pthread_mutex_lock(&_mutex);
+    if (!_events.rebuffering) {
+        _events.rebuffering = YES;
+        _events.rebufferCount++;
+        _rebufferStart = CACurrentMediaTime();
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)rebufferDidEnd
+{
+    pthread_mutex_lock(&_mutex);
+    if (_events.rebuffering) {
+        _events.rebuffering = NO;
+        _events.rebufferDuration += (int64_t)((CACurrentMediaTime() - _rebufferStart) * 1000);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)variantDidSwitchToBitrate:(int)bitrate estimatedBandwidth:(int64_t)bandwidth
+{
+    pthread_mutex_lock(&_mutex);
+    _events.bitrateSwitchCount++;
+    _events.variantBitrate     = bitrate;
+    _events.estimatedBandwidth = bandwidth;
+    pthread_mutex_unlock(&_mutex);
+}
+
+@end
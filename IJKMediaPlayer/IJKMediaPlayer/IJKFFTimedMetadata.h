@@ -0,0 +1,46 @@
+/*
+ * IJKFFTimedMetadata.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, IJKFFTimedMetadataType) {
+    IJKFFTimedMetadataTypeSEI = 1,  // H.264 or HEVC SEI user data unregistered
+};
+
+// Timed metadata of the stream, handed over as the frame it comes with is
+// presented, see -[IJKFFMoviePlayerController setTimedMetadataHandler:queue:].
+@interface IJKFFTimedMetadata : NSObject
+
+- (instancetype)initWithType:(IJKFFTimedMetadataType)type time:(NSTimeInterval)time data:(NSData *)data;
+
+@property(nonatomic, readonly) IJKFFTimedMetadataType type;
+// seconds from the start of the media, as currentPlaybackTime
+@property(nonatomic, readonly) NSTimeInterval time;
+// the 16 bytes of uuid_iso_iec_11578, then the user data
+@property(nonatomic, readonly) NSData *data;
+// the first 16 bytes of data
+@property(nonatomic, readonly) NSUUID *uuid;
+// data after the uuid
+@property(nonatomic, readonly) NSData *payload;
+
+@end
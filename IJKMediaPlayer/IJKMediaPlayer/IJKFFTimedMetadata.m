@@ -0,0 +1,63 @@
+/*
+ * IJKFFTimedMetadata.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKFFTimedMetadata.h"
+
+#define IJK_SEI_UUID_SIZE 16
+
+@implementation IJKFFTimedMetadata
+
+- (instancetype)initWithType:(IJKFFTimedMetadataType)type time:(NSTimeInterval)time data:(NSData *)data
+{
+    self = [super init];
+    if (self) {
+        _type = type;
+        _time = time;
+        _data = data;
+    }
+    return self;
+}
+
+- (NSUUID *)uuid
+{
+    if (_type != IJKFFTimedMetadataTypeSEI || _data.length < IJK_SEI_UUID_SIZE)
+        return nil;
+
+    return [[NSUUID alloc] initWithUUIDBytes:_data.bytes];
+}
+
+- (NSData *)payload
+{
+    if (_type != IJKFFTimedMetadataTypeSEI || _data.length < IJK_SEI_UUID_SIZE)
+        return _data;
+
+    return [_data subdataWithRange:NSMakeRange(IJK_SEI_UUID_SIZE, _data.length - IJK_SEI_UUID_SIZE)];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: SEI %.3f, %lu bytes>", NSStringFromClass([self class]),
+            _time, (unsigned long)_data.length];
+}
+
+@end
@@ -1,8 +1,8 @@
-/*****************************************************************************
- * IJKVideoToolBox.h
- *****************************************************************************
+/*
+ * IJKHTTP3Transport.h
  *
- * copyright (c) 2014 Zhou Quan <zhouqicy@gmail.com>
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
  *
  * This file is part of ijkPlayer.
  *
@@ -21,17 +21,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#ifndef IJKMediaPlayer_videotoolbox_sync_h
-#define IJKMediaPlayer_videotoolbox_sync_h
 
-#include "ff_ffplay.h"
+#import <Foundation/Foundation.h>
 
-typedef struct Ijk_VideoToolBox_Opaque Ijk_VideoToolBox_Opaque;
+// The HTTP/3 transport of the process, see libavformat/http3transport.h:
+// the https requests of the format option "http3" go through one
+// NSURLSession, whose QUIC connections are shared by the players, resume
+// with 0-RTT and move with the device from Wi-Fi to cellular. An origin
+// which does not speak HTTP/3 is fallen back from by the session itself.
+@interface IJKHTTP3Transport : NSObject
 
-Ijk_VideoToolBox_Opaque* videotoolbox_sync_create(FFPlayer* ffp, AVCodecContext* ic);
+// once, by the first player; not before iOS 15
++ (void)start;
 
-int videotoolbox_sync_decode_frame(Ijk_VideoToolBox_Opaque* opaque);
-
-void videotoolbox_sync_free(Ijk_VideoToolBox_Opaque* opaque);
-
-#endif
+@end
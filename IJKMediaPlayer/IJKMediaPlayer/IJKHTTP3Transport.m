@@ -0,0 +1,351 @@
+/*
+ * IJKHTTP3Transport.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#import "IJKHTTP3Transport.h"
+#import <QuartzCore/QuartzCore.h>
+#include "libavformat/http3transport.h"
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+
+// a response is suspended with this much received and not read yet, and
+// resumed once half of it was read
+#define IJK_HTTP3_MAX_BUFFERED (4 * 1024 * 1024)
+
+// one request, its fields under @synchronized of itself
+@interface IJKHTTP3Task : NSObject
+{
+@public
+    AVHTTP3Request          *_request;      // NULL once closed
+    NSURLSessionDataTask    *_task;
+    NSHTTPURLResponse       *_response;
+    NSMutableData           *_body;         // received, from _bodyPos on not read yet
+    NSUInteger               _bodyPos;
+    BOOL                     _suspended;
+    BOOL                     _complete;
+    NSError                 *_error;
+    NSURLSessionTaskMetrics *_metrics;
+    CFTimeInterval           _start;
+}
+@end
+
+@implementation IJKHTTP3Task
+
+- (void)ready
+{
+    if (_request)
+        av_http3_request_ready(_request);
+}
+
+@end
+
+@interface IJKHTTP3Transport () <NSURLSessionDataDelegate>
+@end
+
+static IJKHTTP3Transport *g_transport;
+
+@implementation IJKHTTP3Transport
+{
+    NSURLSession *_session;
+    NSMutableDictionary<NSNumber *, IJKHTTP3Task *> *_tasks;   // by task identifier, until complete
+}
+
+static int ijkh3_error(NSError *error)
+{
+    if (!error)
+        return 0;
+    if (![error.domain isEqualToString:NSURLErrorDomain])
+        return AVERROR(EIO);
+    switch (error.code) {
+        case NSURLErrorCancelled:                   return AVERROR_EXIT;
+        case NSURLErrorTimedOut:                    return AVERROR(ETIMEDOUT);
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorDNSLookupFailed:             return AVERROR(EHOSTUNREACH);
+        case NSURLErrorCannotConnectToHost:         return AVERROR(ECONNREFUSED);
+        case NSURLErrorNetworkConnectionLost:       return AVERROR(ECONNRESET);
+        case NSURLErrorNotConnectedToInternet:      return AVERROR(ENETUNREACH);
+        default:                                    return AVERROR(EIO);
+    }
+}
+
+static int ijkh3_open(void *opaque, AVHTTP3Request *request, const char *method,
+                      const char *url, const char *headers, void **handle)
+{
+    @autoreleasepool {
+        IJKHTTP3Transport *transport = (__bridge IJKHTTP3Transport *)opaque;
+        NSURL *nsurl = [NSURL URLWithString:@(url)];
+        if (!nsurl)
+            return AVERROR(EINVAL);
+
+        NSMutableURLRequest *urlRequest = [NSMutableURLRequest requestWithURL:nsurl];
+        urlRequest.HTTPMethod = @(method);
+        if (@available(iOS 14.5, *))
+            urlRequest.assumesHTTP3Capable = YES;
+        for (NSString *line in [@(headers) componentsSeparatedByString:@"\r\n"]) {
+            NSRange colon = [line rangeOfString:@":"];
+            if (colon.location == NSNotFound)
+                continue;
+            NSString *name  = [line substringToIndex:colon.location];
+            NSString *value = [[line substringFromIndex:colon.location + 1]
+                               stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+            [urlRequest setValue:value forHTTPHeaderField:name];
+        }
+
+        IJKHTTP3Task *t = [[IJKHTTP3Task alloc] init];
+        t->_request = request;
+        t->_body    = [NSMutableData data];
+        t->_start   = CACurrentMediaTime();
+        t->_task    = [transport->_session dataTaskWithRequest:urlRequest];
+        @synchronized (transport) {
+            transport->_tasks[@(t->_task.taskIdentifier)] = t;
+        }
+        [t->_task resume];
+
+        *handle = (__bridge_retained void *)t;
+        return 0;
+    }
+}
+
+static int ijkh3_read_head(void *opaque, void *handle, int *status, char *headers, int size)
+{
+    @autoreleasepool {
+        IJKHTTP3Task *t = (__bridge IJKHTTP3Task *)handle;
+        NSHTTPURLResponse *response;
+
+        @synchronized (t) {
+            response = t->_response;
+            if (!response)
+                return t->_complete ? (t->_error ? ijkh3_error(t->_error) : AVERROR(EIO)) : AVERROR(EAGAIN);
+        }
+
+        // the body comes decoded, which the fields describing the encoded
+        // one would contradict
+        NSDictionary *fields  = response.allHeaderFields;
+        NSString     *coding  = nil;
+        for (NSString *name in fields) {
+            if ([name caseInsensitiveCompare:@"Content-Encoding"] == NSOrderedSame)
+                coding = fields[name];
+        }
+        BOOL decoded = coding && [coding caseInsensitiveCompare:@"identity"] != NSOrderedSame;
+
+        NSMutableString *lines = [NSMutableString string];
+        for (NSString *name in fields) {
+            if ([name caseInsensitiveCompare:@"Connection"] == NSOrderedSame ||
+                [name caseInsensitiveCompare:@"Keep-Alive"] == NSOrderedSame ||
+                [name caseInsensitiveCompare:@"Transfer-Encoding"] == NSOrderedSame)
+                continue;
+            if (decoded && ([name caseInsensitiveCompare:@"Content-Encoding"] == NSOrderedSame ||
+                            [name caseInsensitiveCompare:@"Content-Length"] == NSOrderedSame))
+                continue;
+            [lines appendFormat:@"%@: %@\r\n", name, fields[name]];
+        }
+        if (av_strlcpy(headers, lines.UTF8String, size) >= (size_t)size)
+            return AVERROR(ENOSPC);
+        *status = (int)response.statusCode;
+        return 0;
+    }
+}
+
+static int ijkh3_read(void *opaque, void *handle, uint8_t *buf, int size)
+{
+    IJKHTTP3Task *t = (__bridge IJKHTTP3Task *)handle;
+
+    @synchronized (t) {
+        NSUInteger available = t->_body.length - t->_bodyPos;
+        if (available == 0) {
+            if (!t->_complete)
+                return AVERROR(EAGAIN);
+            return ijkh3_error(t->_error);
+        }
+
+        int n = (int)MIN(available, (NSUInteger)size);
+        memcpy(buf, (const uint8_t *)t->_body.bytes + t->_bodyPos, n);
+        t->_bodyPos += n;
+        if (t->_bodyPos == t->_body.length) {
+            t->_body.length = 0;
+            t->_bodyPos     = 0;
+        } else if (t->_bodyPos >= IJK_HTTP3_MAX_BUFFERED / 2) {
+            [t->_body replaceBytesInRange:NSMakeRange(0, t->_bodyPos) withBytes:NULL length:0];
+            t->_bodyPos = 0;
+        }
+        if (t->_suspended && t->_body.length - t->_bodyPos < IJK_HTTP3_MAX_BUFFERED / 2) {
+            t->_suspended = NO;
+            [t->_task resume];
+        }
+        return n;
+    }
+}
+
+static void ijkh3_close(void *opaque, void *handle, AVHTTP3ConnectionStats *stats)
+{
+    @autoreleasepool {
+        IJKHTTP3Task *t = (__bridge_transfer IJKHTTP3Task *)handle;
+        NSURLSessionTaskMetrics *metrics;
+
+        @synchronized (t) {
+            t->_request = NULL;
+            if (!t->_complete)
+                [t->_task cancel];
+            metrics = t->_metrics;
+        }
+
+        stats->request_time = (int64_t)((CACurrentMediaTime() - t->_start) * 1000000);
+        stats->bytes        = t->_task.countOfBytesReceived;
+
+        // the transaction which brought the response, redirects are not followed
+        NSURLSessionTaskTransactionMetrics *transaction = metrics.transactionMetrics.lastObject;
+        if (!transaction)
+            return;
+        av_strlcpy(stats->protocol, transaction.networkProtocolName.UTF8String ?: "", sizeof(stats->protocol));
+        stats->reused = transaction.isReusedConnection;
+        if (!stats->reused && transaction.connectStartDate && transaction.connectEndDate)
+            stats->connect_time = (int64_t)([transaction.connectEndDate timeIntervalSinceDate:transaction.connectStartDate] * 1000000);
+        if (transaction.fetchStartDate && transaction.responseEndDate)
+            stats->request_time = (int64_t)([transaction.responseEndDate timeIntervalSinceDate:transaction.fetchStartDate] * 1000000);
+        if (@available(iOS 13.0, *))
+            av_strlcpy(stats->remote_ip, transaction.remoteAddress.UTF8String ?: "", sizeof(stats->remote_ip));
+    }
+}
+
++ (void)start
+{
+    if (@available(iOS 15.0, *)) {
+        static dispatch_once_t sOnceToken = 0;
+        dispatch_once(&sOnceToken, ^{
+            g_transport = [[IJKHTTP3Transport alloc] init];
+
+            AVHTTP3TransportCallbacks cb = {
+                .open      = ijkh3_open,
+                .read_head = ijkh3_read_head,
+                .read      = ijkh3_read,
+                .close     = ijkh3_close,
+            };
+            if (av_http3_register_transport(&cb, (__bridge void *)g_transport) < 0)
+                NSLog(@"IJKHTTP3Transport: not registered\n");
+        });
+    }
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        // http.c keeps its own cookies, cache and redirects
+        NSURLSessionConfiguration *config = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+        config.URLCache              = nil;
+        config.requestCachePolicy    = NSURLRequestReloadIgnoringLocalCacheData;
+        config.HTTPCookieStorage     = nil;
+        config.HTTPShouldSetCookies  = NO;
+
+        NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+        queue.name = @"tv.danmaku.ijk.http3";
+        queue.maxConcurrentOperationCount = 1;
+
+        _tasks   = [NSMutableDictionary dictionary];
+        _session = [NSURLSession sessionWithConfiguration:config delegate:self delegateQueue:queue];
+    }
+    return self;
+}
+
+- (IJKHTTP3Task *)taskOf:(NSURLSessionTask *)task
+{
+    @synchronized (self) {
+        return _tasks[@(task.taskIdentifier)];
+    }
+}
+
+#pragma mark NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+willPerformHTTPRedirection:(NSHTTPURLResponse *)response
+        newRequest:(NSURLRequest *)request
+ completionHandler:(void (^)(NSURLRequest *))completionHandler
+{
+    // the redirect goes to http.c as the response
+    completionHandler(nil);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    IJKHTTP3Task *t = [self taskOf:dataTask];
+    if (!t || ![response isKindOfClass:[NSHTTPURLResponse class]]) {
+        completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+
+    @synchronized (t) {
+        t->_response = (NSHTTPURLResponse *)response;
+        [t ready];
+    }
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveData:(NSData *)data
+{
+    IJKHTTP3Task *t = [self taskOf:dataTask];
+    if (!t)
+        return;
+
+    @synchronized (t) {
+        [t->_body appendData:data];
+        if (!t->_suspended && t->_body.length - t->_bodyPos >= IJK_HTTP3_MAX_BUFFERED) {
+            t->_suspended = YES;
+            [t->_task suspend];
+        }
+        [t ready];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics
+{
+    IJKHTTP3Task *t = [self taskOf:task];
+    if (!t)
+        return;
+
+    @synchronized (t) {
+        t->_metrics = metrics;
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task
+didCompleteWithError:(NSError *)error
+{
+    IJKHTTP3Task *t = [self taskOf:task];
+    @synchronized (self) {
+        [_tasks removeObjectForKey:@(task.taskIdentifier)];
+    }
+    if (!t)
+        return;
+
+    @synchronized (t) {
+        t->_complete = YES;
+        t->_error    = error;
+        [t ready];
+    }
+}
+
+@end
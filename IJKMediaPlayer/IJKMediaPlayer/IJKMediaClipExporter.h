@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+
+@class IJKFFOptions;
+
+typedef NS_ENUM(NSInteger, IJKMediaClipCodec) {
+    IJKMediaClipCodecH264,
+    IJKMediaClipCodecHEVC,      // H.264 where HEVC cannot be encoded
+};
+
+extern NSString *const IJKMediaClipExporterErrorDomain;
+
+// progress from 0 to 1, of the time range exported
+typedef void (^IJKMediaClipProgressHandler)(double progress);
+// error is nil once the file is complete, else its code is an FFmpeg error
+// in IJKMediaClipExporterErrorDomain, an OSStatus in NSOSStatusErrorDomain,
+// or NSUserCancelledError in NSCocoaErrorDomain
+typedef void (^IJKMediaClipCompletionHandler)(NSError *error);
+
+// Exports a time range of a url to an mp4 file apart from any player: a
+// demuxer of its own, a decode only pass and a VideoToolbox encoder.
+//
+// The decoded frames stay on the GPU: VideoToolbox decodes H.264 and HEVC
+// in mp4 like containers to IOSurface backed pixel buffers, which go to the
+// encoder as they are, scaled by a pixel transfer session when smaller.
+// Other streams are decoded in software, then converted and scaled once
+// into the encoder's own pixel buffers. The audio is copied as it is when
+// mp4 takes its codec. The export starts at the key frame before the range
+// and is decoded from there, frames before it are not encoded.
+@interface IJKMediaClipExporter : NSObject
+
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options;
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options;
+
+// the video fits in it keeping the display aspect ratio, CGSizeZero for the video size
+@property(atomic) CGSize maximumSize;
+@property(atomic) IJKMediaClipCodec codec;
+// bits per second, 0 for one after the size and the frame rate
+@property(atomic) int64_t bitRate;
+// YES by default
+@property(atomic) BOOL includesAudio;
+
+// handlers are called on the main thread; NO while an export runs
+- (BOOL)exportFromTime:(NSTimeInterval)startTime
+                toTime:(NSTimeInterval)endTime
+                toPath:(NSString *)path
+              progress:(IJKMediaClipProgressHandler)progress
+            completion:(IJKMediaClipCompletionHandler)completion;
+@property(atomic, readonly) BOOL isExporting;
+
+// the file is removed, completion gets NSUserCancelledError
+- (void)cancel;
+
+@end
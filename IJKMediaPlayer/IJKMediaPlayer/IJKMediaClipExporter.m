@@ -0,0 +1,832 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaClipExporter.h"
+#import "IJKFFOptions.h"
+#import <VideoToolbox/VideoToolbox.h>
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libswscale/swscale.h"
+
+// timescale of the encoded video
+#define IJK_CLIP_TIMESCALE          90000
+// of the default bit rate: 6 Mbps for 1080p at 30 fps
+#define IJK_CLIP_BITS_PER_PIXEL     0.1
+#define IJK_CLIP_KEY_INTERVAL       2.0
+// audio read before the first encoded frame waits for the header, up to this
+#define IJK_CLIP_MAX_HELD_PACKETS   512
+
+NSString *const IJKMediaClipExporterErrorDomain = @"IJKMediaClipExporter";
+
+static NSError *ijkclip_av_error(int error)
+{
+    return [NSError errorWithDomain:IJKMediaClipExporterErrorDomain
+                               code:error
+                           userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithUTF8String:av_err2str(error)]}];
+}
+
+static NSError *ijkclip_status_error(OSStatus status)
+{
+    return [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+}
+
+@interface IJKMediaClipExporter ()
+- (void)encodePixelBuffer:(CVPixelBufferRef)pixelBuffer pts:(int64_t)pts;
+- (void)addEncodedSample:(CMSampleBufferRef)sample status:(OSStatus)status;
+@end
+
+// in display order, see kVTDecodeFrame_EnableTemporalProcessing
+static void ijkclip_vtb_output(void *decompressionOutputRefCon, void *sourceFrameRefCon,
+                               OSStatus status, VTDecodeInfoFlags infoFlags,
+                               CVImageBufferRef imageBuffer, CMTime presentationTimeStamp,
+                               CMTime presentationDuration)
+{
+    IJKMediaClipExporter *exporter = (__bridge IJKMediaClipExporter *)decompressionOutputRefCon;
+    if (status == noErr && imageBuffer && CMTIME_IS_NUMERIC(presentationTimeStamp))
+        [exporter encodePixelBuffer:imageBuffer pts:presentationTimeStamp.value];
+}
+
+// on a thread of the encoder
+static void ijkclip_vtenc_output(void *outputCallbackRefCon, void *sourceFrameRefCon,
+                                 OSStatus status, VTEncodeInfoFlags infoFlags,
+                                 CMSampleBufferRef sampleBuffer)
+{
+    IJKMediaClipExporter *exporter = (__bridge IJKMediaClipExporter *)outputCallbackRefCon;
+    [exporter addEncodedSample:sampleBuffer status:status];
+}
+
+static int ijkclip_interrupt_cb(void *opaque);
+
+@implementation IJKMediaClipExporter {
+    dispatch_queue_t     _queue;
+    NSString            *_urlString;
+    AVDictionary        *_formatOptions;
+
+    volatile int         _exporting;
+    volatile int         _cancelled;
+
+    // owned by the queue during an export
+    AVFormatContext     *_inContext;
+    int                  _videoStreamIndex;
+    int                  _audioStreamIndex;
+    AVRational           _videoTimeBase;
+    int64_t              _startPts;             // of the range, in the video time base
+    int64_t              _endPts;
+    int64_t              _lastEncodedPts;
+    AVCodecContext      *_codecContext;
+    struct SwsContext   *_swsContext;
+
+    VTDecompressionSessionRef   _vtbSession;
+    CMVideoFormatDescriptionRef _vtbFormat;
+
+    VTCompressionSessionRef     _encoder;
+    CMVideoCodecType            _encoderCodec;
+    int                         _width;
+    int                         _height;
+    void                       *_transferSession;   // VTPixelTransferSessionRef, iOS 16
+
+    AVFormatContext     *_outContext;
+    int                  _outVideoIndex;
+    int                  _outAudioIndex;
+    BOOL                 _headerWritten;
+    AVPacket            *_heldPackets[IJK_CLIP_MAX_HELD_PACKETS];
+    int                  _nbHeldPackets;
+
+    // filled by the encoder's threads
+    NSMutableArray      *_encodedSamples;
+    volatile OSStatus    _encodeStatus;
+}
+
+@synthesize maximumSize   = _maximumSize;
+@synthesize codec         = _codec;
+@synthesize bitRate       = _bitRate;
+@synthesize includesAudio = _includesAudio;
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options
+{
+    if (aUrl == nil)
+        return nil;
+
+    return [self initWithContentURLString:[aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString]
+                                  options:options];
+}
+
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options
+{
+    if (aUrlString.length == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.clipexporter", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+        _urlString      = [aUrlString copy];
+        _includesAudio  = YES;
+        _encodedSamples = [NSMutableArray array];
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        ijkmp_global_init();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // queued blocks retain self, none is left
+    av_dict_free(&_formatOptions);
+}
+
+- (BOOL)isExporting
+{
+    return _exporting != 0;
+}
+
+- (void)cancel
+{
+    _cancelled = 1;
+}
+
+#pragma mark export
+
+- (BOOL)exportFromTime:(NSTimeInterval)startTime
+                toTime:(NSTimeInterval)endTime
+                toPath:(NSString *)path
+              progress:(IJKMediaClipProgressHandler)progress
+            completion:(IJKMediaClipCompletionHandler)completion
+{
+    if (path.length == 0 || endTime <= startTime || !__sync_bool_compare_and_swap(&_exporting, 0, 1))
+        return NO;
+    _cancelled = 0;
+
+    IJKMediaClipProgressHandler   progressBlock   = [progress copy];
+    IJKMediaClipCompletionHandler completionBlock = [completion copy];
+    CGSize            maximumSize   = self.maximumSize;
+    IJKMediaClipCodec codec         = self.codec;
+    int64_t           bitRate       = self.bitRate;
+    BOOL              includesAudio = self.includesAudio;
+
+    // the export goes on for a while once the app is left
+    __block UIBackgroundTaskIdentifier task = UIBackgroundTaskInvalid;
+    task = [[UIApplication sharedApplication] beginBackgroundTaskWithName:@"IJKMediaClipExporter" expirationHandler:^{
+        [self cancel];
+    }];
+
+    dispatch_async(_queue, ^{
+        NSError *error = nil;
+        @autoreleasepool {
+            error = [self exportFromTime:startTime
+                                  toTime:endTime
+                                  toPath:path
+                             maximumSize:maximumSize
+                                   codec:codec
+                                 bitRate:bitRate
+                           includesAudio:includesAudio
+                                progress:progressBlock];
+        }
+        [self close];
+        if (error)
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        _exporting = 0;
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completionBlock)
+                completionBlock(error);
+            if (task != UIBackgroundTaskInvalid)
+                [[UIApplication sharedApplication] endBackgroundTask:task];
+        });
+    });
+    return YES;
+}
+
+- (NSError *)exportFromTime:(NSTimeInterval)startTime
+                     toTime:(NSTimeInterval)endTime
+                     toPath:(NSString *)path
+                maximumSize:(CGSize)maximumSize
+                      codec:(IJKMediaClipCodec)codec
+                    bitRate:(int64_t)bitRate
+              includesAudio:(BOOL)includesAudio
+                   progress:(IJKMediaClipProgressHandler)progress
+{
+    int ret = [self openInput:includesAudio];
+    if (ret < 0)
+        return ijkclip_av_error(ret);
+
+    AVStream *st      = _inContext->streams[_videoStreamIndex];
+    int64_t   startUs = _inContext->start_time != AV_NOPTS_VALUE ? _inContext->start_time : 0;
+    _videoTimeBase    = st->time_base;
+    _startPts         = av_rescale_q(startUs + (int64_t)(startTime * AV_TIME_BASE), AV_TIME_BASE_Q, _videoTimeBase);
+    _endPts           = av_rescale_q(startUs + (int64_t)(endTime * AV_TIME_BASE), AV_TIME_BASE_Q, _videoTimeBase);
+    _lastEncodedPts   = INT64_MIN;
+
+    OSStatus status = [self openEncoder:codec maximumSize:maximumSize bitRate:bitRate];
+    if (status != noErr)
+        return ijkclip_status_error(status);
+    if ((ret = [self openOutput:path]) < 0)
+        return ijkclip_av_error(ret);
+
+    // max_ts at the start: the key frame at or before it
+    ret = avformat_seek_file(_inContext, _videoStreamIndex, INT64_MIN, _startPts, _startPts, 0);
+    if (ret < 0 && _startPts > av_rescale_q(startUs, AV_TIME_BASE_Q, _videoTimeBase))
+        return ijkclip_av_error(ret);
+
+    BOOL useVideoToolbox = [self openVideoToolbox];
+    if (!useVideoToolbox && (ret = [self openSoftwareDecoder]) < 0)
+        return ijkclip_av_error(ret);
+
+    AVFrame *frame      = av_frame_alloc();
+    BOOL     videoDone  = NO;
+    BOOL     audioDone  = _audioStreamIndex < 0;
+    double   reported   = 0;
+    AVPacket pkt;
+    if (!frame)
+        return ijkclip_av_error(AVERROR(ENOMEM));
+
+    while (!videoDone || !audioDone) {
+        ret = av_read_frame(_inContext, &pkt);
+        if (ret < 0)
+            break;
+
+        if (pkt.stream_index == _videoStreamIndex && !videoDone) {
+            // no frame from here on is shown in the range
+            if (pkt.dts != AV_NOPTS_VALUE && pkt.dts >= _endPts)
+                videoDone = YES;
+            else if (useVideoToolbox)
+                status = [self decodeVideoToolboxPacket:&pkt];
+            else
+                ret = [self decodeSoftwarePacket:&pkt frame:frame];
+        } else if (pkt.stream_index == _audioStreamIndex && !audioDone) {
+            AVRational tb  = _inContext->streams[_audioStreamIndex]->time_base;
+            int64_t    pts = pkt.pts != AV_NOPTS_VALUE ? av_rescale_q(pkt.pts, tb, _videoTimeBase) : AV_NOPTS_VALUE;
+            if (pts != AV_NOPTS_VALUE && pts >= _endPts)
+                audioDone = YES;
+            else if (pts != AV_NOPTS_VALUE && pts >= _startPts)
+                ret = [self writeAudioPacket:&pkt];
+        }
+        av_packet_unref(&pkt);
+        if (ret < 0 || status != noErr)
+            break;
+
+        if ((ret = [self drainEncodedSamples]) < 0)
+            break;
+        if (_encodeStatus != noErr) {
+            status = _encodeStatus;
+            break;
+        }
+
+        double done = _lastEncodedPts == INT64_MIN ? 0 : (double)(_lastEncodedPts - _startPts) / MAX(_endPts - _startPts, 1);
+        if (progress && done - reported >= 0.01) {
+            reported = done;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                progress(MIN(done, 1.0));
+            });
+        }
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+    // the delayed frames, then the ones in the encoder
+    if (ret >= 0 && status == noErr) {
+        if (useVideoToolbox)
+            VTDecompressionSessionFinishDelayedFrames(_vtbSession);
+        else
+            ret = [self decodeSoftwarePacket:NULL frame:frame];
+    }
+    av_frame_free(&frame);
+    if (ret >= 0 && status == noErr) {
+        status = VTCompressionSessionCompleteFrames(_encoder, kCMTimeInvalid);
+        if (status == noErr)
+            status = _encodeStatus;
+    }
+    if (ret >= 0 && status == noErr)
+        ret = [self drainEncodedSamples];
+
+    if (_cancelled)
+        return [NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil];
+    if (status != noErr)
+        return ijkclip_status_error(status);
+    if (ret < 0)
+        return ijkclip_av_error(ret);
+    if (!_headerWritten)
+        return ijkclip_av_error(AVERROR_INVALIDDATA);   // not a frame in the range
+
+    if ((ret = av_write_trailer(_outContext)) < 0)
+        return ijkclip_av_error(ret);
+    if (progress) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            progress(1.0);
+        });
+    }
+    return nil;
+}
+
+- (void)close
+{
+    if (_vtbSession) {
+        VTDecompressionSessionInvalidate(_vtbSession);
+        CFRelease(_vtbSession);
+        _vtbSession = NULL;
+    }
+    if (_vtbFormat) {
+        CFRelease(_vtbFormat);
+        _vtbFormat = NULL;
+    }
+    if (_encoder) {
+        VTCompressionSessionInvalidate(_encoder);
+        CFRelease(_encoder);
+        _encoder = NULL;
+    }
+    if (_transferSession) {
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 160000
+        if (@available(iOS 16.0, *))
+            VTPixelTransferSessionInvalidate((VTPixelTransferSessionRef)_transferSession);
+#endif
+        CFRelease(_transferSession);
+        _transferSession = NULL;
+    }
+    @synchronized (_encodedSamples) {
+        [_encodedSamples removeAllObjects];
+    }
+    _encodeStatus = noErr;
+
+    for (int i = 0; i < _nbHeldPackets; ++i)
+        av_packet_free(&_heldPackets[i]);
+    _nbHeldPackets = 0;
+    if (_outContext) {
+        avio_closep(&_outContext->pb);
+        avformat_free_context(_outContext);
+        _outContext = NULL;
+    }
+    _headerWritten = NO;
+
+    sws_freeContext(_swsContext);
+    _swsContext = NULL;
+    avcodec_free_context(&_codecContext);
+    avformat_close_input(&_inContext);
+}
+
+#pragma mark input, on the queue
+
+static int ijkclip_interrupt_cb(void *opaque)
+{
+    IJKMediaClipExporter *exporter = (__bridge IJKMediaClipExporter *)opaque;
+    return exporter->_cancelled;
+}
+
+- (int)openInput:(BOOL)includesAudio
+{
+    AVFormatContext *ic = avformat_alloc_context();
+    if (!ic)
+        return AVERROR(ENOMEM);
+    ic->interrupt_callback.callback = ijkclip_interrupt_cb;
+    ic->interrupt_callback.opaque   = (__bridge void *)self;
+
+    AVDictionary *options = NULL;
+    av_dict_copy(&options, _formatOptions, 0);
+    int ret = avformat_open_input(&ic, _urlString.UTF8String, NULL, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        NSLog(@"IJKMediaClipExporter: failed to open %@: %d\n", _urlString, ret);
+        return ret;
+    }
+    _inContext = ic;
+
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        return ret;
+    _videoStreamIndex = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (_videoStreamIndex < 0)
+        return _videoStreamIndex;
+    _audioStreamIndex = -1;
+    if (includesAudio) {
+        int index = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, _videoStreamIndex, NULL, 0);
+        AVOutputFormat *mp4 = av_guess_format("mp4", NULL, NULL);
+        if (index >= 0 && mp4 && avformat_query_codec(mp4, ic->streams[index]->codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 1)
+            _audioStreamIndex = index;
+    }
+
+    for (unsigned int i = 0; i < ic->nb_streams; ++i)
+        ic->streams[i]->discard = ((int)i == _videoStreamIndex || (int)i == _audioStreamIndex) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    return 0;
+}
+
+- (BOOL)openVideoToolbox
+{
+    AVCodecParameters *par = _inContext->streams[_videoStreamIndex]->codecpar;
+    CMVideoCodecType codecType = 0;
+    NSString *atom = nil;
+    if (par->codec_id == AV_CODEC_ID_H264) {
+        codecType = kCMVideoCodecType_H264;
+        atom      = @"avcC";
+    }
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (par->codec_id == AV_CODEC_ID_HEVC) {
+        if (@available(iOS 11.0, *)) {
+            if (VTIsHardwareDecodeSupported(kCMVideoCodecType_HEVC)) {
+                codecType = kCMVideoCodecType_HEVC;
+                atom      = @"hvcC";
+            }
+        }
+    }
+#endif
+    // annex b streams, e.g. mpegts, have no avcC/hvcC to describe them with
+    if (!atom || par->extradata_size < 7 || par->extradata[0] != 1)
+        return NO;
+
+    NSDictionary *extensions = @{
+        (id)kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms: @{
+            atom: [NSData dataWithBytes:par->extradata length:par->extradata_size],
+        },
+    };
+    OSStatus status = CMVideoFormatDescriptionCreate(kCFAllocatorDefault, codecType, par->width, par->height,
+                                                     (__bridge CFDictionaryRef)extensions, &_vtbFormat);
+    if (status != noErr)
+        return NO;
+
+    // what the encoder reads without a conversion
+    NSDictionary *attributes = @{
+        (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+        (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+    };
+    VTDecompressionOutputCallbackRecord callback = { ijkclip_vtb_output, (__bridge void *)self };
+    status = VTDecompressionSessionCreate(kCFAllocatorDefault, _vtbFormat, NULL,
+                                          (__bridge CFDictionaryRef)attributes, &callback, &_vtbSession);
+    if (status != noErr) {
+        NSLog(@"IJKMediaClipExporter: VTDecompressionSessionCreate failed: %d\n", (int)status);
+        CFRelease(_vtbFormat);
+        _vtbFormat = NULL;
+        return NO;
+    }
+    return YES;
+}
+
+- (int)openSoftwareDecoder
+{
+    AVCodecParameters *par = _inContext->streams[_videoStreamIndex]->codecpar;
+    AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    if (!(_codecContext = avcodec_alloc_context3(codec)))
+        return AVERROR(ENOMEM);
+    int ret = avcodec_parameters_to_context(_codecContext, par);
+    if (ret < 0)
+        return ret;
+    // throughput over latency: frame threads on every core
+    _codecContext->thread_count = 0;
+    _codecContext->pkt_timebase = _videoTimeBase;
+    return avcodec_open2(_codecContext, codec, NULL);
+}
+
+// the frames come out through ijkclip_vtb_output before it returns
+- (OSStatus)decodeVideoToolboxPacket:(AVPacket *)pkt
+{
+    CMBlockBufferRef  block      = NULL;
+    CMSampleBufferRef sample     = NULL;
+    const size_t      sampleSize = pkt->size;
+    // in the units of the stream, read back as they are
+    CMSampleTimingInfo timing = {
+        .duration              = kCMTimeInvalid,
+        .presentationTimeStamp = CMTimeMake(pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts, 1),
+        .decodeTimeStamp       = kCMTimeInvalid,
+    };
+
+    OSStatus status = CMBlockBufferCreateWithMemoryBlock(kCFAllocatorDefault, pkt->data, pkt->size, kCFAllocatorNull,
+                                                         NULL, 0, pkt->size, 0, &block);
+    if (status == noErr)
+        status = CMSampleBufferCreate(kCFAllocatorDefault, block, TRUE, NULL, NULL, _vtbFormat,
+                                      1, 1, &timing, 1, &sampleSize, &sample);
+    if (status == noErr) {
+        status = VTDecompressionSessionDecodeFrame(_vtbSession, sample, kVTDecodeFrame_EnableTemporalProcessing, NULL, NULL);
+        if (status == noErr)
+            VTDecompressionSessionWaitForAsynchronousFrames(_vtbSession);
+    }
+
+    if (sample)
+        CFRelease(sample);
+    if (block)
+        CFRelease(block);
+    return status;
+}
+
+// pkt NULL drains the decoder
+- (int)decodeSoftwarePacket:(AVPacket *)pkt frame:(AVFrame *)frame
+{
+    int ret = avcodec_send_packet(_codecContext, pkt);
+    if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_INVALIDDATA)
+        return ret;
+
+    while ((ret = avcodec_receive_frame(_codecContext, frame)) >= 0) {
+        int64_t pts = av_frame_get_best_effort_timestamp(frame);
+        if (pts != AV_NOPTS_VALUE && pts >= _startPts && pts < _endPts)
+            ret = [self encodeSoftwareFrame:frame pts:pts];
+        av_frame_unref(frame);
+        if (ret < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+// one conversion, scaled, into a pixel buffer of the encoder
+- (int)encodeSoftwareFrame:(AVFrame *)frame pts:(int64_t)pts
+{
+    CVPixelBufferRef pixelBuffer = NULL;
+    CVPixelBufferPoolRef pool = VTCompressionSessionGetPixelBufferPool(_encoder);
+    if (!pool || CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, pool, &pixelBuffer) != kCVReturnSuccess)
+        return AVERROR(ENOMEM);
+
+    _swsContext = sws_getCachedContext(_swsContext,
+                                       frame->width, frame->height, frame->format,
+                                       _width, _height, AV_PIX_FMT_NV12,
+                                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (!_swsContext) {
+        CVPixelBufferRelease(pixelBuffer);
+        return AVERROR(EINVAL);
+    }
+
+    CVPixelBufferLockBaseAddress(pixelBuffer, 0);
+    uint8_t *data[4]     = { CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0),
+                             CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1) };
+    int      linesize[4] = { (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0),
+                             (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1) };
+    sws_scale(_swsContext, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height, data, linesize);
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+
+    [self encodePixelBuffer:pixelBuffer pts:pts];
+    CVPixelBufferRelease(pixelBuffer);
+    return 0;
+}
+
+#pragma mark encoder
+
+- (OSStatus)openEncoder:(IJKMediaClipCodec)codec maximumSize:(CGSize)maximumSize bitRate:(int64_t)bitRate
+{
+    AVStream          *st  = _inContext->streams[_videoStreamIndex];
+    AVCodecParameters *par = st->codecpar;
+    if (par->width <= 0 || par->height <= 0)
+        return kVTParameterErr;
+
+    // square pixels, the display aspect ratio kept
+    CGFloat    displayWidth = par->width;
+    AVRational sar          = av_guess_sample_aspect_ratio(_inContext, st, NULL);
+    if (sar.num > 0 && sar.den > 0)
+        displayWidth = par->width * (CGFloat)sar.num / sar.den;
+    CGFloat scale = 1.0f;
+    if (maximumSize.width > 0 && maximumSize.height > 0)
+        scale = MIN(1.0f, MIN(maximumSize.width / displayWidth, maximumSize.height / par->height));
+    _width  = MAX((int)lround(displayWidth * scale) & ~1, 2);
+    _height = MAX((int)lround(par->height * scale) & ~1, 2);
+
+    AVRational frameRate = av_guess_frame_rate(_inContext, st, NULL);
+    double     fps       = frameRate.num > 0 && frameRate.den > 0 ? av_q2d(frameRate) : 30.0;
+    if (bitRate <= 0)
+        bitRate = (int64_t)(_width * _height * fps * IJK_CLIP_BITS_PER_PIXEL);
+
+    NSDictionary *attributes = @{
+        (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+        (id)kCVPixelBufferWidthKey:               @(_width),
+        (id)kCVPixelBufferHeightKey:              @(_height),
+        (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+    };
+    OSStatus status = kVTCouldNotFindVideoEncoderErr;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (codec == IJKMediaClipCodecHEVC) {
+        if (@available(iOS 11.0, *)) {
+            _encoderCodec = kCMVideoCodecType_HEVC;
+            status = VTCompressionSessionCreate(kCFAllocatorDefault, _width, _height, _encoderCodec, NULL,
+                                                (__bridge CFDictionaryRef)attributes, NULL,
+                                                ijkclip_vtenc_output, (__bridge void *)self, &_encoder);
+        }
+    }
+#endif
+    if (status != noErr) {
+        _encoderCodec = kCMVideoCodecType_H264;
+        status = VTCompressionSessionCreate(kCFAllocatorDefault, _width, _height, _encoderCodec, NULL,
+                                            (__bridge CFDictionaryRef)attributes, NULL,
+                                            ijkclip_vtenc_output, (__bridge void *)self, &_encoder);
+    }
+    if (status != noErr) {
+        NSLog(@"IJKMediaClipExporter: VTCompressionSessionCreate failed: %d\n", (int)status);
+        return status;
+    }
+
+    // faster than real time, and dts is pts
+    VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_RealTime, kCFBooleanFalse);
+    VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_AllowFrameReordering, kCFBooleanFalse);
+    VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_AverageBitRate, (__bridge CFTypeRef)@(bitRate));
+    VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_ExpectedFrameRate, (__bridge CFTypeRef)@(fps));
+    VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_MaxKeyFrameIntervalDuration, (__bridge CFTypeRef)@(IJK_CLIP_KEY_INTERVAL));
+    if (_encoderCodec == kCMVideoCodecType_H264)
+        VTSessionSetProperty(_encoder, kVTCompressionPropertyKey_ProfileLevel, kVTProfileLevel_H264_High_AutoLevel);
+    status = VTCompressionSessionPrepareToEncodeFrames(_encoder);
+    if (status != noErr)
+        return status;
+
+    // decoded frames larger than the output are scaled on the GPU; before
+    // iOS 16 the encoder scales them itself
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 160000
+    if (@available(iOS 16.0, *)) {
+        if (_width != par->width || _height != par->height) {
+            VTPixelTransferSessionRef transfer = NULL;
+            if (VTPixelTransferSessionCreate(kCFAllocatorDefault, &transfer) == noErr)
+                _transferSession = transfer;
+        }
+    }
+#endif
+    return noErr;
+}
+
+// on the queue, or a thread of the decoder while the queue waits on it
+- (void)encodePixelBuffer:(CVPixelBufferRef)pixelBuffer pts:(int64_t)pts
+{
+    // the frames before the range decode the ones in it, and pts go up
+    if (pts < _startPts || pts >= _endPts || pts <= _lastEncodedPts || _encodeStatus != noErr)
+        return;
+
+    CVPixelBufferRef scaled = NULL;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 160000
+    if (_transferSession && (int)CVPixelBufferGetWidth(pixelBuffer) != _width) {
+        if (@available(iOS 16.0, *)) {
+            CVPixelBufferPoolRef pool = VTCompressionSessionGetPixelBufferPool(_encoder);
+            if (pool && CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, pool, &scaled) == kCVReturnSuccess &&
+                VTPixelTransferSessionTransferImage((VTPixelTransferSessionRef)_transferSession, pixelBuffer, scaled) == noErr)
+                pixelBuffer = scaled;
+        }
+    }
+#endif
+
+    CMTime time = CMTimeMake(av_rescale_q(pts - _startPts, _videoTimeBase, (AVRational){ 1, IJK_CLIP_TIMESCALE }),
+                             IJK_CLIP_TIMESCALE);
+    OSStatus status = VTCompressionSessionEncodeFrame(_encoder, pixelBuffer, time, kCMTimeInvalid, NULL, NULL, NULL);
+    CVPixelBufferRelease(scaled);
+    if (status != noErr)
+        _encodeStatus = status;
+    else
+        _lastEncodedPts = pts;
+}
+
+- (void)addEncodedSample:(CMSampleBufferRef)sample status:(OSStatus)status
+{
+    if (status != noErr) {
+        // kVTInvalidSessionErr once in the background among others
+        _encodeStatus = status;
+        return;
+    }
+    if (!sample)
+        return;     // a frame dropped
+    @synchronized (_encodedSamples) {
+        [_encodedSamples addObject:(__bridge id)sample];
+    }
+}
+
+#pragma mark output, on the queue
+
+- (int)openOutput:(NSString *)path
+{
+    int ret = avformat_alloc_output_context2(&_outContext, NULL, "mp4", path.fileSystemRepresentation);
+    if (ret < 0)
+        return ret;
+
+    AVStream *vst = avformat_new_stream(_outContext, NULL);
+    if (!vst)
+        return AVERROR(ENOMEM);
+    vst->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    vst->codecpar->codec_id   = _encoderCodec == kCMVideoCodecType_HEVC ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
+    vst->codecpar->width      = _width;
+    vst->codecpar->height     = _height;
+    vst->time_base            = (AVRational){ 1, IJK_CLIP_TIMESCALE };
+    _outVideoIndex            = vst->index;
+
+    _outAudioIndex = -1;
+    if (_audioStreamIndex >= 0) {
+        AVStream *ist = _inContext->streams[_audioStreamIndex];
+        AVStream *ast = avformat_new_stream(_outContext, NULL);
+        if (!ast)
+            return AVERROR(ENOMEM);
+        if ((ret = avcodec_parameters_copy(ast->codecpar, ist->codecpar)) < 0)
+            return ret;
+        ast->codecpar->codec_tag = 0;
+        ast->time_base           = ist->time_base;
+        _outAudioIndex           = ast->index;
+    }
+
+    return avio_open2(&_outContext->pb, path.fileSystemRepresentation, AVIO_FLAG_WRITE, NULL, NULL);
+}
+
+// the avcC or hvcC the encoder wrote goes to the header with the first frame
+- (int)writeHeaderWithSample:(CMSampleBufferRef)sample
+{
+    CMFormatDescriptionRef format = CMSampleBufferGetFormatDescription(sample);
+    CFDictionaryRef atoms = format ? CMFormatDescriptionGetExtension(format, kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms) : NULL;
+    CFDataRef config = atoms ? CFDictionaryGetValue(atoms, _encoderCodec == kCMVideoCodecType_HEVC ? CFSTR("hvcC") : CFSTR("avcC")) : NULL;
+    if (!config)
+        return AVERROR_INVALIDDATA;
+
+    AVCodecParameters *par = _outContext->streams[_outVideoIndex]->codecpar;
+    int size = (int)CFDataGetLength(config);
+    par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!par->extradata)
+        return AVERROR(ENOMEM);
+    memcpy(par->extradata, CFDataGetBytePtr(config), size);
+    par->extradata_size = size;
+
+    int ret = avformat_write_header(_outContext, NULL);
+    if (ret < 0)
+        return ret;
+    _headerWritten = YES;
+
+    for (int i = 0; i < _nbHeldPackets && ret >= 0; ++i)
+        ret = [self writeAudioPacket:_heldPackets[i]];
+    for (int i = 0; i < _nbHeldPackets; ++i)
+        av_packet_free(&_heldPackets[i]);
+    _nbHeldPackets = 0;
+    return ret;
+}
+
+- (int)drainEncodedSamples
+{
+    NSArray *samples;
+    @synchronized (_encodedSamples) {
+        samples = [_encodedSamples copy];
+        [_encodedSamples removeAllObjects];
+    }
+
+    for (id object in samples) {
+        CMSampleBufferRef sample = (__bridge CMSampleBufferRef)object;
+        int ret = 0;
+        if (!_headerWritten && (ret = [self writeHeaderWithSample:sample]) < 0)
+            return ret;
+
+        CMBlockBufferRef block  = CMSampleBufferGetDataBuffer(sample);
+        size_t           length = block ? CMBlockBufferGetDataLength(block) : 0;
+        AVPacket         pkt;
+        if (length == 0)
+            continue;
+        if ((ret = av_new_packet(&pkt, (int)length)) < 0)
+            return ret;
+        // length prefixed NAL units, as mp4 stores them
+        CMBlockBufferCopyDataBytes(block, 0, length, pkt.data);
+
+        CMTime pts = CMTimeConvertScale(CMSampleBufferGetPresentationTimeStamp(sample), IJK_CLIP_TIMESCALE, kCMTimeRoundingMethod_Default);
+        pkt.pts = pkt.dts = pts.value;
+        CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sample, false);
+        CFDictionaryRef first  = attachments && CFArrayGetCount(attachments) > 0 ? CFArrayGetValueAtIndex(attachments, 0) : NULL;
+        CFBooleanRef notSync   = first ? CFDictionaryGetValue(first, kCMSampleAttachmentKey_NotSync) : NULL;
+        if (!notSync || !CFBooleanGetValue(notSync))
+            pkt.flags |= AV_PKT_FLAG_KEY;
+        pkt.stream_index = _outVideoIndex;
+        av_packet_rescale_ts(&pkt, (AVRational){ 1, IJK_CLIP_TIMESCALE }, _outContext->streams[_outVideoIndex]->time_base);
+
+        if ((ret = av_interleaved_write_frame(_outContext, &pkt)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+// as read, its time moved to the start of the range
+- (int)writeAudioPacket:(AVPacket *)pkt
+{
+    if (!_headerWritten) {
+        if (_nbHeldPackets >= IJK_CLIP_MAX_HELD_PACKETS)
+            return 0;
+        if (!(_heldPackets[_nbHeldPackets] = av_packet_clone(pkt)))
+            return AVERROR(ENOMEM);
+        _nbHeldPackets++;
+        return 0;
+    }
+
+    AVRational tb     = _inContext->streams[_audioStreamIndex]->time_base;
+    int64_t    offset = av_rescale_q(_startPts, _videoTimeBase, tb);
+    AVPacket   out;
+    int        ret = av_packet_ref(&out, pkt);
+    if (ret < 0)
+        return ret;
+    out.pts         -= offset;
+    if (out.dts != AV_NOPTS_VALUE)
+        out.dts     -= offset;
+    out.pos          = -1;
+    out.stream_index = _outAudioIndex;
+    av_packet_rescale_ts(&out, tb, _outContext->streams[_outAudioIndex]->time_base);
+    return av_interleaved_write_frame(_outContext, &out);
+}
+
+@end
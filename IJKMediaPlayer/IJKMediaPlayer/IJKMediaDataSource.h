@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+// Media bytes the app holds in memory, decrypted or assembled from peers,
+// played without a temporary file or a local http server.
+@protocol IJKMediaDataSource <NSObject>
+
+// The bytes from offset on, as many as are at hand, called on the read
+// thread of the player. They are read in place: wrap the app's buffer with
+// -[NSData initWithBytesNoCopy:length:deallocator:], it is released once
+// the player is past it, and must not change meanwhile.
+// Return an empty NSData at the end of the media, nil with *error set on
+// failure, and nil without an error if the bytes are not there yet; the
+// player then waits for -[IJKMediaDataSourceLink dataAvailable].
+- (NSData *)dataAtOffset:(int64_t)offset error:(NSError **)error;
+
+@optional
+// total size in bytes, -1 if unknown; seeking from the end needs it
+- (int64_t)contentLength;
+
+@end
+
+// Makes a data source reachable by players as a url, see
+// -[IJKFFMoviePlayerController initWithMediaDataSource:withOptions:].
+// The source is retained until the link and the players reading it are gone.
+@interface IJKMediaDataSourceLink : NSObject
+
+- (instancetype)initWithDataSource:(id<IJKMediaDataSource>)dataSource;
+
+@property(nonatomic, readonly) id<IJKMediaDataSource> dataSource;
+@property(nonatomic, readonly) NSString *urlString;
+
+// the bytes a read was waiting for are there; any thread
+- (void)dataAvailable;
+
+@end
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaDataSource.h"
+#include "libavformat/mediadatasource.h"
+#include "libavutil/error.h"
+
+static int ijkmds_read(void *opaque, int64_t pos, const uint8_t **data, void **token)
+{
+    @autoreleasepool {
+        id<IJKMediaDataSource> source = (__bridge id<IJKMediaDataSource>)opaque;
+        NSError *error = nil;
+        NSData  *bytes = [source dataAtOffset:pos error:&error];
+
+        if (!bytes) {
+            if (!error)
+                return AVERROR(EAGAIN);
+            if ([error.domain isEqualToString:NSPOSIXErrorDomain] && error.code > 0)
+                return AVERROR((int)error.code);
+            return AVERROR(EIO);
+        }
+        if (bytes.length == 0)
+            return 0;
+
+        // kept alive while the protocol reads from it
+        *data  = bytes.bytes;
+        *token = (void *)CFBridgingRetain(bytes);
+        return (int)MIN(bytes.length, (NSUInteger)INT_MAX);
+    }
+}
+
+static void ijkmds_release(void *opaque, const uint8_t *data, void *token)
+{
+    if (token)
+        CFRelease(token);
+}
+
+static int64_t ijkmds_size(void *opaque)
+{
+    id<IJKMediaDataSource> source = (__bridge id<IJKMediaDataSource>)opaque;
+
+    if (![source respondsToSelector:@selector(contentLength)])
+        return -1;
+    return [source contentLength];
+}
+
+static void ijkmds_close(void *opaque)
+{
+    CFBridgingRelease(opaque);
+}
+
+static const AVMediaDataSourceCallbacks ijkmds_callbacks = {
+    .read    = ijkmds_read,
+    .release = ijkmds_release,
+    .size    = ijkmds_size,
+    .close   = ijkmds_close,
+};
+
+@implementation IJKMediaDataSourceLink {
+    AVMediaDataSource *_source;
+}
+
+- (instancetype)initWithDataSource:(id<IJKMediaDataSource>)dataSource
+{
+    if (dataSource == nil)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        char url[64];
+
+        _dataSource = dataSource;
+        _source = av_media_data_source_create(&ijkmds_callbacks, (void *)CFBridgingRetain(dataSource));
+        if (!_source) {
+            CFRelease((__bridge CFTypeRef)dataSource);
+            return nil;
+        }
+        av_media_data_source_url(_source, url, sizeof(url));
+        _urlString = [NSString stringWithUTF8String:url];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    av_media_data_source_release(&_source);
+}
+
+- (void)dataAvailable
+{
+    av_media_data_source_ready(_source);
+}
+
+@end
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+@class IJKFFOptions;
+
+extern NSString *const IJKMediaDownloaderErrorDomain;
+
+typedef struct IJKMediaDownloadProgress {
+    int             bitRate;        // of the variant downloaded
+    int             files;          // segments, keys and initialization sections
+    int             filesDone;
+    int64_t         bytes;          // resumed ones included
+    int64_t         bytesFromCache;
+    NSTimeInterval  duration;       // of the segments done
+    NSTimeInterval  totalDuration;
+} IJKMediaDownloadProgress;
+
+typedef void (^IJKMediaDownloadProgressHandler)(IJKMediaDownloadProgress progress);
+// playlistPath is the local playlist once every file is in, nil on error;
+// the code of error is an FFmpeg error in IJKMediaDownloaderErrorDomain,
+// or NSUserCancelledError in NSCocoaErrorDomain
+typedef void (^IJKMediaDownloadCompletionHandler)(NSString *playlistPath, NSError *error);
+
+// Downloads HLS streams into directories for offline playback, one stream
+// at a time, in the order queued. The variant of the highest bit rate up
+// to the one asked for is chosen, with its audio rendition; its segments
+// are fetched several at once, through the http connection pool, and from
+// the disk cache when it has them whole.
+//
+// A cancelled or failed download leaves its files behind: queuing the same
+// url to the same directory again resumes the partial ones and skips the
+// complete ones. While a player is playing, the download goes on at
+// throttledBytesPerSecond over a single request.
+//
+// The local playlist plays with the options the players are created with;
+// [options setFormatOptionIntValue:1 forKey:@"mmap"] maps the segments
+// instead of reading them.
+@interface IJKMediaDownloader : NSObject
+
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithOptions:(IJKFFOptions *)options;
+
+// requests in flight at once, 4 by default, and to the same host, 2 by default
+@property(atomic) int maxConnections;
+@property(atomic) int maxConnectionsPerHost;
+// YES by default
+@property(atomic) BOOL throttlesDuringPlayback;
+// 256 KiB by default
+@property(atomic) int64_t throttledBytesPerSecond;
+
+// maxBitRate: bits per second, 0 for the highest variant; the handlers are
+// called on the main queue, progress twice a second; does nothing if url is
+// already queued
+- (void)downloadURL:(NSURL *)aUrl
+        toDirectory:(NSString *)directory
+         maxBitRate:(int)maxBitRate
+           progress:(IJKMediaDownloadProgressHandler)progress
+         completion:(IJKMediaDownloadCompletionHandler)completion;
+
+- (void)cancelDownloadForURL:(NSURL *)aUrl;
+- (void)cancelAll;
+
+@end
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaDownloader.h"
+#import <UIKit/UIKit.h>
+#import "IJKFFOptions.h"
+#import "IJKFFMoviePlayerController.h"
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+#include "libavformat/hls_download.h"
+
+#define IJK_DOWNLOAD_PROGRESS_INTERVAL  (500 * NSEC_PER_MSEC)
+
+NSString *const IJKMediaDownloaderErrorDomain = @"IJKMediaDownloader";
+
+@interface IJKMediaDownloadTask : NSObject
+{
+@public
+    volatile int   _abortRequest;
+    AVHLSDownload *_download;       // while it runs, under @synchronized (self)
+}
+
+@property(nonatomic, copy) NSString *key;
+@property(nonatomic, copy) NSString *directory;
+@property(nonatomic) int maxBitRate;
+@property(nonatomic) int maxConnections;
+@property(nonatomic) int maxConnectionsPerHost;
+@property(nonatomic, copy) IJKMediaDownloadProgressHandler progress;
+@property(nonatomic, copy) IJKMediaDownloadCompletionHandler completion;
+
+- (void)setRate:(int64_t)rate;
+- (void)reportProgress;
+
+@end
+
+@implementation IJKMediaDownloadTask
+
+- (void)setRate:(int64_t)rate
+{
+    @synchronized (self) {
+        if (_download)
+            av_hls_download_set_rate(_download, rate);
+    }
+}
+
+- (void)reportProgress
+{
+    AVHLSDownloadProgress p;
+
+    @synchronized (self) {
+        if (!_download)
+            return;
+        av_hls_download_get_progress(_download, &p);
+    }
+
+    IJKMediaDownloadProgress progress;
+    progress.bitRate        = p.bandwidth;
+    progress.files          = p.nb_files;
+    progress.filesDone      = p.nb_done;
+    progress.bytes          = p.bytes;
+    progress.bytesFromCache = p.bytes_cached;
+    progress.duration       = (double)p.duration / AV_TIME_BASE;
+    progress.totalDuration  = (double)p.total_duration / AV_TIME_BASE;
+    if (self.progress)
+        self.progress(progress);
+}
+
+@end
+
+static int ijkdownload_interrupt_cb(void *opaque)
+{
+    IJKMediaDownloadTask *task = (__bridge IJKMediaDownloadTask *)opaque;
+    return task->_abortRequest;
+}
+
+@implementation IJKMediaDownloader {
+    dispatch_queue_t      _queue;
+    AVDictionary         *_formatOptions;
+    NSMutableDictionary  *_tasks;       // queued or running, by url
+    IJKMediaDownloadTask *_runningTask; // under @synchronized (_tasks)
+    NSHashTable          *_playingPlayers;
+}
+
+- (instancetype)initWithOptions:(IJKFFOptions *)options
+{
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.downloader", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+        _tasks          = [[NSMutableDictionary alloc] init];
+        _playingPlayers = [NSHashTable weakObjectsHashTable];
+
+        _maxConnections          = 4;
+        _maxConnectionsPerHost   = 2;
+        _throttlesDuringPlayback = YES;
+        _throttledBytesPerSecond = 256 * 1024;
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        ijkmp_global_init();
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(playbackStateDidChange:)
+                                                     name:IJKMPMoviePlayerPlaybackStateDidChangeNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(playbackDidFinish:)
+                                                     name:IJKMPMoviePlayerPlaybackDidFinishNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self cancelAll];
+    // the blocks still queued use the options, free them after the last one
+    AVDictionary *formatOptions = _formatOptions;
+    dispatch_async(_queue, ^{
+        AVDictionary *options = formatOptions;
+        av_dict_free(&options);
+    });
+}
+
+#pragma mark throttling
+
+// posted on the main thread
+- (void)playbackStateDidChange:(NSNotification *)notification
+{
+    id player = notification.object;
+    BOOL playing = [player conformsToProtocol:@protocol(IJKMediaPlayback)] &&
+                   ((id<IJKMediaPlayback>)player).playbackState == IJKMPMoviePlaybackStatePlaying;
+
+    @synchronized (_playingPlayers) {
+        if (playing)
+            [_playingPlayers addObject:player];
+        else
+            [_playingPlayers removeObject:player];
+    }
+    [self updateRate];
+}
+
+- (void)playbackDidFinish:(NSNotification *)notification
+{
+    @synchronized (_playingPlayers) {
+        [_playingPlayers removeObject:notification.object];
+    }
+    [self updateRate];
+}
+
+- (int64_t)currentRate
+{
+    BOOL playing;
+
+    @synchronized (_playingPlayers) {
+        playing = _playingPlayers.allObjects.count > 0;
+    }
+    return playing && self.throttlesDuringPlayback ? MAX(self.throttledBytesPerSecond, 1) : 0;
+}
+
+- (void)updateRate
+{
+    IJKMediaDownloadTask *task;
+
+    @synchronized (_tasks) {
+        task = _runningTask;
+    }
+    [task setRate:[self currentRate]];
+}
+
+- (void)taskDidStart:(IJKMediaDownloadTask *)task
+{
+    @synchronized (_tasks) {
+        _runningTask = task;
+    }
+    [task setRate:[self currentRate]];
+}
+
+- (void)taskDidEnd:(IJKMediaDownloadTask *)task
+{
+    @synchronized (_tasks) {
+        if (_runningTask == task)
+            _runningTask = nil;
+        if (_tasks[task.key] == task)
+            [_tasks removeObjectForKey:task.key];
+    }
+}
+
+#pragma mark downloads
+
+- (void)downloadURL:(NSURL *)aUrl
+        toDirectory:(NSString *)directory
+         maxBitRate:(int)maxBitRate
+           progress:(IJKMediaDownloadProgressHandler)progress
+         completion:(IJKMediaDownloadCompletionHandler)completion
+{
+    NSString *key = aUrl.absoluteString;
+    if (key.length == 0 || directory.length == 0)
+        return;
+
+    IJKMediaDownloadTask *task = [[IJKMediaDownloadTask alloc] init];
+    task.key                   = key;
+    task.directory             = directory;
+    task.maxBitRate            = maxBitRate;
+    task.maxConnections        = self.maxConnections;
+    task.maxConnectionsPerHost = self.maxConnectionsPerHost;
+    task.progress              = progress;
+    task.completion            = completion;
+
+    @synchronized (_tasks) {
+        if (_tasks[key])
+            return;
+        _tasks[key] = task;
+    }
+
+    [IJKFFMoviePlayerController prefetchDNSForURL:aUrl];
+
+    // the queue does not keep the downloader alive, releasing it cancels
+    __weak IJKMediaDownloader *weakSelf = self;
+    AVDictionary *formatOptions = _formatOptions;
+    dispatch_async(_queue, ^{
+        UIBackgroundTaskIdentifier backgroundTask = UIBackgroundTaskInvalid;
+        NSString *playlistPath = nil;
+        NSError  *error        = nil;
+        int       ret          = AVERROR_EXIT;
+
+        if (!task->_abortRequest) {
+            AVIOInterruptCB int_cb = { ijkdownload_interrupt_cb, (__bridge void *)task };
+            AVHLSDownload *download = NULL;
+
+            // an expired download resumes when queued again
+            backgroundTask = [[UIApplication sharedApplication] beginBackgroundTaskWithName:@"IJKMediaDownloader" expirationHandler:^{
+                task->_abortRequest = 1;
+            }];
+
+            ret = av_hls_download_open(&download, task.key.UTF8String, task.directory.UTF8String,
+                                       task.maxBitRate, formatOptions, &int_cb);
+            if (ret >= 0) {
+                @synchronized (task) {
+                    task->_download = download;
+                }
+                [weakSelf taskDidStart:task];
+
+                dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+                dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, IJK_DOWNLOAD_PROGRESS_INTERVAL),
+                                          IJK_DOWNLOAD_PROGRESS_INTERVAL, IJK_DOWNLOAD_PROGRESS_INTERVAL / 5);
+                dispatch_source_set_event_handler(timer, ^{
+                    [task reportProgress];
+                });
+                dispatch_resume(timer);
+
+                ret = av_hls_download_run(download, task.maxConnections, task.maxConnectionsPerHost);
+
+                dispatch_source_cancel(timer);
+                @synchronized (task) {
+                    task->_download = NULL;
+                }
+                av_hls_download_close(&download);
+            }
+        }
+        [weakSelf taskDidEnd:task];
+
+        if (ret >= 0) {
+            playlistPath = [task.directory stringByAppendingPathComponent:@(AV_HLS_DOWNLOAD_PLAYLIST)];
+        } else if (ret == AVERROR_EXIT && task->_abortRequest) {
+            error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil];
+        } else {
+            error = [NSError errorWithDomain:IJKMediaDownloaderErrorDomain
+                                        code:ret
+                                    userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithUTF8String:av_err2str(ret)]}];
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (task.completion)
+                task.completion(playlistPath, error);
+            if (backgroundTask != UIBackgroundTaskInvalid)
+                [[UIApplication sharedApplication] endBackgroundTask:backgroundTask];
+        });
+    });
+}
+
+- (void)cancelDownloadForURL:(NSURL *)aUrl
+{
+    NSString *key = aUrl.absoluteString;
+    if (key.length == 0)
+        return;
+
+    @synchronized (_tasks) {
+        IJKMediaDownloadTask *task = _tasks[key];
+        if (task) {
+            task->_abortRequest = 1;
+            [_tasks removeObjectForKey:key];
+        }
+    }
+}
+
+- (void)cancelAll
+{
+    @synchronized (_tasks) {
+        [_tasks enumerateKeysAndObjectsUsingBlock:^(id key, IJKMediaDownloadTask *task, BOOL *stop) {
+            task->_abortRequest = 1;
+        }];
+        [_tasks removeAllObjects];
+    }
+}
+
+@end
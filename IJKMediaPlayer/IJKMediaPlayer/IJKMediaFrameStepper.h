@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreVideo/CoreVideo.h>
+
+@class IJKFFOptions;
+
+// pixelBuffer is NULL past either end of the media, on failure or when the
+// request was cancelled; it is valid for the call, retain it to keep it
+typedef void (^IJKMediaFrameStepHandler)(CVPixelBufferRef pixelBuffer, NSTimeInterval time);
+
+// Steps a url frame by frame, forward and backward, apart from any player:
+// a demuxer and a decoder of its own on a serial queue, as the thumbnailer.
+//
+// Whole GOPs are decoded at once, from a key frame up to the next one, and
+// kept as IOSurface backed NV12 pixel buffers in presentation order, so that
+// stepping within a GOP costs no decoding, and stepping backward across one
+// decodes the previous GOP once instead of once per frame. Stepping forward
+// across a GOP reads on without a seek. The GOPs farthest from the frame
+// stepped to are dropped once memoryBudget is exceeded; the GOP before is
+// decoded ahead while stepping backward near the start of one.
+@interface IJKMediaFrameStepper : NSObject
+
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options;
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options;
+
+// bytes of decoded frames kept, 192 MB by default; the GOP stepped in is
+// kept whatever its size
+@property(atomic) size_t memoryBudget;
+
+// handlers are called on the main thread, in the order of the requests
+
+// the frame on screen at time
+- (void)moveToTime:(NSTimeInterval)time handler:(IJKMediaFrameStepHandler)handler;
+// frames after the last one moved or stepped to, before it if negative
+- (void)stepBy:(NSInteger)frames handler:(IJKMediaFrameStepHandler)handler;
+
+// pending handlers are called with a NULL pixelBuffer
+- (void)cancelAll;
+
+@end
@@ -0,0 +1,866 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaFrameStepper.h"
+#import "IJKFFOptions.h"
+#import <UIKit/UIKit.h>
+#import <VideoToolbox/VideoToolbox.h>
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "ijksdl/ios/ijksdl_vout_overlay_videotoolbox.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavcodec/slice_pool.h"
+#include "libswscale/swscale.h"
+
+#define IJK_STEP_DEFAULT_BUDGET     (192 * 1024 * 1024)
+// a GOP keeps this share of the budget at most: the one stepped in and
+// both of its neighbours fit
+#define IJK_STEP_GOP_SHARE          3
+// stepping backward this close to the start of a GOP decodes the one before
+#define IJK_STEP_PREFETCH_FRAMES    8
+// reading gives up there looking for a key frame
+#define IJK_STEP_MAX_PACKETS        600
+
+static size_t ijkstep_pixel_buffer_bytes(CVPixelBufferRef pixelBuffer)
+{
+    size_t planes = CVPixelBufferGetPlaneCount(pixelBuffer);
+    if (planes == 0)
+        return CVPixelBufferGetDataSize(pixelBuffer);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < planes; ++i)
+        bytes += CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, i) * CVPixelBufferGetHeightOfPlane(pixelBuffer, i);
+    return bytes;
+}
+
+static int64_t ijkstep_packet_pts(const AVPacket *pkt)
+{
+    return pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+}
+
+@interface IJKFrameStepFrame : NSObject {
+@public
+    CVPixelBufferRef _pixelBuffer;
+    int64_t          _pts;
+    size_t           _bytes;
+}
+@end
+
+@implementation IJKFrameStepFrame
+
+- (void)dealloc
+{
+    CVPixelBufferRelease(_pixelBuffer);
+}
+
+@end
+
+// The frames decoded from a key frame, in [_coverStart, _coverEnd): a whole
+// GOP, or the part of a long one which fits in its budget. The frame on
+// screen at any pts in that range is in _frames, sorted by pts.
+@interface IJKFrameStepGOP : NSObject {
+@public
+    int64_t         _keyPts;
+    int64_t         _coverStart;
+    int64_t         _coverEnd;          // INT64_MAX up to the end of the media
+    BOOL            _reachesStart;      // no frame before it, known once looked for
+    NSMutableArray<IJKFrameStepFrame *> *_frames;
+    size_t          _bytes;
+
+    // while decoding: frames out of [_from, _until) are not kept, and the
+    // oldest ones are dropped over budget as long as they are before _anchor
+    int64_t         _from;
+    int64_t         _until;
+    int64_t         _anchor;
+    size_t          _budget;
+    int64_t         _droppedThrough;
+}
+@end
+
+@implementation IJKFrameStepGOP
+
+- (instancetype)initWithKeyPts:(int64_t)keyPts
+                          from:(int64_t)from
+                         until:(int64_t)until
+                        anchor:(int64_t)anchor
+                        budget:(size_t)budget
+{
+    self = [super init];
+    if (self) {
+        _keyPts         = keyPts;
+        _from           = from;
+        _until          = until;
+        _anchor         = anchor;
+        _budget         = budget;
+        _droppedThrough = INT64_MIN;
+        _frames         = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (BOOL)wantsPts:(int64_t)pts
+{
+    // the leading pictures of an open GOP are shown before its key frame,
+    // they belong to the GOP before
+    return pts != AV_NOPTS_VALUE && pts >= _keyPts && pts >= _from && pts < _until && pts > _droppedThrough;
+}
+
+- (void)addPixelBuffer:(CVPixelBufferRef)pixelBuffer pts:(int64_t)pts
+{
+    if (![self wantsPts:pts])
+        return;
+
+    IJKFrameStepFrame *frame = [[IJKFrameStepFrame alloc] init];
+    frame->_pixelBuffer = CVPixelBufferRetain(pixelBuffer);
+    frame->_pts         = pts;
+    frame->_bytes       = ijkstep_pixel_buffer_bytes(pixelBuffer);
+
+    // VideoToolbox outputs in decode order
+    NSUInteger index = _frames.count;
+    while (index > 0 && _frames[index - 1]->_pts > pts)
+        --index;
+    [_frames insertObject:frame atIndex:index];
+    _bytes += frame->_bytes;
+
+    while (_bytes > _budget && _frames.count > 1 && _frames[0]->_pts < _anchor) {
+        _droppedThrough = _frames[0]->_pts;
+        _bytes -= _frames[0]->_bytes;
+        [_frames removeObjectAtIndex:0];
+    }
+}
+
+- (BOOL)isFull
+{
+    return _bytes > _budget;
+}
+
+// end: the frames from it on may miss some, not decoded yet
+- (void)finishAt:(int64_t)end
+{
+    while (_frames.count > 0 && _frames.lastObject->_pts >= end) {
+        _bytes -= _frames.lastObject->_bytes;
+        [_frames removeLastObject];
+    }
+    _coverStart = _droppedThrough != INT64_MIN ? _droppedThrough + 1 : MAX(_from, _keyPts);
+    _coverEnd   = MIN(end, _until);
+}
+
+- (BOOL)coversPts:(int64_t)pts
+{
+    return pts >= _coverStart && pts < _coverEnd;
+}
+
+// the frame on screen at pts
+- (NSInteger)indexAtPts:(int64_t)pts
+{
+    NSInteger index = 0;
+    while (index + 1 < (NSInteger)_frames.count && _frames[index + 1]->_pts <= pts)
+        ++index;
+    return index;
+}
+
+@end
+
+static void ijkstep_vtb_output(void *decompressionOutputRefCon, void *sourceFrameRefCon,
+                               OSStatus status, VTDecodeInfoFlags infoFlags,
+                               CVImageBufferRef imageBuffer, CMTime presentationTimeStamp,
+                               CMTime presentationDuration)
+{
+    IJKFrameStepGOP *gop = (__bridge IJKFrameStepGOP *)sourceFrameRefCon;
+    if (status == noErr && imageBuffer && CMTIME_IS_NUMERIC(presentationTimeStamp))
+        [gop addPixelBuffer:imageBuffer pts:presentationTimeStamp.value];
+}
+
+@implementation IJKMediaFrameStepper {
+    dispatch_queue_t     _queue;
+    NSString            *_urlString;
+    AVDictionary        *_formatOptions;
+
+    volatile int         _generation;           // bumped by cancelAll
+    volatile int         _runningGeneration;    // of the request on the queue
+
+    // owned by the queue
+    AVFormatContext     *_formatContext;
+    int                  _videoStreamIndex;
+    AVCodecContext      *_codecContext;
+    AVRational           _timeBase;             // of the video stream, kept once closed
+    int64_t              _startPts;
+    AVPacket             _pendingKey;           // read past the GOP decoded last
+    BOOL                 _hasPendingKey;
+    struct SwsContext   *_swsContext;
+    AVFrame             *_convertedFrame;
+    SDL_VoutOverlay     *_overlay;              // copies software frames to pixel buffers
+
+    VTDecompressionSessionRef   _vtbSession;
+    CMVideoFormatDescriptionRef _vtbFormat;
+    BOOL                        _vtbUnsupported;
+
+    NSMutableArray<IJKFrameStepGOP *> *_gops;
+    IJKFrameStepGOP     *_cursorGOP;
+    NSInteger            _cursorIndex;
+}
+
+@synthesize memoryBudget = _memoryBudget;
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options
+{
+    if (aUrl == nil)
+        return nil;
+
+    return [self initWithContentURLString:[aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString]
+                                  options:options];
+}
+
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options
+{
+    if (aUrlString.length == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        // the user waits on every step
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.framestepper", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0));
+        _urlString        = [aUrlString copy];
+        _videoStreamIndex = -1;
+        _memoryBudget     = IJK_STEP_DEFAULT_BUDGET;
+        _gops             = [NSMutableArray array];
+        av_init_packet(&_pendingKey);
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        ijkmp_global_init();
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationDidReceiveMemoryWarning)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    // queued blocks retain self, none is left
+    [self close];
+    sws_freeContext(_swsContext);
+    av_frame_free(&_convertedFrame);
+    if (_overlay)
+        SDL_VoutFreeYUVOverlay(_overlay);
+    av_dict_free(&_formatOptions);
+}
+
+- (void)applicationDidReceiveMemoryWarning
+{
+    dispatch_async(_queue, ^{
+        [_gops removeAllObjects];
+        if (_cursorGOP)
+            [_gops addObject:_cursorGOP];
+    });
+}
+
+#pragma mark requests
+
+- (void)moveToTime:(NSTimeInterval)time handler:(IJKMediaFrameStepHandler)handler
+{
+    [self enqueue:handler prefetchesBackward:NO request:^IJKFrameStepFrame *{
+        return [self frameAtTime:time];
+    }];
+}
+
+- (void)stepBy:(NSInteger)frames handler:(IJKMediaFrameStepHandler)handler
+{
+    [self enqueue:handler prefetchesBackward:frames < 0 request:^IJKFrameStepFrame *{
+        return [self frameSteppedBy:frames];
+    }];
+}
+
+- (void)enqueue:(IJKMediaFrameStepHandler)handler
+prefetchesBackward:(BOOL)prefetchesBackward
+        request:(IJKFrameStepFrame *(^)(void))request
+{
+    if (!handler)
+        return;
+
+    IJKMediaFrameStepHandler block = [handler copy];
+    int generation = _generation;
+    dispatch_async(_queue, ^{
+        IJKFrameStepFrame *frame = nil;
+        NSTimeInterval time = -1;
+        if (generation == _generation) {
+            _runningGeneration = generation;
+            @autoreleasepool {
+                frame = request();
+            }
+            if (frame)
+                time = [self timeForPts:frame->_pts];
+        }
+
+        // the frame keeps its pixel buffer alive up to the handler
+        dispatch_async(dispatch_get_main_queue(), ^{
+            block(frame ? frame->_pixelBuffer : NULL, time);
+        });
+
+        // after the handler, the next requests wait for it on the queue
+        if (frame && prefetchesBackward && generation == _generation) {
+            @autoreleasepool {
+                [self prefetchBackward];
+            }
+        }
+    });
+}
+
+- (void)cancelAll
+{
+    __sync_add_and_fetch(&_generation, 1);
+}
+
+- (BOOL)isCancelled
+{
+    return _runningGeneration != _generation;
+}
+
+#pragma mark cursor and cache, on the queue
+
+- (NSTimeInterval)timeForPts:(int64_t)pts
+{
+    return (pts - _startPts) * av_q2d(_timeBase);
+}
+
+- (IJKFrameStepFrame *)frameAtTime:(NSTimeInterval)time
+{
+    if (![self openIfNeeded])
+        return nil;
+
+    int64_t target = _startPts + (int64_t)(MAX(time, 0) / av_q2d(_timeBase));
+    IJKFrameStepGOP *gop = [self gopAtPts:target anchor:target];
+    if (!gop)
+        return nil;
+
+    return [self moveCursorTo:gop index:[gop indexAtPts:target]];
+}
+
+- (IJKFrameStepFrame *)frameSteppedBy:(NSInteger)frames
+{
+    IJKFrameStepGOP *gop   = _cursorGOP;
+    NSInteger        index = _cursorIndex + frames;
+    if (!gop)
+        return nil;
+
+    while (index >= (NSInteger)gop->_frames.count) {
+        IJKFrameStepGOP *next = [self gopAfter:gop];
+        if (!next)
+            return nil;
+        index -= gop->_frames.count;
+        gop    = next;
+    }
+    while (index < 0) {
+        IJKFrameStepGOP *previous = [self gopBefore:gop];
+        if (!previous)
+            return nil;
+        index += previous->_frames.count;
+        gop    = previous;
+    }
+    return [self moveCursorTo:gop index:index];
+}
+
+- (IJKFrameStepFrame *)moveCursorTo:(IJKFrameStepGOP *)gop index:(NSInteger)index
+{
+    _cursorGOP   = gop;
+    _cursorIndex = index;
+    [self evict];
+    return gop->_frames[index];
+}
+
+- (IJKFrameStepGOP *)gopAfter:(IJKFrameStepGOP *)gop
+{
+    if (gop->_coverEnd == INT64_MAX)
+        return nil;
+    return [self gopAtPts:gop->_coverEnd anchor:gop->_coverEnd];
+}
+
+- (IJKFrameStepGOP *)gopBefore:(IJKFrameStepGOP *)gop
+{
+    if (gop->_reachesStart)
+        return nil;
+
+    // the latest frames are kept, the ones next to gop
+    IJKFrameStepGOP *previous = [self gopAtPts:gop->_coverStart - 1 anchor:INT64_MAX];
+    // not on a cancel or a network error, which close the demuxer
+    if (!previous && ![self isCancelled] && _formatContext)
+        gop->_reachesStart = YES;
+    return previous;
+}
+
+- (void)prefetchBackward
+{
+    IJKFrameStepGOP *gop = _cursorGOP;
+    if (!gop || _cursorIndex >= IJK_STEP_PREFETCH_FRAMES || gop->_reachesStart)
+        return;
+
+    for (IJKFrameStepGOP *cached in _gops) {
+        if ([cached coversPts:gop->_coverStart - 1])
+            return;
+    }
+    [self gopBefore:gop];
+}
+
+// the cached GOP covering pts, or the one decoded for it; its frames fill
+// the gap between the cached neighbours, not more
+- (IJKFrameStepGOP *)gopAtPts:(int64_t)pts anchor:(int64_t)anchor
+{
+    int64_t from  = INT64_MIN;
+    int64_t until = INT64_MAX;
+    for (IJKFrameStepGOP *cached in _gops) {
+        if ([cached coversPts:pts])
+            return cached;
+        if (cached->_coverEnd <= pts)
+            from = MAX(from, cached->_coverEnd);
+        else if (cached->_coverStart > pts)
+            until = MIN(until, cached->_coverStart);
+    }
+
+    IJKFrameStepGOP *gop = [self decodeGOPAtPts:pts from:from until:until anchor:anchor softwareOnly:NO];
+    if (gop)
+        [_gops addObject:gop];
+    return gop;
+}
+
+// the GOPs farthest from the cursor go first
+- (void)evict
+{
+    size_t budget = self.memoryBudget;
+    size_t bytes  = 0;
+    for (IJKFrameStepGOP *gop in _gops)
+        bytes += gop->_bytes;
+
+    while (bytes > budget) {
+        IJKFrameStepGOP *farthest = nil;
+        uint64_t         distance = 0;
+        for (IJKFrameStepGOP *gop in _gops) {
+            if (gop == _cursorGOP)
+                continue;
+            uint64_t d = gop->_coverStart > _cursorGOP->_coverStart ?
+                         (uint64_t)gop->_coverStart - _cursorGOP->_coverStart :
+                         (uint64_t)_cursorGOP->_coverStart - gop->_coverStart;
+            if (!farthest || d > distance) {
+                farthest = gop;
+                distance = d;
+            }
+        }
+        if (!farthest)
+            break;
+        bytes -= farthest->_bytes;
+        [_gops removeObject:farthest];
+    }
+}
+
+#pragma mark demuxer and decoders, on the queue
+
+static int ijkstep_interrupt_cb(void *opaque)
+{
+    IJKMediaFrameStepper *stepper = (__bridge IJKMediaFrameStepper *)opaque;
+    return stepper->_runningGeneration != stepper->_generation;
+}
+
+// one client for every stepper, in the foreground: the user waits on it
+static int stepper_slice_pool_client(void)
+{
+    static int             client;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        client = av_slice_pool_client_open();
+        av_slice_pool_client_set_priority(client, AV_SLICE_POOL_FOREGROUND);
+    });
+    return client;
+}
+
+- (BOOL)openIfNeeded
+{
+    if (_formatContext)
+        return YES;
+
+    AVFormatContext *ic = avformat_alloc_context();
+    if (!ic)
+        return NO;
+    ic->interrupt_callback.callback = ijkstep_interrupt_cb;
+    ic->interrupt_callback.opaque   = (__bridge void *)self;
+
+    AVDictionary *options = NULL;
+    av_dict_copy(&options, _formatOptions, 0);
+    int ret = avformat_open_input(&ic, _urlString.UTF8String, NULL, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        NSLog(@"IJKMediaFrameStepper: failed to open %@: %d\n", _urlString, ret);
+        return NO;
+    }
+
+    AVCodecContext *avctx = NULL;
+    ret = avformat_find_stream_info(ic, NULL);
+    int index = ret < 0 ? ret : av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (index < 0)
+        goto fail;
+
+    for (unsigned int i = 0; i < ic->nb_streams; ++i)
+        ic->streams[i]->discard = (int)i == index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    AVCodecParameters *par = ic->streams[index]->codecpar;
+    AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if (!codec || !(avctx = avcodec_alloc_context3(codec)))
+        goto fail;
+    if (avcodec_parameters_to_context(avctx, par) < 0)
+        goto fail;
+    // the whole GOP is drained at once, frame threads would add nothing
+    avctx->thread_type = FF_THREAD_SLICE;
+    avctx->thread_count = 0;
+    avctx->thread_pool = stepper_slice_pool_client();
+    if (avcodec_open2(avctx, codec, NULL) < 0)
+        goto fail;
+
+    _formatContext    = ic;
+    _videoStreamIndex = index;
+    _codecContext     = avctx;
+    _timeBase         = ic->streams[index]->time_base;
+    _startPts         = ic->start_time != AV_NOPTS_VALUE ? av_rescale_q(ic->start_time, AV_TIME_BASE_Q, _timeBase) : 0;
+    return YES;
+
+fail:
+    NSLog(@"IJKMediaFrameStepper: no video to decode in %@\n", _urlString);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return NO;
+}
+
+// the cached frames stay, their pts do not depend on the demuxer
+- (void)close
+{
+    [self dropPendingKey];
+    [self closeVideoToolbox];
+    avcodec_free_context(&_codecContext);
+    avformat_close_input(&_formatContext);
+}
+
+- (void)dropPendingKey
+{
+    if (_hasPendingKey)
+        av_packet_unref(&_pendingKey);
+    _hasPendingKey = NO;
+}
+
+- (BOOL)openVideoToolbox
+{
+    if (_vtbSession)
+        return YES;
+    if (_vtbUnsupported)
+        return NO;
+
+    AVCodecParameters *par = _formatContext->streams[_videoStreamIndex]->codecpar;
+    CMVideoCodecType codecType = 0;
+    NSString *atom = nil;
+    if (par->codec_id == AV_CODEC_ID_H264) {
+        codecType = kCMVideoCodecType_H264;
+        atom      = @"avcC";
+    }
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (par->codec_id == AV_CODEC_ID_HEVC) {
+        if (@available(iOS 11.0, *)) {
+            if (VTIsHardwareDecodeSupported(kCMVideoCodecType_HEVC)) {
+                codecType = kCMVideoCodecType_HEVC;
+                atom      = @"hvcC";
+            }
+        }
+    }
+#endif
+    // annex b streams, e.g. mpegts, have no avcC/hvcC to describe them with
+    if (!atom || par->extradata_size < 7 || par->extradata[0] != 1) {
+        _vtbUnsupported = YES;
+        return NO;
+    }
+
+    NSDictionary *extensions = @{
+        (id)kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms: @{
+            atom: [NSData dataWithBytes:par->extradata length:par->extradata_size],
+        },
+    };
+    OSStatus status = CMVideoFormatDescriptionCreate(kCFAllocatorDefault, codecType, par->width, par->height,
+                                                     (__bridge CFDictionaryRef)extensions, &_vtbFormat);
+    if (status != noErr) {
+        _vtbUnsupported = YES;
+        return NO;
+    }
+
+    NSDictionary *attributes = @{
+        (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+        (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+    };
+    VTDecompressionOutputCallbackRecord callback = { ijkstep_vtb_output, NULL };
+    status = VTDecompressionSessionCreate(kCFAllocatorDefault, _vtbFormat, NULL,
+                                          (__bridge CFDictionaryRef)attributes, &callback, &_vtbSession);
+    if (status != noErr) {
+        NSLog(@"IJKMediaFrameStepper: VTDecompressionSessionCreate failed: %d\n", (int)status);
+        [self closeVideoToolbox];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)closeVideoToolbox
+{
+    if (_vtbSession) {
+        VTDecompressionSessionInvalidate(_vtbSession);
+        CFRelease(_vtbSession);
+        _vtbSession = NULL;
+    }
+    if (_vtbFormat) {
+        CFRelease(_vtbFormat);
+        _vtbFormat = NULL;
+    }
+}
+
+// the frame, if any, is added to gop by the output callback before returning
+- (BOOL)decodeVideoToolboxPacket:(AVPacket *)pkt intoGOP:(IJKFrameStepGOP *)gop
+{
+    CMBlockBufferRef  block      = NULL;
+    CMSampleBufferRef sample     = NULL;
+    const size_t      sampleSize = pkt->size;
+    // in the units of the stream, read back as they are
+    CMSampleTimingInfo timing = {
+        .duration              = kCMTimeInvalid,
+        .presentationTimeStamp = CMTimeMake(ijkstep_packet_pts(pkt), 1),
+        .decodeTimeStamp       = kCMTimeInvalid,
+    };
+
+    OSStatus status = CMBlockBufferCreateWithMemoryBlock(kCFAllocatorDefault, pkt->data, pkt->size, kCFAllocatorNull,
+                                                         NULL, 0, pkt->size, 0, &block);
+    if (status == noErr)
+        status = CMSampleBufferCreate(kCFAllocatorDefault, block, TRUE, NULL, NULL, _vtbFormat,
+                                      1, 1, &timing, 1, &sampleSize, &sample);
+    if (status == noErr) {
+        status = VTDecompressionSessionDecodeFrame(_vtbSession, sample, 0, (__bridge void *)gop, NULL);
+        if (status == noErr)
+            VTDecompressionSessionWaitForAsynchronousFrames(_vtbSession);
+    }
+
+    if (sample)
+        CFRelease(sample);
+    if (block)
+        CFRelease(block);
+
+    if (status != noErr) {
+        // kVTInvalidSessionErr after going to background among others,
+        // the session is created again for the next GOP
+        [self closeVideoToolbox];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)receiveSoftwareFramesIntoGOP:(IJKFrameStepGOP *)gop frame:(AVFrame *)frame
+{
+    while (avcodec_receive_frame(_codecContext, frame) >= 0) {
+        int64_t pts = av_frame_get_best_effort_timestamp(frame);
+        if ([gop wantsPts:pts])
+            [self addSoftwareFrame:frame pts:pts intoGOP:gop];
+        av_frame_unref(frame);
+    }
+}
+
+// copied into an IOSurface backed NV12 pixel buffer as the players' software
+// frames are, through a VideoToolbox overlay; formats other than 4:2:0 are
+// converted by swscale first
+- (void)addSoftwareFrame:(AVFrame *)frame pts:(int64_t)pts intoGOP:(IJKFrameStepGOP *)gop
+{
+    AVFrame *src = frame;
+    if (!SDL_VoutVideoToolBox_IsPixelBufferFormat(frame->format)) {
+        if (!_convertedFrame && !(_convertedFrame = av_frame_alloc()))
+            return;
+        if (_convertedFrame->width != frame->width || _convertedFrame->height != frame->height) {
+            av_frame_unref(_convertedFrame);
+            _convertedFrame->format = AV_PIX_FMT_YUV420P;
+            _convertedFrame->width  = frame->width;
+            _convertedFrame->height = frame->height;
+            if (av_frame_get_buffer(_convertedFrame, 32) < 0) {
+                av_frame_unref(_convertedFrame);
+                return;
+            }
+        }
+        _swsContext = sws_getCachedContext(_swsContext,
+                                           frame->width, frame->height, frame->format,
+                                           frame->width, frame->height, AV_PIX_FMT_YUV420P,
+                                           SWS_BILINEAR, NULL, NULL, NULL);
+        if (!_swsContext)
+            return;
+        sws_scale(_swsContext, (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height,
+                  _convertedFrame->data, _convertedFrame->linesize);
+        _convertedFrame->colorspace      = frame->colorspace;
+        _convertedFrame->color_range     = frame->color_range;
+        _convertedFrame->interlaced_frame = frame->interlaced_frame;
+        src = _convertedFrame;
+    }
+
+    if (!_overlay && !(_overlay = SDL_VoutVideoToolBox_CreateOverlay(src->width, src->height, NULL)))
+        return;
+    if (SDL_VoutFillFrameYUVOverlay(_overlay, src) == 0)
+        [gop addPixelBuffer:SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(_overlay) pts:pts];
+}
+
+// the next packet of the video stream
+- (int)readPacket:(AVPacket *)pkt
+{
+    for (;;) {
+        int ret = av_read_frame(_formatContext, pkt);
+        if (ret < 0 || pkt->stream_index == _videoStreamIndex)
+            return ret;
+        av_packet_unref(pkt);
+    }
+}
+
+#pragma mark decoding, on the queue
+
+// Decodes from the key frame at or before pts up to the next key frame,
+// keeping the frames in [from, until). Stepping forward, the key frame read
+// last is where the next GOP starts, the demuxer is already there.
+- (IJKFrameStepGOP *)decodeGOPAtPts:(int64_t)pts
+                               from:(int64_t)from
+                              until:(int64_t)until
+                             anchor:(int64_t)anchor
+                       softwareOnly:(BOOL)softwareOnly
+{
+    if (![self openIfNeeded])
+        return nil;
+
+    AVFormatContext *ic = _formatContext;
+    AVPacket pkt;
+    int ret = 0;
+
+    if (_hasPendingKey && ijkstep_packet_pts(&_pendingKey) == pts) {
+        av_packet_move_ref(&pkt, &_pendingKey);
+        _hasPendingKey = NO;
+    } else {
+        [self dropPendingKey];
+        // max_ts at pts: the key frame at or before it
+        ret = avformat_seek_file(ic, _videoStreamIndex, INT64_MIN, pts, pts, 0);
+        if (ret < 0) {
+            if ([self isCancelled])
+                [self close];
+            return nil;
+        }
+
+        int packets = 0;
+        while ((ret = [self readPacket:&pkt]) >= 0) {
+            if ((pkt.flags & AV_PKT_FLAG_KEY) && ijkstep_packet_pts(&pkt) != AV_NOPTS_VALUE)
+                break;
+            av_packet_unref(&pkt);
+            if (++packets >= IJK_STEP_MAX_PACKETS) {
+                ret = AVERROR_INVALIDDATA;
+                break;
+            }
+        }
+        if (ret < 0) {
+            if (ret != AVERROR_EOF && ret != AVERROR_INVALIDDATA)
+                [self close];
+            return nil;
+        }
+    }
+
+    size_t budget = self.memoryBudget / IJK_STEP_GOP_SHARE;
+    IJKFrameStepGOP *gop = [[IJKFrameStepGOP alloc] initWithKeyPts:ijkstep_packet_pts(&pkt)
+                                                               from:from
+                                                              until:until
+                                                             anchor:anchor
+                                                             budget:budget];
+
+    AVCodecContext *avctx = _codecContext;
+    BOOL useVideoToolbox  = !softwareOnly && [self openVideoToolbox];
+    if (!useVideoToolbox)
+        avcodec_flush_buffers(avctx);
+
+    AVFrame *frame   = av_frame_alloc();
+    int64_t  end     = INT64_MAX;
+    int64_t  lastDts = AV_NOPTS_VALUE;
+    BOOL     vtbFailed = NO;
+    for (;;) {
+        int64_t dts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : ijkstep_packet_pts(&pkt);
+        // no frame from here on is shown before until
+        if (dts != AV_NOPTS_VALUE && dts >= until && lastDts != AV_NOPTS_VALUE) {
+            av_packet_unref(&pkt);
+            break;
+        }
+
+        if (useVideoToolbox) {
+            vtbFailed = ![self decodeVideoToolboxPacket:&pkt intoGOP:gop];
+        } else {
+            avcodec_send_packet(avctx, &pkt);
+            [self receiveSoftwareFramesIntoGOP:gop frame:frame];
+        }
+        av_packet_unref(&pkt);
+        if (vtbFailed)
+            break;
+        lastDts = dts;
+
+        // the packets not decoded have greater dts, and no lesser pts
+        if ([gop isFull]) {
+            end = lastDts != AV_NOPTS_VALUE ? lastDts + 1 : INT64_MIN;
+            break;
+        }
+
+        ret = [self readPacket:&pkt];
+        if (ret < 0)
+            break;
+        if (pkt.flags & AV_PKT_FLAG_KEY) {
+            end = ijkstep_packet_pts(&pkt);
+            av_packet_move_ref(&_pendingKey, &pkt);
+            _hasPendingKey = YES;
+            break;
+        }
+    }
+
+    if (!useVideoToolbox) {
+        avcodec_send_packet(avctx, NULL);
+        [self receiveSoftwareFramesIntoGOP:gop frame:frame];
+        avcodec_flush_buffers(avctx);
+    }
+    av_frame_free(&frame);
+
+    // the GOP again, in software from its key frame
+    if (vtbFailed) {
+        [self dropPendingKey];
+        return [self decodeGOPAtPts:pts from:from until:until anchor:anchor softwareOnly:YES];
+    }
+
+    // a network error or a cancel leaves the demuxer somewhere unknown
+    if (ret < 0 && ret != AVERROR_EOF) {
+        [self close];
+        return nil;
+    }
+
+    if (end == INT64_MIN)
+        end = gop->_frames.count > 0 ? gop->_frames.lastObject->_pts + 1 : INT64_MIN;
+    [gop finishAt:end];
+    if (gop->_frames.count == 0)
+        return nil;
+    return gop;
+}
+
+@end
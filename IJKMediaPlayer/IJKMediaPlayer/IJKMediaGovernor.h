@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+@class IJKFFMoviePlayerController;
+
+typedef NS_ENUM(NSInteger, IJKMPMoviePriority) {
+    IJKMPMoviePriorityForeground,   // on screen: decodes, downloads without limit
+    IJKMPMoviePriorityPreloading,   // off screen: paused, downloads within preloadBandwidth
+    IJKMPMoviePriorityBackground,   // paused, downloads suspended
+};
+
+// Shares the device between the players of a feed. Players are managed
+// once given a priority, the others are left alone. Only foreground
+// players decode and render; the others are paused and keep downloading,
+// if their priority allows it, so they start from buffered data when
+// promoted. A player promoted by -setPriority:forPlayer: or by -play
+// demotes the foreground players whose view is off screen, then the least
+// recently promoted ones past maxForegroundPlayers.
+//
+// Give the priority before -prepareToPlay, so a preloading player does
+// not start on prepared. Methods are called on the main thread.
+@interface IJKMediaGovernor : NSObject
+
++ (instancetype)sharedGovernor;
+
+// players decoding at once, default 1, 0 for no limit
+@property(nonatomic) NSUInteger maxForegroundPlayers;
+// players decoding video in software at once, past it VideoToolbox is
+// tried first whatever the options; default 0, no limit
+@property(nonatomic) int maxSoftwareDecoders;
+// bytes per second shared by the preloading players, default 0, no limit
+@property(nonatomic) int64_t preloadBandwidth;
+
+@property(nonatomic, readonly) int softwareDecoderCount;
+
+- (void)setPriority:(IJKMPMoviePriority)priority forPlayer:(IJKFFMoviePlayerController *)player;
+// IJKMPMoviePriorityForeground for a player not managed
+- (IJKMPMoviePriority)priorityOfPlayer:(IJKFFMoviePlayerController *)player;
+
+// called by IJKFFMoviePlayerController
+- (void)playerWillPlay:(IJKFFMoviePlayerController *)player;
+- (void)playerDidPrepare:(IJKFFMoviePlayerController *)player;
+- (void)removePlayer:(IJKFFMoviePlayerController *)player;
+// bytes per second the downloads of player may use, 0 for no limit, -1 while suspended; any thread
+- (int64_t)ioRateOfPlayer:(IJKFFMoviePlayerController *)player;
+
+@end
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaGovernor.h"
+#import "IJKFFMoviePlayerController.h"
+#include "ijkplayer/ios/pipeline/ffpipeline_ios.h"
+
+@interface IJKMediaGovernorEntry : NSObject
+
+@property(nonatomic) IJKMPMoviePriority priority;
+@property(nonatomic) int64_t promoteSerial;
+@property(nonatomic) BOOL    resumeOnPromote;   // playing, or about to autoplay, when demoted
+
+@end
+
+@implementation IJKMediaGovernorEntry
+@end
+
+@implementation IJKMediaGovernor {
+    NSMapTable *_entries;   // player (weak) -> IJKMediaGovernorEntry
+    int64_t     _promoteSerial;
+    int         _maxSoftwareDecoders;
+}
+
++ (instancetype)sharedGovernor
+{
+    static IJKMediaGovernor *governor = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        governor = [[IJKMediaGovernor alloc] init];
+    });
+    return governor;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _entries = [NSMapTable weakToStrongObjectsMapTable];
+        _maxForegroundPlayers = 1;
+    }
+    return self;
+}
+
+- (void)setMaxSoftwareDecoders:(int)maxSoftwareDecoders
+{
+    _maxSoftwareDecoders = maxSoftwareDecoders;
+    ffpipeline_ios_set_max_software_decoders(maxSoftwareDecoders);
+}
+
+- (int)maxSoftwareDecoders
+{
+    return _maxSoftwareDecoders;
+}
+
+- (int)softwareDecoderCount
+{
+    return ffpipeline_ios_get_software_decoder_count();
+}
+
+- (void)setPriority:(IJKMPMoviePriority)priority forPlayer:(IJKFFMoviePlayerController *)player
+{
+    if (!player)
+        return;
+
+    IJKMediaGovernorEntry *entry = nil;
+    IJKMPMoviePriority     oldPriority;
+    BOOL                   isNew = NO;
+    @synchronized (self) {
+        entry = [_entries objectForKey:player];
+        if (!entry) {
+            entry = [[IJKMediaGovernorEntry alloc] init];
+            entry.priority = IJKMPMoviePriorityForeground;
+            [_entries setObject:entry forKey:player];
+            isNew = YES;
+        }
+        oldPriority = entry.priority;
+        entry.priority = priority;
+        if (priority == IJKMPMoviePriorityForeground && (isNew || oldPriority != priority))
+            entry.promoteSerial = ++_promoteSerial;
+    }
+
+    player.runsAtBackgroundQoS = priority != IJKMPMoviePriorityForeground;
+
+    if (priority == IJKMPMoviePriorityForeground) {
+        if (isNew || oldPriority != priority)
+            [self promotePlayer:player entry:entry];
+    } else if (oldPriority == IJKMPMoviePriorityForeground) {
+        entry.resumeOnPromote = [player isPlaying] || (!player.isPreparedToPlay && player.shouldAutoplay);
+        [player pause];
+    }
+}
+
+- (IJKMPMoviePriority)priorityOfPlayer:(IJKFFMoviePlayerController *)player
+{
+    @synchronized (self) {
+        IJKMediaGovernorEntry *entry = [_entries objectForKey:player];
+        return entry ? entry.priority : IJKMPMoviePriorityForeground;
+    }
+}
+
+- (void)promotePlayer:(IJKFFMoviePlayerController *)player entry:(IJKMediaGovernorEntry *)entry
+{
+    NSMutableArray *demoted = [[NSMutableArray alloc] init];
+    @synchronized (self) {
+        NSMutableArray *foreground = [[NSMutableArray alloc] init];
+        for (IJKFFMoviePlayerController *other in _entries) {
+            IJKMediaGovernorEntry *otherEntry = [_entries objectForKey:other];
+            if (other == player || otherEntry.priority != IJKMPMoviePriorityForeground)
+                continue;
+            if (other.view.window == nil)
+                [demoted addObject:other];
+            else
+                [foreground addObject:other];
+        }
+
+        NSMapTable *entries = _entries;
+        [foreground sortUsingComparator:^NSComparisonResult(id a, id b) {
+            int64_t serialA = ((IJKMediaGovernorEntry *)[entries objectForKey:a]).promoteSerial;
+            int64_t serialB = ((IJKMediaGovernorEntry *)[entries objectForKey:b]).promoteSerial;
+            return serialA < serialB ? NSOrderedAscending : (serialA > serialB ? NSOrderedDescending : NSOrderedSame);
+        }];
+        while (_maxForegroundPlayers > 0 && foreground.count + 1 > _maxForegroundPlayers) {
+            [demoted addObject:foreground.firstObject];
+            [foreground removeObjectAtIndex:0];
+        }
+    }
+
+    for (IJKFFMoviePlayerController *other in demoted)
+        [self setPriority:IJKMPMoviePriorityPreloading forPlayer:other];
+
+    if (entry.resumeOnPromote && player.isPreparedToPlay && ![player isPlaying]) {
+        entry.resumeOnPromote = NO;
+        [player play];
+    }
+}
+
+- (void)playerWillPlay:(IJKFFMoviePlayerController *)player
+{
+    @synchronized (self) {
+        IJKMediaGovernorEntry *entry = [_entries objectForKey:player];
+        if (!entry || entry.priority == IJKMPMoviePriorityForeground)
+            return;
+        entry.resumeOnPromote = NO;
+    }
+    [self setPriority:IJKMPMoviePriorityForeground forPlayer:player];
+}
+
+- (void)playerDidPrepare:(IJKFFMoviePlayerController *)player
+{
+    IJKMediaGovernorEntry *entry = nil;
+    @synchronized (self) {
+        entry = [_entries objectForKey:player];
+    }
+    if (!entry)
+        return;
+
+    if (entry.priority != IJKMPMoviePriorityForeground) {
+        // start-on-prepared was set before the player was demoted
+        entry.resumeOnPromote = entry.resumeOnPromote || [player isPlaying] || player.shouldAutoplay;
+        [player pause];
+    } else if (entry.resumeOnPromote) {
+        entry.resumeOnPromote = NO;
+        if (![player isPlaying])
+            [player play];
+    }
+}
+
+- (void)removePlayer:(IJKFFMoviePlayerController *)player
+{
+    @synchronized (self) {
+        [_entries removeObjectForKey:player];
+    }
+}
+
+- (int64_t)ioRateOfPlayer:(IJKFFMoviePlayerController *)player
+{
+    @synchronized (self) {
+        IJKMediaGovernorEntry *entry = [_entries objectForKey:player];
+        if (!entry)
+            return 0;
+
+        switch (entry.priority) {
+            case IJKMPMoviePriorityBackground:
+                return -1;
+            case IJKMPMoviePriorityPreloading: {
+                if (_preloadBandwidth <= 0)
+                    return 0;
+                int64_t preloading = 0;
+                for (IJKFFMoviePlayerController *other in _entries) {
+                    if (((IJKMediaGovernorEntry *)[_entries objectForKey:other]).priority == IJKMPMoviePriorityPreloading)
+                        preloading++;
+                }
+                return MAX(_preloadBandwidth / MAX(preloading, 1), 1);
+            }
+            default:
+                return 0;
+        }
+    }
+}
+
+@end
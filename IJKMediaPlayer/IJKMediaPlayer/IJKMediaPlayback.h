@@ -53,6 +53,16 @@ typedef NS_ENUM(NSInteger, IJKMPMovieFinishReason) {
     IJKMPMovieFinishReasonUserExited
 };
 
+// what a stall of the playback is put down to, checked in this order
+typedef NS_ENUM(NSInteger, IJKMPMovieRebufferCause) {
+    IJKMPMovieRebufferCauseUnknown,
+    IJKMPMovieRebufferCauseSeek,                // buffering after a seek
+    IJKMPMovieRebufferCauseDecoderStarvation,   // video packets queued, no frames out of the decoder
+    IJKMPMovieRebufferCauseConnect,             // a dns lookup, connect or http request under way
+    IJKMPMovieRebufferCauseSegmentGap,          // HLS with nothing downloading, waiting for the next segment
+    IJKMPMovieRebufferCauseThroughput,          // downloading slower than the bitrate
+};
+
 // -----------------------------------------------------------------------------
 // Thumbnails
 
@@ -148,11 +158,30 @@ IJK_EXTERN NSString* const IJKMPMovieNaturalSizeAvailableNotification;
 IJK_EXTERN NSString *const IJKMPMoviePlayerVideoDecoderOpenNotification;
 IJK_EXTERN NSString *const IJKMPMoviePlayerFirstVideoFrameRenderedNotification;
 IJK_EXTERN NSString *const IJKMPMoviePlayerFirstAudioFrameRenderedNotification;
+// once per play, see startupReport of IJKFFMoviePlayerController
+IJK_EXTERN NSString *const IJKMPMoviePlayerStartupReportNotification;
+// once the core is torn down, see shutdownReport of IJKFFMoviePlayerController
+IJK_EXTERN NSString *const IJKMPMoviePlayerShutdownReportNotification;
+
+// as the player steps its thermalPolicy up or down, see IJKFFThermalPolicyLevel
+IJK_EXTERN NSString *const IJKMPMoviePlayerThermalPolicyDidChangeNotification;
+IJK_EXTERN NSString *const IJKMPMoviePlayerThermalPolicyLevelUserInfoKey;           // NSNumber (IJKFFThermalPolicyLevel)
+
+// a stall after the first frame, as it starts; seeks included
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferNotification;
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferCauseUserInfoKey;                // NSNumber (IJKMPMovieRebufferCause)
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferVideoCachedDurationUserInfoKey;  // NSNumber, milliseconds
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferAudioCachedDurationUserInfoKey;  // NSNumber, milliseconds
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferVideoCachedBytesUserInfoKey;     // NSNumber
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferAudioCachedBytesUserInfoKey;     // NSNumber
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferThroughputUserInfoKey;           // NSNumber, bits per second downloaded
+IJK_EXTERN NSString *const IJKMPMoviePlayerRebufferBitrateUserInfoKey;              // NSNumber, bits per second of the media
 
 IJK_EXTERN NSString *const IJKMPMoviePlayerDidSeekCompleteNotification;
 IJK_EXTERN NSString *const IJKMPMoviePlayerDidSeekCompleteTargetKey;
 IJK_EXTERN NSString *const IJKMPMoviePlayerDidSeekCompleteErrorKey;
 IJK_EXTERN NSString *const IJKMPMoviePlayerDidAccurateSeekCompleteCurPos;
+IJK_EXTERN NSString *const IJKMPMoviePlayerDidAccurateSeekCompleteSkippedFrames;
 IJK_EXTERN NSString *const IJKMPMoviePlayerAccurateSeekCompleteNotification;
 
 @end
@@ -209,6 +238,15 @@ typedef NS_ENUM(NSInteger, IJKMediaEvent) {
 
 @end
 
+// the AES-128 keys of HLS segments, for keys the app holds or fetches itself
+@protocol IJKMediaKeyDelegate <NSObject>
+
+// called on a demuxer thread, which waits for the answer; 16 bytes, or nil
+// for the player to fetch keyUrl
+- (NSData *)keyForUrl:(NSString *)keyUrl;
+
+@end
+
 @protocol IJKMediaNativeInvokeDelegate <NSObject>
 
 - (int)invoke:(IJKMediaEvent)event attributes:(NSDictionary *)attributes;
@@ -39,6 +39,20 @@ NSString *const IJKMPMoviePlayerVideoDecoderOpenNotification = @"IJKMPMoviePlaye
 
 NSString *const IJKMPMoviePlayerFirstVideoFrameRenderedNotification = @"IJKMPMoviePlayerFirstVideoFrameRenderedNotification";
 NSString *const IJKMPMoviePlayerFirstAudioFrameRenderedNotification = @"IJKMPMoviePlayerFirstAudioFrameRenderedNotification";
+NSString *const IJKMPMoviePlayerStartupReportNotification = @"IJKMPMoviePlayerStartupReportNotification";
+NSString *const IJKMPMoviePlayerShutdownReportNotification = @"IJKMPMoviePlayerShutdownReportNotification";
+
+NSString *const IJKMPMoviePlayerThermalPolicyDidChangeNotification = @"IJKMPMoviePlayerThermalPolicyDidChangeNotification";
+NSString *const IJKMPMoviePlayerThermalPolicyLevelUserInfoKey = @"IJKMPMoviePlayerThermalPolicyLevelUserInfoKey";
+
+NSString *const IJKMPMoviePlayerRebufferNotification = @"IJKMPMoviePlayerRebufferNotification";
+NSString *const IJKMPMoviePlayerRebufferCauseUserInfoKey = @"IJKMPMoviePlayerRebufferCauseUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferVideoCachedDurationUserInfoKey = @"IJKMPMoviePlayerRebufferVideoCachedDurationUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferAudioCachedDurationUserInfoKey = @"IJKMPMoviePlayerRebufferAudioCachedDurationUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferVideoCachedBytesUserInfoKey = @"IJKMPMoviePlayerRebufferVideoCachedBytesUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferAudioCachedBytesUserInfoKey = @"IJKMPMoviePlayerRebufferAudioCachedBytesUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferThroughputUserInfoKey = @"IJKMPMoviePlayerRebufferThroughputUserInfoKey";
+NSString *const IJKMPMoviePlayerRebufferBitrateUserInfoKey = @"IJKMPMoviePlayerRebufferBitrateUserInfoKey";
 
 NSString *const IJKMPMoviePlayerAccurateSeekCompleteNotification = @"IJKMPMoviePlayerAccurateSeekCompleteNotification";
 
@@ -46,6 +60,7 @@ NSString *const IJKMPMoviePlayerDidSeekCompleteNotification = @"IJKMPMoviePlayer
 NSString *const IJKMPMoviePlayerDidSeekCompleteTargetKey = @"IJKMPMoviePlayerDidSeekCompleteTargetKey";
 NSString *const IJKMPMoviePlayerDidSeekCompleteErrorKey = @"IJKMPMoviePlayerDidSeekCompleteErrorKey";
 NSString *const IJKMPMoviePlayerDidAccurateSeekCompleteCurPos = @"IJKMPMoviePlayerDidAccurateSeekCompleteCurPos";
+NSString *const IJKMPMoviePlayerDidAccurateSeekCompleteSkippedFrames = @"IJKMPMoviePlayerDidAccurateSeekCompleteSkippedFrames";
 
 @implementation IJKMediaUrlOpenData {
     NSString *_url;
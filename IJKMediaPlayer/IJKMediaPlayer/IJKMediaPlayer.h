@@ -26,6 +26,18 @@
 
 #import "IJKFFOptions.h"
 #import "IJKFFMoviePlayerController.h"
+#import "IJKMediaPreloader.h"
+#import "IJKMediaDataSource.h"
+#import "IJKMediaThumbnailer.h"
+#import "IJKMediaSpriteThumbnailer.h"
+#import "IJKMediaFrameStepper.h"
+#import "IJKMediaClipExporter.h"
+#import "IJKMediaDownloader.h"
+#import "IJKFFMosaicPlayerController.h"
+#import "IJKFFChannelZapper.h"
+#import "IJKFFDecoderBenchmark.h"
+#import "IJKFFBlackBox.h"
+#import "IJKMediaGovernor.h"
 
 #import "IJKAVMoviePlayerController.h"
 
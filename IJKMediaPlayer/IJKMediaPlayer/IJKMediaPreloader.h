@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+@class IJKFFOptions;
+
+// Warms the dns cache, the http pool and the disk cache for urls about to
+// be played, e.g. the next items of a feed, so the player created later
+// starts from local data, and a VideoToolbox session of the default size,
+// see +[IJKFFMoviePlayerController prewarmVideoDecoder]. Urls are preloaded one at a time, in the order
+// they were queued, on a background priority queue.
+//
+// Pass the url exactly as the player will get it: progressive urls must be
+// opened as "cache:<url>" by both, and the options must enable the format
+// option "disk_cache". A directory must be set with
+// +[IJKFFMoviePlayerController setDiskCacheDirectory:maxSize:].
+@interface IJKMediaPreloader : NSObject
+
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithOptions:(IJKFFOptions *)options;
+
+// read the first seconds of media, or maxBytes bytes if maxBytes > 0,
+// whichever comes first; does nothing if url is already queued
+- (void)preloadURL:(NSURL *)aUrl duration:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes;
+
+// read seconds of media from the key frame before each of times, in
+// seconds and most likely first, maxBytes in all if maxBytes > 0: the
+// likely seek targets of an item playing, so seeking there starts from the
+// disk cache; does nothing if url is already queued
+- (void)preloadURL:(NSURL *)aUrl seekTargets:(NSArray<NSNumber *> *)times
+          duration:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes;
+
+// call before creating the player of aUrl, so the preload does not compete
+// with it; the data already read stays in the cache
+- (void)cancelPreloadForURL:(NSURL *)aUrl;
+- (void)cancelAll;
+
+@end
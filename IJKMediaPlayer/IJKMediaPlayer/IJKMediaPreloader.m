@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaPreloader.h"
+#import "IJKFFOptions.h"
+#import "IJKFFMoviePlayerController.h"
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+#include "libavformat/preload.h"
+
+@interface IJKMediaPreloadTask : NSObject
+{
+@public
+    volatile int _abortRequest;
+}
+
+@property(nonatomic, copy) NSString *key;
+@property(nonatomic) int64_t duration;      // AV_TIME_BASE units
+@property(nonatomic) int64_t maxBytes;
+@property(nonatomic, copy) NSArray<NSNumber *> *targets;  // seconds, nil for the start
+
+@end
+
+@implementation IJKMediaPreloadTask
+@end
+
+static int ijkpreload_interrupt_cb(void *opaque)
+{
+    IJKMediaPreloadTask *task = (__bridge IJKMediaPreloadTask *)opaque;
+    return task->_abortRequest;
+}
+
+@implementation IJKMediaPreloader {
+    dispatch_queue_t     _queue;
+    AVDictionary        *_formatOptions;
+    NSMutableDictionary *_tasks;    // queued or running, by url
+}
+
+- (instancetype)initWithOptions:(IJKFFOptions *)options
+{
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.preloader", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        _tasks = [[NSMutableDictionary alloc] init];
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+        av_dict_set_int(&_formatOptions, "disk_cache", 1, 0);
+
+        ijkmp_global_init();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self cancelAll];
+    // the blocks still queued use the options, free them after the last one
+    AVDictionary *formatOptions = _formatOptions;
+    dispatch_async(_queue, ^{
+        AVDictionary *options = formatOptions;
+        av_dict_free(&options);
+    });
+}
+
+- (void)preloadURL:(NSURL *)aUrl duration:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes
+{
+    NSString *key = aUrl.absoluteString;
+    if (key.length == 0 || (seconds <= 0 && maxBytes <= 0))
+        return;
+
+    IJKMediaPreloadTask *task = [[IJKMediaPreloadTask alloc] init];
+    task.key      = key;
+    task.duration = (int64_t)(seconds * AV_TIME_BASE);
+    task.maxBytes = maxBytes;
+    if (![self addTask:task])
+        return;
+
+    // resolving does not wait for the preloads queued before this one
+    NSURL *hostUrl = aUrl;
+    if ([aUrl.scheme isEqualToString:@"cache"])
+        hostUrl = [NSURL URLWithString:[key substringFromIndex:@"cache:".length]];
+    [IJKFFMoviePlayerController prefetchDNSForURL:hostUrl];
+    // as does the decoder session, the stream is only guessed
+    [IJKFFMoviePlayerController prewarmVideoDecoder];
+
+    [self runTask:task];
+}
+
+- (void)preloadURL:(NSURL *)aUrl seekTargets:(NSArray<NSNumber *> *)times
+          duration:(NSTimeInterval)seconds maxBytes:(int64_t)maxBytes
+{
+    NSString *key = aUrl.absoluteString;
+    if (key.length == 0 || times.count == 0 || seconds <= 0)
+        return;
+
+    IJKMediaPreloadTask *task = [[IJKMediaPreloadTask alloc] init];
+    task.key      = key;
+    task.duration = (int64_t)(seconds * AV_TIME_BASE);
+    task.maxBytes = maxBytes;
+    task.targets  = times;
+    if (![self addTask:task])
+        return;
+
+    // the host and the decoder are warm already, the item is playing
+    [self runTask:task];
+}
+
+// NO if a task of the url is queued already
+- (BOOL)addTask:(IJKMediaPreloadTask *)task
+{
+    @synchronized (_tasks) {
+        if (_tasks[task.key])
+            return NO;
+        _tasks[task.key] = task;
+    }
+    return YES;
+}
+
+- (void)runTask:(IJKMediaPreloadTask *)task
+{
+    AVDictionary *formatOptions = _formatOptions;
+    NSMutableDictionary *tasks = _tasks;
+    dispatch_async(_queue, ^{
+        if (!task->_abortRequest) {
+            AVIOInterruptCB int_cb = { ijkpreload_interrupt_cb, (__bridge void *)task };
+            if (task.targets) {
+                NSUInteger nb_targets = task.targets.count;
+                int64_t   *targets    = av_malloc_array(nb_targets, sizeof(*targets));
+                if (targets) {
+                    for (NSUInteger i = 0; i < nb_targets; i++)
+                        targets[i] = (int64_t)(task.targets[i].doubleValue * AV_TIME_BASE);
+                    av_preload_url_targets(task.key.UTF8String, targets, (int)nb_targets,
+                                           task.duration, task.maxBytes,
+                                           formatOptions, &int_cb, NULL);
+                    av_free(targets);
+                }
+            } else {
+                av_preload_url(task.key.UTF8String, task.duration, task.maxBytes,
+                               formatOptions, &int_cb, NULL);
+            }
+        }
+
+        @synchronized (tasks) {
+            if (tasks[task.key] == task)
+                [tasks removeObjectForKey:task.key];
+        }
+    });
+}
+
+- (void)cancelPreloadForURL:(NSURL *)aUrl
+{
+    NSString *key = aUrl.absoluteString;
+    if (key.length == 0)
+        return;
+
+    @synchronized (_tasks) {
+        IJKMediaPreloadTask *task = _tasks[key];
+        if (task) {
+            task->_abortRequest = 1;
+            [_tasks removeObjectForKey:key];
+        }
+    }
+}
+
+- (void)cancelAll
+{
+    @synchronized (_tasks) {
+        [_tasks enumerateKeysAndObjectsUsingBlock:^(id key, IJKMediaPreloadTask *task, BOOL *stop) {
+            task->_abortRequest = 1;
+        }];
+        [_tasks removeAllObjects];
+    }
+}
+
+@end
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+
+@class IJKFFOptions;
+
+// Serves scrubbing previews from the thumbnail track a stream publishes,
+// without decoding video: sheets of tiles, each tile the image of a time
+// range. The track is either
+//  - the image stream of an HLS master playlist (EXT-X-IMAGE-STREAM-INF),
+//    or an image media playlist itself (EXT-X-TILES), or
+//  - a WebVTT track whose cues are "sheet.jpg#xywh=x,y,w,h".
+//
+// prefetch discovers the track and downloads the sheets, in time order, on
+// a background priority queue, through the http pool of the players. Each
+// sheet is decoded once, and kept decoded up to maximumDecodedBytes, least
+// recently used first out; the previews share its pixels. A layer given a
+// sheet as its contents is uploaded to the GPU once, the previews after
+// that are changes of its contentsRect.
+//
+// HLS I-frame playlists carry video, use IJKMediaThumbnailer for them.
+@interface IJKMediaSpriteThumbnailer : NSObject
+
+// aUrl: the url played, or the one of a WebVTT thumbnail track
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options;
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options;
+
+// the image stream of the largest tiles fitting in it, CGSizeZero for the
+// largest; set before prefetch
+@property(atomic) CGSize maximumSize;
+// 48 MiB by default
+@property(atomic) int64_t maximumDecodedBytes;
+
+// called on the main thread once the track is found or not; calling prefetch
+// again does nothing
+- (void)prefetchWithCompletion:(void (^)(BOOL available))completion;
+@property(nonatomic, readonly, getter=isAvailable) BOOL available;
+
+// nil until the sheet of time is in, its download then comes next
+- (UIImage *)previewImageAtTime:(NSTimeInterval)time;
+
+// sets the contents and contentsRect of layer to the tile of time, NO and
+// leaves layer as it was until the sheet of time is in
+- (BOOL)showPreviewAtTime:(NSTimeInterval)time inLayer:(CALayer *)layer;
+
+// stops the downloads, the previews in memory stay
+- (void)cancel;
+
+@end
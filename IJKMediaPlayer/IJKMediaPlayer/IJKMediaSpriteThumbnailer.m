@@ -0,0 +1,640 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaSpriteThumbnailer.h"
+#import "IJKFFOptions.h"
+#import <ImageIO/ImageIO.h>
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+
+#define IJK_SPRITE_MAX_TEXT_SIZE    (4 * 1024 * 1024)
+#define IJK_SPRITE_MAX_SHEET_SIZE   (16 * 1024 * 1024)
+#define IJK_SPRITE_IO_SIZE          16384
+
+typedef struct IJKSpriteTile {
+    double      start;      // seconds
+    double      end;
+    NSUInteger  sheet;
+    CGRect      rect;       // in the sheet, in pixels
+} IJKSpriteTile;
+
+@interface IJKSpriteSheet : NSObject
+{
+@public
+    CGImageRef _image;      // decoded, under @synchronized of the thumbnailer
+}
+
+@property(nonatomic, copy) NSString *url;
+@property(nonatomic, strong) NSData *data;      // compressed, once downloaded
+@property(nonatomic) BOOL failed;
+@property(nonatomic) int64_t lastUse;
+
+@end
+
+@implementation IJKSpriteSheet
+
+- (void)dealloc
+{
+    CGImageRelease(_image);
+}
+
+@end
+
+static int ijksprite_interrupt_cb(void *opaque);
+
+// a file path stays one
+static NSString *ijksprite_resolve(NSString *base, NSString *ref)
+{
+    NSURL *baseURL = [base hasPrefix:@"/"] ? [NSURL fileURLWithPath:base] : [NSURL URLWithString:base];
+    NSURL *url = [NSURL URLWithString:ref relativeToURL:baseURL].absoluteURL;
+    if (!url)
+        return nil;
+    return url.isFileURL ? url.path : url.absoluteString;
+}
+
+// KEY=value,KEY="quoted, value"
+static NSDictionary *ijksprite_attributes(NSString *list)
+{
+    NSMutableDictionary *attributes = [NSMutableDictionary dictionary];
+    NSScanner *scanner = [NSScanner scannerWithString:list];
+    scanner.charactersToBeSkipped = nil;
+
+    while (!scanner.isAtEnd) {
+        NSString *key = nil, *value = nil;
+        if (![scanner scanUpToString:@"=" intoString:&key] || ![scanner scanString:@"=" intoString:NULL])
+            break;
+        if ([scanner scanString:@"\"" intoString:NULL]) {
+            [scanner scanUpToString:@"\"" intoString:&value];
+            [scanner scanString:@"\"" intoString:NULL];
+        } else {
+            [scanner scanUpToString:@"," intoString:&value];
+        }
+        [scanner scanString:@"," intoString:NULL];
+        attributes[[key stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]] = value ?: @"";
+    }
+    return attributes;
+}
+
+// "WxH" of RESOLUTION and LAYOUT
+static BOOL ijksprite_size(NSString *string, int *width, int *height)
+{
+    int w, h;
+
+    if (!string || sscanf(string.UTF8String, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+        return NO;
+    *width  = w;
+    *height = h;
+    return YES;
+}
+
+// [hh:]mm:ss.ttt of WebVTT
+static double ijksprite_vtt_time(NSString *string)
+{
+    NSArray<NSString *> *parts = [string componentsSeparatedByString:@":"];
+    double time = 0;
+
+    for (NSString *part in parts)
+        time = time * 60 + part.doubleValue;
+    return time;
+}
+
+static CGImageRef ijksprite_decode(NSData *data)
+{
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+    if (!source)
+        return NULL;
+
+    // decoded now, not at the first draw
+    NSDictionary *options = @{(id)kCGImageSourceShouldCacheImmediately: @YES};
+    CGImageRef image = CGImageSourceCreateImageAtIndex(source, 0, (__bridge CFDictionaryRef)options);
+    CFRelease(source);
+    return image;
+}
+
+static int64_t ijksprite_image_bytes(CGImageRef image)
+{
+    return (int64_t)CGImageGetBytesPerRow(image) * CGImageGetHeight(image);
+}
+
+@implementation IJKMediaSpriteThumbnailer {
+    dispatch_queue_t     _queue;
+    NSString            *_urlString;
+    AVDictionary        *_formatOptions;
+    volatile int         _abortRequest;
+
+    // under @synchronized (self), filled on the queue
+    NSMutableArray<IJKSpriteSheet *> *_sheets;
+    NSMutableData       *_tiles;            // IJKSpriteTile, by start time
+    BOOL                 _prefetchStarted;
+    BOOL                 _servicing;        // the queue runs serviceSheets
+    NSInteger            _wantedSheet;      // -1 if none
+    int64_t              _decodedBytes;
+    int64_t              _useCounter;
+}
+
+@synthesize maximumSize = _maximumSize;
+@synthesize maximumDecodedBytes = _maximumDecodedBytes;
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options
+{
+    if (aUrl == nil)
+        return nil;
+
+    return [self initWithContentURLString:[aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString]
+                                  options:options];
+}
+
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options
+{
+    if (aUrlString.length == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.sprite-thumbnailer", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        _urlString           = [aUrlString copy];
+        _sheets              = [[NSMutableArray alloc] init];
+        _tiles               = [[NSMutableData alloc] init];
+        _wantedSheet         = -1;
+        _maximumDecodedBytes = 48 * 1024 * 1024;
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        ijkmp_global_init();
+
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(didReceiveMemoryWarning)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // queued blocks retain self, none is left
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    av_dict_free(&_formatOptions);
+}
+
+- (void)cancel
+{
+    _abortRequest = 1;
+}
+
+static int ijksprite_interrupt_cb(void *opaque)
+{
+    IJKMediaSpriteThumbnailer *thumbnailer = (__bridge IJKMediaSpriteThumbnailer *)opaque;
+    return thumbnailer->_abortRequest;
+}
+
+// the sheets are decoded again from their compressed data when needed
+- (void)didReceiveMemoryWarning
+{
+    @synchronized (self) {
+        for (IJKSpriteSheet *sheet in _sheets) {
+            CGImageRelease(sheet->_image);
+            sheet->_image = NULL;
+        }
+        _decodedBytes = 0;
+    }
+}
+
+#pragma mark previews
+
+- (BOOL)isAvailable
+{
+    @synchronized (self) {
+        return _tiles.length > 0;
+    }
+}
+
+// with @synchronized (self)
+- (const IJKSpriteTile *)tileAtTime:(NSTimeInterval)time
+{
+    const IJKSpriteTile *tiles = _tiles.bytes;
+    NSUInteger count = _tiles.length / sizeof(IJKSpriteTile);
+    NSUInteger low = 0, high = count;
+
+    if (!count)
+        return NULL;
+    // the last tile starting at or before time
+    while (high - low > 1) {
+        NSUInteger mid = (low + high) / 2;
+        if (tiles[mid].start <= time)
+            low = mid;
+        else
+            high = mid;
+    }
+    return &tiles[low];
+}
+
+// the decoded sheet of time and the tile in it, retained; NULL if not in
+- (CGImageRef)copySheetAtTime:(NSTimeInterval)time rect:(CGRect *)rect
+{
+    @synchronized (self) {
+        const IJKSpriteTile *tile = [self tileAtTime:time];
+        if (!tile)
+            return NULL;
+
+        IJKSpriteSheet *sheet = _sheets[tile->sheet];
+        if (!sheet->_image) {
+            [self wantSheet:tile->sheet];
+            return NULL;
+        }
+        sheet.lastUse = ++_useCounter;
+        *rect = tile->rect;
+        return CGImageRetain(sheet->_image);
+    }
+}
+
+- (UIImage *)previewImageAtTime:(NSTimeInterval)time
+{
+    CGRect rect;
+    CGImageRef sheet = [self copySheetAtTime:time rect:&rect];
+    if (!sheet)
+        return nil;
+
+    // shares the pixels of the sheet
+    CGImageRef tile = CGImageCreateWithImageInRect(sheet, rect);
+    CGImageRelease(sheet);
+    if (!tile)
+        return nil;
+    UIImage *image = [UIImage imageWithCGImage:tile];
+    CGImageRelease(tile);
+    return image;
+}
+
+- (BOOL)showPreviewAtTime:(NSTimeInterval)time inLayer:(CALayer *)layer
+{
+    CGRect rect;
+    CGImageRef sheet = [self copySheetAtTime:time rect:&rect];
+    if (!sheet)
+        return NO;
+
+    CGFloat width  = CGImageGetWidth(sheet);
+    CGFloat height = CGImageGetHeight(sheet);
+
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    if (layer.contents != (__bridge id)sheet)
+        layer.contents = (__bridge id)sheet;
+    layer.contentsRect = CGRectMake(rect.origin.x / width, rect.origin.y / height,
+                                    rect.size.width / width, rect.size.height / height);
+    [CATransaction commit];
+    CGImageRelease(sheet);
+    return YES;
+}
+
+#pragma mark sheets
+
+// with @synchronized (self)
+- (void)wantSheet:(NSUInteger)index
+{
+    if (_abortRequest)
+        return;
+
+    _wantedSheet = index;
+    if (!_servicing) {
+        _servicing = YES;
+        dispatch_async(_queue, ^{
+            [self serviceSheets];
+        });
+    }
+}
+
+// with @synchronized (self)
+- (void)evictFor:(int64_t)bytes
+{
+    while (_decodedBytes + bytes > self.maximumDecodedBytes) {
+        IJKSpriteSheet *oldest = nil;
+        for (IJKSpriteSheet *sheet in _sheets) {
+            if (sheet->_image && (!oldest || sheet.lastUse < oldest.lastUse))
+                oldest = sheet;
+        }
+        if (!oldest)
+            break;
+        _decodedBytes -= ijksprite_image_bytes(oldest->_image);
+        CGImageRelease(oldest->_image);
+        oldest->_image = NULL;
+    }
+}
+
+// on the queue: the sheet wanted first, then the ones not downloaded, in time order
+- (void)serviceSheets
+{
+    for (;;) {
+        IJKSpriteSheet *sheet = nil;
+        BOOL wanted = NO;
+
+        @synchronized (self) {
+            if (_wantedSheet >= 0) {
+                sheet = _sheets[_wantedSheet];
+                wanted = YES;
+                _wantedSheet = -1;
+                if (sheet->_image || sheet.failed)
+                    sheet = nil;
+            }
+            if (!sheet) {
+                for (IJKSpriteSheet *s in _sheets) {
+                    if (!s.data && !s.failed) {
+                        sheet = s;
+                        wanted = NO;
+                        break;
+                    }
+                }
+            }
+            if (!sheet || _abortRequest) {
+                _servicing = NO;
+                return;
+            }
+        }
+
+        @autoreleasepool {
+            NSData *data = sheet.data;
+            if (!data) {
+                data = [self fetchURL:sheet.url maxSize:IJK_SPRITE_MAX_SHEET_SIZE prefix:nil];
+                if (!data) {
+                    sheet.failed = YES;
+                    continue;
+                }
+                sheet.data = data;
+            }
+
+            // decoded ahead while the budget lasts, on demand after that
+            int64_t expected = 0;
+            @synchronized (self) {
+                if (!wanted && _decodedBytes >= self.maximumDecodedBytes)
+                    continue;
+                expected = _decodedBytes;
+            }
+            CGImageRef image = ijksprite_decode(data);
+            if (!image) {
+                sheet.failed = YES;
+                continue;
+            }
+            @synchronized (self) {
+                int64_t bytes = ijksprite_image_bytes(image);
+                if (wanted || expected + bytes <= self.maximumDecodedBytes) {
+                    [self evictFor:bytes];
+                    CGImageRelease(sheet->_image);
+                    sheet->_image = image;
+                    sheet.lastUse = ++_useCounter;
+                    _decodedBytes += bytes;
+                    image = NULL;
+                }
+            }
+            CGImageRelease(image);
+        }
+    }
+}
+
+#pragma mark discovery, on the queue
+
+// the whole resource, nil if it does not start with prefix
+- (NSData *)fetchURL:(NSString *)url maxSize:(NSUInteger)maxSize prefix:(NSArray<NSString *> *)prefixes
+{
+    AVIOInterruptCB int_cb = { ijksprite_interrupt_cb, (__bridge void *)self };
+    AVIOContext *pb = NULL;
+    AVDictionary *options = NULL;
+    uint8_t buf[IJK_SPRITE_IO_SIZE];
+    int ret;
+
+    if (!url)
+        return nil;
+    av_dict_copy(&options, _formatOptions, 0);
+    ret = avio_open2(&pb, url.UTF8String, AVIO_FLAG_READ, &int_cb, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return nil;
+
+    NSMutableData *data = [NSMutableData data];
+    while ((ret = avio_read(pb, buf, sizeof(buf))) > 0) {
+        if (data.length + ret > maxSize)
+            break;
+        [data appendBytes:buf length:ret];
+
+        // a media file is not read past its first bytes
+        if (prefixes && data.length == ret) {
+            const uint8_t *head = buf;
+            int length = ret;
+            BOOL matched = NO;
+            if (length >= 3 && !memcmp(head, "\xEF\xBB\xBF", 3)) {
+                head   += 3;
+                length -= 3;
+            }
+            for (NSString *prefix in prefixes) {
+                NSUInteger size = strlen(prefix.UTF8String);
+                matched = matched || ((NSUInteger)length >= size && !memcmp(head, prefix.UTF8String, size));
+            }
+            if (!matched) {
+                ret = AVERROR_INVALIDDATA;
+                break;
+            }
+        }
+    }
+    avio_closep(&pb);
+    return ret == AVERROR_EOF ? data : nil;
+}
+
+- (NSString *)fetchTextURL:(NSString *)url
+{
+    NSData *data = [self fetchURL:url maxSize:IJK_SPRITE_MAX_TEXT_SIZE prefix:@[@"#EXTM3U", @"WEBVTT"]];
+    NSString *text = data ? [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] : nil;
+    if ([text hasPrefix:@"\uFEFF"])
+        text = [text substringFromIndex:1];
+    return text;
+}
+
+- (NSUInteger)addSheet:(NSString *)url sheets:(NSMutableDictionary<NSString *, NSNumber *> *)indexes
+{
+    NSNumber *index = indexes[url];
+    if (index)
+        return index.unsignedIntegerValue;
+
+    IJKSpriteSheet *sheet = [[IJKSpriteSheet alloc] init];
+    sheet.url = url;
+    @synchronized (self) {
+        [_sheets addObject:sheet];
+        indexes[url] = @(_sheets.count - 1);
+        return _sheets.count - 1;
+    }
+}
+
+// the image stream of the largest tiles fitting in maximumSize, the smallest if none does
+- (NSString *)imageStreamOfMaster:(NSString *)text base:(NSString *)base
+{
+    CGSize maximumSize = self.maximumSize;
+    NSString *best = nil, *smallest = nil;
+    int bestArea = 0, smallestArea = INT_MAX;
+
+    for (NSString *line in [text componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        if (![line hasPrefix:@"#EXT-X-IMAGE-STREAM-INF:"])
+            continue;
+        NSDictionary *attributes = ijksprite_attributes([line substringFromIndex:@"#EXT-X-IMAGE-STREAM-INF:".length]);
+        NSString *uri = attributes[@"URI"];
+        int width = 0, height = 0;
+        if (!uri.length)
+            continue;
+        ijksprite_size(attributes[@"RESOLUTION"], &width, &height);
+
+        BOOL fits = CGSizeEqualToSize(maximumSize, CGSizeZero) ||
+                    (width <= maximumSize.width && height <= maximumSize.height);
+        if (fits && (!best || width * height > bestArea)) {
+            best     = uri;
+            bestArea = width * height;
+        }
+        if (!smallest || width * height < smallestArea) {
+            smallest     = uri;
+            smallestArea = width * height;
+        }
+    }
+    return ijksprite_resolve(base, best ?: smallest);
+}
+
+// EXT-X-TILES of the segment before it, or after its EXTINF
+- (void)parseImagePlaylist:(NSString *)text base:(NSString *)base tiles:(NSMutableData *)tiles
+{
+    NSMutableDictionary *sheets = [NSMutableDictionary dictionary];
+    NSDictionary *layout = nil;
+    double segmentDuration = 0, time = 0;
+
+    for (NSString *rawLine in [text componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        NSString *line = [rawLine stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([line hasPrefix:@"#EXTINF:"]) {
+            segmentDuration = [line substringFromIndex:@"#EXTINF:".length].doubleValue;
+        } else if ([line hasPrefix:@"#EXT-X-TILES:"]) {
+            layout = ijksprite_attributes([line substringFromIndex:@"#EXT-X-TILES:".length]);
+        } else if (line.length && ![line hasPrefix:@"#"]) {
+            int width, height, columns = 1, rows = 1;
+            NSString *url = ijksprite_resolve(base, line);
+
+            if (url && ijksprite_size(layout[@"RESOLUTION"], &width, &height) && segmentDuration > 0) {
+                ijksprite_size(layout[@"LAYOUT"], &columns, &rows);
+                double duration = [layout[@"DURATION"] doubleValue];
+                if (duration <= 0)
+                    duration = segmentDuration / (columns * rows);
+
+                NSUInteger sheet = [self addSheet:url sheets:sheets];
+                for (int i = 0; i < columns * rows && i * duration < segmentDuration; i++) {
+                    IJKSpriteTile tile;
+                    tile.start = time + i * duration;
+                    tile.end   = MIN(tile.start + duration, time + segmentDuration);
+                    tile.sheet = sheet;
+                    tile.rect  = CGRectMake((i % columns) * width, (i / columns) * height, width, height);
+                    [tiles appendBytes:&tile length:sizeof(tile)];
+                }
+            }
+            time += segmentDuration;
+            segmentDuration = 0;
+        }
+    }
+}
+
+// cues of "sheet.jpg#xywh=x,y,w,h"
+- (void)parseWebVTT:(NSString *)text base:(NSString *)base tiles:(NSMutableData *)tiles
+{
+    NSMutableDictionary *sheets = [NSMutableDictionary dictionary];
+    NSArray<NSString *> *lines = [text componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]];
+
+    for (NSUInteger i = 0; i + 1 < lines.count; i++) {
+        NSRange arrow = [lines[i] rangeOfString:@"-->"];
+        if (arrow.location == NSNotFound)
+            continue;
+
+        NSString *payload = [lines[i + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        NSRange fragment  = [payload rangeOfString:@"#xywh="];
+        int x, y, w, h;
+        if (fragment.location == NSNotFound ||
+            sscanf([payload substringFromIndex:NSMaxRange(fragment)].UTF8String, "%d,%d,%d,%d", &x, &y, &w, &h) != 4 ||
+            w <= 0 || h <= 0)
+            continue;
+        NSString *url = ijksprite_resolve(base, [payload substringToIndex:fragment.location]);
+        if (!url)
+            continue;
+
+        NSString *start = [[lines[i] substringToIndex:arrow.location] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        // cue settings may follow the end time
+        NSString *end = [[[lines[i] substringFromIndex:NSMaxRange(arrow)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]
+                         componentsSeparatedByString:@" "].firstObject;
+        IJKSpriteTile tile;
+        tile.start = ijksprite_vtt_time(start);
+        tile.end   = ijksprite_vtt_time(end);
+        tile.sheet = [self addSheet:url sheets:sheets];
+        tile.rect  = CGRectMake(x, y, w, h);
+        [tiles appendBytes:&tile length:sizeof(tile)];
+        i++;
+    }
+}
+
+static int ijksprite_compare_tiles(const void *a, const void *b)
+{
+    double d = ((const IJKSpriteTile *)a)->start - ((const IJKSpriteTile *)b)->start;
+    return d < 0 ? -1 : d > 0;
+}
+
+- (BOOL)loadTrack
+{
+    NSString *text = [self fetchTextURL:_urlString];
+    NSString *base = _urlString;
+    NSMutableData *tiles = [NSMutableData data];
+
+    if ([text hasPrefix:@"#EXTM3U"] && [text rangeOfString:@"#EXT-X-IMAGE-STREAM-INF:"].location != NSNotFound) {
+        base = [self imageStreamOfMaster:text base:base];
+        text = [self fetchTextURL:base];
+    }
+    if ([text hasPrefix:@"#EXTM3U"])
+        [self parseImagePlaylist:text base:base tiles:tiles];
+    else if ([text hasPrefix:@"WEBVTT"])
+        [self parseWebVTT:text base:base tiles:tiles];
+
+    qsort(tiles.mutableBytes, tiles.length / sizeof(IJKSpriteTile), sizeof(IJKSpriteTile), ijksprite_compare_tiles);
+    @synchronized (self) {
+        [_tiles setData:tiles];
+        return _tiles.length > 0;
+    }
+}
+
+- (void)prefetchWithCompletion:(void (^)(BOOL available))completion
+{
+    @synchronized (self) {
+        if (_prefetchStarted)
+            return;
+        _prefetchStarted = YES;
+        _servicing       = YES;
+    }
+
+    void (^block)(BOOL) = [completion copy];
+    dispatch_async(_queue, ^{
+        BOOL available = !_abortRequest && [self loadTrack];
+        if (block) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                block(available);
+            });
+        }
+        [self serviceSheets];
+    });
+}
+
+@end
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+
+@class IJKFFOptions;
+
+// image is nil when the time could not be decoded or the request was cancelled
+typedef void (^IJKMediaThumbnailHandler)(NSTimeInterval requestedTime,
+                                         NSTimeInterval actualTime,
+                                         UIImage *image);
+
+// Extracts still images of a url apart from any player: a demuxer and a
+// decoder of its own, kept open between requests on a background priority
+// queue, so timeline sprites do not reopen the url for every image.
+//
+// Each image is the key frame at or before the requested time, decoded
+// alone: with VideoToolbox for H.264 and HEVC in mp4 like containers, with
+// the software decoder otherwise. The dns cache, the http pool and the disk
+// cache are the ones of the players, enabled by the same format options.
+@interface IJKMediaThumbnailer : NSObject
+
+// options: the ones the players are created with, only format options are used
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options;
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options;
+
+// images fit in it keeping the display aspect ratio, CGSizeZero for the video size
+@property(atomic) CGSize maximumSize;
+
+// handler is called on the main thread once per time, in ascending time order
+- (void)generateThumbnailsAtTimes:(NSArray<NSNumber *> *)times handler:(IJKMediaThumbnailHandler)handler;
+
+// blocks the calling thread; exact decodes on from the key frame up to time
+- (UIImage *)thumbnailAtTime:(NSTimeInterval)time exact:(BOOL)exact actualTime:(NSTimeInterval *)actualTime;
+
+// pending handlers are called with a nil image
+- (void)cancelAll;
+
+@end
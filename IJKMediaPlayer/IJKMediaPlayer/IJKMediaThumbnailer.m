@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2016 Bilibili
+ * Copyright (c) 2016 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKMediaThumbnailer.h"
+#import "IJKFFOptions.h"
+#import <VideoToolbox/VideoToolbox.h>
+#include "ijkplayer/ios/ijkplayer_ios.h"
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavcodec/slice_pool.h"
+#include "libswscale/swscale.h"
+#include "ijksdl/ios/ijksdl_image_convert.h"
+
+// reading gives up there, e.g. a stream starting far from its first key frame
+#define IJK_THUMB_MAX_PACKETS   600
+
+static void ijkthumb_vtb_output(void *decompressionOutputRefCon, void *sourceFrameRefCon,
+                                OSStatus status, VTDecodeInfoFlags infoFlags,
+                                CVImageBufferRef imageBuffer, CMTime presentationTimeStamp,
+                                CMTime presentationDuration)
+{
+    CVPixelBufferRef *pixelBuffer = (CVPixelBufferRef *)sourceFrameRefCon;
+    if (status == noErr && imageBuffer && !*pixelBuffer)
+        *pixelBuffer = CVPixelBufferRetain(imageBuffer);
+}
+
+static void ijkthumb_release_pixels(void *info, const void *data, size_t size)
+{
+    av_free((void *)data);
+}
+
+@implementation IJKMediaThumbnailer {
+    dispatch_queue_t     _queue;
+    NSString            *_urlString;
+    AVDictionary        *_formatOptions;
+
+    volatile int         _generation;           // bumped by cancelAll
+    volatile int         _runningGeneration;    // of the request on the queue
+
+    // owned by the queue
+    AVFormatContext     *_formatContext;
+    int                  _videoStreamIndex;
+    AVCodecContext      *_codecContext;
+    struct SwsContext   *_swsContext;
+
+    VTDecompressionSessionRef   _vtbSession;
+    CMVideoFormatDescriptionRef _vtbFormat;
+    BOOL                        _vtbUnsupported;
+}
+
+@synthesize maximumSize = _maximumSize;
+
+- (instancetype)initWithContentURL:(NSURL *)aUrl options:(IJKFFOptions *)options
+{
+    if (aUrl == nil)
+        return nil;
+
+    return [self initWithContentURLString:[aUrl isFileURL] ? [aUrl path] : [aUrl absoluteString]
+                                  options:options];
+}
+
+- (instancetype)initWithContentURLString:(NSString *)aUrlString options:(IJKFFOptions *)options
+{
+    if (aUrlString.length == 0)
+        return nil;
+
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("tv.danmaku.ijkplayer.thumbnailer", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        _urlString        = [aUrlString copy];
+        _videoStreamIndex = -1;
+
+        if (!options)
+            options = [IJKFFOptions optionsByDefault];
+        [options applyFormatOptionsTo:&_formatOptions];
+
+        ijkmp_global_init();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // queued blocks retain self, none is left
+    [self close];
+    av_dict_free(&_formatOptions);
+}
+
+#pragma mark requests
+
+- (void)generateThumbnailsAtTimes:(NSArray<NSNumber *> *)times handler:(IJKMediaThumbnailHandler)handler
+{
+    if (times.count == 0 || !handler)
+        return;
+
+    // seeks go forward only, neighbouring times share what was read
+    NSArray *sortedTimes = [times sortedArrayUsingSelector:@selector(compare:)];
+    IJKMediaThumbnailHandler block = [handler copy];
+    CGSize maximumSize = self.maximumSize;
+    int generation = _generation;
+    dispatch_async(_queue, ^{
+        for (NSNumber *time in sortedTimes) {
+            UIImage *image = nil;
+            NSTimeInterval actualTime = -1;
+            if (generation == _generation) {
+                _runningGeneration = generation;
+                @autoreleasepool {
+                    image = [self decodeAtTime:time.doubleValue exact:NO maximumSize:maximumSize actualTime:&actualTime];
+                }
+            }
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                block(time.doubleValue, actualTime, image);
+            });
+        }
+    });
+}
+
+- (UIImage *)thumbnailAtTime:(NSTimeInterval)time exact:(BOOL)exact actualTime:(NSTimeInterval *)actualTime
+{
+    __block UIImage *image = nil;
+    __block NSTimeInterval imageTime = -1;
+    CGSize maximumSize = self.maximumSize;
+    int generation = _generation;
+    dispatch_sync(_queue, ^{
+        if (generation != _generation)
+            return;
+
+        _runningGeneration = generation;
+        image = [self decodeAtTime:time exact:exact maximumSize:maximumSize actualTime:&imageTime];
+    });
+
+    if (actualTime)
+        *actualTime = imageTime;
+    return image;
+}
+
+- (void)cancelAll
+{
+    __sync_add_and_fetch(&_generation, 1);
+}
+
+- (BOOL)isCancelled
+{
+    return _runningGeneration != _generation;
+}
+
+#pragma mark demuxer and decoders, on the queue
+
+static int ijkthumb_interrupt_cb(void *opaque)
+{
+    IJKMediaThumbnailer *thumbnailer = (__bridge IJKMediaThumbnailer *)opaque;
+    return thumbnailer->_runningGeneration != thumbnailer->_generation;
+}
+
+// one client for every thumbnailer, in the background of the players
+static int thumbnailer_slice_pool_client(void)
+{
+    static int             client;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        client = av_slice_pool_client_open();
+        av_slice_pool_client_set_priority(client, AV_SLICE_POOL_BACKGROUND);
+    });
+    return client;
+}
+
+- (BOOL)openIfNeeded
+{
+    if (_formatContext)
+        return YES;
+
+    AVFormatContext *ic = avformat_alloc_context();
+    if (!ic)
+        return NO;
+    ic->interrupt_callback.callback = ijkthumb_interrupt_cb;
+    ic->interrupt_callback.opaque   = (__bridge void *)self;
+
+    AVDictionary *options = NULL;
+    av_dict_copy(&options, _formatOptions, 0);
+    int ret = avformat_open_input(&ic, _urlString.UTF8String, NULL, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        NSLog(@"IJKMediaThumbnailer: failed to open %@: %d\n", _urlString, ret);
+        return NO;
+    }
+
+    AVCodecContext *avctx = NULL;
+    ret = avformat_find_stream_info(ic, NULL);
+    int index = ret < 0 ? ret : av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (index < 0)
+        goto fail;
+
+    // only the video samples are read
+    for (unsigned int i = 0; i < ic->nb_streams; ++i)
+        ic->streams[i]->discard = (int)i == index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    AVCodecParameters *par = ic->streams[index]->codecpar;
+    AVCodec *codec = avcodec_find_decoder(par->codec_id);
+    if (!codec || !(avctx = avcodec_alloc_context3(codec)))
+        goto fail;
+    if (avcodec_parameters_to_context(avctx, par) < 0)
+        goto fail;
+    // frame threads would hold frames back, a single one is decoded at a time;
+    // the slices are decoded on the pool the players share, behind them
+    avctx->thread_type = FF_THREAD_SLICE;
+    avctx->thread_count = 0;
+    avctx->thread_pool = thumbnailer_slice_pool_client();
+    if (avcodec_open2(avctx, codec, NULL) < 0)
+        goto fail;
+
+    _formatContext    = ic;
+    _videoStreamIndex = index;
+    _codecContext     = avctx;
+    return YES;
+
+fail:
+    NSLog(@"IJKMediaThumbnailer: no video to decode in %@\n", _urlString);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return NO;
+}
+
+- (void)close
+{
+    [self closeVideoToolbox];
+    sws_freeContext(_swsContext);
+    _swsContext = NULL;
+    avcodec_free_context(&_codecContext);
+    avformat_close_input(&_formatContext);
+    _videoStreamIndex = -1;
+}
+
+- (BOOL)openVideoToolbox
+{
+    if (_vtbSession)
+        return YES;
+    if (_vtbUnsupported)
+        return NO;
+
+    AVCodecParameters *par = _formatContext->streams[_videoStreamIndex]->codecpar;
+    CMVideoCodecType codecType = 0;
+    NSString *atom = nil;
+    if (par->codec_id == AV_CODEC_ID_H264) {
+        codecType = kCMVideoCodecType_H264;
+        atom      = @"avcC";
+    }
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (par->codec_id == AV_CODEC_ID_HEVC) {
+        if (@available(iOS 11.0, *)) {
+            if (VTIsHardwareDecodeSupported(kCMVideoCodecType_HEVC)) {
+                codecType = kCMVideoCodecType_HEVC;
+                atom      = @"hvcC";
+            }
+        }
+    }
+#endif
+    // annex b streams, e.g. mpegts, have no avcC/hvcC to describe them with
+    if (!atom || par->extradata_size < 7 || par->extradata[0] != 1) {
+        _vtbUnsupported = YES;
+        return NO;
+    }
+
+    NSDictionary *extensions = @{
+        (id)kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms: @{
+            atom: [NSData dataWithBytes:par->extradata length:par->extradata_size],
+        },
+    };
+    OSStatus status = CMVideoFormatDescriptionCreate(kCFAllocatorDefault, codecType, par->width, par->height,
+                                                     (__bridge CFDictionaryRef)extensions, &_vtbFormat);
+    if (status != noErr) {
+        _vtbUnsupported = YES;
+        return NO;
+    }
+
+    NSDictionary *attributes = @{
+        (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+        (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+    };
+    VTDecompressionOutputCallbackRecord callback = { ijkthumb_vtb_output, NULL };
+    status = VTDecompressionSessionCreate(kCFAllocatorDefault, _vtbFormat, NULL,
+                                          (__bridge CFDictionaryRef)attributes, &callback, &_vtbSession);
+    if (status != noErr) {
+        // may succeed later, e.g. once back in foreground
+        NSLog(@"IJKMediaThumbnailer: VTDecompressionSessionCreate failed: %d\n", (int)status);
+        [self closeVideoToolbox];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)closeVideoToolbox
+{
+    if (_vtbSession) {
+        VTDecompressionSessionInvalidate(_vtbSession);
+        CFRelease(_vtbSession);
+        _vtbSession = NULL;
+    }
+    if (_vtbFormat) {
+        CFRelease(_vtbFormat);
+        _vtbFormat = NULL;
+    }
+}
+
+- (CVPixelBufferRef)decodeVideoToolboxPacket:(AVPacket *)pkt CF_RETURNS_RETAINED
+{
+    CMBlockBufferRef  block       = NULL;
+    CMSampleBufferRef sample      = NULL;
+    CVPixelBufferRef  pixelBuffer = NULL;
+    const size_t      sampleSize  = pkt->size;
+
+    OSStatus status = CMBlockBufferCreateWithMemoryBlock(kCFAllocatorDefault, pkt->data, pkt->size, kCFAllocatorNull,
+                                                         NULL, 0, pkt->size, 0, &block);
+    if (status == noErr)
+        status = CMSampleBufferCreate(kCFAllocatorDefault, block, TRUE, NULL, NULL, _vtbFormat,
+                                      1, 0, NULL, 1, &sampleSize, &sample);
+    if (status == noErr) {
+        // synchronous, the output callback is done on return
+        status = VTDecompressionSessionDecodeFrame(_vtbSession, sample, 0, &pixelBuffer, NULL);
+        if (status == noErr)
+            VTDecompressionSessionWaitForAsynchronousFrames(_vtbSession);
+    }
+
+    if (sample)
+        CFRelease(sample);
+    if (block)
+        CFRelease(block);
+
+    if (status != noErr || !pixelBuffer) {
+        // kVTInvalidSessionErr after going to background among others,
+        // the session is created again for the next request
+        [self closeVideoToolbox];
+        if (pixelBuffer)
+            CVPixelBufferRelease(pixelBuffer);
+        return NULL;
+    }
+    return pixelBuffer;
+}
+
+#pragma mark decoding, on the queue
+
+- (UIImage *)decodeAtTime:(NSTimeInterval)time
+                    exact:(BOOL)exact
+              maximumSize:(CGSize)maximumSize
+               actualTime:(NSTimeInterval *)actualTime
+{
+    if (![self openIfNeeded])
+        return nil;
+
+    AVFormatContext *ic = _formatContext;
+    AVStream *st = ic->streams[_videoStreamIndex];
+    int64_t startTime = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    int64_t target    = startTime + (int64_t)(MAX(time, 0) * AV_TIME_BASE);
+
+    // max_ts at target: the key frame at or before it
+    int ret = avformat_seek_file(ic, -1, INT64_MIN, target, target, 0);
+    if (ret < 0)
+        ret = avformat_seek_file(ic, -1, INT64_MIN, target, INT64_MAX, 0);
+    if (ret < 0) {
+        if ([self isCancelled])
+            [self close];
+        return nil;
+    }
+
+    AVCodecContext *avctx = _codecContext;
+    avcodec_flush_buffers(avctx);
+    avctx->skip_frame       = exact ? AVDISCARD_DEFAULT : AVDISCARD_NONKEY;
+    avctx->skip_loop_filter = exact ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    int64_t streamTarget = av_rescale_q(target, AV_TIME_BASE_Q, st->time_base);
+    BOOL useVideoToolbox = !exact && [self openVideoToolbox];
+
+    UIImage *image   = nil;
+    int64_t  pts     = AV_NOPTS_VALUE;
+    AVFrame *frame   = av_frame_alloc();
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    for (int packets = 0; !image && packets < IJK_THUMB_MAX_PACKETS; ++packets) {
+        ret = av_read_frame(ic, &pkt);
+        if (ret < 0)
+            break;
+
+        if (pkt.stream_index != _videoStreamIndex || (!exact && !(pkt.flags & AV_PKT_FLAG_KEY))) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        if (useVideoToolbox) {
+            CVPixelBufferRef pixelBuffer = [self decodeVideoToolboxPacket:&pkt];
+            if (pixelBuffer) {
+                AVRational sar = av_guess_sample_aspect_ratio(ic, st, NULL);
+                image = [self imageWithPixelBuffer:pixelBuffer sar:sar maximumSize:maximumSize];
+                pts   = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+                CVPixelBufferRelease(pixelBuffer);
+                av_packet_unref(&pkt);
+                break;
+            }
+            // decoded in software from this very packet
+            useVideoToolbox = NO;
+        }
+
+        avcodec_send_packet(avctx, &pkt);
+        av_packet_unref(&pkt);
+        image = [self receiveFrame:frame exact:exact streamTarget:streamTarget maximumSize:maximumSize pts:&pts];
+    }
+
+    if (!image && ret == AVERROR_EOF && !useVideoToolbox) {
+        // the frames the decoder still holds, e.g. a target in the last gop
+        avcodec_send_packet(avctx, NULL);
+        image = [self receiveFrame:frame exact:exact streamTarget:streamTarget maximumSize:maximumSize pts:&pts];
+    }
+    av_frame_free(&frame);
+
+    // a network error or a cancel leaves the demuxer somewhere unknown
+    if (ret < 0 && ret != AVERROR_EOF)
+        [self close];
+
+    if (image && pts != AV_NOPTS_VALUE && actualTime)
+        *actualTime = pts * av_q2d(st->time_base) - (double)startTime / AV_TIME_BASE;
+    return image;
+}
+
+- (UIImage *)receiveFrame:(AVFrame *)frame
+                    exact:(BOOL)exact
+             streamTarget:(int64_t)streamTarget
+              maximumSize:(CGSize)maximumSize
+                      pts:(int64_t *)pts
+{
+    while (avcodec_receive_frame(_codecContext, frame) >= 0) {
+        int64_t framePts = av_frame_get_best_effort_timestamp(frame);
+        // the frame on screen at target
+        if (!exact || framePts == AV_NOPTS_VALUE || framePts + MAX(frame->pkt_duration, 1) > streamTarget) {
+            AVRational sar = av_guess_sample_aspect_ratio(_formatContext, _formatContext->streams[_videoStreamIndex], frame);
+            UIImage *image = [self imageWithData:frame->data
+                                        linesize:frame->linesize
+                                          format:frame->format
+                                           width:frame->width
+                                          height:frame->height
+                                       fullRange:frame->format == AV_PIX_FMT_YUVJ420P || frame->color_range == AVCOL_RANGE_JPEG
+                                           bt709:frame->colorspace == AVCOL_SPC_BT709
+                                             sar:sar
+                                     maximumSize:maximumSize];
+            *pts = framePts;
+            av_frame_unref(frame);
+            return image;
+        }
+        av_frame_unref(frame);
+    }
+    return nil;
+}
+
+#pragma mark scaling
+
+- (UIImage *)imageWithPixelBuffer:(CVPixelBufferRef)pixelBuffer sar:(AVRational)sar maximumSize:(CGSize)maximumSize
+{
+    CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+    uint8_t *data[4] = {
+        CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0),
+        CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1),
+    };
+    int linesize[4] = {
+        (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0),
+        (int)CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1),
+    };
+    CFTypeRef matrix = CVBufferGetAttachment(pixelBuffer, kCVImageBufferYCbCrMatrixKey, NULL);
+    UIImage *image = [self imageWithData:data
+                                linesize:linesize
+                                  format:AV_PIX_FMT_NV12
+                                   width:(int)CVPixelBufferGetWidth(pixelBuffer)
+                                  height:(int)CVPixelBufferGetHeight(pixelBuffer)
+                               fullRange:CVPixelBufferGetPixelFormatType(pixelBuffer) == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange
+                                   bt709:matrix && CFEqual(matrix, kCVImageBufferYCbCrMatrix_ITU_R_709_2)
+                                     sar:sar
+                             maximumSize:maximumSize];
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+    return image;
+}
+
+// scaled and converted at once: 4:2:0 by ijk_image_yuv420_to_bgra, NEON on
+// arm, the other formats by swscale
+- (UIImage *)imageWithData:(uint8_t **)data
+                  linesize:(int *)linesize
+                    format:(int)format
+                     width:(int)width
+                    height:(int)height
+                 fullRange:(BOOL)fullRange
+                     bt709:(BOOL)bt709
+                       sar:(AVRational)sar
+               maximumSize:(CGSize)maximumSize
+{
+    if (width <= 0 || height <= 0)
+        return nil;
+
+    CGFloat displayWidth = width;
+    if (sar.num > 0 && sar.den > 0)
+        displayWidth = width * (CGFloat)sar.num / sar.den;
+    CGFloat scale = 1.0f;
+    if (maximumSize.width > 0 && maximumSize.height > 0)
+        scale = MIN(1.0f, MIN(maximumSize.width / displayWidth, maximumSize.height / height));
+    int dstWidth  = MAX((int)lround(displayWidth * scale) & ~1, 2);
+    int dstHeight = MAX((int)lround(height * scale) & ~1, 2);
+
+    int dstLinesize = FFALIGN(dstWidth * 4, 16);
+    uint8_t *pixels = av_malloc(dstLinesize * dstHeight);
+    if (!pixels)
+        return nil;
+
+    if (format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P) {
+        IJKYUV420Image src = {
+            .data       = { data[0], data[1], data[2] },
+            .linesize   = { linesize[0], linesize[1], linesize[2] },
+            .width      = width,
+            .height     = height,
+            .nv12       = format == AV_PIX_FMT_NV12,
+            .full_range = fullRange,
+            .bt709      = bt709,
+        };
+        if (ijk_image_yuv420_to_bgra(&src, pixels, dstLinesize, dstWidth, dstHeight) < 0) {
+            av_free(pixels);
+            return nil;
+        }
+    } else {
+        _swsContext = sws_getCachedContext(_swsContext,
+                                           width, height, format,
+                                           dstWidth, dstHeight, AV_PIX_FMT_BGRA,
+                                           SWS_BILINEAR, NULL, NULL, NULL);
+        if (!_swsContext) {
+            av_free(pixels);
+            return nil;
+        }
+
+        uint8_t *dstData[4]      = { pixels };
+        int      dstLinesizes[4] = { dstLinesize };
+        sws_scale(_swsContext, (const uint8_t *const *)data, linesize, 0, height, dstData, dstLinesizes);
+    }
+
+    CGDataProviderRef provider   = CGDataProviderCreateWithData(NULL, pixels, dstLinesize * dstHeight, ijkthumb_release_pixels);
+    CGColorSpaceRef   colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef        cgImage    = CGImageCreate(dstWidth, dstHeight, 8, 32, dstLinesize, colorSpace,
+                                                 kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst,
+                                                 provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+
+    UIImage *image = nil;
+    if (cgImage) {
+        image = [UIImage imageWithCGImage:cgImage];
+        CGImageRelease(cgImage);
+    }
+    return image;
+}
+
+@end
@@ -0,0 +1,42 @@
+/*
+ * IJKNetworkMonitor.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+
+// posted on the main thread when the interface changes
+extern NSString *const IJKNetworkMonitorInterfaceDidChangeNotification;
+
+// Forgets what the process learned of the network when the device moves to
+// another one: the throughput and round trip time new sessions start from,
+// see sharedThroughputEstimate of IJKFFOptions. Tells the changes of the
+// interface the default route goes through, Wi-Fi or cellular, and of
+// reachability; two Wi-Fi networks in a row look the same.
+@interface IJKNetworkMonitor : NSObject
+
+// once, by the first player
++ (void)start;
+
+// the default route goes through cellular, NO before the first flags
++ (BOOL)isCellular;
+
+@end
@@ -0,0 +1,87 @@
+/*
+ * IJKNetworkMonitor.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKNetworkMonitor.h"
+#import <SystemConfiguration/SystemConfiguration.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include "libavformat/throughput.h"
+
+// the flags telling one network from another
+static const SCNetworkReachabilityFlags kIJKNetworkFlagsMask =
+    kSCNetworkReachabilityFlagsReachable | kSCNetworkReachabilityFlagsIsWWAN;
+
+NSString *const IJKNetworkMonitorInterfaceDidChangeNotification = @"IJKNetworkMonitorInterfaceDidChangeNotification";
+
+static SCNetworkReachabilityRef g_reachability;
+static atomic_uint              g_flags;    // written on the queue, read by any thread
+
+static void IJKNetworkMonitorCallback(SCNetworkReachabilityRef target, SCNetworkReachabilityFlags flags, void *info)
+{
+    flags &= kIJKNetworkFlagsMask;
+    SCNetworkReachabilityFlags former = atomic_load(&g_flags);
+    if (flags == former)
+        return;
+
+    NSLog(@"IJKNetworkMonitor: network changed 0x%x -> 0x%x, throughput estimate reset\n",
+          (unsigned)former, (unsigned)flags);
+    atomic_store(&g_flags, flags);
+    av_throughput_reset();
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:IJKNetworkMonitorInterfaceDidChangeNotification object:nil];
+    });
+}
+
+@implementation IJKNetworkMonitor
+
++ (void)start
+{
+    static dispatch_once_t sOnceToken = 0;
+    dispatch_once(&sOnceToken, ^{
+        struct sockaddr_in address = {0};
+        address.sin_len    = sizeof(address);
+        address.sin_family = AF_INET;
+
+        g_reachability = SCNetworkReachabilityCreateWithAddress(kCFAllocatorDefault, (const struct sockaddr *)&address);
+        if (!g_reachability)
+            return;
+
+        // the callbacks on one serial queue, after the flags of now
+        dispatch_queue_t queue = dispatch_queue_create("tv.danmaku.ijk.network", DISPATCH_QUEUE_SERIAL);
+        dispatch_async(queue, ^{
+            SCNetworkReachabilityFlags flags = 0;
+            if (SCNetworkReachabilityGetFlags(g_reachability, &flags))
+                atomic_store(&g_flags, flags & kIJKNetworkFlagsMask);
+        });
+        if (!SCNetworkReachabilitySetCallback(g_reachability, IJKNetworkMonitorCallback, NULL) ||
+            !SCNetworkReachabilitySetDispatchQueue(g_reachability, queue))
+            NSLog(@"IJKNetworkMonitor: network changes not monitored\n");
+    });
+}
+
++ (BOOL)isCellular
+{
+    return (atomic_load(&g_flags) & kIJKNetworkFlagsMask) == kIJKNetworkFlagsMask;
+}
+
+@end
@@ -22,10 +22,92 @@
  */
 
 #include "ijkplayer/ijkplayer.h"
+#include "pipeline/ffpipenode_ios_benchmark_vdec.h"
+#include "pipeline/ffpipeline_ios_props.h"
+#include "pipeline/ffpipeline_ios_buffering.h"
+#include "ijksdl/ios/ijksdl_audio_analysis.h"
+#include "ijksdl/ios/ijksdl_sync_probe.h"
 #import "IJKSDLGLView.h"
+#import "IJKSDLMetalView.h"
+#import "IJKSDLSampleBufferView.h"
+
+struct AVDictionary;
 
 // ref_count is 1 after open
 IjkMediaPlayer *ijkmp_ios_create(int (*msg_loop)(void*));
+// same as ijkmp_ios_create, but presents through a IJKSDLMetalView
+IjkMediaPlayer *ijkmp_ios_create_for_metal(int (*msg_loop)(void*));
+// same as ijkmp_ios_create, but enqueues into a IJKSDLSampleBufferView
+IjkMediaPlayer *ijkmp_ios_create_for_sample_buffer(int (*msg_loop)(void*));
 
 void            ijkmp_ios_set_glview(IjkMediaPlayer *mp, IJKSDLGLView *glView);
+void            ijkmp_ios_set_metal_view(IjkMediaPlayer *mp, IJKSDLMetalView *metalView);
+void            ijkmp_ios_set_sample_buffer_view(IjkMediaPlayer *mp, IJKSDLSampleBufferView *sampleBufferView);
+// views of any kind the frames are also shown in, see ijksdl_vout_ios_outputs.h
+void            ijkmp_ios_set_render_outputs(IjkMediaPlayer *mp, NSArray *views);
 bool            ijkmp_ios_is_videotoolbox_open(IjkMediaPlayer *mp);
+// the options of every category at once, under one lock; dicts indexed by
+// IJKMP_OPT_CATEGORY_*, NULL entries skipped. Same as ijkmp_set_option on
+// each entry
+void            ijkmp_ios_set_option_dicts(IjkMediaPlayer *mp, struct AVDictionary *const *dicts);
+// decode key frames only while scrubbing
+void            ijkmp_ios_set_keyframes_only(IjkMediaPlayer *mp, bool keyframes_only);
+// load adaptive degradation of the software decoder, see ffpipeline_ios.h
+void            ijkmp_ios_set_decode_degradation(IjkMediaPlayer *mp, int level);
+// software decoding behind the players in the foreground, see ffpipeline_ios.h
+void            ijkmp_ios_set_decode_background(IjkMediaPlayer *mp, bool background);
+// for the "thread_pool" codec option, see ffpipeline_ios.h
+int             ijkmp_ios_get_slice_pool_client(IjkMediaPlayer *mp);
+// pixels of the view, for the output size of VideoToolbox, see ffpipeline_ios.h
+void            ijkmp_ios_set_video_output_size(IjkMediaPlayer *mp, int width, int height);
+// frames VideoToolbox did not decode on the way to the last accurate seek target
+int             ijkmp_ios_get_seek_skipped_frames(IjkMediaPlayer *mp);
+int64_t         ijkmp_ios_get_decimated_frames(IjkMediaPlayer *mp);
+// SDL_GetTickHR() of the first packet VideoToolbox took, 0 before
+int64_t         ijkmp_ios_get_first_packet_tick(IjkMediaPlayer *mp);
+// output pixel buffers VideoToolbox allocated, in total and at steady state
+void            ijkmp_ios_get_pixel_buffer_allocations(IjkMediaPlayer *mp, int64_t *total, int64_t *steady);
+// memory accounting and shedding, see ffpipeline_ios.h
+int64_t         ijkmp_ios_get_decoder_buffered_bytes(IjkMediaPlayer *mp);
+int64_t         ijkmp_ios_get_frame_queue_bytes(IjkMediaPlayer *mp);
+void            ijkmp_ios_set_frame_queue_limit(IjkMediaPlayer *mp, int limit);
+void            ijkmp_ios_set_frame_queue_budget(IjkMediaPlayer *mp, int64_t bytes);
+int             ijkmp_ios_get_frame_queue_depth(IjkMediaPlayer *mp);
+// player option "dynamic-buffering", see ffpipeline_ios_buffering.h
+void            ijkmp_ios_update_buffering(IjkMediaPlayer *mp, bool rebuffer);
+bool            ijkmp_ios_get_buffering(IjkMediaPlayer *mp, FFBufferingThresholds *thresholds);
+void            ijkmp_ios_set_max_buffer_size(IjkMediaPlayer *mp, int bytes);
+// player option "decoder-benchmark", see ffpipenode_ios_benchmark_vdec.h;
+// -1 when off or before the video decoder opened
+int             ijkmp_ios_get_decoder_benchmark_result(IjkMediaPlayer *mp, FFDecoderBenchmarkResult *result);
+// spectrum and loudness of the audio output, see ffpipeline_ios.h; false
+// before the first spectrum, or without the analysis
+void            ijkmp_ios_set_audio_analysis(IjkMediaPlayer *mp, bool enabled, float loudness_target);
+bool            ijkmp_ios_get_audio_analysis(IjkMediaPlayer *mp, IJKAudioAnalysisResult *result);
+// the audio side of an A/V sync probe, see ffpipeline_ios_set_sync_probe();
+// before prepareAsync
+void            ijkmp_ios_set_sync_probe(IjkMediaPlayer *mp, IJKSyncProbe *probe);
+// the rate of the audio output and the one of the hardware, which differ
+// when the system resamples, see SDL_AoutIos_SetMatchSampleRate(); false
+// before the audio output opened
+bool            ijkmp_ios_get_audio_sample_rates(IjkMediaPlayer *mp, int *source_rate, int *output_rate);
+// the hot properties without the player mutex, see ffpipeline_ios_props.h;
+// never blocks, false before the first sample. The caller holds a
+// reference to mp
+bool            ijkmp_ios_get_property_snapshot(IjkMediaPlayer *mp, FFPropertySnapshot *snapshot);
+// the hot properties sampled under the player mutex by a thread of the
+// pipeline, from the message loop thread as it starts and ends, which
+// holds a reference to mp in between
+void            ijkmp_ios_start_property_publisher(IjkMediaPlayer *mp);
+void            ijkmp_ios_stop_property_publisher(IjkMediaPlayer *mp);
+// SEI timed metadata, see ffpipeline_ios_timed_metadata.h. take is
+// called with the time of each frame presented, from the render thread, and
+// only takes the player mutex when there is any; NULL if none is due. The
+// caller holds a reference to mp
+void            ijkmp_ios_set_timed_metadata(IjkMediaPlayer *mp, bool enabled);
+CFArrayRef      ijkmp_ios_take_timed_metadata(IjkMediaPlayer *mp, double time);
+// a VideoToolbox session kept for the next player, see videotoolbox_warmup()
+void            ijkmp_ios_videotoolbox_warmup(int width, int height);
+void            ijkmp_ios_videotoolbox_warmup_release(void);
+// the player the pipeline signposts name, see ijksdl_trace_ios.h
+const void     *ijkmp_ios_get_trace_player(IjkMediaPlayer *mp);
@@ -32,14 +32,15 @@
 #include "ijkplayer/ijkplayer_internal.h"
 #include "ijkplayer/pipeline/ffpipeline_ffplay.h"
 #include "pipeline/ffpipeline_ios.h"
+#include "pipeline/IJKVideoToolBoxDecoder.h"
 
-IjkMediaPlayer *ijkmp_ios_create(int (*msg_loop)(void*))
+static IjkMediaPlayer *ijkmp_ios_create_with_vout(int (*msg_loop)(void*), SDL_Vout *(*create_vout)())
 {
     IjkMediaPlayer *mp = ijkmp_create(msg_loop);
     if (!mp)
         goto fail;
 
-    mp->ffplayer->vout = SDL_VoutIos_CreateForGLES2();
+    mp->ffplayer->vout = create_vout();
     if (!mp->ffplayer->vout)
         goto fail;
 
@@ -54,6 +55,21 @@ fail:
     return NULL;
 }
 
+IjkMediaPlayer *ijkmp_ios_create(int (*msg_loop)(void*))
+{
+    return ijkmp_ios_create_with_vout(msg_loop, SDL_VoutIos_CreateForGLES2);
+}
+
+IjkMediaPlayer *ijkmp_ios_create_for_metal(int (*msg_loop)(void*))
+{
+    return ijkmp_ios_create_with_vout(msg_loop, SDL_VoutIos_CreateForMetal);
+}
+
+IjkMediaPlayer *ijkmp_ios_create_for_sample_buffer(int (*msg_loop)(void*))
+{
+    return ijkmp_ios_create_with_vout(msg_loop, SDL_VoutIos_CreateForSampleBuffer);
+}
+
 void ijkmp_ios_set_glview_l(IjkMediaPlayer *mp, IJKSDLGLView *glView)
 {
     assert(mp);
@@ -73,6 +89,54 @@ void ijkmp_ios_set_glview(IjkMediaPlayer *mp, IJKSDLGLView *glView)
     MPTRACE("ijkmp_ios_set_view(glView=%p)=void\n", (void*)glView);
 }
 
+void ijkmp_ios_set_metal_view_l(IjkMediaPlayer *mp, IJKSDLMetalView *metalView)
+{
+    assert(mp);
+    assert(mp->ffplayer);
+    assert(mp->ffplayer->vout);
+
+    SDL_VoutIos_SetMetalView(mp->ffplayer->vout, metalView);
+}
+
+void ijkmp_ios_set_metal_view(IjkMediaPlayer *mp, IJKSDLMetalView *metalView)
+{
+    assert(mp);
+    MPTRACE("ijkmp_ios_set_metal_view(metalView=%p)\n", (void*)metalView);
+    pthread_mutex_lock(&mp->mutex);
+    ijkmp_ios_set_metal_view_l(mp, metalView);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("ijkmp_ios_set_metal_view(metalView=%p)=void\n", (void*)metalView);
+}
+
+void ijkmp_ios_set_sample_buffer_view_l(IjkMediaPlayer *mp, IJKSDLSampleBufferView *sampleBufferView)
+{
+    assert(mp);
+    assert(mp->ffplayer);
+    assert(mp->ffplayer->vout);
+
+    SDL_VoutIos_SetSampleBufferView(mp->ffplayer->vout, sampleBufferView);
+}
+
+void ijkmp_ios_set_sample_buffer_view(IjkMediaPlayer *mp, IJKSDLSampleBufferView *sampleBufferView)
+{
+    assert(mp);
+    MPTRACE("ijkmp_ios_set_sample_buffer_view(sampleBufferView=%p)\n", (void*)sampleBufferView);
+    pthread_mutex_lock(&mp->mutex);
+    ijkmp_ios_set_sample_buffer_view_l(mp, sampleBufferView);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("ijkmp_ios_set_sample_buffer_view(sampleBufferView=%p)=void\n", (void*)sampleBufferView);
+}
+
+void ijkmp_ios_set_render_outputs(IjkMediaPlayer *mp, NSArray *views)
+{
+    assert(mp);
+    MPTRACE("ijkmp_ios_set_render_outputs(views=%d)\n", (int)views.count);
+    pthread_mutex_lock(&mp->mutex);
+    SDL_VoutIos_SetOutputs(mp->ffplayer->vout, views);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("ijkmp_ios_set_render_outputs()=void\n");
+}
+
 bool ijkmp_ios_is_videotoolbox_open_l(IjkMediaPlayer *mp)
 {
     assert(mp);
@@ -91,3 +155,282 @@ bool ijkmp_ios_is_videotoolbox_open(IjkMediaPlayer *mp)
     MPTRACE("%s()=%d\n", __func__, ret ? 1 : 0);
     return ret;
 }
+
+void ijkmp_ios_set_keyframes_only(IjkMediaPlayer *mp, bool keyframes_only)
+{
+    assert(mp);
+    MPTRACE("%s(%d)\n", __func__, keyframes_only ? 1 : 0);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_keyframes_only(mp->ffplayer->pipeline, keyframes_only);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_option_dicts(IjkMediaPlayer *mp, AVDictionary *const *dicts)
+{
+    assert(mp);
+    MPTRACE("%s()\n", __func__);
+    pthread_mutex_lock(&mp->mutex);
+    FFPlayer *ffp = mp->ffplayer;
+    av_dict_copy(&ffp->format_opts, dicts[IJKMP_OPT_CATEGORY_FORMAT], 0);
+    av_dict_copy(&ffp->codec_opts,  dicts[IJKMP_OPT_CATEGORY_CODEC],  0);
+    av_dict_copy(&ffp->sws_dict,    dicts[IJKMP_OPT_CATEGORY_SWS],    0);
+    av_dict_copy(&ffp->player_opts, dicts[IJKMP_OPT_CATEGORY_PLAYER], 0);
+    av_dict_copy(&ffp->swr_opts,    dicts[IJKMP_OPT_CATEGORY_SWR],    0);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_decode_degradation(IjkMediaPlayer *mp, int level)
+{
+    assert(mp);
+    MPTRACE("%s(%d)\n", __func__, level);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_decode_degradation(mp->ffplayer->pipeline, level);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_video_output_size(IjkMediaPlayer *mp, int width, int height)
+{
+    assert(mp);
+    MPTRACE("%s(%d, %d)\n", __func__, width, height);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_video_output_size(mp->ffplayer->pipeline, width, height);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_decode_background(IjkMediaPlayer *mp, bool background)
+{
+    assert(mp);
+    MPTRACE("%s(%d)\n", __func__, background ? 1 : 0);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_decode_background(mp->ffplayer->pipeline, background);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+int ijkmp_ios_get_slice_pool_client(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    MPTRACE("%s()\n", __func__);
+    pthread_mutex_lock(&mp->mutex);
+    int client = ffpipeline_ios_get_slice_pool_client(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=%d\n", __func__, client);
+    return client;
+}
+
+int ijkmp_ios_get_seek_skipped_frames(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int ret = ffpipeline_ios_get_seek_skipped_frames(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+int64_t ijkmp_ios_get_decimated_frames(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int64_t ret = ffpipeline_ios_get_decimated_frames(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+int64_t ijkmp_ios_get_first_packet_tick(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int64_t ret = ffpipeline_ios_get_first_packet_tick(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+void ijkmp_ios_get_pixel_buffer_allocations(IjkMediaPlayer *mp, int64_t *total, int64_t *steady)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_get_pixel_buffer_allocations(mp->ffplayer->pipeline, total, steady);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+int64_t ijkmp_ios_get_decoder_buffered_bytes(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int64_t ret = ffpipeline_ios_get_decoder_buffered_bytes(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+int64_t ijkmp_ios_get_frame_queue_bytes(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int64_t ret = ffpipeline_ios_get_frame_queue_bytes(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+void ijkmp_ios_set_frame_queue_limit(IjkMediaPlayer *mp, int limit)
+{
+    assert(mp);
+    MPTRACE("%s(%d)\n", __func__, limit);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_frame_queue_limit(mp->ffplayer->pipeline, limit);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_frame_queue_budget(IjkMediaPlayer *mp, int64_t bytes)
+{
+    assert(mp);
+    MPTRACE("%s(%lld)\n", __func__, (long long)bytes);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_frame_queue_budget(mp->ffplayer->pipeline, bytes);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+int ijkmp_ios_get_frame_queue_depth(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int ret = ffpipeline_ios_get_frame_queue_depth(mp->ffplayer->pipeline);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+void ijkmp_ios_update_buffering(IjkMediaPlayer *mp, bool rebuffer)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_update_buffering(mp->ffplayer->pipeline, rebuffer);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+bool ijkmp_ios_get_buffering(IjkMediaPlayer *mp, FFBufferingThresholds *thresholds)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    bool ret = ffpipeline_ios_get_buffering(mp->ffplayer->pipeline, thresholds);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+void ijkmp_ios_set_max_buffer_size(IjkMediaPlayer *mp, int bytes)
+{
+    assert(mp);
+    MPTRACE("%s(%d)\n", __func__, bytes);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_max_buffer_size(mp->ffplayer->pipeline, bytes);
+    pthread_mutex_unlock(&mp->mutex);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+int ijkmp_ios_get_decoder_benchmark_result(IjkMediaPlayer *mp, FFDecoderBenchmarkResult *result)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    int ret = ffpipeline_ios_get_decoder_benchmark_result(mp->ffplayer->pipeline, result);
+    pthread_mutex_unlock(&mp->mutex);
+    return ret;
+}
+
+void ijkmp_ios_set_audio_analysis(IjkMediaPlayer *mp, bool enabled, float loudness_target)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_audio_analysis(mp->ffplayer->pipeline, enabled, loudness_target);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+void ijkmp_ios_set_sync_probe(IjkMediaPlayer *mp, IJKSyncProbe *probe)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_sync_probe(mp->ffplayer->pipeline, probe);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+bool ijkmp_ios_get_audio_analysis(IjkMediaPlayer *mp, IJKAudioAnalysisResult *result)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    bool got = SDL_AoutIos_GetAudioAnalysis(mp->ffplayer->aout, result);
+    pthread_mutex_unlock(&mp->mutex);
+    return got;
+}
+
+bool ijkmp_ios_get_audio_sample_rates(IjkMediaPlayer *mp, int *source_rate, int *output_rate)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    bool got = SDL_AoutIos_GetSampleRates(mp->ffplayer->aout, source_rate, output_rate);
+    pthread_mutex_unlock(&mp->mutex);
+    return got;
+}
+
+bool ijkmp_ios_get_property_snapshot(IjkMediaPlayer *mp, FFPropertySnapshot *snapshot)
+{
+    assert(mp);
+    // the pipeline lives as long as the player
+    return ffpipeline_ios_read_properties(mp->ffplayer->pipeline, snapshot);
+}
+
+void ijkmp_ios_start_property_publisher(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    MPTRACE("%s()\n", __func__);
+    if (ffpipeline_ios_start_publishing_properties(mp->ffplayer->pipeline, &mp->mutex) < 0)
+        ALOGE("%s: failed to start the publisher\n", __func__);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_stop_property_publisher(IjkMediaPlayer *mp)
+{
+    assert(mp);
+    MPTRACE("%s()\n", __func__);
+    // the publisher takes the mutex, it is not held here
+    ffpipeline_ios_stop_publishing_properties(mp->ffplayer->pipeline);
+    MPTRACE("%s()=void\n", __func__);
+}
+
+void ijkmp_ios_set_timed_metadata(IjkMediaPlayer *mp, bool enabled)
+{
+    assert(mp);
+    pthread_mutex_lock(&mp->mutex);
+    ffpipeline_ios_set_timed_metadata(mp->ffplayer->pipeline, enabled);
+    pthread_mutex_unlock(&mp->mutex);
+}
+
+CFArrayRef ijkmp_ios_take_timed_metadata(IjkMediaPlayer *mp, double time)
+{
+    assert(mp);
+    // the pipeline lives as long as the player
+    if (!ffpipeline_ios_has_timed_metadata(mp->ffplayer->pipeline))
+        return NULL;
+
+    pthread_mutex_lock(&mp->mutex);
+    CFArrayRef metadata = ffpipeline_ios_take_timed_metadata(mp->ffplayer, time);
+    pthread_mutex_unlock(&mp->mutex);
+    return metadata;
+}
+
+void ijkmp_ios_videotoolbox_warmup(int width, int height)
+{
+    videotoolbox_warmup(width, height);
+}
+
+void ijkmp_ios_videotoolbox_warmup_release(void)
+{
+    videotoolbox_warmup_release();
+}
+
+const void *ijkmp_ios_get_trace_player(IjkMediaPlayer *mp)
+{
+    return mp ? mp->ffplayer : NULL;
+}
@@ -37,6 +37,8 @@ struct Ijk_VideoToolBox {
     void (*free)(Ijk_VideoToolBox_Opaque *opaque);
 };
 
+// picks sync or async scheduling, see Ijk_VideoToolbox_Create in IJKVideoToolBox.m
+Ijk_VideoToolBox *Ijk_VideoToolbox_Create(FFPlayer* ffp, AVCodecContext* ic);
 Ijk_VideoToolBox *Ijk_VideoToolbox_Async_Create(FFPlayer* ffp, AVCodecContext* ic);
 Ijk_VideoToolBox *Ijk_VideoToolbox_Sync_Create(FFPlayer* ffp, AVCodecContext* ic);
 
@@ -23,23 +23,23 @@
 
 #include "IJKVideoToolBox.h"
 #include "ijksdl/ijksdl_inc_internal.h"
-#include "IJKVideoToolBoxAsync.h"
-#include "IJKVideoToolBoxSync.h"
+#include "IJKVideoToolBoxDecoder.h"
+#include "ffpipeline_ios.h"
+#import "IJKDeviceModel.h"
+
+// player option "videotoolbox-mode"
+#define IJK_VTB_MODE_AUTO   0
+#define IJK_VTB_MODE_SYNC   1
+#define IJK_VTB_MODE_ASYNC  2
 
 inline static Ijk_VideoToolBox *Ijk_VideoToolbox_CreateInternal(int async, FFPlayer* ffp, AVCodecContext* ic)
 {
     Ijk_VideoToolBox *vtb = (Ijk_VideoToolBox*) mallocz(sizeof(Ijk_VideoToolBox));
     if (!vtb)
         return NULL;
-    if (async) {
-        vtb->opaque = videotoolbox_async_create(ffp, ic);
-        vtb->decode_frame = videotoolbox_async_decode_frame;
-        vtb->free = videotoolbox_async_free;
-    } else {
-        vtb->opaque = videotoolbox_sync_create(ffp, ic);
-        vtb->decode_frame = videotoolbox_sync_decode_frame;
-        vtb->free = videotoolbox_sync_free;
-    }
+    vtb->opaque = videotoolbox_decoder_create(ffp, ic, async);
+    vtb->decode_frame = videotoolbox_decoder_decode_frame;
+    vtb->free = videotoolbox_decoder_free;
 
     if (!vtb->opaque) {
         freep((void **)&vtb);
@@ -48,6 +48,31 @@ inline static Ijk_VideoToolBox *Ijk_VideoToolbox_CreateInternal(int async, FFPla
     return vtb;
 }
 
+// "videotoolbox-async" still forces async, otherwise pipelining pays off from A8 on,
+// while older devices lose more to the extra frames in flight than they gain
+Ijk_VideoToolBox *Ijk_VideoToolbox_Create(FFPlayer* ffp, AVCodecContext* ic) {
+    int async = 0;
+
+    if (ffp->vtb_async) {
+        async = 1;
+    } else {
+        switch (ffpipeline_ios_get_option_int(ffp, "videotoolbox-mode", IJK_VTB_MODE_AUTO)) {
+            case IJK_VTB_MODE_SYNC:
+                async = 0;
+                break;
+            case IJK_VTB_MODE_ASYNC:
+                async = 1;
+                break;
+            default:
+                async = [IJKDeviceModel currentModel].rank >= kIJKDeviceRank_AppleA8Class;
+                break;
+        }
+    }
+
+    ALOGI("%s: %s mode\n", __FUNCTION__, async ? "async" : "sync");
+    return Ijk_VideoToolbox_CreateInternal(async, ffp, ic);
+}
+
 Ijk_VideoToolBox *Ijk_VideoToolbox_Async_Create(FFPlayer* ffp, AVCodecContext* ic) {
     return Ijk_VideoToolbox_CreateInternal(1, ffp, ic);
 }
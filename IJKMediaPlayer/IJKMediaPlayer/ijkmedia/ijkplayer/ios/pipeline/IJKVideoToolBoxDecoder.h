@@ -0,0 +1,49 @@
+/*****************************************************************************
+ * IJKVideoToolBox.h
+ *****************************************************************************
+ *
+ * copyright (c) 2014 Zhou Quan <zhouqicy@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKMediaPlayer_videotoolbox_decoder_h
+#define IJKMediaPlayer_videotoolbox_decoder_h
+
+#include "ff_ffplay.h"
+
+typedef struct Ijk_VideoToolBox_Opaque Ijk_VideoToolBox_Opaque;
+
+// async only changes how frames are scheduled on the session:
+// several samples in flight with asynchronous decompression,
+// or a single sample decoded inside VTDecompressionSessionDecodeFrame
+Ijk_VideoToolBox_Opaque* videotoolbox_decoder_create(FFPlayer* ffp, AVCodecContext* ic, bool async);
+
+int videotoolbox_decoder_decode_frame(Ijk_VideoToolBox_Opaque* opaque);
+
+void videotoolbox_decoder_free(Ijk_VideoToolBox_Opaque* opaque);
+
+// Create a session for H.264 of width x height in background and keep it
+// for 30 seconds, so the next player of such a stream adopts it
+// when it accepts its format description instead of paying the creation
+// and the spin up of the decoder before its first picture. One at a time,
+// a call for another size replaces it; a call for the same one keeps it
+// longer.
+void videotoolbox_warmup(int width, int height);
+void videotoolbox_warmup_release(void);
+
+#endif
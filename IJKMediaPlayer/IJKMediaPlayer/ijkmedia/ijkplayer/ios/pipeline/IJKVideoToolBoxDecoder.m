@@ -0,0 +1,2367 @@
+/*****************************************************************************
+ * IJKVideoToolBox.m
+ *****************************************************************************
+ *
+ * copyright (c) 2014 Zhou Quan <zhouqicy@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "IJKVideoToolBoxDecoder.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#include "ffpipeline_ios.h"
+#include <mach/mach_time.h>
+#include "libavformat/avc.h"
+#include "libavformat/hevc.h"
+#include "ijksdl_vout_ios_gles2.h"
+#include "h264_sps_parser.h"
+#include "ffpipeline_ios_vdec_caps.h"
+#include "h264_ps_writer.h"
+#include "ijkplayer/ff_ffplay_debug.h"
+#import <CoreMedia/CoreMedia.h>
+#import <CoreFoundation/CoreFoundation.h>
+#import <CoreVideo/CVHostTime.h>
+#import <Foundation/Foundation.h>
+#import "IJKDeviceModel.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#import <VideoToolbox/VideoToolbox.h>
+#include "ff_ffinc.h"
+#include "ff_fferror.h"
+#include "ff_ffmsg.h"
+#include "ijksdl/ios/ijksdl_vout_overlay_videotoolbox.h"
+#include "ijksdl/ios/ijksdl_trace_ios.h"
+#include "ijksdl/ios/ijksdl_evlog_ios.h"
+#import "ijksdl/ios/IJKSDLFrameLatency.h"
+
+#define IJK_VTB_FCC_AVCC   SDL_FOURCC('C', 'c', 'v', 'a')
+#define IJK_VTB_FCC_HVCC   SDL_FOURCC('C', 'c', 'v', 'h')
+
+#define MAX_PKT_QUEUE_DEEP   350
+#define MAX_PKT_QUEUE_BYTES  (16 * 1024 * 1024)
+// capacity of sample_info_array, "videotoolbox-max-decoding-samples" is clamped to it
+#define VTB_MAX_DECODING_SAMPLES      16
+#define VTB_DEFAULT_DECODING_SAMPLES  3
+
+// every sample in flight ends with a callback which signals sample_info_cond,
+// the timeout only lets a wait notice abort_request if VideoToolbox stalls
+#define VTB_SAMPLE_WAIT_WATCHDOG_MS   200
+// the decodes left once the session is invalidated, on free
+#define VTB_FREE_FLUSH_MS             500
+// output widths scaled to the view are rounded up to it, so that a layout
+// animation does not renegotiate the session on every key frame
+#define VTB_OUTPUT_WIDTH_ALIGN        64
+
+// time blocked in sample_info_peek per frame, bucket i counts waits below 2^i ms
+#define VTB_BLOCKED_HISTOGRAM_SIZE    8
+#define VTB_BLOCKED_HISTOGRAM_REPORT  600
+// the output pool is kept filled up to the buffers the player holds at once,
+// at most VTB_POOL_MAX_BUFFERS; a buffer idle in the pool for
+// kCVPixelBufferPoolMaximumBufferAgeKey, 1 second by default, is freed, so
+// the free ones are taken and given back more often than that
+#define VTB_POOL_MAX_BUFFERS          32
+#define VTB_POOL_TOUCH_INTERVAL       0.5
+// output buffers told apart by address; a new one after the first frames
+// of a session is an allocation at steady state
+#define VTB_POOL_SEEN_MAX             64
+#define VTB_POOL_WARMUP_FRAMES        60
+
+// a warmed up session not adopted by then is released
+#define VTB_WARM_KEEP_SECONDS    30
+
+// max_ref_frames is clamped to [2, 5] and a frame is output as soon as
+// the queue holds more than max_ref_frames, so 8 slots always suffice
+#define VTB_MAX_REORDER_FRAMES   8
+
+typedef struct sample_info {
+    int     sample_id;
+
+    double  sort;
+    double  dts;
+    double  pts;
+    int     serial;
+
+    int     sar_num;
+    int     sar_den;
+
+    int64_t push_time;
+    uint64_t dequeue_time;
+    uint64_t submit_time;
+
+    volatile int is_decoding;
+} sample_info;
+
+typedef struct sort_queue {
+    AVFrame pic;
+    int serial;
+    int64_t sort;
+    IJKSDLFrameTiming timing;
+} sort_queue;
+
+typedef struct VTBFormatDesc
+{
+    CMFormatDescriptionRef      fmt_desc;
+    int32_t                     max_ref_frames;
+    // H.264 whose SPS tells that no frame is reordered for output
+    bool                        no_reordering;
+    bool                        convert_bytestream;
+    bool                        convert_3byteTo4byteNALSize;
+} VTBFormatDesc;
+
+// the output callback of a warmed up session reaches the player adopting it
+// through this, the session having been created before the player
+typedef struct VTBSessionTarget {
+    _Atomic(struct Ijk_VideoToolBox_Opaque *) context;
+} VTBSessionTarget;
+
+typedef struct VTBWarmSession {
+    VTDecompressionSessionRef   session;
+    CMVideoFormatDescriptionRef fmt_desc;
+    VTBSessionTarget           *target;
+    int                         width;
+    int                         height;
+    int                         serial;
+} VTBWarmSession;
+
+enum {
+    VTB_STANDBY_NONE = 0,
+    VTB_STANDBY_BUILDING,
+    VTB_STANDBY_READY,
+    VTB_STANDBY_FAILED,
+};
+
+struct Ijk_VideoToolBox_Opaque {
+    FFPlayer                   *ffp;
+    bool                        async;
+    volatile bool               refresh_request;
+    volatile bool               new_seg_flag;
+    volatile bool               idr_based_identified;
+    volatile bool               refresh_session;
+    volatile bool               recovery_drop_packet;
+
+    AVCodecParameters          *codecpar;
+    VTBFormatDesc               fmt_desc;
+    VTDecompressionSessionRef   vt_session;
+    // of vt_session when it was warmed up, freed with it
+    VTBSessionTarget           *vt_session_target;
+    // min-heap on sort, owned by the VTB output thread;
+    // the decode thread only drains it once the session has no frame in flight
+    sort_queue                  m_sort_queue[VTB_MAX_REORDER_FRAMES];
+    atomic_int                  m_queue_depth;
+    int                         serial;
+    bool                        dealloced;
+    // references to the packets since the last key frame, replayed on refresh_session
+    int                         m_buffer_deep;
+    int                         m_buffer_capacity;
+    int64_t                     m_buffer_bytes;
+    AVPacket                   *m_buffer_packet;
+
+    SDL_mutex                  *sample_info_mutex;
+    SDL_cond                   *sample_info_cond;
+    sample_info                 sample_info_array[VTB_MAX_DECODING_SAMPLES];
+    volatile int                sample_info_index;
+    volatile int                sample_info_last_index;
+    // in-flight samples allowed, adapted to the callback latency within [1, sample_info_max]
+    volatile int                sample_info_window;
+    int                         sample_info_max;
+    double                      sample_latency_avg;
+    double                      frame_interval;
+
+    int                         blocked_histogram[VTB_BLOCKED_HISTOGRAM_SIZE];
+    int                         blocked_frames;
+    volatile int                sample_info_id_generator;
+    volatile int                sample_infos_in_decoding;
+
+    SDL_SpeedSampler            sampler;
+
+    // session for the next resolution, built off the decode thread
+    // and swapped in at the next IDR
+    SDL_mutex                  *standby_mutex;
+    SDL_cond                   *standby_cond;
+    volatile int                standby_state;
+    VTBFormatDesc               standby_fmt_desc;
+    AVCodecParameters          *standby_codecpar;
+    VTDecompressionSessionRef   standby_session;
+    int                         standby_output_width;
+    int                         standby_output_height;
+
+    // "videotoolbox-low-latency": real-time sessions, and the frames of a
+    // stream without reordering output from the callback, not the sort queue
+    bool                        low_latency;
+
+    // "fast-first-frame": show the first picture as soon as it is decoded
+    bool                        fast_first_frame;
+    bool                        first_frame_shown;
+    bool                        first_packet_traced;
+
+    // "videotoolbox-hdr": 10-bit streams decode to 10-bit pixel buffers, for
+    // renderers that handle them; 8-bit NV12 otherwise
+    bool                        hdr_output;
+
+    // "videotoolbox-scale-to-view": the pixel buffers no larger than the view
+    // shows them, renegotiated at the first key frame after the view resized
+    bool                        scale_to_view;
+    int                         output_width;
+    int                         output_height;
+
+    // disposable frames not submitted since the last flush, being before the accurate seek target
+    int                         seek_skipped_frames;
+
+    // IJKSDLFrameTiming_now() of the packet being decoded leaving the packet queue
+    uint64_t                    packet_dequeue_time;
+
+    // "decoder-benchmark": frames are counted and released instead of queued
+    FFDecoderBenchmark         *benchmark;
+
+    // packets rewritten to 4 byte NAL lengths when they cannot be in place
+    AVBufferPool               *avcc_pool;
+    int                         avcc_pool_size;
+
+    // the output pool of vt_session, see vtbsession_pool_prepare()
+    CVPixelBufferPoolRef        pixel_buffer_pool;
+    int                         pixel_buffer_min;
+    CFAbsoluteTime              pixel_buffer_touch_time;
+    // owned by the VTB output thread
+    const void                 *pixel_buffer_seen[VTB_POOL_SEEN_MAX];
+    int                         pixel_buffer_seen_count;
+    int64_t                     pixel_buffer_outputs;
+    int64_t                     pixel_buffer_allocations;
+    int64_t                     pixel_buffer_steady_allocations;
+};
+
+
+static void vtbformat_destroy(VTBFormatDesc *fmt_desc);
+static int  vtbformat_init(VTBFormatDesc *fmt_desc, AVCodecParameters *codecpar);
+static void vtbsession_pool_release(Ijk_VideoToolBox_Opaque *context);
+
+static const char *vtb_get_error_string(OSStatus status) {
+    switch (status) {
+        case kVTInvalidSessionErr:                      return "kVTInvalidSessionErr";
+        case kVTVideoDecoderBadDataErr:                 return "kVTVideoDecoderBadDataErr";
+        case kVTVideoDecoderUnsupportedDataFormatErr:   return "kVTVideoDecoderUnsupportedDataFormatErr";
+        case kVTVideoDecoderMalfunctionErr:             return "kVTVideoDecoderMalfunctionErr";
+        default:                                        return "UNKNOWN";
+    }
+}
+
+static void SortQueuePush(Ijk_VideoToolBox_Opaque* context, const sort_queue *frame)
+{
+    sort_queue *heap = context->m_sort_queue;
+    int i = atomic_load_explicit(&context->m_queue_depth, memory_order_relaxed);
+    assert(i < VTB_MAX_REORDER_FRAMES);
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap[parent].sort <= frame->sort)
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = *frame;
+
+    atomic_fetch_add_explicit(&context->m_queue_depth, 1, memory_order_release);
+}
+
+static void SortQueuePop(Ijk_VideoToolBox_Opaque* context)
+{
+    sort_queue *heap = context->m_sort_queue;
+    int depth = atomic_load_explicit(&context->m_queue_depth, memory_order_acquire);
+    if (depth == 0) {
+        return;
+    }
+    CVBufferRelease(heap[0].pic.opaque);
+
+    depth--;
+    sort_queue last = heap[depth];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= depth)
+            break;
+        if (child + 1 < depth && heap[child + 1].sort < heap[child].sort)
+            child++;
+        if (last.sort <= heap[child].sort)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    memset(&heap[depth], 0, sizeof(sort_queue));
+
+    atomic_store_explicit(&context->m_queue_depth, depth, memory_order_release);
+}
+
+static void CFDictionarySetSInt32(CFMutableDictionaryRef dictionary, CFStringRef key, SInt32 numberSInt32)
+{
+    CFNumberRef number;
+    number = CFNumberCreate(NULL, kCFNumberSInt32Type, &numberSInt32);
+    CFDictionarySetValue(dictionary, key, number);
+    CFRelease(number);
+}
+
+static void CFDictionarySetBoolean(CFMutableDictionaryRef dictionary, CFStringRef key, BOOL value)
+{
+    CFDictionarySetValue(dictionary, key, value ? kCFBooleanTrue : kCFBooleanFalse);
+}
+
+
+static void blocked_histogram_report(Ijk_VideoToolBox_Opaque* context)
+{
+    int *h = context->blocked_histogram;
+
+    if (context->blocked_frames <= 0)
+        return;
+
+    ALOGI("vtb blocked per frame (%d): <1ms:%d <2ms:%d <4ms:%d <8ms:%d <16ms:%d <32ms:%d <64ms:%d >=64ms:%d\n",
+          context->blocked_frames, h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7]);
+
+    memset(context->blocked_histogram, 0, sizeof(context->blocked_histogram));
+    context->blocked_frames = 0;
+}
+
+static void blocked_histogram_add(Ijk_VideoToolBox_Opaque* context, int64_t blocked_ms)
+{
+    int bucket = 0;
+    while (bucket < VTB_BLOCKED_HISTOGRAM_SIZE - 1 && blocked_ms >= (1LL << bucket))
+        bucket++;
+
+    context->blocked_histogram[bucket]++;
+    if (++context->blocked_frames >= VTB_BLOCKED_HISTOGRAM_REPORT)
+        blocked_histogram_report(context);
+}
+
+inline static void sample_info_flush(Ijk_VideoToolBox_Opaque* context, int wait_ms)
+{
+    int64_t deadline = (int64_t)SDL_GetTickHR() + wait_ms;
+    SDL_LockMutex(context->sample_info_mutex);
+
+    while (context->sample_infos_in_decoding > 0) {
+        int64_t wait_step = VTB_SAMPLE_WAIT_WATCHDOG_MS;
+        if (wait_ms >= 0) {
+            int64_t remaining = deadline - (int64_t)SDL_GetTickHR();
+            if (remaining <= 0)
+                break;
+            wait_step = FFMIN(wait_step, remaining);
+        }
+
+        SDL_CondWaitTimeout(context->sample_info_cond, context->sample_info_mutex, (uint32_t)wait_step);
+    }
+
+    SDL_UnlockMutex(context->sample_info_mutex);
+}
+
+inline static sample_info* sample_info_peek(Ijk_VideoToolBox_Opaque* context)
+{
+    FFPlayer   *ffp = context->ffp;
+    VideoState *is  = ffp->is;
+
+    SDL_LockMutex(context->sample_info_mutex);
+
+    sample_info *sample_info = NULL;
+    int64_t      begin       = (int64_t)SDL_GetTickHR();
+    while (context->sample_infos_in_decoding >= context->sample_info_window) {
+        if (is->videoq.abort_request || context->dealloced)
+            goto abort;
+
+        SDL_CondWaitTimeout(context->sample_info_cond, context->sample_info_mutex, VTB_SAMPLE_WAIT_WATCHDOG_MS);
+    }
+    blocked_histogram_add(context, (int64_t)SDL_GetTickHR() - begin);
+
+    // callbacks may complete out of order, take the next free slot
+    for (int i = 0; i < VTB_MAX_DECODING_SAMPLES; i++) {
+        int index = (context->sample_info_index + i) % VTB_MAX_DECODING_SAMPLES;
+        if (!context->sample_info_array[index].is_decoding) {
+            context->sample_info_index = index;
+            sample_info = &context->sample_info_array[index];
+            break;
+        }
+    }
+
+abort:
+    SDL_UnlockMutex(context->sample_info_mutex);
+    return sample_info;
+}
+
+inline static void sample_info_push(Ijk_VideoToolBox_Opaque* context)
+{
+    SDL_LockMutex(context->sample_info_mutex);
+
+    sample_info *sample_info = &context->sample_info_array[context->sample_info_index];
+    if (sample_info->is_decoding) {
+        ALOGW("%s, reallocate sample in decoding %d -> %d /%d\n", __FUNCTION__,
+              sample_info->sample_id,
+              context->sample_info_id_generator,
+              context->sample_infos_in_decoding);
+    } else {
+        sample_info->is_decoding = 1;
+        context->sample_infos_in_decoding++;
+    }
+
+    sample_info->sample_id = context->sample_info_id_generator++;
+    sample_info->push_time = (int64_t)SDL_GetTickHR();
+    context->sample_info_last_index = context->sample_info_index;
+    context->sample_info_index++;
+    context->sample_info_index %= VTB_MAX_DECODING_SAMPLES;
+
+    SDL_UnlockMutex(context->sample_info_mutex);
+}
+
+inline static void sample_info_drop_last_push(Ijk_VideoToolBox_Opaque* context)
+{
+    SDL_LockMutex(context->sample_info_mutex);
+
+    sample_info *sample_info = &context->sample_info_array[context->sample_info_last_index];
+    if (sample_info->is_decoding) {
+        sample_info->is_decoding = 0;
+        context->sample_infos_in_decoding--;
+    }
+
+    SDL_CondBroadcast(context->sample_info_cond);
+    SDL_UnlockMutex(context->sample_info_mutex);
+}
+
+// keep enough samples in flight to cover the decode latency, one more for pipelining
+inline static void sample_info_adapt_window(Ijk_VideoToolBox_Opaque* context, int64_t latency)
+{
+    VideoState *is = context->ffp->is;
+
+    if (context->frame_interval <= 0 && is && is->ic && is->video_st) {
+        AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
+        if (frame_rate.num > 0 && frame_rate.den > 0)
+            context->frame_interval = 1000.0 * frame_rate.den / frame_rate.num;
+    }
+    if (context->frame_interval <= 0)
+        return;
+
+    if (context->sample_latency_avg <= 0)
+        context->sample_latency_avg = latency;
+    else
+        context->sample_latency_avg = context->sample_latency_avg * 0.9 + latency * 0.1;
+
+    int target = (int)ceil(context->sample_latency_avg / context->frame_interval) + 1;
+    target = av_clip(target, 1, context->sample_info_max);
+
+    // one step at a time, so a single slow frame does not swing the window
+    if (target > context->sample_info_window)
+        context->sample_info_window++;
+    else if (target < context->sample_info_window)
+        context->sample_info_window--;
+}
+
+inline static void sample_info_recycle(Ijk_VideoToolBox_Opaque* context, sample_info *sample_info)
+{
+    SDL_LockMutex(context->sample_info_mutex);
+
+    if (sample_info->is_decoding) {
+        sample_info->is_decoding = 0;
+        if (context->sample_infos_in_decoding > 0)
+            context->sample_infos_in_decoding--;
+        sample_info_adapt_window(context, (int64_t)SDL_GetTickHR() - sample_info->push_time);
+    } else {
+        ALOGW("%s, multiple frames in same sample %d / %d\n", __FUNCTION__,
+              sample_info->sample_id,
+              context->sample_info_id_generator);
+    }
+
+    SDL_CondBroadcast(context->sample_info_cond);
+    SDL_UnlockMutex(context->sample_info_mutex);
+}
+
+static inline void vtb_write_nal_size(uint8_t *p, uint32_t size)
+{
+    p[0] = size >> 24;
+    p[1] = size >> 16;
+    p[2] = size >> 8;
+    p[3] = size;
+}
+
+// Annex B to the NAL units ff_avc_parse_nal_units() writes. When the packet
+// starts with a start code and all of them are 00 00 00 01, each one makes
+// room for the length of its NAL unit and nothing moves; false, the data
+// unchanged, otherwise.
+static bool vtb_annexb_to_avcc_in_place(uint8_t *data, int size)
+{
+    uint8_t *end = data + size;
+    uint8_t *p   = data;
+
+    if (size < 5 || AV_RB32(data) != 1)
+        return false;
+
+    while (p < end) {
+        uint8_t *next = (uint8_t *)ff_avc_find_startcode(p + 4, end);
+        if (next == p + 4 || (next < end && (end - next < 4 || AV_RB32(next) != 1))) {
+            // a 3 byte start code or an empty NAL unit, put back what was written
+            for (uint8_t *q = data; q < p;) {
+                uint32_t nal_size = AV_RB32(q);
+                vtb_write_nal_size(q, 1);
+                q += nal_size + 4;
+            }
+            return false;
+        }
+        vtb_write_nal_size(p, (uint32_t)(next - p - 4));
+        p = next;
+    }
+    return true;
+}
+
+// the most the two below write for size bytes in, a start code of 3 bytes
+// becoming a length of 4
+#define VTB_AVCC_MAX_SIZE(size) ((size) + (size) / 3 + 4)
+
+// as ff_avc_parse_nal_units() without the dynamic buffer; @return the bytes written
+static int vtb_annexb_to_avcc(uint8_t *out, const uint8_t *data, int size)
+{
+    const uint8_t *end       = data + size;
+    const uint8_t *nal_start = ff_avc_find_startcode(data, end);
+    uint8_t       *dst       = out;
+
+    for (;;) {
+        while (nal_start < end && !*(nal_start++));
+        if (nal_start == end)
+            break;
+
+        const uint8_t *nal_end = ff_avc_find_startcode(nal_start, end);
+        vtb_write_nal_size(dst, (uint32_t)(nal_end - nal_start));
+        memcpy(dst + 4, nal_start, nal_end - nal_start);
+        dst      += 4 + (nal_end - nal_start);
+        nal_start = nal_end;
+    }
+    return (int)(dst - out);
+}
+
+// 3 byte NAL lengths to 4, a truncated last NAL unit is cut to the packet
+static int vtb_avcc3_to_avcc4(uint8_t *out, const uint8_t *data, int size)
+{
+    const uint8_t *end = data + size;
+    uint8_t       *dst = out;
+
+    while (end - data >= 3) {
+        uint32_t nal_size = AV_RB24(data);
+        data += 3;
+        if (nal_size > end - data)
+            nal_size = (uint32_t)(end - data);
+        vtb_write_nal_size(dst, nal_size);
+        memcpy(dst + 4, data, nal_size);
+        dst  += 4 + nal_size;
+        data += nal_size;
+    }
+    return (int)(dst - out);
+}
+
+// Rewrites the packet to the 4 byte NAL lengths of the format description,
+// once as it leaves the packet queue: in place when it can be, in a pooled
+// buffer replacing the one of the packet otherwise. The packets kept for a
+// session refresh are the rewritten ones.
+static int vtb_packet_to_avcc(Ijk_VideoToolBox_Opaque *context, AVPacket *pkt)
+{
+    bool annexb = context->fmt_desc.convert_bytestream;
+
+    if (!pkt->data || pkt->size <= 0 || (!annexb && !context->fmt_desc.convert_3byteTo4byteNALSize))
+        return 0;
+    if (annexb && pkt->buf && av_buffer_is_writable(pkt->buf) &&
+        vtb_annexb_to_avcc_in_place(pkt->data, pkt->size))
+        return 0;
+
+    int needed = VTB_AVCC_MAX_SIZE(pkt->size) + AV_INPUT_BUFFER_PADDING_SIZE;
+    if (needed > context->avcc_pool_size) {
+        // the buffers out keep the former pool alive until they come back
+        av_buffer_pool_uninit(&context->avcc_pool);
+        context->avcc_pool_size = FFALIGN(needed, 64 * 1024);
+        context->avcc_pool      = av_buffer_pool_init(context->avcc_pool_size, av_buffer_alloc);
+    }
+
+    AVBufferRef *buf = context->avcc_pool ? av_buffer_pool_get(context->avcc_pool) : NULL;
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    int size = annexb ? vtb_annexb_to_avcc(buf->data, pkt->data, pkt->size)
+                      : vtb_avcc3_to_avcc4(buf->data, pkt->data, pkt->size);
+    if (size == 0) {
+        av_buffer_unref(&buf);
+        return AVERROR_INVALIDDATA;
+    }
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    av_buffer_unref(&pkt->buf);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    return 0;
+}
+
+static void vtb_block_free(void *refcon, void *memory_block, size_t size_in_bytes)
+{
+    AVBufferRef *buf = refcon;
+    av_buffer_unref(&buf);
+}
+
+// The block buffer holds a reference to the packet data for as long as
+// VideoToolbox does, decoding asynchronously or not, and drops it from
+// whichever thread releases the block last. No copy unless the packet
+// is not reference counted.
+static CMSampleBufferRef CreateSampleBufferFrom(CMFormatDescriptionRef fmt_desc, const AVPacket *pkt)
+{
+    OSStatus status;
+    CMBlockBufferRef newBBufOut = NULL;
+    CMSampleBufferRef sBufOut = NULL;
+    AVBufferRef *buf = NULL;
+    uint8_t *data = pkt->data;
+
+    if (pkt->buf) {
+        buf = av_buffer_ref(pkt->buf);
+    } else if ((buf = av_buffer_alloc(pkt->size))) {
+        memcpy(buf->data, pkt->data, pkt->size);
+        data = buf->data;
+    }
+    if (!buf)
+        return NULL;
+
+    CMBlockBufferCustomBlockSource block_source = {
+        .version   = kCMBlockBufferCustomBlockSourceVersion,
+        .FreeBlock = vtb_block_free,
+        .refCon    = buf,
+    };
+
+    status = CMBlockBufferCreateWithMemoryBlock(
+                                                NULL,
+                                                data,
+                                                pkt->size,
+                                                kCFAllocatorNull,
+                                                &block_source,
+                                                0,
+                                                pkt->size,
+                                                0,
+                                                &newBBufOut);
+    if (status) {
+        // not handed over
+        av_buffer_unref(&buf);
+    }
+
+    if (!status) {
+        status = CMSampleBufferCreate(
+                                      NULL,
+                                      newBBufOut,
+                                      TRUE,
+                                      0,
+                                      0,
+                                      fmt_desc,
+                                      1,
+                                      0,
+                                      NULL,
+                                      0,
+                                      NULL,
+                                      &sBufOut);
+    }
+
+    if (newBBufOut)
+        CFRelease(newBBufOut);
+    if (status == 0) {
+        return sBufOut;
+    } else {
+        return NULL;
+    }
+}
+
+
+
+
+/*
+ * The picture queue is not displayed before the player has started and
+ * the clocks have settled, which waits for the audio output to open. The
+ * first picture is shown on the vout right away instead, the queued copy
+ * is displayed again in sync later.
+ */
+static void ShowFirstPicture(Ijk_VideoToolBox_Opaque* ctx, const AVFrame *picture)
+{
+    FFPlayer        *ffp = ctx->ffp;
+    SDL_VoutOverlay *overlay;
+
+    ctx->first_frame_shown = true;
+    if (!ffp->vout)
+        return;
+
+    overlay = SDL_Vout_CreateOverlay(picture->width, picture->height, IJK_AV_PIX_FMT__VIDEO_TOOLBOX, ffp->vout);
+    if (!overlay)
+        return;
+
+    if (SDL_VoutFillFrameYUVOverlay(overlay, picture) == 0 &&
+        SDL_VoutDisplayYUVOverlay(ffp->vout, overlay) == 0)
+        ffp_notify_msg1(ffp, FFP_MSG_VIDEO_RENDERING_START);
+    SDL_VoutFreeYUVOverlay(overlay);
+}
+
+// to the picture queue; the pixel buffer of frame stays the caller's
+static void OutputPicture(Ijk_VideoToolBox_Opaque* ctx, const sort_queue *frame)
+{
+    AVFrame picture = frame->pic;
+    IJKSDLFrameTiming timing = frame->timing;
+
+    if (ctx->benchmark) {
+        // counted in output order, never shown
+        ffdecoder_benchmark_did_decode(ctx->benchmark, timing.submit, timing.output);
+        return;
+    }
+
+    AVRational tb = ctx->ffp->is->video_st->time_base;
+    AVRational frame_rate = av_guess_frame_rate(ctx->ffp->is->ic, ctx->ffp->is->video_st, NULL);
+    double duration = (frame_rate.num && frame_rate.den ? av_q2d((AVRational) {frame_rate.den, frame_rate.num}) : 0);
+    double pts = (picture.pts == AV_NOPTS_VALUE) ? NAN : picture.pts * av_q2d(tb);
+
+    picture.format = IJK_AV_PIX_FMT__VIDEO_TOOLBOX;
+    if (!isnan(pts)) {
+        int64_t start_time = ctx->ffp->is->ic->start_time;
+        double  media_time = pts - (start_time != AV_NOPTS_VALUE ? start_time / (double)AV_TIME_BASE : 0);
+        CFNumberRef number = CFNumberCreate(NULL, kCFNumberDoubleType, &media_time);
+        CVBufferSetAttachment(picture.opaque, IJK_VTB_ATTACHMENT_PTS, number, kCVAttachmentMode_ShouldNotPropagate);
+        CFRelease(number);
+    }
+    if (ctx->fast_first_frame && !ctx->first_frame_shown)
+        ShowFirstPicture(ctx, &picture);
+
+    ffpipeline_ios_did_decode_frame(ctx->ffp, IJKSDLFrameTiming_elapsed(timing.submit, timing.output), duration);
+    ffpipeline_ios_wait_frame_queue_limit(ctx->ffp);
+    timing.queue = IJKSDLFrameTiming_now();
+    IJKSDLFrameTiming_attach(picture.opaque, &timing);
+    ffp_queue_picture(ctx->ffp, &picture, pts, duration, 0, ctx->ffp->is->viddec.pkt_serial);
+}
+
+static void QueuePicture(Ijk_VideoToolBox_Opaque* ctx) {
+    if (atomic_load_explicit(&ctx->m_queue_depth, memory_order_acquire) == 0) {
+        IJK_EVLOG1(IJK_EV_VTB_GET_PICTURE_FAILED, 0);
+        return;
+    }
+
+    OutputPicture(ctx, &ctx->m_sort_queue[0]);
+    SortQueuePop(ctx);
+}
+
+
+static bool vtb_is_10bit(AVCodecParameters *codecpar)
+{
+    if (codecpar->codec_id != AV_CODEC_ID_HEVC)
+        return false;
+
+    return codecpar->profile == FF_PROFILE_HEVC_MAIN_10 ||
+           codecpar->format  == AV_PIX_FMT_YUV420P10LE ||
+           codecpar->bits_per_raw_sample > 8;
+}
+
+static OSType vtb_output_pixel_format(Ijk_VideoToolBox_Opaque *context, AVCodecParameters *codecpar)
+{
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (context->hdr_output && vtb_is_10bit(codecpar) && ffvdec_caps_vtb_outputs_p010()) {
+        if (@available(iOS 11.0, *))
+            return kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange;
+    }
+#endif
+    return kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+}
+
+// the renderers pick the conversion from these; VideoToolbox copies them
+// from the VUI when present, the container's are used otherwise
+static void vtb_attach_colorimetry(CVImageBufferRef imageBuffer, AVCodecParameters *codecpar)
+{
+    CFStringRef primaries = NULL;
+    CFStringRef transfer  = NULL;
+    CFStringRef matrix    = NULL;
+
+    switch (codecpar->color_primaries) {
+        case AVCOL_PRI_BT709:       primaries = kCVImageBufferColorPrimaries_ITU_R_709_2; break;
+        case AVCOL_PRI_BT2020:      primaries = kCVImageBufferColorPrimaries_ITU_R_2020;  break;
+        case AVCOL_PRI_BT470BG:     primaries = kCVImageBufferColorPrimaries_EBU_3213;    break;
+        case AVCOL_PRI_SMPTE170M:   primaries = kCVImageBufferColorPrimaries_SMPTE_C;     break;
+        default: break;
+    }
+
+    switch (codecpar->color_trc) {
+        case AVCOL_TRC_BT709:
+        case AVCOL_TRC_SMPTE170M:
+        case AVCOL_TRC_BT2020_10:   transfer = kCVImageBufferTransferFunction_ITU_R_709_2; break;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+        case AVCOL_TRC_SMPTE2084:
+            if (@available(iOS 11.0, *))
+                transfer = kCVImageBufferTransferFunction_SMPTE_ST_2084_PQ;
+            break;
+        case AVCOL_TRC_ARIB_STD_B67:
+            if (@available(iOS 11.0, *))
+                transfer = kCVImageBufferTransferFunction_ITU_R_2100_HLG;
+            break;
+#endif
+        default: break;
+    }
+
+    switch (codecpar->color_space) {
+        case AVCOL_SPC_BT709:       matrix = kCVImageBufferYCbCrMatrix_ITU_R_709_2; break;
+        case AVCOL_SPC_BT2020_NCL:  matrix = kCVImageBufferYCbCrMatrix_ITU_R_2020;  break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:   matrix = kCVImageBufferYCbCrMatrix_ITU_R_601_4; break;
+        default: break;
+    }
+
+    if (primaries && !CVBufferGetAttachment(imageBuffer, kCVImageBufferColorPrimariesKey, NULL))
+        CVBufferSetAttachment(imageBuffer, kCVImageBufferColorPrimariesKey, primaries, kCVAttachmentMode_ShouldPropagate);
+    if (transfer && !CVBufferGetAttachment(imageBuffer, kCVImageBufferTransferFunctionKey, NULL))
+        CVBufferSetAttachment(imageBuffer, kCVImageBufferTransferFunctionKey, transfer, kCVAttachmentMode_ShouldPropagate);
+    if (matrix && !CVBufferGetAttachment(imageBuffer, kCVImageBufferYCbCrMatrixKey, NULL))
+        CVBufferSetAttachment(imageBuffer, kCVImageBufferYCbCrMatrixKey, matrix, kCVAttachmentMode_ShouldPropagate);
+}
+
+// on the VTB output thread
+static void vtb_pool_did_output(Ijk_VideoToolBox_Opaque *ctx, CVImageBufferRef imageBuffer)
+{
+    int i;
+
+    ctx->pixel_buffer_outputs++;
+    for (i = 0; i < ctx->pixel_buffer_seen_count; i++) {
+        if (ctx->pixel_buffer_seen[i] == imageBuffer)
+            return;
+    }
+
+    if (ctx->pixel_buffer_seen_count < VTB_POOL_SEEN_MAX) {
+        ctx->pixel_buffer_seen[ctx->pixel_buffer_seen_count++] = imageBuffer;
+    } else {
+        memmove(ctx->pixel_buffer_seen, ctx->pixel_buffer_seen + 1, sizeof(ctx->pixel_buffer_seen) - sizeof(ctx->pixel_buffer_seen[0]));
+        ctx->pixel_buffer_seen[VTB_POOL_SEEN_MAX - 1] = imageBuffer;
+    }
+    ctx->pixel_buffer_allocations++;
+    if (ctx->pixel_buffer_outputs > VTB_POOL_WARMUP_FRAMES) {
+        ctx->pixel_buffer_steady_allocations++;
+        ALOGD("VTB: pixel buffer allocated at steady state, %d in use\n", ctx->pixel_buffer_seen_count);
+    }
+    ffpipeline_ios_set_pixel_buffer_allocations(ctx->ffp, ctx->pixel_buffer_allocations,
+                                                ctx->pixel_buffer_steady_allocations);
+}
+
+static void VTDecoderCallback(void *decompressionOutputRefCon,
+                       void *sourceFrameRefCon,
+                       OSStatus status,
+                       VTDecodeInfoFlags infoFlags,
+                       CVImageBufferRef imageBuffer,
+                       CMTime presentationTimeStamp,
+                       CMTime presentationDuration)
+{
+    @autoreleasepool {
+        Ijk_VideoToolBox_Opaque *ctx = (Ijk_VideoToolBox_Opaque*)decompressionOutputRefCon;
+        if (!ctx)
+            return;
+
+        FFPlayer   *ffp         = ctx->ffp;
+        VideoState *is          = ffp->is;
+        sort_queue  frame       = {0};
+        sort_queue *newFrame    = &frame;
+
+        sample_info *sample_info = sourceFrameRefCon;
+        ijk_trace_end(IJK_TRACE_VTB_DECODE, sample_info, ffp, (int)status);
+        if (!sample_info->is_decoding) {
+            ALOGD("VTB: frame out of date: id=%d\n", sample_info->sample_id);
+            goto failed;
+        }
+
+        newFrame->pic.pts        = sample_info->pts;
+        newFrame->pic.pkt_dts    = sample_info->dts;
+        newFrame->pic.sample_aspect_ratio.num = sample_info->sar_num;
+        newFrame->pic.sample_aspect_ratio.den = sample_info->sar_den;
+        newFrame->serial     = sample_info->serial;
+        newFrame->timing.dequeue = sample_info->dequeue_time;
+        newFrame->timing.submit  = sample_info->submit_time;
+        newFrame->timing.output  = IJKSDLFrameTiming_now();
+
+        if (newFrame->pic.pts != AV_NOPTS_VALUE) {
+            newFrame->sort    = newFrame->pic.pts;
+        } else {
+            newFrame->sort    = newFrame->pic.pkt_dts;
+            newFrame->pic.pts = newFrame->pic.pkt_dts;
+        }
+
+        if (ctx->dealloced || is->abort_request || is->viddec.queue->abort_request)
+            goto failed;
+
+        if (status != 0) {
+            IJK_EVLOG2(IJK_EV_VTB_DECODE_CALLBACK, status, IJK_EVLOG_STR(vtb_get_error_string(status)));
+            goto failed;
+        }
+
+        if (ctx->refresh_session) {
+            goto failed;
+        }
+
+        if (newFrame->serial != ctx->serial) {
+            goto failed;
+        }
+
+        if (imageBuffer == NULL) {
+            ALOGI("imageBuffer null\n");
+            goto failed;
+        }
+        vtb_pool_did_output(ctx, imageBuffer);
+
+        ffp->stat.vdps = SDL_SpeedSamplerAdd(&ctx->sampler, FFP_SHOW_VDPS_VIDEOTOOLBOX, "vdps[VideoToolbox]");
+#ifdef FFP_VTB_DISABLE_OUTPUT
+        goto failed;
+#endif
+
+        OSType format_type = CVPixelBufferGetPixelFormatType(imageBuffer);
+        if (format_type != vtb_output_pixel_format(ctx, ctx->codecpar)) {
+            ALOGI("format_type error \n");
+            goto failed;
+        }
+        vtb_attach_colorimetry(imageBuffer, ctx->codecpar);
+        if (kVTDecodeInfo_FrameDropped & infoFlags) {
+            ALOGI("droped\n");
+            goto failed;
+        }
+
+        if (ctx->new_seg_flag) {
+            ALOGI("new seg process!!!!");
+            while (ctx->m_queue_depth > 0) {
+                QueuePicture(ctx);
+            }
+            ctx->new_seg_flag = false;
+        }
+
+        if (ctx->m_queue_depth > 0 && newFrame->pic.pts < ctx->m_sort_queue[0].pic.pts) {
+            goto failed;
+        }
+
+        // FIXME: duplicated code
+        {
+            double dpts = NAN;
+
+            if (newFrame->pic.pts != AV_NOPTS_VALUE)
+                dpts = av_q2d(is->video_st->time_base) * newFrame->pic.pts;
+
+            if (ffp->framedrop>0 || (ffp->framedrop && ffp_get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
+                ffp->stat.decode_frame_count++;
+                if (newFrame->pic.pts != AV_NOPTS_VALUE) {
+                    double diff = dpts - ffp_get_master_clock(is);
+                    if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
+                        diff - is->frame_last_filter_delay < 0 &&
+                        is->viddec.pkt_serial == is->vidclk.serial &&
+                        is->videoq.nb_packets) {
+                        is->frame_drops_early++;
+                        is->continuous_frame_drops_early++;
+                        if (is->continuous_frame_drops_early > ffp->framedrop) {
+                            is->continuous_frame_drops_early = 0;
+                        } else {
+                            ffp->stat.drop_frame_count++;
+                            ffp->stat.drop_frame_rate = (float)(ffp->stat.drop_frame_count) / (float)(ffp->stat.decode_frame_count);
+                            // drop too late frame
+                            goto failed;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (CVPixelBufferIsPlanar(imageBuffer)) {
+            newFrame->pic.width  = (int)CVPixelBufferGetWidthOfPlane(imageBuffer, 0);
+            newFrame->pic.height = (int)CVPixelBufferGetHeightOfPlane(imageBuffer, 0);
+        } else {
+            newFrame->pic.width  = (int)CVPixelBufferGetWidth(imageBuffer);
+            newFrame->pic.height = (int)CVPixelBufferGetHeight(imageBuffer);
+        }
+
+
+        // nothing decoded later is shown before it, no need to sort
+        if (ctx->low_latency && ctx->fmt_desc.no_reordering) {
+            while (ctx->m_queue_depth > 0) {
+                QueuePicture(ctx);
+            }
+            newFrame->pic.opaque = imageBuffer;
+            OutputPicture(ctx, newFrame);
+            goto successed;
+        }
+
+        if (ctx->m_queue_depth >= VTB_MAX_REORDER_FRAMES) {
+            QueuePicture(ctx);
+        }
+
+        newFrame->pic.opaque = CVBufferRetain(imageBuffer);
+        SortQueuePush(ctx, newFrame);
+
+        //ALOGI("%lf %lf %lf \n", newFrame->sort,newFrame->pts, newFrame->dts);
+        //ALOGI("display queue deep %d\n", ctx->m_queue_depth);
+
+        if (ctx->ffp->is == NULL || ctx->ffp->is->abort_request || ctx->ffp->is->viddec.queue->abort_request) {
+            while (ctx->m_queue_depth > 0) {
+                SortQueuePop(ctx);
+            }
+            goto successed;
+        }
+        //ALOGI("depth %d  %d\n", ctx->m_queue_depth, ctx->m_max_ref_frames);
+        if ((ctx->m_queue_depth > ctx->fmt_desc.max_ref_frames)) {
+            QueuePicture(ctx);
+        }
+    successed:
+        sample_info_recycle(ctx, sample_info);
+        return;
+    failed:
+        sample_info_recycle(ctx, sample_info);
+        return;
+    }
+}
+
+
+// drain: wait for the frames in the session, which are otherwise dropped
+static void vtbsession_destroy(Ijk_VideoToolBox_Opaque *context, bool drain)
+{
+    if (!context)
+        return;
+
+    vtbformat_destroy(&context->fmt_desc);
+
+    if (context->vt_session) {
+        if (drain)
+            VTDecompressionSessionWaitForAsynchronousFrames(context->vt_session);
+        VTDecompressionSessionInvalidate(context->vt_session);
+        CFRelease(context->vt_session);
+        context->vt_session = NULL;
+    }
+    free(context->vt_session_target);
+    context->vt_session_target = NULL;
+    vtbsession_pool_release(context);
+}
+
+static void vtb_output_size(Ijk_VideoToolBox_Opaque *context, AVCodecParameters *codecpar, int *out_width, int *out_height)
+{
+    FFPlayer *ffp    = context->ffp;
+    int       width  = codecpar->width;
+    int       height = codecpar->height;
+    int       view_width, view_height;
+
+    if (ffp->vtb_max_frame_width > 0 && width > ffp->vtb_max_frame_width) {
+        double w_scaler = (float)ffp->vtb_max_frame_width / width;
+        width = ffp->vtb_max_frame_width;
+        height = height * w_scaler;
+    }
+
+    // the larger of the two ratios, for the aspect fill of the view
+    if (context->scale_to_view && width > 0 && height > 0 &&
+        ffpipeline_ios_get_video_output_size(ffp, &view_width, &view_height)) {
+        double scale = FFMAX((double)view_width / width, (double)view_height / height);
+        int    scaled_width = FFALIGN((int)(width * scale), VTB_OUTPUT_WIDTH_ALIGN);
+        if (scale < 1.0 && scaled_width < width) {
+            height = (int)((int64_t)height * scaled_width / width) & ~1;
+            width  = scaled_width;
+        }
+    }
+
+    *out_width  = width;
+    *out_height = height;
+}
+
+static CFMutableDictionaryRef vtb_pixel_buffer_attributes(OSType pixel_format, int width, int height)
+{
+    CFMutableDictionaryRef attributes = CFDictionaryCreateMutable(NULL,
+                                                                  0,
+                                                                  &kCFTypeDictionaryKeyCallBacks,
+                                                                  &kCFTypeDictionaryValueCallBacks);
+    CFDictionarySetSInt32(attributes, kCVPixelBufferPixelFormatTypeKey, pixel_format);
+    CFDictionarySetSInt32(attributes, kCVPixelBufferWidthKey, width);
+    CFDictionarySetSInt32(attributes, kCVPixelBufferHeightKey, height);
+    CFDictionarySetBoolean(attributes, kCVPixelBufferOpenGLESCompatibilityKey, YES);
+    // IOSurface backed, the renderers take them without a copy
+    CFDictionaryRef surface = CFDictionaryCreate(NULL, NULL, NULL, 0,
+                                                 &kCFTypeDictionaryKeyCallBacks,
+                                                 &kCFTypeDictionaryValueCallBacks);
+    if (surface) {
+        CFDictionarySetValue(attributes, kCVPixelBufferIOSurfacePropertiesKey, surface);
+        CFRelease(surface);
+    }
+    return attributes;
+}
+
+// decodes ahead of the other work of the hardware decoder, at the cost of
+// power, for interactive live streams
+static void vtbsession_set_real_time(Ijk_VideoToolBox_Opaque *context, VTDecompressionSessionRef vt_session)
+{
+    if (!context->low_latency)
+        return;
+
+    OSStatus status = VTSessionSetProperty(vt_session, kVTDecompressionPropertyKey_RealTime, kCFBooleanTrue);
+    if (status != noErr)
+        ALOGW("%s - kVTDecompressionPropertyKey_RealTime failed (%d)\n", __FUNCTION__, (int)status);
+}
+
+// the size of the pixel buffers in output_width and output_height
+static VTDecompressionSessionRef vtbsession_create_with_format(Ijk_VideoToolBox_Opaque* context, VTBFormatDesc *fmt_desc, AVCodecParameters *codecpar,
+                                                               int *output_width, int *output_height)
+{
+    FFPlayer *ffp = context->ffp;
+    int       width;
+    int       height;
+
+    VTDecompressionSessionRef vt_session = NULL;
+    CFMutableDictionaryRef destinationPixelBufferAttributes;
+    VTDecompressionOutputCallbackRecord outputCallback;
+    OSStatus status;
+
+    vtb_output_size(context, codecpar, &width, &height);
+
+    ALOGI("after scale width %d height %d \n", width, height);
+
+    destinationPixelBufferAttributes = vtb_pixel_buffer_attributes(vtb_output_pixel_format(context, codecpar), width, height);
+    outputCallback.decompressionOutputCallback = VTDecoderCallback;
+    outputCallback.decompressionOutputRefCon = context  ;
+    if (ijk_trace_enabled()) {
+        char detail[32];
+        snprintf(detail, sizeof(detail), "%dx%d", width, height);
+        ijk_trace_begin(IJK_TRACE_VTB_SESSION_CREATE, context, ffp, detail);
+    }
+    uint64_t create_start = IJKSDLFrameTiming_now();
+    status = VTDecompressionSessionCreate(
+                                          kCFAllocatorDefault,
+                                          fmt_desc->fmt_desc,
+                                          NULL,
+                                          destinationPixelBufferAttributes,
+                                          &outputCallback,
+                                          &vt_session);
+    ijk_trace_end(IJK_TRACE_VTB_SESSION_CREATE, context, ffp, (int)status);
+    if (status == noErr)
+        ffdecoder_benchmark_did_create_session(context->benchmark, IJKSDLFrameTiming_elapsed(create_start, IJKSDLFrameTiming_now()));
+
+    if (status == noErr) {
+        *output_width  = width;
+        *output_height = height;
+        vtbsession_set_real_time(context, vt_session);
+    } else {
+        NSError* error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+        NSLog(@"Error %@", [error description]);
+        ALOGI("%s - failed with status = (%d)", __FUNCTION__, (int)status);
+        ffvdec_caps_vtb_refused(codecpar, (int)status);
+    }
+    CFRelease(destinationPixelBufferAttributes);
+
+    return vt_session;
+}
+
+#pragma mark warm up
+
+static pthread_mutex_t g_vtb_warm_mutex    = PTHREAD_MUTEX_INITIALIZER;
+// width and height are set while the session is built
+static VTBWarmSession  g_vtb_warm;
+static int             g_vtb_warm_serial   = 0;
+static CFAbsoluteTime  g_vtb_warm_deadline = 0;
+
+static void VTDecoderWarmCallback(void *decompressionOutputRefCon,
+                                  void *sourceFrameRefCon,
+                                  OSStatus status,
+                                  VTDecodeInfoFlags infoFlags,
+                                  CVImageBufferRef imageBuffer,
+                                  CMTime presentationTimeStamp,
+                                  CMTime presentationDuration)
+{
+    VTBSessionTarget *target = decompressionOutputRefCon;
+
+    VTDecoderCallback(atomic_load(&target->context), sourceFrameRefCon, status, infoFlags,
+                      imageBuffer, presentationTimeStamp, presentationDuration);
+}
+
+static void vtb_warm_release(VTBWarmSession *warm)
+{
+    if (warm->session) {
+        VTDecompressionSessionInvalidate(warm->session);
+        CFRelease(warm->session);
+    }
+    if (warm->fmt_desc)
+        CFRelease(warm->fmt_desc);
+    free(warm->target);
+    memset(warm, 0, sizeof(*warm));
+}
+
+// the usual levels of the size, the format description only has to be one
+// the session of the stream would accept
+static int vtb_warm_level(int width, int height)
+{
+    int64_t pixels = (int64_t)width * height;
+
+    if (pixels <= 1280 * 720)
+        return 31;
+    if (pixels <= 2048 * 1088)
+        return 40;
+    return 51;
+}
+
+static void vtb_warm_build(int width, int height, int serial)
+{
+    VTBWarmSession warm = {0};
+    OSStatus       status;
+
+    warm.width  = width;
+    warm.height = height;
+    warm.serial = serial;
+    warm.target = calloc(1, sizeof(*warm.target));
+    if (!warm.target)
+        return;
+    atomic_init(&warm.target->context, NULL);
+
+    status = h264_ps_create_format_description(width, height, vtb_warm_level(width, height), false, &warm.fmt_desc);
+    if (status == noErr) {
+        CFMutableDictionaryRef attributes = vtb_pixel_buffer_attributes(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange,
+                                                                        width, height);
+        VTDecompressionOutputCallbackRecord callback = {VTDecoderWarmCallback, warm.target};
+        status = VTDecompressionSessionCreate(kCFAllocatorDefault, warm.fmt_desc, NULL, attributes,
+                                              &callback, &warm.session);
+        CFRelease(attributes);
+    }
+    if (status != noErr) {
+        ALOGW("%s: %dx%d failed with status = (%d)\n", __FUNCTION__, width, height, (int)status);
+        vtb_warm_release(&warm);
+        return;
+    }
+
+    pthread_mutex_lock(&g_vtb_warm_mutex);
+    if (g_vtb_warm.serial == serial && !g_vtb_warm.session) {
+        g_vtb_warm = warm;
+        memset(&warm, 0, sizeof(warm));
+    }
+    pthread_mutex_unlock(&g_vtb_warm_mutex);
+
+    // replaced or released while it was built
+    vtb_warm_release(&warm);
+}
+
+static void vtb_warm_expire(void)
+{
+    VTBWarmSession warm = {0};
+
+    pthread_mutex_lock(&g_vtb_warm_mutex);
+    if (CFAbsoluteTimeGetCurrent() >= g_vtb_warm_deadline) {
+        warm = g_vtb_warm;
+        memset(&g_vtb_warm, 0, sizeof(g_vtb_warm));
+    }
+    pthread_mutex_unlock(&g_vtb_warm_mutex);
+
+    if (warm.session)
+        ALOGI("%s: %dx%d not adopted\n", __FUNCTION__, warm.width, warm.height);
+    vtb_warm_release(&warm);
+}
+
+void videotoolbox_warmup(int width, int height)
+{
+    VTBWarmSession old = {0};
+    int            serial;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    pthread_mutex_lock(&g_vtb_warm_mutex);
+    g_vtb_warm_deadline = CFAbsoluteTimeGetCurrent() + VTB_WARM_KEEP_SECONDS;
+    if (g_vtb_warm.width == width && g_vtb_warm.height == height) {
+        // kept, or being built
+        serial = 0;
+    } else {
+        old = g_vtb_warm;
+        memset(&g_vtb_warm, 0, sizeof(g_vtb_warm));
+        g_vtb_warm.width  = width;
+        g_vtb_warm.height = height;
+        g_vtb_warm.serial = serial = ++g_vtb_warm_serial;
+    }
+    pthread_mutex_unlock(&g_vtb_warm_mutex);
+
+    vtb_warm_release(&old);
+    if (serial) {
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            vtb_warm_build(width, height, serial);
+        });
+    }
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(VTB_WARM_KEEP_SECONDS * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        vtb_warm_expire();
+    });
+}
+
+void videotoolbox_warmup_release(void)
+{
+    pthread_mutex_lock(&g_vtb_warm_mutex);
+    g_vtb_warm_deadline = 0;
+    pthread_mutex_unlock(&g_vtb_warm_mutex);
+
+    vtb_warm_expire();
+}
+
+// The session warmed up for the size of the stream, when it accepts its
+// format description. "videotoolbox-scale-to-view" may have asked for
+// smaller pixel buffers: the stream size ones are kept until the view
+// resizes, the first picture matters more.
+static VTDecompressionSessionRef vtbsession_adopt_warm(Ijk_VideoToolBox_Opaque *context)
+{
+    AVCodecParameters *codecpar = context->codecpar;
+    VTBWarmSession     warm     = {0};
+    int                width, height;
+
+    if (!context->fmt_desc.fmt_desc || codecpar->codec_id != AV_CODEC_ID_H264 ||
+        vtb_output_pixel_format(context, codecpar) != kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange)
+        return NULL;
+    // the cap is not the view's, it holds
+    if (context->ffp->vtb_max_frame_width > 0 && codecpar->width > context->ffp->vtb_max_frame_width)
+        return NULL;
+    vtb_output_size(context, codecpar, &width, &height);
+
+    pthread_mutex_lock(&g_vtb_warm_mutex);
+    if (g_vtb_warm.session &&
+        g_vtb_warm.width == codecpar->width && g_vtb_warm.height == codecpar->height &&
+        VTDecompressionSessionCanAcceptFormatDescription(g_vtb_warm.session, context->fmt_desc.fmt_desc)) {
+        warm = g_vtb_warm;
+        memset(&g_vtb_warm, 0, sizeof(g_vtb_warm));
+    }
+    pthread_mutex_unlock(&g_vtb_warm_mutex);
+
+    if (!warm.session)
+        return NULL;
+
+    atomic_store(&warm.target->context, context);
+    context->vt_session_target = warm.target;
+    context->output_width      = width;
+    context->output_height     = height;
+    CFRelease(warm.fmt_desc);
+
+    ALOGI("%s: adopted the session warmed up for %dx%d\n", __FUNCTION__, warm.width, warm.height);
+    return warm.session;
+}
+
+#pragma mark pixel buffer pool
+
+// takes buffers from the pool up to pixel_buffer_min, allocating the missing
+// ones, and gives them back, their age in the pool starting over
+static void vtbsession_pool_touch(Ijk_VideoToolBox_Opaque *context)
+{
+    CVPixelBufferRef buffers[VTB_POOL_MAX_BUFFERS];
+    int              count = 0;
+    int              min   = context->pixel_buffer_min;
+
+    context->pixel_buffer_touch_time = CFAbsoluteTimeGetCurrent();
+
+    CFNumberRef     threshold = CFNumberCreate(NULL, kCFNumberIntType, &min);
+    const void     *keys[1]   = {kCVPixelBufferPoolAllocationThresholdKey};
+    const void     *values[1] = {threshold};
+    CFDictionaryRef aux       = CFDictionaryCreate(NULL, keys, values, 1,
+                                                   &kCFTypeDictionaryKeyCallBacks,
+                                                   &kCFTypeDictionaryValueCallBacks);
+    CFRelease(threshold);
+    if (!aux)
+        return;
+
+    // past the threshold, the frames in flight and on screen hold the rest
+    while (count < min &&
+           CVPixelBufferPoolCreatePixelBufferWithAuxAttributes(NULL, context->pixel_buffer_pool, aux,
+                                                               &buffers[count]) == kCVReturnSuccess)
+        count++;
+    for (int i = 0; i < count; i++)
+        CVPixelBufferRelease(buffers[i]);
+    CFRelease(aux);
+}
+
+static void vtbsession_pool_release(Ijk_VideoToolBox_Opaque *context)
+{
+    if (context->pixel_buffer_pool) {
+        CVPixelBufferPoolRelease(context->pixel_buffer_pool);
+        context->pixel_buffer_pool = NULL;
+    }
+}
+
+// VideoToolbox allocates its output buffers as the frames need them, and
+// again whenever the renderer holds more than before: the pool is filled up
+// front to what the player holds at once, the picture queue, the reorder
+// queue, the samples in flight and the frame on screen
+static void vtbsession_pool_prepare(Ijk_VideoToolBox_Opaque *context, VTDecompressionSessionRef vt_session)
+{
+    CVPixelBufferPoolRef pool = NULL;
+
+    vtbsession_pool_release(context);
+    memset(context->pixel_buffer_seen, 0, sizeof(context->pixel_buffer_seen));
+    context->pixel_buffer_seen_count = 0;
+    context->pixel_buffer_outputs    = 0;
+
+    if (!vt_session ||
+        VTSessionCopyProperty(vt_session, kVTDecompressionPropertyKey_PixelBufferPool,
+                              kCFAllocatorDefault, &pool) != noErr || !pool)
+        return;
+
+    context->pixel_buffer_pool = pool;
+    context->pixel_buffer_min  = av_clip(context->ffp->pictq_size + context->fmt_desc.max_ref_frames +
+                                         context->sample_info_max + 1,
+                                         1, VTB_POOL_MAX_BUFFERS);
+    vtbsession_pool_touch(context);
+}
+
+// on the decode thread, between packets
+static void vtbsession_pool_keep(Ijk_VideoToolBox_Opaque *context)
+{
+    if (context->pixel_buffer_pool &&
+        CFAbsoluteTimeGetCurrent() - context->pixel_buffer_touch_time >= VTB_POOL_TOUCH_INTERVAL)
+        vtbsession_pool_touch(context);
+}
+
+static VTDecompressionSessionRef vtbsession_create(Ijk_VideoToolBox_Opaque* context)
+{
+    VTDecompressionSessionRef vt_session = NULL;
+
+    vtbformat_init(&context->fmt_desc, context->codecpar);
+    vt_session = vtbsession_adopt_warm(context);
+    if (vt_session)
+        vtbsession_set_real_time(context, vt_session);
+    else
+        vt_session = vtbsession_create_with_format(context, &context->fmt_desc, context->codecpar,
+                                                   &context->output_width, &context->output_height);
+    vtbsession_pool_prepare(context, vt_session);
+
+    memset(context->sample_info_array, 0, sizeof(context->sample_info_array));
+    context->sample_infos_in_decoding = 0;
+    return vt_session;
+}
+
+
+
+// same rule as the late frame drop in VTDecoderCallback, but taken before
+// the hardware spends time on a frame nothing else references
+static bool vtb_drop_disposable_frame(Ijk_VideoToolBox_Opaque* context, const AVPacket *avpkt, double pts)
+{
+    FFPlayer   *ffp = context->ffp;
+    VideoState *is  = ffp->is;
+
+    if (!(ffp->framedrop > 0 || (ffp->framedrop && ffp_get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)))
+        return false;
+    if (pts == AV_NOPTS_VALUE || context->refresh_session)
+        return false;
+    if (context->codecpar->codec_id != AV_CODEC_ID_H264)
+        return false;
+
+    double diff = av_q2d(is->video_st->time_base) * pts - ffp_get_master_clock(is);
+    if (isnan(diff) || fabs(diff) >= AV_NOSYNC_THRESHOLD ||
+        diff - is->frame_last_filter_delay >= 0 ||
+        is->viddec.pkt_serial != is->vidclk.serial ||
+        !is->videoq.nb_packets)
+        return false;
+
+    if (!ff_h264_data_is_disposable(avpkt->data, avpkt->size, false))
+        return false;
+
+    is->continuous_frame_drops_early++;
+    if (is->continuous_frame_drops_early > ffp->framedrop) {
+        is->continuous_frame_drops_early = 0;
+        return false;
+    }
+
+    is->frame_drops_early++;
+    ffp->stat.decode_frame_count++;
+    ffp->stat.drop_frame_count++;
+    ffp->stat.drop_frame_rate = (float)(ffp->stat.drop_frame_count) / (float)(ffp->stat.decode_frame_count);
+    return true;
+}
+
+// accurate seek decodes the frames from the key frame on only to discard
+// them before the target; the ones no other frame references need not be
+// decoded at all. The last interval before the target is kept, its frame
+// may be the one shown.
+static bool vtb_skip_before_seek_target(Ijk_VideoToolBox_Opaque* context, const AVPacket *avpkt, double pts)
+{
+    FFPlayer   *ffp = context->ffp;
+    VideoState *is  = ffp->is;
+
+    if (!ffp->enable_accurate_seek || !is->video_accurate_seek_req || is->seek_req)
+        return false;
+    if (pts == AV_NOPTS_VALUE || context->refresh_session)
+        return false;
+    if (context->codecpar->codec_id != AV_CODEC_ID_H264)
+        return false;
+
+    int64_t pts_us    = av_rescale_q((int64_t)pts, is->video_st->time_base, AV_TIME_BASE_Q);
+    int64_t margin_us = context->frame_interval > 0 ? (int64_t)(context->frame_interval * 1000) : 100000;
+    if (pts_us >= is->seek_pos - margin_us)
+        return false;
+
+    if (!ff_h264_data_is_disposable(avpkt->data, avpkt->size, false))
+        return false;
+
+    context->seek_skipped_frames++;
+    ffpipeline_ios_set_seek_skipped_frames(ffp, context->seek_skipped_frames);
+    return true;
+}
+
+// max-fps below the frame rate: the frames between its slots that nothing
+// references are not submitted, see ffpipeline_ios_decimation_due()
+static bool vtb_decimate_frame(Ijk_VideoToolBox_Opaque* context, const AVPacket *avpkt)
+{
+    FFPlayer *ffp = context->ffp;
+
+    // the benchmark measures every frame
+    if (context->benchmark || context->refresh_session || context->codecpar->codec_id != AV_CODEC_ID_H264)
+        return false;
+    if (!ffpipeline_ios_decimation_due(ffp))
+        return false;
+
+    bool left_out = ff_h264_data_is_disposable(avpkt->data, avpkt->size, false);
+    ffpipeline_ios_did_decimate(ffp, left_out);
+    return left_out;
+}
+
+static int decode_video_internal(Ijk_VideoToolBox_Opaque* context, AVCodecContext *avctx, const AVPacket *avpkt, int* got_picture_ptr)
+{
+    FFPlayer *ffp                   = context->ffp;
+    OSStatus status                 = 0;
+    uint32_t decoder_flags          = 0;
+    sample_info *sample_info        = NULL;
+    CMSampleBufferRef sample_buff   = NULL;
+    double pts                      = avpkt->pts;
+    double dts                      = avpkt->dts;
+
+    if (!context) {
+        goto failed;
+    }
+
+    if (context->async) {
+        decoder_flags |= kVTDecodeFrame_EnableAsynchronousDecompression;
+    }
+
+    if (context->refresh_session) {
+        decoder_flags |= kVTDecodeFrame_DoNotOutputFrame;
+        // ALOGI("flag :%d flag %d \n", decoderFlags,avpkt->flags);
+    }
+
+    if (context->refresh_request) {
+        sample_info_flush(context, 1000);
+        vtbsession_destroy(context, true);
+
+        while (context->m_queue_depth > 0) {
+            SortQueuePop(context);
+        }
+        memset(context->sample_info_array, 0, sizeof(context->sample_info_array));
+        context->sample_infos_in_decoding = 0;
+
+        context->vt_session = vtbsession_create(context);
+        if (!context->vt_session)
+            goto failed;
+        context->refresh_request = false;
+    }
+
+    if (pts == AV_NOPTS_VALUE) {
+        pts = dts;
+    }
+
+    // decimated before the late drop, which then only counts the frames shown
+    if (vtb_skip_before_seek_target(context, avpkt, pts) ||
+        vtb_decimate_frame(context, avpkt) ||
+        vtb_drop_disposable_frame(context, avpkt, pts)) {
+        *got_picture_ptr = 0;
+        return 0;
+    }
+
+    // rewritten to 4 byte NAL lengths by vtb_packet_to_avcc() already
+    sample_buff = CreateSampleBufferFrom(context->fmt_desc.fmt_desc, avpkt);
+    if (!sample_buff) {
+        ALOGI("%s - CreateSampleBufferFrom failed", __FUNCTION__);
+        goto failed;
+    }
+
+    if (avpkt->flags & AV_PKT_FLAG_NEW_SEG) {
+        context->new_seg_flag = true;
+    }
+
+    sample_info = sample_info_peek(context);
+    if (!sample_info) {
+        ALOGE("%s, failed to peek frame_info\n", __FUNCTION__);
+        goto failed;
+    }
+
+    sample_info->pts    = pts;
+    sample_info->dts    = dts;
+    sample_info->serial = context->serial;
+    sample_info->sar_num = avctx->sample_aspect_ratio.num;
+    sample_info->sar_den = avctx->sample_aspect_ratio.den;
+    sample_info->dequeue_time = context->packet_dequeue_time;
+    sample_info->submit_time  = IJKSDLFrameTiming_now();
+    sample_info_push(context);
+
+    // ended by VTDecoderCallback
+    ijk_trace_begin(IJK_TRACE_VTB_DECODE, sample_info, ffp, NULL);
+    status = VTDecompressionSessionDecodeFrame(context->vt_session, sample_buff, decoder_flags, (void*)sample_info, 0);
+    if (status == noErr) {
+        if (context->ffp->is->videoq.abort_request)
+            goto failed;
+
+        // Wait for delayed frames even if kVTDecodeInfo_Asynchronous is not set.
+        if (context->async && ffp->vtb_wait_async) {
+            status = VTDecompressionSessionWaitForAsynchronousFrames(context->vt_session);
+        }
+    }
+
+    if (status != 0) {
+        sample_info_drop_last_push(context);
+
+        IJK_EVLOG2(IJK_EV_VTB_DECODE_FRAME, status, IJK_EVLOG_STR(vtb_get_error_string(status)));
+
+        if (status == kVTInvalidSessionErr) {
+            context->refresh_session = true;
+        }
+        if (status == kVTVideoDecoderMalfunctionErr) {
+            context->recovery_drop_packet = true;
+            context->refresh_session = true;
+        }
+        goto failed;
+    }
+
+
+
+    if (sample_buff) {
+        CFRelease(sample_buff);
+    }
+
+    *got_picture_ptr = 1;
+    return 0;
+failed:
+    if (sample_buff) {
+        CFRelease(sample_buff);
+    }
+    *got_picture_ptr = 0;
+    return -1;
+}
+
+static inline void ResetPktBuffer(Ijk_VideoToolBox_Opaque* context) {
+    for (int i = 0 ; i < context->m_buffer_deep; i++) {
+        av_packet_unref(&context->m_buffer_packet[i]);
+    }
+    context->m_buffer_deep  = 0;
+    context->m_buffer_bytes = 0;
+    ffpipeline_ios_set_decoder_buffered_bytes(context->ffp, 0);
+}
+
+static inline void FreePktBuffer(Ijk_VideoToolBox_Opaque* context) {
+    ResetPktBuffer(context);
+    av_freep(&context->m_buffer_packet);
+    context->m_buffer_capacity = 0;
+}
+
+static inline void DuplicatePkt(Ijk_VideoToolBox_Opaque* context, const AVPacket* pkt) {
+    // the buffer only ever holds the current GOP, so running out of room
+    // drops that GOP as a whole and falls back to I-frame based recovery
+    if (context->m_buffer_deep >= MAX_PKT_QUEUE_DEEP ||
+        context->m_buffer_bytes + pkt->size > MAX_PKT_QUEUE_BYTES) {
+        context->idr_based_identified = false;
+        ResetPktBuffer(context);
+    }
+
+    if (context->m_buffer_deep >= context->m_buffer_capacity) {
+        int new_capacity = FFMIN(FFMAX(context->m_buffer_capacity * 2, 32), MAX_PKT_QUEUE_DEEP);
+        AVPacket *new_buffer = av_realloc_array(context->m_buffer_packet, new_capacity, sizeof(AVPacket));
+        if (!new_buffer) {
+            ALOGE("%s: out of memory\n", __FUNCTION__);
+            context->idr_based_identified = false;
+            ResetPktBuffer(context);
+            return;
+        }
+        context->m_buffer_packet   = new_buffer;
+        context->m_buffer_capacity = new_capacity;
+    }
+
+    AVPacket* avpkt = &context->m_buffer_packet[context->m_buffer_deep];
+    av_init_packet(avpkt);
+    avpkt->data = NULL;
+    avpkt->size = 0;
+    if (av_packet_ref(avpkt, pkt) < 0) {
+        ALOGE("%s: av_packet_ref failed\n", __FUNCTION__);
+        context->idr_based_identified = false;
+        ResetPktBuffer(context);
+        return;
+    }
+    context->m_buffer_bytes += avpkt->size;
+    context->m_buffer_deep++;
+    ffpipeline_ios_set_decoder_buffered_bytes(context->ffp, context->m_buffer_bytes);
+}
+
+
+
+static void vtbsession_standby_build(void *opaque)
+{
+    Ijk_VideoToolBox_Opaque   *context = opaque;
+    VTDecompressionSessionRef  session = NULL;
+
+    if (vtbformat_init(&context->standby_fmt_desc, context->standby_codecpar) == 0)
+        session = vtbsession_create_with_format(context, &context->standby_fmt_desc, context->standby_codecpar,
+                                                &context->standby_output_width, &context->standby_output_height);
+
+    SDL_LockMutex(context->standby_mutex);
+    context->standby_session = session;
+    context->standby_state   = session ? VTB_STANDBY_READY : VTB_STANDBY_FAILED;
+    SDL_CondSignal(context->standby_cond);
+    SDL_UnlockMutex(context->standby_mutex);
+}
+
+static void vtbsession_release_async(void *opaque)
+{
+    VTDecompressionSessionRef vt_session = opaque;
+
+    VTDecompressionSessionInvalidate(vt_session);
+    CFRelease(vt_session);
+}
+
+static int vtbsession_standby_wait(Ijk_VideoToolBox_Opaque *context)
+{
+    int state;
+
+    SDL_LockMutex(context->standby_mutex);
+    while (context->standby_state == VTB_STANDBY_BUILDING)
+        SDL_CondWait(context->standby_cond, context->standby_mutex);
+    state = context->standby_state;
+    SDL_UnlockMutex(context->standby_mutex);
+
+    return state;
+}
+
+static void vtbsession_standby_discard(Ijk_VideoToolBox_Opaque *context)
+{
+    if (!context->standby_mutex || context->standby_state == VTB_STANDBY_NONE)
+        return;
+
+    vtbsession_standby_wait(context);
+
+    if (context->standby_session) {
+        VTDecompressionSessionInvalidate(context->standby_session);
+        CFRelease(context->standby_session);
+        context->standby_session = NULL;
+    }
+    vtbformat_destroy(&context->standby_fmt_desc);
+    avcodec_parameters_free(&context->standby_codecpar);
+    context->standby_state = VTB_STANDBY_NONE;
+}
+
+static int vtbsession_standby_prepare(Ijk_VideoToolBox_Opaque *context, const uint8_t *extradata, int extrasize, int width, int height)
+{
+    vtbsession_standby_discard(context);
+
+    context->standby_codecpar = avcodec_parameters_alloc();
+    if (!context->standby_codecpar)
+        return AVERROR(ENOMEM);
+
+    if (avcodec_parameters_copy(context->standby_codecpar, context->codecpar) < 0)
+        goto fail;
+
+    av_freep(&context->standby_codecpar->extradata);
+    context->standby_codecpar->extradata = av_mallocz(extrasize + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!context->standby_codecpar->extradata)
+        goto fail;
+    memcpy(context->standby_codecpar->extradata, extradata, extrasize);
+    context->standby_codecpar->extradata_size = extrasize;
+    context->standby_codecpar->width          = width;
+    context->standby_codecpar->height         = height;
+
+    ALOGI("%s: building standby session %dx%d\n", __FUNCTION__, width, height);
+    context->standby_state = VTB_STANDBY_BUILDING;
+    dispatch_async_f(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), context, vtbsession_standby_build);
+    return 0;
+
+fail:
+    avcodec_parameters_free(&context->standby_codecpar);
+    return AVERROR(ENOMEM);
+}
+
+// the parameter sets of the session, or of the one being built, repeated
+// e.g. at each discontinuity of an HLS stream
+static bool vtbsession_decodes_extradata(Ijk_VideoToolBox_Opaque *context, const uint8_t *extradata, int extrasize)
+{
+    const AVCodecParameters *par = context->standby_state != VTB_STANDBY_NONE ?
+                                   context->standby_codecpar : context->codecpar;
+
+    return par && par->extradata_size == extrasize && !memcmp(par->extradata, extradata, extrasize);
+}
+
+// called on a key frame, the new session starts clean from it
+static void vtbsession_standby_swap(Ijk_VideoToolBox_Opaque *context)
+{
+    VTDecompressionSessionRef old_session = NULL;
+    VTBSessionTarget         *old_target  = NULL;
+
+    if (vtbsession_standby_wait(context) != VTB_STANDBY_READY) {
+        ALOGW("%s: standby session unavailable, recreate session\n", __FUNCTION__);
+        avcodec_parameters_copy(context->codecpar, context->standby_codecpar);
+        vtbsession_standby_discard(context);
+        context->refresh_request = true;
+        return;
+    }
+
+    // frames already submitted to the old session still come out in order,
+    // while it is released away from the decode thread
+    old_session = context->vt_session;
+    old_target  = context->vt_session_target;
+    if (old_session)
+        VTDecompressionSessionWaitForAsynchronousFrames(old_session);
+
+    vtbformat_destroy(&context->fmt_desc);
+    context->fmt_desc = context->standby_fmt_desc;
+    memset(&context->standby_fmt_desc, 0, sizeof(context->standby_fmt_desc));
+
+    avcodec_parameters_free(&context->codecpar);
+    context->codecpar = context->standby_codecpar;
+    context->standby_codecpar = NULL;
+
+    context->vt_session = context->standby_session;
+    context->vt_session_target = NULL;
+    context->standby_session = NULL;
+    context->output_width  = context->standby_output_width;
+    context->output_height = context->standby_output_height;
+    context->standby_state = VTB_STANDBY_NONE;
+    vtbsession_pool_prepare(context, context->vt_session);
+
+    // a warmed up session is invalidated before its target goes
+    if (old_session && old_target) {
+        vtbsession_release_async(old_session);
+        free(old_target);
+    } else if (old_session) {
+        dispatch_async_f(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), old_session, vtbsession_release_async);
+    }
+
+    ALOGI("%s: switched to %dx%d\n", __FUNCTION__, context->codecpar->width, context->codecpar->height);
+}
+
+static int decode_video(Ijk_VideoToolBox_Opaque* context, AVCodecContext *avctx, AVPacket *avpkt, int* got_picture_ptr)
+{
+    int      ret            = 0;
+    uint8_t *size_data      = NULL;
+    int      size_data_size = 0;
+
+    if (!avpkt || !avpkt->data) {
+        return 0;
+    }
+
+    if (context->ffp->vtb_handle_resolution_change &&
+        context->codecpar->codec_id == AV_CODEC_ID_H264) {
+        size_data = av_packet_get_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA, &size_data_size);
+        // minimum avcC(sps,pps) = 7
+        if (size_data && size_data_size > 7 &&
+            !vtbsession_decodes_extradata(context, size_data, size_data_size)) {
+            int width  = 0;
+            int height = 0;
+            // other parameter sets at the same size, e.g. of an inserted ad,
+            // also take a session of their own, rather than decode errors
+            // and a recreated session
+            if (h264_extradata_get_dimensions(size_data, size_data_size, &width, &height)) {
+                ret = vtbsession_standby_prepare(context, size_data, size_data_size, width, height);
+                if (ret < 0)
+                    return ret;
+            }
+        }
+    }
+
+    bool is_key_frame;
+    if (avpkt->flags & AV_PKT_FLAG_KEY_EXACT) {
+        // the demuxer flags the IDR pictures, see "fflags" "trustkeyframes"
+        is_key_frame = avpkt->flags & AV_PKT_FLAG_KEY;
+    } else {
+        if (ff_avpacket_is_idr(avpkt, context->codecpar->codec_id) == true) {
+            context->idr_based_identified = true;
+        }
+        is_key_frame = ff_avpacket_i_or_idr(avpkt, context->idr_based_identified, context->codecpar->codec_id);
+    }
+    if (is_key_frame) {
+        if (context->standby_state != VTB_STANDBY_NONE)
+            vtbsession_standby_swap(context);
+        ResetPktBuffer(context);
+        context->recovery_drop_packet = false;
+        if (context->scale_to_view && context->vt_session) {
+            int width, height;
+            vtb_output_size(context, context->codecpar, &width, &height);
+            if (width != context->output_width || height != context->output_height) {
+                ALOGI("VTB: output %dx%d -> %dx%d\n", context->output_width, context->output_height, width, height);
+                context->refresh_session = true;
+            }
+        }
+    }
+    // scrubbing: the packets after a dropped one wait for the next key frame,
+    // as after a failed recovery
+    if (!is_key_frame && ffpipeline_ios_is_keyframes_only(context->ffp)) {
+        context->recovery_drop_packet = true;
+        return -1;
+    }
+    if (context->recovery_drop_packet == true) {
+        return -1;
+    }
+
+    DuplicatePkt(context, avpkt);
+
+    if (context->refresh_session) {
+        ret = 0;
+
+        sample_info_flush(context, 1000);
+        vtbsession_destroy(context, true);
+        memset(context->sample_info_array, 0, sizeof(context->sample_info_array));
+        context->sample_infos_in_decoding = 0;
+
+        context->vt_session = vtbsession_create(context);
+        if (!context->vt_session)
+            return -1;
+
+        if ((context->m_buffer_deep > 0) &&
+            ff_avpacket_i_or_idr(&context->m_buffer_packet[0], context->idr_based_identified, context->codecpar->codec_id) == true ) {
+            for (int i = 0; i < context->m_buffer_deep; i++) {
+                AVPacket* pkt = &context->m_buffer_packet[i];
+                ret = decode_video_internal(context, avctx, pkt, got_picture_ptr);
+            }
+        } else {
+            context->recovery_drop_packet = true;
+            ret = -1;
+            ALOGE("recovery error!!!!\n");
+        }
+        context->refresh_session = false;
+        return ret;
+    }
+    vtbsession_pool_keep(context);
+    return decode_video_internal(context, avctx, avpkt, got_picture_ptr);
+}
+
+
+static void dict_set_string(CFMutableDictionaryRef dict, CFStringRef key, const char * value)
+{
+    CFStringRef string;
+    string = CFStringCreateWithCString(NULL, value, kCFStringEncodingASCII);
+    CFDictionarySetValue(dict, key, string);
+    CFRelease(string);
+}
+
+static void dict_set_boolean(CFMutableDictionaryRef dict, CFStringRef key, BOOL value)
+{
+    CFDictionarySetValue(dict, key, value ? kCFBooleanTrue: kCFBooleanFalse);
+}
+
+
+static void dict_set_object(CFMutableDictionaryRef dict, CFStringRef key, CFTypeRef *value)
+{
+    CFDictionarySetValue(dict, key, value);
+}
+
+static void dict_set_data(CFMutableDictionaryRef dict, CFStringRef key, uint8_t * value, uint64_t length)
+{
+    CFDataRef data;
+    data = CFDataCreate(NULL, value, (CFIndex)length);
+    CFDictionarySetValue(dict, key, data);
+    CFRelease(data);
+}
+
+static void dict_set_i32(CFMutableDictionaryRef dict, CFStringRef key,
+                         int32_t value)
+{
+    CFNumberRef number;
+    number = CFNumberCreate(NULL, kCFNumberSInt32Type, &value);
+    CFDictionarySetValue(dict, key, number);
+    CFRelease(number);
+}
+
+static CMFormatDescriptionRef CreateFormatDescriptionFromCodecData(Uint32 format_id, int width, int height, const uint8_t *extradata, int extradata_size, uint32_t atom)
+{
+    CMFormatDescriptionRef fmt_desc = NULL;
+    OSStatus status;
+
+    CFMutableDictionaryRef par = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks,&kCFTypeDictionaryValueCallBacks);
+    CFMutableDictionaryRef atoms = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks,&kCFTypeDictionaryValueCallBacks);
+    CFMutableDictionaryRef extensions = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+    /* CVPixelAspectRatio dict */
+    dict_set_i32(par, CFSTR ("HorizontalSpacing"), 0);
+    dict_set_i32(par, CFSTR ("VerticalSpacing"), 0);
+    /* SampleDescriptionExtensionAtoms dict */
+    if (atom == IJK_VTB_FCC_HVCC)
+        dict_set_data(atoms, CFSTR ("hvcC"), (uint8_t *)extradata, extradata_size);
+    else
+        dict_set_data(atoms, CFSTR ("avcC"), (uint8_t *)extradata, extradata_size);
+
+      /* Extensions dict */
+    dict_set_string(extensions, CFSTR ("CVImageBufferChromaLocationBottomField"), "left");
+    dict_set_string(extensions, CFSTR ("CVImageBufferChromaLocationTopField"), "left");
+    dict_set_boolean(extensions, CFSTR("FullRangeVideo"), FALSE);
+    dict_set_object(extensions, CFSTR ("CVPixelAspectRatio"), (CFTypeRef *) par);
+    dict_set_object(extensions, CFSTR ("SampleDescriptionExtensionAtoms"), (CFTypeRef *) atoms);
+    status = CMVideoFormatDescriptionCreate(NULL, format_id, width, height, extensions, &fmt_desc);
+
+    CFRelease(extensions);
+    CFRelease(atoms);
+    CFRelease(par);
+
+    if (status == 0)
+        return fmt_desc;
+    else
+        return NULL;
+}
+
+void videotoolbox_decoder_free(Ijk_VideoToolBox_Opaque* context)
+{
+    context->dealloced = true;
+    SDL_CondBroadcast(context->sample_info_cond);
+
+    vtbsession_standby_discard(context);
+
+    // the callbacks drop every frame from now on, nothing is waited for:
+    // invalidating ends the decodes still in the session, the flush then
+    // only guards the sample infos they point to
+    vtbsession_destroy(context, false);
+    sample_info_flush(context, VTB_FREE_FLUSH_MS);
+
+    blocked_histogram_report(context);
+
+    while (context && context->m_queue_depth > 0) {
+        SortQueuePop(context);
+    }
+
+    if (context) {
+        FreePktBuffer(context);
+        av_buffer_pool_uninit(&context->avcc_pool);
+        SDL_DestroyCondP(&context->standby_cond);
+        SDL_DestroyMutexP(&context->standby_mutex);
+        SDL_DestroyCondP(&context->sample_info_cond);
+        SDL_DestroyMutexP(&context->sample_info_mutex);
+    }
+
+    vtbformat_destroy(&context->fmt_desc);
+
+    avcodec_parameters_free(&context->codecpar);
+}
+
+int videotoolbox_decoder_decode_frame(Ijk_VideoToolBox_Opaque* context)
+{
+    FFPlayer *ffp = context->ffp;
+    VideoState *is = ffp->is;
+    Decoder *d = &is->viddec;
+    int got_frame = 0;
+    do {
+        int ret = -1;
+        if (is->abort_request || d->queue->abort_request) {
+            return -1;
+        }
+
+        if (!d->packet_pending || d->queue->serial != d->pkt_serial) {
+            AVPacket pkt;
+            do {
+                if (d->queue->nb_packets == 0)
+                    SDL_CondSignal(d->empty_queue_cond);
+                ffp_video_statistic_l(ffp);
+                if (ffp_packet_queue_get_or_buffering(ffp, d->queue, &pkt, &d->pkt_serial, &d->finished) < 0)
+                    return -1;
+                if (ffp_is_flush_packet(&pkt)) {
+                    avcodec_flush_buffers(d->avctx);
+                    context->refresh_request = true;
+                    context->serial += 1;
+                    context->seek_skipped_frames = 0;
+                    ffpipeline_ios_set_seek_skipped_frames(ffp, 0);
+                    d->finished = 0;
+                    ALOGI("flushed last keyframe pts %lld \n",d->pkt.pts);
+                    d->next_pts = d->start_pts;
+                    d->next_pts_tb = d->start_pts_tb;
+                }
+            } while (ffp_is_flush_packet(&pkt) || d->queue->serial != d->pkt_serial);
+
+            av_packet_split_side_data(&pkt);
+            if (vtb_packet_to_avcc(context, &pkt) < 0)
+                ALOGW("%s: failed to rewrite the packet to NAL lengths\n", __func__);
+            // before any skip or drop, the frame shown next fires what it carried
+            ffpipeline_ios_put_sei(ffp, &pkt, d->pkt_serial);
+
+            av_packet_unref(&d->pkt);
+            d->pkt_temp = d->pkt = pkt;
+            d->packet_pending = 1;
+            context->packet_dequeue_time = IJKSDLFrameTiming_now();
+            ffdecoder_benchmark_did_dequeue(context->benchmark, context->packet_dequeue_time);
+
+            if (!context->first_packet_traced) {
+                context->first_packet_traced = true;
+                ijk_trace_event(IJK_TRACE_FIRST_PACKET, ffp, "videotoolbox");
+                ffpipeline_ios_did_take_first_packet(ffp);
+            }
+        }
+
+        ret = decode_video(context, d->avctx, &d->pkt_temp, &got_frame);
+        if (ret < 0) {
+            d->packet_pending = 0;
+        } else {
+            d->pkt_temp.dts =
+            d->pkt_temp.pts = AV_NOPTS_VALUE;
+            if (d->pkt_temp.data) {
+                if (d->avctx->codec_type != AVMEDIA_TYPE_AUDIO)
+                    ret = d->pkt_temp.size;
+                d->pkt_temp.data += ret;
+                d->pkt_temp.size -= ret;
+                if (d->pkt_temp.size <= 0)
+                    d->packet_pending = 0;
+            } else {
+                if (!got_frame) {
+                    d->packet_pending = 0;
+                    d->finished = d->pkt_serial;
+                }
+            }
+        }
+    } while (!got_frame && !d->finished);
+
+    if (d->finished)
+        ffdecoder_benchmark_did_finish(context->benchmark);
+    return got_frame;
+}
+
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+static bool vtbformat_is_hevc_supported()
+{
+    if (@available(iOS 11.0, *)) {
+        return VTIsHardwareDecodeSupported(kCMVideoCodecType_HEVC);
+    }
+    return false;
+}
+#endif
+
+static void vtbformat_destroy(VTBFormatDesc *fmt_desc)
+{
+    if (!fmt_desc || !fmt_desc->fmt_desc)
+        return;
+
+    CFRelease(fmt_desc->fmt_desc);
+    fmt_desc->fmt_desc = NULL;
+}
+
+static int vtbformat_init(VTBFormatDesc *fmt_desc, AVCodecParameters *codecpar)
+{
+    int width           = codecpar->width;
+    int height          = codecpar->height;
+    int level           = codecpar->level;
+    int profile         = codecpar->profile;
+    int sps_level       = 0;
+    int sps_profile     = 0;
+    int extrasize       = codecpar->extradata_size;
+    int codec           = codecpar->codec_id;
+    uint8_t* extradata  = codecpar->extradata;
+
+#if 0
+    switch (profile) {
+        case FF_PROFILE_H264_HIGH_10:
+            if ([IJKDeviceModel currentModel].rank >= kIJKDeviceRank_AppleA7Class) {
+                // Apple A7 SoC
+                // Hi10p can be decoded into NV12 ('420v')
+                break;
+            }
+        case FF_PROFILE_H264_HIGH_10_INTRA:
+        case FF_PROFILE_H264_HIGH_422:
+        case FF_PROFILE_H264_HIGH_422_INTRA:
+        case FF_PROFILE_H264_HIGH_444_PREDICTIVE:
+        case FF_PROFILE_H264_HIGH_444_INTRA:
+        case FF_PROFILE_H264_CAVLC_444:
+            goto failed;
+    }
+#endif
+    if (width < 0 || height < 0) {
+        goto fail;
+    }
+
+    switch (codec) {
+        case AV_CODEC_ID_H264:
+            if (extrasize < 7 || extradata == NULL) {
+                ALOGI("%s - avcC atom too data small or missing", __FUNCTION__);
+                goto fail;
+            }
+
+            if (extradata[0] == 1) {
+                if (!validate_avcC_spc(extradata, extrasize, &fmt_desc->max_ref_frames, &sps_level, &sps_profile)) {
+                    //goto failed;
+                }
+                fmt_desc->no_reordering = h264_avcC_no_reordering(extradata, extrasize);
+                if (level == 0 && sps_level > 0)
+                    level = sps_level;
+
+                if (profile == 0 && sps_profile > 0)
+                    profile = sps_profile;
+                if (profile == FF_PROFILE_H264_MAIN && level == 32 && fmt_desc->max_ref_frames > 4) {
+                    ALOGE("%s - Main@L3.2 detected, VTB cannot decode with %d ref frames", __FUNCTION__, fmt_desc->max_ref_frames);
+                    goto fail;
+                }
+
+                if (extradata[4] == 0xFE) {
+                    extradata[4] = 0xFF;
+                    fmt_desc->convert_3byteTo4byteNALSize = true;
+                }
+
+                fmt_desc->fmt_desc = CreateFormatDescriptionFromCodecData(kCMVideoCodecType_H264, width, height, extradata, extrasize,  IJK_VTB_FCC_AVCC);
+                if (fmt_desc->fmt_desc == NULL) {
+                    goto fail;
+                }
+
+                ALOGI("%s - using avcC atom of size(%d), ref_frames(%d)", __FUNCTION__, extrasize, fmt_desc->max_ref_frames);
+            } else {
+                if ((extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 0 && extradata[3] == 1) ||
+                    (extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 1)) {
+                    AVIOContext *pb;
+                    if (avio_open_dyn_buf(&pb) < 0) {
+                        goto fail;
+                    }
+
+                    fmt_desc->convert_bytestream = true;
+                    ff_isom_write_avcc(pb, extradata, extrasize);
+                    extradata = NULL;
+
+                    extrasize = avio_close_dyn_buf(pb, &extradata);
+
+                    if (!validate_avcC_spc(extradata, extrasize, &fmt_desc->max_ref_frames, &sps_level, &sps_profile)) {
+                        av_free(extradata);
+                        goto fail;
+                    }
+                    fmt_desc->no_reordering = h264_avcC_no_reordering(extradata, extrasize);
+
+                    fmt_desc->fmt_desc = CreateFormatDescriptionFromCodecData(kCMVideoCodecType_H264, width, height, extradata, extrasize, IJK_VTB_FCC_AVCC);
+                    if (fmt_desc->fmt_desc == NULL) {
+                        goto fail;
+                    }
+
+                    av_free(extradata);
+                } else {
+                    ALOGI("%s - invalid avcC atom data", __FUNCTION__);
+                    goto fail;
+                }
+            }
+            break;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+        case AV_CODEC_ID_HEVC:
+            if (!vtbformat_is_hevc_supported()) {
+                ALOGI("%s - HEVC hardware decoder not available", __FUNCTION__);
+                goto fail;
+            }
+
+            // minimum hvcC header = 23
+            if (extrasize < 23 || extradata == NULL) {
+                ALOGI("%s - hvcC atom too data small or missing", __FUNCTION__);
+                goto fail;
+            }
+
+            // reorder depth is not carried by hvcC, assume a B-pyramid of 4
+            fmt_desc->max_ref_frames = 4;
+
+            if (extradata[0] == 1) {
+                // lengthSizeMinusOne is the low 2 bits of hvcC byte 21
+                if ((extradata[21] & 0x03) == 2) {
+                    extradata[21] |= 0x03;
+                    fmt_desc->convert_3byteTo4byteNALSize = true;
+                }
+
+                fmt_desc->fmt_desc = CreateFormatDescriptionFromCodecData(kCMVideoCodecType_HEVC, width, height, extradata, extrasize, IJK_VTB_FCC_HVCC);
+                if (fmt_desc->fmt_desc == NULL) {
+                    goto fail;
+                }
+
+                ALOGI("%s - using hvcC atom of size(%d)", __FUNCTION__, extrasize);
+            } else {
+                if ((extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 0 && extradata[3] == 1) ||
+                    (extradata[0] == 0 && extradata[1] == 0 && extradata[2] == 1)) {
+                    AVIOContext *pb;
+                    if (avio_open_dyn_buf(&pb) < 0) {
+                        goto fail;
+                    }
+
+                    fmt_desc->convert_bytestream = true;
+                    ff_isom_write_hvcc(pb, extradata, extrasize, 0);
+                    extradata = NULL;
+
+                    extrasize = avio_close_dyn_buf(pb, &extradata);
+                    if (extrasize < 23) {
+                        av_free(extradata);
+                        goto fail;
+                    }
+
+                    fmt_desc->fmt_desc = CreateFormatDescriptionFromCodecData(kCMVideoCodecType_HEVC, width, height, extradata, extrasize, IJK_VTB_FCC_HVCC);
+                    av_free(extradata);
+                    if (fmt_desc->fmt_desc == NULL) {
+                        goto fail;
+                    }
+                } else {
+                    ALOGI("%s - invalid hvcC atom data", __FUNCTION__);
+                    goto fail;
+                }
+            }
+            break;
+#endif
+        default:
+            goto fail;
+    }
+
+    fmt_desc->max_ref_frames = FFMAX(fmt_desc->max_ref_frames, 2);
+    fmt_desc->max_ref_frames = FFMIN(fmt_desc->max_ref_frames, 5);
+
+    ALOGI("m_max_ref_frames %d%s\n", fmt_desc->max_ref_frames, fmt_desc->no_reordering ? ", no reordering" : "");
+
+    return 0;
+fail:
+    vtbformat_destroy(fmt_desc);
+    return -1;
+}
+
+Ijk_VideoToolBox_Opaque* videotoolbox_decoder_create(FFPlayer* ffp, AVCodecContext* avctx, bool async)
+{
+    int ret = 0;
+
+    if (ret) {
+        ALOGW("%s - videotoolbox can not exists twice at the same time", __FUNCTION__);
+        return NULL;
+    }
+
+    Ijk_VideoToolBox_Opaque *context_vtb = (Ijk_VideoToolBox_Opaque *)mallocz(sizeof(Ijk_VideoToolBox_Opaque));
+
+    context_vtb->sample_info_mutex = SDL_CreateMutex();
+    context_vtb->sample_info_cond  = SDL_CreateCond();
+
+    if (!context_vtb) {
+        goto fail;
+    }
+
+    context_vtb->codecpar = avcodec_parameters_alloc();
+    if (!context_vtb->codecpar)
+        goto fail;
+
+    ret = avcodec_parameters_from_context(context_vtb->codecpar, avctx);
+    if (ret)
+        goto fail;
+
+    context_vtb->ffp = ffp;
+    context_vtb->async = async;
+    context_vtb->idr_based_identified = true;
+
+    // a synchronous session returns from DecodeFrame with the sample already recycled
+    if (async)
+        context_vtb->sample_info_max = (int)av_clip64(ffpipeline_ios_get_option_int(ffp, "videotoolbox-max-decoding-samples", VTB_DEFAULT_DECODING_SAMPLES),
+                                                      1, VTB_MAX_DECODING_SAMPLES);
+    else
+        context_vtb->sample_info_max = 1;
+    context_vtb->sample_info_window = context_vtb->sample_info_max;
+    context_vtb->fast_first_frame   = ffpipeline_ios_get_option_int(ffp, "fast-first-frame", 0) != 0;
+    context_vtb->low_latency        = ffpipeline_ios_get_option_int(ffp, "videotoolbox-low-latency", 0) != 0;
+    context_vtb->hdr_output         = ffpipeline_ios_get_option_int(ffp, "videotoolbox-hdr", 0) != 0;
+    context_vtb->scale_to_view      = ffpipeline_ios_get_option_int(ffp, "videotoolbox-scale-to-view", 1) != 0;
+    context_vtb->benchmark          = ffpipeline_ios_get_decoder_benchmark(ffp);
+
+    context_vtb->standby_mutex = SDL_CreateMutex();
+    context_vtb->standby_cond  = SDL_CreateCond();
+    if (!context_vtb->standby_mutex || !context_vtb->standby_cond)
+        goto fail;
+
+    ret = vtbformat_init(&context_vtb->fmt_desc, context_vtb->codecpar);
+    if (ret)
+        goto fail;
+    assert(context_vtb->fmt_desc.fmt_desc);
+    vtbformat_destroy(&context_vtb->fmt_desc);
+
+    atomic_init(&context_vtb->m_queue_depth, 0);
+
+    context_vtb->vt_session = vtbsession_create(context_vtb);
+    if (context_vtb->vt_session == NULL)
+        goto fail;
+
+    SDL_SpeedSamplerReset(&context_vtb->sampler);
+    return context_vtb;
+
+fail:
+    videotoolbox_decoder_free(context_vtb);
+    return NULL;
+}
@@ -22,35 +22,710 @@
 
 #include "ffpipeline_ios.h"
 #include "ffpipenode_ios_videotoolbox_vdec.h"
+#include "ffpipenode_ios_hwaccel_vdec.h"
 #include "ffpipenode_ffplay_vdec.h"
+#include "ffpipeline_ios_vdec_caps.h"
+#include "ffpipeline_ios_pictq_depth.h"
 #include "ff_ffplay.h"
+#include "libavcodec/slice_pool.h"
+#include "libavformat/throughput.h"
 #import "ijksdl/ios/ijksdl_aout_ios_audiounit.h"
+#include <math.h>
+#include <pthread.h>
 
 struct IJKFF_Pipeline_Opaque {
-    FFPlayer    *ffp;
-    bool         is_videotoolbox_open;
+    FFPlayer       *ffp;
+    bool            is_videotoolbox_open;
+    bool            holds_software_decoder;
+    volatile bool   keyframes_only;
+    volatile int    decode_degradation;
+    volatile int    seek_skipped_frames;
+    // max-fps cadence of the video decoder, in frames times the frame rate denominator
+    int64_t         decimation_credit;
+    int64_t         decimation_source_rate;
+    volatile int64_t decimated_frames;
+    volatile int64_t first_packet_tick;
+    volatile int64_t pixel_buffer_allocations;
+    volatile int64_t pixel_buffer_steady_allocations;
+    volatile int64_t decoder_buffered_bytes;
+    volatile int    frame_queue_limit;
+    // "video-pictq-adaptive", updated by the VideoToolbox output thread
+    bool            pictq_adaptive;
+    FFPictqDepth    pictq_depth;
+    volatile int    pictq_depth_value;
+    volatile int64_t frame_queue_budget;
+    // "dynamic-buffering", the high water marks and what they came from
+    bool            buffering_seeded;
+    FFBufferingThresholds buffering;
+    // pixels of the view, width in the high half, 0 if unknown
+    volatile int64_t video_output_size;
+    // "decoder-benchmark", created with the video decoder
+    FFDecoderBenchmark *benchmark;
+    // the slice threads of the player on the pool shared by the process
+    int             slice_pool_client;
+    // for the audio output opened next, see ffpipeline_ios_set_audio_analysis()
+    bool            audio_analysis;
+    float           loudness_target;
+    // a reference, for the audio output opened next
+    IJKSyncProbe   *sync_probe;
+    // read by the app without the player mutex, published by props_thread
+    FFPropertyPublisher props;
+    SDL_Thread      _props_thread;
+    SDL_Thread     *props_thread;
+    SDL_mutex      *props_mutex;
+    SDL_cond       *props_cond;
+    bool            props_abort;
+    pthread_mutex_t *player_mutex;
+    // SEI until the frame of its time is presented
+    FFTimedMetadataQueue *timed_metadata;
 };
 
+static SDL_Class g_pipeline_class = {
+    .name = "ffpipeline_ios",
+};
+
+static pthread_mutex_t g_software_decoder_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int             g_software_decoder_count = 0;
+static int             g_software_decoder_max   = 0;
+
+// every player of the process decoding in software competes for the same cores
+static bool software_decoder_acquire(IJKFF_Pipeline_Opaque *opaque, bool force)
+{
+    bool acquired = false;
+
+    pthread_mutex_lock(&g_software_decoder_mutex);
+    if (opaque->holds_software_decoder) {
+        acquired = true;
+    } else if (force || g_software_decoder_max <= 0 || g_software_decoder_count < g_software_decoder_max) {
+        g_software_decoder_count++;
+        opaque->holds_software_decoder = true;
+        acquired = true;
+    }
+    pthread_mutex_unlock(&g_software_decoder_mutex);
+    return acquired;
+}
+
+static void software_decoder_release(IJKFF_Pipeline_Opaque *opaque)
+{
+    pthread_mutex_lock(&g_software_decoder_mutex);
+    if (opaque->holds_software_decoder) {
+        g_software_decoder_count--;
+        opaque->holds_software_decoder = false;
+    }
+    pthread_mutex_unlock(&g_software_decoder_mutex);
+}
+
+void ffpipeline_ios_set_max_software_decoders(int max)
+{
+    pthread_mutex_lock(&g_software_decoder_mutex);
+    g_software_decoder_max = max;
+    pthread_mutex_unlock(&g_software_decoder_mutex);
+}
+
+int ffpipeline_ios_get_software_decoder_count(void)
+{
+    int count;
+
+    pthread_mutex_lock(&g_software_decoder_mutex);
+    count = g_software_decoder_count;
+    pthread_mutex_unlock(&g_software_decoder_mutex);
+    return count;
+}
+
+// the discards of the software decoder: the options of the player, raised
+// by the degradation level, and key frames only while scrubbing
+static void apply_software_discard(IJKFF_Pipeline_Opaque *opaque)
+{
+    FFPlayer *ffp   = opaque->ffp;
+    int       level = opaque->decode_degradation;
+
+    if (opaque->is_videotoolbox_open || !ffp->is || !ffp->is->viddec.avctx)
+        return;
+
+    AVCodecContext *avctx = ffp->is->viddec.avctx;
+    enum AVDiscard  loop_filter = ffp->skip_loop_filter;
+    enum AVDiscard  frame       = ffp->skip_frame;
+    enum AVDiscard  idct        = AVDISCARD_DEFAULT;
+
+    if (level >= 1)
+        loop_filter = FFMAX(loop_filter, AVDISCARD_NONREF);
+    if (level >= 2)
+        loop_filter = AVDISCARD_ALL;
+    if (level >= 3)
+        frame = FFMAX(frame, AVDISCARD_NONREF);
+    if (level >= 4)
+        idct = AVDISCARD_NONREF;
+    if (opaque->keyframes_only)
+        frame = AVDISCARD_NONKEY;
+
+    avctx->skip_loop_filter = loop_filter;
+    avctx->skip_frame       = frame;
+    avctx->skip_idct        = idct;
+}
+
+void ffpipeline_ios_set_keyframes_only(IJKFF_Pipeline *pipeline, bool keyframes_only)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    pipeline->opaque->keyframes_only = keyframes_only;
+    apply_software_discard(pipeline->opaque);
+}
+
+bool ffpipeline_ios_is_keyframes_only(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return false;
+
+    return ffp->pipeline->opaque->keyframes_only;
+}
+
+void ffpipeline_ios_set_decode_degradation(IJKFF_Pipeline *pipeline, int level)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    pipeline->opaque->decode_degradation = av_clip(level, 0, FFP_IOS_DECODE_DEGRADATION_MAX);
+    apply_software_discard(pipeline->opaque);
+}
+
+int ffpipeline_ios_get_slice_pool_client(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    return pipeline->opaque->slice_pool_client;
+}
+
+void ffpipeline_ios_set_decode_background(IJKFF_Pipeline *pipeline, bool background)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    av_slice_pool_client_set_priority(pipeline->opaque->slice_pool_client,
+                                      background ? AV_SLICE_POOL_BACKGROUND : AV_SLICE_POOL_FOREGROUND);
+}
+
+void ffpipeline_ios_set_seek_skipped_frames(FFPlayer *ffp, int count)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    ffp->pipeline->opaque->seek_skipped_frames = count;
+}
+
+int ffpipeline_ios_get_seek_skipped_frames(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    return pipeline->opaque->seek_skipped_frames;
+}
+
+// every frame adds max-fps to the credit, a slot costs the frame rate of
+// the stream: 60 fps capped to 30 has a slot every other frame
+bool ffpipeline_ios_decimation_due(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return false;
+
+    IJKFF_Pipeline_Opaque *opaque = ffp->pipeline->opaque;
+    VideoState            *is     = ffp->is;
+
+    opaque->decimation_source_rate = 0;
+    if (ffp->max_fps <= 0 || !is || !is->ic || !is->video_st)
+        return false;
+
+    AVRational rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
+    if (rate.num <= 0 || rate.den <= 0)
+        return false;
+
+    int64_t source = rate.num;
+    int64_t cap    = (int64_t)ffp->max_fps * rate.den;
+    if (cap >= source) {
+        opaque->decimation_credit = 0;
+        return false;
+    }
+
+    opaque->decimation_credit += cap;
+    if (opaque->decimation_credit >= source) {
+        opaque->decimation_credit -= source;
+        return false;
+    }
+    opaque->decimation_source_rate = source;
+    return true;
+}
+
+void ffpipeline_ios_did_decimate(FFPlayer *ffp, bool left_out)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = ffp->pipeline->opaque;
+    int64_t                source = opaque->decimation_source_rate;
+
+    if (left_out)
+        opaque->decimated_frames++;
+    else if (source > 0)
+        opaque->decimation_credit = FFMAX(opaque->decimation_credit - source, -source);
+}
+
+int64_t ffpipeline_ios_get_decimated_frames(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    return pipeline->opaque->decimated_frames;
+}
+
+void ffpipeline_ios_did_take_first_packet(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    if (!ffp->pipeline->opaque->first_packet_tick)
+        ffp->pipeline->opaque->first_packet_tick = (int64_t)SDL_GetTickHR();
+}
+
+int64_t ffpipeline_ios_get_first_packet_tick(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    return pipeline->opaque->first_packet_tick;
+}
+
+void ffpipeline_ios_set_pixel_buffer_allocations(FFPlayer *ffp, int64_t total, int64_t steady)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    ffp->pipeline->opaque->pixel_buffer_allocations        = total;
+    ffp->pipeline->opaque->pixel_buffer_steady_allocations = steady;
+}
+
+void ffpipeline_ios_get_pixel_buffer_allocations(IJKFF_Pipeline *pipeline, int64_t *total, int64_t *steady)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class) {
+        *total  = 0;
+        *steady = 0;
+        return;
+    }
+
+    *total  = pipeline->opaque->pixel_buffer_allocations;
+    *steady = pipeline->opaque->pixel_buffer_steady_allocations;
+}
+
+void ffpipeline_ios_set_video_output_size(IJKFF_Pipeline *pipeline, int width, int height)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    if (width <= 0 || height <= 0)
+        pipeline->opaque->video_output_size = 0;
+    else
+        pipeline->opaque->video_output_size = ((int64_t)width << 32) | (uint32_t)height;
+}
+
+bool ffpipeline_ios_get_video_output_size(FFPlayer *ffp, int *width, int *height)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return false;
+
+    int64_t size = ffp->pipeline->opaque->video_output_size;
+    if (!size)
+        return false;
+
+    *width  = (int)(size >> 32);
+    *height = (int)(uint32_t)size;
+    return true;
+}
+
+void ffpipeline_ios_set_decoder_buffered_bytes(FFPlayer *ffp, int64_t bytes)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    ffp->pipeline->opaque->decoder_buffered_bytes = bytes;
+}
+
+int64_t ffpipeline_ios_get_decoder_buffered_bytes(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    return pipeline->opaque->decoder_buffered_bytes;
+}
+
+int64_t ffpipeline_ios_get_frame_queue_bytes(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    VideoState *is = pipeline->opaque->ffp->is;
+    if (!is || !is->video_st || !is->video_st->codecpar)
+        return 0;
+
+    // 4:2:0 at 8 bits, as VideoToolbox and the software decoder output
+    AVCodecParameters *codecpar = is->video_st->codecpar;
+    return (int64_t)is->pictq.size * codecpar->width * codecpar->height * 3 / 2;
+}
+
+void ffpipeline_ios_set_frame_queue_limit(IJKFF_Pipeline *pipeline, int limit)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    pipeline->opaque->frame_queue_limit = limit;
+}
+
+// the download rate against the bit rate of the stream, see ffpipeline_ios_buffering.h
+static void update_buffering(IJKFF_Pipeline_Opaque *opaque, FFPlayer *ffp, bool rebuffer)
+{
+    FFBufferingThresholds *b = &opaque->buffering;
+    ThroughputEstimate     estimate;
+
+    if (!ffpipeline_ios_get_option_int(ffp, "dynamic-buffering", 0) || (!rebuffer && opaque->buffering_seeded))
+        return;
+
+    b->bit_rate = ffp_get_property_int64(ffp, FFP_PROP_INT64_BIT_RATE, 0);
+    b->rate     = ffp_get_property_int64(ffp, FFP_PROP_INT64_TCP_SPEED, 0) * 8;
+    if (b->rate <= 0 && av_throughput_get_estimate(ffp->is ? ffp->is->filename : NULL, &estimate) >= 0)
+        b->rate = estimate.bandwidth;
+    if (b->bit_rate <= 0 || b->rate <= 0)
+        return;
+
+    int    horizon_ms = ffpipeline_ios_get_option_int(ffp, "buffering-horizon-ms", 10000);
+    double confidence = av_clip(ffpipeline_ios_get_option_int(ffp, "buffering-confidence", 90), 1, 99) / 100.0;
+    int    max_ms     = ffp->dcc.last_high_water_mark_in_ms;
+    int    resume_ms  = ffbuffering_threshold_ms(b->rate, b->bit_rate, horizon_ms, confidence,
+                                                 FF_BUFFERING_MIN_RESUME_MS, max_ms);
+
+    // the core goes from next to doubling it up to last on each stall, the
+    // model takes over: the stall under way ends at what the rate allows now
+    if (rebuffer) {
+        ffp->dcc.next_high_water_mark_in_ms    = resume_ms;
+        ffp->dcc.current_high_water_mark_in_ms = resume_ms;
+    } else {
+        b->start_ms = ffbuffering_threshold_ms(b->rate, b->bit_rate, horizon_ms, confidence,
+                                               FF_BUFFERING_MIN_START_MS, max_ms);
+        ffp->dcc.first_high_water_mark_in_ms   = b->start_ms;
+        ffp->dcc.current_high_water_mark_in_ms = b->start_ms;
+        ffp->dcc.next_high_water_mark_in_ms    = resume_ms;
+        opaque->buffering_seeded = true;
+    }
+    b->resume_ms = resume_ms;
+    ALOGI("buffering: %lld bps for %lld bps, start %d ms, resume %d ms\n",
+          (long long)b->rate, (long long)b->bit_rate, b->start_ms, b->resume_ms);
+}
+
+void ffpipeline_ios_update_buffering(IJKFF_Pipeline *pipeline, bool rebuffer)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    update_buffering(pipeline->opaque, pipeline->opaque->ffp, rebuffer);
+}
+
+bool ffpipeline_ios_get_buffering(IJKFF_Pipeline *pipeline, FFBufferingThresholds *thresholds)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class || !pipeline->opaque->buffering_seeded)
+        return false;
+
+    *thresholds = pipeline->opaque->buffering;
+    return true;
+}
+
+// the memory shedding limit, and the adaptive depth under it
+static int frame_queue_limit(IJKFF_Pipeline_Opaque *opaque)
+{
+    int limit = opaque->frame_queue_limit;
+
+    if (opaque->pictq_adaptive && opaque->is_videotoolbox_open)
+        limit = limit > 0 ? FFMIN(limit, opaque->pictq_depth_value) : opaque->pictq_depth_value;
+    return limit;
+}
+
+void ffpipeline_ios_wait_frame_queue_limit(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class || !ffp->is)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = ffp->pipeline->opaque;
+    int                    limit  = frame_queue_limit(opaque);
+    FrameQueue            *f      = &ffp->is->pictq;
+    if (limit <= 0)
+        return;
+
+    // the queue signals as frames are shown, the timeout catches a new limit
+    SDL_LockMutex(f->mutex);
+    while (f->size - f->rindex_shown >= limit && !f->pktq->abort_request) {
+        SDL_CondWaitTimeout(f->cond, f->mutex, 100);
+        if ((limit = frame_queue_limit(opaque)) <= 0)
+            break;
+    }
+    SDL_UnlockMutex(f->mutex);
+}
+
+void ffpipeline_ios_did_decode_frame(FFPlayer *ffp, int64_t decode_us, double frame_duration)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class || !ffp->is)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = ffp->pipeline->opaque;
+    if (!opaque->pictq_adaptive || decode_us < 0)
+        return;
+
+    int                max_frames = 0;
+    int64_t            budget     = opaque->frame_queue_budget;
+    AVCodecParameters *codecpar   = ffp->is->video_st ? ffp->is->video_st->codecpar : NULL;
+    // 4:2:0 at 8 bits, as ffpipeline_ios_get_frame_queue_bytes()
+    if (budget > 0 && codecpar && codecpar->width > 0 && codecpar->height > 0)
+        max_frames = (int)FFMIN(budget / ((int64_t)codecpar->width * codecpar->height * 3 / 2), INT_MAX);
+
+    int former = opaque->pictq_depth.depth;
+    int depth  = ffpictq_depth_update(&opaque->pictq_depth, SDL_GetTickHR() / 1000.0,
+                                      decode_us / 1000000.0, frame_duration, max_frames);
+    if (depth != former)
+        ALOGI("pictq depth %d -> %d, decode time %.1f +- %.1f ms\n", former, depth,
+              opaque->pictq_depth.mean * 1000, sqrt(opaque->pictq_depth.variance) * 1000);
+    opaque->pictq_depth_value = depth;
+}
+
+void ffpipeline_ios_set_frame_queue_budget(IJKFF_Pipeline *pipeline, int64_t bytes)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    pipeline->opaque->frame_queue_budget = bytes;
+}
+
+int ffpipeline_ios_get_frame_queue_depth(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return 0;
+
+    int limit = frame_queue_limit(pipeline->opaque);
+    return limit > 0 ? limit : pipeline->opaque->ffp->pictq_size;
+}
+
+void ffpipeline_ios_set_max_buffer_size(IJKFF_Pipeline *pipeline, int bytes)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    // read_thread checks it on every packet
+    pipeline->opaque->ffp->dcc.max_buffer_size = bytes;
+}
+
+FFDecoderBenchmark *ffpipeline_ios_get_decoder_benchmark(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return NULL;
+
+    return ffp->pipeline->opaque->benchmark;
+}
+
+int ffpipeline_ios_get_decoder_benchmark_result(IJKFF_Pipeline *pipeline, FFDecoderBenchmarkResult *result)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class || !pipeline->opaque->benchmark)
+        return -1;
+
+    ffdecoder_benchmark_get_result(pipeline->opaque->benchmark, result);
+    return 0;
+}
+
+// of the packet queue of the video, of the audio without video; the
+// serial of a packet read now, and of the frames decoded from it
+static int timed_metadata_serial(FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+
+    return is->video_st ? is->videoq.serial : is->audioq.serial;
+}
+
+// seconds of the media, as IJK_VTB_ATTACHMENT_PTS
+static double timed_metadata_time(FFPlayer *ffp, AVStream *st, int64_t ts)
+{
+    int64_t start_time = ffp->is->ic->start_time;
+
+    return ts * av_q2d(st->time_base) - (start_time != AV_NOPTS_VALUE ? start_time / (double)AV_TIME_BASE : 0);
+}
+
+void ffpipeline_ios_set_timed_metadata(IJKFF_Pipeline *pipeline, bool enabled)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    fftimed_metadata_set_enabled(pipeline->opaque->timed_metadata, enabled);
+}
+
+void ffpipeline_ios_put_sei(FFPlayer *ffp, const AVPacket *pkt, int serial)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = ffp->pipeline->opaque;
+    VideoState            *is     = ffp->is;
+    int64_t                ts     = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+    if (!fftimed_metadata_is_enabled(opaque->timed_metadata) || !is || !is->video_st || ts == AV_NOPTS_VALUE)
+        return;
+
+    fftimed_metadata_put_sei(opaque->timed_metadata, serial, timed_metadata_time(ffp, is->video_st, ts),
+                             pkt->data, pkt->size, is->video_st->codecpar->codec_id == AV_CODEC_ID_HEVC);
+}
+
+bool ffpipeline_ios_has_timed_metadata(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return false;
+
+    return !fftimed_metadata_is_empty(pipeline->opaque->timed_metadata);
+}
+
+CFArrayRef ffpipeline_ios_take_timed_metadata(FFPlayer *ffp, double time)
+{
+    if (!ffp || !ffp->pipeline || ffp->pipeline->opaque_class != &g_pipeline_class || !ffp->is)
+        return NULL;
+
+    // the entries of a former serial, read before a seek, are dropped
+    return fftimed_metadata_take(ffp->pipeline->opaque->timed_metadata, timed_metadata_serial(ffp), time);
+}
+
+static int props_thread(void *arg)
+{
+    IJKFF_Pipeline_Opaque *opaque = arg;
+
+    SDL_LockMutex(opaque->props_mutex);
+    while (!opaque->props_abort) {
+        SDL_UnlockMutex(opaque->props_mutex);
+        pthread_mutex_lock(opaque->player_mutex);
+        ffprops_publish(&opaque->props, opaque->ffp);
+        pthread_mutex_unlock(opaque->player_mutex);
+
+        SDL_LockMutex(opaque->props_mutex);
+        if (!opaque->props_abort)
+            SDL_CondWaitTimeout(opaque->props_cond, opaque->props_mutex, FFP_PROPS_PUBLISH_MS);
+    }
+    SDL_UnlockMutex(opaque->props_mutex);
+    return 0;
+}
+
+int ffpipeline_ios_start_publishing_properties(IJKFF_Pipeline *pipeline, pthread_mutex_t *player_mutex)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class || !player_mutex)
+        return -1;
+
+    IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
+    if (opaque->props_thread)
+        return 0;
+    if (!opaque->props_mutex || !opaque->props_cond)
+        return -1;
+
+    opaque->player_mutex = player_mutex;
+    opaque->props_abort  = false;
+    opaque->props_thread = SDL_CreateThreadEx(&opaque->_props_thread, props_thread, opaque, "ff_props");
+    return opaque->props_thread ? 0 : -1;
+}
+
+void ffpipeline_ios_stop_publishing_properties(IJKFF_Pipeline *pipeline)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class || !pipeline->opaque->props_thread)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
+    SDL_LockMutex(opaque->props_mutex);
+    opaque->props_abort = true;
+    SDL_CondSignal(opaque->props_cond);
+    SDL_UnlockMutex(opaque->props_mutex);
+    SDL_WaitThread(opaque->props_thread, NULL);
+    opaque->props_thread = NULL;
+}
+
+bool ffpipeline_ios_read_properties(IJKFF_Pipeline *pipeline, FFPropertySnapshot *snapshot)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return false;
+
+    return ffprops_read(&pipeline->opaque->props, snapshot);
+}
+
 static void func_destroy(IJKFF_Pipeline *pipeline)
 {
+    software_decoder_release(pipeline->opaque);
+    ffdecoder_benchmark_freep(&pipeline->opaque->benchmark);
+    fftimed_metadata_freep(&pipeline->opaque->timed_metadata);
+    av_slice_pool_client_close(pipeline->opaque->slice_pool_client);
+    ijk_sync_probe_unref(&pipeline->opaque->sync_probe);
+    // stopped by then, see ffpipeline_ios_stop_publishing_properties()
+    SDL_DestroyCondP(&pipeline->opaque->props_cond);
+    SDL_DestroyMutexP(&pipeline->opaque->props_mutex);
+}
+
+// IJKVideoToolBox for H.264 and HEVC, the hwaccel of libavcodec for the
+// codecs it also knows, see "videotoolbox-hwaccel"
+static IJKFF_Pipenode *open_videotoolbox_decoder(FFPlayer *ffp)
+{
+    IJKFF_Pipenode *node     = NULL;
+    int64_t         hwaccel  = ffpipeline_ios_get_option_int(ffp, "videotoolbox-hwaccel", FF_VTB_HWACCEL_FALLBACK);
+    AVCodecParameters *codecpar = ffp->is && ffp->is->video_st ? ffp->is->video_st->codecpar : NULL;
+    enum AVCodecID  codec_id = codecpar ? codecpar->codec_id : AV_CODEC_ID_NONE;
+
+    // the session would be refused, as it was on this device and OS before
+    if (!ffvdec_caps_vtb_supports(codecpar)) {
+        ALOGI("videotoolbox: %dx%d level %d not supported by this device\n",
+              codecpar->width, codecpar->height, codecpar->level);
+        return NULL;
+    }
+
+    if (hwaccel != FF_VTB_HWACCEL_ALWAYS || !ffpipenode_ios_hwaccel_supports(codec_id))
+        node = ffpipenode_create_video_decoder_from_ios_videotoolbox(ffp);
+    if (!node && hwaccel != FF_VTB_HWACCEL_OFF && ffpipenode_ios_hwaccel_supports(codec_id))
+        node = ffpipenode_create_video_decoder_from_ios_hwaccel(ffp);
+    return node;
 }
 
 static IJKFF_Pipenode *func_open_video_decoder(IJKFF_Pipeline *pipeline, FFPlayer *ffp)
 {
     IJKFF_Pipenode* node = NULL;
     IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
-    if (ffp->videotoolbox) {
-        node = ffpipenode_create_video_decoder_from_ios_videotoolbox(ffp);
+
+    if (!opaque->benchmark && ffpipeline_ios_get_option_int(ffp, "decoder-benchmark", 0))
+        opaque->benchmark = ffdecoder_benchmark_create();
+    // the stream is open, its first buffering under way
+    update_buffering(opaque, ffp, false);
+
+    bool software_allowed = software_decoder_acquire(opaque, false);
+    if (ffp->videotoolbox || !software_allowed) {
+        if (!software_allowed)
+            ALOGI("software decoders all in use, try videotoolbox\n");
+        node = open_videotoolbox_decoder(ffp);
         if (!node)
             ALOGE("vtb fail!!! switch to ffmpeg decode!!!! \n");
     }
     if (node == NULL) {
-        node = ffpipenode_create_video_decoder_from_ffplay(ffp);
+        // decoding over the cap beats not playing at all
+        software_decoder_acquire(opaque, true);
+        if (opaque->benchmark)
+            node = ffpipenode_create_video_decoder_benchmark(ffp, opaque->benchmark);
+        else
+            node = ffpipenode_create_video_decoder_from_ffplay(ffp);
         ffp->stat.vdec_type = FFP_PROPV_DECODER_AVCODEC;
         opaque->is_videotoolbox_open = false;
+        apply_software_discard(opaque);
     } else {
+        software_decoder_release(opaque);
         ffp->stat.vdec_type = FFP_PROPV_DECODER_VIDEOTOOLBOX;
         opaque->is_videotoolbox_open = true;
+
+        // the core allocated "video-pictq-size" frames, the depth stays under
+        opaque->pictq_adaptive = ffpipeline_ios_get_option_int(ffp, "video-pictq-adaptive", 0) && ffp->pictq_size > 1;
+        if (opaque->pictq_adaptive) {
+            int min_depth = av_clip(ffpipeline_ios_get_option_int(ffp, "video-pictq-min", 2), 1, ffp->pictq_size);
+            ffpictq_depth_init(&opaque->pictq_depth, min_depth, ffp->pictq_size, FFMIN(3, ffp->pictq_size));
+            opaque->pictq_depth_value = opaque->pictq_depth.depth;
+        }
     }
     ffp_notify_msg2(ffp, FFP_MSG_VIDEO_DECODER_OPEN, opaque->is_videotoolbox_open);
     return node;
@@ -58,12 +733,69 @@ static IJKFF_Pipenode *func_open_video_decoder(IJKFF_Pipeline *pipeline, FFPlaye
 
 static SDL_Aout *func_open_audio_output(IJKFF_Pipeline *pipeline, FFPlayer *ffp)
 {
-    return SDL_AoutIos_CreateForAudioUnit();
+    IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
+
+    // "audio-low-latency": 1 for short output buffering on live interactive streams
+    bool low_latency = ffpipeline_ios_get_option_int(ffp, "audio-low-latency", 0) != 0;
+    SDL_Aout *aout = SDL_AoutIos_CreateForAudioUnitWithLowLatency(low_latency);
+    if (aout && (opaque->audio_analysis || opaque->loudness_target != 0))
+        SDL_AoutIos_SetAudioAnalysis(aout, opaque->audio_analysis, opaque->loudness_target);
+    if (aout && opaque->sync_probe)
+        SDL_AoutIos_SetSyncProbe(aout, opaque->sync_probe);
+    // "audio-match-sample-rate": 1 (default) for the hardware at the rate of
+    // the source. Only the players heard open their output, the ones with
+    // the audio disabled do not take the session over
+    if (aout)
+        SDL_AoutIos_SetMatchSampleRate(aout, ffpipeline_ios_get_option_int(ffp, "audio-match-sample-rate", 1) != 0);
+    // "audio-shared-output": 1 to mix into the one output unit of the
+    // process, for players heard at once, a preview and a main one or the
+    // items of a crossfade
+    if (aout)
+        SDL_AoutIos_SetSharedOutput(aout, ffpipeline_ios_get_option_int(ffp, "audio-shared-output", 0) != 0);
+    return aout;
 }
 
-static SDL_Class g_pipeline_class = {
-    .name = "ffpipeline_ios",
-};
+void ffpipeline_ios_set_audio_analysis(IJKFF_Pipeline *pipeline, bool enabled, float loudness_target)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
+    opaque->audio_analysis  = enabled;
+    opaque->loudness_target = loudness_target;
+    if (opaque->ffp && opaque->ffp->aout)
+        SDL_AoutIos_SetAudioAnalysis(opaque->ffp->aout, enabled, loudness_target);
+}
+
+void ffpipeline_ios_set_sync_probe(IJKFF_Pipeline *pipeline, IJKSyncProbe *probe)
+{
+    if (!pipeline || pipeline->opaque_class != &g_pipeline_class)
+        return;
+
+    IJKFF_Pipeline_Opaque *opaque = pipeline->opaque;
+    ijk_sync_probe_unref(&opaque->sync_probe);
+    opaque->sync_probe = ijk_sync_probe_ref(probe);
+}
+
+int64_t ffpipeline_ios_get_option_int(FFPlayer *ffp, const char *name, int64_t default_value)
+{
+    AVDictionaryEntry *entry = NULL;
+    char              *end   = NULL;
+    int64_t            value = 0;
+
+    if (!ffp || !name)
+        return default_value;
+
+    entry = av_dict_get(ffp->player_opts, name, NULL, 0);
+    if (!entry || !entry->value)
+        return default_value;
+
+    value = strtoll(entry->value, &end, 10);
+    if (end == entry->value)
+        return default_value;
+
+    return value;
+}
 
 IJKFF_Pipeline *ffpipeline_create_from_ios(FFPlayer *ffp)
 {
@@ -73,6 +805,11 @@ IJKFF_Pipeline *ffpipeline_create_from_ios(FFPlayer *ffp)
 
     IJKFF_Pipeline_Opaque *opaque     = pipeline->opaque;
     opaque->ffp                       = ffp;
+    opaque->slice_pool_client         = av_slice_pool_client_open();
+    ffprops_init(&opaque->props);
+    opaque->props_mutex               = SDL_CreateMutex();
+    opaque->props_cond                = SDL_CreateCond();
+    opaque->timed_metadata            = fftimed_metadata_create();
     pipeline->func_destroy            = func_destroy;
     pipeline->func_open_video_decoder = func_open_video_decoder;
     pipeline->func_open_audio_output  = func_open_audio_output;
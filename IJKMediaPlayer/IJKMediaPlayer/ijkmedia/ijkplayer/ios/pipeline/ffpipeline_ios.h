@@ -24,9 +24,130 @@
 #define FFPLAY__FF_FFPIPELINE_IOS_H
 
 #include "ijkplayer/ff_ffpipeline.h"
+#include "ffpipenode_ios_benchmark_vdec.h"
+#include "ffpipeline_ios_props.h"
+#include "ffpipeline_ios_timed_metadata.h"
+#include "ffpipeline_ios_buffering.h"
+#include "ijksdl/ios/ijksdl_sync_probe.h"
+#include <pthread.h>
 
 struct FFPlayer;
+struct AVPacket;
 
 IJKFF_Pipeline *ffpipeline_create_from_ios(struct FFPlayer *ffp);
 
+// player options only known to the ios pipeline are left in ffp->player_opts by ffplay
+int64_t ffpipeline_ios_get_option_int(struct FFPlayer *ffp, const char *name, int64_t default_value);
+
+// process wide cap of players decoding video in software, 0 (default) for no limit;
+// past it a player tries VideoToolbox first, and decodes in software only if that fails
+void ffpipeline_ios_set_max_software_decoders(int max);
+int  ffpipeline_ios_get_software_decoder_count(void);
+
+// scrubbing: decode key frames only, until cleared and the next key frame;
+// VideoToolbox drops the other packets, the software decoder skips them
+void ffpipeline_ios_set_keyframes_only(IJKFF_Pipeline *pipeline, bool keyframes_only);
+bool ffpipeline_ios_is_keyframes_only(struct FFPlayer *ffp);
+
+// load adaptive degradation of the software decoder, each level adding to
+// the one below: 1 skip_loop_filter nonref, 2 skip_loop_filter all,
+// 3 skip_frame nonref, 4 skip_idct nonref; 0 for none. H.264 and HEVC do
+// not honour skip_idct, only the MPEG video decoders do
+#define FFP_IOS_DECODE_DEGRADATION_MAX 4
+void ffpipeline_ios_set_decode_degradation(IJKFF_Pipeline *pipeline, int level);
+
+// the slice pool client of the player, for the "thread_pool" codec option,
+// see "video-thread-pool"; open while the pipeline lives, 0 if none
+int  ffpipeline_ios_get_slice_pool_client(IJKFF_Pipeline *pipeline);
+// the slice threads of a player in the background of the other players on
+// the pool
+void ffpipeline_ios_set_decode_background(IJKFF_Pipeline *pipeline, bool background);
+
+// frames left undecoded on the way to the last accurate seek target
+void ffpipeline_ios_set_seek_skipped_frames(struct FFPlayer *ffp, int count);
+int  ffpipeline_ios_get_seek_skipped_frames(IJKFF_Pipeline *pipeline);
+
+// "max-fps" below the frame rate of the stream: the decoders leave out the
+// frames nothing references that fall between the slots of an even max-fps
+// cadence, rather than decode them for the late drop. Asked for each frame
+// about to be decoded, true if it falls between two slots; the decoder then
+// tells whether it left it out. A frame decoded anyway takes the next slot
+bool    ffpipeline_ios_decimation_due(struct FFPlayer *ffp);
+void    ffpipeline_ios_did_decimate(struct FFPlayer *ffp, bool left_out);
+// frames left out so far, apart from the late drops
+int64_t ffpipeline_ios_get_decimated_frames(IJKFF_Pipeline *pipeline);
+
+// SDL_GetTickHR() of the first packet the video decoder took, 0 before;
+// not set by the software decoder of the core
+void    ffpipeline_ios_did_take_first_packet(struct FFPlayer *ffp);
+int64_t ffpipeline_ios_get_first_packet_tick(IJKFF_Pipeline *pipeline);
+
+// output pixel buffers VideoToolbox allocated since the decoder opened, and
+// those of them allocated once playback was steady, which the pool filled
+// up front should leave at 0
+void    ffpipeline_ios_set_pixel_buffer_allocations(struct FFPlayer *ffp, int64_t total, int64_t steady);
+void    ffpipeline_ios_get_pixel_buffer_allocations(IJKFF_Pipeline *pipeline, int64_t *total, int64_t *steady);
+
+// pixels the view shows the video in, 0 if unknown; VideoToolbox scales its
+// output down to it, see "videotoolbox-scale-to-view"
+void    ffpipeline_ios_set_video_output_size(IJKFF_Pipeline *pipeline, int width, int height);
+bool    ffpipeline_ios_get_video_output_size(struct FFPlayer *ffp, int *width, int *height);
+
+// memory accounting: packets VideoToolbox keeps since the last key frame,
+// and the decoded frames waiting for display, estimated from the video size
+void    ffpipeline_ios_set_decoder_buffered_bytes(struct FFPlayer *ffp, int64_t bytes);
+int64_t ffpipeline_ios_get_decoder_buffered_bytes(IJKFF_Pipeline *pipeline);
+int64_t ffpipeline_ios_get_frame_queue_bytes(IJKFF_Pipeline *pipeline);
+
+// memory shedding: decoded frames VideoToolbox lets wait for display, below
+// "video-pictq-size", 0 for no limit; bytes of packets the demuxer buffers
+void    ffpipeline_ios_set_frame_queue_limit(IJKFF_Pipeline *pipeline, int limit);
+// blocks the VideoToolbox output while the frame queue is at the limit
+void    ffpipeline_ios_wait_frame_queue_limit(struct FFPlayer *ffp);
+// "video-pictq-adaptive", see ffpipeline_ios_pictq_depth.h: VideoToolbox
+// tells the decode time of each frame it queues, -1 if unknown. The budget
+// caps the depth, 0 for none
+// "dynamic-buffering": the high water marks from the download rate, when
+// the stream is open and on each stall after the first frame; false until set
+void    ffpipeline_ios_update_buffering(IJKFF_Pipeline *pipeline, bool rebuffer);
+bool    ffpipeline_ios_get_buffering(IJKFF_Pipeline *pipeline, FFBufferingThresholds *thresholds);
+void    ffpipeline_ios_did_decode_frame(struct FFPlayer *ffp, int64_t decode_us, double frame_duration);
+void    ffpipeline_ios_set_frame_queue_budget(IJKFF_Pipeline *pipeline, int64_t bytes);
+// the decoded frames let wait for display now: the adaptive depth, or the
+// limit, or "video-pictq-size"
+int     ffpipeline_ios_get_frame_queue_depth(IJKFF_Pipeline *pipeline);
+void    ffpipeline_ios_set_max_buffer_size(IJKFF_Pipeline *pipeline, int bytes);
+
+// "decoder-benchmark", see ffpipenode_ios_benchmark_vdec.h; NULL when off
+FFDecoderBenchmark *ffpipeline_ios_get_decoder_benchmark(struct FFPlayer *ffp);
+// -1 when off or before the video decoder opened
+int     ffpipeline_ios_get_decoder_benchmark_result(IJKFF_Pipeline *pipeline, FFDecoderBenchmarkResult *result);
+
+// spectrum and loudness of the audio output, and its normalization gain to
+// loudness_target in LUFS, 0 for none; see SDL_AoutIos_SetAudioAnalysis().
+// Applied to the output open, and to the ones opened after
+void    ffpipeline_ios_set_audio_analysis(IJKFF_Pipeline *pipeline, bool enabled, float loudness_target);
+// the audio side of an A/V sync probe, see SDL_AoutIos_SetSyncProbe(); for
+// the outputs opened after, NULL for none
+void    ffpipeline_ios_set_sync_probe(IJKFF_Pipeline *pipeline, IJKSyncProbe *probe);
+
+// the hot properties, see ffpipeline_ios_props.h: sampled under
+// player_mutex every FFP_PROPS_PUBLISH_MS by a thread of the pipeline,
+// read from any thread without a lock. Stopped, without player_mutex held,
+// before the pipeline is destroyed
+int     ffpipeline_ios_start_publishing_properties(IJKFF_Pipeline *pipeline, pthread_mutex_t *player_mutex);
+void    ffpipeline_ios_stop_publishing_properties(IJKFF_Pipeline *pipeline);
+bool    ffpipeline_ios_read_properties(IJKFF_Pipeline *pipeline, FFPropertySnapshot *snapshot);
+
+// timed metadata, see ffpipeline_ios_timed_metadata.h: the SEI user data of
+// the VideoToolbox access units, queued while enabled, off by default
+void       ffpipeline_ios_set_timed_metadata(IJKFF_Pipeline *pipeline, bool enabled);
+// video decoder, with each packet taken, of the serial of the packet queue
+void       ffpipeline_ios_put_sei(struct FFPlayer *ffp, const struct AVPacket *pkt, int serial);
+// without a lock, whether there is any to take
+bool       ffpipeline_ios_has_timed_metadata(IJKFF_Pipeline *pipeline);
+// the entries due at time in seconds of the media, of the frame presented,
+// see fftimed_metadata_take()
+CFArrayRef ffpipeline_ios_take_timed_metadata(struct FFPlayer *ffp, double time);
+
 #endif
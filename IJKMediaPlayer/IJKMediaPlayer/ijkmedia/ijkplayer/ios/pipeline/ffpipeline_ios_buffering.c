@@ -0,0 +1,52 @@
+/*
+ * ffpipeline_ios_buffering.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipeline_ios_buffering.h"
+#include <math.h>
+#include "libavutil/common.h"
+
+// the standard normal quantile of p, through the inverse error function
+// approximated as by Winitzki, within 2e-3
+static double normal_quantile(double p)
+{
+    const double a = 0.147;
+    double x   = 2 * av_clipd(p, 0.001, 0.999) - 1;
+    double ln  = log(1 - x * x);
+    double t   = 2 / (M_PI * a) + ln / 2;
+    double inv = sqrt(sqrt(t * t - ln / a) - t);
+
+    return M_SQRT2 * (x < 0 ? -inv : inv);
+}
+
+int ffbuffering_threshold_ms(int64_t rate, int64_t bit_rate, int horizon_ms, double confidence,
+                             int min_ms, int max_ms)
+{
+    if (rate <= 0 || bit_rate <= 0)
+        return max_ms;
+
+    double low      = rate * FFMAX(1 - normal_quantile(confidence) * FF_BUFFERING_RATE_CV, 0.05);
+    double shortage = 1 - low / bit_rate;
+    double need     = shortage > 0 ? horizon_ms * shortage : 0;
+
+    return (int)av_clipd(need, min_ms, FFMAX(max_ms, min_ms));
+}
@@ -0,0 +1,52 @@
+/*
+ * ffpipeline_ios_buffering.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPELINE_IOS_BUFFERING_H
+#define FFPLAY__FF_FFPIPELINE_IOS_BUFFERING_H
+
+#include <stdint.h>
+
+// "dynamic-buffering": the media buffered before playback starts, and
+// before it resumes after a stall, so the download keeps ahead of playback
+// for "buffering-horizon-ms" with a probability of "buffering-confidence"
+// percent. The download rate is taken as normal around the one measured,
+// deviating by FF_BUFFERING_RATE_CV of it; the buffer covers what its
+// pessimistic quantile falls short of the bit rate over the horizon. A
+// download faster than that starts at once.
+#define FF_BUFFERING_RATE_CV        0.35
+#define FF_BUFFERING_MIN_START_MS   100
+// a stall tells of a dip, ridden out for this long at least
+#define FF_BUFFERING_MIN_RESUME_MS  500
+
+typedef struct FFBufferingThresholds {
+    int     start_ms;
+    int     resume_ms;
+    int64_t rate;       // download, bits per second
+    int64_t bit_rate;   // of the stream
+} FFBufferingThresholds;
+
+// rate and bit_rate in bits per second, confidence in (0, 1)
+int ffbuffering_threshold_ms(int64_t rate, int64_t bit_rate, int horizon_ms, double confidence,
+                             int min_ms, int max_ms);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * ffpipeline_ios_pictq_depth.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipeline_ios_pictq_depth.h"
+#include <math.h>
+#include "libavutil/common.h"
+
+// about the last second of frames
+#define DECODE_TIME_WEIGHT (1.0 / 32)
+
+void ffpictq_depth_init(FFPictqDepth *d, int min_depth, int max_depth, int depth)
+{
+    d->min_depth   = FFMAX(min_depth, 1);
+    d->max_depth   = FFMAX(max_depth, d->min_depth);
+    d->depth       = av_clip(depth, d->min_depth, d->max_depth);
+    d->mean        = 0;
+    d->variance    = 0;
+    d->samples     = 0;
+    d->shrink_time = 0;
+}
+
+int ffpictq_depth_update(FFPictqDepth *d, double now, double decode_time, double frame_duration, int max_frames)
+{
+    if (decode_time < 0)
+        return d->depth;
+
+    if (d->samples++ == 0) {
+        d->mean = decode_time;
+    } else {
+        double diff = decode_time - d->mean;
+        d->mean    += DECODE_TIME_WEIGHT * diff;
+        d->variance = (1 - DECODE_TIME_WEIGHT) * (d->variance + DECODE_TIME_WEIGHT * diff * diff);
+    }
+    if (frame_duration <= 0 || d->samples < FF_PICTQ_DEPTH_MIN_SAMPLES)
+        return d->depth;
+
+    int upper  = max_frames > 0 ? av_clip(max_frames, d->min_depth, d->max_depth) : d->max_depth;
+    int target = av_clip((int)ceil(3 * sqrt(d->variance) / frame_duration) + 1, d->min_depth, upper);
+
+    if (target > d->depth || d->depth > upper) {
+        d->depth       = target;
+        d->shrink_time = 0;
+    } else if (target < d->depth) {
+        if (d->shrink_time == 0) {
+            d->shrink_time = now;
+        } else if (now - d->shrink_time >= FF_PICTQ_DEPTH_SHRINK_SECONDS) {
+            d->depth--;
+            d->shrink_time = now;
+        }
+    } else {
+        d->shrink_time = 0;
+    }
+    return d->depth;
+}
@@ -0,0 +1,60 @@
+/*
+ * ffpipeline_ios_pictq_depth.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPELINE_IOS_PICTQ_DEPTH_H
+#define FFPLAY__FF_FFPIPELINE_IOS_PICTQ_DEPTH_H
+
+#include <stdint.h>
+
+// "video-pictq-adaptive": the frames VideoToolbox lets wait for display
+// follow the jitter of its decode times, between "video-pictq-min" and
+// "video-pictq-size", the queue allocated by the core. The depth covers the
+// decode times up to 3 standard deviations above their mean, in frame
+// durations, plus one frame for the cadence: steady decode holds few full
+// size surfaces, a decoder stalling now and then gets the frames to ride
+// it out. It grows at once, and shrinks by a frame after every
+// FF_PICTQ_DEPTH_SHRINK_SECONDS it could have.
+#define FF_PICTQ_DEPTH_SHRINK_SECONDS   2.0
+// the decode times of the first frames include the spin up of the decoder
+#define FF_PICTQ_DEPTH_MIN_SAMPLES      30
+
+typedef struct FFPictqDepth {
+    int     min_depth;
+    int     max_depth;
+    int     depth;
+    // of the decode times, seconds, exponentially weighted
+    double  mean;
+    double  variance;
+    int64_t samples;
+    // when the depth could have shrunk, 0 while it could not
+    double  shrink_time;
+} FFPictqDepth;
+
+void ffpictq_depth_init(FFPictqDepth *d, int min_depth, int max_depth, int depth);
+
+// a frame of frame_duration seconds decoded in decode_time seconds, at now
+// seconds; max_frames caps the depth, from a memory budget, 0 for none.
+// Returns the depth
+int  ffpictq_depth_update(FFPictqDepth *d, double now, double decode_time, double frame_duration, int max_frames);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * ffpipeline_ios_props.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipeline_ios_props.h"
+#include <string.h>
+#include "ff_ffplay.h"
+#include "ijksdl/ijksdl_timer.h"
+
+void ffprops_init(FFPropertyPublisher *publisher)
+{
+    atomic_init(&publisher->seq, 0);
+    atomic_init(&publisher->last_tick, 0);
+    memset(&publisher->snapshot, 0, sizeof(publisher->snapshot));
+}
+
+void ffprops_publish(FFPropertyPublisher *publisher, FFPlayer *ffp)
+{
+    VideoState *is = ffp->is;
+    int64_t     now = (int64_t)SDL_GetTickHR();
+    FFPropertySnapshot s;
+
+    // no more often than FFP_PROPS_INTERVAL_MS
+    if (now - atomic_load_explicit(&publisher->last_tick, memory_order_relaxed) < FFP_PROPS_INTERVAL_MS)
+        return;
+
+    // sampled before the seqlock is taken, the readers spin only for the copy
+    s.tick                      = now;
+    s.advancing                 = is && !is->paused && !is->buffering_on && !is->seek_req && !is->eof;
+    s.position                  = ffp_get_current_position_l(ffp);
+    s.duration                  = ffp_get_duration_l(ffp);
+    s.playable_duration         = ffp_get_playable_duration_l(ffp);
+    s.playback_rate             = ffp_get_property_float(ffp, FFP_PROP_FLOAT_PLAYBACK_RATE, 1.0f);
+    s.playback_volume           = ffp_get_property_float(ffp, FFP_PROP_FLOAT_PLAYBACK_VOLUME, 1.0f);
+    s.video_decoder             = ffp_get_property_int64(ffp, FFP_PROP_INT64_VIDEO_DECODER, FFP_PROPV_DECODER_UNKNOWN);
+    s.decode_frames_per_second  = ffp_get_property_float(ffp, FFP_PROP_FLOAT_VIDEO_DECODE_FRAMES_PER_SECOND, .0f);
+    s.drop_frame_rate           = ffp_get_property_float(ffp, FFP_PROP_FLOAT_DROP_FRAME_RATE, .0f);
+    s.avdelay                   = ffp_get_property_float(ffp, FFP_PROP_FLOAT_AVDELAY, .0f);
+    s.avdiff                    = ffp_get_property_float(ffp, FFP_PROP_FLOAT_AVDIFF, .0f);
+    s.bit_rate                  = ffp_get_property_int64(ffp, FFP_PROP_INT64_BIT_RATE, 0);
+    s.tcp_speed                 = ffp_get_property_int64(ffp, FFP_PROP_INT64_TCP_SPEED, 0);
+    s.traffic_bytes             = ffp_get_property_int64(ffp, FFP_PROP_INT64_TRAFFIC_STATISTIC_BYTE_COUNT, 0);
+    s.video_cached_duration     = ffp_get_property_int64(ffp, FFP_PROP_INT64_VIDEO_CACHED_DURATION, 0);
+    s.audio_cached_duration     = ffp_get_property_int64(ffp, FFP_PROP_INT64_AUDIO_CACHED_DURATION, 0);
+    s.video_cached_bytes        = ffp_get_property_int64(ffp, FFP_PROP_INT64_VIDEO_CACHED_BYTES, 0);
+    s.audio_cached_bytes        = ffp_get_property_int64(ffp, FFP_PROP_INT64_AUDIO_CACHED_BYTES, 0);
+    s.video_cached_packets      = ffp_get_property_int64(ffp, FFP_PROP_INT64_VIDEO_CACHED_PACKETS, 0);
+    s.audio_cached_packets      = ffp_get_property_int64(ffp, FFP_PROP_INT64_AUDIO_CACHED_PACKETS, 0);
+
+    unsigned seq = atomic_load_explicit(&publisher->seq, memory_order_relaxed);
+    atomic_store_explicit(&publisher->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    publisher->snapshot = s;
+    atomic_store_explicit(&publisher->seq, seq + 2, memory_order_release);
+
+    atomic_store_explicit(&publisher->last_tick, now, memory_order_relaxed);
+}
+
+bool ffprops_read(FFPropertyPublisher *publisher, FFPropertySnapshot *snapshot)
+{
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&publisher->seq, memory_order_acquire);
+        *snapshot = publisher->snapshot;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&publisher->seq, memory_order_relaxed));
+
+    return snapshot->tick != 0;
+}
+
+int64_t ffprops_position_at(const FFPropertySnapshot *snapshot, int64_t now)
+{
+    int64_t elapsed = now - snapshot->tick;
+
+    if (!snapshot->advancing || elapsed <= 0)
+        return snapshot->position;
+
+    // bounded, in case the thread sampling stalls with the clock
+    if (elapsed > FFP_PROPS_EXTRAPOLATE_MS)
+        elapsed = FFP_PROPS_EXTRAPOLATE_MS;
+    int64_t position = snapshot->position + (int64_t)(elapsed * snapshot->playback_rate);
+    if (snapshot->duration > 0 && position > snapshot->duration)
+        position = snapshot->duration;
+    return position;
+}
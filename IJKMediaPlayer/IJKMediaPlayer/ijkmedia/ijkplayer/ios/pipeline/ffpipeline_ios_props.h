@@ -0,0 +1,83 @@
+/*
+ * ffpipeline_ios_props.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPELINE_IOS_PROPS_H
+#define FFPLAY__FF_FFPIPELINE_IOS_PROPS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct FFPlayer;
+
+// The hot properties of a player, sampled under the player mutex, which
+// the _l getters of the core need, and published under a seqlock, so the
+// app reads them without the mutex: the position for every display frame,
+// the HUD and the monitors. A thread of the pipeline samples them every
+// FFP_PROPS_PUBLISH_MS, never a reader, which extrapolates the position
+// from the last sample while playback advances. Samples closer than
+// FFP_PROPS_INTERVAL_MS are skipped.
+#define FFP_PROPS_INTERVAL_MS       5
+#define FFP_PROPS_PUBLISH_MS        50
+#define FFP_PROPS_EXTRAPOLATE_MS    500
+
+typedef struct FFPropertySnapshot {
+    int64_t tick;                   // SDL_GetTickHR() of the sample, 0 before the first
+    bool    advancing;              // not paused, buffering, seeking nor at the end
+    int64_t position;               // ms
+    int64_t duration;
+    int64_t playable_duration;
+    float   playback_rate;
+    float   playback_volume;
+
+    int64_t video_decoder;          // FFP_PROPV_DECODER_*
+    float   decode_frames_per_second;
+    float   drop_frame_rate;
+    float   avdelay;
+    float   avdiff;
+    int64_t bit_rate;
+    int64_t tcp_speed;
+    int64_t traffic_bytes;
+    int64_t video_cached_duration;
+    int64_t audio_cached_duration;
+    int64_t video_cached_bytes;
+    int64_t audio_cached_bytes;
+    int64_t video_cached_packets;
+    int64_t audio_cached_packets;
+} FFPropertySnapshot;
+
+typedef struct FFPropertyPublisher {
+    atomic_uint         seq;        // odd while a sample is written
+    _Atomic(int64_t)    last_tick;
+    FFPropertySnapshot  snapshot;
+} FFPropertyPublisher;
+
+void    ffprops_init(FFPropertyPublisher *publisher);
+// under the player mutex
+void    ffprops_publish(FFPropertyPublisher *publisher, struct FFPlayer *ffp);
+// any thread, never blocks; false before the first sample
+bool    ffprops_read(FFPropertyPublisher *publisher, FFPropertySnapshot *snapshot);
+// ms, the position of snapshot carried on to now, SDL_GetTickHR()
+int64_t ffprops_position_at(const FFPropertySnapshot *snapshot, int64_t now);
+
+#endif
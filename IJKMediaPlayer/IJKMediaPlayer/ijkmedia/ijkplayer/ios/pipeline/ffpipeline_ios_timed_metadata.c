@@ -0,0 +1,286 @@
+/*
+ * ffpipeline_ios_timed_metadata.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipeline_ios_timed_metadata.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#define H264_NAL_SEI            6
+#define HEVC_NAL_SEI_PREFIX     39
+#define HEVC_NAL_SEI_SUFFIX     40
+#define SEI_USER_DATA_UNREGISTERED 5
+
+typedef struct FFTimedMetadataEntry {
+    int         type;
+    int         serial;
+    double      time;
+    uint8_t    *data;
+    int         size;
+} FFTimedMetadataEntry;
+
+struct FFTimedMetadataQueue {
+    atomic_bool             enabled;
+    // read without the mutex by the view, which looks with every frame
+    atomic_int              count;
+    pthread_mutex_t         mutex;
+    FFTimedMetadataEntry    entries[FF_TIMED_METADATA_MAX_ENTRIES];
+};
+
+FFTimedMetadataQueue *fftimed_metadata_create(void)
+{
+    FFTimedMetadataQueue *queue = av_mallocz(sizeof(*queue));
+    if (!queue)
+        return NULL;
+
+    atomic_init(&queue->enabled, false);
+    atomic_init(&queue->count, 0);
+    pthread_mutex_init(&queue->mutex, NULL);
+    return queue;
+}
+
+void fftimed_metadata_freep(FFTimedMetadataQueue **queue)
+{
+    if (!queue || !*queue)
+        return;
+
+    fftimed_metadata_flush(*queue);
+    pthread_mutex_destroy(&(*queue)->mutex);
+    av_freep(queue);
+}
+
+void fftimed_metadata_set_enabled(FFTimedMetadataQueue *queue, bool enabled)
+{
+    if (!queue)
+        return;
+
+    atomic_store(&queue->enabled, enabled);
+    if (!enabled)
+        fftimed_metadata_flush(queue);
+}
+
+bool fftimed_metadata_is_enabled(FFTimedMetadataQueue *queue)
+{
+    return queue && atomic_load_explicit(&queue->enabled, memory_order_relaxed);
+}
+
+bool fftimed_metadata_is_empty(FFTimedMetadataQueue *queue)
+{
+    return !queue || atomic_load_explicit(&queue->count, memory_order_acquire) == 0;
+}
+
+// under the mutex
+static void remove_entry(FFTimedMetadataQueue *queue, int index)
+{
+    int count = atomic_load_explicit(&queue->count, memory_order_relaxed);
+
+    av_freep(&queue->entries[index].data);
+    queue->entries[index] = queue->entries[count - 1];
+    atomic_store_explicit(&queue->count, count - 1, memory_order_relaxed);
+}
+
+void fftimed_metadata_put(FFTimedMetadataQueue *queue, int type, int serial, double time,
+                          const uint8_t *data, int size)
+{
+    FFTimedMetadataEntry entry;
+
+    if (!fftimed_metadata_is_enabled(queue) || !data || size <= 0 || size > FF_TIMED_METADATA_MAX_SIZE)
+        return;
+
+    entry.type   = type;
+    entry.serial = serial;
+    entry.time   = time;
+    entry.size   = size;
+    entry.data   = av_memdup(data, size);
+    if (!entry.data)
+        return;
+
+    pthread_mutex_lock(&queue->mutex);
+    if (atomic_load_explicit(&queue->count, memory_order_relaxed) == FF_TIMED_METADATA_MAX_ENTRIES) {
+        int oldest = 0;
+        for (int i = 1; i < FF_TIMED_METADATA_MAX_ENTRIES; i++) {
+            if (queue->entries[i].serial < queue->entries[oldest].serial ||
+                (queue->entries[i].serial == queue->entries[oldest].serial &&
+                 queue->entries[i].time < queue->entries[oldest].time))
+                oldest = i;
+        }
+        remove_entry(queue, oldest);
+    }
+    int count = atomic_load_explicit(&queue->count, memory_order_relaxed);
+    queue->entries[count] = entry;
+    atomic_store_explicit(&queue->count, count + 1, memory_order_release);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// the payloads of a SEI NAL, emulation prevention bytes removed
+static void put_sei_nal(FFTimedMetadataQueue *queue, int serial, double time,
+                        const uint8_t *nal, int size, int header)
+{
+    uint8_t *rbsp = av_malloc(size);
+    int      rbsp_size = 0;
+    int      zeros = 0;
+
+    if (!rbsp)
+        return;
+    for (int i = header; i < size; i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] ? 0 : zeros + 1;
+        rbsp[rbsp_size++] = nal[i];
+    }
+
+    // sei_message()s up to the rbsp_trailing_bits
+    const uint8_t *p   = rbsp;
+    const uint8_t *end = rbsp + rbsp_size;
+    while (end - p > 1 || (end - p == 1 && *p != 0x80)) {
+        int type = 0, payload_size = 0;
+
+        while (p < end && *p == 0xff)
+            type += *p++;
+        if (p >= end)
+            break;
+        type += *p++;
+        while (p < end && *p == 0xff)
+            payload_size += *p++;
+        if (p >= end)
+            break;
+        payload_size += *p++;
+        if (payload_size > end - p)
+            break;
+
+        // uuid_iso_iec_11578 of 16 bytes, then the user data
+        if (type == SEI_USER_DATA_UNREGISTERED && payload_size >= 16)
+            fftimed_metadata_put(queue, FF_TIMED_METADATA_SEI, serial, time, p, payload_size);
+        p += payload_size;
+    }
+    av_free(rbsp);
+}
+
+void fftimed_metadata_put_sei(FFTimedMetadataQueue *queue, int serial, double time,
+                              const uint8_t *data, int size, bool hevc)
+{
+    int offset = 0;
+
+    if (!fftimed_metadata_is_enabled(queue) || !data)
+        return;
+
+    // the length and the first header byte of each NAL, the SEI ones read on
+    while (offset + 5 <= size) {
+        uint32_t nal_size = AV_RB32(data + offset);
+        const uint8_t *nal = data + offset + 4;
+
+        if (nal_size == 0 || nal_size > (uint32_t)(size - offset - 4))
+            break;
+        if (hevc) {
+            int type = (nal[0] >> 1) & 0x3f;
+            if ((type == HEVC_NAL_SEI_PREFIX || type == HEVC_NAL_SEI_SUFFIX) && nal_size > 2)
+                put_sei_nal(queue, serial, time, nal, nal_size, 2);
+        } else if ((nal[0] & 0x1f) == H264_NAL_SEI && nal_size > 1) {
+            put_sei_nal(queue, serial, time, nal, nal_size, 1);
+        }
+        offset += nal_size + 4;
+    }
+}
+
+static CFDictionaryRef entry_dictionary(const FFTimedMetadataEntry *entry)
+{
+    const void *keys[3] = {
+        FF_TIMED_METADATA_KEY_TYPE, FF_TIMED_METADATA_KEY_TIME, FF_TIMED_METADATA_KEY_DATA,
+    };
+    const void *values[3];
+    CFDictionaryRef dict = NULL;
+
+    values[0] = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &entry->type);
+    values[1] = CFNumberCreate(kCFAllocatorDefault, kCFNumberDoubleType, &entry->time);
+    values[2] = CFDataCreate(kCFAllocatorDefault, entry->data, entry->size);
+    if (values[0] && values[1] && values[2])
+        dict = CFDictionaryCreate(kCFAllocatorDefault, keys, values, 3,
+                                  &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    for (int i = 0; i < 3; i++) {
+        if (values[i])
+            CFRelease(values[i]);
+    }
+    return dict;
+}
+
+CFArrayRef fftimed_metadata_take(FFTimedMetadataQueue *queue, int serial, double time)
+{
+    FFTimedMetadataEntry due[FF_TIMED_METADATA_MAX_ENTRIES];
+    int                  due_count = 0;
+
+    if (fftimed_metadata_is_empty(queue))
+        return NULL;
+
+    pthread_mutex_lock(&queue->mutex);
+    for (int i = 0; i < atomic_load_explicit(&queue->count, memory_order_relaxed);) {
+        FFTimedMetadataEntry *entry = &queue->entries[i];
+
+        if (entry->serial < serial) {
+            remove_entry(queue, i);
+        } else if (entry->serial == serial && entry->time <= time) {
+            // insertion in time order, the decode order of the SEIs is not
+            int j = due_count++;
+            for (; j > 0 && due[j - 1].time > entry->time; j--)
+                due[j] = due[j - 1];
+            due[j] = *entry;
+            entry->data = NULL;
+            remove_entry(queue, i);
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (due_count == 0)
+        return NULL;
+
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorDefault, due_count, &kCFTypeArrayCallBacks);
+    for (int i = 0; i < due_count; i++) {
+        CFDictionaryRef dict = array ? entry_dictionary(&due[i]) : NULL;
+        if (dict) {
+            CFArrayAppendValue(array, dict);
+            CFRelease(dict);
+        }
+        av_free(due[i].data);
+    }
+    if (array && CFArrayGetCount(array) == 0) {
+        CFRelease(array);
+        array = NULL;
+    }
+    return array;
+}
+
+void fftimed_metadata_flush(FFTimedMetadataQueue *queue)
+{
+    if (!queue)
+        return;
+
+    pthread_mutex_lock(&queue->mutex);
+    while (atomic_load_explicit(&queue->count, memory_order_relaxed) > 0)
+        remove_entry(queue, 0);
+    pthread_mutex_unlock(&queue->mutex);
+}
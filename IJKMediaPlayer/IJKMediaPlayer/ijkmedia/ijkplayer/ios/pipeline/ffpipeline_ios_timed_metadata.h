@@ -0,0 +1,71 @@
+/*
+ * ffpipeline_ios_timed_metadata.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPELINE_IOS_TIMED_METADATA_H
+#define FFPLAY__FF_FFPIPELINE_IOS_TIMED_METADATA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <CoreFoundation/CoreFoundation.h>
+
+// Timed metadata of the stream, SEI user data unregistered of the video,
+// held with its time until the frame of that time is presented. The decoders put it, walking only the NAL headers of the access
+// units, the ones of SEI NALs excepted; the view takes what is due with the
+// time of each frame it presents, the frames dropped on the way included.
+// Bounded: the oldest entries are dropped first.
+#define FF_TIMED_METADATA_MAX_ENTRIES   64
+#define FF_TIMED_METADATA_MAX_SIZE      (64 * 1024)
+
+enum {
+    FF_TIMED_METADATA_SEI = 1,          // uuid_iso_iec_11578, then the user data
+};
+
+// keys of the dictionaries taken
+#define FF_TIMED_METADATA_KEY_TYPE      CFSTR("type")   // CFNumber, int
+#define FF_TIMED_METADATA_KEY_TIME      CFSTR("time")   // CFNumber, double seconds of the media
+#define FF_TIMED_METADATA_KEY_DATA      CFSTR("data")   // CFData
+
+typedef struct FFTimedMetadataQueue FFTimedMetadataQueue;
+
+FFTimedMetadataQueue *fftimed_metadata_create(void);
+void        fftimed_metadata_freep(FFTimedMetadataQueue **queue);
+
+// off by default, nothing is put then
+void        fftimed_metadata_set_enabled(FFTimedMetadataQueue *queue, bool enabled);
+bool        fftimed_metadata_is_enabled(FFTimedMetadataQueue *queue);
+// any thread, without the lock
+bool        fftimed_metadata_is_empty(FFTimedMetadataQueue *queue);
+
+// serial of the packet queue the data came through, time in seconds of the media
+void        fftimed_metadata_put(FFTimedMetadataQueue *queue, int type, int serial, double time,
+                                 const uint8_t *data, int size);
+// the SEI user data unregistered of an access unit of 4 byte length prefixed NALs
+void        fftimed_metadata_put_sei(FFTimedMetadataQueue *queue, int serial, double time,
+                                     const uint8_t *data, int size, bool hevc);
+
+// the entries of serial at or before time, in time order, as a CFArray of
+// CFDictionary; NULL if none. Entries of an older serial are dropped
+CFArrayRef  fftimed_metadata_take(FFTimedMetadataQueue *queue, int serial, double time);
+void        fftimed_metadata_flush(FFTimedMetadataQueue *queue);
+
+#endif
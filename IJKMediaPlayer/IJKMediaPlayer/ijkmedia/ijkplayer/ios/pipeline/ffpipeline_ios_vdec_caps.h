@@ -0,0 +1,44 @@
+/*
+ * ffpipeline_ios_vdec_caps.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPELINE_IOS_VDEC_CAPS_H
+#define FFPLAY__FF_FFPIPELINE_IOS_VDEC_CAPS_H
+
+#include <stdbool.h>
+
+struct AVCodecParameters;
+
+// The VideoToolbox capabilities of the device, from IJKDeviceModel, probed
+// once in the background by the first call. A stream is supported unless
+// the table says otherwise: while it is not probed yet, or for a codec it
+// does not keep, the session is tried as before.
+bool ffvdec_caps_vtb_supports(const struct AVCodecParameters *codecpar);
+
+// a session refused for codecpar, learned when status says the format is
+// unsupported; other failures may not happen again
+void ffvdec_caps_vtb_refused(const struct AVCodecParameters *codecpar, int status);
+
+// 10 bit biplanar output, true while not probed
+bool ffvdec_caps_vtb_outputs_p010(void);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * ffpipeline_ios_vdec_caps.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipeline_ios_vdec_caps.h"
+#include "libavcodec/avcodec.h"
+#import <VideoToolbox/VideoToolbox.h>
+#import "IJKDeviceModel.h"
+
+static FourCharCode codec_type_of(const AVCodecParameters *codecpar)
+{
+    switch (codecpar->codec_id) {
+        case AV_CODEC_ID_H264:
+            return kCMVideoCodecType_H264;
+        case AV_CODEC_ID_HEVC:
+            return kCMVideoCodecType_HEVC;
+        default:
+            return 0;
+    }
+}
+
+static IJKDecodeFormat decode_format_of(const AVCodecParameters *codecpar)
+{
+    IJKDecodeFormat format;
+
+    format.width  = codecpar->width;
+    format.height = codecpar->height;
+    format.level  = codecpar->level > 0 ? codecpar->level : 0;
+    format.tenBit = codecpar->bits_per_raw_sample > 8 ||
+                    codecpar->format == AV_PIX_FMT_YUV420P10 ||
+                    (codecpar->codec_id == AV_CODEC_ID_H264 && codecpar->profile == FF_PROFILE_H264_HIGH_10) ||
+                    (codecpar->codec_id == AV_CODEC_ID_HEVC && codecpar->profile == FF_PROFILE_HEVC_MAIN_10);
+    return format;
+}
+
+bool ffvdec_caps_vtb_supports(const AVCodecParameters *codecpar)
+{
+    IJKDecodeCapability capability;
+    FourCharCode        codec_type = codecpar ? codec_type_of(codecpar) : 0;
+
+    [IJKDeviceModel probeDecodeCapabilities];
+    if (!codec_type || ![IJKDeviceModel getDecodeCapability:&capability forCodecType:codec_type])
+        return true;
+
+    return [IJKDeviceModel isDecodeFormat:decode_format_of(codecpar) supportedBy:&capability];
+}
+
+void ffvdec_caps_vtb_refused(const AVCodecParameters *codecpar, int status)
+{
+    FourCharCode codec_type = codecpar ? codec_type_of(codecpar) : 0;
+
+    if (!codec_type || codecpar->width <= 0 || codecpar->height <= 0)
+        return;
+    if (status != kVTVideoDecoderUnsupportedDataFormatErr && status != kVTCouldNotFindVideoDecoderErr)
+        return;
+
+    [IJKDeviceModel addDecodeRefusal:decode_format_of(codecpar) forCodecType:codec_type];
+}
+
+bool ffvdec_caps_vtb_outputs_p010(void)
+{
+    IJKDecodeCapability capability;
+
+    if (![IJKDeviceModel getDecodeCapability:&capability forCodecType:kCMVideoCodecType_H264])
+        return true;
+    return (capability.outputFormats & IJKDecodeOutputP010) != 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * ffpipenode_ios_benchmark_vdec.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPENODE_IOS_BENCHMARK_VDEC_H
+#define FFPLAY__FF_FFPIPENODE_IOS_BENCHMARK_VDEC_H
+
+#include <stdint.h>
+#include "ijkplayer/ff_ffpipenode.h"
+
+struct FFPlayer;
+
+// Player option "decoder-benchmark": the decoded video frames are counted
+// and released instead of being queued for display, so the decoder runs as
+// fast as the demuxer feeds it, with no view needed. VideoToolbox reports
+// its frames from its output queue; the software decoder is replaced by the
+// node below, which decodes alone on the video thread.
+typedef struct FFDecoderBenchmark FFDecoderBenchmark;
+
+typedef struct FFDecoderBenchmarkResult {
+    int64_t frames;
+    int64_t elapsed_us;             // first packet taken by the decoder to the last frame out
+    int64_t latency_count;          // frames with a decode latency, submit to output
+    int64_t latency_p50_us;
+    int64_t latency_p95_us;
+    int64_t latency_p99_us;
+    int64_t session_create_us;      // VTDecompressionSessionCreate, summed
+    int     session_count;
+    int     finished;               // the decoder drained the end of the stream
+} FFDecoderBenchmarkResult;
+
+FFDecoderBenchmark *ffdecoder_benchmark_create(void);
+void ffdecoder_benchmark_freep(FFDecoderBenchmark **benchmark);
+
+// decoder threads; times are IJKSDLFrameTiming_now()
+void ffdecoder_benchmark_did_dequeue(FFDecoderBenchmark *benchmark, uint64_t dequeue);
+void ffdecoder_benchmark_did_decode(FFDecoderBenchmark *benchmark, uint64_t submit, uint64_t output);
+void ffdecoder_benchmark_did_create_session(FFDecoderBenchmark *benchmark, int64_t elapsed_us);
+void ffdecoder_benchmark_did_finish(FFDecoderBenchmark *benchmark);
+
+// any thread
+void ffdecoder_benchmark_get_result(FFDecoderBenchmark *benchmark, FFDecoderBenchmarkResult *result);
+
+IJKFF_Pipenode *ffpipenode_create_video_decoder_benchmark(struct FFPlayer *ffp, FFDecoderBenchmark *benchmark);
+
+#endif
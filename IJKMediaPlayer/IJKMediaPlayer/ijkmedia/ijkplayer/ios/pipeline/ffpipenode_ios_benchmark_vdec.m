@@ -0,0 +1,223 @@
+/*
+ * ffpipenode_ios_benchmark_vdec.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipenode_ios_benchmark_vdec.h"
+#include "ijkplayer/ff_ffpipenode.h"
+#include "ijkplayer/ff_ffplay.h"
+#import "ijksdl/ios/IJKSDLFrameLatency.h"
+#include <pthread.h>
+
+struct FFDecoderBenchmark {
+    pthread_mutex_t         mutex;
+    IJKSDLLatencyHistogram *latency;
+    int64_t                 frames;
+    uint64_t                first_dequeue;
+    uint64_t                last_output;
+    int64_t                 session_create_us;
+    int                     session_count;
+    int                     finished;
+};
+
+FFDecoderBenchmark *ffdecoder_benchmark_create(void)
+{
+    FFDecoderBenchmark *benchmark = calloc(1, sizeof(FFDecoderBenchmark));
+    if (!benchmark)
+        return NULL;
+
+    benchmark->latency = IJKSDLLatencyHistogram_create();
+    if (!benchmark->latency) {
+        free(benchmark);
+        return NULL;
+    }
+    pthread_mutex_init(&benchmark->mutex, NULL);
+    return benchmark;
+}
+
+void ffdecoder_benchmark_freep(FFDecoderBenchmark **benchmark)
+{
+    if (!benchmark || !*benchmark)
+        return;
+
+    IJKSDLLatencyHistogram_freep(&(*benchmark)->latency);
+    pthread_mutex_destroy(&(*benchmark)->mutex);
+    free(*benchmark);
+    *benchmark = NULL;
+}
+
+void ffdecoder_benchmark_did_dequeue(FFDecoderBenchmark *benchmark, uint64_t dequeue)
+{
+    if (!benchmark)
+        return;
+
+    pthread_mutex_lock(&benchmark->mutex);
+    if (!benchmark->first_dequeue)
+        benchmark->first_dequeue = dequeue;
+    pthread_mutex_unlock(&benchmark->mutex);
+}
+
+void ffdecoder_benchmark_did_decode(FFDecoderBenchmark *benchmark, uint64_t submit, uint64_t output)
+{
+    if (!benchmark)
+        return;
+
+    IJKSDLLatencyHistogram_add(benchmark->latency, IJKSDLFrameTiming_elapsed(submit, output));
+
+    pthread_mutex_lock(&benchmark->mutex);
+    benchmark->frames++;
+    if (output > benchmark->last_output)
+        benchmark->last_output = output;
+    pthread_mutex_unlock(&benchmark->mutex);
+}
+
+void ffdecoder_benchmark_did_create_session(FFDecoderBenchmark *benchmark, int64_t elapsed_us)
+{
+    if (!benchmark)
+        return;
+
+    pthread_mutex_lock(&benchmark->mutex);
+    benchmark->session_create_us += elapsed_us;
+    benchmark->session_count++;
+    pthread_mutex_unlock(&benchmark->mutex);
+}
+
+void ffdecoder_benchmark_did_finish(FFDecoderBenchmark *benchmark)
+{
+    if (!benchmark)
+        return;
+
+    pthread_mutex_lock(&benchmark->mutex);
+    benchmark->finished = 1;
+    pthread_mutex_unlock(&benchmark->mutex);
+}
+
+void ffdecoder_benchmark_get_result(FFDecoderBenchmark *benchmark, FFDecoderBenchmarkResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (!benchmark)
+        return;
+
+    IJKSDLLatencyPercentiles latency = IJKSDLLatencyHistogram_percentiles(benchmark->latency);
+    result->latency_count  = latency.count;
+    result->latency_p50_us = latency.p50;
+    result->latency_p95_us = latency.p95;
+    result->latency_p99_us = latency.p99;
+
+    pthread_mutex_lock(&benchmark->mutex);
+    result->frames            = benchmark->frames;
+    result->elapsed_us        = MAX(IJKSDLFrameTiming_elapsed(benchmark->first_dequeue, benchmark->last_output), 0);
+    result->session_create_us = benchmark->session_create_us;
+    result->session_count     = benchmark->session_count;
+    result->finished          = benchmark->finished;
+    pthread_mutex_unlock(&benchmark->mutex);
+}
+
+#pragma mark software decoder
+
+struct IJKFF_Pipenode_Opaque {
+    FFPlayer           *ffp;
+    FFDecoderBenchmark *benchmark;
+};
+
+static void func_destroy(IJKFF_Pipenode *node)
+{
+    // do nothing
+}
+
+// every frame out of the decoder, the last ones once the null packet of the end drains it
+static int receive_frames(IJKFF_Pipenode_Opaque *opaque, AVCodecContext *avctx, AVFrame *frame)
+{
+    for (;;) {
+        int ret = avcodec_receive_frame(avctx, frame);
+        if (ret < 0)
+            return ret == AVERROR(EAGAIN) ? 0 : ret;
+
+        // reordered_opaque carries the submit time of the packet across the frame threads
+        ffdecoder_benchmark_did_decode(opaque->benchmark, (uint64_t)frame->reordered_opaque, IJKSDLFrameTiming_now());
+        av_frame_unref(frame);
+    }
+}
+
+static int func_run_sync(IJKFF_Pipenode *node)
+{
+    IJKFF_Pipenode_Opaque *opaque = node->opaque;
+    FFPlayer   *ffp   = opaque->ffp;
+    VideoState *is    = ffp->is;
+    Decoder    *d     = &is->viddec;
+    AVFrame    *frame = av_frame_alloc();
+    AVPacket    pkt;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (;;) {
+        if (is->abort_request || d->queue->abort_request)
+            break;
+
+        if (d->queue->nb_packets == 0)
+            SDL_CondSignal(d->empty_queue_cond);
+        ffp_video_statistic_l(ffp);
+        if (ffp_packet_queue_get_or_buffering(ffp, d->queue, &pkt, &d->pkt_serial, &d->finished) < 0)
+            break;
+        if (ffp_is_flush_packet(&pkt)) {
+            avcodec_flush_buffers(d->avctx);
+            d->finished = 0;
+            continue;
+        }
+
+        uint64_t now = IJKSDLFrameTiming_now();
+        ffdecoder_benchmark_did_dequeue(opaque->benchmark, now);
+        d->avctx->reordered_opaque = (int64_t)now;
+
+        int ret = avcodec_send_packet(d->avctx, &pkt);
+        if (ret < 0 && ret != AVERROR(EAGAIN))
+            ALOGE("%s: avcodec_send_packet failed: %d\n", __func__, ret);
+        ret = receive_frames(opaque, d->avctx, frame);
+        if (ret == AVERROR_EOF) {
+            d->finished = d->pkt_serial;
+            ffdecoder_benchmark_did_finish(opaque->benchmark);
+            // decodes again after a seek back
+            avcodec_flush_buffers(d->avctx);
+        }
+        av_packet_unref(&pkt);
+    }
+
+    av_frame_free(&frame);
+    return 0;
+}
+
+IJKFF_Pipenode *ffpipenode_create_video_decoder_benchmark(FFPlayer *ffp, FFDecoderBenchmark *benchmark)
+{
+    if (!ffp || !ffp->is || !ffp->is->viddec.avctx || !benchmark)
+        return NULL;
+
+    IJKFF_Pipenode *node = ffpipenode_alloc(sizeof(IJKFF_Pipenode_Opaque));
+    if (!node)
+        return node;
+
+    IJKFF_Pipenode_Opaque *opaque = node->opaque;
+    node->func_destroy  = func_destroy;
+    node->func_run_sync = func_run_sync;
+    opaque->ffp         = ffp;
+    opaque->benchmark   = benchmark;
+    return node;
+}
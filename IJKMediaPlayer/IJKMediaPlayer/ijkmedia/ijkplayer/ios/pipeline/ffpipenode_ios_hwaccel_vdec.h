@@ -0,0 +1,48 @@
+/*
+ * ffpipenode_ios_hwaccel_vdec.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef FFPLAY__FF_FFPIPENODE_IOS_HWACCEL_VDEC_H
+#define FFPLAY__FF_FFPIPENODE_IOS_HWACCEL_VDEC_H
+
+#include <stdbool.h>
+#include "ijkplayer/ff_ffpipenode.h"
+
+struct FFPlayer;
+
+// Player option "videotoolbox-hwaccel", with "videotoolbox" on: the
+// VideoToolbox hwaccel of libavcodec, for the codecs IJKVideoToolBox does
+// not decode. Its CVPixelBuffers are queued as VideoToolbox overlays.
+typedef enum FFVideoToolboxHWAccel {
+    FF_VTB_HWACCEL_OFF      = 0,
+    FF_VTB_HWACCEL_FALLBACK = 1,    // MPEG-4 Part 2, H.263, MPEG-1 and MPEG-2
+    FF_VTB_HWACCEL_ALWAYS   = 2,    // H.264 too, instead of IJKVideoToolBox
+} FFVideoToolboxHWAccel;
+
+// the codecs the hwaccel of the bundled libavcodec decodes
+bool ffpipenode_ios_hwaccel_supports(int codec_id);
+
+// decodes on the video thread with a codec context of its own, the one of
+// the core stays idle; NULL if the codec has no hwaccel or fails to open
+IJKFF_Pipenode *ffpipenode_create_video_decoder_from_ios_hwaccel(struct FFPlayer *ffp);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * ffpipenode_ios_hwaccel_vdec.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ffpipenode_ios_hwaccel_vdec.h"
+#include "ffpipeline_ios.h"
+#include "ijkplayer/ff_ffpipenode.h"
+#include "ijkplayer/ff_ffplay.h"
+#include "ijksdl/ios/ijksdl_vout_overlay_videotoolbox.h"
+#import "ijksdl/ios/IJKSDLFrameLatency.h"
+#include "libavcodec/videotoolbox.h"
+#include "libavutil/intreadwrite.h"
+#import <CoreVideo/CoreVideo.h>
+
+struct IJKFF_Pipenode_Opaque {
+    FFPlayer           *ffp;
+    AVCodecContext     *avctx;
+    FFDecoderBenchmark *benchmark;
+};
+
+bool ffpipenode_ios_hwaccel_supports(int codec_id)
+{
+    switch (codec_id) {
+        case AV_CODEC_ID_H263:
+        case AV_CODEC_ID_H264:
+        case AV_CODEC_ID_MPEG1VIDEO:
+        case AV_CODEC_ID_MPEG2VIDEO:
+        case AV_CODEC_ID_MPEG4:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// a session is created for every new sequence; decodes in software when
+// VideoToolbox refuses it
+static enum AVPixelFormat hwaccel_get_format(AVCodecContext *avctx, const enum AVPixelFormat *fmts)
+{
+    for (const enum AVPixelFormat *p = fmts; *p != AV_PIX_FMT_NONE; p++) {
+        if (*p != AV_PIX_FMT_VIDEOTOOLBOX)
+            continue;
+
+        if (avctx->hwaccel_context)
+            av_videotoolbox_default_free(avctx);
+        int ret = av_videotoolbox_default_init(avctx);
+        if (ret >= 0)
+            return AV_PIX_FMT_VIDEOTOOLBOX;
+
+        av_videotoolbox_default_free(avctx);
+        ALOGW("%s: no VideoToolbox session (%d), decoding in software\n", __func__, ret);
+        break;
+    }
+
+    return avcodec_default_get_format(avctx, fmts);
+}
+
+static void func_destroy(IJKFF_Pipenode *node)
+{
+    IJKFF_Pipenode_Opaque *opaque = node->opaque;
+
+    if (opaque->avctx && opaque->avctx->hwaccel_context)
+        av_videotoolbox_default_free(opaque->avctx);
+    avcodec_free_context(&opaque->avctx);
+}
+
+// the early frame drop of the software decoder
+static bool should_drop_frame(FFPlayer *ffp, double dpts)
+{
+    VideoState *is = ffp->is;
+
+    if (!(ffp->framedrop > 0 || (ffp->framedrop && ffp_get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)))
+        return false;
+
+    ffp->stat.decode_frame_count++;
+    if (isnan(dpts))
+        return false;
+
+    double diff = dpts - ffp_get_master_clock(is);
+    if (isnan(diff) || fabs(diff) >= AV_NOSYNC_THRESHOLD ||
+        diff - is->frame_last_filter_delay >= 0 ||
+        is->viddec.pkt_serial != is->vidclk.serial ||
+        !is->videoq.nb_packets)
+        return false;
+
+    is->frame_drops_early++;
+    is->continuous_frame_drops_early++;
+    if (is->continuous_frame_drops_early > ffp->framedrop) {
+        is->continuous_frame_drops_early = 0;
+        return false;
+    }
+
+    ffp->stat.drop_frame_count++;
+    ffp->stat.drop_frame_rate = (float)(ffp->stat.drop_frame_count) / (float)(ffp->stat.decode_frame_count);
+    return true;
+}
+
+static void queue_frame(IJKFF_Pipenode_Opaque *opaque, AVFrame *frame, IJKSDLFrameTiming timing)
+{
+    FFPlayer   *ffp = opaque->ffp;
+    VideoState *is  = ffp->is;
+    int64_t     ts  = av_frame_get_best_effort_timestamp(frame);
+    double      pts = ts == AV_NOPTS_VALUE ? NAN : ts * av_q2d(is->video_st->time_base);
+
+    if (opaque->benchmark) {
+        ffdecoder_benchmark_did_decode(opaque->benchmark, timing.submit, timing.output);
+        return;
+    }
+    if (should_drop_frame(ffp, pts))
+        return;
+
+    AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
+    double     duration   = frame_rate.num && frame_rate.den ? av_q2d((AVRational){frame_rate.den, frame_rate.num}) : 0;
+
+    frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
+    if (frame->format != AV_PIX_FMT_VIDEOTOOLBOX) {
+        ffp_queue_picture(ffp, frame, pts, duration, av_frame_get_pkt_pos(frame), is->viddec.pkt_serial);
+        return;
+    }
+
+    // as IJKVideoToolBox queues its pictures: the CVPixelBuffer in opaque
+    CVPixelBufferRef pixel_buffer = (CVPixelBufferRef)frame->data[3];
+    AVFrame          picture      = {0};
+
+    picture.format              = IJK_AV_PIX_FMT__VIDEO_TOOLBOX;
+    picture.opaque              = pixel_buffer;
+    picture.pts                 = ts;
+    picture.sample_aspect_ratio = frame->sample_aspect_ratio;
+    if (CVPixelBufferIsPlanar(pixel_buffer)) {
+        picture.width  = (int)CVPixelBufferGetWidthOfPlane(pixel_buffer, 0);
+        picture.height = (int)CVPixelBufferGetHeightOfPlane(pixel_buffer, 0);
+    } else {
+        picture.width  = (int)CVPixelBufferGetWidth(pixel_buffer);
+        picture.height = (int)CVPixelBufferGetHeight(pixel_buffer);
+    }
+
+    if (!isnan(pts)) {
+        int64_t     start_time = is->ic->start_time;
+        double      media_time = pts - (start_time != AV_NOPTS_VALUE ? start_time / (double)AV_TIME_BASE : 0);
+        CFNumberRef number     = CFNumberCreate(NULL, kCFNumberDoubleType, &media_time);
+        CVBufferSetAttachment(pixel_buffer, IJK_VTB_ATTACHMENT_PTS, number, kCVAttachmentMode_ShouldNotPropagate);
+        CFRelease(number);
+    }
+
+    ffpipeline_ios_did_decode_frame(ffp, IJKSDLFrameTiming_elapsed(timing.submit, timing.output), duration);
+    ffpipeline_ios_wait_frame_queue_limit(ffp);
+    timing.queue = IJKSDLFrameTiming_now();
+    IJKSDLFrameTiming_attach(pixel_buffer, &timing);
+    ffp_queue_picture(ffp, &picture, pts, duration, 0, is->viddec.pkt_serial);
+}
+
+// an H.264 access unit whose slices all have nal_ref_idc 0, length prefixed
+// as in avcC, or Annex B
+static bool h264_packet_is_disposable(AVCodecContext *avctx, const AVPacket *pkt)
+{
+    const uint8_t *p       = pkt->data;
+    const uint8_t *end     = pkt->data + pkt->size;
+    bool           has_vcl = false;
+    int            length  = avctx->extradata_size >= 7 && avctx->extradata[0] == 1 ? (avctx->extradata[4] & 0x03) + 1 : 0;
+
+    while (p < end) {
+        const uint8_t *nal = NULL;
+        if (length) {
+            if (end - p < length)
+                return false;
+            uint32_t size = length == 4 ? AV_RB32(p) : length == 2 ? AV_RB16(p) : p[0];
+            p += length;
+            if (size == 0 || size > end - p)
+                return false;
+            nal = p;
+            p  += size;
+        } else {
+            if (end - p < 4 || p[0] != 0 || p[1] != 0 || p[2] != 1) {
+                p++;
+                continue;
+            }
+            nal = p + 3;
+            p  += 3;
+        }
+
+        int type = nal[0] & 0x1f;
+        if (type < 1 || type > 5)
+            continue;
+        if (type == 5 || (nal[0] & 0x60))
+            return false;
+        has_vcl = true;
+    }
+    return has_vcl;
+}
+
+// max-fps below the frame rate: the frames between its slots that nothing
+// references are not sent, see ffpipeline_ios_decimation_due()
+static bool decimate_packet(IJKFF_Pipenode_Opaque *opaque, const AVPacket *pkt)
+{
+    if (opaque->avctx->codec_id != AV_CODEC_ID_H264 || !pkt->data)
+        return false;
+    if (!ffpipeline_ios_decimation_due(opaque->ffp))
+        return false;
+
+    bool left_out = h264_packet_is_disposable(opaque->avctx, pkt);
+    ffpipeline_ios_did_decimate(opaque->ffp, left_out);
+    return left_out;
+}
+
+// every frame out of the decoder, the last ones once the null packet of the end drains it
+static int receive_frames(IJKFF_Pipenode_Opaque *opaque, AVFrame *frame, uint64_t dequeue)
+{
+    for (;;) {
+        int ret = avcodec_receive_frame(opaque->avctx, frame);
+        if (ret < 0)
+            return ret == AVERROR(EAGAIN) ? 0 : ret;
+
+        // the hwaccel decodes synchronously, a frame is out when its packet returns
+        IJKSDLFrameTiming timing = {
+            .dequeue = dequeue,
+            .submit  = (uint64_t)frame->reordered_opaque,
+            .output  = IJKSDLFrameTiming_now(),
+        };
+        @autoreleasepool {
+            queue_frame(opaque, frame, timing);
+        }
+        av_frame_unref(frame);
+    }
+}
+
+static int func_run_sync(IJKFF_Pipenode *node)
+{
+    IJKFF_Pipenode_Opaque *opaque = node->opaque;
+    FFPlayer   *ffp   = opaque->ffp;
+    VideoState *is    = ffp->is;
+    Decoder    *d     = &is->viddec;
+    AVFrame    *frame = av_frame_alloc();
+    AVPacket    pkt;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (;;) {
+        if (is->abort_request || d->queue->abort_request)
+            break;
+
+        if (d->queue->nb_packets == 0)
+            SDL_CondSignal(d->empty_queue_cond);
+        ffp_video_statistic_l(ffp);
+        if (ffp_packet_queue_get_or_buffering(ffp, d->queue, &pkt, &d->pkt_serial, &d->finished) < 0)
+            break;
+        if (ffp_is_flush_packet(&pkt)) {
+            avcodec_flush_buffers(opaque->avctx);
+            d->finished = 0;
+            continue;
+        }
+
+        if (!opaque->benchmark && decimate_packet(opaque, &pkt)) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        uint64_t now = IJKSDLFrameTiming_now();
+        ffpipeline_ios_did_take_first_packet(ffp);
+        ffdecoder_benchmark_did_dequeue(opaque->benchmark, now);
+        opaque->avctx->skip_frame       = ffpipeline_ios_is_keyframes_only(ffp) ? AVDISCARD_NONKEY : ffp->skip_frame;
+        opaque->avctx->reordered_opaque = (int64_t)now;
+
+        int ret = avcodec_send_packet(opaque->avctx, &pkt);
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            ALOGE("%s: avcodec_send_packet failed: %d\n", __func__, ret);
+        ret = receive_frames(opaque, frame, now);
+        if (ret == AVERROR_EOF) {
+            d->finished = d->pkt_serial;
+            ffdecoder_benchmark_did_finish(opaque->benchmark);
+            // decodes again after a seek back
+            avcodec_flush_buffers(opaque->avctx);
+        }
+        av_packet_unref(&pkt);
+    }
+
+    av_frame_free(&frame);
+    return 0;
+}
+
+IJKFF_Pipenode *ffpipenode_create_video_decoder_from_ios_hwaccel(FFPlayer *ffp)
+{
+    if (!ffp || !ffp->is || !ffp->is->video_st)
+        return NULL;
+
+    AVStream *st    = ffp->is->video_st;
+    AVCodec  *codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec || !ffpipenode_ios_hwaccel_supports(codec->id))
+        return NULL;
+
+    IJKFF_Pipenode *node = ffpipenode_alloc(sizeof(IJKFF_Pipenode_Opaque));
+    if (!node)
+        return node;
+
+    IJKFF_Pipenode_Opaque *opaque = node->opaque;
+    node->func_destroy  = func_destroy;
+    node->func_run_sync = func_run_sync;
+    opaque->ffp         = ffp;
+    opaque->benchmark   = ffpipeline_ios_get_decoder_benchmark(ffp);
+
+    opaque->avctx = avcodec_alloc_context3(codec);
+    if (!opaque->avctx || avcodec_parameters_to_context(opaque->avctx, st->codecpar) < 0)
+        goto fail;
+
+    // one session decodes in order, frame threads would each want their own
+    opaque->avctx->pkt_timebase     = st->time_base;
+    opaque->avctx->get_format       = hwaccel_get_format;
+    opaque->avctx->thread_count     = 1;
+    opaque->avctx->skip_loop_filter = ffp->skip_loop_filter;
+    opaque->avctx->skip_frame       = ffp->skip_frame;
+
+    int ret = avcodec_open2(opaque->avctx, codec, NULL);
+    if (ret < 0) {
+        ALOGE("%s: failed to open %s (%d)\n", __func__, codec->name, ret);
+        goto fail;
+    }
+
+    ALOGI("video decoder: %s, VideoToolbox hwaccel\n", codec->name);
+    return node;
+
+fail:
+    ffpipenode_free_p(&node);
+    return NULL;
+}
@@ -112,13 +112,11 @@ IJKFF_Pipenode *ffpipenode_create_video_decoder_from_ios_videotoolbox(FFPlayer *
     opaque->avctx = opaque->decoder->avctx;
     switch (opaque->avctx->codec_id) {
     case AV_CODEC_ID_H264:
-            if (ffp->vtb_async)
-                opaque->context = Ijk_VideoToolbox_Async_Create(ffp, opaque->avctx);
-            else
-                opaque->context = Ijk_VideoToolbox_Sync_Create(ffp, opaque->avctx);
+    case AV_CODEC_ID_HEVC:
+            opaque->context = Ijk_VideoToolbox_Create(ffp, opaque->avctx);
         break;
     default:
-        ALOGI("Videotoolbox-pipeline:open_video_decoder: not H264\n");
+        ALOGI("Videotoolbox-pipeline:open_video_decoder: not H264 or HEVC\n");
         goto fail;
     }
     if (opaque->context == NULL) {
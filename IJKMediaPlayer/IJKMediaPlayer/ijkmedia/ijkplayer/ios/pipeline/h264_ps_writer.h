@@ -0,0 +1,163 @@
+/*
+ * h264_ps_writer.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef IJKMediaPlayer_h264_ps_writer_h
+#define IJKMediaPlayer_h264_ps_writer_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <CoreMedia/CoreMedia.h>
+
+// Parameter sets of a stream that does not exist, for VideoToolbox sessions
+// created before the stream is known: the capability probe of IJKDeviceModel
+// and the warm-up of IJKVideoToolBoxDecoder.
+
+#define H264_PS_RBSP_MAX_SIZE   64
+// the NAL header and an emulation prevention byte for every two bytes
+#define H264_PS_NAL_MAX_SIZE    (1 + H264_PS_RBSP_MAX_SIZE * 3 / 2)
+
+typedef struct H264PSWriter {
+    uint8_t buf[H264_PS_RBSP_MAX_SIZE];
+    int     bits;
+} H264PSWriter;
+
+static inline void h264_ps_put_bits(H264PSWriter *w, uint32_t value, int n)
+{
+    for (int i = n - 1; i >= 0; i--) {
+        if ((value >> i) & 1)
+            w->buf[w->bits >> 3] |= 0x80 >> (w->bits & 7);
+        w->bits++;
+    }
+}
+
+// ue(v), se(0) too
+static inline void h264_ps_put_ue(H264PSWriter *w, uint32_t value)
+{
+    uint32_t v   = value + 1;
+    int      len = 0;
+
+    while ((v >> len) > 1)
+        len++;
+    h264_ps_put_bits(w, 0, len);
+    h264_ps_put_bits(w, v, len + 1);
+}
+
+// the rbsp_trailing_bits, then the NAL with its emulation prevention bytes
+static inline size_t h264_ps_finish_nal(H264PSWriter *w, uint8_t header, uint8_t *nal)
+{
+    h264_ps_put_bits(w, 1, 1);
+
+    size_t size  = 0;
+    int    zeros = 0;
+    nal[size++] = header;
+    for (int i = 0; i < (w->bits + 7) / 8; i++) {
+        if (zeros >= 2 && w->buf[i] <= 3) {
+            nal[size++] = 3;
+            zeros = 0;
+        }
+        nal[size++] = w->buf[i];
+        zeros = w->buf[i] ? 0 : zeros + 1;
+    }
+    return size;
+}
+
+// High or High 10 at the size and level given, 4:2:0 progressive, nothing
+// else a decoder could refuse
+static inline size_t h264_ps_write_sps(uint8_t *nal, int width, int height, int level, bool ten_bit)
+{
+    H264PSWriter w;
+    int mb_width  = (width + 15) / 16;
+    int mb_height = (height + 15) / 16;
+    // in chroma samples, two luma ones
+    int crop_right  = (mb_width * 16 - width) / 2;
+    int crop_bottom = (mb_height * 16 - height) / 2;
+
+    memset(&w, 0, sizeof(w));
+    h264_ps_put_bits(&w, ten_bit ? 110 : 100, 8);      // profile_idc
+    h264_ps_put_bits(&w, 0, 8);                         // constraint_set flags
+    h264_ps_put_bits(&w, level, 8);                     // level_idc
+    h264_ps_put_ue(&w, 0);                              // seq_parameter_set_id
+    h264_ps_put_ue(&w, 1);                              // chroma_format_idc
+    h264_ps_put_ue(&w, ten_bit ? 2 : 0);                // bit_depth_luma_minus8
+    h264_ps_put_ue(&w, ten_bit ? 2 : 0);                // bit_depth_chroma_minus8
+    h264_ps_put_bits(&w, 0, 1);                         // qpprime_y_zero_transform_bypass_flag
+    h264_ps_put_bits(&w, 0, 1);                         // seq_scaling_matrix_present_flag
+    h264_ps_put_ue(&w, 0);                              // log2_max_frame_num_minus4
+    h264_ps_put_ue(&w, 2);                              // pic_order_cnt_type
+    h264_ps_put_ue(&w, 1);                              // max_num_ref_frames
+    h264_ps_put_bits(&w, 0, 1);                         // gaps_in_frame_num_value_allowed_flag
+    h264_ps_put_ue(&w, mb_width - 1);                   // pic_width_in_mbs_minus1
+    h264_ps_put_ue(&w, mb_height - 1);                  // pic_height_in_map_units_minus1
+    h264_ps_put_bits(&w, 1, 1);                         // frame_mbs_only_flag
+    h264_ps_put_bits(&w, 1, 1);                         // direct_8x8_inference_flag
+    h264_ps_put_bits(&w, crop_right || crop_bottom, 1); // frame_cropping_flag
+    if (crop_right || crop_bottom) {
+        h264_ps_put_ue(&w, 0);
+        h264_ps_put_ue(&w, crop_right);
+        h264_ps_put_ue(&w, 0);
+        h264_ps_put_ue(&w, crop_bottom);
+    }
+    h264_ps_put_bits(&w, 0, 1);                         // vui_parameters_present_flag
+    return h264_ps_finish_nal(&w, 0x67, nal);
+}
+
+static inline size_t h264_ps_write_pps(uint8_t *nal)
+{
+    H264PSWriter w;
+
+    memset(&w, 0, sizeof(w));
+    h264_ps_put_ue(&w, 0);                              // pic_parameter_set_id
+    h264_ps_put_ue(&w, 0);                              // seq_parameter_set_id
+    h264_ps_put_bits(&w, 0, 1);                         // entropy_coding_mode_flag
+    h264_ps_put_bits(&w, 0, 1);                         // bottom_field_pic_order_in_frame_present_flag
+    h264_ps_put_ue(&w, 0);                              // num_slice_groups_minus1
+    h264_ps_put_ue(&w, 0);                              // num_ref_idx_l0_default_active_minus1
+    h264_ps_put_ue(&w, 0);                              // num_ref_idx_l1_default_active_minus1
+    h264_ps_put_bits(&w, 0, 1);                         // weighted_pred_flag
+    h264_ps_put_bits(&w, 0, 2);                         // weighted_bipred_idc
+    h264_ps_put_ue(&w, 0);                              // pic_init_qp_minus26
+    h264_ps_put_ue(&w, 0);                              // pic_init_qs_minus26
+    h264_ps_put_ue(&w, 0);                              // chroma_qp_index_offset
+    h264_ps_put_bits(&w, 1, 1);                         // deblocking_filter_control_present_flag
+    h264_ps_put_bits(&w, 0, 1);                         // constrained_intra_pred_flag
+    h264_ps_put_bits(&w, 0, 1);                         // redundant_pic_cnt_present_flag
+    return h264_ps_finish_nal(&w, 0x68, nal);
+}
+
+static inline OSStatus h264_ps_create_format_description(int width, int height, int level, bool ten_bit,
+                                                         CMVideoFormatDescriptionRef *format_description)
+{
+    uint8_t        sps[H264_PS_NAL_MAX_SIZE];
+    uint8_t        pps[H264_PS_NAL_MAX_SIZE];
+    const uint8_t *parameter_sets[2]      = {sps, pps};
+    size_t         parameter_set_sizes[2] = {
+        h264_ps_write_sps(sps, width, height, level, ten_bit),
+        h264_ps_write_pps(pps),
+    };
+
+    return CMVideoFormatDescriptionCreateFromH264ParameterSets(kCFAllocatorDefault, 2,
+                                                               parameter_sets, parameter_set_sizes,
+                                                               4, format_description);
+}
+
+#endif
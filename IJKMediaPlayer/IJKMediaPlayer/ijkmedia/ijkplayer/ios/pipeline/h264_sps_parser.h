@@ -57,6 +57,19 @@ enum {
     NAL_FF_IGNORE       = 0xff0f001,
 };
 
+/* HEVC NAL unit types */
+enum {
+    HEVC_NAL_BLA_W_LP   = 16,
+    HEVC_NAL_BLA_W_RADL = 17,
+    HEVC_NAL_BLA_N_LP   = 18,
+    HEVC_NAL_IDR_W_RADL = 19,
+    HEVC_NAL_IDR_N_LP   = 20,
+    HEVC_NAL_CRA_NUT    = 21,
+    HEVC_NAL_VPS        = 32,
+    HEVC_NAL_SPS        = 33,
+    HEVC_NAL_PPS        = 34,
+};
+
 
 typedef struct
 {
@@ -144,9 +157,52 @@ nal_bs_read_ue(nal_bitstream *bs)
     return ((1 << i) - 1 + nal_bs_read(bs, i));
 }
 
+// read signed Exp-Golomb code
+static int64_t
+nal_bs_read_se(nal_bitstream *bs)
+{
+    int64_t k = nal_bs_read_ue(bs);
+
+    return (k & 1) ? (k + 1) / 2 : -(k / 2);
+}
+
+static void
+nal_bs_skip_scaling_list(nal_bitstream *bs, int size)
+{
+    int64_t last_scale = 8;
+    int64_t next_scale = 8;
+
+    for (int j = 0; j < size; j++) {
+        if (next_scale != 0) {
+            int64_t delta_scale = nal_bs_read_se(bs);
+            next_scale = (last_scale + delta_scale + 256) % 256;
+        }
+        last_scale = (next_scale == 0) ? last_scale : next_scale;
+    }
+}
+
+static void
+nal_bs_skip_hrd_parameters(nal_bitstream *bs)
+{
+    int64_t cpb_cnt_minus1 = nal_bs_read_ue(bs);
+
+    nal_bs_read(bs, 4);         // bit_rate_scale
+    nal_bs_read(bs, 4);         // cpb_size_scale
+    for (int64_t i = 0; i <= cpb_cnt_minus1 && !nal_bs_eos(bs); i++) {
+        nal_bs_read_ue(bs);     // bit_rate_value_minus1[i]
+        nal_bs_read_ue(bs);     // cpb_size_value_minus1[i]
+        nal_bs_read(bs, 1);     // cbr_flag[i]
+    }
+    nal_bs_read(bs, 5);         // initial_cpb_removal_delay_length_minus1
+    nal_bs_read(bs, 5);         // cpb_removal_delay_length_minus1
+    nal_bs_read(bs, 5);         // dpb_output_delay_length_minus1
+    nal_bs_read(bs, 5);         // time_offset_length
+}
+
 typedef struct
 {
     uint64_t profile_idc;
+    uint64_t constraint_set3_flag;
     uint64_t level_idc;
     uint64_t sps_id;
 
@@ -176,20 +232,86 @@ typedef struct
     uint64_t frame_crop_right_offset;
     uint64_t frame_crop_top_offset;
     uint64_t frame_crop_bottom_offset;
+
+    uint64_t vui_parameters_present_flag;
+    uint64_t bitstream_restriction_flag;
+    uint64_t max_num_reorder_frames;
+    uint64_t max_dec_frame_buffering;
 } sps_info_struct;
 
-static void parseh264_sps(uint8_t *sps, uint32_t sps_size,  int *level, int *profile, bool *interlaced, int32_t *max_ref_frames)
+// the part of the VUI up to max_num_reorder_frames, E.1.1
+static void parseh264_vui_info(nal_bitstream *bs, sps_info_struct *sps_info)
+{
+    if (nal_bs_read(bs, 1)) {           // aspect_ratio_info_present_flag
+        if (nal_bs_read(bs, 8) == 255) {    // aspect_ratio_idc, Extended_SAR
+            nal_bs_read(bs, 16);        // sar_width
+            nal_bs_read(bs, 16);        // sar_height
+        }
+    }
+    if (nal_bs_read(bs, 1))             // overscan_info_present_flag
+        nal_bs_read(bs, 1);             // overscan_appropriate_flag
+    if (nal_bs_read(bs, 1)) {           // video_signal_type_present_flag
+        nal_bs_read(bs, 3);             // video_format
+        nal_bs_read(bs, 1);             // video_full_range_flag
+        if (nal_bs_read(bs, 1))         // colour_description_present_flag
+            nal_bs_read(bs, 24);        // colour_primaries, transfer_characteristics, matrix_coefficients
+    }
+    if (nal_bs_read(bs, 1)) {           // chroma_loc_info_present_flag
+        nal_bs_read_ue(bs);             // chroma_sample_loc_type_top_field
+        nal_bs_read_ue(bs);             // chroma_sample_loc_type_bottom_field
+    }
+    if (nal_bs_read(bs, 1)) {           // timing_info_present_flag
+        nal_bs_read(bs, 16);            // num_units_in_tick
+        nal_bs_read(bs, 16);
+        nal_bs_read(bs, 16);            // time_scale
+        nal_bs_read(bs, 16);
+        nal_bs_read(bs, 1);             // fixed_frame_rate_flag
+    }
+
+    uint64_t nal_hrd_parameters_present_flag = nal_bs_read(bs, 1);
+    if (nal_hrd_parameters_present_flag)
+        nal_bs_skip_hrd_parameters(bs);
+    uint64_t vcl_hrd_parameters_present_flag = nal_bs_read(bs, 1);
+    if (vcl_hrd_parameters_present_flag)
+        nal_bs_skip_hrd_parameters(bs);
+    if (nal_hrd_parameters_present_flag || vcl_hrd_parameters_present_flag)
+        nal_bs_read(bs, 1);             // low_delay_hrd_flag
+    nal_bs_read(bs, 1);                 // pic_struct_present_flag
+
+    if (nal_bs_eos(bs))
+        return;
+
+    sps_info->bitstream_restriction_flag = nal_bs_read(bs, 1);
+    if (sps_info->bitstream_restriction_flag) {
+        nal_bs_read(bs, 1);             // motion_vectors_over_pic_boundaries_flag
+        nal_bs_read_ue(bs);             // max_bytes_per_pic_denom
+        nal_bs_read_ue(bs);             // max_bits_per_mb_denom
+        nal_bs_read_ue(bs);             // log2_max_mv_length_horizontal
+        nal_bs_read_ue(bs);             // log2_max_mv_length_vertical
+        sps_info->max_num_reorder_frames  = nal_bs_read_ue(bs);
+        sps_info->max_dec_frame_buffering = nal_bs_read_ue(bs);
+        // inconsistent, a truncated SPS read as zeros: not known then
+        if (sps_info->max_dec_frame_buffering < sps_info->max_num_reorder_frames ||
+            sps_info->max_dec_frame_buffering < sps_info->max_num_ref_frames)
+            sps_info->bitstream_restriction_flag = 0;
+    }
+}
+
+static void parseh264_sps_info(const uint8_t *sps, uint32_t sps_size, sps_info_struct *out_sps_info)
 {
     nal_bitstream bs;
     sps_info_struct sps_info = {0};
 
+    // 4:2:0 unless the profile says otherwise
+    sps_info.chroma_format_idc = 1;
+
     nal_bs_init(&bs, sps, sps_size);
 
     sps_info.profile_idc  = nal_bs_read(&bs, 8);
     nal_bs_read(&bs, 1);  // constraint_set0_flag
     nal_bs_read(&bs, 1);  // constraint_set1_flag
     nal_bs_read(&bs, 1);  // constraint_set2_flag
-    nal_bs_read(&bs, 1);  // constraint_set3_flag
+    sps_info.constraint_set3_flag = nal_bs_read(&bs, 1);
     nal_bs_read(&bs, 4);  // reserved
     sps_info.level_idc    = nal_bs_read(&bs, 8);
     sps_info.sps_id       = nal_bs_read_ue(&bs);
@@ -212,7 +334,11 @@ static void parseh264_sps(uint8_t *sps, uint32_t sps_size,  int *level, int *pro
             sps_info.seq_scaling_matrix_present_flag = nal_bs_read (&bs, 1);
             if (sps_info.seq_scaling_matrix_present_flag)
             {
-                /* TODO: unfinished */
+                int lists = (sps_info.chroma_format_idc != 3) ? 8 : 12;
+                for (int i = 0; i < lists; i++) {
+                    if (nal_bs_read(&bs, 1))
+                        nal_bs_skip_scaling_list(&bs, i < 6 ? 16 : 64);
+                }
             }
     }
     sps_info.log2_max_frame_num_minus4 = nal_bs_read_ue(&bs);
@@ -227,16 +353,14 @@ static void parseh264_sps(uint8_t *sps, uint32_t sps_size,  int *level, int *pro
     if (sps_info.pic_order_cnt_type == 0) {
         sps_info.log2_max_pic_order_cnt_lsb_minus4 = nal_bs_read_ue(&bs);
     }
-    else if (sps_info.pic_order_cnt_type == 1) { // TODO: unfinished
-        /*
-         delta_pic_order_always_zero_flag = gst_nal_bs_read (bs, 1);
-         offset_for_non_ref_pic = gst_nal_bs_read_se (bs);
-         offset_for_top_to_bottom_field = gst_nal_bs_read_se (bs);
-
-         num_ref_frames_in_pic_order_cnt_cycle = gst_nal_bs_read_ue (bs);
-         for( i = 0; i < num_ref_frames_in_pic_order_cnt_cycle; i++ )
-         offset_for_ref_frame[i] = gst_nal_bs_read_se (bs);
-         */
+    else if (sps_info.pic_order_cnt_type == 1) {
+        nal_bs_read(&bs, 1);    // delta_pic_order_always_zero_flag
+        nal_bs_read_se(&bs);    // offset_for_non_ref_pic
+        nal_bs_read_se(&bs);    // offset_for_top_to_bottom_field
+
+        int64_t num_ref_frames_in_pic_order_cnt_cycle = nal_bs_read_ue(&bs);
+        for (int64_t i = 0; i < num_ref_frames_in_pic_order_cnt_cycle && !nal_bs_eos(&bs); i++)
+            nal_bs_read_se(&bs); // offset_for_ref_frame[i]
     }
 
     sps_info.max_num_ref_frames             = nal_bs_read_ue(&bs);
@@ -258,6 +382,19 @@ static void parseh264_sps(uint8_t *sps, uint32_t sps_size,  int *level, int *pro
         sps_info.frame_crop_bottom_offset     = nal_bs_read_ue(&bs);
     }
 
+    sps_info.vui_parameters_present_flag    = nal_bs_read(&bs, 1);
+    if (sps_info.vui_parameters_present_flag)
+        parseh264_vui_info(&bs, &sps_info);
+
+    *out_sps_info = sps_info;
+}
+
+static void parseh264_sps(uint8_t *sps, uint32_t sps_size,  int *level, int *profile, bool *interlaced, int32_t *max_ref_frames)
+{
+    sps_info_struct sps_info = {0};
+
+    parseh264_sps_info(sps, sps_size, &sps_info);
+
     *level = (int)sps_info.level_idc;
     *profile = (int)sps_info.profile_idc;
     *interlaced = (int)!sps_info.frame_mbs_only_flag;
@@ -278,6 +415,106 @@ static bool validate_avcC_spc(uint8_t *extradata, uint32_t extrasize, int32_t *m
     return true;
 }
 
+// frames are output in decoding order: max_num_reorder_frames of the VUI
+// is 0, or inferred to be for the intra profiles (E.2.1); picture order
+// count type 2 implies it as well (8.2.1.3)
+static bool h264_sps_no_reordering(const sps_info_struct *sps_info)
+{
+    if (sps_info->bitstream_restriction_flag)
+        return sps_info->max_num_reorder_frames == 0;
+    if (sps_info->pic_order_cnt_type == 2)
+        return true;
+
+    switch (sps_info->profile_idc) {
+        case 44: case 86: case 100: case 110: case 122: case 244:
+            return sps_info->constraint_set3_flag != 0;
+        default:
+            return false;
+    }
+}
+
+// of the first SPS of an avcC atom
+static bool h264_avcC_no_reordering(const uint8_t *extradata, uint32_t extrasize)
+{
+    sps_info_struct sps_info = {0};
+
+    if (!extradata || extrasize < 9)
+        return false;
+
+    uint32_t sps_size = AV_RB16(extradata + 6);
+    if (sps_size < 2 || 8 + sps_size > extrasize)
+        return false;
+
+    parseh264_sps_info(extradata + 9, sps_size - 1, &sps_info);
+    return h264_sps_no_reordering(&sps_info);
+}
+
+// cropped picture size, as in H.264 7.4.2.1.1
+static bool h264_sps_get_dimensions(const sps_info_struct *sps_info, int *width, int *height)
+{
+    int crop_unit_x = 1;
+    int crop_unit_y = 2 - (int)sps_info->frame_mbs_only_flag;
+
+    if (sps_info->chroma_format_idc == 1 || sps_info->chroma_format_idc == 2) {
+        crop_unit_x = 2;
+        if (sps_info->chroma_format_idc == 1)
+            crop_unit_y *= 2;
+    }
+
+    int w = (int)(sps_info->pic_width_in_mbs_minus1 + 1) * 16;
+    int h = (int)(sps_info->pic_height_in_map_units_minus1 + 1) * 16 * (2 - (int)sps_info->frame_mbs_only_flag);
+    if (sps_info->frame_cropping_flag) {
+        w -= (int)(sps_info->frame_crop_left_offset + sps_info->frame_crop_right_offset) * crop_unit_x;
+        h -= (int)(sps_info->frame_crop_top_offset + sps_info->frame_crop_bottom_offset) * crop_unit_y;
+    }
+    if (w <= 0 || h <= 0)
+        return false;
+
+    *width  = w;
+    *height = h;
+    return true;
+}
+
+// picture size of the first SPS in avcC or Annex B extradata
+static bool h264_extradata_get_dimensions(const uint8_t *extradata, int extrasize, int *width, int *height)
+{
+    sps_info_struct sps_info = {0};
+
+    if (!extradata || extrasize < 8)
+        return false;
+
+    if (extradata[0] == 1) {
+        // avcC: the first SPS follows the 6 bytes header and its 16 bits length
+        int sps_size = AV_RB16(extradata + 6);
+        if ((extradata[5] & 0x1f) == 0 || sps_size < 2 || 8 + sps_size > extrasize)
+            return false;
+        parseh264_sps_info(extradata + 9, sps_size - 1, &sps_info);
+        return h264_sps_get_dimensions(&sps_info, width, height);
+    }
+
+    for (int i = 0; i + 4 < extrasize; i++) {
+        if (extradata[i] != 0 || extradata[i + 1] != 0 || extradata[i + 2] != 1)
+            continue;
+
+        const uint8_t *nal = extradata + i + 3;
+        if ((nal[0] & 0x1f) != NAL_SPS)
+            continue;
+
+        const uint8_t *end = extradata + extrasize;
+        for (const uint8_t *p = nal + 1; p + 3 <= end; p++) {
+            if (p[0] == 0 && p[1] == 0 && (p[2] == 0 || p[2] == 1)) {
+                end = p;
+                break;
+            }
+        }
+        if (end - nal < 2)
+            return false;
+        parseh264_sps_info(nal + 1, (uint32_t)(end - nal - 1), &sps_info);
+        return h264_sps_get_dimensions(&sps_info, width, height);
+    }
+    return false;
+}
+
 
 
 
@@ -285,6 +522,10 @@ static inline int ff_get_nal_units_type(const uint8_t * const data) {
     return   data[4] & 0x1f;
 }
 
+static inline int ff_get_hevc_nal_units_type(const uint8_t * const data) {
+    return   (data[4] >> 1) & 0x3f;
+}
+
 static uint32_t bytesToInt(uint8_t* src) {
     uint32_t value;
     value = (uint32_t)((src[0] & 0xFF)<<24|(src[1]&0xFF)<<16|(src[2]&0xFF)<<8|(src[3]&0xFF));
@@ -293,7 +534,7 @@ static uint32_t bytesToInt(uint8_t* src) {
 
 
 
-static bool ff_avpacket_is_idr(const AVPacket* pkt) {
+static bool ff_avpacket_is_idr(const AVPacket* pkt, enum AVCodecID codec_id) {
 
     int state = -1;
 
@@ -301,9 +542,17 @@ static bool ff_avpacket_is_idr(const AVPacket* pkt) {
         int offset = 0;
         while (offset >= 0 && offset + 5 <= pkt->size) {
             void* nal_start = pkt->data+offset;
-            state = ff_get_nal_units_type(nal_start);
-            if (state == NAL_IDR_SLICE) {
-                return true;
+            if (codec_id == AV_CODEC_ID_HEVC) {
+                // any IRAP picture (BLA/IDR/CRA) is a valid point to restart decoding
+                state = ff_get_hevc_nal_units_type(nal_start);
+                if (state >= HEVC_NAL_BLA_W_LP && state <= HEVC_NAL_CRA_NUT) {
+                    return true;
+                }
+            } else {
+                state = ff_get_nal_units_type(nal_start);
+                if (state == NAL_IDR_SLICE) {
+                    return true;
+                }
             }
             //            ALOGI("offset %d \n", bytesToInt(nal_start));
             offset+=(bytesToInt(nal_start) + 4);
@@ -312,6 +561,46 @@ static bool ff_avpacket_is_idr(const AVPacket* pkt) {
     return false;
 }
 
+static inline int ff_h264_nal_is_disposable(const uint8_t *nal, bool *has_vcl) {
+    int type = nal[0] & 0x1f;
+    if (type < NAL_SLICE || type > NAL_IDR_SLICE)
+        return true;
+
+    *has_vcl = true;
+    // nal_ref_idc == 0: no other picture predicts from this one
+    return type != NAL_IDR_SLICE && ((nal[0] >> 5) & 0x03) == 0;
+}
+
+// true if every slice of the H.264 access unit has nal_ref_idc == 0,
+// data is either 4 bytes length prefixed or Annex B
+static bool ff_h264_data_is_disposable(const uint8_t *data, int size, bool annexb) {
+    bool has_vcl = false;
+
+    if (!data || size < 5)
+        return false;
+
+    if (annexb) {
+        for (int i = 0; i + 3 < size; i++) {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+                continue;
+            if (!ff_h264_nal_is_disposable(data + i + 3, &has_vcl))
+                return false;
+            i += 2;
+        }
+    } else {
+        int offset = 0;
+        while (offset + 5 <= size) {
+            uint32_t nal_size = AV_RB32(data + offset);
+            if (nal_size == 0 || nal_size > (uint32_t)(size - offset - 4))
+                return false;
+            if (!ff_h264_nal_is_disposable(data + offset + 4, &has_vcl))
+                return false;
+            offset += nal_size + 4;
+        }
+    }
+    return has_vcl;
+}
+
 static bool ff_avpacket_is_key(const AVPacket* pkt) {
     if (pkt->flags & AV_PKT_FLAG_KEY) {
         return true;
@@ -320,9 +609,9 @@ static bool ff_avpacket_is_key(const AVPacket* pkt) {
     }
 }
 
-static bool ff_avpacket_i_or_idr(const AVPacket* pkt,bool isIdr) {
+static bool ff_avpacket_i_or_idr(const AVPacket* pkt,bool isIdr, enum AVCodecID codec_id) {
     if (isIdr == true) {
-        return ff_avpacket_is_idr(pkt);
+        return ff_avpacket_is_idr(pkt, codec_id);
     } else {
         return ff_avpacket_is_key(pkt);
     }
@@ -30,6 +30,7 @@
 @interface IJKSDLAudioQueueController : NSObject
 
 - (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec;
+- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec lowLatency:(BOOL)lowLatency;
 
 - (void)play;
 - (void)pause;
@@ -38,7 +39,10 @@
 - (void)close;
 - (void)setPlaybackRate:(float)playbackRate;
 - (void)setPlaybackVolume:(float)playbackVolume;
+// queued buffers plus the session output latency and IO buffer duration
 - (double)get_latency_seconds;
+// of the hardware, the queue converts from spec.freq when it differs
+- (double)get_session_sample_rate;
 
 @property (nonatomic, readonly) SDL_AudioSpec spec;
     
@@ -26,22 +26,41 @@
 #import "IJKSDLAudioQueueController.h"
 #import "IJKSDLAudioKit.h"
 #import "ijksdl_log.h"
+#include "ijksdl_audio_tempo.h"
 
 #import <AVFoundation/AVFoundation.h>
 
 #define kIJKAudioQueueNumberBuffers (3)
+#define kIJKAudioQueueLowLatencyNumberBuffers (2)
+#define kIJKAudioLowLatencyIOBufferDuration (0.005)
 
 @implementation IJKSDLAudioQueueController {
     AudioQueueRef _audioQueueRef;
     AudioQueueBufferRef _audioQueueBufferRefArray[kIJKAudioQueueNumberBuffers];
+    int _numberOfBuffers;
     BOOL _isPaused;
     BOOL _isStopped;
 
+    BOOL _lowLatency;
+    volatile double _sessionLatency;
+    volatile double _sessionSampleRate;
+
     volatile BOOL _isAborted;
     NSLock *_lock;
+
+    // variable rate goes through our own time stretch, the queue always plays at 1.0
+    IJKAudioTempo *_tempo;
+    uint8_t *_tempoChunk;
+    volatile float _playbackRate;
+    volatile BOOL _tempoFlushRequest;
 }
 
 - (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec
+{
+    return [self initWithAudioSpec:aSpec lowLatency:NO];
+}
+
+- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec lowLatency:(BOOL)lowLatency
 {
     self = [super init];
     if (self) {
@@ -50,6 +69,8 @@
             return nil;
         }
         _spec = *aSpec;
+        _lowLatency = lowLatency;
+        _numberOfBuffers = lowLatency ? kIJKAudioQueueLowLatencyNumberBuffers : kIJKAudioQueueNumberBuffers;
 
         if (aSpec->format != AUDIO_S16SYS) {
             NSLog(@"aout_open_audio: unsupported format %d\n", (int)aSpec->format);
@@ -72,6 +93,13 @@
             return nil;
         }
 
+        if (_lowLatency) {
+            NSError *error = nil;
+            if (NO == [[AVAudioSession sharedInstance] setPreferredIOBufferDuration:kIJKAudioLowLatencyIOBufferDuration error:&error]) {
+                NSLog(@"AudioQueue: AVAudioSession.setPreferredIOBufferDuration failed: %@\n", error ? [error localizedDescription] : @"nil");
+            }
+        }
+
         /* Set the desired format */
         AudioQueueRef audioQueueRef;
         OSStatus status = AudioQueueNewOutput(&streamDescription,
@@ -87,12 +115,11 @@
             return nil;
         }
 
-        UInt32 propValue = 1;
-        AudioQueueSetProperty(audioQueueRef, kAudioQueueProperty_EnableTimePitch, &propValue, sizeof(propValue));
-        propValue = 1;
-        AudioQueueSetProperty(_audioQueueRef, kAudioQueueProperty_TimePitchBypass, &propValue, sizeof(propValue));
-        propValue = kAudioQueueTimePitchAlgorithm_Spectral;
-        AudioQueueSetProperty(_audioQueueRef, kAudioQueueProperty_TimePitchAlgorithm, &propValue, sizeof(propValue));
+        _playbackRate = 1.0f;
+        _tempo = ijk_audio_tempo_create(_spec.freq, _spec.channels);
+        _tempoChunk = malloc(_spec.size);
+        if (!_tempo || !_tempoChunk)
+            NSLog(@"AudioQueue: no time stretch, playback rate is ignored\n");
 
         status = AudioQueueStart(audioQueueRef, NULL);
         if (status != noErr) {
@@ -103,7 +130,7 @@
 
         _audioQueueRef = audioQueueRef;
 
-        for (int i = 0;i < kIJKAudioQueueNumberBuffers; i++)
+        for (int i = 0;i < _numberOfBuffers; i++)
         {
             AudioQueueAllocateBuffer(audioQueueRef, _spec.size, &_audioQueueBufferRefArray[i]);
             _audioQueueBufferRefArray[i]->mAudioDataByteSize = _spec.size;
@@ -122,10 +149,29 @@
         _isStopped = NO;
 
         _lock = [[NSLock alloc] init];
+
+        [self updateSessionLatency];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(audioSessionRouteChange:)
+                                                     name:AVAudioSessionRouteChangeNotification
+                                                   object:nil];
     }
     return self;
 }
 
+// sampled off the audio thread, get_latency_seconds is called for every callback
+- (void)updateSessionLatency
+{
+    AVAudioSession *session = [AVAudioSession sharedInstance];
+    _sessionLatency = session.outputLatency + session.IOBufferDuration;
+    _sessionSampleRate = session.sampleRate;
+}
+
+- (void)audioSessionRouteChange:(NSNotification *)notification
+{
+    [self updateSessionLatency];
+}
+
 - (void)dealloc
 {
     [self close];
@@ -149,6 +195,8 @@
         if (status != noErr)
             NSLog(@"AudioQueue: AudioQueueStart failed (%d)\n", (int)status);
     }
+
+    [self updateSessionLatency];
 }
 
 - (void)pause
@@ -176,6 +224,7 @@
         if (_isStopped)
             return;
 
+        _tempoFlushRequest = YES;
         AudioQueueFlush(_audioQueueRef);
     }
 }
@@ -199,21 +248,21 @@
 
 - (void)close
 {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
     [self stop];
     _audioQueueRef = nil;
+
+    // the queue is disposed synchronously, no callback is running any more
+    ijk_audio_tempo_free(&_tempo);
+    free(_tempoChunk);
+    _tempoChunk = NULL;
 }
 
 - (void)setPlaybackRate:(float)playbackRate
 {
-    if (fabsf(playbackRate - 1.0f) <= 0.000001) {
-        UInt32 propValue = 1;
-        AudioQueueSetProperty(_audioQueueRef, kAudioQueueProperty_TimePitchBypass, &propValue, sizeof(propValue));
-        AudioQueueSetParameter(_audioQueueRef, kAudioQueueParam_PlayRate, 1.0f);
-    } else {
-        UInt32 propValue = 0;
-        AudioQueueSetProperty(_audioQueueRef, kAudioQueueProperty_TimePitchBypass, &propValue, sizeof(propValue));
-        AudioQueueSetParameter(_audioQueueRef, kAudioQueueParam_PlayRate, playbackRate);
-    }
+    // picked up by the next output callback
+    _playbackRate = playbackRate;
 }
 
 - (void)setPlaybackVolume:(float)playbackVolume
@@ -228,7 +277,40 @@
 
 - (double)get_latency_seconds
 {
-    return ((double)(kIJKAudioQueueNumberBuffers)) * _spec.samples / _spec.freq;
+    // queued output plays rate times faster than the input it was made from
+    double latency = (((double)(_numberOfBuffers)) * _spec.samples / _spec.freq + _sessionLatency) * _playbackRate;
+    IJKAudioTempo *tempo = _tempo;
+    if (tempo)
+        latency += ijk_audio_tempo_get_delay(tempo);
+    return latency;
+}
+
+- (double)get_session_sample_rate
+{
+    return _sessionSampleRate;
+}
+
+static void IJKSDLAudioQueueFillStretched(IJKSDLAudioQueueController *aqController, uint8_t *data, UInt32 size)
+{
+    IJKAudioTempo *tempo = aqController->_tempo;
+    int channels = aqController->_spec.channels;
+    int frames   = size / (channels * sizeof(int16_t));
+    int done     = 0;
+
+    ijk_audio_tempo_set_rate(tempo, aqController->_playbackRate);
+    while (done < frames) {
+        done += ijk_audio_tempo_receive(tempo, (int16_t *)data + done * channels, frames - done);
+        if (done >= frames)
+            break;
+
+        (*aqController->_spec.callback)(aqController->_spec.userdata, aqController->_tempoChunk, aqController->_spec.size);
+        if (ijk_audio_tempo_put(tempo, (int16_t *)aqController->_tempoChunk,
+                                aqController->_spec.size / (channels * sizeof(int16_t))) < 0) {
+            memset(data + done * channels * sizeof(int16_t), aqController->_spec.silence,
+                   (frames - done) * channels * sizeof(int16_t));
+            break;
+        }
+    }
 }
 
 static void IJKSDLAudioQueueOuptutCallback(void * inUserData, AudioQueueRef inAQ, AudioQueueBufferRef inBuffer) {
@@ -239,6 +321,13 @@ static void IJKSDLAudioQueueOuptutCallback(void * inUserData, AudioQueueRef inAQ
             // do nothing;
         } else if (aqController->_isPaused || aqController->_isStopped) {
             memset(inBuffer->mAudioData, aqController.spec.silence, inBuffer->mAudioDataByteSize);
+        } else if (aqController->_tempo && aqController->_tempoChunk &&
+                   (aqController->_playbackRate != 1.0f || !ijk_audio_tempo_is_idle(aqController->_tempo))) {
+            if (aqController->_tempoFlushRequest) {
+                aqController->_tempoFlushRequest = NO;
+                ijk_audio_tempo_flush(aqController->_tempo);
+            }
+            IJKSDLAudioQueueFillStretched(aqController, inBuffer->mAudioData, inBuffer->mAudioDataByteSize);
         } else {
             (*aqController.spec.callback)(aqController.spec.userdata, inBuffer->mAudioData, inBuffer->mAudioDataByteSize);
         }
@@ -26,16 +26,38 @@
 #import <Foundation/Foundation.h>
 
 #include "ijksdl/ijksdl_aout.h"
+#include "ijksdl_audio_analysis.h"
+#include "ijksdl_sync_probe.h"
 
 @interface IJKSDLAudioUnitController : NSObject
 
 - (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec;
+// shared: on a bus of the unit of the process, mixed with the other shared
+// controllers by one IO thread; spec.freq is the rate of that unit, set by
+// the first one opened. A unit of its own when the buses are all taken
+- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec shared:(BOOL)shared;
 
 - (void)play;
 - (void)pause;
 - (void)flush;
 - (void)stop;
 - (void)close;
+- (void)setPlaybackRate:(float)playbackRate;
+// ramped over a few milliseconds by the render thread
+- (void)setPlaybackVolume:(float)playbackVolume;
+// spectrum and loudness measured by the render thread, see
+// ijksdl_audio_analysis.h; the normalization gain to loudnessTarget, in
+// LUFS or 0 for none, is applied with the volume while enabled
+- (void)setAnalysisEnabled:(BOOL)enabled loudnessTarget:(float)loudnessTarget;
+- (BOOL)getAnalysisResult:(IJKAudioAnalysisResult *)result;
+// given the blocks rendered with the time they are heard, mHostTime of the
+// cycle plus the output latency of the route; once, a reference is kept
+- (void)setSyncProbe:(IJKSyncProbe *)probe;
+
+// queued PCM plus the IO buffer
+- (double)get_latency_seconds;
+// of the hardware, the unit converts from spec.freq when it differs
+- (double)get_session_sample_rate;
 
 @property (nonatomic, readonly) SDL_AudioSpec spec;
 
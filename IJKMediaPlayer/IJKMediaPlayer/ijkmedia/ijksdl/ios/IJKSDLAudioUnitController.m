@@ -26,118 +26,1069 @@
 #import "IJKSDLAudioUnitController.h"
 #import "IJKSDLAudioKit.h"
 #include "ijksdl/ijksdl_log.h"
+#include "ijksdl/ijksdl_thread.h"
+#include "ijksdl_audio_tempo.h"
+#include "ijksdl_audio_mix.h"
+#include "ijksdl_audio_analysis.h"
+#include "ijksdl_sync_probe.h"
 
 #import <AVFoundation/AVFoundation.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
 
-@implementation IJKSDLAudioUnitController {
-    AudioUnit _auUnit;
-    BOOL _isPaused;
+// PCM is rendered by spec.callback on a feeder thread into a single producer,
+// single consumer ring ahead of time; the IO thread only copies out of it.
+#define IJK_AU_RING_CHUNKS          4
+#define IJK_AU_FEED_WAIT_NSEC       (20 * 1000 * 1000)
+#define IJK_AU_POOL_MAX             2
+// the unit takes float stereo, mixed from the ring in blocks of at most this
+#define IJK_AU_MIX_FRAMES           512
+#define IJK_AU_GAIN_RAMP_MS         20
+// below this gain a block is mixed again at unity for the analysis
+#define IJK_AU_ANALYSIS_MIN_GAIN    0.001f
+// an output time anchor older than this is not trusted, e.g. after a pause
+#define IJK_AU_ANCHOR_MAX_AGE       0.25
+// the renders a unit mixes at most, e.g. a preview and a main player, or
+// the two items of a crossfade
+#define IJK_AU_MIX_BUSES            8
+#define IJK_AU_CYCLE_WAIT_USEC      500
+
+typedef struct IJKSDLAudioUnitRender {
+    SDL_AudioSpec   spec;
+
+    uint8_t        *ring;
+    uint32_t        ring_size;      // power of two
+    atomic_uint     ring_read;      // advanced by the IO thread only
+    atomic_uint     ring_write;     // advanced by the feeder thread only
+
+    atomic_bool     paused;
+    atomic_bool     abort_request;
+    atomic_bool     flush_request;
+    atomic_uint     flush_serial;
+    atomic_uint     underruns;
+
+    semaphore_t     feed_sem;       // signalled when there is room to fill
+    uint8_t        *chunk;
+
+    // variable rate is stretched on the feeder thread, the unit plays at 1.0
+    _Atomic(float)  playback_rate;
+    IJKAudioTempo  *tempo;
+    uint8_t        *tempo_chunk;
+    unsigned        tempo_serial;
+    SDL_Thread      _feed_thread;
+    SDL_Thread     *feed_thread;
+
+    // volume and down-mix are applied by the IO thread, a change is heard at once
+    _Atomic(float)  volume;
+    IJKAudioGain    gain;           // IO thread only
+    int16_t        *mix_chunk;
+
+    // spectrum and loudness of what the IO thread renders, created off it
+    // the first time it is enabled and freed with the render
+    IJKAudioAnalysis *analysis;
+    atomic_bool     analysis_enabled;
+    _Atomic(float)  loudness_target;    // LUFS, 0 for none
+    float          *analysis_chunk;
+
+    // the ring position the IO thread read at its last cycle, and the
+    // mHostTime the unit gave for that cycle's output; under anchor_seq
+    atomic_uint     anchor_seq;     // odd while the IO thread writes
+    _Atomic(uint64_t) anchor_host;
+    atomic_uint     anchor_read;
+    atomic_uint     anchor_serial;  // flush_serial then
+    double          seconds_per_host_tick;
+
+    // given what the IO thread renders with the time it is heard, set once
+    // and unreferenced with the render
+    _Atomic(IJKSyncProbe *) sync_probe;
+    _Atomic(double) output_latency; // of the route, past the unit
+} IJKSDLAudioUnitRender;
+
+static inline uint32_t render_ring_fill(IJKSDLAudioUnitRender *render)
+{
+    return atomic_load_explicit(&render->ring_write, memory_order_acquire) -
+           atomic_load_explicit(&render->ring_read, memory_order_acquire);
 }
 
-- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec
+// fills chunk with spec.size bytes, through the time stretch when not at 1.0
+static void render_fill_chunk(IJKSDLAudioUnitRender *render, unsigned serial)
 {
-    self = [super init];
-    if (self) {
-        if (aSpec == NULL) {
-            self = nil;
-            return nil;
+    IJKAudioTempo *tempo = render->tempo;
+    float rate = atomic_load_explicit(&render->playback_rate, memory_order_relaxed);
+
+    if (tempo && serial != render->tempo_serial) {
+        ijk_audio_tempo_flush(tempo);
+        render->tempo_serial = serial;
+    }
+
+    if (!tempo || (rate == 1.0f && ijk_audio_tempo_is_idle(tempo))) {
+        render->spec.callback(render->spec.userdata, render->chunk, (int)render->spec.size);
+        return;
+    }
+
+    int channels = render->spec.channels;
+    int frames   = render->spec.size / (channels * sizeof(int16_t));
+    int done     = 0;
+
+    ijk_audio_tempo_set_rate(tempo, rate);
+    while (done < frames) {
+        done += ijk_audio_tempo_receive(tempo, (int16_t *)render->chunk + done * channels, frames - done);
+        if (done >= frames)
+            break;
+
+        render->spec.callback(render->spec.userdata, render->tempo_chunk, (int)render->spec.size);
+        if (ijk_audio_tempo_put(tempo, (int16_t *)render->tempo_chunk, frames) < 0) {
+            memset(render->chunk + done * channels * sizeof(int16_t), render->spec.silence,
+                   (frames - done) * channels * sizeof(int16_t));
+            break;
         }
-        _spec = *aSpec;
+    }
+}
 
-        if (aSpec->format != AUDIO_S16SYS) {
-            NSLog(@"aout_open_audio: unsupported format %d\n", (int)aSpec->format);
-            return nil;
+static int render_feed_thread(void *arg)
+{
+    IJKSDLAudioUnitRender *render = arg;
+    uint32_t chunk_size = render->spec.size;
+    mach_timespec_t timeout = {0, IJK_AU_FEED_WAIT_NSEC};
+
+    while (!atomic_load(&render->abort_request)) {
+        uint32_t write = atomic_load_explicit(&render->ring_write, memory_order_relaxed);
+        uint32_t read  = atomic_load_explicit(&render->ring_read, memory_order_acquire);
+
+        if (atomic_load(&render->paused) || render->ring_size - (write - read) < chunk_size) {
+            semaphore_timedwait(render->feed_sem, timeout);
+            continue;
         }
 
-        if (aSpec->channels > 6) {
-            NSLog(@"aout_open_audio: unsupported channels %d\n", (int)aSpec->channels);
-            return nil;
+        unsigned serial = atomic_load(&render->flush_serial);
+        render_fill_chunk(render, serial);
+        if (serial != atomic_load(&render->flush_serial))
+            continue;
+
+        uint32_t offset = write & (render->ring_size - 1);
+        uint32_t first  = MIN(chunk_size, render->ring_size - offset);
+        memcpy(render->ring + offset, render->chunk, first);
+        memcpy(render->ring, render->chunk + first, chunk_size - first);
+        atomic_store_explicit(&render->ring_write, write + chunk_size, memory_order_release);
+    }
+
+    return 0;
+}
+
+// IO thread, before it reads the cycle's output out of the ring
+static void render_set_anchor(IJKSDLAudioUnitRender *render, const AudioTimeStamp *timestamp, unsigned serial)
+{
+    if (!timestamp || !(timestamp->mFlags & kAudioTimeStampHostTimeValid))
+        return;
+
+    unsigned seq = atomic_load_explicit(&render->anchor_seq, memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&render->anchor_host, timestamp->mHostTime, memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_read,
+                          atomic_load_explicit(&render->ring_read, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_serial, serial, memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_seq, seq + 2, memory_order_release);
+}
+
+// With the unit stopped: the anchor was taken on the former route, the
+// latency of the next one may differ.
+static void render_clear_anchor(IJKSDLAudioUnitRender *render)
+{
+    unsigned seq = atomic_load_explicit(&render->anchor_seq, memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&render->anchor_host, 0, memory_order_relaxed);
+    atomic_store_explicit(&render->anchor_seq, seq + 2, memory_order_release);
+}
+
+// Seconds from now until the byte written next to the ring reaches the
+// unit's output, from the host time of the last IO cycle; false without a
+// recent anchor of the current flush serial.
+static bool render_output_delay(IJKSDLAudioUnitRender *render, double *delay)
+{
+    uint64_t host;
+    uint32_t read;
+    unsigned serial;
+    unsigned seq;
+
+    do {
+        seq    = atomic_load_explicit(&render->anchor_seq, memory_order_acquire);
+        host   = atomic_load_explicit(&render->anchor_host, memory_order_relaxed);
+        read   = atomic_load_explicit(&render->anchor_read, memory_order_relaxed);
+        serial = atomic_load_explicit(&render->anchor_serial, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&render->anchor_seq, memory_order_relaxed));
+
+    if (!host || serial != atomic_load(&render->flush_serial))
+        return false;
+
+    // the host time of an output cycle is usually ahead of now
+    double since = (double)(int64_t)(mach_absolute_time() - host) * render->seconds_per_host_tick;
+    if (since > IJK_AU_ANCHOR_MAX_AGE)
+        return false;
+
+    double bytes_per_sec = (double)render->spec.freq * render->spec.channels * 2;
+    uint32_t write = atomic_load_explicit(&render->ring_write, memory_order_acquire);
+    *delay = MAX(0, (uint32_t)(write - read) / bytes_per_sec - since);
+    return true;
+}
+
+static void render_read(IJKSDLAudioUnitRender *render, uint8_t *data, uint32_t size)
+{
+    uint32_t read  = atomic_load_explicit(&render->ring_read, memory_order_relaxed);
+    uint32_t write = atomic_load_explicit(&render->ring_write, memory_order_acquire);
+    uint32_t count = MIN(write - read, size);
+
+    uint32_t offset = read & (render->ring_size - 1);
+    uint32_t first  = MIN(count, render->ring_size - offset);
+    memcpy(data, render->ring + offset, first);
+    memcpy(data + first, render->ring, count - first);
+
+    if (count < size) {
+        memset(data + count, render->spec.silence, size - count);
+        atomic_fetch_add_explicit(&render->underruns, 1, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&render->ring_read, read + count, memory_order_release);
+}
+
+static IJKSDLAudioUnitRender *render_create(const SDL_AudioSpec *spec)
+{
+    IJKSDLAudioUnitRender *render = calloc(1, sizeof(IJKSDLAudioUnitRender));
+    if (!render)
+        return NULL;
+
+    render->spec = *spec;
+    render->ring_size = 1;
+    while (render->ring_size < spec->size * IJK_AU_RING_CHUNKS)
+        render->ring_size <<= 1;
+
+    render->ring  = malloc(render->ring_size);
+    render->chunk = malloc(spec->size);
+    render->tempo = ijk_audio_tempo_create(spec->freq, spec->channels);
+    render->tempo_chunk = malloc(spec->size);
+    render->mix_chunk = malloc(IJK_AU_MIX_FRAMES * spec->channels * sizeof(int16_t));
+    if (!render->ring || !render->chunk || !render->tempo || !render->tempo_chunk || !render->mix_chunk ||
+        semaphore_create(mach_task_self(), &render->feed_sem, SYNC_POLICY_FIFO, 0) != KERN_SUCCESS) {
+        free(render->ring);
+        free(render->chunk);
+        free(render->tempo_chunk);
+        free(render->mix_chunk);
+        ijk_audio_tempo_free(&render->tempo);
+        free(render);
+        return NULL;
+    }
+
+    atomic_init(&render->ring_read, 0);
+    atomic_init(&render->ring_write, 0);
+    atomic_init(&render->paused, true);
+    atomic_init(&render->abort_request, false);
+    atomic_init(&render->flush_request, false);
+    atomic_init(&render->flush_serial, 0);
+    atomic_init(&render->underruns, 0);
+    atomic_init(&render->playback_rate, 1.0f);
+    atomic_init(&render->volume, 1.0f);
+    atomic_init(&render->analysis_enabled, false);
+    atomic_init(&render->loudness_target, 0.0f);
+    atomic_init(&render->anchor_seq, 0);
+    atomic_init(&render->anchor_host, 0);
+    atomic_init(&render->anchor_read, 0);
+    atomic_init(&render->anchor_serial, 0);
+    atomic_init(&render->sync_probe, NULL);
+    atomic_init(&render->output_latency, 0.0);
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    render->seconds_per_host_tick = (double)timebase.numer / timebase.denom / 1e9;
+
+    ijk_audio_gain_init(&render->gain, 1.0f, spec->freq * IJK_AU_GAIN_RAMP_MS / 1000);
+
+    render->feed_thread = SDL_CreateThreadEx(&render->_feed_thread, render_feed_thread, render, "ff_aout_feed");
+    if (!render->feed_thread) {
+        semaphore_destroy(mach_task_self(), render->feed_sem);
+        free(render->ring);
+        free(render->chunk);
+        free(render->tempo_chunk);
+        free(render->mix_chunk);
+        ijk_audio_tempo_free(&render->tempo);
+        free(render);
+        return NULL;
+    }
+
+    return render;
+}
+
+static void render_free(IJKSDLAudioUnitRender *render)
+{
+    if (!render)
+        return;
+
+    atomic_store(&render->abort_request, true);
+    semaphore_signal(render->feed_sem);
+    SDL_WaitThread(render->feed_thread, NULL);
+
+    ALOGI("AudioUnit: %u underruns\n", atomic_load(&render->underruns));
+
+    semaphore_destroy(mach_task_self(), render->feed_sem);
+    free(render->ring);
+    free(render->chunk);
+    free(render->tempo_chunk);
+    free(render->mix_chunk);
+    ijk_audio_tempo_free(&render->tempo);
+    ijk_audio_analysis_free(&render->analysis);
+    free(render->analysis_chunk);
+    IJKSyncProbe *sync_probe = atomic_load(&render->sync_probe);
+    ijk_sync_probe_unref(&sync_probe);
+    free(render);
+}
+
+// IO thread: the analysis takes the block without the gain it was rendered
+// with, g0 to gain.current; a block rendered about silent is mixed again
+static void render_analyse(IJKSDLAudioUnitRender *render, const float *data, int frames,
+                           float g0, float target)
+{
+    float gain = 0.5f * (g0 + render->gain.current);
+
+    if (gain >= IJK_AU_ANALYSIS_MIN_GAIN) {
+        ijk_audio_analysis_process(render->analysis, data, frames, 1.0f / gain, target);
+        return;
+    }
+
+    IJKAudioGain unity;
+    ijk_audio_gain_init(&unity, 1.0f, 0);
+    ijk_audio_mix_s16_to_f32_stereo(render->analysis_chunk, render->mix_chunk, render->spec.channels,
+                                    frames, &unity);
+    ijk_audio_analysis_process(render->analysis, render->analysis_chunk, frames, 1.0f, target);
+}
+
+// IO thread: the cycle's output of the render, mixed into ioData, or copied
+// there if first; false while it is paused
+static bool render_mix(IJKSDLAudioUnitRender *render, float *chunk, const AudioTimeStamp *inTimeStamp,
+                       AudioBufferList *ioData, bool first)
+{
+    unsigned serial = atomic_load(&render->flush_serial);
+
+    if (atomic_exchange_explicit(&render->flush_request, false, memory_order_acquire)) {
+        atomic_store_explicit(&render->ring_read,
+                              atomic_load_explicit(&render->ring_write, memory_order_acquire),
+                              memory_order_release);
+    }
+
+    if (atomic_load_explicit(&render->paused, memory_order_relaxed))
+        return false;
+
+    render_set_anchor(render, inTimeStamp, serial);
+
+    int   channels = render->spec.channels;
+    bool  analyse  = atomic_load_explicit(&render->analysis_enabled, memory_order_acquire);
+    float target   = atomic_load_explicit(&render->loudness_target, memory_order_relaxed);
+    float volume   = atomic_load_explicit(&render->volume, memory_order_relaxed);
+    IJKSyncProbe *sync_probe = atomic_load_explicit(&render->sync_probe, memory_order_acquire);
+    double sync_time = 0;
+    if (sync_probe && inTimeStamp && (inTimeStamp->mFlags & kAudioTimeStampHostTimeValid))
+        sync_time = inTimeStamp->mHostTime * render->seconds_per_host_tick +
+                    atomic_load_explicit(&render->output_latency, memory_order_relaxed);
+    else
+        sync_probe = NULL;
+
+    // the normalization gain rides on the volume, applied by the same pass
+    render->gain.target = analyse ? volume * ijk_audio_analysis_get_gain(render->analysis) : volume;
+    for (UInt32 i = 0; i < ioData->mNumberBuffers; i++) {
+        AudioBuffer *ioBuffer = &ioData->mBuffers[i];
+        float *data   = ioBuffer->mData;
+        int    frames = ioBuffer->mDataByteSize / (2 * sizeof(float));
+
+        // conversion, down-mix and gain in one pass over what the ring holds;
+        // the analysis and the probe take the render alone, before the mix
+        while (frames > 0) {
+            int    n   = MIN(frames, IJK_AU_MIX_FRAMES);
+            float  g0  = render->gain.current;
+            float *out = first ? data : chunk;
+            render_read(render, (uint8_t *)render->mix_chunk, n * channels * sizeof(int16_t));
+            ijk_audio_mix_s16_to_f32_stereo(out, render->mix_chunk, channels, n, &render->gain);
+            if (analyse)
+                render_analyse(render, out, n, g0, target);
+            if (sync_probe) {
+                ijk_sync_probe_audio(sync_probe, out, n, render->spec.freq, sync_time);
+                sync_time += (double)n / render->spec.freq;
+            }
+            if (!first)
+                ijk_audio_mix_add_f32(data, chunk, n * 2);
+            data   += n * 2;
+            frames -= n;
+        }
+    }
+    semaphore_signal(render->feed_sem);
+
+    return true;
+}
+
+// The renders a unit plays, each on a bus of its own with its volume, rate
+// and ring, mixed by the IO thread of the unit. A bus is set and cleared
+// under the lock of the engine, the IO thread reads them without one.
+typedef struct IJKSDLAudioUnitMixer {
+    _Atomic(IJKSDLAudioUnitRender *) buses[IJK_AU_MIX_BUSES];
+    atomic_uint     cycle_seq;      // odd while the IO thread mixes
+    float          *chunk;          // IO thread only
+} IJKSDLAudioUnitMixer;
+
+static IJKSDLAudioUnitMixer *mixer_create(void)
+{
+    IJKSDLAudioUnitMixer *mixer = calloc(1, sizeof(IJKSDLAudioUnitMixer));
+    if (!mixer)
+        return NULL;
+
+    mixer->chunk = malloc(IJK_AU_MIX_FRAMES * 2 * sizeof(float));
+    if (!mixer->chunk) {
+        free(mixer);
+        return NULL;
+    }
+
+    for (int i = 0; i < IJK_AU_MIX_BUSES; i++)
+        atomic_init(&mixer->buses[i], NULL);
+    atomic_init(&mixer->cycle_seq, 0);
+    return mixer;
+}
+
+static void mixer_free(IJKSDLAudioUnitMixer **pmixer)
+{
+    if (!pmixer || !*pmixer)
+        return;
+
+    free((*pmixer)->chunk);
+    free(*pmixer);
+    *pmixer = NULL;
+}
+
+static bool mixer_add(IJKSDLAudioUnitMixer *mixer, IJKSDLAudioUnitRender *render)
+{
+    for (int i = 0; i < IJK_AU_MIX_BUSES; i++) {
+        if (!atomic_load(&mixer->buses[i])) {
+            atomic_store(&mixer->buses[i], render);
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns once the IO thread is out of the render, which may be freed then
+static bool mixer_remove(IJKSDLAudioUnitMixer *mixer, IJKSDLAudioUnitRender *render)
+{
+    bool removed = false;
+
+    for (int i = 0; i < IJK_AU_MIX_BUSES; i++) {
+        if (atomic_load(&mixer->buses[i]) == render) {
+            atomic_store(&mixer->buses[i], NULL);
+            removed = true;
         }
+    }
+
+    unsigned seq = atomic_load(&mixer->cycle_seq);
+    while ((seq & 1) && atomic_load(&mixer->cycle_seq) == seq)
+        usleep(IJK_AU_CYCLE_WAIT_USEC);
+    return removed;
+}
+
+// Creating and initializing a RemoteIO unit costs milliseconds, a player
+// recycled by a feed would pay it for every item: closed units are kept
+// initialized, without a render callback, for the next one of the same rate.
+static pthread_mutex_t g_au_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AudioUnit       g_au_pool[IJK_AU_POOL_MAX];
+static Float64         g_au_pool_rate[IJK_AU_POOL_MAX];
+static int             g_au_pool_count = 0;
+
+static AudioUnit au_pool_take(Float64 sample_rate)
+{
+    AudioUnit unit = NULL;
+
+    pthread_mutex_lock(&g_au_pool_mutex);
+    for (int i = g_au_pool_count - 1; i >= 0; i--) {
+        if (g_au_pool_rate[i] != sample_rate)
+            continue;
+        unit = g_au_pool[i];
+        g_au_pool_count--;
+        g_au_pool[i]      = g_au_pool[g_au_pool_count];
+        g_au_pool_rate[i] = g_au_pool_rate[g_au_pool_count];
+        break;
+    }
+    pthread_mutex_unlock(&g_au_pool_mutex);
+    return unit;
+}
+
+static bool au_pool_give(AudioUnit unit, Float64 sample_rate)
+{
+    bool taken = false;
+
+    pthread_mutex_lock(&g_au_pool_mutex);
+    if (g_au_pool_count < IJK_AU_POOL_MAX) {
+        g_au_pool[g_au_pool_count]      = unit;
+        g_au_pool_rate[g_au_pool_count] = sample_rate;
+        g_au_pool_count++;
+        taken = true;
+    }
+    pthread_mutex_unlock(&g_au_pool_mutex);
+    return taken;
+}
+
+// after a reset of the media services, the units pooled are of the former server
+static void au_pool_drain(void)
+{
+    pthread_mutex_lock(&g_au_pool_mutex);
+    for (int i = 0; i < g_au_pool_count; i++)
+        AudioComponentInstanceDispose(g_au_pool[i]);
+    g_au_pool_count = 0;
+    pthread_mutex_unlock(&g_au_pool_mutex);
+}
+
+static OSStatus RenderCallback(void                        *inRefCon,
+                               AudioUnitRenderActionFlags  *ioActionFlags,
+                               const AudioTimeStamp        *inTimeStamp,
+                               UInt32                      inBusNumber,
+                               UInt32                      inNumberFrames,
+                               AudioBufferList             *ioData);
+
+// the core delivers S16 in its own layout, the unit takes float stereo
+static void au_stream_description(const SDL_AudioSpec *spec, AudioStreamBasicDescription *desc)
+{
+    IJKSDLGetAudioStreamBasicDescriptionFromSpec(spec, desc);
+    desc->mFormatFlags      = kAudioFormatFlagsNativeFloatPacked;
+    desc->mChannelsPerFrame = 2;
+    desc->mBitsPerChannel   = 8 * sizeof(float);
+    desc->mBytesPerFrame    = 2 * sizeof(float);
+    desc->mBytesPerPacket   = desc->mBytesPerFrame;
+}
+
+// a RemoteIO unit taking desc, not initialized yet
+static AudioUnit au_unit_create(const SDL_AudioSpec *spec, AudioStreamBasicDescription *desc)
+{
+    AudioComponentDescription componentDesc;
+    IJKSDLGetAudioComponentDescriptionFromSpec(spec, &componentDesc);
+
+    AudioComponent auComponent = AudioComponentFindNext(NULL, &componentDesc);
+    if (auComponent == NULL) {
+        ALOGE("AudioUnit: AudioComponentFindNext failed");
+        return NULL;
+    }
+
+    AudioUnit auUnit;
+    OSStatus status = AudioComponentInstanceNew(auComponent, &auUnit);
+    if (status != noErr) {
+        ALOGE("AudioUnit: AudioComponentInstanceNew failed");
+        return NULL;
+    }
+
+    UInt32 flag = 1;
+    status = AudioUnitSetProperty(auUnit,
+                                  kAudioOutputUnitProperty_EnableIO,
+                                  kAudioUnitScope_Output,
+                                  0,
+                                  &flag,
+                                  sizeof(flag));
+    if (status != noErr) {
+        ALOGE("AudioUnit: failed to set IO mode (%d)", (int)status);
+    }
+
+    /* Set the desired format */
+    UInt32 i_param_size = sizeof(*desc);
+    status = AudioUnitSetProperty(auUnit,
+                                  kAudioUnitProperty_StreamFormat,
+                                  kAudioUnitScope_Input,
+                                  0,
+                                  desc,
+                                  i_param_size);
+    if (status != noErr) {
+        ALOGE("AudioUnit: failed to set stream format (%d)", (int)status);
+        AudioComponentInstanceDispose(auUnit);
+        return NULL;
+    }
+
+    /* Retrieve actual format */
+    status = AudioUnitGetProperty(auUnit,
+                                  kAudioUnitProperty_StreamFormat,
+                                  kAudioUnitScope_Input,
+                                  0,
+                                  desc,
+                                  &i_param_size);
+    if (status != noErr) {
+        ALOGE("AudioUnit: failed to verify stream format (%d)\n", (int)status);
+    }
+    return auUnit;
+}
+
+// NULL detaches the mixer, before the unit is pooled
+static OSStatus au_unit_set_mixer(AudioUnit auUnit, IJKSDLAudioUnitMixer *mixer)
+{
+    AURenderCallbackStruct callback;
+    memset(&callback, 0, sizeof(AURenderCallbackStruct));
+    if (mixer) {
+        callback.inputProc = (AURenderCallback) RenderCallback;
+        callback.inputProcRefCon = mixer;
+    }
+    return AudioUnitSetProperty(auUnit,
+                                kAudioUnitProperty_SetRenderCallback,
+                                kAudioUnitScope_Input,
+                                0, &callback, sizeof(callback));
+}
 
-        AudioComponentDescription desc;
-        IJKSDLGetAudioComponentDescriptionFromSpec(&_spec, &desc);
+// A RemoteIO unit and the mixer of its buses. A controller of its own has
+// an engine with one bus; the shared engine has one per controller opened
+// on it, players heard at once run a single IO thread and a crossfade
+// between them is two volumes of the same cycle.
+@interface IJKSDLAudioUnitEngine : NSObject
 
-        AudioComponent auComponent = AudioComponentFindNext(NULL, &desc);
-        if (auComponent == NULL) {
-            ALOGE("AudioUnit: AudioComponentFindNext failed");
+// at the rate of spec, or the one of the engine the first controller made
++ (IJKSDLAudioUnitEngine *)sharedEngineWithSpec:(const SDL_AudioSpec *)spec;
+
+- (id)initWithSpec:(const SDL_AudioSpec *)spec;
+
+// NO when the buses are taken, or the unit closed by the last one removed
+- (BOOL)addRender:(IJKSDLAudioUnitRender *)render;
+- (void)removeRender:(IJKSDLAudioUnitRender *)render;
+// the unit runs while a bus plays
+- (void)playRender:(IJKSDLAudioUnitRender *)render;
+- (void)pauseRender:(IJKSDLAudioUnitRender *)render;
+// the IO buffers of the unit, when no other bus plays through them
+- (void)resetForRender:(IJKSDLAudioUnitRender *)render;
+
+@property (nonatomic, readonly) Float64 sampleRate;
+
+// sampled off the feeder thread, get_latency_seconds is called for every callback
+@property (nonatomic, readonly) double sessionIOBufferDuration;
+@property (nonatomic, readonly) double sessionOutputLatency;
+@property (nonatomic, readonly) double sessionSampleRate;
+
+@end
+
+static pthread_mutex_t        g_shared_engine_mutex = PTHREAD_MUTEX_INITIALIZER;
+static IJKSDLAudioUnitEngine *g_shared_engine;
+
+@implementation IJKSDLAudioUnitEngine {
+    SDL_AudioSpec _spec;
+    AudioUnit     _auUnit;
+    IJKSDLAudioUnitMixer *_mixer;
+    BOOL          _shared;
+    int           _busCount;
+    int           _playingCount;    // buses not paused
+
+    // route changes, interruptions and resets reconfigure the unit in place,
+    // from the threads of their notifications, against play and pause
+    NSLock       *_lock;
+    BOOL          _reconfigureOnPlay;
+    BOOL          _unitUninitialized;   // a reconfiguration failed
+}
+
++ (IJKSDLAudioUnitEngine *)sharedEngineWithSpec:(const SDL_AudioSpec *)spec
+{
+    pthread_mutex_lock(&g_shared_engine_mutex);
+    if (!g_shared_engine) {
+        g_shared_engine = [[IJKSDLAudioUnitEngine alloc] initWithSpec:spec];
+        if (g_shared_engine)
+            g_shared_engine->_shared = YES;
+    }
+    IJKSDLAudioUnitEngine *engine = g_shared_engine;
+    pthread_mutex_unlock(&g_shared_engine_mutex);
+    return engine;
+}
+
+- (id)initWithSpec:(const SDL_AudioSpec *)spec
+{
+    self = [super init];
+    if (self) {
+        _spec = *spec;
+
+        AudioStreamBasicDescription streamDescription;
+        au_stream_description(&_spec, &streamDescription);
+        _sampleRate = streamDescription.mSampleRate;
+
+        _mixer = mixer_create();
+        if (!_mixer) {
+            ALOGE("AudioUnit: failed to create the mixer\n");
             self = nil;
             return nil;
         }
 
-        AudioUnit auUnit;
-        OSStatus status = AudioComponentInstanceNew(auComponent, &auUnit);
+        OSStatus status;
+        AudioUnit auUnit = au_pool_take(_sampleRate);
+        BOOL reused = auUnit != NULL;
+        if (!reused) {
+            auUnit = au_unit_create(&_spec, &streamDescription);
+            if (!auUnit) {
+                self = nil;
+                return nil;
+            }
+        }
+
+        status = au_unit_set_mixer(auUnit, _mixer);
         if (status != noErr) {
-            ALOGE("AudioUnit: AudioComponentInstanceNew failed");
+            ALOGE("AudioUnit: render callback setup failed (%d)\n", (int)status);
+            AudioComponentInstanceDispose(auUnit);
             self = nil;
             return nil;
         }
 
-        UInt32 flag = 1;
-        status = AudioUnitSetProperty(auUnit,
-                                      kAudioOutputUnitProperty_EnableIO,
-                                      kAudioUnitScope_Output,
-                                      0,
-                                      &flag,
-                                      sizeof(flag));
-        if (status != noErr) {
-            ALOGE("AudioUnit: failed to set IO mode (%d)", (int)status);
+        /* AU initiliaze, a pooled unit still is */
+        if (!reused) {
+            status = AudioUnitInitialize(auUnit);
+            if (status != noErr) {
+                ALOGE("AudioUnit: AudioUnitInitialize failed (%d)\n", (int)status);
+                AudioComponentInstanceDispose(auUnit);
+                self = nil;
+                return nil;
+            }
         }
 
-        /* Get the current format */
-        _spec.format = AUDIO_S16SYS;
-        _spec.channels = 2;
+        _auUnit = auUnit;
+        _lock = [[NSLock alloc] init];
+
+        [self updateSessionLatency];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(audioSessionRouteChange:)
+                                                     name:AVAudioSessionRouteChangeNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(audioSessionInterruption:)
+                                                     name:AVAudioSessionInterruptionNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(audioSessionMediaServicesReset:)
+                                                     name:AVAudioSessionMediaServicesWereResetNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self closeUnit];
+    mixer_free(&_mixer);
+}
+
+- (void)updateSessionLatency
+{
+    AVAudioSession *session = [AVAudioSession sharedInstance];
+    _sessionIOBufferDuration = session.IOBufferDuration;
+    _sessionOutputLatency    = session.outputLatency;
+    _sessionSampleRate       = session.sampleRate;
+    for (int i = 0; _mixer && i < IJK_AU_MIX_BUSES; i++) {
+        IJKSDLAudioUnitRender *render = atomic_load(&_mixer->buses[i]);
+        if (render)
+            atomic_store(&render->output_latency, _sessionOutputLatency);
+    }
+}
+
+// the unit stopped, the anchors of every bus were taken on the former route
+- (void)clearAnchors
+{
+    for (int i = 0; i < IJK_AU_MIX_BUSES; i++) {
+        IJKSDLAudioUnitRender *render = atomic_load(&_mixer->buses[i]);
+        if (render)
+            render_clear_anchor(render);
+    }
+}
+
+// A new route may have stopped the unit, a Bluetooth one switching profile,
+// or changed the hardware format under it: the unit is reinitialized in
+// place, its buses and the PCM of their rings kept, which costs
+// milliseconds of silence instead of the close and the open of the output.
+// Under _lock
+- (void)reconfigureUnit
+{
+    _reconfigureOnPlay = NO;
+
+    AudioOutputUnitStop(_auUnit);
+    [self clearAnchors];
+    AudioUnitUninitialize(_auUnit);
+
+    AudioStreamBasicDescription streamDescription;
+    au_stream_description(&_spec, &streamDescription);
+    OSStatus status = AudioUnitSetProperty(_auUnit,
+                                           kAudioUnitProperty_StreamFormat,
+                                           kAudioUnitScope_Input,
+                                           0,
+                                           &streamDescription,
+                                           sizeof(streamDescription));
+    if (status != noErr)
+        ALOGE("AudioUnit: failed to set stream format (%d)\n", (int)status);
+
+    status = AudioUnitInitialize(_auUnit);
+    _unitUninitialized = status != noErr;
+    if (status != noErr) {
+        ALOGE("AudioUnit: AudioUnitInitialize failed (%d)\n", (int)status);
+        return;
+    }
+
+    [self updateSessionLatency];
+    if (_playingCount > 0) {
+        status = AudioOutputUnitStart(_auUnit);
+        if (status != noErr)
+            ALOGE("AudioUnit: AudioOutputUnitStart failed (%d)\n", (int)status);
+    }
+}
+
+// under _lock
+- (BOOL)unitNeedsReconfigure
+{
+    UInt32 running = 0;
+    UInt32 size    = sizeof(running);
+    OSStatus status = AudioUnitGetProperty(_auUnit, kAudioOutputUnitProperty_IsRunning,
+                                           kAudioUnitScope_Global, 0, &running, &size);
+    if (_playingCount > 0 && status == noErr && !running)
+        return YES;
+
+    AudioStreamBasicDescription output;
+    size = sizeof(output);
+    status = AudioUnitGetProperty(_auUnit, kAudioUnitProperty_StreamFormat,
+                                  kAudioUnitScope_Output, 0, &output, &size);
+    return status == noErr && _sessionSampleRate > 0 && output.mSampleRate != _sessionSampleRate;
+}
+
+- (void)audioSessionRouteChange:(NSNotification *)notification
+{
+    @synchronized(_lock) {
+        [self updateSessionLatency];
+        if (!_auUnit || ![self unitNeedsReconfigure])
+            return;
+
+        if (_playingCount > 0)
+            [self reconfigureUnit];
+        else
+            _reconfigureOnPlay = YES;
+    }
+}
+
+// the players may go on playing through an interruption, the unit stopped
+// by the system is started again in place at its end
+- (void)audioSessionInterruption:(NSNotification *)notification
+{
+    NSUInteger type = [[[notification userInfo] valueForKey:AVAudioSessionInterruptionTypeKey] unsignedIntegerValue];
+    if (type != AVAudioSessionInterruptionTypeEnded)
+        return;
+
+    @synchronized(_lock) {
+        if (!_auUnit || _playingCount == 0)
+            return;
+
+        [[AVAudioSession sharedInstance] setActive:YES error:nil];
+        [self updateSessionLatency];
+        if (AudioOutputUnitStart(_auUnit) != noErr || [self unitNeedsReconfigure])
+            [self reconfigureUnit];
+    }
+}
+
+// the unit died with the media server: a new one takes the same mixer
+- (void)audioSessionMediaServicesReset:(NSNotification *)notification
+{
+    au_pool_drain();
+
+    @synchronized(_lock) {
+        if (!_auUnit)
+            return;
+
+        AudioComponentInstanceDispose(_auUnit);
+        _auUnit = NULL;
+        [self clearAnchors];
+
         AudioStreamBasicDescription streamDescription;
-        IJKSDLGetAudioStreamBasicDescriptionFromSpec(&_spec, &streamDescription);
-
-        /* Set the desired format */
-        UInt32 i_param_size = sizeof(streamDescription);
-        status = AudioUnitSetProperty(auUnit,
-                                      kAudioUnitProperty_StreamFormat,
-                                      kAudioUnitScope_Input,
-                                      0,
-                                      &streamDescription,
-                                      i_param_size);
+        au_stream_description(&_spec, &streamDescription);
+        AudioUnit auUnit = au_unit_create(&_spec, &streamDescription);
+        if (!auUnit)
+            return;
+        if (au_unit_set_mixer(auUnit, _mixer) != noErr || AudioUnitInitialize(auUnit) != noErr) {
+            ALOGE("AudioUnit: failed to recreate the unit after a reset of the media services\n");
+            AudioComponentInstanceDispose(auUnit);
+            return;
+        }
+        _auUnit = auUnit;
+        _unitUninitialized = NO;
+
+        [self updateSessionLatency];
+        if (_playingCount > 0) {
+            [[AVAudioSession sharedInstance] setActive:YES error:nil];
+            AudioOutputUnitStart(_auUnit);
+        }
+    }
+}
+
+- (BOOL)addRender:(IJKSDLAudioUnitRender *)render
+{
+    @synchronized(_lock) {
+        if (!_auUnit || render->spec.freq != (int)_sampleRate || !mixer_add(_mixer, render))
+            return NO;
+
+        _busCount++;
+        atomic_store(&render->output_latency, _sessionOutputLatency);
+        return YES;
+    }
+}
+
+- (void)removeRender:(IJKSDLAudioUnitRender *)render
+{
+    int left;
+
+    // not handed out to a controller while its last bus goes
+    if (_shared)
+        pthread_mutex_lock(&g_shared_engine_mutex);
+
+    @synchronized(_lock) {
+        [self pauseRender:render];
+        if (mixer_remove(_mixer, render) && --_busCount == 0)
+            [self closeUnit];
+        left = _busCount;
+    }
+
+    if (_shared) {
+        if (left == 0 && g_shared_engine == self)
+            g_shared_engine = nil;
+        pthread_mutex_unlock(&g_shared_engine_mutex);
+    }
+}
+
+- (void)playRender:(IJKSDLAudioUnitRender *)render
+{
+    @synchronized(_lock) {
+        if (!_auUnit)
+            return;
+
+        if (atomic_load(&render->paused)) {
+            atomic_store(&render->paused, false);
+            _playingCount++;
+        }
+        semaphore_signal(render->feed_sem);
+
+        // the unit may run for another bus already, starting it again is harmless
+        NSError *error = nil;
+        if (NO == [[AVAudioSession sharedInstance] setActive:YES error:&error]) {
+            NSLog(@"AudioUnit: AVAudioSession.setActive(YES) failed: %@\n", error ? [error localizedDescription] : @"nil");
+        }
+
+        // the session is active now, its buffer duration final
+        [self updateSessionLatency];
+
+        if (_reconfigureOnPlay) {
+            [self reconfigureUnit];
+            return;
+        }
+
+        OSStatus status = AudioOutputUnitStart(_auUnit);
         if (status != noErr) {
-            ALOGE("AudioUnit: failed to set stream format (%d)", (int)status);
+            NSLog(@"AudioUnit: AudioOutputUnitStart failed (%d)\n", (int)status);
+            [self reconfigureUnit];
+        }
+    }
+}
+
+- (void)pauseRender:(IJKSDLAudioUnitRender *)render
+{
+    @synchronized(_lock) {
+        if (!atomic_load(&render->paused)) {
+            atomic_store(&render->paused, true);
+            _playingCount--;
+        }
+
+        if (!_auUnit || _playingCount > 0)
+            return;
+
+        OSStatus status = AudioOutputUnitStop(_auUnit);
+        if (status != noErr)
+            ALOGE("AudioUnit: failed to stop AudioUnit (%d)\n", (int)status);
+    }
+}
+
+- (void)resetForRender:(IJKSDLAudioUnitRender *)render
+{
+    @synchronized(_lock) {
+        if (!_auUnit || _busCount > 1)
+            return;
+
+        AudioUnitReset(_auUnit, kAudioUnitScope_Global, 0);
+    }
+}
+
+// with no bus left, under _lock
+- (void)closeUnit
+{
+    if (!_auUnit)
+        return;
+
+    AudioOutputUnitStop(_auUnit);
+    au_unit_set_mixer(_auUnit, NULL);
+    AudioUnitReset(_auUnit, kAudioUnitScope_Global, 0);
+    // the pool hands out initialized units only
+    if (_unitUninitialized || !au_pool_give(_auUnit, _sampleRate))
+        AudioComponentInstanceDispose(_auUnit);
+    _auUnit = NULL;
+}
+
+@end
+
+@implementation IJKSDLAudioUnitController {
+    IJKSDLAudioUnitEngine *_engine;     // kept until dealloc, the latency reads it
+    IJKSDLAudioUnitRender *_render;
+
+    // close against play and pause
+    NSLock   *_lock;
+}
+
+- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec
+{
+    return [self initWithAudioSpec:aSpec shared:NO];
+}
+
+- (id)initWithAudioSpec:(const SDL_AudioSpec *)aSpec shared:(BOOL)shared
+{
+    self = [super init];
+    if (self) {
+        if (aSpec == NULL) {
             self = nil;
             return nil;
         }
+        _spec = *aSpec;
 
-        /* Retrieve actual format */
-        status = AudioUnitGetProperty(auUnit,
-                                      kAudioUnitProperty_StreamFormat,
-                                      kAudioUnitScope_Input,
-                                      0,
-                                      &streamDescription,
-                                      &i_param_size);
-        if (status != noErr) {
-            ALOGE("AudioUnit: failed to verify stream format (%d)\n", (int)status);
+        if (aSpec->format != AUDIO_S16SYS) {
+            NSLog(@"aout_open_audio: unsupported format %d\n", (int)aSpec->format);
+            return nil;
         }
 
-        AURenderCallbackStruct callback;
-        callback.inputProc = (AURenderCallback) RenderCallback;
-        callback.inputProcRefCon = (__bridge void*) self;
-        status = AudioUnitSetProperty(auUnit,
-                                      kAudioUnitProperty_SetRenderCallback,
-                                      kAudioUnitScope_Input,
-                                      0, &callback, sizeof(callback));
-        if (status != noErr) {
-            ALOGE("AudioUnit: render callback setup failed (%d)\n", (int)status);
-            self = nil;
+        if (aSpec->channels > IJK_AUDIO_MIX_MAX_CHANNELS) {
+            NSLog(@"aout_open_audio: unsupported channels %d\n", (int)aSpec->channels);
             return nil;
         }
 
+        // a bus mixes at the rate of the engine, the core resamples to the spec obtained
+        if (shared) {
+            _engine = [IJKSDLAudioUnitEngine sharedEngineWithSpec:&_spec];
+            if (_engine)
+                _spec.freq = (int)_engine.sampleRate;
+        }
+
         SDL_CalculateAudioSpec(&_spec);
 
-        /* AU initiliaze */
-        status = AudioUnitInitialize(auUnit);
-        if (status != noErr) {
-            ALOGE("AudioUnit: AudioUnitInitialize failed (%d)\n", (int)status);
+        _render = render_create(&_spec);
+        if (!_render) {
+            ALOGE("AudioUnit: failed to create render state\n");
             self = nil;
             return nil;
         }
 
-        _auUnit = auUnit;
+        // the shared buses all taken, or the engine closed by its last player meanwhile
+        if (!_engine || ![_engine addRender:_render]) {
+            _engine = [[IJKSDLAudioUnitEngine alloc] initWithSpec:&_spec];
+            if (!_engine || ![_engine addRender:_render]) {
+                render_free(_render);
+                _render = NULL;
+                self = nil;
+                return nil;
+            }
+        }
+
+        _lock = [[NSLock alloc] init];
     }
     return self;
 }
@@ -149,67 +1100,141 @@
 
 - (void)play
 {
-    if (!_auUnit)
-        return;
+    @synchronized(_lock) {
+        if (!_render)
+            return;
 
-    _isPaused = NO;
-    NSError *error = nil;
-    if (NO == [[AVAudioSession sharedInstance] setActive:YES error:&error]) {
-        NSLog(@"AudioUnit: AVAudioSession.setActive(YES) failed: %@\n", error ? [error localizedDescription] : @"nil");
+        [_engine playRender:_render];
     }
-
-    OSStatus status = AudioOutputUnitStart(_auUnit);
-    if (status != noErr)
-        NSLog(@"AudioUnit: AudioOutputUnitStart failed (%d)\n", (int)status);
 }
 
 - (void)pause
 {
-    if (!_auUnit)
-        return;
+    @synchronized(_lock) {
+        if (!_render)
+            return;
 
-    _isPaused = YES;
-    OSStatus status = AudioOutputUnitStop(_auUnit);
-    if (status != noErr)
-        ALOGE("AudioUnit: failed to stop AudioUnit (%d)\n", (int)status);
+        [_engine pauseRender:_render];
+    }
 }
 
 - (void)flush
 {
-    if (!_auUnit)
+    @synchronized(_lock) {
+        if (!_render)
+            return;
+
+        // the IO thread drops whatever is queued on its next cycle
+        atomic_fetch_add(&_render->flush_serial, 1);
+        atomic_store_explicit(&_render->flush_request, true, memory_order_release);
+        semaphore_signal(_render->feed_sem);
+
+        [_engine resetForRender:_render];
+    }
+}
+
+- (double)get_latency_seconds
+{
+    if (!_render)
+        return 0;
+
+    // anchored to the host time the unit gives its output cycles, the
+    // estimate from the ring fill only until the unit has run one
+    double output_delay;
+    if (!render_output_delay(_render, &output_delay)) {
+        double bytes_per_sec = (double)_spec.freq * _spec.channels * 2;
+        output_delay = render_ring_fill(_render) / bytes_per_sec + _engine.sessionIOBufferDuration;
+    }
+
+    double rate = atomic_load(&_render->playback_rate);
+    // the ring holds stretched output, the tempo delay is already in input time
+    return (output_delay + _engine.sessionOutputLatency) * rate +
+           ijk_audio_tempo_get_delay(_render->tempo);
+}
+
+- (double)get_session_sample_rate
+{
+    return _engine.sessionSampleRate;
+}
+
+- (void)setPlaybackRate:(float)playbackRate
+{
+    if (!_render)
         return;
 
-    AudioUnitReset(_auUnit, kAudioUnitScope_Global, 0);
+    atomic_store(&_render->playback_rate, playbackRate);
 }
 
-- (void)stop
+- (void)setPlaybackVolume:(float)playbackVolume
 {
-    if (!_auUnit)
+    if (!_render)
         return;
 
-    OSStatus status = AudioOutputUnitStop(_auUnit);
-    if (status != noErr)
-        ALOGE("AudioUnit: failed to stop AudioUnit (%d)", (int)status);
+    // ramped to by the IO thread
+    atomic_store(&_render->volume, playbackVolume);
 }
 
-- (void)close
+- (void)setAnalysisEnabled:(BOOL)enabled loudnessTarget:(float)loudnessTarget
 {
-    [self stop];
+    if (!_render)
+        return;
 
-    if (!_auUnit)
+    if (enabled && !_render->analysis) {
+        _render->analysis_chunk = malloc(IJK_AU_MIX_FRAMES * 2 * sizeof(float));
+        _render->analysis       = ijk_audio_analysis_create(_spec.freq);
+        if (!_render->analysis_chunk || !_render->analysis) {
+            ALOGE("AudioUnit: failed to create the audio analysis\n");
+            free(_render->analysis_chunk);
+            _render->analysis_chunk = NULL;
+            ijk_audio_analysis_free(&_render->analysis);
+            return;
+        }
+    }
+
+    atomic_store(&_render->loudness_target, loudnessTarget);
+    // publishes the analysis to the IO thread
+    atomic_store_explicit(&_render->analysis_enabled, (bool)enabled, memory_order_release);
+}
+
+- (BOOL)getAnalysisResult:(IJKAudioAnalysisResult *)result
+{
+    if (!_render || !_render->analysis)
+        return NO;
+
+    return ijk_audio_analysis_get_result(_render->analysis, result);
+}
+
+- (void)setSyncProbe:(IJKSyncProbe *)probe
+{
+    if (!_render || !probe)
         return;
 
-    AURenderCallbackStruct callback;
-    memset(&callback, 0, sizeof(AURenderCallbackStruct));
-    AudioUnitSetProperty(_auUnit,
-                         kAudioUnitProperty_SetRenderCallback,
-                         kAudioUnitScope_Input, 0, &callback,
-                         sizeof(callback));
+    // the IO thread may hold the one set, it is not replaced
+    IJKSyncProbe *expected = NULL;
+    IJKSyncProbe *ref      = ijk_sync_probe_ref(probe);
+    if (!atomic_compare_exchange_strong(&_render->sync_probe, &expected, ref))
+        ijk_sync_probe_unref(&ref);
+}
 
-    AudioComponentInstanceDispose(_auUnit);
-    _auUnit = NULL;
+- (void)stop
+{
+    [self pause];
+}
+
+- (void)close
+{
+    @synchronized(_lock) {
+        if (!_render)
+            return;
+
+        // the IO thread is out of the render once its bus is removed
+        [_engine removeRender:_render];
+        render_free(_render);
+        _render = NULL;
+    }
 }
 
+// runs on the real-time IO thread: no locks, no allocation, no Objective-C messaging
 static OSStatus RenderCallback(void                        *inRefCon,
                                AudioUnitRenderActionFlags  *ioActionFlags,
                                const AudioTimeStamp        *inTimeStamp,
@@ -217,24 +1242,27 @@ static OSStatus RenderCallback(void                        *inRefCon,
                                UInt32                      inNumberFrames,
                                AudioBufferList             *ioData)
 {
-    @autoreleasepool {
-        IJKSDLAudioUnitController* auController = (__bridge IJKSDLAudioUnitController *) inRefCon;
+    IJKSDLAudioUnitMixer *mixer = inRefCon;
+    bool mixed = false;
 
-        if (!auController || auController->_isPaused) {
-            for (UInt32 i = 0; i < ioData->mNumberBuffers; i++) {
-                AudioBuffer *ioBuffer = &ioData->mBuffers[i];
-                memset(ioBuffer->mData, auController.spec.silence, ioBuffer->mDataByteSize);
-            }
-            return noErr;
+    if (mixer) {
+        atomic_fetch_add(&mixer->cycle_seq, 1);
+        for (int i = 0; i < IJK_AU_MIX_BUSES; i++) {
+            IJKSDLAudioUnitRender *render = atomic_load(&mixer->buses[i]);
+            if (render && render_mix(render, mixer->chunk, inTimeStamp, ioData, !mixed))
+                mixed = true;
         }
+        atomic_fetch_add(&mixer->cycle_seq, 1);
+    }
 
-        for (int i = 0; i < (int)ioData->mNumberBuffers; i++) {
+    if (!mixed) {
+        for (UInt32 i = 0; i < ioData->mNumberBuffers; i++) {
             AudioBuffer *ioBuffer = &ioData->mBuffers[i];
-            (*auController.spec.callback)(auController.spec.userdata, ioBuffer->mData, ioBuffer->mDataByteSize);
+            memset(ioBuffer->mData, 0, ioBuffer->mDataByteSize);
         }
-
-        return noErr;
     }
+
+    return noErr;
 }
 
 @end
@@ -0,0 +1,66 @@
+/*
+ * IJKSDLFrameCapture.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import <CoreVideo/CoreVideo.h>
+
+#include "ijksdl/ijksdl_vout.h"
+
+typedef void (^IJKSDLFrameCaptureCompletion)(UIImage *image);
+// pixelBuffer is valid for the call, retain it to keep it;
+// pts: seconds from the start of the media, NAN if unknown
+typedef void (^IJKSDLFrameOutputHandler)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts);
+
+// Captures the frame a render view displays without rendering the view.
+//
+// VideoToolbox frames are kept by reference as they are displayed, free of
+// copies; I420 and YV12 frames are copied into a pooled NV12 buffer only
+// while a capture waits for one. The conversion to UIImage runs on a
+// background queue, completions are called on the main thread.
+//
+// The output handler gets the displayed frames themselves, the same way:
+// the decoder's buffer for VideoToolbox, an IOSurface backed copy for
+// software frames. A frame is dropped while the handler still runs on the
+// former one, so a slow consumer never holds back rendering.
+@interface IJKSDLFrameCapture : NSObject
+
+// render thread, overlay may be NULL
+- (void)didDisplayOverlay:(SDL_VoutOverlay *)overlay;
+// the same for the frame of a SDL_FCC__VTB overlay, kept past the overlay
+- (void)didDisplayPixelBuffer:(CVPixelBufferRef)pixelBuffer sarNum:(int)sarNum sarDen:(int)sarDen;
+
+// fallback renders the view, used when no frame can be grabbed in time:
+// playback paused on a software frame, or an overlay format not handled
+- (void)captureWithFallback:(UIImage *(^)(void))fallback
+                 completion:(IJKSDLFrameCaptureCompletion)completion;
+// drops the frame displayed last and the pooled copies
+- (void)reset;
+
+// nil handler stops the output; frameInterval: every Nth displayed frame,
+// 0 or 1 for all; maximumFrameRate: 0 for no limit
+- (void)setFrameOutputHandler:(IJKSDLFrameOutputHandler)handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate;
+
+@end
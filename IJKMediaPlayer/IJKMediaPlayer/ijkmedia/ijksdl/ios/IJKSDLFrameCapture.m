@@ -0,0 +1,340 @@
+/*
+ * IJKSDLFrameCapture.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLFrameCapture.h"
+#import <CoreImage/CoreImage.h>
+#import <CoreVideo/CoreVideo.h>
+#import <QuartzCore/QuartzCore.h>
+#include "ijksdl/ijksdl_log.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+
+// no frame displayed meanwhile: playback is paused, render the view instead
+#define IJK_CAPTURE_FALLBACK_DELAY_MS   200
+
+@implementation IJKSDLFrameCapture {
+    NSLock                 *_lock;
+    dispatch_queue_t        _queue;
+
+    // the frame displayed last, NULL when it was a software frame not copied
+    CVPixelBufferRef        _lastPixelBuffer;
+    int                     _lastSarNum;
+    int                     _lastSarDen;
+    NSMutableArray         *_pendingCompletions;
+
+    CVPixelBufferPoolRef    _pool;
+    int                     _poolWidth;
+    int                     _poolHeight;
+
+    IJKSDLFrameOutputHandler _outputHandler;
+    dispatch_queue_t        _outputQueue;
+    NSUInteger              _outputFrameInterval;
+    CFTimeInterval          _outputMinimumInterval;
+    NSUInteger              _outputFrameCount;
+    CFTimeInterval          _lastOutputTime;
+    BOOL                    _outputBusy;
+}
+
+// one GPU backed context for every player, creating one is expensive
++ (CIContext *)sharedContext
+{
+    static CIContext *context = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        context = [CIContext contextWithOptions:nil];
+    });
+    return context;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _lock               = [[NSLock alloc] init];
+        _queue              = dispatch_queue_create("tv.danmaku.ijk.frame-capture", DISPATCH_QUEUE_SERIAL);
+        _pendingCompletions = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_lastPixelBuffer)
+        CVPixelBufferRelease(_lastPixelBuffer);
+    if (_pool)
+        CVPixelBufferPoolRelease(_pool);
+}
+
+- (CVPixelBufferRef)copyPlanarOverlay:(SDL_VoutOverlay *)overlay CF_RETURNS_RETAINED
+{
+    int uPlane;
+    int vPlane;
+    switch (overlay->format) {
+        case SDL_FCC_I420: uPlane = 1; vPlane = 2; break;
+        case SDL_FCC_YV12: uPlane = 2; vPlane = 1; break;
+        default:
+            return NULL;
+    }
+
+    int width  = overlay->w;
+    int height = overlay->h;
+    if (!_pool || _poolWidth != width || _poolHeight != height) {
+        if (_pool) {
+            CVPixelBufferPoolRelease(_pool);
+            _pool = NULL;
+        }
+
+        NSDictionary *attributes = @{
+            (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+            (id)kCVPixelBufferWidthKey:               @(width),
+            (id)kCVPixelBufferHeightKey:              @(height),
+            (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+        };
+        CVReturn err = CVPixelBufferPoolCreate(kCFAllocatorDefault, NULL, (__bridge CFDictionaryRef)attributes, &_pool);
+        if (err != kCVReturnSuccess || !_pool) {
+            ALOGE("[FrameCapture] CVPixelBufferPoolCreate failed: %d\n", err);
+            return NULL;
+        }
+        _poolWidth  = width;
+        _poolHeight = height;
+    }
+
+    CVPixelBufferRef pixelBuffer = NULL;
+    if (CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, _pool, &pixelBuffer) != kCVReturnSuccess)
+        return NULL;
+
+    CVPixelBufferLockBaseAddress(pixelBuffer, 0);
+
+    uint8_t *dstY    = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+    size_t   pitchY  = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+    for (int y = 0; y < height; ++y)
+        memcpy(dstY + y * pitchY, overlay->pixels[0] + y * overlay->pitches[0], width);
+
+    uint8_t *dstUV   = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
+    size_t   pitchUV = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
+    int      chromaW = (width  + 1) / 2;
+    int      chromaH = (height + 1) / 2;
+    for (int y = 0; y < chromaH; ++y) {
+        const uint8_t *srcU = overlay->pixels[uPlane] + y * overlay->pitches[uPlane];
+        const uint8_t *srcV = overlay->pixels[vPlane] + y * overlay->pitches[vPlane];
+        uint8_t       *dst  = dstUV + y * pitchUV;
+        for (int x = 0; x < chromaW; ++x) {
+            dst[2 * x]     = srcU[x];
+            dst[2 * x + 1] = srcV[x];
+        }
+    }
+
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+    return pixelBuffer;
+}
+
+// under _lock
+- (BOOL)shouldOutputFrame
+{
+    if (!_outputHandler)
+        return NO;
+
+    _outputFrameCount++;
+    if (_outputBusy || _outputFrameCount % _outputFrameInterval != 0)
+        return NO;
+
+    CFTimeInterval now = CACurrentMediaTime();
+    if (_outputMinimumInterval > 0 && now - _lastOutputTime < _outputMinimumInterval)
+        return NO;
+
+    _lastOutputTime = now;
+    return YES;
+}
+
+- (void)didDisplayOverlay:(SDL_VoutOverlay *)overlay
+{
+    if (!overlay)
+        return;
+
+    if (overlay->format == SDL_FCC__VTB) {
+        [self didDisplayPixelBuffer:SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay)
+                      planarOverlay:NULL
+                             sarNum:overlay->sar_num
+                             sarDen:overlay->sar_den];
+    } else {
+        [self didDisplayPixelBuffer:NULL
+                      planarOverlay:overlay
+                             sarNum:overlay->sar_num
+                             sarDen:overlay->sar_den];
+    }
+}
+
+- (void)didDisplayPixelBuffer:(CVPixelBufferRef)pixelBuffer sarNum:(int)sarNum sarDen:(int)sarDen
+{
+    [self didDisplayPixelBuffer:pixelBuffer planarOverlay:NULL sarNum:sarNum sarDen:sarDen];
+}
+
+// planarOverlay is copied only when a capture or the output wants it
+- (void)didDisplayPixelBuffer:(CVPixelBufferRef)displayedBuffer
+                planarOverlay:(SDL_VoutOverlay *)planarOverlay
+                       sarNum:(int)sarNum
+                       sarDen:(int)sarDen
+{
+    NSArray *completions = nil;
+
+    [_lock lock];
+    BOOL output = [self shouldOutputFrame];
+    CVPixelBufferRef pixelBuffer = NULL;
+    if (displayedBuffer) {
+        pixelBuffer = CVPixelBufferRetain(displayedBuffer);
+    } else if (planarOverlay && (_pendingCompletions.count > 0 || output)) {
+        pixelBuffer = [self copyPlanarOverlay:planarOverlay];
+    }
+
+    if (_lastPixelBuffer)
+        CVPixelBufferRelease(_lastPixelBuffer);
+    _lastPixelBuffer = pixelBuffer;
+    _lastSarNum      = sarNum;
+    _lastSarDen      = sarDen;
+
+    if (pixelBuffer && _pendingCompletions.count > 0) {
+        completions = [_pendingCompletions copy];
+        [_pendingCompletions removeAllObjects];
+    }
+
+    IJKSDLFrameOutputHandler outputHandler = nil;
+    dispatch_queue_t         outputQueue   = nil;
+    if (output && pixelBuffer) {
+        outputHandler = _outputHandler;
+        outputQueue   = _outputQueue;
+        _outputBusy   = YES;
+    }
+    [_lock unlock];
+
+    if (completions)
+        [self convertPixelBuffer:pixelBuffer sarNum:sarNum sarDen:sarDen completions:completions];
+
+    if (outputHandler) {
+        NSTimeInterval pts = SDL_VoutOverlayVideoToolBox_GetPresentationTime(pixelBuffer);
+
+        CVPixelBufferRetain(pixelBuffer);
+        dispatch_async(outputQueue, ^{
+            outputHandler(pixelBuffer, pts);
+            CVPixelBufferRelease(pixelBuffer);
+
+            [_lock lock];
+            _outputBusy = NO;
+            [_lock unlock];
+        });
+    }
+}
+
+- (void)reset
+{
+    [_lock lock];
+    if (_lastPixelBuffer) {
+        CVPixelBufferRelease(_lastPixelBuffer);
+        _lastPixelBuffer = NULL;
+    }
+    if (_pool) {
+        CVPixelBufferPoolRelease(_pool);
+        _pool = NULL;
+    }
+    [_lock unlock];
+}
+
+- (void)setFrameOutputHandler:(IJKSDLFrameOutputHandler)handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate
+{
+    [_lock lock];
+    _outputHandler         = [handler copy];
+    _outputQueue           = queue ? queue : dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    _outputFrameInterval   = MAX(frameInterval, 1);
+    // a tenth of slack, frames due a little early are not skipped
+    _outputMinimumInterval = maximumFrameRate > 0 ? 0.9 / maximumFrameRate : 0;
+    _outputFrameCount      = 0;
+    _lastOutputTime        = 0;
+    [_lock unlock];
+}
+
+- (void)captureWithFallback:(UIImage *(^)(void))fallback
+                 completion:(IJKSDLFrameCaptureCompletion)completion
+{
+    if (!completion)
+        return;
+
+    IJKSDLFrameCaptureCompletion block = [completion copy];
+
+    [_lock lock];
+    CVPixelBufferRef pixelBuffer = NULL;
+    if (_lastPixelBuffer)
+        pixelBuffer = CVPixelBufferRetain(_lastPixelBuffer);
+    else
+        [_pendingCompletions addObject:block];
+    int sarNum = _lastSarNum;
+    int sarDen = _lastSarDen;
+    [_lock unlock];
+
+    if (pixelBuffer) {
+        [self convertPixelBuffer:pixelBuffer sarNum:sarNum sarDen:sarDen completions:@[block]];
+        CVPixelBufferRelease(pixelBuffer);
+        return;
+    }
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, IJK_CAPTURE_FALLBACK_DELAY_MS * NSEC_PER_MSEC), dispatch_get_main_queue(), ^{
+        [_lock lock];
+        BOOL pending = [_pendingCompletions containsObject:block];
+        if (pending)
+            [_pendingCompletions removeObject:block];
+        [_lock unlock];
+
+        if (pending)
+            block(fallback ? fallback() : nil);
+    });
+}
+
+- (void)convertPixelBuffer:(CVPixelBufferRef)pixelBuffer
+                    sarNum:(int)sarNum
+                    sarDen:(int)sarDen
+               completions:(NSArray *)completions
+{
+    CVPixelBufferRetain(pixelBuffer);
+    dispatch_async(_queue, ^{
+        @autoreleasepool {
+            CIImage *ciImage = [CIImage imageWithCVPixelBuffer:pixelBuffer];
+            if (sarNum > 0 && sarDen > 0 && sarNum != sarDen)
+                ciImage = [ciImage imageByApplyingTransform:CGAffineTransformMakeScale((CGFloat)sarNum / sarDen, 1.0f)];
+
+            UIImage   *image   = nil;
+            CGImageRef cgImage = [[IJKSDLFrameCapture sharedContext] createCGImage:ciImage fromRect:ciImage.extent];
+            if (cgImage) {
+                image = [UIImage imageWithCGImage:cgImage];
+                CGImageRelease(cgImage);
+            }
+            CVPixelBufferRelease(pixelBuffer);
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                for (IJKSDLFrameCaptureCompletion completion in completions)
+                    completion(image);
+            });
+        }
+    });
+}
+
+@end
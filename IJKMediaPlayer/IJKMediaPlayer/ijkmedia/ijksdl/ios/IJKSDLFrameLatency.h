@@ -0,0 +1,85 @@
+/*
+ * IJKSDLFrameLatency.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreVideo/CoreVideo.h>
+
+// CFData of an IJKSDLFrameTiming, on the pixel buffers the VideoToolbox
+// decoder queues; taken off by the view which presents them
+#define IJK_VTB_ATTACHMENT_TIMING CFSTR("IJKFrameTiming")
+
+// mach_absolute_time() of a frame passing each stage
+typedef struct IJKSDLFrameTiming {
+    uint64_t dequeue;   // packet taken from the packet queue by the decoder
+    uint64_t submit;    // VTDecompressionSessionDecodeFrame
+    uint64_t output;    // VTDecoderCallback
+    uint64_t queue;     // ffp_queue_picture, out of the reorder queue
+} IJKSDLFrameTiming;
+
+uint64_t IJKSDLFrameTiming_now(void);
+void     IJKSDLFrameTiming_attach(CVPixelBufferRef pixelBuffer, const IJKSDLFrameTiming *timing);
+
+typedef NS_ENUM(NSInteger, IJKSDLFrameStage) {
+    IJKSDLFrameStageSubmit,     // dequeue to submit: bitstream conversion, waits for a decode slot
+    IJKSDLFrameStageDecode,     // submit to output
+    IJKSDLFrameStageReorder,    // output to queue
+    IJKSDLFrameStagePresent,    // queue to present: waits for the clock, then rendered
+    IJKSDLFrameStageTotal,      // dequeue to present
+    IJKSDLFrameStageCount,
+};
+
+// microseconds
+typedef struct IJKSDLLatencyPercentiles {
+    int64_t count;
+    int64_t p50;
+    int64_t p95;
+    int64_t p99;
+} IJKSDLLatencyPercentiles;
+
+// one histogram of the kind below, for latencies measured elsewhere than
+// at present time; add from any thread
+typedef struct IJKSDLLatencyHistogram IJKSDLLatencyHistogram;
+
+IJKSDLLatencyHistogram  *IJKSDLLatencyHistogram_create(void);
+void                     IJKSDLLatencyHistogram_freep(IJKSDLLatencyHistogram **histogram);
+void                     IJKSDLLatencyHistogram_add(IJKSDLLatencyHistogram *histogram, int64_t us);
+IJKSDLLatencyPercentiles IJKSDLLatencyHistogram_percentiles(IJKSDLLatencyHistogram *histogram);
+// microseconds between two IJKSDLFrameTiming_now(), -1 if either is unknown
+int64_t                  IJKSDLFrameTiming_elapsed(uint64_t from, uint64_t to);
+
+// Per stage latency histograms of the frames a render view presents.
+//
+// The buckets are log-linear, 8 per power of two, as in HdrHistogram:
+// a value is known within 12.5% from 8 us to 16 s, with no allocation or
+// lock on the render thread. Frames without timing (software decoded, or
+// shown before they were queued) are not counted.
+@interface IJKSDLFrameLatency : NSObject
+
+// render thread, once the frame is presented
+- (void)didPresentPixelBuffer:(CVPixelBufferRef)pixelBuffer;
+
+// any thread
+- (IJKSDLLatencyPercentiles)percentilesOfStage:(IJKSDLFrameStage)stage;
+- (void)reset;
+
+@end
@@ -0,0 +1,206 @@
+/*
+ * IJKSDLFrameLatency.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLFrameLatency.h"
+#include <mach/mach_time.h>
+#include <stdatomic.h>
+
+// 2^3 buckets per power of two, values up to 2^24 us
+#define IJK_LATENCY_SUB_BITS    3
+#define IJK_LATENCY_SUB_COUNT   (1 << IJK_LATENCY_SUB_BITS)
+#define IJK_LATENCY_MAX_BITS    24
+#define IJK_LATENCY_BUCKETS     ((IJK_LATENCY_MAX_BITS - IJK_LATENCY_SUB_BITS + 1) * IJK_LATENCY_SUB_COUNT)
+
+struct IJKSDLLatencyHistogram {
+    atomic_uint buckets[IJK_LATENCY_BUCKETS];
+};
+
+static mach_timebase_info_data_t g_timebase;
+static dispatch_once_t           g_timebase_once;
+
+uint64_t IJKSDLFrameTiming_now(void)
+{
+    return mach_absolute_time();
+}
+
+void IJKSDLFrameTiming_attach(CVPixelBufferRef pixelBuffer, const IJKSDLFrameTiming *timing)
+{
+    if (!pixelBuffer || !timing)
+        return;
+
+    CFDataRef data = CFDataCreate(kCFAllocatorDefault, (const UInt8 *)timing, sizeof(*timing));
+    if (!data)
+        return;
+    CVBufferSetAttachment(pixelBuffer, IJK_VTB_ATTACHMENT_TIMING, data, kCVAttachmentMode_ShouldNotPropagate);
+    CFRelease(data);
+}
+
+int64_t IJKSDLFrameTiming_elapsed(uint64_t from, uint64_t to)
+{
+    if (!from || to < from)
+        return -1;
+
+    dispatch_once(&g_timebase_once, ^{
+        mach_timebase_info(&g_timebase);
+    });
+    return (int64_t)((to - from) * g_timebase.numer / g_timebase.denom / 1000);
+}
+
+static int bucket_of(int64_t us)
+{
+    if (us < IJK_LATENCY_SUB_COUNT)
+        return (int)us;
+
+    us = MIN(us, (1LL << IJK_LATENCY_MAX_BITS) - 1);
+    int magnitude = 63 - __builtin_clzll((uint64_t)us);
+    int shift     = magnitude - IJK_LATENCY_SUB_BITS;
+    return (shift + 1) * IJK_LATENCY_SUB_COUNT + (int)((us >> shift) & (IJK_LATENCY_SUB_COUNT - 1));
+}
+
+// the highest value of the bucket
+static int64_t value_of(int bucket)
+{
+    if (bucket < IJK_LATENCY_SUB_COUNT)
+        return bucket;
+
+    int shift = bucket / IJK_LATENCY_SUB_COUNT - 1;
+    int64_t low = (int64_t)(IJK_LATENCY_SUB_COUNT + bucket % IJK_LATENCY_SUB_COUNT) << shift;
+    return low + (1LL << shift) - 1;
+}
+
+IJKSDLLatencyHistogram *IJKSDLLatencyHistogram_create(void)
+{
+    IJKSDLLatencyHistogram *histogram = calloc(1, sizeof(IJKSDLLatencyHistogram));
+    if (!histogram)
+        return NULL;
+
+    for (int i = 0; i < IJK_LATENCY_BUCKETS; ++i)
+        atomic_init(&histogram->buckets[i], 0);
+    return histogram;
+}
+
+void IJKSDLLatencyHistogram_freep(IJKSDLLatencyHistogram **histogram)
+{
+    if (!histogram || !*histogram)
+        return;
+
+    free(*histogram);
+    *histogram = NULL;
+}
+
+void IJKSDLLatencyHistogram_add(IJKSDLLatencyHistogram *histogram, int64_t us)
+{
+    if (!histogram || us < 0)
+        return;
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_of(us)], 1, memory_order_relaxed);
+}
+
+IJKSDLLatencyPercentiles IJKSDLLatencyHistogram_percentiles(IJKSDLLatencyHistogram *histogram)
+{
+    IJKSDLLatencyPercentiles percentiles = {0};
+    if (!histogram)
+        return percentiles;
+
+    // one pass to copy, the writers keep adding meanwhile
+    unsigned counts[IJK_LATENCY_BUCKETS];
+    for (int i = 0; i < IJK_LATENCY_BUCKETS; ++i) {
+        counts[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        percentiles.count += counts[i];
+    }
+    if (percentiles.count == 0)
+        return percentiles;
+
+    int64_t p50 = (percentiles.count * 50 + 99) / 100;
+    int64_t p95 = (percentiles.count * 95 + 99) / 100;
+    int64_t p99 = (percentiles.count * 99 + 99) / 100;
+    int64_t seen = 0;
+    for (int i = 0; i < IJK_LATENCY_BUCKETS; ++i) {
+        if (counts[i] == 0)
+            continue;
+        int64_t before = seen;
+        seen += counts[i];
+        if (before < p50 && seen >= p50)
+            percentiles.p50 = value_of(i);
+        if (before < p95 && seen >= p95)
+            percentiles.p95 = value_of(i);
+        if (seen >= p99) {
+            percentiles.p99 = value_of(i);
+            break;
+        }
+    }
+    return percentiles;
+}
+
+@implementation IJKSDLFrameLatency {
+    IJKSDLLatencyHistogram _histograms[IJKSDLFrameStageCount];
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        [self reset];
+    }
+    return self;
+}
+
+- (void)didPresentPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    if (!pixelBuffer)
+        return;
+
+    CFTypeRef data = CVBufferGetAttachment(pixelBuffer, IJK_VTB_ATTACHMENT_TIMING, NULL);
+    if (!data || CFGetTypeID(data) != CFDataGetTypeID() || CFDataGetLength(data) != sizeof(IJKSDLFrameTiming))
+        return;
+
+    IJKSDLFrameTiming timing;
+    CFDataGetBytes(data, CFRangeMake(0, sizeof(timing)), (UInt8 *)&timing);
+    // a frame presented again, or a pooled buffer back from the decoder, is not counted twice
+    CVBufferRemoveAttachment(pixelBuffer, IJK_VTB_ATTACHMENT_TIMING);
+
+    uint64_t now = IJKSDLFrameTiming_now();
+    IJKSDLLatencyHistogram_add(&_histograms[IJKSDLFrameStageSubmit],  IJKSDLFrameTiming_elapsed(timing.dequeue, timing.submit));
+    IJKSDLLatencyHistogram_add(&_histograms[IJKSDLFrameStageDecode],  IJKSDLFrameTiming_elapsed(timing.submit,  timing.output));
+    IJKSDLLatencyHistogram_add(&_histograms[IJKSDLFrameStageReorder], IJKSDLFrameTiming_elapsed(timing.output,  timing.queue));
+    IJKSDLLatencyHistogram_add(&_histograms[IJKSDLFrameStagePresent], IJKSDLFrameTiming_elapsed(timing.queue,   now));
+    IJKSDLLatencyHistogram_add(&_histograms[IJKSDLFrameStageTotal],   IJKSDLFrameTiming_elapsed(timing.dequeue, now));
+}
+
+- (IJKSDLLatencyPercentiles)percentilesOfStage:(IJKSDLFrameStage)stage
+{
+    if (stage < 0 || stage >= IJKSDLFrameStageCount) {
+        IJKSDLLatencyPercentiles none = {0};
+        return none;
+    }
+    return IJKSDLLatencyHistogram_percentiles(&_histograms[stage]);
+}
+
+- (void)reset
+{
+    for (int stage = 0; stage < IJKSDLFrameStageCount; ++stage) {
+        for (int i = 0; i < IJK_LATENCY_BUCKETS; ++i)
+            atomic_store_explicit(&_histograms[stage].buckets[i], 0, memory_order_relaxed);
+    }
+}
+
+@end
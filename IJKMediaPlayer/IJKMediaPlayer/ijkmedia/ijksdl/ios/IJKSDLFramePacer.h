@@ -0,0 +1,58 @@
+/*
+ * IJKSDLFramePacer.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <QuartzCore/QuartzCore.h>
+
+// Follows the display refresh with a CADisplayLink on behalf of a render view.
+//
+// The link asks the panel for a rate the content divides (24 fps content
+// runs a ProMotion panel at 48 or 120 Hz instead of 60), and the vsync grid
+// it reports gives each present the minimum time its former frame has to
+// stay on screen, so frames arriving a bit early or late still land on a
+// steady vsync cadence. Rates above 60 Hz on iPhone also need
+// CADisableMinimumFrameDurationOnPhone in the app's Info.plist.
+//
+// start/stop on the main thread, the rest from any thread.
+@interface IJKSDLFramePacer : NSObject
+
+- (void)start;
+- (void)stop;
+
+// frames per second of the video, 0 if unknown
+@property(atomic) CGFloat contentFrameRate;
+// frames per second the view shows at most, the others dropped before
+// they are rendered; 0 for no cap
+@property(atomic) CGFloat maximumFrameRate;
+
+// for presentRenderbuffer:afterMinimumDuration: and the like, 0 to present at once
+- (CFTimeInterval)minimumPresentDuration;
+// the time the frame shows on screen, the vsync it lands on if known
+- (CFTimeInterval)didPresentFrame;
+// YES if a frame given now comes too soon after the former one for maximumFrameRate
+- (BOOL)shouldDropFrame;
+
+// mean deviation of the frame on-screen durations from the content frame interval, in milliseconds
+@property(atomic, readonly) CGFloat judder;
+
+@end
@@ -0,0 +1,251 @@
+/*
+ * IJKSDLFramePacer.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLFramePacer.h"
+#import <UIKit/UIKit.h>
+
+// frames apart by more than this are a pause or a seek, not judder
+#define IJK_PACER_MAX_FRAME_DURATION    1.0
+#define IJK_PACER_SMOOTHING             0.1
+
+// CADisplayLink retains its target
+@interface IJKSDLFramePacerProxy : NSObject
+@property(nonatomic, weak) IJKSDLFramePacer *pacer;
+@end
+
+@interface IJKSDLFramePacer ()
+- (void)onDisplayLink:(CADisplayLink *)link;
+@end
+
+@implementation IJKSDLFramePacerProxy
+
+- (void)onDisplayLink:(CADisplayLink *)link
+{
+    [self.pacer onDisplayLink:link];
+}
+
+@end
+
+@implementation IJKSDLFramePacer {
+    CADisplayLink  *_displayLink;
+    NSInteger       _requestedRate;
+    NSLock         *_lock;
+
+    CFTimeInterval  _vsyncTime;
+    CFTimeInterval  _vsyncInterval;
+    CFTimeInterval  _lastLandedTime;
+    CFTimeInterval  _lastPresentTime;
+    CFTimeInterval  _averageDuration;
+    CGFloat         _judder;
+}
+
+@synthesize contentFrameRate = _contentFrameRate;
+@synthesize maximumFrameRate = _maximumFrameRate;
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _lock = [[NSLock alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_displayLink invalidate];
+}
+
+- (void)start
+{
+    if (_displayLink)
+        return;
+
+    IJKSDLFramePacerProxy *proxy = [[IJKSDLFramePacerProxy alloc] init];
+    proxy.pacer = self;
+    _displayLink = [CADisplayLink displayLinkWithTarget:proxy selector:@selector(onDisplayLink:)];
+    _requestedRate = -1;
+    [self updatePreferredRate];
+    [_displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+}
+
+- (void)stop
+{
+    [_displayLink invalidate];
+    _displayLink = nil;
+
+    [_lock lock];
+    _vsyncInterval   = 0;
+    _lastLandedTime  = 0;
+    _lastPresentTime = 0;
+    [_lock unlock];
+}
+
+- (void)setContentFrameRate:(CGFloat)contentFrameRate
+{
+    [_lock lock];
+    _contentFrameRate = contentFrameRate;
+    [_lock unlock];
+
+    [self scheduleUpdatePreferredRate];
+}
+
+- (void)setMaximumFrameRate:(CGFloat)maximumFrameRate
+{
+    [_lock lock];
+    _maximumFrameRate = maximumFrameRate;
+    [_lock unlock];
+
+    [self scheduleUpdatePreferredRate];
+}
+
+- (CGFloat)maximumFrameRate
+{
+    [_lock lock];
+    CGFloat rate = _maximumFrameRate;
+    [_lock unlock];
+    return rate;
+}
+
+- (void)scheduleUpdatePreferredRate
+{
+    if ([[NSThread currentThread] isMainThread]) {
+        [self updatePreferredRate];
+    } else {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self updatePreferredRate];
+        });
+    }
+}
+
+- (CGFloat)contentFrameRate
+{
+    [_lock lock];
+    CGFloat rate = _contentFrameRate;
+    [_lock unlock];
+    return rate;
+}
+
+// the panel picks a refresh rate the content divides, 0 leaves it native;
+// under a cap the content rate is the one shown
+- (void)updatePreferredRate
+{
+    if (!_displayLink)
+        return;
+
+    NSInteger rate = lround(self.contentFrameRate);
+    NSInteger cap  = lround(self.maximumFrameRate);
+    if (cap > 0 && (rate <= 0 || rate > cap))
+        rate = cap;
+    if (rate == _requestedRate)
+        return;
+    _requestedRate = rate;
+
+    NSInteger maxRate = [UIScreen mainScreen].maximumFramesPerSecond;
+    if (rate > maxRate)
+        rate = 0;
+
+    if (@available(iOS 15.0, *)) {
+        if (rate > 0)
+            _displayLink.preferredFrameRateRange = CAFrameRateRangeMake(rate, maxRate, rate);
+        else
+            _displayLink.preferredFrameRateRange = CAFrameRateRangeDefault;
+    } else {
+        _displayLink.preferredFramesPerSecond = rate;
+    }
+}
+
+- (void)onDisplayLink:(CADisplayLink *)link
+{
+    [_lock lock];
+    _vsyncTime     = link.targetTimestamp;
+    _vsyncInterval = link.targetTimestamp - link.timestamp;
+    [_lock unlock];
+}
+
+- (CFTimeInterval)minimumPresentDuration
+{
+    [_lock lock];
+    CFTimeInterval duration = 0;
+    // half a vsync of slack, a frame due a little early still keeps its slot
+    if (_contentFrameRate > 0 && _vsyncInterval > 0)
+        duration = MAX(1.0 / _contentFrameRate - _vsyncInterval / 2, 0);
+    [_lock unlock];
+    return duration;
+}
+
+- (CFTimeInterval)didPresentFrame
+{
+    CFTimeInterval now = CACurrentMediaTime();
+    CFTimeInterval landed = now;
+
+    [_lock lock];
+    _lastPresentTime = now;
+    if (_vsyncInterval > 0) {
+        // the vsync the frame shows at: the next one, but not before the
+        // former frame had its minimum duration
+        CFTimeInterval earliest = now;
+        if (_contentFrameRate > 0 && _lastLandedTime > 0)
+            earliest = MAX(earliest, _lastLandedTime + MAX(1.0 / _contentFrameRate - _vsyncInterval / 2, 0));
+        landed = _vsyncTime + ceil((earliest - _vsyncTime) / _vsyncInterval) * _vsyncInterval;
+
+        CFTimeInterval duration = landed - _lastLandedTime;
+        if (_lastLandedTime > 0 && duration > 0 && duration < IJK_PACER_MAX_FRAME_DURATION) {
+            if (_averageDuration <= 0)
+                _averageDuration = duration;
+            _averageDuration += (duration - _averageDuration) * IJK_PACER_SMOOTHING;
+
+            CGFloat shownRate = _contentFrameRate;
+            if (_maximumFrameRate > 0 && shownRate > _maximumFrameRate)
+                shownRate = _maximumFrameRate;
+            CFTimeInterval expected = shownRate > 0 ? 1.0 / shownRate : _averageDuration;
+            _judder += (fabs(duration - expected) * 1000 - _judder) * IJK_PACER_SMOOTHING;
+        }
+        _lastLandedTime = landed;
+    }
+    [_lock unlock];
+    return landed;
+}
+
+- (BOOL)shouldDropFrame
+{
+    CFTimeInterval now = CACurrentMediaTime();
+
+    [_lock lock];
+    BOOL drop = NO;
+    // the same half vsync of slack: 60 fps capped to 30 keeps every other frame
+    if (_maximumFrameRate > 0 && _lastPresentTime > 0)
+        drop = now - _lastPresentTime < 1.0 / _maximumFrameRate - _vsyncInterval / 2;
+    [_lock unlock];
+    return drop;
+}
+
+- (CGFloat)judder
+{
+    [_lock lock];
+    CGFloat judder = _judder;
+    [_lock unlock];
+    return judder;
+}
+
+@end
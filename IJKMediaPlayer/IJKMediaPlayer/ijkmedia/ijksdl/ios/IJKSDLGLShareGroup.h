@@ -0,0 +1,52 @@
+/*
+ * IJKSDLGLShareGroup.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <OpenGLES/EAGL.h>
+#import <OpenGLES/ES2/gl.h>
+
+#include "ijksdl/ijksdl_gles2.h"
+#include "ijksdl/ijksdl_vout.h"
+
+// One EAGL sharegroup for the GL views of the process, so that what one of
+// them links is there for the others, and pools of what they link in it.
+// Linking the shaders of a renderer again for every view, and again for
+// every format change, is most of what setting up a view costs.
+//
+// A view takes a program, or a renderer for the format of its overlays,
+// which an earlier view linked if one is free, and gives it back when done
+// with it. One view at a time owns what it took, uniforms included.
+//
+// All but ijk_gl_context_create() with a context of the sharegroup current.
+
+EAGLContext *ijk_gl_context_create(void);
+
+// link is called to link a new program when none of key is free; keys are
+// string literals
+typedef GLuint (^IJKGLProgramLink)(void);
+GLuint ijk_gl_program_take(const char *key, IJKGLProgramLink link);
+void   ijk_gl_program_give(const char *key, GLuint program);
+
+// IJK_GLES2_Renderer_use() before drawing with a renderer taken
+IJK_GLES2_Renderer *ijk_gl_renderer_take(SDL_VoutOverlay *overlay);
+void                ijk_gl_renderer_givep(IJK_GLES2_Renderer **renderer);
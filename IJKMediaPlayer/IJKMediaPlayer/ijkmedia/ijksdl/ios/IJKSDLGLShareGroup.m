@@ -0,0 +1,148 @@
+/*
+ * IJKSDLGLShareGroup.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLGLShareGroup.h"
+#include <pthread.h>
+#include <string.h>
+
+// programs and renderers parked, over all keys and formats; a renderer keeps
+// the textures of its last frame
+#define IJK_GL_POOL_MAX 8
+
+typedef struct IJKGLPoolEntry {
+    const char         *key;        // NULL for a renderer
+    GLuint              program;
+    IJK_GLES2_Renderer *renderer;
+} IJKGLPoolEntry;
+
+static pthread_mutex_t g_gl_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static IJKGLPoolEntry  g_gl_pool[IJK_GL_POOL_MAX];
+static int             g_gl_pool_count = 0;
+
+// never current anywhere, it keeps the sharegroup and what is parked in it
+// alive between views
+static EAGLContext *g_gl_root_context = nil;
+
+EAGLContext *ijk_gl_context_create(void)
+{
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        g_gl_root_context = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+    });
+    if (!g_gl_root_context)
+        return [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+
+    return [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2
+                                 sharegroup:g_gl_root_context.sharegroup];
+}
+
+static void gl_pool_remove(int i)
+{
+    g_gl_pool_count--;
+    g_gl_pool[i] = g_gl_pool[g_gl_pool_count];
+}
+
+static bool gl_pool_add(IJKGLPoolEntry entry)
+{
+    bool taken = false;
+
+    pthread_mutex_lock(&g_gl_pool_mutex);
+    if (g_gl_pool_count < IJK_GL_POOL_MAX) {
+        g_gl_pool[g_gl_pool_count++] = entry;
+        taken = true;
+    }
+    pthread_mutex_unlock(&g_gl_pool_mutex);
+    return taken;
+}
+
+GLuint ijk_gl_program_take(const char *key, IJKGLProgramLink link)
+{
+    GLuint program = 0;
+
+    pthread_mutex_lock(&g_gl_pool_mutex);
+    for (int i = g_gl_pool_count - 1; i >= 0; i--) {
+        if (!g_gl_pool[i].key || strcmp(g_gl_pool[i].key, key))
+            continue;
+        program = g_gl_pool[i].program;
+        gl_pool_remove(i);
+        break;
+    }
+    pthread_mutex_unlock(&g_gl_pool_mutex);
+    if (program)
+        return program;
+
+    program = link();
+    // the other contexts see an object once the one which made it flushed
+    if (program)
+        glFlush();
+    return program;
+}
+
+void ijk_gl_program_give(const char *key, GLuint program)
+{
+    if (!program)
+        return;
+
+    IJKGLPoolEntry entry = { key, program, NULL };
+    if (gl_pool_add(entry))
+        glFlush();
+    else
+        glDeleteProgram(program);
+}
+
+IJK_GLES2_Renderer *ijk_gl_renderer_take(SDL_VoutOverlay *overlay)
+{
+    IJK_GLES2_Renderer *renderer = NULL;
+
+    pthread_mutex_lock(&g_gl_pool_mutex);
+    for (int i = g_gl_pool_count - 1; i >= 0; i--) {
+        if (g_gl_pool[i].key || !IJK_GLES2_Renderer_isFormat(g_gl_pool[i].renderer, overlay->format))
+            continue;
+        renderer = g_gl_pool[i].renderer;
+        gl_pool_remove(i);
+        break;
+    }
+    pthread_mutex_unlock(&g_gl_pool_mutex);
+    if (renderer)
+        return renderer;
+
+    renderer = IJK_GLES2_Renderer_create(overlay);
+    if (renderer)
+        glFlush();
+    return renderer;
+}
+
+void ijk_gl_renderer_givep(IJK_GLES2_Renderer **renderer)
+{
+    if (!renderer || !*renderer)
+        return;
+
+    IJKGLPoolEntry entry = { NULL, 0, *renderer };
+    if (IJK_GLES2_Renderer_isValid(*renderer) && gl_pool_add(entry)) {
+        glFlush();
+        *renderer = NULL;
+        return;
+    }
+    IJK_GLES2_Renderer_reset(*renderer);
+    IJK_GLES2_Renderer_freeP(renderer);
+}
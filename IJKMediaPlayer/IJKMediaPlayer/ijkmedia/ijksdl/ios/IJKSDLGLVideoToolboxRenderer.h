@@ -0,0 +1,58 @@
+/*
+ * IJKSDLGLVideoToolboxRenderer.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <OpenGLES/EAGL.h>
+#import <CoreVideo/CoreVideo.h>
+
+#include "ijksdl/ijksdl_vout.h"
+
+// Renders SDL_FCC__VTB overlays by mapping the NV12 planes of the
+// CVPixelBuffer straight into GL textures.
+// The texture cache lives as long as the renderer and is only flushed
+// when the frame size or pixel format changes.
+@interface IJKSDLGLVideoToolboxRenderer : NSObject
+
+// must be called with context being current
+- (instancetype)initWithContext:(EAGLContext *)context;
+
+- (void)setGravity:(int)gravity backingWidth:(GLint)backingWidth backingHeight:(GLint)backingHeight;
+
+// the frame of a SDL_FCC__VTB overlay, retained by the caller for the call;
+// pixelBuffer could be NULL to redraw the last frame
+- (BOOL)renderPixelBuffer:(CVPixelBufferRef)pixelBuffer
+                    width:(int)width
+                   height:(int)height
+                   sarNum:(int)sarNum
+                   sarDen:(int)sarDen;
+
+// frames mapped through the live texture cache
+@property(nonatomic, readonly) int64_t textureCacheHits;
+// frames which had to (re)build the cache or failed to map
+@property(nonatomic, readonly) int64_t textureCacheMisses;
+
+// must be called with context being current; releases the textures the
+// cache keeps for reuse, not the ones of the last frame
+- (void)flushTextureCache;
+
+@end
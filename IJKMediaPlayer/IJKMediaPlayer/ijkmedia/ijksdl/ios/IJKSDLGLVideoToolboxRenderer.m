@@ -0,0 +1,407 @@
+/*
+ * IJKSDLGLVideoToolboxRenderer.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLGLVideoToolboxRenderer.h"
+#import "IJKSDLGLShareGroup.h"
+#import <CoreVideo/CoreVideo.h>
+#import <OpenGLES/ES2/gl.h>
+#import <OpenGLES/ES2/glext.h>
+#include "ijksdl/ijksdl_gles2.h"
+#include "ijksdl/ijksdl_log.h"
+
+#define IJK_VTB_TEXTURE_POOL_SIZE 2
+#define IJK_VTB_PROGRAM_KEY       "vtb-nv12"
+
+static const char g_vtb_vertex_shader[] =
+    "attribute highp vec4 av4_Position;\n"
+    "attribute highp vec2 av2_Texcoord;\n"
+    "varying   highp vec2 vv2_Texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position  = av4_Position;\n"
+    "    vv2_Texcoord = av2_Texcoord.xy;\n"
+    "}\n";
+
+static const char g_vtb_fragment_shader[] =
+    "precision highp float;\n"
+    "varying   highp vec2 vv2_Texcoord;\n"
+    "uniform         mat3 um3_ColorConversion;\n"
+    "uniform         float uf_LumaOffset;\n"
+    "uniform   lowp  sampler2D us2_SamplerX;\n"
+    "uniform   lowp  sampler2D us2_SamplerY;\n"
+    "void main()\n"
+    "{\n"
+    "    mediump vec3 yuv;\n"
+    "    lowp    vec3 rgb;\n"
+    "    yuv.x  = texture2D(us2_SamplerX, vv2_Texcoord).r - uf_LumaOffset;\n"
+    "    yuv.yz = texture2D(us2_SamplerY, vv2_Texcoord).rg - vec2(0.5, 0.5);\n"
+    "    rgb = um3_ColorConversion * yuv;\n"
+    "    gl_FragColor = vec4(rgb, 1);\n"
+    "}\n";
+
+// column major
+static const GLfloat g_bt601_video_range[] = {
+    1.164,  1.164,  1.164,
+    0.0,   -0.392,  2.017,
+    1.596, -0.813,  0.0,
+};
+
+static const GLfloat g_bt601_full_range[] = {
+    1.0,    1.0,    1.0,
+    0.0,   -0.343,  1.765,
+    1.4,   -0.711,  0.0,
+};
+
+static const GLfloat g_bt709_video_range[] = {
+    1.164,  1.164,  1.164,
+    0.0,   -0.213,  2.112,
+    1.793, -0.533,  0.0,
+};
+
+static const GLfloat g_bt709_full_range[] = {
+    1.0,    1.0,    1.0,
+    0.0,   -0.187,  1.856,
+    1.575, -0.468,  0.0,
+};
+
+static GLuint vtb_load_shader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    if (!shader)
+        return 0;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        ALOGE("[VTB] failed to compile shader\n");
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+@implementation IJKSDLGLVideoToolboxRenderer {
+    CVOpenGLESTextureCacheRef _textureCache;
+    CVOpenGLESTextureRef      _texturePool[IJK_VTB_TEXTURE_POOL_SIZE][2];
+    int                       _texturePoolIndex;
+    BOOL                      _hasFrame;
+
+    int                       _cacheWidth;
+    int                       _cacheHeight;
+    OSType                    _cachePixelFormat;
+
+    GLuint                    _program;
+    GLint                     _av4Position;
+    GLint                     _av2Texcoord;
+    GLint                     _um3ColorConversion;
+    GLint                     _ufLumaOffset;
+    GLint                     _us2Sampler[2];
+
+    int                       _gravity;
+    GLint                     _backingWidth;
+    GLint                     _backingHeight;
+    int                       _frameWidth;
+    int                       _frameHeight;
+    int                       _frameSarNum;
+    int                       _frameSarDen;
+    int                       _framePitch;
+    BOOL                      _verticesChanged;
+    GLfloat                   _vertices[8];
+    GLfloat                   _texcoords[8];
+}
+
+- (instancetype)initWithContext:(EAGLContext *)context
+{
+    self = [super init];
+    if (self) {
+        CVReturn err = CVOpenGLESTextureCacheCreate(kCFAllocatorDefault, NULL, context, NULL, &_textureCache);
+        if (err || _textureCache == NULL) {
+            ALOGE("[VTB] CVOpenGLESTextureCacheCreate failed: %d\n", err);
+            return nil;
+        }
+
+        if (![self setupProgram])
+            return nil;
+
+        _gravity         = IJK_GLES2_GRAVITY_RESIZE_ASPECT;
+        _verticesChanged = YES;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self releaseTexturePool];
+
+    if (_textureCache) {
+        CVOpenGLESTextureCacheFlush(_textureCache, 0);
+        CFRelease(_textureCache);
+        _textureCache = NULL;
+    }
+
+    ijk_gl_program_give(IJK_VTB_PROGRAM_KEY, _program);
+}
+
+- (BOOL)setupProgram
+{
+    _program = ijk_gl_program_take(IJK_VTB_PROGRAM_KEY, ^GLuint {
+        GLuint vertexShader   = vtb_load_shader(GL_VERTEX_SHADER, g_vtb_vertex_shader);
+        GLuint fragmentShader = vtb_load_shader(GL_FRAGMENT_SHADER, g_vtb_fragment_shader);
+        GLuint program        = (vertexShader && fragmentShader) ? glCreateProgram() : 0;
+        if (program) {
+            glAttachShader(program, vertexShader);
+            glAttachShader(program, fragmentShader);
+            glLinkProgram(program);
+
+            GLint status = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            if (!status) {
+                ALOGE("[VTB] failed to link program\n");
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+        // flagged for deletion, they go with the program
+        if (vertexShader)
+            glDeleteShader(vertexShader);
+        if (fragmentShader)
+            glDeleteShader(fragmentShader);
+        return program;
+    });
+    if (!_program)
+        return NO;
+
+    _av4Position        = glGetAttribLocation(_program, "av4_Position");
+    _av2Texcoord        = glGetAttribLocation(_program, "av2_Texcoord");
+    _um3ColorConversion = glGetUniformLocation(_program, "um3_ColorConversion");
+    _ufLumaOffset       = glGetUniformLocation(_program, "uf_LumaOffset");
+    _us2Sampler[0]      = glGetUniformLocation(_program, "us2_SamplerX");
+    _us2Sampler[1]      = glGetUniformLocation(_program, "us2_SamplerY");
+    return YES;
+}
+
+- (void)releaseTexturePool
+{
+    for (int i = 0; i < IJK_VTB_TEXTURE_POOL_SIZE; ++i) {
+        for (int plane = 0; plane < 2; ++plane) {
+            if (_texturePool[i][plane]) {
+                CFRelease(_texturePool[i][plane]);
+                _texturePool[i][plane] = NULL;
+            }
+        }
+    }
+    _hasFrame = NO;
+}
+
+- (void)flushTextureCache
+{
+    if (_textureCache)
+        CVOpenGLESTextureCacheFlush(_textureCache, 0);
+}
+
+- (void)setGravity:(int)gravity backingWidth:(GLint)backingWidth backingHeight:(GLint)backingHeight
+{
+    if (_gravity != gravity || _backingWidth != backingWidth || _backingHeight != backingHeight)
+        _verticesChanged = YES;
+
+    _gravity       = gravity;
+    _backingWidth  = backingWidth;
+    _backingHeight = backingHeight;
+}
+
+- (void)updateVertices
+{
+    float nW = 1.0f;
+    float nH = 1.0f;
+
+    if (_gravity != IJK_GLES2_GRAVITY_RESIZE &&
+        _frameWidth > 0 && _frameHeight > 0 && _backingWidth > 0 && _backingHeight > 0) {
+        float width  = _frameWidth;
+        float height = _frameHeight;
+        if (_frameSarNum > 0 && _frameSarDen > 0)
+            width = width * _frameSarNum / _frameSarDen;
+
+        float dW = _backingWidth  / width;
+        float dH = _backingHeight / height;
+        float dd = (_gravity == IJK_GLES2_GRAVITY_RESIZE_ASPECT_FILL) ? MAX(dW, dH) : MIN(dW, dH);
+
+        nW = (width  * dd / (float)_backingWidth);
+        nH = (height * dd / (float)_backingHeight);
+    }
+
+    _vertices[0] = -nW; _vertices[1] = -nH;
+    _vertices[2] =  nW; _vertices[3] = -nH;
+    _vertices[4] = -nW; _vertices[5] =  nH;
+    _vertices[6] =  nW; _vertices[7] =  nH;
+
+    // crop the padding on the right of each plane
+    float cropRight = 1.0f;
+    if (_framePitch > _frameWidth && _framePitch > 0)
+        cropRight = (float)_frameWidth / (float)_framePitch;
+
+    _texcoords[0] = 0.0f;      _texcoords[1] = 1.0f;
+    _texcoords[2] = cropRight; _texcoords[3] = 1.0f;
+    _texcoords[4] = 0.0f;      _texcoords[5] = 0.0f;
+    _texcoords[6] = cropRight; _texcoords[7] = 0.0f;
+
+    _verticesChanged = NO;
+}
+
+- (void)uploadColorConversion:(CVPixelBufferRef)pixelBuffer
+{
+    CFTypeRef colorAttachments = CVBufferGetAttachment(pixelBuffer, kCVImageBufferYCbCrMatrixKey, NULL);
+    OSType    pixelFormat      = CVPixelBufferGetPixelFormatType(pixelBuffer);
+    BOOL      isFullRange      = (pixelFormat == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange);
+    BOOL      isBT709          = (colorAttachments == NULL ||
+                                  CFStringCompare(colorAttachments, kCVImageBufferYCbCrMatrix_ITU_R_709_2, 0) == kCFCompareEqualTo);
+
+    const GLfloat *matrix = NULL;
+    if (isBT709)
+        matrix = isFullRange ? g_bt709_full_range : g_bt709_video_range;
+    else
+        matrix = isFullRange ? g_bt601_full_range : g_bt601_video_range;
+
+    glUniformMatrix3fv(_um3ColorConversion, 1, GL_FALSE, matrix);
+    glUniform1f(_ufLumaOffset, isFullRange ? 0.0f : 16.0f / 255.0f);
+}
+
+- (BOOL)mapPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    int    width       = (int)CVPixelBufferGetWidth(pixelBuffer);
+    int    height      = (int)CVPixelBufferGetHeight(pixelBuffer);
+    OSType pixelFormat = CVPixelBufferGetPixelFormatType(pixelBuffer);
+
+    if (width != _cacheWidth || height != _cacheHeight || pixelFormat != _cachePixelFormat) {
+        // resolution change: drop every texture backed by the old surfaces
+        [self releaseTexturePool];
+        CVOpenGLESTextureCacheFlush(_textureCache, 0);
+
+        _cacheWidth       = width;
+        _cacheHeight      = height;
+        _cachePixelFormat = pixelFormat;
+        _textureCacheMisses++;
+    } else {
+        _textureCacheHits++;
+    }
+
+    // keep the previous frame alive while the GPU may still sample it
+    int index = (_texturePoolIndex + 1) % IJK_VTB_TEXTURE_POOL_SIZE;
+    for (int plane = 0; plane < 2; ++plane) {
+        if (_texturePool[index][plane]) {
+            CFRelease(_texturePool[index][plane]);
+            _texturePool[index][plane] = NULL;
+        }
+    }
+
+    for (int plane = 0; plane < 2; ++plane) {
+        GLsizei planeWidth  = (GLsizei)CVPixelBufferGetWidthOfPlane(pixelBuffer, plane);
+        GLsizei planeHeight = (GLsizei)CVPixelBufferGetHeightOfPlane(pixelBuffer, plane);
+        GLenum  format      = plane == 0 ? GL_RED_EXT : GL_RG_EXT;
+
+        CVReturn err = CVOpenGLESTextureCacheCreateTextureFromImage(kCFAllocatorDefault,
+                                                                    _textureCache,
+                                                                    pixelBuffer,
+                                                                    NULL,
+                                                                    GL_TEXTURE_2D,
+                                                                    format,
+                                                                    planeWidth,
+                                                                    planeHeight,
+                                                                    format,
+                                                                    GL_UNSIGNED_BYTE,
+                                                                    plane,
+                                                                    &_texturePool[index][plane]);
+        if (err != kCVReturnSuccess) {
+            ALOGE("[VTB] CVOpenGLESTextureCacheCreateTextureFromImage(%d) failed: %d\n", plane, err);
+            _textureCacheMisses++;
+            return NO;
+        }
+
+        glBindTexture(CVOpenGLESTextureGetTarget(_texturePool[index][plane]),
+                      CVOpenGLESTextureGetName(_texturePool[index][plane]));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    _texturePoolIndex = index;
+    _hasFrame = YES;
+    return YES;
+}
+
+- (BOOL)renderPixelBuffer:(CVPixelBufferRef)pixelBuffer
+                    width:(int)width
+                   height:(int)height
+                   sarNum:(int)sarNum
+                   sarDen:(int)sarDen
+{
+    glUseProgram(_program);
+
+    if (pixelBuffer) {
+        int pitch = (int)CVPixelBufferGetWidthOfPlane(pixelBuffer, 0);
+        if (_frameWidth != width || _frameHeight != height ||
+            _frameSarNum != sarNum || _frameSarDen != sarDen ||
+            _framePitch != pitch) {
+            _frameWidth  = width;
+            _frameHeight = height;
+            _frameSarNum = sarNum;
+            _frameSarDen = sarDen;
+            _framePitch  = pitch;
+            _verticesChanged = YES;
+        }
+
+        if (![self mapPixelBuffer:pixelBuffer])
+            return NO;
+
+        [self uploadColorConversion:pixelBuffer];
+    }
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!_hasFrame)
+        return YES;
+
+    if (_verticesChanged)
+        [self updateVertices];
+
+    for (int plane = 0; plane < 2; ++plane) {
+        CVOpenGLESTextureRef texture = _texturePool[_texturePoolIndex][plane];
+        glActiveTexture(GL_TEXTURE0 + plane);
+        glBindTexture(CVOpenGLESTextureGetTarget(texture), CVOpenGLESTextureGetName(texture));
+        glUniform1i(_us2Sampler[plane], plane);
+    }
+
+    glVertexAttribPointer(_av4Position, 2, GL_FLOAT, GL_FALSE, 0, _vertices);
+    glEnableVertexAttribArray(_av4Position);
+    glVertexAttribPointer(_av2Texcoord, 2, GL_FLOAT, GL_FALSE, 0, _texcoords);
+    glEnableVertexAttribArray(_av2Texcoord);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    return YES;
+}
+
+@end
@@ -26,18 +26,39 @@
 #import <UIKit/UIKit.h>
 
 #include "ijksdl/ijksdl_vout.h"
+#import "IJKSDLRenderView.h"
 
-@interface IJKSDLGLView : UIView
+@interface IJKSDLGLView : UIView <IJKSDLRenderView>
 
 - (id) initWithFrame:(CGRect)frame;
 - (void) display: (SDL_VoutOverlay *) overlay;
 
 - (UIImage*) snapshot;
+- (void) captureFrame: (void (^)(UIImage *image)) completion;
+- (void) setFrameOutputHandler: (void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts)) handler
+                         queue: (dispatch_queue_t) queue
+                 frameInterval: (NSUInteger) frameInterval
+              maximumFrameRate: (CGFloat) maximumFrameRate;
 - (void)setHudValue:(NSString *)value forKey:(NSString *)key;
 - (void)setShouldLockWhileBeingMovedToWindow:(BOOL)shouldLockWhiteBeingMovedToWindow __attribute__((deprecated("unused")));
 
 @property(nonatomic, readonly)        CGFloat  fps;
 @property(nonatomic)        CGFloat  scaleFactor;
 @property(nonatomic)        BOOL     shouldShowHudView;
+@property(nonatomic)        CGFloat  contentFrameRate;
+@property(nonatomic)        CGFloat  maximumFrameRate;
+@property(nonatomic, readonly) CGFloat judder;
+@property(nonatomic, readonly) int64_t droppedPresents;
+@property(nonatomic, readonly) int64_t presentedFrames;
+@property(atomic)              BOOL    prefersPixelBufferOverlays;
+
+// VideoToolbox texture cache counters
+@property(nonatomic, readonly) int64_t textureCacheHits;
+@property(nonatomic, readonly) int64_t textureCacheMisses;
+@property(nonatomic, readonly) IJKSDLFrameLatency *frameLatency;
+@property(nonatomic, readonly) IJKSDLSubtitleOverlay *subtitleOverlay;
+@property(nonatomic, copy)     void (^displaySizeHandler)(CGSize pixelSize);
+@property(atomic, copy)        void (^presentHandler)(NSTimeInterval pts);
+@property(atomic, strong)      IJKSDLSyncProbe *syncProbe;
 
 @end
@@ -26,8 +26,16 @@
 #import "IJKSDLGLView.h"
 #include "ijksdl/ijksdl_timer.h"
 #include "ijksdl/ios/ijksdl_ios.h"
+#include "ijksdl/ios/ijksdl_evlog_ios.h"
 #include "ijksdl/ijksdl_gles2.h"
 #import "IJKSDLHudViewController.h"
+#import "IJKSDLGLVideoToolboxRenderer.h"
+#import "IJKSDLGLShareGroup.h"
+#import "IJKSDLFramePacer.h"
+#import "IJKSDLFrameCapture.h"
+#import "IJKSDLSubtitleOverlay.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#include <stdatomic.h>
 
 typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     IJKSDLGLViewApplicationUnknownState = 0,
@@ -35,10 +43,50 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     IJKSDLGLViewApplicationBackgroundState = 2
 };
 
-@interface IJKSDLGLView()
-@property(atomic,strong) NSRecursiveLock *glActiveLock;
-@property(atomic) BOOL glActivePaused;
-@end
+// a VideoToolbox frame waiting for the render queue
+typedef struct IJKSDLGLFrame {
+    CVPixelBufferRef pixelBuffer;
+    int              width;
+    int              height;
+    int              sarNum;
+    int              sarDen;
+} IJKSDLGLFrame;
+
+static void IJKSDLGLFrame_free(IJKSDLGLFrame *frame)
+{
+    if (!frame)
+        return;
+    CVPixelBufferRelease(frame->pixelBuffer);
+    free(frame);
+}
+
+static void *kIJKSDLGLRenderQueueKey = &kIJKSDLGLRenderQueueKey;
+
+// subtitles over the video, out of the premultiplied atlas
+static const char g_subtitle_vertex_shader[] =
+    "attribute highp vec4 av4_Position;\n"
+    "attribute highp vec2 av2_Texcoord;\n"
+    "varying   highp vec2 vv2_Texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position  = av4_Position;\n"
+    "    vv2_Texcoord = av2_Texcoord.xy;\n"
+    "}\n";
+
+static const char g_subtitle_fragment_shader[] =
+    "varying   highp vec2 vv2_Texcoord;\n"
+    "uniform   lowp  sampler2D us2_Atlas;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = texture2D(us2_Atlas, vv2_Texcoord);\n"
+    "}\n";
+
+// out of the way of the video renderers, which set their attributes and
+// textures only when they change
+#define IJK_SUBTITLE_ATTRIB_POSITION    6
+#define IJK_SUBTITLE_ATTRIB_TEXCOORD    7
+#define IJK_SUBTITLE_TEXTURE_UNIT       3
+#define IJK_SUBTITLE_PROGRAM_KEY        "subtitle"
 
 @implementation IJKSDLGLView {
     EAGLContext     *_context;
@@ -54,17 +102,41 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     IJK_GLES2_Renderer *_renderer;
     int                 _rendererGravity;
 
+    IJKSDLGLVideoToolboxRenderer *_vtbRenderer;
+    BOOL                          _isVTBRendering;
+
     BOOL            _isRenderBufferInvalidated;
 
-    int             _tryLockErrorCount;
+    // owns the EAGL context: every GL call, app state change and snapshot
+    // readback runs on it, in order, so none of them waits on a lock
+    dispatch_queue_t _renderQueue;
+    // the latest VideoToolbox frame not rendered yet; a newer one replaces it
+    _Atomic(IJKSDLGLFrame *) _mailbox;
+    _Atomic(int64_t) _droppedPresents;
+    _Atomic(int64_t) _presentedFrames;
+    _Atomic(int64_t) _textureBytes;
+
     BOOL            _didSetupGL;
     BOOL            _didStopGL;
-    BOOL            _didLockedDueToMovedToWindow;
-    BOOL            _shouldLockWhileBeingMovedToWindow;
+    BOOL            _glPaused;
     NSMutableArray *_registeredNotifications;
 
     IJKSDLHudViewController *_hudViewController;
     IJKSDLGLViewApplicationState _applicationState;
+
+    IJKSDLFramePacer *_pacer;
+    IJKSDLFrameCapture *_capture;
+
+    // of the last frame, to place the subtitles
+    int             _frameWidth;
+    int             _frameHeight;
+    int             _frameSarNum;
+    int             _frameSarDen;
+
+    GLuint          _subtitleProgram;
+    GLuint          _subtitleTexture;
+
+    CGSize          _displaySize;
 }
 
 + (Class) layerClass
@@ -76,42 +148,58 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 {
     self = [super initWithFrame:frame];
     if (self) {
-        _tryLockErrorCount = 0;
-        _shouldLockWhileBeingMovedToWindow = YES;
-        self.glActiveLock = [[NSRecursiveLock alloc] init];
+        dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INTERACTIVE, 0);
+        _renderQueue = dispatch_queue_create("tv.danmaku.ijk.gl-render", attr);
+        dispatch_queue_set_specific(_renderQueue, kIJKSDLGLRenderQueueKey, (__bridge void *)self, NULL);
+        atomic_init(&_mailbox, NULL);
+        atomic_init(&_droppedPresents, 0);
+        atomic_init(&_presentedFrames, 0);
+        atomic_init(&_textureBytes, 0);
+
         _registeredNotifications = [[NSMutableArray alloc] init];
         [self registerApplicationObservers];
 
+        // the context and framebuffer wait for the first frame
         _didSetupGL = NO;
-        [self setupGLOnce];
+
+        _pacer = [[IJKSDLFramePacer alloc] init];
+        _frameLatency = [[IJKSDLFrameLatency alloc] init];
+        _capture = [[IJKSDLFrameCapture alloc] init];
+
+        _subtitleOverlay = [[IJKSDLSubtitleOverlay alloc] init];
+        __weak typeof(self) weakSelf = self;
+        _subtitleOverlay.changeHandler = ^{
+            IJKSDLGLView *strongSelf = weakSelf;
+            if (!strongSelf)
+                return;
+            dispatch_async(strongSelf->_renderQueue, ^{
+                [weakSelf renderOverlay:NULL frame:NULL];
+            });
+        };
 
         _hudViewController = [[IJKSDLHudViewController alloc] init];
-        [self addSubview:_hudViewController.tableView];
+        [self addSubview:_hudViewController.view];
     }
 
     return self;
 }
 
-- (void)willMoveToWindow:(UIWindow *)newWindow
+- (void)didMoveToWindow
 {
-    if (!_shouldLockWhileBeingMovedToWindow) {
-        [super willMoveToWindow:newWindow];
-        return;
-    }
-    if (newWindow && !_didLockedDueToMovedToWindow) {
-        [self lockGLActive];
-        _didLockedDueToMovedToWindow = YES;
-    }
-    [super willMoveToWindow:newWindow];
+    [super didMoveToWindow];
+    if (self.window)
+        [_pacer start];
+    else
+        [_pacer stop];
 }
 
-- (void)didMoveToWindow
+// runs block on the render queue and waits, inline if already on it
+- (void)performOnRenderQueue:(dispatch_block_t)block
 {
-    [super didMoveToWindow];
-    if (self.window && _didLockedDueToMovedToWindow) {
-        [self unlockGLActive];
-        _didLockedDueToMovedToWindow = NO;
-    }
+    if (dispatch_get_specific(kIJKSDLGLRenderQueueKey) == (__bridge void *)self)
+        block();
+    else
+        dispatch_sync(_renderQueue, block);
 }
 
 - (BOOL)setupEAGLContext:(EAGLContext *)context
@@ -166,7 +254,7 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 
     [eaglLayer setContentsScale:_scaleFactor];
 
-    _context = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+    _context = ijk_gl_context_create();
     if (_context == nil) {
         NSLog(@"failed to setup EAGLContext\n");
         return NO;
@@ -190,15 +278,10 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     if (_didSetupGL)
         return YES;
 
-    if ([self isApplicationActive] == NO)
-        return NO;
-
-    if (![self tryLockGLActive])
+    if ([self isApplicationActive] == NO || _glPaused)
         return NO;
 
-    BOOL didSetupGL = [self setupGL];
-    [self unlockGLActive];
-    return didSetupGL;
+    return [self setupGL];
 }
 
 - (BOOL)isApplicationActive
@@ -224,15 +307,32 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 
 - (void)dealloc
 {
-    [self lockGLActive];
+    [self unregisterApplicationObservers];
+
+    [self performOnRenderQueue:^{
+        [self teardownGL];
+    }];
+
+    IJKSDLGLFrame_free(atomic_exchange(&_mailbox, NULL));
+}
 
+- (void)teardownGL
+{
     _didStopGL = YES;
 
     EAGLContext *prevContext = [EAGLContext currentContext];
     [EAGLContext setCurrentContext:_context];
     
-    IJK_GLES2_Renderer_reset(_renderer);
-    IJK_GLES2_Renderer_freeP(&_renderer);
+    ijk_gl_renderer_givep(&_renderer);
+    _vtbRenderer = nil;
+
+    ijk_gl_program_give(IJK_SUBTITLE_PROGRAM_KEY, _subtitleProgram);
+    _subtitleProgram = 0;
+
+    if (_subtitleTexture) {
+        glDeleteTextures(1, &_subtitleTexture);
+        _subtitleTexture = 0;
+    }
 
     if (_framebuffer) {
         glDeleteFramebuffers(1, &_framebuffer);
@@ -249,16 +349,44 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     [EAGLContext setCurrentContext:prevContext];
 
     _context = nil;
-
-    [self unregisterApplicationObservers];
-
-    [self unlockGLActive];
 }
 
 - (void)setScaleFactor:(CGFloat)scaleFactor
 {
     _scaleFactor = scaleFactor;
     [self invalidateRenderBuffer];
+    [self updateDisplaySize];
+}
+
+// main thread: the pixels the video is drawn in, for the decoder to scale to
+- (void)updateDisplaySize
+{
+    CGSize size = CGSizeMake(self.bounds.size.width * _scaleFactor, self.bounds.size.height * _scaleFactor);
+    if (CGSizeEqualToSize(size, _displaySize))
+        return;
+
+    _displaySize = size;
+    if (_displaySizeHandler)
+        _displaySizeHandler(size);
+}
+
+- (void)setDisplaySizeHandler:(void (^)(CGSize))displaySizeHandler
+{
+    _displaySizeHandler = [displaySizeHandler copy];
+    if (_displaySizeHandler && _displaySize.width > 0 && _displaySize.height > 0)
+        _displaySizeHandler(_displaySize);
+}
+
+// render thread
+- (void)didPresentPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    void (^presentHandler)(NSTimeInterval) = self.presentHandler;
+    if (!presentHandler)
+        return;
+
+    NSTimeInterval pts = SDL_VoutOverlayVideoToolBox_GetPresentationTime(pixelBuffer);
+    if (!isnan(pts))
+        presentHandler(pts);
 }
 
 - (void)layoutSubviews
@@ -274,8 +402,9 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     newFrame.size.height  = selfFrame.size.height * 8 / 8;
     newFrame.origin.y    += selfFrame.size.height * 0 / 8;
 
-    _hudViewController.tableView.frame = newFrame;
+    _hudViewController.view.frame = newFrame;
     [self invalidateRenderBuffer];
+    [self updateDisplaySize];
 }
 
 - (void)setContentMode:(UIViewContentMode)contentMode
@@ -307,10 +436,9 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     if (!IJK_GLES2_Renderer_isValid(_renderer) ||
         !IJK_GLES2_Renderer_isFormat(_renderer, overlay->format)) {
 
-        IJK_GLES2_Renderer_reset(_renderer);
-        IJK_GLES2_Renderer_freeP(&_renderer);
+        ijk_gl_renderer_givep(&_renderer);
 
-        _renderer = IJK_GLES2_Renderer_create(overlay);
+        _renderer = ijk_gl_renderer_take(overlay);
         if (!IJK_GLES2_Renderer_isValid(_renderer))
             return NO;
 
@@ -323,59 +451,202 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     return YES;
 }
 
+- (BOOL)setupVTBRenderer
+{
+    if (_vtbRenderer == nil) {
+        _vtbRenderer = [[IJKSDLGLVideoToolboxRenderer alloc] initWithContext:_context];
+        if (_vtbRenderer == nil)
+            return NO;
+    }
+
+    [_vtbRenderer setGravity:_rendererGravity backingWidth:_backingWidth backingHeight:_backingHeight];
+    return YES;
+}
+
+- (int64_t)textureCacheHits
+{
+    return _vtbRenderer.textureCacheHits;
+}
+
+- (int64_t)textureCacheMisses
+{
+    return _vtbRenderer.textureCacheMisses;
+}
+
 - (void)invalidateRenderBuffer
 {
     NSLog(@"invalidateRenderBuffer\n");
-    [self lockGLActive];
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        IJKSDLGLView *strongSelf = weakSelf;
+        if (!strongSelf)
+            return;
+        strongSelf->_isRenderBufferInvalidated = YES;
+        [strongSelf renderOverlay:NULL frame:NULL];
+    });
+}
 
-    _isRenderBufferInvalidated = YES;
+- (int64_t)droppedPresents
+{
+    return atomic_load(&_droppedPresents);
+}
 
-    if ([[NSThread currentThread] isMainThread]) {
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
-            if (_isRenderBufferInvalidated)
-                [self display:nil];
-        });
-    } else {
-        [self display:nil];
-    }
+- (int64_t)presentedFrames
+{
+    return atomic_load(&_presentedFrames);
+}
 
-    [self unlockGLActive];
+- (int64_t)textureBytes
+{
+    return atomic_load(&_textureBytes);
+}
+
+- (void)flushTextureCache
+{
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        IJKSDLGLView *strongSelf = weakSelf;
+        if (!strongSelf || !strongSelf->_vtbRenderer || !strongSelf->_context || strongSelf->_didStopGL)
+            return;
+
+        EAGLContext *prevContext = [EAGLContext currentContext];
+        [EAGLContext setCurrentContext:strongSelf->_context];
+        [strongSelf->_vtbRenderer flushTextureCache];
+        [EAGLContext setCurrentContext:prevContext];
+    });
+}
+
+- (void)releaseDrawables
+{
+    [_capture reset];
+    IJKSDLGLFrame_free(atomic_exchange(&_mailbox, NULL));
+    atomic_store(&_textureBytes, 0);
+    [self performOnRenderQueue:^{
+        if (!_didSetupGL)
+            return;
+        [self teardownGL];
+        [_subtitleOverlay invalidateTexture];
+        // the context and framebuffer wait for the next frame, as at first
+        _didSetupGL = NO;
+        _didStopGL  = NO;
+    }];
 }
 
 - (void)display: (SDL_VoutOverlay *) overlay
 {
-    if (![self setupGLOnce])
+    if (!overlay) {
+        [self performOnRenderQueue:^{
+            [self renderOverlay:NULL frame:NULL];
+        }];
         return;
+    }
 
-    if (![self tryLockGLActive]) {
-        if (0 == (_tryLockErrorCount % 100)) {
-            NSLog(@"IJKSDLGLView:display: unable to tryLock GL active: %d\n", _tryLockErrorCount);
-        }
-        _tryLockErrorCount++;
+    if ([_pacer shouldDropFrame]) {
+        atomic_fetch_add(&_droppedPresents, 1);
         return;
     }
 
-    _tryLockErrorCount = 0;
-    if (_context && !_didStopGL) {
-        EAGLContext *prevContext = [EAGLContext currentContext];
-        [EAGLContext setCurrentContext:_context];
-        [self displayInternal:overlay];
-        [EAGLContext setCurrentContext:prevContext];
+    atomic_store(&_textureBytes, (int64_t)overlay->w * overlay->h * 3 / 2);
+
+    if (overlay->format != SDL_FCC__VTB) {
+        // the GLES2 renderer uploads the planes, valid for this call only
+        [self performOnRenderQueue:^{
+            if (![self renderOverlay:overlay frame:NULL])
+                atomic_fetch_add(&_droppedPresents, 1);
+        }];
+        return;
+    }
+
+    CVPixelBufferRef pixelBuffer = SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay);
+    if (!pixelBuffer)
+        return;
+
+    IJKSDLGLFrame *frame = calloc(1, sizeof(IJKSDLGLFrame));
+    if (!frame)
+        return;
+    frame->pixelBuffer = CVPixelBufferRetain(pixelBuffer);
+    frame->width       = overlay->w;
+    frame->height      = overlay->h;
+    frame->sarNum      = overlay->sar_num;
+    frame->sarDen      = overlay->sar_den;
+
+    // a frame still there was never taken by the render queue, and the
+    // drain posted for it will take this one instead
+    IJKSDLGLFrame *superseded = atomic_exchange(&_mailbox, frame);
+    if (superseded) {
+        IJKSDLGLFrame_free(superseded);
+        atomic_fetch_add(&_droppedPresents, 1);
+        return;
     }
 
-    [self unlockGLActive];
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        [weakSelf drainMailbox];
+    });
+}
+
+// render queue
+- (void)drainMailbox
+{
+    IJKSDLGLFrame *frame = atomic_exchange(&_mailbox, NULL);
+    if (!frame)
+        return;
+
+    if (![self renderOverlay:NULL frame:frame])
+        atomic_fetch_add(&_droppedPresents, 1);
+    IJKSDLGLFrame_free(frame);
 }
 
-// NOTE: overlay could be NULl
-- (void)displayInternal: (SDL_VoutOverlay *) overlay
+// render queue; returns NO if a frame given was not presented
+- (BOOL)renderOverlay: (SDL_VoutOverlay *) overlay frame: (IJKSDLGLFrame *) frame
 {
-    if (![self setupRenderer:overlay]) {
+    // nothing to redraw before the first frame
+    if (!_didSetupGL && !overlay && !frame)
+        return NO;
+
+    // no GL in the background
+    if (_glPaused || ![self setupGLOnce])
+        return NO;
+
+    if (!_context || _didStopGL)
+        return NO;
+
+    EAGLContext *prevContext = [EAGLContext currentContext];
+    [EAGLContext setCurrentContext:_context];
+    BOOL presented = [self displayInternal:overlay frame:frame];
+    [EAGLContext setCurrentContext:prevContext];
+    return presented;
+}
+
+// NOTE: overlay and frame could both be NULL, to redraw the last frame
+- (BOOL)displayInternal: (SDL_VoutOverlay *) overlay frame: (IJKSDLGLFrame *) frame
+{
+    if (overlay || frame) {
+        BOOL isVTBRendering = (frame != NULL);
+        if (_isVTBRendering && !isVTBRendering) {
+            // the GLES2 renderer has to re-install its program
+            ijk_gl_renderer_givep(&_renderer);
+        }
+        _isVTBRendering = isVTBRendering;
+
+        _frameWidth  = frame ? frame->width  : overlay->w;
+        _frameHeight = frame ? frame->height : overlay->h;
+        _frameSarNum = frame ? frame->sarNum : overlay->sar_num;
+        _frameSarDen = frame ? frame->sarDen : overlay->sar_den;
+    }
+
+    if (_isVTBRendering) {
+        if (![self setupVTBRenderer]) {
+            NSLog(@"IJKSDLGLView: setupVTBRenderer failed\n");
+            return NO;
+        }
+    } else if (![self setupRenderer:overlay]) {
         if (!overlay && !_renderer) {
             NSLog(@"IJKSDLGLView: setupDisplay not ready\n");
         } else {
             NSLog(@"IJKSDLGLView: setupDisplay failed\n");
         }
-        return;
+        return NO;
     }
 
     [[self eaglLayer] setContentsScale:_scaleFactor];
@@ -388,17 +659,47 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
         [_context renderbufferStorage:GL_RENDERBUFFER fromDrawable:(CAEAGLLayer*)self.layer];
         glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &_backingWidth);
         glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &_backingHeight);
-        IJK_GLES2_Renderer_setGravity(_renderer, _rendererGravity, _backingWidth, _backingHeight);
+        if (_isVTBRendering)
+            [_vtbRenderer setGravity:_rendererGravity backingWidth:_backingWidth backingHeight:_backingHeight];
+        else
+            IJK_GLES2_Renderer_setGravity(_renderer, _rendererGravity, _backingWidth, _backingHeight);
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
     glViewport(0, 0, _backingWidth, _backingHeight);
 
-    if (!IJK_GLES2_Renderer_renderOverlay(_renderer, overlay))
-        ALOGE("[EGL] IJK_GLES2_render failed\n");
+    if (_isVTBRendering) {
+        BOOL rendered = frame ? [_vtbRenderer renderPixelBuffer:frame->pixelBuffer
+                                                          width:frame->width
+                                                         height:frame->height
+                                                         sarNum:frame->sarNum
+                                                         sarDen:frame->sarDen]
+                              : [_vtbRenderer renderPixelBuffer:NULL width:0 height:0 sarNum:0 sarDen:0];
+        if (!rendered)
+            IJK_EVLOG0(IJK_EV_GL_RENDER_VTB_FAILED);
+    } else if (!IJK_GLES2_Renderer_renderOverlay(_renderer, overlay))
+        IJK_EVLOG0(IJK_EV_GL_RENDER_FAILED);
+
+    [self renderSubtitles];
 
     glBindRenderbuffer(GL_RENDERBUFFER, _renderbuffer);
-    [_context presentRenderbuffer:GL_RENDERBUFFER];
+    BOOL isNewFrame = (overlay || frame);
+    CFTimeInterval minimumDuration = isNewFrame ? [_pacer minimumPresentDuration] : 0;
+    if (minimumDuration > 0 && [_context respondsToSelector:@selector(presentRenderbuffer:afterMinimumDuration:)])
+        [_context presentRenderbuffer:GL_RENDERBUFFER afterMinimumDuration:minimumDuration];
+    else
+        [_context presentRenderbuffer:GL_RENDERBUFFER];
+    if (isNewFrame) {
+        CFTimeInterval landed = [_pacer didPresentFrame];
+        [self.syncProbe didDisplayPixelBuffer:frame ? frame->pixelBuffer : NULL at:landed];
+        atomic_fetch_add(&_presentedFrames, 1);
+        if (frame) {
+            [_frameLatency didPresentPixelBuffer:frame->pixelBuffer];
+            [self didPresentPixelBuffer:frame->pixelBuffer];
+            [_capture didDisplayPixelBuffer:frame->pixelBuffer sarNum:frame->sarNum sarDen:frame->sarDen];
+        } else
+            [_capture didDisplayOverlay:overlay];
+    }
 
     int64_t current = (int64_t)SDL_GetTickHR();
     int64_t delta   = (current > _lastFrameTime) ? current - _lastFrameTime : 0;
@@ -411,45 +712,219 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
     } else {
         _frameCount++;
     }
+    return YES;
 }
 
-#pragma mark AppDelegate
+#pragma mark subtitles
 
-- (void) lockGLActive
+static GLuint subtitle_load_shader(GLenum type, const char *source)
 {
-    [self.glActiveLock lock];
+    GLuint shader = glCreateShader(type);
+    if (!shader)
+        return 0;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint status = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        ALOGE("[EGL] failed to compile subtitle shader\n");
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
 }
 
-- (void) unlockGLActive
+- (BOOL)setupSubtitleRenderer
 {
-    [self.glActiveLock unlock];
+    if (_subtitleProgram)
+        return YES;
+
+    GLuint program = ijk_gl_program_take(IJK_SUBTITLE_PROGRAM_KEY, ^GLuint {
+        GLuint vertexShader   = subtitle_load_shader(GL_VERTEX_SHADER, g_subtitle_vertex_shader);
+        GLuint fragmentShader = subtitle_load_shader(GL_FRAGMENT_SHADER, g_subtitle_fragment_shader);
+        GLuint linked         = (vertexShader && fragmentShader) ? glCreateProgram() : 0;
+        if (linked) {
+            glAttachShader(linked, vertexShader);
+            glAttachShader(linked, fragmentShader);
+            glBindAttribLocation(linked, IJK_SUBTITLE_ATTRIB_POSITION, "av4_Position");
+            glBindAttribLocation(linked, IJK_SUBTITLE_ATTRIB_TEXCOORD, "av2_Texcoord");
+            glLinkProgram(linked);
+
+            GLint status = 0;
+            glGetProgramiv(linked, GL_LINK_STATUS, &status);
+            if (!status) {
+                ALOGE("[EGL] failed to link subtitle program\n");
+                glDeleteProgram(linked);
+                linked = 0;
+            }
+        }
+        // flagged for deletion, they go with the program
+        if (vertexShader)
+            glDeleteShader(vertexShader);
+        if (fragmentShader)
+            glDeleteShader(fragmentShader);
+        if (!linked)
+            return 0;
+
+        // the sampler stays with the program, for whoever takes it next
+        GLint prevProgram = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
+        glUseProgram(linked);
+        glUniform1i(glGetUniformLocation(linked, "us2_Atlas"), IJK_SUBTITLE_TEXTURE_UNIT);
+        glUseProgram(prevProgram);
+        return linked;
+    });
+    if (!program)
+        return NO;
+
+    _subtitleProgram = program;
+    // a new context, the atlas goes up again whole
+    [_subtitleOverlay invalidateTexture];
+    return YES;
 }
 
-- (BOOL) tryLockGLActive
+// texture unit IJK_SUBTITLE_TEXTURE_UNIT active
+- (void)uploadSubtitleRows:(const uint8_t *)rows y:(int)y height:(int)height
 {
-    if (![self.glActiveLock tryLock])
-        return NO;
+    if (!_subtitleTexture) {
+        glGenTextures(1, &_subtitleTexture);
+        glBindTexture(GL_TEXTURE_2D, _subtitleTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, IJK_SUBTITLE_ATLAS_SIZE, IJK_SUBTITLE_ATLAS_SIZE, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, _subtitleTexture);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, IJK_SUBTITLE_ATLAS_SIZE, height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, rows);
+}
 
-    /*-
-    if ([UIApplication sharedApplication].applicationState != UIApplicationStateActive &&
-        [UIApplication sharedApplication].applicationState != UIApplicationStateInactive) {
-        [self.appLock unlock];
-        return NO;
+// the picture on screen, clipped to the backing, where the subtitles go
+- (CGRect)subtitleRect
+{
+    CGRect backing = CGRectMake(0, 0, _backingWidth, _backingHeight);
+    if (_rendererGravity == IJK_GLES2_GRAVITY_RESIZE || _frameWidth <= 0 || _frameHeight <= 0)
+        return backing;
+
+    float width  = _frameWidth;
+    float height = _frameHeight;
+    if (_frameSarNum > 0 && _frameSarDen > 0)
+        width = width * _frameSarNum / _frameSarDen;
+
+    float dW = _backingWidth  / width;
+    float dH = _backingHeight / height;
+    float dd = (_rendererGravity == IJK_GLES2_GRAVITY_RESIZE_ASPECT_FILL) ? MAX(dW, dH) : MIN(dW, dH);
+
+    CGRect video = CGRectMake((_backingWidth  - width  * dd) / 2,
+                              (_backingHeight - height * dd) / 2,
+                              width * dd, height * dd);
+    return CGRectIntersection(video, backing);
+}
+
+// after the video, with its GL state left as it was
+- (void)renderSubtitles
+{
+    if (_backingWidth <= 0 || _backingHeight <= 0 || ![self setupSubtitleRenderer])
+        return;
+
+    IJKSDLSubtitleQuad quads[IJK_SUBTITLE_MAX_QUADS];
+    CGRect area = [self subtitleRect];
+    GLint  prevTexture = 0;
+    glActiveTexture(GL_TEXTURE0 + IJK_SUBTITLE_TEXTURE_UNIT);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &prevTexture);
+
+    NSUInteger count = [_subtitleOverlay prepareForVideoSize:area.size
+                                                       quads:quads
+                                                    maxCount:IJK_SUBTITLE_MAX_QUADS
+                                                      upload:^(const uint8_t *rows, int y, int height) {
+        [self uploadSubtitleRows:rows y:y height:height];
+    }];
+    if (count == 0 || !_subtitleTexture) {
+        glBindTexture(GL_TEXTURE_2D, prevTexture);
+        glActiveTexture(GL_TEXTURE0);
+        return;
     }
-     */
 
-    if (self.glActivePaused) {
-        [self.glActiveLock unlock];
-        return NO;
+    // two triangles a quad, in clip space, y up
+    GLfloat vertices[IJK_SUBTITLE_MAX_QUADS * 6 * 2];
+    GLfloat texcoords[IJK_SUBTITLE_MAX_QUADS * 6 * 2];
+    for (NSUInteger i = 0; i < count; ++i) {
+        CGRect f = quads[i].frame;
+        CGRect t = quads[i].texcoords;
+        GLfloat x0 = (area.origin.x + f.origin.x * area.size.width)  / _backingWidth  * 2 - 1;
+        GLfloat x1 = x0 + f.size.width  * area.size.width  / _backingWidth  * 2;
+        GLfloat y0 = 1 - (area.origin.y + f.origin.y * area.size.height) / _backingHeight * 2;
+        GLfloat y1 = y0 - f.size.height * area.size.height / _backingHeight * 2;
+        GLfloat u0 = t.origin.x, u1 = t.origin.x + t.size.width;
+        GLfloat v0 = t.origin.y, v1 = t.origin.y + t.size.height;
+        GLfloat quadVertices[12]  = { x0, y0, x1, y0, x0, y1, x1, y0, x1, y1, x0, y1 };
+        GLfloat quadTexcoords[12] = { u0, v0, u1, v0, u0, v1, u1, v0, u1, v1, u0, v1 };
+        memcpy(&vertices[i * 12],  quadVertices,  sizeof(quadVertices));
+        memcpy(&texcoords[i * 12], quadTexcoords, sizeof(quadTexcoords));
     }
-    
-    return YES;
+
+    GLint prevProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
+    glBindTexture(GL_TEXTURE_2D, _subtitleTexture);
+
+    glUseProgram(_subtitleProgram);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(IJK_SUBTITLE_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+    glVertexAttribPointer(IJK_SUBTITLE_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
+    glEnableVertexAttribArray(IJK_SUBTITLE_ATTRIB_POSITION);
+    glEnableVertexAttribArray(IJK_SUBTITLE_ATTRIB_TEXCOORD);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)count * 6);
+
+    glDisable(GL_BLEND);
+    glDisableVertexAttribArray(IJK_SUBTITLE_ATTRIB_POSITION);
+    glDisableVertexAttribArray(IJK_SUBTITLE_ATTRIB_TEXCOORD);
+    glUseProgram(prevProgram);
+    glBindTexture(GL_TEXTURE_2D, prevTexture);
+    glActiveTexture(GL_TEXTURE0);
 }
 
-- (void)toggleGLPaused:(BOOL)paused
+#pragma mark pacing
+
+- (void)setContentFrameRate:(CGFloat)contentFrameRate
 {
-    [self lockGLActive];
-    if (!self.glActivePaused && paused) {
+    _pacer.contentFrameRate = contentFrameRate;
+}
+
+- (CGFloat)contentFrameRate
+{
+    return _pacer.contentFrameRate;
+}
+
+- (void)setMaximumFrameRate:(CGFloat)maximumFrameRate
+{
+    _pacer.maximumFrameRate = maximumFrameRate;
+}
+
+- (CGFloat)maximumFrameRate
+{
+    return _pacer.maximumFrameRate;
+}
+
+- (CGFloat)judder
+{
+    return _pacer.judder;
+}
+
+#pragma mark AppDelegate
+
+// render queue
+- (void)setGLPaused:(BOOL)paused
+{
+    if (!_glPaused && paused) {
         if (_context != nil) {
             EAGLContext *prevContext = [EAGLContext currentContext];
             [EAGLContext setCurrentContext:_context];
@@ -457,8 +932,26 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
             [EAGLContext setCurrentContext:prevContext];
         }
     }
-    self.glActivePaused = paused;
-    [self unlockGLActive];
+    BOOL resumed = (_glPaused && !paused);
+    _glPaused = paused;
+    if (resumed)
+        [self renderOverlay:NULL frame:NULL];
+}
+
+// GL must be idle before the app leaves the foreground: pausing waits for
+// the render queue, resuming does not
+- (void)toggleGLPaused:(BOOL)paused applicationState:(IJKSDLGLViewApplicationState)state
+{
+    dispatch_block_t message = ^{
+        if (state != IJKSDLGLViewApplicationUnknownState)
+            _applicationState = state;
+        [self setGLPaused:paused];
+    };
+
+    if (paused)
+        [self performOnRenderQueue:message];
+    else
+        dispatch_async(_renderQueue, message);
 }
 
 - (void)registerApplicationObservers
@@ -507,55 +1000,65 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 - (void)applicationWillEnterForeground
 {
     NSLog(@"IJKSDLGLView:applicationWillEnterForeground: %d", (int)[UIApplication sharedApplication].applicationState);
-    _applicationState = IJKSDLGLViewApplicationForegroundState;
-    [self toggleGLPaused:NO];
+    [self toggleGLPaused:NO applicationState:IJKSDLGLViewApplicationForegroundState];
 }
 
 - (void)applicationDidBecomeActive
 {
     NSLog(@"IJKSDLGLView:applicationDidBecomeActive: %d", (int)[UIApplication sharedApplication].applicationState);
-    [self toggleGLPaused:NO];
+    [self toggleGLPaused:NO applicationState:IJKSDLGLViewApplicationUnknownState];
 }
 
 - (void)applicationWillResignActive
 {
     NSLog(@"IJKSDLGLView:applicationWillResignActive: %d", (int)[UIApplication sharedApplication].applicationState);
-    [self toggleGLPaused:YES];
+    [self toggleGLPaused:YES applicationState:IJKSDLGLViewApplicationUnknownState];
 }
 
 - (void)applicationDidEnterBackground
 {
     NSLog(@"IJKSDLGLView:applicationDidEnterBackground: %d", (int)[UIApplication sharedApplication].applicationState);
-    _applicationState = IJKSDLGLViewApplicationBackgroundState;
-    [self toggleGLPaused:YES];
+    [self toggleGLPaused:YES applicationState:IJKSDLGLViewApplicationBackgroundState];
 }
 
 - (void)applicationWillTerminate
 {
     NSLog(@"IJKSDLGLView:applicationWillTerminate: %d", (int)[UIApplication sharedApplication].applicationState);
-    [self toggleGLPaused:YES];
+    [self toggleGLPaused:YES applicationState:IJKSDLGLViewApplicationUnknownState];
 }
 
 #pragma mark snapshot
 
-- (UIImage*)snapshot
+- (void)captureFrame:(void (^)(UIImage *image))completion
 {
-    [self lockGLActive];
-
-    UIImage *image = [self snapshotInternal];
-
-    [self unlockGLActive];
+    __weak typeof(self) weakSelf = self;
+    [_capture captureWithFallback:^UIImage *{
+        return [weakSelf snapshot];
+    } completion:completion];
+}
 
-    return image;
+- (void)setFrameOutputHandler:(void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts))handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate
+{
+    [_capture setFrameOutputHandler:handler
+                              queue:queue
+                      frameInterval:frameInterval
+                   maximumFrameRate:maximumFrameRate];
 }
 
-- (UIImage*)snapshotInternal
+- (UIImage*)snapshot
 {
-    if (isIOS7OrLater()) {
+    // UIKit draws what the compositor shows, on the caller's thread
+    if (isIOS7OrLater())
         return [self snapshotInternalOnIOS7AndLater];
-    } else {
-        return [self snapshotInternalOnIOS6AndBefore];
-    }
+
+    __block UIImage *image = nil;
+    [self performOnRenderQueue:^{
+        image = [self snapshotInternalOnIOS6AndBefore];
+    }];
+    return image;
 }
 
 - (UIImage*)snapshotInternalOnIOS7AndLater
@@ -577,6 +1080,9 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 
 - (UIImage*)snapshotInternalOnIOS6AndBefore
 {
+    if (_context == nil)
+        return nil;
+
     EAGLContext *prevContext = [EAGLContext currentContext];
     [EAGLContext setCurrentContext:_context];
 
@@ -637,28 +1143,22 @@ typedef NS_ENUM(NSInteger, IJKSDLGLViewApplicationState) {
 #pragma mark IJKFFHudController
 - (void)setHudValue:(NSString *)value forKey:(NSString *)key
 {
-    if ([[NSThread currentThread] isMainThread]) {
-        [_hudViewController setHudValue:value forKey:key];
-    } else {
-        dispatch_async(dispatch_get_main_queue(), ^{
-            [self setHudValue:value forKey:key];
-        });
-    }
+    // from any thread, the hud draws off the main thread
+    [_hudViewController setHudValue:value forKey:key];
 }
 
 - (void)setShouldLockWhileBeingMovedToWindow:(BOOL)shouldLockWhileBeingMovedToWindow
 {
-    _shouldLockWhileBeingMovedToWindow = shouldLockWhileBeingMovedToWindow;
 }
 
 - (void)setShouldShowHudView:(BOOL)shouldShowHudView
 {
-    _hudViewController.tableView.hidden = !shouldShowHudView;
+    _hudViewController.view.hidden = !shouldShowHudView;
 }
 
 - (BOOL)shouldShowHudView
 {
-    return !_hudViewController.tableView.hidden;
+    return !_hudViewController.view.hidden;
 }
 
 @end
@@ -8,10 +8,14 @@
 
 #import <UIKit/UIKit.h>
 
-@interface IJKSDLHudViewController : UITableViewController
+// The values drawn as the lines of a single text layer. They are set from
+// any thread, and the layer is updated on a queue of the hud, once per burst
+// of values, so that the main thread does not lay the hud out
+@interface IJKSDLHudViewController : UIViewController
 
 - (id)init;
 
+// a nil value removes the line of key
 - (void)setHudValue:(NSString *)value forKey:(NSString *)key;
 
 @end
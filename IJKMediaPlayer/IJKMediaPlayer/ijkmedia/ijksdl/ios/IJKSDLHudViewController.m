@@ -7,87 +7,124 @@
 //
 
 #import "IJKSDLHudViewController.h"
-#import "IJKSDLHudViewCell.h"
+#import <QuartzCore/QuartzCore.h>
+#include <pthread.h>
 
-@interface HudViewCellData : NSObject
-@property(nonatomic) NSString *key;
-@property(nonatomic) NSString *value;
-@end
+#define HUD_MARGIN          8
+#define HUD_FONT_SIZE       9
+#define HUD_KEY_WIDTH       20
+// a refresh sets its values in a burst, drawn once
+#define HUD_RENDER_DELAY    (20 * NSEC_PER_MSEC)
 
-@implementation HudViewCellData
+@interface IJKSDLHudView : UIView
+@property(nonatomic) CATextLayer *textLayer;
 @end
 
-@interface IJKSDLHudViewController() <UITableViewDataSource, UITableViewDelegate>
+@implementation IJKSDLHudView
+
+- (void)layoutSubviews
+{
+    [super layoutSubviews];
+
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    _textLayer.frame = CGRectInset(self.bounds, HUD_MARGIN, HUD_MARGIN / 2);
+    [CATransaction commit];
+}
 
 @end
 
 @implementation IJKSDLHudViewController
 {
-    NSMutableDictionary *_keyIndexes;
-    NSMutableArray      *_hudDataArray;
+    // under _mutex, from any thread
+    pthread_mutex_t      _mutex;
+    NSMutableOrderedSet *_keys;
+    NSMutableDictionary *_values;
+    BOOL                 _renderPending;
+
+    dispatch_queue_t     _queue;
+    CATextLayer         *_textLayer;
 }
 
 - (id)init
 {
-    self = [super init];
+    self = [super initWithNibName:nil bundle:nil];
     if (self) {
-        _keyIndexes = [[NSMutableDictionary alloc] init];
-        _hudDataArray = [[NSMutableArray alloc] init];
-
-        self.tableView.backgroundColor = [[UIColor alloc] initWithRed:.5f green:.5f blue:.5f alpha:.5f];
-        self.tableView.separatorStyle  = UITableViewCellSeparatorStyleNone;
+        pthread_mutex_init(&_mutex, NULL);
+        _keys   = [[NSMutableOrderedSet alloc] init];
+        _values = [[NSMutableDictionary alloc] init];
+        _queue  = dispatch_queue_create("tv.danmaku.ijk.hud",
+                                        dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+
+        _textLayer = [CATextLayer layer];
+        _textLayer.font            = (__bridge CFTypeRef)@"Menlo";
+        _textLayer.fontSize        = HUD_FONT_SIZE;
+        _textLayer.foregroundColor = [UIColor whiteColor].CGColor;
+        _textLayer.contentsScale   = [UIScreen mainScreen].scale;
+        _textLayer.truncationMode  = kCATruncationEnd;
     }
     return self;
 }
 
-- (void)setHudValue:(NSString *)value forKey:(NSString *)key
+- (void)dealloc
 {
-    HudViewCellData *data = nil;
-    NSNumber *index = [_keyIndexes objectForKey:key];
-    if (index == nil) {
-        data = [[HudViewCellData alloc] init];
-        data.key = key;
-        [_keyIndexes setObject:[NSNumber numberWithUnsignedInteger:_hudDataArray.count]
-                        forKey:key];
-        [_hudDataArray addObject:data];
-    } else {
-        data = [_hudDataArray objectAtIndex:[index unsignedIntegerValue]];
-    }
-
-    data.value = value;
-    [self.tableView reloadData];
+    pthread_mutex_destroy(&_mutex);
 }
 
-#pragma mark UITableViewDataSource
-
-- (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section
+- (void)loadView
 {
-    assert(section == 0);
-    return _hudDataArray.count;
+    IJKSDLHudView *view = [[IJKSDLHudView alloc] init];
+    view.backgroundColor        = [[UIColor alloc] initWithRed:.5f green:.5f blue:.5f alpha:.5f];
+    view.userInteractionEnabled = NO;
+    view.textLayer              = _textLayer;
+    [view.layer addSublayer:_textLayer];
+    self.view = view;
 }
 
-- (UITableViewCell *)tableView:(UITableView *)tableView
-         cellForRowAtIndexPath:(NSIndexPath *)indexPath
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key
 {
-    assert(indexPath.section == 0);
-
-    IJKSDLHudViewCell *cell = [tableView dequeueReusableCellWithIdentifier:@"hud"];
-    if (cell == nil) {
-        cell = [[IJKSDLHudViewCell alloc] init];
+    BOOL schedule;
+
+    if (key == nil)
+        return;
+
+    pthread_mutex_lock(&_mutex);
+    [_keys addObject:key];
+    if (value)
+        _values[key] = [value copy];
+    else
+        [_values removeObjectForKey:key];
+    schedule       = !_renderPending;
+    _renderPending = YES;
+    pthread_mutex_unlock(&_mutex);
+
+    if (schedule) {
+        __weak IJKSDLHudViewController *weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, HUD_RENDER_DELAY), _queue, ^{
+            [weakSelf render];
+        });
     }
-
-    HudViewCellData *data = [_hudDataArray objectAtIndex:indexPath.item];
-
-    [cell setHudValue:data.value forKey:data.key];
-
-    return cell;
 }
 
-#pragma mark UITableViewDelegate
-
-- (CGFloat)tableView:(UITableView *)tableView heightForRowAtIndexPath:(NSIndexPath *)indexPath
+// on _queue: the lines in the order their keys were first set
+- (void)render
 {
-    return 16.f;
+    NSMutableString *text = [[NSMutableString alloc] init];
+
+    pthread_mutex_lock(&_mutex);
+    _renderPending = NO;
+    for (NSString *key in _keys) {
+        NSString *value = _values[key];
+        if (value)
+            [text appendFormat:@"%-*s %@\n", HUD_KEY_WIDTH, key.UTF8String, value];
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    // committed from this thread, the main thread only composites the layer
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    _textLayer.string = text;
+    [CATransaction commit];
 }
 
 @end
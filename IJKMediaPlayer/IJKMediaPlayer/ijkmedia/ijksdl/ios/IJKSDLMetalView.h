@@ -0,0 +1,89 @@
+/*
+ * IJKSDLMetalView.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+
+#include "ijksdl/ijksdl_vout.h"
+#import "IJKSDLRenderView.h"
+
+typedef NS_ENUM(NSInteger, IJKSDLMetalDeinterlaceMode) {
+    IJKSDLMetalDeinterlaceNone  = 0,
+    // the top field, line doubled
+    IJKSDLMetalDeinterlaceBob   = 1,
+    // each line averaged with the lines of the other field around it
+    IJKSDLMetalDeinterlaceBlend = 2,
+};
+
+typedef NS_ENUM(NSInteger, IJKSDLMetalScalingFilter) {
+    IJKSDLMetalScalingBilinear  = 0,
+    IJKSDLMetalScalingBicubic   = 1,
+    IJKSDLMetalScalingLanczos   = 2,
+};
+
+// CAMetalLayer backed video view.
+// Accepts SDL_FCC__VTB (NV12 CVPixelBuffer) and SDL_FCC_I420 overlays,
+// converts them to RGB with compute kernels straight into the drawable.
+@interface IJKSDLMetalView : UIView <IJKSDLRenderView>
+
+// NO if the device has no Metal support
++ (BOOL) isSupported;
+
+- (id) initWithFrame:(CGRect)frame;
+- (void) display: (SDL_VoutOverlay *) overlay;
+
+- (UIImage*) snapshot;
+- (void) captureFrame: (void (^)(UIImage *image)) completion;
+- (void) setFrameOutputHandler: (void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts)) handler
+                         queue: (dispatch_queue_t) queue
+                 frameInterval: (NSUInteger) frameInterval
+              maximumFrameRate: (CGFloat) maximumFrameRate;
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key;
+
+@property(nonatomic, readonly)        CGFloat  fps;
+@property(nonatomic)        CGFloat  scaleFactor;
+@property(nonatomic)        BOOL     shouldShowHudView;
+@property(nonatomic)        CGFloat  contentFrameRate;
+@property(nonatomic)        CGFloat  maximumFrameRate;
+@property(nonatomic, readonly) CGFloat judder;
+@property(nonatomic, readonly) int64_t droppedPresents;
+@property(nonatomic, readonly) int64_t presentedFrames;
+@property(atomic)              BOOL    prefersPixelBufferOverlays;
+
+// Post processing on the GPU, in the conversion kernels, on luma: frames
+// the decoder marks as interlaced are deinterlaced, the picture is scaled
+// to the drawable with the filter, then sharpened by an unsharp mask of
+// sharpness strength, 0 for none, about 1 for strong. Takes effect on the
+// next frame.
+@property(nonatomic) IJKSDLMetalDeinterlaceMode deinterlaceMode;
+@property(nonatomic) IJKSDLMetalScalingFilter   scalingFilter;
+@property(nonatomic) CGFloat                    sharpness;
+
+@property(nonatomic, readonly) int64_t textureCacheHits;
+@property(nonatomic, readonly) int64_t textureCacheMisses;
+@property(nonatomic, readonly) IJKSDLFrameLatency *frameLatency;
+@property(nonatomic, readonly) IJKSDLSubtitleOverlay *subtitleOverlay;
+@property(nonatomic, copy)     void (^displaySizeHandler)(CGSize pixelSize);
+@property(atomic, copy)        void (^presentHandler)(NSTimeInterval pts);
+@property(atomic, strong)      IJKSDLSyncProbe *syncProbe;
+
+@end
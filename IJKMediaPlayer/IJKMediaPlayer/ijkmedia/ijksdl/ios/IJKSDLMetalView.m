@@ -0,0 +1,1274 @@
+/*
+ * IJKSDLMetalView.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLMetalView.h"
+#import <Metal/Metal.h>
+#import <QuartzCore/CAMetalLayer.h>
+#import <CoreVideo/CoreVideo.h>
+#include "ijksdl/ijksdl_timer.h"
+#include "ijksdl/ijksdl_log.h"
+#include "ijksdl/ios/ijksdl_evlog_ios.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#import "IJKSDLHudViewController.h"
+#import "IJKSDLFramePacer.h"
+#import "IJKSDLFrameCapture.h"
+#import "IJKSDLSubtitleOverlay.h"
+
+#define IJK_METAL_MAX_FRAMES_IN_FLIGHT  3
+#define IJK_METAL_DRAWABLE_TIMEOUT_MS   100
+
+typedef NS_ENUM(NSInteger, IJKSDLMetalViewGravity) {
+    IJKSDLMetalViewGravityResize,
+    IJKSDLMetalViewGravityResizeAspect,
+    IJKSDLMetalViewGravityResizeAspectFill,
+};
+
+typedef NS_ENUM(NSInteger, IJKSDLMetalTransfer) {
+    IJKSDLMetalTransferSDR = 0,
+    IJKSDLMetalTransferPQ  = 1,
+    IJKSDLMetalTransferHLG = 2,
+};
+
+// SDR reference white, BT.2408
+#define IJK_METAL_SDR_WHITE_NITS        203.0f
+// peak assumed when the stream carries no mastering display metadata
+#define IJK_METAL_DEFAULT_PEAK_NITS     1000.0f
+
+// must match IJKMetalUniforms in g_metal_kernel_source
+typedef struct IJKMetalUniforms {
+    float colorConversion[3][4];
+    float offset[4];
+    float rect[4];      // picture placement in drawable pixels: x, y, w, h
+    float texScale[4];  // crop of the plane padding
+    float hdr[4];       // transfer, 1 to pass the signal to an EDR layer, peak over SDR white
+    float post[4];      // deinterlace, scaling filter, sharpness, see IJKSDLMetalView.h
+} IJKMetalUniforms;
+
+static NSString *const g_metal_kernel_source =
+    @"#include <metal_stdlib>\n"
+    @"using namespace metal;\n"
+    @"struct IJKMetalUniforms {\n"
+    @"    float4 col0;\n"
+    @"    float4 col1;\n"
+    @"    float4 col2;\n"
+    @"    float4 offset;\n"
+    @"    float4 rect;\n"
+    @"    float4 texScale;\n"
+    @"    float4 hdr;\n"
+    @"    float4 post;\n"
+    @"};\n"
+    @"static float4 ijk_yuv_to_rgb(constant IJKMetalUniforms &u, float3 yuv)\n"
+    @"{\n"
+    @"    float3x3 m = float3x3(u.col0.xyz, u.col1.xyz, u.col2.xyz);\n"
+    @"    return float4(m * (yuv - u.offset.xyz), 1.0);\n"
+    @"}\n"
+    // PQ to display light, in units of 10000 nits
+    @"static float3 ijk_pq_eotf(float3 e)\n"
+    @"{\n"
+    @"    const float m1 = 0.1593017578125, m2 = 78.84375;\n"
+    @"    const float c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;\n"
+    @"    float3 p = pow(max(e, 0.0), 1.0 / m2);\n"
+    @"    return pow(max(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);\n"
+    @"}\n"
+    // HLG to scene light, 0 to 1
+    @"static float3 ijk_hlg_inverse_oetf(float3 e)\n"
+    @"{\n"
+    @"    const float a = 0.17883277, b = 0.28466892, c = 0.55991073;\n"
+    @"    return select((exp((e - c) / a) + b) / 12.0, e * e / 3.0, e <= 0.5);\n"
+    @"}\n"
+    // BT.2020 HDR signal to BT.709 SDR: linear light relative to SDR white,
+    // extended Reinhard on the luminance bringing the peak to white
+    @"static float4 ijk_tone_map(constant IJKMetalUniforms &u, float3 e)\n"
+    @"{\n"
+    @"    const float3 luma = float3(0.2627, 0.6780, 0.0593);\n"
+    @"    float3 rgb;\n"
+    @"    if (u.hdr.x == 1.0) {\n"
+    @"        rgb = ijk_pq_eotf(e) * (10000.0 / 203.0);\n"
+    @"    } else {\n"
+    @"        float3 scene = ijk_hlg_inverse_oetf(e);\n"
+    @"        rgb = scene * pow(max(dot(scene, luma), 1e-6), 0.2) * (1000.0 / 203.0);\n"
+    @"    }\n"
+    @"    float peak = max(u.hdr.z, 1.0);\n"
+    @"    float l = dot(rgb, luma);\n"
+    @"    if (l > 0.0)\n"
+    @"        rgb *= (1.0 + l / (peak * peak)) / (1.0 + l);\n"
+    @"    const float3x3 bt2020_to_bt709 = float3x3(float3( 1.6605, -0.1246, -0.0182),\n"
+    @"                                              float3(-0.5876,  1.1329, -0.1006),\n"
+    @"                                              float3(-0.0728, -0.0083,  1.1187));\n"
+    @"    rgb = clamp(bt2020_to_bt709 * rgb, 0.0, 1.0);\n"
+    @"    return float4(pow(rgb, 1.0 / 2.2), 1.0);\n"
+    @"}\n"
+    // 4 tap weight at distance x: Catmull-Rom, or Lanczos with a = 2
+    @"static float ijk_tap(float x, float filter)\n"
+    @"{\n"
+    @"    x = abs(x);\n"
+    @"    if (filter == 1.0) {\n"
+    @"        if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;\n"
+    @"        if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;\n"
+    @"        return 0.0;\n"
+    @"    }\n"
+    @"    if (x < 1e-4) return 1.0;\n"
+    @"    if (x >= 2.0) return 0.0;\n"
+    @"    float px = M_PI_F * x;\n"
+    @"    return 2.0 * sin(px) * sin(px / 2.0) / (px * px);\n"
+    @"}\n"
+    // one source row at texel column x, filtered horizontally
+    @"static float ijk_luma_row(texture2d<float, access::sample> t, constant IJKMetalUniforms &u, float x, int row)\n"
+    @"{\n"
+    @"    int maxX = int(float(t.get_width()) * u.texScale.x) - 1;\n"
+    @"    uint y = uint(clamp(row, 0, int(t.get_height()) - 1));\n"
+    @"    float x0 = floor(x);\n"
+    @"    float f = x - x0;\n"
+    @"    if (u.post.y == 0.0) {\n"
+    @"        float a = t.read(uint2(clamp(int(x0), 0, maxX), y)).r;\n"
+    @"        float b = t.read(uint2(clamp(int(x0) + 1, 0, maxX), y)).r;\n"
+    @"        return mix(a, b, f);\n"
+    @"    }\n"
+    @"    float sum = 0.0, weights = 0.0;\n"
+    @"    for (int i = -1; i <= 2; ++i) {\n"
+    @"        float w = ijk_tap(float(i) - f, u.post.y);\n"
+    @"        sum += w * t.read(uint2(clamp(int(x0) + i, 0, maxX), y)).r;\n"
+    @"        weights += w;\n"
+    @"    }\n"
+    @"    return sum / weights;\n"
+    @"}\n"
+    // a row of the deinterlaced picture: linear blend weighs in the lines of
+    // the other field, bob keeps the top field and rows count its lines
+    @"static float ijk_luma_field_row(texture2d<float, access::sample> t, constant IJKMetalUniforms &u, float x, int row)\n"
+    @"{\n"
+    @"    if (u.post.x == 1.0)\n"
+    @"        return ijk_luma_row(t, u, x, row * 2);\n"
+    @"    if (u.post.x == 2.0)\n"
+    @"        return 0.25 * ijk_luma_row(t, u, x, row - 1) + 0.5 * ijk_luma_row(t, u, x, row) + 0.25 * ijk_luma_row(t, u, x, row + 1);\n"
+    @"    return ijk_luma_row(t, u, x, row);\n"
+    @"}\n"
+    @"static float ijk_luma_at(texture2d<float, access::sample> t, constant IJKMetalUniforms &u, float2 pos)\n"
+    @"{\n"
+    @"    float2 p = pos * float2(t.get_width(), t.get_height()) - 0.5;\n"
+    @"    if (u.post.x == 1.0)\n"
+    @"        p.y = p.y / 2.0;\n"
+    @"    float y0 = floor(p.y);\n"
+    @"    float f = p.y - y0;\n"
+    @"    if (u.post.y == 0.0)\n"
+    @"        return mix(ijk_luma_field_row(t, u, p.x, int(y0)), ijk_luma_field_row(t, u, p.x, int(y0) + 1), f);\n"
+    @"    float sum = 0.0, weights = 0.0;\n"
+    @"    for (int i = -1; i <= 2; ++i) {\n"
+    @"        float w = ijk_tap(float(i) - f, u.post.y);\n"
+    @"        sum += w * ijk_luma_field_row(t, u, p.x, int(y0) + i);\n"
+    @"        weights += w;\n"
+    @"    }\n"
+    @"    return sum / weights;\n"
+    @"}\n"
+    // the post processing runs on luma only, chroma stays bilinear
+    @"static float ijk_luma(texture2d<float, access::sample> t, sampler s, constant IJKMetalUniforms &u, float2 pos)\n"
+    @"{\n"
+    @"    if (u.post.x == 0.0 && u.post.y == 0.0 && u.post.z == 0.0)\n"
+    @"        return t.sample(s, pos).r;\n"
+    @"    float l = ijk_luma_at(t, u, pos);\n"
+    @"    if (u.post.z > 0.0) {\n"
+    @"        float2 d = 1.0 / float2(t.get_width(), t.get_height());\n"
+    @"        float blur = 0.25 * (t.sample(s, pos + float2(d.x, 0.0)).r + t.sample(s, pos - float2(d.x, 0.0)).r +\n"
+    @"                             t.sample(s, pos + float2(0.0, d.y)).r + t.sample(s, pos - float2(0.0, d.y)).r);\n"
+    @"        l += u.post.z * (l - blur);\n"
+    @"    }\n"
+    @"    return l;\n"
+    @"}\n"
+    @"static bool ijk_source_pos(constant IJKMetalUniforms &u, uint2 gid, thread float2 &pos)\n"
+    @"{\n"
+    @"    pos = (float2(gid) + 0.5 - u.rect.xy) / u.rect.zw;\n"
+    @"    if (pos.x < 0.0 || pos.y < 0.0 || pos.x > 1.0 || pos.y > 1.0)\n"
+    @"        return false;\n"
+    @"    pos *= u.texScale.xy;\n"
+    @"    return true;\n"
+    @"}\n"
+    @"kernel void ijk_nv12_to_rgb(texture2d<float, access::sample> texY  [[texture(0)]],\n"
+    @"                            texture2d<float, access::sample> texUV [[texture(1)]],\n"
+    @"                            texture2d<float, access::write>  dst   [[texture(2)]],\n"
+    @"                            constant IJKMetalUniforms &u [[buffer(0)]],\n"
+    @"                            uint2 gid [[thread_position_in_grid]])\n"
+    @"{\n"
+    @"    if (gid.x >= dst.get_width() || gid.y >= dst.get_height())\n"
+    @"        return;\n"
+    @"    float2 pos;\n"
+    @"    if (!ijk_source_pos(u, gid, pos)) {\n"
+    @"        dst.write(float4(0.0, 0.0, 0.0, 1.0), gid);\n"
+    @"        return;\n"
+    @"    }\n"
+    @"    constexpr sampler s(coord::normalized, filter::linear, address::clamp_to_edge);\n"
+    @"    float3 yuv = float3(ijk_luma(texY, s, u, pos), texUV.sample(s, pos).rg);\n"
+    @"    float4 rgb = ijk_yuv_to_rgb(u, yuv);\n"
+    @"    if (u.hdr.x > 0.0 && u.hdr.y == 0.0)\n"
+    @"        rgb = ijk_tone_map(u, rgb.rgb);\n"
+    @"    dst.write(clamp(rgb, 0.0, 1.0), gid);\n"
+    @"}\n"
+    @"kernel void ijk_i420_to_rgb(texture2d<float, access::sample> texY [[texture(0)]],\n"
+    @"                            texture2d<float, access::sample> texU [[texture(1)]],\n"
+    @"                            texture2d<float, access::sample> texV [[texture(2)]],\n"
+    @"                            texture2d<float, access::write>  dst  [[texture(3)]],\n"
+    @"                            constant IJKMetalUniforms &u [[buffer(0)]],\n"
+    @"                            uint2 gid [[thread_position_in_grid]])\n"
+    @"{\n"
+    @"    if (gid.x >= dst.get_width() || gid.y >= dst.get_height())\n"
+    @"        return;\n"
+    @"    float2 pos;\n"
+    @"    if (!ijk_source_pos(u, gid, pos)) {\n"
+    @"        dst.write(float4(0.0, 0.0, 0.0, 1.0), gid);\n"
+    @"        return;\n"
+    @"    }\n"
+    @"    constexpr sampler s(coord::normalized, filter::linear, address::clamp_to_edge);\n"
+    @"    float3 yuv = float3(ijk_luma(texY, s, u, pos), texU.sample(s, pos).r, texV.sample(s, pos).r);\n"
+    @"    dst.write(ijk_yuv_to_rgb(u, yuv), gid);\n"
+    @"}\n"
+    // subtitles, blended over the video by a render pass
+    @"struct IJKSubtitleVertex {\n"
+    @"    float2 position;\n"
+    @"    float2 texcoord;\n"
+    @"};\n"
+    @"struct IJKSubtitleVaryings {\n"
+    @"    float4 position [[position]];\n"
+    @"    float2 texcoord;\n"
+    @"};\n"
+    @"vertex IJKSubtitleVaryings ijk_subtitle_vertex(constant IJKSubtitleVertex *v [[buffer(0)]],\n"
+    @"                                               uint vid [[vertex_id]])\n"
+    @"{\n"
+    @"    IJKSubtitleVaryings out;\n"
+    @"    out.position = float4(v[vid].position, 0.0, 1.0);\n"
+    @"    out.texcoord = v[vid].texcoord;\n"
+    @"    return out;\n"
+    @"}\n"
+    // premultiplied SDR; on an EDR drawable, to the PQ or HLG signal of SDR white
+    @"fragment float4 ijk_subtitle_fragment(IJKSubtitleVaryings in [[stage_in]],\n"
+    @"                                      texture2d<float, access::sample> atlas [[texture(0)]],\n"
+    @"                                      constant float4 &hdr [[buffer(0)]])\n"
+    @"{\n"
+    @"    constexpr sampler s(coord::normalized, filter::linear, address::clamp_to_edge);\n"
+    @"    float4 c = atlas.sample(s, in.texcoord);\n"
+    @"    if (hdr.y == 0.0 || c.a <= 0.0)\n"
+    @"        return c;\n"
+    @"    const float3x3 bt709_to_bt2020 = float3x3(float3(0.6274, 0.0691, 0.0164),\n"
+    @"                                              float3(0.3293, 0.9195, 0.0880),\n"
+    @"                                              float3(0.0433, 0.0114, 0.8956));\n"
+    @"    float3 rgb = bt709_to_bt2020 * pow(c.rgb / c.a, 2.2);\n"
+    @"    if (hdr.x == 1.0) {\n"
+    @"        const float m1 = 0.1593017578125, m2 = 78.84375;\n"
+    @"        const float c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;\n"
+    @"        float3 p = pow(rgb * (203.0 / 10000.0), m1);\n"
+    @"        rgb = pow((c1 + c2 * p) / (1.0 + c3 * p), m2);\n"
+    @"    } else {\n"
+    @"        const float a = 0.17883277, b = 0.28466892, c = 0.55991073;\n"
+    @"        float3 e = rgb * 0.2647;\n"
+    @"        rgb = select(a * log(max(12.0 * e - b, 1e-6)) + c, sqrt(3.0 * e), e <= 1.0 / 12.0);\n"
+    @"    }\n"
+    @"    return float4(rgb * c.a, c.a);\n"
+    @"}\n";
+
+static const float g_bt601_video_range[3][4] = {
+    {1.164,  1.164,  1.164, 0.0},
+    {0.0,   -0.392,  2.017, 0.0},
+    {1.596, -0.813,  0.0,   0.0},
+};
+
+static const float g_bt601_full_range[3][4] = {
+    {1.0,    1.0,    1.0,   0.0},
+    {0.0,   -0.343,  1.765, 0.0},
+    {1.4,   -0.711,  0.0,   0.0},
+};
+
+static const float g_bt709_video_range[3][4] = {
+    {1.164,  1.164,  1.164, 0.0},
+    {0.0,   -0.213,  2.112, 0.0},
+    {1.793, -0.533,  0.0,   0.0},
+};
+
+static const float g_bt709_full_range[3][4] = {
+    {1.0,    1.0,    1.0,   0.0},
+    {0.0,   -0.187,  1.856, 0.0},
+    {1.575, -0.468,  0.0,   0.0},
+};
+
+static const float g_bt2020_video_range[3][4] = {
+    {1.164,  1.164,  1.164, 0.0},
+    {0.0,   -0.187,  2.142, 0.0},
+    {1.679, -0.650,  0.0,   0.0},
+};
+
+static const float g_bt2020_full_range[3][4] = {
+    {1.0,    1.0,    1.0,   0.0},
+    {0.0,   -0.165,  1.881, 0.0},
+    {1.475, -0.571,  0.0,   0.0},
+};
+
+@implementation IJKSDLMetalView {
+    CGSize                      _displaySize;
+    CAMetalLayer               *_metalLayer;
+    id<MTLDevice>               _device;
+    id<MTLCommandQueue>         _commandQueue;
+    id<MTLComputePipelineState> _nv12Pipeline;
+    id<MTLComputePipelineState> _i420Pipeline;
+    id<MTLLibrary>              _library;
+    dispatch_semaphore_t        _inflightSemaphore;
+    NSLock                     *_renderLock;
+
+    CVMetalTextureCacheRef      _textureCache;
+    int                         _cacheWidth;
+    int                         _cacheHeight;
+    OSType                      _cachePixelFormat;
+
+    // source of the last frame, reused to redraw on layout change
+    Uint32                      _sourceFormat;
+    CVMetalTextureRef           _sourceCVTextures[2];
+    id<MTLTexture>              _i420Textures[IJK_METAL_MAX_FRAMES_IN_FLIGHT][3];
+    int                         _i420Index;
+    IJKMetalUniforms            _uniforms;
+
+    int                         _frameWidth;
+    int                         _frameHeight;
+    int                         _frameSarNum;
+    int                         _frameSarDen;
+    int                         _framePitch;
+    BOOL                        _frameInterlaced;
+
+    IJKSDLMetalTransfer         _transfer;
+
+    IJKSDLMetalViewGravity      _gravity;
+    volatile BOOL               _isApplicationActive;
+    BOOL                        _didLogUnsupportedFormat;
+    // the device, kernels and texture cache wait for the first frame
+    BOOL                        _didSetupMetal;
+    BOOL                        _didFailMetal;
+
+    int                         _frameCount;
+    int64_t                     _lastFrameTime;
+    int64_t                     _droppedPresents;
+    int64_t                     _presentedFrames;
+
+    NSMutableArray             *_registeredNotifications;
+    IJKSDLHudViewController    *_hudViewController;
+
+    IJKSDLFramePacer           *_pacer;
+    IJKSDLFrameCapture         *_capture;
+
+    // for the pixel format of the drawable, which follows the transfer
+    id<MTLRenderPipelineState>  _subtitlePipeline;
+    MTLPixelFormat              _subtitlePixelFormat;
+    id<MTLTexture>              _subtitleTexture;
+}
+
++ (Class) layerClass
+{
+    return [CAMetalLayer class];
+}
+
++ (BOOL) isSupported
+{
+    static BOOL supported = NO;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        id<MTLDevice> device = MTLCreateSystemDefaultDevice();
+        supported = (device != nil);
+    });
+    return supported;
+}
+
+- (id) initWithFrame:(CGRect)frame
+{
+    self = [super initWithFrame:frame];
+    if (self) {
+        _renderLock = [[NSLock alloc] init];
+        _inflightSemaphore = dispatch_semaphore_create(IJK_METAL_MAX_FRAMES_IN_FLIGHT);
+        _gravity = IJKSDLMetalViewGravityResizeAspect;
+        _isApplicationActive = ([UIApplication sharedApplication].applicationState == UIApplicationStateActive);
+
+        _scaleFactor = [[UIScreen mainScreen] scale];
+        if (_scaleFactor < 0.1f)
+            _scaleFactor = 1.0f;
+
+        _metalLayer = (CAMetalLayer *)self.layer;
+        _metalLayer.pixelFormat     = MTLPixelFormatBGRA8Unorm;
+        // compute kernels write straight into the drawable
+        _metalLayer.framebufferOnly = NO;
+        _metalLayer.opaque          = YES;
+        _metalLayer.contentsScale   = _scaleFactor;
+
+        _registeredNotifications = [[NSMutableArray alloc] init];
+        [self registerApplicationObservers];
+
+        _hudViewController = [[IJKSDLHudViewController alloc] init];
+        [self addSubview:_hudViewController.view];
+
+        _pacer = [[IJKSDLFramePacer alloc] init];
+        _frameLatency = [[IJKSDLFrameLatency alloc] init];
+        _capture = [[IJKSDLFrameCapture alloc] init];
+
+        _subtitleOverlay = [[IJKSDLSubtitleOverlay alloc] init];
+        __weak typeof(self) weakSelf = self;
+        _subtitleOverlay.changeHandler = ^{
+            [weakSelf display:NULL];
+        };
+    }
+
+    return self;
+}
+
+- (void)didMoveToWindow
+{
+    [super didMoveToWindow];
+    if (self.window)
+        [_pacer start];
+    else
+        [_pacer stop];
+}
+
+- (void)dealloc
+{
+    [self unregisterApplicationObservers];
+
+    // let in-flight frames release their textures
+    for (int i = 0; i < IJK_METAL_MAX_FRAMES_IN_FLIGHT; ++i)
+        dispatch_semaphore_wait(_inflightSemaphore, DISPATCH_TIME_FOREVER);
+    for (int i = 0; i < IJK_METAL_MAX_FRAMES_IN_FLIGHT; ++i)
+        dispatch_semaphore_signal(_inflightSemaphore);
+
+    [self releaseSourceCVTextures];
+
+    if (_textureCache) {
+        CVMetalTextureCacheFlush(_textureCache, 0);
+        CFRelease(_textureCache);
+        _textureCache = NULL;
+    }
+}
+
+- (BOOL)setupMetal
+{
+    _device = MTLCreateSystemDefaultDevice();
+    if (_device == nil)
+        return NO;
+
+    _metalLayer.device = _device;
+
+    _commandQueue = [_device newCommandQueue];
+    if (_commandQueue == nil)
+        return NO;
+
+    NSError *error = nil;
+    _library = [_device newLibraryWithSource:g_metal_kernel_source options:nil error:&error];
+    if (_library == nil) {
+        NSLog(@"IJKSDLMetalView: failed to compile kernels: %@\n", error);
+        return NO;
+    }
+
+    _nv12Pipeline = [_device newComputePipelineStateWithFunction:[_library newFunctionWithName:@"ijk_nv12_to_rgb"] error:&error];
+    _i420Pipeline = [_device newComputePipelineStateWithFunction:[_library newFunctionWithName:@"ijk_i420_to_rgb"] error:&error];
+    if (_nv12Pipeline == nil || _i420Pipeline == nil) {
+        NSLog(@"IJKSDLMetalView: failed to create pipelines: %@\n", error);
+        return NO;
+    }
+
+    CVReturn err = CVMetalTextureCacheCreate(kCFAllocatorDefault, NULL, _device, NULL, &_textureCache);
+    if (err != kCVReturnSuccess || _textureCache == NULL) {
+        NSLog(@"IJKSDLMetalView: CVMetalTextureCacheCreate failed: %d\n", err);
+        return NO;
+    }
+
+    return YES;
+}
+
+// render lock held
+- (BOOL)setupMetalOnce
+{
+    if (_didSetupMetal)
+        return YES;
+    if (_didFailMetal)
+        return NO;
+
+    if (![self setupMetal]) {
+        NSLog(@"IJKSDLMetalView: failed to setup Metal\n");
+        _didFailMetal = YES;
+        return NO;
+    }
+    _didSetupMetal = YES;
+    return YES;
+}
+
+- (void)releaseSourceCVTextures
+{
+    for (int plane = 0; plane < 2; ++plane) {
+        if (_sourceCVTextures[plane]) {
+            CFRelease(_sourceCVTextures[plane]);
+            _sourceCVTextures[plane] = NULL;
+        }
+    }
+}
+
+- (void)layoutSubviews
+{
+    [super layoutSubviews];
+
+    CGRect selfFrame = self.frame;
+    CGRect newFrame  = selfFrame;
+
+    newFrame.size.width   = selfFrame.size.width * 1 / 3;
+    newFrame.origin.x     = selfFrame.size.width * 2 / 3;
+
+    newFrame.size.height  = selfFrame.size.height * 8 / 8;
+    newFrame.origin.y    += selfFrame.size.height * 0 / 8;
+
+    _hudViewController.view.frame = newFrame;
+    [self invalidateDrawable];
+    [self updateDisplaySize];
+}
+
+- (void)setScaleFactor:(CGFloat)scaleFactor
+{
+    _scaleFactor = scaleFactor;
+    [self invalidateDrawable];
+    [self updateDisplaySize];
+}
+
+// main thread: the pixels the video is drawn in, for the decoder to scale to
+- (void)updateDisplaySize
+{
+    CGSize size = CGSizeMake(self.bounds.size.width * _scaleFactor, self.bounds.size.height * _scaleFactor);
+    if (CGSizeEqualToSize(size, _displaySize))
+        return;
+
+    _displaySize = size;
+    if (_displaySizeHandler)
+        _displaySizeHandler(size);
+}
+
+- (void)setDisplaySizeHandler:(void (^)(CGSize))displaySizeHandler
+{
+    _displaySizeHandler = [displaySizeHandler copy];
+    if (_displaySizeHandler && _displaySize.width > 0 && _displaySize.height > 0)
+        _displaySizeHandler(_displaySize);
+}
+
+// render thread
+- (void)didPresentPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    void (^presentHandler)(NSTimeInterval) = self.presentHandler;
+    if (!presentHandler)
+        return;
+
+    NSTimeInterval pts = SDL_VoutOverlayVideoToolBox_GetPresentationTime(pixelBuffer);
+    if (!isnan(pts))
+        presentHandler(pts);
+}
+
+- (void)setContentMode:(UIViewContentMode)contentMode
+{
+    [super setContentMode:contentMode];
+
+    switch (contentMode) {
+        case UIViewContentModeScaleToFill:
+            _gravity = IJKSDLMetalViewGravityResize;
+            break;
+        case UIViewContentModeScaleAspectFit:
+            _gravity = IJKSDLMetalViewGravityResizeAspect;
+            break;
+        case UIViewContentModeScaleAspectFill:
+            _gravity = IJKSDLMetalViewGravityResizeAspectFill;
+            break;
+        default:
+            _gravity = IJKSDLMetalViewGravityResizeAspect;
+            break;
+    }
+    [self invalidateDrawable];
+}
+
+- (void)invalidateDrawable
+{
+    CGSize size = self.bounds.size;
+    _metalLayer.contentsScale = _scaleFactor;
+    _metalLayer.drawableSize  = CGSizeMake(size.width * _scaleFactor, size.height * _scaleFactor);
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+        [self display:nil];
+    });
+}
+
+#pragma mark render
+
+- (BOOL)prepareVideoToolboxOverlay:(SDL_VoutOverlay *)overlay
+{
+    CVPixelBufferRef pixelBuffer = SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay);
+    if (!pixelBuffer) {
+        IJK_EVLOG0(IJK_EV_METAL_NO_PIXEL_BUFFER);
+        return NO;
+    }
+
+    int    width       = (int)CVPixelBufferGetWidth(pixelBuffer);
+    int    height      = (int)CVPixelBufferGetHeight(pixelBuffer);
+    OSType pixelFormat = CVPixelBufferGetPixelFormatType(pixelBuffer);
+    if (width != _cacheWidth || height != _cacheHeight || pixelFormat != _cachePixelFormat) {
+        [self releaseSourceCVTextures];
+        CVMetalTextureCacheFlush(_textureCache, 0);
+
+        _cacheWidth       = width;
+        _cacheHeight      = height;
+        _cachePixelFormat = pixelFormat;
+        _textureCacheMisses++;
+    } else {
+        _textureCacheHits++;
+    }
+
+    BOOL isTenBit = NO;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    isTenBit = (pixelFormat == kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange ||
+                pixelFormat == kCVPixelFormatType_420YpCbCr10BiPlanarFullRange);
+#endif
+
+    CVMetalTextureRef textures[2] = {NULL, NULL};
+    for (int plane = 0; plane < 2; ++plane) {
+        size_t         planeWidth  = CVPixelBufferGetWidthOfPlane(pixelBuffer, plane);
+        size_t         planeHeight = CVPixelBufferGetHeightOfPlane(pixelBuffer, plane);
+        MTLPixelFormat format      = plane == 0 ? MTLPixelFormatR8Unorm : MTLPixelFormatRG8Unorm;
+        // 10 bits in the high bits of 16, sampled to the same 0 to 1 range
+        if (isTenBit)
+            format = plane == 0 ? MTLPixelFormatR16Unorm : MTLPixelFormatRG16Unorm;
+
+        CVReturn err = CVMetalTextureCacheCreateTextureFromImage(kCFAllocatorDefault,
+                                                                 _textureCache,
+                                                                 pixelBuffer,
+                                                                 NULL,
+                                                                 format,
+                                                                 planeWidth,
+                                                                 planeHeight,
+                                                                 plane,
+                                                                 &textures[plane]);
+        if (err != kCVReturnSuccess) {
+            IJK_EVLOG2(IJK_EV_METAL_TEXTURE_FAILED, plane, err);
+            if (textures[0])
+                CFRelease(textures[0]);
+            _textureCacheMisses++;
+            return NO;
+        }
+    }
+
+    [self releaseSourceCVTextures];
+    _sourceCVTextures[0] = textures[0];
+    _sourceCVTextures[1] = textures[1];
+
+    CFTypeRef matrixKey   = CVBufferGetAttachment(pixelBuffer, kCVImageBufferYCbCrMatrixKey, NULL);
+    BOOL      isFullRange = (pixelFormat == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange);
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    isFullRange = isFullRange || pixelFormat == kCVPixelFormatType_420YpCbCr10BiPlanarFullRange;
+#endif
+    BOOL      isBT2020    = (matrixKey != NULL &&
+                             CFStringCompare(matrixKey, kCVImageBufferYCbCrMatrix_ITU_R_2020, 0) == kCFCompareEqualTo);
+    BOOL      isBT709     = (matrixKey == NULL ||
+                             CFStringCompare(matrixKey, kCVImageBufferYCbCrMatrix_ITU_R_709_2, 0) == kCFCompareEqualTo);
+    const float (*matrix)[4] = NULL;
+    if (isBT2020)
+        matrix = isFullRange ? g_bt2020_full_range : g_bt2020_video_range;
+    else if (isBT709)
+        matrix = isFullRange ? g_bt709_full_range : g_bt709_video_range;
+    else
+        matrix = isFullRange ? g_bt601_full_range : g_bt601_video_range;
+
+    memcpy(_uniforms.colorConversion, matrix, sizeof(_uniforms.colorConversion));
+    _uniforms.offset[0] = isFullRange ? 0.0f : (isTenBit ? 64.0f / 1023.0f : 16.0f / 255.0f);
+    _uniforms.offset[1] = 0.5f;
+    _uniforms.offset[2] = 0.5f;
+
+    [self updateTransferForPixelBuffer:pixelBuffer];
+    return YES;
+}
+
+- (void)updateTransferForPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    IJKSDLMetalTransfer transfer = IJKSDLMetalTransferSDR;
+    float               peakNits = IJK_METAL_DEFAULT_PEAK_NITS;
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 110000
+    if (@available(iOS 11.0, *)) {
+        CFTypeRef transferKey = CVBufferGetAttachment(pixelBuffer, kCVImageBufferTransferFunctionKey, NULL);
+        if (transferKey && CFEqual(transferKey, kCVImageBufferTransferFunction_SMPTE_ST_2084_PQ))
+            transfer = IJKSDLMetalTransferPQ;
+        else if (transferKey && CFEqual(transferKey, kCVImageBufferTransferFunction_ITU_R_2100_HLG))
+            transfer = IJKSDLMetalTransferHLG;
+
+        // SMPTE ST 2086, big endian: max luminance in 0.0001 nits at byte 16
+        CFTypeRef volume = CVBufferGetAttachment(pixelBuffer, kCVImageBufferMasteringDisplayColorVolumeKey, NULL);
+        if (volume && CFGetTypeID(volume) == CFDataGetTypeID() && CFDataGetLength(volume) >= 24) {
+            const UInt8 *bytes = CFDataGetBytePtr(volume);
+            uint32_t maxLuminance = ((uint32_t)bytes[16] << 24) | ((uint32_t)bytes[17] << 16) |
+                                    ((uint32_t)bytes[18] << 8)  |  (uint32_t)bytes[19];
+            if (maxLuminance > 0)
+                peakNits = maxLuminance / 10000.0f;
+        }
+    }
+#endif
+
+    _uniforms.hdr[2] = peakNits / IJK_METAL_SDR_WHITE_NITS;
+    [self setTransfer:transfer];
+}
+
+- (void)setTransfer:(IJKSDLMetalTransfer)transfer
+{
+    _uniforms.hdr[0] = transfer;
+    if (transfer != _transfer) {
+        _transfer = transfer;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self configureLayerForTransfer:transfer];
+        });
+    }
+}
+
+// EDR capable screens show PQ and HLG as they are, from a float drawable in
+// the matching colour space; others get the signal tone mapped to SDR
+- (void)configureLayerForTransfer:(IJKSDLMetalTransfer)transfer
+{
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 160000
+    if (@available(iOS 16.0, *)) {
+        UIScreen *screen = self.window.screen ?: [UIScreen mainScreen];
+        BOOL edr = transfer != IJKSDLMetalTransferSDR && screen.potentialEDRHeadroom > 1.0;
+
+        CGColorSpaceRef colorSpace = NULL;
+        if (edr)
+            colorSpace = CGColorSpaceCreateWithName(transfer == IJKSDLMetalTransferPQ ? kCGColorSpaceITUR_2100_PQ : kCGColorSpaceITUR_2100_HLG);
+        _metalLayer.wantsExtendedDynamicRangeContent = edr;
+        _metalLayer.pixelFormat = edr ? MTLPixelFormatRGBA16Float : MTLPixelFormatBGRA8Unorm;
+        _metalLayer.colorspace  = colorSpace;
+        CGColorSpaceRelease(colorSpace);
+    }
+#endif
+}
+
+- (BOOL)prepareI420Overlay:(SDL_VoutOverlay *)overlay
+{
+    int width  = overlay->w;
+    int height = overlay->h;
+
+    int index = (_i420Index + 1) % IJK_METAL_MAX_FRAMES_IN_FLIGHT;
+    for (int plane = 0; plane < 3; ++plane) {
+        NSUInteger planeWidth  = plane == 0 ? width  : (width  + 1) / 2;
+        NSUInteger planeHeight = plane == 0 ? height : (height + 1) / 2;
+
+        id<MTLTexture> texture = _i420Textures[index][plane];
+        if (texture == nil || texture.width != planeWidth || texture.height != planeHeight) {
+            MTLTextureDescriptor *desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR8Unorm
+                                                                                            width:planeWidth
+                                                                                           height:planeHeight
+                                                                                        mipmapped:NO];
+            texture = [_device newTextureWithDescriptor:desc];
+            if (texture == nil)
+                return NO;
+            _i420Textures[index][plane] = texture;
+        }
+
+        [texture replaceRegion:MTLRegionMake2D(0, 0, planeWidth, planeHeight)
+                   mipmapLevel:0
+                     withBytes:overlay->pixels[plane]
+                   bytesPerRow:overlay->pitches[plane]];
+    }
+    _i420Index = index;
+
+    memcpy(_uniforms.colorConversion, g_bt709_video_range, sizeof(_uniforms.colorConversion));
+    _uniforms.offset[0] = 16.0f / 255.0f;
+    _uniforms.offset[1] = 0.5f;
+    _uniforms.offset[2] = 0.5f;
+
+    [self setTransfer:IJKSDLMetalTransferSDR];
+    return YES;
+}
+
+- (void)updatePlacementForDrawableSize:(CGSize)drawableSize
+{
+    float nW = 1.0f;
+    float nH = 1.0f;
+
+    if (_gravity != IJKSDLMetalViewGravityResize &&
+        _frameWidth > 0 && _frameHeight > 0 && drawableSize.width > 0 && drawableSize.height > 0) {
+        float width  = _frameWidth;
+        float height = _frameHeight;
+        if (_frameSarNum > 0 && _frameSarDen > 0)
+            width = width * _frameSarNum / _frameSarDen;
+
+        float dW = drawableSize.width  / width;
+        float dH = drawableSize.height / height;
+        float dd = (_gravity == IJKSDLMetalViewGravityResizeAspectFill) ? MAX(dW, dH) : MIN(dW, dH);
+
+        nW = (width  * dd / (float)drawableSize.width);
+        nH = (height * dd / (float)drawableSize.height);
+    }
+
+    _uniforms.rect[2] = drawableSize.width  * nW;
+    _uniforms.rect[3] = drawableSize.height * nH;
+    _uniforms.rect[0] = (drawableSize.width  - _uniforms.rect[2]) / 2;
+    _uniforms.rect[1] = (drawableSize.height - _uniforms.rect[3]) / 2;
+
+    _uniforms.texScale[0] = 1.0f;
+    _uniforms.texScale[1] = 1.0f;
+    if (_sourceFormat == SDL_FCC__VTB && _framePitch > _frameWidth && _framePitch > 0)
+        _uniforms.texScale[0] = (float)_frameWidth / (float)_framePitch;
+}
+
+- (void)display: (SDL_VoutOverlay *) overlay
+{
+    if (!_isApplicationActive || (overlay && [_pacer shouldDropFrame])) {
+        if (overlay)
+            _droppedPresents++;
+        return;
+    }
+    // nothing to redraw before the first frame
+    if (!overlay && !_didSetupMetal)
+        return;
+
+    // triple buffering: never block the video thread for long on a busy GPU
+    dispatch_time_t timeout = dispatch_time(DISPATCH_TIME_NOW, IJK_METAL_DRAWABLE_TIMEOUT_MS * NSEC_PER_MSEC);
+    if (dispatch_semaphore_wait(_inflightSemaphore, timeout) != 0) {
+        if (overlay)
+            _droppedPresents++;
+        return;
+    }
+
+    [_renderLock lock];
+    if (![self setupMetalOnce] || ![self displayInternal:overlay]) {
+        dispatch_semaphore_signal(_inflightSemaphore);
+        if (overlay)
+            _droppedPresents++;
+    }
+    [_renderLock unlock];
+}
+
+// returns YES if a command buffer was committed
+- (BOOL)displayInternal: (SDL_VoutOverlay *) overlay
+{
+    if (overlay) {
+        BOOL prepared = NO;
+        switch (overlay->format) {
+            case SDL_FCC__VTB:
+                prepared = [self prepareVideoToolboxOverlay:overlay];
+                break;
+            case SDL_FCC_I420:
+                prepared = [self prepareI420Overlay:overlay];
+                break;
+            default:
+                if (!_didLogUnsupportedFormat) {
+                    ALOGE("[Metal] unsupported overlay format %.4s\n", (const char *)&overlay->format);
+                    _didLogUnsupportedFormat = YES;
+                }
+                break;
+        }
+        if (!prepared)
+            return NO;
+
+        _sourceFormat = overlay->format;
+        _frameWidth   = overlay->w;
+        _frameHeight  = overlay->h;
+        _frameSarNum  = overlay->sar_num;
+        _frameSarDen  = overlay->sar_den;
+        _framePitch   = overlay->pitches[0];
+
+        // decoders tag the interlaced pictures, I420 overlays carry nothing
+        _frameInterlaced = NO;
+        if (overlay->format == SDL_FCC__VTB) {
+            CVPixelBufferRef pixelBuffer = SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay);
+            CFTypeRef fieldCount = pixelBuffer ? CVBufferGetAttachment(pixelBuffer, kCVImageBufferFieldCountKey, NULL) : NULL;
+            _frameInterlaced = fieldCount && [(__bridge NSNumber *)fieldCount intValue] == 2;
+        }
+    }
+
+    id<MTLComputePipelineState> pipeline = nil;
+    id<MTLTexture> sources[3] = {nil, nil, nil};
+    int planes = 0;
+    switch (_sourceFormat) {
+        case SDL_FCC__VTB:
+            if (!_sourceCVTextures[0] || !_sourceCVTextures[1])
+                return NO;
+            pipeline   = _nv12Pipeline;
+            sources[0] = CVMetalTextureGetTexture(_sourceCVTextures[0]);
+            sources[1] = CVMetalTextureGetTexture(_sourceCVTextures[1]);
+            planes     = 2;
+            break;
+        case SDL_FCC_I420:
+            if (_i420Textures[_i420Index][0] == nil)
+                return NO;
+            pipeline   = _i420Pipeline;
+            sources[0] = _i420Textures[_i420Index][0];
+            sources[1] = _i420Textures[_i420Index][1];
+            sources[2] = _i420Textures[_i420Index][2];
+            planes     = 3;
+            break;
+        default:
+            return NO;
+    }
+
+    id<CAMetalDrawable> drawable = [_metalLayer nextDrawable];
+    if (drawable == nil)
+        return NO;
+
+    CGSize drawableSize = CGSizeMake(drawable.texture.width, drawable.texture.height);
+    [self updatePlacementForDrawableSize:drawableSize];
+    // the layer is reconfigured on the main thread, go by what it gave
+    _uniforms.hdr[1] = drawable.texture.pixelFormat == MTLPixelFormatRGBA16Float ? 1.0f : 0.0f;
+    _uniforms.post[0] = _frameInterlaced ? (float)_deinterlaceMode : 0.0f;
+    _uniforms.post[1] = (float)_scalingFilter;
+    _uniforms.post[2] = (float)MAX(_sharpness, 0);
+
+    id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
+    id<MTLComputeCommandEncoder> encoder = [commandBuffer computeCommandEncoder];
+    [encoder setComputePipelineState:pipeline];
+    for (int i = 0; i < planes; ++i)
+        [encoder setTexture:sources[i] atIndex:i];
+    [encoder setTexture:drawable.texture atIndex:planes];
+    [encoder setBytes:&_uniforms length:sizeof(_uniforms) atIndex:0];
+
+    NSUInteger threadWidth  = pipeline.threadExecutionWidth;
+    NSUInteger threadHeight = pipeline.maxTotalThreadsPerThreadgroup / threadWidth;
+    MTLSize threadsPerGroup = MTLSizeMake(threadWidth, threadHeight, 1);
+    MTLSize groups          = MTLSizeMake((drawableSize.width  + threadWidth  - 1) / threadWidth,
+                                          (drawableSize.height + threadHeight - 1) / threadHeight,
+                                          1);
+    [encoder dispatchThreadgroups:groups threadsPerThreadgroup:threadsPerGroup];
+    [encoder endEncoding];
+
+    [self encodeSubtitles:commandBuffer target:drawable.texture];
+
+    // keep the CoreVideo backed textures alive until the GPU is done with them
+    CVMetalTextureRef lumaTexture   = NULL;
+    CVMetalTextureRef chromaTexture = NULL;
+    if (_sourceFormat == SDL_FCC__VTB) {
+        lumaTexture   = (CVMetalTextureRef)CFRetain(_sourceCVTextures[0]);
+        chromaTexture = (CVMetalTextureRef)CFRetain(_sourceCVTextures[1]);
+    }
+    dispatch_semaphore_t inflightSemaphore = _inflightSemaphore;
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+        if (lumaTexture)
+            CFRelease(lumaTexture);
+        if (chromaTexture)
+            CFRelease(chromaTexture);
+        dispatch_semaphore_signal(inflightSemaphore);
+    }];
+    CFTimeInterval minimumDuration = overlay ? [_pacer minimumPresentDuration] : 0;
+    if (minimumDuration > 0)
+        [commandBuffer presentDrawable:drawable afterMinimumDuration:minimumDuration];
+    else
+        [commandBuffer presentDrawable:drawable];
+    [commandBuffer commit];
+
+    if (overlay) {
+        CFTimeInterval   landed      = [_pacer didPresentFrame];
+        CVPixelBufferRef pixelBuffer = NULL;
+        if (overlay->format == SDL_FCC__VTB) {
+            pixelBuffer = SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay);
+            [_frameLatency didPresentPixelBuffer:pixelBuffer];
+            [self didPresentPixelBuffer:pixelBuffer];
+        }
+        [self.syncProbe didDisplayPixelBuffer:pixelBuffer at:landed];
+        _presentedFrames++;
+        [_capture didDisplayOverlay:overlay];
+        [self updateFps];
+    }
+    return YES;
+}
+
+#pragma mark subtitles
+
+- (id<MTLRenderPipelineState>)subtitlePipelineForPixelFormat:(MTLPixelFormat)pixelFormat
+{
+    if (_subtitlePipeline && _subtitlePixelFormat == pixelFormat)
+        return _subtitlePipeline;
+
+    MTLRenderPipelineDescriptor *desc = [[MTLRenderPipelineDescriptor alloc] init];
+    desc.vertexFunction   = [_library newFunctionWithName:@"ijk_subtitle_vertex"];
+    desc.fragmentFunction = [_library newFunctionWithName:@"ijk_subtitle_fragment"];
+
+    MTLRenderPipelineColorAttachmentDescriptor *color = desc.colorAttachments[0];
+    color.pixelFormat                 = pixelFormat;
+    color.blendingEnabled             = YES;
+    color.sourceRGBBlendFactor        = MTLBlendFactorOne;
+    color.sourceAlphaBlendFactor      = MTLBlendFactorOne;
+    color.destinationRGBBlendFactor   = MTLBlendFactorOneMinusSourceAlpha;
+    color.destinationAlphaBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+
+    NSError *error = nil;
+    _subtitlePipeline    = [_device newRenderPipelineStateWithDescriptor:desc error:&error];
+    _subtitlePixelFormat = pixelFormat;
+    if (_subtitlePipeline == nil)
+        NSLog(@"IJKSDLMetalView: failed to create subtitle pipeline: %@\n", error);
+    return _subtitlePipeline;
+}
+
+// a render pass over the drawable the kernel wrote, if there are subtitles
+- (void)encodeSubtitles:(id<MTLCommandBuffer>)commandBuffer target:(id<MTLTexture>)target
+{
+    CGRect drawable = CGRectMake(0, 0, target.width, target.height);
+    CGRect area     = CGRectIntersection(CGRectMake(_uniforms.rect[0], _uniforms.rect[1],
+                                                    _uniforms.rect[2], _uniforms.rect[3]), drawable);
+    if (CGRectIsEmpty(area))
+        return;
+
+    // new events go to free space of the atlas, which the frames in flight
+    // do not sample; a reset of the atlas may show on them, for a frame
+    IJKSDLSubtitleQuad quads[IJK_SUBTITLE_MAX_QUADS];
+    NSUInteger count = [_subtitleOverlay prepareForVideoSize:area.size
+                                                       quads:quads
+                                                    maxCount:IJK_SUBTITLE_MAX_QUADS
+                                                      upload:^(const uint8_t *rows, int y, int height) {
+        if (_subtitleTexture == nil) {
+            MTLTextureDescriptor *desc =
+                [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                                                                   width:IJK_SUBTITLE_ATLAS_SIZE
+                                                                  height:IJK_SUBTITLE_ATLAS_SIZE
+                                                               mipmapped:NO];
+            desc.usage = MTLTextureUsageShaderRead;
+            _subtitleTexture = [_device newTextureWithDescriptor:desc];
+        }
+        [_subtitleTexture replaceRegion:MTLRegionMake2D(0, y, IJK_SUBTITLE_ATLAS_SIZE, height)
+                            mipmapLevel:0
+                              withBytes:rows
+                            bytesPerRow:IJK_SUBTITLE_ATLAS_SIZE * 4];
+    }];
+    if (count == 0 || _subtitleTexture == nil)
+        return;
+
+    id<MTLRenderPipelineState> pipeline = [self subtitlePipelineForPixelFormat:target.pixelFormat];
+    if (pipeline == nil)
+        return;
+
+    // two triangles a quad, in clip space, y up
+    float vertices[IJK_SUBTITLE_MAX_QUADS * 6][4];
+    for (NSUInteger i = 0; i < count; ++i) {
+        CGRect f = quads[i].frame;
+        CGRect t = quads[i].texcoords;
+        float x0 = (area.origin.x + f.origin.x * area.size.width)  / drawable.size.width  * 2 - 1;
+        float x1 = x0 + f.size.width  * area.size.width  / drawable.size.width  * 2;
+        float y0 = 1 - (area.origin.y + f.origin.y * area.size.height) / drawable.size.height * 2;
+        float y1 = y0 - f.size.height * area.size.height / drawable.size.height * 2;
+        float u0 = t.origin.x, u1 = t.origin.x + t.size.width;
+        float v0 = t.origin.y, v1 = t.origin.y + t.size.height;
+        float quad[6][4] = {
+            { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x0, y1, u0, v1 },
+            { x1, y0, u1, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 },
+        };
+        memcpy(vertices[i * 6], quad, sizeof(quad));
+    }
+    float hdr[4] = { _uniforms.hdr[0], _uniforms.hdr[1], 0, 0 };
+
+    MTLRenderPassDescriptor *pass = [MTLRenderPassDescriptor renderPassDescriptor];
+    pass.colorAttachments[0].texture     = target;
+    pass.colorAttachments[0].loadAction  = MTLLoadActionLoad;
+    pass.colorAttachments[0].storeAction = MTLStoreActionStore;
+
+    id<MTLRenderCommandEncoder> encoder = [commandBuffer renderCommandEncoderWithDescriptor:pass];
+    [encoder setRenderPipelineState:pipeline];
+    [encoder setVertexBytes:vertices length:count * 6 * sizeof(vertices[0]) atIndex:0];
+    [encoder setFragmentTexture:_subtitleTexture atIndex:0];
+    [encoder setFragmentBytes:hdr length:sizeof(hdr) atIndex:0];
+    [encoder drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:count * 6];
+    [encoder endEncoding];
+}
+
+- (void)updateFps
+{
+    int64_t current = (int64_t)SDL_GetTickHR();
+    int64_t delta   = (current > _lastFrameTime) ? current - _lastFrameTime : 0;
+    if (delta <= 0) {
+        _lastFrameTime = current;
+    } else if (delta >= 1000) {
+        _fps = ((CGFloat)_frameCount) * 1000 / delta;
+        _frameCount = 0;
+        _lastFrameTime = current;
+    } else {
+        _frameCount++;
+    }
+}
+
+#pragma mark pacing
+
+- (void)setContentFrameRate:(CGFloat)contentFrameRate
+{
+    _pacer.contentFrameRate = contentFrameRate;
+}
+
+- (CGFloat)contentFrameRate
+{
+    return _pacer.contentFrameRate;
+}
+
+- (void)setMaximumFrameRate:(CGFloat)maximumFrameRate
+{
+    _pacer.maximumFrameRate = maximumFrameRate;
+}
+
+- (CGFloat)maximumFrameRate
+{
+    return _pacer.maximumFrameRate;
+}
+
+- (CGFloat)judder
+{
+    return _pacer.judder;
+}
+
+- (int64_t)droppedPresents
+{
+    return _droppedPresents;
+}
+
+- (int64_t)presentedFrames
+{
+    return _presentedFrames;
+}
+
+- (int64_t)textureBytes
+{
+    [_renderLock lock];
+    int64_t bytes = (int64_t)_frameWidth * _frameHeight * 3 / 2;
+    [_renderLock unlock];
+    return bytes;
+}
+
+- (void)releaseDrawables
+{
+    [_capture reset];
+    [_renderLock lock];
+    // let in-flight frames release their textures
+    for (int i = 0; i < IJK_METAL_MAX_FRAMES_IN_FLIGHT; ++i)
+        dispatch_semaphore_wait(_inflightSemaphore, DISPATCH_TIME_FOREVER);
+    for (int i = 0; i < IJK_METAL_MAX_FRAMES_IN_FLIGHT; ++i)
+        dispatch_semaphore_signal(_inflightSemaphore);
+
+    [self releaseSourceCVTextures];
+    if (_textureCache)
+        CVMetalTextureCacheFlush(_textureCache, 0);
+    for (int i = 0; i < IJK_METAL_MAX_FRAMES_IN_FLIGHT; ++i) {
+        for (int plane = 0; plane < 3; ++plane)
+            _i420Textures[i][plane] = nil;
+    }
+    _subtitleTexture = nil;
+    [_subtitleOverlay invalidateTexture];
+    // nothing to redraw until the next frame
+    _sourceFormat = 0;
+    _frameWidth   = 0;
+    _frameHeight  = 0;
+    [_renderLock unlock];
+}
+
+- (void)flushTextureCache
+{
+    [_renderLock lock];
+    if (_textureCache)
+        CVMetalTextureCacheFlush(_textureCache, 0);
+    [_renderLock unlock];
+}
+
+#pragma mark AppDelegate
+
+- (void)registerApplicationObservers
+{
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationDidBecomeActive)
+                                                 name:UIApplicationDidBecomeActiveNotification
+                                               object:nil];
+    [_registeredNotifications addObject:UIApplicationDidBecomeActiveNotification];
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationWillResignActive)
+                                                 name:UIApplicationWillResignActiveNotification
+                                               object:nil];
+    [_registeredNotifications addObject:UIApplicationWillResignActiveNotification];
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(applicationWillResignActive)
+                                                 name:UIApplicationDidEnterBackgroundNotification
+                                               object:nil];
+    [_registeredNotifications addObject:UIApplicationDidEnterBackgroundNotification];
+}
+
+- (void)unregisterApplicationObservers
+{
+    for (NSString *name in _registeredNotifications) {
+        [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                        name:name
+                                                      object:nil];
+    }
+}
+
+- (void)applicationDidBecomeActive
+{
+    NSLog(@"IJKSDLMetalView:applicationDidBecomeActive: %d", (int)[UIApplication sharedApplication].applicationState);
+    _isApplicationActive = YES;
+}
+
+- (void)applicationWillResignActive
+{
+    NSLog(@"IJKSDLMetalView:applicationWillResignActive: %d", (int)[UIApplication sharedApplication].applicationState);
+    // GPU work is not permitted in background
+    _isApplicationActive = NO;
+}
+
+#pragma mark snapshot
+
+- (void)captureFrame:(void (^)(UIImage *image))completion
+{
+    __weak typeof(self) weakSelf = self;
+    [_capture captureWithFallback:^UIImage *{
+        return [weakSelf snapshot];
+    } completion:completion];
+}
+
+- (void)setFrameOutputHandler:(void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts))handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate
+{
+    [_capture setFrameOutputHandler:handler
+                              queue:queue
+                      frameInterval:frameInterval
+                   maximumFrameRate:maximumFrameRate];
+}
+
+- (UIImage*)snapshot
+{
+    if (CGSizeEqualToSize(self.bounds.size, CGSizeZero)) {
+        return nil;
+    }
+    UIGraphicsBeginImageContextWithOptions(self.bounds.size, NO, 0.0);
+    [self drawViewHierarchyInRect:self.bounds afterScreenUpdates:NO];
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+
+    return image;
+}
+
+#pragma mark IJKFFHudController
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key
+{
+    // from any thread, the hud draws off the main thread
+    [_hudViewController setHudValue:value forKey:key];
+}
+
+- (void)setShouldShowHudView:(BOOL)shouldShowHudView
+{
+    _hudViewController.view.hidden = !shouldShowHudView;
+}
+
+- (BOOL)shouldShowHudView
+{
+    return !_hudViewController.view.hidden;
+}
+
+@end
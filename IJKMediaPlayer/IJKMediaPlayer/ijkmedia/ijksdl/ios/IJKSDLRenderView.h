@@ -0,0 +1,103 @@
+/*
+ * IJKSDLRenderView.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import <CoreVideo/CoreVideo.h>
+#import "IJKSDLFrameLatency.h"
+#import "IJKSDLSubtitleOverlay.h"
+#import "IJKSDLSyncProbe.h"
+
+#include "ijksdl/ijksdl_vout.h"
+
+// common interface of the views a SDL_Vout can present into
+@protocol IJKSDLRenderView <NSObject>
+
+- (void) display: (SDL_VoutOverlay *) overlay;
+
+- (UIImage*) snapshot;
+// the frame on screen, grabbed from the decoded picture and converted off the
+// render thread; completion is called on the main thread, with nil on failure
+- (void) captureFrame: (void (^)(UIImage *image)) completion;
+// the displayed frames handed over without copy, see IJKSDLFrameCapture
+- (void) setFrameOutputHandler: (void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts)) handler
+                         queue: (dispatch_queue_t) queue
+                 frameInterval: (NSUInteger) frameInterval
+              maximumFrameRate: (CGFloat) maximumFrameRate;
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key;
+
+@property(nonatomic, readonly)        CGFloat  fps;
+@property(nonatomic)        CGFloat  scaleFactor;
+@property(nonatomic)        BOOL     shouldShowHudView;
+
+// frames per second of the video, paces the presents on the display refresh; 0 if unknown
+@property(nonatomic)           CGFloat contentFrameRate;
+// frames per second shown at most, the frames in between dropped before
+// they are drawn, as droppedPresents; 0 for no cap
+@property(nonatomic)           CGFloat maximumFrameRate;
+// milliseconds, see IJKSDLFramePacer
+@property(nonatomic, readonly) CGFloat judder;
+// frames given to display: which never reached the screen: replaced by a
+// newer one before the render thread got to them, or refused while the app
+// is in the background
+@property(nonatomic, readonly) int64_t droppedPresents;
+// frames put on screen
+@property(nonatomic, readonly) int64_t presentedFrames;
+
+// software YUV420P frames are copied into IOSurface backed pixel buffers on
+// the decoder thread and drawn like VideoToolbox ones, through the texture
+// cache, instead of being uploaded on the render thread; read by the vout
+// as it creates overlays
+@property(atomic)              BOOL prefersPixelBufferOverlays;
+
+// VideoToolbox texture cache counters
+@property(nonatomic, readonly) int64_t textureCacheHits;
+@property(nonatomic, readonly) int64_t textureCacheMisses;
+
+// latency of the VideoToolbox frames presented, reset with each media
+@property(nonatomic, readonly) IJKSDLFrameLatency *frameLatency;
+
+// bytes of the frame the view holds on to, estimated from its size as NV12
+@property(nonatomic, readonly) int64_t textureBytes;
+// lets go of the textures and buffers the view keeps for reuse; the frame
+// on screen stays
+- (void)flushTextureCache;
+// lets go of everything drawn with, the frame on screen included, for a
+// player that hibernates; set up again by the next frame
+- (void)releaseDrawables;
+
+// subtitles drawn over the video as a layer of their own, each event
+// rasterized once; the player sets the events showing
+@property(nonatomic, readonly) IJKSDLSubtitleOverlay *subtitleOverlay;
+
+// main thread, with the pixel size the video is drawn in whenever it changes,
+// and right away once known; the player scales the VideoToolbox output to it
+@property(nonatomic, copy) void (^displaySizeHandler)(CGSize pixelSize);
+
+// render thread, with IJK_VTB_ATTACHMENT_PTS of each VideoToolbox frame as
+// it is presented; the player fires the timed metadata due by then
+@property(atomic, copy) void (^presentHandler)(NSTimeInterval pts);
+
+// given each frame presented, with the vsync it lands on; nil for none
+@property(atomic, strong) IJKSDLSyncProbe *syncProbe;
+
+@end
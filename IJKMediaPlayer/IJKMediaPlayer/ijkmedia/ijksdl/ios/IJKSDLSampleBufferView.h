@@ -0,0 +1,69 @@
+/*
+ * IJKSDLSampleBufferView.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <UIKit/UIKit.h>
+#import <AVFoundation/AVFoundation.h>
+
+#include "ijksdl/ijksdl_vout.h"
+#import "IJKSDLRenderView.h"
+
+// AVSampleBufferDisplayLayer backed video view.
+// SDL_FCC__VTB overlays are enqueued as they are, no GPU pass of our own:
+// the system compositor shows the decoder's surface. SDL_FCC_I420 overlays
+// are copied into pooled NV12 pixel buffers first.
+@interface IJKSDLSampleBufferView : UIView <IJKSDLRenderView>
+
+- (id) initWithFrame:(CGRect)frame;
+- (void) display: (SDL_VoutOverlay *) overlay;
+
+- (UIImage*) snapshot;
+- (void) captureFrame: (void (^)(UIImage *image)) completion;
+- (void) setFrameOutputHandler: (void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts)) handler
+                         queue: (dispatch_queue_t) queue
+                 frameInterval: (NSUInteger) frameInterval
+              maximumFrameRate: (CGFloat) maximumFrameRate;
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key;
+
+// the layer to give AVPictureInPictureControllerContentSource, on iOS 15 and later
+@property(nonatomic, readonly) AVSampleBufferDisplayLayer *sampleBufferDisplayLayer;
+
+@property(nonatomic, readonly)        CGFloat  fps;
+@property(nonatomic)        CGFloat  scaleFactor;
+@property(nonatomic)        BOOL     shouldShowHudView;
+@property(nonatomic)        CGFloat  contentFrameRate;
+@property(nonatomic)        CGFloat  maximumFrameRate;
+@property(nonatomic, readonly) CGFloat judder;
+@property(nonatomic, readonly) int64_t droppedPresents;
+@property(nonatomic, readonly) int64_t presentedFrames;
+@property(atomic)              BOOL    prefersPixelBufferOverlays;
+
+// always 0, frames are not turned into textures
+@property(nonatomic, readonly) int64_t textureCacheHits;
+@property(nonatomic, readonly) int64_t textureCacheMisses;
+@property(nonatomic, readonly) IJKSDLFrameLatency *frameLatency;
+@property(nonatomic, readonly) IJKSDLSubtitleOverlay *subtitleOverlay;
+@property(nonatomic, copy)     void (^displaySizeHandler)(CGSize pixelSize);
+@property(atomic, copy)        void (^presentHandler)(NSTimeInterval pts);
+@property(atomic, strong)      IJKSDLSyncProbe *syncProbe;
+
+@end
@@ -0,0 +1,604 @@
+/*
+ * IJKSDLSampleBufferView.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLSampleBufferView.h"
+#import <CoreImage/CoreImage.h>
+#import <CoreMedia/CoreMedia.h>
+#import <CoreVideo/CoreVideo.h>
+#include "ijksdl/ijksdl_timer.h"
+#include "ijksdl/ijksdl_log.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#import "IJKSDLHudViewController.h"
+#import "IJKSDLFramePacer.h"
+#import "IJKSDLFrameCapture.h"
+
+@implementation IJKSDLSampleBufferView {
+    CGSize                      _displaySize;
+    AVSampleBufferDisplayLayer *_displayLayer;
+    NSLock                     *_renderLock;
+
+    CMVideoFormatDescriptionRef _formatDesc;
+    CVPixelBufferRef            _lastPixelBuffer;
+
+    // NV12 copies of the software decoded frames
+    CVPixelBufferPoolRef        _i420Pool;
+    int                         _i420PoolWidth;
+    int                         _i420PoolHeight;
+
+    BOOL                        _didLogUnsupportedFormat;
+
+    int                         _frameCount;
+    int64_t                     _lastFrameTime;
+    int64_t                     _droppedPresents;
+    int64_t                     _presentedFrames;
+
+    IJKSDLHudViewController    *_hudViewController;
+
+    // the layer shows frames on its own, only the panel rate and the judder are followed
+    IJKSDLFramePacer           *_pacer;
+    IJKSDLFrameCapture         *_capture;
+
+    // the layer composites, the subtitles are sublayers showing parts of the atlas
+    CALayer                    *_subtitleLayer;
+    CGImageRef                  _subtitleAtlas;
+    CGSize                      _displaySize;   // of the last frame, with its aspect ratio
+}
+
++ (Class) layerClass
+{
+    return [AVSampleBufferDisplayLayer class];
+}
+
+- (id) initWithFrame:(CGRect)frame
+{
+    self = [super initWithFrame:frame];
+    if (self) {
+        _renderLock   = [[NSLock alloc] init];
+        _displayLayer = (AVSampleBufferDisplayLayer *)self.layer;
+        _displayLayer.videoGravity = AVLayerVideoGravityResizeAspect;
+        _displayLayer.opaque       = YES;
+
+        _scaleFactor = [[UIScreen mainScreen] scale];
+        if (_scaleFactor < 0.1f)
+            _scaleFactor = 1.0f;
+
+        _hudViewController = [[IJKSDLHudViewController alloc] init];
+        [self addSubview:_hudViewController.view];
+
+        _pacer = [[IJKSDLFramePacer alloc] init];
+        _frameLatency = [[IJKSDLFrameLatency alloc] init];
+        _capture = [[IJKSDLFrameCapture alloc] init];
+
+        _subtitleLayer = [CALayer layer];
+        [_displayLayer addSublayer:_subtitleLayer];
+        _subtitleOverlay = [[IJKSDLSubtitleOverlay alloc] init];
+        __weak typeof(self) weakSelf = self;
+        _subtitleOverlay.changeHandler = ^{
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [weakSelf layoutSubtitles];
+            });
+        };
+    }
+
+    return self;
+}
+
+- (void)didMoveToWindow
+{
+    [super didMoveToWindow];
+    if (self.window)
+        [_pacer start];
+    else
+        [_pacer stop];
+}
+
+- (void)dealloc
+{
+    [_displayLayer flushAndRemoveImage];
+
+    if (_formatDesc) {
+        CFRelease(_formatDesc);
+        _formatDesc = NULL;
+    }
+    if (_lastPixelBuffer) {
+        CVPixelBufferRelease(_lastPixelBuffer);
+        _lastPixelBuffer = NULL;
+    }
+    if (_i420Pool) {
+        CVPixelBufferPoolRelease(_i420Pool);
+        _i420Pool = NULL;
+    }
+    CGImageRelease(_subtitleAtlas);
+}
+
+- (AVSampleBufferDisplayLayer *)sampleBufferDisplayLayer
+{
+    return _displayLayer;
+}
+
+- (void)layoutSubviews
+{
+    [super layoutSubviews];
+
+    CGRect selfFrame = self.frame;
+    CGRect newFrame  = selfFrame;
+
+    newFrame.size.width   = selfFrame.size.width * 1 / 3;
+    newFrame.origin.x     = selfFrame.size.width * 2 / 3;
+
+    newFrame.size.height  = selfFrame.size.height * 8 / 8;
+    newFrame.origin.y    += selfFrame.size.height * 0 / 8;
+
+    _hudViewController.view.frame = newFrame;
+    [self layoutSubtitles];
+    [self updateDisplaySize];
+}
+
+// main thread: the pixels the video is drawn in, for the decoder to scale to
+- (void)updateDisplaySize
+{
+    CGSize size = CGSizeMake(self.bounds.size.width * _scaleFactor, self.bounds.size.height * _scaleFactor);
+    if (CGSizeEqualToSize(size, _displaySize))
+        return;
+
+    _displaySize = size;
+    if (_displaySizeHandler)
+        _displaySizeHandler(size);
+}
+
+- (void)setDisplaySizeHandler:(void (^)(CGSize))displaySizeHandler
+{
+    _displaySizeHandler = [displaySizeHandler copy];
+    if (_displaySizeHandler && _displaySize.width > 0 && _displaySize.height > 0)
+        _displaySizeHandler(_displaySize);
+}
+
+// render thread
+- (void)didPresentPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    void (^presentHandler)(NSTimeInterval) = self.presentHandler;
+    if (!presentHandler)
+        return;
+
+    NSTimeInterval pts = SDL_VoutOverlayVideoToolBox_GetPresentationTime(pixelBuffer);
+    if (!isnan(pts))
+        presentHandler(pts);
+}
+
+- (void)setContentMode:(UIViewContentMode)contentMode
+{
+    [super setContentMode:contentMode];
+
+    switch (contentMode) {
+        case UIViewContentModeScaleToFill:
+            _displayLayer.videoGravity = AVLayerVideoGravityResize;
+            break;
+        case UIViewContentModeScaleAspectFill:
+            _displayLayer.videoGravity = AVLayerVideoGravityResizeAspectFill;
+            break;
+        case UIViewContentModeScaleAspectFit:
+        default:
+            _displayLayer.videoGravity = AVLayerVideoGravityResizeAspect;
+            break;
+    }
+    [self layoutSubtitles];
+}
+
+#pragma mark render
+
+- (CVPixelBufferRef)copyI420Overlay:(SDL_VoutOverlay *)overlay CF_RETURNS_RETAINED
+{
+    int width  = overlay->w;
+    int height = overlay->h;
+
+    if (!_i420Pool || _i420PoolWidth != width || _i420PoolHeight != height) {
+        if (_i420Pool) {
+            CVPixelBufferPoolRelease(_i420Pool);
+            _i420Pool = NULL;
+        }
+
+        NSDictionary *attributes = @{
+            (id)kCVPixelBufferPixelFormatTypeKey:     @(kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange),
+            (id)kCVPixelBufferWidthKey:               @(width),
+            (id)kCVPixelBufferHeightKey:              @(height),
+            (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+        };
+        CVReturn err = CVPixelBufferPoolCreate(kCFAllocatorDefault, NULL, (__bridge CFDictionaryRef)attributes, &_i420Pool);
+        if (err != kCVReturnSuccess || !_i420Pool) {
+            ALOGE("[SampleBuffer] CVPixelBufferPoolCreate failed: %d\n", err);
+            return NULL;
+        }
+        _i420PoolWidth  = width;
+        _i420PoolHeight = height;
+    }
+
+    CVPixelBufferRef pixelBuffer = NULL;
+    if (CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, _i420Pool, &pixelBuffer) != kCVReturnSuccess)
+        return NULL;
+
+    CVPixelBufferLockBaseAddress(pixelBuffer, 0);
+
+    uint8_t *dstY    = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+    size_t   pitchY  = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+    for (int y = 0; y < height; ++y)
+        memcpy(dstY + y * pitchY, overlay->pixels[0] + y * overlay->pitches[0], width);
+
+    uint8_t *dstUV   = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
+    size_t   pitchUV = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
+    int      chromaW = (width  + 1) / 2;
+    int      chromaH = (height + 1) / 2;
+    for (int y = 0; y < chromaH; ++y) {
+        const uint8_t *srcU = overlay->pixels[1] + y * overlay->pitches[1];
+        const uint8_t *srcV = overlay->pixels[2] + y * overlay->pitches[2];
+        uint8_t       *dst  = dstUV + y * pitchUV;
+        for (int x = 0; x < chromaW; ++x) {
+            dst[2 * x]     = srcU[x];
+            dst[2 * x + 1] = srcV[x];
+        }
+    }
+
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, 0);
+    return pixelBuffer;
+}
+
+- (BOOL)updateFormatDescriptionForPixelBuffer:(CVPixelBufferRef)pixelBuffer
+{
+    if (_formatDesc && CMVideoFormatDescriptionMatchesImageBuffer(_formatDesc, pixelBuffer))
+        return YES;
+
+    if (_formatDesc) {
+        CFRelease(_formatDesc);
+        _formatDesc = NULL;
+    }
+
+    OSStatus status = CMVideoFormatDescriptionCreateForImageBuffer(kCFAllocatorDefault, pixelBuffer, &_formatDesc);
+    if (status != noErr || !_formatDesc) {
+        ALOGE("[SampleBuffer] CMVideoFormatDescriptionCreateForImageBuffer failed: %d\n", (int)status);
+        return NO;
+    }
+    return YES;
+}
+
+- (void)display: (SDL_VoutOverlay *) overlay
+{
+    // the layer keeps showing its last frame, nothing to redraw
+    if (!overlay)
+        return;
+
+    [_renderLock lock];
+    if ([_pacer shouldDropFrame] || ![self displayInternal:overlay])
+        _droppedPresents++;
+    [_renderLock unlock];
+}
+
+- (BOOL)displayInternal: (SDL_VoutOverlay *) overlay
+{
+    CVPixelBufferRef pixelBuffer = NULL;
+    switch (overlay->format) {
+        case SDL_FCC__VTB:
+            pixelBuffer = SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay);
+            if (pixelBuffer)
+                CVPixelBufferRetain(pixelBuffer);
+            break;
+        case SDL_FCC_I420:
+            pixelBuffer = [self copyI420Overlay:overlay];
+            break;
+        default:
+            if (!_didLogUnsupportedFormat) {
+                ALOGE("[SampleBuffer] unsupported overlay format %.4s\n", (const char *)&overlay->format);
+                _didLogUnsupportedFormat = YES;
+            }
+            break;
+    }
+    if (!pixelBuffer)
+        return NO;
+
+    if (overlay->sar_num > 0 && overlay->sar_den > 0) {
+        NSDictionary *aspectRatio = @{
+            (id)kCVImageBufferPixelAspectRatioHorizontalSpacingKey: @(overlay->sar_num),
+            (id)kCVImageBufferPixelAspectRatioVerticalSpacingKey:   @(overlay->sar_den),
+        };
+        CVBufferSetAttachment(pixelBuffer, kCVImageBufferPixelAspectRatioKey,
+                              (__bridge CFDictionaryRef)aspectRatio, kCVAttachmentMode_ShouldPropagate);
+    }
+
+    if (![self updateFormatDescriptionForPixelBuffer:pixelBuffer]) {
+        CVPixelBufferRelease(pixelBuffer);
+        return NO;
+    }
+
+    // the player's video refresh already paces the frames against the master clock
+    CMSampleTimingInfo timing = {kCMTimeInvalid, kCMTimeInvalid, kCMTimeInvalid};
+    CMSampleBufferRef sampleBuffer = NULL;
+    OSStatus status = CMSampleBufferCreateReadyWithImageBuffer(kCFAllocatorDefault, pixelBuffer, _formatDesc, &timing, &sampleBuffer);
+    if (status != noErr || !sampleBuffer) {
+        ALOGE("[SampleBuffer] CMSampleBufferCreateReadyWithImageBuffer failed: %d\n", (int)status);
+        CVPixelBufferRelease(pixelBuffer);
+        return NO;
+    }
+
+    CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sampleBuffer, YES);
+    if (attachments && CFArrayGetCount(attachments) > 0) {
+        CFMutableDictionaryRef attachment = (CFMutableDictionaryRef)CFArrayGetValueAtIndex(attachments, 0);
+        CFDictionarySetValue(attachment, kCMSampleAttachmentKey_DisplayImmediately, kCFBooleanTrue);
+    }
+
+    // the layer fails when the app was suspended, flushing brings it back
+    if (_displayLayer.status == AVQueuedSampleBufferRenderingStatusFailed) {
+        ALOGW("[SampleBuffer] display layer failed: %s, flush\n", _displayLayer.error.localizedDescription.UTF8String);
+        [_displayLayer flush];
+    }
+    [_displayLayer enqueueSampleBuffer:sampleBuffer];
+    CFRelease(sampleBuffer);
+
+    if (_lastPixelBuffer)
+        CVPixelBufferRelease(_lastPixelBuffer);
+    _lastPixelBuffer = pixelBuffer;
+
+    CGSize displaySize = CGSizeMake(overlay->w, overlay->h);
+    if (overlay->sar_num > 0 && overlay->sar_den > 0)
+        displaySize.width = displaySize.width * overlay->sar_num / overlay->sar_den;
+    if (!CGSizeEqualToSize(displaySize, _displaySize)) {
+        _displaySize = displaySize;
+        __weak typeof(self) weakSelf = self;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakSelf layoutSubtitles];
+        });
+    }
+
+    CFTimeInterval landed = [_pacer didPresentFrame];
+    [self.syncProbe didDisplayPixelBuffer:pixelBuffer at:landed];
+    _presentedFrames++;
+    if (overlay->format == SDL_FCC__VTB) {
+        [_frameLatency didPresentPixelBuffer:pixelBuffer];
+        [self didPresentPixelBuffer:pixelBuffer];
+    }
+    [_capture didDisplayOverlay:overlay];
+    [self updateFps];
+    return YES;
+}
+
+#pragma mark subtitles
+
+// main thread; the sublayers of the events showing, over the picture
+- (void)layoutSubtitles
+{
+    [_renderLock lock];
+    CGSize displaySize = _displaySize;
+    [_renderLock unlock];
+
+    CGRect bounds = self.bounds;
+    CGRect video  = bounds;
+    if (displaySize.width > 0 && displaySize.height > 0) {
+        if ([_displayLayer.videoGravity isEqualToString:AVLayerVideoGravityResizeAspect]) {
+            video = AVMakeRectWithAspectRatioInsideRect(displaySize, bounds);
+        } else if ([_displayLayer.videoGravity isEqualToString:AVLayerVideoGravityResizeAspectFill]) {
+            CGFloat scale = MAX(bounds.size.width / displaySize.width, bounds.size.height / displaySize.height);
+            CGSize  size  = CGSizeMake(displaySize.width * scale, displaySize.height * scale);
+            video = CGRectMake(CGRectGetMidX(bounds) - size.width / 2, CGRectGetMidY(bounds) - size.height / 2,
+                               size.width, size.height);
+        }
+    }
+    CGRect area = CGRectIntersection(video, bounds);
+    if (CGRectIsNull(area))
+        area = CGRectZero;
+
+    IJKSDLSubtitleQuad quads[IJK_SUBTITLE_MAX_QUADS];
+    __block BOOL atlasChanged = NO;
+    CGFloat scale = self.window.screen.scale ?: _scaleFactor;
+    NSUInteger count = [_subtitleOverlay prepareForVideoSize:CGSizeMake(area.size.width * scale, area.size.height * scale)
+                                                       quads:quads
+                                                    maxCount:IJK_SUBTITLE_MAX_QUADS
+                                                      upload:^(const uint8_t *rows, int y, int height) {
+        atlasChanged = YES;
+    }];
+    if (atlasChanged) {
+        CGImageRelease(_subtitleAtlas);
+        _subtitleAtlas = [_subtitleOverlay copyAtlasImage];
+    }
+
+    [CATransaction begin];
+    [CATransaction setDisableActions:YES];
+    _subtitleLayer.frame = area;
+    NSArray *sublayers = [_subtitleLayer.sublayers copy];
+    for (NSUInteger i = 0; i < MAX(count, sublayers.count); ++i) {
+        if (i >= count) {
+            [sublayers[i] removeFromSuperlayer];
+            continue;
+        }
+        CALayer *layer = i < sublayers.count ? sublayers[i] : nil;
+        if (!layer) {
+            layer = [CALayer layer];
+            [_subtitleLayer addSublayer:layer];
+        }
+        CGRect f = quads[i].frame;
+        layer.frame        = CGRectMake(f.origin.x * area.size.width, f.origin.y * area.size.height,
+                                        f.size.width * area.size.width, f.size.height * area.size.height);
+        layer.contents     = (__bridge id)_subtitleAtlas;
+        layer.contentsRect = quads[i].texcoords;
+    }
+    [CATransaction commit];
+}
+
+- (void)updateFps
+{
+    int64_t current = (int64_t)SDL_GetTickHR();
+    int64_t delta   = (current > _lastFrameTime) ? current - _lastFrameTime : 0;
+    if (delta <= 0) {
+        _lastFrameTime = current;
+    } else if (delta >= 1000) {
+        _fps = ((CGFloat)_frameCount) * 1000 / delta;
+        _frameCount = 0;
+        _lastFrameTime = current;
+    } else {
+        _frameCount++;
+    }
+}
+
+- (int64_t)textureCacheHits
+{
+    return 0;
+}
+
+- (int64_t)textureCacheMisses
+{
+    return 0;
+}
+
+#pragma mark pacing
+
+- (void)setContentFrameRate:(CGFloat)contentFrameRate
+{
+    _pacer.contentFrameRate = contentFrameRate;
+}
+
+- (CGFloat)contentFrameRate
+{
+    return _pacer.contentFrameRate;
+}
+
+- (void)setMaximumFrameRate:(CGFloat)maximumFrameRate
+{
+    _pacer.maximumFrameRate = maximumFrameRate;
+}
+
+- (CGFloat)maximumFrameRate
+{
+    return _pacer.maximumFrameRate;
+}
+
+- (CGFloat)judder
+{
+    return _pacer.judder;
+}
+
+- (int64_t)droppedPresents
+{
+    return _droppedPresents;
+}
+
+- (int64_t)presentedFrames
+{
+    return _presentedFrames;
+}
+
+- (int64_t)textureBytes
+{
+    [_renderLock lock];
+    int64_t bytes = 0;
+    if (_lastPixelBuffer)
+        bytes = (int64_t)CVPixelBufferGetWidth(_lastPixelBuffer) * CVPixelBufferGetHeight(_lastPixelBuffer) * 3 / 2;
+    [_renderLock unlock];
+    return bytes;
+}
+
+// the layer owns what it decodes into, only the copies of the software frames are ours
+- (void)flushTextureCache
+{
+    [_renderLock lock];
+    if (_i420Pool)
+        CVPixelBufferPoolFlush(_i420Pool, kCVPixelBufferPoolFlushExcessBuffers);
+    [_renderLock unlock];
+}
+
+- (void)releaseDrawables
+{
+    [_capture reset];
+    [_displayLayer flushAndRemoveImage];
+    [_renderLock lock];
+    if (_lastPixelBuffer) {
+        CVPixelBufferRelease(_lastPixelBuffer);
+        _lastPixelBuffer = NULL;
+    }
+    if (_i420Pool) {
+        CVPixelBufferPoolRelease(_i420Pool);
+        _i420Pool = NULL;
+    }
+    [_renderLock unlock];
+}
+
+#pragma mark snapshot
+
+- (void)captureFrame:(void (^)(UIImage *image))completion
+{
+    __weak typeof(self) weakSelf = self;
+    [_capture captureWithFallback:^UIImage *{
+        return [weakSelf snapshot];
+    } completion:completion];
+}
+
+- (void)setFrameOutputHandler:(void (^)(CVPixelBufferRef pixelBuffer, NSTimeInterval pts))handler
+                        queue:(dispatch_queue_t)queue
+                frameInterval:(NSUInteger)frameInterval
+             maximumFrameRate:(CGFloat)maximumFrameRate
+{
+    [_capture setFrameOutputHandler:handler
+                              queue:queue
+                      frameInterval:frameInterval
+                   maximumFrameRate:maximumFrameRate];
+}
+
+// the layer content is not part of the view hierarchy rendering,
+// so the last frame is converted instead
+- (UIImage*)snapshot
+{
+    CVPixelBufferRef pixelBuffer = NULL;
+
+    [_renderLock lock];
+    if (_lastPixelBuffer)
+        pixelBuffer = CVPixelBufferRetain(_lastPixelBuffer);
+    [_renderLock unlock];
+
+    if (!pixelBuffer)
+        return nil;
+
+    CIImage   *ciImage = [CIImage imageWithCVPixelBuffer:pixelBuffer];
+    CIContext *context = [CIContext contextWithOptions:nil];
+    CGImageRef cgImage = [context createCGImage:ciImage fromRect:ciImage.extent];
+    CVPixelBufferRelease(pixelBuffer);
+    if (!cgImage)
+        return nil;
+
+    UIImage *image = [UIImage imageWithCGImage:cgImage];
+    CGImageRelease(cgImage);
+    return image;
+}
+
+#pragma mark IJKFFHudController
+- (void)setHudValue:(NSString *)value forKey:(NSString *)key
+{
+    // from any thread, the hud draws off the main thread
+    [_hudViewController setHudValue:value forKey:key];
+}
+
+- (void)setShouldShowHudView:(BOOL)shouldShowHudView
+{
+    _hudViewController.view.hidden = !shouldShowHudView;
+}
+
+- (BOOL)shouldShowHudView
+{
+    return !_hudViewController.view.hidden;
+}
+
+@end
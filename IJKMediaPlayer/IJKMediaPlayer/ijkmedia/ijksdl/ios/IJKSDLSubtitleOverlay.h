@@ -0,0 +1,95 @@
+/*
+ * IJKSDLSubtitleOverlay.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+// side of the square atlas, in pixels
+#define IJK_SUBTITLE_ATLAS_SIZE     1024
+// text is laid out in points of a 720 lines video, and scaled with it
+#define IJK_SUBTITLE_REFERENCE_HEIGHT 720
+#define IJK_SUBTITLE_MAX_QUADS      32
+
+// One subtitle event on screen: a text, or a bitmap such as a DVB or PGS
+// picture. The identifier stays the same as long as the event does, it is
+// how the overlay knows it has drawn it already.
+@interface IJKSDLSubtitleEvent : NSObject
+
+// anchor: normalized in the video, origin top left, where the bottom centre
+// of the text goes
++ (instancetype)eventWithIdentifier:(NSString *)identifier
+                               text:(NSAttributedString *)text
+                             anchor:(CGPoint)anchor;
+// frame: normalized in the video, origin top left
++ (instancetype)eventWithIdentifier:(NSString *)identifier
+                              image:(CGImageRef)image
+                              frame:(CGRect)frame;
+
+@property(nonatomic, readonly) NSString *identifier;
+@property(nonatomic, readonly) NSAttributedString *text;
+@property(nonatomic, readonly) CGPoint anchor;
+@property(nonatomic, readonly) CGImageRef image;
+@property(nonatomic, readonly) CGRect frame;
+
+@end
+
+// an event in the atlas, to draw as one textured quad
+typedef struct IJKSDLSubtitleQuad {
+    CGRect frame;       // in the video, normalized, origin top left
+    CGRect texcoords;   // in the atlas, normalized, origin top left
+} IJKSDLSubtitleQuad;
+
+// Subtitles of a render view, drawn as a layer of their own over the video.
+//
+// Each event is rasterized once, when it first shows, into a shelf packed
+// atlas of premultiplied RGBA; frames after that only draw a quad per event
+// out of the atlas texture, with nothing rasterized nor uploaded. When the
+// atlas is full, or the video size on screen changes the text scale, it is
+// cleared and the events showing are drawn into it again.
+//
+// setEvents: from any thread, the rest from the render thread.
+@interface IJKSDLSubtitleOverlay : NSObject
+
+// the events to show from now on, empty to show none
+- (void)setEvents:(NSArray<IJKSDLSubtitleEvent *> *)events;
+
+// called after the events showing changed, on the thread setting them; the
+// view redraws its last frame with it, for a paused video
+@property(atomic, copy) void (^changeHandler)(void);
+
+// videoSize: in pixels, the area of the render target the subtitles go in.
+// upload is given the atlas rows changed since the last call, if any,
+// IJK_SUBTITLE_ATLAS_SIZE * 4 bytes each, to copy into the texture before
+// the quads are drawn. Returns the number of quads.
+- (NSUInteger)prepareForVideoSize:(CGSize)videoSize
+                            quads:(IJKSDLSubtitleQuad *)quads
+                         maxCount:(NSUInteger)maxCount
+                           upload:(void (^)(const uint8_t *rows, int y, int height))upload;
+
+// the texture was lost, the next prepare uploads the whole atlas
+- (void)invalidateTexture;
+
+// the whole atlas as an image, for views compositing on the CPU
+- (CGImageRef)copyAtlasImage CF_RETURNS_RETAINED;
+
+@end
@@ -0,0 +1,389 @@
+/*
+ * IJKSDLSubtitleOverlay.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLSubtitleOverlay.h"
+#import <UIKit/UIKit.h>
+#include "ijksdl/ijksdl_log.h"
+
+#define IJK_SUBTITLE_ATLAS_STRIDE   (IJK_SUBTITLE_ATLAS_SIZE * 4)
+// transparent pixels between the slots, for the linear filtering
+#define IJK_SUBTITLE_PADDING        2
+#define IJK_SUBTITLE_MAX_SHELVES    64
+// of the video width, where the text wraps
+#define IJK_SUBTITLE_TEXT_WIDTH     0.9
+
+@implementation IJKSDLSubtitleEvent
+
++ (instancetype)eventWithIdentifier:(NSString *)identifier
+                               text:(NSAttributedString *)text
+                             anchor:(CGPoint)anchor
+{
+    IJKSDLSubtitleEvent *event = [[IJKSDLSubtitleEvent alloc] init];
+    event->_identifier = [identifier copy];
+    event->_text       = [text copy];
+    event->_anchor     = anchor;
+    return event;
+}
+
++ (instancetype)eventWithIdentifier:(NSString *)identifier
+                              image:(CGImageRef)image
+                              frame:(CGRect)frame
+{
+    IJKSDLSubtitleEvent *event = [[IJKSDLSubtitleEvent alloc] init];
+    event->_identifier = [identifier copy];
+    event->_image      = CGImageRetain(image);
+    event->_frame      = frame;
+    return event;
+}
+
+- (void)dealloc
+{
+    CGImageRelease(_image);
+}
+
+@end
+
+// where an event sits in the atlas
+@interface IJKSDLSubtitleSlot : NSObject
+@property(nonatomic, strong) IJKSDLSubtitleEvent *event;
+@property(nonatomic)         BOOL   rasterized;
+@property(nonatomic)         CGRect rect;   // in atlas pixels, without the padding
+@end
+
+@implementation IJKSDLSubtitleSlot
+@end
+
+typedef struct IJKSDLSubtitleShelf {
+    int y;
+    int height;
+    int used;
+} IJKSDLSubtitleShelf;
+
+@implementation IJKSDLSubtitleOverlay {
+    NSLock              *_lock;
+    NSArray             *_slots;        // of the events showing, in order
+    uint8_t             *_atlas;
+    CGContextRef         _context;
+
+    IJKSDLSubtitleShelf  _shelves[IJK_SUBTITLE_MAX_SHELVES];
+    int                  _shelfCount;
+    int                  _shelfBottom;
+
+    int                  _dirtyTop;
+    int                  _dirtyBottom;
+
+    // the text of the slots was laid out for it
+    CGSize               _videoSize;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _lock  = [[NSLock alloc] init];
+        _slots = @[];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    CGContextRelease(_context);
+    free(_atlas);
+}
+
+#pragma mark atlas
+
+- (BOOL)setupAtlas
+{
+    if (_context)
+        return YES;
+
+    _atlas = calloc(IJK_SUBTITLE_ATLAS_SIZE, IJK_SUBTITLE_ATLAS_STRIDE);
+    if (!_atlas)
+        return NO;
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    _context = CGBitmapContextCreate(_atlas, IJK_SUBTITLE_ATLAS_SIZE, IJK_SUBTITLE_ATLAS_SIZE, 8,
+                                     IJK_SUBTITLE_ATLAS_STRIDE, colorSpace,
+                                     kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    if (!_context) {
+        free(_atlas);
+        _atlas = NULL;
+        return NO;
+    }
+
+    [self markDirtyFrom:0 to:IJK_SUBTITLE_ATLAS_SIZE];
+    return YES;
+}
+
+- (void)markDirtyFrom:(int)top to:(int)bottom
+{
+    if (_dirtyTop >= _dirtyBottom) {
+        _dirtyTop    = top;
+        _dirtyBottom = bottom;
+    } else {
+        _dirtyTop    = MIN(_dirtyTop, top);
+        _dirtyBottom = MAX(_dirtyBottom, bottom);
+    }
+}
+
+- (void)resetAtlas
+{
+    for (IJKSDLSubtitleSlot *slot in _slots)
+        slot.rasterized = NO;
+
+    _shelfCount  = 0;
+    _shelfBottom = 0;
+    if (_atlas) {
+        memset(_atlas, 0, IJK_SUBTITLE_ATLAS_SIZE * IJK_SUBTITLE_ATLAS_STRIDE);
+        [self markDirtyFrom:0 to:IJK_SUBTITLE_ATLAS_SIZE];
+    }
+}
+
+// first shelf tall enough with room left, else a new one under the others
+- (BOOL)allocateWidth:(int)width height:(int)height origin:(CGPoint *)origin
+{
+    width  += IJK_SUBTITLE_PADDING;
+    height += IJK_SUBTITLE_PADDING;
+
+    for (int i = 0; i < _shelfCount; ++i) {
+        IJKSDLSubtitleShelf *shelf = &_shelves[i];
+        if (shelf->height >= height && shelf->used + width <= IJK_SUBTITLE_ATLAS_SIZE) {
+            *origin = CGPointMake(shelf->used, shelf->y);
+            shelf->used += width;
+            return YES;
+        }
+    }
+
+    if (_shelfCount >= IJK_SUBTITLE_MAX_SHELVES || _shelfBottom + height > IJK_SUBTITLE_ATLAS_SIZE)
+        return NO;
+
+    IJKSDLSubtitleShelf *shelf = &_shelves[_shelfCount++];
+    shelf->y      = _shelfBottom;
+    shelf->height = height;
+    shelf->used   = width;
+    _shelfBottom += height;
+    *origin = CGPointMake(0, shelf->y);
+    return YES;
+}
+
+// in pixels; the text at the scale of the video, the bitmaps as they are
+- (CGSize)pixelSizeOfEvent:(IJKSDLSubtitleEvent *)event
+{
+    if (event.image)
+        return CGSizeMake(CGImageGetWidth(event.image), CGImageGetHeight(event.image));
+
+    CGFloat scale = _videoSize.height / IJK_SUBTITLE_REFERENCE_HEIGHT;
+    CGSize  bound = CGSizeMake(_videoSize.width * IJK_SUBTITLE_TEXT_WIDTH / scale, CGFLOAT_MAX);
+    CGRect  rect  = [event.text boundingRectWithSize:bound
+                                             options:NSStringDrawingUsesLineFragmentOrigin
+                                             context:nil];
+    return CGSizeMake(ceil(rect.size.width * scale), ceil(rect.size.height * scale));
+}
+
+// NO if the atlas has no room left for it
+- (BOOL)rasterizeSlot:(IJKSDLSubtitleSlot *)slot
+{
+    IJKSDLSubtitleEvent *event = slot.event;
+    CGSize size = [self pixelSizeOfEvent:event];
+    int width   = (int)size.width;
+    int height  = (int)size.height;
+
+    if (width <= 0 || height <= 0 ||
+        width  > IJK_SUBTITLE_ATLAS_SIZE - IJK_SUBTITLE_PADDING ||
+        height > IJK_SUBTITLE_ATLAS_SIZE - IJK_SUBTITLE_PADDING) {
+        // never fits, not worth a reset
+        slot.rect       = CGRectZero;
+        slot.rasterized = YES;
+        return YES;
+    }
+
+    CGPoint origin;
+    if (![self allocateWidth:width height:height origin:&origin])
+        return NO;
+
+    slot.rect = CGRectMake(origin.x, origin.y, width, height);
+
+    // the context has its origin at the bottom left, the atlas rows go down
+    CGRect drawRect = CGRectMake(origin.x, IJK_SUBTITLE_ATLAS_SIZE - origin.y - height, width, height);
+    CGContextClearRect(_context, drawRect);
+    if (event.image) {
+        CGContextDrawImage(_context, drawRect, event.image);
+    } else {
+        CGFloat scale = _videoSize.height / IJK_SUBTITLE_REFERENCE_HEIGHT;
+        CGContextSaveGState(_context);
+        CGContextClipToRect(_context, drawRect);
+        CGContextTranslateCTM(_context, origin.x, IJK_SUBTITLE_ATLAS_SIZE - origin.y);
+        CGContextScaleCTM(_context, scale, -scale);
+        UIGraphicsPushContext(_context);
+        [event.text drawWithRect:CGRectMake(0, 0, width / scale, height / scale)
+                         options:NSStringDrawingUsesLineFragmentOrigin
+                         context:nil];
+        UIGraphicsPopContext();
+        CGContextRestoreGState(_context);
+    }
+
+    slot.rasterized = YES;
+    [self markDirtyFrom:(int)origin.y to:(int)origin.y + height];
+    return YES;
+}
+
+// the slots not drawn yet; a full atlas is cleared for the events showing once
+- (void)rasterizeSlots
+{
+    if (_videoSize.width <= 0 || _videoSize.height <= 0 || _slots.count == 0)
+        return;
+    if (![self setupAtlas])
+        return;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        BOOL full = NO;
+        for (IJKSDLSubtitleSlot *slot in _slots) {
+            if (!slot.rasterized && ![self rasterizeSlot:slot]) {
+                full = YES;
+                break;
+            }
+        }
+        if (!full)
+            return;
+        if (pass == 0)
+            [self resetAtlas];
+    }
+
+    ALOGW("[Subtitle] %d events overflow the atlas\n", (int)_slots.count);
+    for (IJKSDLSubtitleSlot *slot in _slots) {
+        if (!slot.rasterized) {
+            slot.rect       = CGRectZero;
+            slot.rasterized = YES;
+        }
+    }
+}
+
+#pragma mark events
+
+- (void)setEvents:(NSArray<IJKSDLSubtitleEvent *> *)events
+{
+    BOOL changed = NO;
+
+    [_lock lock];
+    NSMutableDictionary *previous = [NSMutableDictionary dictionaryWithCapacity:_slots.count];
+    for (IJKSDLSubtitleSlot *slot in _slots)
+        previous[slot.event.identifier] = slot;
+
+    NSMutableArray *slots = [NSMutableArray arrayWithCapacity:events.count];
+    for (IJKSDLSubtitleEvent *event in events) {
+        IJKSDLSubtitleSlot *slot = previous[event.identifier];
+        if (!slot) {
+            slot = [[IJKSDLSubtitleSlot alloc] init];
+            slot.event = event;
+            changed = YES;
+        }
+        [slots addObject:slot];
+    }
+    changed = changed || slots.count != _slots.count;
+    _slots = slots;
+
+    // on this thread rather than the render one, if the size is known yet
+    [self rasterizeSlots];
+    [_lock unlock];
+
+    void (^changeHandler)(void) = self.changeHandler;
+    if (changed && changeHandler)
+        changeHandler();
+}
+
+#pragma mark render
+
+- (NSUInteger)prepareForVideoSize:(CGSize)videoSize
+                            quads:(IJKSDLSubtitleQuad *)quads
+                         maxCount:(NSUInteger)maxCount
+                           upload:(void (^)(const uint8_t *rows, int y, int height))upload
+{
+    NSUInteger count = 0;
+
+    [_lock lock];
+    videoSize = CGSizeMake(floor(videoSize.width), floor(videoSize.height));
+    if (!CGSizeEqualToSize(videoSize, _videoSize)) {
+        BOOL hasText = NO;
+        for (IJKSDLSubtitleSlot *slot in _slots)
+            hasText = hasText || slot.event.text != nil;
+        _videoSize = videoSize;
+        if (hasText)
+            [self resetAtlas];
+    }
+    [self rasterizeSlots];
+
+    if (_dirtyTop < _dirtyBottom && _atlas && upload) {
+        upload(_atlas + (size_t)_dirtyTop * IJK_SUBTITLE_ATLAS_STRIDE, _dirtyTop, _dirtyBottom - _dirtyTop);
+        _dirtyTop = _dirtyBottom = 0;
+    }
+
+    for (IJKSDLSubtitleSlot *slot in _slots) {
+        if (count >= maxCount || _videoSize.width <= 0 || _videoSize.height <= 0)
+            break;
+        if (!slot.rasterized || CGRectIsEmpty(slot.rect))
+            continue;
+
+        IJKSDLSubtitleEvent *event = slot.event;
+        CGRect rect = slot.rect;
+        IJKSDLSubtitleQuad *quad = &quads[count++];
+        if (event.image) {
+            quad->frame = event.frame;
+        } else {
+            CGFloat w = rect.size.width  / _videoSize.width;
+            CGFloat h = rect.size.height / _videoSize.height;
+            quad->frame = CGRectMake(event.anchor.x - w / 2, event.anchor.y - h, w, h);
+        }
+        quad->texcoords = CGRectMake(rect.origin.x    / IJK_SUBTITLE_ATLAS_SIZE,
+                                     rect.origin.y    / IJK_SUBTITLE_ATLAS_SIZE,
+                                     rect.size.width  / IJK_SUBTITLE_ATLAS_SIZE,
+                                     rect.size.height / IJK_SUBTITLE_ATLAS_SIZE);
+    }
+    [_lock unlock];
+
+    return count;
+}
+
+- (void)invalidateTexture
+{
+    [_lock lock];
+    if (_atlas)
+        [self markDirtyFrom:0 to:IJK_SUBTITLE_ATLAS_SIZE];
+    [_lock unlock];
+}
+
+- (CGImageRef)copyAtlasImage
+{
+    CGImageRef image = NULL;
+
+    [_lock lock];
+    if (_context)
+        image = CGBitmapContextCreateImage(_context);
+    [_lock unlock];
+
+    return image;
+}
+
+@end
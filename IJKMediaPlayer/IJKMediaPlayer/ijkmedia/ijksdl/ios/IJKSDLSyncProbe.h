@@ -0,0 +1,49 @@
+/*
+ * IJKSDLSyncProbe.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreVideo/CoreVideo.h>
+#include "ijksdl_sync_probe.h"
+
+// The video side of an IJKSyncProbe, fed by a render view with the frames
+// it presents; the player hands the same probe to its audio output.
+//
+// The brightness is the mean luma of a square at the center of the picture,
+// read from plane 0 of the pixel buffer, so flashes are only seen in frames
+// presented as pixel buffers: VideoToolbox, or software decoded with
+// prefersPixelBufferOverlays. The others count for the pacing only.
+@interface IJKSDLSyncProbe : NSObject
+
+- (instancetype)init;
+
+// the C probe, the reference the object keeps
+@property(nonatomic, readonly) IJKSyncProbe *probe;
+
+// render thread, once the frame is presented; NULL if it has no pixel buffer
+- (void)didDisplayPixelBuffer:(CVPixelBufferRef)pixelBuffer at:(CFTimeInterval)time;
+
+// any thread
+- (IJKSyncProbeResult)result;
+- (void)reset;
+
+@end
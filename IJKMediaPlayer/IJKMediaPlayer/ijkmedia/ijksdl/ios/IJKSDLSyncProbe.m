@@ -0,0 +1,107 @@
+/*
+ * IJKSDLSyncProbe.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "IJKSDLSyncProbe.h"
+
+// pixels on a side of the center square, sampled every other line and column
+#define IJK_SYNC_PROBE_CENTER   32
+
+@implementation IJKSDLSyncProbe
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _probe = ijk_sync_probe_create();
+        if (!_probe)
+            return nil;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    ijk_sync_probe_unref(&_probe);
+}
+
+// 0 to 255, -1 if unknown; full range and video range alike, the
+// thresholds have room for either
+static int center_luma(CVPixelBufferRef pixelBuffer)
+{
+    if (!pixelBuffer || CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly) != kCVReturnSuccess)
+        return -1;
+
+    BOOL    planar = CVPixelBufferIsPlanar(pixelBuffer);
+    OSType  format = CVPixelBufferGetPixelFormatType(pixelBuffer);
+    size_t  width  = planar ? CVPixelBufferGetWidthOfPlane(pixelBuffer, 0)  : CVPixelBufferGetWidth(pixelBuffer);
+    size_t  height = planar ? CVPixelBufferGetHeightOfPlane(pixelBuffer, 0) : CVPixelBufferGetHeight(pixelBuffer);
+    size_t  stride = planar ? CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0) : CVPixelBufferGetBytesPerRow(pixelBuffer);
+    uint8_t *base  = planar ? CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0) : CVPixelBufferGetBaseAddress(pixelBuffer);
+    // 8 bit luma first, or BGRA of which green stands in for it
+    size_t  bytes  = 1, offset = 0;
+    if (!planar && format == kCVPixelFormatType_32BGRA) {
+        bytes  = 4;
+        offset = 1;
+    } else if (!planar || (format != kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange &&
+                           format != kCVPixelFormatType_420YpCbCr8BiPlanarFullRange &&
+                           format != kCVPixelFormatType_420YpCbCr8Planar &&
+                           format != kCVPixelFormatType_420YpCbCr8PlanarFullRange)) {
+        base = NULL;
+    }
+
+    int luma = -1;
+    if (base && width >= IJK_SYNC_PROBE_CENTER && height >= IJK_SYNC_PROBE_CENTER) {
+        size_t x0 = (width - IJK_SYNC_PROBE_CENTER) / 2;
+        size_t y0 = (height - IJK_SYNC_PROBE_CENTER) / 2;
+        int    sum = 0, count = 0;
+        for (size_t y = y0; y < y0 + IJK_SYNC_PROBE_CENTER; y += 2) {
+            const uint8_t *row = base + y * stride;
+            for (size_t x = x0; x < x0 + IJK_SYNC_PROBE_CENTER; x += 2) {
+                sum += row[x * bytes + offset];
+                count++;
+            }
+        }
+        luma = sum / count;
+    }
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+    return luma;
+}
+
+- (void)didDisplayPixelBuffer:(CVPixelBufferRef)pixelBuffer at:(CFTimeInterval)time
+{
+    ijk_sync_probe_video(_probe, center_luma(pixelBuffer), time);
+}
+
+- (IJKSyncProbeResult)result
+{
+    IJKSyncProbeResult result;
+    ijk_sync_probe_get_result(_probe, &result);
+    return result;
+}
+
+- (void)reset
+{
+    ijk_sync_probe_reset(_probe);
+}
+
+@end
@@ -21,6 +21,39 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdbool.h>
 #include "ijksdl/ijksdl_aout.h"
+#include "ijksdl_audio_analysis.h"
+#include "ijksdl_sync_probe.h"
 
 SDL_Aout *SDL_AoutIos_CreateForAudioUnit();
+
+// low_latency: smaller and fewer output buffers, and a short IO buffer duration
+SDL_Aout *SDL_AoutIos_CreateForAudioUnitWithLowLatency(bool low_latency);
+
+// spectrum and loudness of the output, see ijksdl_audio_analysis.h, and
+// the normalization gain to loudness_target, in LUFS or 0 for none. An
+// output opened while either is on renders through an AudioUnit, which
+// measures and applies the gain along with the volume; an output already
+// open through an AudioQueue goes on without
+void SDL_AoutIos_SetAudioAnalysis(SDL_Aout *aout, bool enabled, float loudness_target);
+// false before the first spectrum, or without the analysis
+bool SDL_AoutIos_GetAudioAnalysis(SDL_Aout *aout, IJKAudioAnalysisResult *result);
+
+// an output opened while match is on asks the AVAudioSession for the sample
+// rate of the source, so the hardware plays it as decoded instead of the
+// system resampling it; the last output opened sets the rate of the session
+void SDL_AoutIos_SetMatchSampleRate(SDL_Aout *aout, bool match);
+// the rate of the output spec and the one of the hardware, false before the
+// first output opened
+bool SDL_AoutIos_GetSampleRates(SDL_Aout *aout, int *source_rate, int *output_rate);
+
+// an output opened while shared is on renders on a bus of one AudioUnit of
+// the process, mixed with the other shared outputs by a single IO thread,
+// each with its own volume, rate and latency; at the rate of that unit,
+// which the first one opened sets, the core resamples to it
+void SDL_AoutIos_SetSharedOutput(SDL_Aout *aout, bool shared);
+
+// an output opened with a probe renders through an AudioUnit, which gives
+// the probe the blocks it plays with the time they are heard; NULL for none
+void SDL_AoutIos_SetSyncProbe(SDL_Aout *aout, IJKSyncProbe *probe);
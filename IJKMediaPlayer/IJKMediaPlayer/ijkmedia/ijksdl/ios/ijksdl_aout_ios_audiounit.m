@@ -30,27 +30,84 @@
 #include "ijksdl/ijksdl_aout_internal.h"
 #import "IJKSDLAudioUnitController.h"
 #import "IJKSDLAudioQueueController.h"
+#import "IJKSDLAudioUnitController.h"
+
+#import <AVFoundation/AVFoundation.h>
 
 #define SDL_IOS_AUDIO_MAX_CALLBACKS_PER_SEC 15
+#define SDL_IOS_AUDIO_LOW_LATENCY_CALLBACKS_PER_SEC 60
 
 struct SDL_Aout_Opaque {
-    IJKSDLAudioQueueController *aoutController;
+    // an IJKSDLAudioQueueController, or an IJKSDLAudioUnitController for the
+    // analysis and the shared output
+    id    aoutController;
+    bool  low_latency;
+    bool  analysis;
+    float loudness_target;
+    bool  match_sample_rate;
+    bool  shared_output;
+    IJKSyncProbe *sync_probe;   // a reference, given to the outputs opened
 };
 
+// the hardware at the rate of the source, or the system converts the output
+// on the CPU, 44.1 kHz music to the 48 kHz of most routes
+static void aout_prefer_sample_rate(int freq)
+{
+    AVAudioSession *session = [AVAudioSession sharedInstance];
+    if (session.sampleRate == freq || session.preferredSampleRate == freq)
+        return;
+
+    NSError *error = nil;
+    if (NO == [session setPreferredSampleRate:freq error:&error]) {
+        NSLog(@"aout_open_audio: AVAudioSession.setPreferredSampleRate(%d) failed: %@\n", freq, error ? [error localizedDescription] : @"nil");
+    }
+}
+
 static int aout_open_audio(SDL_Aout *aout, const SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
 {
     assert(desired);
     SDLTRACE("aout_open_audio()\n");
     SDL_Aout_Opaque *opaque = aout->opaque;
 
-    opaque->aoutController = [[IJKSDLAudioQueueController alloc] initWithAudioSpec:desired];
+    SDL_LockMutex(aout->mutex);
+    bool  analysis        = opaque->analysis;
+    float loudness_target = opaque->loudness_target;
+    bool  match_sample_rate = opaque->match_sample_rate;
+    bool  shared_output   = opaque->shared_output;
+    IJKSyncProbe *sync_probe = ijk_sync_probe_ref(opaque->sync_probe);
+    SDL_UnlockMutex(aout->mutex);
+
+    // before the controller, which samples the rate of the session; a shared
+    // output mixes at the rate of its unit, the session is not moved under
+    // the other players
+    if (match_sample_rate && !shared_output)
+        aout_prefer_sample_rate(desired->freq);
+
+    id controller = nil;
+    if (analysis || loudness_target != 0 || sync_probe || shared_output) {
+        // measured and normalized in the IO cycle of the unit
+        controller = [[IJKSDLAudioUnitController alloc] initWithAudioSpec:desired shared:shared_output];
+        if (analysis || loudness_target != 0)
+            [controller setAnalysisEnabled:YES loudnessTarget:loudness_target];
+        [controller setSyncProbe:sync_probe];
+    }
+    ijk_sync_probe_unref(&sync_probe);
+    if (!controller) {
+        controller = [[IJKSDLAudioQueueController alloc] initWithAudioSpec:desired
+                                                                 lowLatency:opaque->low_latency];
+    }
+
+    SDL_LockMutex(aout->mutex);
+    [opaque->aoutController release];
+    opaque->aoutController = controller;
+    SDL_UnlockMutex(aout->mutex);
     if (!opaque->aoutController) {
         ALOGE("aout_open_audio_n: failed to new AudioTrcak()\n");
         return -1;
     }
 
     if (obtained)
-        *obtained = opaque->aoutController.spec;
+        *obtained = [opaque->aoutController spec];
 
     return 0;
 }
@@ -80,7 +137,10 @@ static void aout_close_audio(SDL_Aout *aout)
     SDLTRACE("aout_close_audio()\n");
     SDL_Aout_Opaque *opaque = aout->opaque;
 
+    // not while the analysis is read
+    SDL_LockMutex(aout->mutex);
     [opaque->aoutController close];
+    SDL_UnlockMutex(aout->mutex);
 }
 
 static void aout_set_playback_rate(SDL_Aout *aout, float playbackRate)
@@ -107,6 +167,9 @@ static double auout_get_latency_seconds(SDL_Aout *aout)
 
 static int aout_get_persecond_callbacks(SDL_Aout *aout)
 {
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    if (opaque->low_latency)
+        return SDL_IOS_AUDIO_LOW_LATENCY_CALLBACKS_PER_SEC;
     return SDL_IOS_AUDIO_MAX_CALLBACKS_PER_SEC;
 }
 
@@ -121,18 +184,104 @@ static void aout_free_l(SDL_Aout *aout)
     if (opaque) {
         [opaque->aoutController release];
         opaque->aoutController = nil;
+        ijk_sync_probe_unref(&opaque->sync_probe);
     }
 
     SDL_Aout_FreeInternal(aout);
 }
 
+void SDL_AoutIos_SetAudioAnalysis(SDL_Aout *aout, bool enabled, float loudness_target)
+{
+    if (!aout)
+        return;
+
+    SDL_Aout_Opaque *opaque = aout->opaque;
+
+    SDL_LockMutex(aout->mutex);
+    opaque->analysis        = enabled;
+    opaque->loudness_target = loudness_target;
+    if ([opaque->aoutController isKindOfClass:[IJKSDLAudioUnitController class]])
+        [opaque->aoutController setAnalysisEnabled:(enabled || loudness_target != 0) loudnessTarget:loudness_target];
+    SDL_UnlockMutex(aout->mutex);
+}
+
+bool SDL_AoutIos_GetAudioAnalysis(SDL_Aout *aout, IJKAudioAnalysisResult *result)
+{
+    if (!aout)
+        return false;
+
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    bool got = false;
+
+    SDL_LockMutex(aout->mutex);
+    if ([opaque->aoutController isKindOfClass:[IJKSDLAudioUnitController class]])
+        got = [opaque->aoutController getAnalysisResult:result];
+    SDL_UnlockMutex(aout->mutex);
+    return got;
+}
+
+void SDL_AoutIos_SetMatchSampleRate(SDL_Aout *aout, bool match)
+{
+    if (!aout)
+        return;
+
+    SDL_LockMutex(aout->mutex);
+    aout->opaque->match_sample_rate = match;
+    SDL_UnlockMutex(aout->mutex);
+}
+
+bool SDL_AoutIos_GetSampleRates(SDL_Aout *aout, int *source_rate, int *output_rate)
+{
+    if (!aout)
+        return false;
+
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    bool got = false;
+
+    SDL_LockMutex(aout->mutex);
+    if (opaque->aoutController) {
+        *source_rate = [opaque->aoutController spec].freq;
+        *output_rate = (int)[opaque->aoutController get_session_sample_rate];
+        got = true;
+    }
+    SDL_UnlockMutex(aout->mutex);
+    return got;
+}
+
+void SDL_AoutIos_SetSharedOutput(SDL_Aout *aout, bool shared)
+{
+    if (!aout)
+        return;
+
+    SDL_LockMutex(aout->mutex);
+    aout->opaque->shared_output = shared;
+    SDL_UnlockMutex(aout->mutex);
+}
+
+void SDL_AoutIos_SetSyncProbe(SDL_Aout *aout, IJKSyncProbe *probe)
+{
+    if (!aout)
+        return;
+
+    SDL_LockMutex(aout->mutex);
+    ijk_sync_probe_unref(&aout->opaque->sync_probe);
+    aout->opaque->sync_probe = ijk_sync_probe_ref(probe);
+    SDL_UnlockMutex(aout->mutex);
+}
+
 SDL_Aout *SDL_AoutIos_CreateForAudioUnit()
+{
+    return SDL_AoutIos_CreateForAudioUnitWithLowLatency(false);
+}
+
+SDL_Aout *SDL_AoutIos_CreateForAudioUnitWithLowLatency(bool low_latency)
 {
     SDL_Aout *aout = SDL_Aout_CreateInternal(sizeof(SDL_Aout_Opaque));
     if (!aout)
         return NULL;
 
-    // SDL_Aout_Opaque *opaque = aout->opaque;
+    SDL_Aout_Opaque *opaque = aout->opaque;
+    opaque->low_latency = low_latency;
 
     aout->free_l = aout_free_l;
     aout->open_audio  = aout_open_audio;
@@ -0,0 +1,357 @@
+/*
+ * ijksdl_audio_analysis.c
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_audio_analysis.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavcodec/avfft.h"
+#include "libavutil/mem.h"
+
+#define FFT_BITS            10
+#define FFT_SIZE            (1 << FFT_BITS)
+#define FFT_HOP             (FFT_SIZE / 2)
+#define BAND_LOW_HZ         40.0f
+#define BAND_HIGH_HZ        16000.0f
+
+// loudness is measured in steps of 100 ms, the short term window holds 30
+#define LOUD_STEPS          30
+#define LOUD_MOMENTARY      4
+// gating blocks by momentary loudness, from the absolute gate up in 0.1 LU
+#define HIST_MIN            -70.0f
+#define HIST_STEP           0.1f
+#define HIST_BINS           750
+#define RELATIVE_GATE       -10.0f
+
+#define NORM_MIN_BLOCKS     10      // gated blocks before any normalization
+#define NORM_MAX_CUT        -20.0f
+#define NORM_MAX_BOOST      12.0f
+#define NORM_SLEW           0.3f    // dB per step
+#define NORM_HEADROOM       -1.0f   // dBFS the boosted peak stays under
+
+typedef struct Biquad {
+    float b0, b1, b2, a1, a2;
+} Biquad;
+
+struct IJKAudioAnalysis {
+    // spectrum
+    RDFTContext *rdft;
+    float       *window;
+    float       *fifo;              // mono, the last FFT_SIZE frames once full
+    float       *work;
+    int          fifo_fill;
+    int          band_start[IJK_AUDIO_ANALYSIS_BANDS];
+    int          band_end[IJK_AUDIO_ANALYSIS_BANDS];
+    float        bands[IJK_AUDIO_ANALYSIS_BANDS];
+
+    // loudness, K-weighting as two biquads per channel
+    Biquad       shelf;
+    Biquad       high_pass;
+    float        state[2][4];
+    double       step_sum;
+    float        step_peak;
+    int          step_frames;
+    int          step_size;
+    double       steps[LOUD_STEPS];         // mean square of the two channels
+    float        step_peaks[LOUD_STEPS];
+    unsigned     step_count;
+    uint32_t     hist[HIST_BINS];
+    double       hist_energy[HIST_BINS];    // of the bin centres
+    unsigned     gated_blocks;
+    float        momentary;
+    float        short_term;
+    float        integrated;
+    float        norm_db;
+    float        norm_gain;
+
+    // the result, written by the IO thread under seq, odd while it writes
+    atomic_uint  seq;
+    IJKAudioAnalysisResult result;
+};
+
+static float energy_to_lufs(double energy)
+{
+    return energy > 0 ? -0.691f + 10.0f * (float)log10(energy) : -INFINITY;
+}
+
+// the two stages of BS.1770 for any rate, as libebur128 derives them
+static void k_weighting_init(IJKAudioAnalysis *a, double rate)
+{
+    double f0 = 1681.974450955533;
+    double G  = 3.999843853973347;
+    double Q  = 0.7071752369554196;
+    double K  = tan(M_PI * f0 / rate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+
+    a->shelf.b0 = (float)((Vh + Vb * K / Q + K * K) / a0);
+    a->shelf.b1 = (float)(2.0 * (K * K - Vh) / a0);
+    a->shelf.b2 = (float)((Vh - Vb * K / Q + K * K) / a0);
+    a->shelf.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+    a->shelf.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+    f0 = 38.13547087602444;
+    Q  = 0.5003270373238773;
+    K  = tan(M_PI * f0 / rate);
+    a0 = 1.0 + K / Q + K * K;
+
+    a->high_pass.b0 = 1.0f;
+    a->high_pass.b1 = -2.0f;
+    a->high_pass.b2 = 1.0f;
+    a->high_pass.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+    a->high_pass.a2 = (float)((1.0 - K / Q + K * K) / a0);
+}
+
+static inline float biquad_run(const Biquad *f, float *z, float x)
+{
+    float y = f->b0 * x + z[0];
+    z[0] = f->b1 * x - f->a1 * y + z[1];
+    z[1] = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+IJKAudioAnalysis *ijk_audio_analysis_create(int sample_rate)
+{
+    IJKAudioAnalysis *a;
+    float bin_hz = (float)sample_rate / FFT_SIZE;
+    float high   = fminf(BAND_HIGH_HZ, sample_rate * 0.45f);
+
+    if (sample_rate <= 0)
+        return NULL;
+
+    a = calloc(1, sizeof(*a));
+    if (!a)
+        return NULL;
+
+    // the NEON FFT wants aligned buffers
+    a->rdft   = av_rdft_init(FFT_BITS, DFT_R2C);
+    a->window = av_malloc(FFT_SIZE * sizeof(float));
+    a->fifo   = av_malloc(FFT_SIZE * sizeof(float));
+    a->work   = av_malloc(FFT_SIZE * sizeof(float));
+    if (!a->rdft || !a->window || !a->fifo || !a->work) {
+        ijk_audio_analysis_free(&a);
+        return NULL;
+    }
+
+    for (int i = 0; i < FFT_SIZE; i++)
+        a->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / FFT_SIZE);
+
+    for (int b = 0; b < IJK_AUDIO_ANALYSIS_BANDS; b++) {
+        float from  = BAND_LOW_HZ * powf(high / BAND_LOW_HZ, (float)b / IJK_AUDIO_ANALYSIS_BANDS);
+        float until = BAND_LOW_HZ * powf(high / BAND_LOW_HZ, (float)(b + 1) / IJK_AUDIO_ANALYSIS_BANDS);
+        int   start = (int)lrintf(from / bin_hz);
+        int   end   = (int)lrintf(until / bin_hz);
+
+        // bins 1 to FFT_SIZE / 2 - 1, at least one to a band
+        start = start < 1 ? 1 : (start > FFT_SIZE / 2 - 1 ? FFT_SIZE / 2 - 1 : start);
+        end   = end <= start ? start + 1 : (end > FFT_SIZE / 2 ? FFT_SIZE / 2 : end);
+        a->band_start[b] = start;
+        a->band_end[b]   = end;
+        a->bands[b]      = -INFINITY;
+    }
+
+    k_weighting_init(a, sample_rate);
+    a->step_size = sample_rate / 10;
+    for (int i = 0; i < HIST_BINS; i++)
+        a->hist_energy[i] = pow(10.0, (HIST_MIN + (i + 0.5) * HIST_STEP + 0.691) / 10.0);
+
+    a->momentary  = -INFINITY;
+    a->short_term = -INFINITY;
+    a->integrated = -INFINITY;
+    a->norm_gain  = 1.0f;
+    atomic_init(&a->seq, 0);
+    return a;
+}
+
+void ijk_audio_analysis_free(IJKAudioAnalysis **analysis)
+{
+    IJKAudioAnalysis *a = *analysis;
+
+    if (!a)
+        return;
+
+    av_rdft_end(a->rdft);
+    av_free(a->window);
+    av_free(a->fifo);
+    av_free(a->work);
+    free(a);
+    *analysis = NULL;
+}
+
+static void analysis_publish(IJKAudioAnalysis *a)
+{
+    unsigned seq = atomic_load_explicit(&a->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&a->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(a->result.bands, a->bands, sizeof(a->bands));
+    a->result.momentary          = a->momentary;
+    a->result.short_term         = a->short_term;
+    a->result.integrated         = a->integrated;
+    a->result.normalization_gain = a->norm_db;
+    a->result.serial++;
+    atomic_store_explicit(&a->seq, seq + 2, memory_order_release);
+}
+
+static void analysis_spectrum(IJKAudioAnalysis *a)
+{
+    // a full scale sine comes out at 0 dB through the Hann window
+    const float norm = 16.0f / ((float)FFT_SIZE * FFT_SIZE);
+    float *w = a->work;
+
+    for (int i = 0; i < FFT_SIZE; i++)
+        w[i] = a->fifo[i] * a->window[i];
+    av_rdft_calc(a->rdft, w);
+
+    // w[0] and w[1] hold DC and Nyquist, then bin k at w[2k] and w[2k + 1]
+    for (int b = 0; b < IJK_AUDIO_ANALYSIS_BANDS; b++) {
+        float power = 0;
+        for (int k = a->band_start[b]; k < a->band_end[b]; k++)
+            power += w[2 * k] * w[2 * k] + w[2 * k + 1] * w[2 * k + 1];
+        a->bands[b] = power > 0 ? 10.0f * log10f(power * norm) : -INFINITY;
+    }
+
+    analysis_publish(a);
+}
+
+static float analysis_integrated(IJKAudioAnalysis *a)
+{
+    double   sum   = 0;
+    uint64_t count = 0;
+    int      from;
+
+    for (int i = 0; i < HIST_BINS; i++) {
+        sum   += a->hist_energy[i] * a->hist[i];
+        count += a->hist[i];
+    }
+    if (!count)
+        return -INFINITY;
+
+    from = (int)ceilf((energy_to_lufs(sum / count) + RELATIVE_GATE - HIST_MIN) / HIST_STEP);
+    from = from < 0 ? 0 : from;
+    sum   = 0;
+    count = 0;
+    for (int i = from; i < HIST_BINS; i++) {
+        sum   += a->hist_energy[i] * a->hist[i];
+        count += a->hist[i];
+    }
+    return count ? energy_to_lufs(sum / count) : -INFINITY;
+}
+
+static void analysis_step(IJKAudioAnalysis *a, float target)
+{
+    unsigned slot = a->step_count % LOUD_STEPS;
+    unsigned held;
+    double   momentary  = 0;
+    double   short_term = 0;
+    float    peak       = 0;
+    float    want       = 0;
+
+    a->steps[slot]      = a->step_sum / a->step_frames;
+    a->step_peaks[slot] = a->step_peak;
+    a->step_count++;
+    a->step_sum    = 0;
+    a->step_peak   = 0;
+    a->step_frames = 0;
+
+    // the filters decay into denormals in silence
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < 4; i++) {
+            if (fabsf(a->state[c][i]) < 1e-15f)
+                a->state[c][i] = 0;
+        }
+    }
+
+    held = a->step_count < LOUD_STEPS ? a->step_count : LOUD_STEPS;
+    for (unsigned i = 0; i < held; i++) {
+        double energy = a->steps[(a->step_count - 1 - i) % LOUD_STEPS];
+        if (i < LOUD_MOMENTARY)
+            momentary += energy;
+        short_term += energy;
+        peak = fmaxf(peak, a->step_peaks[(a->step_count - 1 - i) % LOUD_STEPS]);
+    }
+    a->short_term = energy_to_lufs(short_term / held);
+
+    // a 400 ms gating block every step, overlapping by 75%
+    if (a->step_count >= LOUD_MOMENTARY) {
+        a->momentary = energy_to_lufs(momentary / LOUD_MOMENTARY);
+        if (a->momentary >= HIST_MIN) {
+            int bin = (int)((a->momentary - HIST_MIN) / HIST_STEP);
+            a->hist[bin < HIST_BINS ? bin : HIST_BINS - 1]++;
+            a->gated_blocks++;
+            a->integrated = analysis_integrated(a);
+        }
+    }
+
+    if (target != 0 && a->gated_blocks >= NORM_MIN_BLOCKS && isfinite(a->integrated)) {
+        want = target - a->integrated;
+        if (peak > 0)
+            want = fminf(want, NORM_HEADROOM - 20.0f * log10f(peak));
+        want = fmaxf(NORM_MAX_CUT, fminf(NORM_MAX_BOOST, want));
+    }
+    a->norm_db  += fmaxf(-NORM_SLEW, fminf(NORM_SLEW, want - a->norm_db));
+    a->norm_gain = powf(10.0f, a->norm_db / 20.0f);
+}
+
+void ijk_audio_analysis_process(IJKAudioAnalysis *a, const float *stereo, int frames,
+                                float scale, float target)
+{
+    for (int i = 0; i < frames; i++) {
+        float l = stereo[2 * i]     * scale;
+        float r = stereo[2 * i + 1] * scale;
+
+        a->fifo[a->fifo_fill++] = 0.5f * (l + r);
+        if (a->fifo_fill == FFT_SIZE) {
+            analysis_spectrum(a);
+            memmove(a->fifo, a->fifo + FFT_HOP, (FFT_SIZE - FFT_HOP) * sizeof(float));
+            a->fifo_fill = FFT_SIZE - FFT_HOP;
+        }
+
+        float kl = biquad_run(&a->high_pass, a->state[0] + 2, biquad_run(&a->shelf, a->state[0], l));
+        float kr = biquad_run(&a->high_pass, a->state[1] + 2, biquad_run(&a->shelf, a->state[1], r));
+        a->step_sum  += kl * kl + kr * kr;
+        a->step_peak  = fmaxf(a->step_peak, fmaxf(fabsf(l), fabsf(r)));
+        if (++a->step_frames == a->step_size)
+            analysis_step(a, target);
+    }
+}
+
+float ijk_audio_analysis_get_gain(IJKAudioAnalysis *a)
+{
+    return a->norm_gain;
+}
+
+bool ijk_audio_analysis_get_result(IJKAudioAnalysis *a, IJKAudioAnalysisResult *result)
+{
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&a->seq, memory_order_acquire);
+        memcpy(result, &a->result, sizeof(*result));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&a->seq, memory_order_relaxed));
+
+    return result->serial != 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * ijksdl_audio_analysis.h
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_IOS__IJKSDL_AUDIO_ANALYSIS_H
+#define IJKSDL_IOS__IJKSDL_AUDIO_ANALYSIS_H
+
+#include <stdbool.h>
+
+#define IJK_AUDIO_ANALYSIS_BANDS 32
+
+/*
+ * Spectrum and loudness of the output, measured on the IO thread block by
+ * block as the unit renders. The spectrum is a 1024 point real FFT every
+ * 512 frames, through av_rdft (the NEON FFT on arm), summed into bands
+ * spaced evenly in log frequency from 40 Hz to 16 kHz. Loudness is that of
+ * EBU R128 / ITU-R BS.1770: K-weighted, in 100 ms steps, momentary over
+ * 400 ms, short term over 3 s and integrated with the absolute and the
+ * relative gate.
+ *
+ * The normalization gain moves the integrated loudness to a target, at
+ * most 3 dB a second, and boosts no further than the peak of the last 3 s
+ * allows; the output applies it along with the volume.
+ *
+ * Only create and free allocate; process is safe on a real-time thread.
+ */
+typedef struct IJKAudioAnalysis IJKAudioAnalysis;
+
+typedef struct IJKAudioAnalysisResult {
+    float    bands[IJK_AUDIO_ANALYSIS_BANDS];   // dBFS
+    float    momentary;                         // LUFS, -INFINITY in silence
+    float    short_term;
+    float    integrated;
+    float    normalization_gain;                // dB
+    unsigned serial;                            // advanced by every spectrum
+} IJKAudioAnalysisResult;
+
+IJKAudioAnalysis *ijk_audio_analysis_create(int sample_rate);
+void              ijk_audio_analysis_free(IJKAudioAnalysis **analysis);
+
+// IO thread: frames of interleaved float stereo as rendered, multiplied by
+// scale to undo the gain they were rendered with; target in LUFS, 0 for
+// no normalization
+void  ijk_audio_analysis_process(IJKAudioAnalysis *analysis, const float *stereo, int frames,
+                                 float scale, float target);
+// IO thread: the linear normalization gain for the next block
+float ijk_audio_analysis_get_gain(IJKAudioAnalysis *analysis);
+
+// any thread: the last result published, false before the first
+bool  ijk_audio_analysis_get_result(IJKAudioAnalysis *analysis, IJKAudioAnalysisResult *result);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * ijksdl_audio_mix.c
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_audio_mix.h"
+
+#include <math.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IJK_AUDIO_MIX_NEON 1
+#endif
+
+#define MIX_K       0.70710678f     // -3dB, centre and surrounds
+#define MIX_S16     (1.0f / 32768.0f)
+
+typedef struct MixMatrix {
+    float left[IJK_AUDIO_MIX_MAX_CHANNELS];
+    float right[IJK_AUDIO_MIX_MAX_CHANNELS];
+    float norm;                     // so that a full scale input stays in [-1, 1]
+} MixMatrix;
+
+// by channel count, the default layouts of libavutil; the LFE is dropped
+static const MixMatrix g_mix[IJK_AUDIO_MIX_MAX_CHANNELS + 1] = {
+    [1] = { { 1 },                          { 1 },                          1 },
+    [2] = { { 1, 0 },                       { 0, 1 },                       1 },
+    // FL FR FC
+    [3] = { { 1, 0, MIX_K },                { 0, 1, MIX_K },                1 / (1 + MIX_K) },
+    // FL FR FC BC
+    [4] = { { 1, 0, MIX_K, MIX_K },         { 0, 1, MIX_K, MIX_K },         1 / (1 + 2 * MIX_K) },
+    // FL FR FC BL BR
+    [5] = { { 1, 0, MIX_K, MIX_K, 0 },      { 0, 1, MIX_K, 0, MIX_K },      1 / (1 + 2 * MIX_K) },
+    // FL FR FC LFE BL BR
+    [6] = { { 1, 0, MIX_K, 0, MIX_K, 0 },   { 0, 1, MIX_K, 0, 0, MIX_K },   1 / (1 + 2 * MIX_K) },
+};
+
+void ijk_audio_gain_init(IJKAudioGain *gain, float volume, int ramp_frames)
+{
+    gain->current  = volume;
+    gain->target   = volume;
+    gain->max_step = ramp_frames > 0 ? 1.0f / ramp_frames : 0;
+}
+
+// frame i of the segment is scaled by g0 + step * (first + i)
+static void mix_segment_c(float *dst, const int16_t *src, int channels, int first, int frames,
+                          float g0, float step)
+{
+    const MixMatrix *m = &g_mix[channels];
+
+    for (int i = first; i < first + frames; i++) {
+        float g = g0 + step * (float)i;
+        float l = 0;
+        float r = 0;
+
+        for (int c = 0; c < channels; c++) {
+            l += m->left[c]  * src[c];
+            r += m->right[c] * src[c];
+        }
+
+        dst[0] = l * g;
+        dst[1] = r * g;
+        src += channels;
+        dst += 2;
+    }
+}
+
+#if IJK_AUDIO_MIX_NEON
+static inline float32x4_t s16_to_f32(int16x4_t v)
+{
+    return vcvtq_f32_s32(vmovl_s16(v));
+}
+
+// @return the frames done, a multiple of 4; the layouts worth it only
+static int mix_segment_neon(float *dst, const int16_t *src, int channels, int frames,
+                            float g0, float step)
+{
+    static const float ramp[4] = { 0, 1, 2, 3 };
+
+    if (channels != 1 && channels != 2 && channels != 6)
+        return 0;
+
+    float32x4_t index = vld1q_f32(ramp);
+    float32x4_t four  = vdupq_n_f32(4);
+    float32x4_t base  = vdupq_n_f32(g0);
+    int i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t g = vmlaq_n_f32(base, index, step);
+        float32x4x2_t out;
+
+        if (channels == 1) {
+            float32x4_t x = s16_to_f32(vld1_s16(src));
+            out.val[0] = vmulq_f32(x, g);
+            out.val[1] = out.val[0];
+            src += 4;
+        } else if (channels == 2) {
+            int16x4x2_t x = vld2_s16(src);
+            out.val[0] = vmulq_f32(s16_to_f32(x.val[0]), g);
+            out.val[1] = vmulq_f32(s16_to_f32(x.val[1]), g);
+            src += 8;
+        } else {
+            // lanes of the three loads alternate FL LFE, FR BL, FC BR
+            int16x8x3_t x   = vld3q_s16(src);
+            int16x8x2_t lr  = vuzpq_s16(x.val[0], x.val[1]);   // FL FR, LFE BL
+            int16x8x2_t cbr = vuzpq_s16(x.val[2], x.val[2]);   // FC FC, BR BR
+            float32x4_t fl  = s16_to_f32(vget_low_s16(lr.val[0]));
+            float32x4_t fr  = s16_to_f32(vget_high_s16(lr.val[0]));
+            float32x4_t bl  = s16_to_f32(vget_high_s16(lr.val[1]));
+            float32x4_t fc  = s16_to_f32(vget_low_s16(cbr.val[0]));
+            float32x4_t br  = s16_to_f32(vget_low_s16(cbr.val[1]));
+            float32x4_t l   = vmlaq_n_f32(fl, vaddq_f32(fc, bl), MIX_K);
+            float32x4_t r   = vmlaq_n_f32(fr, vaddq_f32(fc, br), MIX_K);
+            out.val[0] = vmulq_f32(l, g);
+            out.val[1] = vmulq_f32(r, g);
+            src += 24;
+        }
+
+        vst2q_f32(dst, out);
+        dst  += 8;
+        index = vaddq_f32(index, four);
+    }
+
+    return i;
+}
+#endif
+
+static void mix_segment(float *dst, const int16_t *src, int channels, int frames,
+                        float g0, float step)
+{
+    float scale = g_mix[channels].norm * MIX_S16;
+    int   done  = 0;
+
+    g0   *= scale;
+    step *= scale;
+#if IJK_AUDIO_MIX_NEON
+    done = mix_segment_neon(dst, src, channels, frames, g0, step);
+#endif
+    mix_segment_c(dst + done * 2, src + done * channels, channels, done, frames - done, g0, step);
+}
+
+void ijk_audio_mix_s16_to_f32_stereo(float *dst, const int16_t *src, int channels, int frames,
+                                     IJKAudioGain *gain)
+{
+    float target = gain->target;
+
+    while (frames > 0) {
+        float g0    = gain->current;
+        float delta = target - g0;
+        float step  = 0;
+        int   n     = frames;
+
+        if (delta != 0 && gain->max_step > 0 && fabsf(delta) > gain->max_step * frames) {
+            step = copysignf(gain->max_step, delta);
+            gain->current = g0 + step * frames;
+        } else if (delta != 0 && gain->max_step > 0) {
+            // reaches the target within the buffer, holds it for the rest
+            n = (int)ceilf(fabsf(delta) / gain->max_step);
+            n = n < 1 ? 1 : (n > frames ? frames : n);
+            step = delta / n;
+            gain->current = target;
+        } else {
+            gain->current = target;
+            g0 = target;
+        }
+
+        mix_segment(dst, src, channels, n, g0, step);
+        dst    += n * 2;
+        src    += n * channels;
+        frames -= n;
+    }
+}
+
+void ijk_audio_mix_add_f32(float *dst, const float *src, int samples)
+{
+    int i = 0;
+
+#if IJK_AUDIO_MIX_NEON
+    for (; i + 4 <= samples; i += 4)
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+#endif
+    for (; i < samples; i++)
+        dst[i] += src[i];
+}
@@ -0,0 +1,52 @@
+/*
+ * ijksdl_audio_mix.h
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_IOS__IJKSDL_AUDIO_MIX_H
+#define IJKSDL_IOS__IJKSDL_AUDIO_MIX_H
+
+#include <stdint.h>
+
+#define IJK_AUDIO_MIX_MAX_CHANNELS 6
+
+/*
+ * Last stage of the output: interleaved S16 in the default layout of its
+ * channel count (mono, stereo, 3.0, 4.0, 5.0 and 5.1 back) to interleaved
+ * float stereo, down-mixed and scaled by a gain in the same pass. The
+ * gain moves to its target at a bounded slope, sample by sample, so that
+ * a volume change does not click. NEON on arm, plain C elsewhere.
+ *
+ * Allocates nothing, safe on a real-time thread.
+ */
+typedef struct IJKAudioGain {
+    float current;      // where the next buffer starts
+    float target;
+    float max_step;     // per frame, 1 / frames of a full scale ramp
+} IJKAudioGain;
+
+void ijk_audio_gain_init(IJKAudioGain *gain, float volume, int ramp_frames);
+
+// channels in [1, IJK_AUDIO_MIX_MAX_CHANNELS], dst holds frames * 2 floats
+void ijk_audio_mix_s16_to_f32_stereo(float *dst, const int16_t *src, int channels, int frames,
+                                     IJKAudioGain *gain);
+
+// dst[i] += src[i], the outputs of several players summed into one buffer
+void ijk_audio_mix_add_f32(float *dst, const float *src, int samples);
+
+#endif
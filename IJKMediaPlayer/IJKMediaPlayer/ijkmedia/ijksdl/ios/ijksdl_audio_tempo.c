@@ -0,0 +1,378 @@
+/*
+ * ijksdl_audio_tempo.c
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_audio_tempo.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IJK_AUDIO_TEMPO_NEON 1
+#endif
+
+// sequence and seek window shrink from slow to fast rates, as in SoundTouch
+#define TEMPO_OVERLAP_MS        8
+#define TEMPO_SEQUENCE_MS_SLOW  90
+#define TEMPO_SEQUENCE_MS_FAST  40
+#define TEMPO_SEEK_MS_SLOW      20
+#define TEMPO_SEEK_MS_FAST      15
+#define TEMPO_RATE_SLOW         0.5f
+#define TEMPO_RATE_FAST         2.0f
+#define TEMPO_COARSE_STEP       4
+
+typedef struct TempoFifo {
+    int16_t *data;
+    int      begin;     // frames
+    int      frames;
+    int      capacity;
+} TempoFifo;
+
+struct IJKAudioTempo {
+    int      sample_rate;
+    int      channels;
+    float    rate;
+
+    int      overlap;       // frames, multiple of 8
+    int      sequence;
+    int      seek;
+    double   nominal_skip;
+    double   skip_frac;
+    int      sample_req;
+
+    int16_t *mid;           // tail of the previous sequence, cross faded into the next one
+    int      has_mid;
+
+    TempoFifo in;
+    TempoFifo out;
+};
+
+static int fifo_reserve(TempoFifo *fifo, int channels, int frames)
+{
+    if (fifo->begin + fifo->frames + frames <= fifo->capacity)
+        return 0;
+
+    if (fifo->begin) {
+        memmove(fifo->data, fifo->data + fifo->begin * channels, fifo->frames * channels * sizeof(int16_t));
+        fifo->begin = 0;
+        if (fifo->frames + frames <= fifo->capacity)
+            return 0;
+    }
+
+    int capacity = (fifo->frames + frames) * 2;
+    int16_t *data = realloc(fifo->data, capacity * channels * sizeof(int16_t));
+    if (!data)
+        return -1;
+    fifo->data     = data;
+    fifo->capacity = capacity;
+    return 0;
+}
+
+static inline int16_t *fifo_head(TempoFifo *fifo, int channels)
+{
+    return fifo->data + fifo->begin * channels;
+}
+
+static inline int16_t *fifo_tail(TempoFifo *fifo, int channels)
+{
+    return fifo->data + (fifo->begin + fifo->frames) * channels;
+}
+
+static inline void fifo_drain(TempoFifo *fifo, int frames)
+{
+    fifo->begin  += frames;
+    fifo->frames -= frames;
+    if (fifo->frames <= 0) {
+        fifo->begin  = 0;
+        fifo->frames = 0;
+    }
+}
+
+static inline int ms_to_frames(IJKAudioTempo *tempo, float ms)
+{
+    return (int)(tempo->sample_rate * ms / 1000);
+}
+
+static void tempo_update_params(IJKAudioTempo *tempo)
+{
+    float k = (tempo->rate - TEMPO_RATE_SLOW) / (TEMPO_RATE_FAST - TEMPO_RATE_SLOW);
+    if (k < 0)
+        k = 0;
+    else if (k > 1)
+        k = 1;
+
+    tempo->sequence = ms_to_frames(tempo, TEMPO_SEQUENCE_MS_SLOW + (TEMPO_SEQUENCE_MS_FAST - TEMPO_SEQUENCE_MS_SLOW) * k);
+    tempo->seek     = ms_to_frames(tempo, TEMPO_SEEK_MS_SLOW + (TEMPO_SEEK_MS_FAST - TEMPO_SEEK_MS_SLOW) * k);
+    if (tempo->sequence < 2 * tempo->overlap + 8)
+        tempo->sequence = 2 * tempo->overlap + 8;
+    if (tempo->seek < TEMPO_COARSE_STEP)
+        tempo->seek = TEMPO_COARSE_STEP;
+
+    tempo->nominal_skip = tempo->rate * (tempo->sequence - tempo->overlap);
+    int skip = (int)(tempo->nominal_skip + 1) + tempo->overlap;
+    tempo->sample_req = (skip > tempo->sequence ? skip : tempo->sequence) + tempo->seek;
+}
+
+// cross correlation of ref and cmp, and the energy of cmp; count is a multiple of 8
+static int64_t tempo_correlate(const int16_t *ref, const int16_t *cmp, int count, int64_t *norm)
+{
+#if IJK_AUDIO_TEMPO_NEON
+    int64x2_t acc_corr = vdupq_n_s64(0);
+    int64x2_t acc_norm = vdupq_n_s64(0);
+
+    for (int i = 0; i < count; i += 8) {
+        int16x8_t a = vld1q_s16(ref + i);
+        int16x8_t b = vld1q_s16(cmp + i);
+
+        // a product of two s16 fits s32 but the sum of two may not
+        acc_corr = vpadalq_s32(acc_corr, vmull_s16(vget_low_s16(a),  vget_low_s16(b)));
+        acc_corr = vpadalq_s32(acc_corr, vmull_s16(vget_high_s16(a), vget_high_s16(b)));
+        acc_norm = vpadalq_s32(acc_norm, vmull_s16(vget_low_s16(b),  vget_low_s16(b)));
+        acc_norm = vpadalq_s32(acc_norm, vmull_s16(vget_high_s16(b), vget_high_s16(b)));
+    }
+
+    *norm = vgetq_lane_s64(acc_norm, 0) + vgetq_lane_s64(acc_norm, 1);
+    return vgetq_lane_s64(acc_corr, 0) + vgetq_lane_s64(acc_corr, 1);
+#else
+    int64_t corr = 0;
+    int64_t energy = 0;
+
+    for (int i = 0; i < count; i++) {
+        corr   += (int32_t)ref[i] * cmp[i];
+        energy += (int32_t)cmp[i] * cmp[i];
+    }
+
+    *norm = energy;
+    return corr;
+#endif
+}
+
+static double tempo_score(IJKAudioTempo *tempo, const int16_t *in, int offset)
+{
+    int64_t norm = 0;
+    int64_t corr = tempo_correlate(tempo->mid, in + offset * tempo->channels,
+                                   tempo->overlap * tempo->channels, &norm);
+    return corr / sqrt((double)norm + 1);
+}
+
+// coarse pass over the seek window, then refined around the best match
+static int tempo_seek_best(IJKAudioTempo *tempo, const int16_t *in)
+{
+    int    best       = 0;
+    double best_score = tempo_score(tempo, in, 0);
+
+    for (int i = TEMPO_COARSE_STEP; i < tempo->seek; i += TEMPO_COARSE_STEP) {
+        double score = tempo_score(tempo, in, i);
+        if (score > best_score) {
+            best_score = score;
+            best       = i;
+        }
+    }
+
+    int center = best;
+    for (int i = center - TEMPO_COARSE_STEP + 1; i < center + TEMPO_COARSE_STEP; i++) {
+        if (i < 0 || i >= tempo->seek || i == center)
+            continue;
+        double score = tempo_score(tempo, in, i);
+        if (score > best_score) {
+            best_score = score;
+            best       = i;
+        }
+    }
+
+    return best;
+}
+
+static void tempo_cross_fade(IJKAudioTempo *tempo, int16_t *out, const int16_t *in)
+{
+    int channels = tempo->channels;
+    int overlap  = tempo->overlap;
+
+    for (int i = 0; i < overlap; i++) {
+        for (int c = 0; c < channels; c++) {
+            int j = i * channels + c;
+            out[j] = (int16_t)((tempo->mid[j] * (overlap - i) + in[j] * i) / overlap);
+        }
+    }
+}
+
+// at 1.0 the pending input is handed over as is, after fading out of the last sequence
+static int tempo_drain(IJKAudioTempo *tempo)
+{
+    int channels = tempo->channels;
+
+    if (tempo->has_mid) {
+        if (tempo->in.frames < tempo->overlap)
+            return 0;
+        if (fifo_reserve(&tempo->out, channels, tempo->overlap) < 0)
+            return -1;
+        tempo_cross_fade(tempo, fifo_tail(&tempo->out, channels), fifo_head(&tempo->in, channels));
+        tempo->out.frames += tempo->overlap;
+        fifo_drain(&tempo->in, tempo->overlap);
+        tempo->has_mid   = 0;
+        tempo->skip_frac = 0;
+    }
+
+    if (!tempo->in.frames)
+        return 0;
+    if (fifo_reserve(&tempo->out, channels, tempo->in.frames) < 0)
+        return -1;
+    memcpy(fifo_tail(&tempo->out, channels), fifo_head(&tempo->in, channels),
+           tempo->in.frames * channels * sizeof(int16_t));
+    tempo->out.frames += tempo->in.frames;
+    fifo_drain(&tempo->in, tempo->in.frames);
+    return 0;
+}
+
+static int tempo_process(IJKAudioTempo *tempo)
+{
+    int channels = tempo->channels;
+
+    if (tempo->rate == 1.0f)
+        return tempo_drain(tempo);
+
+    while (tempo->in.frames >= tempo->sample_req) {
+        if (fifo_reserve(&tempo->out, channels, tempo->sequence) < 0)
+            return -1;
+
+        const int16_t *in  = fifo_head(&tempo->in, channels);
+        int16_t       *out = fifo_tail(&tempo->out, channels);
+        int offset = 0;
+
+        if (tempo->has_mid) {
+            offset = tempo_seek_best(tempo, in);
+            tempo_cross_fade(tempo, out, in + offset * channels);
+        } else {
+            memcpy(out, in, tempo->overlap * channels * sizeof(int16_t));
+        }
+        offset += tempo->overlap;
+        out    += tempo->overlap * channels;
+
+        int body = tempo->sequence - 2 * tempo->overlap;
+        memcpy(out, in + offset * channels, body * channels * sizeof(int16_t));
+        memcpy(tempo->mid, in + (offset + body) * channels, tempo->overlap * channels * sizeof(int16_t));
+        tempo->has_mid     = 1;
+        tempo->out.frames += tempo->overlap + body;
+
+        tempo->skip_frac += tempo->nominal_skip;
+        int skip = (int)tempo->skip_frac;
+        tempo->skip_frac -= skip;
+        fifo_drain(&tempo->in, skip);
+    }
+
+    return 0;
+}
+
+IJKAudioTempo *ijk_audio_tempo_create(int sample_rate, int channels)
+{
+    if (sample_rate <= 0 || channels <= 0)
+        return NULL;
+
+    IJKAudioTempo *tempo = calloc(1, sizeof(IJKAudioTempo));
+    if (!tempo)
+        return NULL;
+
+    tempo->sample_rate = sample_rate;
+    tempo->channels    = channels;
+    tempo->rate        = 1.0f;
+    tempo->overlap     = (ms_to_frames(tempo, TEMPO_OVERLAP_MS) + 7) & ~7;
+    tempo->mid         = calloc(tempo->overlap * channels, sizeof(int16_t));
+    if (!tempo->mid) {
+        free(tempo);
+        return NULL;
+    }
+
+    tempo_update_params(tempo);
+    return tempo;
+}
+
+void ijk_audio_tempo_free(IJKAudioTempo **ptempo)
+{
+    if (!ptempo || !*ptempo)
+        return;
+
+    IJKAudioTempo *tempo = *ptempo;
+    free(tempo->in.data);
+    free(tempo->out.data);
+    free(tempo->mid);
+    free(tempo);
+    *ptempo = NULL;
+}
+
+void ijk_audio_tempo_set_rate(IJKAudioTempo *tempo, float rate)
+{
+    if (fabsf(rate - 1.0f) <= 0.000001f)
+        rate = 1.0f;
+    else if (rate < IJK_AUDIO_TEMPO_MIN_RATE)
+        rate = IJK_AUDIO_TEMPO_MIN_RATE;
+    else if (rate > IJK_AUDIO_TEMPO_MAX_RATE)
+        rate = IJK_AUDIO_TEMPO_MAX_RATE;
+
+    if (rate == tempo->rate)
+        return;
+
+    tempo->rate = rate;
+    tempo_update_params(tempo);
+}
+
+void ijk_audio_tempo_flush(IJKAudioTempo *tempo)
+{
+    fifo_drain(&tempo->in, tempo->in.frames);
+    fifo_drain(&tempo->out, tempo->out.frames);
+    tempo->has_mid   = 0;
+    tempo->skip_frac = 0;
+}
+
+int ijk_audio_tempo_put(IJKAudioTempo *tempo, const int16_t *samples, int frames)
+{
+    int channels = tempo->channels;
+
+    if (fifo_reserve(&tempo->in, channels, frames) < 0)
+        return -1;
+    memcpy(fifo_tail(&tempo->in, channels), samples, frames * channels * sizeof(int16_t));
+    tempo->in.frames += frames;
+
+    return tempo_process(tempo);
+}
+
+int ijk_audio_tempo_receive(IJKAudioTempo *tempo, int16_t *samples, int frames)
+{
+    int channels = tempo->channels;
+
+    if (frames > tempo->out.frames)
+        frames = tempo->out.frames;
+    memcpy(samples, fifo_head(&tempo->out, channels), frames * channels * sizeof(int16_t));
+    fifo_drain(&tempo->out, frames);
+    return frames;
+}
+
+int ijk_audio_tempo_is_idle(IJKAudioTempo *tempo)
+{
+    return !tempo->has_mid && !tempo->in.frames && !tempo->out.frames;
+}
+
+double ijk_audio_tempo_get_delay(IJKAudioTempo *tempo)
+{
+    double frames = tempo->in.frames + tempo->out.frames * tempo->rate;
+    if (tempo->has_mid)
+        frames += tempo->overlap * tempo->rate;
+    return frames / tempo->sample_rate;
+}
@@ -0,0 +1,57 @@
+/*
+ * ijksdl_audio_tempo.h
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_IOS__IJKSDL_AUDIO_TEMPO_H
+#define IJKSDL_IOS__IJKSDL_AUDIO_TEMPO_H
+
+#include <stdint.h>
+
+#define IJK_AUDIO_TEMPO_MIN_RATE 0.5f
+#define IJK_AUDIO_TEMPO_MAX_RATE 3.0f
+
+/*
+ * Pitch preserving time stretch of interleaved S16 PCM (WSOLA): the input
+ * is cut into overlapping sequences, each one is placed where it best
+ * matches the tail of the previous one within a short seek window, and
+ * the overlap is cross faded. The input is advanced by rate times the
+ * output, so there is no resampling and no FFT.
+ *
+ * Not thread safe, a tempo is fed and drained by the audio thread.
+ */
+typedef struct IJKAudioTempo IJKAudioTempo;
+
+IJKAudioTempo *ijk_audio_tempo_create(int sample_rate, int channels);
+void    ijk_audio_tempo_free(IJKAudioTempo **ptempo);
+
+// clamped to [IJK_AUDIO_TEMPO_MIN_RATE, IJK_AUDIO_TEMPO_MAX_RATE], 1.0 drains to a pass through
+void    ijk_audio_tempo_set_rate(IJKAudioTempo *tempo, float rate);
+void    ijk_audio_tempo_flush(IJKAudioTempo *tempo);
+
+// @return 0 on success, -1 if out of memory
+int     ijk_audio_tempo_put(IJKAudioTempo *tempo, const int16_t *samples, int frames);
+// @return the number of frames received, up to frames
+int     ijk_audio_tempo_receive(IJKAudioTempo *tempo, int16_t *samples, int frames);
+
+// nothing buffered, the input can go straight to the output at 1.0
+int     ijk_audio_tempo_is_idle(IJKAudioTempo *tempo);
+// buffered input, in seconds of input
+double  ijk_audio_tempo_get_delay(IJKAudioTempo *tempo);
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * ijksdl_blackbox_ios.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_blackbox_ios.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLACKBOX_MAGIC      0x31424249  // "IBB1"
+
+// the layout of IJKBlackBoxRecord, the sequence number atomic
+typedef struct BlackBoxSlot {
+    atomic_uint seq;        // 0 while written
+    uint16_t    type;
+    uint16_t    player;
+    int64_t     time;
+    int64_t     values[IJK_BLACKBOX_VALUES];
+} BlackBoxSlot;
+
+typedef struct BlackBoxFile {
+    uint32_t    magic;
+    uint32_t    slot_size;
+    uint32_t    nb_slots;
+    atomic_int  open_players;   // above 0 when the process was killed while playing
+    atomic_uint head;           // records written
+    uint32_t    reserved[3];
+    BlackBoxSlot slots[IJK_BLACKBOX_RECORDS];
+} BlackBoxFile;
+
+typedef struct BlackBoxType {
+    const char *name;
+    const char *format;
+} BlackBoxType;
+
+#define IJK_BLACKBOX_TYPE_INFO(type, name, format) [type] = { name, format },
+static const BlackBoxType g_types[IJK_BB_COUNT] = {
+    IJK_BLACKBOX_TYPES(IJK_BLACKBOX_TYPE_INFO)
+};
+#undef IJK_BLACKBOX_TYPE_INFO
+
+static _Atomic(BlackBoxFile *) g_file;
+static atomic_int              g_next_player;
+
+static int64_t now_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static int compare_seq(const void *a, const void *b)
+{
+    uint32_t sa = ((const IJKBlackBoxRecord *)a)->seq;
+    uint32_t sb = ((const IJKBlackBoxRecord *)b)->seq;
+    return sa < sb ? -1 : sa > sb;
+}
+
+// the records of the last span, if the launch that wrote them was killed
+// with a player open
+static IJKBlackBoxRecord *read_previous(BlackBoxFile *file, int *nb_previous)
+{
+    IJKBlackBoxRecord *records;
+    int                n = 0, first = 0;
+
+    *nb_previous = 0;
+    if (file->magic != BLACKBOX_MAGIC || file->slot_size != sizeof(BlackBoxSlot) ||
+        file->nb_slots != IJK_BLACKBOX_RECORDS || atomic_load(&file->open_players) <= 0)
+        return NULL;
+
+    records = malloc(sizeof(*records) * IJK_BLACKBOX_RECORDS);
+    if (!records)
+        return NULL;
+
+    // a slot holds the record its sequence number says, or one torn
+    for (int i = 0; i < IJK_BLACKBOX_RECORDS; i++) {
+        BlackBoxSlot *slot = &file->slots[i];
+        uint32_t      seq  = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+        if (!seq || (seq - 1) % IJK_BLACKBOX_RECORDS != (uint32_t)i ||
+            slot->type == IJK_BB_NONE || slot->type >= IJK_BB_COUNT)
+            continue;
+        records[n].seq    = seq;
+        records[n].type   = slot->type;
+        records[n].player = slot->player;
+        records[n].time   = slot->time;
+        memcpy(records[n].values, slot->values, sizeof(records[n].values));
+        n++;
+    }
+    qsort(records, n, sizeof(*records), compare_seq);
+
+    while (first < n && records[first].time < records[n - 1].time - IJK_BLACKBOX_SPAN_MS)
+        first++;
+    if (first >= n) {
+        free(records);
+        return NULL;
+    }
+    memmove(records, records + first, sizeof(*records) * (n - first));
+    *nb_previous = n - first;
+    return records;
+}
+
+int ijk_blackbox_open(const char *path, IJKBlackBoxRecord **previous, int *nb_previous)
+{
+    BlackBoxFile *file;
+    struct stat   st;
+    int           fd;
+
+    *previous    = NULL;
+    *nb_previous = 0;
+    if (atomic_load(&g_file))
+        return -EEXIST;
+
+    fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) < 0 || (st.st_size != sizeof(BlackBoxFile) && ftruncate(fd, sizeof(BlackBoxFile)) < 0)) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    // shared, so the pages are the file's and are written back after a kill
+    file = mmap(NULL, sizeof(BlackBoxFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+        return -errno;
+
+    if (st.st_size == sizeof(BlackBoxFile))
+        *previous = read_previous(file, nb_previous);
+
+    memset(file, 0, sizeof(*file));
+    file->magic     = BLACKBOX_MAGIC;
+    file->slot_size = sizeof(BlackBoxSlot);
+    file->nb_slots  = IJK_BLACKBOX_RECORDS;
+
+    BlackBoxFile *expected = NULL;
+    if (!atomic_compare_exchange_strong(&g_file, &expected, file)) {
+        munmap(file, sizeof(BlackBoxFile));
+        free(*previous);
+        *previous    = NULL;
+        *nb_previous = 0;
+        return -EEXIST;
+    }
+    return 0;
+}
+
+int ijk_blackbox_new_player(void)
+{
+    // 0 is the process
+    return atomic_fetch_add_explicit(&g_next_player, 1, memory_order_relaxed) % UINT16_MAX + 1;
+}
+
+void ijk_blackbox_player_did_open(int player)
+{
+    BlackBoxFile *file = atomic_load_explicit(&g_file, memory_order_acquire);
+    if (!file)
+        return;
+
+    atomic_fetch_add(&file->open_players, 1);
+    ijk_blackbox_write(IJK_BB_PLAYER_OPEN, player, NULL, 0);
+}
+
+void ijk_blackbox_player_did_close(int player)
+{
+    BlackBoxFile *file = atomic_load_explicit(&g_file, memory_order_acquire);
+    if (!file)
+        return;
+
+    ijk_blackbox_write(IJK_BB_PLAYER_CLOSE, player, NULL, 0);
+    atomic_fetch_sub(&file->open_players, 1);
+}
+
+void ijk_blackbox_write(IJKBlackBoxType type, int player, const int64_t *values, int nb_values)
+{
+    BlackBoxFile *file = atomic_load_explicit(&g_file, memory_order_acquire);
+    if (!file)
+        return;
+
+    uint32_t      seq  = atomic_fetch_add_explicit(&file->head, 1, memory_order_relaxed) + 1;
+    BlackBoxSlot *slot = &file->slots[(seq - 1) % IJK_BLACKBOX_RECORDS];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->type   = type;
+    slot->player = player;
+    slot->time   = now_ms();
+    for (int i = 0; i < IJK_BLACKBOX_VALUES; i++)
+        slot->values[i] = values && i < nb_values ? values[i] : 0;
+    atomic_store_explicit(&slot->seq, seq, memory_order_release);
+}
+
+void ijk_blackbox_format(const IJKBlackBoxRecord *record, char *buf, int size)
+{
+    const BlackBoxType *type = &g_types[record->type < IJK_BB_COUNT ? record->type : IJK_BB_NONE];
+    const int64_t      *v    = record->values;
+    char                text[256];
+    time_t              seconds = (time_t)(record->time / 1000);
+    struct tm           tm;
+
+    snprintf(text, sizeof(text), type->format ? type->format : "",
+             (long long)v[0], (long long)v[1], (long long)v[2], (long long)v[3], (long long)v[4], (long long)v[5]);
+    localtime_r(&seconds, &tm);
+    snprintf(buf, size, "%02d:%02d:%02d.%03d #%d %s %s",
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(record->time % 1000), record->player,
+             type->name ? type->name : "?", text);
+}
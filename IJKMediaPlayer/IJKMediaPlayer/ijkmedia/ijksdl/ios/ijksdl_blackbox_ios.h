@@ -0,0 +1,86 @@
+/*
+ * ijksdl_blackbox_ios.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_BLACKBOX_IOS_H
+#define IJKSDL_BLACKBOX_IOS_H
+
+#include <stdint.h>
+
+// Black box: a ring of the last telemetry records of the process, in a file
+// mapped shared. A record is in the page cache as soon as it is written, so
+// it outlives a kill of the process, by the watchdog or jetsam too, and the
+// next launch reads back what led up to it. Any thread writes without a
+// lock: a slot is taken by an atomic increment and published by its
+// sequence number, a record torn by the kill is left out.
+
+#define IJK_BLACKBOX_RECORDS    2048
+#define IJK_BLACKBOX_VALUES     6
+// the records read back span this much before the last one
+#define IJK_BLACKBOX_SPAN_MS    60000
+
+// type, name, format of the values, which the formats take as %lld
+#define IJK_BLACKBOX_TYPES(X) \
+    X(IJK_BB_PLAYER_OPEN,       "open",     "") \
+    X(IJK_BB_PLAYER_CLOSE,      "close",    "") \
+    X(IJK_BB_BUFFER,            "buffer",   "position %lld ms, cached video %lld ms %lld B, audio %lld ms %lld B") \
+    X(IJK_BB_RATES,             "rates",    "decode %lld, output %lld cfps, drop %lld/10000, dropped presents %lld, tcp %lld B/s, bit rate %lld") \
+    X(IJK_BB_MEMORY,            "memory",   "footprint %lld B, available %lld B") \
+    X(IJK_BB_MEMORY_WARNING,    "memwarn",  "player %lld B") \
+    X(IJK_BB_THREAD_STALL,      "stall",    "main thread late %lld ms") \
+    X(IJK_BB_REBUFFER_START,    "rebuffer", "at %lld ms") \
+    X(IJK_BB_REBUFFER_END,      "resume",   "after %lld ms") \
+    X(IJK_BB_VARIANT_SWITCH,    "variant",  "%lld -> %lld bps, estimate %lld bps") \
+    X(IJK_BB_NETWORK,           "http",     "error %lld, code %lld")
+
+#define IJK_BLACKBOX_TYPE_ENUM(type, name, format) type,
+typedef enum IJKBlackBoxType {
+    IJK_BB_NONE,
+    IJK_BLACKBOX_TYPES(IJK_BLACKBOX_TYPE_ENUM)
+    IJK_BB_COUNT
+} IJKBlackBoxType;
+#undef IJK_BLACKBOX_TYPE_ENUM
+
+typedef struct IJKBlackBoxRecord {
+    uint32_t seq;           // its number among the records written, from 1
+    uint16_t type;
+    uint16_t player;        // see ijk_blackbox_new_player(), 0 for the process
+    int64_t  time;          // milliseconds since 1970
+    int64_t  values[IJK_BLACKBOX_VALUES];
+} IJKBlackBoxRecord;
+
+// Map the file at path, created if need be, and start the ring of this
+// launch. If the launch before was killed with a player open, its records
+// of the last IJK_BLACKBOX_SPAN_MS are returned in *previous, oldest first,
+// to be freed; NULL otherwise. Once; 0, or a negative errno
+int  ijk_blackbox_open(const char *path, IJKBlackBoxRecord **previous, int *nb_previous);
+
+// no-ops until the ring is open
+int  ijk_blackbox_new_player(void);
+void ijk_blackbox_player_did_open(int player);
+void ijk_blackbox_player_did_close(int player);
+void ijk_blackbox_write(IJKBlackBoxType type, int player, const int64_t *values, int nb_values);
+
+// one line, "time player name values"
+void ijk_blackbox_format(const IJKBlackBoxRecord *record, char *buf, int size);
+
+#endif
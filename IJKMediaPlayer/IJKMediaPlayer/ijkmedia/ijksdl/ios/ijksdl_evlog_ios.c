@@ -0,0 +1,506 @@
+/*
+ * ijksdl_evlog_ios.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_evlog_ios.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/log.h"
+#include "libavutil/time.h"
+#include "ijksdl/ijksdl_log.h"
+
+// arguments kept of an av_log message
+#define AV_LOG_ARGS     3
+#define LINE_SIZE       512
+
+typedef struct EventInfo {
+    int         level;
+    const char *tag;
+    const char *format;
+} EventInfo;
+
+#define IJK_EVLOG_EVENT_INFO(event, level, tag, format) { level, tag, format },
+static const EventInfo g_events[IJK_EV_COUNT] = {
+    IJK_EVLOG_EVENTS(IJK_EVLOG_EVENT_INFO)
+};
+#undef IJK_EVLOG_EVENT_INFO
+
+typedef struct EventRecord {
+    int64_t     time;           // av_gettime_relative()
+    int64_t     args[AV_LOG_ARGS];
+    const char *tag;            // av_log: the class name
+    const char *format;         // av_log: its format
+    uint16_t    event;
+    uint8_t     level;
+} EventRecord;
+
+// written by one thread at a time, the one owning it, read by the dumps
+typedef struct EventRing {
+    atomic_uint     head;       // records written so far
+    atomic_bool     owned;
+    int             index;
+    char            thread[16];
+    EventRecord     records[IJK_EVLOG_RING_SIZE];
+} EventRing;
+
+static atomic_bool      g_enabled;
+static atomic_int       g_av_level = AV_LOG_VERBOSE;
+static atomic_uint      g_lost;
+static _Atomic(int64_t) g_cleared;
+
+static pthread_once_t   g_once  = PTHREAD_ONCE_INIT;
+static pthread_key_t    g_key;
+static pthread_mutex_t  g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static EventRing       *g_rings[IJK_EVLOG_MAX_THREADS];
+static atomic_int       g_ring_count;
+
+// the ring stays, for the history and for the next thread
+static void ring_disown(void *ring)
+{
+    atomic_store_explicit(&((EventRing *)ring)->owned, false, memory_order_release);
+}
+
+static void evlog_init(void)
+{
+    pthread_key_create(&g_key, ring_disown);
+}
+
+static EventRing *thread_ring(void)
+{
+    EventRing *ring;
+    int        count;
+
+    pthread_once(&g_once, evlog_init);
+    ring = pthread_getspecific(g_key);
+    if (ring)
+        return ring;
+
+    pthread_mutex_lock(&g_mutex);
+    count = atomic_load_explicit(&g_ring_count, memory_order_relaxed);
+    for (int i = 0; i < count && !ring; i++) {
+        if (!atomic_load_explicit(&g_rings[i]->owned, memory_order_acquire))
+            ring = g_rings[i];
+    }
+    if (!ring && count < IJK_EVLOG_MAX_THREADS) {
+        ring = calloc(1, sizeof(*ring));
+        if (ring) {
+            ring->index = count;
+            g_rings[count] = ring;
+            atomic_store_explicit(&g_ring_count, count + 1, memory_order_release);
+        }
+    }
+    if (ring) {
+        atomic_store_explicit(&ring->owned, true, memory_order_relaxed);
+        ring->thread[0] = '\0';
+        pthread_getname_np(pthread_self(), ring->thread, sizeof(ring->thread));
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    if (ring)
+        pthread_setspecific(g_key, ring);
+    return ring;
+}
+
+static EventRecord *ring_begin(EventRing *ring, unsigned *head)
+{
+    *head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return &ring->records[*head % IJK_EVLOG_RING_SIZE];
+}
+
+static void ring_commit(EventRing *ring, unsigned head)
+{
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void ijk_evlog_set_enabled(bool enabled)
+{
+    atomic_store(&g_enabled, enabled);
+}
+
+bool ijk_evlog_is_enabled(void)
+{
+    return atomic_load_explicit(&g_enabled, memory_order_relaxed);
+}
+
+void ijk_evlog_set_av_level(int av_level)
+{
+    atomic_store(&g_av_level, av_level);
+}
+
+// the formats of the events: %lld, %s and %%
+static void format_event(char *buf, size_t size, const char *format, const int64_t *args)
+{
+    size_t len = 0;
+    int    arg = 0;
+
+    for (const char *p = format; *p && len + 1 < size; p++) {
+        int n = 0;
+
+        if (*p != '%') {
+            buf[len++] = *p;
+            continue;
+        }
+        if (!strncmp(p, "%lld", 4)) {
+            n  = snprintf(buf + len, size - len, "%lld", arg < AV_LOG_ARGS ? (long long)args[arg] : 0LL);
+            p += 3;
+            arg++;
+        } else if (!strncmp(p, "%s", 2)) {
+            const char *s = arg < AV_LOG_ARGS ? (const char *)(intptr_t)args[arg] : NULL;
+            n  = snprintf(buf + len, size - len, "%s", s ? s : "(null)");
+            p += 1;
+            arg++;
+        } else if (p[1] == '%') {
+            buf[len++] = '%';
+            p += 1;
+        } else {
+            buf[len++] = '%';
+        }
+        if (n > 0)
+            len = len + n < size ? len + n : size - 1;
+    }
+    buf[len] = '\0';
+}
+
+void ijk_evlog_write(IJKEventId event, int64_t arg0, int64_t arg1, int64_t arg2)
+{
+    const EventInfo *info = &g_events[event];
+
+    if (!ijk_evlog_is_enabled()) {
+        char    text[LINE_SIZE];
+        int64_t args[AV_LOG_ARGS] = { arg0, arg1, arg2 };
+
+        format_event(text, sizeof(text), info->format, args);
+        ALOG(info->level, IJK_LOG_TAG, "[%s] %s\n", info->tag, text);
+        return;
+    }
+
+    EventRing *ring = thread_ring();
+    if (!ring) {
+        atomic_fetch_add_explicit(&g_lost, 1, memory_order_relaxed);
+        return;
+    }
+
+    unsigned     head;
+    EventRecord *record = ring_begin(ring, &head);
+    record->time    = av_gettime_relative();
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    record->tag     = info->tag;
+    record->format  = info->format;
+    record->event   = event;
+    record->level   = info->level;
+    ring_commit(ring, head);
+}
+
+#pragma mark av_log
+
+typedef enum ArgKind {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_STAR,       // a '*' width or precision
+    ARG_BAD,
+} ArgKind;
+
+// the conversion p is at, past its '%', copied into spec; p is left past it
+static ArgKind next_conversion(const char **pp, char *spec, size_t spec_size)
+{
+    const char *p     = *pp;
+    const char *begin = p - 1;
+    int         l     = 0;
+    ArgKind     kind  = ARG_BAD;
+
+    while (*p && strchr("-+ #0", *p))
+        p++;
+    if (*p == '*') {
+        *pp = p + 1;
+        return ARG_STAR;
+    }
+    while (*p && (strchr("0123456789.", *p)))
+        p++;
+    if (*p == '*') {
+        *pp = p + 1;
+        return ARG_STAR;
+    }
+
+    for (; *p && strchr("hlLjzt", *p); p++) {
+        switch (*p) {
+            case 'l': l++;      break;
+            case 'j': l = 2;    break;
+            case 'z':
+            case 't': l = 3;    break;
+            case 'L': l = 4;    break;
+        }
+    }
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            kind = l == 0 ? ARG_INT : l == 1 ? ARG_LONG : l == 2 ? ARG_LLONG : l == 3 ? ARG_SIZE : ARG_BAD;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            kind = l == 4 ? ARG_BAD : ARG_DOUBLE;
+            break;
+        case 'p':
+            kind = ARG_PTR;
+            break;
+        case 's':
+            kind = l == 0 ? ARG_STR : ARG_BAD;
+            break;
+        default:
+            break;
+    }
+    if (*p)
+        p++;
+
+    size_t len = p - begin;
+    if (len >= spec_size)
+        return ARG_BAD;
+    memcpy(spec, begin, len);
+    spec[len] = '\0';
+    *pp = p;
+    return kind;
+}
+
+// the conversions up to AV_LOG_ARGS, as av_log would have printed them
+static void capture_av_args(int64_t *args, const char *fmt, va_list vl)
+{
+    char spec[32];
+    int  arg = 0;
+
+    for (const char *p = fmt; *p && arg < AV_LOG_ARGS; ) {
+        if (*p++ != '%')
+            continue;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+
+        switch (next_conversion(&p, spec, sizeof(spec))) {
+            case ARG_INT:       args[arg++] = va_arg(vl, int);                      break;
+            case ARG_LONG:      args[arg++] = va_arg(vl, long);                     break;
+            case ARG_LLONG:     args[arg++] = va_arg(vl, long long);                break;
+            case ARG_SIZE:      args[arg++] = (int64_t)va_arg(vl, size_t);          break;
+            case ARG_PTR:       args[arg++] = (int64_t)(intptr_t)va_arg(vl, void *); break;
+            case ARG_DOUBLE: {
+                double d = va_arg(vl, double);
+                memcpy(&args[arg++], &d, sizeof(d));
+                break;
+            }
+            // not kept past the call
+            case ARG_STR:       (void)va_arg(vl, const char *); arg++;              break;
+            case ARG_STAR:      (void)va_arg(vl, int);                              break;
+            default:            return;
+        }
+    }
+}
+
+static void format_av(char *buf, size_t size, const char *fmt, const int64_t *args)
+{
+    char   spec[32];
+    size_t len = 0;
+    int    arg = 0;
+
+    for (const char *p = fmt; *p && len + 1 < size; ) {
+        int n = 0;
+
+        if (*p != '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+
+        ArgKind kind = next_conversion(&p, spec, sizeof(spec));
+        if (kind == ARG_STAR)
+            continue;
+        if (kind == ARG_BAD || arg >= AV_LOG_ARGS) {
+            n = snprintf(buf + len, size - len, "?");
+        } else {
+            int64_t v = args[arg++];
+            double  d;
+
+            switch (kind) {
+                case ARG_INT:       n = snprintf(buf + len, size - len, spec, (int)v);                  break;
+                case ARG_LONG:      n = snprintf(buf + len, size - len, spec, (long)v);                 break;
+                case ARG_LLONG:     n = snprintf(buf + len, size - len, spec, (long long)v);            break;
+                case ARG_SIZE:      n = snprintf(buf + len, size - len, spec, (size_t)v);               break;
+                case ARG_PTR:       n = snprintf(buf + len, size - len, spec, (void *)(intptr_t)v);     break;
+                case ARG_DOUBLE:
+                    memcpy(&d, &v, sizeof(d));
+                    n = snprintf(buf + len, size - len, spec, d);
+                    break;
+                default:            n = snprintf(buf + len, size - len, "<s>");                         break;
+            }
+        }
+        if (n > 0)
+            len = len + n < size ? len + n : size - 1;
+    }
+    buf[len] = '\0';
+}
+
+static int ijk_level_of_av(int level)
+{
+    if (level <= AV_LOG_ERROR)      return IJK_LOG_ERROR;
+    if (level <= AV_LOG_WARNING)    return IJK_LOG_WARN;
+    if (level <= AV_LOG_INFO)       return IJK_LOG_INFO;
+    if (level <= AV_LOG_VERBOSE)    return IJK_LOG_VERBOSE;
+    return IJK_LOG_DEBUG;
+}
+
+void ijk_evlog_av_log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    AVClass   *avc  = avcl ? *(AVClass **)avcl : NULL;
+    EventRing *ring = NULL;
+
+    if (fmt && level <= atomic_load_explicit(&g_av_level, memory_order_relaxed) && ijk_evlog_is_enabled())
+        ring = thread_ring();
+    if (ring) {
+        unsigned     head;
+        EventRecord *record = ring_begin(ring, &head);
+        va_list      vl2;
+
+        memset(record->args, 0, sizeof(record->args));
+        va_copy(vl2, vl);
+        capture_av_args(record->args, fmt, vl2);
+        va_end(vl2);
+        record->time    = av_gettime_relative();
+        record->tag     = avc ? avc->class_name : g_events[IJK_EV_AV_LOG].tag;
+        record->format  = fmt;
+        record->event   = IJK_EV_AV_LOG;
+        record->level   = ijk_level_of_av(level);
+        ring_commit(ring, head);
+    }
+
+    if (level <= av_log_get_level())
+        VLOG(ijk_level_of_av(level), IJK_LOG_TAG, fmt, vl);
+}
+
+#pragma mark dump
+
+typedef struct DumpRecord {
+    EventRecord record;
+    EventRing  *ring;
+} DumpRecord;
+
+static int compare_time(const void *a, const void *b)
+{
+    int64_t ta = ((const DumpRecord *)a)->record.time;
+    int64_t tb = ((const DumpRecord *)b)->record.time;
+    return ta < tb ? -1 : ta > tb;
+}
+
+static char level_letter(int level)
+{
+    switch (level) {
+        case IJK_LOG_VERBOSE:   return 'V';
+        case IJK_LOG_DEBUG:     return 'D';
+        case IJK_LOG_INFO:      return 'I';
+        case IJK_LOG_WARN:      return 'W';
+        case IJK_LOG_ERROR:     return 'E';
+        case IJK_LOG_FATAL:     return 'F';
+        default:                return '?';
+    }
+}
+
+void ijk_evlog_dump(void (*line)(void *opaque, const char *text), void *opaque)
+{
+    int         count   = atomic_load_explicit(&g_ring_count, memory_order_acquire);
+    int64_t     cleared = atomic_load(&g_cleared);
+    DumpRecord *all   = malloc(sizeof(*all) * IJK_EVLOG_RING_SIZE * (count > 0 ? count : 1));
+    size_t      n     = 0;
+    char        text[LINE_SIZE];
+    char        out[LINE_SIZE + 64];
+
+    if (!all)
+        return;
+
+    for (int i = 0; i < count; i++) {
+        EventRing *ring  = g_rings[i];
+        unsigned   head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned   first = head > IJK_EVLOG_RING_SIZE ? head - IJK_EVLOG_RING_SIZE : 0;
+        size_t     start = n;
+
+        for (unsigned k = first; k < head; k++)
+            all[n++].record = ring->records[k % IJK_EVLOG_RING_SIZE];
+
+        // the ones the thread went on to overwrite meanwhile are torn
+        atomic_thread_fence(memory_order_acquire);
+        unsigned now   = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned valid = now >= IJK_EVLOG_RING_SIZE ? now - IJK_EVLOG_RING_SIZE + 1 : 0;
+        size_t   kept  = start;
+        for (unsigned k = first; k < head; k++) {
+            if (k >= valid && all[start + (k - first)].record.time >= cleared)
+                all[kept++] = all[start + (k - first)];
+        }
+        n = kept;
+        for (size_t k = start; k < n; k++)
+            all[k].ring = ring;
+    }
+
+    qsort(all, n, sizeof(*all), compare_time);
+    for (size_t i = 0; i < n; i++) {
+        const EventRecord *r = &all[i].record;
+
+        if (r->event == IJK_EV_AV_LOG)
+            format_av(text, sizeof(text), r->format, r->args);
+        else
+            format_event(text, sizeof(text), r->format, r->args);
+        size_t len = strlen(text);
+        while (len > 0 && text[len - 1] == '\n')
+            text[--len] = '\0';
+
+        char thread[20];
+        if (all[i].ring->thread[0])
+            snprintf(thread, sizeof(thread), "%s", all[i].ring->thread);
+        else
+            snprintf(thread, sizeof(thread), "#%d", all[i].ring->index);
+        snprintf(out, sizeof(out), "%10.3f %-15s %c %s: %s",
+                 (r->time - all[0].record.time) / 1000.0, thread, level_letter(r->level), r->tag, text);
+        line(opaque, out);
+    }
+
+    unsigned lost = atomic_load_explicit(&g_lost, memory_order_relaxed);
+    if (lost) {
+        snprintf(out, sizeof(out), "%u events lost, more than %d threads", lost, IJK_EVLOG_MAX_THREADS);
+        line(opaque, out);
+    }
+    free(all);
+}
+
+void ijk_evlog_clear(void)
+{
+    // the rings are their threads' to write, the dumps skip what is older
+    atomic_store(&g_cleared, av_gettime_relative());
+    atomic_store(&g_lost, 0);
+}
@@ -0,0 +1,88 @@
+/*
+ * ijksdl_evlog_ios.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_EVLOG_IOS_H
+#define IJKSDL_EVLOG_IOS_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Binary event log: the hot paths write an event id and up to three
+// integer arguments to a ring of the calling thread, without a lock and
+// without formatting; the text is made only when the log is dumped. Cheap
+// enough to be left on in production, so a field issue keeps the history
+// before it. The last IJK_EVLOG_RING_SIZE events of each thread are kept.
+//
+// Off, an event is formatted and printed at once as ALOG did, see
+// ijk_evlog_set_enabled().
+
+#define IJK_EVLOG_RING_SIZE     1024
+#define IJK_EVLOG_MAX_THREADS   64
+
+// event, IJK_LOG_* level, tag, format. The formats take %lld for an
+// argument, and %s for a static string passed with IJK_EVLOG_STR()
+#define IJK_EVLOG_EVENTS(X) \
+    X(IJK_EV_AV_LOG,                 IJK_LOG_DEBUG, "ffmpeg", NULL) \
+    X(IJK_EV_VTB_GET_PICTURE_FAILED, IJK_LOG_INFO,  "vtb",    "get picture failure, sort queue %lld") \
+    X(IJK_EV_VTB_DECODE_CALLBACK,    IJK_LOG_ERROR, "vtb",    "decode callback %lld %s") \
+    X(IJK_EV_VTB_DECODE_FRAME,       IJK_LOG_ERROR, "vtb",    "decodeFrame %lld %s") \
+    X(IJK_EV_GL_RENDER_VTB_FAILED,   IJK_LOG_ERROR, "egl",    "IJKSDLGLVideoToolboxRenderer render failed") \
+    X(IJK_EV_GL_RENDER_FAILED,       IJK_LOG_ERROR, "egl",    "IJK_GLES2_render failed") \
+    X(IJK_EV_METAL_NO_PIXEL_BUFFER,  IJK_LOG_ERROR, "metal",  "nil pixelBuffer in overlay") \
+    X(IJK_EV_METAL_TEXTURE_FAILED,   IJK_LOG_ERROR, "metal",  "CVMetalTextureCacheCreateTextureFromImage(%lld) failed: %lld")
+
+#define IJK_EVLOG_EVENT_ENUM(event, level, tag, format) event,
+typedef enum IJKEventId {
+    IJK_EVLOG_EVENTS(IJK_EVLOG_EVENT_ENUM)
+    IJK_EV_COUNT
+} IJKEventId;
+#undef IJK_EVLOG_EVENT_ENUM
+
+#define IJK_EVLOG_STR(s) ((int64_t)(intptr_t)(const char *)(s))
+
+void ijk_evlog_set_enabled(bool enabled);
+bool ijk_evlog_is_enabled(void);
+
+void ijk_evlog_write(IJKEventId event, int64_t arg0, int64_t arg1, int64_t arg2);
+
+#define IJK_EVLOG0(event)                   ijk_evlog_write(event, 0, 0, 0)
+#define IJK_EVLOG1(event, a0)               ijk_evlog_write(event, (int64_t)(a0), 0, 0)
+#define IJK_EVLOG2(event, a0, a1)           ijk_evlog_write(event, (int64_t)(a0), (int64_t)(a1), 0)
+#define IJK_EVLOG3(event, a0, a1, a2)       ijk_evlog_write(event, (int64_t)(a0), (int64_t)(a1), (int64_t)(a2))
+
+// The av_log callback while the log is on: messages up to the AV_LOG_* level
+// set are kept as their format and the arguments it takes, but for the
+// strings, which are not kept past the call; the ones up to av_log_get_level()
+// are printed as well. Installed and removed by the caller, see
+// av_log_set_callback()
+void ijk_evlog_set_av_level(int av_level);
+void ijk_evlog_av_log_callback(void *avcl, int level, const char *fmt, va_list vl);
+
+// the events of every thread in time order, one line each, with the time
+// since the first in ms, the thread and the tag; on the calling thread.
+// Events written meanwhile may be left out
+void ijk_evlog_dump(void (*line)(void *opaque, const char *text), void *opaque);
+void ijk_evlog_clear(void);
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * ijksdl_image_convert.c
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_image_convert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IJK_IMAGE_CONVERT_NEON 1
+#endif
+
+// bilinear weights in 1/128, so that a weighted sum of two u8 fits u16
+#define WEIGHT_BITS     7
+#define WEIGHT_ONE      (1 << WEIGHT_BITS)
+// conversion coefficients in 1/64, so that a term fits s16
+#define COEFF_BITS      6
+
+#define ALIGN16(x)      (((x) + 15) & ~(size_t)15)
+
+typedef struct ConvertCoeffs {
+    int16_t y_offset;
+    int16_t y_scale;
+    int16_t v_r;
+    int16_t u_g;
+    int16_t v_g;
+    int16_t u_b;
+} ConvertCoeffs;
+
+static const ConvertCoeffs g_coeffs[2][2] = {
+    // BT.601: video range, full range
+    { { 16, 75, 102, 25, 52, 129 }, { 0, 64,  90, 22, 46, 113 } },
+    // BT.709
+    { { 16, 75, 115, 14, 34, 135 }, { 0, 64, 101, 12, 30, 119 } },
+};
+
+typedef struct Plane {
+    const uint8_t *data;
+    int            linesize;
+    int            width;
+    int            height;
+} Plane;
+
+static void halve_plane(const Plane *src, uint8_t *dst, Plane *out)
+{
+    int width  = src->width / 2;
+    int height = src->height / 2;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *a = src->data + 2 * y * src->linesize;
+        const uint8_t *b = a + src->linesize;
+        uint8_t       *d = dst + y * width;
+        int            x = 0;
+#if IJK_IMAGE_CONVERT_NEON
+        for (; x + 8 <= width; x += 8) {
+            uint16x8_t sum = vaddq_u16(vpaddlq_u8(vld1q_u8(a + 2 * x)), vpaddlq_u8(vld1q_u8(b + 2 * x)));
+            vst1_u8(d + x, vrshrn_n_u16(sum, 2));
+        }
+#endif
+        for (; x < width; x++)
+            d[x] = (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2;
+    }
+
+    out->data     = dst;
+    out->linesize = width;
+    out->width    = width;
+    out->height   = height;
+}
+
+// src->width counts CbCr pairs
+static void halve_interleaved(const Plane *src, uint8_t *dst_u, uint8_t *dst_v, Plane *out_u, Plane *out_v)
+{
+    int width  = src->width / 2;
+    int height = src->height / 2;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *a = src->data + 2 * y * src->linesize;
+        const uint8_t *b = a + src->linesize;
+        uint8_t       *u = dst_u + y * width;
+        uint8_t       *v = dst_v + y * width;
+        int            x = 0;
+#if IJK_IMAGE_CONVERT_NEON
+        for (; x + 8 <= width; x += 8) {
+            uint8x8x4_t ra = vld4_u8(a + 4 * x);
+            uint8x8x4_t rb = vld4_u8(b + 4 * x);
+            uint16x8_t  su = vaddq_u16(vaddl_u8(ra.val[0], ra.val[2]), vaddl_u8(rb.val[0], rb.val[2]));
+            uint16x8_t  sv = vaddq_u16(vaddl_u8(ra.val[1], ra.val[3]), vaddl_u8(rb.val[1], rb.val[3]));
+            vst1_u8(u + x, vrshrn_n_u16(su, 2));
+            vst1_u8(v + x, vrshrn_n_u16(sv, 2));
+        }
+#endif
+        for (; x < width; x++) {
+            u[x] = (a[4 * x]     + a[4 * x + 2] + b[4 * x]     + b[4 * x + 2] + 2) >> 2;
+            v[x] = (a[4 * x + 1] + a[4 * x + 3] + b[4 * x + 1] + b[4 * x + 3] + 2) >> 2;
+        }
+    }
+
+    *out_u = (Plane){ dst_u, width, width, height };
+    *out_v = (Plane){ dst_v, width, width, height };
+}
+
+static void deinterleave(const Plane *src, uint8_t *dst_u, uint8_t *dst_v, Plane *out_u, Plane *out_v)
+{
+    int width = src->width;
+
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *s = src->data + y * src->linesize;
+        uint8_t       *u = dst_u + y * width;
+        uint8_t       *v = dst_v + y * width;
+        int            x = 0;
+#if IJK_IMAGE_CONVERT_NEON
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x2_t uv = vld2q_u8(s + 2 * x);
+            vst1q_u8(u + x, uv.val[0]);
+            vst1q_u8(v + x, uv.val[1]);
+        }
+#endif
+        for (; x < width; x++) {
+            u[x] = s[2 * x];
+            v[x] = s[2 * x + 1];
+        }
+    }
+
+    *out_u = (Plane){ dst_u, width, width, src->height };
+    *out_v = (Plane){ dst_v, width, width, src->height };
+}
+
+// the two source samples around the centre of each of count outputs
+static void bilinear_taps(int *index0, int *index1, uint8_t *weight, int count, int src_size)
+{
+    for (int i = 0; i < count; i++) {
+        int64_t pos = (int64_t)(2 * i + 1) * src_size * WEIGHT_ONE / (2 * count) - WEIGHT_ONE / 2;
+        if (pos < 0)
+            pos = 0;
+
+        int index = (int)(pos >> WEIGHT_BITS);
+        if (index >= src_size - 1) {
+            index0[i] = index1[i] = src_size - 1;
+            weight[i] = 0;
+        } else {
+            index0[i] = index;
+            index1[i] = index + 1;
+            weight[i] = pos & (WEIGHT_ONE - 1);
+        }
+    }
+}
+
+static const uint8_t *lerp_rows(const Plane *src, int row0, int row1, uint8_t weight, uint8_t *dst)
+{
+    const uint8_t *a = src->data + row0 * src->linesize;
+    const uint8_t *b = src->data + row1 * src->linesize;
+    int            x = 0;
+
+    if (!weight)
+        return a;
+#if IJK_IMAGE_CONVERT_NEON
+    uint8x8_t w0 = vdup_n_u8(WEIGHT_ONE - weight);
+    uint8x8_t w1 = vdup_n_u8(weight);
+    for (; x + 8 <= src->width; x += 8) {
+        uint16x8_t sum = vmlal_u8(vmull_u8(vld1_u8(a + x), w0), vld1_u8(b + x), w1);
+        vst1_u8(dst + x, vrshrn_n_u16(sum, WEIGHT_BITS));
+    }
+#endif
+    for (; x < src->width; x++)
+        dst[x] = (a[x] * (WEIGHT_ONE - weight) + b[x] * weight + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+    return dst;
+}
+
+static void lerp_columns(const uint8_t *src, const int *index0, const int *index1, const uint8_t *weight,
+                         uint8_t *dst, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = (src[index0[x]] * (WEIGHT_ONE - weight[x]) + src[index1[x]] * weight[x] + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+}
+
+static inline uint8_t clip_u8(int value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static void convert_row(const uint8_t *ys, const uint8_t *us, const uint8_t *vs,
+                        uint8_t *dst, int width, const ConvertCoeffs *c)
+{
+    int x = 0;
+#if IJK_IMAGE_CONVERT_NEON
+    int16x8_t y_offset = vdupq_n_s16(c->y_offset);
+    int16x8_t c_offset = vdupq_n_s16(128);
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t y = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(ys + x))), y_offset), c->y_scale);
+        int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(us + x))), c_offset);
+        int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(vs + x))), c_offset);
+        int16x8_t r = vqaddq_s16(y, vmulq_n_s16(v, c->v_r));
+        int16x8_t g = vqsubq_s16(vqsubq_s16(y, vmulq_n_s16(u, c->u_g)), vmulq_n_s16(v, c->v_g));
+        int16x8_t b = vqaddq_s16(y, vmulq_n_s16(u, c->u_b));
+
+        uint8x8x4_t bgra;
+        bgra.val[0] = vqrshrun_n_s16(b, COEFF_BITS);
+        bgra.val[1] = vqrshrun_n_s16(g, COEFF_BITS);
+        bgra.val[2] = vqrshrun_n_s16(r, COEFF_BITS);
+        bgra.val[3] = vdup_n_u8(255);
+        vst4_u8(dst + 4 * x, bgra);
+    }
+#endif
+    for (; x < width; x++) {
+        int y = (ys[x] - c->y_offset) * c->y_scale;
+        int u = us[x] - 128;
+        int v = vs[x] - 128;
+        int round = 1 << (COEFF_BITS - 1);
+
+        dst[4 * x]     = clip_u8((y + u * c->u_b + round) >> COEFF_BITS);
+        dst[4 * x + 1] = clip_u8((y - u * c->u_g - v * c->v_g + round) >> COEFF_BITS);
+        dst[4 * x + 2] = clip_u8((y + v * c->v_r + round) >> COEFF_BITS);
+        dst[4 * x + 3] = 255;
+    }
+}
+
+int ijk_image_yuv420_to_bgra(const IJKYUV420Image *src,
+                             uint8_t *dst, int dst_linesize, int dst_width, int dst_height)
+{
+    Plane   luma   = { src->data[0], src->linesize[0], src->width, src->height };
+    Plane   chroma = { src->data[1], src->linesize[1], (src->width + 1) / 2, (src->height + 1) / 2 };
+    Plane   cb     = chroma;
+    Plane   cr     = { src->data[2], src->linesize[2], chroma.width, chroma.height };
+    int     levels = 0;
+
+    while (luma.width >> levels >= 2 * dst_width && luma.height >> levels >= 2 * dst_height &&
+           chroma.width >> levels >= 2 && chroma.height >> levels >= 2)
+        levels++;
+
+    // levels alternate between two buffers, the first one also takes the
+    // chroma of NV12 when it is not halved
+    size_t first_size  = ALIGN16((size_t)(luma.width / 2) * (luma.height / 2) + (size_t)chroma.width * chroma.height * 2);
+    size_t second_size = ALIGN16((size_t)(luma.width / 4) * (luma.height / 4) + (size_t)(chroma.width / 2) * (chroma.height / 2) * 2);
+    int    row_width   = luma.width;
+    size_t row_size    = ALIGN16((size_t)row_width * 3 + (size_t)dst_width * 3);
+    size_t tap_size    = (size_t)dst_width * 2 * (2 * sizeof(int) + 1) + (size_t)dst_height * 2 * (2 * sizeof(int) + 1);
+    uint8_t *memory = malloc(first_size + second_size + row_size + tap_size);
+    if (!memory)
+        return -1;
+
+    uint8_t *buffers[2] = { memory, memory + first_size };
+    for (int level = 0; level < levels; level++) {
+        uint8_t *buffer = buffers[level & 1];
+        Plane    next_luma;
+
+        halve_plane(&luma, buffer, &next_luma);
+        buffer += (size_t)next_luma.width * next_luma.height;
+        if (src->nv12 && level == 0) {
+            halve_interleaved(&chroma, buffer, buffer + (size_t)(chroma.width / 2) * (chroma.height / 2), &cb, &cr);
+        } else {
+            Plane next_cb, next_cr;
+            halve_plane(&cb, buffer, &next_cb);
+            halve_plane(&cr, buffer + (size_t)next_cb.width * next_cb.height, &next_cr);
+            cb = next_cb;
+            cr = next_cr;
+        }
+        luma = next_luma;
+    }
+    if (src->nv12 && levels == 0)
+        deinterleave(&chroma, buffers[0], buffers[0] + (size_t)chroma.width * chroma.height, &cb, &cr);
+
+    uint8_t *rows   = memory + first_size + second_size;
+    uint8_t *row_y  = rows;
+    uint8_t *row_u  = row_y + row_width;
+    uint8_t *row_v  = row_u + row_width;
+    uint8_t *out_y  = row_v + row_width;
+    uint8_t *out_u  = out_y + dst_width;
+    uint8_t *out_v  = out_u + dst_width;
+
+    int     *taps   = (int *)(memory + first_size + second_size + row_size);
+    int     *lx0    = taps,         *lx1 = lx0 + dst_width;
+    int     *cx0    = lx1 + dst_width, *cx1 = cx0 + dst_width;
+    int     *ly0    = cx1 + dst_width, *ly1 = ly0 + dst_height;
+    int     *cy0    = ly1 + dst_height, *cy1 = cy0 + dst_height;
+    uint8_t *lwx    = (uint8_t *)(cy1 + dst_height);
+    uint8_t *cwx    = lwx + dst_width;
+    uint8_t *lwy    = cwx + dst_width;
+    uint8_t *cwy    = lwy + dst_height;
+
+    bilinear_taps(lx0, lx1, lwx, dst_width,  luma.width);
+    bilinear_taps(ly0, ly1, lwy, dst_height, luma.height);
+    bilinear_taps(cx0, cx1, cwx, dst_width,  cb.width);
+    bilinear_taps(cy0, cy1, cwy, dst_height, cb.height);
+
+    const ConvertCoeffs *coeffs = &g_coeffs[src->bt709 ? 1 : 0][src->full_range ? 1 : 0];
+    for (int y = 0; y < dst_height; y++) {
+        lerp_columns(lerp_rows(&luma, ly0[y], ly1[y], lwy[y], row_y), lx0, lx1, lwx, out_y, dst_width);
+        lerp_columns(lerp_rows(&cb,   cy0[y], cy1[y], cwy[y], row_u), cx0, cx1, cwx, out_u, dst_width);
+        lerp_columns(lerp_rows(&cr,   cy0[y], cy1[y], cwy[y], row_v), cx0, cx1, cwx, out_v, dst_width);
+        convert_row(out_y, out_u, out_v, dst + y * dst_linesize, dst_width, coeffs);
+    }
+
+    free(memory);
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * ijksdl_image_convert.h
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_IOS__IJKSDL_IMAGE_CONVERT_H
+#define IJKSDL_IOS__IJKSDL_IMAGE_CONVERT_H
+
+#include <stdint.h>
+
+/*
+ * 4:2:0 YUV to BGRA (B, G, R, 255 in memory), scaled on the way for
+ * thumbnails: the planes are halved with 2x2 boxes while the picture is at
+ * least twice the output, then sampled bilinearly with the conversion
+ * fused in, row by row. NEON on arm, plain C elsewhere.
+ */
+typedef struct IJKYUV420Image {
+    const uint8_t *data[3];         // Y, and Cb Cr, or the interleaved CbCr of NV12
+    int            linesize[3];
+    int            width;
+    int            height;
+    int            nv12;
+    int            full_range;      // else video range
+    int            bt709;           // else BT.601
+} IJKYUV420Image;
+
+// dst_width and dst_height at least 2
+// @return 0 on success, -1 if out of memory
+int ijk_image_yuv420_to_bgra(const IJKYUV420Image *src,
+                             uint8_t *dst, int dst_linesize, int dst_width, int dst_height);
+
+#endif
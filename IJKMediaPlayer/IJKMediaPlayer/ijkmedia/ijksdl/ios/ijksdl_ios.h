@@ -24,6 +24,9 @@
 #include "ijksdl/ijksdl.h"
 #include "ijksdl_aout_ios_audiounit.h"
 #include "ijksdl_vout_ios_gles2.h"
+#include "ijksdl_vout_ios_metal.h"
+#include "ijksdl_vout_ios_sample_buffer.h"
+#include "ijksdl_vout_ios_outputs.h"
 #import <UIKit/UIKit.h>
 
 
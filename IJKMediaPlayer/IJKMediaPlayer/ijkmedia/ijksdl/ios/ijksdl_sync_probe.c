@@ -0,0 +1,275 @@
+/*
+ * ijksdl_sync_probe.c
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ijksdl_sync_probe.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a tone onset needs this much silence before it, in seconds
+#define IJK_SYNC_PROBE_QUIET        0.1
+#define IJK_SYNC_PROBE_LOUD         0.1f    // -20 dBFS
+#define IJK_SYNC_PROBE_BRIGHT       160
+#define IJK_SYNC_PROBE_DARK         96
+// a flash and an onset further apart are of different periods
+#define IJK_SYNC_PROBE_MAX_OFFSET   0.5
+// longer between presents is a pause, not an interval
+#define IJK_SYNC_PROBE_MAX_INTERVAL 0.5
+
+// written by one thread, read by any
+typedef struct SyncRing {
+    atomic_uint head;
+    unsigned    size;
+    double     *times;
+    double     *values;
+} SyncRing;
+
+struct IJKSyncProbe {
+    atomic_int      ref_count;
+    _Atomic(double) since;      // reset time, earlier events are left out
+
+    // IO thread
+    SyncRing        onsets;
+    int64_t         quiet_frames;
+
+    // render thread
+    SyncRing        flashes;
+    SyncRing        intervals;  // milliseconds, at the time of the later frame
+    int             last_luma;
+    double          last_time;
+};
+
+static int ring_init(SyncRing *ring, unsigned size)
+{
+    ring->size   = size;
+    ring->times  = calloc(size, sizeof(double));
+    ring->values = calloc(size, sizeof(double));
+    return ring->times && ring->values ? 0 : -1;
+}
+
+static void ring_push(SyncRing *ring, double time, double value)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->times[head % ring->size]  = time;
+    ring->values[head % ring->size] = value;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// the entries not older than since, oldest first; those the writer went on
+// to overwrite meanwhile are torn and left out
+static int ring_copy(SyncRing *ring, double since, double *times, double *values)
+{
+    unsigned head  = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned first = head > ring->size ? head - ring->size : 0;
+    int      n     = 0;
+
+    for (unsigned k = first; k < head; k++) {
+        times[n]  = ring->times[k % ring->size];
+        values[n] = ring->values[k % ring->size];
+        n++;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    unsigned now   = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned valid = now >= ring->size ? now - ring->size + 1 : 0;
+
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (first + i >= valid && times[i] >= since) {
+            times[kept]  = times[i];
+            values[kept] = values[i];
+            kept++;
+        }
+    }
+    return kept;
+}
+
+static void probe_free(IJKSyncProbe *probe)
+{
+    SyncRing *rings[] = { &probe->onsets, &probe->flashes, &probe->intervals };
+    for (int i = 0; i < 3; i++) {
+        free(rings[i]->times);
+        free(rings[i]->values);
+    }
+    free(probe);
+}
+
+IJKSyncProbe *ijk_sync_probe_create(void)
+{
+    IJKSyncProbe *probe = calloc(1, sizeof(*probe));
+    if (!probe)
+        return NULL;
+
+    atomic_init(&probe->ref_count, 1);
+    probe->last_luma = -1;
+    if (ring_init(&probe->onsets, IJK_SYNC_PROBE_EVENTS) < 0 ||
+        ring_init(&probe->flashes, IJK_SYNC_PROBE_EVENTS) < 0 ||
+        ring_init(&probe->intervals, IJK_SYNC_PROBE_INTERVALS) < 0) {
+        probe_free(probe);
+        return NULL;
+    }
+    return probe;
+}
+
+IJKSyncProbe *ijk_sync_probe_ref(IJKSyncProbe *probe)
+{
+    if (probe)
+        atomic_fetch_add_explicit(&probe->ref_count, 1, memory_order_relaxed);
+    return probe;
+}
+
+void ijk_sync_probe_unref(IJKSyncProbe **pprobe)
+{
+    IJKSyncProbe *probe = pprobe ? *pprobe : NULL;
+    if (!probe)
+        return;
+
+    *pprobe = NULL;
+    if (atomic_fetch_sub_explicit(&probe->ref_count, 1, memory_order_acq_rel) == 1)
+        probe_free(probe);
+}
+
+void ijk_sync_probe_audio(IJKSyncProbe *probe, const float *stereo, int frames, int sample_rate, double time)
+{
+    int64_t quiet_needed = (int64_t)(IJK_SYNC_PROBE_QUIET * sample_rate);
+
+    for (int i = 0; i < frames; i++) {
+        float level = fmaxf(fabsf(stereo[2 * i]), fabsf(stereo[2 * i + 1]));
+        if (level < IJK_SYNC_PROBE_LOUD) {
+            probe->quiet_frames++;
+            continue;
+        }
+        if (probe->quiet_frames >= quiet_needed)
+            ring_push(&probe->onsets, time + (double)i / sample_rate, 0);
+        probe->quiet_frames = 0;
+    }
+}
+
+void ijk_sync_probe_video(IJKSyncProbe *probe, int luma, double time)
+{
+    double interval = time - probe->last_time;
+
+    if (probe->last_time > 0 && interval > 0 && interval < IJK_SYNC_PROBE_MAX_INTERVAL)
+        ring_push(&probe->intervals, time, interval * 1000);
+    probe->last_time = time;
+
+    if (luma < 0)
+        return;
+    if (luma >= IJK_SYNC_PROBE_BRIGHT && probe->last_luma >= 0 && probe->last_luma <= IJK_SYNC_PROBE_DARK)
+        ring_push(&probe->flashes, time, luma);
+    probe->last_luma = luma;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return da < db ? -1 : da > db;
+}
+
+// of n sorted values
+static double percentile(const double *sorted, int n, int p)
+{
+    return n > 0 ? sorted[(n - 1) * p / 100] : 0;
+}
+
+static void mean_stddev(const double *values, int n, double *mean, double *stddev)
+{
+    double sum = 0, sum2 = 0;
+
+    for (int i = 0; i < n; i++)
+        sum += values[i];
+    *mean = n > 0 ? sum / n : 0;
+    for (int i = 0; i < n; i++)
+        sum2 += (values[i] - *mean) * (values[i] - *mean);
+    *stddev = n > 1 ? sqrt(sum2 / (n - 1)) : 0;
+}
+
+void ijk_sync_probe_get_result(IJKSyncProbe *probe, IJKSyncProbeResult *result)
+{
+    double  since = atomic_load(&probe->since);
+    double  flashes[IJK_SYNC_PROBE_EVENTS], onsets[IJK_SYNC_PROBE_EVENTS];
+    double  offsets[IJK_SYNC_PROBE_EVENTS], magnitudes[IJK_SYNC_PROBE_EVENTS];
+    double *times  = malloc(sizeof(double) * IJK_SYNC_PROBE_INTERVALS);
+    double *values = malloc(sizeof(double) * IJK_SYNC_PROBE_INTERVALS);
+    double  unused[IJK_SYNC_PROBE_EVENTS];
+
+    memset(result, 0, sizeof(*result));
+    if (!times || !values) {
+        free(times);
+        free(values);
+        return;
+    }
+
+    result->flashes = ring_copy(&probe->flashes, since, flashes, unused);
+    result->onsets  = ring_copy(&probe->onsets, since, onsets, unused);
+    for (int i = 0; i < result->flashes; i++) {
+        double best = IJK_SYNC_PROBE_MAX_OFFSET;
+        int    pair = -1;
+        for (int j = 0; j < result->onsets; j++) {
+            if (fabs(flashes[i] - onsets[j]) < best) {
+                best = fabs(flashes[i] - onsets[j]);
+                pair = j;
+            }
+        }
+        if (pair >= 0)
+            offsets[result->pairs++] = (flashes[i] - onsets[pair]) * 1000;
+    }
+    if (result->pairs > 0) {
+        mean_stddev(offsets, result->pairs, &result->offset_mean, &result->offset_stddev);
+        for (int i = 0; i < result->pairs; i++)
+            magnitudes[i] = fabs(offsets[i]);
+        qsort(offsets, result->pairs, sizeof(double), compare_double);
+        qsort(magnitudes, result->pairs, sizeof(double), compare_double);
+        result->offset_min = offsets[0];
+        result->offset_p50 = percentile(offsets, result->pairs, 50);
+        result->offset_p95 = percentile(magnitudes, result->pairs, 95);
+        result->offset_max = offsets[result->pairs - 1];
+    }
+
+    result->intervals = ring_copy(&probe->intervals, since, times, values);
+    if (result->intervals > 0) {
+        mean_stddev(values, result->intervals, &result->interval_mean, &result->interval_stddev);
+        qsort(values, result->intervals, sizeof(double), compare_double);
+        result->interval_p50 = percentile(values, result->intervals, 50);
+        result->interval_p95 = percentile(values, result->intervals, 95);
+        result->interval_max = values[result->intervals - 1];
+    }
+    free(times);
+    free(values);
+}
+
+void ijk_sync_probe_reset(IJKSyncProbe *probe)
+{
+    // the writers go on, the results skip what came before
+    double latest = 0;
+    SyncRing *rings[] = { &probe->onsets, &probe->flashes, &probe->intervals };
+
+    for (int i = 0; i < 3; i++) {
+        unsigned head = atomic_load_explicit(&rings[i]->head, memory_order_acquire);
+        if (head > 0)
+            latest = fmax(latest, rings[i]->times[(head - 1) % rings[i]->size]);
+    }
+    atomic_store(&probe->since, nextafter(latest, INFINITY));
+}
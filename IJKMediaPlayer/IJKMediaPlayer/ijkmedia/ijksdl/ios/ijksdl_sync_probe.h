@@ -0,0 +1,85 @@
+/*
+ * ijksdl_sync_probe.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_IOS__IJKSDL_SYNC_PROBE_H
+#define IJKSDL_IOS__IJKSDL_SYNC_PROBE_H
+
+#include <stdint.h>
+
+#define IJK_SYNC_PROBE_EVENTS       256     // flashes and onsets kept of each
+#define IJK_SYNC_PROBE_INTERVALS    1024    // present intervals kept
+
+/*
+ * A/V sync and frame pacing as played out, for a calibrated test stream:
+ * each period starts with a white flash frame over black and a tone burst
+ * over silence at the same pts. The render thread gives the time each
+ * frame lands on screen and how bright it is, the IO thread of the audio
+ * output the blocks it renders with the time their first frame is heard;
+ * a flash is the first bright frame after a dark one, an onset the first
+ * loud sample after IJK_SYNC_PROBE_QUIET of silence. Each flash is paired
+ * with the onset nearest to it.
+ *
+ * Times are seconds of the host clock, CACurrentMediaTime(). Each side is
+ * written by one thread without a lock or an allocation; the result is
+ * computed from what is kept, on any thread.
+ */
+typedef struct IJKSyncProbe IJKSyncProbe;
+
+typedef struct IJKSyncProbeResult {
+    int     flashes;            // detected
+    int     onsets;
+    int     pairs;              // a flash with an onset within half a second
+
+    // milliseconds the flash is shown after the tone is heard, of the pairs
+    double  offset_mean;
+    double  offset_stddev;
+    double  offset_min;
+    double  offset_p50;
+    double  offset_p95;         // of the absolute offsets
+    double  offset_max;
+
+    // milliseconds between the frames landing on screen, all frames
+    int     intervals;
+    double  interval_mean;
+    double  interval_stddev;    // the jitter
+    double  interval_p50;
+    double  interval_p95;
+    double  interval_max;
+} IJKSyncProbeResult;
+
+IJKSyncProbe *ijk_sync_probe_create(void);
+IJKSyncProbe *ijk_sync_probe_ref(IJKSyncProbe *probe);
+void          ijk_sync_probe_unref(IJKSyncProbe **probe);
+
+// IO thread: frames of interleaved float stereo as rendered, the first one
+// heard at time
+void ijk_sync_probe_audio(IJKSyncProbe *probe, const float *stereo, int frames, int sample_rate, double time);
+// render thread: a frame landing on screen at time, luma the mean of its
+// center from 0 to 255, -1 if unknown
+void ijk_sync_probe_video(IJKSyncProbe *probe, int luma, double time);
+
+// any thread: of what was detected since the last reset
+void ijk_sync_probe_get_result(IJKSyncProbe *probe, IJKSyncProbeResult *result);
+void ijk_sync_probe_reset(IJKSyncProbe *probe);
+
+#endif
@@ -22,3 +22,46 @@
  */
 
 #import <Foundation/Foundation.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct SDL_Thread;
+
+// What a thread does, which gives its QoS class: the work the user waits on
+// is kept off the efficiency cores, the downloads are not.
+typedef enum IJKSDLThreadRole {
+    IJKSDLThreadRoleOther = 0,      // default
+    IJKSDLThreadRoleIO,             // utility
+    IJKSDLThreadRoleDemux,          // user initiated
+    IJKSDLThreadRoleVideoDecode,    // user interactive
+    IJKSDLThreadRoleAudio,          // user interactive
+    IJKSDLThreadRoleRender,         // user interactive
+    IJKSDLThreadRoleMessage,        // user initiated
+    IJKSDLThreadRoleCount,
+} IJKSDLThreadRole;
+
+// the role of the threads the player core names: "ff_read", "ff_video_dec"...
+IJKSDLThreadRole IJKSDLThreadRoleForName(const char *name);
+const char *IJKSDLThreadRoleGetName(IJKSDLThreadRole role);
+
+struct SDL_Thread *SDL_CreateThreadExWithRole(struct SDL_Thread *thread, int (*fn)(void *), void *data,
+                                              const char *name, IJKSDLThreadRole role);
+
+// The threads of a player. A thread joins the group of the thread creating
+// it, so entering the group around ijkmp_prepare_async brings in every
+// thread the player starts. While the group is in the background its new
+// threads start at background QoS; brought back, they are raised to their
+// role with a QoS override. Threads started in the foreground keep their
+// role, the player pauses them.
+typedef struct IJKSDLThreadGroup IJKSDLThreadGroup;
+
+IJKSDLThreadGroup *IJKSDLThreadGroup_create(void);
+// the group lives on until its last thread exits
+void IJKSDLThreadGroup_releasep(IJKSDLThreadGroup **group);
+
+// the threads this one creates from now on, NULL to stop
+void IJKSDLThreadGroup_enter(IJKSDLThreadGroup *group);
+void IJKSDLThreadGroup_setBackground(IJKSDLThreadGroup *group, bool background);
+
+// microseconds of CPU, user and system, by role, of the threads alive or gone
+void IJKSDLThreadGroup_getCPUTime(IJKSDLThreadGroup *group, int64_t cpu_us[IJKSDLThreadRoleCount]);
@@ -23,25 +23,240 @@
 
 #import "ijksdl_thread_ios.h"
 #include "ijksdl/ijksdl_thread.h"
+#include <mach/mach.h>
+#include <pthread.h>
+#include <pthread/qos.h>
+#include <stdatomic.h>
+
+typedef struct IJKSDLThreadEntry {
+    pthread_t                 thread;
+    mach_port_t               port;
+    IJKSDLThreadRole          role;
+    bool                      background;   // started at background QoS
+    pthread_override_t        override;     // raised to its role since
+    struct IJKSDLThreadEntry *next;
+} IJKSDLThreadEntry;
+
+struct IJKSDLThreadGroup {
+    atomic_int         ref_count;   // the owner and each thread
+    pthread_mutex_t    mutex;
+    bool               background;
+    IJKSDLThreadEntry *threads;
+    int64_t            exited_cpu_us[IJKSDLThreadRoleCount];
+};
+
+typedef struct IJKSDLThreadStart {
+    SDL_Thread        *thread;
+    IJKSDLThreadGroup *group;
+    IJKSDLThreadRole   role;
+} IJKSDLThreadStart;
+
+static __thread IJKSDLThreadGroup *tls_thread_group;
+
+static const struct {
+    const char       *name;
+    IJKSDLThreadRole  role;
+} g_role_names[] = {
+    { "ff_read",        IJKSDLThreadRoleDemux },
+    { "ff_video_dec",   IJKSDLThreadRoleVideoDecode },
+    { "ff_audio_dec",   IJKSDLThreadRoleAudio },
+    { "ff_aout",        IJKSDLThreadRoleAudio },
+    { "ff_vout",        IJKSDLThreadRoleRender },
+    { "ff_msg",         IJKSDLThreadRoleMessage },
+    { "ff_io",          IJKSDLThreadRoleIO },
+};
+
+IJKSDLThreadRole IJKSDLThreadRoleForName(const char *name)
+{
+    if (!name)
+        return IJKSDLThreadRoleOther;
+    for (int i = 0; i < sizeof(g_role_names) / sizeof(g_role_names[0]); ++i) {
+        if (!strncmp(name, g_role_names[i].name, strlen(g_role_names[i].name)))
+            return g_role_names[i].role;
+    }
+    return IJKSDLThreadRoleOther;
+}
+
+const char *IJKSDLThreadRoleGetName(IJKSDLThreadRole role)
+{
+    switch (role) {
+        case IJKSDLThreadRoleIO:            return "io";
+        case IJKSDLThreadRoleDemux:         return "demux";
+        case IJKSDLThreadRoleVideoDecode:   return "video_decode";
+        case IJKSDLThreadRoleAudio:         return "audio";
+        case IJKSDLThreadRoleRender:        return "render";
+        case IJKSDLThreadRoleMessage:       return "message";
+        default:                            return "other";
+    }
+}
+
+static qos_class_t role_qos(IJKSDLThreadRole role)
+{
+    switch (role) {
+        case IJKSDLThreadRoleIO:            return QOS_CLASS_UTILITY;
+        case IJKSDLThreadRoleDemux:         return QOS_CLASS_USER_INITIATED;
+        case IJKSDLThreadRoleVideoDecode:   return QOS_CLASS_USER_INTERACTIVE;
+        case IJKSDLThreadRoleAudio:         return QOS_CLASS_USER_INTERACTIVE;
+        case IJKSDLThreadRoleRender:        return QOS_CLASS_USER_INTERACTIVE;
+        case IJKSDLThreadRoleMessage:       return QOS_CLASS_USER_INITIATED;
+        default:                            return QOS_CLASS_DEFAULT;
+    }
+}
+
+static int64_t thread_cpu_us(mach_port_t port)
+{
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t   count = THREAD_BASIC_INFO_COUNT;
+
+    if (thread_info(port, THREAD_BASIC_INFO, (thread_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return (int64_t)(info.user_time.seconds + info.system_time.seconds) * 1000000 +
+           info.user_time.microseconds + info.system_time.microseconds;
+}
+
+static void thread_group_retain(IJKSDLThreadGroup *group)
+{
+    if (group)
+        atomic_fetch_add(&group->ref_count, 1);
+}
+
+static void thread_group_release(IJKSDLThreadGroup *group)
+{
+    if (!group || atomic_fetch_sub(&group->ref_count, 1) != 1)
+        return;
+    pthread_mutex_destroy(&group->mutex);
+    free(group);
+}
 
 static void *SDL_RunThread(void *data)
 {
     @autoreleasepool {
-        SDL_Thread *thread = data;
+        IJKSDLThreadStart  start = *(IJKSDLThreadStart *)data;
+        SDL_Thread        *thread = start.thread;
+        IJKSDLThreadGroup *group  = start.group;
+        IJKSDLThreadEntry  entry  = { 0 };
+        free(data);
+
         pthread_setname_np(thread->name);
+        tls_thread_group = group;
+
+        entry.thread = pthread_self();
+        entry.port   = pthread_mach_thread_np(entry.thread);
+        entry.role   = start.role;
+        if (group) {
+            pthread_mutex_lock(&group->mutex);
+            entry.background = group->background;
+            entry.next       = group->threads;
+            group->threads   = &entry;
+            pthread_mutex_unlock(&group->mutex);
+        }
+        pthread_set_qos_class_self_np(entry.background ? QOS_CLASS_BACKGROUND : role_qos(entry.role), 0);
+
         thread->retval = thread->func(thread->data);
+
+        if (group) {
+            pthread_mutex_lock(&group->mutex);
+            for (IJKSDLThreadEntry **p = &group->threads; *p; p = &(*p)->next) {
+                if (*p == &entry) {
+                    *p = entry.next;
+                    break;
+                }
+            }
+            if (entry.override)
+                pthread_override_qos_class_end_np(entry.override);
+            group->exited_cpu_us[entry.role] += thread_cpu_us(entry.port);
+            pthread_mutex_unlock(&group->mutex);
+            thread_group_release(group);
+        }
         return NULL;
     }
 }
 
-SDL_Thread *SDL_CreateThreadEx(SDL_Thread *thread, int (*fn)(void *), void *data, const char *name)
+SDL_Thread *SDL_CreateThreadExWithRole(SDL_Thread *thread, int (*fn)(void *), void *data, const char *name,
+                                       IJKSDLThreadRole role)
 {
+    IJKSDLThreadStart *start = malloc(sizeof(IJKSDLThreadStart));
+    if (!start)
+        return NULL;
+
     thread->func = fn;
     thread->data = data;
     strlcpy(thread->name, name, sizeof(thread->name) - 1);
-    int retval = pthread_create(&thread->id, NULL, SDL_RunThread, thread);
-    if (retval)
+
+    start->thread = thread;
+    start->group  = tls_thread_group;
+    start->role   = role;
+    thread_group_retain(start->group);
+
+    int retval = pthread_create(&thread->id, NULL, SDL_RunThread, start);
+    if (retval) {
+        thread_group_release(start->group);
+        free(start);
         return NULL;
+    }
 
     return thread;
 }
+
+SDL_Thread *SDL_CreateThreadEx(SDL_Thread *thread, int (*fn)(void *), void *data, const char *name)
+{
+    return SDL_CreateThreadExWithRole(thread, fn, data, name, IJKSDLThreadRoleForName(name));
+}
+
+IJKSDLThreadGroup *IJKSDLThreadGroup_create(void)
+{
+    IJKSDLThreadGroup *group = calloc(1, sizeof(IJKSDLThreadGroup));
+    if (!group)
+        return NULL;
+
+    atomic_init(&group->ref_count, 1);
+    pthread_mutex_init(&group->mutex, NULL);
+    return group;
+}
+
+void IJKSDLThreadGroup_releasep(IJKSDLThreadGroup **group)
+{
+    if (!group || !*group)
+        return;
+
+    thread_group_release(*group);
+    *group = NULL;
+}
+
+void IJKSDLThreadGroup_enter(IJKSDLThreadGroup *group)
+{
+    tls_thread_group = group;
+}
+
+void IJKSDLThreadGroup_setBackground(IJKSDLThreadGroup *group, bool background)
+{
+    if (!group)
+        return;
+
+    pthread_mutex_lock(&group->mutex);
+    group->background = background;
+    for (IJKSDLThreadEntry *entry = group->threads; entry; entry = entry->next) {
+        if (!entry->background)
+            continue;
+        if (!background && !entry->override) {
+            entry->override = pthread_override_qos_class_start_np(entry->thread, role_qos(entry->role), 0);
+        } else if (background && entry->override) {
+            pthread_override_qos_class_end_np(entry->override);
+            entry->override = NULL;
+        }
+    }
+    pthread_mutex_unlock(&group->mutex);
+}
+
+void IJKSDLThreadGroup_getCPUTime(IJKSDLThreadGroup *group, int64_t cpu_us[IJKSDLThreadRoleCount])
+{
+    memset(cpu_us, 0, sizeof(int64_t) * IJKSDLThreadRoleCount);
+    if (!group)
+        return;
+
+    pthread_mutex_lock(&group->mutex);
+    memcpy(cpu_us, group->exited_cpu_us, sizeof(int64_t) * IJKSDLThreadRoleCount);
+    for (IJKSDLThreadEntry *entry = group->threads; entry; entry = entry->next)
+        cpu_us[entry->role] += thread_cpu_us(entry->port);
+    pthread_mutex_unlock(&group->mutex);
+}
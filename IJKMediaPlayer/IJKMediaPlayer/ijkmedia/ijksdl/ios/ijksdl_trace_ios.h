@@ -0,0 +1,71 @@
+/*
+ * ijksdl_trace_ios.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef IJKSDL_TRACE_IOS_H
+#define IJKSDL_TRACE_IOS_H
+
+#include <stdbool.h>
+
+// os_signpost intervals of the playback pipeline, subsystem
+// "tv.danmaku.ijk.media", category "PlaybackPipeline"; nothing before iOS 12.
+//
+// An interval is named by its stage and identified by obj, which must be the
+// same pointer at begin and end and unique among the intervals of the stage
+// open at a time. Every interval tells the player it belongs to, so that
+// Instruments can filter the critical path of one player.
+//
+// The calls cost a load and a branch while Instruments is not recording.
+
+// stage, name shown in Instruments
+#define IJK_TRACE_STAGES(X) \
+    X(IJK_TRACE_FIRST_FRAME,        "First Frame")      \
+    X(IJK_TRACE_PREPARE,            "Prepare")          \
+    X(IJK_TRACE_DNS,                "DNS")              \
+    X(IJK_TRACE_TCP_CONNECT,        "TCP Connect")      \
+    X(IJK_TRACE_TLS_HANDSHAKE,      "TLS Handshake")    \
+    X(IJK_TRACE_HTTP_OPEN,          "HTTP Open")        \
+    X(IJK_TRACE_HTTP_SEEK,          "HTTP Seek")        \
+    X(IJK_TRACE_OPEN_INPUT,         "Open Input")       \
+    X(IJK_TRACE_PROBE,              "Probe")            \
+    X(IJK_TRACE_OPEN_COMPONENTS,    "Open Components")  \
+    X(IJK_TRACE_FIRST_PACKET,       "First Packet")     \
+    X(IJK_TRACE_VTB_SESSION_CREATE, "VT Session Create")\
+    X(IJK_TRACE_VTB_DECODE,         "VT Decode")        \
+    X(IJK_TRACE_FIRST_DECODE,       "First Decode")     \
+    X(IJK_TRACE_FIRST_PRESENT,      "First Present")
+
+#define IJK_TRACE_STAGE_ENUM(stage, name) stage,
+typedef enum IJKTraceStage {
+    IJK_TRACE_STAGES(IJK_TRACE_STAGE_ENUM)
+} IJKTraceStage;
+#undef IJK_TRACE_STAGE_ENUM
+
+// true while the pipeline log is being recorded, to skip preparing details
+bool ijk_trace_enabled(void);
+
+// detail may be NULL, error is 0 on success
+void ijk_trace_begin(IJKTraceStage stage, const void *obj, const void *player, const char *detail);
+void ijk_trace_end(IJKTraceStage stage, const void *obj, const void *player, int error);
+void ijk_trace_event(IJKTraceStage stage, const void *player, const char *detail);
+
+#endif
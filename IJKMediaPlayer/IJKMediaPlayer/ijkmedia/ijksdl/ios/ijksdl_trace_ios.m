@@ -0,0 +1,102 @@
+/*
+ * ijksdl_trace_ios.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "ijksdl_trace_ios.h"
+
+#import <Foundation/Foundation.h>
+#include <os/log.h>
+#include <os/signpost.h>
+
+// signpost names must be literals, hence a case per stage
+#define IJK_TRACE_BEGIN_CASE(stage, name) \
+    case stage: os_signpost_interval_begin(log, sid, name, "player=%p %{public}s", player, detail); break;
+#define IJK_TRACE_END_CASE(stage, name) \
+    case stage: os_signpost_interval_end(log, sid, name, "player=%p error=%d", player, error); break;
+#define IJK_TRACE_EVENT_CASE(stage, name) \
+    case stage: os_signpost_event_emit(log, sid, name, "player=%p %{public}s", player, detail); break;
+
+static os_log_t g_trace_log;
+
+// NULL before iOS 12
+static os_log_t trace_log(void)
+{
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        if (@available(iOS 12.0, *))
+            g_trace_log = os_log_create("tv.danmaku.ijk.media", "PlaybackPipeline");
+    });
+    return g_trace_log;
+}
+
+bool ijk_trace_enabled(void)
+{
+    os_log_t log = trace_log();
+    if (!log)
+        return false;
+    if (@available(iOS 12.0, *))
+        return os_signpost_enabled(log);
+    return false;
+}
+
+void ijk_trace_begin(IJKTraceStage stage, const void *obj, const void *player, const char *detail)
+{
+    if (!ijk_trace_enabled())
+        return;
+    if (@available(iOS 12.0, *)) {
+        os_log_t          log = g_trace_log;
+        os_signpost_id_t  sid = obj ? os_signpost_id_make_with_pointer(log, obj) : OS_SIGNPOST_ID_EXCLUSIVE;
+        if (!detail)
+            detail = "";
+        switch (stage) {
+            IJK_TRACE_STAGES(IJK_TRACE_BEGIN_CASE)
+        }
+    }
+}
+
+void ijk_trace_end(IJKTraceStage stage, const void *obj, const void *player, int error)
+{
+    if (!ijk_trace_enabled())
+        return;
+    if (@available(iOS 12.0, *)) {
+        os_log_t          log = g_trace_log;
+        os_signpost_id_t  sid = obj ? os_signpost_id_make_with_pointer(log, obj) : OS_SIGNPOST_ID_EXCLUSIVE;
+        switch (stage) {
+            IJK_TRACE_STAGES(IJK_TRACE_END_CASE)
+        }
+    }
+}
+
+void ijk_trace_event(IJKTraceStage stage, const void *player, const char *detail)
+{
+    if (!ijk_trace_enabled())
+        return;
+    if (@available(iOS 12.0, *)) {
+        os_log_t          log = g_trace_log;
+        os_signpost_id_t  sid = player ? os_signpost_id_make_with_pointer(log, player) : OS_SIGNPOST_ID_EXCLUSIVE;
+        if (!detail)
+            detail = "";
+        switch (stage) {
+            IJK_TRACE_STAGES(IJK_TRACE_EVENT_CASE)
+        }
+    }
+}
@@ -28,6 +28,7 @@
 #include "ijksdl/ijksdl_vout_internal.h"
 #include "ijksdl/ffmpeg/ijksdl_vout_overlay_ffmpeg.h"
 #include "ijksdl_vout_overlay_videotoolbox.h"
+#include "ijksdl_vout_ios_outputs.h"
 #import "IJKSDLGLView.h"
 
 typedef struct SDL_VoutSurface_Opaque {
@@ -35,15 +36,20 @@ typedef struct SDL_VoutSurface_Opaque {
 } SDL_VoutSurface_Opaque;
 
 struct SDL_Vout_Opaque {
+    SDL_VoutIos_Outputs outputs;    // first, see ijksdl_vout_ios_outputs.h
     IJKSDLGLView *gl_view;
 };
 
 static SDL_VoutOverlay *vout_create_overlay_l(int width, int height, int frame_format, SDL_Vout *vout)
 {
+    SDL_Vout_Opaque *opaque = vout->opaque;
     switch (frame_format) {
         case IJK_AV_PIX_FMT__VIDEO_TOOLBOX:
             return SDL_VoutVideoToolBox_CreateOverlay(width, height, vout);
         default:
+            if (SDL_VoutVideoToolBox_IsPixelBufferFormat(frame_format) &&
+                (opaque->gl_view.prefersPixelBufferOverlays || SDL_VoutIos_HasOutputs_l(vout)))
+                return SDL_VoutVideoToolBox_CreateOverlay(width, height, vout);
             return SDL_VoutFFmpeg_CreateOverlay(width, height, frame_format, vout);
     }
 }
@@ -68,6 +74,7 @@ static void vout_free_l(SDL_Vout *vout)
             [opaque->gl_view release];
             opaque->gl_view = nil;
         }
+        SDL_VoutIos_FreeOutputs_l(vout);
     }
 
     SDL_Vout_FreeInternal(vout);
@@ -94,6 +101,7 @@ static int vout_display_overlay_l(SDL_Vout *vout, SDL_VoutOverlay *overlay)
     }
 
     [gl_view display:overlay];
+    SDL_VoutIos_DisplayOutputs_l(vout, overlay);
     return 0;
 }
 
@@ -1,8 +1,8 @@
-/*****************************************************************************
- * IJKVideoToolBox.h
- *****************************************************************************
+/*
+ * ijksdl_vout_ios_metal.h
  *
- * copyright (c) 2014 Zhou Quan <zhouqicy@gmail.com>
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
  *
  * This file is part of ijkPlayer.
  *
@@ -21,17 +21,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#ifndef IJKMediaPlayer_videotoolbox_async_h
-#define IJKMediaPlayer_videotoolbox_async_h
+#include "ijksdl/ijksdl_stdinc.h"
+#include "ijksdl/ijksdl_vout.h"
 
-#include "ff_ffplay.h"
+@class IJKSDLMetalView;
 
-typedef struct Ijk_VideoToolBox_Opaque Ijk_VideoToolBox_Opaque;
-
-Ijk_VideoToolBox_Opaque* videotoolbox_async_create(FFPlayer* ffp, AVCodecContext* ic);
-
-int videotoolbox_async_decode_frame(Ijk_VideoToolBox_Opaque* opaque);
-
-void videotoolbox_async_free(Ijk_VideoToolBox_Opaque* opaque);
-
-#endif
+SDL_Vout *SDL_VoutIos_CreateForMetal();
+void SDL_VoutIos_SetMetalView(SDL_Vout *vout, IJKSDLMetalView *view);
@@ -0,0 +1,154 @@
+/*
+ * ijksdl_vout_ios_metal.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "ijksdl_vout_ios_metal.h"
+
+#include <assert.h>
+#include "ijksdl/ijksdl_vout.h"
+#include "ijksdl/ijksdl_vout_internal.h"
+#include "ijksdl/ffmpeg/ijksdl_vout_overlay_ffmpeg.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#include "ijksdl_vout_ios_outputs.h"
+#import "IJKSDLMetalView.h"
+
+typedef struct SDL_VoutSurface_Opaque {
+    SDL_Vout *vout;
+} SDL_VoutSurface_Opaque;
+
+struct SDL_Vout_Opaque {
+    SDL_VoutIos_Outputs outputs;    // first, see ijksdl_vout_ios_outputs.h
+    IJKSDLMetalView *metal_view;
+};
+
+static SDL_VoutOverlay *vout_create_overlay_l(int width, int height, int frame_format, SDL_Vout *vout)
+{
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    switch (frame_format) {
+        case IJK_AV_PIX_FMT__VIDEO_TOOLBOX:
+            return SDL_VoutVideoToolBox_CreateOverlay(width, height, vout);
+        default:
+            if (SDL_VoutVideoToolBox_IsPixelBufferFormat(frame_format) &&
+                (opaque->metal_view.prefersPixelBufferOverlays || SDL_VoutIos_HasOutputs_l(vout)))
+                return SDL_VoutVideoToolBox_CreateOverlay(width, height, vout);
+            return SDL_VoutFFmpeg_CreateOverlay(width, height, frame_format, vout);
+    }
+}
+
+static SDL_VoutOverlay *vout_create_overlay(int width, int height, int frame_format, SDL_Vout *vout)
+{
+    SDL_LockMutex(vout->mutex);
+    SDL_VoutOverlay *overlay = vout_create_overlay_l(width, height, frame_format, vout);
+    SDL_UnlockMutex(vout->mutex);
+    return overlay;
+}
+
+static void vout_free_l(SDL_Vout *vout)
+{
+    if (!vout)
+        return;
+
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    if (opaque) {
+        if (opaque->metal_view) {
+            // TODO: post to MainThread?
+            [opaque->metal_view release];
+            opaque->metal_view = nil;
+        }
+        SDL_VoutIos_FreeOutputs_l(vout);
+    }
+
+    SDL_Vout_FreeInternal(vout);
+}
+
+static int vout_display_overlay_l(SDL_Vout *vout, SDL_VoutOverlay *overlay)
+{
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    IJKSDLMetalView *metal_view = opaque->metal_view;
+
+    if (!metal_view) {
+        ALOGE("vout_display_overlay_l: NULL metal_view\n");
+        return -1;
+    }
+
+    if (!overlay) {
+        ALOGE("vout_display_overlay_l: NULL overlay\n");
+        return -1;
+    }
+
+    if (overlay->w <= 0 || overlay->h <= 0) {
+        ALOGE("vout_display_overlay_l: invalid overlay dimensions(%d, %d)\n", overlay->w, overlay->h);
+        return -1;
+    }
+
+    [metal_view display:overlay];
+    SDL_VoutIos_DisplayOutputs_l(vout, overlay);
+    return 0;
+}
+
+static int vout_display_overlay(SDL_Vout *vout, SDL_VoutOverlay *overlay)
+{
+    @autoreleasepool {
+        SDL_LockMutex(vout->mutex);
+        int retval = vout_display_overlay_l(vout, overlay);
+        SDL_UnlockMutex(vout->mutex);
+        return retval;
+    }
+}
+
+SDL_Vout *SDL_VoutIos_CreateForMetal()
+{
+    SDL_Vout *vout = SDL_Vout_CreateInternal(sizeof(SDL_Vout_Opaque));
+    if (!vout)
+        return NULL;
+
+    SDL_Vout_Opaque *opaque = vout->opaque;
+    opaque->metal_view = nil;
+    vout->create_overlay = vout_create_overlay;
+    vout->free_l = vout_free_l;
+    vout->display_overlay = vout_display_overlay;
+
+    return vout;
+}
+
+static void SDL_VoutIos_SetMetalView_l(SDL_Vout *vout, IJKSDLMetalView *view)
+{
+    SDL_Vout_Opaque *opaque = vout->opaque;
+
+    if (opaque->metal_view == view)
+        return;
+
+    if (opaque->metal_view) {
+        [opaque->metal_view release];
+        opaque->metal_view = nil;
+    }
+
+    if (view)
+        opaque->metal_view = [view retain];
+}
+
+void SDL_VoutIos_SetMetalView(SDL_Vout *vout, IJKSDLMetalView *view)
+{
+    SDL_LockMutex(vout->mutex);
+    SDL_VoutIos_SetMetalView_l(vout, view);
+    SDL_UnlockMutex(vout->mutex);
+}
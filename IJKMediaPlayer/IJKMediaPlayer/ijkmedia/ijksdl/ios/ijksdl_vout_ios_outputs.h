@@ -0,0 +1,52 @@
+/*
+ * ijksdl_vout_ios_outputs.h
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __IJKMediaPlayer__ijksdl_vout_ios_outputs__
+#define __IJKMediaPlayer__ijksdl_vout_ios_outputs__
+
+#include "ijksdl/ijksdl_stdinc.h"
+#include "ijksdl/ijksdl_vout.h"
+
+@class NSArray;
+
+// The render views a vout displays its overlays in besides its own, e.g.
+// an external screen or a mini player, fed by the one decoder. Only
+// VideoToolbox overlays are displayed in them: their pixel buffer is
+// shared, retained by each view, which renders it at its own size and
+// paces it at its own rate. While there are outputs the vouts create
+// VideoToolbox overlays for software 4:2:0 frames too.
+//
+// The opaque of every iOS vout begins with it.
+typedef struct SDL_VoutIos_Outputs {
+    NSArray *views;     // of UIView<IJKSDLRenderView>, nil for none
+} SDL_VoutIos_Outputs;
+
+// views are retained, nil or empty for none
+void SDL_VoutIos_SetOutputs(SDL_Vout *vout, NSArray *views);
+
+// under vout->mutex
+bool SDL_VoutIos_HasOutputs_l(SDL_Vout *vout);
+void SDL_VoutIos_DisplayOutputs_l(SDL_Vout *vout, SDL_VoutOverlay *overlay);
+void SDL_VoutIos_FreeOutputs_l(SDL_Vout *vout);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * ijksdl_vout_ios_outputs.m
+ *
+ * Copyright (c) 2013 Bilibili
+ * Copyright (c) 2013 Zhang Rui <bbcallen@gmail.com>
+ *
+ * This file is part of ijkPlayer.
+ *
+ * ijkPlayer is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * ijkPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with ijkPlayer; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#import "ijksdl_vout_ios_outputs.h"
+
+#include "ijksdl/ijksdl_vout_internal.h"
+#include "ijksdl_vout_overlay_videotoolbox.h"
+#import "IJKSDLRenderView.h"
+
+static SDL_VoutIos_Outputs *outputs_of(SDL_Vout *vout)
+{
+    return (SDL_VoutIos_Outputs *)vout->opaque;
+}
+
+void SDL_VoutIos_SetOutputs(SDL_Vout *vout, NSArray *views)
+{
+    if (!vout)
+        return;
+
+    NSArray *copied = views.count > 0 ? [views copy] : nil;
+
+    SDL_LockMutex(vout->mutex);
+    SDL_VoutIos_Outputs *outputs = outputs_of(vout);
+    NSArray *former = outputs->views;
+    outputs->views = copied;
+    SDL_UnlockMutex(vout->mutex);
+
+    // TODO: post to MainThread?
+    [former release];
+}
+
+bool SDL_VoutIos_HasOutputs_l(SDL_Vout *vout)
+{
+    return outputs_of(vout)->views.count > 0;
+}
+
+void SDL_VoutIos_DisplayOutputs_l(SDL_Vout *vout, SDL_VoutOverlay *overlay)
+{
+    NSArray *views = outputs_of(vout)->views;
+    if (!views || !overlay || overlay->format != SDL_FCC__VTB)
+        return;
+    if (!SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(overlay))
+        return;
+
+    for (UIView<IJKSDLRenderView> *view in views)
+        [view display:overlay];
+}
+
+void SDL_VoutIos_FreeOutputs_l(SDL_Vout *vout)
+{
+    SDL_VoutIos_Outputs *outputs = outputs_of(vout);
+    [outputs->views release];
+    outputs->views = nil;
+}
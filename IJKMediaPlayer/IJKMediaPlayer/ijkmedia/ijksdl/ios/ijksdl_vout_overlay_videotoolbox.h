@@ -29,7 +29,17 @@
 #include "ijksdl_vout.h"
 #include "ijksdl_inc_ffmpeg.h"
 
+// CFNumber, seconds from the start of the media, on the pixel buffers the
+// VideoToolbox decoder queues
+#define IJK_VTB_ATTACHMENT_PTS CFSTR("IJKPresentationTime")
+
 SDL_VoutOverlay *SDL_VoutVideoToolBox_CreateOverlay(int width, int height, SDL_Vout *vout);
+// software frames of this format can be filled into a VideoToolbox overlay:
+// they are copied into an IOSurface backed pixel buffer on the decoder
+// thread, and rendered from it like decoder output, without an upload
+bool SDL_VoutVideoToolBox_IsPixelBufferFormat(int frame_format);
 CVPixelBufferRef SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(SDL_VoutOverlay *overlay);
+// IJK_VTB_ATTACHMENT_PTS of the pixel buffer, NAN without
+double SDL_VoutOverlayVideoToolBox_GetPresentationTime(CVPixelBufferRef pixel_buffer);
 
 #endif
@@ -24,6 +24,9 @@
 #include "ijksdl_vout_overlay_videotoolbox.h"
 
 #include <assert.h>
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include "ijksdl_stdinc.h"
 #include "ijksdl_mutex.h"
 #include "ijksdl_vout_internal.h"
@@ -35,6 +38,12 @@ struct SDL_VoutOverlay_Opaque {
     CVPixelBufferRef pixel_buffer;
     Uint16 pitches[AV_NUM_DATA_POINTERS];
     Uint8 *pixels[AV_NUM_DATA_POINTERS];
+
+    // software frames
+    CVPixelBufferPoolRef pool;
+    int                  pool_width;
+    int                  pool_height;
+    OSType               pool_format;
 };
 
 
@@ -46,6 +55,8 @@ static void func_free_l(SDL_VoutOverlay *overlay)
     if (!opaque)
         return;
     overlay->unref(overlay);
+    if (opaque->pool)
+        CVPixelBufferPoolRelease(opaque->pool);
     if (opaque->mutex)
         SDL_DestroyMutex(opaque->mutex);
 
@@ -83,12 +94,124 @@ static void func_unref(SDL_VoutOverlay *overlay)
     return;
 }
 
-static int func_fill_frame(SDL_VoutOverlay *overlay, const AVFrame *frame)
+bool SDL_VoutVideoToolBox_IsPixelBufferFormat(int frame_format)
+{
+    return frame_format == AV_PIX_FMT_YUV420P || frame_format == AV_PIX_FMT_YUVJ420P;
+}
+
+static void interleave_uv(uint8_t *dst, const uint8_t *src_u, const uint8_t *src_v, int width)
+{
+    int x = 0;
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vld1q_u8(src_u + x);
+        uv.val[1] = vld1q_u8(src_v + x);
+        vst2q_u8(dst + 2 * x, uv);
+    }
+#endif
+    for (; x < width; ++x) {
+        dst[2 * x]     = src_u[x];
+        dst[2 * x + 1] = src_v[x];
+    }
+}
+
+static CVPixelBufferRef copy_frame_to_pixel_buffer(SDL_VoutOverlay_Opaque *opaque, const AVFrame *frame)
 {
-    assert(frame->format == IJK_AV_PIX_FMT__VIDEO_TOOLBOX);
+    int    width  = frame->width;
+    int    height = frame->height;
+    OSType format = (frame->format == AV_PIX_FMT_YUVJ420P || frame->color_range == AVCOL_RANGE_JPEG) ?
+                    kCVPixelFormatType_420YpCbCr8BiPlanarFullRange :
+                    kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+
+    if (!opaque->pool || opaque->pool_width != width || opaque->pool_height != height || opaque->pool_format != format) {
+        if (opaque->pool) {
+            CVPixelBufferPoolRelease(opaque->pool);
+            opaque->pool = NULL;
+        }
+
+        CFMutableDictionaryRef attributes = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        CFDictionaryRef        surface    = CFDictionaryCreate(NULL, NULL, NULL, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        CFNumberRef            number;
+        number = CFNumberCreate(NULL, kCFNumberSInt32Type, &format);
+        CFDictionarySetValue(attributes, kCVPixelBufferPixelFormatTypeKey, number);
+        CFRelease(number);
+        number = CFNumberCreate(NULL, kCFNumberIntType, &width);
+        CFDictionarySetValue(attributes, kCVPixelBufferWidthKey, number);
+        CFRelease(number);
+        number = CFNumberCreate(NULL, kCFNumberIntType, &height);
+        CFDictionarySetValue(attributes, kCVPixelBufferHeightKey, number);
+        CFRelease(number);
+        CFDictionarySetValue(attributes, kCVPixelBufferIOSurfacePropertiesKey, surface);
+        CFDictionarySetValue(attributes, kCVPixelBufferOpenGLESCompatibilityKey, kCFBooleanTrue);
+        CFDictionarySetValue(attributes, kCVPixelBufferMetalCompatibilityKey, kCFBooleanTrue);
+
+        CVReturn err = CVPixelBufferPoolCreate(kCFAllocatorDefault, NULL, attributes, &opaque->pool);
+        CFRelease(surface);
+        CFRelease(attributes);
+        if (err != kCVReturnSuccess || !opaque->pool) {
+            ALOGE("%s: CVPixelBufferPoolCreate failed: %d\n", __func__, err);
+            opaque->pool = NULL;
+            return NULL;
+        }
+        opaque->pool_width  = width;
+        opaque->pool_height = height;
+        opaque->pool_format = format;
+    }
+
+    CVPixelBufferRef pixel_buffer = NULL;
+    if (CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, opaque->pool, &pixel_buffer) != kCVReturnSuccess)
+        return NULL;
 
-    CVBufferRef pixel_buffer = CVBufferRetain(frame->opaque);
+    CVPixelBufferLockBaseAddress(pixel_buffer, 0);
+
+    uint8_t *dst_y    = CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 0);
+    size_t   pitch_y  = CVPixelBufferGetBytesPerRowOfPlane(pixel_buffer, 0);
+    for (int y = 0; y < height; ++y)
+        memcpy(dst_y + y * pitch_y, frame->data[0] + y * frame->linesize[0], width);
+
+    uint8_t *dst_uv   = CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 1);
+    size_t   pitch_uv = CVPixelBufferGetBytesPerRowOfPlane(pixel_buffer, 1);
+    int      chroma_w = (width  + 1) / 2;
+    int      chroma_h = (height + 1) / 2;
+    for (int y = 0; y < chroma_h; ++y)
+        interleave_uv(dst_uv + y * pitch_uv,
+                      frame->data[1] + y * frame->linesize[1],
+                      frame->data[2] + y * frame->linesize[2],
+                      chroma_w);
+
+    CVPixelBufferUnlockBaseAddress(pixel_buffer, 0);
+
+    // the renderers take a missing matrix for BT.709
+    CFStringRef matrix = kCVImageBufferYCbCrMatrix_ITU_R_601_4;
+    if (frame->colorspace == AVCOL_SPC_BT709 || (frame->colorspace == AVCOL_SPC_UNSPECIFIED && height >= 720))
+        matrix = kCVImageBufferYCbCrMatrix_ITU_R_709_2;
+    CVBufferSetAttachment(pixel_buffer, kCVImageBufferYCbCrMatrixKey, matrix, kCVAttachmentMode_ShouldPropagate);
+    // as VideoToolbox tags its interlaced pictures, for the renderers to deinterlace
+    if (frame->interlaced_frame) {
+        int field_count = 2;
+        CFNumberRef fields = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &field_count);
+        CVBufferSetAttachment(pixel_buffer, kCVImageBufferFieldCountKey, fields, kCVAttachmentMode_ShouldPropagate);
+        CFRelease(fields);
+    } else {
+        CVBufferRemoveAttachment(pixel_buffer, kCVImageBufferFieldCountKey);
+    }
+    return pixel_buffer;
+}
+
+static int func_fill_frame(SDL_VoutOverlay *overlay, const AVFrame *frame)
+{
     SDL_VoutOverlay_Opaque *opaque = overlay->opaque;
+    CVBufferRef pixel_buffer = NULL;
+    if (frame->format == IJK_AV_PIX_FMT__VIDEO_TOOLBOX) {
+        pixel_buffer = CVBufferRetain(frame->opaque);
+    } else {
+        assert(SDL_VoutVideoToolBox_IsPixelBufferFormat(frame->format));
+        pixel_buffer = copy_frame_to_pixel_buffer(opaque, frame);
+        if (!pixel_buffer)
+            return -1;
+    }
+
     if (opaque->pixel_buffer != NULL) {
         CVBufferRelease(opaque->pixel_buffer);
     }
@@ -97,24 +220,12 @@ static int func_fill_frame(SDL_VoutOverlay *overlay, const AVFrame *frame)
     overlay->planes = 2;
 
 #if 1
-    if (CVPixelBufferLockBaseAddress(pixel_buffer, 0) != kCVReturnSuccess) {
-        overlay->pixels[0]  = NULL;
-        overlay->pixels[1]  = NULL;
-        overlay->pitches[0] = 0;
-        overlay->pitches[1] = 0;
-        overlay->w = 0;
-        overlay->h = 0;
-        CVBufferRelease(pixel_buffer);
-        opaque->pixel_buffer = NULL;
-        return -1;
-    }
-    // overlay->pixels[0]  = CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 0);
-    // overlay->pixels[1]  = CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 1);
+    // planes are sampled by the GPU through the texture cache,
+    // locking the base address here would only map them into CPU memory
     overlay->pixels[0]  = NULL;
     overlay->pixels[1]  = NULL;
     overlay->pitches[0] = CVPixelBufferGetWidthOfPlane(pixel_buffer, 0);
     overlay->pitches[1] = CVPixelBufferGetWidthOfPlane(pixel_buffer, 1);
-    CVPixelBufferUnlockBaseAddress(pixel_buffer, 0);
 #else
     overlay->pixels[0]  = NULL;
     overlay->pixels[1]  = NULL;
@@ -156,6 +267,16 @@ CVPixelBufferRef SDL_VoutOverlayVideoToolBox_GetCVPixelBufferRef(SDL_VoutOverlay
     return opaque->pixel_buffer;
 }
 
+double SDL_VoutOverlayVideoToolBox_GetPresentationTime(CVPixelBufferRef pixel_buffer)
+{
+    double    pts = NAN;
+    CFTypeRef number = pixel_buffer ? CVBufferGetAttachment(pixel_buffer, IJK_VTB_ATTACHMENT_PTS, NULL) : NULL;
+
+    if (number && CFGetTypeID(number) == CFNumberGetTypeID())
+        CFNumberGetValue(number, kCFNumberDoubleType, &pts);
+    return pts;
+}
+
 SDL_VoutOverlay *SDL_VoutVideoToolBox_CreateOverlay(int width, int height, SDL_Vout *display)
 {
     SDLTRACE("SDL_VoutVideoToolBox_CreateOverlay(w=%d, h=%d, fmt=_VTB, dp=%p)\n",
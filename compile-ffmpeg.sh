@@ -60,12 +60,14 @@ do_lipo_ffmpeg () {
 }
 
 SSL_LIBS="libcrypto libssl"
-do_lipo_ssl () {
-    LIB_FILE=$1
+DAV1D_LIBS="libdav1d"
+do_lipo_dep () {
+    DEP_NAME=$1
+    LIB_FILE=$2
     LIPO_FLAGS=
     for ARCH in $FF_ALL_ARCHS
     do
-        ARCH_LIB_FILE="$UNI_BUILD_ROOT/build/openssl-$ARCH/output/lib/$LIB_FILE"
+        ARCH_LIB_FILE="$UNI_BUILD_ROOT/build/$DEP_NAME-$ARCH/output/lib/$LIB_FILE"
         if [ -f "$ARCH_LIB_FILE" ]; then
             LIPO_FLAGS="$LIPO_FLAGS $ARCH_LIB_FILE"
         else
@@ -87,6 +89,11 @@ do_lipo_all () {
         do_lipo_ffmpeg "$FF_LIB.a";
     done
 
+    # arm64 only, see tools/do-compile-ffmpeg.sh
+    if [ -f "$UNI_BUILD_ROOT/build/ffmpeg-arm64/output/lib/libcheckasm.a" ]; then
+        do_lipo_ffmpeg "libcheckasm.a";
+    fi
+
     ANY_ARCH=
     for ARCH in $FF_ALL_ARCHS
     do
@@ -112,7 +119,13 @@ do_lipo_all () {
 
     for SSL_LIB in $SSL_LIBS
     do
-        do_lipo_ssl "$SSL_LIB.a";
+        do_lipo_dep openssl "$SSL_LIB.a";
+    done
+
+    # linked by the apps when libavcodec was built with it
+    for DAV1D_LIB in $DAV1D_LIBS
+    do
+        do_lipo_dep dav1d "$DAV1D_LIB.a";
     done
 }
 
@@ -1684,6 +1684,12 @@ typedef struct AVPacket {
  * after decoding.
  **/
 #define AV_PKT_FLAG_DISCARD   0x0004
+/**
+ * The demuxer vouches for AV_PKT_FLAG_KEY of the packet: it is set on the
+ * IDR (IRAP) pictures and only on them, so decoders need not look for them
+ * in the data. See AVFMT_FLAG_TRUST_KEYFRAMES.
+ */
+#define AV_PKT_FLAG_KEY_EXACT 0x0100
 #define AV_PKT_FLAG_NEW_SEG 0x8000 ///< The packet is the first packet from a source in concat
 
 enum AVSideDataParamChangeFlags {
@@ -3635,6 +3641,15 @@ typedef struct AVCodecContext {
      *             AVCodecContext.get_format callback)
      */
     int hwaccel_flags;
+
+    /**
+     * Run the slice threads on the pool shared by the process instead of
+     * threads of this context, for the slice pool client given, see
+     * slice_pool.h. 0 for threads of its own.
+     * - encoding: unused
+     * - decoding: Set by user before avcodec_open2().
+     */
+    int thread_pool;
 } AVCodecContext;
 
 AVRational av_codec_get_pkt_timebase         (const AVCodecContext *avctx);
@@ -4241,6 +4256,18 @@ void avcodec_register(AVCodec *codec);
  */
 void avcodec_register_all(void);
 
+/**
+ * Make avcodec_register_all() register only the encoders and decoders named
+ * in a comma separated list, along with every parser and hwaccel. The others
+ * are registered the first time a codec lookup misses, so a start that only
+ * needs the listed ones skips most of the registration.
+ *
+ * Must be called before avcodec_register_all(), has no effect after.
+ *
+ * @param names the codec names, NULL or "" to register all of them again
+ */
+void avcodec_register_allow_list(const char *names);
+
 /**
  * Allocate an AVCodecContext and set its fields to default values. The
  * resulting struct should be freed with avcodec_free_context().
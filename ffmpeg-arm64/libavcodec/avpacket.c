@@ -29,6 +29,7 @@
 #include "avcodec.h"
 #include "bytestream.h"
 #include "internal.h"
+#include "packet_pool.h"
 
 void av_init_packet(AVPacket *pkt)
 {
@@ -74,9 +75,15 @@ static int packet_alloc(AVBufferRef **buf, int size)
     if (size < 0 || size >= INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
         return AVERROR(EINVAL);
 
-    ret = av_buffer_realloc(buf, size + AV_INPUT_BUFFER_PADDING_SIZE);
-    if (ret < 0)
-        return ret;
+    if (!*buf) {
+        *buf = ff_packet_pool_get(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!*buf)
+            return AVERROR(ENOMEM);
+    } else {
+        ret = av_buffer_realloc(buf, size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (ret < 0)
+            return ret;
+    }
 
     memset((*buf)->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 
@@ -136,7 +143,7 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
             pkt->data = pkt->buf->data + data_offset;
         }
     } else {
-        pkt->buf = av_buffer_alloc(new_size);
+        pkt->buf = ff_packet_pool_get(new_size);
         if (!pkt->buf)
             return AVERROR(ENOMEM);
         if (pkt->size > 0)
@@ -170,7 +177,7 @@ FF_DISABLE_DEPRECATION_WARNINGS
 #define ALLOC_MALLOC(data, size) data = av_malloc(size)
 #define ALLOC_BUF(data, size)                \
 do {                                         \
-    av_buffer_realloc(&pkt->buf, size);      \
+    pkt->buf = ff_packet_pool_get(size);     \
     data = pkt->buf ? pkt->buf->data : NULL; \
 } while (0)
 
@@ -58,6 +58,12 @@
  * skipped due to the skip_frame setting.
  */
 #define FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM  (1 << 3)
+/**
+ * The decoder wraps a platform decoder that may be unavailable at run time.
+ * If its init function fails, avcodec_open2() opens the next registered
+ * decoder of the same codec id instead.
+ */
+#define FF_CODEC_CAP_INIT_FALLBACK          (1 << 4)
 
 #ifdef TRACE
 #   define ff_tlog(ctx, ...) av_log(ctx, AV_LOG_TRACE, __VA_ARGS__)
@@ -185,6 +191,13 @@ struct AVCodecDefault {
 
 extern const uint8_t ff_log2_run[41];
 
+/**
+ * Register the codecs avcodec_register_allow_list() left out, once.
+ *
+ * @return 1 if some may have been registered since the caller looked
+ */
+int ff_codec_register_rest(void);
+
 /**
  * Return the index into tab at which {a,b} match elements {[0],[1]} of tab.
  * If there is no such matching pair then size is returned.
@@ -0,0 +1,110 @@
+/*
+ * Process wide pools of packet payloads
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "packet_pool.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+
+// 1K, 4K, 16K, 64K, 256K, 1M: audio frames, p frames, i frames, then 4K i frames
+#define PACKET_POOL_CLASSES    6
+#define PACKET_POOL_MIN_SHIFT  10
+
+static pthread_mutex_t packet_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AVBufferPool   *packet_pools[PACKET_POOL_CLASSES];
+static AVPacketPoolStatistic packet_pool_stat;
+
+// called by av_buffer_pool_get() with packet_pool_mutex held
+static AVBufferRef *packet_pool_alloc(int size)
+{
+    packet_pool_stat.misses++;
+    return av_buffer_alloc(size);
+}
+
+AVBufferRef *ff_packet_pool_get(int size)
+{
+    AVBufferRef *buf = NULL;
+    int i;
+
+    for (i = 0; i < PACKET_POOL_CLASSES; i++) {
+        if (size <= 1 << (PACKET_POOL_MIN_SHIFT + 2 * i))
+            break;
+    }
+    if (i == PACKET_POOL_CLASSES) {
+        pthread_mutex_lock(&packet_pool_mutex);
+        packet_pool_stat.oversized++;
+        pthread_mutex_unlock(&packet_pool_mutex);
+        return av_buffer_alloc(size);
+    }
+
+    pthread_mutex_lock(&packet_pool_mutex);
+    if (!packet_pools[i])
+        packet_pools[i] = av_buffer_pool_init(1 << (PACKET_POOL_MIN_SHIFT + 2 * i), packet_pool_alloc);
+    if (packet_pools[i]) {
+        int64_t misses = packet_pool_stat.misses;
+        buf = av_buffer_pool_get(packet_pools[i]);
+        if (buf && misses == packet_pool_stat.misses)
+            packet_pool_stat.hits++;
+    }
+    pthread_mutex_unlock(&packet_pool_mutex);
+
+    return buf;
+}
+
+void av_packet_pool_get_statistic(AVPacketPoolStatistic *stat)
+{
+    pthread_mutex_lock(&packet_pool_mutex);
+    *stat = packet_pool_stat;
+    pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+void av_packet_pool_trim(void)
+{
+    int i;
+
+    pthread_mutex_lock(&packet_pool_mutex);
+    for (i = 0; i < PACKET_POOL_CLASSES; i++)
+        av_buffer_pool_uninit(&packet_pools[i]);
+    pthread_mutex_unlock(&packet_pool_mutex);
+}
+
+#else
+
+AVBufferRef *ff_packet_pool_get(int size)
+{
+    return av_buffer_alloc(size);
+}
+
+void av_packet_pool_get_statistic(AVPacketPoolStatistic *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+}
+
+void av_packet_pool_trim(void)
+{
+}
+
+#endif
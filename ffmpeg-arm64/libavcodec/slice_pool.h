@@ -0,0 +1,72 @@
+/*
+ * Process wide pool of slice threads
+ *
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_SLICE_POOL_H
+#define AVCODEC_SLICE_POOL_H
+
+#include "avcodec.h"
+
+/**
+ * The slice threads of the contexts setting AVCodecContext.thread_pool
+ * run on one pool shared by the whole process, a thread per core, instead
+ * of thread_count threads each. An execute() queues thread_count - 1
+ * runners on the pool and runs jobs itself meanwhile; the runners take
+ * the jobs in order until none is left, so a job waiting on an earlier
+ * one, as the HEVC wavefront does, waits on a job running. The runners
+ * not taken by then are withdrawn.
+ *
+ * Each pool thread takes the runners queued to it newest first and steals
+ * the oldest of the others when out of them. The runners of a background
+ * client are only taken when no foreground one is queued anywhere.
+ */
+
+enum AVSlicePoolPriority {
+    AV_SLICE_POOL_FOREGROUND,
+    AV_SLICE_POOL_BACKGROUND,
+};
+
+/**
+ * A client, the value of AVCodecContext.thread_pool for the contexts of a
+ * player; its priority can change while they decode.
+ *
+ * @return the client, 0 if none is left
+ */
+int av_slice_pool_client_open(void);
+void av_slice_pool_client_set_priority(int client, enum AVSlicePoolPriority priority);
+void av_slice_pool_client_close(int client);
+
+/**
+ * @return the threads of the pool, 0 if there is no pool: threads or cores
+ *         missing
+ */
+int ff_slice_pool_size(void);
+
+typedef int (ff_slice_pool_func)(AVCodecContext *c, void *arg);
+typedef int (ff_slice_pool_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
+
+/**
+ * AVCodecContext.execute() and execute2() on the pool, func2 if func is
+ * NULL; threadnr is below avctx->thread_count.
+ */
+int ff_slice_pool_execute(AVCodecContext *avctx, ff_slice_pool_func *func, ff_slice_pool_func2 *func2,
+                          void *arg, int *ret, int job_count, int job_size);
+
+#endif /* AVCODEC_SLICE_POOL_H */
@@ -27,32 +27,109 @@
  *      support work with concatdec, hls
  */
 
+#include "libavutil/application.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "io_reactor.h"
+#include "os_support.h"
+#include "throughput.h"
 #include "url.h"
+#include <fcntl.h>
 #include <stdint.h>
 
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_POLL_H
+#include <poll.h>
+#endif
+#if HAVE_MMAP && HAVE_MKSTEMP
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#define ASYNC_HAVE_BUFFER_FILE 1
+#else
+#define ASYNC_HAVE_BUFFER_FILE 0
+#endif
 
 #define BUFFER_CAPACITY         (4 * 1024 * 1024)
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
+#define SHORT_SEEK_THRESHOLD_MIN (64 * 1024)
+#define SHORT_SEEK_THRESHOLD_MAX (4 * 1024 * 1024)
+#define READ_AHEAD_MIN          (512 * 1024)
+#define READ_SPEED_INTERVAL     (1000 * 1000)
+#define READ_AHEAD_INTERVAL     (1000 * 1000)
+#define IO_PACE_STEP            (50 * 1000)
+#define IO_PACE_BURST           (250 * 1000)
+#define IO_SUSPEND_INTERVAL     (200 * 1000)
+#define READ_WAIT_MAX           (1000 * 1000)
+#define READ_CHUNK_SIZE         (64 * 1024)
+
+#define BUFFER_FILE_CAPACITY        (64 * 1024 * 1024)
+#define BUFFER_FILE_READ_BACK       (16 * 1024 * 1024)
+#define BUFFER_FILE_HOT_SIZE        (1 * 1024 * 1024)
+
+#define RANGE_MAX_CONNECTIONS       8
+#define RANGE_START_CONNECTIONS     2
+#define RANGE_MAX_CHUNKS            (2 * RANGE_MAX_CONNECTIONS)
+#define RANGE_CHUNK_SIZE            (512 * 1024)
+#define RANGE_MIN_SIZE              (8 * 1024 * 1024)
+#define RANGE_READ_SIZE             (64 * 1024)
+#define RANGE_RETRIES               2
+#define RANGE_MIN_SAMPLE_BYTES      (64 * 1024)
+#define RANGE_HOLD_ROUNDS           4
+
+#define TAIL_PROBE_SIZE             4096
+#define TAIL_PREFETCH_SIZE          (8 * 1024 * 1024)
 
+/*
+ * The fifo storage is either heap memory or, with buffer_file_dir set, a
+ * shared mapping of an unlinked file. The file backed pages are written back
+ * every hot_size bytes, after which the kernel may reclaim them like any clean
+ * page cache, so only the recently written and read part stays resident.
+ */
 typedef struct RingBuffer
 {
     AVFifoBuffer *fifo;
     int           read_back_capacity;
 
     int           read_pos;
+
+    uint8_t      *map;
+    size_t        map_size;
+    int           hot_size;
+    uint8_t      *sync_ptr;     // first byte written since the last write back
+    int           unsynced;
 } RingBuffer;
 
+enum RangeChunkState {
+    RANGE_CHUNK_FREE,
+    RANGE_CHUNK_QUEUED,
+    RANGE_CHUNK_DOWNLOADING,
+    RANGE_CHUNK_DONE,
+};
+
+// a byte range of the resource, downloaded by a worker, copied to the ring in order
+typedef struct RangeChunk {
+    URLContext          *owner;
+    enum RangeChunkState state;
+    int64_t              start;
+    int                  size;
+    uint8_t             *buf;
+    int                  filled;    // downloaded
+    int                  written;   // copied to the ring
+    int                  error;     // why the download stopped short
+    int                  retries;
+    int                  cancel;    // the worker frees the chunk when its download stops
+} RangeChunk;
+
 typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
@@ -75,9 +152,77 @@ typedef struct Context {
     pthread_cond_t  cond_wakeup_background;
     pthread_mutex_t mutex;
     pthread_t       async_buffer_thread;
+    FFIOReactorSource *reactor;             // runs the background work instead of the thread
+    int             background_idle;        // waits for cond_wakeup_background
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* options */
+    char           *buffer_file_dir;
+    int             buffer_file_capacity;
+    int             buffer_file_read_back;
+    int             buffer_file_hot_size;
+    int             read_ahead_seconds;
+    int64_t         read_ahead_bit_rate;
+    int             range_connections_max;
+    int             range_chunk_size;
+    int64_t         range_min_size;
+    int             tail_prefetch_size;
+    int             read_chunk_size;
+    int             avio_buffer_size;
+    int64_t         app_ctx_intptr;
+    int             use_reactor;
+
+    AVApplicationContext *app_ctx;
+    int             forward_capacity;
+    int             max_forward;            // forward bytes within the memory the application allows, 0 for no limit
+    int             read_ahead;             // forward bytes to buffer, 0 for the whole ring
+    int             read_ahead_throttled;
+    int             short_seek_threshold;
+    int64_t         next_read_ahead_time;
+    int64_t         io_rate;                // bytes per second allowed by the application, 0 for no limit, < 0 suspended
+    int64_t         io_pace_time;           // the download may go on at this time
+
+    /* parallel range download */
+    char           *url;                    // the resource after redirects
+    int             open_flags;
+    AVDictionary   *open_opts;
+    int             range_allowed;
+    int             range_enabled;
+    pthread_cond_t  cond_wakeup_range;
+    pthread_t       range_threads[RANGE_MAX_CONNECTIONS];
+    int             range_nb_threads;
+    RangeChunk      range_chunks[RANGE_MAX_CHUNKS];
+    int64_t         range_write_pos;        // next byte for the ring
+    int64_t         range_next_pos;         // start of the next chunk to queue
+    int             range_connections;      // downloads at once
+    int             range_downloading;
+    int64_t         range_conn_speed;       // bytes per second of one connection
+    int             range_samples;
+    int64_t         range_prev_speed;       // aggregate rate before the last step up
+    int             range_prev_connections;
+    int             range_hold;
+
+    /* moov at the end of an mp4, fetched while the head is read */
+    RangeChunk      tail;
+    pthread_t       tail_thread;
+    int             tail_thread_started;
+    int             in_tail;                // logical_pos is in the tail, the ring stays at ring_pos
+    int64_t         ring_pos;
+
+    /* background thread only */
+    int64_t         speed_start;
+    int64_t         speed_bytes;
+    int64_t         read_speed;             // bytes per second while downloading, 0 if unknown
+    int64_t         inner_pos;
+    int64_t         inner_read;             // bytes read since the inner was positioned
+    uint8_t         probe[TAIL_PROBE_SIZE]; // the head of the resource
+    int             probe_len;
+    int             probe_done;
+    int             read_short;             // the last read drained the http and tls buffers
+    int             read_batch_short;       // a read of the current chunk did
+    int64_t         read_wait_deadline;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -91,8 +236,127 @@ static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capa
     return 0;
 }
 
+#if ASYNC_HAVE_BUFFER_FILE
+static int ring_init_file(RingBuffer *ring, unsigned int capacity, int read_back_capacity,
+                          const char *dir, int hot_size, void *log_ctx)
+{
+    char            *path;
+    struct statvfs   vfs;
+    size_t           size = (size_t)capacity + read_back_capacity;
+    void            *map  = MAP_FAILED;
+    int              fd;
+    int              ret  = 0;
+
+    memset(ring, 0, sizeof(RingBuffer));
+
+    path = av_asprintf("%s/ijkasync-XXXXXX", dir);
+    if (!path)
+        return AVERROR(ENOMEM);
+    fd = mkstemp(path);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        av_log(log_ctx, AV_LOG_WARNING, "mkstemp(%s) failed: %s\n", path, av_err2str(ret));
+        av_free(path);
+        return ret;
+    }
+    // the file only lives as long as the mapping
+    unlink(path);
+    av_free(path);
+
+    /* a store into a page the file system can not back raises SIGBUS,
+     * so make sure the space is there before mapping a sparse file */
+    if (fstatvfs(fd, &vfs) == 0 && (uint64_t)vfs.f_bavail * vfs.f_frsize < 2 * (uint64_t)size) {
+        av_log(log_ctx, AV_LOG_WARNING, "not enough free space for a %zu bytes buffer file\n", size);
+        ret = AVERROR(ENOSPC);
+        goto fail;
+    }
+#ifdef F_PREALLOCATE
+    {
+        fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, size };
+        if (fcntl(fd, F_PREALLOCATE, &store) < 0) {
+            ret = AVERROR(errno);
+            av_log(log_ctx, AV_LOG_WARNING, "F_PREALLOCATE failed: %s\n", av_err2str(ret));
+            goto fail;
+        }
+    }
+#endif
+    if (ftruncate(fd, size) < 0) {
+        ret = AVERROR(errno);
+        av_log(log_ctx, AV_LOG_WARNING, "ftruncate failed: %s\n", av_err2str(ret));
+        goto fail;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = AVERROR(errno);
+        av_log(log_ctx, AV_LOG_WARNING, "mmap failed: %s\n", av_err2str(ret));
+        goto fail;
+    }
+    posix_madvise(map, size, POSIX_MADV_SEQUENTIAL);
+
+    /* an AVFifoBuffer over the mapping, so reads and writes share the
+     * av_fifo code with the memory ring; ring_destroy() knows the difference */
+    ring->fifo = av_mallocz(sizeof(AVFifoBuffer));
+    if (!ring->fifo) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ring->fifo->buffer = map;
+    ring->fifo->end    = ring->fifo->buffer + size;
+    av_fifo_reset(ring->fifo);
+
+    ring->read_back_capacity = read_back_capacity;
+    ring->map                = map;
+    ring->map_size           = size;
+    ring->hot_size           = hot_size;
+    ring->sync_ptr           = map;
+    close(fd);
+    return 0;
+fail:
+    if (map != MAP_FAILED)
+        munmap(map, size);
+    close(fd);
+    return ret;
+}
+
+static void ring_sync_range(RingBuffer *ring, uint8_t *start, uint8_t *end)
+{
+    uintptr_t page  = sysconf(_SC_PAGESIZE);
+    uint8_t  *first = (uint8_t *)((uintptr_t)start & ~(page - 1));
+
+    if (end > first)
+        msync(first, end - first, MS_ASYNC);
+}
+
+// start writing back what the background thread stored since the last call
+static void ring_sync(RingBuffer *ring, int written)
+{
+    uint8_t *wptr = ring->fifo->wptr;
+
+    ring->unsynced += written;
+    if (ring->unsynced < ring->hot_size)
+        return;
+
+    if (wptr > ring->sync_ptr) {
+        ring_sync_range(ring, ring->sync_ptr, wptr);
+    } else {
+        ring_sync_range(ring, ring->sync_ptr, ring->fifo->end);
+        ring_sync_range(ring, ring->fifo->buffer, wptr);
+    }
+    ring->sync_ptr = wptr;
+    ring->unsynced = 0;
+}
+#endif
+
 static void ring_destroy(RingBuffer *ring)
 {
+#if ASYNC_HAVE_BUFFER_FILE
+    if (ring->map) {
+        munmap(ring->map, ring->map_size);
+        ring->map = NULL;
+        av_freep(&ring->fifo);
+        return;
+    }
+#endif
     av_fifo_freep(&ring->fifo);
 }
 
@@ -100,6 +364,8 @@ static void ring_reset(RingBuffer *ring)
 {
     av_fifo_reset(ring->fifo);
     ring->read_pos = 0;
+    ring->sync_ptr = ring->fifo->wptr;
+    ring->unsynced = 0;
 }
 
 static int ring_size(RingBuffer *ring)
@@ -130,8 +396,15 @@ static int ring_generic_read(RingBuffer *ring, void *dest, int buf_size, void (*
 
 static int ring_generic_write(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
 {
+    int ret;
+
     av_assert2(size <= ring_space(ring));
-    return av_fifo_generic_write(ring->fifo, src, size, func);
+    ret = av_fifo_generic_write(ring->fifo, src, size, func);
+#if ASYNC_HAVE_BUFFER_FILE
+    if (ring->map && ret > 0)
+        ring_sync(ring, ret);
+#endif
+    return ret;
 }
 
 static int ring_size_of_read_back(RingBuffer *ring)
@@ -147,6 +420,39 @@ static int ring_drain(RingBuffer *ring, int offset)
     return 0;
 }
 
+// bytes of memory the ring holds, the pages of a file are the kernel's
+static int ring_memory(RingBuffer *ring)
+{
+    return ring->map ? 0 : ring->fifo->end - ring->fifo->buffer;
+}
+
+static void ring_copy_to_fifo(void *dst, void *src, int size)
+{
+    av_fifo_generic_write(dst, src, size, NULL);
+}
+
+// memory rings only, what the ring holds forward must fit into capacity;
+// the oldest read back bytes are dropped
+static int ring_resize(RingBuffer *ring, int capacity, int read_back_capacity)
+{
+    int           read_back = FFMIN(ring->read_pos, read_back_capacity);
+    int           size      = ring_size(ring);
+    AVFifoBuffer *fifo;
+
+    av_assert2(!ring->map && size <= capacity);
+    fifo = av_fifo_alloc(capacity + read_back_capacity);
+    if (!fifo)
+        return AVERROR(ENOMEM);
+
+    av_fifo_drain(ring->fifo, ring->read_pos - read_back);
+    av_fifo_generic_read(ring->fifo, fifo, read_back + size, ring_copy_to_fifo);
+    av_fifo_freep(&ring->fifo);
+    ring->fifo               = fifo;
+    ring->read_pos           = read_back;
+    ring->read_back_capacity = read_back_capacity;
+    return 0;
+}
+
 static int async_check_interrupt(void *arg)
 {
     URLContext *h   = arg;
@@ -161,93 +467,873 @@ static int async_check_interrupt(void *arg)
     return c->abort_request;
 }
 
+// must be called locked, for whatever waits on cond_wakeup_background
+static void async_wakeup_background(Context *c)
+{
+    pthread_cond_signal(&c->cond_wakeup_background);
+    if (c->reactor && (c->background_idle || c->seek_request || c->abort_request))
+        ff_io_reactor_wake(c->reactor);
+}
+
+// whether a read would not block, as far as the socket tells
+static int async_inner_readable(Context *c)
+{
+#if HAVE_POLL_H
+    struct pollfd pfd = { 0 };
+
+    pfd.fd     = ffurl_get_file_handle(c->inner);
+    pfd.events = POLLIN;
+    return pfd.fd >= 0 && poll(&pfd, 1, 0) > 0;
+#else
+    return 0;
+#endif
+}
+
 static int wrapped_url_read(void *src, void *dst, int size)
 {
     URLContext *h   = src;
     Context    *c   = h->priv_data;
     int         ret;
 
-    ret = ffurl_read(c->inner, dst, size);
-    c->inner_io_error = ret < 0 ? ret : 0;
+    // a chunk is read in as few calls as the socket has data for, and ends
+    // rather than waiting for more; 0 ends it without being an eof
+    if (c->read_batch_short && !async_inner_readable(c))
+        return 0;
 
+    ret = ffurl_read(c->inner, dst, size);
+    c->inner_io_error   = ret < 0 ? ret : 0;
+    c->read_batch_short = ret > 0 && ret < size;
+
+    if (ret > 0) {
+        if (!c->probe_done && c->inner_pos == c->probe_len) {
+            int len = FFMIN(ret, TAIL_PROBE_SIZE - c->probe_len);
+            memcpy(c->probe + c->probe_len, dst, len);
+            c->probe_len += len;
+        }
+        c->inner_pos  += ret;
+        c->inner_read += ret;
+    }
     return ret;
 }
 
-static void *async_buffer_task(void *arg)
+// measure the download speed over the time spent reading, waits excluded
+static void async_update_read_speed(URLContext *h, int64_t start, int bytes)
 {
-    URLContext   *h    = arg;
-    Context      *c    = h->priv_data;
-    RingBuffer   *ring = &c->ring;
-    int           ret  = 0;
-    int64_t       seek_ret;
+    Context            *c   = h->priv_data;
+    int64_t             now = av_gettime_relative();
+    int64_t             elapsed, sample;
+    AVAppAsyncReadSpeed speed = { 0 };
+
+    if (!c->speed_start) {
+        c->speed_start = start;
+        c->speed_bytes = 0;
+    }
+    c->speed_bytes += FFMAX(bytes, 0);
+    elapsed = now - c->speed_start;
+    if (elapsed < READ_SPEED_INTERVAL)
+        return;
+
+    sample = c->speed_bytes * 1000000 / elapsed;
+    c->read_speed = c->read_speed ? (c->read_speed * 3 + sample) / 4 : sample;
+
+    speed.size          = sizeof(speed);
+    speed.is_full_speed = 1;
+    speed.io_bytes      = c->speed_bytes;
+    speed.elapsed_milli = elapsed / 1000;
+    av_application_on_async_read_speed(c->app_ctx, &speed);
+    ff_throughput_add_sample(c->inner ? c->inner->filename : c->url, c->speed_bytes, elapsed);
+
+    c->speed_start = now;
+    c->speed_bytes = 0;
+}
 
-    while (1) {
-        int fifo_space, to_copy;
+/*
+ * Give memory back when the application asks for it, three quarters of
+ * max_memory forward and the rest for reading back. The ring is rebuilt
+ * once what it holds forward fits, until then max_forward keeps the
+ * download from adding to it. Background thread, with c->mutex held.
+ */
+static void async_limit_memory(Context *c, int64_t max_memory)
+{
+    RingBuffer *ring      = &c->ring;
+    int         forward   = FFMAX(max_memory / 4 * 3, READ_AHEAD_MIN);
+    int         read_back = FFMAX(max_memory - forward, 0);
+
+    if (ring->map || forward + read_back >= ring_memory(ring))
+        return;
+
+    c->max_forward = forward;
+    if (ring_size(ring) > forward || ring_resize(ring, forward, read_back) < 0)
+        return;
+
+    av_log(NULL, AV_LOG_INFO, "async: ring cut to %d + %d bytes\n", forward, read_back);
+    c->forward_capacity = forward;
+    c->range_chunk_size = FFMIN(c->range_chunk_size, forward / 2);
+}
 
+/*
+ * Size the forward window to read_ahead_seconds of media, more when the link
+ * is barely faster than the stream, and set the short seek threshold to what
+ * the link downloads in about half a second, the rough cost of a reconnect.
+ * The bit rate comes from the application (AVAPP_CTRL_ASYNC_READ_AHEAD) or
+ * the read_ahead_bit_rate option; while unknown the whole ring is filled.
+ */
+static void async_update_read_ahead(URLContext *h)
+{
+    Context             *c    = h->priv_data;
+    RingBuffer          *ring = &c->ring;
+    AVAppAsyncReadAhead  ctl  = { 0 };
+    AVAppAsyncStatistic  stat = { 0 };
+    int64_t              bit_rate   = c->read_ahead_bit_rate;
+    int64_t              read_ahead = 0;
+    int64_t              threshold  = SHORT_SEEK_THRESHOLD;
+    int64_t              byte_rate;
+
+    ctl.size       = sizeof(ctl);
+    ctl.read_speed = c->read_speed;
+    if (av_application_on_async_read_ahead(c->app_ctx, &ctl) >= 0 && ctl.bit_rate > 0)
+        bit_rate = ctl.bit_rate;
+    if (c->io_rate != ctl.max_io_rate)
+        c->io_pace_time = 0;
+    c->io_rate = ctl.max_io_rate;
+    byte_rate = bit_rate / 8;
+
+    if (ctl.max_memory > 0) {
         pthread_mutex_lock(&c->mutex);
-        if (async_check_interrupt(h)) {
-            c->io_eof_reached = 1;
-            c->io_error       = AVERROR_EXIT;
-            pthread_cond_signal(&c->cond_wakeup_main);
-            pthread_mutex_unlock(&c->mutex);
-            break;
-        }
+        async_limit_memory(c, ctl.max_memory);
+        pthread_mutex_unlock(&c->mutex);
+    }
 
-        if (c->seek_request) {
-            seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
-            if (seek_ret >= 0) {
-                c->io_eof_reached = 0;
-                c->io_error       = 0;
-                ring_reset(ring);
-            }
+    if (c->read_ahead_seconds > 0 && byte_rate > 0) {
+        int64_t margin = 100;
+        if (c->read_speed > 0)
+            margin = av_clip64(2 * byte_rate * 100 / c->read_speed, 100, 400);
+        read_ahead = byte_rate * c->read_ahead_seconds * margin / 100;
+        read_ahead = av_clip64(read_ahead, READ_AHEAD_MIN, c->forward_capacity);
+        if (read_ahead >= c->forward_capacity)
+            read_ahead = 0;
+    }
+    if (c->max_forward > 0 && c->max_forward < c->forward_capacity &&
+        (!read_ahead || read_ahead > c->max_forward))
+        read_ahead = c->max_forward;
+    if (c->read_speed > 0)
+        threshold = av_clip64(c->read_speed / 2, SHORT_SEEK_THRESHOLD_MIN, SHORT_SEEK_THRESHOLD_MAX);
 
-            c->seek_completed = 1;
-            c->seek_ret       = seek_ret;
-            c->seek_request   = 0;
+    pthread_mutex_lock(&c->mutex);
+    c->read_ahead           = read_ahead;
+    c->short_seek_threshold = threshold;
+    stat.buf_backwards      = ring_size_of_read_back(ring);
+    stat.buf_forwards       = ring_size(ring);
+    stat.buf_memory         = ring_memory(ring);
+    pthread_mutex_unlock(&c->mutex);
 
+    stat.size         = sizeof(stat);
+    stat.buf_capacity = read_ahead ? read_ahead : c->forward_capacity;
+    av_application_on_async_statistic(c->app_ctx, &stat);
 
-            pthread_cond_signal(&c->cond_wakeup_main);
-            pthread_mutex_unlock(&c->mutex);
-            continue;
+    // poll more often while suspended, so a promoted player resumes quickly
+    c->next_read_ahead_time = av_gettime_relative() + (c->io_rate < 0 ? IO_SUSPEND_INTERVAL : READ_AHEAD_INTERVAL);
+}
+
+/*
+ * The application may cap the download of a player that is not on screen,
+ * so players sharing a link leave the bandwidth to the one being watched.
+ * Bytes are paced with a short burst allowance.
+ */
+static int64_t async_io_delay(Context *c)
+{
+    int64_t now;
+
+    if (c->io_rate < 0)
+        return IO_PACE_STEP;
+    if (c->io_rate == 0)
+        return 0;
+
+    now = av_gettime_relative();
+    return c->io_pace_time > now ? c->io_pace_time - now : 0;
+}
+
+static void async_io_account(Context *c, int bytes)
+{
+    int64_t now;
+
+    if (c->io_rate <= 0 || bytes <= 0)
+        return;
+
+    now = av_gettime_relative();
+    c->io_pace_time  = FFMAX(c->io_pace_time, now - IO_PACE_BURST);
+    c->io_pace_time += bytes * 1000000LL / c->io_rate;
+}
+
+// must be called locked, resumes downloading once a quarter of the window is consumed
+static int async_read_ahead_reached(Context *c)
+{
+    int forwards = ring_size(&c->ring);
+
+    if (c->read_ahead <= 0)
+        c->read_ahead_throttled = 0;
+    else if (c->read_ahead_throttled)
+        c->read_ahead_throttled = forwards > c->read_ahead / 4 * 3;
+    else
+        c->read_ahead_throttled = forwards >= c->read_ahead;
+    return c->read_ahead_throttled;
+}
+
+/*
+ * Parallel range download
+ *
+ * A large seekable http resource is fetched as chunks of range_chunk_size
+ * bytes, over up to range_connections "offset" / "end_offset" requests at
+ * once, http_pool keeping the connections alive from one chunk to the next.
+ * The background thread copies the chunks into the ring in order, the
+ * earliest one while it is still downloading. The inner connection serves
+ * the first chunk after opening and stays until a range request delivers,
+ * a server ignoring ranges is then read on from it.
+ */
+
+static int async_range_interrupt(void *arg)
+{
+    RangeChunk *chunk = arg;
+    Context    *c     = chunk->owner->priv_data;
+
+    return chunk->cancel || c->abort_request || ff_check_interrupt(&c->interrupt_callback);
+}
+
+// must be called locked
+static void async_range_free_chunk(RangeChunk *chunk)
+{
+    URLContext *owner = chunk->owner;
+
+    av_freep(&chunk->buf);
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->owner = owner;
+}
+
+/*
+ * Hill climbing on the aggregate rate, the per connection rate times the
+ * connections: one more connection stays while it adds a tenth, otherwise
+ * the count steps back and holds for a few rounds before trying again.
+ * Must be called locked.
+ */
+static void async_range_add_sample(URLContext *h, int64_t bytes, int64_t elapsed)
+{
+    Context *c = h->priv_data;
+    int64_t  sample, aggregate;
+
+    if (bytes < RANGE_MIN_SAMPLE_BYTES || elapsed <= 0)
+        return;
+
+    sample = bytes * 1000000 / elapsed;
+    c->range_conn_speed = c->range_conn_speed ? (c->range_conn_speed * 3 + sample) / 4 : sample;
+
+    // a round is two chunks per connection, for the rate to settle
+    if (++c->range_samples < 2 * c->range_connections)
+        return;
+    c->range_samples = 0;
+    aggregate = c->range_conn_speed * c->range_connections;
+
+    if (c->range_prev_connections && c->range_connections > c->range_prev_connections &&
+        aggregate * 10 < c->range_prev_speed * 11) {
+        c->range_connections      = c->range_prev_connections;
+        c->range_prev_connections = 0;
+        c->range_hold             = RANGE_HOLD_ROUNDS;
+    } else if (c->range_hold > 0) {
+        c->range_hold--;
+        return;
+    } else if (c->range_connections < c->range_connections_max) {
+        c->range_prev_speed       = aggregate;
+        c->range_prev_connections = c->range_connections;
+        c->range_connections++;
+    } else {
+        c->range_prev_connections = 0;
+        return;
+    }
+    av_log(h, AV_LOG_VERBOSE, "%d range connections, %"PRId64" bytes/s each\n",
+           c->range_connections, c->range_conn_speed);
+}
+
+static int async_range_download(URLContext *h, RangeChunk *chunk, int filled)
+{
+    Context         *c      = h->priv_data;
+    URLContext      *hd     = NULL;
+    AVDictionary    *opts   = NULL;
+    AVIOInterruptCB  int_cb = { async_range_interrupt, chunk };
+    int64_t          start  = av_gettime_relative();
+    int              first  = filled;
+    int              ret;
+
+    av_dict_copy(&opts, c->open_opts, 0);
+    av_dict_set_int(&opts, "offset",     chunk->start + filled, 0);
+    av_dict_set_int(&opts, "end_offset", chunk->start + chunk->size, 0);
+    ret = ffurl_open_whitelist(&hd, c->url, AVIO_FLAG_READ, &int_cb, &opts,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    while (filled < chunk->size) {
+        ret = ffurl_read(hd, chunk->buf + filled, FFMIN(RANGE_READ_SIZE, chunk->size - filled));
+        if (ret <= 0) {
+            ret = ret ? ret : AVERROR_EOF;
+            break;
         }
+        filled += ret;
+        ret     = 0;
 
-        fifo_space = ring_space(ring);
-        if (c->io_eof_reached || fifo_space <= 0) {
+        pthread_mutex_lock(&c->mutex);
+        chunk->filled = filled;
+        if (chunk == &c->tail)
             pthread_cond_signal(&c->cond_wakeup_main);
-            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
-            pthread_mutex_unlock(&c->mutex);
+        else
+            async_wakeup_background(c);
+        pthread_mutex_unlock(&c->mutex);
+    }
+    ffurl_closep(&hd);
+
+    pthread_mutex_lock(&c->mutex);
+    async_range_add_sample(h, filled - first, av_gettime_relative() - start);
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+// must be called locked, earliest first, it is the one needed next
+static RangeChunk *async_range_next_queued(Context *c)
+{
+    RangeChunk *chunk = NULL;
+    int i;
+
+    if (c->range_downloading >= c->range_connections)
+        return NULL;
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++) {
+        RangeChunk *cand = &c->range_chunks[i];
+        if (cand->state == RANGE_CHUNK_QUEUED && (!chunk || cand->start < chunk->start))
+            chunk = cand;
+    }
+    return chunk;
+}
+
+static void *async_range_worker(void *arg)
+{
+    URLContext *h = arg;
+    Context    *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        RangeChunk *chunk = async_range_next_queued(c);
+        int         filled, ret;
+
+        if (!chunk) {
+            pthread_cond_wait(&c->cond_wakeup_range, &c->mutex);
             continue;
         }
+        chunk->state = RANGE_CHUNK_DOWNLOADING;
+        filled       = chunk->filled;
+        c->range_downloading++;
         pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        ret = async_range_download(h, chunk, filled);
 
         pthread_mutex_lock(&c->mutex);
-        if (ret <= 0) {
-            c->io_eof_reached = 1;
-            if (c->inner_io_error < 0)
-                c->io_error = c->inner_io_error;
+        c->range_downloading--;
+        if (chunk->cancel) {
+            async_range_free_chunk(chunk);
+        } else {
+            chunk->state = RANGE_CHUNK_DONE;
+            chunk->error = ret;
         }
+        async_wakeup_background(c);
+        pthread_cond_broadcast(&c->cond_wakeup_range);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+// must be called locked
+static void async_range_reset(Context *c, int64_t pos)
+{
+    int i;
+
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++) {
+        RangeChunk *chunk = &c->range_chunks[i];
+        if (chunk->state == RANGE_CHUNK_DOWNLOADING)
+            chunk->cancel = 1;
+        else if (chunk->state != RANGE_CHUNK_FREE)
+            async_range_free_chunk(chunk);
+    }
+    c->range_write_pos = pos;
+    c->range_next_pos  = pos;
+}
+
+/*
+ * Queue chunks after range_next_pos for the idle connections, keeping what
+ * is downloaded but not in the ring within the ring space and the read
+ * ahead window. Must be called locked.
+ */
+static void async_range_schedule(Context *c)
+{
+    RangeChunk *chunk;
+    int         i, active = 0;
+
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++) {
+        chunk = &c->range_chunks[i];
+        if (!chunk->cancel && (chunk->state == RANGE_CHUNK_QUEUED || chunk->state == RANGE_CHUNK_DOWNLOADING))
+            active++;
+    }
+
+    while (active < c->range_connections && c->range_next_pos < c->logical_size) {
+        int64_t pending = c->range_next_pos - c->range_write_pos;
+        int     size    = FFMIN(c->range_chunk_size, c->logical_size - c->range_next_pos);
+
+        if (pending > 0 && (pending + size > ring_space(&c->ring) ||
+                            (c->read_ahead > 0 && ring_size(&c->ring) + pending + size > c->read_ahead)))
+            break;
+
+        chunk = NULL;
+        for (i = 0; i < RANGE_MAX_CHUNKS && !chunk; i++) {
+            if (c->range_chunks[i].state == RANGE_CHUNK_FREE)
+                chunk = &c->range_chunks[i];
+        }
+        if (!chunk || !(chunk->buf = av_malloc(size)))
+            break;
+
+        chunk->state = RANGE_CHUNK_QUEUED;
+        chunk->start = c->range_next_pos;
+        chunk->size  = size;
+        c->range_next_pos += size;
+        active++;
+    }
+    pthread_cond_broadcast(&c->cond_wakeup_range);
+}
+
+// must be called locked, the chunk the ring continues with
+static RangeChunk *async_range_head(Context *c)
+{
+    int i;
+
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++) {
+        RangeChunk *chunk = &c->range_chunks[i];
+        if (chunk->state != RANGE_CHUNK_FREE && !chunk->cancel &&
+            chunk->start + chunk->written == c->range_write_pos)
+            return chunk;
+    }
+    return NULL;
+}
+
+// must be called locked
+static int async_range_start(URLContext *h)
+{
+    Context *c = h->priv_data;
+    int      ret;
+
+    while (c->range_nb_threads < c->range_connections_max) {
+        ret = pthread_create(&c->range_threads[c->range_nb_threads], NULL, async_range_worker, h);
+        if (ret) {
+            av_log(h, AV_LOG_WARNING, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            break;
+        }
+        c->range_nb_threads++;
+    }
+    if (c->range_nb_threads < 2) {
+        c->range_allowed = 0;
+        return AVERROR(ENOSYS);
+    }
+    c->range_connections_max = c->range_nb_threads;
+    c->range_connections     = FFMIN(RANGE_START_CONNECTIONS, c->range_connections_max);
+    c->range_enabled         = 1;
+    async_range_reset(c, c->inner_pos);
+    av_log(h, AV_LOG_VERBOSE, "downloading in ranges from %"PRId64"\n", c->inner_pos);
+    return 0;
+}
+
+// back to a single connection, called unlocked with range_enabled cleared
+static int async_range_fallback(URLContext *h)
+{
+    Context         *c      = h->priv_data;
+    AVDictionary    *opts   = NULL;
+    AVIOInterruptCB  int_cb = { async_check_interrupt, h };
+    int              ret;
+
+    av_log(h, AV_LOG_WARNING, "range requests failed, downloading over one connection from %"PRId64"\n",
+           c->range_write_pos);
+    if (c->inner && c->inner_pos == c->range_write_pos)
+        return 0;
+    ffurl_closep(&c->inner);
+    av_dict_copy(&opts, c->open_opts, 0);
+    av_dict_set_int(&opts, "offset", c->range_write_pos, 0);
+    ret = ffurl_open_whitelist(&c->inner, c->url, c->open_flags, &int_cb, &opts,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    c->inner_pos  = c->range_write_pos;
+    c->inner_read = 0;
+    return ret;
+}
+
+/*
+ * Copy what the head chunk has into the ring, must be called locked.
+ * Returns the bytes copied, 0 if there is nothing to copy yet, or a negative
+ * AVERROR when nothing more comes.
+ */
+static int async_range_write(URLContext *h, int fifo_space)
+{
+    Context    *c = h->priv_data;
+    RangeChunk *chunk;
+    uint8_t    *src;
+    int         to_copy, ret;
+
+    async_range_schedule(c);
+    chunk = async_range_head(c);
+    if (!chunk)
+        return c->range_write_pos >= c->logical_size ? AVERROR_EOF : 0;
+
+    if (chunk->state == RANGE_CHUNK_DONE && chunk->error && chunk->written == chunk->filled) {
+        if (chunk->error != AVERROR_EXIT && chunk->retries++ < RANGE_RETRIES) {
+            av_log(h, AV_LOG_WARNING, "range %"PRId64"-%"PRId64" failed: %s, requesting it again\n",
+                   chunk->start + chunk->filled, chunk->start + chunk->size, av_err2str(chunk->error));
+            chunk->state = RANGE_CHUNK_QUEUED;
+            chunk->error = 0;
+            pthread_cond_broadcast(&c->cond_wakeup_range);
+            return 0;
+        }
+        ret = chunk->error;
+        async_range_reset(c, c->range_write_pos);
+        c->range_enabled = 0;
+        c->range_allowed = 0;
+        if (ret == AVERROR_EXIT)
+            return ret;
 
-        pthread_cond_signal(&c->cond_wakeup_main);
         pthread_mutex_unlock(&c->mutex);
+        ret = async_range_fallback(h);
+        pthread_mutex_lock(&c->mutex);
+        return ret < 0 ? ret : 0;
+    }
+
+    to_copy = FFMIN(chunk->filled - chunk->written, fifo_space);
+    if (to_copy <= 0)
+        return 0;
+
+    // the worker only appends, the copied part stays put
+    src = chunk->buf + chunk->written;
+    pthread_mutex_unlock(&c->mutex);
+    ring_generic_write(&c->ring, src, to_copy, NULL);
+    pthread_mutex_lock(&c->mutex);
+
+    chunk->written     += to_copy;
+    c->range_write_pos += to_copy;
+    if (chunk->written == chunk->size) {
+        if (chunk->state == RANGE_CHUNK_DONE)
+            async_range_free_chunk(chunk);
+        else
+            chunk->cancel = 1;
     }
+    return to_copy;
+}
+
+/*
+ * Moov at the end
+ *
+ * An mp4 that is not fast start puts mdat before moov, the header reader
+ * seeks from the head to the end and back. The top level boxes are followed
+ * as the head comes in, and once mdat shows up what comes after it is
+ * fetched over a second connection. Reading there does not move the ring,
+ * so the seek back to the head is served from it as well.
+ */
+
+static void *async_tail_task(void *arg)
+{
+    URLContext *h = arg;
+    Context    *c = h->priv_data;
+    int         ret;
+
+    ret = async_range_download(h, &c->tail, 0);
+
+    pthread_mutex_lock(&c->mutex);
+    c->tail.state = RANGE_CHUNK_DONE;
+    c->tail.error = ret;
+    pthread_cond_signal(&c->cond_wakeup_main);
+    pthread_mutex_unlock(&c->mutex);
 
     return NULL;
 }
 
+// must be called locked by the background thread
+static void async_tail_probe(URLContext *h, int final)
+{
+    Context *c        = h->priv_data;
+    int64_t  pos      = 0;
+    int64_t  moov_pos = -1;
+
+    // after a seek or at the end no more of the head comes
+    final |= c->inner_pos != c->probe_len;
+    while (pos + 8 <= c->probe_len) {
+        uint64_t size = AV_RB32(c->probe + pos);
+        uint32_t type = AV_RL32(c->probe + pos + 4);
+
+        if (size == 1) {
+            if (pos + 16 > c->probe_len)
+                break;
+            size = AV_RB64(c->probe + pos + 8);
+        }
+        // a size of 0 extends to the end of the file
+        if (size < 8 || type == MKTAG('m','o','o','v')) {
+            final = 1;
+            break;
+        }
+        if (type == MKTAG('m','d','a','t')) {
+            moov_pos = size < c->logical_size ? pos + size : -1;
+            final    = 1;
+            break;
+        }
+        pos += size;
+    }
+    if (pos + 16 > TAIL_PROBE_SIZE)
+        final = 1;
+    if (!final)
+        return;
+
+    c->probe_done = 1;
+    if (moov_pos <= 0 || moov_pos >= c->logical_size)
+        return;
+
+    c->tail.start = moov_pos;
+    c->tail.size  = FFMIN(c->logical_size - moov_pos, c->tail_prefetch_size);
+    if (!(c->tail.buf = av_malloc(c->tail.size)))
+        return;
+    c->tail.state = RANGE_CHUNK_DOWNLOADING;
+    if (pthread_create(&c->tail_thread, NULL, async_tail_task, h)) {
+        async_range_free_chunk(&c->tail);
+        return;
+    }
+    c->tail_thread_started = 1;
+    av_log(h, AV_LOG_VERBOSE, "moov expected at %"PRId64", fetching %d bytes from there\n",
+           moov_pos, c->tail.size);
+}
+
+// must be called locked
+static int async_tail_contains(Context *c, int64_t pos)
+{
+    RangeChunk *tail = &c->tail;
+
+    if (tail->state == RANGE_CHUNK_FREE || pos < tail->start)
+        return 0;
+    return pos < tail->start + (tail->state == RANGE_CHUNK_DONE ? tail->filled : tail->size);
+}
+
+// with c->mutex held, which it releases; the reactor is woken instead
+static int async_wait_background(Context *c)
+{
+    if (c->reactor) {
+        c->background_idle = 1;
+        pthread_mutex_unlock(&c->mutex);
+        return FF_IO_REACTOR_WAIT;
+    }
+    pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+    pthread_mutex_unlock(&c->mutex);
+    return FF_IO_REACTOR_RUN;
+}
+
+/*
+ * A read of a socket with nothing to read would hold a reactor worker, so
+ * after a short read, which leaves the http and tls buffers empty, wait for
+ * the descriptor. The read goes ahead after READ_WAIT_MAX whatever it is,
+ * the rest of an http chunk may still be buffered.
+ */
+static int async_wait_readable(Context *c, int *fd, int64_t *timeout)
+{
+#if HAVE_POLL_H
+    struct pollfd pfd = { 0 };
+    int64_t       now;
+
+    if (!c->reactor || !c->read_short || !c->inner)
+        return 0;
+    pfd.fd     = ffurl_get_file_handle(c->inner);
+    pfd.events = POLLIN;
+    if (pfd.fd < 0 || poll(&pfd, 1, 0) != 0)
+        goto read;
+
+    now = av_gettime_relative();
+    if (!c->read_wait_deadline)
+        c->read_wait_deadline = now + READ_WAIT_MAX;
+    if (now >= c->read_wait_deadline)
+        goto read;
+    *fd      = pfd.fd;
+    *timeout = c->read_wait_deadline - now;
+    return 1;
+read:
+    c->read_short         = 0;
+    c->read_wait_deadline = 0;
+#endif
+    return 0;
+}
+
+// a slice of the background work, and what to wait for before the next
+static int async_buffer_step(void *arg, int *fd, int64_t *timeout)
+{
+    URLContext   *h    = arg;
+    Context      *c    = h->priv_data;
+    RingBuffer   *ring = &c->ring;
+    int           ret  = 0;
+    int64_t       seek_ret;
+    int64_t       delay;
+    int           fifo_space, to_copy;
+    int64_t       start;
+
+    if (av_gettime_relative() >= c->next_read_ahead_time)
+        async_update_read_ahead(h);
+
+    pthread_mutex_lock(&c->mutex);
+    c->background_idle = 0;
+    if (async_check_interrupt(h)) {
+        c->io_eof_reached = 1;
+        c->io_error       = AVERROR_EXIT;
+        pthread_cond_signal(&c->cond_wakeup_main);
+        pthread_mutex_unlock(&c->mutex);
+        return FF_IO_REACTOR_DONE;
+    }
+
+    if (c->seek_request) {
+        if (c->range_enabled) {
+            async_range_reset(c, c->seek_pos);
+            seek_ret = c->seek_pos;
+        } else {
+            seek_ret = c->inner ? ffurl_seek(c->inner, c->seek_pos, c->seek_whence) : AVERROR(EIO);
+        }
+        if (seek_ret >= 0) {
+            c->io_eof_reached = 0;
+            c->io_error       = 0;
+            c->inner_pos      = seek_ret;
+            c->inner_read     = 0;
+            c->read_short     = 0;
+            ring_reset(ring);
+        }
+
+        c->seek_completed = 1;
+        c->seek_ret       = seek_ret;
+        c->seek_request   = 0;
+
+
+        pthread_cond_signal(&c->cond_wakeup_main);
+        pthread_mutex_unlock(&c->mutex);
+        return FF_IO_REACTOR_RUN;
+    }
+
+    delay = async_io_delay(c);
+    if (delay > 0) {
+        pthread_mutex_unlock(&c->mutex);
+        *timeout = FFMIN(delay, IO_PACE_STEP);
+        return FF_IO_REACTOR_WAIT;
+    }
+
+    fifo_space = ring_space(ring);
+    if (c->io_eof_reached || fifo_space <= 0 || async_read_ahead_reached(c)) {
+        c->speed_start = 0;
+        pthread_cond_signal(&c->cond_wakeup_main);
+        return async_wait_background(c);
+    }
+
+    if (c->range_enabled) {
+        start = av_gettime_relative();
+        ret   = async_range_write(h, fifo_space);
+        if (ret < 0) {
+            c->io_eof_reached = 1;
+            if (ret != AVERROR_EOF)
+                c->io_error = ret;
+        } else if (!ret && c->range_enabled) {
+            // the workers signal progress, the reader has nothing to wake up for
+            return async_wait_background(c);
+        }
+        pthread_cond_signal(&c->cond_wakeup_main);
+        pthread_mutex_unlock(&c->mutex);
+        if (ret > 0) {
+            async_io_account(c, ret);
+            async_update_read_speed(h, start, ret);
+            // ranges work, the inner connection is not needed anymore
+            ffurl_closep(&c->inner);
+        }
+        return FF_IO_REACTOR_RUN;
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    if (async_wait_readable(c, fd, timeout)) {
+        // the time waiting for the socket is not download time
+        c->speed_start = 0;
+        return FF_IO_REACTOR_WAIT_READ;
+    }
+
+    to_copy = FFMIN(c->read_chunk_size, fifo_space);
+    start   = av_gettime_relative();
+    c->read_batch_short = 0;
+    ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+    async_update_read_speed(h, start, ret);
+    async_io_account(c, ret);
+    c->read_short = ret < to_copy;
+
+    pthread_mutex_lock(&c->mutex);
+    if (ret <= 0) {
+        c->io_eof_reached = 1;
+        if (c->inner_io_error < 0)
+            c->io_error = c->inner_io_error;
+    } else if (c->range_allowed && !c->io_rate && c->inner_read >= c->range_chunk_size) {
+        async_range_start(h);
+    }
+    if (!c->probe_done)
+        async_tail_probe(h, ret <= 0);
+
+    pthread_cond_signal(&c->cond_wakeup_main);
+    pthread_mutex_unlock(&c->mutex);
+    return FF_IO_REACTOR_RUN;
+}
+
+static void *async_buffer_task(void *arg)
+{
+    int     fd;
+    int64_t timeout;
+
+    while (1) {
+        timeout = 0;
+        switch (async_buffer_step(arg, &fd, &timeout)) {
+        case FF_IO_REACTOR_DONE:
+            return NULL;
+        case FF_IO_REACTOR_WAIT:
+            if (timeout > 0)
+                av_usleep(timeout);
+            break;
+        }
+    }
+}
+
 static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     Context         *c = h->priv_data;
-    int              ret;
+    int              i, ret;
     AVIOInterruptCB  interrupt_callback = {.callback = async_check_interrupt, .opaque = h};
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    ret = -1;
+#if ASYNC_HAVE_BUFFER_FILE
+    if (c->buffer_file_dir && c->buffer_file_dir[0]) {
+        ret = ring_init_file(&c->ring, c->buffer_file_capacity, c->buffer_file_read_back,
+                             c->buffer_file_dir, c->buffer_file_hot_size, h);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "buffer file unavailable, buffering in memory\n");
+    }
+#endif
+    if (ret < 0)
+        ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
     if (ret < 0)
         goto fifo_fail;
+    c->forward_capacity     = av_fifo_space(c->ring.fifo) - c->ring.read_back_capacity;
+    c->short_seek_threshold = SHORT_SEEK_THRESHOLD;
+
+    /* taken from the options by av_opt_set_dict(), put it back for the inner protocol */
+    c->app_ctx = (AVApplicationContext *)(intptr_t)c->app_ctx_intptr;
+    if (c->app_ctx_intptr)
+        av_dict_set_int(options, "ijkapplication", c->app_ctx_intptr, 0);
+
+    /* the range requests are opened with the same options */
+    if (options)
+        av_dict_copy(&c->open_opts, *options, 0);
 
     /* wrap interrupt callback */
     c->interrupt_callback = h->interrupt_callback;
@@ -259,6 +1345,24 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     c->logical_size = ffurl_size(c->inner);
     h->is_streamed  = c->inner->is_streamed;
+    // the buffer of the AVIOContext on top, fewer and larger reads from the ring
+    if (c->avio_buffer_size)
+        h->max_packet_size = c->avio_buffer_size;
+
+    /* range requests need a seekable http resource of known size */
+    if (!h->is_streamed && c->logical_size > 0 &&
+        (!strcmp(c->inner->prot->name, "http") || !strcmp(c->inner->prot->name, "https")) &&
+        (c->inner_pos = ffurl_seek(c->inner, 0, SEEK_CUR)) >= 0) {
+        uint8_t *location = NULL;
+        if (av_opt_get(c->inner->priv_data, "location", 0, &location) < 0 || !location)
+            location = av_strdup(arg);
+        c->url              = location;
+        c->open_flags       = flags;
+        c->range_allowed    = c->url && c->range_connections_max > 1 && c->logical_size >= c->range_min_size;
+        c->range_chunk_size = FFMIN(c->range_chunk_size, c->forward_capacity / 2);
+    }
+    c->inner_pos  = FFMAX(c->inner_pos, 0);
+    c->probe_done = !c->url || c->tail_prefetch_size <= 0 || c->inner_pos > 0;
 
     ret = pthread_mutex_init(&c->mutex, NULL);
     if (ret != 0) {
@@ -278,15 +1382,29 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
         goto cond_wakeup_background_fail;
     }
 
-    ret = pthread_create(&c->async_buffer_thread, NULL, async_buffer_task, h);
-    if (ret) {
-        av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(ret));
-        goto thread_fail;
+    ret = pthread_cond_init(&c->cond_wakeup_range, NULL);
+    if (ret != 0) {
+        av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(ret));
+        goto cond_wakeup_range_fail;
+    }
+
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++)
+        c->range_chunks[i].owner = h;
+    c->tail.owner = h;
+
+    if (!c->use_reactor || ff_io_reactor_add(&c->reactor, async_buffer_step, h) < 0) {
+        ret = pthread_create(&c->async_buffer_thread, NULL, async_buffer_task, h);
+        if (ret) {
+            av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(ret));
+            goto thread_fail;
+        }
     }
 
     return 0;
 
 thread_fail:
+    pthread_cond_destroy(&c->cond_wakeup_range);
+cond_wakeup_range_fail:
     pthread_cond_destroy(&c->cond_wakeup_background);
 cond_wakeup_background_fail:
     pthread_cond_destroy(&c->cond_wakeup_main);
@@ -295,6 +1413,8 @@ cond_wakeup_main_fail:
 mutex_fail:
     ffurl_close(c->inner);
 url_fail:
+    av_freep(&c->url);
+    av_dict_free(&c->open_opts);
     ring_destroy(&c->ring);
 fifo_fail:
     return ret;
@@ -303,21 +1423,43 @@ fifo_fail:
 static int async_close(URLContext *h)
 {
     Context *c = h->priv_data;
-    int      ret;
+    int      i, ret;
 
     pthread_mutex_lock(&c->mutex);
     c->abort_request = 1;
-    pthread_cond_signal(&c->cond_wakeup_background);
+    async_wakeup_background(c);
+    pthread_cond_broadcast(&c->cond_wakeup_range);
     pthread_mutex_unlock(&c->mutex);
 
-    ret = pthread_join(c->async_buffer_thread, NULL);
-    if (ret != 0)
-        av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
+    if (c->reactor) {
+        ff_io_reactor_join(&c->reactor);
+    } else {
+        ret = pthread_join(c->async_buffer_thread, NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
+    }
+
+    for (i = 0; i < c->range_nb_threads; i++) {
+        ret = pthread_join(c->range_threads[i], NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
+    }
+    if (c->tail_thread_started) {
+        ret = pthread_join(c->tail_thread, NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
+    }
+    for (i = 0; i < RANGE_MAX_CHUNKS; i++)
+        av_freep(&c->range_chunks[i].buf);
+    av_freep(&c->tail.buf);
 
+    pthread_cond_destroy(&c->cond_wakeup_range);
     pthread_cond_destroy(&c->cond_wakeup_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
     ffurl_close(c->inner);
+    av_freep(&c->url);
+    av_dict_free(&c->open_opts);
     ring_destroy(&c->ring);
 
     return 0;
@@ -360,18 +1502,62 @@ static int async_read_internal(URLContext *h, void *dest, int size, int read_com
             }
             break;
         }
-        pthread_cond_signal(&c->cond_wakeup_background);
+        async_wakeup_background(c);
         pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
-    pthread_cond_signal(&c->cond_wakeup_background);
+    async_wakeup_background(c);
     pthread_mutex_unlock(&c->mutex);
 
     return ret;
 }
 
+static int async_read_tail(URLContext *h, unsigned char *buf, int size)
+{
+    Context    *c      = h->priv_data;
+    RangeChunk *tail   = &c->tail;
+    int64_t     offset = c->logical_pos - tail->start;
+    int         ret;
+
+    pthread_mutex_lock(&c->mutex);
+    while (1) {
+        if (async_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (offset < tail->filled) {
+            ret = FFMIN(size, tail->filled - offset);
+            memcpy(buf, tail->buf + offset, ret);
+            c->logical_pos += ret;
+            break;
+        }
+        if (offset >= tail->size || tail->state == RANGE_CHUNK_DONE) {
+            ret = tail->start + offset >= c->logical_size ? AVERROR_EOF : AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence);
+
 static int async_read(URLContext *h, unsigned char *buf, int size)
 {
+    Context *c = h->priv_data;
+    int64_t  ret;
+
+    if (c->in_tail) {
+        ret = async_read_tail(h, buf, size);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+        // past what the tail holds, carry on from the ring
+        ret = async_seek(h, c->logical_pos, SEEK_SET);
+        if (ret < 0)
+            return ret;
+    }
     return async_read_internal(h, buf, size, 0, NULL);
 }
 
@@ -387,6 +1573,7 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     int64_t       new_logical_pos;
     int fifo_size;
     int fifo_size_of_read_back;
+    int in_tail;
 
     if (whence == AVSEEK_SIZE) {
         av_log(h, AV_LOG_TRACE, "async_seek: AVSEEK_SIZE: %"PRId64"\n", (int64_t)c->logical_size);
@@ -403,13 +1590,31 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     if (new_logical_pos < 0)
         return AVERROR(EINVAL);
 
+    /* the tail is read without moving the ring, which is back where it was
+     * on leaving the tail */
+    pthread_mutex_lock(&c->mutex);
+    in_tail = async_tail_contains(c, new_logical_pos);
+    pthread_mutex_unlock(&c->mutex);
+    if (in_tail) {
+        if (!c->in_tail) {
+            c->ring_pos = c->logical_pos;
+            c->in_tail  = 1;
+        }
+        c->logical_pos = new_logical_pos;
+        return new_logical_pos;
+    }
+    if (c->in_tail) {
+        c->in_tail     = 0;
+        c->logical_pos = c->ring_pos;
+    }
+
     fifo_size = ring_size(ring);
     fifo_size_of_read_back = ring_size_of_read_back(ring);
     if (new_logical_pos == c->logical_pos) {
         /* current position */
         return c->logical_pos;
     } else if ((new_logical_pos >= (c->logical_pos - fifo_size_of_read_back)) &&
-               (new_logical_pos < (c->logical_pos + fifo_size + SHORT_SEEK_THRESHOLD))) {
+               (new_logical_pos < (c->logical_pos + fifo_size + c->short_seek_threshold))) {
         int pos_delta = (int)(new_logical_pos - c->logical_pos);
         /* fast seek */
         av_log(h, AV_LOG_TRACE, "async_seek: fask_seek %"PRId64" from %d dist:%d/%d\n",
@@ -453,7 +1658,7 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
             ret = c->seek_ret;
             break;
         }
-        pthread_cond_signal(&c->cond_wakeup_background);
+        async_wakeup_background(c);
         pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
     }
 
@@ -466,6 +1671,34 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "buffer_file_dir",        "buffer in a memory mapped file in this directory instead of the heap",
+        OFFSET(buffer_file_dir),        AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "buffer_file_capacity",   "read ahead size of the buffer file",
+        OFFSET(buffer_file_capacity),   AV_OPT_TYPE_INT, { .i64 = BUFFER_FILE_CAPACITY },  1024 * 1024, INT_MAX / 4, D },
+    { "buffer_file_read_back",  "read back size of the buffer file",
+        OFFSET(buffer_file_read_back),  AV_OPT_TYPE_INT, { .i64 = BUFFER_FILE_READ_BACK }, 0, INT_MAX / 4, D },
+    { "buffer_file_hot_size",   "bytes written to the buffer file before they are written back",
+        OFFSET(buffer_file_hot_size),   AV_OPT_TYPE_INT, { .i64 = BUFFER_FILE_HOT_SIZE },  64 * 1024, INT_MAX, D },
+    { "read_ahead_seconds",     "stop downloading once this many seconds of media are buffered, 0 to fill the buffer",
+        OFFSET(read_ahead_seconds),     AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "read_ahead_bit_rate",    "stream bit rate to use until the application reports one",
+        OFFSET(read_ahead_bit_rate),    AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "parallel_connections",   "download large http resources over up to this many range requests at once, 1 to disable",
+        OFFSET(range_connections_max),  AV_OPT_TYPE_INT, { .i64 = 1 }, 1, RANGE_MAX_CONNECTIONS, D },
+    { "parallel_chunk_size",    "bytes per range request",
+        OFFSET(range_chunk_size),       AV_OPT_TYPE_INT, { .i64 = RANGE_CHUNK_SIZE }, 64 * 1024, 16 * 1024 * 1024, D },
+    { "parallel_min_size",      "smallest resource to download in ranges",
+        OFFSET(range_min_size),         AV_OPT_TYPE_INT64, { .i64 = RANGE_MIN_SIZE }, 0, INT64_MAX, D },
+    { "tail_prefetch_size",     "bytes to fetch ahead from the moov box at the end of an http mp4, 0 to disable",
+        OFFSET(tail_prefetch_size),     AV_OPT_TYPE_INT, { .i64 = TAIL_PREFETCH_SIZE }, 0, INT_MAX / 4, D },
+    { "read_chunk_size",        "most bytes to read from the inner protocol at once",
+        OFFSET(read_chunk_size),        AV_OPT_TYPE_INT, { .i64 = READ_CHUNK_SIZE }, 4096, 16 * 1024 * 1024, D },
+    { "avio_buffer_size",       "size of the buffer of the AVIOContext reading from the ring, 0 for the default",
+        OFFSET(avio_buffer_size),       AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 16 * 1024 * 1024, D },
+    { "io_reactor",             "download on the shared reactor threads instead of a thread of its own",
+        OFFSET(use_reactor),            AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
+    { "ijkapplication",         "AVApplicationContext",
+        OFFSET(app_ctx_intptr),         AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, D },
     {NULL},
 };
 
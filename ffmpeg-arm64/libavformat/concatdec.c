@@ -23,6 +23,8 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -33,10 +35,13 @@ typedef enum ConcatMatchMode {
     MATCH_EXACT_ID,
 } ConcatMatchMode;
 
+#define FOLLOW_INTERVAL 1000000
+
 typedef struct ConcatStream {
     AVBitStreamFilterContext *bsf;
     AVCodecContext *avctx;
     int out_stream_index;
+    int extradata_changed;  ///< sent with the first packet, the decoder goes on otherwise
 } ConcatStream;
 
 typedef struct {
@@ -57,6 +62,7 @@ typedef struct {
     ConcatFile *files;
     ConcatFile *cur_file;
     unsigned nb_files;
+    unsigned nb_files_alloc;
     AVFormatContext *avf;
     int safe;
     int seekable;
@@ -66,6 +72,21 @@ typedef struct {
     int segment_time_metadata;
     AVDictionary *options;
     int error;
+
+    /* the next file, opened and probed while the current one plays */
+    int preload;
+#if HAVE_THREADS
+    pthread_t preload_thread;
+#endif
+    int preload_running;
+    int preload_abort;
+    unsigned preload_fileno;
+    AVFormatContext *preload_avf;
+    int preload_ret;
+
+    /* the script is read again for the files appended as the last one plays */
+    int follow;
+    int64_t last_refresh;
 } ConcatContext;
 
 static int concat_probe(AVProbeData *probe)
@@ -163,11 +184,16 @@ fail:
     return ret;
 }
 
+/* Returns 1 if the extradata of st changed, for the decoder to reconfigure. */
 static int copy_stream_props(AVStream *st, AVStream *source_st)
 {
     int ret;
 
     if (st->codecpar->codec_id || !source_st->codecpar->codec_id) {
+        int changed = st->codecpar->codec_id &&
+                      (st->codecpar->extradata_size != source_st->codecpar->extradata_size ||
+                       memcmp(st->codecpar->extradata, source_st->codecpar->extradata,
+                              source_st->codecpar->extradata_size));
         if (st->codecpar->extradata_size < source_st->codecpar->extradata_size) {
             if (st->codecpar->extradata) {
                 av_freep(&st->codecpar->extradata);
@@ -180,7 +206,8 @@ static int copy_stream_props(AVStream *st, AVStream *source_st)
         }
         memcpy(st->codecpar->extradata, source_st->codecpar->extradata,
                source_st->codecpar->extradata_size);
-        return 0;
+        st->codecpar->extradata_size = source_st->codecpar->extradata_size;
+        return changed;
     }
     if ((ret = avcodec_parameters_copy(st->codecpar, source_st->codecpar)) < 0)
         return ret;
@@ -247,7 +274,8 @@ static int match_streams_one_to_one(AVFormatContext *avf)
         }
         if ((ret = copy_stream_props(st, cat->avf->streams[i])) < 0)
             return ret;
-        cat->cur_file->streams[i].out_stream_index = i;
+        cat->cur_file->streams[i].out_stream_index  = i;
+        cat->cur_file->streams[i].extradata_changed = ret;
     }
     return 0;
 }
@@ -267,7 +295,8 @@ static int match_streams_exact_id(AVFormatContext *avf)
                        i, j, st->id);
                 if ((ret = copy_stream_props(avf->streams[j], st)) < 0)
                     return ret;
-                cat->cur_file->streams[i].out_stream_index = j;
+                cat->cur_file->streams[i].out_stream_index  = j;
+                cat->cur_file->streams[i].extradata_changed = ret;
             }
         }
     }
@@ -311,7 +340,17 @@ static int match_streams(AVFormatContext *avf)
     return 0;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+static int preload_check_interrupt(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    return cat->preload_abort || ff_check_interrupt(&avf->interrupt_callback);
+}
+
+/* Opens and probes a file, touching nothing else: also runs on the preload thread. */
+static int open_input(AVFormatContext *avf, unsigned fileno, AVFormatContext **pavf,
+                      int preload)
 {
     ConcatContext *cat = avf->priv_data;
     ConcatFile *file = &cat->files[fileno];
@@ -321,15 +360,23 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
     AVDictionaryEntry *t = NULL;
     int fps_flag = 0;
 
+    *pavf = NULL;
     new_avf = avformat_alloc_context();
     if (!new_avf)
         return AVERROR(ENOMEM);
 
     new_avf->flags |= avf->flags;
-    new_avf->interrupt_callback = avf->interrupt_callback;
+    if (preload) {
+        new_avf->interrupt_callback.callback = preload_check_interrupt;
+        new_avf->interrupt_callback.opaque   = avf;
+    } else {
+        new_avf->interrupt_callback = avf->interrupt_callback;
+    }
 
-    if ((ret = ff_copy_whiteblacklists(new_avf, avf)) < 0)
+    if ((ret = ff_copy_whiteblacklists(new_avf, avf)) < 0) {
+        avformat_free_context(new_avf);
         return ret;
+    }
 
     if (cat->options)
         av_dict_copy(&tmp, cat->options, 0);
@@ -348,13 +395,89 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
     av_dict_free(&tmp);
     if (ret < 0 ||
         (ret = avformat_find_stream_info(new_avf, NULL)) < 0) {
-        av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
+        if (!(preload && cat->preload_abort))
+            av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
         avformat_close_input(&new_avf);
         return ret;
     }
 
-    if (!new_avf)
-        return 0;
+    *pavf = new_avf;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *preload_task(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    cat->preload_ret = open_input(avf, cat->preload_fileno, &cat->preload_avf, 1);
+    return NULL;
+}
+#endif
+
+static void start_preload(AVFormatContext *avf, unsigned fileno)
+{
+#if HAVE_THREADS
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    if (!cat->preload || cat->preload_running || fileno >= cat->nb_files)
+        return;
+
+    cat->preload_fileno = fileno;
+    cat->preload_avf    = NULL;
+    cat->preload_abort  = 0;
+    ret = pthread_create(&cat->preload_thread, NULL, preload_task, avf);
+    if (ret) {
+        av_log(avf, AV_LOG_WARNING, "pthread_create failed: %s, no preload\n",
+               av_err2str(AVERROR(ret)));
+        return;
+    }
+    cat->preload_running = 1;
+#endif
+}
+
+/* Waits for the preload; discard interrupts it and drops the file. */
+static void finish_preload(AVFormatContext *avf, int discard)
+{
+#if HAVE_THREADS
+    ConcatContext *cat = avf->priv_data;
+
+    if (!cat->preload_running)
+        return;
+
+    if (discard)
+        cat->preload_abort = 1;
+    pthread_join(cat->preload_thread, NULL);
+    cat->preload_running = 0;
+    cat->preload_abort   = 0;
+    if (discard)
+        avformat_close_input(&cat->preload_avf);
+#endif
+}
+
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    AVFormatContext *new_avf = NULL;
+    int ret;
+
+    if (cat->preload_running && cat->preload_fileno == fileno) {
+        finish_preload(avf, 0);
+        new_avf = cat->preload_avf;
+        cat->preload_avf = NULL;
+        if ((ret = cat->preload_ret) < 0)
+            return ret;
+        /* its io still checks preload_abort, set only on this thread to drop a preload */
+        new_avf->interrupt_callback = avf->interrupt_callback;
+        av_log(avf, AV_LOG_VERBOSE, "Preloaded '%s'\n", file->url);
+    } else {
+        finish_preload(avf, 1);
+        if ((ret = open_input(avf, fileno, &new_avf, 0)) < 0)
+            return ret;
+    }
 
     if (cat->avf)
         avformat_close_input(&cat->avf);
@@ -383,6 +506,7 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
        if ((ret = avformat_seek_file(cat->avf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
            return ret;
     }
+    start_preload(avf, fileno + 1);
     return 0;
 }
 
@@ -391,6 +515,7 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i, j;
 
+    finish_preload(avf, 1);
     for (i = 0; i < cat->nb_files; i++) {
         av_freep(&cat->files[i].url);
         for (j = 0; j < cat->files[i].nb_streams; j++) {
@@ -409,21 +534,25 @@ static int concat_read_close(AVFormatContext *avf)
     return 0;
 }
 
-static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
+/**
+ * Adds the files of the script; refresh skips the files already known, for
+ * those appended since, and the stream directives.
+ */
+static int parse_script(AVFormatContext *avf, AVIOContext *pb, int refresh)
 {
     ConcatContext *cat = avf->priv_data;
     uint8_t buf[4096];
     uint8_t *cursor, *keyword;
-    int ret, line = 0, i;
-    unsigned nb_files_alloc = 0;
+    int ret, line = 0;
+    unsigned seen_files = 0, skip_files = refresh ? cat->nb_files : 0;
+    int skipping = 0;
     ConcatFile *file = NULL;
-    int64_t time = 0;
-
-    if (options && *options)
-        av_dict_copy(&cat->options, *options, 0);
 
     while (1) {
-        if ((ret = ff_get_line(avf->pb, buf, sizeof(buf))) <= 0)
+        if ((ret = ff_get_line(pb, buf, sizeof(buf))) <= 0)
+            break;
+        /* a line still being appended is read again next time */
+        if (refresh && buf[ret - 1] != '\n')
             break;
         line++;
         cursor = buf;
@@ -437,11 +566,20 @@ static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
                 av_log(avf, AV_LOG_ERROR, "Line %d: filename required\n", line);
                 FAIL(AVERROR_INVALIDDATA);
             }
-            if ((ret = add_file(avf, filename, &file, &nb_files_alloc)) < 0)
+            if (seen_files++ < skip_files) {
+                av_free(filename);
+                file = NULL;
+                skipping = 1;
+                continue;
+            }
+            skipping = 0;
+            if ((ret = add_file(avf, filename, &file, &cat->nb_files_alloc)) < 0)
                 goto fail;
         } else if (!strcmp(keyword, "duration") || !strcmp(keyword, "inpoint") || !strcmp(keyword, "outpoint")) {
             char *dur_str = get_keyword(&cursor);
             int64_t dur;
+            if (skipping)
+                continue;
             if (!file) {
                 av_log(avf, AV_LOG_ERROR, "Line %d: %s without file\n",
                        line, keyword);
@@ -460,6 +598,8 @@ static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
                 file->outpoint = dur;
         } else if (!strcmp(keyword, "file_packet_metadata")) {
             char *metadata;
+            if (skipping)
+                continue;
             if (!file) {
                 av_log(avf, AV_LOG_ERROR, "Line %d: %s without file\n",
                        line, keyword);
@@ -476,6 +616,8 @@ static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
                 FAIL(AVERROR_INVALIDDATA);
             }
             av_freep(&metadata);
+        } else if (refresh && (!strcmp(keyword, "stream") || !strcmp(keyword, "exact_stream_id"))) {
+            continue;
         } else if (!strcmp(keyword, "stream")) {
             if (!avformat_new_stream(avf, NULL))
                 FAIL(AVERROR(ENOMEM));
@@ -504,8 +646,18 @@ static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
     }
     if (ret < 0)
         goto fail;
-    if (!cat->nb_files)
-        FAIL(AVERROR_INVALIDDATA);
+    return 0;
+
+fail:
+    return ret;
+}
+
+/* The start times and the duration, as far as the durations are known. */
+static void update_times(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    int64_t time = 0;
+    unsigned i;
 
     for (i = 0; i < cat->nb_files; i++) {
         if (cat->files[i].start_time == AV_NOPTS_VALUE)
@@ -519,10 +671,25 @@ static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
         }
         time += cat->files[i].duration;
     }
-    if (i == cat->nb_files) {
+    cat->seekable = i == cat->nb_files;
+    if (cat->seekable)
         avf->duration = time;
-        cat->seekable = 1;
-    }
+}
+
+static int concat_read_header(AVFormatContext *avf, AVDictionary **options)
+{
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    if (options && *options)
+        av_dict_copy(&cat->options, *options, 0);
+
+    if ((ret = parse_script(avf, avf->pb, 0)) < 0)
+        goto fail;
+    if (!cat->nb_files)
+        FAIL(AVERROR_INVALIDDATA);
+
+    update_times(avf);
 
     cat->stream_match_mode = avf->nb_streams ? MATCH_EXACT_ID :
                                                MATCH_ONE_TO_ONE;
@@ -535,6 +702,30 @@ fail:
     return ret;
 }
 
+/* Never while preloading: the files may move. */
+static int refresh_files(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    unsigned fileno = cat->cur_file - cat->files;
+    unsigned nb_files = cat->nb_files;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    av_assert0(!cat->preload_running);
+    cat->last_refresh = av_gettime_relative();
+    if ((ret = avf->io_open(avf, &pb, avf->filename, AVIO_FLAG_READ, NULL)) < 0)
+        return ret;
+    ret = parse_script(avf, pb, 1);
+    ff_format_io_close(avf, &pb);
+
+    cat->cur_file = &cat->files[fileno];
+    if (cat->nb_files > nb_files) {
+        av_log(avf, AV_LOG_VERBOSE, "%u files appended\n", cat->nb_files - nb_files);
+        update_times(avf);
+    }
+    return ret;
+}
+
 static int open_next_file(AVFormatContext *avf)
 {
     ConcatContext *cat = avf->priv_data;
@@ -543,6 +734,8 @@ static int open_next_file(AVFormatContext *avf)
     if (cat->cur_file->duration == AV_NOPTS_VALUE)
         cat->cur_file->duration = cat->avf->duration - (cat->cur_file->file_inpoint - cat->cur_file->file_start_time);
 
+    if (cat->follow && fileno + 1 >= cat->nb_files && refresh_files(avf) < 0)
+        av_log(avf, AV_LOG_WARNING, "Cannot read the script again\n");
     if (++fileno >= cat->nb_files) {
         cat->eof = 1;
         return AVERROR_EOF;
@@ -638,6 +831,14 @@ static int concat_read_packet(AVFormatContext *avf, AVPacket *pkt)
     if (!cat->avf)
         return AVERROR(EIO);
 
+    /* the next file, once appended, is preloaded as any other */
+    if (cat->follow && !cat->preload_running &&
+        cat->cur_file - cat->files + 1 >= cat->nb_files &&
+        av_gettime_relative() - cat->last_refresh >= FOLLOW_INTERVAL) {
+        if (refresh_files(avf) >= 0)
+            start_preload(avf, cat->cur_file - cat->files + 1);
+    }
+
     while (1) {
         ret = av_read_frame(cat->avf, pkt);
         if (ret == AVERROR_EOF) {
@@ -685,6 +886,15 @@ open_fail:
     }
     if ((ret = filter_packet(avf, cs, pkt)))
         return ret;
+    /* the bitstream filter repeats the parameter sets in band */
+    if (cs->extradata_changed && !cs->bsf) {
+        AVCodecParameters *par = avf->streams[cs->out_stream_index]->codecpar;
+        uint8_t *side = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, par->extradata_size);
+        if (!side)
+            return AVERROR(ENOMEM);
+        memcpy(side, par->extradata, par->extradata_size);
+        cs->extradata_changed = 0;
+    }
 
     st = cat->avf->streams[pkt->stream_index];
     av_log(avf, AV_LOG_DEBUG, "file:%d stream:%d pts:%s pts_time:%s dts:%s dts_time:%s",
@@ -831,6 +1041,10 @@ static const AVOption options[] = {
       OFFSET(auto_convert), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
     { "segment_time_metadata", "output file segment start time and duration as packet metadata",
       OFFSET(segment_time_metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "preload", "open and probe the next file while the current one is read",
+      OFFSET(preload), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
+    { "follow", "read the script again for the files appended to it while the last one is read",
+      OFFSET(follow), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
     { NULL }
 };
 
@@ -0,0 +1,2138 @@
+/*
+ * Dynamic Adaptive Streaming over HTTP demuxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * MPEG-DASH demuxer
+ * @see ISO/IEC 23009-1
+ *
+ * The first video and the first audio AdaptationSet of every Period are
+ * read, each Representation through a demuxer of its own fed by read_data(),
+ * the way the HLS demuxer reads its variants. Segments are addressed with a
+ * SegmentTemplate, with or without SegmentTimeline, a SegmentList or a
+ * SegmentBase.
+ */
+
+#include <libxml/parser.h>
+
+#include "libavutil/application.h"
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/dict.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "internal.h"
+#include "avio_internal.h"
+#include "hls_prefetch.h"
+#include "url.h"
+
+#define INITIAL_BUFFER_SIZE 32768
+#define MAX_INIT_SECTION_SIZE   (1024 * 1024)
+#define MAX_MANIFEST_SIZE       (4 * 1024 * 1024)
+#define MAX_TIMELINE_ENTRIES    (1 << 18)
+
+#define ABR_MIN_SAMPLE_BYTES    (16 * 1024)
+#define ABR_UPSWITCH_BUFFER     10000   /* ms buffered before switching up */
+#define ABR_HOLD_BUFFER         20000   /* ms buffered to ride out a throughput dip */
+#define ABR_PANIC_BUFFER        3000    /* ms buffered below which the estimate is halved */
+
+#define LIVE_START_SEGMENTS     3       /* behind the live edge without suggestedPresentationDelay */
+
+struct timeline {
+    int64_t start;              ///< in timescale units
+    int64_t duration;
+};
+
+struct segment_url {
+    char *url;
+    int64_t offset;
+    int64_t size;               ///< -1 up to the end of the resource
+};
+
+/* where the segments of a Representation are, replaced on manifest reloads */
+struct addressing {
+    char *media;                ///< SegmentTemplate@media, NULL for a SegmentList or SegmentBase
+    char *init_url;             ///< initialization segment, NULL if there is none
+    int64_t init_offset;
+    int64_t init_size;
+    int64_t start_number;
+    int64_t timescale;
+    int64_t duration;           ///< of every segment, 0 with a SegmentTimeline
+    int64_t pto;                ///< presentationTimeOffset
+    struct timeline *timeline;
+    int n_timeline;
+    struct segment_url *urls;   ///< SegmentList, or the whole resource for SegmentBase
+    int n_urls;
+};
+
+struct period;
+struct track;
+
+struct representation {
+    char *id;
+    char *base_url;
+    enum AVMediaType type;
+    int bandwidth;
+    struct addressing addr;
+    struct period *period;
+    AVFormatContext *parent;
+    struct track *track;        ///< reading this representation, NULL otherwise
+
+    AVFormatContext *ctx;
+    AVIOContext pb;
+    uint8_t *read_buffer;
+    AVIOContext *input;
+    HLSPrefetch *prefetch;
+    HLSPrefetchSegment *prefetch_seg;
+    int64_t cur_seq_no;
+    int64_t cur_seg_offset;
+    int64_t cur_seg_size;
+    int64_t download_bytes;
+    int64_t download_time;
+
+    char *init_sec_url;         ///< where init_sec_buf was loaded from
+    int64_t init_sec_offset;
+    uint8_t *init_sec_buf;
+    unsigned int init_sec_buf_size;
+    int init_sec_data_len;
+    int init_sec_buf_read_offset;
+
+    AVPacket pkt;
+    AVStream **main_streams;
+    int n_main_streams;
+    int64_t seek_timestamp;
+    int seek_flags;
+};
+
+struct period {
+    char *id;
+    int64_t start;              ///< AV_TIME_BASE, from the start of the presentation
+    int64_t duration;           ///< AV_TIME_BASE, AV_NOPTS_VALUE if open ended
+    int seen;                   ///< listed by the last manifest loaded
+    struct representation **videos;     ///< by increasing bandwidth
+    int n_videos;
+    struct representation **audios;
+    int n_audios;
+};
+
+/* a media type exported to the caller, read from one representation at a time */
+struct track {
+    enum AVMediaType type;
+    struct representation *rep;
+    struct representation *next;        ///< continue with it once rep has drained
+    int64_t next_seq_no;
+    int abr_switch;                     ///< next is an abr decision, not the next period
+    AVStream **streams;
+    int n_streams;
+};
+
+typedef struct DASHContext {
+    AVClass *class;
+    AVFormatContext *ctx;
+    char *manifest_url;                 ///< MPD@Location once there is one
+    int is_live;
+    int64_t media_presentation_duration;
+    int64_t availability_start_time;    ///< microseconds since the epoch
+    int64_t minimum_update_period;
+    int64_t time_shift_buffer_depth;
+    int64_t suggested_presentation_delay;
+    int64_t last_load_time;
+    struct period **periods;
+    int n_periods;
+    struct track tracks[2];
+    int n_tracks;
+
+    AVIOInterruptCB *interrupt_callback;
+    AVDictionary *avio_opts;
+    char *user_agent;                   ///< holds HTTP user agent set as an AVOption to the HTTP protocol context
+    char *cookies;                      ///< holds HTTP cookie values set in either the initial response or as an AVOption to the HTTP protocol context
+    char *headers;                      ///< holds HTTP headers set as an AVOption to the HTTP protocol context
+    char *http_proxy;                   ///< holds the address of the HTTP proxy server
+    AVApplicationContext *app_ctx;
+
+    int prefetch_segments;
+    int prefetch_max_size;
+
+    /* adaptive representation selection, see abr_check_switch() */
+    int abr;
+    int64_t abr_fast_bandwidth;         ///< bits per second
+    int64_t abr_slow_bandwidth;
+    int64_t abr_buffered_milli;         ///< buffer level at the switch decision
+} DASHContext;
+
+static void reset_packet(AVPacket *pkt)
+{
+    av_init_packet(pkt);
+    pkt->data = NULL;
+}
+
+static void free_addressing(struct addressing *a)
+{
+    int i;
+
+    for (i = 0; i < a->n_urls; i++)
+        av_freep(&a->urls[i].url);
+    av_freep(&a->urls);
+    av_freep(&a->timeline);
+    av_freep(&a->media);
+    av_freep(&a->init_url);
+    a->n_urls     = 0;
+    a->n_timeline = 0;
+}
+
+static void stop_prefetch(struct representation *rep)
+{
+    if (!rep->prefetch)
+        return;
+    ff_hls_prefetch_release(rep->prefetch, &rep->prefetch_seg);
+    ff_hls_prefetch_cancel_outside(rep->prefetch, INT_MAX, INT_MIN);
+}
+
+static void close_demuxer(struct representation *rep)
+{
+    stop_prefetch(rep);
+    if (rep->input)
+        ff_format_io_close(rep->parent, &rep->input);
+    av_packet_unref(&rep->pkt);
+    reset_packet(&rep->pkt);
+    avformat_close_input(&rep->ctx);
+    av_freep(&rep->pb.buffer);
+    memset(&rep->pb, 0, sizeof(rep->pb));
+    av_freep(&rep->main_streams);
+    rep->n_main_streams = 0;
+    // the next demuxer gets the same initialization segment
+    rep->init_sec_buf_read_offset = 0;
+}
+
+static void free_representation(struct representation **prep)
+{
+    struct representation *rep = *prep;
+
+    if (!rep)
+        return;
+    close_demuxer(rep);
+    ff_hls_prefetch_freep(&rep->prefetch);
+    av_freep(&rep->init_sec_buf);
+    av_freep(&rep->init_sec_url);
+    free_addressing(&rep->addr);
+    av_freep(&rep->id);
+    av_freep(&rep->base_url);
+    av_freep(prep);
+}
+
+static void free_period(struct period **pperiod)
+{
+    struct period *p = *pperiod;
+    int i;
+
+    if (!p)
+        return;
+    for (i = 0; i < p->n_videos; i++)
+        free_representation(&p->videos[i]);
+    for (i = 0; i < p->n_audios; i++)
+        free_representation(&p->audios[i]);
+    av_freep(&p->videos);
+    av_freep(&p->audios);
+    av_freep(&p->id);
+    av_freep(pperiod);
+}
+
+static void free_period_list(struct period ***pperiods, int *n_periods)
+{
+    int i;
+
+    for (i = 0; i < *n_periods; i++)
+        free_period(&(*pperiods)[i]);
+    av_freep(pperiods);
+    *n_periods = 0;
+}
+
+/* keep the list sorted by increasing bandwidth */
+static int add_representation(struct representation ***preps, int *n_reps,
+                              struct representation *rep)
+{
+    int i, ret;
+
+    if ((ret = av_reallocp_array(preps, *n_reps + 1, sizeof(**preps))) < 0) {
+        *n_reps = 0;
+        return ret;
+    }
+    for (i = *n_reps; i > 0 && (*preps)[i - 1]->bandwidth > rep->bandwidth; i--)
+        (*preps)[i] = (*preps)[i - 1];
+    (*preps)[i] = rep;
+    (*n_reps)++;
+    return 0;
+}
+
+/* ISO 8601 duration, e.g. PT1M30.5S, in AV_TIME_BASE units */
+static int64_t parse_duration(const char *str)
+{
+    int64_t total = 0;
+    int in_time = 0;
+
+    if (*str++ != 'P')
+        return AV_NOPTS_VALUE;
+    while (*str) {
+        char *end;
+        double v;
+
+        if (*str == 'T') {
+            in_time = 1;
+            str++;
+            continue;
+        }
+        v = strtod(str, &end);
+        if (end == str)
+            return AV_NOPTS_VALUE;
+        switch (*end) {
+        case 'Y': v *= 365 * 86400;                 break;
+        case 'M': v *= in_time ? 60 : 30 * 86400;   break;
+        case 'W': v *= 7 * 86400;                   break;
+        case 'D': v *= 86400;                       break;
+        case 'H': v *= 3600;                        break;
+        case 'S':                                   break;
+        default:  return AV_NOPTS_VALUE;
+        }
+        total += llrint(v * AV_TIME_BASE);
+        str = end + 1;
+    }
+    return total;
+}
+
+static int is_element(xmlNodePtr node, const char *name)
+{
+    return node->type == XML_ELEMENT_NODE && !av_strcasecmp((const char *)node->name, name);
+}
+
+static xmlNodePtr find_child(xmlNodePtr node, const char *name)
+{
+    for (node = node ? node->children : NULL; node; node = node->next) {
+        if (is_element(node, name))
+            return node;
+    }
+    return NULL;
+}
+
+static char *get_prop(xmlNodePtr node, const char *name)
+{
+    xmlChar *val = node ? xmlGetProp(node, (const xmlChar *)name) : NULL;
+    char *ret;
+
+    if (!val)
+        return NULL;
+    ret = av_strdup((const char *)val);
+    xmlFree(val);
+    return ret;
+}
+
+static int64_t get_prop_int(xmlNodePtr node, const char *name, int64_t def)
+{
+    xmlChar *val = node ? xmlGetProp(node, (const xmlChar *)name) : NULL;
+
+    if (val) {
+        def = strtoll((const char *)val, NULL, 10);
+        xmlFree(val);
+    }
+    return def;
+}
+
+static int64_t get_prop_duration(xmlNodePtr node, const char *name)
+{
+    xmlChar *val = node ? xmlGetProp(node, (const xmlChar *)name) : NULL;
+    int64_t ret = AV_NOPTS_VALUE;
+
+    if (val) {
+        ret = parse_duration((const char *)val);
+        xmlFree(val);
+    }
+    return ret;
+}
+
+/* byte range "first-last", size -1 if there is none */
+static void get_prop_range(xmlNodePtr node, const char *name, int64_t *offset, int64_t *size)
+{
+    xmlChar *val = node ? xmlGetProp(node, (const xmlChar *)name) : NULL;
+    int64_t first, last;
+
+    *offset = 0;
+    *size   = -1;
+    if (!val)
+        return;
+    if (sscanf((const char *)val, "%"SCNd64"-%"SCNd64, &first, &last) == 2 && last >= first) {
+        *offset = first;
+        *size   = last - first + 1;
+    }
+    xmlFree(val);
+}
+
+/* rel resolved against base, both may be NULL */
+static char *make_url(const char *base, const char *rel)
+{
+    char buf[MAX_URL_SIZE];
+    size_t len;
+
+    if (!rel)
+        return av_strdup(base);
+    rel += strspn(rel, " \t\r\n");
+    ff_make_absolute_url(buf, sizeof(buf), base, rel);
+    len = strlen(buf);
+    while (len && strchr(" \t\r\n", buf[len - 1]))
+        buf[--len] = '\0';
+    return av_strdup(buf);
+}
+
+/* the BaseURL of node resolved against base */
+static char *get_base_url(xmlNodePtr node, const char *base)
+{
+    xmlNodePtr n = find_child(node, "BaseURL");
+    xmlChar *rel = n ? xmlNodeGetContent(n) : NULL;
+    char *ret;
+
+    ret = make_url(base, (const char *)rel);
+    if (rel)
+        xmlFree(rel);
+    return ret;
+}
+
+/*
+ * SegmentTemplate, SegmentList and SegmentBase are inherited from the
+ * Period and AdaptationSet, attribute by attribute; chain holds the
+ * element at these levels and at the Representation, NULL where missing.
+ */
+static xmlChar *get_inherited_prop(xmlNodePtr *chain, const char *name)
+{
+    int i;
+
+    for (i = 2; i >= 0; i--) {
+        xmlChar *val = chain[i] ? xmlGetProp(chain[i], (const xmlChar *)name) : NULL;
+        if (val)
+            return val;
+    }
+    return NULL;
+}
+
+static int64_t get_inherited_int(xmlNodePtr *chain, const char *name, int64_t def)
+{
+    xmlChar *val = get_inherited_prop(chain, name);
+
+    if (val) {
+        def = strtoll((const char *)val, NULL, 10);
+        xmlFree(val);
+    }
+    return def;
+}
+
+static xmlNodePtr get_inherited_child(xmlNodePtr *chain, const char *name)
+{
+    int i;
+
+    for (i = 2; i >= 0; i--) {
+        xmlNodePtr n = find_child(chain[i], name);
+        if (n)
+            return n;
+    }
+    return NULL;
+}
+
+static int template_id(const char *id, size_t len, const char *name)
+{
+    return len == strlen(name) && !strncmp(id, name, len);
+}
+
+/* expand $RepresentationID$, $Number$, $Bandwidth$ and $Time$ */
+static char *fill_template(struct representation *rep, const char *tmpl,
+                           int64_t number, int64_t time)
+{
+    AVBPrint bp;
+    const char *p = tmpl;
+    char *ret = NULL;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while (*p) {
+        const char *end, *fmt;
+        size_t len;
+        int width = 1;
+
+        if (*p != '$') {
+            av_bprint_chars(&bp, *p++, 1);
+            continue;
+        }
+        if (!(end = strchr(p + 1, '$'))) {
+            av_bprintf(&bp, "%s", p);
+            break;
+        }
+        p++;
+        fmt = memchr(p, '%', end - p);
+        len = (fmt ? fmt : end) - p;
+        if (fmt)
+            width = FFMAX(atoi(fmt + 1), 1);
+
+        if (!len)
+            av_bprint_chars(&bp, '$', 1);
+        else if (template_id(p, len, "RepresentationID"))
+            av_bprintf(&bp, "%s", rep->id ? rep->id : "");
+        else if (template_id(p, len, "Number"))
+            av_bprintf(&bp, "%0*"PRId64, width, number);
+        else if (template_id(p, len, "Bandwidth"))
+            av_bprintf(&bp, "%0*d", width, rep->bandwidth);
+        else if (template_id(p, len, "Time"))
+            av_bprintf(&bp, "%0*"PRId64, width, time);
+        else
+            av_bprintf(&bp, "$%.*s$", (int)(end - p), p);
+        p = end + 1;
+    }
+    if (av_bprint_is_complete(&bp))
+        ret = make_url(rep->base_url, bp.str);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+static int parse_timeline(struct addressing *a, xmlNodePtr timeline, int64_t period_duration)
+{
+    xmlNodePtr n;
+    int64_t t = 0;
+
+    for (n = timeline->children; n; n = n->next) {
+        int64_t d, r, i;
+        xmlNodePtr next;
+
+        if (!is_element(n, "S"))
+            continue;
+        t = get_prop_int(n, "t", t);
+        d = get_prop_int(n, "d", 0);
+        r = get_prop_int(n, "r", 0);
+        if (d <= 0)
+            return AVERROR_INVALIDDATA;
+        if (r < 0) {
+            /* repeated up to the next S@t, or the end of the period */
+            for (next = n->next; next && !is_element(next, "S"); next = next->next)
+                ;
+            if (next && get_prop_int(next, "t", -1) > t)
+                r = (get_prop_int(next, "t", -1) - t + d - 1) / d - 1;
+            else if (period_duration != AV_NOPTS_VALUE)
+                r = (av_rescale(period_duration, a->timescale, AV_TIME_BASE) + a->pto - t + d - 1) / d - 1;
+            else
+                r = 0;
+        }
+        if (r < 0 || a->n_timeline + r + 1 > MAX_TIMELINE_ENTRIES)
+            return AVERROR_INVALIDDATA;
+        if (av_reallocp_array(&a->timeline, a->n_timeline + r + 1, sizeof(*a->timeline)) < 0) {
+            a->n_timeline = 0;
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i <= r; i++) {
+            a->timeline[a->n_timeline].start    = t;
+            a->timeline[a->n_timeline].duration = d;
+            a->n_timeline++;
+            t += d;
+        }
+    }
+    return a->n_timeline ? 0 : AVERROR_INVALIDDATA;
+}
+
+static int parse_init(struct representation *rep, xmlNodePtr init)
+{
+    struct addressing *a = &rep->addr;
+    char *src = get_prop(init, "sourceURL");
+
+    av_freep(&a->init_url);
+    a->init_url = make_url(rep->base_url, src);
+    av_free(src);
+    if (!a->init_url)
+        return AVERROR(ENOMEM);
+    get_prop_range(init, "range", &a->init_offset, &a->init_size);
+    return 0;
+}
+
+static int parse_segment_list(struct representation *rep, xmlNodePtr list)
+{
+    struct addressing *a = &rep->addr;
+    xmlNodePtr n;
+
+    for (n = list->children; n; n = n->next) {
+        struct segment_url *u;
+        char *media;
+
+        if (!is_element(n, "SegmentURL"))
+            continue;
+        if (av_reallocp_array(&a->urls, a->n_urls + 1, sizeof(*a->urls)) < 0) {
+            a->n_urls = 0;
+            return AVERROR(ENOMEM);
+        }
+        u = &a->urls[a->n_urls++];
+        media  = get_prop(n, "media");
+        u->url = make_url(rep->base_url, media);
+        av_free(media);
+        if (!u->url)
+            return AVERROR(ENOMEM);
+        get_prop_range(n, "mediaRange", &u->offset, &u->size);
+    }
+    return a->n_urls ? 0 : AVERROR_INVALIDDATA;
+}
+
+static int parse_addressing(struct representation *rep, xmlNodePtr *levels,
+                            int64_t period_duration)
+{
+    struct addressing *a = &rep->addr;
+    xmlNodePtr tmpl[3], list[3], base[3], init;
+    xmlChar *val;
+    int i, ret;
+
+    for (i = 0; i < 3; i++) {
+        tmpl[i] = find_child(levels[i], "SegmentTemplate");
+        list[i] = find_child(levels[i], "SegmentList");
+        base[i] = find_child(levels[i], "SegmentBase");
+    }
+
+    if (tmpl[0] || tmpl[1] || tmpl[2]) {
+        xmlNodePtr timeline = get_inherited_child(tmpl, "SegmentTimeline");
+
+        if (!(val = get_inherited_prop(tmpl, "media")))
+            return AVERROR_INVALIDDATA;
+        a->media = av_strdup((const char *)val);
+        xmlFree(val);
+        if (!a->media)
+            return AVERROR(ENOMEM);
+
+        a->timescale    = get_inherited_int(tmpl, "timescale", 1);
+        a->start_number = get_inherited_int(tmpl, "startNumber", 1);
+        a->duration     = get_inherited_int(tmpl, "duration", 0);
+        a->pto          = get_inherited_int(tmpl, "presentationTimeOffset", 0);
+        if (a->timescale <= 0)
+            return AVERROR_INVALIDDATA;
+
+        if ((val = get_inherited_prop(tmpl, "initialization"))) {
+            a->init_url = fill_template(rep, (const char *)val, 0, 0);
+            a->init_size = -1;
+            xmlFree(val);
+            if (!a->init_url)
+                return AVERROR(ENOMEM);
+        } else if ((init = get_inherited_child(tmpl, "Initialization"))) {
+            if ((ret = parse_init(rep, init)) < 0)
+                return ret;
+        }
+
+        if (timeline) {
+            a->duration = 0;
+            return parse_timeline(a, timeline, period_duration);
+        }
+        return a->duration > 0 ? 0 : AVERROR_INVALIDDATA;
+    }
+
+    if (list[0] || list[1] || list[2]) {
+        a->timescale    = get_inherited_int(list, "timescale", 1);
+        a->start_number = get_inherited_int(list, "startNumber", 1);
+        a->duration     = get_inherited_int(list, "duration", 0);
+        a->pto          = get_inherited_int(list, "presentationTimeOffset", 0);
+        if (a->timescale <= 0 || a->duration < 0)
+            return AVERROR_INVALIDDATA;
+        if ((init = get_inherited_child(list, "Initialization")) &&
+            (ret = parse_init(rep, init)) < 0)
+            return ret;
+        for (i = 2; i >= 0 && !list[i]; i--)
+            ;
+        return parse_segment_list(rep, list[i]);
+    }
+
+    /* SegmentBase or nothing: the whole resource is a single segment, read
+     * from its start, the initialization range included */
+    a->timescale    = get_inherited_int(base, "timescale", 1);
+    a->start_number = 1;
+    a->pto          = get_inherited_int(base, "presentationTimeOffset", 0);
+    if (a->timescale <= 0)
+        return AVERROR_INVALIDDATA;
+    if (!(a->urls = av_mallocz(sizeof(*a->urls))))
+        return AVERROR(ENOMEM);
+    a->n_urls       = 1;
+    a->urls[0].size = -1;
+    if (!(a->urls[0].url = av_strdup(rep->base_url)))
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static enum AVMediaType get_media_type(const char *content_type, const char *mime_type)
+{
+    if (content_type && !av_strcasecmp(content_type, "video"))
+        return AVMEDIA_TYPE_VIDEO;
+    if (content_type && !av_strcasecmp(content_type, "audio"))
+        return AVMEDIA_TYPE_AUDIO;
+    if (mime_type && !av_strncasecmp(mime_type, "video/", 6))
+        return AVMEDIA_TYPE_VIDEO;
+    if (mime_type && !av_strncasecmp(mime_type, "audio/", 6))
+        return AVMEDIA_TYPE_AUDIO;
+    return AVMEDIA_TYPE_UNKNOWN;
+}
+
+static enum AVMediaType get_representation_type(xmlNodePtr adapt, xmlNodePtr node)
+{
+    char *content_type = get_prop(adapt, "contentType");
+    char *mime_type    = get_prop(node, "mimeType");
+    enum AVMediaType type;
+
+    if (!mime_type)
+        mime_type = get_prop(adapt, "mimeType");
+    if (!content_type)
+        content_type = get_prop(find_child(adapt, "ContentComponent"), "contentType");
+    type = get_media_type(content_type, mime_type);
+    av_free(content_type);
+    av_free(mime_type);
+    return type;
+}
+
+static int parse_adaptation_set(DASHContext *c, struct period *p, xmlNodePtr period_node,
+                                xmlNodePtr adapt, const char *base_url, enum AVMediaType *type)
+{
+    struct representation ***preps;
+    int *n_reps;
+    char *adapt_base;
+    xmlNodePtr n;
+    int ret = 0;
+
+    if (find_child(adapt, "ContentProtection")) {
+        av_log(c->ctx, AV_LOG_WARNING, "Skipping a protected AdaptationSet\n");
+        return 0;
+    }
+    if (!(adapt_base = get_base_url(adapt, base_url)))
+        return AVERROR(ENOMEM);
+
+    for (n = adapt->children; n; n = n->next) {
+        xmlNodePtr levels[3] = { period_node, adapt, n };
+        struct representation *rep;
+        enum AVMediaType rep_type;
+
+        if (!is_element(n, "Representation"))
+            continue;
+        rep_type = get_representation_type(adapt, n);
+        if (*type == AVMEDIA_TYPE_UNKNOWN &&
+            (rep_type == AVMEDIA_TYPE_VIDEO || rep_type == AVMEDIA_TYPE_AUDIO))
+            *type = rep_type;
+        if (rep_type != *type || find_child(n, "ContentProtection"))
+            continue;
+        preps  = rep_type == AVMEDIA_TYPE_VIDEO ? &p->videos   : &p->audios;
+        n_reps = rep_type == AVMEDIA_TYPE_VIDEO ? &p->n_videos : &p->n_audios;
+
+        if (!(rep = av_mallocz(sizeof(*rep)))) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        rep->parent         = c->ctx;
+        rep->period         = p;
+        rep->type           = rep_type;
+        rep->seek_timestamp = AV_NOPTS_VALUE;
+        rep->id             = get_prop(n, "id");
+        rep->bandwidth      = get_prop_int(n, "bandwidth", 0);
+        rep->base_url       = get_base_url(n, adapt_base);
+        reset_packet(&rep->pkt);
+        ret = rep->base_url ? parse_addressing(rep, levels, p->duration) : AVERROR(ENOMEM);
+        if (ret < 0) {
+            av_log(c->ctx, AV_LOG_WARNING, "Skipping representation '%s' without usable segment addressing\n",
+                   rep->id ? rep->id : "");
+            free_representation(&rep);
+            ret = ret == AVERROR(ENOMEM) ? ret : 0;
+            if (ret < 0)
+                break;
+            continue;
+        }
+        if ((ret = add_representation(preps, n_reps, rep)) < 0) {
+            free_representation(&rep);
+            break;
+        }
+    }
+    av_free(adapt_base);
+    return ret;
+}
+
+static int parse_period(DASHContext *c, struct period *p, xmlNodePtr node, const char *base_url)
+{
+    enum AVMediaType found[2] = { AVMEDIA_TYPE_UNKNOWN, AVMEDIA_TYPE_UNKNOWN };
+    char *period_base;
+    xmlNodePtr n;
+    int ret = 0;
+
+    if (!(period_base = get_base_url(node, base_url)))
+        return AVERROR(ENOMEM);
+    p->id = get_prop(node, "id");
+
+    /* the first video and the first audio AdaptationSet */
+    for (n = node->children; n && ret >= 0; n = n->next) {
+        enum AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+        xmlNodePtr rep = find_child(n, "Representation");
+
+        if (!is_element(n, "AdaptationSet") || !rep)
+            continue;
+        type = get_representation_type(n, rep);
+        if (type == found[0] || type == found[1])
+            continue;
+        if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO)
+            type = AVMEDIA_TYPE_UNKNOWN;
+        ret = parse_adaptation_set(c, p, node, n, period_base, &type);
+        if (type == AVMEDIA_TYPE_VIDEO && p->n_videos)
+            found[0] = type;
+        if (type == AVMEDIA_TYPE_AUDIO && p->n_audios)
+            found[1] = type;
+    }
+    av_free(period_base);
+    return ret;
+}
+
+static int parse_manifest(DASHContext *c, const char *url, const char *buf, int size,
+                          struct period ***pperiods, int *n_periods)
+{
+    xmlDocPtr doc;
+    xmlNodePtr root, n;
+    xmlChar *val;
+    char *type, *base_url = NULL;
+    int64_t start = 0;
+    int ret = 0;
+
+    doc = xmlReadMemory(buf, size, url, NULL, XML_PARSE_NONET);
+    if (!doc)
+        return AVERROR_INVALIDDATA;
+    root = xmlDocGetRootElement(doc);
+    if (!root || !is_element(root, "MPD")) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+
+    type = get_prop(root, "type");
+    c->is_live = type && !strcmp(type, "dynamic");
+    av_free(type);
+    c->media_presentation_duration  = get_prop_duration(root, "mediaPresentationDuration");
+    c->minimum_update_period        = get_prop_duration(root, "minimumUpdatePeriod");
+    c->time_shift_buffer_depth      = get_prop_duration(root, "timeShiftBufferDepth");
+    c->suggested_presentation_delay = get_prop_duration(root, "suggestedPresentationDelay");
+    if ((val = xmlGetProp(root, (const xmlChar *)"availabilityStartTime"))) {
+        int64_t t;
+        if (av_parse_time(&t, (const char *)val, 0) >= 0)
+            c->availability_start_time = t;
+        xmlFree(val);
+    } else if (c->is_live) {
+        av_log(c->ctx, AV_LOG_WARNING, "Dynamic manifest without availabilityStartTime\n");
+    }
+
+    if ((n = find_child(root, "Location")) && (val = xmlNodeGetContent(n))) {
+        char *location = make_url(url, (const char *)val);
+        xmlFree(val);
+        if (location) {
+            av_free(c->manifest_url);
+            c->manifest_url = location;
+        }
+    }
+
+    if (!(base_url = get_base_url(root, url))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (n = root->children; n; n = n->next) {
+        struct period *p;
+
+        if (!is_element(n, "Period"))
+            continue;
+        if (!(p = av_mallocz(sizeof(*p)))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        dynarray_add(pperiods, n_periods, p);
+        p->start    = get_prop_duration(n, "start");
+        p->duration = get_prop_duration(n, "duration");
+        if (p->start == AV_NOPTS_VALUE)
+            p->start = start;
+        /* an open ended period lasts up to the next one */
+        if (*n_periods > 1 && (*pperiods)[*n_periods - 2]->duration == AV_NOPTS_VALUE)
+            (*pperiods)[*n_periods - 2]->duration = p->start - (*pperiods)[*n_periods - 2]->start;
+        start = p->duration == AV_NOPTS_VALUE ? p->start : p->start + p->duration;
+    }
+    if (!*n_periods) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    if ((*pperiods)[*n_periods - 1]->duration == AV_NOPTS_VALUE &&
+        c->media_presentation_duration != AV_NOPTS_VALUE)
+        (*pperiods)[*n_periods - 1]->duration = c->media_presentation_duration -
+                                                (*pperiods)[*n_periods - 1]->start;
+
+    {
+        int i = 0;
+        for (n = root->children; n; n = n->next) {
+            if (is_element(n, "Period") && (ret = parse_period(c, (*pperiods)[i++], n, base_url)) < 0)
+                goto fail;
+        }
+    }
+
+fail:
+    av_free(base_url);
+    xmlFreeDoc(doc);
+    return ret;
+}
+
+/* AV_TIME_BASE, from the start of the period */
+static int64_t segment_start_time(struct representation *rep, int64_t seq_no)
+{
+    struct addressing *a = &rep->addr;
+    int64_t idx = seq_no - a->start_number;
+
+    if (a->timeline) {
+        struct timeline *last = &a->timeline[a->n_timeline - 1];
+        int64_t t = idx < 0                ? a->timeline[0].start :
+                    idx < a->n_timeline    ? a->timeline[idx].start :
+                    last->start + (idx - a->n_timeline + 1) * last->duration;
+        return av_rescale(t - a->pto, AV_TIME_BASE, a->timescale);
+    }
+    if (a->duration > 0)
+        return av_rescale(FFMAX(idx, 0) * a->duration, AV_TIME_BASE, a->timescale);
+    return 0;
+}
+
+static int64_t segment_duration(struct representation *rep, int64_t seq_no)
+{
+    struct addressing *a = &rep->addr;
+    int64_t idx = seq_no - a->start_number;
+
+    if (a->timeline)
+        return av_rescale(a->timeline[av_clip64(idx, 0, a->n_timeline - 1)].duration,
+                          AV_TIME_BASE, a->timescale);
+    if (a->duration > 0)
+        return av_rescale(a->duration, AV_TIME_BASE, a->timescale);
+    return rep->period->duration != AV_NOPTS_VALUE ? rep->period->duration : 0;
+}
+
+/* the segment at t, from the start of the period */
+static int64_t seq_no_at_time(struct representation *rep, int64_t t)
+{
+    struct addressing *a = &rep->addr;
+    int lo, hi;
+
+    if (a->timeline) {
+        lo = 0;
+        hi = a->n_timeline - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (segment_start_time(rep, a->start_number + mid) <= t)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return a->start_number + lo;
+    }
+    if (a->duration > 0 && t > 0) {
+        int64_t seq_no = a->start_number + av_rescale_rnd(t, a->timescale, a->duration * AV_TIME_BASE,
+                                                          AV_ROUND_DOWN);
+        return a->urls ? FFMIN(seq_no, a->start_number + a->n_urls - 1) : seq_no;
+    }
+    return a->start_number;
+}
+
+/* the last segment listed, or available now, first_seq_no() - 1 if there is none yet */
+static int64_t last_seq_no(DASHContext *c, struct representation *rep)
+{
+    struct addressing *a = &rep->addr;
+    struct period     *p = rep->period;
+    int64_t last = INT64_MAX;
+
+    if (a->timeline || a->urls) {
+        last = a->start_number + (a->timeline ? a->n_timeline : a->n_urls) - 1;
+        /* segments listed past the end of the period are not presented */
+        if (p->duration != AV_NOPTS_VALUE && p->duration > 0)
+            last = FFMIN(last, seq_no_at_time(rep, p->duration - 1));
+        return last;
+    }
+    if (p->duration != AV_NOPTS_VALUE)
+        last = a->start_number + av_rescale_rnd(p->duration, a->timescale, a->duration * AV_TIME_BASE,
+                                                AV_ROUND_UP) - 1;
+    if (c->is_live) {
+        /* a segment is available once it is complete */
+        int64_t now = av_gettime() - c->availability_start_time - p->start;
+        last = FFMIN(last, a->start_number - 1 +
+                     av_rescale_rnd(FFMAX(now, 0), a->timescale, a->duration * AV_TIME_BASE, AV_ROUND_DOWN));
+    }
+    return last;
+}
+
+static int64_t first_seq_no(DASHContext *c, struct representation *rep)
+{
+    struct addressing *a = &rep->addr;
+    int64_t first;
+
+    if (a->timeline || a->urls || !c->is_live || c->time_shift_buffer_depth == AV_NOPTS_VALUE)
+        return a->start_number;
+    /* only the time shift buffer of a live template is available */
+    first = last_seq_no(c, rep) + 1 -
+            av_rescale(c->time_shift_buffer_depth, a->timescale, a->duration * AV_TIME_BASE);
+    return FFMAX(first, a->start_number);
+}
+
+/* the period gets no further segments */
+static int period_complete(DASHContext *c, struct representation *rep)
+{
+    struct addressing *a = &rep->addr;
+    struct period     *p = rep->period;
+
+    if (!c->is_live)
+        return 1;
+    if (a->timeline || a->urls)
+        return p != c->periods[c->n_periods - 1];
+    return p->duration != AV_NOPTS_VALUE &&
+           rep->cur_seq_no >= a->start_number +
+                              av_rescale_rnd(p->duration, a->timescale, a->duration * AV_TIME_BASE, AV_ROUND_UP);
+}
+
+static int get_segment(struct representation *rep, int64_t seq_no,
+                       char **url, int64_t *offset, int64_t *size)
+{
+    struct addressing *a = &rep->addr;
+    int64_t idx = seq_no - a->start_number;
+
+    *offset = 0;
+    *size   = -1;
+    if (a->media) {
+        int64_t time = a->timeline ? a->timeline[av_clip64(idx, 0, a->n_timeline - 1)].start :
+                                     idx * a->duration;
+        *url = fill_template(rep, a->media, seq_no, time);
+    } else {
+        if (idx < 0 || idx >= a->n_urls)
+            return AVERROR_BUG;
+        *url    = av_strdup(a->urls[idx].url);
+        *offset = a->urls[idx].offset;
+        *size   = a->urls[idx].size;
+    }
+    return *url ? 0 : AVERROR(ENOMEM);
+}
+
+static void update_options(char **dest, const char *name, void *src)
+{
+    av_freep(dest);
+    av_opt_get(src, name, AV_OPT_SEARCH_CHILDREN, (uint8_t**)dest);
+    if (*dest && !strlen(*dest))
+        av_freep(dest);
+}
+
+static void set_request_options(DASHContext *c, AVDictionary **opts, int64_t offset, int64_t size)
+{
+    // broker prior HTTP options that should be consistent across requests
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+    av_dict_set(opts, "seekable", "0", 0);
+
+    if (offset > 0 || size >= 0)
+        av_dict_set_int(opts, "offset", offset, 0);
+    if (size >= 0)
+        av_dict_set_int(opts, "end_offset", offset + size, 0);
+}
+
+/* same restrictions as the HLS demuxer: an explicit protocol prefix, or a local file */
+static int check_url(const char *url, int *is_http)
+{
+    const char *proto_name = avio_find_protocol_name(url);
+
+    if (!proto_name)
+        return AVERROR_INVALIDDATA;
+    if (strncmp(proto_name, url, strlen(proto_name)) || url[strlen(proto_name)] != ':') {
+        if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
+            return AVERROR_INVALIDDATA;
+    }
+    if (is_http)
+        *is_http = av_strstart(proto_name, "http", NULL);
+    return 0;
+}
+
+static int open_url(DASHContext *c, AVIOContext **pb, const char *url,
+                    int64_t offset, int64_t size)
+{
+    AVFormatContext *s = c->ctx;
+    AVDictionary *tmp = NULL;
+    int is_http = 0;
+    int ret;
+
+    if ((ret = check_url(url, &is_http)) < 0)
+        return ret;
+
+    av_dict_copy(&tmp, c->avio_opts, 0);
+    set_request_options(c, &tmp, offset, size);
+    ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+    av_dict_free(&tmp);
+    if (ret < 0)
+        return ret;
+
+    // update cookies on http response with setcookies.
+    if (is_http)
+        update_options(&c->cookies, "cookies", *pb);
+
+    /* the "offset" option only restricts http requests */
+    if (!is_http && offset > 0) {
+        int64_t seekret = avio_seek(*pb, offset, SEEK_SET);
+        if (seekret < 0) {
+            av_log(s, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of '%s'\n", offset, url);
+            ff_format_io_close(s, pb);
+            return seekret;
+        }
+    }
+    return 0;
+}
+
+static int read_manifest(DASHContext *c, AVIOContext *pb, const char *url,
+                         struct period ***pperiods, int *n_periods)
+{
+    AVBPrint bp;
+    int ret;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = avio_read_to_bprint(pb, &bp, MAX_MANIFEST_SIZE);
+    if (ret >= 0 && !av_bprint_is_complete(&bp))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0)
+        ret = parse_manifest(c, url, bp.str, bp.len, pperiods, n_periods);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+static struct period *find_period(DASHContext *c, struct period *p)
+{
+    int i;
+
+    for (i = 0; i < c->n_periods; i++) {
+        struct period *old = c->periods[i];
+        if (p->id ? old->id && !strcmp(old->id, p->id) : !old->id && old->start == p->start)
+            return old;
+    }
+    return NULL;
+}
+
+/* a live SegmentTimeline may drop segments and renumber the rest, follow the
+ * time of the next segment */
+static int64_t remap_seq_no(struct representation *old, struct addressing *a, int64_t seq_no)
+{
+    int64_t t;
+    int i;
+
+    if (!old->addr.timeline || !a->timeline)
+        return seq_no;
+    t = old->addr.pto + av_rescale(segment_start_time(old, seq_no), old->addr.timescale, AV_TIME_BASE);
+    for (i = 0; i < a->n_timeline; i++) {
+        int64_t ts = av_rescale(a->timeline[i].start, old->addr.timescale, a->timescale);
+        if (ts + av_rescale(a->timeline[i].duration, old->addr.timescale, a->timescale) / 2 > t)
+            break;
+    }
+    return a->start_number + i;
+}
+
+static int merge_representations(DASHContext *c, struct period *p,
+                                 struct representation ***preps, int *n_reps,
+                                 struct representation **reps, int n)
+{
+    int i, j, ret;
+
+    for (i = 0; i < n; i++) {
+        struct representation *rep = reps[i], *old = NULL;
+
+        for (j = 0; j < *n_reps && rep->id; j++) {
+            if ((*preps)[j]->id && !strcmp((*preps)[j]->id, rep->id)) {
+                old = (*preps)[j];
+                break;
+            }
+        }
+        if (!old) {
+            if ((ret = add_representation(preps, n_reps, rep)) < 0)
+                return ret;
+            rep->period = p;
+            reps[i] = NULL;
+            continue;
+        }
+
+        if (old->track || old->ctx) {
+            int64_t seq_no = remap_seq_no(old, &rep->addr, old->cur_seq_no);
+            if (seq_no != old->cur_seq_no) {
+                stop_prefetch(old);
+                old->cur_seq_no = seq_no;
+            }
+            for (j = 0; j < c->n_tracks; j++) {
+                if (c->tracks[j].next == old)
+                    c->tracks[j].next_seq_no = remap_seq_no(old, &rep->addr, c->tracks[j].next_seq_no);
+            }
+        }
+        FFSWAP(struct addressing, old->addr, rep->addr);
+        FFSWAP(char *, old->base_url, rep->base_url);
+        old->bandwidth = rep->bandwidth;
+    }
+    return 0;
+}
+
+static int period_in_use(DASHContext *c, struct period *p)
+{
+    int i;
+
+    for (i = 0; i < c->n_tracks; i++) {
+        if ((c->tracks[i].rep && c->tracks[i].rep->period == p) ||
+            (c->tracks[i].next && c->tracks[i].next->period == p))
+            return 1;
+    }
+    return 0;
+}
+
+/* take over a newly loaded list of periods, keeping the reading state */
+static int merge_manifest(DASHContext *c, struct period **periods, int n_periods)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < c->n_periods; i++)
+        c->periods[i]->seen = 0;
+
+    for (i = 0; i < n_periods && ret >= 0; i++) {
+        struct period *p = periods[i], *old = find_period(c, p);
+
+        if (!old) {
+            p->seen = 1;
+            if ((ret = av_dynarray_add_nofree(&c->periods, &c->n_periods, p)) >= 0)
+                periods[i] = NULL;
+            continue;
+        }
+        old->seen     = 1;
+        old->start    = p->start;
+        old->duration = p->duration;
+        ret = merge_representations(c, old, &old->videos, &old->n_videos, p->videos, p->n_videos);
+        if (ret >= 0)
+            ret = merge_representations(c, old, &old->audios, &old->n_audios, p->audios, p->n_audios);
+    }
+
+    /* drop the periods gone from the manifest that were already read */
+    while (c->n_periods > 1 && !c->periods[0]->seen && !period_in_use(c, c->periods[0])) {
+        free_period(&c->periods[0]);
+        memmove(c->periods, c->periods + 1, (c->n_periods - 1) * sizeof(*c->periods));
+        c->n_periods--;
+    }
+
+    for (i = 0; i < n_periods; i++)
+        free_period(&periods[i]);
+    av_free(periods);
+    return ret;
+}
+
+static int reload_manifest(DASHContext *c)
+{
+    struct period **periods = NULL;
+    int n_periods = 0;
+    AVIOContext *in = NULL;
+    char *url = av_strdup(c->manifest_url);
+    int ret;
+
+    c->last_load_time = av_gettime_relative();
+    if (!url)
+        return AVERROR(ENOMEM);
+    ret = open_url(c, &in, url, 0, -1);
+    if (ret >= 0) {
+        ret = read_manifest(c, in, url, &periods, &n_periods);
+        ff_format_io_close(c->ctx, &in);
+    }
+    if (ret >= 0)
+        ret = merge_manifest(c, periods, n_periods);
+    else
+        free_period_list(&periods, &n_periods);
+    av_free(url);
+    return ret;
+}
+
+/* a dynamic SegmentTemplate without timeline is computed, the others are listed */
+static int64_t reload_interval(DASHContext *c, struct representation *rep)
+{
+    if (c->minimum_update_period > 0)
+        return c->minimum_update_period;
+    if (!rep->addr.timeline && !rep->addr.urls)
+        return INT64_MAX;
+    return FFMAX(segment_duration(rep, last_seq_no(c, rep)), AV_TIME_BASE / 2);
+}
+
+static struct representation *select_representation(DASHContext *c, struct period *p,
+                                                    enum AVMediaType type, int bandwidth)
+{
+    struct representation **reps = type == AVMEDIA_TYPE_VIDEO ? p->videos   : p->audios;
+    int n_reps                   = type == AVMEDIA_TYPE_VIDEO ? p->n_videos : p->n_audios;
+    int i;
+
+    if (!n_reps)
+        return NULL;
+    /* abr starts low, and keeps to the bandwidth it had when the period changes */
+    if (type == AVMEDIA_TYPE_AUDIO || !c->abr)
+        return reps[n_reps - 1];
+    if (bandwidth < 0)
+        return reps[0];
+    for (i = n_reps - 1; i > 0 && reps[i]->bandwidth > bandwidth; i--)
+        ;
+    return reps[i];
+}
+
+/* queue the end of the period, the track moves on to the next one once drained */
+static int next_period(DASHContext *c, struct track *t)
+{
+    struct representation *rep = t->rep;
+    struct period *p = NULL;
+    int i;
+
+    for (i = 0; i < c->n_periods - 1; i++) {
+        if (c->periods[i] == rep->period) {
+            p = c->periods[i + 1];
+            break;
+        }
+    }
+    if (!p)
+        return AVERROR_EOF;
+    if (!(t->next = select_representation(c, p, t->type, rep->bandwidth))) {
+        av_log(c->ctx, AV_LOG_WARNING, "No %s representation in period '%s'\n",
+               av_get_media_type_string(t->type), p->id ? p->id : "");
+        return AVERROR_EOF;
+    }
+    t->next_seq_no = FFMAX(seq_no_at_time(t->next, 0), first_seq_no(c, t->next));
+    t->abr_switch  = 0;
+    return AVERROR_EOF;
+}
+
+/* wait for rep->cur_seq_no to be available, AVERROR_EOF at the end of the period */
+static int wait_for_segment(DASHContext *c, struct representation *rep)
+{
+    int64_t first, last;
+    int ret;
+
+    for (;;) {
+        if (c->is_live && av_gettime_relative() - c->last_load_time >= reload_interval(c, rep)) {
+            if ((ret = reload_manifest(c)) < 0) {
+                if (ff_check_interrupt(c->interrupt_callback))
+                    return AVERROR_EXIT;
+                av_log(c->ctx, AV_LOG_WARNING, "Failed to reload the manifest: %s\n", av_err2str(ret));
+            }
+        }
+        first = first_seq_no(c, rep);
+        last  = last_seq_no(c, rep);
+        if (rep->cur_seq_no < first) {
+            av_log(c->ctx, AV_LOG_WARNING, "skipping %"PRId64" segments ahead, expired from the manifest\n",
+                   first - rep->cur_seq_no);
+            rep->cur_seq_no = first;
+        }
+        if (rep->cur_seq_no <= last)
+            return 0;
+        if (period_complete(c, rep))
+            return next_period(c, rep->track);
+        if (ff_check_interrupt(c->interrupt_callback))
+            return AVERROR_EXIT;
+        av_usleep(100 * 1000);
+    }
+}
+
+static int open_segment(DASHContext *c, struct representation *rep)
+{
+    char *url;
+    int64_t offset, size;
+    int ret;
+
+    if ((ret = get_segment(rep, rep->cur_seq_no, &url, &offset, &size)) < 0)
+        return ret;
+    av_log(rep->parent, AV_LOG_VERBOSE, "DASH request for url '%s', offset %"PRId64", representation '%s'\n",
+           url, offset, rep->id ? rep->id : "");
+    ret = open_url(c, &rep->input, url, offset, size);
+    av_free(url);
+    rep->cur_seg_offset = 0;
+    rep->cur_seg_size   = size;
+    return ret;
+}
+
+static int read_from_segment(struct representation *rep, uint8_t *buf, int buf_size)
+{
+    int ret;
+
+    /* limit read if the segment was only a part of a file */
+    if (rep->cur_seg_size >= 0)
+        buf_size = FFMIN(buf_size, rep->cur_seg_size - rep->cur_seg_offset);
+    if (buf_size <= 0)
+        return AVERROR_EOF;
+
+    if (rep->prefetch_seg) {
+        ret = ff_hls_prefetch_read(rep->prefetch, rep->prefetch_seg, buf, buf_size);
+    } else {
+        int64_t start = av_gettime_relative();
+        ret = avio_read(rep->input, buf, buf_size);
+        rep->download_time += av_gettime_relative() - start;
+        if (ret > 0)
+            rep->download_bytes += ret;
+    }
+    if (ret > 0)
+        rep->cur_seg_offset += ret;
+    return ret;
+}
+
+static int update_init_section(DASHContext *c, struct representation *rep)
+{
+    struct addressing *a = &rep->addr;
+    int64_t sec_size, urlsize;
+    int ret;
+
+    if (!a->init_url ||
+        (rep->init_sec_url && !strcmp(rep->init_sec_url, a->init_url) &&
+         rep->init_sec_offset == a->init_offset))
+        return 0;
+
+    ret = open_url(c, &rep->input, a->init_url, a->init_offset, a->init_size);
+    if (ret < 0) {
+        av_log(rep->parent, AV_LOG_WARNING, "Failed to open the initialization segment of representation '%s'\n",
+               rep->id ? rep->id : "");
+        return ret;
+    }
+
+    if (a->init_size >= 0)
+        sec_size = a->init_size;
+    else if ((urlsize = avio_size(rep->input)) >= 0)
+        sec_size = urlsize;
+    else
+        sec_size = MAX_INIT_SECTION_SIZE;
+    sec_size = FFMIN(sec_size, MAX_INIT_SECTION_SIZE);
+
+    av_fast_malloc(&rep->init_sec_buf, &rep->init_sec_buf_size, sec_size);
+    ret = rep->init_sec_buf ? avio_read(rep->input, rep->init_sec_buf, sec_size) : AVERROR(ENOMEM);
+    ff_format_io_close(rep->parent, &rep->input);
+    if (ret < 0)
+        return ret;
+
+    av_free(rep->init_sec_url);
+    if (!(rep->init_sec_url = av_strdup(a->init_url)))
+        return AVERROR(ENOMEM);
+    rep->init_sec_offset          = a->init_offset;
+    rep->init_sec_data_len        = ret;
+    rep->init_sec_buf_read_offset = 0;
+    return 0;
+}
+
+/* queue the prefetch_segments segments available after cur_seq_no */
+static void schedule_prefetch(DASHContext *c, struct representation *rep)
+{
+    int64_t seq_no, last;
+    int ret;
+
+    if (c->prefetch_segments <= 0)
+        return;
+
+    if (!rep->prefetch) {
+        ret = ff_hls_prefetch_alloc(&rep->prefetch, c->prefetch_segments, c->prefetch_max_size,
+                                    c->interrupt_callback,
+                                    c->ctx->protocol_whitelist, c->ctx->protocol_blacklist,
+                                    rep->parent);
+        if (ret < 0) {
+            av_log(rep->parent, AV_LOG_WARNING, "Segment prefetch unavailable: %s\n", av_err2str(ret));
+            c->prefetch_segments = 0;
+            return;
+        }
+    }
+
+    last = FFMIN(rep->cur_seq_no + c->prefetch_segments, last_seq_no(c, rep));
+    ff_hls_prefetch_cancel_outside(rep->prefetch, rep->cur_seq_no, last);
+
+    for (seq_no = rep->cur_seq_no + 1; seq_no <= last; seq_no++) {
+        AVDictionary *opts = NULL;
+        int64_t offset, size;
+        char *url;
+        int is_http;
+
+        if (get_segment(rep, seq_no, &url, &offset, &size) < 0)
+            break;
+        // a byte range can only be bounded by http, elsewhere the rest of the file would be read
+        if (check_url(url, &is_http) < 0 || (!is_http && size >= 0)) {
+            av_free(url);
+            break;
+        }
+        av_dict_copy(&opts, c->avio_opts, 0);
+        set_request_options(c, &opts, offset, size);
+        av_dict_set(&opts, "seekable", "1", 0);
+        ret = ff_hls_prefetch_schedule(rep->prefetch, seq_no, url, is_http ? 0 : offset, opts);
+        av_dict_free(&opts);
+        av_free(url);
+        if (ret < 0)
+            break;
+    }
+}
+
+static void abr_add_sample(DASHContext *c, int64_t bytes, int64_t elapsed)
+{
+    int64_t bandwidth;
+
+    if (bytes < ABR_MIN_SAMPLE_BYTES || elapsed <= 0)
+        return;
+
+    bandwidth = bytes * 8 * 1000000 / elapsed;
+    c->abr_fast_bandwidth = c->abr_fast_bandwidth ? (c->abr_fast_bandwidth + bandwidth) / 2 : bandwidth;
+    c->abr_slow_bandwidth = c->abr_slow_bandwidth ? (c->abr_slow_bandwidth * 4 + bandwidth) / 5 : bandwidth;
+}
+
+/*
+ * Called at a segment boundary of the video track, with the same rules as
+ * the HLS demuxer: the best representation of the AdaptationSet within 80%
+ * of the lower of a fast and a slow moving average of the downloads, gated
+ * by the buffer level the application reports.
+ */
+static void abr_check_switch(DASHContext *c, struct track *t)
+{
+    struct representation *cur = t->rep, *next = NULL;
+    struct period *p = cur->period;
+    AVAppBufferLevel level = { 0 };
+    int64_t estimate, usable, t_next;
+    int i;
+
+    if (!c->abr || t->next || p->n_videos < 2 || !c->abr_fast_bandwidth ||
+        (period_complete(c, cur) && cur->cur_seq_no > last_seq_no(c, cur)))
+        return;
+
+    level.size                  = sizeof(level);
+    level.cached_duration_milli = -1;
+    av_application_on_buffer_level(c->app_ctx, &level);
+
+    estimate = FFMIN(c->abr_fast_bandwidth, c->abr_slow_bandwidth);
+    if (level.cached_duration_milli >= 0 && level.cached_duration_milli < ABR_PANIC_BUFFER)
+        estimate /= 2;
+    usable = estimate / 5 * 4;
+
+    /* the best representation within the usable bandwidth, or the lowest one */
+    for (i = 0; i < p->n_videos; i++) {
+        if (p->videos[i]->bandwidth <= usable)
+            next = p->videos[i];
+    }
+    if (!next)
+        next = p->videos[0];
+
+    if (next == cur || next->bandwidth == cur->bandwidth)
+        return;
+    if (next->bandwidth > cur->bandwidth &&
+        level.cached_duration_milli >= 0 && level.cached_duration_milli < ABR_UPSWITCH_BUFFER)
+        return;
+    if (next->bandwidth < cur->bandwidth && level.cached_duration_milli >= ABR_HOLD_BUFFER)
+        return;
+
+    av_log(cur->parent, AV_LOG_INFO, "ABR: switching from %d to %d bps at segment %"PRId64", "
+           "estimate %"PRId64" bps, buffered %"PRId64" ms\n",
+           cur->bandwidth, next->bandwidth, cur->cur_seq_no, estimate, level.cached_duration_milli);
+
+    /* the middle of the next segment, representations may be numbered differently */
+    t_next = segment_start_time(cur, cur->cur_seq_no) + segment_duration(cur, cur->cur_seq_no) / 2;
+    t->next               = next;
+    t->next_seq_no        = seq_no_at_time(next, t_next);
+    t->abr_switch         = 1;
+    c->abr_buffered_milli = level.cached_duration_milli;
+    stop_prefetch(cur);
+}
+
+static int read_data(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct representation *rep = opaque;
+    DASHContext *c = rep->parent->priv_data;
+    struct track *t;
+    int ret;
+
+restart:
+    t = rep->track;
+    // let the demuxer drain before switching representations
+    if (!t || t->rep != rep || t->next)
+        return AVERROR_EOF;
+
+    if (!rep->input && !rep->prefetch_seg) {
+        if ((ret = wait_for_segment(c, rep)) < 0)
+            return ret;
+
+        if ((ret = update_init_section(c, rep)) < 0)
+            return ret;
+
+        if (rep->prefetch)
+            rep->prefetch_seg = ff_hls_prefetch_take(rep->prefetch, rep->cur_seq_no);
+        if (rep->prefetch_seg) {
+            av_log(rep->parent, AV_LOG_VERBOSE, "DASH prefetched segment %"PRId64", representation '%s'\n",
+                   rep->cur_seq_no, rep->id ? rep->id : "");
+            rep->cur_seg_offset = 0;
+            rep->cur_seg_size   = -1;
+        } else {
+            int64_t start = av_gettime_relative();
+            rep->download_bytes = 0;
+            ret = open_segment(c, rep);
+            rep->download_time = av_gettime_relative() - start;
+            if (ret < 0) {
+                if (ff_check_interrupt(c->interrupt_callback))
+                    return AVERROR_EXIT;
+                /* a static template without any duration ends where the segments do */
+                if (!c->is_live && last_seq_no(c, rep) == INT64_MAX)
+                    return next_period(c, t);
+                /* without UTCTiming the clocks may disagree, the live edge is
+                 * tried again rather than skipped */
+                if (c->is_live && rep->cur_seq_no >= last_seq_no(c, rep) - 1) {
+                    av_usleep(500 * 1000);
+                    goto restart;
+                }
+                av_log(rep->parent, AV_LOG_WARNING, "Failed to open segment %"PRId64" of representation '%s'\n",
+                       rep->cur_seq_no, rep->id ? rep->id : "");
+                rep->cur_seq_no++;
+                goto restart;
+            }
+        }
+        schedule_prefetch(c, rep);
+    }
+
+    if (rep->init_sec_buf_read_offset < rep->init_sec_data_len) {
+        /* Push init section out first before first actual segment */
+        int copy_size = FFMIN(rep->init_sec_data_len - rep->init_sec_buf_read_offset, buf_size);
+        memcpy(buf, rep->init_sec_buf + rep->init_sec_buf_read_offset, copy_size);
+        rep->init_sec_buf_read_offset += copy_size;
+        return copy_size;
+    }
+
+    ret = read_from_segment(rep, buf, buf_size);
+    if (ret > 0)
+        return ret;
+    if (rep->prefetch_seg) {
+        int64_t bytes, elapsed;
+        if (ff_hls_prefetch_get_timing(rep->prefetch, rep->prefetch_seg, &bytes, &elapsed) >= 0)
+            abr_add_sample(c, bytes, elapsed);
+        ff_hls_prefetch_release(rep->prefetch, &rep->prefetch_seg);
+        if (ret != AVERROR_EOF && !rep->cur_seg_offset) {
+            // the prefetch failed before any data, try the segment again directly
+            if (ff_check_interrupt(c->interrupt_callback))
+                return AVERROR_EXIT;
+            goto restart;
+        }
+    } else {
+        abr_add_sample(c, rep->download_bytes, rep->download_time);
+    }
+    if (rep->input)
+        ff_format_io_close(rep->parent, &rep->input);
+    rep->cur_seq_no++;
+
+    if (t->type == AVMEDIA_TYPE_VIDEO)
+        abr_check_switch(c, t);
+
+    goto restart;
+}
+
+static int save_avio_options(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    static const char *opts[] = {
+        "headers", "http_proxy", "user_agent", "user-agent", "cookies", NULL };
+    const char **opt = opts;
+    uint8_t *buf;
+    int ret = 0;
+
+    while (*opt) {
+        if (av_opt_get(s->pb, *opt, AV_OPT_SEARCH_CHILDREN | AV_OPT_ALLOW_NULL, &buf) >= 0) {
+            ret = av_dict_set(&c->avio_opts, *opt, buf,
+                              AV_DICT_DONT_STRDUP_VAL);
+            if (ret < 0)
+                return ret;
+        }
+        opt++;
+    }
+
+    return ret;
+}
+
+static int nested_io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                          int flags, AVDictionary **opts)
+{
+    av_log(s, AV_LOG_ERROR,
+           "A DASH segment '%s' referred to an external file '%s'. "
+           "Opening this file was forbidden for security reasons\n",
+           s->filename, url);
+    return AVERROR(EPERM);
+}
+
+/* the n-th stream of a type of every representation of a track is exported
+ * through the n-th stream of that type of the track */
+static AVStream *find_track_stream(struct track *t, struct representation *rep, AVStream *ist)
+{
+    enum AVMediaType type = ist->codecpar->codec_type;
+    int i, nth = 0;
+
+    for (i = 0; i < ist->index; i++)
+        nth += rep->ctx->streams[i]->codecpar->codec_type == type;
+    for (i = 0; i < t->n_streams; i++) {
+        if (t->streams[i]->codecpar->codec_type == type && !nth--)
+            return t->streams[i];
+    }
+    return NULL;
+}
+
+/* add new subdemuxer streams to the track, if any */
+static int update_streams_from_subdemuxer(AVFormatContext *s, struct representation *rep)
+{
+    struct track *t = rep->track;
+    int ret;
+
+    while (rep->n_main_streams < rep->ctx->nb_streams) {
+        AVStream *ist = rep->ctx->streams[rep->n_main_streams];
+        AVStream *st  = find_track_stream(t, rep, ist);
+
+        if (!st) {
+            if (!(st = avformat_new_stream(s, NULL)))
+                return AVERROR(ENOMEM);
+            if ((ret = avcodec_parameters_copy(st->codecpar, ist->codecpar)) < 0)
+                return ret;
+            avpriv_set_pts_info(st, ist->pts_wrap_bits, ist->time_base.num, ist->time_base.den);
+            st->internal->need_context_update = 1;
+            if (rep->bandwidth)
+                av_dict_set_int(&st->metadata, "variant_bitrate", rep->bandwidth, 0);
+            dynarray_add(&t->streams, &t->n_streams, st);
+        }
+        dynarray_add(&rep->main_streams, &rep->n_main_streams, st);
+    }
+    return 0;
+}
+
+static int open_demuxer(AVFormatContext *s, struct representation *rep)
+{
+    AVInputFormat *in_fmt = NULL;
+    char *url = NULL;
+    int64_t offset, size;
+    int ret;
+
+    if (!(rep->ctx = avformat_alloc_context()))
+        return AVERROR(ENOMEM);
+
+    av_freep(&rep->pb.buffer);
+    rep->read_buffer = av_malloc(INITIAL_BUFFER_SIZE);
+    if (!rep->read_buffer) {
+        avformat_free_context(rep->ctx);
+        rep->ctx = NULL;
+        return AVERROR(ENOMEM);
+    }
+    ffio_init_context(&rep->pb, rep->read_buffer, INITIAL_BUFFER_SIZE, 0, rep,
+                      read_data, NULL, NULL);
+    rep->pb.seekable = 0;
+
+    if (!rep->addr.init_url && get_segment(rep, rep->cur_seq_no, &url, &offset, &size) < 0)
+        url = NULL;
+    ret = av_probe_input_buffer(&rep->pb, &in_fmt, rep->addr.init_url ? rep->addr.init_url : url,
+                                NULL, 0, 0);
+    av_free(url);
+    if (ret < 0) {
+        /* Free the ctx - it isn't initialized properly at this point,
+         * so avformat_close_input shouldn't be called. */
+        av_log(s, AV_LOG_ERROR, "Error when loading the first segment of representation '%s'\n",
+               rep->id ? rep->id : "");
+        avformat_free_context(rep->ctx);
+        rep->ctx = NULL;
+        return ret;
+    }
+    rep->ctx->pb       = &rep->pb;
+    rep->ctx->io_open  = nested_io_open;
+    rep->ctx->flags   |= s->flags;
+
+    if ((ret = ff_copy_whiteblacklists(rep->ctx, s)) < 0)
+        return ret;
+
+    ret = avformat_open_input(&rep->ctx, rep->id ? rep->id : "", in_fmt, NULL);
+    if (ret < 0)
+        return ret;
+
+    return update_streams_from_subdemuxer(s, rep);
+}
+
+/*
+ * Continue track t with representation to, from seq_no on. The subdemuxer
+ * always starts over with the initialization segment: mov keeps the byte
+ * positions of the fragments it has seen, which no longer match.
+ */
+static int switch_representation(AVFormatContext *s, struct track *t,
+                                 struct representation *to, int64_t seq_no)
+{
+    DASHContext *c = s->priv_data;
+    struct representation *from = t->rep;
+    int abr_switch = t->abr_switch && from && from != to && from->period == to->period;
+    AVAppVariantSwitch event = { 0 };
+    int ret;
+
+    t->next       = NULL;
+    t->abr_switch = 0;
+
+    close_demuxer(to);
+    to->cur_seq_no     = seq_no;
+    to->seek_timestamp = AV_NOPTS_VALUE;
+    to->track          = t;
+    t->rep             = to;
+    if ((ret = open_demuxer(s, to)) < 0) {
+        close_demuxer(to);
+        if (from == to) {
+            to->track = NULL;
+            t->rep    = NULL;
+            return ret;
+        }
+        to->track = NULL;
+        t->rep    = from;
+        if (!abr_switch)
+            return ret;
+        av_log(s, AV_LOG_WARNING, "ABR: failed to open representation %d bps, staying at %d bps\n",
+               to->bandwidth, from->bandwidth);
+        from->pb.eof_reached = 0;
+        return ff_check_interrupt(c->interrupt_callback) ? AVERROR_EXIT : 0;
+    }
+
+    if (from && from != to) {
+        from->track = NULL;
+        close_demuxer(from);
+    }
+
+    if (abr_switch) {
+        event.size                = sizeof(event);
+        event.from_bitrate        = from->bandwidth;
+        event.to_bitrate          = to->bandwidth;
+        event.seq_no              = seq_no;
+        event.estimated_bandwidth = FFMIN(c->abr_fast_bandwidth, c->abr_slow_bandwidth);
+        event.buffered_milli      = c->abr_buffered_milli;
+        av_application_on_variant_switch(c->app_ctx, &event);
+    }
+    return 0;
+}
+
+static int dash_close(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int i;
+
+    free_period_list(&c->periods, &c->n_periods);
+    for (i = 0; i < c->n_tracks; i++)
+        av_freep(&c->tracks[i].streams);
+    c->n_tracks = 0;
+
+    av_freep(&c->manifest_url);
+    av_dict_free(&c->avio_opts);
+    return 0;
+}
+
+static int dash_read_header(AVFormatContext *s, AVDictionary **options)
+{
+    void *u = (s->flags & AVFMT_FLAG_CUSTOM_IO) ? NULL : s->pb;
+    static const enum AVMediaType types[] = { AVMEDIA_TYPE_VIDEO, AVMEDIA_TYPE_AUDIO };
+    DASHContext *c = s->priv_data;
+    struct period **periods = NULL, *p;
+    int n_periods = 0;
+    int64_t live_time = INT64_MAX;
+    char *location = NULL;
+    int ret, i;
+
+    c->ctx                = s;
+    c->interrupt_callback = &s->interrupt_callback;
+
+    if (options && *options)
+        av_dict_copy(&c->avio_opts, *options, 0);
+
+    {
+        AVDictionaryEntry *e = av_dict_get(c->avio_opts, "ijkapplication", NULL, 0);
+        if (e)
+            c->app_ctx = (AVApplicationContext *)(intptr_t)strtoll(e->value, NULL, 10);
+    }
+
+    if (u) {
+        update_options(&c->user_agent, "user_agent", u);
+        update_options(&c->cookies, "cookies", u);
+        update_options(&c->headers, "headers", u);
+        update_options(&c->http_proxy, "http_proxy", u);
+        // relative urls follow redirects of the manifest
+        av_opt_get(u, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&location);
+    }
+    if ((ret = save_avio_options(s)) < 0)
+        goto fail;
+
+    c->manifest_url = location && *location ? location : av_strdup(s->filename);
+    if (c->manifest_url != location)
+        av_free(location);
+    if (!c->manifest_url) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    {
+        char *url = av_strdup(c->manifest_url);
+        ret = url ? read_manifest(c, s->pb, url, &periods, &n_periods) : AVERROR(ENOMEM);
+        av_free(url);
+    }
+    c->last_load_time = av_gettime_relative();
+    if (ret < 0) {
+        free_period_list(&periods, &n_periods);
+        goto fail;
+    }
+    if ((ret = merge_manifest(c, periods, n_periods)) < 0)
+        goto fail;
+
+    /* a live presentation starts in the period playing now */
+    p = c->periods[0];
+    for (i = 1; c->is_live && i < c->n_periods; i++) {
+        if (c->periods[i]->start <= av_gettime() - c->availability_start_time)
+            p = c->periods[i];
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(types); i++) {
+        struct representation *rep = select_representation(c, p, types[i], -1);
+        struct track *t;
+
+        if (!rep)
+            continue;
+        t       = &c->tracks[c->n_tracks++];
+        t->type = types[i];
+        t->rep  = rep;
+
+        if (c->is_live) {
+            int64_t last = last_seq_no(c, rep);
+            int64_t delay = c->suggested_presentation_delay != AV_NOPTS_VALUE ?
+                            c->suggested_presentation_delay :
+                            LIVE_START_SEGMENTS * segment_duration(rep, last);
+            live_time = FFMIN(live_time, segment_start_time(rep, last) + segment_duration(rep, last) - delay);
+        }
+    }
+    if (!c->n_tracks) {
+        av_log(s, AV_LOG_ERROR, "No playable audio or video representation\n");
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+
+    for (i = 0; i < c->n_tracks; i++) {
+        struct track *t = &c->tracks[i];
+        struct representation *rep = t->rep;
+        int64_t seq_no = first_seq_no(c, rep);
+
+        if (c->is_live)
+            seq_no = av_clip64(seq_no_at_time(rep, live_time), seq_no, FFMAX(seq_no, last_seq_no(c, rep)));
+        t->rep = NULL;
+        if ((ret = switch_representation(s, t, rep, seq_no)) < 0)
+            goto fail;
+    }
+
+    if (!c->is_live) {
+        struct period *last = c->periods[c->n_periods - 1];
+        if (c->media_presentation_duration != AV_NOPTS_VALUE)
+            s->duration = c->media_presentation_duration;
+        else if (last->duration != AV_NOPTS_VALUE)
+            s->duration = last->start + last->duration;
+    }
+    return 0;
+fail:
+    dash_close(s);
+    return ret;
+}
+
+static int track_discarded(struct track *t)
+{
+    int i;
+
+    for (i = 0; i < t->n_streams; i++) {
+        if (t->streams[i]->discard < AVDISCARD_ALL)
+            return 0;
+    }
+    return t->n_streams > 0;
+}
+
+/* move a subdemuxer packet to the exported stream and the presentation timeline */
+static int export_packet(AVFormatContext *s, struct representation *rep, AVPacket *pkt)
+{
+    struct addressing *a = &rep->addr;
+    AVStream *ist, *st;
+    int64_t offset;
+    int ret;
+
+    if ((ret = update_streams_from_subdemuxer(s, rep)) < 0)
+        return ret;
+    if (pkt->stream_index >= rep->n_main_streams)
+        return AVERROR_BUG;
+    ist = rep->ctx->streams[pkt->stream_index];
+    st  = rep->main_streams[pkt->stream_index];
+
+    /* another representation or period may come with other parameters */
+    if (ist->codecpar->codec_id       != st->codecpar->codec_id ||
+        ist->codecpar->extradata_size != st->codecpar->extradata_size ||
+        (ist->codecpar->extradata_size &&
+         memcmp(ist->codecpar->extradata, st->codecpar->extradata, ist->codecpar->extradata_size))) {
+        if ((ret = avcodec_parameters_copy(st->codecpar, ist->codecpar)) < 0)
+            return ret;
+        st->internal->need_context_update = 1;
+        if (ist->codecpar->extradata_size) {
+            uint8_t *side = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                                    ist->codecpar->extradata_size);
+            if (side)
+                memcpy(side, ist->codecpar->extradata, ist->codecpar->extradata_size);
+        }
+    }
+
+    av_packet_rescale_ts(pkt, ist->time_base, st->time_base);
+    offset = av_rescale_q(rep->period->start - av_rescale(a->pto, AV_TIME_BASE, a->timescale),
+                          AV_TIME_BASE_Q, st->time_base);
+    if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts += offset;
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts += offset;
+    pkt->stream_index = st->index;
+    return 0;
+}
+
+static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    DASHContext *c = s->priv_data;
+    struct track *min = NULL;
+    int ret, i;
+
+    for (i = 0; i < c->n_tracks; i++) {
+        struct track *t = &c->tracks[i];
+        struct representation *rep;
+
+        if (track_discarded(t))
+            continue;
+        while ((rep = t->rep) && !rep->pkt.data) {
+            ret = av_read_frame(rep->ctx, &rep->pkt);
+            if (ret < 0) {
+                if (!avio_feof(&rep->pb) && ret != AVERROR_EOF)
+                    return ret;
+                reset_packet(&rep->pkt);
+                if (!t->next)
+                    break;
+                if ((ret = switch_representation(s, t, t->next, t->next_seq_no)) < 0)
+                    return ret;
+                continue;
+            }
+            if ((ret = export_packet(s, rep, &rep->pkt)) < 0) {
+                av_packet_unref(&rep->pkt);
+                reset_packet(&rep->pkt);
+                return ret;
+            }
+
+            if (rep->seek_timestamp != AV_NOPTS_VALUE) {
+                AVStream *st = s->streams[rep->pkt.stream_index];
+                int64_t ts = rep->pkt.dts != AV_NOPTS_VALUE ? rep->pkt.dts : rep->pkt.pts;
+
+                if (ts == AV_NOPTS_VALUE ||
+                    (av_compare_ts(ts, st->time_base, rep->seek_timestamp, AV_TIME_BASE_Q) >= 0 &&
+                     (rep->seek_flags & AVSEEK_FLAG_ANY || t->type != AVMEDIA_TYPE_VIDEO ||
+                      rep->pkt.flags & AV_PKT_FLAG_KEY))) {
+                    rep->seek_timestamp = AV_NOPTS_VALUE;
+                } else {
+                    av_packet_unref(&rep->pkt);
+                    reset_packet(&rep->pkt);
+                }
+            }
+        }
+
+        /* Check if this track has the packet with the lowest dts */
+        if (rep && rep->pkt.data) {
+            AVPacket *mpkt = min ? &min->rep->pkt : NULL;
+            if (!min || rep->pkt.dts == AV_NOPTS_VALUE ||
+                (mpkt->dts != AV_NOPTS_VALUE &&
+                 av_compare_ts(rep->pkt.dts, s->streams[rep->pkt.stream_index]->time_base,
+                               mpkt->dts, s->streams[mpkt->stream_index]->time_base) < 0))
+                min = t;
+        }
+    }
+
+    if (!min)
+        return AVERROR_EOF;
+    *pkt = min->rep->pkt;
+    reset_packet(&min->rep->pkt);
+    return 0;
+}
+
+static int dash_read_seek(AVFormatContext *s, int stream_index,
+                          int64_t timestamp, int flags)
+{
+    DASHContext *c = s->priv_data;
+    struct period *p;
+    int64_t seek_timestamp;
+    int i, ret;
+
+    if ((flags & AVSEEK_FLAG_BYTE) || c->is_live)
+        return AVERROR(ENOSYS);
+
+    seek_timestamp = av_rescale_q_rnd(timestamp, s->streams[stream_index]->time_base, AV_TIME_BASE_Q,
+                                      flags & AVSEEK_FLAG_BACKWARD ? AV_ROUND_DOWN : AV_ROUND_UP);
+    if (s->duration > 0 && seek_timestamp > s->duration)
+        return AVERROR(EIO);
+
+    p = c->periods[0];
+    for (i = 1; i < c->n_periods; i++) {
+        if (c->periods[i]->start <= seek_timestamp)
+            p = c->periods[i];
+    }
+
+    for (i = 0; i < c->n_tracks; i++) {
+        struct track *t = &c->tracks[i];
+        struct representation *rep = t->rep, *to;
+        int64_t seq_no;
+
+        if (!rep)
+            continue;
+        to = rep->period == p ? rep : select_representation(c, p, t->type, rep->bandwidth);
+        if (!to)
+            continue;
+        seq_no = av_clip64(seq_no_at_time(to, seek_timestamp - p->start),
+                           first_seq_no(c, to), last_seq_no(c, to));
+        /* segments start with a key frame, backwards is where the video one does;
+         * the video track comes first */
+        if (flags & AVSEEK_FLAG_BACKWARD && t->type == AVMEDIA_TYPE_VIDEO)
+            seek_timestamp = FFMIN(seek_timestamp, p->start + segment_start_time(to, seq_no));
+        t->abr_switch = 0;
+        if ((ret = switch_representation(s, t, to, seq_no)) < 0)
+            return ret;
+        t->rep->seek_timestamp = seek_timestamp;
+        t->rep->seek_flags     = flags;
+    }
+    return 0;
+}
+
+static int dash_probe(AVProbeData *p)
+{
+    if (!av_stristr(p->buf, "<MPD"))
+        return 0;
+    if (av_stristr(p->buf, "urn:mpeg:dash:schema:mpd") ||
+        av_stristr(p->buf, "urn:mpeg:dash:profile"))
+        return AVPROBE_SCORE_MAX;
+    return AVPROBE_SCORE_EXTENSION;
+}
+
+#define OFFSET(x) offsetof(DASHContext, x)
+#define FLAGS AV_OPT_FLAG_DECODING_PARAM
+static const AVOption dash_options[] = {
+    {"prefetch_segments", "number of segments to download ahead in parallel, 0 to disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, HLS_PREFETCH_MAX_SEGMENTS, FLAGS},
+    {"prefetch_max_size", "max bytes of prefetched segments waiting to be read",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT, {.i64 = 8 * 1024 * 1024}, 0, INT_MAX, FLAGS},
+    {"abr", "switch video representations according to the measured bandwidth",
+        OFFSET(abr), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
+    {NULL}
+};
+
+static const AVClass dash_class = {
+    .class_name = "dash",
+    .item_name  = av_default_item_name,
+    .option     = dash_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVInputFormat ff_dash_demuxer = {
+    .name           = "dash",
+    .long_name      = NULL_IF_CONFIG_SMALL("Dynamic Adaptive Streaming over HTTP"),
+    .priv_class     = &dash_class,
+    .priv_data_size = sizeof(DASHContext),
+    .read_probe     = dash_probe,
+    .read_header2   = dash_read_header,
+    .read_packet    = dash_read_packet,
+    .read_close     = dash_close,
+    .read_seek      = dash_read_seek,
+    .flags          = AVFMT_NO_BYTE_SEEK,
+    .extensions     = "mpd",
+};
@@ -0,0 +1,105 @@
+/*
+ * Process wide persistent cache of downloaded byte ranges
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_DISK_CACHE_H
+#define AVFORMAT_DISK_CACHE_H
+
+#include <stdint.h>
+
+/**
+ * Resources are keyed by the md5 of their url without the fragment and
+ * without the query parameters that change from one request to the next
+ * (tokens, signatures, expiry times), so a re-watch with a fresh signed
+ * url hits the same entry.
+ *
+ * Each entry is a sparse data file addressed by resource offset and an
+ * index file listing the cached ranges, merged as they grow. Entries not
+ * open by any reader are evicted least recently used first once the
+ * cached bytes exceed the budget. The index files are read back by
+ * av_disk_cache_configure(), so the cache outlives the process.
+ */
+
+#define DISK_CACHE_IGNORE_PARAMS "token,expires,signature,sign,auth_key,Expires,Signature,Policy,Key-Pair-Id," \
+                                 "X-Amz-Date,X-Amz-Expires,X-Amz-Signature,X-Amz-Credential,X-Amz-Security-Token"
+
+typedef struct DiskCacheStatistic {
+    int64_t hit_bytes;      // bytes read from the cache
+    int64_t miss_bytes;     // bytes stored after a download
+    int64_t evictions;
+    int64_t size;           // cached bytes
+    int64_t max_size;
+    int     entries;
+} DiskCacheStatistic;
+
+typedef struct DiskCacheFile DiskCacheFile;
+
+/**
+ * Set the cache directory, created if needed, and the budget of cached
+ * bytes. Entries left there by a previous run are loaded. Changing the
+ * directory drops the entries of the former one that no reader has open.
+ *
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int  av_disk_cache_configure(const char *dir, int64_t max_size);
+
+/**
+ * Remove every entry no reader has open, from memory and disk.
+ */
+void av_disk_cache_clear(void);
+void av_disk_cache_get_statistic(DiskCacheStatistic *stat);
+
+/**
+ * Open the entry of url, creating it if needed.
+ *
+ * @param ignore_params comma separated query parameters left out of the key,
+ *                      NULL for DISK_CACHE_IGNORE_PARAMS
+ * @return 0 on success, AVERROR(ENOSYS) if no cache is configured,
+ *         another negative AVERROR on failure
+ */
+int  ff_disk_cache_open(DiskCacheFile **pfile, const char *url, const char *ignore_params);
+void ff_disk_cache_close(DiskCacheFile **pfile);
+
+/**
+ * @return the size of the resource, -1 if not known yet
+ */
+int64_t ff_disk_cache_get_size(DiskCacheFile *file);
+void    ff_disk_cache_set_size(DiskCacheFile *file, int64_t size);
+
+/**
+ * @return the number of cached bytes starting at pos, 0 if pos is not cached
+ */
+int64_t ff_disk_cache_available(DiskCacheFile *file, int64_t pos);
+
+/**
+ * Read cached bytes at pos, at most ff_disk_cache_available(pos).
+ *
+ * @return the number of bytes read, a negative AVERROR on failure
+ */
+int  ff_disk_cache_read(DiskCacheFile *file, int64_t pos, uint8_t *buf, int size);
+
+/**
+ * Store downloaded bytes at pos. Nothing is stored if the entry would not
+ * fit the budget on its own.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int  ff_disk_cache_write(DiskCacheFile *file, int64_t pos, const uint8_t *buf, int size);
+
+#endif /* AVFORMAT_DISK_CACHE_H */
@@ -0,0 +1,434 @@
+/*
+ * Process wide DNS resolution cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "dns_cache.h"
+#include "network.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define DNS_CACHE_MAX_ENTRIES 64
+
+typedef struct DnsCacheEntry {
+    struct DnsCacheEntry *next;
+    char            *key;           // "host:port"
+    int64_t          update_time;   // av_gettime_relative() of the last store, 0 if never stored
+    int              gai_error;     // non zero for a negative entry
+    int              pending;       // a prefetch is resolving this key
+    struct addrinfo *res;           // private copy, released with ff_dns_cache_freeaddrinfo()
+} DnsCacheEntry;
+
+void ff_dns_cache_freeaddrinfo(struct addrinfo **p_ai)
+{
+    struct addrinfo *ai = *p_ai;
+
+    while (ai) {
+        struct addrinfo *next = ai->ai_next;
+        av_freep(&ai->ai_addr);
+        av_free(ai);
+        ai = next;
+    }
+    *p_ai = NULL;
+}
+
+#if HAVE_PTHREADS
+
+static pthread_mutex_t    dns_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DnsCacheEntry     *dns_cache_head;
+static int                dns_cache_count;
+static DnsCacheStatistic  dns_cache_stat;
+
+// ai_canonname is not kept, ai_addr is copied with its real length so
+// AF_INET6 entries survive the round trip
+static struct addrinfo *dns_cache_copy_addrinfo(const struct addrinfo *src)
+{
+    struct addrinfo *head = NULL;
+    struct addrinfo **tail = &head;
+
+    for (; src; src = src->ai_next) {
+        struct addrinfo *ai;
+
+        if (!src->ai_addr || !src->ai_addrlen)
+            continue;
+
+        ai = av_mallocz(sizeof(*ai));
+        if (!ai)
+            goto fail;
+        *ai = *src;
+        ai->ai_canonname = NULL;
+        ai->ai_next      = NULL;
+        ai->ai_addr      = av_malloc(src->ai_addrlen);
+        if (!ai->ai_addr) {
+            av_free(ai);
+            goto fail;
+        }
+        memcpy(ai->ai_addr, src->ai_addr, src->ai_addrlen);
+
+        *tail = ai;
+        tail  = &ai->ai_next;
+    }
+    return head;
+fail:
+    ff_dns_cache_freeaddrinfo(&head);
+    return NULL;
+}
+
+static void dns_cache_make_key(char *key, size_t key_size, const char *hostname, int port)
+{
+    snprintf(key, key_size, "%s:%d", hostname, port);
+}
+
+static void dns_cache_entry_free(DnsCacheEntry **p_entry)
+{
+    DnsCacheEntry *entry = *p_entry;
+
+    if (!entry)
+        return;
+
+    ff_dns_cache_freeaddrinfo(&entry->res);
+    av_freep(&entry->key);
+    av_freep(p_entry);
+}
+
+// must be called with dns_cache_mutex held
+static DnsCacheEntry **dns_cache_find_locked(const char *key)
+{
+    DnsCacheEntry **p_entry = &dns_cache_head;
+
+    for (; *p_entry; p_entry = &(*p_entry)->next) {
+        if (!strcmp((*p_entry)->key, key))
+            break;
+    }
+    return p_entry;
+}
+
+// drop the least recently stored entry, pending ones are in use by a worker
+static void dns_cache_evict_locked(void)
+{
+    DnsCacheEntry **p_entry  = &dns_cache_head;
+    DnsCacheEntry **p_oldest = NULL;
+    DnsCacheEntry  *oldest;
+
+    for (; *p_entry; p_entry = &(*p_entry)->next) {
+        if ((*p_entry)->pending)
+            continue;
+        if (!p_oldest || (*p_entry)->update_time < (*p_oldest)->update_time)
+            p_oldest = p_entry;
+    }
+    if (!p_oldest)
+        return;
+
+    oldest    = *p_oldest;
+    *p_oldest = oldest->next;
+    dns_cache_entry_free(&oldest);
+    dns_cache_count--;
+}
+
+static DnsCacheEntry *dns_cache_get_or_add_locked(const char *key)
+{
+    DnsCacheEntry **p_entry = dns_cache_find_locked(key);
+    DnsCacheEntry  *entry   = *p_entry;
+
+    if (entry)
+        return entry;
+
+    if (dns_cache_count >= DNS_CACHE_MAX_ENTRIES)
+        dns_cache_evict_locked();
+
+    entry = av_mallocz(sizeof(*entry));
+    if (!entry)
+        return NULL;
+    entry->key = av_strdup(key);
+    if (!entry->key) {
+        av_free(entry);
+        return NULL;
+    }
+
+    entry->next    = dns_cache_head;
+    dns_cache_head = entry;
+    dns_cache_count++;
+    return entry;
+}
+
+int ff_dns_cache_lookup(const char *hostname, int port, int64_t ttl, int64_t negative_ttl,
+                        struct addrinfo **res, int *gai_error)
+{
+    char           key[1024 + 16];
+    DnsCacheEntry *entry;
+    int64_t        age;
+    int            ret = DNS_CACHE_MISS;
+
+    if (!hostname || !hostname[0])
+        return DNS_CACHE_MISS;
+
+    dns_cache_make_key(key, sizeof(key), hostname, port);
+
+    pthread_mutex_lock(&dns_cache_mutex);
+    entry = *dns_cache_find_locked(key);
+    if (entry && entry->update_time > 0) {
+        age = av_gettime_relative() - entry->update_time;
+        if (entry->gai_error) {
+            if (age < negative_ttl) {
+                *gai_error = entry->gai_error;
+                ret = DNS_CACHE_NEGATIVE;
+            }
+        } else if (ttl < 0 || age < ttl) {
+            *res = dns_cache_copy_addrinfo(entry->res);
+            if (*res)
+                ret = DNS_CACHE_HIT;
+        }
+    }
+
+    if (ret == DNS_CACHE_HIT)
+        dns_cache_stat.hits++;
+    else if (ret == DNS_CACHE_NEGATIVE)
+        dns_cache_stat.negative_hits++;
+    else
+        dns_cache_stat.misses++;
+    pthread_mutex_unlock(&dns_cache_mutex);
+
+    return ret;
+}
+
+void ff_dns_cache_store(const char *hostname, int port, const struct addrinfo *ai, int gai_error)
+{
+    char             key[1024 + 16];
+    DnsCacheEntry   *entry;
+    struct addrinfo *copy = NULL;
+
+    if (!hostname || !hostname[0])
+        return;
+
+    // copy outside of the lock, a long address list is not free
+    if (!gai_error) {
+        copy = dns_cache_copy_addrinfo(ai);
+        if (!copy)
+            return;
+    }
+
+    dns_cache_make_key(key, sizeof(key), hostname, port);
+
+    pthread_mutex_lock(&dns_cache_mutex);
+    entry = dns_cache_get_or_add_locked(key);
+    if (entry) {
+        ff_dns_cache_freeaddrinfo(&entry->res);
+        entry->res         = copy;
+        entry->gai_error   = gai_error;
+        entry->update_time = av_gettime_relative();
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&dns_cache_mutex);
+
+    ff_dns_cache_freeaddrinfo(&copy);
+}
+
+void ff_dns_cache_remove(const char *hostname, int port)
+{
+    char            key[1024 + 16];
+    DnsCacheEntry **p_entry;
+    DnsCacheEntry  *entry;
+
+    if (!hostname || !hostname[0])
+        return;
+
+    dns_cache_make_key(key, sizeof(key), hostname, port);
+
+    pthread_mutex_lock(&dns_cache_mutex);
+    p_entry = dns_cache_find_locked(key);
+    entry   = *p_entry;
+    if (entry) {
+        if (entry->pending) {
+            // the worker still refers to it, only forget the result
+            ff_dns_cache_freeaddrinfo(&entry->res);
+            entry->update_time = 0;
+        } else {
+            *p_entry = entry->next;
+            dns_cache_entry_free(&entry);
+            dns_cache_count--;
+        }
+    }
+    pthread_mutex_unlock(&dns_cache_mutex);
+}
+
+typedef struct DnsPrefetchRequest {
+    char *hostname;
+    int   port;
+} DnsPrefetchRequest;
+
+static void *dns_cache_prefetch_worker(void *arg)
+{
+    DnsPrefetchRequest *req   = arg;
+    struct addrinfo     hints = { 0 };
+    struct addrinfo    *ai    = NULL;
+    DnsCacheEntry      *entry;
+    char                portstr[10];
+    char                key[1024 + 16];
+    int                 ret;
+
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(portstr, sizeof(portstr), "%d", req->port);
+
+    ret = getaddrinfo(req->hostname, portstr, &hints, &ai);
+    if (ret)
+        av_log(NULL, AV_LOG_WARNING, "DNS prefetch %s failed: %s\n", req->hostname, gai_strerror(ret));
+    ff_dns_cache_store(req->hostname, req->port, ai, ret);
+    if (ai)
+        freeaddrinfo(ai);
+
+    dns_cache_make_key(key, sizeof(key), req->hostname, req->port);
+    pthread_mutex_lock(&dns_cache_mutex);
+    entry = *dns_cache_find_locked(key);
+    if (entry)
+        entry->pending = 0;
+    pthread_mutex_unlock(&dns_cache_mutex);
+
+    av_freep(&req->hostname);
+    av_free(req);
+    return NULL;
+}
+
+int av_dns_cache_prefetch(const char *hostname, int port)
+{
+    DnsPrefetchRequest *req;
+    DnsCacheEntry      *entry;
+    pthread_attr_t      attr;
+    pthread_t           thread;
+    char                key[1024 + 16];
+    int                 ret;
+
+    if (!hostname || !hostname[0] || port <= 0 || port >= 65536)
+        return AVERROR(EINVAL);
+
+    dns_cache_make_key(key, sizeof(key), hostname, port);
+
+    pthread_mutex_lock(&dns_cache_mutex);
+    entry = dns_cache_get_or_add_locked(key);
+    if (!entry) {
+        pthread_mutex_unlock(&dns_cache_mutex);
+        return AVERROR(ENOMEM);
+    }
+    if (entry->pending) {
+        pthread_mutex_unlock(&dns_cache_mutex);
+        return 0;
+    }
+    entry->pending = 1;
+    pthread_mutex_unlock(&dns_cache_mutex);
+
+    req = av_mallocz(sizeof(*req));
+    if (!req) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    req->hostname = av_strdup(hostname);
+    req->port     = port;
+    if (!req->hostname) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, dns_cache_prefetch_worker, req);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    if (req)
+        av_freep(&req->hostname);
+    av_free(req);
+    pthread_mutex_lock(&dns_cache_mutex);
+    entry = *dns_cache_find_locked(key);
+    if (entry)
+        entry->pending = 0;
+    pthread_mutex_unlock(&dns_cache_mutex);
+    return ret;
+}
+
+void av_dns_cache_clear(void)
+{
+    DnsCacheEntry **p_entry;
+
+    pthread_mutex_lock(&dns_cache_mutex);
+    p_entry = &dns_cache_head;
+    while (*p_entry) {
+        DnsCacheEntry *entry = *p_entry;
+        if (entry->pending) {
+            ff_dns_cache_freeaddrinfo(&entry->res);
+            entry->update_time = 0;
+            p_entry = &entry->next;
+        } else {
+            *p_entry = entry->next;
+            dns_cache_entry_free(&entry);
+            dns_cache_count--;
+        }
+    }
+    pthread_mutex_unlock(&dns_cache_mutex);
+}
+
+void av_dns_cache_get_statistic(DnsCacheStatistic *stat)
+{
+    pthread_mutex_lock(&dns_cache_mutex);
+    *stat         = dns_cache_stat;
+    stat->entries = dns_cache_count;
+    pthread_mutex_unlock(&dns_cache_mutex);
+}
+
+#else
+
+int ff_dns_cache_lookup(const char *hostname, int port, int64_t ttl, int64_t negative_ttl,
+                        struct addrinfo **res, int *gai_error)
+{
+    return DNS_CACHE_MISS;
+}
+
+void ff_dns_cache_store(const char *hostname, int port, const struct addrinfo *ai, int gai_error)
+{
+}
+
+void ff_dns_cache_remove(const char *hostname, int port)
+{
+}
+
+int av_dns_cache_prefetch(const char *hostname, int port)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_dns_cache_clear(void)
+{
+}
+
+void av_dns_cache_get_statistic(DnsCacheStatistic *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+}
+
+#endif
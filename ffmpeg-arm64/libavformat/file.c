@@ -35,6 +35,9 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,21 +70,35 @@
 
 /* standard file protocol */
 
+/* with mmap, the pages ahead of the read position asked for in advance */
+#define MMAP_READ_AHEAD (4 << 20)
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
     int follow;
+    int use_mmap;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_MMAP
+    /* a regular file read through a mapping of what it had at open, with
+     * use_mmap; what it got since is read from fd */
+    uint8_t *map;
+    int64_t map_size;
+    int64_t pos;
+    int64_t advised;            /* end of the pages asked for */
+    long page_size;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "read a regular file through a memory mapping, without a system call per read", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -104,11 +121,55 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+/* keep the pages of the next MMAP_READ_AHEAD bytes coming in, renewed
+ * half way through */
+static void file_advise(FileContext *c)
+{
+#ifdef MADV_WILLNEED
+    int64_t start, end;
+
+    if (c->advised >= c->map_size || c->pos + MMAP_READ_AHEAD / 2 < c->advised)
+        return;
+    start = c->pos & ~(int64_t)(c->page_size - 1);
+    end   = FFMIN(c->pos + MMAP_READ_AHEAD, c->map_size);
+    if (end > start)
+        madvise(c->map + start, end - start, MADV_WILLNEED);
+    c->advised = end;
+#endif
+}
+
+static int file_read_mapped(FileContext *c, unsigned char *buf, int size)
+{
+    int ret;
+
+    if (c->pos >= c->map_size) {
+        /* written since it was mapped */
+        if (lseek(c->fd, c->pos, SEEK_SET) < 0)
+            return AVERROR(errno);
+        ret = read(c->fd, buf, size);
+        if (ret < 0)
+            return AVERROR(errno);
+        c->pos += ret;
+        return ret;
+    }
+    size = FFMIN(size, c->map_size - c->pos);
+    file_advise(c);
+    memcpy(buf, c->map + c->pos, size);
+    c->pos += size;
+    return size;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_MMAP
+    if (c->map)
+        return file_read_mapped(c, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -227,6 +288,27 @@ static int file_open(URLContext *h, const char *filename, int flags)
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_MMAP
+    /* A file truncated while mapped faults on the pages it lost, hence
+     * opt-in, for files that are complete, like downloads. */
+    if (c->use_mmap && access == O_RDONLY && !c->follow && !h->is_streamed &&
+        S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            c->map       = map;
+            c->map_size  = st.st_size;
+            c->pos       = 0;
+            c->advised   = 0;
+            c->page_size = sysconf(_SC_PAGESIZE);
+            if (c->page_size <= 0)
+                c->page_size = 4096;
+#ifdef MADV_SEQUENTIAL
+            madvise(c->map, c->map_size, MADV_SEQUENTIAL);
+#endif
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -242,6 +324,26 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_MMAP
+    if (c->map) {
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        /* ask for the pages from there on the next read */
+        c->pos = c->advised = pos;
+        return pos;
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -250,6 +352,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
     return close(c->fd);
 }
 
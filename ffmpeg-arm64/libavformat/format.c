@@ -127,6 +127,8 @@ AVOutputFormat *av_guess_format(const char *short_name, const char *filename,
             fmt_found = fmt;
         }
     }
+    if (!fmt_found && ff_format_register_rest())
+        return av_guess_format(short_name, filename, mime_type);
     return fmt_found;
 }
 
@@ -167,6 +169,8 @@ AVInputFormat *av_find_input_format(const char *short_name)
     while ((fmt = av_iformat_next(fmt)))
         if (av_match_name(short_name, fmt->name))
             return fmt;
+    if (ff_format_register_rest())
+        return av_find_input_format(short_name);
     return NULL;
 }
 
@@ -243,6 +247,9 @@ AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened,
         score_max = FFMIN(AVPROBE_SCORE_EXTENSION / 2 - 1, score_max);
     *score_ret = score_max;
 
+    /* a probe none of the allowed demuxers knows anything about */
+    if (!score_max && ff_format_register_rest())
+        return av_probe_input_format3(pd, is_opened, score_ret);
     return fmt;
 }
 
@@ -0,0 +1,135 @@
+/*
+ * HLS adaptive variant selection
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "hls_abr.h"
+
+void ff_hls_abr_add_sample(HLSABREstimate *estimate, int64_t bytes, int64_t elapsed)
+{
+    int64_t bandwidth;
+
+    if (bytes < HLS_ABR_MIN_SAMPLE_BYTES || elapsed <= 0)
+        return;
+
+    bandwidth = bytes * 8 * 1000000 / elapsed;
+    estimate->fast_bandwidth = estimate->fast_bandwidth ?
+                               (estimate->fast_bandwidth + bandwidth) / 2 : bandwidth;
+    estimate->slow_bandwidth = estimate->slow_bandwidth ?
+                               (estimate->slow_bandwidth * 4 + bandwidth) / 5 : bandwidth;
+}
+
+int64_t ff_hls_abr_get_bandwidth(const HLSABREstimate *estimate)
+{
+    if (!estimate->fast_bandwidth)
+        return estimate->slow_bandwidth;
+    if (!estimate->slow_bandwidth)
+        return estimate->fast_bandwidth;
+    return FFMIN(estimate->fast_bandwidth, estimate->slow_bandwidth);
+}
+
+static int64_t usable_bandwidth(const HLSABRPolicy *policy, int64_t bandwidth, int64_t max_bitrate)
+{
+    int64_t usable = bandwidth / 100 * policy->usable_percent;
+    if (max_bitrate > 0)
+        usable = FFMIN(usable, max_bitrate);
+    return usable;
+}
+
+int ff_hls_abr_initial_variant(const HLSABRPolicy *policy, HLSABREstimate *estimate,
+                               const HLSABRVariant *variants, int nb_variants,
+                               int64_t bandwidth, int64_t max_bitrate)
+{
+    int64_t usable;
+    int     first = 0, pick = -1, i;
+
+    if (nb_variants <= 0)
+        return -1;
+
+    /* the leader exports the streams, so it must have the video */
+    while (first < nb_variants - 1 && variants[first].audio_only)
+        first++;
+    if (bandwidth <= 0)
+        return first;
+
+    usable = usable_bandwidth(policy, bandwidth, max_bitrate);
+    for (i = 0; i < nb_variants; i++) {
+        if (!variants[i].audio_only && variants[i].bandwidth <= usable &&
+            (pick < 0 || variants[i].bandwidth > variants[pick].bandwidth))
+            pick = i;
+    }
+    if (pick < 0)
+        return first;
+
+    estimate->slow_bandwidth = bandwidth;
+    return pick;
+}
+
+int ff_hls_abr_check_switch(const HLSABRPolicy *policy, const HLSABREstimate *estimate,
+                            const HLSABRVariant *variants, int nb_variants, int cur,
+                            const AVAppBufferLevel *level, int64_t *bandwidth)
+{
+    const HLSABRVariant *from = &variants[cur], *to;
+    int64_t buffered = level->cached_duration_milli;
+    int64_t estimated, usable;
+    int     next = -1, lowest = -1, n_audio_only = 0, audio_only, at_once;
+    int     i;
+
+    if (!estimate->fast_bandwidth)
+        return -1;
+
+    estimated = ff_hls_abr_get_bandwidth(estimate);
+    if (buffered >= 0 && buffered < policy->panic_buffer)
+        estimated /= 2;
+    if (bandwidth)
+        *bandwidth = estimated;
+    usable = usable_bandwidth(policy, estimated, level->max_bitrate);
+
+    /* the kind of variants picked from, when there are both */
+    for (i = 0; i < nb_variants; i++)
+        n_audio_only += variants[i].audio_only;
+    audio_only = n_audio_only == nb_variants || (n_audio_only && level->audio_only);
+
+    /* the best variant within the usable bandwidth, or the lowest one */
+    for (i = 0; i < nb_variants; i++) {
+        const HLSABRVariant *v = &variants[i];
+        if (v->audio_only != audio_only)
+            continue;
+        if (v->bandwidth <= usable && (next < 0 || v->bandwidth > variants[next].bandwidth))
+            next = i;
+        if (lowest < 0 || v->bandwidth < variants[lowest].bandwidth)
+            lowest = i;
+    }
+    if (next < 0 || (level->audio_only && !audio_only))
+        next = lowest;
+    if (next < 0)
+        return -1;
+
+    to      = &variants[next];
+    at_once = to->audio_only != from->audio_only || (level->audio_only && !n_audio_only);
+    if (next == cur || (to->bandwidth == from->bandwidth && to->audio_only == from->audio_only))
+        return -1;
+    if (!at_once && to->bandwidth > from->bandwidth &&
+        buffered >= 0 && buffered < policy->upswitch_buffer)
+        return -1;
+    if (!at_once && to->bandwidth < from->bandwidth && buffered >= policy->hold_buffer &&
+        (level->max_bitrate <= 0 || from->bandwidth <= level->max_bitrate))
+        return -1;
+    return next;
+}
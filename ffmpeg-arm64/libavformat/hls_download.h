@@ -0,0 +1,98 @@
+/*
+ * Offline download of an HLS stream
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_DOWNLOAD_H
+#define AVFORMAT_HLS_DOWNLOAD_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avio.h"
+
+/**
+ * A download fetches the segments of one variant of an HLS stream, and of
+ * its audio rendition, into a directory: several at once, over the http
+ * connection pool, and from the disk cache for the ones cached whole. A
+ * file is written as "<name>.part" and renamed once complete, so a run
+ * after an interrupted one resumes the partial files with range requests
+ * and skips the complete ones.
+ *
+ * Once every file is in, the directory gets "index.m3u8", a playlist of
+ * the local files with the keys, initialization sections and
+ * discontinuities of the remote one. It plays with the hls demuxer; set
+ * the "mmap" format option for the file protocol to map the segments.
+ */
+
+#define AV_HLS_DOWNLOAD_PLAYLIST "index.m3u8"
+
+typedef struct AVHLSDownload AVHLSDownload;
+
+typedef struct AVHLSDownloadProgress {
+    int     bandwidth;          // of the variant
+    int     nb_files;           // segments, keys and initialization sections
+    int     nb_done;
+    int64_t bytes;              // of the files done or in progress, resumed ones included
+    int64_t bytes_cached;       // copied from the disk cache
+    int64_t duration;           // of the segments done, in AV_TIME_BASE units
+    int64_t total_duration;
+} AVHLSDownloadProgress;
+
+/**
+ * Load the playlists of the variant to download.
+ *
+ * @param dir           created if needed
+ * @param max_bandwidth the variant of the highest bandwidth up to this is
+ *                      chosen, the lowest if none is; <= 0 for the highest
+ * @param options       format options as given to the player, the http
+ *                      ones are used for every request, may be NULL
+ * @param int_cb        checked by every request, may be NULL
+ * @return 0 on success, a negative AVERROR otherwise (AVERROR(ENOSYS)
+ *         without thread support)
+ */
+int  av_hls_download_open(AVHLSDownload **pd, const char *url, const char *dir,
+                          int max_bandwidth, AVDictionary *options,
+                          const AVIOInterruptCB *int_cb);
+
+/**
+ * Download the files not in the directory yet and write the playlist.
+ * Blocks the calling thread until done, failed or interrupted; an
+ * interrupted run leaves what it got for the next one.
+ *
+ * @param max_connections requests in flight at once
+ * @param max_per_host    of them to the same host
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int  av_hls_download_run(AVHLSDownload *d, int max_connections, int max_per_host);
+
+/**
+ * Limit the download, from any thread, to one request at a time and
+ * max_rate bytes per second, e.g. while a player streams. 0 lifts the
+ * limit.
+ */
+void av_hls_download_set_rate(AVHLSDownload *d, int64_t max_rate);
+
+/**
+ * May be called from any thread.
+ */
+void av_hls_download_get_progress(AVHLSDownload *d, AVHLSDownloadProgress *progress);
+
+void av_hls_download_close(AVHLSDownload **pd);
+
+#endif /* AVFORMAT_HLS_DOWNLOAD_H */
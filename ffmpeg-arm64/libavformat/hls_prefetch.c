@@ -0,0 +1,514 @@
+/*
+ * Parallel download of upcoming HLS segments
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "hls_prefetch.h"
+#include "url.h"
+
+#if HAVE_PTHREADS
+
+#include <pthread.h>
+
+#define PREFETCH_CHUNK_SIZE 32768
+
+enum PrefetchState {
+    PREFETCH_FREE,
+    PREFETCH_QUEUED,
+    PREFETCH_DOWNLOADING,
+    PREFETCH_DONE,
+};
+
+struct HLSPrefetchSegment {
+    HLSPrefetch        *owner;
+    enum PrefetchState  state;
+    int                 seq_no;
+    char               *url;
+    int64_t             seek_offset;
+    AVDictionary       *opts;
+
+    uint8_t            *buf;
+    unsigned int        buf_size;
+    int                 data_len;
+    int                 read_pos;
+    int                 error;      // why the download stopped, 0 at the end of the segment
+    int64_t             download_time;  // without the waits for buffer space
+
+    int                 cancel;     // a worker frees the segment when its download stops
+    int                 taken;
+};
+
+struct HLSPrefetch {
+    void               *log_ctx;
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    pthread_t           workers[HLS_PREFETCH_MAX_SEGMENTS];
+    int                 nb_workers;
+    int                 abort_request;
+
+    HLSPrefetchSegment  segments[HLS_PREFETCH_MAX_SEGMENTS];
+    int64_t             max_size;
+    int64_t             buffered;   // downloaded and not read yet
+
+    AVIOInterruptCB     int_cb;
+    char               *whitelist;
+    char               *blacklist;
+};
+
+// must be called locked
+static void prefetch_segment_reset(HLSPrefetch *p, HLSPrefetchSegment *seg)
+{
+    p->buffered -= seg->data_len - seg->read_pos;
+    av_freep(&seg->url);
+    av_dict_free(&seg->opts);
+    av_freep(&seg->buf);
+    memset(seg, 0, sizeof(*seg));
+    seg->owner = p;
+}
+
+static int prefetch_interrupt_cb(void *opaque)
+{
+    HLSPrefetchSegment *seg = opaque;
+    HLSPrefetch        *p   = seg->owner;
+
+    return seg->cancel || p->abort_request || ff_check_interrupt(&p->int_cb);
+}
+
+// must be called locked
+static int prefetch_is_first_downloading(HLSPrefetch *p, HLSPrefetchSegment *seg)
+{
+    int i;
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++) {
+        HLSPrefetchSegment *other = &p->segments[i];
+        if (other->state == PREFETCH_DOWNLOADING && !other->cancel && other->seq_no < seg->seq_no)
+            return 0;
+    }
+    return 1;
+}
+
+static int prefetch_download(HLSPrefetch *p, HLSPrefetchSegment *seg, uint8_t *chunk)
+{
+    AVIOContext     *pb     = NULL;
+    AVIOInterruptCB  int_cb = { prefetch_interrupt_cb, seg };
+    int64_t          start  = av_gettime_relative();
+    int64_t          waited = 0;
+    int              ret;
+
+    ret = ffio_open_whitelist(&pb, seg->url, AVIO_FLAG_READ, &int_cb, &seg->opts,
+                              p->whitelist, p->blacklist);
+    if (ret < 0)
+        return ret;
+
+    if (seg->seek_offset > 0) {
+        int64_t seek_ret = avio_seek(pb, seg->seek_offset, SEEK_SET);
+        if (seek_ret < 0) {
+            ret = seek_ret;
+            goto end;
+        }
+    }
+
+    while (1) {
+        int64_t wait_start = av_gettime_relative();
+        pthread_mutex_lock(&p->mutex);
+        while (!seg->cancel && !p->abort_request && p->buffered >= p->max_size &&
+               !prefetch_is_first_downloading(p, seg))
+            pthread_cond_wait(&p->cond, &p->mutex);
+        pthread_mutex_unlock(&p->mutex);
+        waited += av_gettime_relative() - wait_start;
+        if (prefetch_interrupt_cb(seg)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+
+        ret = avio_read(pb, chunk, PREFETCH_CHUNK_SIZE);
+        if (ret <= 0)
+            break;
+
+        pthread_mutex_lock(&p->mutex);
+        if (seg->data_len + ret > seg->buf_size) {
+            uint8_t *buf = av_fast_realloc(seg->buf, &seg->buf_size,
+                                           FFMAX(seg->data_len + ret, seg->buf_size * 2));
+            if (!buf) {
+                pthread_mutex_unlock(&p->mutex);
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            seg->buf = buf;
+        }
+        memcpy(seg->buf + seg->data_len, chunk, ret);
+        seg->data_len += ret;
+        p->buffered   += ret;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+    }
+
+end:
+    avio_closep(&pb);
+    seg->download_time = av_gettime_relative() - start - waited;
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+static void *prefetch_worker(void *arg)
+{
+    HLSPrefetch *p     = arg;
+    uint8_t     *chunk = av_malloc(PREFETCH_CHUNK_SIZE);
+    int          i, ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (chunk && !p->abort_request) {
+        HLSPrefetchSegment *seg = NULL;
+
+        // earliest first, it is the one needed next
+        for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++) {
+            HLSPrefetchSegment *cand = &p->segments[i];
+            if (cand->state == PREFETCH_QUEUED && (!seg || cand->seq_no < seg->seq_no))
+                seg = cand;
+        }
+        if (!seg) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+
+        seg->state = PREFETCH_DOWNLOADING;
+        pthread_mutex_unlock(&p->mutex);
+
+        av_log(p->log_ctx, AV_LOG_DEBUG, "HLS prefetch of segment %d, url '%s'\n",
+               seg->seq_no, seg->url);
+        ret = prefetch_download(p, seg, chunk);
+
+        pthread_mutex_lock(&p->mutex);
+        if (seg->cancel) {
+            prefetch_segment_reset(p, seg);
+        } else {
+            if (ret < 0)
+                av_log(p->log_ctx, AV_LOG_WARNING, "HLS prefetch of segment %d failed: %s\n",
+                       seg->seq_no, av_err2str(ret));
+            seg->error = ret;
+            seg->state = PREFETCH_DONE;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    av_free(chunk);
+    return NULL;
+}
+
+int ff_hls_prefetch_alloc(HLSPrefetch **pp, int nb_workers, int64_t max_size,
+                          const AVIOInterruptCB *int_cb,
+                          const char *whitelist, const char *blacklist,
+                          void *log_ctx)
+{
+    HLSPrefetch *p;
+    int i, ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->log_ctx  = log_ctx;
+    p->max_size = max_size;
+    if (int_cb)
+        p->int_cb = *int_cb;
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++)
+        p->segments[i].owner = p;
+    if ((whitelist && !(p->whitelist = av_strdup(whitelist))) ||
+        (blacklist && !(p->blacklist = av_strdup(blacklist)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    nb_workers = av_clip(nb_workers, 1, HLS_PREFETCH_MAX_SEGMENTS);
+    for (i = 0; i < nb_workers; i++) {
+        ret = pthread_create(&p->workers[i], NULL, prefetch_worker, p);
+        if (ret) {
+            av_log(log_ctx, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            break;
+        }
+        p->nb_workers++;
+    }
+    if (!p->nb_workers) {
+        ff_hls_prefetch_freep(&p);
+        return AVERROR(ret);
+    }
+
+    *pp = p;
+    return 0;
+fail:
+    av_freep(&p->whitelist);
+    av_freep(&p->blacklist);
+    av_freep(&p);
+    return ret;
+}
+
+void ff_hls_prefetch_freep(HLSPrefetch **pp)
+{
+    HLSPrefetch *p = *pp;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort_request = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (i = 0; i < p->nb_workers; i++)
+        pthread_join(p->workers[i], NULL);
+
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++)
+        prefetch_segment_reset(p, &p->segments[i]);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->whitelist);
+    av_freep(&p->blacklist);
+    av_freep(pp);
+}
+
+// must be called locked
+static HLSPrefetchSegment *prefetch_find_locked(HLSPrefetch *p, int seq_no)
+{
+    int i;
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++) {
+        HLSPrefetchSegment *seg = &p->segments[i];
+        if (seg->state != PREFETCH_FREE && !seg->cancel && seg->seq_no == seq_no)
+            return seg;
+    }
+    return NULL;
+}
+
+// must be called locked
+static void prefetch_drop_locked(HLSPrefetch *p, HLSPrefetchSegment *seg)
+{
+    if (seg->state == PREFETCH_DOWNLOADING)
+        seg->cancel = 1;
+    else
+        prefetch_segment_reset(p, seg);
+}
+
+int ff_hls_prefetch_schedule(HLSPrefetch *p, int seq_no, const char *url,
+                             int64_t seek_offset, AVDictionary *opts)
+{
+    HLSPrefetchSegment *seg = NULL;
+    int i, ret = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    if (prefetch_find_locked(p, seq_no))
+        goto end;
+
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++) {
+        if (p->segments[i].state == PREFETCH_FREE) {
+            seg = &p->segments[i];
+            break;
+        }
+    }
+    if (!seg) {
+        ret = AVERROR(EAGAIN);
+        goto end;
+    }
+
+    seg->url = av_strdup(url);
+    if (!seg->url || av_dict_copy(&seg->opts, opts, 0) < 0) {
+        prefetch_segment_reset(p, seg);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    seg->seq_no      = seq_no;
+    seg->seek_offset = seek_offset;
+    seg->state       = PREFETCH_QUEUED;
+    pthread_cond_broadcast(&p->cond);
+end:
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+void ff_hls_prefetch_cancel_outside(HLSPrefetch *p, int first_seq_no, int last_seq_no)
+{
+    int i;
+
+    pthread_mutex_lock(&p->mutex);
+    for (i = 0; i < HLS_PREFETCH_MAX_SEGMENTS; i++) {
+        HLSPrefetchSegment *seg = &p->segments[i];
+        if (seg->state == PREFETCH_FREE || seg->cancel || seg->taken)
+            continue;
+        if (seg->seq_no < first_seq_no || seg->seq_no > last_seq_no)
+            prefetch_drop_locked(p, seg);
+    }
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+HLSPrefetchSegment *ff_hls_prefetch_take(HLSPrefetch *p, int seq_no)
+{
+    HLSPrefetchSegment *seg;
+
+    pthread_mutex_lock(&p->mutex);
+    seg = prefetch_find_locked(p, seq_no);
+    if (seg && (seg->state == PREFETCH_QUEUED || (seg->state == PREFETCH_DONE && seg->error < 0 && !seg->data_len))) {
+        prefetch_segment_reset(p, seg);
+        seg = NULL;
+    }
+    if (seg)
+        seg->taken = 1;
+    pthread_mutex_unlock(&p->mutex);
+
+    return seg;
+}
+
+int ff_hls_prefetch_read(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                         uint8_t *buf, int buf_size)
+{
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (seg->read_pos >= seg->data_len && seg->state != PREFETCH_DONE) {
+        if (ff_check_interrupt(&p->int_cb)) {
+            pthread_mutex_unlock(&p->mutex);
+            return AVERROR_EXIT;
+        }
+        pthread_cond_wait(&p->cond, &p->mutex);
+    }
+
+    if (seg->read_pos < seg->data_len) {
+        ret = FFMIN(buf_size, seg->data_len - seg->read_pos);
+        memcpy(buf, seg->buf + seg->read_pos, ret);
+        seg->read_pos += ret;
+        p->buffered   -= ret;
+        // a worker may wait for buffer space
+        pthread_cond_broadcast(&p->cond);
+    } else {
+        ret = seg->error < 0 ? seg->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+int ff_hls_prefetch_get_timing(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                               int64_t *bytes, int64_t *elapsed)
+{
+    int ret = AVERROR(EAGAIN);
+
+    pthread_mutex_lock(&p->mutex);
+    if (seg->state == PREFETCH_DONE) {
+        *bytes   = seg->data_len;
+        *elapsed = seg->download_time;
+        ret = seg->error;
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+void ff_hls_prefetch_release(HLSPrefetch *p, HLSPrefetchSegment **pseg)
+{
+    HLSPrefetchSegment *seg = *pseg;
+
+    if (!seg)
+        return;
+    *pseg = NULL;
+
+    pthread_mutex_lock(&p->mutex);
+    seg->taken = 0;
+    prefetch_drop_locked(p, seg);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+int ff_hls_prefetch_done_until(HLSPrefetch *p, int seq_no)
+{
+    HLSPrefetchSegment *seg;
+
+    pthread_mutex_lock(&p->mutex);
+    while ((seg = prefetch_find_locked(p, seq_no)) &&
+           seg->state == PREFETCH_DONE && !seg->error)
+        seq_no++;
+    pthread_mutex_unlock(&p->mutex);
+
+    return seq_no - 1;
+}
+
+#else
+
+int ff_hls_prefetch_alloc(HLSPrefetch **pp, int nb_workers, int64_t max_size,
+                          const AVIOInterruptCB *int_cb,
+                          const char *whitelist, const char *blacklist,
+                          void *log_ctx)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_hls_prefetch_freep(HLSPrefetch **pp)
+{
+}
+
+int ff_hls_prefetch_schedule(HLSPrefetch *p, int seq_no, const char *url,
+                             int64_t seek_offset, AVDictionary *opts)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_hls_prefetch_cancel_outside(HLSPrefetch *p, int first_seq_no, int last_seq_no)
+{
+}
+
+HLSPrefetchSegment *ff_hls_prefetch_take(HLSPrefetch *p, int seq_no)
+{
+    return NULL;
+}
+
+int ff_hls_prefetch_read(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                         uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_hls_prefetch_get_timing(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                               int64_t *bytes, int64_t *elapsed)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_hls_prefetch_release(HLSPrefetch *p, HLSPrefetchSegment **pseg)
+{
+}
+
+int ff_hls_prefetch_done_until(HLSPrefetch *p, int seq_no)
+{
+    return seq_no - 1;
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * HTTP/3 transport supplied by the application
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP3TRANSPORT_H
+#define AVFORMAT_HTTP3TRANSPORT_H
+
+#include <stdint.h>
+
+/**
+ * An HTTP/3 transport carries the https requests of the http protocol over
+ * QUIC, with the "http3" option, through the QUIC stack of the platform:
+ * the application registers one for the process, which owns the
+ * connections, their 0-RTT resumption and their migration from one network
+ * to another. A request is pulled: the transport reports the bytes it does
+ * not have yet as such, and the reader waits until av_http3_request_ready()
+ * is called for the request.
+ */
+
+typedef struct AVHTTP3Request AVHTTP3Request;
+
+/**
+ * Of the connection a request went over, once it is closed.
+ */
+typedef struct AVHTTP3ConnectionStats {
+    char    protocol[16];       // ALPN of the connection: "h3", or what the transport fell back to
+    char    remote_ip[64];      // empty if unknown
+    int     reused;             // the connection was open before the request
+    int64_t connect_time;       // microseconds to set the connection up, handshake included, 0 if reused
+    int64_t request_time;       // microseconds from the request to the end of the response
+    int64_t bytes;              // of the response body received
+} AVHTTP3ConnectionStats;
+
+typedef struct AVHTTP3TransportCallbacks {
+    /**
+     * Start a request. Called from the reading thread.
+     *
+     * @param request to pass to av_http3_request_ready()
+     * @param method  "GET" or "HEAD"
+     * @param url     "https://host[:port]/path"
+     * @param headers "Name: value\r\n" lines, without the hop by hop ones
+     * @param handle  set to what the other callbacks get back
+     * @return 0, or a negative AVERROR; an origin without HTTP/3 is for
+     *         the transport to fall back from
+     */
+    int (*open)(void *opaque, AVHTTP3Request *request, const char *method,
+                const char *url, const char *headers, void **handle);
+
+    /**
+     * Get the response head.
+     *
+     * @param status  set to the status code
+     * @param headers filled with "Name: value\r\n" lines describing the
+     *                body as read, without the hop by hop ones
+     * @return 0, AVERROR(EAGAIN) if the head did not come yet,
+     *         AVERROR(ENOSPC) if it does not fit, another negative AVERROR
+     *         if the request failed
+     */
+    int (*read_head)(void *opaque, void *handle, int *status, char *headers, int size);
+
+    /**
+     * Read the response body.
+     *
+     * @return the number of bytes read, 0 at the end of the body,
+     *         AVERROR(EAGAIN) if the bytes did not come yet, another
+     *         negative AVERROR if the request failed
+     */
+    int (*read)(void *opaque, void *handle, uint8_t *buf, int size);
+
+    /**
+     * Close the request, cancelling it if the response is not over;
+     * av_http3_request_ready() is not to be called for it afterwards.
+     *
+     * @param stats filled with what is known of the connection
+     */
+    void (*close)(void *opaque, void *handle, AVHTTP3ConnectionStats *stats);
+} AVHTTP3TransportCallbacks;
+
+/**
+ * Register the transport of the process, once; the requests opened
+ * afterwards with the "http3" option go through it.
+ *
+ * @param cb     copied, all required
+ * @param opaque passed to the callbacks, for the life of the process
+ * @return 0, AVERROR(EEXIST) if a transport is registered already,
+ *         AVERROR(EINVAL) if a callback is missing
+ */
+int av_http3_register_transport(const AVHTTP3TransportCallbacks *cb, void *opaque);
+
+/**
+ * Wake the reader of request waiting for the response head or body.
+ * Can be called from any thread, until the request is closed.
+ */
+void av_http3_request_ready(AVHTTP3Request *request);
+
+#endif /* AVFORMAT_HTTP3TRANSPORT_H */
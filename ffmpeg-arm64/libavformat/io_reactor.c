@@ -0,0 +1,317 @@
+/*
+ * Process wide IO reactor
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+
+#include "io_reactor.h"
+
+#if HAVE_PTHREADS && (defined(__APPLE__) || defined(__FreeBSD__))
+#define IO_REACTOR_KQUEUE 1
+#include <pthread.h>
+#include <sys/event.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#define IO_REACTOR_KQUEUE 0
+#endif
+
+#if IO_REACTOR_KQUEUE
+
+#define IO_REACTOR_WORKERS_MIN  2
+#define IO_REACTOR_WORKERS_MAX  4
+#define IO_REACTOR_EVENTS       32
+
+enum {
+    SOURCE_WAITING,
+    SOURCE_QUEUED,
+    SOURCE_RUNNING,
+    SOURCE_DONE,
+};
+
+struct FFIOReactorSource {
+    FFIOReactorStep    step;
+    void              *opaque;
+    int                state;
+    int                rerun;       // woken while running
+    int                fd;          // watched for reading, -1 if none
+    int                timer;       // a timer is armed
+    FFIOReactorSource *next;        // in the run queue, or freed
+};
+
+typedef struct IOReactor {
+    pthread_mutex_t    mutex;
+    pthread_cond_t     cond_run;
+    pthread_cond_t     cond_done;
+    FFIOReactorSource *head;
+    FFIOReactorSource *tail;
+    // joined, freed by the poll thread once no event it is handling can
+    // point to them anymore
+    FFIOReactorSource *freed;
+    int                kq;
+} IOReactor;
+
+static IOReactor      reactor;
+static pthread_once_t reactor_once = PTHREAD_ONCE_INIT;
+static int            reactor_ok;
+
+// must be called locked
+static void reactor_unwatch(IOReactor *r, FFIOReactorSource *src)
+{
+    struct kevent ev;
+
+    // one change at a time: a oneshot that fired is gone already, and the
+    // error would cut the changes after it
+    if (src->fd >= 0) {
+        EV_SET(&ev, src->fd, EVFILT_READ, EV_DELETE, 0, 0, src);
+        kevent(r->kq, &ev, 1, NULL, 0, NULL);
+        src->fd = -1;
+    }
+    if (src->timer) {
+        EV_SET(&ev, (uintptr_t)src, EVFILT_TIMER, EV_DELETE, 0, 0, src);
+        kevent(r->kq, &ev, 1, NULL, 0, NULL);
+        src->timer = 0;
+    }
+}
+
+// must be called locked
+static void reactor_queue(IOReactor *r, FFIOReactorSource *src)
+{
+    src->state = SOURCE_QUEUED;
+    src->next  = NULL;
+    if (r->tail)
+        r->tail->next = src;
+    else
+        r->head = src;
+    r->tail = src;
+    pthread_cond_signal(&r->cond_run);
+}
+
+// must be called locked
+static void reactor_watch(IOReactor *r, FFIOReactorSource *src, int fd, int64_t timeout)
+{
+    struct kevent ev;
+
+    src->state = SOURCE_WAITING;
+    if (fd >= 0) {
+        EV_SET(&ev, fd, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, src);
+        if (kevent(r->kq, &ev, 1, NULL, 0, NULL) < 0) {
+            reactor_queue(r, src);
+            return;
+        }
+        src->fd = fd;
+    }
+    if (timeout > 0) {
+        EV_SET(&ev, (uintptr_t)src, EVFILT_TIMER, EV_ADD | EV_ONESHOT, NOTE_USECONDS, timeout, src);
+        if (kevent(r->kq, &ev, 1, NULL, 0, NULL) < 0) {
+            reactor_unwatch(r, src);
+            reactor_queue(r, src);
+            return;
+        }
+        src->timer = 1;
+    }
+}
+
+static void *reactor_poll(void *arg)
+{
+    IOReactor      *r = arg;
+    struct kevent   events[IO_REACTOR_EVENTS];
+    struct timespec sweep = { 1, 0 };
+    int             i, n;
+
+    for (;;) {
+        pthread_mutex_lock(&r->mutex);
+        while (r->freed) {
+            FFIOReactorSource *src = r->freed;
+            r->freed = src->next;
+            av_free(src);
+        }
+        pthread_mutex_unlock(&r->mutex);
+
+        n = kevent(r->kq, NULL, 0, events, IO_REACTOR_EVENTS, &sweep);
+        if (n <= 0)
+            continue;
+
+        pthread_mutex_lock(&r->mutex);
+        for (i = 0; i < n; i++) {
+            FFIOReactorSource *src = events[i].udata;
+            if (events[i].flags & EV_ERROR)
+                continue;
+            // a late event of a wait already over at worst runs the step once more
+            if (src->state == SOURCE_WAITING) {
+                reactor_unwatch(r, src);
+                reactor_queue(r, src);
+            }
+        }
+        pthread_mutex_unlock(&r->mutex);
+    }
+    return NULL;
+}
+
+static void *reactor_work(void *arg)
+{
+    IOReactor *r = arg;
+
+    pthread_mutex_lock(&r->mutex);
+    for (;;) {
+        FFIOReactorSource *src;
+        int64_t            timeout = 0;
+        int                fd      = -1;
+        int                wait;
+
+        while (!r->head)
+            pthread_cond_wait(&r->cond_run, &r->mutex);
+        src     = r->head;
+        r->head = src->next;
+        if (!r->head)
+            r->tail = NULL;
+        src->state = SOURCE_RUNNING;
+        src->rerun = 0;
+        pthread_mutex_unlock(&r->mutex);
+
+        wait = src->step(src->opaque, &fd, &timeout);
+
+        pthread_mutex_lock(&r->mutex);
+        if (wait == FF_IO_REACTOR_DONE) {
+            src->state = SOURCE_DONE;
+            pthread_cond_broadcast(&r->cond_done);
+        } else if (src->rerun || wait == FF_IO_REACTOR_RUN) {
+            reactor_queue(r, src);
+        } else {
+            reactor_watch(r, src, wait == FF_IO_REACTOR_WAIT_READ ? fd : -1, timeout);
+        }
+    }
+    return NULL;
+}
+
+static int reactor_spawn(void *(*func)(void *))
+{
+    pthread_attr_t attr;
+    pthread_t      thread;
+    int            ret;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, func, &reactor);
+    pthread_attr_destroy(&attr);
+    return ret;
+}
+
+static void reactor_init(void)
+{
+    IOReactor *r       = &reactor;
+    int        workers = av_clip(av_cpu_count(), IO_REACTOR_WORKERS_MIN, IO_REACTOR_WORKERS_MAX);
+    int        i;
+
+    r->kq = kqueue();
+    if (r->kq < 0) {
+        av_log(NULL, AV_LOG_WARNING, "io_reactor: kqueue failed, a thread per context\n");
+        return;
+    }
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->cond_run, NULL);
+    pthread_cond_init(&r->cond_done, NULL);
+
+    if (reactor_spawn(reactor_poll)) {
+        av_log(NULL, AV_LOG_WARNING, "io_reactor: no poll thread, a thread per context\n");
+        return;
+    }
+    // the threads stay for the life of the process, as idle as the sources
+    for (i = 0; i < workers; i++) {
+        if (reactor_spawn(reactor_work))
+            break;
+    }
+    reactor_ok = i > 0;
+}
+
+int ff_io_reactor_add(FFIOReactorSource **psrc, FFIOReactorStep step, void *opaque)
+{
+    IOReactor         *r = &reactor;
+    FFIOReactorSource *src;
+
+    pthread_once(&reactor_once, reactor_init);
+    if (!reactor_ok)
+        return AVERROR(ENOSYS);
+
+    src = av_mallocz(sizeof(*src));
+    if (!src)
+        return AVERROR(ENOMEM);
+    src->step   = step;
+    src->opaque = opaque;
+    src->fd     = -1;
+    *psrc       = src;
+
+    pthread_mutex_lock(&r->mutex);
+    reactor_queue(r, src);
+    pthread_mutex_unlock(&r->mutex);
+    return 0;
+}
+
+void ff_io_reactor_wake(FFIOReactorSource *src)
+{
+    IOReactor *r = &reactor;
+
+    pthread_mutex_lock(&r->mutex);
+    if (src->state == SOURCE_WAITING) {
+        reactor_unwatch(r, src);
+        reactor_queue(r, src);
+    } else if (src->state == SOURCE_RUNNING) {
+        src->rerun = 1;
+    }
+    pthread_mutex_unlock(&r->mutex);
+}
+
+void ff_io_reactor_join(FFIOReactorSource **psrc)
+{
+    IOReactor         *r   = &reactor;
+    FFIOReactorSource *src = *psrc;
+
+    if (!src)
+        return;
+
+    pthread_mutex_lock(&r->mutex);
+    while (src->state != SOURCE_DONE)
+        pthread_cond_wait(&r->cond_done, &r->mutex);
+    src->next = r->freed;
+    r->freed  = src;
+    pthread_mutex_unlock(&r->mutex);
+    *psrc = NULL;
+}
+
+#else
+
+int ff_io_reactor_add(FFIOReactorSource **src, FFIOReactorStep step, void *opaque)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_io_reactor_wake(FFIOReactorSource *src)
+{
+}
+
+void ff_io_reactor_join(FFIOReactorSource **src)
+{
+}
+
+#endif /* IO_REACTOR_KQUEUE */
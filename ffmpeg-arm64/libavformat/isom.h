@@ -126,9 +126,31 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Cursor of a sample index that is built while demuxing, a window of
+ * samples at a time, instead of when opening the file.
+ */
+typedef struct MOVLazyIndex {
+    unsigned int window;          ///< samples per window, 0 once the index is complete
+    unsigned int first_sample;    ///< sample number of st->index_entries[0]
+    unsigned int sample;          ///< next sample to add, sample_count at the end
+    unsigned int chunk;
+    unsigned int chunk_sample;    ///< position of the next sample in its chunk
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stss_index;
+    unsigned int distance;
+    unsigned int discard_samples; ///< leading samples outside of the edit list
+    int64_t offset;
+    int64_t dts;
+    int64_t start_dts;            ///< dts of the first sample
+} MOVLazyIndex;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
+    int split_input;      ///< to be read through an input of its own, opened at its first packet
     int ffindex;          ///< AVStream index
     int next_chunk;
     unsigned int chunk_count;
@@ -160,6 +182,7 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    MOVLazyIndex lazy_index;
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -248,6 +271,8 @@ typedef struct MOVContext {
     MOVFragmentIndex** fragment_index_data;
     unsigned fragment_index_count;
     int fragment_index_complete;
+    int keep_fragments;   ///< fragments kept indexed behind the one being read, -1 to keep all
+    int64_t fragment_duration; ///< from mehd, in the movie timescale, 0 if unknown
     int atom_depth;
     unsigned int aax_mode;  ///< 'aax' file has been detected
     uint8_t file_key[20];
@@ -260,6 +285,8 @@ typedef struct MOVContext {
     uint8_t *decryption_key;
     int decryption_key_len;
     int enable_drefs;
+    int lazy_index;       ///< samples per window of lazily built indexes, 0 to build them when opening
+    int64_t split_distance; ///< bytes between the samples of a time past which a track gets its own input, 0 for never
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
 } MOVContext;
 
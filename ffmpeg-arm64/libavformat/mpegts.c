@@ -1610,7 +1610,7 @@ static void scte_data_cb(MpegTSFilter *filter, const uint8_t *section,
     MpegTSContext *ts = filter->u.section_filter.opaque;
 
     int idx = ff_find_stream_index(ts->stream, filter->pid);
-    if (idx < 0)
+    if (idx < 0 || ts->stream->streams[idx]->discard == AVDISCARD_ALL)
         return;
 
     new_data_packet(section, section_len, ts->pkt);
@@ -2247,6 +2247,13 @@ static int parse_pcr(int64_t *ppcr_high, int *ppcr_low,
                      const uint8_t *packet);
 
 /* handle one TS packet */
+/* no stream of the PES is read, it is skipped at the PES header anyway */
+static int pes_is_discarded(PESContext *pes)
+{
+    return pes->st && pes->st->discard == AVDISCARD_ALL &&
+           (!pes->sub_st || pes->sub_st->discard == AVDISCARD_ALL);
+}
+
 static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
 {
     MpegTSFilter *tss;
@@ -2273,6 +2280,23 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
         return 0;
     has_adaptation   = afc & 2;
     has_payload      = afc & 1;
+
+    /* Drop the packets of unread streams before any work on them; those
+     * with an adaptation field go on, as they may carry the PCR. The
+     * PES being assembled is dropped too, a stream read again starts
+     * at the next PES header. */
+    if (tss->type == MPEGTS_PES && !has_adaptation &&
+        pes_is_discarded(tss->u.pes_filter.opaque)) {
+        PESContext *pes = tss->u.pes_filter.opaque;
+        if (pes->state != MPEGTS_SKIP) {
+            av_buffer_unref(&pes->buffer);
+            pes->data_index = 0;
+            pes->state      = MPEGTS_SKIP;
+        }
+        tss->last_cc = -1;
+        return 0;
+    }
+
     is_discontinuity = has_adaptation &&
                        packet[4] != 0 && /* with length > 0 */
                        (packet[5] & 0x80); /* and discontinuity indicated */
@@ -2343,8 +2367,10 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
         }
 
         // stop find_stream_info from waiting for more streams
-        // when all programs have received a PMT
-        if (ts->stream->ctx_flags & AVFMTCTX_NOHEADER && ts->scan_all_pmts <= 0) {
+        // when all programs have received a PMT, fast open trusts the
+        // PMTs seen so far even when asked to scan for all of them
+        if (ts->stream->ctx_flags & AVFMTCTX_NOHEADER &&
+            (ts->scan_all_pmts <= 0 || (ts->stream->flags & AVFMT_FLAG_FAST_OPEN))) {
             int i;
             for (i = 0; i < ts->nb_prg; i++) {
                 if (!ts->prg[i].pmt_found)
@@ -2427,15 +2453,32 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
         return 0;
     }
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            avio_seek(pb, -1, SEEK_CUR);
+    /* look for the sync byte in what is buffered with memchr(), which the
+     * C library vectorizes, refilling a byte at a time */
+    for (i = 0; i < ts->resync_size; ) {
+        int avail = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        const uint8_t *sync;
+
+        if (avail <= 0) {
+            c = avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
+            i++;
+            if (c == 0x47) {
+                avio_seek(pb, -1, SEEK_CUR);
+                reanalyze(s->priv_data);
+                return 0;
+            }
+            continue;
+        }
+        sync = memchr(pb->buf_ptr, 0x47, avail);
+        if (sync) {
+            pb->buf_ptr = (uint8_t *)sync;
             reanalyze(s->priv_data);
             return 0;
         }
+        pb->buf_ptr += avail;
+        i += avail;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -0,0 +1,169 @@
+/*
+ * Warm the caches for a url before it is played
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/mathematics.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "preload.h"
+
+/* read packets until duration of media past the first ones or max_bytes */
+static int preload_window(AVFormatContext *ic, int nb_streams, int64_t *start,
+                          int64_t duration, int64_t max_bytes,
+                          int64_t *pbytes, int64_t *pread)
+{
+    int64_t  bytes = 0;
+    int64_t  read  = 0;
+    AVPacket pkt;
+    int      ret   = 0;
+    int      i;
+
+    for (i = 0; i < nb_streams; i++)
+        start[i] = AV_NOPTS_VALUE;
+
+    av_init_packet(&pkt);
+    while ((duration <= 0 || read < duration) && (max_bytes <= 0 || bytes < max_bytes)) {
+        int64_t ts;
+
+        ret = av_read_frame(ic, &pkt);
+        if (ret == AVERROR_EOF) {
+            ret = 0;
+            break;
+        }
+        if (ret < 0)
+            break;
+
+        bytes += pkt.size;
+        ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        // streams added after the header (hls, mpegts) are not tracked,
+        // the ones present at open time are enough to measure progress
+        if (ts != AV_NOPTS_VALUE && pkt.stream_index < nb_streams) {
+            AVStream *st = ic->streams[pkt.stream_index];
+
+            if (start[pkt.stream_index] == AV_NOPTS_VALUE)
+                start[pkt.stream_index] = ts;
+            read = FFMAX(read, av_rescale_q(ts - start[pkt.stream_index],
+                                            st->time_base, AV_TIME_BASE_Q));
+        }
+        av_packet_unref(&pkt);
+    }
+
+    *pbytes += bytes;
+    *pread  += read;
+    return ret;
+}
+
+static int preload(const char *url, const int64_t *targets, int nb_targets,
+                   int64_t duration, int64_t max_bytes,
+                   AVDictionary *options, const AVIOInterruptCB *int_cb,
+                   AVPreloadResult *result)
+{
+    AVFormatContext *ic      = NULL;
+    AVDictionary    *opts    = NULL;
+    int64_t         *start   = NULL;
+    int64_t          bytes   = 0;
+    int64_t          read    = 0;
+    int64_t          begin   = av_gettime_relative();
+    int              nb_streams;
+    int              ret;
+    int              i;
+
+    if (result)
+        memset(result, 0, sizeof(*result));
+    if (!url || (duration <= 0 && max_bytes <= 0))
+        return AVERROR(EINVAL);
+
+    ic = avformat_alloc_context();
+    if (!ic)
+        return AVERROR(ENOMEM);
+    if (int_cb)
+        ic->interrupt_callback = *int_cb;
+
+    av_dict_copy(&opts, options, 0);
+    ret = avformat_open_input(&ic, url, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Preload %s: open failed: %s\n", url, av_err2str(ret));
+        goto end;
+    }
+
+    nb_streams = ic->nb_streams;
+    start = av_malloc_array(FFMAX(nb_streams, 1), sizeof(*start));
+    if (!start) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if (!nb_targets) {
+        ret = preload_window(ic, nb_streams, start, duration, max_bytes, &bytes, &read);
+    } else {
+        for (i = 0; i < nb_targets && (max_bytes <= 0 || bytes < max_bytes); i++) {
+            // from the key frame before the target, where a seek there starts
+            ret = avformat_seek_file(ic, -1, INT64_MIN, targets[i], targets[i], 0);
+            if (ret < 0) {
+                if (ret == AVERROR_EXIT)
+                    break;
+                av_log(NULL, AV_LOG_WARNING, "Preload %s: seek to %"PRId64" ms failed: %s\n",
+                       url, targets[i] / 1000, av_err2str(ret));
+                ret = 0;
+                continue;
+            }
+            ret = preload_window(ic, nb_streams, start, duration,
+                                 max_bytes > 0 ? max_bytes - bytes : 0, &bytes, &read);
+            if (ret < 0)
+                break;
+        }
+    }
+
+    if (ret >= 0)
+        av_log(NULL, AV_LOG_INFO, "Preload %s: %"PRId64" bytes, %"PRId64" ms of media in %"PRId64" ms\n",
+               url, bytes, read / 1000, (av_gettime_relative() - begin) / 1000);
+    else if (ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_WARNING, "Preload %s: read failed: %s\n", url, av_err2str(ret));
+
+end:
+    if (result) {
+        result->bytes    = bytes;
+        result->duration = read;
+        result->elapsed  = av_gettime_relative() - begin;
+    }
+    av_free(start);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+int av_preload_url(const char *url, int64_t duration, int64_t max_bytes,
+                   AVDictionary *options, const AVIOInterruptCB *int_cb,
+                   AVPreloadResult *result)
+{
+    return preload(url, NULL, 0, duration, max_bytes, options, int_cb, result);
+}
+
+int av_preload_url_targets(const char *url, const int64_t *targets, int nb_targets,
+                           int64_t duration, int64_t max_bytes,
+                           AVDictionary *options, const AVIOInterruptCB *int_cb,
+                           AVPreloadResult *result)
+{
+    if (!targets || nb_targets <= 0 || duration <= 0) {
+        if (result)
+            memset(result, 0, sizeof(*result));
+        return AVERROR(EINVAL);
+    }
+    return preload(url, targets, nb_targets, duration, max_bytes, options, int_cb, result);
+}
@@ -0,0 +1,49 @@
+/*
+ * Persistent cache of stream analysis results
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PROBE_CACHE_H
+#define AVFORMAT_PROBE_CACHE_H
+
+#include "avformat.h"
+
+/**
+ * The codec parameters avformat_find_stream_info() found for a url, kept as
+ * an entry of the disk cache (see disk_cache.h), keyed the same way, so that
+ * opening the media again takes them from there instead of decoding. An
+ * entry holds while the input reports the ETag and Last-Modified it had
+ * when it was stored, and the demuxer finds the same streams in its header:
+ * same count, types, codecs and time bases.
+ *
+ * Enabled by the "probe_cache" format option, with the disk cache configured.
+ */
+
+/**
+ * Fill in the parameters the demuxer left unset from the entry of s.
+ *
+ * @return 1 if the entry matched and was applied, 0 otherwise
+ */
+int  ff_probe_cache_apply(AVFormatContext *s);
+
+/**
+ * Store the parameters of the streams of s, once probing found them.
+ */
+void ff_probe_cache_store(AVFormatContext *s);
+
+#endif /* AVFORMAT_PROBE_CACHE_H */
@@ -0,0 +1,210 @@
+/*
+ * Process wide network throughput and round trip time estimate
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/time.h"
+
+#include "avformat.h"
+#include "throughput.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define THROUGHPUT_MAX_HOSTS        32
+#define THROUGHPUT_MIN_SAMPLE_BYTES (64 * 1024)
+#define THROUGHPUT_MIN_SAMPLE_TIME  10000
+/* microseconds of downloads an estimate stands for at most, so it keeps up */
+#define THROUGHPUT_MAX_WEIGHT       (30 * 1000000.0)
+/* below, the samples left are too old or too few to tell */
+#define THROUGHPUT_MIN_WEIGHT       (500000.0)
+#define THROUGHPUT_MAX_RTT_WEIGHT   16.0
+#define THROUGHPUT_MIN_RTT_WEIGHT   0.5
+
+typedef struct ThroughputEntry {
+    char    host[256];          // "" for the process
+    int64_t update_time;        // av_gettime_relative() the weights were decayed to, 0 if unused
+    int64_t sample_time;        // of the last sample
+    double  bandwidth;          // bits per second
+    double  bandwidth_weight;   // microseconds of downloads, decayed
+    double  rtt;                // microseconds
+    double  rtt_weight;         // connects, decayed
+} ThroughputEntry;
+
+#if HAVE_PTHREADS
+
+static pthread_mutex_t  throughput_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThroughputEntry  throughput_entries[THROUGHPUT_MAX_HOSTS + 1];
+
+static int throughput_host(const char *url, char *host, int host_size)
+{
+    int port;
+
+    if (!url)
+        return AVERROR(EINVAL);
+    av_url_split(NULL, 0, NULL, 0, host, host_size, &port, NULL, 0, url);
+    return host[0] ? 0 : AVERROR(EINVAL);
+}
+
+static void throughput_decay_locked(ThroughputEntry *entry, int64_t now)
+{
+    double factor;
+
+    if (now <= entry->update_time)
+        return;
+
+    factor = exp2(-(double)(now - entry->update_time) / THROUGHPUT_HALF_LIFE);
+    entry->bandwidth_weight *= factor;
+    entry->rtt_weight       *= factor;
+    entry->update_time       = now;
+}
+
+// the entry of host, the least recently sampled one replaced if it is new
+static ThroughputEntry *throughput_find_locked(const char *host, int add)
+{
+    ThroughputEntry *oldest = NULL;
+    int i;
+
+    for (i = 1; i <= THROUGHPUT_MAX_HOSTS; i++) {
+        ThroughputEntry *entry = &throughput_entries[i];
+        if (entry->update_time && !strcmp(entry->host, host))
+            return entry;
+        if (!oldest || entry->sample_time < oldest->sample_time)
+            oldest = entry;
+    }
+    if (!add)
+        return NULL;
+
+    memset(oldest, 0, sizeof(*oldest));
+    av_strlcpy(oldest->host, host, sizeof(oldest->host));
+    return oldest;
+}
+
+static void throughput_add_locked(ThroughputEntry *entry, int64_t now, double bandwidth, double weight, double rtt)
+{
+    if (!entry->update_time)
+        entry->update_time = now;
+    throughput_decay_locked(entry, now);
+    entry->sample_time = now;
+
+    if (weight > 0) {
+        entry->bandwidth = (entry->bandwidth * entry->bandwidth_weight + bandwidth * weight) /
+                           (entry->bandwidth_weight + weight);
+        entry->bandwidth_weight = FFMIN(entry->bandwidth_weight + weight, THROUGHPUT_MAX_WEIGHT);
+    }
+    if (rtt > 0) {
+        entry->rtt = (entry->rtt * entry->rtt_weight + rtt) / (entry->rtt_weight + 1);
+        entry->rtt_weight = FFMIN(entry->rtt_weight + 1, THROUGHPUT_MAX_RTT_WEIGHT);
+    }
+}
+
+static void throughput_add(const char *url, double bandwidth, double weight, double rtt)
+{
+    char    host[256];
+    int64_t now = av_gettime_relative();
+
+    if (throughput_host(url, host, sizeof(host)) < 0)
+        return;
+
+    pthread_mutex_lock(&throughput_mutex);
+    throughput_add_locked(&throughput_entries[0], now, bandwidth, weight, rtt);
+    throughput_add_locked(throughput_find_locked(host, 1), now, bandwidth, weight, rtt);
+    pthread_mutex_unlock(&throughput_mutex);
+}
+
+void ff_throughput_add_sample(const char *url, int64_t bytes, int64_t elapsed)
+{
+    if (bytes < THROUGHPUT_MIN_SAMPLE_BYTES || elapsed < THROUGHPUT_MIN_SAMPLE_TIME)
+        return;
+
+    throughput_add(url, bytes * 8 * 1000000.0 / elapsed, elapsed, 0);
+}
+
+void ff_throughput_add_rtt(const char *url, int64_t rtt)
+{
+    if (rtt <= 0)
+        return;
+
+    throughput_add(url, 0, 0, rtt);
+}
+
+int av_throughput_get_estimate(const char *url, ThroughputEstimate *estimate)
+{
+    char             host[256];
+    ThroughputEntry *entries[2] = { NULL, &throughput_entries[0] };
+    int64_t          now = av_gettime_relative();
+    int              i;
+
+    memset(estimate, 0, sizeof(*estimate));
+
+    pthread_mutex_lock(&throughput_mutex);
+    if (url && throughput_host(url, host, sizeof(host)) >= 0)
+        entries[0] = throughput_find_locked(host, 0);
+    // the host first, what it lacks from the process
+    for (i = 0; i < 2; i++) {
+        ThroughputEntry *entry = entries[i];
+        if (!entry || !entry->update_time)
+            continue;
+
+        throughput_decay_locked(entry, now);
+        if (!estimate->bandwidth && entry->bandwidth_weight >= THROUGHPUT_MIN_WEIGHT) {
+            estimate->bandwidth = llrint(entry->bandwidth);
+            estimate->age       = now - entry->sample_time;
+        }
+        if (!estimate->rtt && entry->rtt_weight >= THROUGHPUT_MIN_RTT_WEIGHT)
+            estimate->rtt = llrint(entry->rtt);
+    }
+    pthread_mutex_unlock(&throughput_mutex);
+
+    return estimate->bandwidth || estimate->rtt ? 0 : AVERROR(ENOENT);
+}
+
+void av_throughput_reset(void)
+{
+    pthread_mutex_lock(&throughput_mutex);
+    memset(throughput_entries, 0, sizeof(throughput_entries));
+    pthread_mutex_unlock(&throughput_mutex);
+}
+
+#else
+
+void ff_throughput_add_sample(const char *url, int64_t bytes, int64_t elapsed)
+{
+}
+
+void ff_throughput_add_rtt(const char *url, int64_t rtt)
+{
+}
+
+int av_throughput_get_estimate(const char *url, ThroughputEstimate *estimate)
+{
+    memset(estimate, 0, sizeof(*estimate));
+    return AVERROR(ENOENT);
+}
+
+void av_throughput_reset(void)
+{
+}
+
+#endif
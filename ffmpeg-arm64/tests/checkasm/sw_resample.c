@@ -0,0 +1,208 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/samplefmt.h"
+#include "libswresample/audioconvert.h"
+#include "libswresample/resample.h"
+#include "libswresample/swresample_internal.h"
+
+#include "checkasm.h"
+
+#define SAMPLES 1024
+#define CHANNELS 6
+
+#define randomize_float(buf, len)                                           \
+    do {                                                                    \
+        int k;                                                              \
+        for (k = 0; k < len; k++)                                           \
+            buf[k] = (float)((int)(rnd() & 0xffff) - 0x8000) / 0x7400;      \
+    } while (0)
+
+/* The C conversions of libswresample only have the per sample signature,
+ * these process a whole buffer the way the simd functions do. */
+static void conv_flt_to_s16_c(uint8_t **dst, const uint8_t **src, int len)
+{
+    int16_t *out = (int16_t *)dst[0];
+    const float *in = (const float *)src[0];
+    int i;
+
+    for (i = 0; i < len; i++)
+        out[i] = av_clip_int16(lrintf(in[i] * (1 << 15)));
+}
+
+static void conv_fltp_to_s16_c(uint8_t **dst, const uint8_t **src, int len)
+{
+    int16_t *out = (int16_t *)dst[0];
+    int channels, ch, i;
+
+    for (channels = 0; channels < SWR_CH_MAX && src[channels]; channels++)
+        ;
+    for (ch = 0; ch < channels; ch++) {
+        const float *in = (const float *)src[ch];
+        for (i = 0; i < len; i++)
+            out[i * channels + ch] = av_clip_int16(lrintf(in[i] * (1 << 15)));
+    }
+}
+
+/* the neon versions truncate to Q31 before rounding to 16 bits */
+static int cmp_s16_off_by_one(const int16_t *a, const int16_t *b, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (FFABS(a[i] - b[i]) > 1)
+            return 1;
+    return 0;
+}
+
+static void check_audio_convert(void)
+{
+    static const struct {
+        enum AVSampleFormat in_fmt, out_fmt;
+        int channels;
+        const char *name;
+    } convs[] = {
+        { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S16, 2,        "flt_to_s16"      },
+        { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16, 2,        "fltp_to_s16_2ch" },
+        { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16, CHANNELS, "fltp_to_s16_nch" },
+    };
+    LOCAL_ALIGNED_16(float,   src_buf, [SAMPLES * CHANNELS]);
+    LOCAL_ALIGNED_16(int16_t, dst0,    [SAMPLES * CHANNELS]);
+    LOCAL_ALIGNED_16(int16_t, dst1,    [SAMPLES * CHANNELS]);
+    int i, ch;
+
+    declare_func(void, uint8_t **dst, const uint8_t **src, int len);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(convs); i++) {
+        int planar = convs[i].in_fmt == AV_SAMPLE_FMT_FLTP;
+        int channels = convs[i].channels;
+        /* interleaved input is converted as a single plane */
+        int len = planar ? SAMPLES : SAMPLES * channels;
+        const uint8_t *src[SWR_CH_MAX] = { NULL };
+        uint8_t *out0[SWR_CH_MAX] = { (uint8_t *)dst0 };
+        uint8_t *out1[SWR_CH_MAX] = { (uint8_t *)dst1 };
+        simd_func_type *func;
+        AudioConvert *ac;
+
+        for (ch = 0; ch < (planar ? channels : 1); ch++)
+            src[ch] = (const uint8_t *)(src_buf + ch * SAMPLES);
+
+        ac = swri_audio_convert_alloc(convs[i].out_fmt, convs[i].in_fmt, channels, NULL, 0);
+        if (!ac) {
+            fail();
+            continue;
+        }
+        func = ac->simd_f;
+        if (!av_get_cpu_flags())
+            func = planar ? conv_fltp_to_s16_c : conv_flt_to_s16_c;
+
+        if (check_func(func, "audio_convert_%s", convs[i].name)) {
+            randomize_float(src_buf, SAMPLES * channels);
+            memset(dst0, 0, sizeof(*dst0) * SAMPLES * CHANNELS);
+            memset(dst1, 0, sizeof(*dst1) * SAMPLES * CHANNELS);
+
+            call_ref(out0, src, len);
+            call_new(out1, src, len);
+            if (cmp_s16_off_by_one(dst0, dst1, SAMPLES * channels))
+                fail();
+
+            bench_new(out1, src, len);
+        }
+        swri_audio_convert_free(&ac);
+    }
+
+    report("audio_convert");
+}
+
+static void check_resample_common(void)
+{
+    static const enum AVSampleFormat formats[] = { AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLTP };
+    /* filter lengths taking the x8, the x4 and the scalar tails */
+    static const int filter_sizes[] = { 32, 16, 12, 6 };
+    /* up from 44.1 kHz to the 48 kHz the output unit runs at, and down */
+    static const int rates[][2] = { { 44100, 48000 }, { 48000, 44100 } };
+    int dst_len = SAMPLES / 2;
+    LOCAL_ALIGNED_16(float, src_buf, [SAMPLES + 64]);
+    LOCAL_ALIGNED_16(float, dst0,    [SAMPLES]);
+    LOCAL_ALIGNED_16(float, dst1,    [SAMPLES]);
+    int f, s, r, i;
+
+    declare_func(int, ResampleContext *c, void *dst, const void *src, int n, int update_ctx);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        for (s = 0; s < FF_ARRAY_ELEMS(filter_sizes); s++) {
+            for (r = 0; r < FF_ARRAY_ELEMS(rates); r++) {
+                ResampleContext *c = swri_resampler.init(NULL, rates[r][1], rates[r][0],
+                                                         filter_sizes[s], 10, 0, 0.97,
+                                                         formats[f], SWR_FILTER_TYPE_KAISER,
+                                                         9, 0, 0, 0);
+                if (!c) {
+                    fail();
+                    continue;
+                }
+
+                /* the initial index of swresample leans on its padding of the input */
+                c->index = rnd() % c->phase_count;
+                c->frac  = 0;
+
+                if (check_func(c->dsp.resample_common, "resample_common_%s_%d_%s",
+                               av_get_sample_fmt_name(formats[f]), c->filter_length,
+                               rates[r][0] < rates[r][1] ? "up" : "down")) {
+                    if (formats[f] == AV_SAMPLE_FMT_S16P) {
+                        int16_t *src = (int16_t *)src_buf;
+                        for (i = 0; i < SAMPLES + 64; i++)
+                            src[i] = rnd();
+                    } else {
+                        randomize_float(src_buf, SAMPLES + 64);
+                    }
+                    memset(dst0, 0, sizeof(*dst0) * SAMPLES);
+                    memset(dst1, 0, sizeof(*dst1) * SAMPLES);
+
+                    call_ref(c, dst0, src_buf, dst_len, 0);
+                    call_new(c, dst1, src_buf, dst_len, 0);
+                    if (formats[f] == AV_SAMPLE_FMT_S16P) {
+                        if (memcmp(dst0, dst1, dst_len * sizeof(int16_t)))
+                            fail();
+                    } else {
+                        /* the neon versions sum in another order */
+                        if (!float_near_abs_eps_array(dst0, dst1, 1e-5, dst_len))
+                            fail();
+                    }
+
+                    bench_new(c, dst1, src_buf, dst_len, 0);
+                }
+                swri_resampler.free(&c);
+            }
+        }
+    }
+
+    report("resample_common");
+}
+
+void checkasm_check_sw_resample(void)
+{
+    check_audio_convert();
+    check_resample_common();
+}
@@ -2,6 +2,18 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += fate-hpack
+fate-hpack: libavformat/tests/hpack$(EXESUF)
+fate-hpack: CMD = run libavformat/tests/hpack
+
+FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += fate-http3
+fate-http3: libavformat/tests/http3$(EXESUF)
+fate-http3: CMD = run libavformat/tests/http3
+
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += fate-http_mirror
+fate-http_mirror: libavformat/tests/http_mirror$(EXESUF)
+fate-http_mirror: CMD = run libavformat/tests/http_mirror
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy
@@ -0,0 +1,102 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/aarch64/cpu.h"
+#include "libavcodec/hevcdsp.h"
+
+void ff_hevc_idct_4x4_neon_8(int16_t *coeffs, int col_limit);
+void ff_hevc_idct_8x8_neon_8(int16_t *coeffs, int col_limit);
+void ff_hevc_idct_4x4_dc_neon_8(int16_t *coeffs);
+void ff_hevc_idct_8x8_dc_neon_8(int16_t *coeffs);
+void ff_hevc_idct_16x16_dc_neon_8(int16_t *coeffs);
+void ff_hevc_idct_32x32_dc_neon_8(int16_t *coeffs);
+void ff_hevc_add_residual_4x4_neon_8(uint8_t *dst, int16_t *res,
+                                     ptrdiff_t stride);
+void ff_hevc_add_residual_8x8_neon_8(uint8_t *dst, int16_t *res,
+                                     ptrdiff_t stride);
+void ff_hevc_add_residual_16x16_neon_8(uint8_t *dst, int16_t *res,
+                                       ptrdiff_t stride);
+void ff_hevc_add_residual_32x32_neon_8(uint8_t *dst, int16_t *res,
+                                       ptrdiff_t stride);
+
+#define PEL_FUNCS(type, dir)                                                   \
+void ff_hevc_put_ ## type ## _ ## dir ## _neon_8(int16_t *dst, uint8_t *src,   \
+                                                 ptrdiff_t srcstride,          \
+                                                 int height, intptr_t mx,      \
+                                                 intptr_t my, int width);      \
+void ff_hevc_put_ ## type ## _uni_ ## dir ## _neon_8(uint8_t *dst,             \
+                                                     ptrdiff_t dststride,      \
+                                                     uint8_t *src,             \
+                                                     ptrdiff_t srcstride,      \
+                                                     int height, intptr_t mx,  \
+                                                     intptr_t my, int width);  \
+void ff_hevc_put_ ## type ## _bi_ ## dir ## _neon_8(uint8_t *dst,              \
+                                                    ptrdiff_t dststride,       \
+                                                    uint8_t *src,              \
+                                                    ptrdiff_t srcstride,       \
+                                                    int16_t *src2,             \
+                                                    int height, intptr_t mx,   \
+                                                    intptr_t my, int width)
+
+PEL_FUNCS(qpel, h);
+PEL_FUNCS(qpel, v);
+PEL_FUNCS(epel, h);
+PEL_FUNCS(epel, v);
+
+/* The NEON interpolation handles widths that are a multiple of 4, i.e.
+ * every block size except 2 and 6 (index 0 and 2). The two dimensional
+ * hv cases stay in C. */
+#define SET_PEL_FUNCS(type, idx)                                                         \
+    do {                                                                                 \
+        c->put_hevc_ ## type[idx][0][1]         = ff_hevc_put_ ## type ## _h_neon_8;     \
+        c->put_hevc_ ## type[idx][1][0]         = ff_hevc_put_ ## type ## _v_neon_8;     \
+        c->put_hevc_ ## type ## _uni[idx][0][1] = ff_hevc_put_ ## type ## _uni_h_neon_8; \
+        c->put_hevc_ ## type ## _uni[idx][1][0] = ff_hevc_put_ ## type ## _uni_v_neon_8; \
+        c->put_hevc_ ## type ## _bi[idx][0][1]  = ff_hevc_put_ ## type ## _bi_h_neon_8;  \
+        c->put_hevc_ ## type ## _bi[idx][1][0]  = ff_hevc_put_ ## type ## _bi_v_neon_8;  \
+    } while (0)
+
+av_cold void ff_hevc_dsp_init_aarch64(HEVCDSPContext *c, const int bit_depth)
+{
+    int cpu_flags = av_get_cpu_flags();
+    int i;
+
+    if (have_neon(cpu_flags) && bit_depth == 8) {
+        c->idct[0]         = ff_hevc_idct_4x4_neon_8;
+        c->idct[1]         = ff_hevc_idct_8x8_neon_8;
+        c->idct_dc[0]      = ff_hevc_idct_4x4_dc_neon_8;
+        c->idct_dc[1]      = ff_hevc_idct_8x8_dc_neon_8;
+        c->idct_dc[2]      = ff_hevc_idct_16x16_dc_neon_8;
+        c->idct_dc[3]      = ff_hevc_idct_32x32_dc_neon_8;
+        c->add_residual[0] = ff_hevc_add_residual_4x4_neon_8;
+        c->add_residual[1] = ff_hevc_add_residual_8x8_neon_8;
+        c->add_residual[2] = ff_hevc_add_residual_16x16_neon_8;
+        c->add_residual[3] = ff_hevc_add_residual_32x32_neon_8;
+
+        for (i = 1; i < 10; i++) {
+            if (i == 2)
+                continue;
+            SET_PEL_FUNCS(qpel, i);
+            SET_PEL_FUNCS(epel, i);
+        }
+    }
+}
@@ -0,0 +1,326 @@
+/*
+ * AV1 decoding via libdav1d
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * AV1 decoder wrapping libdav1d.
+ *
+ * dav1d threads by itself, frames and tiles at once on a pool of its own,
+ * with its own NEON and SSSE3/AVX2 code: the codec only declares
+ * AV_CODEC_CAP_AUTO_THREADS, and passes thread_count on. With thread_type
+ * set to slice threads only, or AV_CODEC_FLAG_LOW_DELAY, the pictures are
+ * not held back for frame threading, as with the native decoders.
+ *
+ * The pictures are returned as dav1d allocated them, without a copy: the
+ * frame holds a reference to the Dav1dPicture until it is unreferenced.
+ */
+
+#include <dav1d/dav1d.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mastering_display_metadata.h"
+#include "libavutil/opt.h"
+
+#include "avcodec.h"
+#include "internal.h"
+
+typedef struct Libdav1dContext {
+    AVClass *class;
+    Dav1dContext *c;
+    /* the packet sent, until dav1d took all of it */
+    Dav1dData data;
+
+    int max_frame_delay;
+    int apply_grain;
+} Libdav1dContext;
+
+static const enum AVPixelFormat pix_fmts[][3] = {
+    [DAV1D_PIXEL_LAYOUT_I400] = { AV_PIX_FMT_GRAY8,   AV_PIX_FMT_GRAY10,    AV_PIX_FMT_GRAY12    },
+    [DAV1D_PIXEL_LAYOUT_I420] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV420P12 },
+    [DAV1D_PIXEL_LAYOUT_I422] = { AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P12 },
+    [DAV1D_PIXEL_LAYOUT_I444] = { AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV444P12 },
+};
+
+static void libdav1d_log_callback(void *opaque, const char *fmt, va_list vl)
+{
+    AVCodecContext *c = opaque;
+
+    av_vlog(c, AV_LOG_ERROR, fmt, vl);
+}
+
+static av_cold int libdav1d_init(AVCodecContext *c)
+{
+    Libdav1dContext *dav1d = c->priv_data;
+    Dav1dSettings s;
+    int res;
+
+    av_log(c, AV_LOG_INFO, "libdav1d %s\n", dav1d_version());
+
+    dav1d_default_settings(&s);
+    s.logger.cookie   = c;
+    s.logger.callback = libdav1d_log_callback;
+    s.apply_grain     = dav1d->apply_grain;
+    /* 0, the default, lets dav1d use a thread per core */
+    s.n_threads       = av_clip(c->thread_count, 0, 256);
+    if ((c->flags & AV_CODEC_FLAG_LOW_DELAY) || !(c->thread_type & FF_THREAD_FRAME))
+        s.max_frame_delay = 1;
+    else
+        s.max_frame_delay = dav1d->max_frame_delay;
+
+    res = dav1d_open(&dav1d->c, &s);
+    if (res < 0)
+        return res;
+
+    av_log(c, AV_LOG_DEBUG, "%d threads, frame delay %d\n", s.n_threads, s.max_frame_delay);
+    return 0;
+}
+
+static void libdav1d_flush(AVCodecContext *c)
+{
+    Libdav1dContext *dav1d = c->priv_data;
+
+    dav1d_data_unref(&dav1d->data);
+    dav1d_flush(dav1d->c);
+}
+
+static void libdav1d_data_free(const uint8_t *data, void *opaque)
+{
+    AVPacket *pkt = opaque;
+
+    av_packet_free(&pkt);
+}
+
+static void libdav1d_picture_free(void *opaque, uint8_t *data)
+{
+    Dav1dPicture *p = opaque;
+
+    dav1d_picture_unref(p);
+    av_free(p);
+}
+
+static int libdav1d_send_packet(AVCodecContext *c, const AVPacket *avpkt)
+{
+    Libdav1dContext *dav1d = c->priv_data;
+    AVPacket *pkt;
+    int res;
+
+    if (dav1d->data.sz)
+        return AVERROR(EAGAIN);
+    if (!avpkt)
+        return 0;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    /* referenced, or copied when not refcounted */
+    res = av_packet_ref(pkt, avpkt);
+    if (res < 0) {
+        av_packet_free(&pkt);
+        return res;
+    }
+
+    res = dav1d_data_wrap(&dav1d->data, pkt->data, pkt->size, libdav1d_data_free, pkt);
+    if (res < 0) {
+        av_packet_free(&pkt);
+        return res;
+    }
+    dav1d->data.m.timestamp = pkt->pts;
+    dav1d->data.m.offset    = pkt->pos;
+    dav1d->data.m.duration  = pkt->duration;
+
+    return 0;
+}
+
+static int libdav1d_receive_frame(AVCodecContext *c, AVFrame *frame)
+{
+    Libdav1dContext *dav1d = c->priv_data;
+    Dav1dPicture *p;
+    int res;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    for (;;) {
+        if (dav1d->data.sz) {
+            res = dav1d_send_data(dav1d->c, &dav1d->data);
+            if (res < 0 && res != DAV1D_ERR(EAGAIN)) {
+                dav1d_data_unref(&dav1d->data);
+                if (c->err_recognition & AV_EF_EXPLODE) {
+                    av_free(p);
+                    return res;
+                }
+                av_log(c, AV_LOG_ERROR, "Error parsing the packet, skipped\n");
+            }
+        }
+
+        res = dav1d_get_picture(dav1d->c, p);
+        if (res != DAV1D_ERR(EAGAIN))
+            break;
+        /* the frames in flight went out, dav1d takes more of the packet */
+        if (dav1d->data.sz)
+            continue;
+        av_free(p);
+        return c->internal->draining ? AVERROR_EOF : AVERROR(EAGAIN);
+    }
+    if (res < 0) {
+        av_free(p);
+        return res;
+    }
+
+    av_assert0(p->data[0] && p->p.layout < FF_ARRAY_ELEMS(pix_fmts));
+
+    frame->buf[0] = av_buffer_create(NULL, 0, libdav1d_picture_free, p, AV_BUFFER_FLAG_READONLY);
+    if (!frame->buf[0]) {
+        dav1d_picture_unref(p);
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+
+    frame->data[0]     = p->data[0];
+    frame->data[1]     = p->data[1];
+    frame->data[2]     = p->data[2];
+    frame->linesize[0] = p->stride[0];
+    frame->linesize[1] = p->stride[1];
+    frame->linesize[2] = p->stride[1];
+
+    c->profile = p->seq_hdr->profile;
+    c->pix_fmt = pix_fmts[p->p.layout][p->seq_hdr->hbd];
+    frame->format = c->pix_fmt;
+
+    if (c->width != p->p.w || c->height != p->p.h) {
+        res = ff_set_dimensions(c, p->p.w, p->p.h);
+        if (res < 0)
+            goto fail;
+    }
+    frame->width  = p->p.w;
+    frame->height = p->p.h;
+
+    av_reduce(&frame->sample_aspect_ratio.num, &frame->sample_aspect_ratio.den,
+              frame->height * (int64_t)p->frame_hdr->render_width,
+              frame->width  * (int64_t)p->frame_hdr->render_height, INT_MAX);
+    ff_set_sar(c, frame->sample_aspect_ratio);
+
+    c->color_primaries = frame->color_primaries = (enum AVColorPrimaries)p->seq_hdr->pri;
+    c->color_trc       = frame->color_trc       = (enum AVColorTransferCharacteristic)p->seq_hdr->trc;
+    c->colorspace      = frame->colorspace      = (enum AVColorSpace)p->seq_hdr->mtrx;
+    c->color_range     = frame->color_range     = p->seq_hdr->color_range ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    if (p->p.layout == DAV1D_PIXEL_LAYOUT_I420) {
+        if (p->seq_hdr->chr == DAV1D_CHR_VERTICAL)
+            c->chroma_sample_location = frame->chroma_location = AVCHROMA_LOC_LEFT;
+        else if (p->seq_hdr->chr == DAV1D_CHR_COLOCATED)
+            c->chroma_sample_location = frame->chroma_location = AVCHROMA_LOC_TOPLEFT;
+    }
+
+    /* AV1 presents the temporal units in order, pts for dts too */
+    frame->pts          = p->m.timestamp;
+    frame->pkt_dts      = p->m.timestamp;
+#if FF_API_PKT_PTS
+FF_DISABLE_DEPRECATION_WARNINGS
+    frame->pkt_pts      = p->m.timestamp;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+    frame->pkt_pos      = p->m.offset;
+    frame->pkt_duration = p->m.duration;
+
+    frame->key_frame = p->frame_hdr->frame_type == DAV1D_FRAME_TYPE_KEY;
+    switch (p->frame_hdr->frame_type) {
+    case DAV1D_FRAME_TYPE_KEY:
+    case DAV1D_FRAME_TYPE_INTRA:
+        frame->pict_type = AV_PICTURE_TYPE_I;
+        break;
+    case DAV1D_FRAME_TYPE_INTER:
+        frame->pict_type = AV_PICTURE_TYPE_P;
+        break;
+    case DAV1D_FRAME_TYPE_SWITCH:
+        frame->pict_type = AV_PICTURE_TYPE_SP;
+        break;
+    default:
+        break;
+    }
+
+    if (p->mastering_display) {
+        AVMasteringDisplayMetadata *mastering = av_mastering_display_metadata_create_side_data(frame);
+        int i;
+
+        if (!mastering) {
+            res = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < 3; i++) {
+            mastering->display_primaries[i][0] = av_make_q(p->mastering_display->primaries[i][0], 1 << 16);
+            mastering->display_primaries[i][1] = av_make_q(p->mastering_display->primaries[i][1], 1 << 16);
+        }
+        mastering->white_point[0] = av_make_q(p->mastering_display->white_point[0], 1 << 16);
+        mastering->white_point[1] = av_make_q(p->mastering_display->white_point[1], 1 << 16);
+        mastering->max_luminance  = av_make_q(p->mastering_display->max_luminance, 1 << 8);
+        mastering->min_luminance  = av_make_q(p->mastering_display->min_luminance, 1 << 14);
+        mastering->has_primaries  = 1;
+        mastering->has_luminance  = 1;
+    }
+
+    return 0;
+fail:
+    av_frame_unref(frame);
+    return res;
+}
+
+static av_cold int libdav1d_close(AVCodecContext *c)
+{
+    Libdav1dContext *dav1d = c->priv_data;
+
+    dav1d_data_unref(&dav1d->data);
+    dav1d_close(&dav1d->c);
+
+    return 0;
+}
+
+#define OFFSET(x) offsetof(Libdav1dContext, x)
+#define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
+static const AVOption libdav1d_options[] = {
+    { "max_frame_delay", "Frames decoded ahead with frame threads, 0 for as many as threads", OFFSET(max_frame_delay), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, DAV1D_MAX_FRAME_DELAY, VD },
+    { "filmgrain", "Apply the film grain the stream signals", OFFSET(apply_grain), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, VD },
+    { NULL }
+};
+
+static const AVClass libdav1d_class = {
+    .class_name = "libdav1d decoder",
+    .item_name  = av_default_item_name,
+    .option     = libdav1d_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVCodec ff_libdav1d_decoder = {
+    .name           = "libdav1d",
+    .long_name      = NULL_IF_CONFIG_SMALL("dav1d AV1 decoder by VideoLAN"),
+    .type           = AVMEDIA_TYPE_VIDEO,
+    .id             = AV_CODEC_ID_AV1,
+    .priv_data_size = sizeof(Libdav1dContext),
+    .init           = libdav1d_init,
+    .close          = libdav1d_close,
+    .flush          = libdav1d_flush,
+    .send_packet    = libdav1d_send_packet,
+    .receive_frame  = libdav1d_receive_frame,
+    .capabilities   = AV_CODEC_CAP_DELAY | AV_CODEC_CAP_AUTO_THREADS,
+    .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_INIT_CLEANUP,
+    .priv_class     = &libdav1d_class,
+};
@@ -27,6 +27,7 @@
 #include "avcodec.h"
 #include "internal.h"
 #include "pthread_internal.h"
+#include "slice_pool.h"
 #include "thread.h"
 
 #include "libavutil/avassert.h"
@@ -54,6 +55,8 @@ typedef struct SliceThreadContext {
     int current_job;
     int done;
 
+    int pooled;             // no workers, the jobs run on the slice pool
+
     int *entries;
     int entries_count;
     int thread_count;
@@ -112,7 +115,7 @@ void ff_slice_thread_free(AVCodecContext *avctx)
         pthread_cond_broadcast(&c->progress_cond[i]);
     pthread_mutex_unlock(&c->current_job_lock);
 
-    for (i=0; i<avctx->thread_count; i++)
+    for (i=0; !c->pooled && i<avctx->thread_count; i++)
          pthread_join(c->workers[i], NULL);
 
     for (i = 0; i < c->thread_count; i++) {
@@ -172,6 +175,22 @@ static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
+static int pool_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
+{
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+        return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+
+    return ff_slice_pool_execute(avctx, func, NULL, arg, ret, job_count, job_size);
+}
+
+static int pool_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
+{
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+        return avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+
+    return ff_slice_pool_execute(avctx, NULL, func2, arg, ret, job_count, 0);
+}
+
 int ff_slice_thread_init(AVCodecContext *avctx)
 {
     int i;
@@ -208,6 +227,19 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     if (!c)
         return -1;
 
+    // the pool runs thread_count - 1 jobs besides the caller's
+    if (avctx->thread_pool && ff_slice_pool_size()) {
+        thread_count = avctx->thread_count = FFMIN(thread_count, ff_slice_pool_size() + 1);
+        avctx->internal->thread_ctx = c;
+        c->pooled = 1;
+        pthread_cond_init(&c->current_job_cond, NULL);
+        pthread_cond_init(&c->last_job_cond, NULL);
+        pthread_mutex_init(&c->current_job_lock, NULL);
+        avctx->execute = pool_execute;
+        avctx->execute2 = pool_execute2;
+        return 0;
+    }
+
     c->workers = av_mallocz_array(thread_count, sizeof(pthread_t));
     if (!c->workers) {
         av_free(c);
@@ -1479,6 +1479,8 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Wait for packet data before writing a header, and add bitstream filters as requested by the muxer
+#define AVFMT_FLAG_FAST_OPEN  0x400000 ///< Let avformat_find_stream_info() take codec parameters from the container headers and parsers instead of decoding, see fast_open_skipped
+#define AVFMT_FLAG_TRUST_KEYFRAMES 0x800000 ///< Take the keyframes of the demuxers which know them (mov with stss, flv) as the IDR pictures, mark their packets AV_PKT_FLAG_KEY_EXACT, and run the header parser only up to a keyframe after each codec parameter change
 
     /**
      * Maximum size of the data read from input for determining
@@ -1922,6 +1924,33 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_streams;
+
+    /**
+     * With AVFMT_FLAG_FAST_OPEN, the media duration avformat_find_stream_info()
+     * would still have analyzed when it stopped on complete container
+     * parameters, in AV_TIME_BASE units. For live input this is about the
+     * wall clock time saved. 0 if probing did not stop early.
+     * - encoding: unused
+     * - decoding: set by libavformat
+     */
+    int64_t fast_open_skipped;
+
+    /**
+     * Let avformat_find_stream_info() store the codec parameters it found in
+     * the disk cache, and take them from there when the same media is opened
+     * again. Needs the disk cache to be configured.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_cache;
+
+    /**
+     * Key of the probe cache entry, when the url alone does not identify the
+     * media (e.g. it carries a session token). NULL to use the url.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache_key;
 } AVFormatContext;
 
 /**
@@ -2001,6 +2030,19 @@ const char *avformat_license(void);
  */
 void av_register_all(void);
 
+/**
+ * Make av_register_all() register only the muxers and demuxers named in
+ * formats, and avcodec_register_all() only the codecs named in codecs, both
+ * comma separated lists of the names of the registration macros ("mov",
+ * "mpegts", "h264"). The rest are registered the first time a lookup or a
+ * probe finds nothing among them.
+ *
+ * Must be called before av_register_all(), has no effect after.
+ *
+ * @see avcodec_register_allow_list()
+ */
+void av_register_allow_list(const char *formats, const char *codecs);
+
 void av_register_input_format(AVInputFormat *format);
 void av_register_output_format(AVOutputFormat *format);
 
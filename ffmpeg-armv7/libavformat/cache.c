@@ -23,16 +23,24 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
+ *
+ * The data is kept in a temporary file of fixed size blocks, at most
+ * cache_max_size bytes of them: a flat array indexed by the block number
+ * of the resource finds the slot of a block in the file, and the least
+ * recently used block is reused once the file is full.
+ *
+ * With disk_cache set, the data is kept in the process wide store of
+ * disk_cache.c instead of a temporary file, and the inner protocol is
+ * only opened once something is not cached.
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
-#include "libavutil/tree.h"
 #include "avformat.h"
+#include "disk_cache.h"
 #include <fcntl.h>
 #if HAVE_IO_H
 #include <io.h>
@@ -45,16 +53,24 @@
 #include "os_support.h"
 #include "url.h"
 
-typedef struct CacheEntry {
-    int64_t logical_pos;
-    int64_t physical_pos;
-    int size;
-} CacheEntry;
+#define DISK_CACHE_MIN_SKIP (256 * 1024)
+
+typedef struct CacheBlock {
+    int64_t block;          ///< number of the block in the resource
+    int start, end;         ///< the cached bytes of the block, one range
+    int prev, next;         ///< least recently used list, -1 terminated
+} CacheBlock;
 
 typedef struct Context {
     AVClass *class;
     int fd;
-    struct AVTreeNode *root;
+    int block_size;
+    int64_t max_size;
+    int *index;             ///< slot + 1 of each block of the resource, 0 if not cached
+    int nb_index;
+    CacheBlock *blocks;     ///< by slot in the file
+    int nb_blocks, max_blocks;
+    int lru_head, lru_tail; ///< most and least recently used slots
     int64_t logical_pos;
     int64_t cache_pos;
     int64_t inner_pos;
@@ -63,20 +79,87 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    DiskCacheFile *disk;
+    int disk_cache;
+    char *disk_cache_dir;
+    int64_t disk_cache_max_size;
+    char *disk_cache_ignore_params;
+    char *inner_url;                ///< opened on the first miss when disk caching
+    int inner_flags;
+    AVDictionary *inner_options;
+    int64_t end_offset;             ///< end of the byte range requested with "end_offset", 0 if none
 } Context;
 
-static int cmp(const void *key, const void *node)
+static int cache_open_inner(URLContext *h)
 {
-    return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
+    Context *c= h->priv_data;
+    AVDictionary *options = NULL;
+    int64_t size;
+    int ret;
+
+    // let http start the request where the reader is
+    av_dict_copy(&options, c->inner_options, 0);
+    if (c->logical_pos)
+        av_dict_set_int(&options, "offset", c->logical_pos, 0);
+    ret = ffurl_open_whitelist(&c->inner, c->inner_url, c->inner_flags, &h->interrupt_callback,
+                               &options, h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+
+    c->inner_pos = ffurl_seek(c->inner, 0, SEEK_CUR);
+    if (c->inner_pos < 0)
+        c->inner_pos = 0;
+    size = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+    if (size > 0)
+        ff_disk_cache_set_size(c->disk, size);
+    return 0;
+}
+
+static int cache_open_disk(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    Context *c= h->priv_data;
+    AVDictionaryEntry *e;
+    int ret;
+
+    if (c->disk_cache_dir && (ret = av_disk_cache_configure(c->disk_cache_dir, c->disk_cache_max_size)) < 0)
+        return ret;
+    if ((ret = ff_disk_cache_open(&c->disk, arg, c->disk_cache_ignore_params)) < 0)
+        return ret;
+
+    // a byte range of the resource, as asked by hls
+    if ((e = av_dict_get(*options, "offset", NULL, 0)))
+        c->logical_pos = strtoll(e->value, NULL, 10);
+    if ((e = av_dict_get(*options, "end_offset", NULL, 0)))
+        c->end_offset = strtoll(e->value, NULL, 10);
+
+    c->inner_url   = av_strdup(arg);
+    c->inner_flags = flags;
+    if (!c->inner_url || av_dict_copy(&c->inner_options, *options, 0) < 0)
+        return AVERROR(ENOMEM);
+    av_dict_free(options);
+
+    if (ff_disk_cache_available(c->disk, c->logical_pos) > 0)
+        return 0;
+    return cache_open_inner(h);
 }
 
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     char *buffername;
     Context *c= h->priv_data;
+    int ret;
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->disk_cache) {
+        ret = cache_open_disk(h, arg, flags, options);
+        if (ret != AVERROR(ENOSYS))
+            return ret;
+        av_log(h, AV_LOG_WARNING, "No disk cache configured, caching in a temporary file\n");
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -86,107 +169,232 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
     unlink(buffername);
     av_freep(&buffername);
 
+    c->max_blocks = FFMAX(c->max_size / c->block_size, 2);
+    c->blocks     = av_malloc_array(c->max_blocks, sizeof(*c->blocks));
+    if (!c->blocks)
+        return AVERROR(ENOMEM);
+    c->lru_head = c->lru_tail = -1;
+
     return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
                                 options, h->protocol_whitelist, h->protocol_blacklist, h);
 }
 
-static int add_entry(URLContext *h, const unsigned char *buf, int size)
+static void block_unlink(Context *c, int slot)
+{
+    CacheBlock *b = &c->blocks[slot];
+
+    if (b->prev >= 0)
+        c->blocks[b->prev].next = b->next;
+    else
+        c->lru_head = b->next;
+    if (b->next >= 0)
+        c->blocks[b->next].prev = b->prev;
+    else
+        c->lru_tail = b->prev;
+}
+
+static void block_link_head(Context *c, int slot)
+{
+    CacheBlock *b = &c->blocks[slot];
+
+    b->prev = -1;
+    b->next = c->lru_head;
+    if (c->lru_head >= 0)
+        c->blocks[c->lru_head].prev = slot;
+    else
+        c->lru_tail = slot;
+    c->lru_head = slot;
+}
+
+static int block_find(Context *c, int64_t block)
+{
+    int slot = block < c->nb_index ? c->index[block] - 1 : -1;
+
+    if (slot >= 0 && slot != c->lru_head) {
+        block_unlink(c, slot);
+        block_link_head(c, slot);
+    }
+    return slot;
+}
+
+/* the slot of block, taken from the least recently used one if needed */
+static int block_get(Context *c, int64_t block)
+{
+    CacheBlock *b;
+    int slot = block_find(c, block);
+
+    if (slot >= 0)
+        return slot;
+
+    if (block >= c->nb_index) {
+        int nb_index = FFMAX(block + 1, 2 * (int64_t)c->nb_index);
+        int ret;
+        if (block >= INT_MAX / sizeof(*c->index) - 1)
+            return AVERROR(ENOMEM);
+        nb_index = FFMIN(nb_index, INT_MAX / sizeof(*c->index));
+        if ((ret = av_reallocp_array(&c->index, nb_index, sizeof(*c->index))) < 0) {
+            // the index is gone, and with it every block
+            c->nb_index  = c->nb_blocks = 0;
+            c->lru_head  = c->lru_tail  = -1;
+            return ret;
+        }
+        memset(c->index + c->nb_index, 0, (nb_index - c->nb_index) * sizeof(*c->index));
+        c->nb_index = nb_index;
+    }
+
+    if (c->nb_blocks < c->max_blocks) {
+        slot = c->nb_blocks++;
+    } else {
+        slot = c->lru_tail;
+        block_unlink(c, slot);
+        c->index[c->blocks[slot].block] = 0;
+    }
+    b        = &c->blocks[slot];
+    b->block = block;
+    b->start = b->end = 0;
+    block_link_head(c, slot);
+    c->index[block] = slot + 1;
+    return slot;
+}
+
+static int cache_file_seek(URLContext *h, int64_t physical_pos)
 {
     Context *c= h->priv_data;
-    int64_t pos = -1;
-    int ret;
-    CacheEntry *entry = NULL, *next[2] = {NULL, NULL};
-    CacheEntry *entry_ret;
-    struct AVTreeNode *node = NULL;
-
-    //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
-    if (pos < 0) {
-        ret = AVERROR(errno);
+    int64_t r;
+
+    if (c->cache_pos == physical_pos)
+        return 0;
+    r = lseek(c->fd, physical_pos, SEEK_SET);
+    if (r < 0) {
+        c->cache_pos = -1;
         av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
-        goto fail;
+        return AVERROR(errno);
     }
-    c->cache_pos = pos;
+    c->cache_pos = r;
+    return 0;
+}
 
-    ret = write(c->fd, buf, size);
-    if (ret < 0) {
-        ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "write in cache failed\n");
-        goto fail;
-    }
-    c->cache_pos += ret;
-
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
-
-    if (!entry)
-        entry = next[0];
-
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->logical_pos ||
-        entry->physical_pos + entry->size != pos
-    ) {
-        entry = av_malloc(sizeof(*entry));
-        node = av_tree_node_alloc();
-        if (!entry || !node) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+static int add_entry(URLContext *h, const unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    int64_t pos = c->logical_pos;
+    int ret;
+
+    while (size > 0) {
+        int64_t block = pos / c->block_size;
+        int off = pos % c->block_size;
+        int len = FFMIN(size, c->block_size - off);
+        int slot = block_get(c, block);
+        CacheBlock *b;
+
+        if (slot < 0)
+            return slot;
+        if ((ret = cache_file_seek(h, (int64_t)slot * c->block_size + off)) < 0)
+            return ret;
+        ret = write(c->fd, buf, len);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            c->cache_pos = -1;
+            av_log(h, AV_LOG_ERROR, "write in cache failed\n");
+            return ret;
         }
-        entry->logical_pos = c->logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
-            goto fail;
+        c->cache_pos += ret;
+
+        // one range per block: the new bytes extend it or replace it
+        b = &c->blocks[slot];
+        if (b->start < b->end && off <= b->end && off + ret >= b->start) {
+            b->start = FFMIN(b->start, off);
+            b->end   = FFMAX(b->end, off + ret);
+        } else {
+            b->start = off;
+            b->end   = off + ret;
         }
-    } else
-        entry->size += ret;
-
+        if (ret < len)
+            break;
+        buf  += len;
+        pos  += len;
+        size -= len;
+    }
     return 0;
-fail:
-    //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
-    //for simplicty we just leave the file a bit larger
-    av_free(entry);
-    av_free(node);
-    return ret;
 }
 
-static int cache_read(URLContext *h, unsigned char *buf, int size)
+static int cache_read_disk(URLContext *h, unsigned char *buf, int size)
 {
     Context *c= h->priv_data;
-    CacheEntry *entry, *next[2] = {NULL, NULL};
-    int64_t r;
+    int64_t available, r;
 
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
+    if (c->end_offset > 0) {
+        if (c->logical_pos >= c->end_offset)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->end_offset - c->logical_pos);
+    }
 
-    if (!entry)
-        entry = next[0];
+    /* Keep streaming from the inner protocol over short cached ranges
+     * rather than paying a new request after each of them. */
+    available = ff_disk_cache_available(c->disk, c->logical_pos);
+    if (available > 0 && (!c->inner || c->inner_pos != c->logical_pos ||
+                          available >= DISK_CACHE_MIN_SKIP)) {
+        r = ff_disk_cache_read(c->disk, c->logical_pos, buf, FFMIN(size, available));
+        if (r > 0) {
+            c->logical_pos += r;
+            c->cache_hit ++;
+            return r;
+        }
+    }
 
-    if (entry) {
-        int64_t in_block_pos = c->logical_pos - entry->logical_pos;
-        av_assert0(entry->logical_pos <= c->logical_pos);
-        if (in_block_pos < entry->size) {
-            int64_t physical_target = entry->physical_pos + in_block_pos;
+    r = ff_disk_cache_get_size(c->disk);
+    if (r >= 0 && c->logical_pos >= r)
+        return AVERROR_EOF;
 
-            if (c->cache_pos != physical_target) {
-                r = lseek(c->fd, physical_target, SEEK_SET);
-            } else
-                r = c->cache_pos;
+    if (!c->inner && (r = cache_open_inner(h)) < 0)
+        return r;
+    if (c->logical_pos != c->inner_pos) {
+        r = ffurl_seek(c->inner, c->logical_pos, SEEK_SET);
+        if (r<0) {
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+            return r;
+        }
+        c->inner_pos = r;
+    }
 
-            if (r >= 0) {
-                c->cache_pos = r;
-                r = read(c->fd, buf, FFMIN(size, entry->size - in_block_pos));
-            }
+    r = ffurl_read(c->inner, buf, size);
+    if ((r == 0 || r == AVERROR_EOF) && size > 0 && !c->end_offset)
+        ff_disk_cache_set_size(c->disk, c->logical_pos);
+    if (r<=0)
+        return r;
+    c->inner_pos += r;
+    c->cache_miss ++;
 
-            if (r > 0) {
-                c->cache_pos += r;
-                c->logical_pos += r;
-                c->cache_hit ++;
-                return r;
-            }
+    ff_disk_cache_write(c->disk, c->logical_pos, buf, r);
+    c->logical_pos += r;
+    return r;
+}
+
+static int cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    int64_t block;
+    int off, slot;
+    int64_t r;
+
+    if (c->disk)
+        return cache_read_disk(h, buf, size);
+
+    block = c->logical_pos / c->block_size;
+    off   = c->logical_pos % c->block_size;
+    slot  = block_find(c, block);
+    if (slot >= 0 && off >= c->blocks[slot].start && off < c->blocks[slot].end) {
+        r = cache_file_seek(h, (int64_t)slot * c->block_size + off);
+        if (r >= 0)
+            r = read(c->fd, buf, FFMIN(size, c->blocks[slot].end - off));
+
+        if (r > 0) {
+            c->cache_pos += r;
+            c->logical_pos += r;
+            c->cache_hit ++;
+            return r;
         }
+        c->cache_pos = -1;
     }
 
     // Cache miss or some kind of fault with the cache
@@ -218,11 +426,50 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     return r;
 }
 
+static int64_t cache_seek_disk(URLContext *h, int64_t pos, int whence)
+{
+    Context *c= h->priv_data;
+    int64_t size = ff_disk_cache_get_size(c->disk);
+    int ret;
+
+    if (size < 0 && (whence == AVSEEK_SIZE || whence == SEEK_END)) {
+        if (!c->inner && (ret = cache_open_inner(h)) < 0)
+            return ret;
+        size = ff_disk_cache_get_size(c->disk);
+    }
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return size >= 0 ? size : AVERROR(ENOSYS);
+    case SEEK_END:
+        if (size < 0)
+            return AVERROR(ENOSYS);
+        pos += size;
+        break;
+    case SEEK_CUR:
+        pos += c->logical_pos;
+        break;
+    case SEEK_SET:
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    // the inner protocol follows on the next miss
+    c->logical_pos = pos;
+    return pos;
+}
+
 static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
 {
     Context *c= h->priv_data;
     int64_t ret;
 
+    if (c->disk)
+        return cache_seek_disk(h, pos, whence);
+
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
@@ -283,12 +530,6 @@ resolve_eof:
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
@@ -296,10 +537,18 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
+    if (c->disk) {
+        ff_disk_cache_close(&c->disk);
+        ffurl_closep(&c->inner);
+        av_freep(&c->inner_url);
+        av_dict_free(&c->inner_options);
+        return 0;
+    }
+
     close(c->fd);
     ffurl_close(c->inner);
-    av_tree_enumerate(c->root, NULL, NULL, enu_free);
-    av_tree_destroy(c->root);
+    av_freep(&c->index);
+    av_freep(&c->blocks);
 
     return 0;
 }
@@ -309,6 +558,12 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_block_size", "Size of the blocks of the temporary file", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 64 * 1024 }, 4096, 16 * 1024 * 1024, D },
+    { "cache_max_size", "Most bytes kept in the temporary file, the least recently used blocks are reused", OFFSET(max_size), AV_OPT_TYPE_INT64, { .i64 = 64 * 1024 * 1024 }, 0, INT64_MAX, D },
+    { "disk_cache", "Keep the data in the persistent disk cache", OFFSET(disk_cache), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "disk_cache_dir", "Directory of the persistent disk cache, configured process wide", OFFSET(disk_cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "disk_cache_max_size", "Budget of the persistent disk cache in bytes", OFFSET(disk_cache_max_size), AV_OPT_TYPE_INT64, { .i64 = 512 * 1024 * 1024 }, 1, INT64_MAX, D },
+    { "disk_cache_ignore_params", "Comma separated query parameters left out of the cache key", OFFSET(disk_cache_ignore_params), AV_OPT_TYPE_STRING, { .str = DISK_CACHE_IGNORE_PARAMS }, 0, 0, D },
     {NULL},
 };
 
@@ -27,6 +27,8 @@
  * http://tools.ietf.org/html/draft-pantos-http-live-streaming
  */
 
+#include "config.h"
+#include "libavutil/application.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
 #include "libavutil/intreadwrite.h"
@@ -37,8 +39,17 @@
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "hls_abr.h"
+#include "hls_fetch.h"
+#include "hls_playlist.h"
+#include "hls_prefetch.h"
+#include "throughput.h"
 #include "id3v2.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define INITIAL_BUFFER_SIZE 32768
 
 #define MAX_FIELD_LEN 64
@@ -47,6 +58,24 @@
 #define MPEG_TIME_BASE 90000
 #define MPEG_TIME_BASE_Q (AVRational){1, MPEG_TIME_BASE}
 
+
+/* the weights of the requests sharing an HTTP/2 connection: a late reload
+ * holds back the live edge, and audio is needed before the video it leads */
+#define H2_WEIGHT_PLAYLIST      256
+#define H2_WEIGHT_AUDIO         192
+#define H2_WEIGHT_MEDIA         96
+#define H2_WEIGHT_PREFETCH      16
+
+/* with demux_threads, the packets a playlist worker reads ahead, and how
+ * long the others wait for a playlist that has none queued */
+#define DEMUX_QUEUE_SIZE        (4 * 1024 * 1024)
+#define DEMUX_STALL_TIME        100000
+#define DEMUX_WAIT_INTERVAL     10000
+
+/* AES-128 keys fetched ahead, for the segments after the one opened */
+#define MAX_KEY_FETCHES         4
+#define KEY_PREFETCH_SEGMENTS   3
+
 /*
  * An apple http stream consists of a playlist with media segment files,
  * played sequentially. There may be several playlists with the same
@@ -65,18 +94,54 @@ enum KeyType {
     KEY_SAMPLE_AES
 };
 
+/* where a key frame starts in a segment, to seek straight to it */
+struct keyframe {
+    int64_t timestamp;          /* dts in AV_TIME_BASE, as seek_timestamp */
+    int64_t offset;             /* from url_offset */
+};
+
 struct segment {
-    int64_t previous_duration;
+    int disc_seq;               /* discontinuity sequence number */
     int64_t duration;
     int64_t start_time;
     int64_t url_offset;
     int64_t size;
     char *url;
     char *key;
+    /* allocated sizes, segments are recycled across live reloads */
+    unsigned int url_size;
+    unsigned int key_size;
     enum KeyType key_type;
     uint8_t iv[16];
     /* associated Media Initialization Section, treated as a segment */
     struct segment *init_section;
+    /* video key frames met in an earlier pass over the segment, or listed
+     * by an I-frame playlist, in timestamp order */
+    struct keyframe *keyframes;
+    int n_keyframes;
+    unsigned int keyframes_size;
+};
+
+/* where the data of a segment begins in the AVIOContext of the playlist */
+struct segment_start {
+    int seq_no;
+    int64_t pos;
+    int64_t offset;             /* in the segment, where it was opened */
+};
+
+#define MAX_SEGMENT_STARTS 4
+/* timestamps further than this from where they should be start afresh */
+#define DISCONTINUITY_MAX_GAP (AV_TIME_BASE / 2)
+#define MAX_KEYFRAMES      1024
+
+/* EXT-X-PART, or the part announced by EXT-X-PRELOAD-HINT */
+struct part {
+    struct segment seg;
+    int seq_no;         /* of the parent segment */
+    int index;          /* in the parent segment */
+    int independent;
+    int gap;
+    int is_hint;
 };
 
 struct rendition;
@@ -114,11 +179,36 @@ struct playlist {
     int start_seq_no;
     int n_segments;
     struct segment **segments;
+    unsigned int segments_size;
+    /* the array of the previous load and the segments that left the live
+     * window, reused by the next reload */
+    struct segment **spare_segments;
+    unsigned int spare_segments_size;
+    struct segment **segment_pool;
+    unsigned int segment_pool_size;
+    int n_segment_pool;
     int needed, cur_needed;
     int cur_seq_no;
     int64_t cur_seg_offset;
+    int64_t seek_seg_offset;    /* where to open cur_seq_no, at a key frame after a seek */
     int64_t last_load_time;
 
+    /* Low-Latency HLS: the parts listed for the last segments and the one
+     * still being produced, ending with the preload hint if any */
+    int n_parts;
+    struct part **parts;
+    unsigned int parts_size;
+    int64_t part_target;
+    int64_t part_hold_back;
+    int64_t can_skip_until;
+    int can_block_reload;
+    int skip_failed;            /* a delta update could not be applied */
+    int cur_part;               /* next part of cur_seq_no, 0 at the segment start */
+    struct part *input_part;    /* the part open as input, NULL for a whole segment */
+    /* validators of the last playlist response, for conditional reloads */
+    char *etag;
+    char *last_modified;
+
     /* Currently active Media Initialization Section */
     struct segment *cur_init_section;
     uint8_t *init_sec_buf;
@@ -156,6 +246,40 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Downloads of the segments after cur_seq_no, and the one of them
+     * being read instead of input, if any */
+    HLSPrefetch *prefetch;
+    HLSPrefetchSegment *prefetch_seg;
+
+    /* time spent opening and reading the current segment, and its size */
+    int64_t download_time;
+    int64_t download_bytes;
+
+    /* the last segments read, to place the key frames of the demuxer */
+    struct segment_start seg_starts[MAX_SEGMENT_STARTS];
+    int n_seg_starts;
+    int iframes_loaded;         /* the I-frame playlists were looked at */
+
+    /* shift of the timestamps, for the discontinuity sequences to follow
+     * each other, see rebase_timestamps() */
+    int disc_seq;               /* of the input last opened, -1 to note the next one */
+    int disc_next_seq;          /* of an input the demuxer has not reached yet, -1 if none */
+    int64_t disc_next_pos;      /* where that input starts in pb */
+    int64_t disc_next_ts;       /* where it starts on the timeline, if known */
+    int64_t ts_offset;          /* in AV_TIME_BASE */
+    int64_t ts_end;             /* past the last packet, AV_NOPTS_VALUE after a seek */
+
+    /* with demux_threads, the packets read by the worker of the playlist
+     * for hls_read_packet() to take, see demux_thread() */
+    AVPacketList *queue_first, *queue_last;
+    int queue_size;
+    int demux_ret;              /* why the worker stopped reading, 0 while it reads */
+    int64_t demux_empty_since;  /* the queue was found empty then, 0 if it is not */
+#if HAVE_PTHREADS
+    pthread_t demux_thread;
+    int demux_running;
+#endif
 };
 
 /*
@@ -175,6 +299,8 @@ struct rendition {
 
 struct variant {
     int bandwidth;
+    int audio_only;     ///< CODECS lists audio codecs only
+    int excluded;       ///< CODECS lists one of exclude_codecs
 
     /* every variant contains at least the main Media Playlist in index 0 */
     int n_playlists;
@@ -186,7 +312,7 @@ struct variant {
 };
 
 typedef struct HLSContext {
-    AVClass *class;
+    const AVClass *class;
     AVFormatContext *ctx;
     int n_variants;
     struct variant **variants;
@@ -194,6 +320,9 @@ typedef struct HLSContext {
     struct playlist **playlists;
     int n_renditions;
     struct rendition **renditions;
+    /* EXT-X-I-FRAME-STREAM-INF of the master playlist */
+    int n_iframe_urls;
+    char **iframe_urls;
 
     int cur_seq_no;
     int live_start_index;
@@ -207,6 +336,46 @@ typedef struct HLSContext {
     char *http_proxy;                    ///< holds the address of the HTTP proxy server
     AVDictionary *avio_opts;
     int strict_std_compliance;
+    int prefetch_segments;
+    int prefetch_max_size;
+    int64_t audio_lead;                  ///< downloads of audio renditions kept this far ahead of video
+    int disk_cache;                      ///< read plain http segments through the cache protocol
+    int64_t key_cache_lifetime;          ///< keys are reused by the sessions of the process this long
+    HLSFetch *key_fetches[MAX_KEY_FETCHES];  ///< see prefetch_keys()
+    int key_fetch_next;
+    char *disk_cache_dir;
+    int64_t disk_cache_max_size;
+    char *exclude_codecs;                ///< see drop_excluded_variants()
+    int disc_seq;                        ///< last discontinuity sequence entered, see rebase_timestamps()
+    int64_t disc_offset;                 ///< ts_offset of the playlists in disc_seq
+
+    /* adaptive variant selection, see abr_check_switch() */
+    int abr;
+    int shared_estimate;                ///< start from the estimate of the process, see abr_initial_playlist()
+    int parallel_open;                  ///< see load_media_playlists()
+    int low_latency;
+    AVApplicationContext *app_ctx;
+    struct playlist *abr_leader;        ///< variant playlist whose streams are exported
+    struct playlist *abr_playlist;      ///< variant playlist being read
+    struct playlist *abr_next;          ///< switch to it once abr_playlist has drained
+    int abr_switch_seq_no;              ///< first segment of abr_playlist not read
+    HLSABRPolicy abr_policy;
+    HLSABRVariant *abr_variants;        ///< of variants, in the same order
+    HLSABREstimate abr_estimate;
+    int64_t abr_buffered_milli;     // buffer level at the switch decision
+
+    /* per playlist demux workers, started once two playlists are read:
+     * they and the reading thread hold lock but for the blocking network
+     * calls, and leave the state of the playlists to it while paused */
+    int demux_threads;
+    int demux_started;
+    int demux_pause;
+    int demux_busy;                 ///< workers inside av_read_frame()
+    int demux_abort;
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+    pthread_cond_t demux_cond;      ///< a queue changed, or the pause did
+#endif
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -217,16 +386,166 @@ static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
     return len;
 }
 
+static void free_segment(struct segment **pseg)
+{
+    av_freep(&(*pseg)->keyframes);
+    av_freep(&(*pseg)->key);
+    av_freep(&(*pseg)->url);
+    av_freep(pseg);
+}
+
 static void free_segment_list(struct playlist *pls)
 {
     int i;
-    for (i = 0; i < pls->n_segments; i++) {
-        av_freep(&pls->segments[i]->key);
-        av_freep(&pls->segments[i]->url);
-        av_freep(&pls->segments[i]);
-    }
+    for (i = 0; i < pls->n_segments; i++)
+        free_segment(&pls->segments[i]);
+    for (i = 0; i < pls->n_segment_pool; i++)
+        free_segment(&pls->segment_pool[i]);
     av_freep(&pls->segments);
-    pls->n_segments = 0;
+    av_freep(&pls->spare_segments);
+    av_freep(&pls->segment_pool);
+    pls->segments_size = pls->spare_segments_size = pls->segment_pool_size = 0;
+    pls->n_segments = pls->n_segment_pool = 0;
+}
+
+static void free_part(struct part **ppart)
+{
+    av_freep(&(*ppart)->seg.key);
+    av_freep(&(*ppart)->seg.url);
+    av_freep(ppart);
+}
+
+static void free_part_list(struct playlist *pls)
+{
+    int i;
+    for (i = 0; i < pls->n_parts; i++)
+        free_part(&pls->parts[i]);
+    av_freep(&pls->parts);
+    pls->parts_size = 0;
+    pls->n_parts    = 0;
+}
+
+static void recycle_segment(struct playlist *pls, struct segment *seg)
+{
+    struct segment **pool = av_fast_realloc(pls->segment_pool, &pls->segment_pool_size,
+                                            (pls->n_segment_pool + 1) * sizeof(*pool));
+    if (!pool) {
+        free_segment(&seg);
+        return;
+    }
+    pls->segment_pool = pool;
+    pool[pls->n_segment_pool++] = seg;
+}
+
+/* the segment with seq_no from the previous load if there is one, so its
+ * strings are kept, else a recycled or new one */
+static struct segment *reuse_segment(struct playlist *pls, int seq_no,
+                                     struct segment **old_segments,
+                                     int n_old_segments, int old_start_seq_no)
+{
+    struct segment *seg;
+    int i = seq_no - old_start_seq_no;
+
+    if (i >= 0 && i < n_old_segments && old_segments[i]) {
+        seg = old_segments[i];
+        old_segments[i] = NULL;
+        return seg;
+    }
+    if (pls->n_segment_pool) {
+        seg = pls->segment_pool[--pls->n_segment_pool];
+        seg->n_keyframes = 0;
+        return seg;
+    }
+    return av_mallocz(sizeof(struct segment));
+}
+
+static int append_segment(struct playlist *pls, struct segment *seg)
+{
+    struct segment **segments = av_fast_realloc(pls->segments, &pls->segments_size,
+                                                (pls->n_segments + 1) * sizeof(*segments));
+    if (!segments)
+        return AVERROR(ENOMEM);
+    pls->segments = segments;
+    segments[pls->n_segments++] = seg;
+    return 0;
+}
+
+/* copy str to *dst, in place when it fits */
+static int set_segment_string(char **dst, unsigned int *size, const char *str)
+{
+    size_t len = strlen(str) + 1;
+
+    if (*dst && !strcmp(*dst, str))
+        return 0;
+    av_fast_malloc(dst, size, len);
+    if (!*dst)
+        return AVERROR(ENOMEM);
+    memcpy(*dst, str, len);
+    return 0;
+}
+
+static int set_segment_key(struct segment *seg, enum KeyType key_type,
+                           const char *key, const uint8_t *iv, int has_iv,
+                           int seq_no, const char *url_base)
+{
+    char tmp_str[MAX_URL_SIZE];
+
+    seg->key_type = key_type;
+    if (has_iv) {
+        memcpy(seg->iv, iv, sizeof(seg->iv));
+    } else {
+        memset(seg->iv, 0, sizeof(seg->iv));
+        AV_WB32(seg->iv + 12, seq_no);
+    }
+
+    if (key_type == KEY_NONE) {
+        av_freep(&seg->key);
+        seg->key_size = 0;
+        return 0;
+    }
+    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url_base, key);
+    return set_segment_string(&seg->key, &seg->key_size, tmp_str);
+}
+
+/* the part of the previous load with the same position, else a new one */
+static struct part *reuse_part(struct part **old_parts, int n_old_parts,
+                               int seq_no, int index)
+{
+    int i;
+
+    for (i = 0; i < n_old_parts; i++) {
+        struct part *part = old_parts[i];
+        if (part && part->seq_no == seq_no && part->index == index) {
+            old_parts[i] = NULL;
+            return part;
+        }
+    }
+    return av_mallocz(sizeof(struct part));
+}
+
+static int append_part(struct playlist *pls, struct part *part)
+{
+    struct part **parts = av_fast_realloc(pls->parts, &pls->parts_size,
+                                          (pls->n_parts + 1) * sizeof(*parts));
+    if (!parts)
+        return AVERROR(ENOMEM);
+    pls->parts = parts;
+    parts[pls->n_parts++] = part;
+    return 0;
+}
+
+static struct part *find_part(struct playlist *pls, int seq_no, int index)
+{
+    int i;
+
+    for (i = pls->n_parts - 1; i >= 0; i--) {
+        struct part *part = pls->parts[i];
+        if (part->seq_no == seq_no && part->index == index)
+            return part;
+        if (part->seq_no < seq_no)
+            break;
+    }
+    return NULL;
 }
 
 static void free_init_section_list(struct playlist *pls)
@@ -240,29 +559,54 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+/* drop what the worker of pls read, to read again from where pls is now */
+static void flush_queue(struct playlist *pls)
+{
+    AVPacketList *node;
+
+    while ((node = pls->queue_first)) {
+        pls->queue_first = node->next;
+        av_packet_unref(&node->pkt);
+        av_free(node);
+    }
+    pls->queue_last        = NULL;
+    pls->queue_size        = 0;
+    pls->demux_ret         = 0;
+    pls->demux_empty_since = 0;
+}
+
+static void free_playlist(HLSContext *c, struct playlist *pls)
+{
+    free_segment_list(pls);
+    free_part_list(pls);
+    free_init_section_list(pls);
+    av_freep(&pls->main_streams);
+    av_freep(&pls->renditions);
+    av_freep(&pls->id3_buf);
+    av_dict_free(&pls->id3_initial);
+    ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
+    av_freep(&pls->init_sec_buf);
+    av_freep(&pls->etag);
+    av_freep(&pls->last_modified);
+    av_packet_unref(&pls->pkt);
+    flush_queue(pls);
+    av_freep(&pls->pb.buffer);
+    if (pls->input)
+        ff_format_io_close(c->ctx, &pls->input);
+    ff_hls_prefetch_release(pls->prefetch, &pls->prefetch_seg);
+    ff_hls_prefetch_freep(&pls->prefetch);
+    if (pls->ctx) {
+        pls->ctx->pb = NULL;
+        avformat_close_input(&pls->ctx);
+    }
+    av_free(pls);
+}
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
-    for (i = 0; i < c->n_playlists; i++) {
-        struct playlist *pls = c->playlists[i];
-        free_segment_list(pls);
-        free_init_section_list(pls);
-        av_freep(&pls->main_streams);
-        av_freep(&pls->renditions);
-        av_freep(&pls->id3_buf);
-        av_dict_free(&pls->id3_initial);
-        ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
-        av_freep(&pls->init_sec_buf);
-        av_packet_unref(&pls->pkt);
-        av_freep(&pls->pb.buffer);
-        if (pls->input)
-            ff_format_io_close(c->ctx, &pls->input);
-        if (pls->ctx) {
-            pls->ctx->pb = NULL;
-            avformat_close_input(&pls->ctx);
-        }
-        av_free(pls);
-    }
+    for (i = 0; i < c->n_playlists; i++)
+        free_playlist(c, c->playlists[i]);
     av_freep(&c->playlists);
     av_freep(&c->cookies);
     av_freep(&c->user_agent);
@@ -271,6 +615,15 @@ static void free_playlist_list(HLSContext *c)
     c->n_playlists = 0;
 }
 
+static void free_iframe_url_list(HLSContext *c)
+{
+    int i;
+    for (i = 0; i < c->n_iframe_urls; i++)
+        av_freep(&c->iframe_urls[i]);
+    av_freep(&c->iframe_urls);
+    c->n_iframe_urls = 0;
+}
+
 static void free_variant_list(HLSContext *c)
 {
     int i;
@@ -315,18 +668,69 @@ static struct playlist *new_playlist(HLSContext *c, const char *url,
     pls->is_id3_timestamped = -1;
     pls->id3_mpegts_timestamp = AV_NOPTS_VALUE;
 
+    pls->disc_seq      = -1;
+    pls->disc_next_seq = -1;
+    pls->ts_end        = AV_NOPTS_VALUE;
+
     dynarray_add(&c->playlists, &c->n_playlists, pls);
     return pls;
 }
 
 struct variant_info {
     char bandwidth[20];
+    char codecs[MAX_FIELD_LEN * 2];
     /* variant group ids: */
     char audio[MAX_FIELD_LEN];
     char video[MAX_FIELD_LEN];
     char subtitles[MAX_FIELD_LEN];
 };
 
+/* "mp4a.40.2,avc1.4d401f": every codec of the list is an audio one */
+static int codecs_audio_only(const char *codecs)
+{
+    static const char *const audio[] = { "mp4a", "ac-3", "ec-3", "ac-4", "opus", "Opus", "fLaC", "alac", "mp3" };
+    const char *p = codecs;
+    int i;
+
+    if (!*codecs)
+        return 0;
+    while (*p) {
+        p += strspn(p, " ,");
+        if (!*p)
+            break;
+        for (i = 0; i < FF_ARRAY_ELEMS(audio); i++) {
+            if (av_strstart(p, audio[i], NULL))
+                break;
+        }
+        if (i == FF_ARRAY_ELEMS(audio))
+            return 0;
+        p += strcspn(p, ",");
+    }
+    return 1;
+}
+
+/* some codec of the CODECS list starts with one of the comma separated
+ * prefixes of excluded, "av01" matching "av01.0.08M.08" */
+static int codecs_excluded(const char *codecs, const char *excluded)
+{
+    const char *p = codecs;
+
+    while (*p) {
+        const char *e = excluded;
+        p += strspn(p, " ,");
+        while (*p && *e) {
+            size_t len;
+            e  += strspn(e, " ,");
+            len = strcspn(e, " ,");
+            if (len && !strncmp(p, e, len))
+                return 1;
+            e  += len;
+        }
+        p += strcspn(p, ",");
+    }
+    return 0;
+}
+
 static struct variant *new_variant(HLSContext *c, struct variant_info *info,
                                    const char *url, const char *base)
 {
@@ -343,6 +747,8 @@ static struct variant *new_variant(HLSContext *c, struct variant_info *info,
 
     if (info) {
         var->bandwidth = atoi(info->bandwidth);
+        var->audio_only = codecs_audio_only(info->codecs);
+        var->excluded = c->exclude_codecs && codecs_excluded(info->codecs, c->exclude_codecs);
         strcpy(var->audio_group, info->audio);
         strcpy(var->video_group, info->video);
         strcpy(var->subtitles_group, info->subtitles);
@@ -359,6 +765,9 @@ static void handle_variant_args(struct variant_info *info, const char *key,
     if (!strncmp(key, "BANDWIDTH=", key_len)) {
         *dest     =        info->bandwidth;
         *dest_len = sizeof(info->bandwidth);
+    } else if (!strncmp(key, "CODECS=", key_len)) {
+        *dest     =        info->codecs;
+        *dest_len = sizeof(info->codecs);
     } else if (!strncmp(key, "AUDIO=", key_len)) {
         *dest     =        info->audio;
         *dest_len = sizeof(info->audio);
@@ -371,6 +780,19 @@ static void handle_variant_args(struct variant_info *info, const char *key,
     }
 }
 
+struct iframe_info {
+    char uri[MAX_URL_SIZE];
+};
+
+static void handle_iframe_args(struct iframe_info *info, const char *key,
+                               int key_len, char **dest, int *dest_len)
+{
+    if (!strncmp(key, "URI=", key_len)) {
+        *dest     =        info->uri;
+        *dest_len = sizeof(info->uri);
+    }
+}
+
 struct key_info {
      char uri[MAX_URL_SIZE];
      char method[11];
@@ -404,30 +826,40 @@ static struct segment *new_init_section(struct playlist *pls,
     struct segment *sec;
     char *ptr;
     char tmp_str[MAX_URL_SIZE];
+    int64_t size = -1, url_offset = 0;
+    int i;
 
     if (!info->uri[0])
         return NULL;
 
+    if (info->byterange[0]) {
+        size = strtoll(info->byterange, NULL, 10);
+        ptr = strchr(info->byterange, '@');
+        if (ptr)
+            url_offset = strtoll(ptr+1, NULL, 10);
+    }
+    /* otherwise the entire file is the init section */
+
+    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url_base, info->uri);
+
+    /* live reloads repeat the same EXT-X-MAP, keep the one already read */
+    for (i = 0; i < pls->n_init_sections; i++) {
+        sec = pls->init_sections[i];
+        if (sec->size == size && sec->url_offset == url_offset && !strcmp(sec->url, tmp_str))
+            return sec;
+    }
+
     sec = av_mallocz(sizeof(*sec));
     if (!sec)
         return NULL;
 
-    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url_base, info->uri);
     sec->url = av_strdup(tmp_str);
     if (!sec->url) {
         av_free(sec);
         return NULL;
     }
-
-    if (info->byterange[0]) {
-        sec->size = strtoll(info->byterange, NULL, 10);
-        ptr = strchr(info->byterange, '@');
-        if (ptr)
-            sec->url_offset = strtoll(ptr+1, NULL, 10);
-    } else {
-        /* the entire file is the init section */
-        sec->size = -1;
-    }
+    sec->size       = size;
+    sec->url_offset = url_offset;
 
     dynarray_add(&pls->init_sections, &pls->n_init_sections, sec);
 
@@ -446,6 +878,69 @@ static void handle_init_section_args(struct init_section_info *info, const char
     }
 }
 
+struct part_info {
+    char type[16];
+    char uri[MAX_URL_SIZE];
+    char duration[32];
+    char byterange[64];
+    char byterange_start[32];
+    char byterange_length[32];
+    char independent[4];
+    char gap[4];
+};
+
+/* attributes of EXT-X-PART and EXT-X-PRELOAD-HINT */
+static void handle_part_args(struct part_info *info, const char *key,
+                             int key_len, char **dest, int *dest_len)
+{
+    if (!strncmp(key, "TYPE=", key_len)) {
+        *dest     =        info->type;
+        *dest_len = sizeof(info->type);
+    } else if (!strncmp(key, "URI=", key_len)) {
+        *dest     =        info->uri;
+        *dest_len = sizeof(info->uri);
+    } else if (!strncmp(key, "DURATION=", key_len)) {
+        *dest     =        info->duration;
+        *dest_len = sizeof(info->duration);
+    } else if (!strncmp(key, "BYTERANGE=", key_len)) {
+        *dest     =        info->byterange;
+        *dest_len = sizeof(info->byterange);
+    } else if (!strncmp(key, "BYTERANGE-START=", key_len)) {
+        *dest     =        info->byterange_start;
+        *dest_len = sizeof(info->byterange_start);
+    } else if (!strncmp(key, "BYTERANGE-LENGTH=", key_len)) {
+        *dest     =        info->byterange_length;
+        *dest_len = sizeof(info->byterange_length);
+    } else if (!strncmp(key, "INDEPENDENT=", key_len)) {
+        *dest     =        info->independent;
+        *dest_len = sizeof(info->independent);
+    } else if (!strncmp(key, "GAP=", key_len)) {
+        *dest     =        info->gap;
+        *dest_len = sizeof(info->gap);
+    }
+}
+
+struct server_control_info {
+    char can_block_reload[4];
+    char can_skip_until[32];
+    char part_hold_back[32];
+};
+
+static void handle_server_control_args(struct server_control_info *info, const char *key,
+                                       int key_len, char **dest, int *dest_len)
+{
+    if (!strncmp(key, "CAN-BLOCK-RELOAD=", key_len)) {
+        *dest     =        info->can_block_reload;
+        *dest_len = sizeof(info->can_block_reload);
+    } else if (!strncmp(key, "CAN-SKIP-UNTIL=", key_len)) {
+        *dest     =        info->can_skip_until;
+        *dest_len = sizeof(info->can_skip_until);
+    } else if (!strncmp(key, "PART-HOLD-BACK=", key_len)) {
+        *dest     =        info->part_hold_back;
+        *dest_len = sizeof(info->part_hold_back);
+    }
+}
+
 struct rendition_info {
     char type[16];
     char uri[MAX_URL_SIZE];
@@ -598,7 +1093,72 @@ static void update_options(char **dest, const char *name, void *src)
         av_freep(dest);
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+/* Taken around the calls that may block on the network, by a worker and
+ * by the reading thread, so the other workers go on meanwhile. No-ops
+ * until the workers are started. */
+static void demux_unlock(HLSContext *c)
+{
+#if HAVE_PTHREADS
+    if (c->demux_started)
+        pthread_mutex_unlock(&c->lock);
+#endif
+}
+
+static void demux_lock(HLSContext *c)
+{
+#if HAVE_PTHREADS
+    if (c->demux_started)
+        pthread_mutex_lock(&c->lock);
+#endif
+}
+
+/* wait for the workers to leave av_read_frame(), with lock held */
+static void demux_pause(HLSContext *c)
+{
+#if HAVE_PTHREADS
+    if (!c->demux_started)
+        return;
+    c->demux_pause = 1;
+    while (c->demux_busy)
+        pthread_cond_wait(&c->demux_cond, &c->lock);
+#endif
+}
+
+static void demux_resume(HLSContext *c)
+{
+#if HAVE_PTHREADS
+    if (!c->demux_started)
+        return;
+    c->demux_pause = 0;
+    pthread_cond_broadcast(&c->demux_cond);
+#endif
+}
+
+static void stop_demux(HLSContext *c)
+{
+#if HAVE_PTHREADS
+    int i;
+
+    if (!c->demux_started)
+        return;
+    pthread_mutex_lock(&c->lock);
+    c->demux_abort = 1;
+    pthread_cond_broadcast(&c->demux_cond);
+    pthread_mutex_unlock(&c->lock);
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+        if (pls->demux_running)
+            pthread_join(pls->demux_thread, NULL);
+        pls->demux_running = 0;
+    }
+    pthread_cond_destroy(&c->demux_cond);
+    pthread_mutex_destroy(&c->lock);
+    c->demux_started = 0;
+#endif
+}
+
+/* flags: AVIO_FLAG_DIRECT or 0, with AVIO_FLAG_READ */
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url, int flags,
                     AVDictionary *opts, AVDictionary *opts2, int *is_http)
 {
     HLSContext *c = s->priv_data;
@@ -631,7 +1191,9 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
-    ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+    demux_unlock(c);
+    ret = s->io_open(s, pb, url, AVIO_FLAG_READ | flags, &tmp);
+    demux_lock(c);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         void *u = (s->flags & AVFMT_FLAG_CUSTOM_IO) ? NULL : s->pb;
@@ -647,11 +1209,37 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     return ret;
 }
 
+/* the options of every load of a playlist */
+static void playlist_options(HLSContext *c, AVDictionary **opts)
+{
+    AVDictionaryEntry *e;
+
+    /* Some HLS servers don't like being sent the range header */
+    av_dict_set(opts, "seekable", "0", 0);
+
+    // broker prior HTTP options that should be consistent across requests
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+
+    if ((e = av_dict_get(c->avio_opts, "http2", NULL, 0)))
+        av_dict_set(opts, "http2", e->value, 0);
+    if ((e = av_dict_get(c->avio_opts, "http3", NULL, 0)))
+        av_dict_set(opts, "http3", e->value, 0);
+    if ((e = av_dict_get(c->avio_opts, "mirrors", NULL, 0)))
+        av_dict_set(opts, "mirrors", e->value, 0);
+    if ((e = av_dict_get(c->avio_opts, "mirror_stall_timeout", NULL, 0)))
+        av_dict_set(opts, "mirror_stall_timeout", e->value, 0);
+    av_dict_set_int(opts, "http2_weight", H2_WEIGHT_PLAYLIST, 0);
+}
+
 static int parse_playlist(HLSContext *c, const char *url,
                           struct playlist *pls, AVIOContext *in)
 {
     int ret = 0, is_segment = 0, is_variant = 0;
-    int64_t duration = 0, previous_duration1 = 0, previous_duration = 0, total_duration = 0;
+    int64_t duration = 0, total_duration = 0;
+    int disc_seq = 0;
     enum KeyType key_type = KEY_NONE;
     uint8_t iv[16] = "";
     int has_iv = 0;
@@ -666,21 +1254,29 @@ static int parse_playlist(HLSContext *c, const char *url,
     char tmp_str[MAX_URL_SIZE];
     struct segment *cur_init_section = NULL;
     int start_seq_no = -1;
+    struct segment **old_segments = NULL;
+    int n_old_segments = 0, old_start_seq_no = 0;
+    struct part **old_parts = NULL;
+    int n_old_parts = 0, part_index = 0, is_hint;
+    int64_t part_offset = 0;
+    int64_t http_code = 0;
+    int i;
 
     if (!in) {
 #if 1
         AVDictionary *opts = NULL;
         close_in = 1;
-        /* Some HLS servers don't like being sent the range header */
-        av_dict_set(&opts, "seekable", "0", 0);
+        playlist_options(c, &opts);
 
-        // broker prior HTTP options that should be consistent across requests
-        av_dict_set(&opts, "user_agent", c->user_agent, 0);
-        av_dict_set(&opts, "cookies", c->cookies, 0);
-        av_dict_set(&opts, "headers", c->headers, 0);
-        av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
+        // a live playlist that did not change since the last load gets a 304
+        if (pls && pls->n_segments && !pls->finished && !strcmp(url, pls->url)) {
+            av_dict_set(&opts, "if_none_match", pls->etag, 0);
+            av_dict_set(&opts, "if_modified_since", pls->last_modified, 0);
+        }
 
+        demux_unlock(c);
         ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
+        demux_lock(c);
         av_dict_free(&opts);
         if (ret < 0)
             return ret;
@@ -695,6 +1291,13 @@ static int parse_playlist(HLSContext *c, const char *url,
     if (av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, &new_url) >= 0)
         url = new_url;
 
+    if (pls && av_opt_get_int(in, "http_code", AV_OPT_SEARCH_CHILDREN, &http_code) >= 0 &&
+        http_code == 304) {
+        av_log(c->ctx, AV_LOG_DEBUG, "Playlist %s not modified\n", url);
+        pls->last_load_time = av_gettime_relative();
+        goto fail;
+    }
+
     read_chomp_line(in, line, sizeof(line));
     if (strcmp(line, "#EXTM3U")) {
         ret = AVERROR_INVALIDDATA;
@@ -702,9 +1305,24 @@ static int parse_playlist(HLSContext *c, const char *url,
     }
 
     if (pls) {
-        free_segment_list(pls);
+        /* only the segments new to this load are allocated, the others
+         * are taken over from the previous one */
+        FFSWAP(struct segment **, pls->segments, pls->spare_segments);
+        FFSWAP(unsigned int, pls->segments_size, pls->spare_segments_size);
+        old_segments     = pls->spare_segments;
+        n_old_segments   = pls->n_segments;
+        old_start_seq_no = pls->start_seq_no;
+        pls->n_segments  = 0;
+        old_parts        = pls->parts;
+        n_old_parts      = pls->n_parts;
+        pls->parts       = NULL;
+        pls->parts_size  = 0;
+        pls->n_parts     = 0;
         pls->finished = 0;
         pls->type = PLS_TYPE_UNSPECIFIED;
+        pls->can_block_reload = 0;
+        pls->can_skip_until   = 0;
+        pls->part_hold_back   = 0;
     }
     while (!avio_feof(in)) {
         read_chomp_line(in, line, sizeof(line));
@@ -713,6 +1331,19 @@ static int parse_playlist(HLSContext *c, const char *url,
             memset(&variant_info, 0, sizeof(variant_info));
             ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_variant_args,
                                &variant_info);
+        } else if (av_strstart(line, "#EXT-X-I-FRAME-STREAM-INF:", &ptr)) {
+            struct iframe_info info = {{0}};
+            char *iframe_url;
+            ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_iframe_args,
+                               &info);
+            if (!info.uri[0])
+                continue;
+            ff_make_absolute_url(tmp_str, sizeof(tmp_str), url, info.uri);
+            if (!(iframe_url = av_strdup(tmp_str))) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            dynarray_add(&c->iframe_urls, &c->n_iframe_urls, iframe_url);
         } else if (av_strstart(line, "#EXT-X-KEY:", &ptr)) {
             struct key_info info = {{0}};
             ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_key_args,
@@ -763,11 +1394,104 @@ static int parse_playlist(HLSContext *c, const char *url,
             ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_init_section_args,
                                &info);
             cur_init_section = new_init_section(pls, &info, url);
+        } else if (av_strstart(line, "#EXT-X-SERVER-CONTROL:", &ptr)) {
+            struct server_control_info info = {{0}};
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_server_control_args,
+                               &info);
+            pls->can_block_reload = !strcmp(info.can_block_reload, "YES");
+            pls->can_skip_until   = atof(info.can_skip_until) * AV_TIME_BASE;
+            pls->part_hold_back   = atof(info.part_hold_back) * AV_TIME_BASE;
+        } else if (av_strstart(line, "#EXT-X-PART-INF:", &ptr)) {
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            if (av_strstart(ptr, "PART-TARGET=", &ptr))
+                pls->part_target = atof(ptr) * AV_TIME_BASE;
+        } else if ((is_hint = av_strstart(line, "#EXT-X-PRELOAD-HINT:", &ptr)) ||
+                   av_strstart(line, "#EXT-X-PART:", &ptr)) {
+            struct part_info info = {{0}};
+            struct part *part;
+            int seq;
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_part_args,
+                               &info);
+            if (!info.uri[0] || (is_hint && strcmp(info.type, "PART")))
+                continue;
+            seq  = pls->start_seq_no + pls->n_segments;
+            part = reuse_part(old_parts, n_old_parts, seq, part_index);
+            if (!part) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            part->seq_no           = seq;
+            part->index            = part_index++;
+            part->is_hint          = is_hint;
+            part->independent      = !strcmp(info.independent, "YES");
+            part->gap              = !strcmp(info.gap, "YES");
+            part->seg.duration     = atof(info.duration) * AV_TIME_BASE;
+            part->seg.init_section = cur_init_section;
+            part->seg.disc_seq     = disc_seq;
+            part->seg.size         = -1;
+            part->seg.url_offset   = 0;
+            if (info.byterange[0]) {
+                /* without an offset the part follows the previous one */
+                part->seg.size       = strtoll(info.byterange, NULL, 10);
+                ptr = strchr(info.byterange, '@');
+                part->seg.url_offset = ptr ? strtoll(ptr + 1, NULL, 10) : part_offset;
+                part_offset          = part->seg.url_offset + part->seg.size;
+            } else if (info.byterange_start[0]) {
+                part->seg.url_offset = strtoll(info.byterange_start, NULL, 10);
+                if (info.byterange_length[0])
+                    part->seg.size   = strtoll(info.byterange_length, NULL, 10);
+            }
+            ff_make_absolute_url(tmp_str, sizeof(tmp_str), url, info.uri);
+            ret = set_segment_string(&part->seg.url, &part->seg.url_size, tmp_str);
+            if (ret >= 0)
+                ret = set_segment_key(&part->seg, key_type, key, iv, has_iv, seq, url);
+            if (ret >= 0)
+                ret = append_part(pls, part);
+            if (ret < 0) {
+                free_part(&part);
+                goto fail;
+            }
+        } else if (av_strstart(line, "#EXT-X-SKIP:", &ptr)) {
+            /* delta update, the oldest segments are the ones already known */
+            int skipped = av_strstart(ptr, "SKIPPED-SEGMENTS=", &ptr) ? atoi(ptr) : 0;
+            if (!pls) {
+                ret = AVERROR_INVALIDDATA;
+                goto fail;
+            }
+            for (i = 0; i < skipped; i++) {
+                int idx = pls->start_seq_no + pls->n_segments - old_start_seq_no;
+                struct segment *seg;
+                if (idx < 0 || idx >= n_old_segments || !old_segments[idx]) {
+                    av_log(c->ctx, AV_LOG_WARNING, "Cannot apply delta update of %s\n", url);
+                    ret = AVERROR_INVALIDDATA;
+                    goto fail;
+                }
+                seg = old_segments[idx];
+                old_segments[idx] = NULL;
+                if ((ret = append_segment(pls, seg)) < 0) {
+                    recycle_segment(pls, seg);
+                    goto fail;
+                }
+                disc_seq = seg->disc_seq;
+                seg->start_time = total_duration;
+                total_duration += seg->duration;
+                cur_init_section = seg->init_section;
+            }
         } else if (av_strstart(line, "#EXT-X-ENDLIST", &ptr)) {
             if (pls)
                 pls->finished = 1;
+        } else if (av_strstart(line, "#EXT-X-DISCONTINUITY-SEQUENCE:", &ptr)) {
+            disc_seq = atoi(ptr);
         } else if (av_strstart(line, "#EXT-X-DISCONTINUITY", &ptr)) {
-            previous_duration = previous_duration1;
+            disc_seq++;
         } else if (av_strstart(line, "#EXTINF:", &ptr)) {
             is_segment = 1;
             duration   = atof(ptr) * AV_TIME_BASE;
@@ -795,48 +1519,31 @@ static int parse_playlist(HLSContext *c, const char *url,
                     }
                     pls = c->playlists[c->n_playlists - 1];
                 }
-                seg = av_malloc(sizeof(struct segment));
+                seg = reuse_segment(pls, pls->start_seq_no + pls->n_segments,
+                                    old_segments, n_old_segments, old_start_seq_no);
                 if (!seg) {
                     ret = AVERROR(ENOMEM);
                     goto fail;
                 }
-                previous_duration1 += duration;
-                seg->previous_duration = previous_duration;
+                seg->disc_seq = disc_seq;
                 seg->start_time = total_duration;
                 total_duration += duration;
                 seg->duration = duration;
-                seg->key_type = key_type;
-                if (has_iv) {
-                    memcpy(seg->iv, iv, sizeof(iv));
-                } else {
-                    int seq = pls->start_seq_no + pls->n_segments;
-                    memset(seg->iv, 0, sizeof(seg->iv));
-                    AV_WB32(seg->iv + 12, seq);
-                }
+                ret = set_segment_key(seg, key_type, key, iv, has_iv,
+                                      pls->start_seq_no + pls->n_segments, url);
 
-                if (key_type != KEY_NONE) {
-                    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url, key);
-                    seg->key = av_strdup(tmp_str);
-                    if (!seg->key) {
-                        av_free(seg);
-                        ret = AVERROR(ENOMEM);
-                        goto fail;
-                    }
-                } else {
-                    seg->key = NULL;
+                if (ret >= 0) {
+                    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url, line);
+                    ret = set_segment_string(&seg->url, &seg->url_size, tmp_str);
                 }
-
-                ff_make_absolute_url(tmp_str, sizeof(tmp_str), url, line);
-                seg->url = av_strdup(tmp_str);
-                if (!seg->url) {
-                    av_free(seg->key);
-                    av_free(seg);
-                    ret = AVERROR(ENOMEM);
+                if (ret >= 0)
+                    ret = append_segment(pls, seg);
+                if (ret < 0) {
+                    recycle_segment(pls, seg);
                     goto fail;
                 }
-
-                dynarray_add(&pls->segments, &pls->n_segments, seg);
                 is_segment = 0;
+                part_index = 0;
 
                 seg->size = seg_size;
                 if (seg_size >= 0) {
@@ -852,10 +1559,22 @@ static int parse_playlist(HLSContext *c, const char *url,
             }
         }
     }
-    if (pls)
+    if (pls) {
         pls->last_load_time = av_gettime_relative();
+        update_options(&pls->etag, "etag", in);
+        update_options(&pls->last_modified, "last_modified", in);
+    }
 
 fail:
+    for (i = 0; i < n_old_segments; i++) {
+        if (old_segments[i])
+            recycle_segment(pls, old_segments[i]);
+    }
+    for (i = 0; i < n_old_parts; i++) {
+        if (old_parts[i])
+            free_part(&old_parts[i]);
+    }
+    av_free(old_parts);
     av_free(new_url);
     if (close_in)
         ff_format_io_close(c->ctx, &in);
@@ -876,18 +1595,28 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size,
                          enum ReadFromURLMode mode)
 {
+    HLSContext *c = pls->parent->priv_data;
     int ret;
 
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    if (mode == READ_COMPLETE) {
+    if (pls->prefetch_seg) {
+        demux_unlock(c);
+        ret = ff_hls_prefetch_read(pls->prefetch, pls->prefetch_seg, buf, buf_size);
+        demux_lock(c);
+    } else {
+        int64_t start = av_gettime_relative();
+        demux_unlock(c);
         ret = avio_read(pls->input, buf, buf_size);
-        if (ret != buf_size)
+        demux_lock(c);
+        if (mode == READ_COMPLETE && ret != buf_size)
             av_log(NULL, AV_LOG_ERROR, "Could not read complete segment.\n");
-    } else
-        ret = avio_read(pls->input, buf, buf_size);
+        pls->download_time += av_gettime_relative() - start;
+        if (ret > 0)
+            pls->download_bytes += ret;
+    }
 
     if (ret > 0)
         pls->cur_seg_offset += ret;
@@ -992,93 +1721,61 @@ static void handle_id3(AVIOContext *pb, struct playlist *pls)
         ff_id3v2_free_extra_meta(&extra_meta);
 }
 
-static void intercept_id3(struct playlist *pls, uint8_t *buf,
-                         int buf_size, int *len)
+/*
+ * Read a segment start into buf, without the ID3 tags, which elementary
+ * audio streams use to convey timestamps at the beginning of each segment
+ * and the raw demuxer should not see on every segment switch. The tags are
+ * read into id3_buf, a header at a time; only the header that is no tag is
+ * copied into buf, the data after it is read in place.
+ */
+static int intercept_id3(struct playlist *pls, struct segment *seg,
+                         uint8_t *buf, int buf_size)
 {
-    /* intercept id3 tags, we do not want to pass them to the raw
-     * demuxer on all segment switches */
-    int bytes;
+    uint8_t header[ID3v2_HEADER_SIZE];
+    int64_t maxsize = seg->size >= 0 ? seg->size : 1024*1024;
     int id3_buf_pos = 0;
-    int fill_buf = 0;
-    struct segment *seg = current_segment(pls);
+    int len, bytes;
 
     /* gather all the id3 tags */
     while (1) {
-        /* see if we can retrieve enough data for ID3 header */
-        if (*len < ID3v2_HEADER_SIZE && buf_size >= ID3v2_HEADER_SIZE) {
-            bytes = read_from_url(pls, seg, buf + *len, ID3v2_HEADER_SIZE - *len, READ_COMPLETE);
-            if (bytes > 0) {
-
-                if (bytes == ID3v2_HEADER_SIZE - *len)
-                    /* no EOF yet, so fill the caller buffer again after
-                     * we have stripped the ID3 tags */
-                    fill_buf = 1;
-
-                *len += bytes;
-
-            } else if (*len <= 0) {
-                /* error/EOF */
-                *len = bytes;
-                fill_buf = 0;
-            }
-        }
+        uint8_t *id3_buf;
+        int taglen;
 
-        if (*len < ID3v2_HEADER_SIZE)
+        len = read_from_url(pls, seg, header, sizeof(header), READ_COMPLETE);
+        if (len < (int)sizeof(header) || !ff_id3v2_match(header, ID3v2_DEFAULT_MAGIC))
             break;
 
-        if (ff_id3v2_match(buf, ID3v2_DEFAULT_MAGIC)) {
-            int64_t maxsize = seg->size >= 0 ? seg->size : 1024*1024;
-            int taglen = ff_id3v2_tag_len(buf);
-            int tag_got_bytes = FFMIN(taglen, *len);
-            int remaining = taglen - tag_got_bytes;
-
-            if (taglen > maxsize) {
-                av_log(pls->ctx, AV_LOG_ERROR, "Too large HLS ID3 tag (%d > %"PRId64" bytes)\n",
-                       taglen, maxsize);
-                break;
-            }
-
-            /*
-             * Copy the id3 tag to our temporary id3 buffer.
-             * We could read a small id3 tag directly without memcpy, but
-             * we would still need to copy the large tags, and handling
-             * both of those cases together with the possibility for multiple
-             * tags would make the handling a bit complex.
-             */
-            pls->id3_buf = av_fast_realloc(pls->id3_buf, &pls->id3_buf_size, id3_buf_pos + taglen);
-            if (!pls->id3_buf)
-                break;
-            memcpy(pls->id3_buf + id3_buf_pos, buf, tag_got_bytes);
-            id3_buf_pos += tag_got_bytes;
-
-            /* strip the intercepted bytes */
-            *len -= tag_got_bytes;
-            memmove(buf, buf + tag_got_bytes, *len);
-            av_log(pls->ctx, AV_LOG_DEBUG, "Stripped %d HLS ID3 bytes\n", tag_got_bytes);
-
-            if (remaining > 0) {
-                /* read the rest of the tag in */
-                if (read_from_url(pls, seg, pls->id3_buf + id3_buf_pos, remaining, READ_COMPLETE) != remaining)
-                    break;
-                id3_buf_pos += remaining;
-                av_log(pls->ctx, AV_LOG_DEBUG, "Stripped additional %d HLS ID3 bytes\n", remaining);
-            }
+        taglen = ff_id3v2_tag_len(header);
+        if (taglen > maxsize) {
+            av_log(pls->ctx, AV_LOG_ERROR, "Too large HLS ID3 tag (%d > %"PRId64" bytes)\n",
+                   taglen, maxsize);
+            break;
+        }
+        id3_buf = av_fast_realloc(pls->id3_buf, &pls->id3_buf_size, id3_buf_pos + taglen);
+        if (!id3_buf)
+            break;
+        pls->id3_buf = id3_buf;
+        memcpy(pls->id3_buf + id3_buf_pos, header, sizeof(header));
 
-        } else {
-            /* no more ID3 tags */
+        /* read the rest of the tag in */
+        bytes = taglen - sizeof(header);
+        if (read_from_url(pls, seg, pls->id3_buf + id3_buf_pos + sizeof(header), bytes, READ_COMPLETE) != bytes) {
+            len = 0;
             break;
         }
+        id3_buf_pos += taglen;
+        av_log(pls->ctx, AV_LOG_DEBUG, "Stripped %d HLS ID3 bytes\n", taglen);
     }
 
-    /* re-fill buffer for the caller unless EOF */
-    if (*len >= 0 && (fill_buf || *len == 0)) {
-        bytes = read_from_url(pls, seg, buf + *len, buf_size - *len, READ_NORMAL);
-
-        /* ignore error if we already had some data */
-        if (bytes >= 0)
-            *len += bytes;
-        else if (*len == 0)
-            *len = bytes;
+    if (len > 0) {
+        memcpy(buf, header, len);
+        /* fill the caller buffer unless EOF */
+        if (len == sizeof(header)) {
+            bytes = read_from_url(pls, seg, buf + len, buf_size - len, READ_NORMAL);
+            /* ignore error if we already had some data */
+            if (bytes > 0)
+                len += bytes;
+        }
     }
 
     if (pls->id3_buf) {
@@ -1090,64 +1787,185 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
 
     if (pls->is_id3_timestamped == -1)
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
+
+    return len;
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+static int playlist_is_audio_rendition(struct playlist *pls)
 {
-    AVDictionary *opts = NULL;
-    int ret;
-    int is_http = 0;
+    return pls->n_renditions == 1 && pls->renditions[0]->playlist == pls &&
+           pls->renditions[0]->type == AVMEDIA_TYPE_AUDIO;
+}
 
+static void set_segment_options(HLSContext *c, struct segment *seg, int64_t skip,
+                                AVDictionary **opts)
+{
     // broker prior HTTP options that should be consistent across requests
-    av_dict_set(&opts, "user_agent", c->user_agent, 0);
-    av_dict_set(&opts, "cookies", c->cookies, 0);
-    av_dict_set(&opts, "headers", c->headers, 0);
-    av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
-    av_dict_set(&opts, "seekable", "0", 0);
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+    av_dict_set(opts, "seekable", "0", 0);
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
          * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        av_dict_set_int(opts, "offset", seg->url_offset + skip, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
+    } else if (seg->url_offset + skip) {
+        /* open ended, e.g. a preload hint or a segment entered at a key frame */
+        av_dict_set_int(opts, "offset", seg->url_offset + skip, 0);
+    }
+}
+
+/*
+ * With disk_cache set, unencrypted http segments are opened as
+ * "cache:<url>" so the persistent disk cache serves them on a replay.
+ * The cache protocol handles the offset and end_offset of byte ranges.
+ */
+static const char *segment_url(HLSContext *c, struct segment *seg,
+                               char *buf, int size, AVDictionary **opts)
+{
+    if (!c->disk_cache || seg->key_type != KEY_NONE ||
+        !(av_strstart(seg->url, "http://", NULL) || av_strstart(seg->url, "https://", NULL)))
+        return seg->url;
+
+    snprintf(buf, size, "cache:%s", seg->url);
+    av_dict_set(opts, "disk_cache", "1", 0);
+    if (c->disk_cache_dir) {
+        av_dict_set(opts, "disk_cache_dir", c->disk_cache_dir, 0);
+        av_dict_set_int(opts, "disk_cache_max_size", c->disk_cache_max_size, 0);
+    }
+    return buf;
+}
+
+static int app_key(HLSContext *c, const char *url, uint8_t *key)
+{
+    AVAppHLSKey control = { 0 };
+
+    control.size = sizeof(control);
+    av_strlcpy(control.url, url, sizeof(control.url));
+    if (av_application_on_hls_key(c->app_ctx, &control) < 0 || !control.is_handled)
+        return 0;
+    memcpy(key, control.key, sizeof(control.key));
+    return 1;
+}
+
+/* the fetch of url started by prefetch_keys(), removed from the list */
+static HLSFetch *take_key_fetch(HLSContext *c, const char *url)
+{
+    HLSFetch *fetch = NULL;
+    int i;
+
+    for (i = 0; i < MAX_KEY_FETCHES; i++) {
+        if (c->key_fetches[i] && !strcmp(ff_hls_fetch_url(c->key_fetches[i]), url)) {
+            FFSWAP(HLSFetch *, fetch, c->key_fetches[i]);
+            break;
+        }
+    }
+    return fetch;
+}
+
+/*
+ * The 16 bytes of the key at url: from the application, from the keys of
+ * the process, from the fetch prefetch_keys() started or fetched now, in
+ * that order.
+ */
+static int load_key(HLSContext *c, struct playlist *pls, const char *url, uint8_t *key)
+{
+    HLSFetch *fetch;
+    AVIOContext *pb;
+    int ret;
+
+    if (app_key(c, url, key))
+        return 0;
+    if (c->key_cache_lifetime && ff_hls_fetch_lookup_key(url, key, c->key_cache_lifetime))
+        return 0;
+
+    if ((fetch = take_key_fetch(c, url))) {
+        demux_unlock(c);
+        ret = ff_hls_fetch_wait(fetch, &pb);
+        demux_lock(c);
+        if (ret >= 0)
+            ret = avio_read(pb, key, 16);
+        ff_hls_fetch_freep(&fetch);
+    } else {
+        AVDictionary *opts = NULL;
+        // small and waited for, like a playlist
+        playlist_options(c, &opts);
+        ret = open_url(pls->parent, &pb, url, 0, c->avio_opts, opts, NULL);
+        av_dict_free(&opts);
+        if (ret >= 0) {
+            ret = avio_read(pb, key, 16);
+            ff_format_io_close(pls->parent, &pb);
+        }
     }
+    if (ret < 0)
+        return ret;
+    if (ret != 16)
+        return AVERROR_INVALIDDATA;
+
+    if (c->key_cache_lifetime)
+        ff_hls_fetch_store_key(url, key);
+    return 0;
+}
+
+/* the url of an AES-128 segment for the crypto protocol, and its options */
+static void crypto_url(struct segment *seg, const uint8_t *key,
+                       char *url, int url_size, AVDictionary **opts)
+{
+    char iv_hex[33], key_hex[33];
+
+    ff_data_to_hex(iv_hex, seg->iv, sizeof(seg->iv), 0);
+    ff_data_to_hex(key_hex, key, 16, 0);
+    iv_hex[32] = key_hex[32] = '\0';
+    if (strstr(seg->url, "://"))
+        snprintf(url, url_size, "crypto+%s", seg->url);
+    else
+        snprintf(url, url_size, "crypto:%s", seg->url);
+
+    av_dict_set(opts, "key", key_hex, 0);
+    av_dict_set(opts, "iv", iv_hex, 0);
+}
+
+/* skip: bytes of an unencrypted segment not to read, to start at a key frame */
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, int64_t skip)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+    int is_http = 0;
+
+    if (seg->key_type != KEY_NONE)
+        skip = 0;
+    set_segment_options(c, seg, skip, &opts);
+    av_dict_set_int(&opts, "http2_weight",
+                    playlist_is_audio_rendition(pls) ? H2_WEIGHT_AUDIO : H2_WEIGHT_MEDIA, 0);
 
     av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
-           seg->url, seg->url_offset, pls->index);
+           seg->url, seg->url_offset + skip, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, &pls->input, seg->url, c->avio_opts, opts, &is_http);
+        char cache_url[MAX_URL_SIZE];
+        const char *url = segment_url(c, seg, cache_url, sizeof(cache_url), &opts);
+        /* Unbuffered: the reads of read_data() go from the protocol straight
+         * into the buffer of pls->pb, which the subdemuxer parses in place */
+        ret = open_url(pls->parent, &pls->input, url, AVIO_FLAG_DIRECT, c->avio_opts, opts, &is_http);
+        if (url != seg->url)
+            is_http = 1;
     } else if (seg->key_type == KEY_AES_128) {
         AVDictionary *opts2 = NULL;
-        char iv[33], key[33], url[MAX_URL_SIZE];
+        char url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
-            AVIOContext *pb;
-            if (open_url(pls->parent, &pb, seg->key, c->avio_opts, opts, NULL) == 0) {
-                ret = avio_read(pb, pls->key, sizeof(pls->key));
-                if (ret != sizeof(pls->key)) {
-                    av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
-                           seg->key);
-                }
-                ff_format_io_close(pls->parent, &pb);
-            } else {
-                av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
-                       seg->key);
+            if ((ret = load_key(c, pls, seg->key, pls->key)) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Unable to load key file %s: %s\n",
+                       seg->key, av_err2str(ret));
             }
             av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
         }
-        ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
-        iv[32] = key[32] = '\0';
-        if (strstr(seg->url, "://"))
-            snprintf(url, sizeof(url), "crypto+%s", seg->url);
-        else
-            snprintf(url, sizeof(url), "crypto:%s", seg->url);
-
         av_dict_copy(&opts2, c->avio_opts, 0);
-        av_dict_set(&opts2, "key", key, 0);
-        av_dict_set(&opts2, "iv", iv, 0);
+        crypto_url(seg, pls->key, url, sizeof(url), &opts2);
 
-        ret = open_url(pls->parent, &pls->input, url, opts2, opts, &is_http);
+        ret = open_url(pls->parent, &pls->input, url, 0, opts2, opts, &is_http);
 
         av_dict_free(&opts2);
 
@@ -1173,10 +1991,10 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
      * as would be expected. Wrong offset received from the server will not be
      * noticed without the call, though.
      */
-    if (ret == 0 && !is_http && seg->key_type == KEY_NONE && seg->url_offset) {
-        int64_t seekret = avio_seek(pls->input, seg->url_offset, SEEK_SET);
+    if (ret == 0 && !is_http && seg->key_type == KEY_NONE && seg->url_offset + skip) {
+        int64_t seekret = avio_seek(pls->input, seg->url_offset + skip, SEEK_SET);
         if (seekret < 0) {
-            av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", seg->url_offset, seg->url);
+            av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", seg->url_offset + skip, seg->url);
             ret = seekret;
             ff_format_io_close(pls->parent, &pls->input);
         }
@@ -1184,7 +2002,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
 
 cleanup:
     av_dict_free(&opts);
-    pls->cur_seg_offset = 0;
+    pls->cur_seg_offset = skip;
     return ret;
 }
 
@@ -1204,7 +2022,7 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     if (!seg->init_section)
         return 0;
 
-    ret = open_input(c, pls, seg->init_section);
+    ret = open_input(c, pls, seg->init_section, 0);
     if (ret < 0) {
         av_log(pls->parent, AV_LOG_WARNING,
                "Failed to open an initialization section in playlist %d\n",
@@ -1245,6 +2063,313 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
+/* end of the segments downloaded in a row from the one being read, from
+ * the start of the playlist */
+static int64_t playlist_download_end(struct playlist *pls)
+{
+    int last = pls->cur_seq_no;
+
+    if (pls->prefetch)
+        last = FFMAX(last, ff_hls_prefetch_done_until(pls->prefetch, pls->cur_seq_no + 1));
+    last = FFMIN(last - pls->start_seq_no, pls->n_segments - 1);
+    if (last < 0)
+        return 0;
+    return pls->segments[last]->start_time + pls->segments[last]->duration;
+}
+
+/*
+ * The segments of a playlist read along with audio renditions may only be
+ * prefetched if they start audio_lead before the downloaded end of each of
+ * them, and not at all while the player runs short of audio with plenty of
+ * video: a starved audio stalls playback whatever video is buffered.
+ */
+static int64_t prefetch_limit(HLSContext *c, struct playlist *pls)
+{
+    AVAppBufferLevel level = { 0 };
+    int64_t limit = INT64_MAX;
+    int i;
+
+    if (!c->audio_lead || playlist_is_audio_rendition(pls))
+        return INT64_MAX;
+
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *audio = c->playlists[i];
+        if (audio != pls && audio->needed && playlist_is_audio_rendition(audio))
+            limit = FFMIN(limit, playlist_download_end(audio) - c->audio_lead);
+    }
+    if (limit == INT64_MAX)
+        return INT64_MAX;
+
+    level.size                        = sizeof(level);
+    level.cached_duration_milli       = -1;
+    level.audio_cached_duration_milli = -1;
+    level.video_cached_duration_milli = -1;
+    av_application_on_buffer_level(c->app_ctx, &level);
+    if (level.audio_cached_duration_milli >= 0 &&
+        level.audio_cached_duration_milli * 1000 < c->audio_lead &&
+        level.video_cached_duration_milli * 1000 >= c->audio_lead)
+        return INT64_MIN;
+    return limit;
+}
+
+static int alloc_prefetch(HLSContext *c, struct playlist *pls, int nb_workers)
+{
+    int ret = ff_hls_prefetch_alloc(&pls->prefetch, nb_workers, c->prefetch_max_size,
+                                    c->interrupt_callback,
+                                    c->ctx->protocol_whitelist, c->ctx->protocol_blacklist,
+                                    pls->parent);
+    if (ret < 0)
+        av_log(pls->parent, AV_LOG_WARNING, "Segment prefetch unavailable: %s\n", av_err2str(ret));
+    return ret;
+}
+
+/* the key of an AES-128 segment if it is at hand, without a request */
+static int segment_key(HLSContext *c, struct playlist *pls, struct segment *seg, uint8_t *key)
+{
+    if (!strcmp(seg->key, pls->key_url)) {
+        memcpy(key, pls->key, sizeof(pls->key));
+        return 1;
+    }
+    return c->key_cache_lifetime && ff_hls_fetch_lookup_key(seg->key, key, c->key_cache_lifetime);
+}
+
+/*
+ * Fetch the keys of the AES-128 segments ahead that are not at hand yet,
+ * so that the segment whose key changes does not wait for it, and so
+ * that schedule_segment() can queue it once the key is in.
+ */
+static void prefetch_keys(HLSContext *c, struct playlist *pls)
+{
+    int seq_no, last_seq_no, i, j;
+    uint8_t key[16];
+
+    last_seq_no = FFMIN(pls->cur_seq_no + FFMAX(c->prefetch_segments, KEY_PREFETCH_SEGMENTS),
+                        pls->start_seq_no + pls->n_segments - 1);
+    for (seq_no = FFMAX(pls->cur_seq_no + 1, pls->start_seq_no); seq_no <= last_seq_no; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        AVDictionary *opts = NULL;
+
+        if (seg->key_type != KEY_AES_128 ||
+            !(av_strstart(seg->key, "http://", NULL) || av_strstart(seg->key, "https://", NULL)))
+            continue;
+        for (j = 0; j < MAX_KEY_FETCHES; j++)
+            if (c->key_fetches[j] && !strcmp(ff_hls_fetch_url(c->key_fetches[j]), seg->key))
+                break;
+        if (j < MAX_KEY_FETCHES || segment_key(c, pls, seg, key) || app_key(c, seg->key, key))
+            continue;
+
+        // the oldest one goes
+        i = c->key_fetch_next;
+        c->key_fetch_next = (i + 1) % MAX_KEY_FETCHES;
+        ff_hls_fetch_freep(&c->key_fetches[i]);
+        playlist_options(c, &opts);
+        if (ff_hls_fetch_start(&c->key_fetches[i], seg->key, opts, c->interrupt_callback,
+                               c->ctx->protocol_whitelist, c->ctx->protocol_blacklist) < 0)
+            ff_hls_fetch_freep(&c->key_fetches[i]);
+        av_dict_free(&opts);
+    }
+}
+
+/* Queue seq_no, unless it cannot be downloaded ahead. An AES-128 segment
+ * can once its key is at hand, see prefetch_keys(). */
+static int schedule_segment(HLSContext *c, struct playlist *pls, int seq_no)
+{
+    struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+    const char *proto_name = avio_find_protocol_name(seg->url);
+    AVDictionary *opts = NULL;
+    char cache_url[MAX_URL_SIZE], url[MAX_URL_SIZE];
+    const char *seg_url;
+    uint8_t key[16];
+    int is_http, ret;
+
+    if (seg->key_type == KEY_SAMPLE_AES ||
+        (seg->key_type == KEY_AES_128 && !segment_key(c, pls, seg, key)))
+        return AVERROR(ENOSYS);
+    // same rule as open_url(), an explicit protocol prefix only
+    if (!proto_name || strncmp(proto_name, seg->url, strlen(proto_name)) ||
+        seg->url[strlen(proto_name)] != ':')
+        return AVERROR(ENOSYS);
+    is_http = av_strstart(proto_name, "http", NULL);
+    // a byte range can only be bounded by http, elsewhere the rest of the file would be read;
+    // a decrypted one cannot be seeked into either
+    if (!is_http && (seg->size >= 0 || seg->key_type != KEY_NONE))
+        return AVERROR(ENOSYS);
+
+    av_dict_copy(&opts, c->avio_opts, 0);
+    set_segment_options(c, seg, 0, &opts);
+    av_dict_set(&opts, "seekable", "1", 0);
+    av_dict_set_int(&opts, "http2_weight", H2_WEIGHT_PREFETCH, 0);
+    if (seg->key_type == KEY_AES_128) {
+        crypto_url(seg, key, url, sizeof(url), &opts);
+        seg_url = url;
+    } else {
+        seg_url = segment_url(c, seg, cache_url, sizeof(cache_url), &opts);
+    }
+    ret = ff_hls_prefetch_schedule(pls->prefetch, seq_no, seg_url,
+                                   is_http ? 0 : seg->url_offset, opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/*
+ * Queue the prefetch_segments segments after cur_seq_no and drop the ones
+ * no longer ahead of it. A segment that cannot be downloaded ahead stops
+ * the queue.
+ */
+static void schedule_prefetch(HLSContext *c, struct playlist *pls)
+{
+    int seq_no, last_seq_no, i;
+    int64_t limit;
+
+    if (c->prefetch_segments <= 0)
+        return;
+
+    if (!pls->prefetch && alloc_prefetch(c, pls, c->prefetch_segments) < 0) {
+        c->prefetch_segments = 0;
+        return;
+    }
+
+    last_seq_no = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                        pls->start_seq_no + pls->n_segments - 1);
+    ff_hls_prefetch_cancel_outside(pls->prefetch, pls->cur_seq_no, last_seq_no);
+
+    // the downloads already running go on, only the new ones wait for audio
+    limit = prefetch_limit(c, pls);
+    for (seq_no = FFMAX(pls->cur_seq_no + 1, pls->start_seq_no); seq_no <= last_seq_no; seq_no++) {
+        if (pls->segments[seq_no - pls->start_seq_no]->start_time >= limit ||
+            schedule_segment(c, pls, seq_no) < 0)
+            break;
+    }
+
+    // audio got further, the playlists waiting for it may go on
+    if (playlist_is_audio_rendition(pls)) {
+        for (i = 0; i < c->n_playlists; i++) {
+            struct playlist *other = c->playlists[i];
+            if (other->needed && other->prefetch && !playlist_is_audio_rendition(other))
+                schedule_prefetch(c, other);
+        }
+    }
+}
+
+static void stop_prefetch(struct playlist *pls)
+{
+    if (!pls->prefetch)
+        return;
+    ff_hls_prefetch_release(pls->prefetch, &pls->prefetch_seg);
+    ff_hls_prefetch_cancel_outside(pls->prefetch, INT_MAX, INT_MIN);
+}
+
+static struct variant *variant_of_playlist(HLSContext *c, struct playlist *pls)
+{
+    int i;
+    for (i = 0; i < c->n_variants; i++) {
+        if (c->variants[i]->playlists[0] == pls)
+            return c->variants[i];
+    }
+    return NULL;
+}
+
+static void abr_add_sample(HLSContext *c, const char *url, int64_t bytes, int64_t elapsed)
+{
+    ff_throughput_add_sample(url, bytes, elapsed);
+    ff_hls_abr_add_sample(&c->abr_estimate, bytes, elapsed);
+}
+
+static int abr_init_variants(HLSContext *c)
+{
+    int i;
+
+    c->abr_variants = av_malloc_array(c->n_variants, sizeof(*c->abr_variants));
+    if (!c->abr_variants)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < c->n_variants; i++) {
+        c->abr_variants[i].bandwidth  = c->variants[i]->bandwidth;
+        c->abr_variants[i].audio_only = c->variants[i]->audio_only;
+    }
+    return 0;
+}
+
+/*
+ * The variant a session starts with, from what the other sessions of the
+ * process measured to the same host, see ff_hls_abr_initial_variant().
+ */
+static struct playlist *abr_initial_playlist(HLSContext *c, AVFormatContext *s)
+{
+    ThroughputEstimate estimate = { 0 };
+    AVAppBufferLevel   level = { 0 };
+    struct variant    *pick;
+
+    if (c->shared_estimate && av_throughput_get_estimate(c->variants[0]->playlists[0]->url, &estimate) < 0)
+        estimate.bandwidth = 0;
+    if (estimate.bandwidth) {
+        level.size                  = sizeof(level);
+        level.cached_duration_milli = -1;
+        av_application_on_buffer_level(c->app_ctx, &level);
+    }
+
+    pick = c->variants[ff_hls_abr_initial_variant(&c->abr_policy, &c->abr_estimate, c->abr_variants,
+                                                  c->n_variants, estimate.bandwidth, level.max_bitrate)];
+    if (c->abr_estimate.slow_bandwidth)
+        av_log(s, AV_LOG_INFO, "ABR: starting at %d bps, estimate %"PRId64" bps from %"PRId64" ms ago\n",
+               pick->bandwidth, estimate.bandwidth, estimate.age / 1000);
+    return pick->playlists[0];
+}
+
+/*
+ * Parallel downloads split the link: each segment prefetched on top of the
+ * one read needs another bitrate of the variant worth of the estimate.
+ */
+static void seed_prefetch_segments(HLSContext *c, struct variant *var)
+{
+    ThroughputEstimate estimate;
+    int64_t            headroom;
+
+    if (!c->shared_estimate || c->prefetch_segments <= 1 || !var || var->bandwidth <= 0 ||
+        av_throughput_get_estimate(var->playlists[0]->url, &estimate) < 0 || !estimate.bandwidth)
+        return;
+
+    headroom = estimate.bandwidth / var->bandwidth;
+    c->prefetch_segments = FFMAX(FFMIN(headroom - 1, c->prefetch_segments), 1);
+}
+
+/*
+ * Called at a segment boundary of the variant being read, see
+ * ff_hls_abr_check_switch() for the decision.
+ */
+static void abr_check_switch(HLSContext *c, struct playlist *pls)
+{
+    struct variant  *cur = variant_of_playlist(c, pls), *next;
+    AVAppBufferLevel level = { 0 };
+    int64_t estimate = 0;
+    int i;
+
+    if (!cur || !c->abr_estimate.fast_bandwidth ||
+        (pls->finished && pls->cur_seq_no >= pls->start_seq_no + pls->n_segments))
+        return;
+
+    level.size                  = sizeof(level);
+    level.cached_duration_milli = -1;
+    av_application_on_buffer_level(c->app_ctx, &level);
+
+    for (i = 0; c->variants[i] != cur; i++)
+        ;
+    i = ff_hls_abr_check_switch(&c->abr_policy, &c->abr_estimate, c->abr_variants, c->n_variants, i,
+                                &level, &estimate);
+    if (i < 0)
+        return;
+    next = c->variants[i];
+
+    av_log(pls->parent, AV_LOG_INFO, "ABR: switching from %d to %d bps%s at segment %d, "
+           "estimate %"PRId64" bps, buffered %"PRId64" ms\n",
+           cur->bandwidth, next->bandwidth, next->audio_only ? " audio only" : "",
+           pls->cur_seq_no, estimate, level.cached_duration_milli);
+
+    c->abr_next           = next->playlists[0];
+    c->abr_switch_seq_no  = pls->cur_seq_no;
+    c->abr_buffered_milli = level.cached_duration_milli;
+    stop_prefetch(pls);
+}
+
 static int64_t default_reload_interval(struct playlist *pls)
 {
     return pls->n_segments > 0 ?
@@ -1252,6 +2377,125 @@ static int64_t default_reload_interval(struct playlist *pls)
                           pls->target_duration;
 }
 
+/*
+ * Reload a live playlist. With msn >= 0 and a server that can block, the
+ * response waits until segment msn, or its part if part >= 0, is listed;
+ * a delta update is asked for while the known segments are recent enough.
+ */
+static int reload_playlist(HLSContext *c, struct playlist *pls, int msn, int part)
+{
+    char url[MAX_URL_SIZE];
+    const char *sep = strchr(pls->url, '?') ? "&" : "?";
+    int skip, ret;
+
+    skip = c->low_latency && pls->can_skip_until > 0 && !pls->skip_failed &&
+           pls->n_segments &&
+           av_gettime_relative() - pls->last_load_time < pls->can_skip_until / 2;
+    if (!c->low_latency || !pls->can_block_reload)
+        msn = -1;
+    if (msn < 0 && !skip)
+        return parse_playlist(c, pls->url, pls, NULL);
+
+    av_strlcpy(url, pls->url, sizeof(url));
+    if (msn >= 0) {
+        av_strlcatf(url, sizeof(url), "%s_HLS_msn=%d", sep, msn);
+        if (part >= 0)
+            av_strlcatf(url, sizeof(url), "&_HLS_part=%d", part);
+        sep = "&";
+    }
+    if (skip)
+        av_strlcatf(url, sizeof(url), "%s_HLS_skip=YES", sep);
+
+    ret = parse_playlist(c, url, pls, NULL);
+    if (ret == AVERROR_INVALIDDATA && skip) {
+        pls->skip_failed = 1;
+        return reload_playlist(c, pls, msn, part);
+    }
+    return ret;
+}
+
+/* the part to read next, NULL to read cur_seq_no as a whole segment */
+static struct part *select_part(HLSContext *c, struct playlist *pls)
+{
+    struct part *part;
+
+    for (;;) {
+        int complete = pls->cur_seq_no < pls->start_seq_no + pls->n_segments;
+
+        if (!c->low_latency || (!pls->cur_part && complete))
+            return NULL;
+        part = find_part(pls, pls->cur_seq_no, pls->cur_part);
+        if (part && part->gap) {
+            pls->cur_part++;
+            continue;
+        }
+        if (part || !complete)
+            return part;
+        /* every listed part of the segment was read */
+        pls->cur_seq_no++;
+        pls->cur_part = 0;
+    }
+}
+
+/* start a low latency stream PART-HOLD-BACK from its end, at an
+ * independent part */
+static void select_cur_part(HLSContext *c, struct playlist *pls)
+{
+    int64_t hold_back, duration = 0;
+    int i;
+
+    pls->cur_part = 0;
+    if (!c->low_latency || pls->finished || !pls->n_parts)
+        return;
+
+    hold_back = pls->part_hold_back > 0 ? pls->part_hold_back : 3 * pls->part_target;
+    for (i = pls->n_parts - 1; i >= 0; i--) {
+        struct part *part = pls->parts[i];
+        if (part->is_hint)
+            continue;
+        duration += part->seg.duration;
+        if (duration >= hold_back && (part->independent || !part->index)) {
+            pls->cur_seq_no = part->seq_no;
+            pls->cur_part   = part->index;
+            return;
+        }
+    }
+}
+
+static void add_segment_start(struct playlist *pls)
+{
+    struct segment_start *start = &pls->seg_starts[pls->n_seg_starts++ % MAX_SEGMENT_STARTS];
+
+    start->seq_no = pls->cur_seq_no;
+    start->pos    = pls->pb.pos;
+    start->offset = pls->cur_seg_offset;
+}
+
+/* note where an input of another discontinuity sequence than the last
+ * one starts, for rebase_timestamps() */
+static void add_discontinuity(HLSContext *c, struct playlist *pls,
+                              const struct segment *seg, int is_part, int64_t skip)
+{
+    int i;
+
+    if (seg->disc_seq == pls->disc_seq)
+        return;
+    pls->disc_seq      = seg->disc_seq;
+    pls->disc_next_seq = seg->disc_seq;
+    pls->disc_next_pos = pls->pb.pos;
+    pls->disc_next_ts  = AV_NOPTS_VALUE;
+
+    if (is_part)
+        return;
+    if (skip) {
+        for (i = 0; i < seg->n_keyframes; i++)
+            if (seg->keyframes[i].offset == skip)
+                pls->disc_next_ts = seg->keyframes[i].timestamp;
+    } else if (c->first_timestamp != AV_NOPTS_VALUE) {
+        pls->disc_next_ts = c->first_timestamp + seg->start_time;
+    }
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1260,12 +2504,21 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     int just_opened = 0;
 
 restart:
+    if (c->demux_abort)
+        return AVERROR_EXIT;
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    // let the demuxer drain before switching variants
+    if (c->abr_next && v == c->abr_playlist)
+        return AVERROR_EOF;
+
+    if (!v->input && !v->prefetch_seg) {
         int64_t reload_interval;
         struct segment *seg;
+        struct part *part;
+        int blocked = 0;
+        int64_t skip;
 
         /* Check that the playlist is still needed before opening a new
          * segment. */
@@ -1281,6 +2534,7 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            stop_prefetch(v);
             return AVERROR_EOF;
         }
 
@@ -1291,50 +2545,99 @@ restart:
 reload:
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+            if ((ret = reload_playlist(c, v, -1, -1)) < 0) {
                 av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                        v->index);
                 return ret;
             }
             /* If we need to reload the playlist again below (if
              * there's still no more segments), switch to a reload
-             * interval of half the target duration. */
-            reload_interval = v->target_duration / 2;
+             * interval of half the target duration, or of a part. */
+            reload_interval = c->low_latency && v->part_target > 0 ?
+                              v->part_target : v->target_duration / 2;
         }
+select:
         if (v->cur_seq_no < v->start_seq_no) {
             av_log(NULL, AV_LOG_WARNING,
                    "skipping %d segments ahead, expired from playlists\n",
                    v->start_seq_no - v->cur_seq_no);
             v->cur_seq_no = v->start_seq_no;
+            v->cur_part   = 0;
         }
-        if (v->cur_seq_no >= v->start_seq_no + v->n_segments) {
+        part = select_part(c, v);
+        if (!part && v->cur_seq_no >= v->start_seq_no + v->n_segments) {
             if (v->finished)
                 return AVERROR_EOF;
+            if (c->low_latency && v->can_block_reload && !blocked) {
+                /* the server answers once the segment or part is there */
+                blocked = 1;
+                ret = reload_playlist(c, v, v->cur_seq_no, v->n_parts ? v->cur_part : -1);
+                if (ret < 0) {
+                    av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+                           v->index);
+                    return ret;
+                }
+                goto select;
+            }
+            blocked = 0;
             while (av_gettime_relative() - v->last_load_time < reload_interval) {
                 if (ff_check_interrupt(c->interrupt_callback))
                     return AVERROR_EXIT;
+                demux_unlock(c);
                 av_usleep(100*1000);
+                demux_lock(c);
+                if (c->demux_abort)
+                    return AVERROR_EXIT;
             }
             /* Enough time has elapsed since the last reload */
             goto reload;
         }
 
-        seg = current_segment(v);
+        // let the demuxer drain before switching variants
+        if (c->abr_next && v == c->abr_playlist)
+            return AVERROR_EOF;
+
+        seg = part ? &part->seg : current_segment(v);
+        /* only the segment the seek found is entered at a key frame */
+        skip = part || seg->init_section ? 0 : v->seek_seg_offset;
+        v->seek_seg_offset = 0;
 
         /* load/update Media Initialization Section, if any */
         ret = update_init_section(v, seg);
         if (ret)
             return ret;
 
-        ret = open_input(c, v, seg);
-        if (ret < 0) {
-            if (ff_check_interrupt(c->interrupt_callback))
-                return AVERROR_EXIT;
-            av_log(v->parent, AV_LOG_WARNING, "Failed to open segment of playlist %d\n",
-                   v->index);
-            v->cur_seq_no += 1;
-            goto reload;
+        if (v->prefetch && !part)
+            v->prefetch_seg = ff_hls_prefetch_take(v->prefetch, v->cur_seq_no);
+        if (v->prefetch_seg) {
+            av_log(v->parent, AV_LOG_VERBOSE, "HLS prefetched segment %d, playlist %d\n",
+                   v->cur_seq_no, v->index);
+            v->cur_seg_offset = 0;
+        } else {
+            int64_t start = av_gettime_relative();
+            v->download_bytes = 0;
+            ret = open_input(c, v, seg, skip);
+            v->download_time = av_gettime_relative() - start;
+            if (ret < 0) {
+                if (ff_check_interrupt(c->interrupt_callback))
+                    return AVERROR_EXIT;
+                av_log(v->parent, AV_LOG_WARNING, "Failed to open %s of playlist %d\n",
+                       part ? "part" : "segment", v->index);
+                if (part) {
+                    v->cur_part += 1;
+                } else {
+                    v->cur_seq_no += 1;
+                    v->cur_part    = 0;
+                }
+                goto reload;
+            }
         }
+        v->input_part = part;
+        add_discontinuity(c, v, seg, !!part, skip);
+        if (!part)
+            add_segment_start(v);
+        prefetch_keys(c, v);
+        schedule_prefetch(c, v);
         just_opened = 1;
     }
 
@@ -1346,21 +2649,42 @@ reload:
         return copy_size;
     }
 
-    ret = read_from_url(v, current_segment(v), buf, buf_size, READ_NORMAL);
-    if (ret > 0) {
-        if (just_opened && v->is_id3_timestamped != 0) {
-            /* Intercept ID3 tags here, elementary audio streams are required
-             * to convey timestamps using them in the beginning of each segment. */
-            intercept_id3(v, buf, buf_size, &ret);
-        }
-
+    if (just_opened && v->is_id3_timestamped != 0 && buf_size >= ID3v2_HEADER_SIZE)
+        ret = intercept_id3(v, v->input_part ? &v->input_part->seg : current_segment(v),
+                            buf, buf_size);
+    else
+        ret = read_from_url(v, v->input_part ? &v->input_part->seg : current_segment(v),
+                            buf, buf_size, READ_NORMAL);
+    if (ret > 0)
         return ret;
+    if (v->prefetch_seg) {
+        int64_t bytes, elapsed;
+        if (ff_hls_prefetch_get_timing(v->prefetch, v->prefetch_seg, &bytes, &elapsed) >= 0)
+            abr_add_sample(c, v->url, bytes, elapsed);
+        ff_hls_prefetch_release(v->prefetch, &v->prefetch_seg);
+        if (ret != AVERROR_EOF && !v->cur_seg_offset) {
+            // the prefetch failed before any data, try the segment again directly
+            if (ff_check_interrupt(c->interrupt_callback))
+                return AVERROR_EXIT;
+            goto restart;
+        }
+    } else if (!v->input_part) {
+        abr_add_sample(c, v->url, v->download_bytes, v->download_time);
     }
     ff_format_io_close(v->parent, &v->input);
+    if (v->input_part) {
+        v->input_part = NULL;
+        v->cur_part++;
+        goto restart;
+    }
     v->cur_seq_no++;
+    v->cur_part = 0;
 
     c->cur_seq_no = v->cur_seq_no;
 
+    if (v == c->abr_playlist)
+        abr_check_switch(c, v);
+
     goto restart;
 }
 
@@ -1489,7 +2813,8 @@ static int save_avio_options(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
     static const char *opts[] = {
-        "headers", "http_proxy", "user_agent", "user-agent", "cookies", NULL };
+        "headers", "http_proxy", "user_agent", "user-agent", "cookies", "http2", "http3",
+        "mirrors", "mirror_stall_timeout", NULL };
     const char **opt = opts;
     uint8_t *buf;
     int ret = 0;
@@ -1561,16 +2886,41 @@ static int set_stream_info_from_input_stream(AVStream *st, struct playlist *pls,
     return 0;
 }
 
+/* with abr, the n-th stream of a type of every variant is exported through
+ * the n-th stream of that type of the first variant */
+static AVStream *abr_find_main_stream(HLSContext *c, struct playlist *pls, AVStream *ist)
+{
+    struct playlist *leader = c->abr_leader;
+    enum AVMediaType type = ist->codecpar->codec_type;
+    int i, nth = 0;
+
+    for (i = 0; i < ist->index; i++)
+        nth += pls->ctx->streams[i]->codecpar->codec_type == type;
+    for (i = 0; i < leader->n_main_streams; i++) {
+        if (leader->main_streams[i]->codecpar->codec_type == type && !nth--)
+            return leader->main_streams[i];
+    }
+    return NULL;
+}
+
 /* add new subdemuxer streams to our context, if any */
 static int update_streams_from_subdemuxer(AVFormatContext *s, struct playlist *pls)
 {
+    HLSContext *c = s->priv_data;
     int err;
 
     while (pls->n_main_streams < pls->ctx->nb_streams) {
         int ist_idx = pls->n_main_streams;
-        AVStream *st = avformat_new_stream(s, NULL);
         AVStream *ist = pls->ctx->streams[ist_idx];
+        AVStream *st;
+
+        if (c->abr_leader && pls != c->abr_leader &&
+            (st = abr_find_main_stream(c, pls, ist))) {
+            dynarray_add(&pls->main_streams, &pls->n_main_streams, st);
+            continue;
+        }
 
+        st = avformat_new_stream(s, NULL);
         if (!st)
             return AVERROR(ENOMEM);
 
@@ -1608,13 +2958,258 @@ static void update_noheader_flag(AVFormatContext *s)
         s->ctx_flags &= ~AVFMTCTX_NOHEADER;
 }
 
+/* open the subdemuxer of pls, reading from its cur_seq_no */
+static int open_playlist_demuxer(AVFormatContext *s, struct playlist *pls)
+{
+    AVInputFormat *in_fmt = NULL;
+    int ret;
+
+    // left over by an earlier attempt, if any
+    av_freep(&pls->pb.buffer);
+    pls->read_buffer = av_malloc(INITIAL_BUFFER_SIZE);
+    if (!pls->read_buffer){
+        ret = AVERROR(ENOMEM);
+        avformat_free_context(pls->ctx);
+        pls->ctx = NULL;
+        return ret;
+    }
+    ffio_init_context(&pls->pb, pls->read_buffer, INITIAL_BUFFER_SIZE, 0, pls,
+                      read_data, NULL, NULL);
+    pls->pb.seekable = 0;
+    ret = av_probe_input_buffer(&pls->pb, &in_fmt, pls->segments[0]->url,
+                                NULL, 0, 0);
+    if (ret < 0) {
+        /* Free the ctx - it isn't initialized properly at this point,
+         * so avformat_close_input shouldn't be called. If
+         * avformat_open_input fails below, it frees and zeros the
+         * context, so it doesn't need any special treatment like this. */
+        av_log(s, AV_LOG_ERROR, "Error when loading first segment '%s'\n", pls->segments[0]->url);
+        avformat_free_context(pls->ctx);
+        pls->ctx = NULL;
+        return ret;
+    }
+    pls->ctx->pb       = &pls->pb;
+    pls->ctx->io_open  = nested_io_open;
+    pls->ctx->flags   |= s->flags;
+
+    if ((ret = ff_copy_whiteblacklists(pls->ctx, s)) < 0)
+        return ret;
+
+    ret = avformat_open_input(&pls->ctx, pls->segments[0]->url, in_fmt, NULL);
+    if (ret < 0)
+        return ret;
+
+    if (pls->id3_deferred_extra && pls->ctx->nb_streams == 1) {
+        ff_id3v2_parse_apic(pls->ctx, &pls->id3_deferred_extra);
+        avformat_queue_attached_pictures(pls->ctx);
+        ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
+        pls->id3_deferred_extra = NULL;
+    }
+
+    if (pls->is_id3_timestamped == -1)
+        av_log(s, AV_LOG_WARNING, "No expected HTTP requests have been made\n");
+
+    /*
+     * For ID3 timestamped raw audio streams we need to detect the packet
+     * durations to calculate timestamps in fill_timing_for_id3_timestamped_stream(),
+     * but for other streams we can rely on our user calling avformat_find_stream_info()
+     * on us if they want to.
+     */
+    if (pls->is_id3_timestamped) {
+        ret = avformat_find_stream_info(pls->ctx, NULL);
+        if (ret < 0)
+            return ret;
+    }
+
+    pls->has_noheader_flag = !!(pls->ctx->ctx_flags & AVFMTCTX_NOHEADER);
+
+    /* Create new AVStreams for each stream in this playlist */
+    ret = update_streams_from_subdemuxer(s, pls);
+    if (ret < 0)
+        return ret;
+
+    add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_AUDIO);
+    add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_VIDEO);
+    add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_SUBTITLE);
+
+    return 0;
+}
+
+static int playlist_in_variant(struct variant *var, struct playlist *pls)
+{
+    int i;
+    for (i = 0; i < var->n_playlists; i++) {
+        if (var->playlists[i] == pls)
+            return 1;
+    }
+    return 0;
+}
+
+/* parse the download of pls, or load it if it has none */
+static int load_media_playlist(HLSContext *c, struct playlist *pls, HLSFetch *fetch)
+{
+    AVIOContext *in;
+    const char *location;
+    int ret;
+
+    if (!fetch)
+        return parse_playlist(c, pls->url, pls, NULL);
+
+    if ((ret = ff_hls_fetch_wait(fetch, &in)) < 0)
+        return ret;
+    // relative urls resolve against the playlist the redirects ended at
+    location = ff_hls_fetch_get(fetch, "location");
+    ret = parse_playlist(c, location ? location : pls->url, pls, in);
+    if (ret < 0)
+        return ret;
+    av_freep(&pls->etag);
+    av_freep(&pls->last_modified);
+    if ((ff_hls_fetch_get(fetch, "etag") &&
+         !(pls->etag = av_strdup(ff_hls_fetch_get(fetch, "etag")))) ||
+        (ff_hls_fetch_get(fetch, "last_modified") &&
+         !(pls->last_modified = av_strdup(ff_hls_fetch_get(fetch, "last_modified")))))
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/* download the first segment of pls while the other playlists load */
+static void start_first_segment(HLSContext *c, struct playlist *pls)
+{
+    if (!pls->n_segments)
+        return;
+
+    pls->cur_seq_no = select_cur_seq_no(c, pls);
+    select_cur_part(c, pls);
+    // parts are read as they are published, not ahead
+    if (select_part(c, pls))
+        return;
+    if (!pls->prefetch && alloc_prefetch(c, pls, FFMAX(c->prefetch_segments, 1)) < 0)
+        return;
+    if (schedule_segment(c, pls, pls->cur_seq_no) >= 0)
+        av_log(c->ctx, AV_LOG_VERBOSE, "HLS started segment %d of %s while loading the other playlists\n",
+               pls->cur_seq_no, pls->url);
+}
+
+/*
+ * Download the media playlists of a master playlist at once instead of one
+ * after the other. The ones played first, the variant abr starts with or
+ * the playlists of the only variant, are parsed as soon as they are in and
+ * their first segment starts downloading while the others still load.
+ *
+ * speculative is the download of a playlist started before the master
+ * playlist was parsed, taken over if it is one of them.
+ */
+static int load_media_playlists(HLSContext *c, HLSFetch **speculative,
+                                struct playlist **abr_first)
+{
+    HLSFetch **fetches;
+    int ret = 0, i, pass;
+
+    fetches = av_mallocz_array(c->n_playlists, sizeof(*fetches));
+    if (!fetches)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+        AVDictionary *opts = NULL;
+
+        if (*speculative && !strcmp(ff_hls_fetch_url(*speculative), pls->url)) {
+            fetches[i]   = *speculative;
+            *speculative = NULL;
+            continue;
+        }
+        // loaded in turn without a download of its own
+        playlist_options(c, &opts);
+        ff_hls_fetch_start(&fetches[i], pls->url, opts, c->interrupt_callback,
+                           c->ctx->protocol_whitelist, c->ctx->protocol_blacklist);
+        av_dict_free(&opts);
+    }
+    ff_hls_fetch_freep(speculative);
+
+    // same conditions as in hls_read_header(), but for the segments
+    if (c->abr && c->n_variants > 1 && c->n_playlists == c->n_variants) {
+        for (i = 0; i < c->n_variants && c->variants[i]->n_playlists == 1; i++)
+            ;
+        if (i == c->n_variants && abr_init_variants(c) >= 0)
+            *abr_first = abr_initial_playlist(c, c->ctx);
+    }
+
+    for (pass = 0; pass < 2 && ret >= 0; pass++) {
+        for (i = 0; i < c->n_playlists; i++) {
+            struct playlist *pls = c->playlists[i];
+            int first = *abr_first ? pls == *abr_first :
+                        c->n_variants == 1 && playlist_in_variant(c->variants[0], pls);
+
+            if (first == pass)
+                continue;
+            if ((ret = load_media_playlist(c, pls, fetches[i])) < 0)
+                break;
+            ff_hls_fetch_freep(&fetches[i]);
+            if (first)
+                start_first_segment(c, pls);
+        }
+    }
+
+    for (i = 0; i < c->n_playlists; i++)
+        ff_hls_fetch_freep(&fetches[i]);
+    av_free(fetches);
+    return ret;
+}
+
+/* Drop the variants of the master playlist whose CODECS lists one of the
+ * "exclude_codecs", e.g. AV1 on devices too slow to decode it in software,
+ * before their media playlists are loaded. Nothing is dropped when no
+ * variant would be left. */
+static void drop_excluded_variants(HLSContext *c)
+{
+    int i, j, n = 0;
+
+    for (i = 0; i < c->n_variants; i++)
+        n += !c->variants[i]->excluded;
+    if (!n || n == c->n_variants)
+        return;
+
+    for (i = n = 0; i < c->n_variants; i++) {
+        struct variant *var = c->variants[i];
+        if (!var->excluded) {
+            c->variants[n++] = var;
+            continue;
+        }
+        av_log(c->ctx, AV_LOG_VERBOSE, "Variant %s of excluded codecs dropped\n",
+               var->playlists[0]->url);
+        /* only its main playlist is its own, the renditions are shared */
+        for (j = 0; j < c->n_playlists; j++) {
+            if (c->playlists[j] == var->playlists[0]) {
+                memmove(&c->playlists[j], &c->playlists[j + 1],
+                        (c->n_playlists - j - 1) * sizeof(*c->playlists));
+                c->n_playlists--;
+                break;
+            }
+        }
+        free_playlist(c, var->playlists[0]);
+        av_freep(&var->playlists);
+        av_free(var);
+    }
+    c->n_variants = n;
+}
+
 static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
+    int i;
 
+    // the next session fetches it before the master playlist is parsed
+    if (c->abr_playlist && c->n_variants > 1)
+        ff_hls_fetch_remember(s->filename, c->abr_playlist->url);
+
+    stop_demux(c);
+    for (i = 0; i < MAX_KEY_FETCHES; i++)
+        ff_hls_fetch_freep(&c->key_fetches[i]);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
+    free_iframe_url_list(c);
+    av_freep(&c->abr_variants);
 
     av_dict_free(&c->avio_opts);
 
@@ -1627,6 +3222,9 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
     HLSContext *c = s->priv_data;
     int ret = 0, i;
     int highest_cur_seq_no = 0;
+    HLSFetch *speculative = NULL;
+    struct playlist *abr_first = NULL;
+    char url[MAX_URL_SIZE];
 
     c->ctx                = s;
     c->interrupt_callback = &s->interrupt_callback;
@@ -1635,10 +3233,17 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
     c->first_packet = 1;
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
+    c->disc_seq = -1;
 
     if (options && *options)
         av_dict_copy(&c->avio_opts, *options, 0);
 
+    {
+        AVDictionaryEntry *e = av_dict_get(c->avio_opts, "ijkapplication", NULL, 0);
+        if (e)
+            c->app_ctx = (AVApplicationContext *)(intptr_t)strtoll(e->value, NULL, 10);
+    }
+
     if (u) {
         // get the previous user agent & set back to null if string size is zero
         update_options(&c->user_agent, "user_agent", u);
@@ -1653,6 +3258,15 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
         update_options(&c->http_proxy, "http_proxy", u);
     }
 
+    // the media playlist of the last session loads while the master is parsed
+    if (c->parallel_open && ff_hls_fetch_recall(s->filename, url, sizeof(url))) {
+        AVDictionary *opts = NULL;
+        playlist_options(c, &opts);
+        ff_hls_fetch_start(&speculative, url, opts, c->interrupt_callback,
+                           s->protocol_whitelist, s->protocol_blacklist);
+        av_dict_free(&opts);
+    }
+
     if ((ret = parse_playlist(c, s->filename, NULL, s->pb)) < 0)
         goto fail;
 
@@ -1667,15 +3281,21 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
         ret = AVERROR_EOF;
         goto fail;
     }
+    if (c->exclude_codecs)
+        drop_excluded_variants(c);
     /* If the playlist only contained playlists (Master Playlist),
      * parse each individual playlist. */
-    if (c->n_playlists > 1 || c->playlists[0]->n_segments == 0) {
+    if (c->parallel_open && (c->n_playlists > 1 || c->playlists[0]->n_segments == 0)) {
+        if ((ret = load_media_playlists(c, &speculative, &abr_first)) < 0)
+            goto fail;
+    } else if (c->n_playlists > 1 || c->playlists[0]->n_segments == 0) {
         for (i = 0; i < c->n_playlists; i++) {
             struct playlist *pls = c->playlists[i];
             if ((ret = parse_playlist(c, pls->url, pls, NULL)) < 0)
                 goto fail;
         }
     }
+    ff_hls_fetch_freep(&speculative);
 
     if (c->variants[0]->playlists[0]->n_segments == 0) {
         av_log(NULL, AV_LOG_WARNING, "Empty playlist\n");
@@ -1723,13 +3343,33 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
             continue;
 
         pls->cur_seq_no = select_cur_seq_no(c, pls);
+        select_cur_part(c, pls);
         highest_cur_seq_no = FFMAX(highest_cur_seq_no, pls->cur_seq_no);
     }
 
+    /* With abr, only the first variant is opened and exported, the others
+     * are opened when switched to. That needs every variant to be a single
+     * playlist, alternative rendition playlists are played as before. */
+    if (c->abr && c->n_variants > 1 && c->n_playlists == c->n_variants) {
+        for (i = 0; i < c->n_variants; i++) {
+            if (c->variants[i]->n_playlists != 1 || !c->variants[i]->playlists[0]->n_segments)
+                break;
+        }
+        if (i == c->n_variants && abr_first)
+            c->abr_leader = c->abr_playlist = abr_first;
+        else if (i == c->n_variants && abr_init_variants(c) >= 0)
+            c->abr_leader = c->abr_playlist = abr_initial_playlist(c, s);
+        else
+            av_log(s, AV_LOG_INFO, "ABR disabled, variants with rendition playlists\n");
+    }
+    if (c->abr_leader)
+        seed_prefetch_segments(c, variant_of_playlist(c, c->abr_leader));
+    else if (c->n_variants == 1)
+        seed_prefetch_segments(c, c->variants[0]);
+
     /* Open the demuxer for each playlist */
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
-        AVInputFormat *in_fmt = NULL;
 
         if (!(pls->ctx = avformat_alloc_context())) {
             ret = AVERROR(ENOMEM);
@@ -1743,6 +3383,12 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
         pls->needed = 1;
         pls->parent = s;
 
+        if (c->abr_leader && pls != c->abr_leader) {
+            pls->needed = 0;
+            stop_prefetch(pls);
+            continue;
+        }
+
         /*
          * If this is a live stream and this playlist looks like it is one segment
          * behind, try to sync it up so that every substream starts at the same
@@ -1753,79 +3399,23 @@ static int hls_read_header(AVFormatContext *s, AVDictionary **options)
         if (!pls->finished && pls->cur_seq_no == highest_cur_seq_no - 1 &&
             highest_cur_seq_no < pls->start_seq_no + pls->n_segments) {
             pls->cur_seq_no = highest_cur_seq_no;
+            pls->cur_part   = 0;
         }
+        // a first segment started early that is not the one to start at
+        if (pls->prefetch)
+            ff_hls_prefetch_cancel_outside(pls->prefetch, pls->cur_seq_no,
+                                           pls->cur_seq_no + c->prefetch_segments);
 
-        pls->read_buffer = av_malloc(INITIAL_BUFFER_SIZE);
-        if (!pls->read_buffer){
-            ret = AVERROR(ENOMEM);
-            avformat_free_context(pls->ctx);
-            pls->ctx = NULL;
-            goto fail;
-        }
-        ffio_init_context(&pls->pb, pls->read_buffer, INITIAL_BUFFER_SIZE, 0, pls,
-                          read_data, NULL, NULL);
-        pls->pb.seekable = 0;
-        ret = av_probe_input_buffer(&pls->pb, &in_fmt, pls->segments[0]->url,
-                                    NULL, 0, 0);
-        if (ret < 0) {
-            /* Free the ctx - it isn't initialized properly at this point,
-             * so avformat_close_input shouldn't be called. If
-             * avformat_open_input fails below, it frees and zeros the
-             * context, so it doesn't need any special treatment like this. */
-            av_log(s, AV_LOG_ERROR, "Error when loading first segment '%s'\n", pls->segments[0]->url);
-            avformat_free_context(pls->ctx);
-            pls->ctx = NULL;
-            goto fail;
-        }
-        pls->ctx->pb       = &pls->pb;
-        pls->ctx->io_open  = nested_io_open;
-        pls->ctx->flags   |= s->flags;
-
-        if ((ret = ff_copy_whiteblacklists(pls->ctx, s)) < 0)
-            goto fail;
-
-        ret = avformat_open_input(&pls->ctx, pls->segments[0]->url, in_fmt, NULL);
-        if (ret < 0)
-            goto fail;
-
-        if (pls->id3_deferred_extra && pls->ctx->nb_streams == 1) {
-            ff_id3v2_parse_apic(pls->ctx, &pls->id3_deferred_extra);
-            avformat_queue_attached_pictures(pls->ctx);
-            ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
-            pls->id3_deferred_extra = NULL;
-        }
-
-        if (pls->is_id3_timestamped == -1)
-            av_log(s, AV_LOG_WARNING, "No expected HTTP requests have been made\n");
-
-        /*
-         * For ID3 timestamped raw audio streams we need to detect the packet
-         * durations to calculate timestamps in fill_timing_for_id3_timestamped_stream(),
-         * but for other streams we can rely on our user calling avformat_find_stream_info()
-         * on us if they want to.
-         */
-        if (pls->is_id3_timestamped) {
-            ret = avformat_find_stream_info(pls->ctx, NULL);
-            if (ret < 0)
-                goto fail;
-        }
-
-        pls->has_noheader_flag = !!(pls->ctx->ctx_flags & AVFMTCTX_NOHEADER);
-
-        /* Create new AVStreams for each stream in this playlist */
-        ret = update_streams_from_subdemuxer(s, pls);
+        ret = open_playlist_demuxer(s, pls);
         if (ret < 0)
             goto fail;
-
-        add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_AUDIO);
-        add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_VIDEO);
-        add_metadata_from_renditions(s, pls, AVMEDIA_TYPE_SUBTITLE);
     }
 
     update_noheader_flag(s);
 
     return 0;
 fail:
+    ff_hls_fetch_freep(&speculative);
     hls_close(s);
     return ret;
 }
@@ -1833,7 +3423,18 @@ fail:
 static int recheck_discard_flags(AVFormatContext *s, int first)
 {
     HLSContext *c = s->priv_data;
-    int i, changed = 0;
+    int i, j, changed = 0;
+
+    /* the subdemuxers then drop what is not read early, mpegts by PID */
+    for (i = 0; i < c->n_playlists; i++) {
+        struct playlist *pls = c->playlists[i];
+        for (j = 0; pls->ctx && j < pls->n_main_streams && j < pls->ctx->nb_streams; j++)
+            pls->ctx->streams[j]->discard = pls->main_streams[j]->discard;
+    }
+
+    // the variant is chosen by abr, the streams read follow the exported ones
+    if (c->abr_leader)
+        return 0;
 
     /* Check if any new streams are needed */
     for (i = 0; i < c->n_playlists; i++)
@@ -1848,10 +3449,20 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
         if (pls->cur_needed && !pls->needed) {
+            if (!changed)
+                demux_pause(c);
+            flush_queue(pls);
             pls->needed = 1;
             changed = 1;
             pls->cur_seq_no = select_cur_seq_no(c, pls);
+            pls->cur_part = 0;
             pls->pb.eof_reached = 0;
+            /* what was left of the segment read when it was dropped */
+            pls->pb.buf_end = pls->pb.buf_ptr = pls->pb.buffer;
+            av_packet_unref(&pls->pkt);
+            reset_packet(&pls->pkt);
+            if (pls->ctx && pls->ctx->iformat)
+                ff_read_frame_flush(pls->ctx);
             if (c->cur_timestamp != AV_NOPTS_VALUE) {
                 /* catch up */
                 pls->seek_timestamp = c->cur_timestamp;
@@ -1859,117 +3470,564 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
                 pls->seek_stream_index = -1;
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
-        } else if (first && !pls->cur_needed && pls->needed) {
+        } else if ((first || pls->n_main_streams) && !pls->cur_needed && pls->needed) {
+            /* later on too, so a rendition whose streams were all closed,
+             * the video one of audio only playback, is no longer fetched */
+            if (!changed)
+                demux_pause(c);
+            flush_queue(pls);
             if (pls->input)
                 ff_format_io_close(pls->parent, &pls->input);
+            stop_prefetch(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
         }
     }
+    if (changed)
+        demux_resume(c);
     return changed;
 }
 
-static void fill_timing_for_id3_timestamped_stream(struct playlist *pls)
+static void fill_timing_for_id3_timestamped_stream(struct playlist *pls, AVPacket *pkt)
 {
     if (pls->id3_offset >= 0) {
-        pls->pkt.dts = pls->id3_mpegts_timestamp +
+        pkt->dts = pls->id3_mpegts_timestamp +
                                  av_rescale_q(pls->id3_offset,
-                                              pls->ctx->streams[pls->pkt.stream_index]->time_base,
+                                              pls->ctx->streams[pkt->stream_index]->time_base,
                                               MPEG_TIME_BASE_Q);
-        if (pls->pkt.duration)
-            pls->id3_offset += pls->pkt.duration;
+        if (pkt->duration)
+            pls->id3_offset += pkt->duration;
         else
             pls->id3_offset = -1;
     } else {
         /* there have been packets with unknown duration
          * since the last id3 tag, should not normally happen */
-        pls->pkt.dts = AV_NOPTS_VALUE;
+        pkt->dts = AV_NOPTS_VALUE;
     }
 
-    if (pls->pkt.duration)
-        pls->pkt.duration = av_rescale_q(pls->pkt.duration,
-                                         pls->ctx->streams[pls->pkt.stream_index]->time_base,
-                                         MPEG_TIME_BASE_Q);
+    if (pkt->duration)
+        pkt->duration = av_rescale_q(pkt->duration,
+                                     pls->ctx->streams[pkt->stream_index]->time_base,
+                                     MPEG_TIME_BASE_Q);
 
-    pls->pkt.pts = AV_NOPTS_VALUE;
+    pkt->pts = AV_NOPTS_VALUE;
 }
 
-static AVRational get_timebase(struct playlist *pls)
+static AVRational get_timebase(struct playlist *pls, AVPacket *pkt)
 {
     if (pls->is_id3_timestamped)
         return MPEG_TIME_BASE_Q;
 
-    return pls->ctx->streams[pls->pkt.stream_index]->time_base;
+    return pls->ctx->streams[pkt->stream_index]->time_base;
 }
 
 static int compare_ts_with_wrapdetect(int64_t ts_a, struct playlist *pls_a,
                                       int64_t ts_b, struct playlist *pls_b)
 {
-    int64_t scaled_ts_a = av_rescale_q(ts_a, get_timebase(pls_a), MPEG_TIME_BASE_Q);
-    int64_t scaled_ts_b = av_rescale_q(ts_b, get_timebase(pls_b), MPEG_TIME_BASE_Q);
+    int64_t scaled_ts_a = av_rescale_q(ts_a, get_timebase(pls_a, &pls_a->pkt), MPEG_TIME_BASE_Q);
+    int64_t scaled_ts_b = av_rescale_q(ts_b, get_timebase(pls_b, &pls_b->pkt), MPEG_TIME_BASE_Q);
 
     return av_compare_mod(scaled_ts_a, scaled_ts_b, 1LL << 33);
 }
 
-static int hls_read_packet(AVFormatContext *s, AVPacket *pkt)
+/* Only unencrypted MPEG-TS segments are entered at a key frame: anywhere
+ * else the data before it is needed to decrypt or demux what follows. */
+static int segment_is_seekable(struct segment *seg)
+{
+    return seg->key_type == KEY_NONE && !seg->init_section;
+}
+
+static void add_keyframe(struct segment *seg, int64_t timestamp, int64_t offset)
+{
+    struct keyframe *kf;
+    int i = seg->n_keyframes;
+
+    while (i > 0 && seg->keyframes[i - 1].timestamp > timestamp)
+        i--;
+    if (i > 0 && seg->keyframes[i - 1].offset == offset) {
+        /* a pass over the segment corrects what an I-frame playlist told */
+        seg->keyframes[i - 1].timestamp = timestamp;
+        return;
+    }
+    if (seg->n_keyframes >= MAX_KEYFRAMES)
+        return;
+    kf = av_fast_realloc(seg->keyframes, &seg->keyframes_size,
+                         (seg->n_keyframes + 1) * sizeof(*kf));
+    if (!kf)
+        return;
+    seg->keyframes = kf;
+    memmove(kf + i + 1, kf + i, (seg->n_keyframes - i) * sizeof(*kf));
+    kf[i].timestamp = timestamp;
+    kf[i].offset    = offset;
+    seg->n_keyframes++;
+}
+
+/* note where the video key frame in pkt starts in its segment */
+static void record_keyframe(struct playlist *pls, AVPacket *pkt)
+{
+    struct segment_start *start = NULL;
+    struct segment *seg;
+    AVRational tb;
+    int i, idx;
+
+    if (!(pkt->flags & AV_PKT_FLAG_KEY) || pkt->pos < 0 || pkt->dts == AV_NOPTS_VALUE ||
+        pls->ctx->streams[pkt->stream_index]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ||
+        strcmp(pls->ctx->iformat->name, "mpegts"))
+        return;
+
+    /* the demuxer reads ahead, the packet may be from a segment before the last */
+    for (i = FFMAX(pls->n_seg_starts - MAX_SEGMENT_STARTS, 0); i < pls->n_seg_starts; i++) {
+        struct segment_start *s = &pls->seg_starts[i % MAX_SEGMENT_STARTS];
+        if (s->pos <= pkt->pos && (!start || s->pos >= start->pos))
+            start = s;
+    }
+    if (!start)
+        return;
+    idx = start->seq_no - pls->start_seq_no;
+    if (idx < 0 || idx >= pls->n_segments)
+        return;
+    seg = pls->segments[idx];
+    if (!segment_is_seekable(seg))
+        return;
+
+    tb = get_timebase(pls, pkt);
+    add_keyframe(seg, av_rescale_rnd(pkt->dts, AV_TIME_BASE, tb.den, AV_ROUND_DOWN),
+                 pkt->pos - start->pos + start->offset);
+}
+
+static void free_iframe_playlist(struct playlist **ppls)
+{
+    struct playlist *pls = *ppls;
+    free_segment_list(pls);
+    free_part_list(pls);
+    free_init_section_list(pls);
+    av_freep(&pls->etag);
+    av_freep(&pls->last_modified);
+    av_freep(ppls);
+}
+
+/* Take the key frames of the segments of pls from an I-frame playlist, whose
+ * entries are byte ranges of the same files. Returns how many matched. */
+static int map_iframe_playlist(HLSContext *c, struct playlist *pls, struct playlist *iframes)
+{
+    int64_t first = c->first_timestamp == AV_NOPTS_VALUE ? 0 : c->first_timestamp;
+    int i, j = 0, n = 0;
+
+    for (i = 0; i < iframes->n_segments; i++) {
+        struct segment *entry = iframes->segments[i];
+        int k;
+        for (k = j; k < pls->n_segments; k++) {
+            struct segment *seg = pls->segments[k];
+            if (!strcmp(seg->url, entry->url) && entry->url_offset >= seg->url_offset &&
+                (seg->size < 0 || entry->url_offset < seg->url_offset + seg->size))
+                break;
+        }
+        if (k == pls->n_segments)
+            continue;
+        j = k;
+        if (!segment_is_seekable(pls->segments[k]))
+            continue;
+        add_keyframe(pls->segments[k], first + entry->start_time,
+                     entry->url_offset - pls->segments[k]->url_offset);
+        n++;
+    }
+    return n;
+}
+
+/* once per playlist, from the first I-frame playlist that lists its segments */
+static void load_iframe_playlists(HLSContext *c, struct playlist *pls)
+{
+    int i;
+
+    if (pls->iframes_loaded)
+        return;
+    pls->iframes_loaded = 1;
+
+    for (i = 0; i < c->n_iframe_urls; i++) {
+        struct playlist *iframes = av_mallocz(sizeof(*iframes));
+        int n = 0;
+        if (!iframes)
+            return;
+        av_strlcpy(iframes->url, c->iframe_urls[i], sizeof(iframes->url));
+        if (parse_playlist(c, iframes->url, iframes, NULL) >= 0)
+            n = map_iframe_playlist(c, pls, iframes);
+        free_iframe_playlist(&iframes);
+        if (n > 0) {
+            av_log(c->ctx, AV_LOG_VERBOSE, "HLS: %d key frames of playlist %d from %s\n",
+                   n, pls->index, c->iframe_urls[i]);
+            return;
+        }
+    }
+}
+
+/* where to open the segment holding timestamp: the last known key frame
+ * not after it, from where reading on finds the one the seek wants */
+static int64_t keyframe_offset(HLSContext *c, struct playlist *pls, int64_t timestamp)
+{
+    struct segment *seg = current_segment(pls);
+    int i;
+
+    if (!segment_is_seekable(seg))
+        return 0;
+    load_iframe_playlists(c, pls);
+    for (i = seg->n_keyframes - 1; i >= 0; i--)
+        if (seg->keyframes[i].timestamp <= timestamp)
+            return seg->keyframes[i].offset;
+    return 0;
+}
+
+/* continue with c->abr_next where abr_playlist stopped */
+static int abr_switch(AVFormatContext *s)
+{
+    HLSContext      *c    = s->priv_data;
+    struct playlist *from = c->abr_playlist;
+    struct playlist *to   = c->abr_next;
+    struct variant  *from_var = variant_of_playlist(c, from);
+    struct variant  *to_var   = variant_of_playlist(c, to);
+    AVAppVariantSwitch event = { 0 };
+    int ret = 0;
+
+    c->abr_next = NULL;
+
+    if (from->finished && to->finished) {
+        int64_t ts = c->first_timestamp == AV_NOPTS_VALUE ? 0 : c->first_timestamp;
+        int idx    = c->abr_switch_seq_no - from->start_seq_no;
+        if (idx >= from->n_segments)
+            return AVERROR_EOF;
+        find_timestamp_in_playlist(c, to, ts + from->segments[idx]->start_time, &to->cur_seq_no);
+    } else {
+        // live variants share media sequence numbers
+        to->cur_seq_no = c->abr_switch_seq_no;
+    }
+
+    to->cur_part       = 0;
+    to->input_part     = NULL;
+    to->needed         = 1;
+    to->seek_timestamp = AV_NOPTS_VALUE;
+    to->pb.eof_reached = 0;
+    to->pb.buf_end     = to->pb.buf_ptr = to->pb.buffer;
+    to->pb.pos         = 0;
+    to->n_seg_starts   = 0;
+    /* the variants share the timeline, and the shift into it */
+    to->disc_seq       = -1;
+    to->disc_next_seq  = -1;
+    to->ts_offset      = from->ts_offset;
+    to->ts_end         = from->ts_end;
+    av_packet_unref(&to->pkt);
+    reset_packet(&to->pkt);
+    flush_queue(to);
+
+    if (to->ctx && to->ctx->iformat) {
+        ff_read_frame_flush(to->ctx);
+    } else {
+        if (!to->ctx && !(to->ctx = avformat_alloc_context()))
+            ret = AVERROR(ENOMEM);
+        if (ret >= 0)
+            ret = open_playlist_demuxer(s, to);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "ABR: failed to open variant %d bps, staying at %d bps\n",
+                   to_var->bandwidth, from_var->bandwidth);
+            to->needed = 0;
+            from->pb.eof_reached = 0;
+            flush_queue(from);
+            return ff_check_interrupt(c->interrupt_callback) ? AVERROR_EXIT : 0;
+        }
+    }
+    from->needed    = 0;
+    c->abr_playlist = to;
+
+    event.size                = sizeof(event);
+    event.from_bitrate        = from_var->bandwidth;
+    event.to_bitrate          = to_var->bandwidth;
+    event.seq_no              = to->cur_seq_no;
+    event.estimated_bandwidth = ff_hls_abr_get_bandwidth(&c->abr_estimate);
+    event.buffered_milli      = c->abr_buffered_milli;
+    av_application_on_variant_switch(c->app_ctx, &event);
+    return 0;
+}
+
+/*
+ * At EXT-X-DISCONTINUITY the timestamps usually jump, e.g. into and out
+ * of an ad inserted by the server. The packets of the next discontinuity
+ * sequence are shifted to follow the last ones, so that the decoders and
+ * the clocks of the player go on as across any other segment. The
+ * playlists entering one sequence share the shift, to stay in sync, and
+ * after a seek the sequence is placed by the durations of the segments.
+ */
+static void rebase_timestamps(HLSContext *c, struct playlist *pls, AVPacket *pkt)
+{
+    AVRational tb = get_timebase(pls, pkt);
+    int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    int64_t offset, end;
+
+    if (ts == AV_NOPTS_VALUE)
+        return;
+    ts = av_rescale_q(ts, tb, AV_TIME_BASE_Q);
+
+    if (pls->disc_next_seq >= 0 && (pkt->pos < 0 || pkt->pos >= pls->disc_next_pos)) {
+        offset = pls->ts_offset;
+        if (pls->ts_end != AV_NOPTS_VALUE) {
+            /* timestamps that go on across the discontinuity are kept */
+            if (FFABS(ts + offset - pls->ts_end) > DISCONTINUITY_MAX_GAP) {
+                if (c->disc_seq == pls->disc_next_seq &&
+                    FFABS(ts + c->disc_offset - pls->ts_end) <= DISCONTINUITY_MAX_GAP)
+                    offset = c->disc_offset;
+                else
+                    offset = pls->ts_end - ts;
+            }
+        } else if (pls->n_segments && pls->disc_next_seq == pls->segments[0]->disc_seq) {
+            offset = 0;
+        } else if (c->disc_seq == pls->disc_next_seq) {
+            offset = c->disc_offset;
+        } else if (pls->disc_next_ts != AV_NOPTS_VALUE &&
+                   FFABS(ts - pls->disc_next_ts) > DISCONTINUITY_MAX_GAP) {
+            offset = pls->disc_next_ts - ts;
+        } else {
+            offset = 0;
+        }
+        if (offset != pls->ts_offset)
+            av_log(pls->parent, AV_LOG_VERBOSE,
+                   "Discontinuity sequence %d of playlist %d, timestamps shifted by %"PRId64"\n",
+                   pls->disc_next_seq, pls->index, offset);
+        pls->ts_offset     = offset;
+        c->disc_seq        = pls->disc_next_seq;
+        c->disc_offset     = offset;
+        pls->disc_next_seq = -1;
+    }
+
+    if (pls->ts_offset) {
+        int64_t shift = av_rescale_q(pls->ts_offset, AV_TIME_BASE_Q, tb);
+        if (pkt->dts != AV_NOPTS_VALUE)
+            pkt->dts += shift;
+        if (pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts += shift;
+    }
+    end = ts + pls->ts_offset;
+    if (pkt->duration > 0)
+        end += av_rescale_q(pkt->duration, tb, AV_TIME_BASE_Q);
+    if (pls->ts_end == AV_NOPTS_VALUE || end > pls->ts_end)
+        pls->ts_end = end;
+}
+
+/* the next packet of pls, past the ones before its seek timestamp; pkt
+ * is left blank at the end of the playlist */
+static int read_playlist_packet(HLSContext *c, struct playlist *pls, AVPacket *pkt)
+{
+    int ret;
+
+    while (1) {
+        int64_t ts_diff;
+        AVRational tb;
+        ret = av_read_frame(pls->ctx, pkt);
+        if (ret < 0) {
+            if (!avio_feof(&pls->pb) && ret != AVERROR_EOF)
+                return ret;
+            reset_packet(pkt);
+            return 0;
+        }
+        /* stream_index check prevents matching picture attachments etc. */
+        if (pls->is_id3_timestamped && pkt->stream_index == 0) {
+            /* audio elementary streams are id3 timestamped */
+            fill_timing_for_id3_timestamped_stream(pls, pkt);
+        }
+        rebase_timestamps(c, pls, pkt);
+
+        if (c->first_timestamp == AV_NOPTS_VALUE &&
+            pkt->dts           != AV_NOPTS_VALUE)
+            c->first_timestamp = av_rescale_q(pkt->dts,
+                get_timebase(pls, pkt), AV_TIME_BASE_Q);
+        if (pls->finished || pls->type == PLS_TYPE_EVENT)
+            record_keyframe(pls, pkt);
+
+        if (pls->seek_timestamp == AV_NOPTS_VALUE)
+            return 0;
+
+        if (pls->seek_stream_index < 0 ||
+            pls->seek_stream_index == pkt->stream_index) {
+
+            if (pkt->dts == AV_NOPTS_VALUE) {
+                pls->seek_timestamp = AV_NOPTS_VALUE;
+                return 0;
+            }
+
+            tb = get_timebase(pls, pkt);
+            ts_diff = av_rescale_rnd(pkt->dts, AV_TIME_BASE,
+                                    tb.den, AV_ROUND_DOWN) -
+                    pls->seek_timestamp;
+            if (ts_diff >= 0 && (pls->seek_flags  & AVSEEK_FLAG_ANY ||
+                                pkt->flags & AV_PKT_FLAG_KEY)) {
+                pls->seek_timestamp = AV_NOPTS_VALUE;
+                return 0;
+            }
+        }
+        av_packet_unref(pkt);
+        reset_packet(pkt);
+    }
+}
+
+#if HAVE_PTHREADS
+/*
+ * A worker reads the packets of one playlist ahead into its queue, so a
+ * segment open or a live reload that takes long on one rendition holds
+ * back that rendition only. It stops at the end of the playlist or on an
+ * error, until the reading thread takes the error or flushes the queue.
+ */
+static void *demux_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    HLSContext *c = pls->parent->priv_data;
+    AVPacketList *node;
+    AVPacket pkt;
+    int ret;
+
+    pthread_mutex_lock(&c->lock);
+    while (!c->demux_abort) {
+        if (c->demux_pause || !pls->needed || pls->demux_ret < 0 ||
+            pls->queue_size >= DEMUX_QUEUE_SIZE) {
+            pthread_cond_wait(&c->demux_cond, &c->lock);
+            continue;
+        }
+
+        c->demux_busy++;
+        ret = read_playlist_packet(c, pls, &pkt);
+        if (ret >= 0 && !pkt.data)
+            ret = AVERROR_EOF;
+        if (ret >= 0 && !(node = av_mallocz(sizeof(*node))))
+            ret = AVERROR(ENOMEM);
+        if (ret >= 0 && (ret = av_packet_ref(&node->pkt, &pkt)) < 0)
+            av_free(node);
+        if (ret >= 0) {
+            if (pls->queue_last)
+                pls->queue_last->next = node;
+            else
+                pls->queue_first = node;
+            pls->queue_last  = node;
+            pls->queue_size += node->pkt.size + sizeof(*node);
+        } else {
+            pls->demux_ret = ret;
+        }
+        av_packet_unref(&pkt);
+        /* the packet is queued before a pause sees the worker out */
+        c->demux_busy--;
+        pthread_cond_broadcast(&c->demux_cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return NULL;
+}
+
+/* from the first packet on which two playlists are read */
+static int start_demux(HLSContext *c)
+{
+    int i, needed = 0, ret;
+
+    for (i = 0; i < c->n_playlists; i++)
+        needed += c->playlists[i]->needed;
+    if (needed < 2)
+        return 0;
+
+    if ((ret = pthread_mutex_init(&c->lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&c->demux_cond, NULL))) {
+        pthread_mutex_destroy(&c->lock);
+        return AVERROR(ret);
+    }
+    c->demux_started = 1;
+    return 0;
+}
+
+/* move the first packet queued for pls to pls->pkt, AVERROR(EAGAIN) if
+ * there is none yet; pls->pkt is left blank at the end of the playlist */
+static int take_queued_packet(HLSContext *c, struct playlist *pls)
+{
+    AVPacketList *node = pls->queue_first;
+    int ret;
+
+    if (!pls->demux_running) {
+        if ((ret = pthread_create(&pls->demux_thread, NULL, demux_thread, pls)))
+            return AVERROR(ret);
+        pls->demux_running = 1;
+    }
+
+    if (!node) {
+        if (pls->demux_ret == AVERROR_EOF)
+            return 0;
+        if (pls->demux_ret < 0) {
+            // returned once, the worker tries again on the next packet
+            ret = pls->demux_ret;
+            pls->demux_ret = 0;
+            pthread_cond_broadcast(&c->demux_cond);
+            return ret;
+        }
+        if (!pls->demux_empty_since)
+            pls->demux_empty_since = av_gettime_relative();
+        return AVERROR(EAGAIN);
+    }
+
+    pls->queue_first = node->next;
+    if (!pls->queue_first)
+        pls->queue_last = NULL;
+    pls->queue_size -= node->pkt.size + sizeof(*node);
+    pls->pkt = node->pkt;
+    av_free(node);
+    pls->demux_empty_since = 0;
+    pthread_cond_broadcast(&c->demux_cond);
+    return 0;
+}
+
+static int demux_wait(HLSContext *c)
+{
+    int64_t         t  = av_gettime() + DEMUX_WAIT_INTERVAL;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    pthread_cond_timedwait(&c->demux_cond, &c->lock, &tv);
+    return ff_check_interrupt(c->interrupt_callback) ? AVERROR_EXIT : 0;
+}
+#else
+static int start_demux(HLSContext *c)
+{
+    return 0;
+}
+
+static int take_queued_packet(HLSContext *c, struct playlist *pls)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int demux_wait(HLSContext *c)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
+static int read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *c = s->priv_data;
     int ret, i, minplaylist = -1;
+    int pending, waiting;
 
+restart:
     recheck_discard_flags(s, c->first_packet);
     c->first_packet = 0;
+    pending = waiting = 0;
 
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
         /* Make sure we've got one buffered packet from each open playlist
          * stream */
         if (pls->needed && !pls->pkt.data) {
-            while (1) {
-                int64_t ts_diff;
-                AVRational tb;
-                ret = av_read_frame(pls->ctx, &pls->pkt);
-                if (ret < 0) {
-                    if (!avio_feof(&pls->pb) && ret != AVERROR_EOF)
-                        return ret;
-                    reset_packet(&pls->pkt);
-                    break;
-                } else {
-                    /* stream_index check prevents matching picture attachments etc. */
-                    if (pls->is_id3_timestamped && pls->pkt.stream_index == 0) {
-                        /* audio elementary streams are id3 timestamped */
-                        fill_timing_for_id3_timestamped_stream(pls);
-                    }
-
-                    if (c->first_timestamp == AV_NOPTS_VALUE &&
-                        pls->pkt.dts       != AV_NOPTS_VALUE)
-                        c->first_timestamp = av_rescale_q(pls->pkt.dts,
-                            get_timebase(pls), AV_TIME_BASE_Q);
-                }
-
-                if (pls->seek_timestamp == AV_NOPTS_VALUE)
-                    break;
-
-                if (pls->seek_stream_index < 0 ||
-                    pls->seek_stream_index == pls->pkt.stream_index) {
-
-                    if (pls->pkt.dts == AV_NOPTS_VALUE) {
-                        pls->seek_timestamp = AV_NOPTS_VALUE;
-                        break;
-                    }
-
-                    tb = get_timebase(pls);
-                    ts_diff = av_rescale_rnd(pls->pkt.dts, AV_TIME_BASE,
-                                            tb.den, AV_ROUND_DOWN) -
-                            pls->seek_timestamp;
-                    if (ts_diff >= 0 && (pls->seek_flags  & AVSEEK_FLAG_ANY ||
-                                        pls->pkt.flags & AV_PKT_FLAG_KEY)) {
-                        pls->seek_timestamp = AV_NOPTS_VALUE;
-                        break;
-                    }
-                }
-                av_packet_unref(&pls->pkt);
-                reset_packet(&pls->pkt);
+            if (!c->demux_started) {
+                if ((ret = read_playlist_packet(c, pls, &pls->pkt)) < 0)
+                    return ret;
+            } else if ((ret = take_queued_packet(c, pls)) == AVERROR(EAGAIN)) {
+                /* a playlist that stalls is not waited for by the others */
+                pending++;
+                if (av_gettime_relative() - pls->demux_empty_since < DEMUX_STALL_TIME)
+                    waiting++;
+            } else if (ret < 0) {
+                return ret;
             }
         }
         /* Check if this stream has the packet with the lowest dts */
@@ -1989,6 +4047,22 @@ static int hls_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    if (pending && (minplaylist < 0 || waiting)) {
+        if ((ret = demux_wait(c)) < 0)
+            return ret;
+        minplaylist = -1;
+        goto restart;
+    }
+
+    if (minplaylist < 0 && c->abr_next) {
+        demux_pause(c);
+        ret = abr_switch(s);
+        demux_resume(c);
+        if (ret < 0)
+            return ret;
+        goto restart;
+    }
+
     /* If we got a packet, return it */
     if (minplaylist >= 0) {
         struct playlist *pls = c->playlists[minplaylist];
@@ -2028,6 +4102,11 @@ static int hls_read_packet(AVFormatContext *s, AVPacket *pkt)
                                             ist->time_base,
                                             AV_TIME_BASE_Q);
 
+        // another abr variant may use another time base
+        if (pls != c->abr_leader && c->abr_leader && !pls->is_id3_timestamped &&
+            av_cmp_q(ist->time_base, st->time_base))
+            av_packet_rescale_ts(pkt, ist->time_base, st->time_base);
+
         /* There may be more situations where this would be useful, but this at least
          * handles newly probed codecs properly (i.e. request_probe by mpegts). */
         if (ist->codecpar->codec_id != st->codecpar->codec_id) {
@@ -2038,35 +4117,26 @@ static int hls_read_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
 
-        if (c->playlists[minplaylist]->finished) {
-            struct playlist *pls = c->playlists[minplaylist];
-            int seq_no = pls->cur_seq_no - pls->start_seq_no;
-            if (seq_no < pls->n_segments && s->streams[pkt->stream_index]) {
-                struct segment *seg = pls->segments[seq_no];
-                int64_t pred = av_rescale_q(seg->previous_duration,
-                                            AV_TIME_BASE_Q,
-                                            s->streams[pkt->stream_index]->time_base);
-                int64_t max_ts = av_rescale_q(seg->start_time + seg->duration,
-                                              AV_TIME_BASE_Q,
-                                              s->streams[pkt->stream_index]->time_base);
-                /* EXTINF duration is not precise enough */
-                max_ts += 2 * AV_TIME_BASE;
-                if (s->start_time > 0) {
-                    max_ts += av_rescale_q(s->start_time,
-                                           AV_TIME_BASE_Q,
-                                           s->streams[pkt->stream_index]->time_base);
-                }
-                if (pkt->dts != AV_NOPTS_VALUE && pkt->dts + pred < max_ts) pkt->dts += pred;
-                if (pkt->pts != AV_NOPTS_VALUE && pkt->pts + pred < max_ts) pkt->pts += pred;
-            }
-        }
         return 0;
     }
     return AVERROR_EOF;
 }
 
-static int hls_read_seek(AVFormatContext *s, int stream_index,
-                               int64_t timestamp, int flags)
+static int hls_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    HLSContext *c = s->priv_data;
+    int ret;
+
+    if (c->demux_threads && !c->demux_started && (ret = start_demux(c)) < 0)
+        return ret;
+    demux_lock(c);
+    ret = read_packet(s, pkt);
+    demux_unlock(c);
+    return ret;
+}
+
+static int seek_playlists(AVFormatContext *s, int stream_index,
+                          int64_t timestamp, int flags)
 {
     HLSContext *c = s->priv_data;
     struct playlist *seek_pls = NULL;
@@ -2104,6 +4174,22 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
             }
         }
     }
+    if (c->abr_playlist) {
+        // every variant maps to the exported streams, seek the one being read
+        struct playlist *pls = c->abr_playlist;
+        seek_pls = NULL;
+        for (j = 0; j < pls->n_main_streams; j++) {
+            if (pls->main_streams[j] == s->streams[stream_index]) {
+                seek_pls = pls;
+                stream_subdemuxer_index = j;
+                break;
+            }
+        }
+        if (seek_pls && c->abr_next) {
+            c->abr_next = NULL;
+            seek_pls->pb.eof_reached = 0;
+        }
+    }
     /* check if the timestamp is valid for the playlist with the
      * specified stream index */
     if (!seek_pls || !find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no))
@@ -2112,21 +4198,34 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     /* set segment now so we do not need to search again below */
     seek_pls->cur_seq_no = seq_no;
     seek_pls->seek_stream_index = stream_subdemuxer_index;
+    /* enter it at the key frame, with a ranged request, when known */
+    seek_pls->seek_seg_offset = keyframe_offset(c, seek_pls, seek_timestamp);
+    /* the sequences are placed again from where the seek lands */
+    c->disc_seq = -1;
 
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         if (pls->input)
             ff_format_io_close(pls->parent, &pls->input);
+        pls->input_part = NULL;
+        pls->cur_part   = 0;
+        stop_prefetch(pls);
         av_packet_unref(&pls->pkt);
         reset_packet(&pls->pkt);
+        flush_queue(pls);
         pls->pb.eof_reached = 0;
         /* Clear any buffered data */
         pls->pb.buf_end = pls->pb.buf_ptr = pls->pb.buffer;
         /* Reset the pos, to let the mpegts demuxer know we've seeked. */
         pls->pb.pos = 0;
+        pls->n_seg_starts = 0;
+        pls->disc_seq      = -1;
+        pls->disc_next_seq = -1;
+        pls->ts_end        = AV_NOPTS_VALUE;
         /* Flush the packet queue of the subdemuxer. */
-        ff_read_frame_flush(pls->ctx);
+        if (pls->ctx)
+            ff_read_frame_flush(pls->ctx);
 
         pls->seek_timestamp = seek_timestamp;
         pls->seek_flags = flags;
@@ -2147,6 +4246,20 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     return 0;
 }
 
+static int hls_read_seek(AVFormatContext *s, int stream_index,
+                               int64_t timestamp, int flags)
+{
+    HLSContext *c = s->priv_data;
+    int ret;
+
+    demux_lock(c);
+    demux_pause(c);
+    ret = seek_playlists(s, stream_index, timestamp, flags);
+    demux_resume(c);
+    demux_unlock(c);
+    return ret;
+}
+
 static int hls_probe(AVProbeData *p)
 {
     /* Require #EXTM3U at the start, and either one of the ones below
@@ -2166,6 +4279,40 @@ static int hls_probe(AVProbeData *p)
 static const AVOption hls_options[] = {
     {"live_start_index", "segment index to start live streams at (negative values are from the end)",
         OFFSET(live_start_index), AV_OPT_TYPE_INT, {.i64 = -3}, INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "number of segments to download ahead in parallel, 0 to disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, HLS_PREFETCH_MAX_SEGMENTS, FLAGS},
+    {"low_latency", "read partial segments and block on live reloads when the server supports it",
+        OFFSET(low_latency), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"abr", "switch variants according to the measured bandwidth",
+        OFFSET(abr), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
+    {"abr_upswitch_buffer", "ms buffered before switching up",
+        OFFSET(abr_policy.upswitch_buffer), AV_OPT_TYPE_INT64, {.i64 = HLS_ABR_UPSWITCH_BUFFER}, 0, INT64_MAX, FLAGS},
+    {"abr_hold_buffer", "ms buffered to ride out a throughput dip without switching down",
+        OFFSET(abr_policy.hold_buffer), AV_OPT_TYPE_INT64, {.i64 = HLS_ABR_HOLD_BUFFER}, 0, INT64_MAX, FLAGS},
+    {"abr_panic_buffer", "ms buffered below which the bandwidth estimate is halved",
+        OFFSET(abr_policy.panic_buffer), AV_OPT_TYPE_INT64, {.i64 = HLS_ABR_PANIC_BUFFER}, 0, INT64_MAX, FLAGS},
+    {"abr_usable_percent", "percent of the bandwidth estimate a variant may take",
+        OFFSET(abr_policy.usable_percent), AV_OPT_TYPE_INT, {.i64 = HLS_ABR_USABLE_PERCENT}, 1, 100, FLAGS},
+    {"shared_estimate", "start the variant and the prefetch from the bandwidth other sessions measured",
+        OFFSET(shared_estimate), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"parallel_open", "load the media playlists at once and start the first segment before they all are in",
+        OFFSET(parallel_open), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"demux_threads", "read each playlist on a thread of its own when several are read",
+        OFFSET(demux_threads), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"prefetch_max_size", "max bytes of prefetched segments waiting to be read",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT, {.i64 = 8 * 1024 * 1024}, 0, INT_MAX, FLAGS},
+    {"audio_lead", "keep the prefetch of audio renditions this far ahead of video, 0 to disable",
+        OFFSET(audio_lead), AV_OPT_TYPE_DURATION, {.i64 = 2 * AV_TIME_BASE}, 0, INT64_MAX, FLAGS},
+    {"disk_cache", "keep http segments in the persistent disk cache",
+        OFFSET(disk_cache), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
+    {"disk_cache_dir", "directory of the disk cache, if not configured by the application",
+        OFFSET(disk_cache_dir), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
+    {"disk_cache_max_size", "budget of the disk cache in bytes",
+        OFFSET(disk_cache_max_size), AV_OPT_TYPE_INT64, {.i64 = 512 * 1024 * 1024}, 1, INT64_MAX, FLAGS},
+    {"key_cache_lifetime", "time an AES-128 key is reused by the sessions of the process, 0 to fetch it every time",
+        OFFSET(key_cache_lifetime), AV_OPT_TYPE_DURATION, {.i64 = 5 * 60 * 1000000LL}, 0, INT64_MAX, FLAGS},
+    {"exclude_codecs", "comma separated codecs whose variants are not played when others are, e.g. \"av01\"",
+        OFFSET(exclude_codecs), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -2187,3 +4334,193 @@ AVInputFormat ff_hls_demuxer = {
     .read_close     = hls_close,
     .read_seek      = hls_read_seek,
 };
+
+static int export_range(HLSMediaRange *dst, const struct segment *seg)
+{
+    dst->url    = av_strdup(seg->url);
+    dst->offset = seg->url_offset;
+    dst->size   = seg->size;
+    return dst->url ? 0 : AVERROR(ENOMEM);
+}
+
+static int export_playlist(HLSMediaPlaylist *dst, const struct playlist *pls)
+{
+    int i, j, ret;
+
+    dst->url             = av_strdup(pls->url);
+    dst->finished        = pls->finished;
+    dst->target_duration = pls->target_duration;
+    dst->start_seq_no    = pls->start_seq_no;
+    dst->init_sections   = av_mallocz_array(FFMAX(pls->n_init_sections, 1), sizeof(*dst->init_sections));
+    dst->segments        = av_mallocz_array(FFMAX(pls->n_segments, 1), sizeof(*dst->segments));
+    if (!dst->url || !dst->init_sections || !dst->segments)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < pls->n_init_sections; i++) {
+        if ((ret = export_range(&dst->init_sections[i], pls->init_sections[i])) < 0)
+            return ret;
+        dst->nb_init_sections++;
+    }
+    for (i = 0; i < pls->n_segments; i++) {
+        const struct segment *seg = pls->segments[i];
+        HLSMediaSegment *out = &dst->segments[i];
+
+        if ((ret = export_range(&out->range, seg)) < 0)
+            return ret;
+        dst->nb_segments++;
+        out->duration      = seg->duration;
+        out->discontinuity = i && seg->disc_seq != pls->segments[i - 1]->disc_seq;
+        out->key_method    = seg->key_type == KEY_AES_128    ? HLS_KEY_AES_128    :
+                             seg->key_type == KEY_SAMPLE_AES ? HLS_KEY_SAMPLE_AES : HLS_KEY_NONE;
+        memcpy(out->iv, seg->iv, sizeof(out->iv));
+        if (out->key_method != HLS_KEY_NONE && !(out->key_url = av_strdup(seg->key)))
+            return AVERROR(ENOMEM);
+        out->init_section = -1;
+        for (j = 0; j < pls->n_init_sections; j++) {
+            if (seg->init_section == pls->init_sections[j])
+                out->init_section = j;
+        }
+    }
+    return 0;
+}
+
+/* the audio rendition of the group of var with a playlist of its own, the default one first */
+static struct playlist *variant_audio_playlist(HLSContext *c, const struct variant *var)
+{
+    struct playlist *found = NULL;
+    int i;
+
+    if (!var->audio_group[0])
+        return NULL;
+    for (i = 0; i < c->n_renditions; i++) {
+        struct rendition *rend = c->renditions[i];
+
+        if (rend->type != AVMEDIA_TYPE_AUDIO || !rend->playlist ||
+            strcmp(rend->group_id, var->audio_group) ||
+            !strcmp(rend->playlist->url, var->playlists[0]->url))
+            continue;
+        if (rend->disposition & AV_DISPOSITION_DEFAULT)
+            return rend->playlist;
+        if (!found)
+            found = rend->playlist;
+    }
+    return found;
+}
+
+static struct variant *pick_variant(HLSContext *c, int max_bandwidth)
+{
+    struct variant *best = NULL, *lowest = NULL;
+    int i;
+
+    for (i = 0; i < c->n_variants; i++) {
+        struct variant *var = c->variants[i];
+
+        if (!lowest || var->bandwidth < lowest->bandwidth)
+            lowest = var;
+        if ((max_bandwidth <= 0 || var->bandwidth <= max_bandwidth) &&
+            (!best || var->bandwidth > best->bandwidth))
+            best = var;
+    }
+    return best ? best : lowest;
+}
+
+int ff_hls_load_variant(HLSMediaPlaylist **pls, const char *url, int max_bandwidth,
+                        AVDictionary *options, const AVIOInterruptCB *int_cb)
+{
+    AVFormatContext   *s = avformat_alloc_context();
+    HLSContext        *c = av_mallocz(sizeof(*c));
+    struct playlist   *chosen[HLS_MAX_VARIANT_PLAYLISTS];
+    struct variant    *var;
+    AVDictionaryEntry *e;
+    int nb_chosen = 0, ret, i;
+
+    for (i = 0; i < HLS_MAX_VARIANT_PLAYLISTS; i++)
+        pls[i] = NULL;
+    if (!s || !c) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (int_cb)
+        s->interrupt_callback = *int_cb;
+    c->class = &hls_class;
+    c->ctx   = s;
+    c->interrupt_callback = &s->interrupt_callback;
+    av_dict_copy(&c->avio_opts, options, 0);
+    if ((e = av_dict_get(options, "user_agent", NULL, 0)))
+        c->user_agent = av_strdup(e->value);
+    if ((e = av_dict_get(options, "cookies", NULL, 0)))
+        c->cookies = av_strdup(e->value);
+    if ((e = av_dict_get(options, "headers", NULL, 0)))
+        c->headers = av_strdup(e->value);
+    if ((e = av_dict_get(options, "http_proxy", NULL, 0)))
+        c->http_proxy = av_strdup(e->value);
+
+    if ((ret = parse_playlist(c, url, NULL, NULL)) < 0)
+        goto end;
+    if (!c->n_variants || !c->n_playlists) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+
+    var = pick_variant(c, max_bandwidth);
+    chosen[nb_chosen++] = var->playlists[0];
+    if (!var->playlists[0]->n_segments &&
+        (ret = parse_playlist(c, var->playlists[0]->url, var->playlists[0], NULL)) < 0)
+        goto end;
+    if ((chosen[nb_chosen] = variant_audio_playlist(c, var))) {
+        if ((ret = parse_playlist(c, chosen[nb_chosen]->url, chosen[nb_chosen], NULL)) < 0)
+            goto end;
+        nb_chosen++;
+    }
+
+    for (i = 0; i < nb_chosen; i++) {
+        if (!chosen[i]->n_segments) {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+        if (!(pls[i] = av_mallocz(sizeof(*pls[i])))) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        pls[i]->bandwidth = i ? 0 : var->bandwidth;
+        pls[i]->is_audio  = i > 0;
+        if ((ret = export_playlist(pls[i], chosen[i])) < 0)
+            goto end;
+    }
+    ret = nb_chosen;
+
+end:
+    if (ret < 0) {
+        for (i = 0; i < HLS_MAX_VARIANT_PLAYLISTS; i++)
+            ff_hls_media_playlist_free(&pls[i]);
+    }
+    if (c) {
+        free_playlist_list(c);
+        free_variant_list(c);
+        free_rendition_list(c);
+        free_iframe_url_list(c);
+        av_dict_free(&c->avio_opts);
+        av_free(c);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+void ff_hls_media_playlist_free(HLSMediaPlaylist **ppls)
+{
+    HLSMediaPlaylist *pls = *ppls;
+    int i;
+
+    if (!pls)
+        return;
+    for (i = 0; i < pls->nb_segments; i++) {
+        av_free(pls->segments[i].range.url);
+        av_free(pls->segments[i].key_url);
+    }
+    for (i = 0; i < pls->nb_init_sections; i++)
+        av_free(pls->init_sections[i].url);
+    av_free(pls->segments);
+    av_free(pls->init_sections);
+    av_free(pls->url);
+    av_freep(ppls);
+}
@@ -0,0 +1,106 @@
+/*
+ * HLS adaptive variant selection
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_ABR_H
+#define AVFORMAT_HLS_ABR_H
+
+#include <stdint.h>
+#include "libavutil/application.h"
+
+/**
+ * The decisions of the HLS demuxer on which variant to read, apart from
+ * the demuxer so tools/hls_abr_sim runs the same code against recorded
+ * network traces.
+ *
+ * The throughput estimate is the lower of a fast and a slow moving average
+ * of the segment downloads; the variant picked is the best one within
+ * usable_percent of it. The buffer level reported by the application gates
+ * the decision: no switch up before upswitch_buffer, no switch down while
+ * hold_buffer still covers the dip, half the estimate below panic_buffer.
+ * A bitrate cap from the application bounds the pick and switches down at
+ * once.
+ *
+ * While the application plays audio only, the pick is among the audio only
+ * variants, or the lowest variant if there is none, and is switched to at
+ * once; back to video, so is the pick among the others.
+ */
+
+#define HLS_ABR_MIN_SAMPLE_BYTES    (16 * 1024)
+#define HLS_ABR_UPSWITCH_BUFFER     10000
+#define HLS_ABR_HOLD_BUFFER         20000
+#define HLS_ABR_PANIC_BUFFER        3000
+#define HLS_ABR_USABLE_PERCENT      80
+
+typedef struct HLSABRPolicy {
+    int64_t upswitch_buffer;    ///< ms buffered before switching up
+    int64_t hold_buffer;        ///< ms buffered to ride out a throughput dip
+    int64_t panic_buffer;       ///< ms buffered below which the estimate is halved
+    int     usable_percent;     ///< of the estimate a variant may take
+} HLSABRPolicy;
+
+#define HLS_ABR_DEFAULT_POLICY { HLS_ABR_UPSWITCH_BUFFER, HLS_ABR_HOLD_BUFFER, \
+                                 HLS_ABR_PANIC_BUFFER, HLS_ABR_USABLE_PERCENT }
+
+typedef struct HLSABRVariant {
+    int bandwidth;              ///< bits per second, as listed
+    int audio_only;
+} HLSABRVariant;
+
+typedef struct HLSABREstimate {
+    int64_t fast_bandwidth;     ///< bits per second, 0 before the first sample
+    int64_t slow_bandwidth;
+} HLSABREstimate;
+
+/**
+ * A segment download of bytes in elapsed microseconds; downloads too short
+ * to tell are ignored.
+ */
+void    ff_hls_abr_add_sample(HLSABREstimate *estimate, int64_t bytes, int64_t elapsed);
+
+/**
+ * @return bits per second, 0 before the first sample
+ */
+int64_t ff_hls_abr_get_bandwidth(const HLSABREstimate *estimate);
+
+/**
+ * The variant a session starts with: the best one within usable_percent of
+ * bandwidth, what was measured before, and max_bitrate if not 0; the first
+ * one with video when bandwidth is 0 or none fits. Seeds the slow average
+ * with bandwidth, so the first segment alone does not decide the next
+ * switch.
+ *
+ * @return the index of the variant, -1 if there is none
+ */
+int     ff_hls_abr_initial_variant(const HLSABRPolicy *policy, HLSABREstimate *estimate,
+                                   const HLSABRVariant *variants, int nb_variants,
+                                   int64_t bandwidth, int64_t max_bitrate);
+
+/**
+ * Called at a segment boundary of the variant cur.
+ *
+ * @param level     from the application, cached_duration_milli -1 if unknown
+ * @param bandwidth set to the estimate the decision was taken on, may be NULL
+ * @return the index of the variant to switch to, -1 to stay on cur
+ */
+int     ff_hls_abr_check_switch(const HLSABRPolicy *policy, const HLSABREstimate *estimate,
+                                const HLSABRVariant *variants, int nb_variants, int cur,
+                                const AVAppBufferLevel *level, int64_t *bandwidth);
+
+#endif /* AVFORMAT_HLS_ABR_H */
@@ -27,13 +27,19 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/lfg.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
 #include "libavutil/time.h"
 #include "libavutil/application.h"
 
 #include "avformat.h"
 #include "http.h"
 #include "httpauth.h"
+#include "http_pool.h"
+#include "http2.h"
+#include "http3.h"
+#include "http_mirror.h"
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
@@ -47,6 +53,9 @@
  * path names). */
 #define BUFFER_SIZE   MAX_URL_SIZE
 #define MAX_REDIRECTS 8
+/* backoff of the reconnects, doubled from the first to reconnect_delay_max */
+#define RECONNECT_DELAY_MIN   250000
+#define RECONNECT_SLEEP_STEP  100000
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 typedef enum {
@@ -71,6 +80,11 @@ typedef struct HTTPContext {
     char *http_proxy;
     char *headers;
     char *mime_type;
+    /* validators of the response, and the ones to send for a conditional GET */
+    char *etag;
+    char *last_modified;
+    char *if_none_match;
+    char *if_modified_since;
     char *user_agent;
 #if FF_API_HTTP_USER_AGENT
     char *user_agent_deprecated;
@@ -113,8 +127,10 @@ typedef struct HTTPContext {
     int reconnect;
     int reconnect_at_eof;
     int reconnect_streamed;
-    int reconnect_delay;
+    int64_t reconnect_delay;        /* microseconds, before the next attempt */
     int reconnect_delay_max;
+    AVLFG reconnect_lfg;
+    int reconnect_lfg_init;
     int listen;
     char *resource;
     int reply_code;
@@ -124,6 +140,35 @@ typedef struct HTTPContext {
     char *tcp_hook;
     int64_t app_ctx_intptr;
     AVApplicationContext *app_ctx;
+    int http_pool;
+    int http_pool_max_per_host;
+    int http_pool_idle_timeout;
+    /* Set if s->hd is leased from the connection pool. */
+    HTTPPoolConnection *pool_conn;
+    int http2;
+    int http2_weight;
+    /* Set instead of s->hd if the request goes over a shared HTTP/2 connection. */
+    HTTP2Stream *h2;
+    int http3;
+    /* Set instead of s->hd if the request goes through the HTTP/3 transport of the application. */
+    HTTP3Stream *h3;
+    char *mirrors;
+    int mirror_stall_timeout;
+    /* Set if the request goes to mirrors: the http context of the one the
+     * response is read from, the others of mirror_urls failed over to. */
+    URLContext *mirror;
+    char *mirror_urls[MIRROR_MAX_CANDIDATES];
+    int nb_mirror_urls;
+    int mirror_index;
+    unsigned mirror_tried;  /* of mirror_urls, since the last read */
+    /* the request being timed for the application, see http_request_begin(),
+     * av_gettime_relative() of its steps, request_start 0 without one */
+    AVAppHttpRequest request;
+    int64_t request_start;
+    int64_t request_connected;
+    int64_t request_sent;
+    int64_t request_first_byte;
+    int64_t request_last_byte;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -144,6 +189,11 @@ static const AVOption options[] = {
     { "multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the ETag of the response", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the Last-Modified date of the response", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "http_code", "export the status code of the response", OFFSET(http_code), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 999, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "if_none_match", "send If-None-Match, a 304 response reads as empty", OFFSET(if_none_match), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "if_modified_since", "send If-Modified-Since, a 304 response reads as empty", OFFSET(if_modified_since), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     { "icy_metadata_headers", "return ICY metadata headers", OFFSET(icy_metadata_headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT },
@@ -166,6 +216,14 @@ static const AVOption options[] = {
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "http-tcp-hook", "hook protocol on tcp", OFFSET(tcp_hook), AV_OPT_TYPE_STRING, { .str = "tcp" }, 0, 0, D | E },
     { "ijkapplication", "AVApplicationContext", OFFSET(app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, .flags = D },
+    { "http_pool", "share persistent connections with other http contexts of the process", OFFSET(http_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "http_pool_max_per_host", "max idle pooled connections per host", OFFSET(http_pool_max_per_host), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, INT_MAX, D },
+    { "http_pool_idle_timeout", "close pooled connections idle for longer (in milliseconds)", OFFSET(http_pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 15000 }, 0, INT_MAX, D },
+    { "http2", "send https GET and HEAD requests over HTTP/2 connections shared by the process, if the server speaks it", OFFSET(http2), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "http2_weight", "priority of the request against the others of its HTTP/2 connection", OFFSET(http2_weight), AV_OPT_TYPE_INT, { .i64 = 16 }, 1, 256, D },
+    { "http3", "send https GET and HEAD requests through the HTTP/3 transport of the application, if one is registered", OFFSET(http3), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "mirrors", "origins serving the same paths, separated by '|', raced at open and failed over to", OFFSET(mirrors), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "mirror_stall_timeout", "fail over from a mirror silent for longer (in milliseconds)", OFFSET(mirror_stall_timeout), AV_OPT_TYPE_INT, { .i64 = 2000 }, 0, INT_MAX, D },
     { NULL }
 };
 
@@ -184,6 +242,174 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static void http_on_pool_statistic(HTTPContext *s, int is_reused)
+{
+    AVAppHttpPoolStatistic event = {0};
+    HTTPPoolStatistic      stat;
+
+    if (!s->app_ctx)
+        return;
+
+    ff_http_pool_get_statistic(&stat);
+    event.size      = sizeof(event);
+    event.is_reused = is_reused;
+    event.opened    = stat.opened;
+    event.reused    = stat.reused;
+    event.idle      = stat.idle;
+    av_application_on_http_pool_statistic(s->app_ctx, &event);
+}
+
+/* report the request timed, if any, to the application */
+static void http_request_done(URLContext *h, int error, int is_complete)
+{
+    HTTPContext *s = h->priv_data;
+    AVAppHttpRequest *r = &s->request;
+
+    if (!s->request_start)
+        return;
+    s->request_start = 0;
+
+    if (s->location)
+        av_strlcpy(r->url, s->location, sizeof(r->url));
+    r->http_code   = s->request_first_byte ? s->http_code : 0;
+    r->error       = error;
+    r->is_complete = is_complete;
+    if (s->request_sent)
+        r->send_time = s->request_sent - s->request_connected;
+    if (s->request_sent && s->request_first_byte) {
+        r->wait_time    = s->request_first_byte - s->request_sent;
+        r->receive_time = s->request_last_byte - s->request_first_byte;
+    }
+    av_application_on_http_request(s->app_ctx, r);
+}
+
+static void http_request_begin(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    // a response still open is given up on
+    http_request_done(h, 0, 0);
+    if (!s->app_ctx)
+        return;
+
+    memset(&s->request, 0, sizeof(s->request));
+    s->request.size       = sizeof(s->request);
+    s->request.offset     = s->off;
+    s->request.age        = -1;
+    s->request.start_time = av_gettime();
+    s->request_start      = av_gettime_relative();
+    s->request_connected  = s->request_sent = 0;
+    s->request_first_byte = s->request_last_byte = 0;
+}
+
+/* the steps of the connection, opened since start unless reused */
+static void http_request_connected(URLContext *h, const char *lower_proto, int reused, int64_t start)
+{
+    HTTPContext *s = h->priv_data;
+    AVAppHttpRequest *r = &s->request;
+    int64_t now = av_gettime_relative();
+
+    if (!s->request_start)
+        return;
+    s->request_connected = now;
+    r->is_reused    = reused;
+    r->dns_time     = r->connect_time = r->tls_time = 0;
+    if (s->h3 || s->h2) {
+        av_strlcpy(r->protocol, s->h3 ? "h3" : "h2", sizeof(r->protocol));
+        r->connect_time = now - start;
+        return;
+    }
+    av_strlcpy(r->protocol, "http/1.1", sizeof(r->protocol));
+    if (reused)
+        return;
+    // exported by the tcp and tls protocols, the handshake is the rest
+    av_opt_get_int(s->hd, "dns_time",     AV_OPT_SEARCH_CHILDREN, &r->dns_time);
+    av_opt_get_int(s->hd, "connect_time", AV_OPT_SEARCH_CHILDREN, &r->connect_time);
+    if (!strcmp(lower_proto, "tls"))
+        r->tls_time = FFMAX(now - start - r->dns_time - r->connect_time, 0);
+}
+
+/* return 1 if the connection was leased from the pool */
+static int http_open_lower(URLContext *h, const char *url, AVDictionary **options, int allow_reuse)
+{
+    HTTPContext *s = h->priv_data;
+    int ret;
+
+    if (s->http_pool) {
+        ret = ff_http_pool_open(&s->pool_conn, url, allow_reuse,
+                                &h->interrupt_callback, s->app_ctx, options,
+                                h->protocol_whitelist, h->protocol_blacklist, h);
+        if (ret < 0)
+            return ret;
+        s->hd = s->pool_conn->hd;
+        http_on_pool_statistic(s, ret);
+        return ret;
+    }
+
+    av_dict_set_int(options, "ijkapplication", (int64_t)(intptr_t)s->app_ctx, 0);
+    ret = ffurl_open_whitelist(&s->hd, url, AVIO_FLAG_READ_WRITE,
+                               &h->interrupt_callback, options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    return ret < 0 ? ret : 0;
+}
+
+/* the connection can serve another request once the response is consumed */
+static int http_cnx_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    // chunked bodies are not tracked to their trailer, never reuse them
+    return s->pool_conn && !s->willclose && !s->post_data &&
+           !(h->flags & AVIO_FLAG_WRITE) &&
+           ((s->http_code >= 200 && s->http_code < 300) || s->http_code == 304) &&
+           s->chunksize == UINT64_MAX && s->filesize != UINT64_MAX &&
+           s->off == target_end && s->buf_ptr == s->buf_end;
+}
+
+/* HTTP/2 or HTTP/3 for requests without a body to https servers, unless proxied */
+static int http_use_multiplexed(URLContext *h, const char *lower_proto)
+{
+    HTTPContext *s = h->priv_data;
+
+    return !strcmp(lower_proto, "tls") && !s->listen &&
+           !(h->flags & AVIO_FLAG_WRITE) && !s->post_data &&
+           (!s->method || !strcmp(s->method, "GET") || !strcmp(s->method, "HEAD"));
+}
+
+/* ffurl_read() of the connection or of the HTTP/2 or HTTP/3 stream, 0 at the end */
+static int http_lower_read(HTTPContext *s, uint8_t *buf, int size)
+{
+    int ret;
+
+    if (s->h3)
+        ret = ff_http3_read(s->h3, buf, size);
+    else if (s->h2)
+        ret = ff_http2_read(s->h2, buf, size);
+    else
+        return ffurl_read(s->hd, buf, size);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+static void http_close_cnx(URLContext *h, int reusable)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    http_request_done(h, 0, target_end != UINT64_MAX && s->off >= target_end);
+    if (s->h3) {
+        ff_http3_close(&s->h3);
+    } else if (s->h2) {
+        ff_http2_close(&s->h2);
+    } else if (s->pool_conn) {
+        ff_http_pool_release(&s->pool_conn, reusable, s->http_pool_max_per_host,
+                             (int64_t)s->http_pool_idle_timeout * 1000);
+        s->hd = NULL;
+    } else if (s->hd) {
+        ffurl_closep(&s->hd);
+    }
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -192,8 +418,14 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char path1[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
     int port, use_proxy, err, location_changed = 0;
+    int reused = 0, kept;
     char prev_location[4096];
     HTTPContext *s = h->priv_data;
+    uint64_t off = s->off;
+    int64_t start;
+
+    http_request_begin(h);
+    start = av_gettime_relative();
 
     lower_proto = s->tcp_hook;
 
@@ -232,18 +464,44 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
-    if (!s->hd) {
-        av_dict_set_int(options, "ijkapplication", (int64_t)(intptr_t)s->app_ctx, 0);
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
-        if (err < 0)
+    if (!s->hd && !s->h2 && !s->h3 && s->http3 && http_use_multiplexed(h, lower_proto)) {
+        err = ff_http3_open(&s->h3, &h->interrupt_callback, s->app_ctx);
+        if (err < 0 && err != AVERROR(ENOPROTOOPT))
             return err;
     }
+    if (!s->hd && !s->h2 && !s->h3 && s->http2 && http_use_multiplexed(h, lower_proto)) {
+        err = ff_http2_open(&s->h2, buf, s->http2_weight, &h->interrupt_callback, options,
+                            h->protocol_whitelist, h->protocol_blacklist, h);
+        if (err < 0 && err != AVERROR(ENOPROTOOPT))
+            return err;
+    }
+    kept = !!s->hd;
+    if (!s->hd && !s->h2 && !s->h3) {
+        reused = http_open_lower(h, buf, options, 1);
+        if (reused < 0)
+            return reused;
+    }
+    http_request_connected(h, lower_proto, kept || reused > 0, start);
 
     av_strlcpy(prev_location, s->location, sizeof(prev_location));
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    if (err < 0 && reused > 0 && err != AVERROR_EXIT) {
+        /* the server may have dropped the idle connection meanwhile */
+        av_log(h, AV_LOG_VERBOSE, "Pooled connection to %s failed, opening a new one\n", buf);
+        http_request_done(h, err, 0);
+        http_close_cnx(h, 0);
+        s->off = off;
+        location_changed = 0;
+        http_request_begin(h);
+        start = av_gettime_relative();
+        err = http_open_lower(h, buf, options, 0);
+        if (err < 0)
+            return err;
+        http_request_connected(h, lower_proto, 0, start);
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
+    }
     if (err < 0)
         return err;
 
@@ -255,7 +513,7 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
 {
     HTTPAuthType cur_auth_type, cur_proxy_auth_type;
     HTTPContext *s = h->priv_data;
-    int location_changed, attempts = 0, redirects = 0;
+    int location_changed, attempts = 0, redirects = 0, err;
 redo:
     av_dict_copy(options, s->chained_options, 0);
 
@@ -270,7 +528,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(h, 0);
             goto redo;
         } else
             goto fail;
@@ -278,7 +536,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(h, 0);
             goto redo;
         } else
             goto fail;
@@ -287,7 +545,7 @@ redo:
          s->http_code == 303 || s->http_code == 307) &&
         location_changed == 1) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_close_cnx(h, 0);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
         /* Restart the authentication process with the new target, which
@@ -300,11 +558,10 @@ redo:
     return 0;
 
 fail:
-    if (s->hd)
-        ffurl_closep(&s->hd);
-    if (location_changed < 0)
-        return location_changed;
-    return ff_http_averror(s->http_code, AVERROR(EIO));
+    err = location_changed < 0 ? location_changed : ff_http_averror(s->http_code, AVERROR(EIO));
+    http_request_done(h, err, 0);
+    http_close_cnx(h, 0);
+    return err;
 }
 
 int ff_http_do_new_request(URLContext *h, const char *uri)
@@ -489,6 +746,178 @@ fail:
     return ret;
 }
 
+/* the options of this request, for the same one to a mirror */
+static int http_mirror_options(URLContext *h, AVDictionary **options)
+{
+    static const char *const skipped[] = {
+        "location", "offset", "mirrors", "reconnect", "listen", "resource",
+    };
+    HTTPContext *s = h->priv_data;
+    const AVOption *o = NULL;
+    AVDictionaryEntry *e;
+    int ret = av_dict_copy(options, s->chained_options, 0);
+
+    while (ret >= 0 && (o = av_opt_next(s, o))) {
+        uint8_t *val = NULL;
+        int i;
+
+        if (!(o->flags & D) || (o->flags & (AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY)) ||
+            o->type == AV_OPT_TYPE_CONST)
+            continue;
+        for (i = 0; i < FF_ARRAY_ELEMS(skipped) && strcmp(o->name, skipped[i]); i++)
+            ;
+        if (i < FF_ARRAY_ELEMS(skipped))
+            continue;
+        if ((ret = av_opt_get(s, o->name, AV_OPT_ALLOW_NULL, &val)) < 0 || !val)
+            continue;
+        ret = av_dict_set(options, o->name, (char *)val, AV_DICT_DONT_STRDUP_VAL);
+    }
+    if (ret < 0)
+        return ret;
+
+    if (h->rw_timeout)
+        av_dict_set_int(options, "rw_timeout", h->rw_timeout, 0);
+    av_dict_set_int(options, "offset", s->off, 0);
+    // a stall shows as a timeout of the socket
+    e = av_dict_get(*options, "timeout", NULL, 0);
+    if (s->mirror_stall_timeout > 0 &&
+        (!e || strtoll(e->value, NULL, 10) < 0 ||
+         strtoll(e->value, NULL, 10) > s->mirror_stall_timeout * 1000LL))
+        av_dict_set_int(options, "timeout", s->mirror_stall_timeout * 1000LL, 0);
+    return 0;
+}
+
+static int http_mirror_copy_string(char **dst, const char *src)
+{
+    char *copy = NULL;
+
+    if (src && !(copy = av_strdup(src)))
+        return AVERROR(ENOMEM);
+    av_free(*dst);
+    *dst = copy;
+    return 0;
+}
+
+/* the response of the mirror as this one's, its location left as requested */
+static int http_mirror_adopt(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPContext *m = s->mirror->priv_data;
+    int ret;
+
+    s->http_code   = m->http_code;
+    s->filesize    = m->filesize;
+    s->off         = m->off;
+    h->is_streamed = s->mirror->is_streamed;
+    if ((ret = http_mirror_copy_string(&s->mime_type, m->mime_type)) < 0 ||
+        (ret = http_mirror_copy_string(&s->etag, m->etag)) < 0 ||
+        (ret = http_mirror_copy_string(&s->last_modified, m->last_modified)) < 0 ||
+        (ret = http_mirror_copy_string(&s->cookies, m->cookies)) < 0)
+        return ret;
+    return 0;
+}
+
+/* open the untried ones by rank, the first ones nb_racers at once, until
+ * one opens */
+static int http_mirror_connect(URLContext *h, int nb_racers, int reason, int error)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    char *urls[MIRROR_MAX_CANDIDATES];
+    int indexes[MIRROR_MAX_CANDIDATES];
+    int ret = AVERROR(EIO), nb = 0, i, k, winner;
+
+    for (i = 0; i < s->nb_mirror_urls; i++) {
+        if (!(s->mirror_tried & (1U << i))) {
+            indexes[nb] = i;
+            urls[nb++]  = s->mirror_urls[i];
+        }
+    }
+
+    for (i = 0; i < nb; i += k, nb_racers = 1) {
+        int64_t start = av_gettime_relative();
+
+        k = FFMIN(nb_racers, nb - i);
+        av_dict_free(&options);
+        if ((ret = http_mirror_options(h, &options)) < 0)
+            break;
+        ret = ff_http_mirror_race(&s->mirror, &winner, urls + i, k, h->flags,
+                                  &h->interrupt_callback, options,
+                                  h->protocol_whitelist, h->protocol_blacklist);
+        if (ret >= 0) {
+            AVAppHttpMirror event = { 0 };
+
+            s->mirror_index  = indexes[i + winner];
+            s->mirror_tried |= 1U << s->mirror_index;
+            event.size    = sizeof(event);
+            event.reason  = reason;
+            event.error   = error;
+            event.offset  = s->off;
+            event.elapsed = av_gettime_relative() - start;
+            av_strlcpy(event.url, urls[i + winner], sizeof(event.url));
+            av_application_on_http_mirror(s->app_ctx, &event);
+            break;
+        }
+        for (winner = 0; winner < k; winner++)
+            s->mirror_tried |= 1U << indexes[i + winner];
+        if (ret == AVERROR_EXIT)
+            break;
+    }
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+    return http_mirror_adopt(h);
+}
+
+/* continue at s->off on the next one */
+static int http_mirror_failover(URLContext *h, int error)
+{
+    HTTPContext *s = h->priv_data;
+    const char *url = s->mirror_urls[s->mirror_index];
+
+    av_log(h, AV_LOG_WARNING, "Mirror %s failed at offset %"PRIu64": %s\n",
+           url, s->off, av_err2str(error));
+    ff_http_mirror_report(url, 0, error);
+    ff_http_mirror_race_release(&s->mirror);
+    return http_mirror_connect(h, 1, AVAPP_HTTP_MIRROR_FAILOVER, error);
+}
+
+static void http_mirror_free(HTTPContext *s)
+{
+    int i;
+
+    ff_http_mirror_race_release(&s->mirror);
+    for (i = 0; i < s->nb_mirror_urls; i++)
+        av_freep(&s->mirror_urls[i]);
+    s->nb_mirror_urls = 0;
+}
+
+static int http_mirror_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+    int ret;
+
+    for (;;) {
+        if (!s->mirror)
+            return AVERROR(EIO);
+        ret = ffurl_read(s->mirror, buf, size);
+        if (ret > 0) {
+            s->off         += ret;
+            s->mirror_tried = 1U << s->mirror_index;
+            return ret;
+        }
+        if (ret == AVERROR_EXIT)
+            return ret;
+        // the end, unless it came before the one announced
+        if ((!ret || ret == AVERROR_EOF) &&
+            (target_end == UINT64_MAX || s->off >= target_end))
+            return ret;
+        if ((ret = http_mirror_failover(h, ret ? ret : AVERROR_EOF)) < 0)
+            return ret;
+    }
+}
+
 static int http_open(URLContext *h, const char *uri, int flags,
                      AVDictionary **options)
 {
@@ -526,11 +955,23 @@ static int http_open(URLContext *h, const char *uri, int flags,
     if (s->listen) {
         return http_listen(h, uri, flags, options);
     }
+    if (s->mirrors && *s->mirrors && !(flags & AVIO_FLAG_WRITE) && !s->post_data &&
+        (!s->method || !strcmp(s->method, "GET") || !strcmp(s->method, "HEAD")))
+        s->nb_mirror_urls = ff_http_mirror_rank(uri, s->mirrors, s->mirror_urls);
+    // by itself, if it has no mirror
+    if (s->nb_mirror_urls == 1)
+        http_mirror_free(s);
+
     av_application_will_http_open(s->app_ctx, (void*)h, uri);
-    ret = http_open_cnx(h, options);
+    if (s->nb_mirror_urls)
+        ret = http_mirror_connect(h, 2, AVAPP_HTTP_MIRROR_RACE, 0);
+    else
+        ret = http_open_cnx(h, options);
     av_application_did_http_open(s->app_ctx, (void*)h, uri, ret, s->http_code);
-    if (ret < 0)
+    if (ret < 0) {
+        http_mirror_free(s);
         av_dict_free(&s->chained_options);
+    }
     return ret;
 }
 
@@ -558,7 +999,7 @@ static int http_getc(HTTPContext *s)
 {
     int len;
     if (s->buf_ptr >= s->buf_end) {
-        len = ffurl_read(s->hd, s->buffer, BUFFER_SIZE);
+        len = http_lower_read(s, s->buffer, BUFFER_SIZE);
         if (len < 0) {
             return len;
         } else if (len == 0) {
@@ -566,6 +1007,11 @@ static int http_getc(HTTPContext *s)
         } else {
             s->buf_ptr = s->buffer;
             s->buf_end = s->buffer + len;
+            if (s->request_start) {
+                s->request_last_byte = av_gettime_relative();
+                if (!s->request_first_byte)
+                    s->request_first_byte = s->request_last_byte;
+            }
         }
     }
     return *s->buf_ptr++;
@@ -854,6 +1300,12 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -865,6 +1317,14 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Encoding")) {
             if ((ret = parse_content_encoding(h, p)) < 0)
                 return ret;
+        } else if (!av_strcasecmp(tag, "X-Cache") || !av_strcasecmp(tag, "X-Cache-Status") ||
+                   !av_strcasecmp(tag, "CF-Cache-Status")) {
+            av_strlcpy(s->request.cache_status, p, sizeof(s->request.cache_status));
+        } else if (!av_strcasecmp(tag, "Age")) {
+            s->request.age = strtoll(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "X-Served-By") || !av_strcasecmp(tag, "X-Amz-Cf-Pop") ||
+                   (!av_strcasecmp(tag, "Via") && !s->request.edge[0])) {
+            av_strlcpy(s->request.edge, p, sizeof(s->request.edge));
         }
     }
     return 1;
@@ -1007,6 +1467,12 @@ static int http_read_header(URLContext *h, int *new_location)
     if (s->seekable == -1 && s->is_mediagateway && s->filesize == 2000000000)
         h->is_streamed = 1; /* we can in fact _not_ seek */
 
+    /* not modified, there is no body whatever the headers say */
+    if (s->http_code == 304) {
+        s->filesize  = 0;
+        s->chunksize = UINT64_MAX;
+    }
+
     // add any new cookies into the existing cookie string
     cookie_string(s->cookie_dict, &s->cookies);
     av_dict_free(&s->cookie_dict);
@@ -1090,7 +1556,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests)
+        if (s->multiple_requests || s->http_pool)
             len += av_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         else
@@ -1116,6 +1582,12 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
             av_free(cookies);
         }
     }
+    if (!has_header(s->headers, "\r\nIf-None-Match: ") && s->if_none_match && !post)
+        len += av_strlcatf(headers + len, sizeof(headers) - len,
+                           "If-None-Match: %s\r\n", s->if_none_match);
+    if (!has_header(s->headers, "\r\nIf-Modified-Since: ") && s->if_modified_since && !post)
+        len += av_strlcatf(headers + len, sizeof(headers) - len,
+                           "If-Modified-Since: %s\r\n", s->if_modified_since);
     if (!has_header(s->headers, "\r\nIcy-MetaData: ") && s->icy)
         len += av_strlcatf(headers + len, sizeof(headers) - len,
                            "Icy-MetaData: %d\r\n", 1);
@@ -1148,8 +1620,16 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     }
 
 
-    if ((err = ffurl_write(s->hd, s->buffer, strlen(s->buffer))) < 0)
+    if (s->h3)
+        err = ff_http3_send_request(s->h3, (const char *)s->buffer);
+    else if (s->h2)
+        err = ff_http2_send_request(s->h2, (const char *)s->buffer);
+    else
+        err = ffurl_write(s->hd, s->buffer, strlen(s->buffer));
+    if (err < 0)
         goto done;
+    if (s->request_start)
+        s->request_sent = av_gettime_relative();
 
     if (s->post_data)
         if ((err = ffurl_write(s->hd, s->post_data, s->post_datalen)) < 0)
@@ -1165,6 +1645,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     s->willclose        = 0;
     s->end_chunked_post = 0;
     s->end_header       = 0;
+    av_freep(&s->etag);
+    av_freep(&s->last_modified);
     if (post && !s->post_data && !send_expect_100) {
         /* Pretend that it did work. We didn't read any header yet, since
          * we've still to send the POST data, but the code calling this
@@ -1219,9 +1701,10 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"'\n",
                     s->chunksize);
 
-            if (!s->chunksize)
+            if (!s->chunksize) {
+                http_request_done(h, 0, 1);
                 return 0;
-            else if (s->chunksize == UINT64_MAX) {
+            } else if (s->chunksize == UINT64_MAX) {
                 av_log(h, AV_LOG_ERROR, "Invalid chunk size %"PRIu64"\n",
                        s->chunksize);
                 return AVERROR(EINVAL);
@@ -1239,8 +1722,10 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
         s->buf_ptr += len;
     } else {
         uint64_t target_end = s->end_off ? s->end_off : s->filesize;
-        if ((!s->willclose || s->chunksize == UINT64_MAX) && s->off >= target_end)
+        if ((!s->willclose || s->chunksize == UINT64_MAX) && s->off >= target_end) {
+            http_request_done(h, 0, 1);
             return AVERROR_EOF;
+        }
 
         len = size;
         if (s->filesize > 0 && s->filesize != UINT64_MAX && s->filesize != 2147483647) {
@@ -1249,16 +1734,22 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                 len = (int)unread;
         }
         if (len > 0)
-            len = ffurl_read(s->hd, buf, len);
+            len = http_lower_read(s, buf, len);
         if (!len && (!s->willclose || s->chunksize == UINT64_MAX) && s->off < target_end) {
             av_log(h, AV_LOG_ERROR,
                    "Stream ends prematurely at %"PRIu64", should be %"PRIu64"\n",
                    s->off, target_end
                   );
+            http_request_done(h, AVERROR(EIO), 0);
             return AVERROR(EIO);
         }
+        if (len > 0 && s->request_start)
+            s->request_last_byte = av_gettime_relative();
+        else if (len <= 0)
+            http_request_done(h, len, !len);
     }
     if (len > 0) {
+        s->request.bytes += len;
         s->off += len;
         if (s->chunksize > 0 && s->chunksize != UINT64_MAX) {
             av_assert0(s->chunksize >= len);
@@ -1301,15 +1792,74 @@ static int http_buf_read_compressed(URLContext *h, uint8_t *buf, int size)
 }
 #endif /* CONFIG_ZLIB */
 
-static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int force_reconnect);
+static int http_reopen_cnx(URLContext *h, uint64_t off);
+
+/* sleep in steps, so a player closing the stream is not kept waiting */
+static int http_reconnect_sleep(URLContext *h, int64_t delay)
+{
+    while (delay > 0) {
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        av_usleep(FFMIN(delay, RECONNECT_SLEEP_STEP));
+        delay -= RECONNECT_SLEEP_STEP;
+    }
+    return ff_check_interrupt(&h->interrupt_callback) ? AVERROR_EXIT : 0;
+}
+
+/*
+ * Resume at s->off with a range request, until it works or the backoff
+ * reaches reconnect_delay_max. The first attempt is immediate, the next ones
+ * wait half to all of a doubling delay, so the players of a host that went
+ * away do not all come back at once. Each attempt is an http open event.
+ */
+static int http_reconnect(URLContext *h, int read_ret)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target = h->is_streamed ? 0 : s->off;
+    int64_t start, sleep;
+    int ret;
+
+    if (!s->reconnect_lfg_init) {
+        av_lfg_init(&s->reconnect_lfg, av_get_random_seed());
+        s->reconnect_lfg_init = 1;
+    }
+
+    for (;;) {
+        if (s->reconnect_delay > (int64_t)s->reconnect_delay_max * 1000000)
+            return AVERROR(EIO);
+
+        sleep = s->reconnect_delay / 2;
+        if (sleep)
+            sleep += av_lfg_get(&s->reconnect_lfg) % (s->reconnect_delay - sleep + 1);
+        av_log(h, AV_LOG_INFO, "Will reconnect at %"PRIu64" in %"PRId64" ms, error=%s.\n",
+               target, sleep / 1000, av_err2str(read_ret));
+        if ((ret = http_reconnect_sleep(h, sleep)) < 0)
+            return ret;
+        s->reconnect_delay = FFMAX(2 * s->reconnect_delay, RECONNECT_DELAY_MIN);
+
+        start = av_gettime_relative();
+        av_application_will_http_open(s->app_ctx, (void*)h, s->location);
+        ret = http_reopen_cnx(h, target);
+        av_application_did_http_open(s->app_ctx, (void*)h, s->location, ret, s->http_code);
+        if (!ret) {
+            av_log(h, AV_LOG_INFO, "Reconnected at %"PRIu64" in %"PRId64" ms.\n",
+                   target, (av_gettime_relative() - start) / 1000);
+            return 0;
+        }
+        av_log(h, AV_LOG_WARNING, "Failed to reconnect at %"PRIu64": %s.\n", target, av_err2str(ret));
+        /* the server answered, it will answer the same again */
+        if (ret == AVERROR_EXIT ||
+            (s->http_code >= 400 && s->http_code < 500 && s->http_code != 408 && s->http_code != 429))
+            return ret;
+    }
+}
 
 static int http_read_stream(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
     int err, new_location, read_ret;
-    int64_t seek_ret;
 
-    if (!s->hd)
+    if (!s->hd && !s->h2 && !s->h3)
         return AVERROR_EOF;
 
     if (s->end_chunked_post && !s->end_header) {
@@ -1323,24 +1873,18 @@ static int http_read_stream(URLContext *h, uint8_t *buf, int size)
         return http_buf_read_compressed(h, buf, size);
 #endif /* CONFIG_ZLIB */
     read_ret = http_buf_read(h, buf, size);
-    if (   (read_ret  < 0 && s->reconnect        && (!h->is_streamed || s->reconnect_streamed) && s->filesize > 0 && s->off < s->filesize)
-        || (read_ret == 0 && s->reconnect_at_eof && (!h->is_streamed || s->reconnect_streamed))) {
-        uint64_t target = h->is_streamed ? 0 : s->off;
-
-        if (s->reconnect_delay > s->reconnect_delay_max)
-            return AVERROR(EIO);
-
-        av_log(h, AV_LOG_INFO, "Will reconnect at %"PRIu64" error=%s.\n", s->off, av_err2str(read_ret));
-        av_usleep(1000U*1000*s->reconnect_delay);
-        s->reconnect_delay = 1 + 2*s->reconnect_delay;
-        seek_ret = http_seek_internal(h, target, SEEK_SET, 1);
-        if (seek_ret != target) {
-            av_log(h, AV_LOG_ERROR, "Failed to reconnect at %"PRIu64".\n", target);
+    /* ride out the drop here: a reader above, as the async ring, keeps its
+     * data and goes on from the byte it stopped at */
+    while (   (read_ret  < 0 && read_ret != AVERROR_EXIT && s->reconnect && (!h->is_streamed || s->reconnect_streamed) && s->filesize > 0 && s->off < s->filesize)
+           || (read_ret == 0 && s->reconnect_at_eof && (!h->is_streamed || s->reconnect_streamed))) {
+        err = http_reconnect(h, read_ret);
+        if (err == AVERROR_EXIT)
+            return err;
+        if (err < 0)
             return read_ret;
-        }
-
         read_ret = http_buf_read(h, buf, size);
-    } else
+    }
+    if (read_ret > 0)
         s->reconnect_delay = 0;
 
     return read_ret;
@@ -1428,6 +1972,9 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+    if (s->nb_mirror_urls)
+        return http_mirror_read(h, buf, size);
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1489,6 +2036,12 @@ static int http_close(URLContext *h)
     int ret = 0;
     HTTPContext *s = h->priv_data;
 
+    if (s->nb_mirror_urls) {
+        http_mirror_free(s);
+        av_dict_free(&s->chained_options);
+        return 0;
+    }
+
 #if CONFIG_ZLIB
     inflateEnd(&s->inflate_stream);
     av_freep(&s->inflate_buffer);
@@ -1498,26 +2051,96 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
-    if (s->hd)
-        ffurl_closep(&s->hd);
+    http_close_cnx(h, http_cnx_reusable(h));
     av_dict_free(&s->chained_options);
     return ret;
 }
 
-static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int force_reconnect)
+/* Reopen at off, on a pooled connection if any. The old one is kept if it
+ * fails. A server ignoring the range fails too, never resending bytes. */
+static int http_reopen_cnx(URLContext *h, uint64_t off)
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPPoolConnection *old_pool_conn = s->pool_conn;
+    HTTP2Stream *old_h2 = s->h2;
+    HTTP3Stream *old_h3 = s->h3;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
     AVDictionary *options = NULL;
 
+    /* we save the old context in case the seek fails */
+    old_buf_size = s->buf_end - s->buf_ptr;
+    memcpy(old_buf, s->buf_ptr, old_buf_size);
+    s->hd        = NULL;
+    s->pool_conn = NULL;
+    s->h2        = NULL;
+    s->h3        = NULL;
+    s->off       = off;
+
+    /* if it fails, continue on old connection */
+    ret = http_open_cnx(h, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        memcpy(s->buffer, old_buf, old_buf_size);
+        s->buf_ptr = s->buffer;
+        s->buf_end = s->buffer + old_buf_size;
+        s->hd        = old_hd;
+        s->pool_conn = old_pool_conn;
+        s->h2        = old_h2;
+        s->h3        = old_h3;
+        s->off       = old_off;
+        return ret;
+    }
+    /* the old response was abandoned halfway, the connection is unusable */
+    if (old_h3)
+        ff_http3_close(&old_h3);
+    else if (old_h2)
+        ff_http2_close(&old_h2);
+    else if (old_pool_conn)
+        ff_http_pool_release(&old_pool_conn, 0, 0, 0);
+    else
+        ffurl_close(old_hd);
+    return 0;
+}
+
+/* on the same one, another one if it fails */
+static int64_t http_mirror_seek(URLContext *h, int64_t off)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t old_off = s->off;
+    int64_t ret = AVERROR(EIO);
+
+    av_application_will_http_seek(s->app_ctx, (void*)h, s->location, off);
+    if (s->mirror)
+        ret = ffurl_seek(s->mirror, off, SEEK_SET);
+    else
+        s->mirror_tried = 0;    // all failed before, each gets another chance
+    if (ret >= 0) {
+        s->off = off;
+    } else if (ret != AVERROR_EXIT) {
+        s->off = off;
+        if (s->mirror)
+            ret = http_mirror_failover(h, ret);
+        else
+            ret = http_mirror_connect(h, 1, AVAPP_HTTP_MIRROR_FAILOVER, ret);
+        if (ret < 0)
+            s->off = old_off;
+    }
+    av_application_did_http_seek(s->app_ctx, (void*)h, s->location, off, ret < 0 ? ret : 0, s->http_code);
+    return ret < 0 ? ret : off;
+}
+
+static int64_t http_seek(URLContext *h, int64_t off, int whence)
+{
+    HTTPContext *s = h->priv_data;
+    int ret;
+
     if (whence == AVSEEK_SIZE)
         return s->filesize;
-    else if (!force_reconnect &&
-             ((whence == SEEK_CUR && off == 0) ||
-              (whence == SEEK_SET && off == s->off)))
+    else if ((whence == SEEK_CUR && off == 0) ||
+             (whence == SEEK_SET && off == s->off))
         return s->off;
     else if ((s->filesize == UINT64_MAX && whence == SEEK_END))
         return AVERROR(ENOSYS);
@@ -1530,48 +2153,37 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         return AVERROR(EINVAL);
     if (off < 0)
         return AVERROR(EINVAL);
-    s->off = off;
 
-    if (s->off && h->is_streamed)
+    if (off && h->is_streamed)
         return AVERROR(ENOSYS);
 
-    /* we save the old context in case the seek fails */
-    old_buf_size = s->buf_end - s->buf_ptr;
-    memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    if (s->nb_mirror_urls)
+        return http_mirror_seek(h, off);
 
-    /* if it fails, continue on old connection */
     av_application_will_http_seek(s->app_ctx, (void*)h, s->location, off);
-    if ((ret = http_open_cnx(h, &options)) < 0) {
-        av_application_did_http_seek(s->app_ctx, (void*)h, s->location, off, ret, s->http_code);
-        av_dict_free(&options);
-        memcpy(s->buffer, old_buf, old_buf_size);
-        s->buf_ptr = s->buffer;
-        s->buf_end = s->buffer + old_buf_size;
-        s->hd      = old_hd;
-        s->off     = old_off;
-        return ret;
-    }
+    ret = http_reopen_cnx(h, off);
     av_application_did_http_seek(s->app_ctx, (void*)h, s->location, off, ret, s->http_code);
-    av_dict_free(&options);
-    ffurl_close(old_hd);
-    return off;
-}
-
-static int64_t http_seek(URLContext *h, int64_t off, int whence)
-{
-    return http_seek_internal(h, off, whence, 0);
+    return ret < 0 ? ret : off;
 }
 
 static int http_get_file_handle(URLContext *h)
 {
     HTTPContext *s = h->priv_data;
+    if (s->nb_mirror_urls)
+        return s->mirror ? ffurl_get_file_handle(s->mirror) : -1;
+    // an HTTP/2 or HTTP/3 stream has no socket of its own
+    if (s->h2 || s->h3)
+        return -1;
     return ffurl_get_file_handle(s->hd);
 }
 
 static int http_get_short_seek(URLContext *h)
 {
     HTTPContext *s = h->priv_data;
+    if (s->nb_mirror_urls)
+        return s->mirror ? ffurl_get_short_seek(s->mirror) : AVERROR(ENOSYS);
+    if (s->h2 || s->h3)
+        return AVERROR(ENOSYS);
     return ffurl_get_short_seek(s->hd);
 }
 
@@ -1601,7 +2213,7 @@ const URLProtocol ff_http_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &http_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy"
+    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,cache,httpproxy"
 };
 #endif /* CONFIG_HTTP_PROTOCOL */
 
@@ -1621,7 +2233,7 @@ const URLProtocol ff_https_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &https_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy"
+    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,cache,httpproxy"
 };
 #endif /* CONFIG_HTTPS_PROTOCOL */
 
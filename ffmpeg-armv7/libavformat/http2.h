@@ -0,0 +1,82 @@
+/*
+ * HTTP/2 client sessions shared by the http contexts of the process
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP2_H
+#define AVFORMAT_HTTP2_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "url.h"
+
+/**
+ * One request on an HTTP/2 connection (RFC 7540) to an origin, which all
+ * the requests of the process to that origin share: the playlist reloads,
+ * the segments and the prefetches of a player are multiplexed instead of
+ * queueing for a connection each.
+ *
+ * The stream speaks HTTP/1.1 to its caller, so http.c keeps its logic: the
+ * request head it would have written is translated into a HEADERS frame,
+ * and the response head is read back as an HTTP/1.1 status line and header
+ * lines, followed by the body. The connection is read by a thread of the
+ * session, which fills the streams as their frames come.
+ */
+typedef struct HTTP2Stream HTTP2Stream;
+
+/**
+ * Open a stream on the session to url, the lower protocol url of the
+ * origin ("tls://host:443"), connecting it first if there is none.
+ *
+ * @param weight  the priority of the stream against the others of the
+ *                session, 1 to 256
+ * @param int_cb  copied, checked while connecting and reading
+ * @param options of the lower protocol, used when connecting
+ * @return 0, AVERROR(ENOPROTOOPT) if the origin does not speak HTTP/2, in
+ *         which case HTTP/1.1 is to be used, another negative AVERROR on
+ *         failure
+ */
+int ff_http2_open(HTTP2Stream **pstream, const char *url, int weight,
+                  const AVIOInterruptCB *int_cb, AVDictionary **options,
+                  const char *whitelist, const char *blacklist,
+                  URLContext *parent);
+
+/**
+ * Send the request, once per stream.
+ *
+ * @param request an HTTP/1.1 request head without a body, up to the blank
+ *                line; hop by hop header fields are dropped
+ */
+int ff_http2_send_request(HTTP2Stream *stream, const char *request);
+
+/**
+ * Read the response: the head, then the body.
+ *
+ * @return the number of bytes read, AVERROR_EOF at the end of the
+ *         response, a negative AVERROR if the stream or the connection
+ *         failed
+ */
+int ff_http2_read(HTTP2Stream *stream, uint8_t *buf, int size);
+
+/**
+ * Close the stream, cancelling the response if it is not over.
+ */
+void ff_http2_close(HTTP2Stream **pstream);
+
+#endif /* AVFORMAT_HTTP2_H */
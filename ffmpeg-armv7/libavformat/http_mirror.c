@@ -0,0 +1,423 @@
+/*
+ * Racing and failover between mirrors of an http resource
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "http_mirror.h"
+#include "internal.h"
+
+#define MIRROR_MAX_ORIGINS      32
+#define MIRROR_RACERS           2
+#define MIRROR_MIN_WEIGHT       0.25        // below, the time to the response head is unknown
+#define MIRROR_MAX_WEIGHT       8.0         // opens a mean stands for at most, so it keeps up
+#define MIRROR_FAILURE_COST     1000000.0   // microseconds a failure ranks an origin down by
+#define MIRROR_WAIT_INTERVAL    100000
+/* the ones left to finish get as long again as the winner took, and this */
+#define MIRROR_GRACE            200000
+
+typedef struct MirrorScore {
+    char    origin[256];
+    int64_t update_time;    // av_gettime_relative() the weights were decayed to, 0 if unused
+    double  elapsed;        // mean microseconds to the response head
+    double  weight;         // opens, decayed
+    double  failures;       // decayed
+} MirrorScore;
+
+static pthread_mutex_t score_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MirrorScore     scores[MIRROR_MAX_ORIGINS];
+
+/* "proto://host[:port]" of url, and its path */
+static int mirror_split(const char *url, char *origin, int origin_size, char *path, int path_size)
+{
+    char proto[16], host[256];
+    int  port;
+
+    av_url_split(proto, sizeof(proto), NULL, 0, host, sizeof(host), &port,
+                 path, path_size, url);
+    if (!host[0] || (strcmp(proto, "http") && strcmp(proto, "https")))
+        return AVERROR(EINVAL);
+    ff_url_join(origin, origin_size, proto, NULL, host, port, NULL);
+    return 0;
+}
+
+static void score_decay_locked(MirrorScore *score, int64_t now)
+{
+    double factor;
+
+    if (now <= score->update_time)
+        return;
+
+    factor = exp2(-(double)(now - score->update_time) / MIRROR_HALF_LIFE);
+    score->weight      *= factor;
+    score->failures    *= factor;
+    score->update_time  = now;
+}
+
+// the score of origin, the least recently updated one replaced if it is new
+static MirrorScore *score_find_locked(const char *origin, int add)
+{
+    MirrorScore *oldest = NULL;
+    int i;
+
+    for (i = 0; i < MIRROR_MAX_ORIGINS; i++) {
+        MirrorScore *score = &scores[i];
+        if (score->update_time && !strcmp(score->origin, origin))
+            return score;
+        if (!oldest || score->update_time < oldest->update_time)
+            oldest = score;
+    }
+    if (!add)
+        return NULL;
+
+    memset(oldest, 0, sizeof(*oldest));
+    av_strlcpy(oldest->origin, origin, sizeof(oldest->origin));
+    return oldest;
+}
+
+/* microseconds, 0 if never measured */
+static double score_cost_locked(const char *origin, int64_t now)
+{
+    MirrorScore *score = score_find_locked(origin, 0);
+    double       cost  = 0;
+
+    if (!score)
+        return 0;
+    score_decay_locked(score, now);
+    if (score->weight >= MIRROR_MIN_WEIGHT)
+        cost = score->elapsed;
+    return cost + score->failures * MIRROR_FAILURE_COST;
+}
+
+void ff_http_mirror_report(const char *url, int64_t elapsed, int error)
+{
+    char         origin[256], path[8];
+    int64_t      now = av_gettime_relative();
+    MirrorScore *score;
+
+    if (mirror_split(url, origin, sizeof(origin), path, sizeof(path)) < 0)
+        return;
+
+    pthread_mutex_lock(&score_mutex);
+    score = score_find_locked(origin, 1);
+    if (!score->update_time)
+        score->update_time = now;
+    score_decay_locked(score, now);
+    if (error) {
+        score->failures += 1;
+    } else {
+        score->elapsed = (score->elapsed * score->weight + elapsed) / (score->weight + 1);
+        score->weight  = FFMIN(score->weight + 1, MIRROR_MAX_WEIGHT);
+    }
+    pthread_mutex_unlock(&score_mutex);
+}
+
+int ff_http_mirror_rank(const char *url, const char *mirrors, char **urls)
+{
+    char        origins[MIRROR_MAX_CANDIDATES][256], path[4096];
+    double      costs[MIRROR_MAX_CANDIDATES];
+    const char *p = mirrors;
+    int64_t     now = av_gettime_relative();
+    int         nb = 0, i, j;
+
+    if (mirror_split(url, origins[0], sizeof(origins[0]), path, sizeof(path)) < 0)
+        return 0;
+    nb = 1;
+    while (p && *p && nb < MIRROR_MAX_CANDIDATES) {
+        char mirror[1024], unused[8];
+        int  len = strcspn(p, "|");
+
+        av_strlcpy(mirror, p, FFMIN(len + 1, sizeof(mirror)));
+        p += len + (p[len] == '|');
+        if (mirror_split(mirror, origins[nb], sizeof(origins[nb]), unused, sizeof(unused)) < 0)
+            continue;
+        for (j = 0; j < nb && strcmp(origins[j], origins[nb]); j++)
+            ;
+        if (j == nb)
+            nb++;
+    }
+
+    pthread_mutex_lock(&score_mutex);
+    for (i = 0; i < nb; i++)
+        costs[i] = score_cost_locked(origins[i], now);
+    pthread_mutex_unlock(&score_mutex);
+
+    // by cost, the order of the list kept among equals
+    for (i = 0; i < nb; i++) {
+        int best = i;
+        for (j = i + 1; j < nb; j++) {
+            if (costs[j] < costs[best])
+                best = j;
+        }
+        urls[i] = av_asprintf("%s%s", origins[best], path);
+        if (!urls[i]) {
+            while (i-- > 0)
+                av_freep(&urls[i]);
+            return 0;
+        }
+        if (best != i) {
+            char   origin[256];
+            double cost = costs[best];
+
+            memcpy(origin, origins[best], sizeof(origin));
+            memmove(origins[i + 1], origins[i], sizeof(origins[0]) * (best - i));
+            memmove(&costs[i + 1], &costs[i], sizeof(costs[0]) * (best - i));
+            memcpy(origins[i], origin, sizeof(origin));
+            costs[i] = cost;
+        }
+    }
+    return nb;
+}
+
+typedef struct MirrorRace MirrorRace;
+
+typedef struct MirrorRacer {
+    MirrorRace     *race;
+    char           *url;
+    AVDictionary   *options;
+    URLContext     *uc;         // opened, until taken
+    int             done;
+    int             ret;
+    int64_t         elapsed;
+    int             taken;      // the winner, interrupted by the caller as long as it lives
+} MirrorRacer;
+
+struct MirrorRace {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             refs;       // the caller's and one per thread
+    int             abandoned;  // the caller returned, the others are interrupted at deadline
+    int64_t         start;
+    int64_t         deadline;
+    AVIOInterruptCB int_cb;
+    int             flags;
+    char           *whitelist;
+    char           *blacklist;
+    MirrorRacer     racers[MIRROR_RACERS];
+    int             nb_racers;
+};
+
+static void race_unref(MirrorRace *race)
+{
+    int refs, i;
+
+    pthread_mutex_lock(&race->mutex);
+    refs = --race->refs;
+    pthread_cond_broadcast(&race->cond);
+    pthread_mutex_unlock(&race->mutex);
+    if (refs > 0)
+        return;
+
+    for (i = 0; i < race->nb_racers; i++) {
+        av_free(race->racers[i].url);
+        av_dict_free(&race->racers[i].options);
+    }
+    av_free(race->whitelist);
+    av_free(race->blacklist);
+    pthread_cond_destroy(&race->cond);
+    pthread_mutex_destroy(&race->mutex);
+    av_free(race);
+}
+
+/* interrupt the ones left to finish and wait for them, they may report to
+ * the application through their options */
+static void race_finish(MirrorRace *race)
+{
+    pthread_mutex_lock(&race->mutex);
+    race->deadline = av_gettime_relative();
+    while (race->refs > 1)
+        pthread_cond_wait(&race->cond, &race->mutex);
+    pthread_mutex_unlock(&race->mutex);
+    race_unref(race);
+}
+
+static int racer_interrupt(void *opaque)
+{
+    MirrorRacer *r    = opaque;
+    MirrorRace  *race = r->race;
+    int          ret;
+
+    pthread_mutex_lock(&race->mutex);
+    if (r->taken || !race->abandoned)
+        ret = ff_check_interrupt(&race->int_cb);
+    else
+        ret = av_gettime_relative() > race->deadline;
+    pthread_mutex_unlock(&race->mutex);
+    return ret;
+}
+
+static void *racer_thread(void *arg)
+{
+    MirrorRacer    *r    = arg;
+    MirrorRace     *race = r->race;
+    AVIOInterruptCB cb   = { racer_interrupt, r };
+    URLContext     *uc   = NULL;
+    int64_t         elapsed;
+    int             ret, abandoned;
+
+    ret = ffurl_open_whitelist(&uc, r->url, race->flags, &cb, &r->options,
+                               race->whitelist, race->blacklist, NULL);
+    elapsed = av_gettime_relative() - race->start;
+
+    pthread_mutex_lock(&race->mutex);
+    abandoned  = race->abandoned;
+    r->done    = 1;
+    r->ret     = ret;
+    r->elapsed = elapsed;
+    if (ret >= 0 && !abandoned) {
+        r->uc = uc;
+        uc    = NULL;
+    }
+    pthread_cond_broadcast(&race->cond);
+    pthread_mutex_unlock(&race->mutex);
+
+    // one left to finish was at least as slow as it got to be
+    if (ret >= 0 || (ret == AVERROR_EXIT && abandoned))
+        ff_http_mirror_report(r->url, elapsed, 0);
+    else if (ret != AVERROR_EXIT)
+        ff_http_mirror_report(r->url, 0, ret);
+    ffurl_closep(&uc);
+
+    race_unref(race);
+    return NULL;
+}
+
+int ff_http_mirror_race(URLContext **puc, int *winner, char **urls, int nb_racers,
+                        int flags, const AVIOInterruptCB *int_cb, AVDictionary *options,
+                        const char *whitelist, const char *blacklist)
+{
+    MirrorRace *race;
+    URLContext *losers[MIRROR_RACERS] = { NULL };
+    int         ret = AVERROR(EIO), i, best;
+
+    *puc    = NULL;
+    *winner = -1;
+    nb_racers = FFMIN(nb_racers, MIRROR_RACERS);
+    if (nb_racers <= 0)
+        return AVERROR(EINVAL);
+
+    race = av_mallocz(sizeof(*race));
+    if (!race)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&race->mutex, NULL)) {
+        av_free(race);
+        return AVERROR(ENOMEM);
+    }
+    if (pthread_cond_init(&race->cond, NULL)) {
+        pthread_mutex_destroy(&race->mutex);
+        av_free(race);
+        return AVERROR(ENOMEM);
+    }
+    race->refs      = 1;
+    race->start     = av_gettime_relative();
+    race->flags     = flags;
+    race->nb_racers = nb_racers;
+    if (int_cb)
+        race->int_cb = *int_cb;
+    race->whitelist = whitelist ? av_strdup(whitelist) : NULL;
+    race->blacklist = blacklist ? av_strdup(blacklist) : NULL;
+
+    for (i = 0; i < nb_racers; i++) {
+        MirrorRacer *r = &race->racers[i];
+        pthread_t    thread;
+
+        r->race = race;
+        r->url  = av_strdup(urls[i]);
+        if (!r->url || av_dict_copy(&r->options, options, 0) < 0 ||
+            pthread_create(&thread, NULL, racer_thread, r)) {
+            r->done = 1;
+            r->ret  = AVERROR(ENOMEM);
+            continue;
+        }
+        pthread_detach(thread);
+        pthread_mutex_lock(&race->mutex);
+        race->refs++;
+        pthread_mutex_unlock(&race->mutex);
+    }
+
+    pthread_mutex_lock(&race->mutex);
+    for (;;) {
+        int pending = 0;
+
+        best = -1;
+        for (i = 0; i < nb_racers; i++) {
+            MirrorRacer *r = &race->racers[i];
+            if (!r->done)
+                pending++;
+            else if (r->uc && (best < 0 || r->elapsed < race->racers[best].elapsed))
+                best = i;
+            else if (!r->uc)
+                ret = r->ret;
+        }
+        if (best >= 0 || !pending)
+            break;
+        if (ff_check_interrupt(&race->int_cb)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        {
+            int64_t         t  = av_gettime() + MIRROR_WAIT_INTERVAL;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            pthread_cond_timedwait(&race->cond, &race->mutex, &tv);
+        }
+    }
+
+    race->abandoned = 1;
+    race->deadline  = av_gettime_relative();
+    if (best >= 0) {
+        MirrorRacer *r = &race->racers[best];
+
+        race->deadline = race->start + 2 * r->elapsed + MIRROR_GRACE;
+        r->taken = 1;
+        *puc     = r->uc;
+        *winner  = best;
+        r->uc    = NULL;
+        ret      = 0;
+    }
+    for (i = 0; i < nb_racers; i++) {
+        losers[i] = race->racers[i].uc;
+        race->racers[i].uc = NULL;
+    }
+    pthread_mutex_unlock(&race->mutex);
+
+    for (i = 0; i < nb_racers; i++)
+        ffurl_closep(&losers[i]);
+    // the winner's interrupt callback refers to the race as long as it lives
+    if (best < 0)
+        race_finish(race);
+    return ret;
+}
+
+void ff_http_mirror_race_release(URLContext **puc)
+{
+    MirrorRacer *r;
+
+    if (!*puc)
+        return;
+    r = (*puc)->interrupt_callback.opaque;
+    ffurl_closep(puc);
+    race_finish(r->race);
+}
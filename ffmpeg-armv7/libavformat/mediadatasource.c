@@ -0,0 +1,323 @@
+/*
+ * Media bytes supplied by the application
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * The ijkmediadatasource: protocol, reading an AVMediaDataSource of the
+ * application. A lent buffer is kept until the reader is past it, so the
+ * AVIOContext refills and the short seeks within it cost a memcpy from the
+ * application's memory and nothing else.
+ */
+
+#include <stdlib.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "mediadatasource.h"
+#include "url.h"
+
+/* a reader waiting for bytes checks for an interrupt this often */
+#define MDS_WAIT_INTERVAL 100000
+
+struct AVMediaDataSource {
+    unsigned                    id;
+    AVMediaDataSourceCallbacks  cb;
+    void                       *opaque;
+    int                         refs;       // the creator's and one per reader
+    AVMediaDataSource          *next;       // in the registry, while reachable
+
+    pthread_mutex_t             mutex;
+    pthread_cond_t              cond;
+    unsigned                    generation; // bumped by av_media_data_source_ready()
+};
+
+static pthread_mutex_t     registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AVMediaDataSource  *registry;
+static unsigned            registry_next_id = 1;
+
+static void mds_unref(AVMediaDataSource *s)
+{
+    int refs;
+
+    pthread_mutex_lock(&registry_mutex);
+    refs = --s->refs;
+    pthread_mutex_unlock(&registry_mutex);
+    if (refs > 0)
+        return;
+
+    if (s->cb.close)
+        s->cb.close(s->opaque);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    av_free(s);
+}
+
+AVMediaDataSource *av_media_data_source_create(const AVMediaDataSourceCallbacks *cb,
+                                               void *opaque)
+{
+    AVMediaDataSource *s;
+
+    if (!cb || !cb->read)
+        return NULL;
+
+    s = av_mallocz(sizeof(*s));
+    if (!s)
+        return NULL;
+    if (pthread_mutex_init(&s->mutex, NULL)) {
+        av_free(s);
+        return NULL;
+    }
+    if (pthread_cond_init(&s->cond, NULL)) {
+        pthread_mutex_destroy(&s->mutex);
+        av_free(s);
+        return NULL;
+    }
+    s->cb     = *cb;
+    s->opaque = opaque;
+    s->refs   = 1;
+
+    pthread_mutex_lock(&registry_mutex);
+    s->id    = registry_next_id++;
+    s->next  = registry;
+    registry = s;
+    pthread_mutex_unlock(&registry_mutex);
+
+    return s;
+}
+
+int av_media_data_source_url(AVMediaDataSource *s, char *buf, int buf_size)
+{
+    return snprintf(buf, buf_size, "ijkmediadatasource:%u", s->id);
+}
+
+void av_media_data_source_ready(AVMediaDataSource *s)
+{
+    if (!s)
+        return;
+
+    pthread_mutex_lock(&s->mutex);
+    s->generation++;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+void av_media_data_source_release(AVMediaDataSource **ps)
+{
+    AVMediaDataSource  *s = *ps;
+    AVMediaDataSource **p;
+
+    if (!s)
+        return;
+    *ps = NULL;
+
+    pthread_mutex_lock(&registry_mutex);
+    for (p = &registry; *p; p = &(*p)->next) {
+        if (*p == s) {
+            *p = s->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    mds_unref(s);
+}
+
+typedef struct MediaDataSourceContext {
+    const AVClass      *class;
+    AVMediaDataSource  *src;
+    int64_t             pos;
+
+    /* the buffer lent last, [lent_pos, lent_pos + lent_size) */
+    const uint8_t      *lent;
+    void               *lent_token;
+    int64_t             lent_pos;
+    int                 lent_size;
+} MediaDataSourceContext;
+
+static void mds_give_back(MediaDataSourceContext *c)
+{
+    if (!c->lent)
+        return;
+
+    if (c->src->cb.release)
+        c->src->cb.release(c->src->opaque, c->lent, c->lent_token);
+    c->lent       = NULL;
+    c->lent_token = NULL;
+    c->lent_size  = 0;
+}
+
+static int mds_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    MediaDataSourceContext *c = h->priv_data;
+    AVMediaDataSource      *s;
+    unsigned                id;
+    char                   *end;
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(EINVAL);
+
+    av_strstart(arg, "ijkmediadatasource:", &arg);
+    id = strtoul(arg, &end, 10);
+    if (end == arg || *end)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&registry_mutex);
+    for (s = registry; s; s = s->next) {
+        if (s->id == id) {
+            s->refs++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+    if (!s) {
+        av_log(h, AV_LOG_ERROR, "no media data source %u\n", id);
+        return AVERROR(ENOENT);
+    }
+
+    c->src = s;
+    c->pos = 0;
+    return 0;
+}
+
+/* wait for av_media_data_source_ready() past generation, or an interrupt */
+static int mds_wait(URLContext *h, AVMediaDataSource *s, unsigned generation)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&s->mutex);
+    while (s->generation == generation) {
+        int64_t         t = av_gettime() + MDS_WAIT_INTERVAL;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    return ret;
+}
+
+static int mds_read(URLContext *h, unsigned char *buf, int size)
+{
+    MediaDataSourceContext *c = h->priv_data;
+    AVMediaDataSource      *s = c->src;
+    const uint8_t          *data;
+    void                   *token;
+    unsigned                generation;
+    int                     ret;
+
+    for (;;) {
+        if (c->lent && c->pos >= c->lent_pos && c->pos < c->lent_pos + c->lent_size) {
+            int off = c->pos - c->lent_pos;
+
+            size = FFMIN(size, c->lent_size - off);
+            memcpy(buf, c->lent + off, size);
+            c->pos += size;
+            if (off + size == c->lent_size)
+                mds_give_back(c);
+            return size;
+        }
+        mds_give_back(c);
+
+        pthread_mutex_lock(&s->mutex);
+        generation = s->generation;
+        pthread_mutex_unlock(&s->mutex);
+
+        data  = NULL;
+        token = NULL;
+        ret   = s->cb.read(s->opaque, c->pos, &data, &token);
+        if (ret > 0) {
+            c->lent       = data;
+            c->lent_token = token;
+            c->lent_pos   = c->pos;
+            c->lent_size  = ret;
+            continue;
+        }
+        if (ret == 0)
+            return AVERROR_EOF;
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        ret = mds_wait(h, s, generation);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int64_t mds_seek(URLContext *h, int64_t pos, int whence)
+{
+    MediaDataSourceContext *c = h->priv_data;
+    AVMediaDataSource      *s = c->src;
+    int64_t                 size = s->cb.size ? s->cb.size(s->opaque) : -1;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return size >= 0 ? size : AVERROR(ENOSYS);
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += c->pos;
+        break;
+    case SEEK_END:
+        if (size < 0)
+            return AVERROR(ENOSYS);
+        pos += size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    // a seek within the lent buffer keeps it
+    c->pos = pos;
+    return pos;
+}
+
+static int mds_close(URLContext *h)
+{
+    MediaDataSourceContext *c = h->priv_data;
+
+    mds_give_back(c);
+    mds_unref(c->src);
+    c->src = NULL;
+    return 0;
+}
+
+static const AVClass mds_context_class = {
+    .class_name = "ijkmediadatasource",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+URLProtocol ff_ijkmediadatasource_protocol = {
+    .name                = "ijkmediadatasource",
+    .url_open2           = mds_open,
+    .url_read            = mds_read,
+    .url_seek            = mds_seek,
+    .url_close           = mds_close,
+    .priv_data_size      = sizeof(MediaDataSourceContext),
+    .priv_data_class     = &mds_context_class,
+};
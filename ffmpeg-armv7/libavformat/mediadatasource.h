@@ -0,0 +1,96 @@
+/*
+ * Media bytes supplied by the application
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_MEDIADATASOURCE_H
+#define AVFORMAT_MEDIADATASOURCE_H
+
+#include <stdint.h>
+
+/**
+ * A media data source lets the application hand media bytes it holds in
+ * memory (decrypted, assembled from peers) to players, through the
+ * "ijkmediadatasource:" protocol. The protocol pulls them: the source lends
+ * a read only buffer, which is read in place and given back through
+ * release once the reader is past it or seeks elsewhere. Bytes which are
+ * not there yet are reported as such, and the reader waits until
+ * av_media_data_source_ready() is called.
+ */
+
+typedef struct AVMediaDataSource AVMediaDataSource;
+
+typedef struct AVMediaDataSourceCallbacks {
+    /**
+     * Lend the bytes from pos on, as many as are at hand. Called from the
+     * reading thread, one call at a time per reader.
+     *
+     * @param data  set to the lent bytes, left untouched until release
+     * @param token set to what release gets back, may be left NULL
+     * @return the number of bytes lent, 0 at the end of the media,
+     *         AVERROR(EAGAIN) if the bytes at pos are not there yet,
+     *         another negative AVERROR on failure
+     */
+    int (*read)(void *opaque, int64_t pos, const uint8_t **data, void **token);
+
+    /**
+     * Give back a buffer lent by read, may be NULL.
+     */
+    void (*release)(void *opaque, const uint8_t *data, void *token);
+
+    /**
+     * @return the total size of the media, < 0 if unknown; may be NULL
+     */
+    int64_t (*size)(void *opaque);
+
+    /**
+     * The source is released and no reader is left, may be NULL.
+     */
+    void (*close)(void *opaque);
+} AVMediaDataSourceCallbacks;
+
+/**
+ * Create a source and make it reachable by its url.
+ *
+ * @param cb     copied, read is required
+ * @param opaque passed to the callbacks
+ * @return the source, NULL on failure
+ */
+AVMediaDataSource *av_media_data_source_create(const AVMediaDataSourceCallbacks *cb,
+                                               void *opaque);
+
+/**
+ * Write the url opening the source, "ijkmediadatasource:<id>", into buf.
+ *
+ * @return the length of the url, as snprintf()
+ */
+int av_media_data_source_url(AVMediaDataSource *s, char *buf, int buf_size);
+
+/**
+ * Wake the readers waiting for bytes the source did not have, to read
+ * again. Can be called from any thread.
+ */
+void av_media_data_source_ready(AVMediaDataSource *s);
+
+/**
+ * Make the url unreachable and drop the reference of the creator. Readers
+ * already open go on, close is called once the last one is closed.
+ */
+void av_media_data_source_release(AVMediaDataSource **s);
+
+#endif /* AVFORMAT_MEDIADATASOURCE_H */
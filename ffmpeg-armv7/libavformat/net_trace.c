@@ -0,0 +1,628 @@
+/*
+ * Process wide record and replay of network conditions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "config.h"
+#include "libavutil/atomic.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "avio.h"
+#include "net_trace.h"
+#include "url.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define NET_TRACE_HEADER    "# ijk net trace v1"
+
+#define NET_TRACE_SLOT      10000       // microseconds aggregated per recorded line
+#define NET_TRACE_QUANTUM   1460        // bytes a waiting read is given at least, a segment
+#define NET_TRACE_WINDOW    (256 * 1024) // bytes the link delivers ahead of the readers
+#define NET_TRACE_POLL      100000      // microseconds between checks of the interrupt
+#define NET_TRACE_MIN_SLEEP 1000        // microseconds, a wait rounded below that still sleeps
+#define NET_TRACE_BLOCKED   1000        // microseconds a read waits to count as blocked
+#define NET_TRACE_OPEN_RATE 1000000     // microseconds of a trace ending on a rate without end
+
+enum {
+    NET_TRACE_OFF,
+    NET_TRACE_RECORD,
+    NET_TRACE_REPLAY,
+};
+
+typedef struct NetTracePoint {
+    int64_t time;                   // microseconds
+    int64_t bytes;                  // delivered from the start of the trace
+} NetTracePoint;
+
+typedef struct NetTraceSpan {
+    int64_t start;                  // microseconds
+    int64_t duration;
+} NetTraceSpan;
+
+#if HAVE_PTHREADS
+
+static pthread_mutex_t net_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+// set under the mutex; read without it first by the hooks, so that reads
+// and connects do not take the lock while no trace runs
+static int             net_trace_mode;
+static int             net_trace_generation;
+static int64_t         net_trace_start;
+
+// record
+static FILE           *rec_file;
+static int64_t         rec_line_time;   // of the last line written
+static int64_t         rec_last_time;   // of the last bytes read
+static int64_t         rec_bytes;       // read since the last line
+
+// replay
+static NetTracePoint  *rep_points;
+static int             rep_nb_points;
+static NetTraceSpan   *rep_losses;
+static int             rep_nb_losses;
+static NetTraceSpan   *rep_connects;
+static int             rep_nb_connects;
+static int64_t        *rep_resets;
+static int             rep_nb_resets;
+static int64_t         rep_duration;
+static int64_t         rep_total;       // bytes of one pass
+static int64_t         rep_delivered;   // bytes handed to the readers
+
+static int64_t net_trace_now(void)
+{
+    return av_gettime_relative() - net_trace_start;
+}
+
+// must be called with net_trace_mutex held
+static void net_trace_free_locked(void)
+{
+    if (rec_file)
+        fclose(rec_file);
+    rec_file = NULL;
+
+    av_freep(&rep_points);
+    av_freep(&rep_losses);
+    av_freep(&rep_connects);
+    av_freep(&rep_resets);
+    rep_nb_points   = 0;
+    rep_nb_losses   = 0;
+    rep_nb_connects = 0;
+    rep_nb_resets   = 0;
+    rep_delivered   = 0;
+
+    avpriv_atomic_int_set(&net_trace_mode, NET_TRACE_OFF);
+    net_trace_generation++;
+}
+
+// attach a connection to the trace running, the first time it shows up
+static void net_trace_attach_locked(NetTraceConnection *conn, int64_t now)
+{
+    if (conn->generation == net_trace_generation)
+        return;
+    conn->generation = net_trace_generation;
+    conn->reset      = 0;
+    conn->opened     = now;
+    conn->wait_start = now;
+}
+
+/* record */
+
+static void record_line_locked(int64_t time, int64_t bytes)
+{
+    fprintf(rec_file, "%"PRId64" %"PRId64"\n", time / 1000, bytes);
+    rec_line_time = time;
+    rec_bytes     = 0;
+}
+
+// idle_since: when the reader started waiting for these bytes; when nothing
+// came from then on, the link was empty and the trace stays flat
+static void record_bytes_locked(int64_t time, int64_t bytes, int64_t idle_since)
+{
+    if (idle_since > rec_last_time && idle_since - rec_line_time >= NET_TRACE_SLOT) {
+        if (rec_bytes)
+            record_line_locked(rec_last_time, rec_bytes);
+        record_line_locked(idle_since, 0);
+    }
+
+    rec_bytes    += bytes;
+    rec_last_time = time;
+    if (time - rec_line_time >= NET_TRACE_SLOT)
+        record_line_locked(time, rec_bytes);
+}
+
+/* replay */
+
+// bytes of one pass delivered at time, 0 <= time < rep_duration
+static int64_t replay_bytes_in_pass(int64_t time)
+{
+    int lo = 0, hi = rep_nb_points - 1;
+    const NetTracePoint *a, *b;
+
+    // last point at or before time
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (rep_points[mid].time <= time)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    a = &rep_points[lo];
+    if (lo == rep_nb_points - 1)
+        return a->bytes;
+    b = &rep_points[lo + 1];
+    if (b->time <= a->time)
+        return b->bytes;
+    return a->bytes + av_rescale(b->bytes - a->bytes, time - a->time, b->time - a->time);
+}
+
+// time of one pass at which bytes have been delivered, 0 < bytes <= rep_total
+static int64_t replay_time_in_pass(int64_t bytes)
+{
+    int lo = 0, hi = rep_nb_points - 1;
+    const NetTracePoint *a, *b;
+
+    // first point reaching bytes
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (rep_points[mid].bytes >= bytes)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    b = &rep_points[lo];
+    if (lo == 0)
+        return b->time;
+    a = &rep_points[lo - 1];
+    return a->time + av_rescale(b->time - a->time, bytes - a->bytes, b->bytes - a->bytes);
+}
+
+// the outage time falls in, if any
+static const NetTraceSpan *replay_loss_at(int64_t time)
+{
+    int64_t in_pass = time % rep_duration;
+    int i;
+
+    for (i = 0; i < rep_nb_losses; i++) {
+        if (in_pass >= rep_losses[i].start && in_pass < rep_losses[i].start + rep_losses[i].duration)
+            return &rep_losses[i];
+    }
+    return NULL;
+}
+
+// bytes delivered by time, outages holding back what the link delivered
+static int64_t replay_bytes_at(int64_t time)
+{
+    const NetTraceSpan *loss = replay_loss_at(time);
+
+    if (loss)
+        time -= time % rep_duration - loss->start;
+    return time / rep_duration * rep_total + replay_bytes_in_pass(time % rep_duration);
+}
+
+// time by which bytes have been delivered
+static int64_t replay_time_of(int64_t bytes)
+{
+    int64_t pass = (bytes - 1) / rep_total;
+    int64_t time = pass * rep_duration + replay_time_in_pass(bytes - pass * rep_total);
+    const NetTraceSpan *loss;
+    int i;
+
+    for (i = 0; i <= rep_nb_losses && (loss = replay_loss_at(time)); i++)
+        time += loss->start + loss->duration - time % rep_duration;
+    return time;
+}
+
+static int replay_was_reset_locked(NetTraceConnection *conn, int64_t now)
+{
+    int i;
+
+    if (conn->reset)
+        return 1;
+    for (i = 0; i < rep_nb_resets; i++) {
+        // the first occurrence after the connect
+        int64_t first = (conn->opened - rep_resets[i] + rep_duration) / rep_duration * rep_duration + rep_resets[i];
+        if (first <= now) {
+            conn->reset = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int64_t replay_connect_time_locked(int64_t now)
+{
+    int64_t in_pass = now % rep_duration;
+    int i;
+
+    if (!rep_nb_connects)
+        return 0;
+    for (i = rep_nb_connects - 1; i > 0; i--) {
+        if (rep_connects[i].start <= in_pass)
+            break;
+    }
+    return rep_connects[i].duration;
+}
+
+// sleep until the trace time until, or the interrupt
+static int replay_sleep(URLContext *h, int64_t now, int64_t until)
+{
+    av_usleep(av_clip64(until - now, NET_TRACE_MIN_SLEEP, NET_TRACE_POLL));
+    if (ff_check_interrupt(&h->interrupt_callback))
+        return AVERROR_EXIT;
+    return 0;
+}
+
+static int replay_add_point(NetTracePoint point)
+{
+    if (!av_dynarray2_add((void **)&rep_points, &rep_nb_points, sizeof(point), (uint8_t *)&point))
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static int replay_load_locked(const char *path)
+{
+    FILE   *f = fopen(path, "r");
+    char    line[256];
+    int     lineno = 0;
+    int     rate_open = 0;
+    double  rate = 0;           // bytes per microsecond
+    int64_t rate_start = 0;
+    int64_t last = 0, end = 0;
+    int64_t bytes = 0;
+    int     ret = 0;
+
+    if (!f) {
+        ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "net trace: cannot open %s\n", path);
+        return ret;
+    }
+
+    if ((ret = replay_add_point((NetTracePoint){ 0, 0 })) < 0)
+        goto end;
+
+    while (fgets(line, sizeof(line), f)) {
+        double  a, b;
+        int64_t time;
+        char    word[16];
+        const char *p = line;
+
+        lineno++;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+            continue;
+
+        if (sscanf(p, "%15s", word) == 1 && !(word[0] >= '0' && word[0] <= '9')) {
+            int n = sscanf(p, "%*s %lf %lf", &a, &b);
+            if (n < 1 || a < 0 || (n == 2 && b < 0))
+                goto invalid;
+            time = (int64_t)(a * 1000);
+
+            if (!strcmp(word, "loss") && n == 2) {
+                NetTraceSpan span = { time, (int64_t)(b * 1000) };
+                if (!av_dynarray2_add((void **)&rep_losses, &rep_nb_losses, sizeof(span), (uint8_t *)&span))
+                    goto nomem;
+                end = FFMAX(end, span.start + span.duration);
+                continue;
+            } else if (!strcmp(word, "connect") && n == 2) {
+                NetTraceSpan span = { time, (int64_t)(b * 1000) };
+                if (!av_dynarray2_add((void **)&rep_connects, &rep_nb_connects, sizeof(span), (uint8_t *)&span))
+                    goto nomem;
+                end = FFMAX(end, time);
+                continue;
+            } else if (!strcmp(word, "reset")) {
+                if (!av_dynarray2_add((void **)&rep_resets, &rep_nb_resets, sizeof(time), (uint8_t *)&time))
+                    goto nomem;
+                end = FFMAX(end, time);
+                continue;
+            } else if (strcmp(word, "rate") && strcmp(word, "end")) {
+                goto invalid;
+            }
+        } else {
+            long long n;
+            if (sscanf(p, "%lf %lld", &a, &n) != 2 || a < 0 || n < 0)
+                goto invalid;
+            time = (int64_t)(a * 1000);
+            b    = n;
+        }
+
+        // the lines of the curve, in order
+        if (time < last)
+            goto invalid;
+        if (rate_open) {
+            bytes += (int64_t)(rate * (time - rate_start));
+            if ((ret = replay_add_point((NetTracePoint){ time, bytes })) < 0)
+                goto end;
+            rate_open = 0;
+        }
+        last = time;
+
+        if (!strcmp(word, "rate")) {
+            if (sscanf(p, "%*s %lf %lf", &a, &b) != 2)
+                goto invalid;
+            if ((ret = replay_add_point((NetTracePoint){ time, bytes })) < 0)
+                goto end;
+            rate       = b * 1000 / 8 / 1000000;
+            rate_start = time;
+            rate_open  = 1;
+        } else if (!strcmp(word, "end")) {
+            end = FFMAX(end, time);
+        } else {
+            bytes += (int64_t)b;
+            if ((ret = replay_add_point((NetTracePoint){ time, bytes })) < 0)
+                goto end;
+        }
+    }
+
+    end = FFMAX(end, last);
+    if (rate_open) {
+        if (end <= rate_start)
+            end = rate_start + NET_TRACE_OPEN_RATE;
+        bytes += (int64_t)(rate * (end - rate_start));
+        if ((ret = replay_add_point((NetTracePoint){ end, bytes })) < 0)
+            goto end;
+    }
+    if (bytes <= 0 || end <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "net trace: %s delivers nothing\n", path);
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    rep_duration = end;
+    rep_total    = bytes;
+    goto end;
+
+invalid:
+    av_log(NULL, AV_LOG_ERROR, "net trace: %s:%d: invalid line\n", path, lineno);
+    ret = AVERROR_INVALIDDATA;
+    goto end;
+nomem:
+    ret = AVERROR(ENOMEM);
+end:
+    fclose(f);
+    return ret;
+}
+
+/* hooks */
+
+int ff_net_trace_did_connect(URLContext *h, NetTraceConnection *conn, int64_t connect_start)
+{
+    int64_t now, start, until;
+    int     generation;
+    int     ret = 0;
+
+    if (avpriv_atomic_int_get(&net_trace_mode) == NET_TRACE_OFF)
+        return 0;
+
+    pthread_mutex_lock(&net_trace_mutex);
+    if (net_trace_mode == NET_TRACE_OFF) {
+        pthread_mutex_unlock(&net_trace_mutex);
+        return 0;
+    }
+
+    now   = net_trace_now();
+    start = FFMAX(connect_start - net_trace_start, 0);
+    conn->generation = -1;
+    net_trace_attach_locked(conn, now);
+
+    if (net_trace_mode == NET_TRACE_RECORD) {
+        fprintf(rec_file, "connect %"PRId64" %"PRId64"\n", start / 1000, (now - start) / 1000);
+        pthread_mutex_unlock(&net_trace_mutex);
+        return 0;
+    }
+
+    generation = net_trace_generation;
+    until      = start + replay_connect_time_locked(start);
+    pthread_mutex_unlock(&net_trace_mutex);
+
+    while (now < until) {
+        if ((ret = replay_sleep(h, now, until)) < 0)
+            break;
+        pthread_mutex_lock(&net_trace_mutex);
+        now = generation == net_trace_generation ? net_trace_now() : until;
+        pthread_mutex_unlock(&net_trace_mutex);
+    }
+    return ret;
+}
+
+int ff_net_trace_will_read(URLContext *h, NetTraceConnection *conn, int size)
+{
+    int64_t wait_start = 0;
+
+    if (avpriv_atomic_int_get(&net_trace_mode) == NET_TRACE_OFF)
+        return size;
+
+    for (;;) {
+        int64_t now, available, need, until;
+        int     ret;
+
+        pthread_mutex_lock(&net_trace_mutex);
+        if (net_trace_mode == NET_TRACE_OFF) {
+            pthread_mutex_unlock(&net_trace_mutex);
+            return size;
+        }
+        now = net_trace_now();
+        net_trace_attach_locked(conn, now);
+
+        if (net_trace_mode == NET_TRACE_RECORD) {
+            conn->wait_start = now;
+            pthread_mutex_unlock(&net_trace_mutex);
+            return size;
+        }
+
+        if (replay_was_reset_locked(conn, now)) {
+            pthread_mutex_unlock(&net_trace_mutex);
+            return AVERROR(ECONNRESET);
+        }
+
+        // a link left idle does not bank more than a window
+        available = replay_bytes_at(now);
+        if (available - rep_delivered > NET_TRACE_WINDOW)
+            rep_delivered = available - NET_TRACE_WINDOW;
+        available -= rep_delivered;
+
+        need = FFMIN(size, NET_TRACE_QUANTUM);
+        if (available >= need) {
+            size = FFMIN(size, available);
+            rep_delivered += size;
+            pthread_mutex_unlock(&net_trace_mutex);
+            return size;
+        }
+        if (h->flags & AVIO_FLAG_NONBLOCK) {
+            pthread_mutex_unlock(&net_trace_mutex);
+            return AVERROR(EAGAIN);
+        }
+
+        if (!wait_start)
+            wait_start = av_gettime_relative();
+        else if (h->rw_timeout > 0 && av_gettime_relative() - wait_start > h->rw_timeout) {
+            pthread_mutex_unlock(&net_trace_mutex);
+            return AVERROR(ETIMEDOUT);
+        }
+
+        until = replay_time_of(rep_delivered + need);
+        pthread_mutex_unlock(&net_trace_mutex);
+        if ((ret = replay_sleep(h, now, until)) < 0)
+            return ret;
+    }
+}
+
+void ff_net_trace_did_read(NetTraceConnection *conn, int granted, int ret)
+{
+    if (avpriv_atomic_int_get(&net_trace_mode) == NET_TRACE_OFF)
+        return;
+
+    pthread_mutex_lock(&net_trace_mutex);
+    if (net_trace_mode == NET_TRACE_OFF || conn->generation != net_trace_generation) {
+        pthread_mutex_unlock(&net_trace_mutex);
+        return;
+    }
+
+    if (net_trace_mode == NET_TRACE_RECORD) {
+        int64_t now = net_trace_now();
+        if (ret > 0)
+            record_bytes_locked(now, ret, now - conn->wait_start >= NET_TRACE_BLOCKED ? conn->wait_start : 0);
+        else if (ret == AVERROR(ECONNRESET))
+            fprintf(rec_file, "reset %"PRId64"\n", now / 1000);
+    } else if (ret < granted) {
+        // the server had less than the link could carry
+        rep_delivered -= granted - FFMAX(ret, 0);
+    }
+    pthread_mutex_unlock(&net_trace_mutex);
+}
+
+/* control */
+
+int av_net_trace_start_recording(const char *path)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&net_trace_mutex);
+    net_trace_free_locked();
+
+    rec_file = fopen(path, "w");
+    if (!rec_file) {
+        ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "net trace: cannot create %s\n", path);
+    } else {
+        fprintf(rec_file, NET_TRACE_HEADER "\n");
+        rec_line_time   = 0;
+        rec_last_time   = 0;
+        rec_bytes       = 0;
+        net_trace_start = av_gettime_relative();
+        avpriv_atomic_int_set(&net_trace_mode, NET_TRACE_RECORD);
+    }
+    pthread_mutex_unlock(&net_trace_mutex);
+    return ret;
+}
+
+int av_net_trace_start_replay(const char *path)
+{
+    int ret;
+
+    pthread_mutex_lock(&net_trace_mutex);
+    net_trace_free_locked();
+
+    ret = replay_load_locked(path);
+    if (ret < 0) {
+        net_trace_free_locked();
+    } else {
+        av_log(NULL, AV_LOG_INFO, "net trace: replaying %s, %"PRId64" bytes in %"PRId64" ms\n",
+               path, rep_total, rep_duration / 1000);
+        net_trace_start = av_gettime_relative();
+        avpriv_atomic_int_set(&net_trace_mode, NET_TRACE_REPLAY);
+    }
+    pthread_mutex_unlock(&net_trace_mutex);
+    return ret;
+}
+
+int av_net_trace_stop(void)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&net_trace_mutex);
+    if (rec_file) {
+        if (rec_bytes)
+            record_line_locked(rec_last_time, rec_bytes);
+        fprintf(rec_file, "end %"PRId64"\n", net_trace_now() / 1000);
+        if (ferror(rec_file) || fclose(rec_file))
+            ret = AVERROR(EIO);
+        rec_file = NULL;
+    }
+    net_trace_free_locked();
+    pthread_mutex_unlock(&net_trace_mutex);
+    return ret;
+}
+
+#else
+
+int ff_net_trace_did_connect(URLContext *h, NetTraceConnection *conn, int64_t connect_start)
+{
+    return 0;
+}
+
+int ff_net_trace_will_read(URLContext *h, NetTraceConnection *conn, int size)
+{
+    return size;
+}
+
+void ff_net_trace_did_read(NetTraceConnection *conn, int granted, int ret)
+{
+}
+
+int av_net_trace_start_recording(const char *path)
+{
+    return AVERROR(ENOSYS);
+}
+
+int av_net_trace_start_replay(const char *path)
+{
+    return AVERROR(ENOSYS);
+}
+
+int av_net_trace_stop(void)
+{
+    return 0;
+}
+
+#endif
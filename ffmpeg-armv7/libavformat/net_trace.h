@@ -0,0 +1,120 @@
+/*
+ * Process wide record and replay of network conditions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_NET_TRACE_H
+#define AVFORMAT_NET_TRACE_H
+
+#include <stdint.h>
+
+struct URLContext;
+
+/**
+ * A trace covers every outgoing tcp connection of the process, the
+ * downlink only.
+ *
+ * Recording notes how long each connect took and when how many bytes were
+ * read, the whole process sharing one timeline. Record with a player that
+ * keeps reading (a large buffer): while nobody reads, the trace only knows
+ * what arrived in the meantime.
+ *
+ * Replay shapes the connections to a trace whatever server they talk to,
+ * usually one on the loopback serving the same media: connects last as
+ * long as the trace says, and the bytes read by all connections together
+ * come no faster than the trace delivered them. The trace repeats past its
+ * end. The data itself is not replayed, so a player may request other
+ * ranges or variants than the one recorded.
+ *
+ * The trace is text, one record per line, times in milliseconds from the
+ * start of the trace:
+ *
+ *   # comment
+ *   <t> <bytes>          bytes delivered since the previous line, spread
+ *                        evenly over that time
+ *   rate <t> <kbit/s>    a steady link from t until the next line
+ *   loss <t> <ms>        an outage: nothing is delivered from t for ms,
+ *                        what the link delivered meanwhile arrives after
+ *   reset <t>            the connections open at t fail with ECONNRESET
+ *   connect <t> <ms>     connects from t on take ms
+ *   end <t>              the length of the trace, the last time otherwise
+ *
+ * Lines with bytes are written by recording, a 3G profile could read:
+ *
+ *   rate 0 1500
+ *   loss 8000 2500
+ *   rate 12000 400
+ *   reset 15000
+ *   connect 0 180
+ *   end 20000
+ */
+
+typedef struct NetTraceConnection {
+    int     generation;     // of the trace the fields below belong to
+    int     reset;          // failed by a reset of the trace
+    int64_t opened;         // trace time of the connect
+    int64_t wait_start;     // trace time the last read started waiting
+} NetTraceConnection;
+
+/**
+ * Called once a connection is open, connect_start being the
+ * av_gettime_relative() before connecting. On replay, waits for the
+ * connect time of the trace.
+ *
+ * @return 0, or AVERROR_EXIT if interrupted
+ */
+int  ff_net_trace_did_connect(struct URLContext *h, NetTraceConnection *conn, int64_t connect_start);
+
+/**
+ * Called before waiting on the socket for a read of size bytes. On replay,
+ * waits until the trace delivers some bytes, honouring the rw_timeout and
+ * the interrupt callback of h.
+ *
+ * @return the bytes the read may take, at most size, or a negative AVERROR
+ */
+int  ff_net_trace_will_read(struct URLContext *h, NetTraceConnection *conn, int size);
+
+/**
+ * Called with the result of the read, granted being what
+ * ff_net_trace_will_read() returned.
+ */
+void ff_net_trace_did_read(NetTraceConnection *conn, int granted, int ret);
+
+/**
+ * Record the network of the process to path, written on
+ * av_net_trace_stop(). Stops the trace running.
+ *
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int  av_net_trace_start_recording(const char *path);
+
+/**
+ * Shape the network of the process to the trace of path, from now on.
+ * Stops the trace running.
+ *
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int  av_net_trace_start_replay(const char *path);
+
+/**
+ * @return 0 on success, a negative AVERROR if the recording could not be
+ *         written
+ */
+int  av_net_trace_stop(void);
+
+#endif /* AVFORMAT_NET_TRACE_H */
@@ -0,0 +1,86 @@
+/*
+ * Capture of demuxed packets, for decoder replay
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PKTCAP_H
+#define AVFORMAT_PKTCAP_H
+
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * A capture holds the packets of a demuxer as it returned them: their
+ * data, timestamps, flags and side data (new extradata included), in the
+ * order read, with the codec parameters of the streams and the time each
+ * packet was read. The pktcap demuxer plays it back, so that decoders see
+ * exactly the input of the capture, without the network and the demuxer
+ * it came through.
+ *
+ * Its "pace" option sets when packets are returned: "none", as fast as
+ * they are read; "dts", in real time by their timestamps; "capture", at
+ * the times they were captured, stalls included.
+ *
+ * The file is written record after record, so a capture cut short by the
+ * app dying plays up to its last complete packet. Big-endian throughout:
+ *
+ *   "PKTCAP" u16 version, u32 nb_streams, the streams, then packets until
+ *   the end of the file
+ *
+ *   stream: u32 id, u32 disposition, time_base, avg_frame_rate and
+ *           r_frame_rate as u32 num/den pairs, the codec parameters,
+ *           u32 size + extradata, u32 count + metadata as pairs of
+ *           NUL-terminated strings, u32 count + side data
+ *
+ *   packet: u32 size, u16 stream_index, u16 flags, s64 pts, s64 dts,
+ *           s64 duration, s64 time read in microseconds from the start of
+ *           the capture, u16 count of side data, the data, the side data
+ *
+ *   side data: u32 type, u32 size, data
+ */
+
+#define AV_PKTCAP_VERSION 1
+
+typedef struct AVPacketCapture AVPacketCapture;
+
+/**
+ * Create a capture of the streams of ic at path, writing its header.
+ *
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int av_packet_capture_open(AVPacketCapture **pc, const char *path, const AVFormatContext *ic);
+
+/**
+ * Append a packet of ic, as returned by av_read_frame().
+ *
+ * @param time microseconds since the start of the capture at which the
+ *             packet was read, e.g. from av_gettime_relative()
+ * @return 0 on success, a negative AVERROR otherwise
+ */
+int av_packet_capture_write(AVPacketCapture *pc, const AVPacket *pkt, int64_t time);
+
+/**
+ * Close the file and free the capture.
+ *
+ * @return 0 on success, a negative AVERROR if the file could not be
+ *         written completely
+ */
+int av_packet_capture_close(AVPacketCapture **pc);
+
+#endif /* AVFORMAT_PKTCAP_H */
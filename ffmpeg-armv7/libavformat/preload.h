@@ -0,0 +1,82 @@
+/*
+ * Warm the caches for a url before it is played
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PRELOAD_H
+#define AVFORMAT_PRELOAD_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avio.h"
+
+/**
+ * A preload opens the url the way a player does and reads its first
+ * packets without decoding them. With the format options the player will
+ * use, the host ends up in the dns cache, the http connections in the pool
+ * and the bytes in the disk cache (progressive urls opened as
+ * "cache:<url>", segments of http HLS streams), so the player that opens
+ * the same url afterwards starts from local data.
+ */
+
+typedef struct AVPreloadResult {
+    int64_t bytes;          // packet bytes read
+    int64_t duration;       // media read, in AV_TIME_BASE units
+    int64_t elapsed;        // wall clock time spent, in microseconds
+} AVPreloadResult;
+
+/**
+ * Open url and read it until duration of media or max_bytes of packets
+ * have been read, whichever comes first. Blocks the calling thread, run
+ * it on a low priority one.
+ *
+ * @param duration  media to read in AV_TIME_BASE units, <= 0 for no limit
+ * @param max_bytes packet bytes to read, <= 0 for no limit
+ * @param options   format options, as given to avformat_open_input(), may be NULL
+ * @param int_cb    checked while opening and reading, may be NULL
+ * @param result    filled with what was read, may be NULL
+ * @return 0 once a limit or the end of the input is reached,
+ *         AVERROR(EINVAL) if neither limit is set, another negative
+ *         AVERROR on failure or interruption
+ */
+int av_preload_url(const char *url, int64_t duration, int64_t max_bytes,
+                   AVDictionary *options, const AVIOInterruptCB *int_cb,
+                   AVPreloadResult *result);
+
+/**
+ * Open url and read duration of media from the key frame before each of
+ * the targets in turn: the times a player of url is likely to seek to,
+ * such as chapter starts and resume points, most likely first. Stops
+ * once max_bytes of packets have been read in all. A target the input
+ * cannot seek to is skipped.
+ *
+ * @param targets   in AV_TIME_BASE units, from the start of the input
+ * @param duration  media to read at each target in AV_TIME_BASE units
+ * @param max_bytes packet bytes to read in all, <= 0 for no limit
+ * @param result    the sums over the targets, may be NULL
+ * @return 0 once every target was read or the limit reached,
+ *         AVERROR(EINVAL) without targets or duration, another negative
+ *         AVERROR on failure or interruption
+ */
+int av_preload_url_targets(const char *url, const int64_t *targets, int nb_targets,
+                           int64_t duration, int64_t max_bytes,
+                           AVDictionary *options, const AVIOInterruptCB *int_cb,
+                           AVPreloadResult *result);
+
+#endif /* AVFORMAT_PRELOAD_H */
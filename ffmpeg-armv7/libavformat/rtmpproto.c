@@ -89,6 +89,8 @@ typedef struct RTMPContext {
     ClientState   state;                      ///< current state
     int           stream_id;                  ///< ID assigned by the server for the stream
     uint8_t*      flv_data;                   ///< buffer with data for demuxer
+    AVBufferRef*  flv_buf;                    ///< pooled message buffer flv_data points into, NULL if flv_data is allocated on its own
+    RTMPPacketPool pkt_pool;                  ///< payload buffers of incoming messages
     int           flv_size;                   ///< current buffer size
     int           flv_off;                    ///< number of bytes read from current buffer
     int           flv_nb_packets;             ///< number of flv packets published
@@ -419,7 +421,8 @@ static int read_connect(URLContext *s, RTMPContext *rt)
     // handle RTMP Protocol Control Messages
     for (;;) {
         if ((ret = ff_rtmp_packet_read(rt->stream, &pkt, rt->in_chunk_size,
-                                       &rt->prev_pkt[0], &rt->nb_prev_pkt[0])) < 0)
+                                       &rt->prev_pkt[0], &rt->nb_prev_pkt[0],
+                                       &rt->pkt_pool)) < 0)
             return ret;
 #ifdef DEBUG
         ff_rtmp_packet_dump(s, &pkt);
@@ -2206,6 +2209,40 @@ static int handle_invoke(URLContext *s, RTMPPacket *pkt)
     return ret;
 }
 
+static void flv_data_free(RTMPContext *rt)
+{
+    if (rt->flv_buf) {
+        av_buffer_unref(&rt->flv_buf);
+        rt->flv_data = NULL;
+    } else {
+        av_freep(&rt->flv_data);
+    }
+}
+
+/**
+ * Move the unread FLV data out of the message buffer it was framed in,
+ * before it gets reallocated.
+ */
+static int flv_data_detach(RTMPContext *rt)
+{
+    uint8_t *data;
+
+    if (!rt->flv_buf)
+        return 0;
+
+    if (rt->flv_off >= rt->flv_size) {
+        flv_data_free(rt);
+        return 0;
+    }
+
+    if (!(data = av_malloc(rt->flv_size)))
+        return AVERROR(ENOMEM);
+    memcpy(data, rt->flv_data, rt->flv_size);
+    av_buffer_unref(&rt->flv_buf);
+    rt->flv_data = data;
+    return 0;
+}
+
 static int update_offset(RTMPContext *rt, int size)
 {
     int old_flv_size;
@@ -2239,6 +2276,32 @@ static int append_flv_data(RTMPContext *rt, RTMPPacket *pkt, int skip)
         rt->has_video = 1;
     }
 
+    if (pkt->buf && rt->flv_off >= rt->flv_size) {
+        // everything was read, frame the message as an FLV tag in place:
+        // the tag header goes over the room in front of the data, skipped
+        // bytes included, and the tag size into the room after it
+        uint8_t *p = (uint8_t *)data - RTMP_HEADER;
+
+        flv_data_free(rt);
+        rt->flv_buf  = pkt->buf;
+        rt->flv_data = p;
+        rt->flv_size = size + 15;
+        rt->flv_off  = 0;
+        pkt->buf  = NULL;
+        pkt->data = NULL;
+
+        bytestream_put_byte(&p, pkt->type);
+        bytestream_put_be24(&p, size);
+        bytestream_put_be24(&p, ts);
+        bytestream_put_byte(&p, ts >> 24);
+        bytestream_put_be24(&p, 0);
+        p += size;
+        bytestream_put_be32(&p, size + RTMP_HEADER);
+        return 0;
+    }
+
+    if ((ret = flv_data_detach(rt)) < 0)
+        return ret;
     old_flv_size = update_offset(rt, size + 15);
 
     if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0) {
@@ -2374,6 +2437,8 @@ static int handle_metadata(RTMPContext *rt, RTMPPacket *pkt)
     uint32_t size;
     uint32_t ts, cts, pts = 0;
 
+    if ((ret = flv_data_detach(rt)) < 0)
+        return ret;
     old_flv_size = update_offset(rt, pkt->size);
 
     if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0) {
@@ -2439,7 +2504,7 @@ static int get_packet(URLContext *s, int for_header)
         RTMPPacket rpkt = { 0 };
         if ((ret = ff_rtmp_packet_read(rt->stream, &rpkt,
                                        rt->in_chunk_size, &rt->prev_pkt[0],
-                                       &rt->nb_prev_pkt[0])) <= 0) {
+                                       &rt->nb_prev_pkt[0], &rt->pkt_pool)) <= 0) {
             if (ret == 0) {
                 return AVERROR(EAGAIN);
             } else {
@@ -2531,7 +2596,8 @@ static int rtmp_close(URLContext *h)
     }
 
     free_tracked_methods(rt);
-    av_freep(&rt->flv_data);
+    flv_data_free(rt);
+    ff_rtmp_packet_pool_uninit(&rt->pkt_pool);
     ffurl_close(rt->stream);
     return ret;
 }
@@ -2553,8 +2619,13 @@ static int inject_fake_duration_metadata(RTMPContext *rt)
     // size of our fake metadata packet.
 
     uint8_t* p;
+    uint8_t* old_flv_data;
+    int ret;
+
+    if ((ret = flv_data_detach(rt)) < 0)
+        return ret;
     // Keep old flv_data pointer
-    uint8_t* old_flv_data = rt->flv_data;
+    old_flv_data = rt->flv_data;
     // Allocate a new flv_data pointer with enough space for the additional package
     if (!(rt->flv_data = av_malloc(rt->flv_size + 55))) {
         rt->flv_data = old_flv_data;
@@ -3095,7 +3166,8 @@ static int rtmp_write(URLContext *s, const uint8_t *buf, int size)
         if ((ret = ff_rtmp_packet_read_internal(rt->stream, &rpkt,
                                                 rt->in_chunk_size,
                                                 &rt->prev_pkt[0],
-                                                &rt->nb_prev_pkt[0], c)) <= 0)
+                                                &rt->nb_prev_pkt[0],
+                                                &rt->pkt_pool, c)) <= 0)
              return ret;
 
         if ((ret = rtmp_parse_result(s, rt, &rpkt)) < 0)
@@ -60,7 +60,7 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
     char buf[200], opts[50] = "";
     struct addrinfo hints = { 0 }, *ai = NULL;
     const char *proxy_path;
-    int use_proxy;
+    int use_proxy, ret;
 
     set_options(c, uri);
 
@@ -104,7 +104,12 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
                     proxy_port, "/%s", dest);
     }
 
-    return ffurl_open_whitelist(&c->tcp, buf, AVIO_FLAG_READ_WRITE,
-                                &parent->interrupt_callback, options,
-                                parent->protocol_whitelist, parent->protocol_blacklist, parent);
+    ret = ffurl_open_whitelist(&c->tcp, buf, AVIO_FLAG_READ_WRITE,
+                               &parent->interrupt_callback, options,
+                               parent->protocol_whitelist, parent->protocol_blacklist, parent);
+    if (ret >= 0) {
+        av_opt_get_int(c->tcp, "dns_time",     AV_OPT_SEARCH_CHILDREN, &c->dns_time);
+        av_opt_get_int(c->tcp, "connect_time", AV_OPT_SEARCH_CHILDREN, &c->connect_time);
+    }
+    return ret;
 }
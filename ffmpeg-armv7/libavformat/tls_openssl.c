@@ -27,10 +27,12 @@
 #include "tls.h"
 #include "libavcodec/internal.h"
 #include "libavutil/avstring.h"
+#include "libavutil/application.h"
 #include "libavutil/avutil.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include <openssl/bio.h>
 #include <openssl/ssl.h>
@@ -46,8 +48,132 @@ typedef struct TLSContext {
 #if OPENSSL_VERSION_NUMBER >= 0x1010000fL
     BIO_METHOD* url_bio_method;
 #endif
+    int session_cache;
+    char session_key[300];
+    int64_t app_ctx_intptr;
+    AVApplicationContext *app_ctx;
+    char *alpn;
+    char *alpn_selected;
 } TLSContext;
 
+/* Process wide client session cache. Every tls_open() has its own SSL_CTX,
+ * so OpenSSL's internal per context cache never sees a second connection;
+ * sessions (and tickets) are kept here instead, keyed by SNI host, port and
+ * verify mode so an unverified session never resumes a verified open. */
+#define TLS_SESSION_CACHE_SIZE 32
+
+typedef struct TLSSessionCacheEntry {
+    char         key[300];
+    SSL_SESSION *session;
+    int64_t      last_used;
+} TLSSessionCacheEntry;
+
+static TLSSessionCacheEntry tls_session_cache[TLS_SESSION_CACHE_SIZE];
+static int64_t tls_session_handshakes;
+static int64_t tls_session_resumed;
+
+#if HAVE_PTHREADS
+static pthread_mutex_t tls_session_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define tls_session_lock()   pthread_mutex_lock(&tls_session_mutex)
+#define tls_session_unlock() pthread_mutex_unlock(&tls_session_mutex)
+#else
+#define tls_session_lock()
+#define tls_session_unlock()
+#endif
+
+static TLSSessionCacheEntry *tls_session_find_locked(const char *key)
+{
+    int i;
+    for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        if (tls_session_cache[i].session && !strcmp(tls_session_cache[i].key, key))
+            return &tls_session_cache[i];
+    }
+    return NULL;
+}
+
+/* called by OpenSSL with a new client session, returning 1 keeps the reference */
+static int tls_session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+    TLSContext *p = SSL_get_app_data(ssl);
+    TLSSessionCacheEntry *entry;
+    int i;
+
+    if (!p || !p->session_key[0])
+        return 0;
+
+    tls_session_lock();
+    entry = tls_session_find_locked(p->session_key);
+    if (!entry) {
+        entry = &tls_session_cache[0];
+        for (i = 1; i < TLS_SESSION_CACHE_SIZE && entry->session; i++) {
+            if (!tls_session_cache[i].session || tls_session_cache[i].last_used < entry->last_used)
+                entry = &tls_session_cache[i];
+        }
+    }
+    if (entry->session)
+        SSL_SESSION_free(entry->session);
+    av_strlcpy(entry->key, p->session_key, sizeof(entry->key));
+    entry->session   = session;
+    entry->last_used = av_gettime_relative();
+    tls_session_unlock();
+    return 1;
+}
+
+static void tls_session_apply(TLSContext *p)
+{
+    TLSSessionCacheEntry *entry;
+
+    tls_session_lock();
+    entry = tls_session_find_locked(p->session_key);
+    if (entry) {
+        if (SSL_SESSION_get_time(entry->session) + SSL_SESSION_get_timeout(entry->session) < time(NULL)) {
+            SSL_SESSION_free(entry->session);
+            entry->session = NULL;
+        } else {
+            // SSL_set_session() takes its own reference
+            SSL_set_session(p->ssl, entry->session);
+            entry->last_used = av_gettime_relative();
+        }
+    }
+    tls_session_unlock();
+}
+
+static void tls_session_remove(const char *key)
+{
+    TLSSessionCacheEntry *entry;
+
+    tls_session_lock();
+    entry = tls_session_find_locked(key);
+    if (entry) {
+        SSL_SESSION_free(entry->session);
+        entry->session = NULL;
+    }
+    tls_session_unlock();
+}
+
+static void tls_session_report(TLSContext *p, const char *host, int is_resumed)
+{
+    AVAppTlsStatistic stat = {0};
+
+    tls_session_lock();
+    tls_session_handshakes++;
+    if (is_resumed)
+        tls_session_resumed++;
+    stat.handshakes = tls_session_handshakes;
+    stat.resumed    = tls_session_resumed;
+    tls_session_unlock();
+
+    av_log(NULL, AV_LOG_DEBUG, "TLS handshake with %s %s, resumed %"PRId64"/%"PRId64"\n",
+           host, is_resumed ? "resumed" : "full", stat.resumed, stat.handshakes);
+
+    if (!p->app_ctx)
+        return;
+    stat.size       = sizeof(stat);
+    stat.is_resumed = is_resumed;
+    av_strlcpy(stat.host, host, sizeof(stat.host));
+    av_application_on_tls_statistic(p->app_ctx, &stat);
+}
+
 #if HAVE_THREADS
 #include <openssl/crypto.h>
 pthread_mutex_t *openssl_mutexes;
@@ -98,6 +224,8 @@ static int url_bio_bread(BIO *b, char *buf, int len)
     if (ret >= 0)
         return ret;
     BIO_clear_retry_flags(b);
+    if (ret == AVERROR(EAGAIN))
+        BIO_set_retry_read(b);
     if (ret == AVERROR_EXIT)
         return 0;
     return -1;
@@ -110,6 +238,8 @@ static int url_bio_bwrite(BIO *b, const char *buf, int len)
     if (ret >= 0)
         return ret;
     BIO_clear_retry_flags(b);
+    if (ret == AVERROR(EAGAIN))
+        BIO_set_retry_write(b);
     if (ret == AVERROR_EXIT)
         return 0;
     return -1;
@@ -193,6 +323,12 @@ void ff_openssl_deinit(void)
 
 static int print_tls_error(URLContext *h, int ret)
 {
+    TLSContext *c = h->priv_data;
+    if (h->flags & AVIO_FLAG_NONBLOCK) {
+        int err = SSL_get_error(c->ssl, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+            return AVERROR(EAGAIN);
+    }
     av_log(h, AV_LOG_ERROR, "%s\n", ERR_error_string(ERR_get_error(), NULL));
     return AVERROR(EIO);
 }
@@ -216,6 +352,34 @@ static int tls_close(URLContext *h)
     return 0;
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+/* the comma separated list of the option in the wire format of ALPN */
+static int tls_set_alpn(URLContext *h, const char *alpn)
+{
+    TLSContext *p = h->priv_data;
+    unsigned char protos[256];
+    int len = 0;
+
+    while (*alpn) {
+        int n = strcspn(alpn, ",");
+        if (n == 0 || n > 255 || len + 1 + n > sizeof(protos)) {
+            av_log(h, AV_LOG_ERROR, "Invalid alpn %s\n", p->alpn);
+            return AVERROR(EINVAL);
+        }
+        protos[len++] = n;
+        memcpy(protos + len, alpn, n);
+        len  += n;
+        alpn += n + (alpn[n] == ',');
+    }
+    // unlike the rest of OpenSSL, 0 is success here
+    if (len && SSL_set_alpn_protos(p->ssl, protos, len)) {
+        av_log(h, AV_LOG_ERROR, "%s\n", ERR_error_string(ERR_get_error(), NULL));
+        return AVERROR(EIO);
+    }
+    return 0;
+}
+#endif
+
 static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **options)
 {
     TLSContext *p = h->priv_data;
@@ -226,6 +390,11 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     if ((ret = ff_openssl_init()) < 0)
         return ret;
 
+    /* taken from the options by av_opt_set_dict(), put it back for tcp */
+    p->app_ctx = (AVApplicationContext *)(intptr_t)p->app_ctx_intptr;
+    if (p->app_ctx_intptr)
+        av_dict_set_int(options, "ijkapplication", p->app_ctx_intptr, 0);
+
     if ((ret = ff_tls_open_underlying(c, h, uri, options)) < 0)
         goto fail;
 
@@ -260,6 +429,14 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     // the requested hostname.
     if (c->verify)
         SSL_CTX_set_verify(p->ctx, SSL_VERIFY_PEER|SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    // client certificates are left out, a resumed session would skip them
+    if (p->session_cache && !c->listen && !c->cert_file && !c->key_file) {
+        int port = 443;
+        av_url_split(NULL, 0, NULL, 0, NULL, 0, &port, NULL, 0, uri);
+        snprintf(p->session_key, sizeof(p->session_key), "%s:%d:%d", c->host, port, c->verify);
+        SSL_CTX_set_session_cache_mode(p->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(p->ctx, tls_session_new_cb);
+    }
     p->ssl = SSL_new(p->ctx);
     if (!p->ssl) {
         av_log(h, AV_LOG_ERROR, "%s\n", ERR_error_string(ERR_get_error(), NULL));
@@ -283,7 +460,17 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     SSL_set_bio(p->ssl, bio, bio);
     if (!c->listen && !c->numerichost)
         SSL_set_tlsext_host_name(p->ssl, c->host);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+    if (!c->listen && p->alpn && (ret = tls_set_alpn(h, p->alpn)) < 0)
+        goto fail;
+#endif
+    if (p->session_key[0]) {
+        SSL_set_app_data(p->ssl, p);
+        tls_session_apply(p);
+    }
+    av_application_on_net_stage(p->app_ctx, AVAPP_EVENT_WILL_TLS_HANDSHAKE, h, c->host, 0);
     ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
+    av_application_on_net_stage(p->app_ctx, AVAPP_EVENT_DID_TLS_HANDSHAKE, h, c->host, ret == 1 ? 0 : AVERROR(EIO));
     if (ret == 0) {
         av_log(h, AV_LOG_ERROR, "Unable to negotiate TLS/SSL session\n");
         ret = AVERROR(EIO);
@@ -293,8 +480,24 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         goto fail;
     }
 
+    if (p->session_key[0])
+        tls_session_report(p, c->host, SSL_session_reused(p->ssl));
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+    if (p->alpn) {
+        const unsigned char *selected;
+        unsigned selected_len;
+        SSL_get0_alpn_selected(p->ssl, &selected, &selected_len);
+        if (selected_len && !(p->alpn_selected = av_strndup((const char *)selected, selected_len))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
+
     return 0;
 fail:
+    if (p->session_key[0])
+        tls_session_remove(p->session_key);
     tls_close(h);
     return ret;
 }
@@ -302,7 +505,11 @@ fail:
 static int tls_read(URLContext *h, uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
-    int ret = SSL_read(c->ssl, buf, size);
+    int ret;
+    // non blocking down to tcp, the bio turns its EAGAIN into a retry
+    c->tls_shared.tcp->flags &= ~AVIO_FLAG_NONBLOCK;
+    c->tls_shared.tcp->flags |= h->flags & AVIO_FLAG_NONBLOCK;
+    ret = SSL_read(c->ssl, buf, size);
     if (ret > 0)
         return ret;
     if (ret == 0)
@@ -313,7 +520,10 @@ static int tls_read(URLContext *h, uint8_t *buf, int size)
 static int tls_write(URLContext *h, const uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
-    int ret = SSL_write(c->ssl, buf, size);
+    int ret;
+    c->tls_shared.tcp->flags &= ~AVIO_FLAG_NONBLOCK;
+    c->tls_shared.tcp->flags |= h->flags & AVIO_FLAG_NONBLOCK;
+    ret = SSL_write(c->ssl, buf, size);
     if (ret > 0)
         return ret;
     if (ret == 0)
@@ -329,6 +539,10 @@ static int tls_get_file_handle(URLContext *h)
 
 static const AVOption options[] = {
     TLS_COMMON_OPTIONS(TLSContext, tls_shared),
+    { "tls_session_cache", "resume sessions of earlier connections to the same host", offsetof(TLSContext, session_cache), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, .flags = TLS_OPTFL },
+    { "ijkapplication", "AVApplicationContext", offsetof(TLSContext, app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, .flags = TLS_OPTFL },
+    { "alpn", "protocols offered to the server, comma separated", offsetof(TLSContext, alpn), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL },
+    { "alpn_selected", "export the protocol the server selected", offsetof(TLSContext, alpn_selected), AV_OPT_TYPE_STRING, .flags = AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { NULL }
 };
 
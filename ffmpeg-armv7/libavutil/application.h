@@ -31,6 +31,17 @@
 #define AVAPP_EVENT_ASYNC_STATISTIC     0x11000 //AVAppAsyncStatistic
 #define AVAPP_EVENT_ASYNC_READ_SPEED    0x11001 //AVAppAsyncReadSpeed
 #define AVAPP_EVENT_IO_TRAFFIC          0x12204 //AVAppIOTraffic
+#define AVAPP_EVENT_DNS_STATISTIC       0x12205 //AVAppDnsStatistic
+#define AVAPP_EVENT_HTTP_POOL_STATISTIC 0x12206 //AVAppHttpPoolStatistic
+#define AVAPP_EVENT_TLS_STATISTIC       0x12207 //AVAppTlsStatistic
+#define AVAPP_EVENT_HLS_VARIANT_SWITCH  0x12208 //AVAppVariantSwitch
+#define AVAPP_EVENT_WILL_DNS_RESOLVE    0x12209 //AVAppNetStage
+#define AVAPP_EVENT_DID_DNS_RESOLVE     0x1220a //AVAppNetStage
+#define AVAPP_EVENT_WILL_TLS_HANDSHAKE  0x1220b //AVAppNetStage
+#define AVAPP_EVENT_DID_TLS_HANDSHAKE   0x1220c //AVAppNetStage
+#define AVAPP_EVENT_HTTP3_STATISTIC     0x1220d //AVAppHttp3Statistic
+#define AVAPP_EVENT_HTTP_MIRROR         0x1220e //AVAppHttpMirror
+#define AVAPP_EVENT_HTTP_REQUEST        0x1220f //AVAppHttpRequest
 
 #define AVAPP_CTRL_WILL_TCP_OPEN   0x20001 //AVAppTcpIOControl
 #define AVAPP_CTRL_DID_TCP_OPEN    0x20002 //AVAppTcpIOControl
@@ -39,6 +50,9 @@
 #define AVAPP_CTRL_WILL_LIVE_OPEN  0x20005 //AVAppIOControl
 
 #define AVAPP_CTRL_WILL_CONCAT_SEGMENT_OPEN 0x20007 //AVAppIOControl
+#define AVAPP_CTRL_ASYNC_READ_AHEAD         0x20008 //AVAppAsyncReadAhead
+#define AVAPP_CTRL_HLS_BUFFER_LEVEL         0x20009 //AVAppBufferLevel
+#define AVAPP_CTRL_HLS_KEY                  0x2000a //AVAppHLSKey
 
 typedef struct AVAppIOControl {
     size_t  size;
@@ -56,6 +70,7 @@ typedef struct AVAppTcpIOControl {
     char ip[96];
     int  port;
     int  fd;
+    int64_t elapsed_milli;  /* time spent in connect() */
 } AVAppTcpIOControl;
 
 typedef struct AVAppAsyncStatistic {
@@ -63,6 +78,7 @@ typedef struct AVAppAsyncStatistic {
     int64_t buf_backwards;
     int64_t buf_forwards;
     int64_t buf_capacity;
+    int64_t buf_memory;     /* bytes of memory the ring holds, 0 when backed by a file */
 } AVAppAsyncStatistic;
 
 typedef struct AVAppAsyncReadSpeed {
@@ -72,6 +88,30 @@ typedef struct AVAppAsyncReadSpeed {
     int64_t elapsed_milli;
 } AVAppAsyncReadSpeed;
 
+typedef struct AVAppAsyncReadAhead {
+    size_t  size;
+    int64_t read_speed;     /* in, download speed in bytes per second, 0 if unknown */
+    int64_t bit_rate;       /* out, stream bit rate in bits per second, 0 if unknown */
+    int64_t max_io_rate;    /* out, bytes per second the download may use, 0 for no limit, < 0 to suspend it */
+    int64_t max_memory;     /* out, bytes of memory the ring may keep, 0 for no limit; it does not grow back */
+} AVAppAsyncReadAhead;
+
+typedef struct AVAppBufferLevel {
+    size_t  size;
+    int64_t cached_duration_milli;  /* out, playable duration buffered by the player, -1 if unknown */
+    int64_t audio_cached_duration_milli;    /* out, of the audio stream alone, -1 if unknown */
+    int64_t video_cached_duration_milli;    /* out, of the video stream alone, -1 if unknown */
+    int64_t max_bitrate;            /* out, bits per second the variants picked stay under, 0 for no cap */
+    int     audio_only;             /* out, the video is not played: an audio only variant, or the lowest one */
+} AVAppBufferLevel;
+
+typedef struct AVAppHLSKey {
+    size_t  size;
+    char    url[4096];      /* in, the URI of EXT-X-KEY */
+    uint8_t key[16];        /* out, the AES-128 key */
+    int     is_handled;     /* out, key is set and nothing is fetched, default = false */
+} AVAppHLSKey;
+
 typedef struct AVAppHttpEvent
 {
     void    *obj;
@@ -81,6 +121,113 @@ typedef struct AVAppHttpEvent
     int      http_code;
 } AVAppHttpEvent;
 
+typedef struct AVAppDnsStatistic
+{
+    size_t  size;
+    char    hostname[1024];
+    int     cache_result;   /* 0: miss, 1: hit, 2: negative hit */
+    int     error;          /* getaddrinfo() error, 0 on success */
+    int64_t elapsed_milli;  /* time spent in lookup and resolve */
+
+    /* process wide totals */
+    int64_t hits;
+    int64_t negative_hits;
+    int64_t misses;
+} AVAppDnsStatistic;
+
+typedef struct AVAppHttpPoolStatistic
+{
+    size_t  size;
+    int     is_reused;      /* this open leased an idle connection */
+
+    /* process wide totals */
+    int64_t opened;
+    int64_t reused;
+    int     idle;
+} AVAppHttpPoolStatistic;
+
+typedef struct AVAppTlsStatistic
+{
+    size_t  size;
+    char    host[1024];
+    int     is_resumed;     /* abbreviated handshake with a cached session */
+
+    /* process wide totals */
+    int64_t handshakes;
+    int64_t resumed;
+} AVAppTlsStatistic;
+
+typedef struct AVAppVariantSwitch
+{
+    size_t  size;
+    int     from_bitrate;           /* BANDWIDTH of the variants */
+    int     to_bitrate;
+    int64_t estimated_bandwidth;    /* bits per second */
+    int64_t buffered_milli;         /* -1 if unknown */
+    int     seq_no;                 /* first segment of the new variant */
+} AVAppVariantSwitch;
+
+/* begin and end of a connection setup step, for tracing */
+typedef struct AVAppNetStage
+{
+    size_t  size;
+    void   *obj;            /* URLContext, the same in the will and did events */
+    char    host[1024];
+    int     error;          /* did events only, 0 on success */
+} AVAppNetStage;
+
+/* a request through the HTTP/3 transport, when it is closed */
+typedef struct AVAppHttp3Statistic
+{
+    size_t  size;
+    char    host[1024];
+    char    protocol[16];   /* ALPN of the connection, "h3" unless it fell back */
+    char    remote_ip[64];
+    int     reused;
+    int64_t connect_time;   /* microseconds, 0 if reused */
+    int64_t request_time;   /* microseconds */
+    int64_t bytes;
+} AVAppHttp3Statistic;
+
+#define AVAPP_HTTP_MIRROR_RACE      0   /* won the race of the open */
+#define AVAPP_HTTP_MIRROR_FAILOVER  1   /* took over from a failed or stalled one */
+
+typedef struct AVAppHttpMirror
+{
+    size_t  size;
+    char    url[4096];      /* the request to the mirror */
+    int     reason;         /* AVAPP_HTTP_MIRROR_* */
+    int     error;          /* of the one failed over from */
+    int64_t offset;         /* the response continued from */
+    int64_t elapsed;        /* microseconds to its response head */
+} AVAppHttpMirror;
+
+/* a request once its response is read to the end, given up on or failed;
+ * a redirect or an authentication round is a request of its own. Times
+ * are microseconds, 0 for the steps the request went without. */
+typedef struct AVAppHttpRequest
+{
+    size_t  size;
+    char    url[4096];
+    char    protocol[16];   /* "http/1.1", "h2" or "h3" */
+    int     http_code;      /* 0 without a response */
+    int     error;          /* 0, or what ended the request */
+    int     is_complete;    /* the body was read to its end */
+    int     is_reused;      /* on a connection kept from an earlier request */
+    int64_t offset;         /* first byte asked for */
+    int64_t bytes;          /* of the body read */
+    int64_t start_time;     /* av_gettime() */
+    int64_t dns_time;
+    int64_t connect_time;   /* once resolved; for h2 and h3 the setup of the stream */
+    int64_t tls_time;
+    int64_t send_time;      /* connected to the request written */
+    int64_t wait_time;      /* the request written to the first byte of the response */
+    int64_t receive_time;   /* the first byte of the response to the last one read */
+    char    cache_status[64];   /* X-Cache, X-Cache-Status or CF-Cache-Status */
+    int64_t age;            /* Age of the response in seconds, -1 without */
+    char    edge[128];      /* the CDN server answering: X-Served-By, X-Amz-Cf-Pop or Via */
+} AVAppHttpRequest;
+
 typedef struct AVAppIOTraffic
 {
     void   *obj;
@@ -115,6 +262,17 @@ int av_application_on_tcp_did_open(AVApplicationContext *h, int error, int fd, A
 
 void av_application_on_async_statistic(AVApplicationContext *h, AVAppAsyncStatistic *statistic);
 void av_application_on_async_read_speed(AVApplicationContext *h, AVAppAsyncReadSpeed *speed);
+int  av_application_on_async_read_ahead(AVApplicationContext *h, AVAppAsyncReadAhead *control);
+void av_application_on_dns_statistic(AVApplicationContext *h, AVAppDnsStatistic *statistic);
+void av_application_on_http_pool_statistic(AVApplicationContext *h, AVAppHttpPoolStatistic *statistic);
+void av_application_on_tls_statistic(AVApplicationContext *h, AVAppTlsStatistic *statistic);
+int  av_application_on_buffer_level(AVApplicationContext *h, AVAppBufferLevel *control);
+int  av_application_on_hls_key(AVApplicationContext *h, AVAppHLSKey *control);
+void av_application_on_variant_switch(AVApplicationContext *h, AVAppVariantSwitch *event);
+void av_application_on_net_stage(AVApplicationContext *h, int event_type, void *obj, const char *host, int error);
+void av_application_on_http3_statistic(AVApplicationContext *h, AVAppHttp3Statistic *statistic);
+void av_application_on_http_mirror(AVApplicationContext *h, AVAppHttpMirror *event);
+void av_application_on_http_request(AVApplicationContext *h, AVAppHttpRequest *event);
 
 
 #endif /* AVUTIL_APPLICATION_H */
@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/avassert.h"
 
@@ -102,6 +103,66 @@ DECLARE_RESAMPLE_COMMON_TEMPLATE(float, float, float, float, OUT)
 DECLARE_RESAMPLE_COMMON_TEMPLATE(s16, int16_t, int16_t, int32_t, OUT)
 #undef OUT
 
+void ff_resample_common_apply_filter_x8_stereo_float_neon(float *acc, const float *src0,
+                                                          const float *src1, const float *filter,
+                                                          int length);
+
+/* Each filter is loaded once for both channels, and the two samples are
+ * converted and stored side by side as they come, the way out_convert
+ * would have in a pass of its own. */
+static int ff_resample_stereo_s16_neon(ResampleContext *c, int16_t *dst, const void *source0,
+                                       const void *source1, int n)
+{
+    const float *src0 = source0;
+    const float *src1 = source1;
+    int dst_index;
+    int index = c->index;
+    int frac = c->frac;
+    int sample_index = 0;
+    int x8_aligned_filter_length = c->filter_length & ~7;
+
+    while (index >= c->phase_count) {
+        sample_index++;
+        index -= c->phase_count;
+    }
+
+    for (dst_index = 0; dst_index < n; dst_index++) {
+        const float *filter = ((const float *) c->filter_bank) + c->filter_alloc * index;
+        float val[2] = { 0, 0 };
+        int i = 0;
+
+        if (x8_aligned_filter_length >= 8) {
+            ff_resample_common_apply_filter_x8_stereo_float_neon(val, &src0[sample_index],
+                                                                 &src1[sample_index], filter,
+                                                                 x8_aligned_filter_length);
+            i += x8_aligned_filter_length;
+        }
+        for (; i < c->filter_length; i++) {
+            val[0] += src0[sample_index + i] * filter[i];
+            val[1] += src1[sample_index + i] * filter[i];
+        }
+        dst[2 * dst_index    ] = av_clip_int16(lrintf(val[0] * (1 << 15)));
+        dst[2 * dst_index + 1] = av_clip_int16(lrintf(val[1] * (1 << 15)));
+
+        frac  += c->dst_incr_mod;
+        index += c->dst_incr_div;
+        if (frac >= c->src_incr) {
+            frac -= c->src_incr;
+            index++;
+        }
+
+        while (index >= c->phase_count) {
+            sample_index++;
+            index -= c->phase_count;
+        }
+    }
+
+    c->frac = frac;
+    c->index = index;
+
+    return sample_index;
+}
+
 av_cold void swri_resample_dsp_aarch64_init(ResampleContext *c)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -112,6 +173,7 @@ av_cold void swri_resample_dsp_aarch64_init(ResampleContext *c)
     switch(c->format) {
     case AV_SAMPLE_FMT_FLTP:
         c->dsp.resample_common = ff_resample_common_float_neon;
+        c->dsp.resample_stereo_s16 = ff_resample_stereo_s16_neon;
         break;
     case AV_SAMPLE_FMT_S16P:
         c->dsp.resample_common = ff_resample_common_s16_neon;
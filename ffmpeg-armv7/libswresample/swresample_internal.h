@@ -77,6 +77,7 @@ typedef int     (* set_compensation_func)(struct ResampleContext *c, int sample_
 typedef int64_t (* get_delay_func)(struct SwrContext *s, int64_t base);
 typedef int     (* invert_initial_buffer_func)(struct ResampleContext *c, AudioData *dst, const AudioData *src, int src_size, int *dst_idx, int *dst_count);
 typedef int64_t (* get_out_samples_func)(struct SwrContext *s, int in_samples);
+typedef int     (* packed_output_func)(struct ResampleContext *c, enum AVSampleFormat fmt, int ch_count);
 
 struct Resampler {
   resample_init_func            init;
@@ -87,6 +88,7 @@ struct Resampler {
   get_delay_func                get_delay;
   invert_initial_buffer_func    invert_initial_buffer;
   get_out_samples_func          get_out_samples;
+  packed_output_func            packed_output;  ///< whether multiple_resample() can write fmt packed, NULL if never
 };
 
 extern struct Resampler const swri_resampler;
@@ -142,6 +144,7 @@ struct SwrContext {
     int64_t firstpts_in_samples;                    ///< swr first pts in samples
 
     int resample_first;                             ///< 1 if resampling must come first, 0 if rematrixing
+    int packed_resample;                            ///< 1 if the resampler writes the packed output, without out_convert
     int rematrix;                                   ///< flag to indicate if rematrixing is needed (basically if input and output layouts mismatch)
     int rematrix_custom;                            ///< flag to indicate that a custom matrix has been defined
 
@@ -0,0 +1,219 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavcodec/aacpsdsp.h"
+
+#include "checkasm.h"
+
+#define N 32
+#define STRIDE 128
+#define EPS 0.0001
+
+#define randomize(buf, len)                                     \
+    do {                                                        \
+        int k;                                                  \
+        for (k = 0; k < len; k++)                               \
+            (buf)[k] = (float)((int)(rnd() & 0xffff) - 0x8000) / 0x4000; \
+    } while (0)
+
+static void test_add_squares(void)
+{
+    LOCAL_ALIGNED_16(float, dst0, [N]);
+    LOCAL_ALIGNED_16(float, dst1, [N]);
+    LOCAL_ALIGNED_16(float, src,  [N], [2]);
+
+    declare_func(void, float *dst, const float (*src)[2], int n);
+
+    randomize((float *)src, N * 2);
+    randomize(dst0, N);
+    memcpy(dst1, dst0, N * sizeof(float));
+
+    call_ref(dst0, src, N);
+    call_new(dst1, src, N);
+    if (!float_near_abs_eps_array(dst0, dst1, EPS, N))
+        fail();
+    bench_new(dst1, src, N);
+}
+
+static void test_mul_pair_single(void)
+{
+    LOCAL_ALIGNED_16(float, dst0, [N], [2]);
+    LOCAL_ALIGNED_16(float, dst1, [N], [2]);
+    LOCAL_ALIGNED_16(float, src0, [N], [2]);
+    LOCAL_ALIGNED_16(float, src1, [N]);
+
+    declare_func(void, float (*dst)[2], float (*src0)[2], float *src1, int n);
+
+    randomize((float *)src0, N * 2);
+    randomize(src1, N);
+
+    call_ref(dst0, src0, src1, N);
+    call_new(dst1, src0, src1, N);
+    if (memcmp(dst0, dst1, N * 2 * sizeof(float)))
+        fail();
+    bench_new(dst1, src0, src1, N);
+}
+
+static void test_hybrid_analysis(void)
+{
+    LOCAL_ALIGNED_16(float, dst0,   [STRIDE * 8], [2]);
+    LOCAL_ALIGNED_16(float, dst1,   [STRIDE * 8], [2]);
+    LOCAL_ALIGNED_16(float, in,     [13], [2]);
+    LOCAL_ALIGNED_16(float, filter, [8], [8][2]);
+    int stride;
+
+    declare_func(void, float (*out)[2], float (*in)[2],
+                 const float (*filter)[8][2], int stride, int n);
+
+    randomize((float *)in, 13 * 2);
+    randomize((float *)filter, 8 * 8 * 2);
+
+    /* the strides of the hybrid analysis in aacps */
+    for (stride = 1; stride <= 32; stride += 31) {
+        int n = stride == 1 ? 8 : 4;
+        memset(dst0, 0, STRIDE * 8 * 2 * sizeof(float));
+        memset(dst1, 0, STRIDE * 8 * 2 * sizeof(float));
+        call_ref(dst0, in, (const float (*)[8][2])filter, stride, n);
+        call_new(dst1, in, (const float (*)[8][2])filter, stride, n);
+        if (!float_near_abs_eps_array((float *)dst0, (float *)dst1, EPS, STRIDE * 8 * 2))
+            fail();
+    }
+    bench_new(dst1, in, (const float (*)[8][2])filter, 1, 8);
+}
+
+static void test_hybrid_analysis_ileave(void)
+{
+    LOCAL_ALIGNED_16(float, in,   [2], [38][64]);
+    LOCAL_ALIGNED_16(float, out0, [91], [32][2]);
+    LOCAL_ALIGNED_16(float, out1, [91], [32][2]);
+    int i;
+
+    declare_func(void, float (*out)[32][2], float L[2][38][64], int i, int len);
+
+    randomize((float *)in, 2 * 38 * 64);
+    /* the bands aacps starts from */
+    for (i = 3; i <= 5; i += 2) {
+        memset(out0, 0, 91 * 32 * 2 * sizeof(float));
+        memset(out1, 0, 91 * 32 * 2 * sizeof(float));
+        call_ref(out0, in, i, 32);
+        call_new(out1, in, i, 32);
+        if (memcmp(out0, out1, 91 * 32 * 2 * sizeof(float)))
+            fail();
+    }
+    bench_new(out1, in, 3, 32);
+}
+
+static void test_hybrid_synthesis_deint(void)
+{
+    LOCAL_ALIGNED_16(float, out0, [2], [38][64]);
+    LOCAL_ALIGNED_16(float, out1, [2], [38][64]);
+    LOCAL_ALIGNED_16(float, in,   [91], [32][2]);
+    int i;
+
+    declare_func(void, float out[2][38][64], float (*in)[32][2], int i, int len);
+
+    randomize((float *)in, 91 * 32 * 2);
+    for (i = 3; i <= 5; i += 2) {
+        memset(out0, 0, 2 * 38 * 64 * sizeof(float));
+        memset(out1, 0, 2 * 38 * 64 * sizeof(float));
+        call_ref(out0, in, i, 32);
+        call_new(out1, in, i, 32);
+        if (memcmp(out0, out1, 2 * 38 * 64 * sizeof(float)))
+            fail();
+    }
+    bench_new(out1, in, 3, 32);
+}
+
+static void test_stereo_interpolate(PSDSPContext *psdsp)
+{
+    LOCAL_ALIGNED_16(float, l,  [N], [2]);
+    LOCAL_ALIGNED_16(float, r,  [N], [2]);
+    LOCAL_ALIGNED_16(float, l0, [N], [2]);
+    LOCAL_ALIGNED_16(float, r0, [N], [2]);
+    LOCAL_ALIGNED_16(float, l1, [N], [2]);
+    LOCAL_ALIGNED_16(float, r1, [N], [2]);
+    LOCAL_ALIGNED_16(float, h,      [2], [4]);
+    LOCAL_ALIGNED_16(float, h_step, [2], [4]);
+    int i, len;
+
+    declare_func(void, float (*l)[2], float (*r)[2],
+                 float h[2][4], float h_step[2][4], int len);
+
+    randomize((float *)l, N * 2);
+    randomize((float *)r, N * 2);
+
+    for (i = 0; i < 2; i++) {
+        if (check_func(psdsp->stereo_interpolate[i], "ps_stereo_interpolate%s",
+                       i ? "_ipdopd" : "")) {
+            /* odd lengths too, the borders of the envelopes are arbitrary */
+            for (len = N - 1; len <= N; len++) {
+                memcpy(l0, l, N * 2 * sizeof(float));
+                memcpy(r0, r, N * 2 * sizeof(float));
+                memcpy(l1, l, N * 2 * sizeof(float));
+                memcpy(r1, r, N * 2 * sizeof(float));
+
+                randomize((float *)h, 2 * 4);
+                randomize((float *)h_step, 2 * 4);
+
+                call_ref(l0, r0, h, h_step, len);
+                call_new(l1, r1, h, h_step, len);
+                if (!float_near_abs_eps_array((float *)l0, (float *)l1, EPS, N * 2) ||
+                    !float_near_abs_eps_array((float *)r0, (float *)r1, EPS, N * 2))
+                    fail();
+            }
+
+            memcpy(l1, l, N * 2 * sizeof(float));
+            memcpy(r1, r, N * 2 * sizeof(float));
+            bench_new(l1, r1, h, h_step, N);
+        }
+    }
+}
+
+void checkasm_check_aacpsdsp(void)
+{
+    PSDSPContext psdsp;
+
+    ff_psdsp_init(&psdsp);
+
+    if (check_func(psdsp.add_squares, "ps_add_squares"))
+        test_add_squares();
+    report("add_squares");
+
+    if (check_func(psdsp.mul_pair_single, "ps_mul_pair_single"))
+        test_mul_pair_single();
+    report("mul_pair_single");
+
+    if (check_func(psdsp.hybrid_analysis, "ps_hybrid_analysis"))
+        test_hybrid_analysis();
+    report("hybrid_analysis");
+
+    if (check_func(psdsp.hybrid_analysis_ileave, "ps_hybrid_analysis_ileave"))
+        test_hybrid_analysis_ileave();
+    report("hybrid_analysis_ileave");
+
+    if (check_func(psdsp.hybrid_synthesis_deint, "ps_hybrid_synthesis_deint"))
+        test_hybrid_synthesis_deint();
+    report("hybrid_synthesis_deint");
+
+    test_stereo_interpolate(&psdsp);
+    report("stereo_interpolate");
+}
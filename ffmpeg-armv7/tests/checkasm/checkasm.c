@@ -65,6 +65,10 @@ static const struct {
     void (*func)(void);
 } tests[] = {
 #if CONFIG_AVCODEC
+    #if CONFIG_AAC_DECODER
+        { "aacpsdsp", checkasm_check_aacpsdsp },
+        { "sbrdsp",   checkasm_check_sbrdsp },
+    #endif
     #if CONFIG_ALAC_DECODER
         { "alacdsp", checkasm_check_alacdsp },
     #endif
@@ -105,6 +109,9 @@ static const struct {
     #if CONFIG_HUFFYUVDSP
         { "llviddsp", checkasm_check_llviddsp },
     #endif
+    #if CONFIG_OPUS_DECODER
+        { "opusdsp", checkasm_check_opusdsp },
+    #endif
     #if CONFIG_PIXBLOCKDSP
         { "pixblockdsp", checkasm_check_pixblockdsp },
     #endif
@@ -128,6 +135,12 @@ static const struct {
     #if CONFIG_COLORSPACE_FILTER
         { "vf_colorspace", checkasm_check_colorspace },
     #endif
+#endif
+#if CONFIG_SWRESAMPLE
+    { "sw_resample", checkasm_check_sw_resample },
+#endif
+#if CONFIG_SWSCALE
+    { "sw_scale", checkasm_check_sw_scale },
 #endif
     { NULL }
 };
@@ -401,7 +414,7 @@ static void print_benchs(CheckasmFunc *f)
             CheckasmFuncVersion *v = &f->versions;
             do {
                 if (v->iterations) {
-                    int decicycles = (10*v->cycles/v->iterations - state.nop_time) / 4;
+                    int decicycles = (10*v->cycles/v->iterations - state.nop_time/BENCH_CALLS) / 4;
                     printf("%s_%s: %d.%d\n", f->name, cpu_suffix(v->cpu), decicycles/10, decicycles%10);
                 }
             } while ((v = v->next));
@@ -513,7 +526,11 @@ static void print_cpu_name(void)
     }
 }
 
+#ifdef CHECKASM_LIBRARY
+int checkasm_main(int argc, char *argv[])
+#else
 int main(int argc, char *argv[])
+#endif
 {
     unsigned int seed = av_get_random_seed();
     int i, ret = 0;
@@ -564,6 +581,9 @@ int main(int argc, char *argv[])
 #ifdef AV_READ_TIME
         if (state.bench_pattern) {
             state.nop_time = measure_nop_time();
+#if ARCH_AARCH64 && defined(__APPLE__)
+            printf("units: ns\n");
+#endif
             printf("nop: %d.%d\n", state.nop_time/10, state.nop_time%10);
             print_benchs(state.funcs);
         }
@@ -571,6 +591,11 @@ int main(int argc, char *argv[])
     }
 
     destroy_func_tree(state.funcs);
+#ifdef CHECKASM_LIBRARY
+    /* leave the host app as it was, for another run */
+    memset(&state, 0, sizeof(state));
+    av_force_cpu_flags(-1);
+#endif
     return ret;
 }
 
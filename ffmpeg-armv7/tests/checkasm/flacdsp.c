@@ -53,6 +53,33 @@ static void check_decorrelate(uint8_t **ref_dst, uint8_t **ref_src, uint8_t **ne
     bench_new(new_dst, (int32_t **)new_src, channels, BUF_SIZE / sizeof(int32_t), 8);
 }
 
+#define LPC_SAMPLES (BUF_SIZE / 4)
+#define LPC_LEN     (LPC_SAMPLES - 3)
+
+static void check_lpc(int order, int bits)
+{
+    LOCAL_ALIGNED_16(int32_t, ref_samples, [LPC_SAMPLES]);
+    LOCAL_ALIGNED_16(int32_t, new_samples, [LPC_SAMPLES]);
+    int coeffs[32];
+    int qlevel = rnd() % 16;
+    int i;
+
+    declare_func(void, int32_t *samples, const int coeffs[32], int order,
+                 int qlevel, int len);
+
+    /* the ones past the order are not used */
+    for (i = 0; i < 32; i++)
+        coeffs[i] = i < order ? (int)(rnd() & 0x7fff) - 0x4000 : (int)rnd();
+    for (i = 0; i < LPC_SAMPLES; i++)
+        ref_samples[i] = new_samples[i] = (int32_t)(rnd() & ((1 << bits) - 1)) - (1 << (bits - 1));
+
+    call_ref(ref_samples, coeffs, order, qlevel, LPC_LEN);
+    call_new(new_samples, coeffs, order, qlevel, LPC_LEN);
+    if (memcmp(ref_samples, new_samples, BUF_SIZE))
+        fail();
+    bench_new(new_samples, coeffs, order, qlevel, LPC_LEN);
+}
+
 void checkasm_check_flacdsp(void)
 {
     LOCAL_ALIGNED_16(uint8_t, ref_dst, [BUF_SIZE*MAX_CHANNELS]);
@@ -87,4 +114,14 @@ void checkasm_check_flacdsp(void)
     }
 
     report("decorrelate");
+
+    ff_flacdsp_init(&h, AV_SAMPLE_FMT_S32, 2, 0);
+    for (i = 1; i <= 32; i++) {
+        if (check_func(h.lpc16, "flac_lpc_16_%d", i))
+            check_lpc(i, 16);
+        if (check_func(h.lpc32, "flac_lpc_32_%d", i))
+            check_lpc(i, 24);
+    }
+
+    report("lpc");
 }
@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/opusdsp.h"
+#include "libavcodec/opus_celt.h"
+#include "libavutil/internal.h"
+
+#define PERIOD_MAX 1024
+#define BUF_SIZE   720
+#define DATA_SIZE  (PERIOD_MAX + 2 + BUF_SIZE)
+#define EPS        0.005
+
+#define randomize_float(buf, len)                               \
+    do {                                                        \
+        int i;                                                  \
+        for (i = 0; i < len; i++) {                             \
+            float f = (float)rnd() / (UINT_MAX >> 1) - 1.0f;    \
+            buf[i] = f;                                         \
+        }                                                       \
+    } while (0)
+
+static void test_postfilter(int period)
+{
+    LOCAL_ALIGNED_16(float, data0, [DATA_SIZE]);
+    LOCAL_ALIGNED_16(float, data1, [DATA_SIZE]);
+    LOCAL_ALIGNED_16(float, gains, [4]);
+    float *in0 = data0 + PERIOD_MAX + 2;
+    float *in1 = data1 + PERIOD_MAX + 2;
+
+    declare_func(void, float *data, int period, const float *gains, int len);
+
+    randomize_float(data0, DATA_SIZE);
+    memcpy(data1, data0, DATA_SIZE * sizeof(float));
+    randomize_float(gains, 3);
+
+    call_ref(in0, period, gains, BUF_SIZE);
+    call_new(in1, period, gains, BUF_SIZE);
+    if (!float_near_abs_eps_array(data0, data1, EPS, DATA_SIZE))
+        fail();
+    bench_new(in1, period, gains, BUF_SIZE);
+}
+
+static void test_deemphasis(void)
+{
+    LOCAL_ALIGNED_16(float, src, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(float, dst1, [BUF_SIZE]);
+    float state = (float)rnd() / (UINT_MAX >> 1) - 1.0f;
+    float ret0, ret1;
+    int i;
+
+    declare_func(float, float *out, const float *in, float state, int len);
+
+    /* at the scale of the CELT output, 16 bit samples */
+    randomize_float(src, BUF_SIZE);
+    for (i = 0; i < BUF_SIZE; i++)
+        src[i] *= 16384.0f;
+
+    ret0 = call_ref(dst0, src, state, BUF_SIZE);
+    ret1 = call_new(dst1, src, state, BUF_SIZE);
+    if (!float_near_abs_eps(ret0, ret1, EPS * 32768) ||
+        !float_near_abs_eps_array(dst0, dst1, EPS, BUF_SIZE))
+        fail();
+    bench_new(dst1, src, state, BUF_SIZE);
+}
+
+void checkasm_check_opusdsp(void)
+{
+    OpusDSP ctx;
+
+    ff_opus_dsp_init(&ctx);
+
+    if (check_func(ctx.postfilter, "postfilter_15"))
+        test_postfilter(CELT_POSTFILTER_MINPERIOD);
+    if (check_func(ctx.postfilter, "postfilter_512"))
+        test_postfilter(512);
+    if (check_func(ctx.postfilter, "postfilter_1022"))
+        test_postfilter(1022);
+    report("postfilter");
+
+    if (check_func(ctx.deemphasis, "deemphasis"))
+        test_deemphasis();
+    report("deemphasis");
+}
@@ -0,0 +1,277 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#include "checkasm.h"
+
+/* the neon versions need a multiple of 16 pixels and an even height */
+#define W 128
+#define H 16
+
+#define SRC_W 1920
+#define DST_W 1280
+
+/* The neon yuv2rgb works in 16 bits where the C one looks up 8 bit
+ * tables, so the two may disagree by a few steps. */
+#define YUV2RGB_MAX_DIFF 3
+
+#define randomize_buffer(buf, len)                  \
+    do {                                            \
+        int k;                                      \
+        for (k = 0; k < len; k += 4)                \
+            AV_WN32(&(buf)[k], rnd());              \
+    } while (0)
+
+static const enum AVPixelFormat yuv2rgb_src[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+};
+
+static const enum AVPixelFormat yuv2rgb_dst[] = {
+    AV_PIX_FMT_ARGB, AV_PIX_FMT_RGBA, AV_PIX_FMT_ABGR, AV_PIX_FMT_BGRA,
+};
+
+/* C conversions from yuv420p, by output format, for the nv references */
+static SwsFunc yuv2rgb_c[FF_ARRAY_ELEMS(yuv2rgb_dst)];
+
+/* libswscale has no unscaled C path from nv12/nv21 to rgb, this one
+ * splits the chroma and goes through the yuv420p conversion. */
+static int nv_to_rgbx_c(SwsContext *c, const uint8_t *src[], int srcStride[],
+                        int srcSliceY, int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    static uint8_t u[W / 2 * H / 2], v[W / 2 * H / 2];
+    const uint8_t *planes[4] = { src[0], u, v, NULL };
+    int strides[4] = { srcStride[0], W / 2, W / 2, 0 };
+    int swap = c->srcFormat == AV_PIX_FMT_NV21;
+    int i, x, y;
+
+    for (y = 0; y < srcSliceH / 2; y++) {
+        for (x = 0; x < W / 2; x++) {
+            u[y * W / 2 + x] = src[1][y * srcStride[1] + 2 * x + swap];
+            v[y * W / 2 + x] = src[1][y * srcStride[1] + 2 * x + !swap];
+        }
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(yuv2rgb_dst); i++)
+        if (yuv2rgb_dst[i] == c->dstFormat)
+            return yuv2rgb_c[i](c, planes, strides, srcSliceY, srcSliceH, dst, dstStride);
+    return 0;
+}
+
+static int cmp_off_by_n(const uint8_t *a, const uint8_t *b, int len, int n)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (FFABS(a[i] - b[i]) > n)
+            return 1;
+    return 0;
+}
+
+static void check_yuv2rgb(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, src_y,  [W * H]);
+    LOCAL_ALIGNED_32(uint8_t, src_u,  [W * H]);
+    LOCAL_ALIGNED_32(uint8_t, src_v,  [W * H]);
+    LOCAL_ALIGNED_32(uint8_t, dst0,   [W * H * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst1,   [W * H * 4]);
+    int cpu_flags = av_get_cpu_flags();
+    int i, j, y;
+
+    declare_func(int, SwsContext *c, const uint8_t *src[], int srcStride[],
+                 int srcSliceY, int srcSliceH, uint8_t *dst[], int dstStride[]);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(yuv2rgb_src); i++) {
+        enum AVPixelFormat src_fmt = yuv2rgb_src[i];
+        int nv = src_fmt == AV_PIX_FMT_NV12 || src_fmt == AV_PIX_FMT_NV21;
+
+        for (j = 0; j < FF_ARRAY_ELEMS(yuv2rgb_dst); j++) {
+            enum AVPixelFormat dst_fmt = yuv2rgb_dst[j];
+            SwsContext *c = sws_getContext(W, H, src_fmt, W, H, dst_fmt,
+                                           SWS_BILINEAR, NULL, NULL, NULL);
+            SwsFunc func;
+
+            if (!c) {
+                fail();
+                continue;
+            }
+
+            func = c->swscale;
+            if (!cpu_flags && src_fmt == AV_PIX_FMT_YUV420P)
+                yuv2rgb_c[j] = func;
+            if (nv) {
+                /* only the neon versions convert nv unscaled */
+                if (!cpu_flags)
+                    func = nv_to_rgbx_c;
+                else if (!(ARCH_ARM || ARCH_AARCH64) || !(cpu_flags & AV_CPU_FLAG_NEON))
+                    func = NULL;
+            }
+
+            if (check_func(func, "yuv2rgb_%s_%s", av_get_pix_fmt_name(src_fmt),
+                           av_get_pix_fmt_name(dst_fmt))) {
+                const uint8_t *src[4] = { src_y, src_u, src_v, NULL };
+                uint8_t *dst_ref[4] = { dst0, NULL, NULL, NULL };
+                uint8_t *dst_new[4] = { dst1, NULL, NULL, NULL };
+                int chroma_w = nv ? W : W / 2;
+
+                randomize_buffer(src_y, W * H);
+                randomize_buffer(src_u, W * H);
+                randomize_buffer(src_v, W * H);
+                /* the C yuv422p conversion reads every other chroma line */
+                if (src_fmt == AV_PIX_FMT_YUV422P) {
+                    for (y = 0; y < H; y += 2) {
+                        memcpy(src_u + (y + 1) * chroma_w, src_u + y * chroma_w, chroma_w);
+                        memcpy(src_v + (y + 1) * chroma_w, src_v + y * chroma_w, chroma_w);
+                    }
+                }
+                memset(dst0, 0, W * H * 4);
+                memset(dst1, 0, W * H * 4);
+
+                /* the C versions scale the strides of yuv422p in place */
+                call_ref(c, src, (int[4]){ W, chroma_w, chroma_w, 0 }, 0, H,
+                         dst_ref, (int[4]){ W * 4, 0, 0, 0 });
+                call_new(c, src, (int[4]){ W, chroma_w, chroma_w, 0 }, 0, H,
+                         dst_new, (int[4]){ W * 4, 0, 0, 0 });
+                if (cmp_off_by_n(dst0, dst1, W * H * 4, YUV2RGB_MAX_DIFF))
+                    fail();
+
+                bench_new(c, src, (int[4]){ W, chroma_w, chroma_w, 0 }, 0, H,
+                          dst_new, (int[4]){ W * 4, 0, 0, 0 });
+            }
+            sws_freeContext(c);
+        }
+    }
+
+    report("yuv2rgb");
+}
+
+static void check_hscale(void)
+{
+    static const int filter_sizes[] = { 8, 16 };
+    LOCAL_ALIGNED_32(uint8_t, src,       [SRC_W + 16]);
+    LOCAL_ALIGNED_32(int16_t, filter,    [DST_W * 16]);
+    LOCAL_ALIGNED_32(int32_t, filterPos, [DST_W]);
+    LOCAL_ALIGNED_32(int16_t, dst0,      [DST_W]);
+    LOCAL_ALIGNED_32(int16_t, dst1,      [DST_W]);
+    SwsContext *c;
+    int i, j;
+
+    declare_func(void, SwsContext *c, int16_t *dst, int dstW, const uint8_t *src,
+                 const int16_t *filter, const int32_t *filterPos, int filterSize);
+
+    c = sws_getContext(SRC_W, H, AV_PIX_FMT_YUV420P, DST_W, H, AV_PIX_FMT_YUV420P,
+                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (!c) {
+        fail();
+        return;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(filter_sizes); i++) {
+        int filter_size = filter_sizes[i];
+
+        if (check_func(c->hyScale, "hscale_8_to_15_%d", filter_size)) {
+            randomize_buffer(src, SRC_W + 16);
+            for (j = 0; j < DST_W; j++)
+                filterPos[j] = (int64_t)j * (SRC_W - filter_size) / DST_W;
+            /* negative taps small enough that no sum of 16 falls below
+             * int16, which only the neon version saturates */
+            for (j = 0; j < DST_W * filter_size; j++)
+                filter[j] = (int)(rnd() % 5120) - 1024;
+            memset(dst0, 0, DST_W * sizeof(*dst0));
+            memset(dst1, 0, DST_W * sizeof(*dst1));
+
+            call_ref(c, dst0, DST_W, src, filter, filterPos, filter_size);
+            call_new(c, dst1, DST_W, src, filter, filterPos, filter_size);
+            if (memcmp(dst0, dst1, DST_W * sizeof(*dst0)))
+                fail();
+
+            bench_new(c, dst1, DST_W, src, filter, filterPos, filter_size);
+        }
+    }
+    sws_freeContext(c);
+
+    report("hscale");
+}
+
+static void check_yuv2planeX(void)
+{
+    static const int filter_sizes[] = { 2, 4, 8, 16 };
+    static const uint8_t dither[8] = { 64, 0, 48, 16, 60, 4, 52, 20 };
+    LOCAL_ALIGNED_32(int16_t, src_buf, [16 * DST_W]);
+    LOCAL_ALIGNED_32(int16_t, filter,  [16]);
+    LOCAL_ALIGNED_32(uint8_t, dst0,    [DST_W]);
+    LOCAL_ALIGNED_32(uint8_t, dst1,    [DST_W]);
+    const int16_t *src[16];
+    SwsContext *c;
+    int i, j, offset;
+
+    declare_func(void, const int16_t *filter, int filterSize, const int16_t **src,
+                 uint8_t *dest, int dstW, const uint8_t *dither, int offset);
+
+    c = sws_getContext(SRC_W, H, AV_PIX_FMT_YUV420P, DST_W, H, AV_PIX_FMT_YUV420P,
+                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (!c) {
+        fail();
+        return;
+    }
+
+    for (j = 0; j < 16; j++)
+        src[j] = src_buf + j * DST_W;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(filter_sizes); i++) {
+        int filter_size = filter_sizes[i];
+
+        /* the dither offset is 0 or 3 */
+        for (offset = 0; offset <= 3; offset += 3) {
+            if (check_func(c->yuv2planeX, "yuv2planeX_8_%d_%d", filter_size, offset)) {
+                /* 15 bit input as the horizontal scalers leave it, taps
+                 * kept away from overflowing the 32 bit sum */
+                for (j = 0; j < 16 * DST_W; j++)
+                    src_buf[j] = rnd() & 0x7fff;
+                for (j = 0; j < filter_size; j++)
+                    filter[j] = (int)(rnd() % 3072) - 1024;
+                memset(dst0, 0, DST_W);
+                memset(dst1, 0, DST_W);
+
+                call_ref(filter, filter_size, src, dst0, DST_W, dither, offset);
+                call_new(filter, filter_size, src, dst1, DST_W, dither, offset);
+                if (memcmp(dst0, dst1, DST_W))
+                    fail();
+
+                bench_new(filter, filter_size, src, dst1, DST_W, dither, offset);
+            }
+        }
+    }
+    sws_freeContext(c);
+
+    report("yuv2planeX");
+}
+
+void checkasm_check_sw_scale(void)
+{
+    check_yuv2rgb();
+    check_hscale();
+    check_yuv2planeX();
+}
@@ -25,28 +25,52 @@
  */
 
 #include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
+#include "internal.h"
 #include "version.h"
 
+/* With an allow list, the first pass registers its codecs only, along with
+ * every hwaccel and parser, and the second one, run on the first lookup that
+ * misses, the rest of them. */
+enum {
+    REGISTER_PASS_ALL,
+    REGISTER_PASS_ALLOWED,
+    REGISTER_PASS_REST,
+};
+
+static char *allow_list;
+static int   register_pass;
+static int   registered;
+static int   register_rest_pending;
+
+static int register_codec(const char *name)
+{
+    if (register_pass == REGISTER_PASS_ALL)
+        return 1;
+    return av_match_name(name, allow_list) == (register_pass == REGISTER_PASS_ALLOWED);
+}
+
 #define REGISTER_HWACCEL(X, x)                                          \
     {                                                                   \
         extern AVHWAccel ff_##x##_hwaccel;                              \
-        if (CONFIG_##X##_HWACCEL)                                       \
+        if (CONFIG_##X##_HWACCEL && register_pass != REGISTER_PASS_REST) \
             av_register_hwaccel(&ff_##x##_hwaccel);                     \
     }
 
 #define REGISTER_ENCODER(X, x)                                          \
     {                                                                   \
         extern AVCodec ff_##x##_encoder;                                \
-        if (CONFIG_##X##_ENCODER)                                       \
+        if (CONFIG_##X##_ENCODER && register_codec(#x))                 \
             avcodec_register(&ff_##x##_encoder);                        \
     }
 
 #define REGISTER_DECODER(X, x)                                          \
     {                                                                   \
         extern AVCodec ff_##x##_decoder;                                \
-        if (CONFIG_##X##_DECODER)                                       \
+        if (CONFIG_##X##_DECODER && register_codec(#x))                 \
             avcodec_register(&ff_##x##_decoder);                        \
     }
 
@@ -55,7 +79,7 @@
 #define REGISTER_PARSER(X, x)                                           \
     {                                                                   \
         extern AVCodecParser ff_##x##_parser;                           \
-        if (CONFIG_##X##_PARSER)                                        \
+        if (CONFIG_##X##_PARSER && register_pass != REGISTER_PASS_REST)  \
             av_register_codec_parser(&ff_##x##_parser);                 \
     }
 
@@ -390,6 +414,13 @@ static void register_all(void)
     REGISTER_ENCDEC (ZLIB,              zlib);
     REGISTER_ENCDEC (ZMBV,              zmbv);
 
+    /* AudioToolbox decoders, preferred over the native ones below; they
+     * fall back to them if the system decoder fails to open */
+    REGISTER_DECODER(AAC_AT,            aac_at);
+    REGISTER_DECODER(AC3_AT,            ac3_at);
+    REGISTER_DECODER(EAC3_AT,           eac3_at);
+    REGISTER_DECODER(MP3_AT,            mp3_at);
+
     /* audio codecs */
     REGISTER_ENCDEC (AAC,               aac);
     REGISTER_DECODER(AAC_FIXED,         aac_fixed);
@@ -588,22 +619,20 @@ static void register_all(void)
     REGISTER_ENCDEC (XSUB,              xsub);
 
     /* external libraries */
-    REGISTER_ENCDEC (AAC_AT,            aac_at);
-    REGISTER_DECODER(AC3_AT,            ac3_at);
+    REGISTER_ENCODER(AAC_AT,            aac_at);
     REGISTER_DECODER(ADPCM_IMA_QT_AT,   adpcm_ima_qt_at);
     REGISTER_ENCDEC (ALAC_AT,           alac_at);
     REGISTER_DECODER(AMR_NB_AT,         amr_nb_at);
-    REGISTER_DECODER(EAC3_AT,           eac3_at);
     REGISTER_DECODER(GSM_MS_AT,         gsm_ms_at);
     REGISTER_ENCDEC (ILBC_AT,           ilbc_at);
     REGISTER_DECODER(MP1_AT,            mp1_at);
     REGISTER_DECODER(MP2_AT,            mp2_at);
-    REGISTER_DECODER(MP3_AT,            mp3_at);
     REGISTER_ENCDEC (PCM_ALAW_AT,       pcm_alaw_at);
     REGISTER_ENCDEC (PCM_MULAW_AT,      pcm_mulaw_at);
     REGISTER_DECODER(QDMC_AT,           qdmc_at);
     REGISTER_DECODER(QDM2_AT,           qdm2_at);
     REGISTER_DECODER(LIBCELT,           libcelt);
+    REGISTER_DECODER(LIBDAV1D,          libdav1d);
     REGISTER_ENCDEC (LIBFDK_AAC,        libfdk_aac);
     REGISTER_ENCDEC (LIBGSM,            libgsm);
     REGISTER_ENCDEC (LIBGSM_MS,         libgsm_ms);
@@ -717,9 +746,45 @@ static void register_all(void)
     REGISTER_PARSER(XMA,                xma);
 }
 
+static void register_allowed(void)
+{
+    registered = 1;
+    if (allow_list) {
+        register_pass         = REGISTER_PASS_ALLOWED;
+        register_rest_pending = 1;
+    }
+    register_all();
+}
+
+static void register_rest(void)
+{
+    register_pass = REGISTER_PASS_REST;
+    register_all();
+    register_rest_pending = 0;
+}
+
+void avcodec_register_allow_list(const char *names)
+{
+    if (registered)
+        return;
+    av_freep(&allow_list);
+    if (names && *names)
+        allow_list = av_strdup(names);
+}
+
 void avcodec_register_all(void)
 {
     static AVOnce control = AV_ONCE_INIT;
 
-    ff_thread_once(&control, register_all);
+    ff_thread_once(&control, register_allowed);
+}
+
+int ff_codec_register_rest(void)
+{
+    static AVOnce control = AV_ONCE_INIT;
+
+    if (!register_rest_pending)
+        return 0;
+    ff_thread_once(&control, register_rest);
+    return 1;
 }
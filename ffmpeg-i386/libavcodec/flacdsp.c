@@ -123,6 +123,8 @@ av_cold void ff_flacdsp_init(FLACDSPContext *c, enum AVSampleFormat fmt, int cha
         break;
     }
 
+    if (ARCH_AARCH64)
+        ff_flacdsp_init_aarch64(c, fmt, channels, bps);
     if (ARCH_ARM)
         ff_flacdsp_init_arm(c, fmt, channels, bps);
     if (ARCH_X86)
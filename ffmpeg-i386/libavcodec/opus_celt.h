@@ -29,6 +29,7 @@
 #include "opus.h"
 
 #include "mdct15.h"
+#include "opusdsp.h"
 #include "libavutil/float_dsp.h"
 #include "libavutil/libm.h"
 
@@ -94,6 +95,7 @@ struct CeltFrame {
     AVCodecContext      *avctx;
     MDCT15Context       *imdct[4];
     AVFloatDSPContext   *dsp;
+    OpusDSP             opusdsp;
     CeltBlock           block[2];
     int channels;
     int output_channels;
@@ -19,24 +19,47 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "avformat.h"
+#include "internal.h"
 #include "rtp.h"
 #include "rdt.h"
 #include "url.h"
 #include "version.h"
 
+/* as in libavcodec: with an allow list, the (de)muxers of the list first,
+ * the rest on the first lookup or probe that finds nothing */
+enum {
+    REGISTER_PASS_ALL,
+    REGISTER_PASS_ALLOWED,
+    REGISTER_PASS_REST,
+};
+
+static char *allow_list;
+static int   register_pass;
+static int   registered;
+static int   register_rest_pending;
+
+static int register_format(const char *name)
+{
+    if (register_pass == REGISTER_PASS_ALL)
+        return 1;
+    return av_match_name(name, allow_list) == (register_pass == REGISTER_PASS_ALLOWED);
+}
+
 #define REGISTER_MUXER(X, x)                                            \
     {                                                                   \
         extern AVOutputFormat ff_##x##_muxer;                           \
-        if (CONFIG_##X##_MUXER)                                         \
+        if (CONFIG_##X##_MUXER && register_format(#x))                  \
             av_register_output_format(&ff_##x##_muxer);                 \
     }
 
 #define REGISTER_DEMUXER(X, x)                                          \
     {                                                                   \
         extern AVInputFormat ff_##x##_demuxer;                          \
-        if (CONFIG_##X##_DEMUXER)                                       \
+        if (CONFIG_##X##_DEMUXER && register_format(#x))                \
             av_register_input_format(&ff_##x##_demuxer);                \
     }
 
@@ -44,8 +67,6 @@
 
 static void register_all(void)
 {
-    avcodec_register_all();
-
     /* (de)muxers */
     REGISTER_MUXER   (A64,              a64);
     REGISTER_DEMUXER (AA,               aa);
@@ -96,7 +117,7 @@ static void register_all(void)
     REGISTER_DEMUXER (CINE,             cine);
     REGISTER_DEMUXER (CONCAT,           concat);
     REGISTER_MUXER   (CRC,              crc);
-    REGISTER_MUXER   (DASH,             dash);
+    REGISTER_MUXDEMUX(DASH,             dash);
     REGISTER_MUXDEMUX(DATA,             data);
     REGISTER_MUXDEMUX(DAUD,             daud);
     REGISTER_DEMUXER (DCSTR,            dcstr);
@@ -248,6 +269,7 @@ static void register_all(void)
     REGISTER_MUXDEMUX(PCM_U16LE,        pcm_u16le);
     REGISTER_MUXDEMUX(PCM_U8,           pcm_u8);
     REGISTER_DEMUXER (PJS,              pjs);
+    REGISTER_DEMUXER (PKTCAP,           pktcap);
     REGISTER_DEMUXER (PMP,              pmp);
     REGISTER_MUXER   (PSP,              psp);
     REGISTER_DEMUXER (PVA,              pva);
@@ -382,9 +404,48 @@ static void register_all(void)
     REGISTER_DEMUXER (LIBOPENMPT,       libopenmpt);
 }
 
+static void register_allowed(void)
+{
+    registered = 1;
+    avcodec_register_all();
+
+    if (allow_list) {
+        register_pass         = REGISTER_PASS_ALLOWED;
+        register_rest_pending = 1;
+    }
+    register_all();
+}
+
+static void register_rest(void)
+{
+    register_pass = REGISTER_PASS_REST;
+    register_all();
+    register_rest_pending = 0;
+}
+
+void av_register_allow_list(const char *formats, const char *codecs)
+{
+    avcodec_register_allow_list(codecs);
+    if (registered)
+        return;
+    av_freep(&allow_list);
+    if (formats && *formats)
+        allow_list = av_strdup(formats);
+}
+
 void av_register_all(void)
 {
-    AVOnce control = AV_ONCE_INIT;
+    static AVOnce control = AV_ONCE_INIT;
+
+    ff_thread_once(&control, register_allowed);
+}
+
+int ff_format_register_rest(void)
+{
+    static AVOnce control = AV_ONCE_INIT;
 
-    ff_thread_once(&control, register_all);
+    if (!register_rest_pending)
+        return 0;
+    ff_thread_once(&control, register_rest);
+    return 1;
 }
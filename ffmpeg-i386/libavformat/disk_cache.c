@@ -0,0 +1,630 @@
+/*
+ * Process wide persistent cache of downloaded byte ranges
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/internal.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "disk_cache.h"
+#include "internal.h"
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#include <fcntl.h>
+#if HAVE_IO_H
+#include <io.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+#include "os_support.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define DISK_CACHE_KEY_SIZE         32
+#define DISK_CACHE_MAX_RANGES       4096
+#define DISK_CACHE_SAVE_INTERVAL    (4 * 1024 * 1024)
+#define DISK_CACHE_INDEX_MAX_SIZE   (DISK_CACHE_MAX_RANGES * 48 + 256)
+
+#if HAVE_PTHREADS
+static pthread_mutex_t disk_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define disk_cache_lock()   pthread_mutex_lock(&disk_cache_mutex)
+#define disk_cache_unlock() pthread_mutex_unlock(&disk_cache_mutex)
+#else
+#define disk_cache_lock()
+#define disk_cache_unlock()
+#endif
+
+typedef struct DiskCacheRange {
+    int64_t start;
+    int64_t end;
+} DiskCacheRange;
+
+typedef struct DiskCacheEntry {
+    struct DiskCacheEntry *next;
+    char            key[DISK_CACHE_KEY_SIZE + 1];
+    DiskCacheRange *ranges;         // sorted, neither overlapping nor adjacent
+    int             nb_ranges;
+    int64_t         cached;         // bytes in ranges
+    int64_t         size;           // resource size, -1 if unknown
+    int64_t         access_time;    // av_gettime() of the last open
+    int64_t         unsaved;        // bytes added since the index was written
+    int             refcount;       // open DiskCacheFile
+    int             dirty;
+} DiskCacheEntry;
+
+struct DiskCacheFile {
+    DiskCacheEntry *entry;
+    int             fd;
+};
+
+static char               *disk_cache_dir;
+static int64_t             disk_cache_max_size;
+static DiskCacheEntry     *disk_cache_head;
+static DiskCacheStatistic  disk_cache_stat;
+
+static void disk_cache_path(char *buf, int size, const char *key, const char *ext)
+{
+    snprintf(buf, size, "%s/%s%s", disk_cache_dir, key, ext);
+}
+
+static int disk_cache_param_ignored(const char *name, int len, const char *ignore_params)
+{
+    const char *p = ignore_params;
+
+    while (*p) {
+        int n = strcspn(p, ",");
+        if (n == len && !strncmp(p, name, len))
+            return 1;
+        p += n;
+        if (*p)
+            p++;
+    }
+    return 0;
+}
+
+static int disk_cache_make_key(char *key, const char *url, const char *ignore_params)
+{
+    struct AVMD5 *md5 = av_md5_alloc();
+    uint8_t digest[16];
+    const char *end   = url + strcspn(url, "#");
+    const char *query = memchr(url, '?', end - url);
+
+    if (!md5)
+        return AVERROR(ENOMEM);
+    if (!ignore_params)
+        ignore_params = DISK_CACHE_IGNORE_PARAMS;
+
+    av_md5_init(md5);
+    av_md5_update(md5, url, (query ? query : end) - url);
+    if (query) {
+        const char *p = query + 1;
+        while (p < end) {
+            int len  = strcspn(p, "&#");
+            int name = strcspn(p, "=&#");
+            if (len && !disk_cache_param_ignored(p, name, ignore_params)) {
+                av_md5_update(md5, "&", 1);
+                av_md5_update(md5, p, len);
+            }
+            p += len;
+            if (p < end)
+                p++;
+        }
+    }
+    av_md5_final(md5, digest);
+    av_free(md5);
+
+    ff_data_to_hex(key, digest, sizeof(digest), 1);
+    key[DISK_CACHE_KEY_SIZE] = '\0';
+    return 0;
+}
+
+// add [start, end) to the ranges, return the number of bytes not cached before
+static int64_t disk_cache_add_range(DiskCacheEntry *entry, int64_t start, int64_t end)
+{
+    int64_t added = end - start;
+    int i = 0, j;
+
+    while (i < entry->nb_ranges && entry->ranges[i].end < start)
+        i++;
+    for (j = i; j < entry->nb_ranges && entry->ranges[j].start <= end; j++) {
+        int64_t overlap = FFMIN(end, entry->ranges[j].end) - FFMAX(start, entry->ranges[j].start);
+        if (overlap > 0)
+            added -= overlap;
+    }
+
+    if (j == i) {
+        DiskCacheRange *ranges;
+        if (entry->nb_ranges >= DISK_CACHE_MAX_RANGES)
+            return AVERROR(ENOSPC);
+        ranges = av_realloc_array(entry->ranges, entry->nb_ranges + 1, sizeof(*ranges));
+        if (!ranges)
+            return AVERROR(ENOMEM);
+        entry->ranges = ranges;
+        memmove(&ranges[i + 1], &ranges[i], (entry->nb_ranges - i) * sizeof(*ranges));
+        entry->nb_ranges++;
+    } else {
+        start = FFMIN(start, entry->ranges[i].start);
+        end   = FFMAX(end,   entry->ranges[j - 1].end);
+        memmove(&entry->ranges[i + 1], &entry->ranges[j], (entry->nb_ranges - j) * sizeof(*entry->ranges));
+        entry->nb_ranges -= j - i - 1;
+    }
+    entry->ranges[i].start = start;
+    entry->ranges[i].end   = end;
+    return added;
+}
+
+// must be called locked
+static void disk_cache_save_index(DiskCacheEntry *entry)
+{
+    char path[1024], tmp_path[1024];
+    AVBPrint bp;
+    int fd, i, ret;
+
+    if (!entry->dirty)
+        return;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "ffdc 1\nsize %"PRId64"\natime %"PRId64"\n", entry->size, entry->access_time);
+    for (i = 0; i < entry->nb_ranges; i++)
+        av_bprintf(&bp, "%"PRId64" %"PRId64"\n", entry->ranges[i].start, entry->ranges[i].end);
+    if (!av_bprint_is_complete(&bp))
+        goto end;
+
+    disk_cache_path(path,     sizeof(path),     entry->key, ".idx");
+    disk_cache_path(tmp_path, sizeof(tmp_path), entry->key, ".idx.tmp");
+    fd = avpriv_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        goto end;
+    ret = write(fd, bp.str, bp.len);
+    close(fd);
+    if (ret != bp.len || rename(tmp_path, path) < 0) {
+        unlink(tmp_path);
+        goto end;
+    }
+    entry->dirty   = 0;
+    entry->unsaved = 0;
+end:
+    av_bprint_finalize(&bp, NULL);
+}
+
+static int disk_cache_parse_index(DiskCacheEntry *entry, const char *buf)
+{
+    const char *p;
+    char *next;
+    int64_t start, end;
+
+    if (!av_strstart(buf, "ffdc 1\nsize ", &p))
+        return AVERROR_INVALIDDATA;
+    entry->size = strtoll(p, &next, 10);
+    if (next == p || !av_strstart(next, "\natime ", &p))
+        return AVERROR_INVALIDDATA;
+    entry->access_time = strtoll(p, &next, 10);
+    p = next;
+
+    while (*p == '\n' && p[1]) {
+        start = strtoll(p + 1, &next, 10);
+        if (next == p + 1)
+            return AVERROR_INVALIDDATA;
+        p   = next;
+        end = strtoll(p, &next, 10);
+        if (next == p || start < 0 || end <= start)
+            return AVERROR_INVALIDDATA;
+        p = next;
+        if (entry->nb_ranges && start <= entry->ranges[entry->nb_ranges - 1].end)
+            return AVERROR_INVALIDDATA;
+        if (disk_cache_add_range(entry, start, end) < 0)
+            return AVERROR_INVALIDDATA;
+        entry->cached += end - start;
+    }
+    return 0;
+}
+
+static void disk_cache_entry_free(DiskCacheEntry **pentry)
+{
+    if (!*pentry)
+        return;
+    av_freep(&(*pentry)->ranges);
+    av_freep(pentry);
+}
+
+// must be called locked
+static void disk_cache_remove_files(const char *key)
+{
+    char path[1024];
+
+    disk_cache_path(path, sizeof(path), key, ".idx");
+    unlink(path);
+    disk_cache_path(path, sizeof(path), key, ".data");
+    unlink(path);
+}
+
+// must be called locked
+static void disk_cache_unlink_entry(DiskCacheEntry **pp)
+{
+    DiskCacheEntry *entry = *pp;
+
+    *pp = entry->next;
+    disk_cache_remove_files(entry->key);
+    disk_cache_stat.size -= entry->cached;
+    disk_cache_stat.entries--;
+    disk_cache_entry_free(&entry);
+}
+
+// drop unused entries, least recently opened first, until the budget is met;
+// must be called locked
+static void disk_cache_evict_locked(void)
+{
+    while (disk_cache_stat.size > disk_cache_max_size) {
+        DiskCacheEntry **pp, **oldest = NULL;
+
+        for (pp = &disk_cache_head; *pp; pp = &(*pp)->next) {
+            if (!(*pp)->refcount && (!oldest || (*pp)->access_time < (*oldest)->access_time))
+                oldest = pp;
+        }
+        if (!oldest)
+            break;
+        av_log(NULL, AV_LOG_DEBUG, "disk cache: evict %s, %"PRId64" bytes\n",
+               (*oldest)->key, (*oldest)->cached);
+        disk_cache_unlink_entry(oldest);
+        disk_cache_stat.evictions++;
+    }
+}
+
+static DiskCacheEntry *disk_cache_find_locked(const char *key)
+{
+    DiskCacheEntry *entry;
+
+    for (entry = disk_cache_head; entry; entry = entry->next) {
+        if (!strcmp(entry->key, key))
+            return entry;
+    }
+    return NULL;
+}
+
+static int disk_cache_is_key(const char *name, const char *ext)
+{
+    int i;
+
+    for (i = 0; i < DISK_CACHE_KEY_SIZE; i++) {
+        if (!name[i] || !strchr("0123456789abcdef", name[i]))
+            return 0;
+    }
+    return !strcmp(name + DISK_CACHE_KEY_SIZE, ext);
+}
+
+static void disk_cache_load_entry_locked(const char *key)
+{
+    DiskCacheEntry *entry = NULL;
+    char path[1024];
+    char *buf = NULL;
+    int fd, len = -1;
+
+    if (disk_cache_find_locked(key))
+        return;
+
+    disk_cache_path(path, sizeof(path), key, ".idx");
+    fd = avpriv_open(path, O_RDONLY);
+    if (fd >= 0) {
+        buf = av_malloc(DISK_CACHE_INDEX_MAX_SIZE + 1);
+        if (buf)
+            len = read(fd, buf, DISK_CACHE_INDEX_MAX_SIZE);
+        close(fd);
+    }
+    entry = av_mallocz(sizeof(*entry));
+    if (len < 0 || !entry) {
+        disk_cache_entry_free(&entry);
+        av_free(buf);
+        return;
+    }
+    buf[len] = '\0';
+    av_strlcpy(entry->key, key, sizeof(entry->key));
+
+    if (disk_cache_parse_index(entry, buf) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "disk cache: dropping broken entry %s\n", key);
+        disk_cache_remove_files(key);
+        disk_cache_entry_free(&entry);
+    } else {
+        entry->next     = disk_cache_head;
+        disk_cache_head = entry;
+        disk_cache_stat.size += entry->cached;
+        disk_cache_stat.entries++;
+    }
+    av_free(buf);
+}
+
+// read back the entries of a previous run, remove data files without index;
+// must be called locked
+static void disk_cache_load_locked(void)
+{
+#if HAVE_DIRENT_H
+    DIR *dir = opendir(disk_cache_dir);
+    struct dirent *de;
+    char key[DISK_CACHE_KEY_SIZE + 1];
+    char path[1024];
+
+    if (!dir)
+        return;
+    while ((de = readdir(dir))) {
+        if (disk_cache_is_key(de->d_name, ".idx")) {
+            av_strlcpy(key, de->d_name, sizeof(key));
+            disk_cache_load_entry_locked(key);
+        }
+    }
+    rewinddir(dir);
+    while ((de = readdir(dir))) {
+        av_strlcpy(key, de->d_name, sizeof(key));
+        if ((disk_cache_is_key(de->d_name, ".data") && !disk_cache_find_locked(key)) ||
+            disk_cache_is_key(de->d_name, ".idx.tmp")) {
+            disk_cache_path(path, sizeof(path), de->d_name, "");
+            unlink(path);
+        }
+    }
+    closedir(dir);
+#endif
+}
+
+int av_disk_cache_configure(const char *dir, int64_t max_size)
+{
+    DiskCacheEntry **pp;
+    char *new_dir;
+    int ret = 0;
+
+    if (!dir || !*dir || max_size <= 0)
+        return AVERROR(EINVAL);
+
+    disk_cache_lock();
+    if (disk_cache_dir && !strcmp(disk_cache_dir, dir)) {
+        disk_cache_max_size = max_size;
+        disk_cache_evict_locked();
+        goto end;
+    }
+
+    for (pp = &disk_cache_head; *pp; pp = &(*pp)->next) {
+        if ((*pp)->refcount) {
+            ret = AVERROR(EBUSY);
+            goto end;
+        }
+    }
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+        ret = AVERROR(errno);
+        av_log(NULL, AV_LOG_ERROR, "disk cache: cannot create %s\n", dir);
+        goto end;
+    }
+    new_dir = av_strdup(dir);
+    if (!new_dir) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    while (disk_cache_head) {
+        DiskCacheEntry *entry = disk_cache_head;
+        disk_cache_head = entry->next;
+        disk_cache_save_index(entry);
+        disk_cache_entry_free(&entry);
+    }
+    disk_cache_stat.size    = 0;
+    disk_cache_stat.entries = 0;
+    av_free(disk_cache_dir);
+    disk_cache_dir      = new_dir;
+    disk_cache_max_size = max_size;
+
+    disk_cache_load_locked();
+    disk_cache_evict_locked();
+    av_log(NULL, AV_LOG_INFO, "disk cache: %s, %d entries, %"PRId64" of %"PRId64" bytes\n",
+           disk_cache_dir, disk_cache_stat.entries, disk_cache_stat.size, disk_cache_max_size);
+end:
+    disk_cache_unlock();
+    return ret;
+}
+
+void av_disk_cache_clear(void)
+{
+    DiskCacheEntry **pp;
+
+    disk_cache_lock();
+    pp = &disk_cache_head;
+    while (*pp) {
+        if ((*pp)->refcount)
+            pp = &(*pp)->next;
+        else
+            disk_cache_unlink_entry(pp);
+    }
+    disk_cache_unlock();
+}
+
+void av_disk_cache_get_statistic(DiskCacheStatistic *stat)
+{
+    disk_cache_lock();
+    *stat          = disk_cache_stat;
+    stat->max_size = disk_cache_max_size;
+    disk_cache_unlock();
+}
+
+int ff_disk_cache_open(DiskCacheFile **pfile, const char *url, const char *ignore_params)
+{
+    DiskCacheFile  *file;
+    DiskCacheEntry *entry;
+    char key[DISK_CACHE_KEY_SIZE + 1];
+    char path[1024];
+    int ret;
+
+    *pfile = NULL;
+    if ((ret = disk_cache_make_key(key, url, ignore_params)) < 0)
+        return ret;
+    file = av_mallocz(sizeof(*file));
+    if (!file)
+        return AVERROR(ENOMEM);
+
+    disk_cache_lock();
+    if (!disk_cache_dir) {
+        ret = AVERROR(ENOSYS);
+        goto fail;
+    }
+    entry = disk_cache_find_locked(key);
+    if (!entry) {
+        entry = av_mallocz(sizeof(*entry));
+        if (!entry) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        av_strlcpy(entry->key, key, sizeof(entry->key));
+        entry->size     = -1;
+        entry->next     = disk_cache_head;
+        disk_cache_head = entry;
+        disk_cache_stat.entries++;
+    }
+
+    disk_cache_path(path, sizeof(path), key, ".data");
+    file->fd = avpriv_open(path, O_RDWR | O_CREAT, 0600);
+    if (file->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    entry->refcount++;
+    entry->access_time = av_gettime();
+    entry->dirty       = 1;
+    file->entry = entry;
+    disk_cache_unlock();
+
+    *pfile = file;
+    return 0;
+fail:
+    disk_cache_unlock();
+    av_free(file);
+    return ret;
+}
+
+void ff_disk_cache_close(DiskCacheFile **pfile)
+{
+    DiskCacheFile *file = *pfile;
+
+    if (!file)
+        return;
+
+    close(file->fd);
+    disk_cache_lock();
+    file->entry->refcount--;
+    disk_cache_save_index(file->entry);
+    disk_cache_evict_locked();
+    disk_cache_unlock();
+    av_freep(pfile);
+}
+
+int64_t ff_disk_cache_get_size(DiskCacheFile *file)
+{
+    int64_t size;
+
+    disk_cache_lock();
+    size = file->entry->size;
+    disk_cache_unlock();
+    return size;
+}
+
+void ff_disk_cache_set_size(DiskCacheFile *file, int64_t size)
+{
+    disk_cache_lock();
+    if (file->entry->size != size) {
+        file->entry->size  = size;
+        file->entry->dirty = 1;
+    }
+    disk_cache_unlock();
+}
+
+int64_t ff_disk_cache_available(DiskCacheFile *file, int64_t pos)
+{
+    DiskCacheEntry *entry = file->entry;
+    int64_t available = 0;
+    int lo = 0, hi;
+
+    disk_cache_lock();
+    hi = entry->nb_ranges;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (entry->ranges[mid].end <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < entry->nb_ranges && entry->ranges[lo].start <= pos)
+        available = entry->ranges[lo].end - pos;
+    disk_cache_unlock();
+    return available;
+}
+
+int ff_disk_cache_read(DiskCacheFile *file, int64_t pos, uint8_t *buf, int size)
+{
+    int ret;
+
+    if (lseek(file->fd, pos, SEEK_SET) != pos)
+        return AVERROR(errno);
+    ret = read(file->fd, buf, size);
+    if (ret < 0)
+        return AVERROR(errno);
+
+    disk_cache_lock();
+    disk_cache_stat.hit_bytes += ret;
+    disk_cache_unlock();
+    return ret;
+}
+
+int ff_disk_cache_write(DiskCacheFile *file, int64_t pos, const uint8_t *buf, int size)
+{
+    DiskCacheEntry *entry = file->entry;
+    int64_t added;
+    int fits, written = 0;
+
+    disk_cache_lock();
+    fits = entry->cached + size <= disk_cache_max_size;
+    disk_cache_unlock();
+    if (!fits || size <= 0)
+        return 0;
+
+    if (lseek(file->fd, pos, SEEK_SET) != pos)
+        return AVERROR(errno);
+    while (written < size) {
+        int ret = write(file->fd, buf + written, size - written);
+        if (ret <= 0)
+            return ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+        written += ret;
+    }
+
+    // the bytes are on disk before the range says so, readers never see a hole
+    disk_cache_lock();
+    added = disk_cache_add_range(entry, pos, pos + size);
+    if (added > 0) {
+        entry->cached        += added;
+        entry->unsaved       += added;
+        entry->dirty          = 1;
+        disk_cache_stat.size += added;
+    }
+    disk_cache_stat.miss_bytes += size;
+    if (entry->unsaved >= DISK_CACHE_SAVE_INTERVAL)
+        disk_cache_save_index(entry);
+    disk_cache_evict_locked();
+    disk_cache_unlock();
+    return added < 0 ? (int)added : 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * Concurrent download of HLS playlists
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "hls_fetch.h"
+#include "url.h"
+
+#if HAVE_PTHREADS
+
+#include <pthread.h>
+
+#define FETCH_MAX_SIZE      (16 * 1024 * 1024)
+#define FETCH_IO_SIZE       4096
+#define FETCH_WAIT_INTERVAL 100000
+#define RECALL_ENTRIES      8
+#define KEY_ENTRIES         16
+
+struct HLSFetch {
+    char               *url;
+    AVDictionary       *opts;
+    AVIOInterruptCB     int_cb;
+    char               *whitelist;
+    char               *blacklist;
+    pthread_t           thread;
+    int                 abort_request;
+
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    int                 done;
+    int                 error;
+    AVBPrint            body;
+    AVDictionary       *response;  // the options of the protocol worth keeping
+
+    AVIOContext        *pb;
+    int                 read_pos;
+};
+
+static pthread_mutex_t recall_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char           *recall_masters[RECALL_ENTRIES];
+static char           *recall_urls[RECALL_ENTRIES];
+static int             recall_next;
+
+static pthread_mutex_t key_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char           *key_urls[KEY_ENTRIES];
+static uint8_t         key_values[KEY_ENTRIES][16];
+static int64_t         key_times[KEY_ENTRIES];
+static int             key_next;
+
+static int fetch_interrupt_cb(void *opaque)
+{
+    HLSFetch *f = opaque;
+
+    return f->abort_request || ff_check_interrupt(&f->int_cb);
+}
+
+static void *fetch_thread(void *arg)
+{
+    static const char *const kept[] = { "location", "etag", "last_modified" };
+    HLSFetch        *f      = arg;
+    AVIOInterruptCB  int_cb = { fetch_interrupt_cb, f };
+    AVIOContext     *pb     = NULL;
+    AVDictionary    *response = NULL;
+    int              ret, i;
+
+    ret = ffio_open_whitelist(&pb, f->url, AVIO_FLAG_READ, &int_cb, &f->opts,
+                              f->whitelist, f->blacklist);
+    if (ret >= 0) {
+        for (i = 0; i < FF_ARRAY_ELEMS(kept); i++) {
+            uint8_t *value = NULL;
+            if (av_opt_get(pb, kept[i], AV_OPT_SEARCH_CHILDREN, &value) >= 0 && value && *value)
+                av_dict_set(&response, kept[i], (char *)value, AV_DICT_DONT_STRDUP_VAL);
+            else
+                av_free(value);
+        }
+        // the body is only read by the demuxer thread once done is set
+        ret = avio_read_to_bprint(pb, &f->body, FETCH_MAX_SIZE);
+        avio_closep(&pb);
+    }
+
+    pthread_mutex_lock(&f->mutex);
+    f->response = response;
+    f->error    = ret < 0 ? ret : 0;
+    f->done     = 1;
+    pthread_cond_broadcast(&f->cond);
+    pthread_mutex_unlock(&f->mutex);
+    return NULL;
+}
+
+int ff_hls_fetch_start(HLSFetch **pf, const char *url, AVDictionary *opts,
+                       const AVIOInterruptCB *int_cb,
+                       const char *whitelist, const char *blacklist)
+{
+    HLSFetch *f;
+    int ret;
+
+    *pf = NULL;
+    f = av_mallocz(sizeof(*f));
+    if (!f)
+        return AVERROR(ENOMEM);
+    if (int_cb)
+        f->int_cb = *int_cb;
+    av_bprint_init(&f->body, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (!(f->url = av_strdup(url)) ||
+        av_dict_copy(&f->opts, opts, 0) < 0 ||
+        (whitelist && !(f->whitelist = av_strdup(whitelist))) ||
+        (blacklist && !(f->blacklist = av_strdup(blacklist)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&f->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&f->cond, NULL))) {
+        pthread_mutex_destroy(&f->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&f->thread, NULL, fetch_thread, f))) {
+        pthread_cond_destroy(&f->cond);
+        pthread_mutex_destroy(&f->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    *pf = f;
+    return 0;
+fail:
+    av_freep(&f->url);
+    av_dict_free(&f->opts);
+    av_freep(&f->whitelist);
+    av_freep(&f->blacklist);
+    av_bprint_finalize(&f->body, NULL);
+    av_freep(&f);
+    return ret;
+}
+
+void ff_hls_fetch_freep(HLSFetch **pf)
+{
+    HLSFetch *f = *pf;
+
+    if (!f)
+        return;
+
+    f->abort_request = 1;
+    pthread_join(f->thread, NULL);
+
+    if (f->pb) {
+        av_freep(&f->pb->buffer);
+        av_freep(&f->pb);
+    }
+    pthread_cond_destroy(&f->cond);
+    pthread_mutex_destroy(&f->mutex);
+    av_freep(&f->url);
+    av_dict_free(&f->opts);
+    av_dict_free(&f->response);
+    av_freep(&f->whitelist);
+    av_freep(&f->blacklist);
+    av_bprint_finalize(&f->body, NULL);
+    av_freep(pf);
+}
+
+const char *ff_hls_fetch_url(HLSFetch *f)
+{
+    return f->url;
+}
+
+static int fetch_read_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    HLSFetch *f = opaque;
+    int size = FFMIN(buf_size, (int)f->body.len - f->read_pos);
+
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, f->body.str + f->read_pos, size);
+    f->read_pos += size;
+    return size;
+}
+
+int ff_hls_fetch_wait(HLSFetch *f, AVIOContext **pb)
+{
+    uint8_t *buffer;
+    int ret = 0;
+
+    *pb = NULL;
+    pthread_mutex_lock(&f->mutex);
+    while (!f->done) {
+        int64_t         t  = av_gettime() + FETCH_WAIT_INTERVAL;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+
+        if (ff_check_interrupt(&f->int_cb)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_timedwait(&f->cond, &f->mutex, &tv);
+    }
+    if (f->done)
+        ret = f->error;
+    pthread_mutex_unlock(&f->mutex);
+    if (ret < 0)
+        return ret;
+    if (!av_bprint_is_complete(&f->body))
+        return AVERROR(ENOMEM);
+
+    if (!f->pb) {
+        if (!(buffer = av_malloc(FETCH_IO_SIZE)))
+            return AVERROR(ENOMEM);
+        f->pb = avio_alloc_context(buffer, FETCH_IO_SIZE, 0, f, fetch_read_packet, NULL, NULL);
+        if (!f->pb) {
+            av_free(buffer);
+            return AVERROR(ENOMEM);
+        }
+    }
+    *pb = f->pb;
+    return 0;
+}
+
+const char *ff_hls_fetch_get(HLSFetch *f, const char *name)
+{
+    AVDictionaryEntry *e;
+
+    pthread_mutex_lock(&f->mutex);
+    e = f->done ? av_dict_get(f->response, name, NULL, 0) : NULL;
+    pthread_mutex_unlock(&f->mutex);
+    return e ? e->value : NULL;
+}
+
+void ff_hls_fetch_remember(const char *master_url, const char *url)
+{
+    char *master_copy = av_strdup(master_url);
+    char *url_copy    = av_strdup(url);
+    int i;
+
+    if (!master_copy || !url_copy) {
+        av_free(master_copy);
+        av_free(url_copy);
+        return;
+    }
+
+    pthread_mutex_lock(&recall_mutex);
+    for (i = 0; i < RECALL_ENTRIES; i++) {
+        if (recall_masters[i] && !strcmp(recall_masters[i], master_url))
+            break;
+    }
+    if (i == RECALL_ENTRIES) {
+        i = recall_next;
+        recall_next = (recall_next + 1) % RECALL_ENTRIES;
+    }
+    FFSWAP(char *, recall_masters[i], master_copy);
+    FFSWAP(char *, recall_urls[i], url_copy);
+    pthread_mutex_unlock(&recall_mutex);
+
+    av_free(master_copy);
+    av_free(url_copy);
+}
+
+int ff_hls_fetch_recall(const char *master_url, char *url, int url_size)
+{
+    int i, found = 0;
+
+    pthread_mutex_lock(&recall_mutex);
+    for (i = 0; i < RECALL_ENTRIES; i++) {
+        if (recall_masters[i] && !strcmp(recall_masters[i], master_url)) {
+            av_strlcpy(url, recall_urls[i], url_size);
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&recall_mutex);
+    return found;
+}
+
+void ff_hls_fetch_store_key(const char *url, const uint8_t *key)
+{
+    char *url_copy = av_strdup(url);
+    int i;
+
+    if (!url_copy)
+        return;
+
+    pthread_mutex_lock(&key_mutex);
+    for (i = 0; i < KEY_ENTRIES; i++) {
+        if (key_urls[i] && !strcmp(key_urls[i], url))
+            break;
+    }
+    if (i == KEY_ENTRIES) {
+        i = key_next;
+        key_next = (key_next + 1) % KEY_ENTRIES;
+    }
+    FFSWAP(char *, key_urls[i], url_copy);
+    memcpy(key_values[i], key, sizeof(key_values[i]));
+    key_times[i] = av_gettime_relative();
+    pthread_mutex_unlock(&key_mutex);
+
+    av_free(url_copy);
+}
+
+int ff_hls_fetch_lookup_key(const char *url, uint8_t *key, int64_t max_age)
+{
+    int64_t now = av_gettime_relative();
+    int i, found = 0;
+
+    pthread_mutex_lock(&key_mutex);
+    for (i = 0; i < KEY_ENTRIES; i++) {
+        if (!key_urls[i] || strcmp(key_urls[i], url))
+            continue;
+        if (now - key_times[i] <= max_age) {
+            memcpy(key, key_values[i], sizeof(key_values[i]));
+            found = 1;
+        } else {
+            // expired, not kept in memory any longer than it may be used
+            av_freep(&key_urls[i]);
+            memset(key_values[i], 0, sizeof(key_values[i]));
+        }
+        break;
+    }
+    pthread_mutex_unlock(&key_mutex);
+    return found;
+}
+
+#else
+
+int ff_hls_fetch_start(HLSFetch **pf, const char *url, AVDictionary *opts,
+                       const AVIOInterruptCB *int_cb,
+                       const char *whitelist, const char *blacklist)
+{
+    *pf = NULL;
+    return AVERROR(ENOSYS);
+}
+
+void ff_hls_fetch_freep(HLSFetch **pf)
+{
+}
+
+const char *ff_hls_fetch_url(HLSFetch *f)
+{
+    return NULL;
+}
+
+int ff_hls_fetch_wait(HLSFetch *f, AVIOContext **pb)
+{
+    return AVERROR(ENOSYS);
+}
+
+const char *ff_hls_fetch_get(HLSFetch *f, const char *name)
+{
+    return NULL;
+}
+
+void ff_hls_fetch_remember(const char *master_url, const char *url)
+{
+}
+
+int ff_hls_fetch_recall(const char *master_url, char *url, int url_size)
+{
+    return 0;
+}
+
+void ff_hls_fetch_store_key(const char *url, const uint8_t *key)
+{
+}
+
+int ff_hls_fetch_lookup_key(const char *url, uint8_t *key, int64_t max_age)
+{
+    return 0;
+}
+
+#endif
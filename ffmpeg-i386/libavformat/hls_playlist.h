@@ -0,0 +1,86 @@
+/*
+ * Media playlists of an HLS stream, parsed for other users than the demuxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_PLAYLIST_H
+#define AVFORMAT_HLS_PLAYLIST_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avio.h"
+
+#define HLS_MAX_VARIANT_PLAYLISTS   2   // the variant and its audio rendition
+
+enum HLSKeyMethod {
+    HLS_KEY_NONE,
+    HLS_KEY_AES_128,
+    HLS_KEY_SAMPLE_AES,
+};
+
+/* a byte range of a resource, the whole resource if size is -1 */
+typedef struct HLSMediaRange {
+    char    *url;
+    int64_t  offset;
+    int64_t  size;
+} HLSMediaRange;
+
+typedef struct HLSMediaSegment {
+    HLSMediaRange   range;
+    int64_t         duration;       // AV_TIME_BASE units
+    int             discontinuity;  // EXT-X-DISCONTINUITY before it
+    enum HLSKeyMethod key_method;
+    char           *key_url;
+    uint8_t         iv[16];         // the explicit one or the one of the sequence number
+    int             init_section;   // index in init_sections, -1 if none
+} HLSMediaSegment;
+
+typedef struct HLSMediaPlaylist {
+    char            *url;
+    int              bandwidth;     // of the variant, 0 for a rendition
+    int              is_audio;      // an audio rendition of the variant
+    int              finished;      // EXT-X-ENDLIST
+    int64_t          target_duration;
+    int              start_seq_no;
+    HLSMediaSegment *segments;
+    int              nb_segments;
+    HLSMediaRange   *init_sections;
+    int              nb_init_sections;
+} HLSMediaPlaylist;
+
+/**
+ * Load the master playlist at url and the media playlists of one variant:
+ * the one of the highest bandwidth up to max_bandwidth, or the lowest if
+ * none is, and the audio rendition of its group that has a playlist of its
+ * own. A media playlist at url is the only one loaded.
+ *
+ * @param pls           filled with up to HLS_MAX_VARIANT_PLAYLISTS, the
+ *                      variant first, to be freed with
+ *                      ff_hls_media_playlist_free()
+ * @param max_bandwidth in bits per second, <= 0 for the highest
+ * @param options       the format options of the demuxer, the http ones
+ *                      are used for the playlists
+ * @return the number of playlists, or a negative AVERROR
+ */
+int  ff_hls_load_variant(HLSMediaPlaylist **pls, const char *url, int max_bandwidth,
+                         AVDictionary *options, const AVIOInterruptCB *int_cb);
+
+void ff_hls_media_playlist_free(HLSMediaPlaylist **ppls);
+
+#endif /* AVFORMAT_HLS_PLAYLIST_H */
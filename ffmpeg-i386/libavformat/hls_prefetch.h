@@ -0,0 +1,105 @@
+/*
+ * Parallel download of upcoming HLS segments
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_PREFETCH_H
+#define AVFORMAT_HLS_PREFETCH_H
+
+#include "libavutil/dict.h"
+#include "avio.h"
+
+#define HLS_PREFETCH_MAX_SEGMENTS 8
+
+/**
+ * Worker threads download scheduled segments into memory, identified by
+ * their media sequence number, while the demuxer is still reading an
+ * earlier one. Everything except the workers runs on the demuxer thread.
+ *
+ * At most max_size bytes that the demuxer has not read yet are buffered;
+ * only the earliest segment still downloading keeps going past that, so
+ * the segment being read never waits for later ones.
+ */
+typedef struct HLSPrefetch HLSPrefetch;
+typedef struct HLSPrefetchSegment HLSPrefetchSegment;
+
+/**
+ * @param nb_workers parallel downloads, at most HLS_PREFETCH_MAX_SEGMENTS
+ * @param int_cb     interrupt callback of the demuxer, checked by the
+ *                   workers as well
+ * @return 0 on success, a negative AVERROR otherwise (AVERROR(ENOSYS)
+ *         without thread support)
+ */
+int  ff_hls_prefetch_alloc(HLSPrefetch **pp, int nb_workers, int64_t max_size,
+                           const AVIOInterruptCB *int_cb,
+                           const char *whitelist, const char *blacklist,
+                           void *log_ctx);
+void ff_hls_prefetch_freep(HLSPrefetch **pp);
+
+/**
+ * Queue seq_no for download, unless it already is.
+ *
+ * @param seek_offset offset to skip to after opening, for byte range
+ *                    segments on protocols without the "offset" option
+ * @param opts        options for ffio_open_whitelist(), copied
+ */
+int  ff_hls_prefetch_schedule(HLSPrefetch *p, int seq_no, const char *url,
+                              int64_t seek_offset, AVDictionary *opts);
+
+/**
+ * Drop every segment outside [first_seq_no, last_seq_no], aborting their
+ * downloads. first_seq_no > last_seq_no drops all of them.
+ */
+void ff_hls_prefetch_cancel_outside(HLSPrefetch *p, int first_seq_no, int last_seq_no);
+
+/**
+ * Take seq_no for reading if its download has started; a queued one that
+ * no worker picked up yet is dropped, the caller opens it faster itself.
+ *
+ * @return the segment or NULL
+ */
+HLSPrefetchSegment *ff_hls_prefetch_take(HLSPrefetch *p, int seq_no);
+
+/**
+ * Read from a taken segment, waiting for its download if needed.
+ *
+ * @return bytes read, AVERROR_EOF at the end of the segment, or the
+ *         error the download stopped with
+ */
+int  ff_hls_prefetch_read(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                          uint8_t *buf, int buf_size);
+
+/**
+ * Size and duration of a finished download, the time spent waiting for
+ * buffer space excluded.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) while the download is running, or
+ *         the error it stopped with
+ */
+int  ff_hls_prefetch_get_timing(HLSPrefetch *p, HLSPrefetchSegment *seg,
+                                int64_t *bytes, int64_t *elapsed);
+
+void ff_hls_prefetch_release(HLSPrefetch *p, HLSPrefetchSegment **pseg);
+
+/**
+ * @return the last of the segments from seq_no on whose downloads all
+ *         completed, seq_no - 1 if the one of seq_no did not
+ */
+int  ff_hls_prefetch_done_until(HLSPrefetch *p, int seq_no);
+
+#endif /* AVFORMAT_HLS_PREFETCH_H */
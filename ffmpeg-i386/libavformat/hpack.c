@@ -0,0 +1,425 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "hpack.h"
+
+static const struct {
+    const char *name;
+    const char *value;
+} static_table[] = {
+    { ":authority",                  "" },
+    { ":method",                     "GET" },
+    { ":method",                     "POST" },
+    { ":path",                       "/" },
+    { ":path",                       "/index.html" },
+    { ":scheme",                     "http" },
+    { ":scheme",                     "https" },
+    { ":status",                     "200" },
+    { ":status",                     "204" },
+    { ":status",                     "206" },
+    { ":status",                     "304" },
+    { ":status",                     "400" },
+    { ":status",                     "404" },
+    { ":status",                     "500" },
+    { "accept-charset",              "" },
+    { "accept-encoding",             "gzip, deflate" },
+    { "accept-language",             "" },
+    { "accept-ranges",               "" },
+    { "accept",                      "" },
+    { "access-control-allow-origin", "" },
+    { "age",                         "" },
+    { "allow",                       "" },
+    { "authorization",               "" },
+    { "cache-control",               "" },
+    { "content-disposition",         "" },
+    { "content-encoding",            "" },
+    { "content-language",            "" },
+    { "content-length",              "" },
+    { "content-location",            "" },
+    { "content-range",               "" },
+    { "content-type",                "" },
+    { "cookie",                      "" },
+    { "date",                        "" },
+    { "etag",                        "" },
+    { "expect",                      "" },
+    { "expires",                     "" },
+    { "from",                        "" },
+    { "host",                        "" },
+    { "if-match",                    "" },
+    { "if-modified-since",           "" },
+    { "if-none-match",               "" },
+    { "if-range",                    "" },
+    { "if-unmodified-since",         "" },
+    { "last-modified",               "" },
+    { "link",                        "" },
+    { "location",                    "" },
+    { "max-forwards",                "" },
+    { "proxy-authenticate",          "" },
+    { "proxy-authorization",         "" },
+    { "range",                       "" },
+    { "referer",                     "" },
+    { "refresh",                     "" },
+    { "retry-after",                 "" },
+    { "server",                      "" },
+    { "set-cookie",                  "" },
+    { "strict-transport-security",   "" },
+    { "transfer-encoding",           "" },
+    { "user-agent",                  "" },
+    { "vary",                        "" },
+    { "via",                         "" },
+    { "www-authenticate",            "" },
+};
+
+#define STATIC_TABLE_SIZE FF_ARRAY_ELEMS(static_table)
+
+/* symbols of each code length, 0 to 30 bits */
+static const uint8_t huffman_count[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+/* symbols in canonical code order, 256 is EOS */
+static const uint16_t huffman_symbol[257] = {
+     48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,
+     45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
+     95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+     58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+     77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89,
+    106, 107, 113, 118, 119, 120, 121, 122,  38,  42,  44,  59,
+     88,  90,  33,  34,  40,  41,  63,  39,  43, 124,  35,  62,
+      0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239,   9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254,   2,   3,   4,   5,
+      6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+     21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
+    249,  10,  13,  22, 256,
+};
+
+/* a dynamic table entry costs its strings and 32 bytes (RFC 7541 4.1) */
+#define ENTRY_SIZE(name, value) (strlen(name) + strlen(value) + 32)
+
+void ff_hpack_decoder_init(HPACKDecoder *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->max_size = HPACK_TABLE_SIZE;
+}
+
+static void evict(HPACKDecoder *d, int max_size)
+{
+    while (d->size > max_size && d->nb_entries) {
+        HPACKEntry *e = &d->entries[--d->nb_entries];
+        d->size -= ENTRY_SIZE(e->name, e->value);
+        av_freep(&e->name);
+        av_freep(&e->value);
+    }
+}
+
+void ff_hpack_decoder_uninit(HPACKDecoder *d)
+{
+    evict(d, 0);
+    av_freep(&d->entries);
+}
+
+/* takes name and value */
+static int add_entry(HPACKDecoder *d, char *name, char *value)
+{
+    int size = ENTRY_SIZE(name, value);
+
+    if (size > d->max_size) {
+        /* not an error, it empties the table */
+        evict(d, 0);
+        av_free(name);
+        av_free(value);
+        return 0;
+    }
+    evict(d, d->max_size - size);
+    if (!d->entries) {
+        /* the most entries the table can hold */
+        d->entries = av_malloc_array(HPACK_TABLE_SIZE / 32, sizeof(*d->entries));
+        if (!d->entries) {
+            av_free(name);
+            av_free(value);
+            return AVERROR(ENOMEM);
+        }
+    }
+    memmove(d->entries + 1, d->entries, d->nb_entries * sizeof(*d->entries));
+    d->entries[0].name  = name;
+    d->entries[0].value = value;
+    d->nb_entries++;
+    d->size += size;
+    return 0;
+}
+
+static int get_entry(HPACKDecoder *d, uint32_t index, const char **name, const char **value)
+{
+    if (index == 0)
+        return AVERROR_INVALIDDATA;
+    if (index <= STATIC_TABLE_SIZE) {
+        *name  = static_table[index - 1].name;
+        *value = static_table[index - 1].value;
+        return 0;
+    }
+    index -= STATIC_TABLE_SIZE + 1;
+    if (index >= d->nb_entries)
+        return AVERROR_INVALIDDATA;
+    *name  = d->entries[index].name;
+    *value = d->entries[index].value;
+    return 0;
+}
+
+static int decode_int(const uint8_t **p, const uint8_t *end, int prefix, uint32_t *out)
+{
+    uint32_t max = (1 << prefix) - 1;
+    uint32_t v;
+    int shift = 0;
+
+    if (*p >= end)
+        return AVERROR_INVALIDDATA;
+    v = *(*p)++ & max;
+    if (v < max) {
+        *out = v;
+        return 0;
+    }
+    for (;;) {
+        uint8_t b;
+        if (*p >= end || shift > 21)
+            return AVERROR_INVALIDDATA;
+        b = *(*p)++;
+        v += (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+        if (!(b & 0x80))
+            break;
+    }
+    *out = v;
+    return 0;
+}
+
+static int huffman_decode(const uint8_t *src, int size, char *dst)
+{
+    const char *start = dst;
+    uint32_t code = 0, first = 0;
+    int len = 0, index = 0, i, bit;
+
+    for (i = 0; i < size; i++) {
+        for (bit = 7; bit >= 0; bit--) {
+            int count;
+
+            code = code << 1 | ((src[i] >> bit) & 1);
+            if (++len > 30)
+                return AVERROR_INVALIDDATA;
+            count = huffman_count[len];
+            if (code - first < count) {
+                int sym = huffman_symbol[index + code - first];
+                if (sym == 256)
+                    return AVERROR_INVALIDDATA;
+                *dst++ = sym;
+                code = first = len = index = 0;
+            } else {
+                index += count;
+                first  = (first + count) << 1;
+            }
+        }
+    }
+    /* padding is the most significant bits of EOS, all ones, under a byte */
+    if (len > 7 || code != (1U << len) - 1)
+        return AVERROR_INVALIDDATA;
+    *dst = 0;
+    return dst - start;
+}
+
+static int decode_string(const uint8_t **p, const uint8_t *end, char **out)
+{
+    int huffman, ret;
+    uint32_t len;
+
+    if (*p >= end)
+        return AVERROR_INVALIDDATA;
+    huffman = **p & 0x80;
+    if ((ret = decode_int(p, end, 7, &len)) < 0)
+        return ret;
+    if (len > end - *p)
+        return AVERROR_INVALIDDATA;
+
+    /* the shortest code is 5 bits */
+    *out = av_malloc(huffman ? len * 8 / 5 + 1 : len + 1);
+    if (!*out)
+        return AVERROR(ENOMEM);
+    if (huffman) {
+        ret = huffman_decode(*p, len, *out);
+        if (ret < 0) {
+            av_freep(out);
+            return ret;
+        }
+    } else {
+        memcpy(*out, *p, len);
+        (*out)[len] = 0;
+    }
+    if (strlen(*out) != (huffman ? ret : len)) {
+        /* a NUL inside would cut the field short */
+        av_freep(out);
+        return AVERROR_INVALIDDATA;
+    }
+    *p += len;
+    return 0;
+}
+
+int ff_hpack_decode(HPACKDecoder *d, const uint8_t *buf, int size,
+                    int (*cb)(void *opaque, const char *name, const char *value),
+                    void *opaque)
+{
+    const uint8_t *p = buf, *end = buf + size;
+    int ret = 0;
+
+    while (p < end) {
+        const char *name, *value;
+        char *new_name = NULL, *new_value = NULL;
+        uint32_t index;
+        int prefix, incremental = 0;
+
+        if (*p & 0x80) {                    /* indexed */
+            if ((ret = decode_int(&p, end, 7, &index)) < 0 ||
+                (ret = get_entry(d, index, &name, &value)) < 0)
+                return ret;
+            if (cb && (ret = cb(opaque, name, value)) < 0)
+                return ret;
+            continue;
+        }
+        if ((*p & 0xe0) == 0x20) {          /* dynamic table size update */
+            if ((ret = decode_int(&p, end, 5, &index)) < 0)
+                return ret;
+            if (index > HPACK_TABLE_SIZE)
+                return AVERROR_INVALIDDATA;
+            d->max_size = index;
+            evict(d, d->max_size);
+            continue;
+        }
+
+        /* literal, with incremental indexing, without or never indexed */
+        incremental = (*p & 0xc0) == 0x40;
+        prefix      = incremental ? 6 : 4;
+        if ((ret = decode_int(&p, end, prefix, &index)) < 0)
+            return ret;
+        if (index) {
+            const char *unused;
+            if ((ret = get_entry(d, index, &name, &unused)) < 0)
+                return ret;
+            if (incremental && !(new_name = av_strdup(name)))
+                return AVERROR(ENOMEM);
+        } else {
+            if ((ret = decode_string(&p, end, &new_name)) < 0)
+                return ret;
+            name = new_name;
+        }
+        if ((ret = decode_string(&p, end, &new_value)) < 0) {
+            av_free(new_name);
+            return ret;
+        }
+        if (cb)
+            ret = cb(opaque, new_name ? new_name : name, new_value);
+        if (ret >= 0 && incremental) {
+            /* the table takes the strings */
+            ret = add_entry(d, new_name, new_value);
+        } else {
+            av_free(new_name);
+            av_free(new_value);
+        }
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int encode_int(uint8_t **p, uint8_t *end, int prefix, uint8_t pattern, uint32_t v)
+{
+    uint32_t max = (1 << prefix) - 1;
+
+    if (*p >= end)
+        return AVERROR(ENOSPC);
+    if (v < max) {
+        *(*p)++ = pattern | v;
+        return 0;
+    }
+    *(*p)++ = pattern | max;
+    v -= max;
+    while (v >= 0x80) {
+        if (*p >= end)
+            return AVERROR(ENOSPC);
+        *(*p)++ = 0x80 | (v & 0x7f);
+        v >>= 7;
+    }
+    if (*p >= end)
+        return AVERROR(ENOSPC);
+    *(*p)++ = v;
+    return 0;
+}
+
+static int encode_string(uint8_t **p, uint8_t *end, const char *str)
+{
+    size_t len = strlen(str);
+    int ret;
+
+    if ((ret = encode_int(p, end, 7, 0x00, len)) < 0)
+        return ret;
+    if (len > end - *p)
+        return AVERROR(ENOSPC);
+    memcpy(*p, str, len);
+    *p += len;
+    return 0;
+}
+
+int ff_hpack_encode(uint8_t *buf, int size, const char *name, const char *value)
+{
+    uint8_t *p = buf, *end = buf + size;
+    int i, name_index = 0, ret;
+
+    for (i = 0; i < STATIC_TABLE_SIZE; i++) {
+        if (strcmp(static_table[i].name, name))
+            continue;
+        if (!strcmp(static_table[i].value, value)) {
+            if ((ret = encode_int(&p, end, 7, 0x80, i + 1)) < 0)
+                return ret;
+            return p - buf;
+        }
+        if (!name_index)
+            name_index = i + 1;
+    }
+
+    /* literal header field without indexing */
+    if ((ret = encode_int(&p, end, 4, 0x00, name_index)) < 0 ||
+        (!name_index && (ret = encode_string(&p, end, name)) < 0) ||
+        (ret = encode_string(&p, end, value)) < 0)
+        return ret;
+    return p - buf;
+}
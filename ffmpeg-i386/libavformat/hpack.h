@@ -0,0 +1,68 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HPACK_H
+#define AVFORMAT_HPACK_H
+
+#include <stdint.h>
+
+/* the dynamic table size of the decoder, SETTINGS_HEADER_TABLE_SIZE left at its default */
+#define HPACK_TABLE_SIZE 4096
+
+typedef struct HPACKEntry {
+    char *name;
+    char *value;
+} HPACKEntry;
+
+/**
+ * The decoding side of a connection, whose dynamic table follows every
+ * header block the peer sends, on any stream.
+ */
+typedef struct HPACKDecoder {
+    HPACKEntry *entries;        // newest first
+    int         nb_entries;
+    int         size;           // RFC 7541 4.1, name + value + 32 per entry
+    int         max_size;
+} HPACKDecoder;
+
+void ff_hpack_decoder_init(HPACKDecoder *d);
+void ff_hpack_decoder_uninit(HPACKDecoder *d);
+
+/**
+ * Decode a complete header block.
+ *
+ * @param cb called for each header field, in order, the strings are NUL
+ *           terminated and only valid during the call; a negative return
+ *           aborts the decoding
+ * @return 0, or a negative AVERROR, after which the connection is lost
+ */
+int ff_hpack_decode(HPACKDecoder *d, const uint8_t *buf, int size,
+                    int (*cb)(void *opaque, const char *name, const char *value),
+                    void *opaque);
+
+/**
+ * Encode a header field as a literal never added to a table, so the
+ * encoder keeps no state. name must be lowercase.
+ *
+ * @return the number of bytes written, AVERROR(ENOSPC) if size is too small
+ */
+int ff_hpack_encode(uint8_t *buf, int size, const char *name, const char *value);
+
+#endif /* AVFORMAT_HPACK_H */
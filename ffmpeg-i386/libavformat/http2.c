@@ -0,0 +1,1115 @@
+/*
+ * HTTP/2 client sessions shared by the http contexts of the process
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/atomic.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "hpack.h"
+#include "http2.h"
+#include "network.h"
+
+#define H2_FRAME_HEADER_SIZE    9
+#define H2_MAX_FRAME_SIZE       16384               // ours, SETTINGS_MAX_FRAME_SIZE left at its default
+#define H2_DEFAULT_WINDOW       65535
+#define H2_STREAM_WINDOW        (1 << 20)
+#define H2_SESSION_WINDOW       (16 << 20)
+#define H2_MAX_HEADER_BLOCK     (256 * 1024)
+#define H2_READ_BUFFER_SIZE     (2 * (H2_FRAME_HEADER_SIZE + H2_MAX_FRAME_SIZE))
+#define H2_IDLE_TIMEOUT         (30 * 1000000)      // a session without streams is closed after
+#define H2_HTTP1_ORIGIN_TTL     (600 * 1000000LL)   // an origin without h2 is not tried again for
+#define H2_MAX_HTTP1_ORIGINS    16
+#define H2_WAIT_INTERVAL        100000
+
+enum {
+    H2_DATA             = 0x0,
+    H2_HEADERS          = 0x1,
+    H2_PRIORITY         = 0x2,
+    H2_RST_STREAM       = 0x3,
+    H2_SETTINGS         = 0x4,
+    H2_PUSH_PROMISE     = 0x5,
+    H2_PING             = 0x6,
+    H2_GOAWAY           = 0x7,
+    H2_WINDOW_UPDATE    = 0x8,
+    H2_CONTINUATION     = 0x9,
+};
+
+#define H2_FLAG_END_STREAM      0x01
+#define H2_FLAG_ACK             0x01
+#define H2_FLAG_END_HEADERS     0x04
+#define H2_FLAG_PADDED          0x08
+#define H2_FLAG_PRIORITY        0x20
+
+#define H2_SETTINGS_ENABLE_PUSH             0x2
+#define H2_SETTINGS_MAX_CONCURRENT_STREAMS  0x3
+#define H2_SETTINGS_INITIAL_WINDOW_SIZE     0x4
+#define H2_SETTINGS_MAX_FRAME_SIZE          0x5
+
+#define H2_NO_ERROR             0x0
+#define H2_PROTOCOL_ERROR       0x1
+#define H2_CANCEL               0x8
+
+static const char h2_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+enum {
+    H2_CONNECTING,
+    H2_OPEN,
+    H2_CLOSED,      // no new streams, the ones open go on if the connection does
+};
+
+typedef struct HTTP2Session HTTP2Session;
+
+struct HTTP2Stream {
+    HTTP2Session           *session;
+    uint32_t                id;             // 0 until the request is sent
+    int                     weight;
+    AVIOInterruptCB         int_cb;
+    int64_t                 rw_timeout;
+
+    /* under the mutex of the session */
+    AVFifoBuffer           *fifo;           // the response head, then the body
+    int                     head_left;      // bytes of the head still in the fifo
+    int                     head_done;
+    int                     end_stream;
+    int                     error;
+    int                     unacked;        // body bytes read, not given back to the window yet
+    HTTP2Stream            *next;
+};
+
+/* lock order: registry_mutex, io_mutex, mutex */
+struct HTTP2Session {
+    char                   *key;            // lower protocol url, e.g. "tls://host:443"
+    URLContext             *hd;
+    AVIOInterruptCB         connect_int_cb; // the opener's, while connecting
+    volatile int            closing;
+
+    /* one SSL object cannot be used by two threads at once, hd is read and
+     * written under it */
+    pthread_mutex_t         io_mutex;
+
+    pthread_mutex_t         mutex;
+    pthread_cond_t          cond;           // a stream got bytes or an error
+    int                     state;
+    int                     refs;           // the reader thread and the streams
+    HTTP2Stream            *streams;
+    int                     nb_streams;
+    uint32_t                next_id;
+    uint32_t                max_streams;    // the peer's SETTINGS_MAX_CONCURRENT_STREAMS
+    uint32_t                max_frame_size; // the peer's SETTINGS_MAX_FRAME_SIZE
+    int64_t                 idle_since;
+
+    /* the reader thread only */
+    HPACKDecoder            hpack;
+    uint8_t                *block;          // a header block gathered over CONTINUATION frames
+    unsigned                block_alloc;
+    int                     block_size;
+    uint32_t                block_id;
+    int                     block_end_stream;
+    int                     conn_unacked;
+    AVBPrint                out;            // control frames to send once the frames read are handled
+    uint8_t                 rbuf[H2_READ_BUFFER_SIZE];
+
+    HTTP2Session           *next;           // in the registry, while it may take new streams
+};
+
+typedef struct HTTP1Origin {
+    char                    key[256];
+    int64_t                 expire_time;
+} HTTP1Origin;
+
+static pthread_mutex_t  registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   registry_cond  = PTHREAD_COND_INITIALIZER;  // a session is connected or failed
+static HTTP2Session    *registry;
+static HTTP1Origin      http1_origins[H2_MAX_HTTP1_ORIGINS];
+
+static void h2_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    int64_t         t = av_gettime() + H2_WAIT_INTERVAL;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    pthread_cond_timedwait(cond, mutex, &tv);
+}
+
+static uint8_t *h2_put_frame_header(uint8_t *p, int size, int type, int flags, uint32_t id)
+{
+    AV_WB24(p, size);
+    p[3] = type;
+    p[4] = flags;
+    AV_WB32(p + 5, id & 0x7fffffff);
+    return p + H2_FRAME_HEADER_SIZE;
+}
+
+static int h2_write(HTTP2Session *s, const uint8_t *buf, int size)
+{
+    int ret;
+
+    pthread_mutex_lock(&s->io_mutex);
+    ret = ffurl_write(s->hd, buf, size);
+    pthread_mutex_unlock(&s->io_mutex);
+    if (ret < 0)
+        avpriv_atomic_int_set(&s->closing, 1);
+    return ret;
+}
+
+static int h2_send_u32_frame(HTTP2Session *s, int type, uint32_t id, uint32_t value)
+{
+    uint8_t buf[H2_FRAME_HEADER_SIZE + 4];
+
+    AV_WB32(h2_put_frame_header(buf, 4, type, 0, id), value);
+    return h2_write(s, buf, sizeof(buf));
+}
+
+/* the reader thread only */
+static void h2_queue_frame(HTTP2Session *s, int type, int flags, uint32_t id,
+                           const uint8_t *payload, int size)
+{
+    uint8_t header[H2_FRAME_HEADER_SIZE];
+
+    h2_put_frame_header(header, size, type, flags, id);
+    av_bprint_append_data(&s->out, (const char *)header, sizeof(header));
+    if (size)
+        av_bprint_append_data(&s->out, (const char *)payload, size);
+}
+
+static void h2_queue_u32_frame(HTTP2Session *s, int type, uint32_t id, uint32_t value)
+{
+    uint8_t payload[4];
+
+    AV_WB32(payload, value);
+    h2_queue_frame(s, type, 0, id, payload, sizeof(payload));
+}
+
+static void h2_flush(HTTP2Session *s)
+{
+    if (s->out.len && av_bprint_is_complete(&s->out))
+        h2_write(s, (const uint8_t *)s->out.str, s->out.len);
+    av_bprint_clear(&s->out);
+}
+
+static int h2_interrupt_cb(void *opaque)
+{
+    HTTP2Session *s = opaque;
+
+    return avpriv_atomic_int_get(&s->closing) ||
+           ff_check_interrupt(&s->connect_int_cb);
+}
+
+static void h2_session_free(HTTP2Session *s)
+{
+    if (s->hd)
+        ffurl_closep(&s->hd);
+    ff_hpack_decoder_uninit(&s->hpack);
+    av_bprint_finalize(&s->out, NULL);
+    av_freep(&s->block);
+    av_freep(&s->key);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    pthread_mutex_destroy(&s->io_mutex);
+    av_free(s);
+}
+
+static void h2_session_unref(HTTP2Session *s)
+{
+    int refs;
+
+    pthread_mutex_lock(&s->mutex);
+    refs = --s->refs;
+    pthread_mutex_unlock(&s->mutex);
+    if (refs > 0)
+        return;
+
+    h2_session_free(s);
+}
+
+static HTTP2Session *h2_session_alloc(const char *url)
+{
+    HTTP2Session *s = av_mallocz(sizeof(*s));
+
+    if (!s)
+        return NULL;
+    s->key = av_strdup(url);
+    if (!s->key) {
+        av_free(s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->io_mutex, NULL);
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    ff_hpack_decoder_init(&s->hpack);
+    av_bprint_init(&s->out, 0, AV_BPRINT_SIZE_UNLIMITED);
+    s->state          = H2_CONNECTING;
+    s->next_id        = 1;
+    s->max_streams    = UINT32_MAX;
+    s->max_frame_size = H2_MAX_FRAME_SIZE;
+    s->idle_since     = av_gettime_relative();
+    return s;
+}
+
+/* must be called with the registry locked */
+static void h2_registry_remove_locked(HTTP2Session *s)
+{
+    HTTP2Session **p;
+
+    for (p = &registry; *p; p = &(*p)->next) {
+        if (*p == s) {
+            *p = s->next;
+            break;
+        }
+    }
+}
+
+static int h2_is_http1_origin_locked(const char *url)
+{
+    int64_t now = av_gettime_relative();
+    int i;
+
+    for (i = 0; i < H2_MAX_HTTP1_ORIGINS; i++) {
+        if (http1_origins[i].expire_time > now && !strcmp(http1_origins[i].key, url))
+            return 1;
+    }
+    return 0;
+}
+
+static void h2_add_http1_origin_locked(const char *url)
+{
+    int i, oldest = 0;
+
+    if (strlen(url) >= sizeof(http1_origins[0].key))
+        return;
+    for (i = 1; i < H2_MAX_HTTP1_ORIGINS; i++) {
+        if (http1_origins[i].expire_time < http1_origins[oldest].expire_time)
+            oldest = i;
+    }
+    av_strlcpy(http1_origins[oldest].key, url, sizeof(http1_origins[oldest].key));
+    http1_origins[oldest].expire_time = av_gettime_relative() + H2_HTTP1_ORIGIN_TTL;
+}
+
+static HTTP2Stream *h2_find_stream(HTTP2Session *s, uint32_t id)
+{
+    HTTP2Stream *st;
+
+    for (st = s->streams; st; st = st->next) {
+        if (st->id == id)
+            return st;
+    }
+    return NULL;
+}
+
+/* the stream can still take frames */
+static int h2_stream_live(HTTP2Stream *st)
+{
+    return st && !st->end_stream && !st->error;
+}
+
+static void h2_stream_fail(HTTP2Stream *st, int err)
+{
+    if (h2_stream_live(st))
+        st->error = err;
+}
+
+typedef struct H2HeaderBlock {
+    HTTP2Stream    *stream;
+    int             status;
+    AVBPrint        head;
+} H2HeaderBlock;
+
+static int h2_on_header(void *opaque, const char *name, const char *value)
+{
+    H2HeaderBlock *b = opaque;
+
+    if (!b->stream)
+        return 0;
+    if (name[0] == ':') {
+        if (!strcmp(name, ":status") && strlen(value) == 3)
+            b->status = strtol(value, NULL, 10);
+        return 0;
+    }
+    // a field which would break the lines of the head is not passed
+    if (strpbrk(name, "\r\n:") || strpbrk(value, "\r\n"))
+        return 0;
+    av_bprintf(&b->head, "%s: %s\r\n", name, value);
+    return 0;
+}
+
+/* the response head goes to the stream as HTTP/1.1 would have it */
+static int h2_on_header_block(HTTP2Session *s)
+{
+    H2HeaderBlock b = { 0 };
+    int ret;
+
+    b.stream = h2_find_stream(s, s->block_id);
+    if (!h2_stream_live(b.stream))
+        b.stream = NULL;
+    av_bprint_init(&b.head, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&b.head, "HTTP/2 000\r\n");
+
+    // decoded whatever the stream, the table follows every block
+    ret = ff_hpack_decode(&s->hpack, s->block, s->block_size, h2_on_header, &b);
+    s->block_id = 0;
+    if (ret < 0 || !b.stream || b.stream->head_done)
+        goto end;       // trailers are not passed
+
+    if (b.status < 100 || (b.status < 200 && s->block_end_stream)) {
+        h2_stream_fail(b.stream, AVERROR_INVALIDDATA);
+        h2_queue_u32_frame(s, H2_RST_STREAM, b.stream->id, H2_PROTOCOL_ERROR);
+        goto end;
+    }
+    if (b.status < 200)
+        goto end;       // an interim response
+
+    av_bprintf(&b.head, "\r\n");
+    if (!av_bprint_is_complete(&b.head)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    // the status line was written before the fields, the status is known now
+    b.head.str[7] = '0' + b.status / 100;
+    b.head.str[8] = '0' + b.status / 10 % 10;
+    b.head.str[9] = '0' + b.status % 10;
+    if (av_fifo_space(b.stream->fifo) < b.head.len &&
+        av_fifo_grow(b.stream->fifo, b.head.len) < 0) {
+        h2_stream_fail(b.stream, AVERROR(ENOMEM));
+        goto end;
+    }
+    av_fifo_generic_write(b.stream->fifo, b.head.str, b.head.len, NULL);
+    b.stream->head_left = b.head.len;
+    b.stream->head_done = 1;
+end:
+    if (ret >= 0 && s->block_end_stream && h2_stream_live(b.stream))
+        b.stream->end_stream = 1;
+    av_bprint_finalize(&b.head, NULL);
+    return ret;
+}
+
+static int h2_append_block(HTTP2Session *s, const uint8_t *data, int size)
+{
+    uint8_t *block;
+
+    if (s->block_size + size > H2_MAX_HEADER_BLOCK)
+        return AVERROR_INVALIDDATA;
+    block = av_fast_realloc(s->block, &s->block_alloc, s->block_size + size);
+    if (!block)
+        return AVERROR(ENOMEM);
+    s->block = block;
+    memcpy(s->block + s->block_size, data, size);
+    s->block_size += size;
+    return 0;
+}
+
+/* strip the padding, *size is that of the payload */
+static int h2_unpad(int flags, const uint8_t **data, int *size)
+{
+    int pad;
+
+    if (!(flags & H2_FLAG_PADDED))
+        return 0;
+    if (*size < 1)
+        return AVERROR_INVALIDDATA;
+    pad = (*data)[0];
+    if (pad >= *size)
+        return AVERROR_INVALIDDATA;
+    *data += 1;
+    *size -= 1 + pad;
+    return 0;
+}
+
+static int h2_on_data(HTTP2Session *s, int flags, uint32_t id, const uint8_t *data, int size)
+{
+    HTTP2Stream *st = h2_find_stream(s, id);
+    int window = size;
+    int ret;
+
+    if (!id || (ret = h2_unpad(flags, &data, &size)) < 0)
+        return AVERROR_INVALIDDATA;
+
+    // the session window is given back as the bytes come, the one of the
+    // stream as they are read, which bounds what a stream buffers
+    s->conn_unacked += window;
+    if (s->conn_unacked >= H2_SESSION_WINDOW / 2) {
+        h2_queue_u32_frame(s, H2_WINDOW_UPDATE, 0, s->conn_unacked);
+        s->conn_unacked = 0;
+    }
+
+    if (!h2_stream_live(st))
+        return 0;
+    if (!st->head_done) {
+        st->error = AVERROR_INVALIDDATA;
+        h2_queue_u32_frame(s, H2_RST_STREAM, id, H2_PROTOCOL_ERROR);
+        return 0;
+    }
+    if (av_fifo_space(st->fifo) < size &&
+        av_fifo_grow(st->fifo, size) < 0) {
+        st->error = AVERROR(ENOMEM);
+        h2_queue_u32_frame(s, H2_RST_STREAM, id, H2_CANCEL);
+        return 0;
+    }
+    av_fifo_generic_write(st->fifo, (void *)data, size, NULL);
+    st->unacked += window - size;
+    if (flags & H2_FLAG_END_STREAM)
+        st->end_stream = 1;
+    return 0;
+}
+
+static int h2_on_settings(HTTP2Session *s, int flags, uint32_t id, const uint8_t *data, int size)
+{
+    int i;
+
+    if (id || size % 6 || ((flags & H2_FLAG_ACK) && size))
+        return AVERROR_INVALIDDATA;
+    if (flags & H2_FLAG_ACK)
+        return 0;
+
+    for (i = 0; i < size; i += 6) {
+        uint32_t value = AV_RB32(data + i + 2);
+
+        switch (AV_RB16(data + i)) {
+        case H2_SETTINGS_MAX_CONCURRENT_STREAMS:
+            s->max_streams = value;
+            break;
+        case H2_SETTINGS_MAX_FRAME_SIZE:
+            if (value < 16384 || value > 16777215)
+                return AVERROR_INVALIDDATA;
+            s->max_frame_size = value;
+            break;
+        }
+    }
+    h2_queue_frame(s, H2_SETTINGS, H2_FLAG_ACK, 0, NULL, 0);
+    return 0;
+}
+
+static int h2_on_goaway(HTTP2Session *s, uint32_t id, const uint8_t *data, int size)
+{
+    uint32_t last_id;
+    HTTP2Stream *st;
+
+    if (id || size < 8)
+        return AVERROR_INVALIDDATA;
+    last_id = AV_RB32(data) & 0x7fffffff;
+    av_log(NULL, AV_LOG_VERBOSE, "http2: %s goes away after stream %u, error %u\n",
+           s->key, last_id, AV_RB32(data + 4));
+
+    // the streams past last_id were not processed, they can be retried
+    s->state = H2_CLOSED;
+    for (st = s->streams; st; st = st->next) {
+        if (st->id > last_id)
+            h2_stream_fail(st, AVERROR(ECONNRESET));
+    }
+    return 0;
+}
+
+/* a negative return is an error of the connection */
+static int h2_handle_frame(HTTP2Session *s, int type, int flags, uint32_t id,
+                           const uint8_t *data, int size)
+{
+    int ret;
+
+    // a header block is not interleaved with other frames
+    if (s->block_id && (type != H2_CONTINUATION || id != s->block_id))
+        return AVERROR_INVALIDDATA;
+
+    switch (type) {
+    case H2_DATA:
+        return h2_on_data(s, flags, id, data, size);
+    case H2_HEADERS:
+        if (!id || (ret = h2_unpad(flags, &data, &size)) < 0)
+            return AVERROR_INVALIDDATA;
+        if (flags & H2_FLAG_PRIORITY) {
+            if (size < 5)
+                return AVERROR_INVALIDDATA;
+            data += 5;
+            size -= 5;
+        }
+        s->block_id         = id;
+        s->block_size       = 0;
+        s->block_end_stream = flags & H2_FLAG_END_STREAM;
+        if ((ret = h2_append_block(s, data, size)) < 0)
+            return ret;
+        return flags & H2_FLAG_END_HEADERS ? h2_on_header_block(s) : 0;
+    case H2_CONTINUATION:
+        if (!s->block_id)
+            return AVERROR_INVALIDDATA;
+        if ((ret = h2_append_block(s, data, size)) < 0)
+            return ret;
+        return flags & H2_FLAG_END_HEADERS ? h2_on_header_block(s) : 0;
+    case H2_RST_STREAM:
+        if (!id || size != 4)
+            return AVERROR_INVALIDDATA;
+        h2_stream_fail(h2_find_stream(s, id), AVERROR(ECONNRESET));
+        return 0;
+    case H2_SETTINGS:
+        return h2_on_settings(s, flags, id, data, size);
+    case H2_PING:
+        if (id || size != 8)
+            return AVERROR_INVALIDDATA;
+        if (!(flags & H2_FLAG_ACK))
+            h2_queue_frame(s, H2_PING, H2_FLAG_ACK, 0, data, size);
+        return 0;
+    case H2_GOAWAY:
+        return h2_on_goaway(s, id, data, size);
+    case H2_PUSH_PROMISE:
+        // disabled by our SETTINGS
+        return AVERROR_INVALIDDATA;
+    default:
+        // PRIORITY, WINDOW_UPDATE: nothing is sent but headers; unknown types are ignored
+        return 0;
+    }
+}
+
+/* handle the complete frames of buf, leave the rest at its start */
+static int h2_handle_frames(HTTP2Session *s, int *len)
+{
+    uint8_t *buf = s->rbuf;
+    int pos = 0, ret = 0;
+
+    pthread_mutex_lock(&s->mutex);
+    while (*len - pos >= H2_FRAME_HEADER_SIZE) {
+        int size = AV_RB24(buf + pos);
+
+        if (size > H2_MAX_FRAME_SIZE) {
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        if (*len - pos < H2_FRAME_HEADER_SIZE + size)
+            break;
+        ret = h2_handle_frame(s, buf[pos + 3], buf[pos + 4], AV_RB32(buf + pos + 5) & 0x7fffffff,
+                              buf + pos + H2_FRAME_HEADER_SIZE, size);
+        pos += H2_FRAME_HEADER_SIZE + size;
+        if (ret < 0)
+            break;
+    }
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+
+    memmove(buf, buf + pos, *len - pos);
+    *len -= pos;
+    return ret;
+}
+
+/* a session left without streams once closed or idle for long ends */
+static int h2_session_done(HTTP2Session *s)
+{
+    int done;
+
+    pthread_mutex_lock(&s->mutex);
+    done = !s->nb_streams &&
+           (s->state == H2_CLOSED || av_gettime_relative() - s->idle_since > H2_IDLE_TIMEOUT);
+    if (done)
+        s->state = H2_CLOSED;
+    pthread_mutex_unlock(&s->mutex);
+    return done;
+}
+
+static void *h2_reader(void *arg)
+{
+    HTTP2Session *s = arg;
+    HTTP2Stream  *st;
+    int len = 0, wait = 0, ret;
+
+    for (;;) {
+        if (wait) {
+            ret = ff_network_wait_fd(ffurl_get_file_handle(s->hd), 0);
+            if (h2_session_done(s)) {
+                ret = 0;
+                break;
+            }
+            if (ret == AVERROR(EAGAIN))
+                continue;
+            if (ret < 0)
+                break;
+        }
+
+        // not blocking, the writers wait for the io mutex meanwhile; tls
+        // may hold decrypted bytes back, so it is read until it has none
+        pthread_mutex_lock(&s->io_mutex);
+        s->hd->flags |= AVIO_FLAG_NONBLOCK;
+        ret = ffurl_read(s->hd, s->rbuf + len, H2_READ_BUFFER_SIZE - len);
+        s->hd->flags &= ~AVIO_FLAG_NONBLOCK;
+        pthread_mutex_unlock(&s->io_mutex);
+        wait = ret == AVERROR(EAGAIN);
+        if (wait)
+            continue;
+        if (ret <= 0) {
+            ret = ret ? ret : AVERROR_EOF;
+            break;
+        }
+
+        len += ret;
+        ret = h2_handle_frames(s, &len);
+        if (ret == AVERROR_INVALIDDATA) {
+            static const uint8_t goaway[8] = { 0, 0, 0, 0, 0, 0, 0, H2_PROTOCOL_ERROR };
+
+            av_log(NULL, AV_LOG_ERROR, "http2: protocol error on %s\n", s->key);
+            h2_queue_frame(s, H2_GOAWAY, 0, 0, goaway, sizeof(goaway));
+        }
+        h2_flush(s);
+        if (ret < 0)
+            break;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    h2_registry_remove_locked(s);
+    pthread_mutex_unlock(&registry_mutex);
+
+    pthread_mutex_lock(&s->mutex);
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_VERBOSE, "http2: connection to %s lost: %s\n", s->key, av_err2str(ret));
+    s->state = H2_CLOSED;
+    for (st = s->streams; st; st = st->next)
+        h2_stream_fail(st, AVERROR(ECONNRESET));
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    // a writer blocked on the dead connection gives up
+    avpriv_atomic_int_set(&s->closing, 1);
+
+    h2_session_unref(s);
+    return NULL;
+}
+
+static int h2_session_connect(HTTP2Session *s, const AVIOInterruptCB *int_cb,
+                              AVDictionary **options,
+                              const char *whitelist, const char *blacklist,
+                              URLContext *parent)
+{
+    AVIOInterruptCB cb   = { h2_interrupt_cb, s };
+    AVDictionary   *opts = NULL;
+    uint8_t        *alpn = NULL;
+    uint8_t         hello[sizeof(h2_preface) - 1 + 2 * H2_FRAME_HEADER_SIZE + 12 + 4];
+    uint8_t        *p;
+    int ret;
+
+    if (options)
+        av_dict_copy(&opts, *options, 0);
+    av_dict_set(&opts, "alpn", "h2,http/1.1", 0);
+    // the connection outlives the player opening it, it reports to none
+    av_dict_set(&opts, "ijkapplication", NULL, 0);
+
+    s->connect_int_cb = int_cb ? *int_cb : (AVIOInterruptCB){ NULL };
+    ret = ffurl_open_whitelist(&s->hd, s->key, AVIO_FLAG_READ_WRITE, &cb, &opts,
+                               whitelist, blacklist, parent);
+    s->connect_int_cb = (AVIOInterruptCB){ NULL };
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    if (av_opt_get(s->hd->priv_data, "alpn_selected", 0, &alpn) < 0 ||
+        !alpn || strcmp((const char *)alpn, "h2")) {
+        av_log(parent, AV_LOG_VERBOSE, "%s does not speak HTTP/2\n", s->key);
+        av_free(alpn);
+        return AVERROR(ENOPROTOOPT);
+    }
+    av_free(alpn);
+
+    // no push, and windows large enough for segments to come at full speed
+    memcpy(hello, h2_preface, sizeof(h2_preface) - 1);
+    p = h2_put_frame_header(hello + sizeof(h2_preface) - 1, 12, H2_SETTINGS, 0, 0);
+    AV_WB16(p,      H2_SETTINGS_ENABLE_PUSH);
+    AV_WB32(p + 2,  0);
+    AV_WB16(p + 6,  H2_SETTINGS_INITIAL_WINDOW_SIZE);
+    AV_WB32(p + 8,  H2_STREAM_WINDOW);
+    p = h2_put_frame_header(p + 12, 4, H2_WINDOW_UPDATE, 0, 0);
+    AV_WB32(p, H2_SESSION_WINDOW - H2_DEFAULT_WINDOW);
+
+    ret = ffurl_write(s->hd, hello, sizeof(hello));
+    return ret < 0 ? ret : 0;
+}
+
+/* must be called with the session locked */
+static void h2_attach_locked(HTTP2Session *s, HTTP2Stream *st)
+{
+    st->session = s;
+    st->next    = s->streams;
+    s->streams  = st;
+    s->nb_streams++;
+    s->refs++;
+}
+
+static void h2_stream_free(HTTP2Stream **pst)
+{
+    av_fifo_freep(&(*pst)->fifo);
+    av_freep(pst);
+}
+
+int ff_http2_open(HTTP2Stream **pstream, const char *url, int weight,
+                  const AVIOInterruptCB *int_cb, AVDictionary **options,
+                  const char *whitelist, const char *blacklist,
+                  URLContext *parent)
+{
+    HTTP2Session       *s;
+    HTTP2Stream        *st;
+    AVDictionaryEntry  *e;
+    pthread_t           thread;
+    pthread_attr_t      attr;
+    int ret;
+
+    st = av_mallocz(sizeof(*st));
+    if (!st)
+        return AVERROR(ENOMEM);
+    st->fifo = av_fifo_alloc(4096);
+    if (!st->fifo) {
+        av_free(st);
+        return AVERROR(ENOMEM);
+    }
+    st->weight = av_clip(weight, 1, 256);
+    st->int_cb = int_cb ? *int_cb : (AVIOInterruptCB){ NULL };
+    if (options && (e = av_dict_get(*options, "timeout", NULL, 0)))
+        st->rw_timeout = strtoll(e->value, NULL, 10);
+
+    pthread_mutex_lock(&registry_mutex);
+    for (;;) {
+        int connecting = 0;
+
+        for (s = registry; s; s = s->next) {
+            if (strcmp(s->key, url))
+                continue;
+            pthread_mutex_lock(&s->mutex);
+            if (s->state == H2_OPEN && s->nb_streams < s->max_streams) {
+                h2_attach_locked(s, st);
+                pthread_mutex_unlock(&s->mutex);
+                break;
+            }
+            connecting |= s->state == H2_CONNECTING;
+            pthread_mutex_unlock(&s->mutex);
+        }
+        if (s || !connecting)
+            break;
+        // one connection per origin, the others wait for it
+        if (ff_check_interrupt(&st->int_cb)) {
+            pthread_mutex_unlock(&registry_mutex);
+            h2_stream_free(&st);
+            return AVERROR_EXIT;
+        }
+        h2_cond_wait(&registry_cond, &registry_mutex);
+    }
+    if (s) {
+        pthread_mutex_unlock(&registry_mutex);
+        *pstream = st;
+        return 0;
+    }
+    if (h2_is_http1_origin_locked(url)) {
+        pthread_mutex_unlock(&registry_mutex);
+        h2_stream_free(&st);
+        return AVERROR(ENOPROTOOPT);
+    }
+
+    s = h2_session_alloc(url);
+    if (!s) {
+        pthread_mutex_unlock(&registry_mutex);
+        h2_stream_free(&st);
+        return AVERROR(ENOMEM);
+    }
+    s->next  = registry;
+    registry = s;
+    pthread_mutex_unlock(&registry_mutex);
+
+    ret = h2_session_connect(s, int_cb, options, whitelist, blacklist, parent);
+
+    pthread_mutex_lock(&registry_mutex);
+    if (ret >= 0) {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        ret = AVERROR(pthread_create(&thread, &attr, h2_reader, s));
+        pthread_attr_destroy(&attr);
+    }
+    if (ret < 0) {
+        if (ret == AVERROR(ENOPROTOOPT))
+            h2_add_http1_origin_locked(url);
+        h2_registry_remove_locked(s);
+        pthread_cond_broadcast(&registry_cond);
+        pthread_mutex_unlock(&registry_mutex);
+        h2_session_free(s);
+        h2_stream_free(&st);
+        return ret;
+    }
+    pthread_mutex_lock(&s->mutex);
+    s->refs++;
+    if (s->state == H2_CONNECTING)
+        s->state = H2_OPEN;
+    h2_attach_locked(s, st);
+    pthread_mutex_unlock(&s->mutex);
+    pthread_cond_broadcast(&registry_cond);
+    pthread_mutex_unlock(&registry_mutex);
+
+    *pstream = st;
+    return 0;
+}
+
+/* hop by hop fields, and Host which becomes :authority */
+static int h2_skip_field(const char *name)
+{
+    static const char *const skipped[] = {
+        "connection", "keep-alive", "proxy-connection", "transfer-encoding",
+        "upgrade", "te", "host",
+    };
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(skipped); i++) {
+        if (!strcmp(name, skipped[i]))
+            return 1;
+    }
+    return 0;
+}
+
+static int h2_encode(uint8_t *buf, int size, int *pos, const char *name, const char *value)
+{
+    int ret = ff_hpack_encode(buf + *pos, size - *pos, name, value);
+
+    if (ret < 0)
+        return ret;
+    *pos += ret;
+    return 0;
+}
+
+/* the header block of an HTTP/1.1 request head */
+static int h2_encode_request(const char *request, uint8_t **pblock, int *pblock_size)
+{
+    char       *copy = av_strdup(request);
+    char       *line, *next, *method, *path, *host = NULL;
+    uint8_t    *fields = NULL, *block = NULL;
+    int         size, fields_size = 0, block_size = 0, ret = AVERROR_INVALIDDATA;
+
+    if (!copy)
+        return AVERROR(ENOMEM);
+    // every field costs less encoded than as a line, the pseudo ones aside
+    size   = 2 * strlen(request) + 256;
+    fields = av_malloc(size);
+    block  = av_malloc(size);
+    if (!fields || !block) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    // request line
+    next = strstr(copy, "\r\n");
+    if (!next)
+        goto end;
+    *next  = '\0';
+    next  += 2;
+    method = copy;
+    path   = strchr(method, ' ');
+    if (!path)
+        goto end;
+    *path++ = '\0';
+    line    = strchr(path, ' ');
+    if (!line)
+        goto end;
+    *line = '\0';
+
+    for (line = next; *line; line = next) {
+        char *value, *p;
+
+        next = strstr(line, "\r\n");
+        if (!next)
+            goto end;
+        *next  = '\0';
+        next  += 2;
+        if (!*line)
+            break;      // the blank line ending the head
+        value  = strchr(line, ':');
+        if (!value)
+            goto end;
+        *value++ = '\0';
+        value   += strspn(value, " \t");
+        for (p = line; *p; p++)
+            *p = av_tolower(*p);
+
+        if (!strcmp(line, "host"))
+            host = value;
+        if (h2_skip_field(line))
+            continue;
+        if ((ret = h2_encode(fields, size, &fields_size, line, value)) < 0)
+            goto end;
+        ret = AVERROR_INVALIDDATA;
+    }
+    if (!host)
+        goto end;
+
+    if ((ret = h2_encode(block, size, &block_size, ":method", method)) < 0 ||
+        (ret = h2_encode(block, size, &block_size, ":scheme", "https")) < 0 ||
+        (ret = h2_encode(block, size, &block_size, ":authority", host)) < 0 ||
+        (ret = h2_encode(block, size, &block_size, ":path", path)) < 0)
+        goto end;
+    if (size - block_size < fields_size) {
+        ret = AVERROR(ENOSPC);
+        goto end;
+    }
+    memcpy(block + block_size, fields, fields_size);
+    block_size += fields_size;
+
+    *pblock      = block;
+    *pblock_size = block_size;
+    block        = NULL;
+    ret          = 0;
+end:
+    av_free(copy);
+    av_free(fields);
+    av_free(block);
+    return ret;
+}
+
+int ff_http2_send_request(HTTP2Stream *st, const char *request)
+{
+    HTTP2Session *s = st->session;
+    uint8_t *block, *frames, *p;
+    int block_size, max_frame_size, pos, ret;
+
+    if ((ret = h2_encode_request(request, &block, &block_size)) < 0)
+        return ret;
+    frames = av_malloc(block_size + 5 + H2_FRAME_HEADER_SIZE * (block_size / H2_MAX_FRAME_SIZE + 2));
+    if (!frames) {
+        av_free(block);
+        return AVERROR(ENOMEM);
+    }
+
+    // the ids must reach the peer in the order they are given
+    pthread_mutex_lock(&s->io_mutex);
+    pthread_mutex_lock(&s->mutex);
+    if (st->id || s->state != H2_OPEN || s->next_id > 0x7fffffff) {
+        pthread_mutex_unlock(&s->mutex);
+        pthread_mutex_unlock(&s->io_mutex);
+        av_free(block);
+        av_free(frames);
+        return st->id ? AVERROR(EINVAL) : AVERROR(ECONNRESET);
+    }
+    st->id          = s->next_id;
+    s->next_id     += 2;
+    max_frame_size  = s->max_frame_size;
+    if (s->next_id > 0x7fffffff)
+        s->state = H2_CLOSED;
+    pthread_mutex_unlock(&s->mutex);
+
+    // HEADERS carrying the priority, then CONTINUATION if the block is large
+    pos = FFMIN(block_size, max_frame_size - 5);
+    p   = h2_put_frame_header(frames, 5 + pos, H2_HEADERS,
+                              H2_FLAG_END_STREAM | H2_FLAG_PRIORITY |
+                              (pos == block_size ? H2_FLAG_END_HEADERS : 0), st->id);
+    AV_WB32(p, 0);
+    p[4] = st->weight - 1;
+    memcpy(p + 5, block, pos);
+    p += 5 + pos;
+    while (pos < block_size) {
+        int size = FFMIN(block_size - pos, max_frame_size);
+
+        p = h2_put_frame_header(p, size, H2_CONTINUATION,
+                                pos + size == block_size ? H2_FLAG_END_HEADERS : 0, st->id);
+        memcpy(p, block + pos, size);
+        p   += size;
+        pos += size;
+    }
+    ret = ffurl_write(s->hd, frames, p - frames);
+    pthread_mutex_unlock(&s->io_mutex);
+    av_free(block);
+    av_free(frames);
+
+    if (ret < 0) {
+        avpriv_atomic_int_set(&s->closing, 1);
+        pthread_mutex_lock(&s->mutex);
+        h2_stream_fail(st, ret);
+        pthread_mutex_unlock(&s->mutex);
+        return ret;
+    }
+    return 0;
+}
+
+int ff_http2_read(HTTP2Stream *st, uint8_t *buf, int size)
+{
+    HTTP2Session *s = st->session;
+    int64_t  deadline = st->rw_timeout > 0 ? av_gettime_relative() + st->rw_timeout : 0;
+    uint32_t update = 0;
+    int ret;
+
+    pthread_mutex_lock(&s->mutex);
+    for (;;) {
+        int avail = av_fifo_size(st->fifo);
+
+        if (avail > 0) {
+            int head;
+
+            ret  = FFMIN(size, avail);
+            av_fifo_generic_read(st->fifo, buf, ret, NULL);
+            head = FFMIN(ret, st->head_left);
+            st->head_left -= head;
+            st->unacked   += ret - head;
+            if (st->unacked >= H2_STREAM_WINDOW / 2 && h2_stream_live(st)) {
+                update      = st->unacked;
+                st->unacked = 0;
+            }
+            break;
+        }
+        if (st->error) {
+            ret = st->error;
+            break;
+        }
+        if (st->end_stream) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        if (ff_check_interrupt(&st->int_cb)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (deadline && av_gettime_relative() > deadline) {
+            ret = AVERROR(ETIMEDOUT);
+            break;
+        }
+        h2_cond_wait(&s->cond, &s->mutex);
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    if (update)
+        h2_send_u32_frame(s, H2_WINDOW_UPDATE, st->id, update);
+    return ret;
+}
+
+void ff_http2_close(HTTP2Stream **pstream)
+{
+    HTTP2Stream   *st = *pstream;
+    HTTP2Stream  **p;
+    HTTP2Session  *s;
+    int cancel;
+
+    if (!st)
+        return;
+    s = st->session;
+
+    pthread_mutex_lock(&s->mutex);
+    cancel = st->id && h2_stream_live(st);
+    for (p = &s->streams; *p; p = &(*p)->next) {
+        if (*p == st) {
+            *p = st->next;
+            break;
+        }
+    }
+    if (!--s->nb_streams)
+        s->idle_since = av_gettime_relative();
+    pthread_mutex_unlock(&s->mutex);
+
+    if (cancel)
+        h2_send_u32_frame(s, H2_RST_STREAM, st->id, H2_CANCEL);
+    h2_session_unref(s);
+    h2_stream_free(pstream);
+}
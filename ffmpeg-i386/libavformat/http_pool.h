@@ -0,0 +1,77 @@
+/*
+ * Process wide pool of persistent HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP_POOL_H
+#define AVFORMAT_HTTP_POOL_H
+
+#include "libavutil/application.h"
+#include "libavutil/dict.h"
+#include "url.h"
+
+/**
+ * A lower protocol connection (tcp, tls, ...) that can outlive the
+ * HTTPContext which opened it.
+ *
+ * The URLContext is opened with an interrupt callback and an
+ * AVApplicationContext owned by the pool entry, both forward to whoever
+ * holds the connection at the moment, so an idle connection never refers
+ * to a player that is gone.
+ */
+typedef struct HTTPPoolConnection {
+    URLContext           *hd;
+    char                 *key;              // lower protocol url, e.g. "tls://host:443"
+    AVIOInterruptCB       owner_int_cb;
+    AVApplicationContext *owner_app_ctx;
+    AVApplicationContext *app_ctx;
+    int64_t               expire_time;      // av_gettime_relative() deadline while idle
+    struct HTTPPoolConnection *next;
+} HTTPPoolConnection;
+
+typedef struct HTTPPoolStatistic {
+    int64_t opened;     // connections opened through the pool
+    int64_t reused;     // idle connections handed out again
+    int     idle;       // connections waiting in the pool
+} HTTPPoolStatistic;
+
+/**
+ * Lease an idle connection to url, or open a new one.
+ *
+ * @param allow_reuse 0 to always open a new connection
+ * @return 1 if an idle connection was reused, 0 if a new one was opened,
+ *         a negative AVERROR on failure
+ */
+int ff_http_pool_open(HTTPPoolConnection **pconn, const char *url, int allow_reuse,
+                      const AVIOInterruptCB *int_cb, AVApplicationContext *app_ctx,
+                      AVDictionary **options,
+                      const char *whitelist, const char *blacklist,
+                      URLContext *parent);
+
+/**
+ * Give the connection back. It is closed unless reusable is set and the
+ * host has less than max_idle_per_host idle connections.
+ *
+ * @param idle_timeout how long the connection may stay idle, in microseconds
+ */
+void ff_http_pool_release(HTTPPoolConnection **pconn, int reusable,
+                          int max_idle_per_host, int64_t idle_timeout);
+
+void ff_http_pool_get_statistic(HTTPPoolStatistic *stat);
+
+#endif /* AVFORMAT_HTTP_POOL_H */
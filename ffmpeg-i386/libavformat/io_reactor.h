@@ -0,0 +1,64 @@
+/*
+ * Process wide IO reactor
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_IO_REACTOR_H
+#define AVFORMAT_IO_REACTOR_H
+
+#include <stdint.h>
+
+/**
+ * The background IO of every URL context in the process, run on a few
+ * shared threads instead of one thread each. A source is a step function,
+ * called on a worker and never on two at once, which does a slice of work
+ * and tells how to wait before the next one. One kqueue thread watches the
+ * descriptors and timers of the waiting sources.
+ */
+
+enum FFIOReactorWait {
+    FF_IO_REACTOR_RUN,          ///< call again once a worker is free
+    FF_IO_REACTOR_WAIT_READ,    ///< until *fd is readable, or *timeout microseconds
+    FF_IO_REACTOR_WAIT,         ///< *timeout microseconds, until woken if <= 0
+    FF_IO_REACTOR_DONE,         ///< never called again
+};
+
+typedef struct FFIOReactorSource FFIOReactorSource;
+
+typedef int (*FFIOReactorStep)(void *opaque, int *fd, int64_t *timeout);
+
+/**
+ * The step is first called right away, *src is set before.
+ *
+ * @return AVERROR(ENOSYS) if the platform has no reactor, the caller then
+ *         runs the step on a thread of its own
+ */
+int ff_io_reactor_add(FFIOReactorSource **src, FFIOReactorStep step, void *opaque);
+
+/**
+ * Any thread: call the step again soon, whatever it waits for, or once more
+ * if it is running.
+ */
+void ff_io_reactor_wake(FFIOReactorSource *src);
+
+/**
+ * Wait for the step to return FF_IO_REACTOR_DONE and free the source.
+ */
+void ff_io_reactor_join(FFIOReactorSource **src);
+
+#endif /* AVFORMAT_IO_REACTOR_H */
@@ -1161,7 +1161,9 @@ static int mov_read_moov(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
 static int mov_read_moof(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
-    if (!c->has_looked_for_mfra && c->use_mfra_for > 0) {
+    /* fragments are only dropped from the index if the mfra can find them again */
+    if (!c->has_looked_for_mfra &&
+        (c->use_mfra_for > 0 || (c->keep_fragments >= 0 && !c->fragment_index_complete))) {
         c->has_looked_for_mfra = 1;
         if (pb->seekable & AVIO_SEEKABLE_NORMAL) {
             int ret;
@@ -3302,6 +3304,437 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+#define MOV_LAZY_INDEX_MIN_WINDOW 128
+
+static int mov_lazy_index_alloc(AVStream *st, unsigned int nb_entries)
+{
+    if (nb_entries >= UINT_MAX / sizeof(*st->index_entries))
+        return AVERROR(ENOMEM);
+    if (nb_entries * sizeof(*st->index_entries) <= st->index_entries_allocated_size)
+        return 0;
+    if (av_reallocp_array(&st->index_entries, nb_entries, sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        st->index_entries_allocated_size = 0;
+        return AVERROR(ENOMEM);
+    }
+    st->index_entries_allocated_size = nb_entries * sizeof(*st->index_entries);
+    return 0;
+}
+
+static void mov_lazy_index_enter_chunk(MOVStreamContext *sc, MOVLazyIndex *li)
+{
+    while (mov_stsc_index_valid(li->stsc_index, sc->stsc_count) &&
+           li->chunk + 1 == sc->stsc_data[li->stsc_index + 1].first)
+        li->stsc_index++;
+    li->chunk_sample = 0;
+    li->offset       = sc->chunk_offsets[li->chunk];
+}
+
+static inline int mov_lazy_index_key_off(MOVStreamContext *sc)
+{
+    return sc->keyframe_count && sc->keyframes[0] > 0;
+}
+
+/* Index of the first stss entry at or after the sample, the last one if none. */
+static unsigned int mov_lazy_index_find_stss(MOVStreamContext *sc, unsigned int sample)
+{
+    int64_t key = (int64_t)sample + mov_lazy_index_key_off(sc);
+    unsigned int lo = 0, hi = sc->keyframe_count - 1;
+
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        if (sc->keyframes[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Last sync sample at or before the sample. */
+static unsigned int mov_lazy_index_prev_keyframe(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int key_off = mov_lazy_index_key_off(sc);
+    unsigned int i;
+
+    if (sc->keyframe_absent)
+        return st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ? sample : 0;
+    if (!sc->keyframe_count)
+        return sample;
+    i = mov_lazy_index_find_stss(sc, sample);
+    if (sc->keyframes[i] - key_off > sample) {
+        if (!i)
+            return 0;
+        i--;
+    }
+    return sc->keyframes[i] - key_off;
+}
+
+/* First sync sample after the sample, sample_count if none. */
+static unsigned int mov_lazy_index_next_keyframe(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int key_off = mov_lazy_index_key_off(sc);
+    unsigned int i;
+
+    if (sc->keyframe_absent && st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+        return sc->sample_count;
+    if (sc->keyframe_absent || !sc->keyframe_count)
+        return sample + 1;
+    i = mov_lazy_index_find_stss(sc, sample + 1);
+    if (sc->keyframes[i] - key_off <= sample)
+        return sc->sample_count;
+    return sc->keyframes[i] - key_off;
+}
+
+/* Last sample with a dts at or before the timestamp. */
+static unsigned int mov_lazy_index_sample_at(MOVStreamContext *sc, int64_t timestamp)
+{
+    int64_t dts = sc->lazy_index.start_dts;
+    unsigned int sample = 0;
+    unsigned int i;
+
+    if (timestamp < dts)
+        return 0;
+    for (i = 0; i < sc->stts_count && sample < sc->sample_count; i++) {
+        unsigned int count    = sc->stts_data[i].count;
+        unsigned int duration = sc->stts_data[i].duration;
+
+        /* the last entry, or one stuck at zero samples, covers all the rest */
+        if (i + 1 == sc->stts_count || !count)
+            count = sc->sample_count - sample;
+        if (duration && timestamp < dts + (int64_t)count * duration) {
+            sample += (timestamp - dts) / duration;
+            break;
+        }
+        dts    += (int64_t)count * duration;
+        sample += count;
+        if (!sc->stts_data[i].count)
+            break;
+    }
+    return FFMIN(sample, sc->sample_count - 1);
+}
+
+/**
+ * Move the cursor to the given sample and empty the index, so that the
+ * next window starts there.
+ */
+static void mov_lazy_index_set_sample(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+    unsigned int left = sample;
+    unsigned int i;
+
+    st->nb_index_entries = 0;
+    li->first_sample = sample;
+    li->sample       = sample;
+
+    li->dts        = li->start_dts;
+    li->stts_index = 0;
+    while (li->stts_index + 1 < sc->stts_count && sc->stts_data[li->stts_index].count &&
+           left >= sc->stts_data[li->stts_index].count) {
+        left    -= sc->stts_data[li->stts_index].count;
+        li->dts += (int64_t)sc->stts_data[li->stts_index].count * sc->stts_data[li->stts_index].duration;
+        li->stts_index++;
+    }
+    li->dts        += (int64_t)left * sc->stts_data[li->stts_index].duration;
+    li->stts_sample = left;
+
+    li->chunk      = 0;
+    li->stsc_index = 0;
+    mov_lazy_index_enter_chunk(sc, li);
+    left = sample;
+    for (;;) {
+        unsigned int count = sc->stsc_data[li->stsc_index].count;
+        unsigned int end = mov_stsc_index_valid(li->stsc_index, sc->stsc_count) ?
+                           FFMIN(sc->stsc_data[li->stsc_index + 1].first - 1, sc->chunk_count) :
+                           sc->chunk_count;
+        unsigned int chunks = end > li->chunk ? end - li->chunk : 1;
+
+        if (count && left < (uint64_t)count * chunks) {
+            li->chunk += left / count;
+            left      %= count;
+            break;
+        }
+        left      -= count * chunks;
+        li->chunk += chunks;
+        if (li->chunk >= sc->chunk_count) {
+            li->sample = sc->sample_count;
+            return;
+        }
+        mov_lazy_index_enter_chunk(sc, li);
+    }
+    li->chunk_sample = left;
+    li->offset       = sc->chunk_offsets[li->chunk];
+    for (i = sample - left; i < sample; i++)
+        li->offset += sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[i];
+
+    li->distance = 0;
+    if (sc->keyframe_count) {
+        li->stss_index = mov_lazy_index_find_stss(sc, sample);
+        li->distance   = sample - mov_lazy_index_prev_keyframe(st, sample);
+    } else if (sc->keyframe_absent && st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+        li->distance = sample;
+    }
+}
+
+/**
+ * Append up to count samples from the cursor to st->index_entries, the
+ * same entries mov_build_index() would have created for them.
+ */
+static int mov_lazy_index_add(MOVContext *mov, AVStream *st, unsigned int count)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+    int key_off = mov_lazy_index_key_off(sc);
+    int ret;
+
+    count = FFMIN(count, sc->sample_count - li->sample);
+    if ((ret = mov_lazy_index_alloc(st, st->nb_index_entries + count)) < 0)
+        return ret;
+
+    while (count--) {
+        AVIndexEntry *e;
+        unsigned int sample_size;
+        int keyframe = 0;
+
+        while (li->chunk_sample >= sc->stsc_data[li->stsc_index].count) {
+            if (++li->chunk >= sc->chunk_count) {
+                li->sample = sc->sample_count;
+                return 0;
+            }
+            mov_lazy_index_enter_chunk(sc, li);
+        }
+
+        if (!sc->keyframe_absent) {
+            if (!sc->keyframe_count || li->sample + key_off == sc->keyframes[li->stss_index]) {
+                keyframe = 1;
+                if (li->stss_index + 1 < sc->keyframe_count)
+                    li->stss_index++;
+            }
+        } else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || !li->sample) {
+            keyframe = 1;
+        }
+        if (keyframe)
+            li->distance = 0;
+
+        sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[li->sample];
+        if (sample_size > 0x3FFFFFFF) {
+            av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+            li->sample = sc->sample_count;
+            return AVERROR_INVALIDDATA;
+        }
+        e = &st->index_entries[st->nb_index_entries++];
+        e->pos          = li->offset;
+        e->timestamp    = li->dts;
+        e->size         = sample_size;
+        e->min_distance = li->distance;
+        e->flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+        if (li->sample < li->discard_samples)
+            e->flags |= AVINDEX_DISCARD_FRAME;
+
+        li->offset += sample_size;
+        li->dts    += sc->stts_data[li->stts_index].duration;
+        li->distance++;
+        li->chunk_sample++;
+        li->sample++;
+        li->stts_sample++;
+        if (li->stts_index + 1 < sc->stts_count && li->stts_sample == sc->stts_data[li->stts_index].count) {
+            li->stts_sample = 0;
+            li->stts_index++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Slide the window past the samples already returned.
+ */
+static int mov_lazy_index_fill(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+    int drop = FFMIN(sc->current_sample, st->nb_index_entries);
+
+    if (drop > 0) {
+        memmove(st->index_entries, st->index_entries + drop,
+                (st->nb_index_entries - drop) * sizeof(*st->index_entries));
+        st->nb_index_entries -= drop;
+        li->first_sample     += drop;
+        sc->current_sample   -= drop;
+        sc->current_index    -= drop;
+    }
+    if (st->nb_index_entries >= li->window)
+        return 0;
+    return mov_lazy_index_add(mov, st, li->window - st->nb_index_entries);
+}
+
+/**
+ * Make the window hold the sample a seek to timestamp resolves to.
+ */
+static void mov_lazy_index_seek(MOVContext *mov, AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+    unsigned int target, start;
+
+    if (st->nb_index_entries && timestamp >= st->index_entries[0].timestamp &&
+        (timestamp <= st->index_entries[st->nb_index_entries - 1].timestamp ||
+         li->sample >= sc->sample_count) &&
+        av_index_search_timestamp(st, timestamp, flags) >= 0)
+        return;
+
+    target = mov_lazy_index_sample_at(sc, timestamp);
+    start  = flags & AVSEEK_FLAG_ANY ? target : mov_lazy_index_prev_keyframe(st, target);
+    mov_lazy_index_set_sample(st, start);
+    mov_lazy_index_add(mov, st, FFMAX(li->window, target - start + 2));
+
+    if (!(flags & AVSEEK_FLAG_BACKWARD) && av_index_search_timestamp(st, timestamp, flags) < 0) {
+        start = mov_lazy_index_next_keyframe(st, target);
+        if (start < sc->sample_count) {
+            mov_lazy_index_set_sample(st, start);
+            mov_lazy_index_add(mov, st, li->window);
+        }
+    }
+}
+
+/**
+ * Complete the index of a track, for when other samples get appended to
+ * it (fragments).
+ */
+static void mov_lazy_index_finish(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+
+    if (!li->window)
+        return;
+    mov_lazy_index_add(mov, st, sc->sample_count - li->sample);
+    li->window = 0;
+}
+
+/**
+ * Index the first window of a long track instead of all of its samples,
+ * if the lazy_index option is set and the track only uses the parts of
+ * the sample tables this cursor implements.
+ *
+ * @return 1 if the index is built lazily, 0 if not, a negative AVERROR
+ *         on failure
+ */
+static int mov_lazy_index_init(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = &sc->lazy_index;
+    unsigned int window = FFMAX(mov->lazy_index, MOV_LAZY_INDEX_MIN_WINDOW);
+    unsigned int discard_samples = 0;
+    uint64_t stream_size = 0;
+    unsigned int i;
+    int ret;
+
+    if (!mov->lazy_index || sc->sample_count <= window || !sc->chunk_count ||
+        !sc->stsc_count || !sc->stts_count || st->nb_index_entries ||
+        !mov->seek_individually || mov->decryption_key_len ||
+        sc->stps_count ||
+        (sc->rap_group_count && sc->rap_group) ||
+        (sc->stsz_sample_size <= 0 && !sc->sample_sizes))
+        return 0;
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].duration < 0)
+            return 0;
+    if (sc->pseudo_stream_id != -1)
+        for (i = 0; i < sc->stsc_count; i++)
+            if (sc->stsc_data[i].id - 1 != sc->pseudo_stream_id)
+                return 0;
+
+    /* mov_fix_index() rewrites the index for edit lists; only a single edit
+     * covering the whole media maps onto shifted timestamps. */
+    if (!mov->ignore_editlist && mov->advanced_editlist && sc->elst_count) {
+        const MOVElst *e = &sc->elst_data[0];
+        int64_t first_cts = sc->ctts_count ? sc->ctts_data[0].duration : 0;
+        unsigned int stts_index = 0, stts_sample = 0;
+        int64_t dts = 0;
+
+        if (sc->elst_count != 1 || e->time < 0 || sc->dts_shift || !mov->time_scale ||
+            e->time + av_rescale(e->duration + 1, sc->time_scale, mov->time_scale) <
+            st->duration + first_cts)
+            return 0;
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (e->time && (sc->ctts_count || st->codecpar->codec_id == AV_CODEC_ID_VORBIS ||
+                            e->time >= sc->time_scale))
+                return 0;
+            /* whole samples before the edit are decoded and discarded */
+            for (i = 0; dts < e->time; i++) {
+                if (i >= window)
+                    return 0;
+                dts += sc->stts_data[stts_index].duration;
+                stts_sample++;
+                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
+                    stts_sample = 0;
+                    stts_index++;
+                }
+            }
+            if (dts != e->time)
+                return 0;
+            discard_samples = i;
+        } else if (e->time != first_cts) {
+            return 0;
+        }
+        start_dts -= e->time;
+        st->duration = av_rescale(e->duration, sc->time_scale, mov->time_scale);
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            st->skip_samples = sc->start_pad = e->time;
+    }
+
+    memset(li, 0, sizeof(*li));
+    li->window          = window;
+    li->start_dts       = start_dts;
+    li->discard_samples = discard_samples;
+
+    if (sc->stsz_sample_size > 0 && sc->stsz_sample_size < sc->sample_size) {
+        av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+        sc->stsz_sample_size = sc->sample_size;
+    }
+    if (sc->sample_size > 0 && sc->sample_size < sc->stsz_sample_size) {
+        unsigned int stsc_index = 0;
+        for (i = 0; i + 1 < sc->chunk_count; i++) {
+            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+                   i + 1 == sc->stsc_data[stsc_index + 1].first)
+                stsc_index++;
+            if (sc->chunk_offsets[i + 1] > sc->chunk_offsets[i] &&
+                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size >
+                sc->chunk_offsets[i + 1] - sc->chunk_offsets[i]) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+                break;
+            }
+        }
+    }
+
+    if (sc->stsz_sample_size > 0) {
+        stream_size = (uint64_t)sc->stsz_sample_size * sc->sample_count;
+    } else {
+        for (i = 0; i < sc->sample_count; i++)
+            stream_size += sc->sample_sizes[i];
+    }
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size * 8 * sc->time_scale / st->duration;
+
+    mov_lazy_index_set_sample(st, 0);
+    if ((ret = mov_lazy_index_add(mov, st, window)) < 0) {
+        li->window = 0;
+        return ret;
+    }
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (i = 0; i + 1 < FFMIN(st->nb_index_entries, 100); i++)
+            ff_rfps_add_frame(mov->fc, st, st->index_entries[i].timestamp);
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: indexing %u samples lazily, %u at a time\n",
+           st->index, sc->sample_count, window);
+    return 1;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3373,6 +3806,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
+        if (mov_lazy_index_init(mov, st, current_dts))
+            return;
         if (av_reallocp_array(&st->index_entries,
                               st->nb_index_entries + sc->sample_count,
                               sizeof(*st->index_entries)) < 0) {
@@ -3804,11 +4239,21 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
+
+    /* The sync samples of H.264 and HEVC are their IDR and IRAP pictures,
+     * unless partial sync samples or random access groups add others. */
+    if ((st->codecpar->codec_id == AV_CODEC_ID_H264 || st->codecpar->codec_id == AV_CODEC_ID_HEVC) &&
+        sc->keyframe_count && !sc->keyframe_absent && !sc->stps_count &&
+        (!sc->rap_group_count || st->codecpar->codec_id == AV_CODEC_ID_HEVC))
+        st->internal->trusted_keyframes = 1;
+
+    /* Do not need those anymore, unless the index is still being built. */
+    if (!sc->lazy_index.window) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+    }
     av_freep(&sc->stps_data);
     av_freep(&sc->elst_data);
     av_freep(&sc->rap_group);
@@ -4219,6 +4664,19 @@ static int mov_read_tfdt(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     } else {
         sc->track_end = avio_rb32(pb);
     }
+    /* the decode time of the fragment wins over the time of its index entry,
+     * unless the mfra was asked for */
+    if (c->use_mfra_for <= 0)
+        frag->time = AV_NOPTS_VALUE;
+    return 0;
+}
+
+static int mov_read_mehd(MOVContext *c, AVIOContext *pb, MOVAtom atom)
+{
+    int version = avio_r8(pb);
+
+    avio_rb24(pb); /* flags */
+    c->fragment_duration = version ? avio_rb64(pb) : avio_rb32(pb);
     return 0;
 }
 
@@ -4247,6 +4705,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    mov_lazy_index_finish(c, st);
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -4429,7 +4888,7 @@ static int mov_read_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         }
         avio_rb32(pb); // sap_flags
         index->items[i].moof_offset = offset;
-        index->items[i].time = av_rescale_q(pts, st->time_base, timescale);
+        index->items[i].time = av_rescale_q(pts, timescale, st->time_base);
         offset += size;
         pts += duration;
     }
@@ -5320,6 +5779,7 @@ static const MOVParseTableEntry mov_default_parse_table[] = {
 { MKTAG('t','m','c','d'), mov_read_tmcd },
 { MKTAG('c','h','a','p'), mov_read_chap },
 { MKTAG('t','r','e','x'), mov_read_trex },
+{ MKTAG('m','e','h','d'), mov_read_mehd },
 { MKTAG('t','r','u','n'), mov_read_trun },
 { MKTAG('u','d','t','a'), mov_read_default },
 { MKTAG('w','a','v','e'), mov_read_wave },
@@ -5334,6 +5794,7 @@ static const MOVParseTableEntry mov_default_parse_table[] = {
 { MKTAG('d','v','c','1'), mov_read_dvc1 },
 { MKTAG('s','b','g','p'), mov_read_sbgp },
 { MKTAG('h','v','c','C'), mov_read_glbl },
+{ MKTAG('a','v','1','C'), mov_read_glbl },
 { MKTAG('u','u','i','d'), mov_read_uuid },
 { MKTAG('C','i','n', 0x8e), mov_read_targa_y216 },
 { MKTAG('f','r','e','e'), mov_read_free },
@@ -5894,6 +6355,32 @@ static int read_tfra(MOVContext *mov, AVIOContext *f)
     return 0;
 }
 
+/**
+ * Read the fragments as they are reached, like with a sidx covering the
+ * file: the mfra finds any of them again. The duration comes from the mehd,
+ * or from the last fragment the mfra knows of.
+ */
+static void mov_mfra_index_complete(MOVContext *c)
+{
+    int i, j;
+
+    for (i = 0; i < c->fc->nb_streams; i++) {
+        AVStream *st = c->fc->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        if (c->fragment_duration > 0 && c->time_scale > 0) {
+            st->duration = av_rescale(c->fragment_duration, sc->time_scale, c->time_scale);
+            continue;
+        }
+        for (j = 0; j < c->fragment_index_count; j++) {
+            MOVFragmentIndex *index = c->fragment_index_data[j];
+            if (index->track_id == st->id && index->item_count)
+                st->duration = FFMAX(st->duration, index->items[index->item_count - 1].time);
+        }
+    }
+    c->fragment_index_complete = 1;
+}
+
 static int mov_read_mfra(MOVContext *c, AVIOContext *f)
 {
     int64_t stream_size = avio_size(f);
@@ -5929,6 +6416,8 @@ static int mov_read_mfra(MOVContext *c, AVIOContext *f)
             goto fail;
     } while (!ret);
     ret = 0;
+    if (c->keep_fragments >= 0 && c->fragment_index_count && !c->fragment_index_complete)
+        mov_mfra_index_complete(c);
 fail:
     seek_ret = avio_seek(f, original_pos, SEEK_SET);
     if (seek_ret < 0) {
@@ -5939,6 +6428,122 @@ fail:
     return ret;
 }
 
+#define MOV_SPLIT_PROBES 15
+
+/**
+ * The median byte distance between samples of the anchor track and the
+ * samples of st of the same time, at MOV_SPLIT_PROBES points of the anchor.
+ */
+static int64_t mov_interleave_distance(AVStream *anchor, AVStream *st)
+{
+    int64_t distances[MOV_SPLIT_PROBES];
+    int i, j, n = 0;
+
+    for (i = 0; i < MOV_SPLIT_PROBES; i++) {
+        AVIndexEntry *e = &anchor->index_entries[(int64_t)anchor->nb_index_entries * i / MOV_SPLIT_PROBES];
+        int64_t ts = av_rescale_q(e->timestamp, anchor->time_base, st->time_base);
+        int64_t distance;
+        int index = av_index_search_timestamp(st, ts, AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
+
+        if (index < 0)
+            continue;
+        distance = FFABS(st->index_entries[index].pos - e->pos);
+        for (j = n++; j > 0 && distances[j - 1] > distance; j--)
+            distances[j] = distances[j - 1];
+        distances[j] = distance;
+    }
+
+    return n ? distances[n / 2] : 0;
+}
+
+/**
+ * Reading the samples of a badly interleaved file in time order alternates
+ * between places of the file further apart than any read-ahead, every jump
+ * a new request of a network input. The audio and video tracks whose
+ * samples lie more than split_distance away from the ones of the same time
+ * of the largest track are read through inputs of their own instead, each
+ * reading ahead sequentially from where its track is.
+ *
+ * @return the number of tracks to split
+ */
+static int mov_split_tracks(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    AVStream *anchor = NULL;
+    int i, nb_split = 0;
+
+    if (mov->split_distance <= 0 || mov->fragment_index_count || mov->next_root_atom ||
+        !(s->pb->seekable & AVIO_SEEKABLE_NORMAL) || (s->flags & AVFMT_FLAG_CUSTOM_IO) ||
+        !s->filename[0])
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        if (sc->pb == s->pb && st->nb_index_entries &&
+            (!anchor || sc->data_size > ((MOVStreamContext *)anchor->priv_data)->data_size))
+            anchor = st;
+    }
+    if (!anchor)
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+        int64_t distance;
+
+        if (st == anchor || sc->pb != s->pb || !st->nb_index_entries ||
+            (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO &&
+             st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO))
+            continue;
+
+        distance = mov_interleave_distance(anchor, st);
+        if (distance <= mov->split_distance)
+            continue;
+
+        av_log(s, AV_LOG_VERBOSE, "stream %d is %"PRId64" bytes away from stream %d, "
+               "read through an input of its own\n", st->index, distance, anchor->index);
+        sc->split_input = 1;
+        nb_split++;
+    }
+
+    return nb_split;
+}
+
+/**
+ * Open the input of a track split by mov_split_tracks(), with the options
+ * of the main one; the track stays on the main one on failure.
+ */
+static void mov_open_split_input(AVFormatContext *s, MOVStreamContext *sc)
+{
+    static const char *const opts[] = {
+        "headers", "http_proxy", "user_agent", "user-agent", "cookies", "http2", "http3",
+        "mirrors", "mirror_stall_timeout", "ijkapplication", NULL };
+    AVDictionary *options = NULL;
+    AVIOContext *pb = NULL;
+    uint8_t *buf;
+    int i, ret;
+
+    sc->split_input = 0;
+
+    for (i = 0; opts[i]; i++) {
+        if (av_opt_get(s->pb, opts[i], AV_OPT_SEARCH_CHILDREN, &buf) >= 0 && buf)
+            av_dict_set(&options, opts[i], buf, AV_DICT_DONT_STRDUP_VAL);
+    }
+
+    ret = s->io_open(s, &pb, s->filename, AVIO_FLAG_READ, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "stream %d: opening an input of its own failed: %s\n",
+               sc->ffindex, av_err2str(ret));
+        return;
+    }
+
+    sc->pb = pb;
+    sc->pb_is_copied = 0;
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -6122,7 +6727,9 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
-    ff_configure_buffers_for_index(s, AV_TIME_BASE);
+    /* the main input need not buffer the gaps of the tracks read apart */
+    if (!mov_split_tracks(s))
+        ff_configure_buffers_for_index(s, AV_TIME_BASE);
 
     return 0;
 }
@@ -6140,6 +6747,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
+        if (msc->lazy_index.window && msc->current_sample + 1 >= avst->nb_index_entries)
+            mov_lazy_index_fill(s->priv_data, avst);
         if (msc->pb && msc->current_sample < avst->nb_index_entries) {
             AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
@@ -6184,6 +6793,119 @@ static int should_retry(AVIOContext *pb, int error_code) {
     return 1;
 }
 
+/**
+ * Whether the samples of the fragments can be dropped from the index: only
+ * tracks of fragments alone, whose ctts entries are one per index entry.
+ */
+static int mov_fragments_droppable(AVFormatContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        if (sc->sample_count || sc->index_ranges ||
+            (sc->ctts_data && sc->ctts_count != (unsigned)st->nb_index_entries))
+            return 0;
+    }
+    return 1;
+}
+
+static void mov_drop_samples(AVStream *st, int count)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (count <= 0)
+        return;
+
+    memmove(st->index_entries, st->index_entries + count,
+            (st->nb_index_entries - count) * sizeof(*st->index_entries));
+    st->nb_index_entries -= count;
+    if (sc->ctts_data) {
+        memmove(sc->ctts_data, sc->ctts_data + count,
+                (sc->ctts_count - count) * sizeof(*sc->ctts_data));
+        sc->ctts_count -= count;
+        sc->ctts_index  = FFMAX(sc->ctts_index - count, 0);
+        sc->ctts_sample = 0;
+    }
+    mov_current_sample_set(sc, FFMAX(sc->current_sample - count, 0));
+}
+
+/**
+ * Drop the samples of the fragments more than keep_fragments behind the
+ * one at target, which is about to be read, and let them be read again if
+ * a seek goes back to them. Only whole fragments go, and none with samples
+ * not returned yet.
+ */
+static void mov_trim_fragments(AVFormatContext *s, int64_t target)
+{
+    MOVContext *mov = s->priv_data;
+    MOVFragmentIndex *index = NULL;
+    int64_t keep_pos;
+    int i, j, t = -1;
+
+    for (i = 0; i < mov->fragment_index_count && t < 0; i++) {
+        index = mov->fragment_index_data[i];
+        for (j = 0; j < index->item_count; j++) {
+            if (index->items[j].moof_offset == target) {
+                t = j;
+                break;
+            }
+        }
+    }
+    if (t < 0 || !mov_fragments_droppable(s))
+        return;
+
+    keep_pos = index->items[FFMAX(t - 1 - mov->keep_fragments, 0)].moof_offset;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+
+        if (sc->current_sample < st->nb_index_entries)
+            keep_pos = FFMIN(keep_pos, st->index_entries[sc->current_sample].pos);
+    }
+    /* back to the start of its fragment */
+    for (j = t; j > 0 && index->items[j].moof_offset > keep_pos; j--);
+    keep_pos = index->items[j].moof_offset;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        int count = 0;
+
+        while (count < st->nb_index_entries && st->index_entries[count].pos < keep_pos)
+            count++;
+        mov_drop_samples(st, count);
+    }
+
+    for (i = 0; i < mov->fragment_index_count; i++) {
+        index = mov->fragment_index_data[i];
+        for (j = 0; j < index->item_count && index->items[j].moof_offset < keep_pos; j++)
+            index->items[j].headers_read = 0;
+    }
+}
+
+/**
+ * Empty the index before a seek reads a fragment it does not hold, so that
+ * it is built again in order from there.
+ */
+static void mov_clear_fragments(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    int i, j;
+
+    if (!mov_fragments_droppable(s))
+        return;
+
+    for (i = 0; i < s->nb_streams; i++)
+        mov_drop_samples(s->streams[i], s->streams[i]->nb_index_entries);
+    for (i = 0; i < mov->fragment_index_count; i++) {
+        MOVFragmentIndex *index = mov->fragment_index_data[i];
+        for (j = 0; j < index->item_count; j++)
+            index->items[j].headers_read = 0;
+    }
+}
+
 static int mov_switch_root(AVFormatContext *s, int64_t target)
 {
     MOVContext *mov = s->priv_data;
@@ -6267,6 +6989,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     if (!sample || (mov->next_root_atom && sample->pos > mov->next_root_atom)) {
         if (!mov->next_root_atom)
             return AVERROR_EOF;
+        if (mov->keep_fragments >= 0 && mov->fragment_index_complete)
+            mov_trim_fragments(s, mov->next_root_atom);
         if ((ret = mov_switch_root(s, mov->next_root_atom)) < 0)
             return ret;
         goto retry;
@@ -6282,7 +7006,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (st->discard != AVDISCARD_ALL) {
-        int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
+        int64_t ret64;
+
+        if (sc->split_input)
+            mov_open_split_input(s, sc);
+
+        ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
         if (ret64 != sample->pos) {
             av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
                    sc->ffindex, sample->pos);
@@ -6392,7 +7121,7 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc = st->priv_data;
-    int i, j;
+    int i, j, k;
 
     if (!mov->fragment_index_complete)
         return 0;
@@ -6400,14 +7129,28 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
     for (i = 0; i < mov->fragment_index_count; i++) {
         if (mov->fragment_index_data[i]->track_id == st->id || !sc->has_sidx) {
             MOVFragmentIndex *index = mov->fragment_index_data[i];
-            for (j = index->item_count - 1; j >= 0; j--) {
-                if (index->items[j].time <= timestamp) {
-                    if (index->items[j].headers_read)
-                        return 0;
+            int64_t index_timestamp = timestamp;
 
-                    return mov_switch_root(s, index->items[j].moof_offset);
+            if (!index->item_count)
+                continue;
+            /* the index of another track counts in its own timescale */
+            for (k = 0; k < s->nb_streams; k++) {
+                if (s->streams[k]->id == index->track_id) {
+                    index_timestamp = av_rescale_q(timestamp, st->time_base,
+                                                   s->streams[k]->time_base);
+                    break;
                 }
             }
+            for (j = index->item_count - 1; j > 0; j--) {
+                if (index->items[j].time <= index_timestamp)
+                    break;
+            }
+            if (index->items[j].headers_read)
+                return 0;
+
+            if (mov->keep_fragments >= 0)
+                mov_clear_fragments(s);
+            return mov_switch_root(s, index->items[j].moof_offset);
         }
     }
 
@@ -6417,12 +7160,11 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
-    int sample, time_sample;
+    int sample, time_sample, current_sample;
     int i;
 
-    int ret = mov_seek_fragment(s, st, timestamp);
-    if (ret < 0)
-        return ret;
+    if (sc->lazy_index.window)
+        mov_lazy_index_seek(s->priv_data, st, timestamp, flags);
 
     sample = av_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
@@ -6432,14 +7174,16 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
         return AVERROR_INVALIDDATA;
     mov_current_sample_set(sc, sample);
     av_log(s, AV_LOG_TRACE, "stream %d, found sample %d\n", st->index, sc->current_sample);
+    /* sample number in the track, the index may only hold a window of it */
+    current_sample = sc->current_sample + sc->lazy_index.first_sample;
     /* adjust ctts index */
     if (sc->ctts_data) {
         time_sample = 0;
         for (i = 0; i < sc->ctts_count; i++) {
             int next = time_sample + sc->ctts_data[i].count;
-            if (next > sc->current_sample) {
+            if (next > current_sample) {
                 sc->ctts_index = i;
-                sc->ctts_sample = sc->current_sample - time_sample;
+                sc->ctts_sample = current_sample - time_sample;
                 break;
             }
             time_sample = next;
@@ -6450,9 +7194,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     time_sample = 0;
     for (i = 0; i < sc->stsc_count; i++) {
         int next = time_sample + mov_get_stsc_samples(sc, i);
-        if (next > sc->current_sample) {
+        if (next > current_sample) {
             sc->stsc_index = i;
-            sc->stsc_sample = sc->current_sample - time_sample;
+            sc->stsc_sample = current_sample - time_sample;
             break;
         }
         time_sample = next;
@@ -6466,12 +7210,17 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
     MOVContext *mc = s->priv_data;
     AVStream *st;
     int sample;
-    int i;
+    int i, ret;
 
     if (stream_index >= s->nb_streams)
         return AVERROR_INVALIDDATA;
 
     st = s->streams[stream_index];
+    /* the fragment first, the index may be built again from it */
+    ret = mov_seek_fragment(s, st, sample_time);
+    if (ret < 0)
+        return ret;
+
     sample = mov_seek_stream(s, st, sample_time, flags);
     if (sample < 0)
         return sample;
@@ -6556,6 +7305,12 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "lazy_index", "Index long tracks while demuxing, this many samples at a time (0 indexes them when opening)",
+        OFFSET(lazy_index), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX / 2, FLAGS },
+    { "split_interleave", "Read an audio or video track through an input of its own when its samples lie this many bytes away from the ones of the same time (0 never does)",
+        OFFSET(split_distance), AV_OPT_TYPE_INT64, {.i64 = 4 * 1024 * 1024}, 0, INT64_MAX, FLAGS },
+    { "keep_fragments", "Fragments kept indexed behind the one being read when a sidx or mfra finds the others again (-1 keeps all)",
+        OFFSET(keep_fragments), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX / 2, FLAGS },
 
     { NULL },
 };
@@ -58,6 +58,8 @@ static const AVOption avformat_options[] = {
 {"bitexact", "do not write random/volatile data", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_BITEXACT }, 0, 0, E, "fflags" },
 {"shortest", "stop muxing with the shortest stream", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_SHORTEST }, 0, 0, E, "fflags" },
 {"autobsf", "add needed bsfs automatically (delays header until each stream's first packet is written)", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_AUTO_BSF }, 0, 0, E, "fflags" },
+{"fastopen", "take codec parameters from the container headers when they are complete, instead of decoding", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_FAST_OPEN }, INT_MIN, INT_MAX, D, "fflags" },
+{"trustkeyframes", "take the keyframes of the container as the IDR pictures, and parse the headers only when they change", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_TRUST_KEYFRAMES }, INT_MIN, INT_MAX, D, "fflags" },
 {"analyzeduration", "specify how many microseconds are analyzed to probe the input", OFFSET(max_analyze_duration), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, INT64_MAX, D},
 {"cryptokey", "decryption key", OFFSET(key), AV_OPT_TYPE_BINARY, {.dbl = 0}, 0, 0, D},
 {"indexmem", "max memory used for timestamp index (per stream)", OFFSET(max_index_size), AV_OPT_TYPE_INT, {.i64 = 1<<20 }, 0, INT_MAX, D},
@@ -108,6 +110,8 @@ static const AVOption avformat_options[] = {
 {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, D },
 {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, D },
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
+{"probe_cache", "keep stream analysis results in the disk cache and reuse them on reopening", OFFSET(probe_cache), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+{"probe_cache_key", "key of the probe cache entry instead of the url", OFFSET(probe_cache_key), AV_OPT_TYPE_STRING, { .str = NULL }, CHAR_MIN, CHAR_MAX, D },
 {NULL},
 };
 
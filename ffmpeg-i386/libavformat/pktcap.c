@@ -0,0 +1,421 @@
+/*
+ * Capture of demuxed packets, for decoder replay
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Writer of packet captures and the pktcap demuxer replaying them, see
+ * pktcap.h for the format.
+ */
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "pktcap.h"
+
+#define PKTCAP_MAGIC        "PKTCAP"
+#define PKTCAP_MAX_STREAMS  1024
+#define PKTCAP_MAX_SIDE     1024
+
+/* the 32-bit fields of the codec parameters, in the order of the file */
+#define PKTCAP_CODECPAR_FIELDS(F)                                           \
+    F(codec_type) F(codec_id) F(codec_tag) F(format)                        \
+    F(bits_per_coded_sample) F(bits_per_raw_sample) F(profile) F(level)     \
+    F(width) F(height) F(field_order) F(color_range) F(color_primaries)     \
+    F(color_trc) F(color_space) F(chroma_location) F(video_delay)           \
+    F(channels) F(sample_rate) F(block_align) F(frame_size)                 \
+    F(initial_padding) F(trailing_padding) F(seek_preroll)
+
+struct AVPacketCapture {
+    AVIOContext *pb;
+    int          nb_streams;
+};
+
+static void write_side_data(AVIOContext *pb, int type, const uint8_t *data, int size)
+{
+    avio_wb32(pb, type);
+    avio_wb32(pb, size);
+    avio_write(pb, data, size);
+}
+
+static void write_stream(AVIOContext *pb, const AVStream *st)
+{
+    const AVCodecParameters *par = st->codecpar;
+    AVDictionaryEntry *tag = NULL;
+    int i;
+
+    avio_wb32(pb, st->id);
+    avio_wb32(pb, st->disposition);
+    avio_wb32(pb, st->time_base.num);
+    avio_wb32(pb, st->time_base.den);
+    avio_wb32(pb, st->avg_frame_rate.num);
+    avio_wb32(pb, st->avg_frame_rate.den);
+    avio_wb32(pb, st->r_frame_rate.num);
+    avio_wb32(pb, st->r_frame_rate.den);
+
+#define WRITE_FIELD(name) avio_wb32(pb, par->name);
+    PKTCAP_CODECPAR_FIELDS(WRITE_FIELD)
+#undef WRITE_FIELD
+    avio_wb64(pb, par->bit_rate);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->sample_aspect_ratio.num);
+    avio_wb32(pb, par->sample_aspect_ratio.den);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+
+    avio_wb32(pb, av_dict_count(st->metadata));
+    while ((tag = av_dict_get(st->metadata, "", tag, AV_DICT_IGNORE_SUFFIX))) {
+        avio_put_str(pb, tag->key);
+        avio_put_str(pb, tag->value);
+    }
+
+    avio_wb32(pb, st->nb_side_data);
+    for (i = 0; i < st->nb_side_data; i++)
+        write_side_data(pb, st->side_data[i].type, st->side_data[i].data, st->side_data[i].size);
+}
+
+int av_packet_capture_open(AVPacketCapture **ppc, const char *path, const AVFormatContext *ic)
+{
+    AVPacketCapture *pc;
+    int i, ret;
+
+    *ppc = NULL;
+    if (!ic->nb_streams || ic->nb_streams > PKTCAP_MAX_STREAMS)
+        return AVERROR(EINVAL);
+
+    pc = av_mallocz(sizeof(*pc));
+    if (!pc)
+        return AVERROR(ENOMEM);
+    pc->nb_streams = ic->nb_streams;
+
+    ret = avio_open(&pc->pb, path, AVIO_FLAG_WRITE);
+    if (ret < 0) {
+        av_free(pc);
+        return ret;
+    }
+
+    avio_write(pc->pb, (const uint8_t *)PKTCAP_MAGIC, 6);
+    avio_wb16(pc->pb, AV_PKTCAP_VERSION);
+    avio_wb32(pc->pb, ic->nb_streams);
+    for (i = 0; i < ic->nb_streams; i++)
+        write_stream(pc->pb, ic->streams[i]);
+    avio_flush(pc->pb);
+
+    if (pc->pb->error < 0) {
+        ret = pc->pb->error;
+        av_packet_capture_close(&pc);
+        return ret;
+    }
+
+    *ppc = pc;
+    return 0;
+}
+
+int av_packet_capture_write(AVPacketCapture *pc, const AVPacket *pkt, int64_t time)
+{
+    AVIOContext *pb = pc->pb;
+    int i;
+
+    if (pkt->stream_index < 0 || pkt->stream_index >= pc->nb_streams ||
+        pkt->side_data_elems > PKTCAP_MAX_SIDE)
+        return AVERROR(EINVAL);
+
+    avio_wb32(pb, pkt->size);
+    avio_wb16(pb, pkt->stream_index);
+    avio_wb16(pb, pkt->flags);
+    avio_wb64(pb, pkt->pts);
+    avio_wb64(pb, pkt->dts);
+    avio_wb64(pb, pkt->duration);
+    avio_wb64(pb, time);
+    avio_wb16(pb, pkt->side_data_elems);
+    avio_write(pb, pkt->data, pkt->size);
+    for (i = 0; i < pkt->side_data_elems; i++)
+        write_side_data(pb, pkt->side_data[i].type, pkt->side_data[i].data, pkt->side_data[i].size);
+
+    return pb->error;
+}
+
+int av_packet_capture_close(AVPacketCapture **ppc)
+{
+    AVPacketCapture *pc = *ppc;
+    int ret;
+
+    if (!pc)
+        return 0;
+
+    avio_flush(pc->pb);
+    ret = pc->pb->error;
+    avio_closep(&pc->pb);
+    av_freep(ppc);
+    return ret;
+}
+
+#if CONFIG_PKTCAP_DEMUXER
+
+enum PacketCapturePace {
+    PACE_NONE,
+    PACE_DTS,
+    PACE_CAPTURE,
+};
+
+/* a jump of the replay time past this restarts the clock, e.g. at a
+ * discontinuity of the timestamps */
+#define PKTCAP_MAX_JUMP     (10 * AV_TIME_BASE)
+#define PKTCAP_WAIT_STEP    10000
+
+typedef struct PacketCaptureContext {
+    const AVClass *class;
+    int     pace;
+    int64_t start;  ///< av_gettime_relative() at replay time 0, AV_NOPTS_VALUE before the first packet
+    int64_t last;   ///< latest replay time waited for
+} PacketCaptureContext;
+
+static int pktcap_probe(AVProbeData *p)
+{
+    if (p->buf_size < 8 || memcmp(p->buf, PKTCAP_MAGIC, 6) || AV_RB16(p->buf + 6) != AV_PKTCAP_VERSION)
+        return 0;
+    return AVPROBE_SCORE_MAX;
+}
+
+static int read_side_data_header(AVIOContext *pb, int *type, int *size)
+{
+    *type = avio_rb32(pb);
+    *size = avio_rb32(pb);
+    if (avio_feof(pb))
+        return AVERROR_EOF;
+    return *size < 0 ? AVERROR_INVALIDDATA : 0;
+}
+
+static int read_stream(AVFormatContext *s, AVStream *st)
+{
+    AVIOContext *pb = s->pb;
+    AVCodecParameters *par = st->codecpar;
+    AVRational time_base;
+    unsigned count;
+    int i, ret, size, type;
+
+    st->id                   = avio_rb32(pb);
+    st->disposition          = avio_rb32(pb);
+    time_base.num            = avio_rb32(pb);
+    time_base.den            = avio_rb32(pb);
+    st->avg_frame_rate.num   = avio_rb32(pb);
+    st->avg_frame_rate.den   = avio_rb32(pb);
+    st->r_frame_rate.num     = avio_rb32(pb);
+    st->r_frame_rate.den     = avio_rb32(pb);
+    if (time_base.num <= 0 || time_base.den <= 0)
+        return AVERROR_INVALIDDATA;
+    avpriv_set_pts_info(st, 64, time_base.num, time_base.den);
+
+#define READ_FIELD(name) par->name = avio_rb32(pb);
+    PKTCAP_CODECPAR_FIELDS(READ_FIELD)
+#undef READ_FIELD
+    par->bit_rate                = avio_rb64(pb);
+    par->channel_layout          = avio_rb64(pb);
+    par->sample_aspect_ratio.num = avio_rb32(pb);
+    par->sample_aspect_ratio.den = avio_rb32(pb);
+
+    size = avio_rb32(pb);
+    if (size < 0)
+        return AVERROR_INVALIDDATA;
+    if (size) {
+        if ((ret = ff_get_extradata(s, par, pb, size)) < 0)
+            return ret;
+    }
+
+    count = avio_rb32(pb);
+    for (i = 0; i < count && !avio_feof(pb); i++) {
+        char key[256], value[1024];
+
+        avio_get_str(pb, INT_MAX, key, sizeof(key));
+        avio_get_str(pb, INT_MAX, value, sizeof(value));
+        av_dict_set(&st->metadata, key, value, 0);
+    }
+
+    count = avio_rb32(pb);
+    if (count > PKTCAP_MAX_SIDE)
+        return AVERROR_INVALIDDATA;
+    for (i = 0; i < count; i++) {
+        uint8_t *data;
+
+        if ((ret = read_side_data_header(pb, &type, &size)) < 0)
+            return ret;
+        data = av_stream_new_side_data(st, type, size);
+        if (!data)
+            return AVERROR(ENOMEM);
+        if ((ret = ffio_read_size(pb, data, size)) < 0)
+            return ret;
+    }
+
+    return avio_feof(pb) ? AVERROR_EOF : 0;
+}
+
+static int pktcap_read_header(AVFormatContext *s)
+{
+    PacketCaptureContext *c = s->priv_data;
+    unsigned nb_streams;
+    int i, ret;
+
+    avio_skip(s->pb, 8);
+    nb_streams = avio_rb32(s->pb);
+    if (!nb_streams || nb_streams > PKTCAP_MAX_STREAMS)
+        return AVERROR_INVALIDDATA;
+
+    for (i = 0; i < nb_streams; i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+        if (!st)
+            return AVERROR(ENOMEM);
+        if ((ret = read_stream(s, st)) < 0) {
+            av_log(s, AV_LOG_ERROR, "Invalid stream %d\n", i);
+            return ret;
+        }
+    }
+
+    c->start = AV_NOPTS_VALUE;
+    return 0;
+}
+
+/* wait for the replay time t of a packet */
+static int pktcap_pace(AVFormatContext *s, int64_t t)
+{
+    PacketCaptureContext *c = s->priv_data;
+    int64_t wait;
+
+    if (t == AV_NOPTS_VALUE)
+        return 0;
+
+    if (c->start == AV_NOPTS_VALUE || FFABS(t - c->last) > PKTCAP_MAX_JUMP) {
+        c->start = av_gettime_relative() - t;
+        c->last  = t;
+    }
+    c->last = FFMAX(c->last, t);
+
+    while ((wait = c->start + t - av_gettime_relative()) > 0) {
+        if (ff_check_interrupt(&s->interrupt_callback))
+            return AVERROR_EXIT;
+        av_usleep(FFMIN(wait, PKTCAP_WAIT_STEP));
+    }
+    return 0;
+}
+
+static int pktcap_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    PacketCaptureContext *c = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t pos = avio_tell(pb);
+    int64_t pts, dts, duration, time;
+    int i, ret, size, stream_index, flags, nb_side_data, type;
+
+    size         = avio_rb32(pb);
+    stream_index = avio_rb16(pb);
+    flags        = avio_rb16(pb);
+    pts          = avio_rb64(pb);
+    dts          = avio_rb64(pb);
+    duration     = avio_rb64(pb);
+    time         = avio_rb64(pb);
+    nb_side_data = avio_rb16(pb);
+    /* a capture cut short ends at its last complete packet */
+    if (avio_feof(pb))
+        return AVERROR_EOF;
+    if (size < 0 || stream_index >= s->nb_streams)
+        return AVERROR_INVALIDDATA;
+
+    ret = av_get_packet(pb, pkt, size);
+    if (ret < 0)
+        return ret;
+    if (ret < size)
+        goto truncated;
+
+    for (i = 0; i < nb_side_data; i++) {
+        uint8_t *data;
+
+        if ((ret = read_side_data_header(pb, &type, &size)) < 0)
+            goto fail;
+        data = av_packet_new_side_data(pkt, type, size);
+        if (!data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if (avio_read(pb, data, size) < size)
+            goto truncated;
+    }
+
+    pkt->stream_index = stream_index;
+    pkt->flags        = flags;
+    pkt->pts          = pts;
+    pkt->dts          = dts;
+    pkt->duration     = duration;
+    pkt->pos          = pos;
+
+    switch (c->pace) {
+    case PACE_DTS:
+        if (dts != AV_NOPTS_VALUE || pts != AV_NOPTS_VALUE)
+            ret = pktcap_pace(s, av_rescale_q(dts != AV_NOPTS_VALUE ? dts : pts,
+                                              s->streams[stream_index]->time_base, AV_TIME_BASE_Q));
+        break;
+    case PACE_CAPTURE:
+        ret = pktcap_pace(s, time);
+        break;
+    default:
+        ret = 0;
+        break;
+    }
+    if (ret < 0)
+        goto fail;
+
+    return 0;
+truncated:
+    ret = AVERROR_EOF;
+fail:
+    av_packet_unref(pkt);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(PacketCaptureContext, x)
+#define DEC AV_OPT_FLAG_DECODING_PARAM
+static const AVOption pktcap_options[] = {
+    { "pace", "when to return the packets", OFFSET(pace), AV_OPT_TYPE_INT, { .i64 = PACE_NONE }, PACE_NONE, PACE_CAPTURE, DEC, "pace" },
+        { "none",    "as fast as they are read",             0, AV_OPT_TYPE_CONST, { .i64 = PACE_NONE },    0, 0, DEC, "pace" },
+        { "dts",     "in real time by their timestamps",     0, AV_OPT_TYPE_CONST, { .i64 = PACE_DTS },     0, 0, DEC, "pace" },
+        { "capture", "at the times they were captured",      0, AV_OPT_TYPE_CONST, { .i64 = PACE_CAPTURE }, 0, 0, DEC, "pace" },
+    { NULL },
+};
+
+static const AVClass pktcap_class = {
+    .class_name = "pktcap demuxer",
+    .item_name  = av_default_item_name,
+    .option     = pktcap_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVInputFormat ff_pktcap_demuxer = {
+    .name           = "pktcap",
+    .long_name      = NULL_IF_CONFIG_SMALL("Packet capture"),
+    .priv_data_size = sizeof(PacketCaptureContext),
+    .read_probe     = pktcap_probe,
+    .read_header    = pktcap_read_header,
+    .read_packet    = pktcap_read_packet,
+    .flags          = AVFMT_GENERIC_INDEX,
+    .extensions     = "pktcap",
+    .priv_class     = &pktcap_class,
+};
+
+#endif /* CONFIG_PKTCAP_DEMUXER */
@@ -25,7 +25,10 @@
 #include "libavutil/time.h"
 #include "libavutil/application.h"
 
+#include "dns_cache.h"
+#include "throughput.h"
 #include "internal.h"
+#include "net_trace.h"
 #include "network.h"
 #include "os_support.h"
 #include "url.h"
@@ -52,8 +55,19 @@ typedef struct TCPContext {
     int dns_cache;
     int64_t dns_cache_timeout;
     int dns_cache_clear;
+    int dns_cache_negative_timeout;
+    int happy_eyeballs;
+    int happy_eyeballs_delay;
+    int io_traffic_interval;
+    /* of the open, in microseconds, read by the http protocol */
+    int64_t dns_time;
+    int64_t connect_time;
 
     AVApplicationContext *app_ctx;
+    /* bytes read and not reported yet */
+    int64_t traffic_bytes;
+    int64_t traffic_time;
+    NetTraceConnection net_trace;
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -67,12 +81,18 @@ static const AVOption options[] = {
     { "send_buffer_size", "Socket send buffer size (in bytes)",                OFFSET(send_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "recv_buffer_size", "Socket receive buffer size (in bytes)",             OFFSET(recv_buffer_size), AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
     { "ijkapplication",   "AVApplicationContext",                              OFFSET(app_ctx_intptr),   AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, .flags = D },
+    { "io_traffic_interval", "report the bytes read at most this often (in microseconds), 0 for every read", OFFSET(io_traffic_interval), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, .flags = D },
 
     { "addrinfo_one_by_one",  "parse addrinfo one by one in getaddrinfo()",    OFFSET(addrinfo_one_by_one), AV_OPT_TYPE_INT, { .i64 = 0 },         0, 1, .flags = D|E },
     { "addrinfo_timeout", "set timeout (in microseconds) for getaddrinfo()",   OFFSET(addrinfo_timeout), AV_OPT_TYPE_INT, { .i64 = -1 },       -1, INT_MAX, .flags = D|E },
     { "dns_cache", "enable dns cache",   OFFSET(dns_cache), AV_OPT_TYPE_INT, { .i64 = 0 },       0, INT_MAX, .flags = D|E },
     { "dns_cache_timeout", "dns cache TTL (in microseconds)",   OFFSET(dns_cache_timeout), AV_OPT_TYPE_INT, { .i64 = -1 },       -1, INT64_MAX, .flags = D|E },
     { "dns_cache_clear", "clear dns cache",   OFFSET(dns_cache_clear), AV_OPT_TYPE_INT, { .i64 = 0},       -1, INT_MAX, .flags = D|E },
+    { "happy_eyeballs", "race connection attempts across addresses (RFC 8305)",   OFFSET(happy_eyeballs), AV_OPT_TYPE_INT, { .i64 = 1 },       0, 1, .flags = D|E },
+    { "happy_eyeballs_delay", "delay before the next connection attempt (in milliseconds)",   OFFSET(happy_eyeballs_delay), AV_OPT_TYPE_INT, { .i64 = 250 },       10, INT_MAX, .flags = D|E },
+    { "dns_cache_negative_timeout", "dns cache TTL of failed lookups (in milliseconds)",   OFFSET(dns_cache_negative_timeout), AV_OPT_TYPE_INT, { .i64 = 10000 },       0, INT_MAX, .flags = D|E },
+    { "dns_time",     "time the open spent resolving the host (in microseconds)",    OFFSET(dns_time),     AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "connect_time", "time the open spent connecting, once resolved (in microseconds)", OFFSET(connect_time), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { NULL }
 };
 
@@ -83,11 +103,6 @@ static const AVClass tcp_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
-static AVDictionary *dns_dictionary;
-static pthread_mutex_t dns_dictionary_mutex;
-static pthread_once_t key_once = PTHREAD_ONCE_INIT;
-static int init_mutex_ret = -1;
-
 int ijk_tcp_getaddrinfo_nonblock(const char *hostname, const char *servname,
                                  const struct addrinfo *hints, struct addrinfo **res,
                                  int64_t timeout,
@@ -112,12 +127,6 @@ typedef struct TCPAddrinfoRequest
     int              last_error;
 } TCPAddrinfoRequest;
 
-typedef struct DnsCacheInfo
-{
-    int64_t dns_cache_time;
-    struct addrinfo *res;  // construct by private function, not support ai_next and ai_canonname, can only be released using free_private_addrinfo
-} DnsCacheInfo;
-
 static void tcp_getaddrinfo_request_free(TCPAddrinfoRequest *req)
 {
     av_assert0(req);
@@ -342,119 +351,55 @@ int ijk_tcp_getaddrinfo_nonblock(const char *hostname, const char *servname,
 }
 #endif
 
-static void free_private_addrinfo(struct addrinfo **p_ai) {
-    struct addrinfo *ai = *p_ai;
+static void tcp_report_dns_statistic(TCPContext *s, const char *hostname, int cache_result,
+                                     int error, int64_t start_time)
+{
+    AVAppDnsStatistic stat = {0};
+    DnsCacheStatistic total;
 
-    if (ai) {
-        if (ai->ai_addr) {
-            av_freep(&ai->ai_addr);
-        }
-        av_freep(p_ai);
-    }
-}
+    if (!s->app_ctx)
+        return;
 
-static int get_dns_cache(URLContext *h, char *hostname, struct addrinfo **p_ai) {
-    TCPContext *s = h->priv_data;
-    AVDictionaryEntry *elem = NULL;
-    DnsCacheInfo *dns_cache_info = NULL;
-    struct addrinfo *ai = NULL;
-    int64_t cur_time = av_gettime();
-
-    if (cur_time < 0 || hostname[0] == 0) {
-        return 0;
-    }
-
-    pthread_mutex_lock(&dns_dictionary_mutex);
-    elem = av_dict_get(dns_dictionary, hostname, NULL, AV_DICT_MATCH_CASE);
-    if (elem) {
-        dns_cache_info = (DnsCacheInfo *) (intptr_t) strtoll(elem->value, NULL, 10);
-        if (dns_cache_info != NULL) {
-            if (s->dns_cache_clear) {
-                av_dict_set_int(&dns_dictionary, hostname, 0, 0);
-                free_private_addrinfo(&dns_cache_info->res);
-                av_freep(&dns_cache_info);
-                goto fail;
-            }
+    av_dns_cache_get_statistic(&total);
+
+    stat.size          = sizeof(stat);
+    av_strlcpy(stat.hostname, hostname, sizeof(stat.hostname));
+    stat.cache_result  = cache_result;
+    stat.error         = error;
+    stat.elapsed_milli = (av_gettime_relative() - start_time) / 1000;
+    stat.hits          = total.hits;
+    stat.negative_hits = total.negative_hits;
+    stat.misses        = total.misses;
+    av_application_on_dns_statistic(s->app_ctx, &stat);
+}
 
-            if (s->dns_cache_timeout < 0 || (dns_cache_info->dns_cache_time + s->dns_cache_timeout * 1000) > cur_time) {
-                if (dns_cache_info->res && dns_cache_info->res->ai_addr) {
-                    ai = (struct addrinfo *) av_mallocz(sizeof(struct addrinfo));
-                    if (!ai) {
-                        goto fail;
-                    }
-                    memcpy(ai, dns_cache_info->res, sizeof(struct addrinfo));
-                    ai->ai_addr = (struct sockaddr *) av_mallocz(sizeof(struct sockaddr));
-                    if (!ai->ai_addr) {
-                        av_freep(&ai);
-                        goto fail;
-                    }
-                    memcpy(ai->ai_addr, dns_cache_info->res->ai_addr, sizeof(struct sockaddr));
-                    ai->ai_canonname = NULL;
-                    ai->ai_next = NULL;
-                    *p_ai = ai;
-                    av_log(NULL, AV_LOG_INFO, "Hit DNS cache hostname = %s\n", hostname);
-                } else {
-                    av_dict_set_int(&dns_dictionary, hostname, 0, 0);
-                    av_freep(&dns_cache_info);
-                    goto fail;
-                }
-                pthread_mutex_unlock(&dns_dictionary_mutex);
-                return 1;
-            } else {
-                av_dict_set_int(&dns_dictionary, hostname, 0, 0);
-                free_private_addrinfo(&dns_cache_info->res);
-                av_freep(&dns_cache_info);
-            }
+static void tcp_fix_ipv6_port(struct addrinfo *ai, int port)
+{
+#if HAVE_STRUCT_SOCKADDR_IN6
+    // workaround for IOS9 getaddrinfo in IPv6 only network use hardcode IPv4 address can not resolve port number.
+    if (ai->ai_family == AF_INET6){
+        struct sockaddr_in6 * sockaddr_v6 = (struct sockaddr_in6 *)ai->ai_addr;
+        if (!sockaddr_v6->sin6_port){
+            sockaddr_v6->sin6_port = htons(port);
         }
     }
-fail:
-    pthread_mutex_unlock(&dns_dictionary_mutex);
-    return 0;
+#endif
 }
 
-static void set_dns_cache(char *hostname, struct addrinfo *cur_ai) {
-    DnsCacheInfo *new_dns_cache_info;
-    int64_t cur_time = av_gettime();
-
-    if (cur_time < 0 || hostname[0] == 0) {
-        return;
-    }
-
-    if (cur_ai == NULL || cur_ai->ai_addr == NULL) {
-        return;
-    }
-
-    new_dns_cache_info = (DnsCacheInfo *) av_mallocz(sizeof(struct DnsCacheInfo));
-    if (!new_dns_cache_info) {
-        return;
-    }
+static void tcp_customize_fd(void *ctx, int fd)
+{
+    TCPContext *s = ctx;
 
-    new_dns_cache_info->res = (struct addrinfo *) av_mallocz(sizeof(struct addrinfo));
-    if (!new_dns_cache_info->res) {
-        av_freep(&new_dns_cache_info);
-        return;
+    /* Set the socket's send or receive buffer sizes, if specified.
+       If unspecified or setting fails, system default is used. */
+    if (s->recv_buffer_size > 0) {
+        /* on Darwin this also turns off the auto tuning of the buffer */
+        if (setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size)))
+            av_log(s, AV_LOG_WARNING, "setsockopt(SO_RCVBUF, %d) failed\n", s->recv_buffer_size);
     }
-
-    memcpy(new_dns_cache_info->res, cur_ai, sizeof(struct addrinfo));
-
-    new_dns_cache_info->res->ai_addr = (struct sockaddr *) av_mallocz(sizeof(struct sockaddr));
-    if (!new_dns_cache_info->res->ai_addr) {
-        av_freep(&new_dns_cache_info->res);
-        av_freep(&new_dns_cache_info);
-        return;
+    if (s->send_buffer_size > 0) {
+        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
     }
-
-    memcpy(new_dns_cache_info->res->ai_addr, cur_ai->ai_addr, sizeof(struct sockaddr));
-    new_dns_cache_info->res->ai_canonname = NULL;
-    new_dns_cache_info->res->ai_next = NULL;
-    new_dns_cache_info->dns_cache_time = cur_time;
-    pthread_mutex_lock(&dns_dictionary_mutex);
-    av_dict_set_int(&dns_dictionary, hostname, (int64_t) (intptr_t) new_dns_cache_info, 0);
-    pthread_mutex_unlock(&dns_dictionary_mutex);
-}
-
-static void private_mutex_init(void){
-    init_mutex_ret = pthread_mutex_init(&dns_dictionary_mutex, NULL);
 }
 
 /* return non zero if error */
@@ -468,17 +413,11 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     int ret;
     char hostname[1024],proto[1024],path[1024];
     char portstr[10];
-    char hostname_bak[1024];
     AVAppTcpIOControl control = {0};
-    int hit_dns_cache = 0;
-    AVDictionaryEntry *elem = NULL;
-    DnsCacheInfo *dns_cache_info = NULL;
-    if (s->dns_cache && init_mutex_ret) {
-        pthread_once(&key_once, private_mutex_init);
-        if (init_mutex_ret) {
-            s->dns_cache = 0;
-        }
-    }
+    int use_dns_cache = 0;
+    int dns_cache_result = DNS_CACHE_MISS;
+    int64_t dns_start_time;
+    int64_t connect_start_time = 0;
 
     if (s->open_timeout < 0) {
         s->open_timeout = 15000000;
@@ -523,12 +462,21 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     if (s->listen)
         hints.ai_flags |= AI_PASSIVE;
 
-    if (s->dns_cache) {
-        memcpy(hostname_bak, hostname, 1024);
-        hit_dns_cache = get_dns_cache(h, hostname, &ai);
-    }
-
-    if (!hit_dns_cache) {
+    // passive sockets bind to the local address, nothing worth caching
+    use_dns_cache  = s->dns_cache && !s->listen && hostname[0];
+    dns_start_time = av_gettime_relative();
+    ret = 0;
+    av_application_on_net_stage(s->app_ctx, AVAPP_EVENT_WILL_DNS_RESOLVE, h, hostname, 0);
+    if (use_dns_cache) {
+        if (s->dns_cache_clear)
+            ff_dns_cache_remove(hostname, port);
+        dns_cache_result = ff_dns_cache_lookup(hostname, port,
+                                               s->dns_cache_timeout < 0 ? -1 : s->dns_cache_timeout * 1000,
+                                               (int64_t)s->dns_cache_negative_timeout * 1000,
+                                               &ai, &ret);
+    }
+
+    if (dns_cache_result == DNS_CACHE_MISS) {
 #ifdef HAVE_PTHREADS
         ret = ijk_tcp_getaddrinfo_nonblock(hostname, portstr, &hints, &ai, s->addrinfo_timeout, &h->interrupt_callback, s->addrinfo_one_by_one);
 #else
@@ -540,26 +488,57 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
             ret = getaddrinfo(hostname, portstr, &hints, &ai);
 #endif
 
-        if (ret) {
-            av_log(h, AV_LOG_ERROR,
-                "Failed to resolve hostname %s: %s\n",
-                hostname, gai_strerror(ret));
-            return AVERROR(EIO);
-        }
+        // only remember answers from the resolver, not timeouts or interrupts
+        if (use_dns_cache && (!ret || ret == EAI_NONAME || ret == EAI_FAIL))
+            ff_dns_cache_store(hostname, port, ai, ret);
+    }
+
+    av_application_on_net_stage(s->app_ctx, AVAPP_EVENT_DID_DNS_RESOLVE, h, hostname, ret);
+    s->dns_time = av_gettime_relative() - dns_start_time;
+    if (use_dns_cache)
+        tcp_report_dns_statistic(s, hostname, dns_cache_result, ret, dns_start_time);
+
+    if (ret) {
+        av_log(h, AV_LOG_ERROR,
+            "Failed to resolve hostname %s: %s%s\n",
+            hostname, gai_strerror(ret),
+            dns_cache_result == DNS_CACHE_NEGATIVE ? " (dns cache)" : "");
+        return AVERROR(EIO);
     }
 
     cur_ai = ai;
 
- restart:
-#if HAVE_STRUCT_SOCKADDR_IN6
-    // workaround for IOS9 getaddrinfo in IPv6 only network use hardcode IPv4 address can not resolve port number.
-    if (cur_ai->ai_family == AF_INET6){
-        struct sockaddr_in6 * sockaddr_v6 = (struct sockaddr_in6 *)cur_ai->ai_addr;
-        if (!sockaddr_v6->sin6_port){
-            sockaddr_v6->sin6_port = htons(port);
+    if (!s->listen && s->happy_eyeballs && ai->ai_next) {
+        for (cur_ai = ai; cur_ai; cur_ai = cur_ai->ai_next)
+            tcp_fix_ipv6_port(cur_ai, port);
+        cur_ai = ai;
+
+        ret = av_application_on_tcp_will_open(s->app_ctx);
+        if (ret) {
+            av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_WILL_TCP_OPEN");
+            goto fail1;
         }
+
+        connect_start_time = av_gettime_relative();
+        ret = ff_connect_parallel(ai, s->open_timeout / 1000, s->happy_eyeballs_delay,
+                                  h, &fd, &cur_ai, tcp_customize_fd, s);
+        control.elapsed_milli = (av_gettime_relative() - connect_start_time) / 1000;
+        if (ret < 0) {
+            /* every attempt failed, told as the single address path does */
+            av_application_on_tcp_did_open(s->app_ctx, ret, fd, &control);
+            goto fail1;
+        }
+
+        ret = av_application_on_tcp_did_open(s->app_ctx, 0, fd, &control);
+        if (ret) {
+            av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
+            goto fail1;
+        }
+        goto connected;
     }
-#endif
+
+ restart:
+    tcp_fix_ipv6_port(cur_ai, port);
 
     fd = ff_socket(cur_ai->ai_family,
                    cur_ai->ai_socktype,
@@ -569,14 +548,7 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         goto fail;
     }
 
-    /* Set the socket's send or receive buffer sizes, if specified.
-       If unspecified or setting fails, system default is used. */
-    if (s->recv_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size));
-    }
-    if (s->send_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
-    }
+    tcp_customize_fd(s, fd);
 
     if (s->listen == 2) {
         // multi-client
@@ -596,8 +568,11 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
             goto fail1;
         }
 
-        if ((ret = ff_listen_connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
-                                     s->open_timeout / 1000, h, !!cur_ai->ai_next)) < 0) {
+        connect_start_time = av_gettime_relative();
+        ret = ff_listen_connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
+                                s->open_timeout / 1000, h, !!cur_ai->ai_next);
+        control.elapsed_milli = (av_gettime_relative() - connect_start_time) / 1000;
+        if (ret < 0) {
             if (av_application_on_tcp_did_open(s->app_ctx, ret, fd, &control))
                 goto fail1;
             if (ret == AVERROR_EXIT)
@@ -609,21 +584,26 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
             if (ret) {
                 av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
                 goto fail1;
-            } else if (s->dns_cache && !hit_dns_cache && strcmp(control.ip, hostname_bak) && hostname_bak[0] != 0) {
-                set_dns_cache(hostname_bak, cur_ai);
-                av_log(NULL, AV_LOG_INFO, "Add dns cache hostname = %s, ip = %s\n", hostname_bak , control.ip);
             }
         }
     }
 
+connected:
+    if (!s->listen) {
+        s->connect_time = av_gettime_relative() - dns_start_time - s->dns_time;
+        ret = ff_net_trace_did_connect(h, &s->net_trace, connect_start_time);
+        if (ret < 0)
+            goto fail1;
+        ff_throughput_add_rtt(uri, av_gettime_relative() - connect_start_time);
+    }
+
     h->is_streamed = 1;
     s->fd = fd;
 
-    if (!s->dns_cache || !hit_dns_cache) {
+    if (dns_cache_result == DNS_CACHE_HIT)
+        ff_dns_cache_freeaddrinfo(&ai);
+    else
         freeaddrinfo(ai);
-    } else {
-        free_private_addrinfo(&ai);
-    }
     return 0;
 
  fail:
@@ -638,23 +618,17 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
  fail1:
     if (fd >= 0)
         closesocket(fd);
-    if (s->dns_cache && hit_dns_cache) {
-        av_log(NULL, AV_LOG_ERROR, "Hit dns cache but connect fail hostname = %s, ip = %s\n", hostname , control.ip);
-        pthread_mutex_lock(&dns_dictionary_mutex);
-        elem = av_dict_get(dns_dictionary, hostname_bak, NULL, AV_DICT_MATCH_CASE);
-        if (elem) {
-            dns_cache_info = (DnsCacheInfo *) (intptr_t) strtoll(elem->value, NULL, 10);
-            if (dns_cache_info != NULL) {
-                av_dict_set_int(&dns_dictionary, hostname_bak, 0, 0);
-                free_private_addrinfo(&dns_cache_info->res);
-                av_freep(&dns_cache_info);
-            }
-        }
-        pthread_mutex_unlock(&dns_dictionary_mutex);
-        free_private_addrinfo(&ai);
-    } else {
+    if (use_dns_cache) {
+        // the cached addresses may be stale, resolve again next time
+        if (ret != AVERROR_EXIT)
+            ff_dns_cache_remove(hostname, port);
+        if (dns_cache_result == DNS_CACHE_HIT)
+            av_log(NULL, AV_LOG_ERROR, "Hit dns cache but connect fail hostname = %s, ip = %s\n", hostname , control.ip);
+    }
+    if (dns_cache_result == DNS_CACHE_HIT)
+        ff_dns_cache_freeaddrinfo(&ai);
+    else
         freeaddrinfo(ai);
-    }
     return ret;
 }
 
@@ -674,20 +648,49 @@ static int tcp_accept(URLContext *s, URLContext **c)
     return 0;
 }
 
+/* one traffic event per interval instead of one per recv() */
+static void tcp_report_traffic(URLContext *h, int bytes, int flush)
+{
+    TCPContext *s = h->priv_data;
+    int64_t now;
+
+    s->traffic_bytes += bytes;
+    if (s->traffic_bytes <= 0)
+        return;
+    if (!flush && s->io_traffic_interval > 0) {
+        now = av_gettime_relative();
+        if (now - s->traffic_time < s->io_traffic_interval)
+            return;
+        s->traffic_time = now;
+    }
+    av_application_did_io_tcp_read(s->app_ctx, (void*)h, (int)FFMIN(s->traffic_bytes, INT_MAX));
+    s->traffic_bytes = 0;
+}
+
 static int tcp_read(URLContext *h, uint8_t *buf, int size)
 {
     TCPContext *s = h->priv_data;
     int ret;
 
+    // capped to what a replayed network trace lets through
+    size = ff_net_trace_will_read(h, &s->net_trace, size);
+    if (size < 0)
+        return size;
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd_timeout(s->fd, 0, h->rw_timeout, &h->interrupt_callback);
-        if (ret)
+        if (ret) {
+            ff_net_trace_did_read(&s->net_trace, size, ret);
             return ret;
+        }
     }
     ret = recv(s->fd, buf, size, 0);
+    if (ret < 0)
+        ret = ff_neterrno();
+    ff_net_trace_did_read(&s->net_trace, size, ret);
     if (ret > 0)
-        av_application_did_io_tcp_read(s->app_ctx, (void*)h, ret);
-    return ret < 0 ? ff_neterrno() : ret;
+        tcp_report_traffic(h, ret, 0);
+    return ret;
 }
 
 static int tcp_write(URLContext *h, const uint8_t *buf, int size)
@@ -723,6 +726,7 @@ static int tcp_shutdown(URLContext *h, int flags)
 static int tcp_close(URLContext *h)
 {
     TCPContext *s = h->priv_data;
+    tcp_report_traffic(h, 0, 1);
     closesocket(s->fd);
     return 0;
 }
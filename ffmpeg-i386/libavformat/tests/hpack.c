@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavformat/hpack.h"
+
+static int print_header(void *opaque, const char *name, const char *value)
+{
+    printf("  %s: %s\n", name, value);
+    return 0;
+}
+
+static void test_decode(HPACKDecoder *d, const char *title, const uint8_t *buf, int size)
+{
+    int ret = ff_hpack_decode(d, buf, size, print_header, NULL);
+    printf("%s: %s, %d entries, size %d\n", title, ret < 0 ? "failed" : "ok",
+           d->nb_entries, d->size);
+}
+
+/* RFC 7541 C.4, requests with Huffman coding */
+static const uint8_t request1[] = {
+    0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b,
+    0xa0, 0xab, 0x90, 0xf4, 0xff,
+};
+static const uint8_t request2[] = {
+    0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf,
+};
+static const uint8_t request3[] = {
+    0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9,
+    0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf,
+};
+
+/* RFC 7541 C.6, responses with Huffman coding and evictions */
+static const uint8_t response1[] = {
+    0x48, 0x82, 0x64, 0x02, 0x58, 0x85, 0xae, 0xc3, 0x77, 0x1a, 0x4b, 0x61,
+    0x96, 0xd0, 0x7a, 0xbe, 0x94, 0x10, 0x54, 0xd4, 0x44, 0xa8, 0x20, 0x05,
+    0x95, 0x04, 0x0b, 0x81, 0x66, 0xe0, 0x82, 0xa6, 0x2d, 0x1b, 0xff, 0x6e,
+    0x91, 0x9d, 0x29, 0xad, 0x17, 0x18, 0x63, 0xc7, 0x8f, 0x0b, 0x97, 0xc8,
+    0xe9, 0xae, 0x82, 0xae, 0x43, 0xd3,
+};
+static const uint8_t response2[] = {
+    0x48, 0x83, 0x64, 0x0e, 0xff, 0xc1, 0xc0, 0xbf,
+};
+static const uint8_t response3[] = {
+    0x88, 0xc1, 0x61, 0x96, 0xd0, 0x7a, 0xbe, 0x94, 0x10, 0x54, 0xd4, 0x44,
+    0xa8, 0x20, 0x05, 0x95, 0x04, 0x0b, 0x81, 0x66, 0xe0, 0x84, 0xa6, 0x2d,
+    0x1b, 0xff, 0xc0, 0x5a, 0x83, 0x9b, 0xd9, 0xab, 0x77, 0xad, 0x94, 0xe7,
+    0x82, 0x1d, 0xd7, 0xf2, 0xe6, 0xc7, 0xb3, 0x35, 0xdf, 0xdf, 0xcd, 0x5b,
+    0x39, 0x60, 0xd5, 0xaf, 0x27, 0x08, 0x7f, 0x36, 0x72, 0xc1, 0xab, 0x27,
+    0x0f, 0xb5, 0x29, 0x1f, 0x95, 0x87, 0x31, 0x60, 0x65, 0xc0, 0x03, 0xed,
+    0x4e, 0xe5, 0xb1, 0x06, 0x3d, 0x50, 0x07,
+};
+
+/* an index past the tables, and a padding which is not a prefix of EOS */
+static const uint8_t bad_index[]   = { 0xbe };
+static const uint8_t bad_padding[] = { 0x04, 0x81, 0x00 };
+
+int main(void)
+{
+    static const char *fields[][2] = {
+        { ":method",   "GET" },
+        { ":scheme",   "https" },
+        { ":path",     "/live/seg-1024.ts?token=abc" },
+        { ":authority", "cdn.example.com" },
+        { "range",     "bytes=0-" },
+        { "x-priority", "audio" },
+    };
+    HPACKDecoder d;
+    uint8_t buf[256];
+    int i, size = 0;
+
+    ff_hpack_decoder_init(&d);
+    test_decode(&d, "request 1", request1, sizeof(request1));
+    test_decode(&d, "request 2", request2, sizeof(request2));
+    test_decode(&d, "request 3", request3, sizeof(request3));
+    ff_hpack_decoder_uninit(&d);
+
+    ff_hpack_decoder_init(&d);
+    d.max_size = 256;
+    test_decode(&d, "response 1", response1, sizeof(response1));
+    test_decode(&d, "response 2", response2, sizeof(response2));
+    test_decode(&d, "response 3", response3, sizeof(response3));
+    ff_hpack_decoder_uninit(&d);
+
+    ff_hpack_decoder_init(&d);
+    test_decode(&d, "bad index", bad_index, sizeof(bad_index));
+    test_decode(&d, "bad padding", bad_padding, sizeof(bad_padding));
+
+    for (i = 0; i < FF_ARRAY_ELEMS(fields); i++) {
+        int ret = ff_hpack_encode(buf + size, sizeof(buf) - size, fields[i][0], fields[i][1]);
+        if (ret < 0)
+            return 1;
+        size += ret;
+    }
+    test_decode(&d, "encoded", buf, size);
+    printf("too small: %s\n",
+           ff_hpack_encode(buf, 8, "user-agent", "ijkplayer") < 0 ? "refused" : "written");
+    ff_hpack_decoder_uninit(&d);
+
+    return 0;
+}
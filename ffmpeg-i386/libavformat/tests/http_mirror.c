@@ -0,0 +1,57 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/mem.h"
+#include "libavformat/http_mirror.h"
+
+static const char url[]     = "https://a.example.com/live/seg-7.ts?token=1";
+static const char mirrors[] = "https://b.example.com/|ftp://c.example.com|https://a.example.com"
+                              "|http://d.example.com:8080/other";
+
+static void rank(const char *title)
+{
+    char *urls[MIRROR_MAX_CANDIDATES];
+    int   nb = ff_http_mirror_rank(url, mirrors, urls), i;
+
+    printf("%s:\n", title);
+    for (i = 0; i < nb; i++) {
+        printf("  %s\n", urls[i]);
+        av_free(urls[i]);
+    }
+}
+
+int main(void)
+{
+    char *urls[MIRROR_MAX_CANDIDATES];
+
+    printf("not http: %d\n", ff_http_mirror_rank("file:/tmp/seg.ts", mirrors, urls));
+    rank("unmeasured, in the order given");
+
+    ff_http_mirror_report("https://a.example.com/x", 500000, 0);
+    ff_http_mirror_report("https://b.example.com/y", 100000, 0);
+    rank("the unmeasured one first, then the fastest");
+
+    ff_http_mirror_report("http://d.example.com:8080/z", 0, AVERROR(ETIMEDOUT));
+    rank("a failure last");
+
+    ff_http_mirror_report("https://b.example.com/y", 1300000, 0);
+    rank("slower on average");
+    return 0;
+}
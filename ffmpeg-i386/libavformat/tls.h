@@ -41,6 +41,10 @@ typedef struct TLSShared {
     int numerichost;
 
     URLContext *tcp;
+
+    /* of the underlying tcp open, see the tcp protocol */
+    int64_t dns_time;
+    int64_t connect_time;
 } TLSShared;
 
 #define TLS_OPTFL (AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM)
@@ -51,7 +55,9 @@ typedef struct TLSShared {
     {"cert_file",  "Certificate file",                    offsetof(pstruct, options_field . cert_file), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"key_file",   "Private key file",                    offsetof(pstruct, options_field . key_file),  AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"listen",     "Listen for incoming connections",     offsetof(pstruct, options_field . listen),    AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }, \
-    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }
+    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"dns_time",     "time the open spent resolving the host (in microseconds)", offsetof(pstruct, options_field . dns_time),     AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }, \
+    {"connect_time", "time the open spent connecting, once resolved (in microseconds)", offsetof(pstruct, options_field . connect_time), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
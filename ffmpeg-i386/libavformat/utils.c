@@ -49,6 +49,9 @@
 #if CONFIG_NETWORK
 #include "network.h"
 #endif
+#if CONFIG_CACHE_PROTOCOL
+#include "probe_cache.h"
+#endif
 #include "riff.h"
 #include "url.h"
 
@@ -1522,6 +1525,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
     while (!got_packet && !s->internal->parse_queue) {
         AVStream *st;
         AVPacket cur_pkt;
+        int skip_parser = 0;
 
         /* read next packet */
         ret = ff_read_packet(s, &cur_pkt);
@@ -1569,6 +1573,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
             st->internal->need_context_update = 0;
+            st->internal->headers_parsed = 0;
         }
 
         if (cur_pkt.pts != AV_NOPTS_VALUE &&
@@ -1605,9 +1610,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 st->parser->flags |= PARSER_FLAG_USE_CODEC_TS;
         }
 
-        if (!st->need_parsing || !st->parser) {
+        /* The container's keyframes are trusted: the headers parser only
+         * runs up to a keyframe after a change of the codec parameters. */
+        if (st->parser && st->need_parsing == AVSTREAM_PARSE_HEADERS &&
+            st->internal->trusted_keyframes && (s->flags & AVFMT_FLAG_TRUST_KEYFRAMES)) {
+            if (av_packet_get_side_data(&cur_pkt, AV_PKT_DATA_NEW_EXTRADATA, NULL))
+                st->internal->headers_parsed = 0;
+            skip_parser = st->internal->headers_parsed;
+            if (!skip_parser && (cur_pkt.flags & AV_PKT_FLAG_KEY))
+                st->internal->headers_parsed = 1;
+        }
+
+        if (!st->need_parsing || !st->parser || skip_parser) {
             /* no parsing needed: we just output the packet as is */
             *pkt = cur_pkt;
+            if (skip_parser)
+                pkt->flags |= AV_PKT_FLAG_KEY_EXACT;
             compute_pkt_fields(s, st, NULL, pkt, AV_NOPTS_VALUE, AV_NOPTS_VALUE);
             if ((s->iformat->flags & AVFMT_GENERIC_INDEX) &&
                 (pkt->flags & AV_PKT_FLAG_KEY) && pkt->dts != AV_NOPTS_VALUE) {
@@ -2947,6 +2965,57 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
+/* Whether the container headers and the parsers gave enough to open a
+ * decoder for st, without decoding a frame: the sample or pixel format is
+ * left to the decoder. Fills in the picture size found by the parser. */
+static int has_container_parameters(AVStream *st)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    AVCodecParserContext *pc = st->parser;
+
+    if (avctx->codec_id == AV_CODEC_ID_NONE)
+        return avctx->codec_type == AVMEDIA_TYPE_DATA;
+
+    switch (avctx->codec_type) {
+    case AVMEDIA_TYPE_AUDIO:
+        if (!avctx->sample_rate || !avctx->channels)
+            return 0;
+        if (!avctx->frame_size && determinable_frame_size(avctx))
+            return 0;
+        /* raw AAC needs its AudioSpecificConfig, ADTS repeats it in every
+         * frame and is only parsed when the demuxer asked for it */
+        if (avctx->codec_id == AV_CODEC_ID_AAC && !avctx->extradata_size &&
+            !(st->need_parsing && pc && st->codec_info_nb_frames))
+            return 0;
+        if (avctx->codec_id == AV_CODEC_ID_DTS)
+            return 0;
+        break;
+    case AVMEDIA_TYPE_VIDEO:
+        if ((!avctx->width || !avctx->height) && pc && pc->width > 0 && pc->height > 0) {
+            avctx->width        = pc->width;
+            avctx->height       = pc->height;
+            avctx->coded_width  = pc->coded_width;
+            avctx->coded_height = pc->coded_height;
+            if (avctx->pix_fmt == AV_PIX_FMT_NONE && pc->format >= 0)
+                avctx->pix_fmt = pc->format;
+        }
+        if (!avctx->width || !avctx->height)
+            return 0;
+        if ((avctx->codec_id == AV_CODEC_ID_H264 || avctx->codec_id == AV_CODEC_ID_HEVC) &&
+            !avctx->extradata_size)
+            return 0;
+        if (avctx->codec_id == AV_CODEC_ID_RV30 || avctx->codec_id == AV_CODEC_ID_RV40)
+            return 0;
+        break;
+    case AVMEDIA_TYPE_SUBTITLE:
+        if (avctx->codec_id == AV_CODEC_ID_HDMV_PGS_SUBTITLE && !avctx->width)
+            return 0;
+        break;
+    }
+
+    return 1;
+}
+
 /* returns 1 or 0 if or if not decoded data was returned, or a negative error */
 static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
                             AVDictionary **options)
@@ -3380,6 +3449,49 @@ void ff_rfps_calculate(AVFormatContext *ic)
     }
 }
 
+/* Estimate the media the regular probing would still have read, at the
+ * point where fast open found every stream complete: up to the analysis
+ * limit while the format has no header (mpegts keeps looking for programs
+ * when asked to scan all PMTs), else the frames the frame rate analysis of
+ * a video stream is missing. Decoding time is not counted. */
+static int64_t fast_open_skipped(AVFormatContext *ic, int64_t limit)
+{
+    int64_t analyzed = 0, skipped = 0;
+    int64_t scan_all_pmts = 0;
+    int i;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        if (st->time_base.den > 0)
+            analyzed = FFMAX(analyzed, av_rescale_q(st->info->codec_info_duration,
+                                                    st->time_base, AV_TIME_BASE_Q));
+    }
+    av_opt_get_int(ic, "scan_all_pmts", AV_OPT_SEARCH_CHILDREN, &scan_all_pmts);
+    if ((ic->ctx_flags & AVFMTCTX_NOHEADER) || scan_all_pmts > 0)
+        return FFMAX(limit - analyzed, 0);
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        int frames = av_q2d(st->time_base) > 0.0005 ? 40 : 20;
+        int64_t frame_duration;
+
+        if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ||
+            (st->r_frame_rate.num && st->avg_frame_rate.num) ||
+            !tb_unreliable(st->internal->avctx) || ic->fps_probe_size >= 0 ||
+            st->info->duration_count >= frames)
+            continue;
+        if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+            frame_duration = av_rescale_q(1, av_inv_q(st->avg_frame_rate), AV_TIME_BASE_Q);
+        else if (st->codec_info_nb_frames > 1 && st->info->codec_info_duration > 0)
+            frame_duration = av_rescale_q(st->info->codec_info_duration, st->time_base, AV_TIME_BASE_Q) /
+                             (st->codec_info_nb_frames - 1);
+        else
+            continue;
+        skipped = FFMAX(skipped, (frames - st->info->duration_count) * frame_duration);
+    }
+    return FFMIN(skipped, FFMAX(limit - analyzed, 0));
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3397,8 +3509,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    int fast_open = !!(ic->flags & AVFMT_FLAG_FAST_OPEN);
+    int cache_hit = 0;
 
     flush_codecs = probesize > 0;
+    ic->fast_open_skipped = 0;
 
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
@@ -3418,6 +3533,15 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         av_log(ic, AV_LOG_DEBUG, "Before avformat_find_stream_info() pos: %"PRId64" bytes read:%"PRId64" seeks:%d nb_streams:%d\n",
                avio_tell(ic->pb), ic->pb->bytes_read, ic->pb->seek_count, ic->nb_streams);
 
+#if CONFIG_CACHE_PROTOCOL
+    /* Parameters stored when this media was last opened complete what the
+     * header gives, so they are taken as if the container had them. */
+    if (ic->probe_cache && ff_probe_cache_apply(ic)) {
+        cache_hit = 1;
+        fast_open = 1;
+    }
+#endif
+
     for (i = 0; i < ic->nb_streams; i++) {
         const AVCodec *codec;
         AVDictionary *thread_opt = NULL;
@@ -3485,7 +3609,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         // Try to just open decoders, in case this is enough to get parameters.
-        if (!has_codec_parameters(st, NULL) && st->request_probe <= 0) {
+        if (!has_codec_parameters(st, NULL) && st->request_probe <= 0 &&
+            !(fast_open && has_container_parameters(st))) {
             if (codec && !avctx->codec)
                 if (avcodec_open2(avctx, codec, options ? &options[i] : &thread_opt) < 0)
                     av_log(ic, AV_LOG_WARNING,
@@ -3517,7 +3642,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             int fps_analyze_framecount = 20;
 
             st = ic->streams[i];
-            if (!has_codec_parameters(st, NULL))
+            if (fast_open ? !has_container_parameters(st) : !has_codec_parameters(st, NULL))
                 break;
 
             if (ic->metadata) {
@@ -3538,7 +3663,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
              * the correct fps. */
             if (av_q2d(st->time_base) > 0.0005)
                 fps_analyze_framecount *= 2;
-            if (!tb_unreliable(st->internal->avctx))
+            if (!tb_unreliable(st->internal->avctx) || fast_open)
                 fps_analyze_framecount = 0;
             if (ic->fps_probe_size >= 0)
                 fps_analyze_framecount = ic->fps_probe_size;
@@ -3568,12 +3693,19 @@ FF_ENABLE_DEPRECATION_WARNINGS
         if (i == ic->nb_streams) {
             analyzed_all_streams = 1;
             /* NOTE: If the format has no header, then we need to read some
-             * packets to get most of the streams, so we cannot stop here. */
-            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+             * packets to get most of the streams, so we cannot stop here.
+             * Unless it told which streams are missing and none is, or the
+             * probe cache told which streams there are. */
+            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) || (fast_open && missing_streams) || cache_hit) {
                 /* If we found the info for all the codecs, we can stop. */
                 ret = count;
                 av_log(ic, AV_LOG_DEBUG, "All info found\n");
                 flush_codecs = 0;
+                if (fast_open) {
+                    ic->fast_open_skipped = fast_open_skipped(ic, max_analyze_duration);
+                    av_log(ic, AV_LOG_VERBOSE, "Fast open: parameters from the container after %d packets, "
+                           "%"PRId64" ms of analysis skipped\n", count, ic->fast_open_skipped / 1000);
+                }
                 break;
             }
         }
@@ -3726,8 +3858,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (!fast_open || !has_container_parameters(st))
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3741,7 +3874,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
             st = ic->streams[stream_index];
             avctx = st->internal->avctx;
-            if (!has_codec_parameters(st, NULL)) {
+            if (!has_codec_parameters(st, NULL) && !(fast_open && has_container_parameters(st))) {
                 const AVCodec *codec = find_probe_decoder(ic, st, st->codecpar->codec_id);
                 if (codec && !avctx->codec) {
                     AVDictionary *opts = NULL;
@@ -3837,6 +3970,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
                               best_fps, 12 * 1001, INT_MAX);
             }
 
+            /* no frame rate analysis was done, trust the container */
+            if (fast_open && !st->r_frame_rate.num &&
+                st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+                st->r_frame_rate = st->avg_frame_rate;
             if (!st->r_frame_rate.num) {
                 if (    avctx->time_base.den * (int64_t) st->time_base.num
                     <= avctx->time_base.num * avctx->ticks_per_frame * (int64_t) st->time_base.den) {
@@ -3898,7 +4035,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (ret < 0)
                 goto find_stream_info_err;
         }
-        if (!has_codec_parameters(st, &errmsg)) {
+        if (!has_codec_parameters(st, &errmsg) && !(fast_open && has_container_parameters(st))) {
             char buf[256];
             avcodec_string(buf, sizeof(buf), st->internal->avctx, 0);
             av_log(ic, AV_LOG_WARNING,
@@ -3968,6 +4105,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+#if CONFIG_CACHE_PROTOCOL
+    if (ret >= 0 && ic->probe_cache && !cache_hit)
+        ff_probe_cache_store(ic);
+#endif
+
 find_stream_info_err:
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
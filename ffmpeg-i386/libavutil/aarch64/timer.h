@@ -24,7 +24,25 @@
 #include <stdint.h>
 #include "config.h"
 
-#if HAVE_INLINE_ASM
+#if defined(__APPLE__)
+
+#include <mach/mach_time.h>
+
+/* The cycle counter traps in iOS apps; report nanoseconds instead. */
+#define AV_READ_TIME read_time
+#define FF_TIMER_UNITS "decinanoseconds"
+
+static inline uint64_t read_time(void)
+{
+    static mach_timebase_info_data_t timebase;
+
+    if (!timebase.denom)
+        mach_timebase_info(&timebase);
+
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+#elif HAVE_INLINE_ASM
 
 #define AV_READ_TIME read_time
 
@@ -39,6 +57,6 @@ static inline uint64_t read_time(void)
     return cycle_counter;
 }
 
-#endif /* HAVE_INLINE_ASM */
+#endif /* __APPLE__ */
 
 #endif /* AVUTIL_AARCH64_TIMER_H */
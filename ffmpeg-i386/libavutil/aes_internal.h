@@ -40,4 +40,10 @@ typedef struct AVAES {
     void (*crypt)(struct AVAES *a, uint8_t *dst, const uint8_t *src, int count, uint8_t *iv, int rounds);
 } AVAES;
 
+/**
+ * Replaces a->crypt with an implementation for the CPU, if any; the round
+ * keys are left as av_aes_init() laid them out.
+ */
+void ff_init_aes_aarch64(AVAES *a, int decrypt);
+
 #endif /* AVUTIL_AES_INTERNAL_H */
@@ -156,7 +156,16 @@ int av_application_on_tcp_did_open(AVApplicationContext *h, int error, int fd, A
     int       so_family;
     char      *so_ip_name = control->ip;
 
-    if (!h || !h->func_on_app_event || fd <= 0)
+    if (!h || !h->func_on_app_event)
+        return 0;
+
+    // a failed open has no peer, it is told without an address
+    if (error) {
+        control->error = error;
+        control->fd = fd;
+        return h->func_on_app_event(h, AVAPP_CTRL_DID_TCP_OPEN, (void *)control, sizeof(AVAppTcpIOControl));
+    }
+    if (fd <= 0)
         return 0;
 
     ret = getpeername(fd, (struct sockaddr *)&so_stg, &so_len);
@@ -200,6 +209,84 @@ void av_application_on_async_read_speed(AVApplicationContext *h, AVAppAsyncReadS
         h->func_on_app_event(h, AVAPP_EVENT_ASYNC_READ_SPEED, (void *)speed, sizeof(AVAppAsyncReadSpeed));
 }
 
+int  av_application_on_async_read_ahead(AVApplicationContext *h, AVAppAsyncReadAhead *control)
+{
+    if (h && h->func_on_app_event)
+        return h->func_on_app_event(h, AVAPP_CTRL_ASYNC_READ_AHEAD, (void *)control, sizeof(AVAppAsyncReadAhead));
+    return 0;
+}
+
+void av_application_on_dns_statistic(AVApplicationContext *h, AVAppDnsStatistic *statistic)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_DNS_STATISTIC, (void *)statistic, sizeof(AVAppDnsStatistic));
+}
+
+void av_application_on_http_pool_statistic(AVApplicationContext *h, AVAppHttpPoolStatistic *statistic)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_HTTP_POOL_STATISTIC, (void *)statistic, sizeof(AVAppHttpPoolStatistic));
+}
+
+void av_application_on_tls_statistic(AVApplicationContext *h, AVAppTlsStatistic *statistic)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_TLS_STATISTIC, (void *)statistic, sizeof(AVAppTlsStatistic));
+}
+
+int  av_application_on_buffer_level(AVApplicationContext *h, AVAppBufferLevel *control)
+{
+    if (h && h->func_on_app_event)
+        return h->func_on_app_event(h, AVAPP_CTRL_HLS_BUFFER_LEVEL, (void *)control, sizeof(AVAppBufferLevel));
+    return 0;
+}
+
+int  av_application_on_hls_key(AVApplicationContext *h, AVAppHLSKey *control)
+{
+    if (h && h->func_on_app_event)
+        return h->func_on_app_event(h, AVAPP_CTRL_HLS_KEY, (void *)control, sizeof(AVAppHLSKey));
+    return 0;
+}
+
+void av_application_on_variant_switch(AVApplicationContext *h, AVAppVariantSwitch *event)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_HLS_VARIANT_SWITCH, (void *)event, sizeof(AVAppVariantSwitch));
+}
+
+void av_application_on_net_stage(AVApplicationContext *h, int event_type, void *obj, const char *host, int error)
+{
+    AVAppNetStage event = {0};
+
+    if (!h || !h->func_on_app_event)
+        return;
+
+    event.size  = sizeof(event);
+    event.obj   = obj;
+    event.error = error;
+    if (host)
+        av_strlcpy(event.host, host, sizeof(event.host));
+    h->func_on_app_event(h, event_type, (void *)&event, sizeof(AVAppNetStage));
+}
+
+void av_application_on_http3_statistic(AVApplicationContext *h, AVAppHttp3Statistic *statistic)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_HTTP3_STATISTIC, (void *)statistic, sizeof(AVAppHttp3Statistic));
+}
+
+void av_application_on_http_mirror(AVApplicationContext *h, AVAppHttpMirror *event)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_HTTP_MIRROR, (void *)event, sizeof(AVAppHttpMirror));
+}
+
+void av_application_on_http_request(AVApplicationContext *h, AVAppHttpRequest *event)
+{
+    if (h && h->func_on_app_event)
+        h->func_on_app_event(h, AVAPP_EVENT_HTTP_REQUEST, (void *)event, sizeof(AVAppHttpRequest));
+}
+
 void av_application_did_io_tcp_read(AVApplicationContext *h, void *obj, int bytes)
 {
     AVAppIOTraffic event = {0};
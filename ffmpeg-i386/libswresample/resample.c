@@ -494,8 +494,13 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
              * when frac and dst_incr_mod are zero */
             resample_func = (c->linear && (c->frac || c->dst_incr_mod)) ?
                             c->dsp.resample_linear : c->dsp.resample_common;
-            for (i = 0; i < dst->ch_count; i++)
-                *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            if (dst->fmt != c->format) {
+                /* the packed output of swr_convert(), see packed_output() */
+                *consumed = c->dsp.resample_stereo_s16(c, (int16_t *)dst->ch[0], src->ch[0], src->ch[1], dst_size);
+            } else {
+                for (i = 0; i < dst->ch_count; i++)
+                    *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            }
         }
     }
 
@@ -607,6 +612,12 @@ static int invert_initial_buffer(ResampleContext *c, AudioData *dst, const Audio
     return FFMAX(res, 0);
 }
 
+static int packed_output(ResampleContext *c, enum AVSampleFormat fmt, int ch_count)
+{
+    return fmt == AV_SAMPLE_FMT_S16 && ch_count == 2 && c->dsp.resample_stereo_s16 &&
+           !c->linear && !(c->filter_length == 1 && c->phase_count == 1);
+}
+
 struct Resampler const swri_resampler={
   resample_init,
   resample_free,
@@ -616,4 +627,5 @@ struct Resampler const swri_resampler={
   get_delay,
   invert_initial_buffer,
   get_out_samples,
+  packed_output,
 };
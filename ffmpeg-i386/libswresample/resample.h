@@ -57,6 +57,9 @@ typedef struct ResampleContext {
                                const void *src, int n, int update_ctx);
         int (*resample_linear)(struct ResampleContext *c, void *dst,
                                const void *src, int n, int update_ctx);
+        /* both channels of FLTP stereo in one pass, into packed s16 */
+        int (*resample_stereo_s16)(struct ResampleContext *c, int16_t *dst,
+                                   const void *src0, const void *src1, int n);
     } dsp;
 } ResampleContext;
 
@@ -125,6 +125,6 @@ static int64_t get_out_samples(struct SwrContext *s, int in_samples){
 
 struct Resampler const swri_soxr_resampler={
     create, destroy, process, flush, NULL /* set_compensation */, get_delay,
-    invert_initial_buffer, get_out_samples
+    invert_initial_buffer, get_out_samples, NULL /* packed_output */
 };
 
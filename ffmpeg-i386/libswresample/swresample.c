@@ -327,6 +327,13 @@ av_assert0(s->out.ch_count);
     if ((ret = swri_dither_init(s, s->out_sample_fmt, s->int_sample_fmt)) < 0)
         goto fail;
 
+    /* downmixed first, so fewer channels are resampled, straight into the
+     * output in one pass */
+    s->packed_resample = s->resample && s->resampler->packed_output && !s->dither.method &&
+                         s->resampler->packed_output(s->resample, s->out_sample_fmt, s->out.ch_count);
+    if (s->packed_resample)
+        s->resample_first = 0;
+
     if(!s->resample && !s->rematrix && !s->channel_map && !s->dither.method){
         s->full_convert = swri_audio_convert_alloc(s->out_sample_fmt,
                                                    s-> in_sample_fmt, s-> in.ch_count, NULL, 0);
@@ -628,6 +635,8 @@ static int swr_convert_internal(struct SwrContext *s, AudioData *out, int out_co
         else if(preout==midbuf) preout= midbuf= out;
         else                    preout= out;
     }
+    if(s->packed_resample)
+        preout= out;
 
     if(in != postin){
         swri_audio_convert(s->in_convert, postin, in, in_count);
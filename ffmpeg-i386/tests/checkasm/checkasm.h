@@ -31,6 +31,7 @@
 #include "libavutil/lfg.h"
 #include "libavutil/timer.h"
 
+void checkasm_check_aacpsdsp(void);
 void checkasm_check_alacdsp(void);
 void checkasm_check_audiodsp(void);
 void checkasm_check_blend(void);
@@ -46,7 +47,11 @@ void checkasm_check_hevc_add_res(void);
 void checkasm_check_hevc_idct(void);
 void checkasm_check_jpeg2000dsp(void);
 void checkasm_check_llviddsp(void);
+void checkasm_check_opusdsp(void);
 void checkasm_check_pixblockdsp(void);
+void checkasm_check_sbrdsp(void);
+void checkasm_check_sw_resample(void);
+void checkasm_check_sw_scale(void);
 void checkasm_check_synth_filter(void);
 void checkasm_check_v210enc(void);
 void checkasm_check_vp8dsp(void);
@@ -77,6 +82,19 @@ static av_unused void *func_ref, *func_new;
 
 #define BENCH_RUNS 1000 /* Trade-off between accuracy and speed */
 
+/* Calls timed per run, in groups of 4. The clock of Apple devices ticks
+ * slower than a short function runs, so a run has to span many calls. */
+#if defined(__APPLE__)
+#define BENCH_CALLS 32
+#else
+#define BENCH_CALLS 1
+#endif
+
+#ifdef CHECKASM_LIBRARY
+/* Entry point when linked into a host app, takes the arguments of main() */
+int checkasm_main(int argc, char *argv[]);
+#endif
+
 /* Decide whether or not the specified function needs to be tested */
 #define check_func(func, ...) (func_ref = checkasm_check_func((func_new = func), __VA_ARGS__))
 
@@ -169,10 +187,13 @@ void checkasm_checked_call(void *func, ...);
             int ti, tcount = 0;\
             for (ti = 0; ti < BENCH_RUNS; ti++) {\
                 uint64_t t = AV_READ_TIME();\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
-                tfunc(__VA_ARGS__);\
+                int tc;\
+                for (tc = 0; tc < BENCH_CALLS; tc++) {\
+                    tfunc(__VA_ARGS__);\
+                    tfunc(__VA_ARGS__);\
+                    tfunc(__VA_ARGS__);\
+                    tfunc(__VA_ARGS__);\
+                }\
                 t = AV_READ_TIME() - t;\
                 if (t*tcount <= tsum*4 && ti > 0) {\
                     tsum += t;\
@@ -180,7 +201,7 @@ void checkasm_checked_call(void *func, ...);
                 }\
             }\
             emms_c();\
-            checkasm_update_bench(tcount, tsum);\
+            checkasm_update_bench(tcount * BENCH_CALLS, tsum);\
         }\
     } while (0)
 #else
@@ -0,0 +1,68 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/aarch64/cpu.h"
+#include "libavcodec/flacdsp.h"
+#include "config.h"
+
+void ff_flac_lpc_16_neon(int32_t *samples, const int coeffs[32], int order,
+                         int qlevel, int len);
+void ff_flac_lpc_32_neon(int32_t *samples, const int coeffs[32], int order,
+                         int qlevel, int len);
+
+#define DECORRELATE_FUNCS(fmt)                                                          \
+void ff_flac_decorrelate_indep2_##fmt##_neon(uint8_t **out, int32_t **in, int channels, \
+                                             int len, int shift);                       \
+void ff_flac_decorrelate_ls_##fmt##_neon(uint8_t **out, int32_t **in, int channels,     \
+                                         int len, int shift);                           \
+void ff_flac_decorrelate_rs_##fmt##_neon(uint8_t **out, int32_t **in, int channels,     \
+                                         int len, int shift);                           \
+void ff_flac_decorrelate_ms_##fmt##_neon(uint8_t **out, int32_t **in, int channels,     \
+                                         int len, int shift)
+
+DECORRELATE_FUNCS(16);
+DECORRELATE_FUNCS(32);
+
+av_cold void ff_flacdsp_init_aarch64(FLACDSPContext *c, enum AVSampleFormat fmt, int channels,
+                                     int bps)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+#if CONFIG_FLAC_DECODER
+    if (have_neon(cpu_flags)) {
+        c->lpc16 = ff_flac_lpc_16_neon;
+        c->lpc32 = ff_flac_lpc_32_neon;
+
+        if (fmt == AV_SAMPLE_FMT_S16) {
+            if (channels == 2)
+                c->decorrelate[0] = ff_flac_decorrelate_indep2_16_neon;
+            c->decorrelate[1] = ff_flac_decorrelate_ls_16_neon;
+            c->decorrelate[2] = ff_flac_decorrelate_rs_16_neon;
+            c->decorrelate[3] = ff_flac_decorrelate_ms_16_neon;
+        } else if (fmt == AV_SAMPLE_FMT_S32) {
+            if (channels == 2)
+                c->decorrelate[0] = ff_flac_decorrelate_indep2_32_neon;
+            c->decorrelate[1] = ff_flac_decorrelate_ls_32_neon;
+            c->decorrelate[2] = ff_flac_decorrelate_rs_32_neon;
+            c->decorrelate[3] = ff_flac_decorrelate_ms_32_neon;
+        }
+    }
+#endif
+}
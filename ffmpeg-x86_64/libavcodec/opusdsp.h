@@ -0,0 +1,45 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_OPUSDSP_H
+#define AVCODEC_OPUSDSP_H
+
+typedef struct OpusDSP {
+    /**
+     * CELT pitch postfilter with constant period and gains, in place.
+     * data[-period - 2] onwards is read.
+     * @param period pitch period, at least CELT_POSTFILTER_MINPERIOD
+     * @param gains  center tap, then the two pairs of side taps
+     * @param len    number of samples, a multiple of 4
+     */
+    void (*postfilter)(float *data, int period, const float *gains, int len);
+
+    /**
+     * CELT deemphasis and scaling to [-1, 1]: y[i] = in[i] + state,
+     * state = y[i] * CELT_EMPH_COEFF, out[i] = y[i] / 32768.
+     * @param state state of the filter before in[0]
+     * @param len   number of samples, a multiple of 4
+     * @return      state of the filter after in[len - 1]
+     */
+    float (*deemphasis)(float *out, const float *in, float state, int len);
+} OpusDSP;
+
+void ff_opus_dsp_init(OpusDSP *ctx);
+void ff_opus_dsp_init_aarch64(OpusDSP *ctx);
+
+#endif /* AVCODEC_OPUSDSP_H */
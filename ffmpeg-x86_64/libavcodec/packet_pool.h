@@ -0,0 +1,57 @@
+/*
+ * Process wide pools of packet payloads
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_PACKET_POOL_H
+#define AVCODEC_PACKET_POOL_H
+
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+
+/**
+ * Packet payloads allocated by av_new_packet(), av_grow_packet() on an
+ * unreferenced packet and av_packet_ref() of an unreferenced source are
+ * taken from a set of power of four size classes shared by every demuxer,
+ * decoder and packet queue of the process. A payload returns to its class
+ * when the last reference is dropped, so steady playback stops hitting
+ * the allocator once the classes are warm. Payloads larger than the
+ * biggest class are allocated as before.
+ */
+
+typedef struct AVPacketPoolStatistic {
+    int64_t hits;       // payloads reused from a class
+    int64_t misses;     // payloads allocated for a class
+    int64_t oversized;  // payloads too large for any class
+} AVPacketPoolStatistic;
+
+void av_packet_pool_get_statistic(AVPacketPoolStatistic *stat);
+
+/**
+ * Release the payloads idle in the classes. Payloads in use are freed
+ * when their last reference is dropped.
+ */
+void av_packet_pool_trim(void);
+
+/**
+ * @return a buffer of at least size bytes, NULL if out of memory
+ */
+AVBufferRef *ff_packet_pool_get(int size);
+
+#endif /* AVCODEC_PACKET_POOL_H */
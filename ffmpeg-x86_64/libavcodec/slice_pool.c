@@ -0,0 +1,371 @@
+/*
+ * Process wide pool of slice threads
+ *
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <stdatomic.h>
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/internal.h"
+#include "libavutil/thread.h"
+
+#include "pthread_internal.h"
+#include "slice_pool.h"
+
+#define SLICE_POOL_CLIENTS 64
+
+// the priority of each client, by client - 1
+static atomic_int    client_priority[SLICE_POOL_CLIENTS];
+static atomic_char   client_used[SLICE_POOL_CLIENTS];
+
+int av_slice_pool_client_open(void)
+{
+    int i;
+
+    for (i = 0; i < SLICE_POOL_CLIENTS; i++) {
+        char unused = 0;
+        if (atomic_compare_exchange_strong(&client_used[i], &unused, 1)) {
+            atomic_store(&client_priority[i], AV_SLICE_POOL_FOREGROUND);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+void av_slice_pool_client_set_priority(int client, enum AVSlicePoolPriority priority)
+{
+    if (client > 0 && client <= SLICE_POOL_CLIENTS)
+        atomic_store(&client_priority[client - 1], priority);
+}
+
+void av_slice_pool_client_close(int client)
+{
+    if (client > 0 && client <= SLICE_POOL_CLIENTS)
+        atomic_store(&client_used[client - 1], 0);
+}
+
+static int client_get_priority(int client)
+{
+    if (client > 0 && client <= SLICE_POOL_CLIENTS)
+        return atomic_load(&client_priority[client - 1]);
+    return AV_SLICE_POOL_FOREGROUND;
+}
+
+#if HAVE_THREADS
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#endif
+
+#define SLICE_POOL_LEVELS 2
+
+typedef struct SlicePoolBatch SlicePoolBatch;
+
+typedef struct SlicePoolTask {
+    SlicePoolBatch       *batch;
+    struct SlicePoolTask *prev;
+    struct SlicePoolTask *next;
+    atomic_int            queue;    // the deque holding it, -1 once taken or withdrawn
+} SlicePoolTask;
+
+struct SlicePoolBatch {
+    AVCodecContext      *avctx;
+    ff_slice_pool_func  *func;
+    ff_slice_pool_func2 *func2;
+    void                *arg;
+    int                 *rets;
+    int                  job_count;
+    int                  job_size;
+    int                  priority;
+    atomic_int           next_job;
+    atomic_int           next_thread;
+
+    pthread_mutex_t      mutex;
+    pthread_cond_t       cond;
+    int                  active;    // runners queued or running
+};
+
+typedef struct SlicePoolDeque {
+    pthread_mutex_t  mutex;
+    SlicePoolTask   *head;          // oldest, stolen
+    SlicePoolTask   *tail;          // newest, taken by its thread
+} SlicePoolDeque;
+
+typedef struct SlicePool {
+    int              size;
+    SlicePoolDeque (*deques)[SLICE_POOL_LEVELS];
+    atomic_uint      next_deque;
+    atomic_int       pending[SLICE_POOL_LEVELS];
+
+    pthread_mutex_t  idle_mutex;
+    pthread_cond_t   idle_cond;
+} SlicePool;
+
+static SlicePool      pool;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void deque_push(SlicePool *p, int q, int level, SlicePoolTask *task)
+{
+    SlicePoolDeque *d = &p->deques[q][level];
+
+    pthread_mutex_lock(&d->mutex);
+    task->prev = d->tail;
+    task->next = NULL;
+    if (d->tail)
+        d->tail->next = task;
+    else
+        d->head = task;
+    d->tail = task;
+    atomic_store(&task->queue, q);
+    pthread_mutex_unlock(&d->mutex);
+}
+
+// must be called locked
+static void deque_unlink(SlicePoolDeque *d, SlicePoolTask *task)
+{
+    if (task->prev)
+        task->prev->next = task->next;
+    else
+        d->head = task->next;
+    if (task->next)
+        task->next->prev = task->prev;
+    else
+        d->tail = task->prev;
+    atomic_store(&task->queue, -1);
+}
+
+static SlicePoolTask *deque_take(SlicePool *p, int q, int level, int newest)
+{
+    SlicePoolDeque *d = &p->deques[q][level];
+    SlicePoolTask  *task;
+
+    pthread_mutex_lock(&d->mutex);
+    task = newest ? d->tail : d->head;
+    if (task) {
+        deque_unlink(d, task);
+        atomic_fetch_sub(&p->pending[level], 1);
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return task;
+}
+
+// its own deque first, then the others from the next one on
+static SlicePoolTask *pool_take(SlicePool *p, int self)
+{
+    int level, i;
+
+    for (level = 0; level < SLICE_POOL_LEVELS; level++) {
+        if (!atomic_load(&p->pending[level]))
+            continue;
+        for (i = 0; i < p->size; i++) {
+            SlicePoolTask *task = deque_take(p, (self + i) % p->size, level, !i);
+            if (task)
+                return task;
+        }
+    }
+    return NULL;
+}
+
+static void batch_run(SlicePoolBatch *b, int threadnr)
+{
+    int job;
+
+    while ((job = atomic_fetch_add(&b->next_job, 1)) < b->job_count) {
+        int ret = b->func ? b->func(b->avctx, (char *)b->arg + job * b->job_size)
+                          : b->func2(b->avctx, b->arg, job, threadnr);
+        if (b->rets)
+            b->rets[job] = ret;
+    }
+}
+
+static void batch_finish(SlicePoolBatch *b, int runners)
+{
+    pthread_mutex_lock(&b->mutex);
+    b->active -= runners;
+    if (!b->active)
+        pthread_cond_signal(&b->cond);
+    pthread_mutex_unlock(&b->mutex);
+}
+
+#if defined(__APPLE__)
+static void worker_set_level(int *current, int level)
+{
+    if (*current == level)
+        return;
+    pthread_set_qos_class_self_np(level == AV_SLICE_POOL_FOREGROUND ? QOS_CLASS_USER_INITIATED
+                                                                    : QOS_CLASS_UTILITY, 0);
+    *current = level;
+}
+#else
+static void worker_set_level(int *current, int level)
+{
+}
+#endif
+
+static void *attribute_align_arg pool_worker(void *arg)
+{
+    SlicePool *p     = &pool;
+    int        self  = (int)(intptr_t)arg;
+    int        level = -1;
+
+    for (;;) {
+        SlicePoolTask *task = pool_take(p, self);
+
+        if (!task) {
+            pthread_mutex_lock(&p->idle_mutex);
+            while (!atomic_load(&p->pending[0]) && !atomic_load(&p->pending[1]))
+                pthread_cond_wait(&p->idle_cond, &p->idle_mutex);
+            pthread_mutex_unlock(&p->idle_mutex);
+            continue;
+        }
+
+        worker_set_level(&level, task->batch->priority);
+        batch_run(task->batch, atomic_fetch_add(&task->batch->next_thread, 1));
+        batch_finish(task->batch, 1);
+    }
+    return NULL;
+}
+
+static void pool_init(void)
+{
+    SlicePool *p    = &pool;
+    int        size = FFMIN(av_cpu_count(), MAX_AUTO_THREADS);
+    int        i, level;
+
+    if (size <= 1)
+        return;
+
+    p->deques = av_mallocz_array(size, sizeof(*p->deques));
+    if (!p->deques)
+        return;
+    for (i = 0; i < size; i++)
+        for (level = 0; level < SLICE_POOL_LEVELS; level++)
+            pthread_mutex_init(&p->deques[i][level].mutex, NULL);
+    pthread_mutex_init(&p->idle_mutex, NULL);
+    pthread_cond_init(&p->idle_cond, NULL);
+
+    // the threads stay for the life of the process, asleep when idle
+    for (i = 0; i < size; i++) {
+        pthread_attr_t attr;
+        pthread_t      thread;
+        int            ret;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        ret = pthread_create(&thread, &attr, pool_worker, (void *)(intptr_t)i);
+        pthread_attr_destroy(&attr);
+        if (ret)
+            break;
+    }
+    // a thread not created leaves its deque to be stolen from
+    p->size = i ? size : 0;
+}
+
+int ff_slice_pool_size(void)
+{
+    pthread_once(&pool_once, pool_init);
+    return pool.size;
+}
+
+int ff_slice_pool_execute(AVCodecContext *avctx, ff_slice_pool_func *func, ff_slice_pool_func2 *func2,
+                          void *arg, int *ret, int job_count, int job_size)
+{
+    SlicePool      *p = &pool;
+    SlicePoolBatch  b = { 0 };
+    SlicePoolTask   tasks[MAX_AUTO_THREADS];
+    int             runners, withdrawn = 0, i;
+
+    if (job_count <= 0)
+        return 0;
+
+    runners = FFMIN3(avctx->thread_count, job_count, MAX_AUTO_THREADS + 1) - 1;
+    if (runners <= 0 || !ff_slice_pool_size()) {
+        return func ? avcodec_default_execute(avctx, func, arg, ret, job_count, job_size)
+                    : avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+    }
+
+    b.avctx     = avctx;
+    b.func      = func;
+    b.func2     = func2;
+    b.arg       = arg;
+    b.rets      = ret;
+    b.job_count = job_count;
+    b.job_size  = job_size;
+    b.priority  = av_clip(client_get_priority(avctx->thread_pool), 0, SLICE_POOL_LEVELS - 1);
+    b.active    = runners;
+    atomic_init(&b.next_job, 0);
+    atomic_init(&b.next_thread, 1);
+    pthread_mutex_init(&b.mutex, NULL);
+    pthread_cond_init(&b.cond, NULL);
+
+    // counted first, a worker finding them not queued yet looks again
+    atomic_fetch_add(&p->pending[b.priority], runners);
+    for (i = 0; i < runners; i++) {
+        tasks[i].batch = &b;
+        deque_push(p, atomic_fetch_add(&p->next_deque, 1) % p->size, b.priority, &tasks[i]);
+    }
+    pthread_mutex_lock(&p->idle_mutex);
+    pthread_cond_broadcast(&p->idle_cond);
+    pthread_mutex_unlock(&p->idle_mutex);
+
+    batch_run(&b, 0);
+
+    // every job is taken: the runners still queued have nothing left to do
+    for (i = 0; i < runners; i++) {
+        int q = atomic_load(&tasks[i].queue);
+        if (q >= 0) {
+            SlicePoolDeque *d = &p->deques[q][b.priority];
+            pthread_mutex_lock(&d->mutex);
+            if (atomic_load(&tasks[i].queue) == q) {
+                deque_unlink(d, &tasks[i]);
+                atomic_fetch_sub(&p->pending[b.priority], 1);
+                withdrawn++;
+            }
+            pthread_mutex_unlock(&d->mutex);
+        }
+    }
+    pthread_mutex_lock(&b.mutex);
+    b.active -= withdrawn;
+    while (b.active)
+        pthread_cond_wait(&b.cond, &b.mutex);
+    pthread_mutex_unlock(&b.mutex);
+
+    pthread_mutex_destroy(&b.mutex);
+    pthread_cond_destroy(&b.cond);
+    return 0;
+}
+
+#else
+
+int ff_slice_pool_size(void)
+{
+    return 0;
+}
+
+int ff_slice_pool_execute(AVCodecContext *avctx, ff_slice_pool_func *func, ff_slice_pool_func2 *func2,
+                          void *arg, int *ret, int job_count, int job_size)
+{
+    return func ? avcodec_default_execute(avctx, func, arg, ret, job_count, job_size)
+                : avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+}
+
+#endif /* HAVE_THREADS */
@@ -1239,7 +1239,7 @@ int attribute_align_arg ff_codec_open2_recursive(AVCodecContext *avctx, const AV
     return ret;
 }
 
-int attribute_align_arg avcodec_open2(AVCodecContext *avctx, const AVCodec *codec, AVDictionary **options)
+static int open_codec(AVCodecContext *avctx, const AVCodec *codec, AVDictionary **options)
 {
     int ret = 0;
     AVDictionary *tmp = NULL;
@@ -1733,6 +1733,51 @@ FF_ENABLE_DEPRECATION_WARNINGS
     goto end;
 }
 
+/* the next registered decoder of the codec id, not itself a fallback one */
+static const AVCodec *find_fallback_decoder(const AVCodec *codec)
+{
+    AVCodec *p;
+    int rest = 0;
+
+    do {
+        p = NULL;
+        while ((p = av_codec_next(p)))
+            if (av_codec_is_decoder(p) && p->id == codec->id &&
+                !(p->caps_internal & FF_CODEC_CAP_INIT_FALLBACK) &&
+                !(p->capabilities & AV_CODEC_CAP_EXPERIMENTAL))
+                return p;
+    } while (!rest++ && ff_codec_register_rest());
+    return NULL;
+}
+
+int attribute_align_arg avcodec_open2(AVCodecContext *avctx, const AVCodec *codec, AVDictionary **options)
+{
+    const AVCodec *opened = codec ? codec : avctx->codec;
+    const AVCodec *fallback;
+    AVDictionary *saved = NULL;
+    int ret;
+
+    if (!opened || !(opened->caps_internal & FF_CODEC_CAP_INIT_FALLBACK) ||
+        !av_codec_is_decoder(opened) || avcodec_is_open(avctx))
+        return open_codec(avctx, codec, options);
+
+    if (options)
+        av_dict_copy(&saved, *options, 0);
+    ret = open_codec(avctx, codec, options);
+    if (ret >= 0 || ret == AVERROR(ENOMEM) || !(fallback = find_fallback_decoder(opened))) {
+        av_dict_free(&saved);
+        return ret;
+    }
+
+    av_log(avctx, AV_LOG_WARNING, "Failed to open %s, falling back to %s\n",
+           opened->name, fallback->name);
+    if (options) {
+        av_dict_free(options);
+        *options = saved;
+    }
+    return open_codec(avctx, fallback, options);
+}
+
 int ff_alloc_packet2(AVCodecContext *avctx, AVPacket *avpkt, int64_t size, int64_t min_size)
 {
     if (avpkt->size < 0) {
@@ -3128,7 +3173,7 @@ static enum AVCodecID remap_deprecated_codec_id(enum AVCodecID id)
     }
 }
 
-static AVCodec *find_encdec(enum AVCodecID id, int encoder)
+static AVCodec *find_registered(enum AVCodecID id, int encoder)
 {
     AVCodec *p, *experimental = NULL;
     p = first_avcodec;
@@ -3146,25 +3191,49 @@ static AVCodec *find_encdec(enum AVCodecID id, int encoder)
     return experimental;
 }
 
-AVCodec *avcodec_find_encoder(enum AVCodecID id)
+/* the codecs left out by avcodec_register_allow_list() are registered on
+ * the first lookup that misses */
+static AVCodec *find_encdec(enum AVCodecID id, int encoder)
 {
-    return find_encdec(id, 1);
+    AVCodec *p = find_registered(id, encoder);
+    if (!p && ff_codec_register_rest())
+        p = find_registered(id, encoder);
+    return p;
 }
 
-AVCodec *avcodec_find_encoder_by_name(const char *name)
+static AVCodec *find_registered_by_name(const char *name, int encoder)
 {
-    AVCodec *p;
-    if (!name)
-        return NULL;
-    p = first_avcodec;
+    AVCodec *p = first_avcodec;
     while (p) {
-        if (av_codec_is_encoder(p) && strcmp(name, p->name) == 0)
+        if ((encoder ? av_codec_is_encoder(p) : av_codec_is_decoder(p)) &&
+            strcmp(name, p->name) == 0)
             return p;
         p = p->next;
     }
     return NULL;
 }
 
+static AVCodec *find_encdec_by_name(const char *name, int encoder)
+{
+    AVCodec *p;
+    if (!name)
+        return NULL;
+    p = find_registered_by_name(name, encoder);
+    if (!p && ff_codec_register_rest())
+        p = find_registered_by_name(name, encoder);
+    return p;
+}
+
+AVCodec *avcodec_find_encoder(enum AVCodecID id)
+{
+    return find_encdec(id, 1);
+}
+
+AVCodec *avcodec_find_encoder_by_name(const char *name)
+{
+    return find_encdec_by_name(name, 1);
+}
+
 AVCodec *avcodec_find_decoder(enum AVCodecID id)
 {
     return find_encdec(id, 0);
@@ -3172,16 +3241,7 @@ AVCodec *avcodec_find_decoder(enum AVCodecID id)
 
 AVCodec *avcodec_find_decoder_by_name(const char *name)
 {
-    AVCodec *p;
-    if (!name)
-        return NULL;
-    p = first_avcodec;
-    while (p) {
-        if (av_codec_is_decoder(p) && strcmp(name, p->name) == 0)
-            return p;
-        p = p->next;
-    }
-    return NULL;
+    return find_encdec_by_name(name, 0);
 }
 
 const char *avcodec_get_name(enum AVCodecID id)
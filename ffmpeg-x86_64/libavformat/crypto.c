@@ -27,7 +27,8 @@
 #include "url.h"
 
 // encourage reads of 4096 bytes - 1 block is always retained.
-#define MAX_BUFFER_BLOCKS 257
+// large enough that a segment is decrypted in a few calls, not thousands
+#define MAX_BUFFER_BLOCKS 4097
 #define BLOCKSIZE 16
 
 typedef struct CryptoContext {
@@ -180,6 +181,17 @@ err:
     return ret;
 }
 
+static void crypto_consume(CryptoContext *c, int blocks)
+{
+    c->indata_used += BLOCKSIZE * blocks;
+    if (c->indata_used >= sizeof(c->inbuffer)/2) {
+        memmove(c->inbuffer, c->inbuffer + c->indata_used,
+                c->indata - c->indata_used);
+        c->indata     -= c->indata_used;
+        c->indata_used = 0;
+    }
+}
+
 static int crypto_read(URLContext *h, uint8_t *buf, int size)
 {
     CryptoContext *c = h->priv_data;
@@ -211,17 +223,20 @@ retry:
         return AVERROR_EOF;
     if (!c->eof)
         blocks--;
+    if (!c->eof && size >= BLOCKSIZE) {
+        // no padding to strip: straight into the caller's buffer
+        blocks = FFMIN(blocks, size / BLOCKSIZE);
+        av_aes_crypt(c->aes_decrypt, buf, c->inbuffer + c->indata_used,
+                     blocks, c->decrypt_iv, 1);
+        crypto_consume(c, blocks);
+        c->position += BLOCKSIZE * blocks;
+        return BLOCKSIZE * blocks;
+    }
     av_aes_crypt(c->aes_decrypt, c->outbuffer, c->inbuffer + c->indata_used,
                  blocks, c->decrypt_iv, 1);
     c->outdata      = BLOCKSIZE * blocks;
     c->outptr       = c->outbuffer;
-    c->indata_used += BLOCKSIZE * blocks;
-    if (c->indata_used >= sizeof(c->inbuffer)/2) {
-        memmove(c->inbuffer, c->inbuffer + c->indata_used,
-                c->indata - c->indata_used);
-        c->indata     -= c->indata_used;
-        c->indata_used = 0;
-    }
+    crypto_consume(c, blocks);
     if (c->eof) {
         // Remove PKCS7 padding at the end
         int padding = c->outbuffer[c->outdata - 1];
@@ -0,0 +1,80 @@
+/*
+ * Process wide DNS resolution cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_DNS_CACHE_H
+#define AVFORMAT_DNS_CACHE_H
+
+#include <stdint.h>
+
+struct addrinfo;
+
+/**
+ * Entries are keyed by "host:port" and shared by every player in the
+ * process. Successful lookups keep the whole address list, failed lookups
+ * are remembered as negative entries so a dead host is not resolved again
+ * on every retry.
+ */
+
+#define DNS_CACHE_MISS      0
+#define DNS_CACHE_HIT       1
+#define DNS_CACHE_NEGATIVE  2
+
+typedef struct DnsCacheStatistic {
+    int64_t hits;
+    int64_t negative_hits;
+    int64_t misses;
+    int     entries;
+} DnsCacheStatistic;
+
+/**
+ * Look up hostname:port.
+ *
+ * @param ttl          max age of a positive entry in microseconds, < 0 for no limit
+ * @param negative_ttl max age of a negative entry in microseconds
+ * @param res          on DNS_CACHE_HIT, a private copy of the address list,
+ *                     release it with ff_dns_cache_freeaddrinfo()
+ * @param gai_error    on DNS_CACHE_NEGATIVE, the getaddrinfo() error cached
+ * @return DNS_CACHE_MISS, DNS_CACHE_HIT or DNS_CACHE_NEGATIVE
+ */
+int  ff_dns_cache_lookup(const char *hostname, int port, int64_t ttl, int64_t negative_ttl,
+                         struct addrinfo **res, int *gai_error);
+
+/**
+ * Store the result of getaddrinfo(). A non zero gai_error stores a negative
+ * entry, ai is ignored in that case.
+ */
+void ff_dns_cache_store(const char *hostname, int port, const struct addrinfo *ai, int gai_error);
+
+void ff_dns_cache_remove(const char *hostname, int port);
+void ff_dns_cache_freeaddrinfo(struct addrinfo **p_ai);
+
+/**
+ * Resolve hostname:port in the background and put the result into the cache,
+ * so the next tcp open with dns_cache enabled does not wait for the resolver.
+ * Does nothing if a prefetch of the same host:port is already pending.
+ *
+ * @return 0 on success (including the no-op case), a negative AVERROR otherwise
+ */
+int  av_dns_cache_prefetch(const char *hostname, int port);
+
+void av_dns_cache_clear(void);
+void av_dns_cache_get_statistic(DnsCacheStatistic *stat);
+
+#endif /* AVFORMAT_DNS_CACHE_H */
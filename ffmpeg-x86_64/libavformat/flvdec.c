@@ -24,6 +24,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/application.h"
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/dict.h"
@@ -31,6 +32,7 @@
 #include "libavutil/intfloat.h"
 #include "libavutil/mathematics.h"
 #include "libavcodec/bytestream.h"
+#include "libavcodec/h264.h"
 #include "libavcodec/mpeg4audio.h"
 #include "avformat.h"
 #include "internal.h"
@@ -40,6 +42,9 @@
 #define VALIDATE_INDEX_TS_THRESH 2500
 
 #define RESYNC_BUFFER_SIZE (1<<20)
+#define RESYNC_READ_SIZE   (1<<14)
+/* entries of an AMF keyframes array read at a time */
+#define KEYFRAMES_READ_COUNT 1024
 
 typedef struct FLVContext {
     const AVClass *class; ///< Class for private options.
@@ -62,6 +67,8 @@ typedef struct FLVContext {
     int broken_sizes;
     int sum_flv_tag_size;
 
+    int untrusted_keyframes; ///< an H.264 keyframe held no IDR picture
+
     int last_keyframe_stream_index;
     int keyframe_count;
     int64_t video_bit_rate;
@@ -70,6 +77,15 @@ typedef struct FLVContext {
     int64_t *keyframe_filepositions;
     int missing_streams;
     AVRational framerate;
+    int meta_width;     // onMetaData size, for a video stream created later
+    int meta_height;
+
+    int64_t app_ctx_intptr;
+    AVApplicationContext *app_ctx;
+    int live_target_latency;    // ms
+    int live_max_latency;       // ms, 0 disables the skip
+    int64_t latency_check_dts;
+    int64_t skip_until_dts;     // AV_NOPTS_VALUE while not skipping
 } FLVContext;
 
 static int probe(AVProbeData *p, int live)
@@ -116,11 +132,45 @@ static void add_keyframes_index(AVFormatContext *s)
     stream = s->streams[flv->last_keyframe_stream_index];
 
     if (stream->nb_index_entries == 0) {
+        AVIndexEntry *entries = NULL;
+
+        /* The arrays are in time order: the entries are appended in place,
+         * rather than each searched for by av_add_index_entry(), which takes
+         * those out of order and the wrapped timestamps. */
+        if (stream->pts_wrap_reference == AV_NOPTS_VALUE &&
+            flv->keyframe_count < UINT_MAX / sizeof(*entries))
+            entries = av_fast_realloc(stream->index_entries,
+                                      &stream->index_entries_allocated_size,
+                                      flv->keyframe_count * sizeof(*entries));
+        if (entries)
+            stream->index_entries = entries;
+
         for (i = 0; i < flv->keyframe_count; i++) {
+            int64_t pos       = flv->keyframe_filepositions[i];
+            int64_t timestamp = flv->keyframe_times[i] * 1000;
+            int     n         = stream->nb_index_entries;
+            AVIndexEntry *ie;
+
             av_log(s, AV_LOG_TRACE, "keyframe filepositions = %"PRId64" times = %"PRId64"\n",
-                   flv->keyframe_filepositions[i], flv->keyframe_times[i] * 1000);
-            av_add_index_entry(stream, flv->keyframe_filepositions[i],
-                flv->keyframe_times[i] * 1000, 0, 0, AVINDEX_KEYFRAME);
+                   pos, timestamp);
+            if (!entries || timestamp < 0 || timestamp >= (1LL << 48) ||
+                (n && timestamp < stream->index_entries[n - 1].timestamp)) {
+                av_add_index_entry(stream, pos, timestamp, 0, 0, AVINDEX_KEYFRAME);
+                continue;
+            }
+
+            /* as av_add_index_entry(), the last of equal timestamps stays */
+            if (n && timestamp == stream->index_entries[n - 1].timestamp) {
+                ie = &stream->index_entries[n - 1];
+            } else {
+                ie = &stream->index_entries[n];
+                ie->min_distance = 0;
+                stream->nb_index_entries++;
+            }
+            ie->pos       = pos;
+            ie->timestamp = timestamp;
+            ie->size      = 0;
+            ie->flags     = AVINDEX_KEYFRAME;
         }
     } else
         av_log(s, AV_LOG_WARNING, "Skipping duplicate index\n");
@@ -151,6 +201,10 @@ static AVStream *create_stream(AVFormatContext *s, int codec_type)
         st->codecpar->bit_rate = flv->video_bit_rate;
         flv->missing_streams &= ~FLV_HEADER_FLAG_HASVIDEO;
         st->avg_frame_rate = flv->framerate;
+        if (s->flags & AVFMT_FLAG_FAST_OPEN) {
+            st->codecpar->width  = flv->meta_width;
+            st->codecpar->height = flv->meta_height;
+        }
     }
 
 
@@ -418,10 +472,23 @@ static int parse_keyframes_index(AVFormatContext *s, AVIOContext *ioc, int64_t m
             goto finish;
         }
 
-        for (i = 0; i < arraylen && avio_tell(ioc) < max_pos - 1; i++) {
-            if (avio_r8(ioc) != AMF_DATA_TYPE_NUMBER)
+        /* the entries are read in blocks, up to the last one starting
+         * before max_pos - 1 */
+        for (i = 0; i < arraylen; ) {
+            uint8_t buf[KEYFRAMES_READ_COUNT * 9];
+            int64_t left = max_pos - 1 - avio_tell(ioc);
+            int n = FFMIN(arraylen - i, KEYFRAMES_READ_COUNT), j;
+
+            if (left <= 0)
+                break;
+            n = FFMIN(n, (left + 8) / 9);
+            if (avio_read(ioc, buf, n * 9) != n * 9)
                 goto invalid;
-            current_array[0][i] = av_int2double(avio_rb64(ioc));
+            for (j = 0; j < n; j++, i++) {
+                if (buf[j * 9] != AMF_DATA_TYPE_NUMBER)
+                    goto invalid;
+                current_array[0][i] = av_int2double(AV_RB64(buf + j * 9 + 1));
+            }
         }
         if (times && filepositions) {
             // All done, exiting at a position allowing amf_parse_object
@@ -567,6 +634,10 @@ static int amf_parse_object(AVFormatContext *s, AVStream *astream,
                     flv->framerate = av_d2q(num_val, 1000);
                     if (vstream)
                         vstream->avg_frame_rate = flv->framerate;
+                } else if (!strcmp(key, "width") && !vpar && 0 < num_val && num_val < INT_MAX) {
+                    flv->meta_width = num_val;
+                } else if (!strcmp(key, "height") && !vpar && 0 < num_val && num_val < INT_MAX) {
+                    flv->meta_height = num_val;
                 } else if (flv->trust_metadata) {
                     if (!strcmp(key, "videocodecid") && vpar) {
                         int ret = flv_set_video_codec(s, vstream, num_val, 0);
@@ -734,6 +805,9 @@ static int flv_read_header(AVFormatContext *s)
     s->start_time = 0;
     flv->sum_flv_tag_size = 0;
     flv->last_keyframe_stream_index = -1;
+    flv->app_ctx = (AVApplicationContext *)(intptr_t)flv->app_ctx_intptr;
+    flv->latency_check_dts = AV_NOPTS_VALUE;
+    flv->skip_until_dts = AV_NOPTS_VALUE;
 
     return 0;
 }
@@ -897,33 +971,153 @@ skip:
 static int resync(AVFormatContext *s)
 {
     FLVContext *flv = s->priv_data;
-    int64_t i;
-    int64_t pos = avio_tell(s->pb);
+    uint8_t *buf = flv->resync_buffer;
+    int64_t pos  = avio_tell(s->pb);
+    int64_t base = 0;   // bytes since pos before buf[0]
+    int64_t end  = 0;   // bytes since pos read
+    int64_t i    = 23;  // next byte to check as the start of a tag after two others
+
+    while (!avio_feof(s->pb)) {
+        int len = end - base, n;
+
+        /* keep the last RESYNC_BUFFER_SIZE bytes, a tag pair spans less */
+        if (len + RESYNC_READ_SIZE > 2 * RESYNC_BUFFER_SIZE) {
+            memmove(buf, buf + len - RESYNC_BUFFER_SIZE, RESYNC_BUFFER_SIZE);
+            base += len - RESYNC_BUFFER_SIZE;
+            len   = RESYNC_BUFFER_SIZE;
+        }
+        n = avio_read(s->pb, buf + len, RESYNC_READ_SIZE);
+        if (n <= 0)
+            break;
+        end += n;
 
-    for (i=0; !avio_feof(s->pb); i++) {
-        int j  = i & (RESYNC_BUFFER_SIZE-1);
-        int j1 = j + RESYNC_BUFFER_SIZE;
-        flv->resync_buffer[j ] =
-        flv->resync_buffer[j1] = avio_r8(s->pb);
+        while (i < end) {
+            /* The previous tag size before byte i is below RESYNC_BUFFER_SIZE,
+             * its first byte is 0: memchr() skips the rest in vector steps. */
+            const uint8_t *z = memchr(buf + (i - 4 - base), 0, end - i);
+            const uint8_t *q;
+            unsigned lsize2;
 
-        if (i > 22) {
-            unsigned lsize2 = AV_RB32(flv->resync_buffer + j1 - 4);
+            if (!z) {
+                i = end;
+                break;
+            }
+            i = z - buf + base + 4;
+            q = buf + (i - base);
+            lsize2 = AV_RB32(q - 4);
             if (lsize2 >= 11 && lsize2 + 8LL < FFMIN(i, RESYNC_BUFFER_SIZE)) {
-                unsigned  size2 = AV_RB24(flv->resync_buffer + j1 - lsize2 + 1 - 4);
-                unsigned lsize1 = AV_RB32(flv->resync_buffer + j1 - lsize2 - 8);
+                unsigned  size2 = AV_RB24(q - lsize2 + 1 - 4);
+                unsigned lsize1 = AV_RB32(q - lsize2 - 8);
                 if (lsize1 >= 11 && lsize1 + 8LL + lsize2 < FFMIN(i, RESYNC_BUFFER_SIZE)) {
-                    unsigned  size1 = AV_RB24(flv->resync_buffer + j1 - lsize1 + 1 - lsize2 - 8);
+                    unsigned  size1 = AV_RB24(q - lsize1 + 1 - lsize2 - 8);
                     if (size1 == lsize1 - 11 && size2  == lsize2 - 11) {
                         avio_seek(s->pb, pos + i - lsize1 - lsize2 - 8, SEEK_SET);
                         return 1;
                     }
                 }
             }
+            i++;
         }
     }
     return AVERROR_EOF;
 }
 
+/**
+ * Live latency bound: at every sync point (a video keyframe, or an audio
+ * packet when there is no video) the player reports how much it has
+ * buffered. Past live_max_latency the packets are dropped up to the
+ * sync point that brings the buffer back to live_target_latency, the
+ * player keeps playing its queue and then continues from there.
+ *
+ * @return 1 if the packet is to be dropped
+ */
+static int flv_live_skip(AVFormatContext *s, int stream_type, int key, int64_t dts)
+{
+    FLVContext *flv = s->priv_data;
+    AVAppBufferLevel level = { 0 };
+    int i, sync_point;
+
+    if (!flv->live_max_latency || !flv->app_ctx || dts == AV_NOPTS_VALUE)
+        return 0;
+
+    if (stream_type == FLV_STREAM_TYPE_VIDEO) {
+        sync_point = key;
+    } else if (stream_type == FLV_STREAM_TYPE_AUDIO) {
+        sync_point = 1;
+        for (i = 0; i < s->nb_streams; i++)
+            if (s->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+                sync_point = 0;
+    } else {
+        sync_point = 0;
+    }
+
+    if (flv->skip_until_dts != AV_NOPTS_VALUE) {
+        if (!sync_point || dts < flv->skip_until_dts)
+            return 1;
+        av_log(s, AV_LOG_INFO, "live latency: resume at %"PRId64"\n", dts);
+        flv->skip_until_dts = AV_NOPTS_VALUE;
+        flv->latency_check_dts = dts;
+        return 0;
+    }
+
+    if (!sync_point)
+        return 0;
+    if (flv->latency_check_dts != AV_NOPTS_VALUE &&
+        dts >= flv->latency_check_dts && dts - flv->latency_check_dts < 1000)
+        return 0;
+    flv->latency_check_dts = dts;
+
+    level.size = sizeof(level);
+    level.cached_duration_milli = -1;
+    av_application_on_buffer_level(flv->app_ctx, &level);
+    if (level.cached_duration_milli <= flv->live_max_latency)
+        return 0;
+
+    flv->skip_until_dts = dts + level.cached_duration_milli -
+                          FFMIN(flv->live_target_latency, flv->live_max_latency);
+    av_log(s, AV_LOG_INFO, "live latency %"PRId64" ms over %d ms, skip %"PRId64" to %"PRId64"\n",
+           level.cached_duration_milli, flv->live_max_latency, dts, flv->skip_until_dts);
+    return 1;
+}
+
+/* FLV flags any intra picture as a keyframe, while decoders take the
+ * keyframes of H.264 for IDR pictures. The flags are trusted, see
+ * AVFMT_FLAG_TRUST_KEYFRAMES, only as long as each keyframe holds an IDR
+ * slice; checked before the packet is returned, so that none without one
+ * gets past the headers parser. */
+static void flv_check_h264_keyframe(AVFormatContext *s, AVStream *st, AVPacket *pkt)
+{
+    FLVContext *flv = s->priv_data;
+    const uint8_t *p = pkt->data, *end = pkt->data + pkt->size;
+    int length_size = 4, i;
+
+    if (flv->untrusted_keyframes || !(pkt->flags & AV_PKT_FLAG_KEY))
+        return;
+
+    if (st->codecpar->extradata_size >= 5 && st->codecpar->extradata[0] == 1)
+        length_size = (st->codecpar->extradata[4] & 3) + 1;
+    while (end - p > length_size) {
+        uint32_t nal_size = 0;
+
+        for (i = 0; i < length_size; i++)
+            nal_size = (nal_size << 8) | p[i];
+        p += length_size;
+        if (!nal_size || nal_size > end - p)
+            break;
+        if ((p[0] & 0x1f) == H264_NAL_IDR_SLICE) {
+            st->internal->trusted_keyframes = 1;
+            return;
+        }
+        p += nal_size;
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Keyframe without an IDR picture, "
+           "keyframe flags no longer trusted\n");
+    flv->untrusted_keyframes         = 1;
+    st->internal->trusted_keyframes = 0;
+    st->internal->headers_parsed    = 0;
+}
+
 static int flv_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     FLVContext *flv = s->priv_data;
@@ -1178,7 +1372,10 @@ retry_duration:
             if (st->codecpar->codec_id == AV_CODEC_ID_AAC && t && !strcmp(t->value, "Omnia A/XE"))
                 st->codecpar->extradata_size = 2;
 
-            if (st->codecpar->codec_id == AV_CODEC_ID_AAC && 0) {
+            /* the sound format flags always claim 44.1 kHz stereo for AAC,
+             * take the real values from the AudioSpecificConfig so
+             * fast open does not need to decode a frame */
+            if (st->codecpar->codec_id == AV_CODEC_ID_AAC && (s->flags & AVFMT_FLAG_FAST_OPEN)) {
                 MPEG4AudioConfig cfg;
 
                 if (avpriv_mpeg4audio_get_config(&cfg, st->codecpar->extradata,
@@ -1235,6 +1432,14 @@ retry_duration:
             stream_type == FLV_STREAM_TYPE_DATA)
         pkt->flags |= AV_PKT_FLAG_KEY;
 
+    if (stream_type == FLV_STREAM_TYPE_VIDEO && st->codecpar->codec_id == AV_CODEC_ID_H264)
+        flv_check_h264_keyframe(s, st, pkt);
+
+    if (flv_live_skip(s, stream_type, pkt->flags & AV_PKT_FLAG_KEY, dts)) {
+        av_packet_unref(pkt);
+        ret = FFERROR_REDO;
+    }
+
 leave:
     last = avio_rb32(s->pb);
     if (last != orig_size + 11 && last != orig_size + 10 &&
@@ -1257,6 +1462,8 @@ static int flv_read_seek(AVFormatContext *s, int stream_index,
 {
     FLVContext *flv = s->priv_data;
     flv->validate_count = 0;
+    flv->latency_check_dts = AV_NOPTS_VALUE;
+    flv->skip_until_dts = AV_NOPTS_VALUE;
     return avio_seek_time(s->pb, stream_index, ts, flags);
 }
 
@@ -1265,6 +1472,9 @@ static int flv_read_seek(AVFormatContext *s, int stream_index,
 static const AVOption options[] = {
     { "flv_metadata", "Allocate streams according to the onMetaData array", OFFSET(trust_metadata), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
     { "missing_streams", "", OFFSET(missing_streams), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 0xFF, VD | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "ijkapplication", "AVApplicationContext", OFFSET(app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, VD },
+    { "live_target_latency", "buffered duration to get back to after a skip, in milliseconds", OFFSET(live_target_latency), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, VD },
+    { "live_max_latency", "skip to a later keyframe when the player buffers more than this, in milliseconds", OFFSET(live_max_latency), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
     { NULL }
 };
 
@@ -0,0 +1,726 @@
+/*
+ * Offline download of an HLS stream
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/common.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "hls_download.h"
+#include "hls_playlist.h"
+#include "internal.h"
+#include "os_support.h"
+#include "url.h"
+#if CONFIG_CACHE_PROTOCOL
+#include "disk_cache.h"
+#endif
+
+#if HAVE_PTHREADS
+
+#include <pthread.h>
+
+#define DOWNLOAD_IO_SIZE        (64 * 1024)
+#define DOWNLOAD_MAX_WORKERS    16
+#define DOWNLOAD_MAX_ATTEMPTS   3
+#define DOWNLOAD_WAIT_INTERVAL  100000      // a waiting worker checks for an interrupt this often
+#define DOWNLOAD_RATE_BURST     1000000     // idle time the rate limit does not make up for
+
+enum ItemState {
+    ITEM_PENDING,
+    ITEM_RUNNING,
+    ITEM_DONE,
+};
+
+/* a file of the directory: a segment, a key or an initialization section */
+typedef struct DownloadItem {
+    HLSMediaRange   range;          // url owned by the playlist
+    char            name[64];       // in the directory
+    char            host[256];
+    int64_t         duration;       // of a segment of the first track, 0 otherwise
+    int64_t         bytes;          // in the file
+    int             attempts;
+    int             restart;        // the partial file is not resumed
+    enum ItemState  state;
+} DownloadItem;
+
+typedef struct DownloadTrack {
+    HLSMediaPlaylist *pls;
+    int              *segment_items;
+    int              *init_items;
+    int              *key_items;    // per segment, -1 if not encrypted
+} DownloadTrack;
+
+struct AVHLSDownload {
+    char                 *dir;
+    AVDictionary         *opts;     // of every request
+    AVIOInterruptCB       int_cb;
+    DownloadTrack         tracks[HLS_MAX_VARIANT_PLAYLISTS];
+    int                   nb_tracks;
+    DownloadItem         *items;
+    int                   nb_items;
+
+    pthread_mutex_t       mutex;
+    pthread_cond_t        cond;
+    int                   max_connections;
+    int                   max_per_host;
+    int                   nb_pending;
+    int                   nb_running;
+    int                   error;
+    int                   abort_request;
+    int64_t               max_rate;
+    int64_t               rate_start;   // of the bytes counted against max_rate
+    int64_t               rate_bytes;
+    AVHLSDownloadProgress progress;
+};
+
+static int download_interrupt_cb(void *opaque)
+{
+    AVHLSDownload *d = opaque;
+
+    return d->abort_request || ff_check_interrupt(&d->int_cb);
+}
+
+/* ".ts" of "http://host/a/seg1.ts?token=x", def if there is none */
+static void url_extension(const char *url, const char *def, char *ext, int size)
+{
+    const char *end = url + strcspn(url, "?#");
+    const char *dot = NULL;
+    const char *p;
+
+    for (p = url; p < end; p++) {
+        if (*p == '/')
+            dot = NULL;
+        else if (*p == '.')
+            dot = p;
+    }
+    if (!dot || end - dot < 2 || end - dot > 6)
+        av_strlcpy(ext, def, size);
+    else
+        av_strlcpy(ext, dot, FFMIN(size, end - dot + 1));
+}
+
+static int add_item(AVHLSDownload *d, const HLSMediaRange *range, int64_t duration,
+                    const char *fmt, ...)
+{
+    DownloadItem *item = &d->items[d->nb_items];
+    struct stat st;
+    char *path;
+    va_list ap;
+
+    item->range    = *range;
+    item->duration = duration;
+    va_start(ap, fmt);
+    vsnprintf(item->name, sizeof(item->name), fmt, ap);
+    va_end(ap);
+    av_url_split(NULL, 0, NULL, 0, item->host, sizeof(item->host), NULL, NULL, 0, range->url);
+
+    // complete in an earlier run
+    if (!(path = av_asprintf("%s/%s", d->dir, item->name)))
+        return AVERROR(ENOMEM);
+    if (!stat(path, &st) && (range->size < 0 || st.st_size == range->size)) {
+        item->state  = ITEM_DONE;
+        item->bytes  = st.st_size;
+        d->progress.nb_done++;
+        d->progress.bytes    += st.st_size;
+        d->progress.duration += duration;
+    }
+    av_free(path);
+    if (item->state == ITEM_PENDING)
+        d->nb_pending++;
+    d->progress.nb_files++;
+    return d->nb_items++;
+}
+
+static int add_track(AVHLSDownload *d, DownloadTrack *t, int index)
+{
+    HLSMediaPlaylist *pls    = t->pls;
+    const char       *prefix = pls->is_audio ? "a" : "v";
+    char              ext[8];
+    int               i, j, ret;
+
+    t->segment_items = av_malloc_array(pls->nb_segments, sizeof(*t->segment_items));
+    t->key_items     = av_malloc_array(pls->nb_segments, sizeof(*t->key_items));
+    t->init_items    = av_malloc_array(FFMAX(pls->nb_init_sections, 1), sizeof(*t->init_items));
+    if (!t->segment_items || !t->key_items || !t->init_items)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < pls->nb_init_sections; i++) {
+        url_extension(pls->init_sections[i].url, ".mp4", ext, sizeof(ext));
+        if ((ret = add_item(d, &pls->init_sections[i], 0, "%sinit%d%s", prefix, i, ext)) < 0)
+            return ret;
+        t->init_items[i] = ret;
+    }
+    for (i = 0; i < pls->nb_segments; i++) {
+        HLSMediaSegment *seg = &pls->segments[i];
+
+        t->key_items[i] = -1;
+        if (seg->key_method != HLS_KEY_NONE) {
+            // keys rotate seldom, the one of the segment before is the likely match
+            for (j = i - 1; j >= 0; j--) {
+                if (t->key_items[j] >= 0 && !strcmp(pls->segments[j].key_url, seg->key_url)) {
+                    t->key_items[i] = t->key_items[j];
+                    break;
+                }
+            }
+            if (t->key_items[i] < 0) {
+                HLSMediaRange key = { seg->key_url, 0, -1 };
+
+                if ((ret = add_item(d, &key, 0, "%skey%d.key", prefix, i)) < 0)
+                    return ret;
+                t->key_items[i] = ret;
+            }
+        }
+        url_extension(seg->range.url, ".ts", ext, sizeof(ext));
+        ret = add_item(d, &seg->range, index ? 0 : seg->duration, "%s%d%s",
+                       prefix, pls->start_seq_no + i, ext);
+        if (ret < 0)
+            return ret;
+        t->segment_items[i] = ret;
+        if (!index)
+            d->progress.total_duration += seg->duration;
+    }
+    return 0;
+}
+
+int av_hls_download_open(AVHLSDownload **pd, const char *url, const char *dir,
+                         int max_bandwidth, AVDictionary *options,
+                         const AVIOInterruptCB *int_cb)
+{
+    HLSMediaPlaylist *pls[HLS_MAX_VARIANT_PLAYLISTS];
+    AVHLSDownload    *d;
+    int               nb_items = 0, ret, i;
+
+    *pd = NULL;
+    if (!url || !dir)
+        return AVERROR(EINVAL);
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST)
+        return AVERROR(errno);
+
+    d = av_mallocz(sizeof(*d));
+    if (!d)
+        return AVERROR(ENOMEM);
+    if (int_cb)
+        d->int_cb = *int_cb;
+    if (!(d->dir = av_strdup(dir)) || av_dict_copy(&d->opts, options, 0) < 0) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = ff_hls_load_variant(pls, url, max_bandwidth, options, int_cb)) < 0)
+        goto fail;
+    d->nb_tracks = ret;
+    for (i = 0; i < d->nb_tracks; i++) {
+        d->tracks[i].pls = pls[i];
+        // a key per segment at most
+        nb_items += 2 * pls[i]->nb_segments + pls[i]->nb_init_sections;
+    }
+    d->progress.bandwidth = pls[0]->bandwidth;
+
+    if (!(d->items = av_mallocz_array(nb_items, sizeof(*d->items)))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < d->nb_tracks; i++) {
+        if ((ret = add_track(d, &d->tracks[i], i)) < 0)
+            goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&d->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&d->cond, NULL))) {
+        pthread_mutex_destroy(&d->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    *pd = d;
+    return 0;
+fail:
+    for (i = 0; i < d->nb_tracks; i++) {
+        ff_hls_media_playlist_free(&d->tracks[i].pls);
+        av_freep(&d->tracks[i].segment_items);
+        av_freep(&d->tracks[i].init_items);
+        av_freep(&d->tracks[i].key_items);
+    }
+    av_freep(&d->items);
+    av_dict_free(&d->opts);
+    av_freep(&d->dir);
+    av_freep(&d);
+    return ret;
+}
+
+/* count n bytes written, and wait as long as max_rate requires */
+static int account_bytes(AVHLSDownload *d, DownloadItem *item, int n, int cached)
+{
+    AVIOInterruptCB int_cb = { download_interrupt_cb, d };
+    int64_t wait = 0;
+
+    pthread_mutex_lock(&d->mutex);
+    item->bytes += n;
+    d->progress.bytes += n;
+    if (cached) {
+        d->progress.bytes_cached += n;
+    } else if (d->max_rate > 0) {
+        int64_t now = av_gettime_relative();
+
+        d->rate_bytes += n;
+        wait = d->rate_start + av_rescale(d->rate_bytes, 1000000, d->max_rate) - now;
+        if (wait < -DOWNLOAD_RATE_BURST) {
+            d->rate_start = now;
+            d->rate_bytes = 0;
+        }
+    }
+    pthread_mutex_unlock(&d->mutex);
+
+    while (wait > 0) {
+        if (ff_check_interrupt(&int_cb))
+            return AVERROR_EXIT;
+        av_usleep(FFMIN(wait, DOWNLOAD_WAIT_INTERVAL));
+        wait -= DOWNLOAD_WAIT_INTERVAL;
+    }
+    return 0;
+}
+
+#if CONFIG_CACHE_PROTOCOL
+/* @return 1 if the rest of the range was in the disk cache, 0 if not */
+static int copy_from_cache(AVHLSDownload *d, DownloadItem *item, AVIOContext *out,
+                           uint8_t *buf)
+{
+    DiskCacheFile *file = NULL;
+    int64_t pos = item->range.offset + item->bytes;
+    int64_t end;
+    int ret = 1;
+
+    if (ff_disk_cache_open(&file, item->range.url, NULL) < 0)
+        return 0;
+    end = item->range.size >= 0 ? item->range.offset + item->range.size
+                                : ff_disk_cache_get_size(file);
+    if (end <= pos || ff_disk_cache_available(file, pos) < end - pos) {
+        ff_disk_cache_close(&file);
+        return 0;
+    }
+    while (pos < end) {
+        int n = ff_disk_cache_read(file, pos, buf, FFMIN(DOWNLOAD_IO_SIZE, end - pos));
+
+        if (n <= 0) {
+            ret = n < 0 ? n : AVERROR(EIO);
+            break;
+        }
+        avio_write(out, buf, n);
+        pos += n;
+        if ((ret = account_bytes(d, item, n, 1)) < 0)
+            break;
+        ret = 1;
+    }
+    ff_disk_cache_close(&file);
+    return ret;
+}
+#endif
+
+static int copy_from_url(AVHLSDownload *d, DownloadItem *item, AVIOContext *out,
+                         uint8_t *buf)
+{
+    AVIOInterruptCB int_cb = { download_interrupt_cb, d };
+    AVIOContext    *in     = NULL;
+    AVDictionary   *opts   = NULL;
+    const char     *proto  = avio_find_protocol_name(item->range.url);
+    int64_t         start  = item->range.offset + item->bytes;
+    int             is_http = proto && av_strstart(proto, "http", NULL);
+    int             ret;
+
+    av_dict_copy(&opts, d->opts, 0);
+    av_dict_set(&opts, "seekable", "0", 0);
+    if (is_http && start)
+        av_dict_set_int(&opts, "offset", start, 0);
+    if (is_http && item->range.size >= 0)
+        av_dict_set_int(&opts, "end_offset", item->range.offset + item->range.size, 0);
+    ret = ffio_open_whitelist(&in, item->range.url, AVIO_FLAG_READ, &int_cb, &opts, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        // the server may not take ranges, start over
+        if (item->bytes)
+            item->restart = 1;
+        return ret;
+    }
+    if (!is_http && start && (ret = avio_seek(in, start, SEEK_SET)) < 0)
+        goto end;
+
+    while (item->range.size < 0 || item->bytes < item->range.size) {
+        int size = DOWNLOAD_IO_SIZE;
+
+        if (item->range.size >= 0)
+            size = FFMIN(size, item->range.size - item->bytes);
+        ret = avio_read(in, buf, size);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            goto end;
+        avio_write(out, buf, ret);
+        if ((ret = account_bytes(d, item, ret, 0)) < 0)
+            goto end;
+    }
+    ret = item->range.size >= 0 && item->bytes < item->range.size ? AVERROR(EIO) : 0;
+end:
+    avio_closep(&in);
+    return ret;
+}
+
+static int download_item(AVHLSDownload *d, DownloadItem *item)
+{
+    AVIOInterruptCB int_cb = { download_interrupt_cb, d };
+    AVIOContext    *out    = NULL;
+    AVDictionary   *opts   = NULL;
+    uint8_t        *buf    = av_malloc(DOWNLOAD_IO_SIZE);
+    char           *path   = av_asprintf("%s/%s", d->dir, item->name);
+    char           *part   = av_asprintf("%s/%s.part", d->dir, item->name);
+    struct stat     st;
+    int64_t         have   = 0;
+    int             ret;
+
+    if (!buf || !path || !part) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (!item->restart && !stat(part, &st) &&
+        (item->range.size < 0 || st.st_size <= item->range.size))
+        have = st.st_size;
+    item->restart = 0;
+    pthread_mutex_lock(&d->mutex);
+    d->progress.bytes += have - item->bytes;
+    item->bytes = have;
+    pthread_mutex_unlock(&d->mutex);
+
+    av_dict_set_int(&opts, "truncate", !have, 0);
+    ret = ffio_open_whitelist(&out, part, AVIO_FLAG_WRITE, &int_cb, &opts, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+    if (have && (ret = avio_seek(out, have, SEEK_SET)) < 0)
+        goto end;
+
+    ret = 0;
+#if CONFIG_CACHE_PROTOCOL
+    ret = copy_from_cache(d, item, out, buf);
+#endif
+    if (!ret)
+        ret = copy_from_url(d, item, out, buf);
+    avio_flush(out);
+    if (ret >= 0 && out->error < 0)
+        ret = out->error;
+    avio_closep(&out);
+    if (ret >= 0)
+        ret = ff_rename(part, path, NULL);
+
+end:
+    avio_closep(&out);
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_WARNING, "HLS download of %s failed: %s\n",
+               item->range.url, av_err2str(ret));
+    av_free(part);
+    av_free(path);
+    av_free(buf);
+    return ret < 0 ? ret : 0;
+}
+
+/* the first pending item whose host takes another request, with d->mutex held */
+static DownloadItem *next_item(AVHLSDownload *d)
+{
+    int limit = d->max_rate > 0 ? 1 : d->max_connections;
+    int i, j;
+
+    if (d->nb_running >= limit)
+        return NULL;
+    for (i = 0; i < d->nb_items; i++) {
+        DownloadItem *item = &d->items[i];
+        int host_running = 0;
+
+        if (item->state != ITEM_PENDING)
+            continue;
+        for (j = 0; j < d->nb_items; j++) {
+            if (d->items[j].state == ITEM_RUNNING && !strcmp(d->items[j].host, item->host))
+                host_running++;
+        }
+        if (host_running < d->max_per_host)
+            return item;
+    }
+    return NULL;
+}
+
+static void *download_worker(void *arg)
+{
+    AVHLSDownload *d = arg;
+
+    pthread_mutex_lock(&d->mutex);
+    while (!d->abort_request && d->nb_pending) {
+        DownloadItem *item = next_item(d);
+        int ret;
+
+        if (!item) {
+            int64_t         t  = av_gettime() + DOWNLOAD_WAIT_INTERVAL;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+
+            if (ff_check_interrupt(&d->int_cb)) {
+                d->error         = AVERROR_EXIT;
+                d->abort_request = 1;
+                break;
+            }
+            pthread_cond_timedwait(&d->cond, &d->mutex, &tv);
+            continue;
+        }
+
+        item->state = ITEM_RUNNING;
+        d->nb_running++;
+        d->nb_pending--;
+        pthread_mutex_unlock(&d->mutex);
+
+        ret = download_item(d, item);
+
+        pthread_mutex_lock(&d->mutex);
+        d->nb_running--;
+        if (ret >= 0) {
+            item->state = ITEM_DONE;
+            d->progress.nb_done++;
+            d->progress.duration += item->duration;
+        } else {
+            // left for the next run once out of attempts
+            item->state = ITEM_PENDING;
+            d->nb_pending++;
+            if (ret == AVERROR_EXIT || ++item->attempts >= DOWNLOAD_MAX_ATTEMPTS) {
+                item->attempts = 0;
+                if (!d->error)
+                    d->error = ret;
+                d->abort_request = 1;
+            }
+        }
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->mutex);
+    return NULL;
+}
+
+/* written aside and renamed, a reader never sees half of it */
+static int write_text(AVHLSDownload *d, const char *name, AVBPrint *text)
+{
+    AVIOContext *out  = NULL;
+    char        *path = av_asprintf("%s/%s", d->dir, name);
+    char        *tmp  = av_asprintf("%s/%s.tmp", d->dir, name);
+    int          ret;
+
+    if (!path || !tmp || !av_bprint_is_complete(text)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = ffio_open_whitelist(&out, tmp, AVIO_FLAG_WRITE, &d->int_cb, NULL, NULL, NULL)) < 0)
+        goto end;
+    avio_write(out, (const uint8_t *)text->str, text->len);
+    avio_flush(out);
+    ret = out->error;
+    avio_closep(&out);
+    if (ret >= 0)
+        ret = ff_rename(tmp, path, NULL);
+end:
+    av_free(tmp);
+    av_free(path);
+    return ret;
+}
+
+static int write_media_playlist(AVHLSDownload *d, DownloadTrack *t, const char *name)
+{
+    static const char *const methods[] = { "NONE", "AES-128", "SAMPLE-AES" };
+    HLSMediaPlaylist *pls    = t->pls;
+    int64_t           target = pls->target_duration;
+    const uint8_t    *iv     = NULL;
+    int               init   = -1, key = -1;
+    AVBPrint          bp;
+    int               i, ret;
+
+    for (i = 0; i < pls->nb_segments; i++)
+        target = FFMAX(target, pls->segments[i].duration);
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "#EXTM3U\n#EXT-X-VERSION:%d\n#EXT-X-TARGETDURATION:%d\n"
+               "#EXT-X-MEDIA-SEQUENCE:%d\n#EXT-X-PLAYLIST-TYPE:VOD\n",
+               pls->nb_init_sections ? 6 : 3,
+               (int)((target + AV_TIME_BASE - 1) / AV_TIME_BASE), pls->start_seq_no);
+    for (i = 0; i < pls->nb_segments; i++) {
+        HLSMediaSegment *seg = &pls->segments[i];
+
+        if (seg->discontinuity)
+            av_bprintf(&bp, "#EXT-X-DISCONTINUITY\n");
+        if (seg->init_section >= 0 && seg->init_section != init) {
+            init = seg->init_section;
+            av_bprintf(&bp, "#EXT-X-MAP:URI=\"%s\"\n", d->items[t->init_items[init]].name);
+        }
+        // the iv of every segment is explicit, the sequence numbers are not kept
+        if (t->key_items[i] != key || (key >= 0 && memcmp(iv, seg->iv, sizeof(seg->iv)))) {
+            key = t->key_items[i];
+            iv  = seg->iv;
+            if (key < 0) {
+                av_bprintf(&bp, "#EXT-X-KEY:METHOD=NONE\n");
+            } else {
+                char hex[33];
+
+                ff_data_to_hex(hex, seg->iv, sizeof(seg->iv), 0);
+                hex[32] = '\0';
+                av_bprintf(&bp, "#EXT-X-KEY:METHOD=%s,URI=\"%s\",IV=0x%s\n",
+                           methods[seg->key_method], d->items[key].name, hex);
+            }
+        }
+        av_bprintf(&bp, "#EXTINF:%.3f,\n%s\n", seg->duration / (double)AV_TIME_BASE,
+                   d->items[t->segment_items[i]].name);
+    }
+    av_bprintf(&bp, "#EXT-X-ENDLIST\n");
+
+    ret = write_text(d, name, &bp);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+static int write_playlists(AVHLSDownload *d)
+{
+    AVBPrint bp;
+    int ret;
+
+    if (d->nb_tracks == 1)
+        return write_media_playlist(d, &d->tracks[0], AV_HLS_DOWNLOAD_PLAYLIST);
+
+    if ((ret = write_media_playlist(d, &d->tracks[0], "video.m3u8")) < 0 ||
+        (ret = write_media_playlist(d, &d->tracks[1], "audio.m3u8")) < 0)
+        return ret;
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "#EXTM3U\n"
+               "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"audio\",NAME=\"audio\",DEFAULT=YES,AUTOSELECT=YES,URI=\"audio.m3u8\"\n"
+               "#EXT-X-STREAM-INF:BANDWIDTH=%d,AUDIO=\"audio\"\n"
+               "video.m3u8\n", FFMAX(d->tracks[0].pls->bandwidth, 1));
+    ret = write_text(d, AV_HLS_DOWNLOAD_PLAYLIST, &bp);
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
+
+int av_hls_download_run(AVHLSDownload *d, int max_connections, int max_per_host)
+{
+    pthread_t workers[DOWNLOAD_MAX_WORKERS];
+    int nb_workers = 0, ret = 0, i;
+
+    max_connections = av_clip(max_connections, 1, DOWNLOAD_MAX_WORKERS);
+
+    pthread_mutex_lock(&d->mutex);
+    d->max_connections = max_connections;
+    d->max_per_host    = max_per_host > 0 ? max_per_host : max_connections;
+    d->error           = 0;
+    d->abort_request   = 0;
+    pthread_mutex_unlock(&d->mutex);
+
+    for (i = 0; i < max_connections; i++) {
+        if ((ret = pthread_create(&workers[nb_workers], NULL, download_worker, d))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            break;
+        }
+        nb_workers++;
+    }
+    for (i = 0; i < nb_workers; i++)
+        pthread_join(workers[i], NULL);
+    if (!nb_workers)
+        return AVERROR(ret);
+
+    if (d->error < 0)
+        return d->error;
+    if (d->nb_pending)
+        return AVERROR_EXIT;
+    return write_playlists(d);
+}
+
+void av_hls_download_set_rate(AVHLSDownload *d, int64_t max_rate)
+{
+    pthread_mutex_lock(&d->mutex);
+    if (d->max_rate != max_rate) {
+        d->max_rate   = FFMAX(max_rate, 0);
+        d->rate_start = av_gettime_relative();
+        d->rate_bytes = 0;
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->mutex);
+}
+
+void av_hls_download_get_progress(AVHLSDownload *d, AVHLSDownloadProgress *progress)
+{
+    pthread_mutex_lock(&d->mutex);
+    *progress = d->progress;
+    pthread_mutex_unlock(&d->mutex);
+}
+
+void av_hls_download_close(AVHLSDownload **pd)
+{
+    AVHLSDownload *d = *pd;
+    int i;
+
+    if (!d)
+        return;
+    for (i = 0; i < d->nb_tracks; i++) {
+        ff_hls_media_playlist_free(&d->tracks[i].pls);
+        av_freep(&d->tracks[i].segment_items);
+        av_freep(&d->tracks[i].init_items);
+        av_freep(&d->tracks[i].key_items);
+    }
+    pthread_cond_destroy(&d->cond);
+    pthread_mutex_destroy(&d->mutex);
+    av_freep(&d->items);
+    av_dict_free(&d->opts);
+    av_freep(&d->dir);
+    av_freep(pd);
+}
+
+#else
+
+int av_hls_download_open(AVHLSDownload **pd, const char *url, const char *dir,
+                         int max_bandwidth, AVDictionary *options,
+                         const AVIOInterruptCB *int_cb)
+{
+    *pd = NULL;
+    return AVERROR(ENOSYS);
+}
+
+int av_hls_download_run(AVHLSDownload *d, int max_connections, int max_per_host)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_hls_download_set_rate(AVHLSDownload *d, int64_t max_rate)
+{
+}
+
+void av_hls_download_get_progress(AVHLSDownload *d, AVHLSDownloadProgress *progress)
+{
+    memset(progress, 0, sizeof(*progress));
+}
+
+void av_hls_download_close(AVHLSDownload **pd)
+{
+}
+
+#endif
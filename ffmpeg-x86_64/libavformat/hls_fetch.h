@@ -0,0 +1,93 @@
+/*
+ * Concurrent download of HLS playlists
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_FETCH_H
+#define AVFORMAT_HLS_FETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avio.h"
+
+/**
+ * A playlist downloaded whole into memory on a thread of its own, so that
+ * the media playlists of a master playlist are in flight at once instead
+ * of one round trip after the other. Everything except the thread runs on
+ * the demuxer thread.
+ */
+typedef struct HLSFetch HLSFetch;
+
+/**
+ * @param opts   options for ffio_open_whitelist(), copied
+ * @param int_cb interrupt callback of the demuxer, checked by the thread
+ *               as well
+ * @return 0 on success, a negative AVERROR otherwise (AVERROR(ENOSYS)
+ *         without thread support)
+ */
+int  ff_hls_fetch_start(HLSFetch **pf, const char *url, AVDictionary *opts,
+                        const AVIOInterruptCB *int_cb,
+                        const char *whitelist, const char *blacklist);
+
+/**
+ * Abort the download if it is still running and free the fetch.
+ */
+void ff_hls_fetch_freep(HLSFetch **pf);
+
+const char *ff_hls_fetch_url(HLSFetch *f);
+
+/**
+ * Wait for the download to end.
+ *
+ * @param pb set to a context reading the body, freed with the fetch
+ * @return 0 on success, the error the download failed with, or
+ *         AVERROR_EXIT if interrupted
+ */
+int  ff_hls_fetch_wait(HLSFetch *f, AVIOContext **pb);
+
+/**
+ * @param name "location", "etag" or "last_modified"
+ * @return the value of the response, NULL if it has none
+ */
+const char *ff_hls_fetch_get(HLSFetch *f, const char *name);
+
+/**
+ * Remember the media playlist played last from a master playlist, for
+ * the next session to fetch it before the master is parsed.
+ */
+void ff_hls_fetch_remember(const char *master_url, const char *url);
+
+/**
+ * @return 1 and the url of the media playlist remembered for master_url,
+ *         0 if none is
+ */
+int  ff_hls_fetch_recall(const char *master_url, char *url, int url_size);
+
+/**
+ * Keep the 16 bytes of the AES-128 key at url for the sessions to come.
+ */
+void ff_hls_fetch_store_key(const char *url, const uint8_t *key);
+
+/**
+ * @param max_age in microseconds, an older key is dropped
+ * @return 1 and the key stored for url, 0 if none is
+ */
+int  ff_hls_fetch_lookup_key(const char *url, uint8_t *key, int64_t max_age);
+
+#endif /* AVFORMAT_HLS_FETCH_H */
@@ -0,0 +1,320 @@
+/*
+ * HTTP/3 requests through the transport of the application
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "http3.h"
+
+#define H3_MAX_HEAD         (64 * 1024)
+#define H3_WAIT_INTERVAL    100000      // a waiting reader checks for an interrupt this often
+
+struct AVHTTP3Request {
+    AVIOInterruptCB         int_cb;
+    AVApplicationContext   *app_ctx;
+    void                   *handle;         // of the transport, once sent
+    char                    host[1024];
+
+    pthread_mutex_t         mutex;
+    pthread_cond_t          cond;
+    unsigned                generation;     // bumped by av_http3_request_ready()
+
+    char                   *head;           // the response head as HTTP/1.1, until read
+    int                     head_size;
+    int                     head_pos;
+    int                     head_done;
+};
+
+static pthread_mutex_t              transport_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AVHTTP3TransportCallbacks    transport;
+static void                        *transport_opaque;
+static int                          transport_registered;
+
+int av_http3_register_transport(const AVHTTP3TransportCallbacks *cb, void *opaque)
+{
+    int ret = 0;
+
+    if (!cb || !cb->open || !cb->read_head || !cb->read || !cb->close)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&transport_mutex);
+    if (transport_registered) {
+        ret = AVERROR(EEXIST);
+    } else {
+        transport            = *cb;
+        transport_opaque     = opaque;
+        transport_registered = 1;
+    }
+    pthread_mutex_unlock(&transport_mutex);
+    return ret;
+}
+
+void av_http3_request_ready(AVHTTP3Request *st)
+{
+    if (!st)
+        return;
+
+    pthread_mutex_lock(&st->mutex);
+    st->generation++;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->mutex);
+}
+
+int ff_http3_open(HTTP3Stream **pstream, const AVIOInterruptCB *int_cb,
+                  AVApplicationContext *app_ctx)
+{
+    HTTP3Stream *st;
+    int registered;
+
+    *pstream = NULL;
+    // registered once, never changed afterwards
+    pthread_mutex_lock(&transport_mutex);
+    registered = transport_registered;
+    pthread_mutex_unlock(&transport_mutex);
+    if (!registered)
+        return AVERROR(ENOPROTOOPT);
+
+    st = av_mallocz(sizeof(*st));
+    if (!st)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&st->mutex, NULL)) {
+        av_free(st);
+        return AVERROR(ENOMEM);
+    }
+    if (pthread_cond_init(&st->cond, NULL)) {
+        pthread_mutex_destroy(&st->mutex);
+        av_free(st);
+        return AVERROR(ENOMEM);
+    }
+    if (int_cb)
+        st->int_cb = *int_cb;
+    st->app_ctx = app_ctx;
+
+    *pstream = st;
+    return 0;
+}
+
+/* hop by hop fields, and Host which is in the url */
+static int h3_skip_field(const char *name)
+{
+    static const char *const skipped[] = {
+        "connection", "keep-alive", "proxy-connection", "transfer-encoding",
+        "upgrade", "te", "host",
+    };
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(skipped); i++) {
+        if (!av_strcasecmp(name, skipped[i]))
+            return 1;
+    }
+    return 0;
+}
+
+int ff_http3_send_request(HTTP3Stream *st, const char *request)
+{
+    char       *copy = av_strdup(request);
+    char       *line, *next, *method, *path, *host = NULL;
+    AVBPrint    url, headers;
+    int         ret = AVERROR_INVALIDDATA;
+
+    if (!copy)
+        return AVERROR(ENOMEM);
+    if (st->handle) {
+        av_free(copy);
+        return AVERROR(EINVAL);
+    }
+    av_bprint_init(&url, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&headers, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    // request line
+    next = strstr(copy, "\r\n");
+    if (!next)
+        goto end;
+    *next  = '\0';
+    next  += 2;
+    method = copy;
+    path   = strchr(method, ' ');
+    if (!path)
+        goto end;
+    *path++ = '\0';
+    line    = strchr(path, ' ');
+    if (!line)
+        goto end;
+    *line = '\0';
+
+    for (line = next; *line; line = next) {
+        char *value;
+
+        next = strstr(line, "\r\n");
+        if (!next)
+            goto end;
+        *next  = '\0';
+        next  += 2;
+        if (!*line)
+            break;      // the blank line ending the head
+        value  = strchr(line, ':');
+        if (!value)
+            goto end;
+        *value++ = '\0';
+        value   += strspn(value, " \t");
+
+        if (!av_strcasecmp(line, "host"))
+            host = value;
+        if (!h3_skip_field(line))
+            av_bprintf(&headers, "%s: %s\r\n", line, value);
+    }
+    if (!host || *path != '/')
+        goto end;
+    av_bprintf(&url, "https://%s%s", host, path);
+    if (!av_bprint_is_complete(&url) || !av_bprint_is_complete(&headers)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    av_strlcpy(st->host, host, sizeof(st->host));
+
+    ret = transport.open(transport_opaque, st, method, url.str, headers.str, &st->handle);
+    if (ret < 0)
+        st->handle = NULL;
+
+end:
+    av_bprint_finalize(&url, NULL);
+    av_bprint_finalize(&headers, NULL);
+    av_free(copy);
+    return ret;
+}
+
+/* wait for av_http3_request_ready() past generation, or an interrupt */
+static int h3_wait(HTTP3Stream *st, unsigned generation)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&st->mutex);
+    while (st->generation == generation) {
+        int64_t         t = av_gettime() + H3_WAIT_INTERVAL;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+
+        if (ff_check_interrupt(&st->int_cb)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_timedwait(&st->cond, &st->mutex, &tv);
+    }
+    pthread_mutex_unlock(&st->mutex);
+
+    return ret;
+}
+
+/* the response head goes to the stream as HTTP/1.1 would have it */
+static int h3_read_head(HTTP3Stream *st)
+{
+    char *fields = av_malloc(H3_MAX_HEAD);
+    int   status = 0, ret;
+
+    if (!fields)
+        return AVERROR(ENOMEM);
+    ret = transport.read_head(transport_opaque, st->handle, &status, fields, H3_MAX_HEAD);
+    if (ret >= 0) {
+        fields[H3_MAX_HEAD - 1] = '\0';
+        st->head = av_asprintf("HTTP/3 %03d\r\n%s\r\n", status, fields);
+        if (!st->head)
+            ret = AVERROR(ENOMEM);
+        else
+            st->head_size = strlen(st->head);
+    }
+    av_free(fields);
+    return ret;
+}
+
+int ff_http3_read(HTTP3Stream *st, uint8_t *buf, int size)
+{
+    unsigned generation;
+    int      ret;
+
+    if (!st->handle)
+        return AVERROR(EINVAL);
+
+    for (;;) {
+        if (st->head_done) {
+            pthread_mutex_lock(&st->mutex);
+            generation = st->generation;
+            pthread_mutex_unlock(&st->mutex);
+
+            ret = transport.read(transport_opaque, st->handle, buf, size);
+            if (ret > 0)
+                av_application_did_io_tcp_read(st->app_ctx, st, ret);
+            if (ret != AVERROR(EAGAIN))
+                return ret ? ret : AVERROR_EOF;
+        } else if (st->head) {
+            ret = FFMIN(size, st->head_size - st->head_pos);
+            memcpy(buf, st->head + st->head_pos, ret);
+            st->head_pos += ret;
+            if (st->head_pos == st->head_size) {
+                av_freep(&st->head);
+                st->head_done = 1;
+            }
+            return ret;
+        } else {
+            pthread_mutex_lock(&st->mutex);
+            generation = st->generation;
+            pthread_mutex_unlock(&st->mutex);
+
+            ret = h3_read_head(st);
+            if (ret >= 0)
+                continue;
+            if (ret != AVERROR(EAGAIN))
+                return ret;
+        }
+        if ((ret = h3_wait(st, generation)) < 0)
+            return ret;
+    }
+}
+
+void ff_http3_close(HTTP3Stream **pstream)
+{
+    HTTP3Stream *st = *pstream;
+
+    if (!st)
+        return;
+    *pstream = NULL;
+
+    if (st->handle) {
+        AVHTTP3ConnectionStats stats = { { 0 } };
+        AVAppHttp3Statistic    event = { 0 };
+
+        transport.close(transport_opaque, st->handle, &stats);
+        event.size         = sizeof(event);
+        event.reused       = stats.reused;
+        event.connect_time = stats.connect_time;
+        event.request_time = stats.request_time;
+        event.bytes        = stats.bytes;
+        av_strlcpy(event.host, st->host, sizeof(event.host));
+        av_strlcpy(event.protocol, stats.protocol, sizeof(event.protocol));
+        av_strlcpy(event.remote_ip, stats.remote_ip, sizeof(event.remote_ip));
+        av_application_on_http3_statistic(st->app_ctx, &event);
+    }
+    av_free(st->head);
+    pthread_cond_destroy(&st->cond);
+    pthread_mutex_destroy(&st->mutex);
+    av_free(st);
+}
@@ -0,0 +1,71 @@
+/*
+ * HTTP/3 requests through the transport of the application
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP3_H
+#define AVFORMAT_HTTP3_H
+
+#include <stdint.h>
+
+#include "libavutil/application.h"
+#include "http3transport.h"
+#include "url.h"
+
+/**
+ * One request through the HTTP/3 transport of the application, see
+ * http3transport.h. Like an HTTP/2 stream it speaks HTTP/1.1 to its
+ * caller, so http.c keeps its logic: the request head it would have
+ * written is handed to the transport as a url and header lines, and the
+ * response head is read back as an HTTP/1.1 status line and header lines,
+ * followed by the body.
+ */
+typedef struct AVHTTP3Request HTTP3Stream;
+
+/**
+ * @param int_cb  copied, checked while waiting for the transport
+ * @param app_ctx told the stats of the connection and the traffic, may be NULL
+ * @return 0, AVERROR(ENOPROTOOPT) if no transport is registered, another
+ *         negative AVERROR on failure
+ */
+int ff_http3_open(HTTP3Stream **pstream, const AVIOInterruptCB *int_cb,
+                  AVApplicationContext *app_ctx);
+
+/**
+ * Send the request, once per stream.
+ *
+ * @param request an HTTP/1.1 request head without a body, up to the blank
+ *                line, to an https origin; hop by hop header fields are
+ *                dropped
+ */
+int ff_http3_send_request(HTTP3Stream *stream, const char *request);
+
+/**
+ * Read the response: the head, then the body.
+ *
+ * @return the number of bytes read, AVERROR_EOF at the end of the
+ *         response, a negative AVERROR if the request failed
+ */
+int ff_http3_read(HTTP3Stream *stream, uint8_t *buf, int size);
+
+/**
+ * Close the stream, cancelling the response if it is not over.
+ */
+void ff_http3_close(HTTP3Stream **pstream);
+
+#endif /* AVFORMAT_HTTP3_H */
@@ -0,0 +1,83 @@
+/*
+ * Racing and failover between mirrors of an http resource
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP_MIRROR_H
+#define AVFORMAT_HTTP_MIRROR_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "url.h"
+
+/**
+ * Mirrors are origins ("https://host[:port]") serving the same paths. A
+ * request to any of them can go to another: it is opened on the best two
+ * at once and continues on the one whose response head comes first, the
+ * other one is left to finish its open in the background, to be measured,
+ * and is closed, at the latest when the one opened is.
+ *
+ * Every open adds to a score per origin kept by the process: the mean time
+ * to the response head, its weight halving every MIRROR_HALF_LIFE, and the
+ * failures, which fade the same way. An origin never measured ranks first,
+ * so each one gets tried.
+ */
+
+#define MIRROR_HALF_LIFE        (120 * 1000000LL)
+#define MIRROR_MAX_CANDIDATES   8
+
+/**
+ * The url on each origin of the set made of its own and mirrors, best
+ * first.
+ *
+ * @param mirrors origins separated by '|', the one of url among them or not
+ * @param urls    filled with up to MIRROR_MAX_CANDIDATES urls, to be freed
+ *                with av_free() each
+ * @return the number of urls, 0 if url is not an http one
+ */
+int ff_http_mirror_rank(const char *url, const char *mirrors, char **urls);
+
+/**
+ * The time to the response head of a request to the origin of url, or its
+ * failure if error is set.
+ */
+void ff_http_mirror_report(const char *url, int64_t elapsed, int error);
+
+/**
+ * Open the first nb_racers of urls at once, each with a copy of options,
+ * and return the first one to open.
+ *
+ * @param puc     set to the one opened, to be closed with
+ *                ff_http_mirror_race_release()
+ * @param winner  set to the index of the url opened
+ * @param int_cb  checked while racing and by the one opened; not by the
+ *                ones left to finish
+ * @return 0, or the error of the last one to fail
+ */
+int ff_http_mirror_race(URLContext **puc, int *winner, char **urls, int nb_racers,
+                        int flags, const AVIOInterruptCB *int_cb, AVDictionary *options,
+                        const char *whitelist, const char *blacklist);
+
+/**
+ * Close a context opened by ff_http_mirror_race() and set it to NULL, once
+ * the ones left to finish are closed.
+ */
+void ff_http_mirror_race_release(URLContext **puc);
+
+#endif /* AVFORMAT_HTTP_MIRROR_H */
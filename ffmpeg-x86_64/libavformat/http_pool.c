@@ -0,0 +1,268 @@
+/*
+ * Process wide pool of persistent HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "http_pool.h"
+#include "network.h"
+#if HAVE_POLL_H
+#include <poll.h>
+#endif
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#define HTTP_POOL_MAX_IDLE 16
+
+#if HAVE_PTHREADS
+static pthread_mutex_t http_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define http_pool_lock()    pthread_mutex_lock(&http_pool_mutex)
+#define http_pool_unlock()  pthread_mutex_unlock(&http_pool_mutex)
+#else
+#define http_pool_lock()
+#define http_pool_unlock()
+#endif
+
+static HTTPPoolConnection *http_pool_idle;
+static HTTPPoolStatistic   http_pool_stat;
+
+static int http_pool_interrupt_cb(void *opaque)
+{
+    HTTPPoolConnection *conn = opaque;
+    return ff_check_interrupt(&conn->owner_int_cb);
+}
+
+static int http_pool_on_app_event(AVApplicationContext *h, int event_type, void *obj, size_t size)
+{
+    HTTPPoolConnection   *conn  = h->opaque;
+    AVApplicationContext *owner = conn->owner_app_ctx;
+
+    if (owner && owner->func_on_app_event)
+        return owner->func_on_app_event(owner, event_type, obj, size);
+    return 0;
+}
+
+static void http_pool_connection_free(HTTPPoolConnection **pconn)
+{
+    HTTPPoolConnection *conn = *pconn;
+
+    if (!conn)
+        return;
+
+    // the owner may be going away, close() must not call back into it
+    conn->owner_int_cb.callback = NULL;
+    conn->owner_app_ctx         = NULL;
+    if (conn->hd)
+        ffurl_closep(&conn->hd);
+    av_application_closep(&conn->app_ctx);
+    av_freep(&conn->key);
+    av_freep(pconn);
+}
+
+// an idle connection must not be readable: pending data or EOF means the
+// server has given up on it
+static int http_pool_connection_alive(HTTPPoolConnection *conn)
+{
+    struct pollfd p = { 0 };
+
+    p.fd = ffurl_get_file_handle(conn->hd);
+    if (p.fd < 0)
+        return 1;
+    p.events = POLLIN;
+    return poll(&p, 1, 0) == 0;
+}
+
+// take the expired connections out of the idle list, must be called locked
+static HTTPPoolConnection *http_pool_collect_expired_locked(int64_t now)
+{
+    HTTPPoolConnection **pp      = &http_pool_idle;
+    HTTPPoolConnection  *expired = NULL;
+
+    while (*pp) {
+        HTTPPoolConnection *conn = *pp;
+        if (conn->expire_time <= now) {
+            *pp        = conn->next;
+            conn->next = expired;
+            expired    = conn;
+            http_pool_stat.idle--;
+        } else {
+            pp = &conn->next;
+        }
+    }
+    return expired;
+}
+
+static void http_pool_free_list(HTTPPoolConnection *list)
+{
+    while (list) {
+        HTTPPoolConnection *next = list->next;
+        http_pool_connection_free(&list);
+        list = next;
+    }
+}
+
+// newest first, it is the least likely to be closed by the server;
+// must be called locked
+static HTTPPoolConnection *http_pool_take_idle_locked(const char *url)
+{
+    HTTPPoolConnection **pp;
+
+    for (pp = &http_pool_idle; *pp; pp = &(*pp)->next) {
+        if (!strcmp((*pp)->key, url)) {
+            HTTPPoolConnection *conn = *pp;
+            *pp        = conn->next;
+            conn->next = NULL;
+            http_pool_stat.idle--;
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+int ff_http_pool_open(HTTPPoolConnection **pconn, const char *url, int allow_reuse,
+                      const AVIOInterruptCB *int_cb, AVApplicationContext *app_ctx,
+                      AVDictionary **options,
+                      const char *whitelist, const char *blacklist,
+                      URLContext *parent)
+{
+    HTTPPoolConnection *conn = NULL;
+    HTTPPoolConnection *dead;
+    AVIOInterruptCB     pool_int_cb;
+    int ret;
+
+    http_pool_lock();
+    dead = http_pool_collect_expired_locked(av_gettime_relative());
+    if (allow_reuse)
+        conn = http_pool_take_idle_locked(url);
+    http_pool_unlock();
+    http_pool_free_list(dead);
+
+    while (conn && !http_pool_connection_alive(conn)) {
+        http_pool_connection_free(&conn);
+        http_pool_lock();
+        conn = http_pool_take_idle_locked(url);
+        http_pool_unlock();
+    }
+
+    if (conn) {
+        conn->owner_int_cb  = int_cb ? *int_cb : (AVIOInterruptCB){ NULL };
+        conn->owner_app_ctx = app_ctx;
+        http_pool_lock();
+        http_pool_stat.reused++;
+        http_pool_unlock();
+        *pconn = conn;
+        return 1;
+    }
+
+    conn = av_mallocz(sizeof(*conn));
+    if (!conn)
+        return AVERROR(ENOMEM);
+    conn->key = av_strdup(url);
+    if (!conn->key) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ret = av_application_alloc(&conn->app_ctx, conn);
+    if (ret < 0)
+        goto fail;
+    conn->app_ctx->func_on_app_event = http_pool_on_app_event;
+    conn->owner_int_cb  = int_cb ? *int_cb : (AVIOInterruptCB){ NULL };
+    conn->owner_app_ctx = app_ctx;
+
+    pool_int_cb.callback = http_pool_interrupt_cb;
+    pool_int_cb.opaque   = conn;
+    av_dict_set_int(options, "ijkapplication", (int64_t)(intptr_t)conn->app_ctx, 0);
+    ret = ffurl_open_whitelist(&conn->hd, url, AVIO_FLAG_READ_WRITE,
+                               &pool_int_cb, options,
+                               whitelist, blacklist, parent);
+    if (ret < 0)
+        goto fail;
+
+    http_pool_lock();
+    http_pool_stat.opened++;
+    http_pool_unlock();
+    *pconn = conn;
+    return 0;
+fail:
+    http_pool_connection_free(&conn);
+    return ret;
+}
+
+void ff_http_pool_release(HTTPPoolConnection **pconn, int reusable,
+                          int max_idle_per_host, int64_t idle_timeout)
+{
+    HTTPPoolConnection  *conn = *pconn;
+    HTTPPoolConnection  *dead = NULL;
+    HTTPPoolConnection **pp, **poldest = NULL;
+    int64_t now = av_gettime_relative();
+    int same_host = 0;
+
+    if (!conn)
+        return;
+    *pconn = NULL;
+
+    if (!reusable || max_idle_per_host <= 0 || idle_timeout <= 0) {
+        http_pool_connection_free(&conn);
+        return;
+    }
+
+    conn->owner_int_cb.callback = NULL;
+    conn->owner_app_ctx         = NULL;
+    conn->expire_time           = now + idle_timeout;
+
+    http_pool_lock();
+    dead = http_pool_collect_expired_locked(now);
+    for (pp = &http_pool_idle; *pp; pp = &(*pp)->next) {
+        if (!strcmp((*pp)->key, conn->key))
+            same_host++;
+    }
+    if (same_host >= max_idle_per_host) {
+        conn->next = dead;
+        dead       = conn;
+    } else {
+        if (http_pool_stat.idle >= HTTP_POOL_MAX_IDLE) {
+            // the list is newest first, drop the oldest
+            for (pp = &http_pool_idle; *pp; pp = &(*pp)->next)
+                poldest = pp;
+            if (poldest) {
+                HTTPPoolConnection *oldest = *poldest;
+                *poldest     = NULL;
+                oldest->next = dead;
+                dead         = oldest;
+                http_pool_stat.idle--;
+            }
+        }
+        conn->next     = http_pool_idle;
+        http_pool_idle = conn;
+        http_pool_stat.idle++;
+    }
+    http_pool_unlock();
+    http_pool_free_list(dead);
+}
+
+void ff_http_pool_get_statistic(HTTPPoolStatistic *stat)
+{
+    http_pool_lock();
+    *stat = http_pool_stat;
+    http_pool_unlock();
+}
@@ -59,7 +59,7 @@ static int ijkdummy_open(URLContext *h, const char *arg, int flags, AVDictionary
 }
 
 IJK_FF_PROTOCOL(async);
-IJK_DUMMY_PROTOCOL(ijkmediadatasource);
+IJK_FF_PROTOCOL(ijkmediadatasource);
 IJK_DUMMY_PROTOCOL(ijkhttphook);
 IJK_DUMMY_PROTOCOL(ijklongurl);
 IJK_DUMMY_PROTOCOL(ijksegment);
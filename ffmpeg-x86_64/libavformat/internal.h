@@ -178,6 +178,18 @@ struct AVStreamInternal {
 
     enum AVCodecID orig_codec_id;
 
+    /**
+     * Set by the demuxer if its keyframes are exactly the IDR (IRAP) pictures
+     * of the stream, see AVFMT_FLAG_TRUST_KEYFRAMES.
+     */
+    int trusted_keyframes;
+
+    /**
+     * With trusted_keyframes, the AVSTREAM_PARSE_HEADERS parser has seen a
+     * keyframe since the codec parameters last changed, and is skipped.
+     */
+    int headers_parsed;
+
     /**
      * Whether the internal avctx needs to be updated from codecpar (after a late change to codecpar)
      */
@@ -213,6 +225,13 @@ char *ff_data_to_hex(char *buf, const uint8_t *src, int size, int lowercase);
  */
 int ff_hex_to_data(uint8_t *data, const char *p);
 
+/**
+ * Register the (de)muxers av_register_allow_list() left out, once.
+ *
+ * @return 1 if some may have been registered since the caller looked
+ */
+int ff_format_register_rest(void);
+
 /**
  * Add packet to AVFormatContext->packet_buffer list, determining its
  * interleaved position using compare() function argument.
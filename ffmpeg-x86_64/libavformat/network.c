@@ -23,6 +23,7 @@
 #include "tls.h"
 #include "url.h"
 #include "libavcodec/internal.h"
+#include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
 #include "libavutil/mem.h"
 #include "libavutil/time.h"
@@ -280,6 +281,218 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
     return ret;
 }
 
+// reorder the list as v6, v4, v6, v4, ... starting with the family of
+// the first entry, keeping the resolver order inside each family
+static void interleave_addrinfo(struct addrinfo *base)
+{
+    struct addrinfo **next = &base->ai_next;
+    int family = base->ai_family;
+
+    while (*next) {
+        struct addrinfo **cur;
+
+        for (cur = next; *cur; cur = &(*cur)->ai_next) {
+            if ((*cur)->ai_family != family)
+                break;
+        }
+        if (!*cur)
+            break;
+
+        if (cur != next) {
+            struct addrinfo *ai = *cur;
+            *cur        = ai->ai_next;
+            ai->ai_next = *next;
+            *next       = ai;
+        }
+        family = (*next)->ai_family;
+        next   = &(*next)->ai_next;
+    }
+}
+
+typedef struct ConnectionAttempt {
+    int              fd;
+    int64_t          deadline;
+    struct addrinfo *addr;
+} ConnectionAttempt;
+
+// < 0 on error, 0 if the attempt is in progress, > 0 if already connected
+static int start_connect_attempt(ConnectionAttempt *attempt, struct addrinfo *ai,
+                                 int timeout_ms, URLContext *h,
+                                 void (*customize_fd)(void *, int), void *customize_ctx)
+{
+    int ret;
+
+    attempt->fd = ff_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (attempt->fd < 0)
+        return ff_neterrno();
+    attempt->deadline = av_gettime_relative() + (int64_t)timeout_ms * 1000;
+    attempt->addr     = ai;
+
+    if (ff_socket_nonblock(attempt->fd, 1) < 0)
+        av_log(NULL, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
+
+    if (customize_fd)
+        customize_fd(customize_ctx, attempt->fd);
+
+    while ((ret = connect(attempt->fd, ai->ai_addr, ai->ai_addrlen))) {
+        ret = ff_neterrno();
+        switch (ret) {
+        case AVERROR(EINTR):
+            if (ff_check_interrupt(&h->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                goto fail;
+            }
+            continue;
+        case AVERROR(EINPROGRESS):
+        case AVERROR(EAGAIN):
+            return 0;
+        default:
+            goto fail;
+        }
+    }
+    return 1;
+fail:
+    closesocket(attempt->fd);
+    attempt->fd = -1;
+    return ret;
+}
+
+static void log_connect_attempt(URLContext *h, int level, const struct addrinfo *ai,
+                                const char *what, int err)
+{
+    char hostbuf[100], portbuf[20], errbuf[100] = "";
+
+    if (av_log_get_level() < level)
+        return;
+
+    if (getnameinfo(ai->ai_addr, ai->ai_addrlen, hostbuf, sizeof(hostbuf),
+                    portbuf, sizeof(portbuf), NI_NUMERICHOST | NI_NUMERICSERV)) {
+        av_strlcpy(hostbuf, "?", sizeof(hostbuf));
+        av_strlcpy(portbuf, "?", sizeof(portbuf));
+    }
+    if (err)
+        av_strerror(err, errbuf, sizeof(errbuf));
+    av_log(h, level, "%s %s port %s%s%s\n", what, hostbuf, portbuf, err ? ": " : "", errbuf);
+}
+
+#define MAX_PARALLEL_ATTEMPTS 3
+
+int ff_connect_parallel(struct addrinfo *addrs, int timeout_ms_per_address,
+                        int delay_ms, URLContext *h, int *fd,
+                        struct addrinfo **winner,
+                        void (*customize_fd)(void *, int), void *customize_ctx)
+{
+    ConnectionAttempt attempts[MAX_PARALLEL_ATTEMPTS];
+    struct pollfd     pfd[MAX_PARALLEL_ATTEMPTS];
+    int     nb_attempts = 0, i, j;
+    int64_t next_attempt = 0, next_deadline, now;
+    int     ret, last_err = AVERROR(ECONNREFUSED);
+    socklen_t optlen;
+
+    interleave_addrinfo(addrs);
+
+    while (nb_attempts > 0 || addrs) {
+        now = av_gettime_relative();
+
+        // start another attempt once the delay has passed or nothing is in flight
+        if (addrs && nb_attempts < MAX_PARALLEL_ATTEMPTS &&
+            (nb_attempts == 0 || now >= next_attempt)) {
+            struct addrinfo *ai = addrs;
+            addrs = addrs->ai_next;
+
+            log_connect_attempt(h, AV_LOG_VERBOSE, ai, "Starting connection attempt to", 0);
+            ret = start_connect_attempt(&attempts[nb_attempts], ai, timeout_ms_per_address,
+                                        h, customize_fd, customize_ctx);
+            if (ret == AVERROR_EXIT) {
+                last_err = ret;
+                break;
+            } else if (ret < 0) {
+                last_err = ret;
+                log_connect_attempt(h, AV_LOG_WARNING, ai, "Connection attempt to", ret);
+                continue;
+            } else if (ret > 0) {
+                j = nb_attempts;
+                goto connected;
+            }
+            pfd[nb_attempts].fd      = attempts[nb_attempts].fd;
+            pfd[nb_attempts].events  = POLLOUT;
+            pfd[nb_attempts].revents = 0;
+            nb_attempts++;
+            next_attempt = av_gettime_relative() + (int64_t)delay_ms * 1000;
+            continue;
+        }
+
+        // attempts are kept oldest first, so the first has the nearest deadline
+        next_deadline = attempts[0].deadline;
+        if (addrs && nb_attempts < MAX_PARALLEL_ATTEMPTS)
+            next_deadline = FFMIN(next_deadline, next_attempt);
+
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            last_err = AVERROR_EXIT;
+            break;
+        }
+        ret = poll(pfd, nb_attempts, av_clip64((next_deadline - now) / 1000, 0, POLLING_TIME));
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EINTR))
+                continue;
+            last_err = ret;
+            break;
+        }
+
+        now = av_gettime_relative();
+        for (i = 0; i < nb_attempts; i++) {
+            int err = 0;
+
+            if (pfd[i].revents) {
+                optlen = sizeof(err);
+                if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &err, &optlen))
+                    err = ff_neterrno();
+                else if (err)
+                    err = AVERROR(err);
+                if (!err) {
+                    j = i;
+                    goto connected;
+                }
+            } else if (attempts[i].deadline <= now) {
+                err = AVERROR(ETIMEDOUT);
+            }
+
+            if (err) {
+                last_err = err;
+                log_connect_attempt(h, AV_LOG_WARNING, attempts[i].addr, "Connection attempt to", err);
+                closesocket(attempts[i].fd);
+                memmove(&attempts[i], &attempts[i + 1], (nb_attempts - i - 1) * sizeof(*attempts));
+                memmove(&pfd[i],      &pfd[i + 1],      (nb_attempts - i - 1) * sizeof(*pfd));
+                nb_attempts--;
+                i--;
+                // a failure frees the slot for the next address right away
+                next_attempt = now;
+            }
+        }
+    }
+
+    for (i = 0; i < nb_attempts; i++)
+        closesocket(attempts[i].fd);
+    if (last_err != AVERROR_EXIT) {
+        char errbuf[100];
+        av_strerror(last_err, errbuf, sizeof(errbuf));
+        av_log(h, AV_LOG_ERROR, "Connection to %s failed: %s\n", h->filename, errbuf);
+    }
+    return last_err;
+
+connected:
+    for (i = 0; i < nb_attempts; i++) {
+        if (i != j)
+            closesocket(attempts[i].fd);
+    }
+    log_connect_attempt(h, AV_LOG_VERBOSE, attempts[j].addr, "Connected to", 0);
+    *fd = attempts[j].fd;
+    if (winner)
+        *winner = attempts[j].addr;
+    return 0;
+}
+
 static int match_host_pattern(const char *pattern, const char *hostname)
 {
     int len_p, len_h;
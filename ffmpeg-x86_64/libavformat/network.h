@@ -293,6 +293,29 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
                       socklen_t addrlen, int timeout,
                       URLContext *h, int will_try_next);
 
+/**
+ * Connect to any of the addresses in addrs, racing the attempts as
+ * described in RFC 8305 (Happy Eyeballs): the list is reordered to
+ * alternate address families, and a new attempt is started every delay_ms
+ * (or as soon as the previous one fails) while the older ones stay open.
+ * The first socket to connect wins, every other one is closed.
+ *
+ * @param addrs        List of addresses, reordered in place, the head
+ *                     element stays the same.
+ * @param timeout_ms_per_address Connect timeout of a single attempt.
+ * @param delay_ms     Delay before starting the next attempt.
+ * @param h            URLContext providing interrupt check
+ *                     callback and logging context.
+ * @param fd           The connected non-blocking socket on success.
+ * @param winner       If not NULL, the address that connected.
+ * @param customize_fd If not NULL, called on each socket before connect().
+ * @return             0 on success, AVERROR on failure.
+ */
+int ff_connect_parallel(struct addrinfo *addrs, int timeout_ms_per_address,
+                        int delay_ms, URLContext *h, int *fd,
+                        struct addrinfo **winner,
+                        void (*customize_fd)(void *, int), void *customize_ctx);
+
 int ff_http_match_no_proxy(const char *no_proxy, const char *hostname);
 
 int ff_socket(int domain, int type, int protocol);
@@ -0,0 +1,362 @@
+/*
+ * Persistent cache of stream analysis results
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "avio_internal.h"
+#include "disk_cache.h"
+#include "probe_cache.h"
+
+#define PROBE_CACHE_MAGIC       MKTAG('I', 'J', 'P', 'C')
+#define PROBE_CACHE_VERSION     1
+#define PROBE_CACHE_PREFIX      "probe-cache:"
+#define PROBE_CACHE_MAX_SIZE    (1 << 20)
+#define PROBE_CACHE_MAX_STREAMS 64
+#define PROBE_CACHE_STRING_SIZE 512
+
+typedef struct ProbeCacheStream {
+    AVCodecParameters *par;
+    AVRational         r_frame_rate;
+    AVRational         avg_frame_rate;
+    AVRational         time_base;
+} ProbeCacheStream;
+
+static int probe_cache_open(AVFormatContext *s, DiskCacheFile **pfile)
+{
+    const char *url = s->probe_cache_key && *s->probe_cache_key ? s->probe_cache_key : s->filename;
+    char *key;
+    int ret;
+
+    if (!*url)
+        return AVERROR(EINVAL);
+    key = av_asprintf(PROBE_CACHE_PREFIX "%s", url);
+    if (!key)
+        return AVERROR(ENOMEM);
+    ret = ff_disk_cache_open(pfile, key, NULL);
+    av_free(key);
+    return ret;
+}
+
+// what the protocol under s->pb reported of the resource, "" if nothing
+static void probe_cache_validator(AVFormatContext *s, char *buf, int size)
+{
+    uint8_t *etag = NULL, *modified = NULL;
+
+    if (s->pb) {
+        av_opt_get(s->pb, "etag",          AV_OPT_SEARCH_CHILDREN, &etag);
+        av_opt_get(s->pb, "last_modified", AV_OPT_SEARCH_CHILDREN, &modified);
+    }
+    snprintf(buf, size, "%s|%s", etag ? (char *)etag : "", modified ? (char *)modified : "");
+    av_free(etag);
+    av_free(modified);
+}
+
+static void write_string(AVIOContext *pb, const char *str)
+{
+    int len = strlen(str);
+
+    avio_wl32(pb, len);
+    avio_write(pb, (const uint8_t *)str, len);
+}
+
+static int read_string(AVIOContext *pb, char *buf, int size)
+{
+    unsigned len = avio_rl32(pb);
+
+    if (len >= size)
+        return AVERROR_INVALIDDATA;
+    if (avio_read(pb, (uint8_t *)buf, len) != len)
+        return AVERROR_INVALIDDATA;
+    buf[len] = '\0';
+    return 0;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wl32(pb, q.num);
+    avio_wl32(pb, q.den);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+
+    q.num = avio_rl32(pb);
+    q.den = avio_rl32(pb);
+    return q;
+}
+
+static void write_stream(AVIOContext *pb, AVStream *st)
+{
+    AVCodecParameters *par = st->codecpar;
+
+    avio_wl32(pb, par->codec_type);
+    avio_wl32(pb, par->codec_id);
+    avio_wl32(pb, par->codec_tag);
+    avio_wl32(pb, par->format);
+    avio_wl64(pb, par->bit_rate);
+    avio_wl32(pb, par->bits_per_coded_sample);
+    avio_wl32(pb, par->bits_per_raw_sample);
+    avio_wl32(pb, par->profile);
+    avio_wl32(pb, par->level);
+    avio_wl32(pb, par->width);
+    avio_wl32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    avio_wl32(pb, par->field_order);
+    avio_wl32(pb, par->color_range);
+    avio_wl32(pb, par->color_primaries);
+    avio_wl32(pb, par->color_trc);
+    avio_wl32(pb, par->color_space);
+    avio_wl32(pb, par->chroma_location);
+    avio_wl32(pb, par->video_delay);
+    avio_wl64(pb, par->channel_layout);
+    avio_wl32(pb, par->channels);
+    avio_wl32(pb, par->sample_rate);
+    avio_wl32(pb, par->block_align);
+    avio_wl32(pb, par->frame_size);
+    avio_wl32(pb, par->initial_padding);
+    avio_wl32(pb, par->trailing_padding);
+    avio_wl32(pb, par->seek_preroll);
+    write_rational(pb, st->r_frame_rate);
+    write_rational(pb, st->avg_frame_rate);
+    write_rational(pb, st->time_base);
+    avio_wl32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+}
+
+static int read_stream(AVIOContext *pb, ProbeCacheStream *cs)
+{
+    AVCodecParameters *par = cs->par;
+    unsigned size;
+
+    par->codec_type            = avio_rl32(pb);
+    par->codec_id              = avio_rl32(pb);
+    par->codec_tag             = avio_rl32(pb);
+    par->format                = (int)avio_rl32(pb);
+    par->bit_rate              = avio_rl64(pb);
+    par->bits_per_coded_sample = avio_rl32(pb);
+    par->bits_per_raw_sample   = avio_rl32(pb);
+    par->profile               = (int)avio_rl32(pb);
+    par->level                 = (int)avio_rl32(pb);
+    par->width                 = avio_rl32(pb);
+    par->height                = avio_rl32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->field_order           = avio_rl32(pb);
+    par->color_range           = avio_rl32(pb);
+    par->color_primaries       = avio_rl32(pb);
+    par->color_trc             = avio_rl32(pb);
+    par->color_space           = avio_rl32(pb);
+    par->chroma_location       = avio_rl32(pb);
+    par->video_delay           = avio_rl32(pb);
+    par->channel_layout        = avio_rl64(pb);
+    par->channels              = avio_rl32(pb);
+    par->sample_rate           = avio_rl32(pb);
+    par->block_align           = avio_rl32(pb);
+    par->frame_size            = avio_rl32(pb);
+    par->initial_padding       = avio_rl32(pb);
+    par->trailing_padding      = avio_rl32(pb);
+    par->seek_preroll          = avio_rl32(pb);
+    cs->r_frame_rate           = read_rational(pb);
+    cs->avg_frame_rate         = read_rational(pb);
+    cs->time_base              = read_rational(pb);
+
+    size = avio_rl32(pb);
+    if (size > PROBE_CACHE_MAX_SIZE)
+        return AVERROR_INVALIDDATA;
+    if (size) {
+        par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = size;
+        if (avio_read(pb, par->extradata, size) != size)
+            return AVERROR_INVALIDDATA;
+    }
+    return pb->eof_reached ? AVERROR_INVALIDDATA : 0;
+}
+
+// the demuxer decides: only what it left unset is taken from the cache
+static void apply_stream(AVStream *st, const ProbeCacheStream *cs)
+{
+    AVCodecParameters *par = st->codecpar, *src = cs->par;
+
+#define FILL(field, unset) if (par->field == (unset)) par->field = src->field
+    FILL(codec_tag,             0);
+    FILL(format,                -1);
+    FILL(bit_rate,              0);
+    FILL(bits_per_coded_sample, 0);
+    FILL(bits_per_raw_sample,   0);
+    FILL(profile,               FF_PROFILE_UNKNOWN);
+    FILL(level,                 FF_LEVEL_UNKNOWN);
+    FILL(width,                 0);
+    FILL(height,                0);
+    FILL(field_order,           AV_FIELD_UNKNOWN);
+    FILL(color_range,           AVCOL_RANGE_UNSPECIFIED);
+    FILL(color_primaries,       AVCOL_PRI_UNSPECIFIED);
+    FILL(color_trc,             AVCOL_TRC_UNSPECIFIED);
+    FILL(color_space,           AVCOL_SPC_UNSPECIFIED);
+    FILL(chroma_location,       AVCHROMA_LOC_UNSPECIFIED);
+    FILL(video_delay,           0);
+    FILL(channel_layout,        0);
+    FILL(channels,              0);
+    FILL(sample_rate,           0);
+    FILL(block_align,           0);
+    FILL(frame_size,            0);
+    FILL(initial_padding,       0);
+    FILL(trailing_padding,      0);
+    FILL(seek_preroll,          0);
+#undef FILL
+    if (!par->sample_aspect_ratio.num)
+        par->sample_aspect_ratio = src->sample_aspect_ratio;
+
+    if (!par->extradata_size && src->extradata_size) {
+        par->extradata      = src->extradata;
+        par->extradata_size = src->extradata_size;
+        src->extradata      = NULL;
+        src->extradata_size = 0;
+    }
+    if (!st->r_frame_rate.num)
+        st->r_frame_rate = cs->r_frame_rate;
+    if (!st->avg_frame_rate.num)
+        st->avg_frame_rate = cs->avg_frame_rate;
+}
+
+static int stream_matches(AVStream *st, const ProbeCacheStream *cs)
+{
+    return st->codecpar->codec_type == cs->par->codec_type &&
+           st->codecpar->codec_id   == cs->par->codec_id   &&
+           !av_cmp_q(st->time_base, cs->time_base);
+}
+
+static uint8_t *probe_cache_read(DiskCacheFile *file, int *psize)
+{
+    int64_t  size = ff_disk_cache_get_size(file);
+    uint8_t *buf;
+
+    if (size < 12 || size > PROBE_CACHE_MAX_SIZE || ff_disk_cache_available(file, 0) < size)
+        return NULL;
+    buf = av_malloc(size);
+    if (!buf)
+        return NULL;
+    // an entry rewritten meanwhile fails the checksum
+    if (ff_disk_cache_read(file, 0, buf, size) != size ||
+        AV_RL32(buf) != PROBE_CACHE_MAGIC ||
+        AV_RL32(buf + size - 4) != av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, buf, size - 4)) {
+        av_free(buf);
+        return NULL;
+    }
+    *psize = size - 4;
+    return buf;
+}
+
+int ff_probe_cache_apply(AVFormatContext *s)
+{
+    DiskCacheFile    *file = NULL;
+    ProbeCacheStream *streams = NULL;
+    AVIOContext       pb;
+    uint8_t          *buf;
+    char              validator[PROBE_CACHE_STRING_SIZE], stored[PROBE_CACHE_STRING_SIZE];
+    char              format[PROBE_CACHE_STRING_SIZE];
+    unsigned          nb_streams = 0, i;
+    int               size, hit = 0;
+
+    if (!s->probe_cache || !s->nb_streams || s->nb_streams > PROBE_CACHE_MAX_STREAMS)
+        return 0;
+    if (probe_cache_open(s, &file) < 0)
+        return 0;
+    buf = probe_cache_read(file, &size);
+    ff_disk_cache_close(&file);
+    if (!buf)
+        return 0;
+
+    ffio_init_context(&pb, buf, size, 0, NULL, NULL, NULL, NULL);
+    avio_skip(&pb, 4);
+    probe_cache_validator(s, validator, sizeof(validator));
+    if (avio_rl32(&pb) != PROBE_CACHE_VERSION ||
+        read_string(&pb, stored, sizeof(stored)) < 0 || strcmp(stored, validator) ||
+        read_string(&pb, format, sizeof(format)) < 0 || strcmp(format, s->iformat->name))
+        goto end;
+
+    nb_streams = avio_rl32(&pb);
+    if (nb_streams != s->nb_streams)
+        goto end;
+    streams = av_mallocz_array(nb_streams, sizeof(*streams));
+    if (!streams)
+        goto end;
+    for (i = 0; i < nb_streams; i++) {
+        if (!(streams[i].par = avcodec_parameters_alloc()) ||
+            read_stream(&pb, &streams[i]) < 0 ||
+            !stream_matches(s->streams[i], &streams[i]))
+            goto end;
+    }
+
+    for (i = 0; i < nb_streams; i++)
+        apply_stream(s->streams[i], &streams[i]);
+    hit = 1;
+    av_log(s, AV_LOG_VERBOSE, "Probe cache: parameters of %u streams taken from the cache\n", nb_streams);
+
+end:
+    for (i = 0; streams && i < nb_streams; i++)
+        avcodec_parameters_free(&streams[i].par);
+    av_free(streams);
+    av_free(buf);
+    return hit;
+}
+
+void ff_probe_cache_store(AVFormatContext *s)
+{
+    DiskCacheFile *file = NULL;
+    AVIOContext   *pb;
+    uint8_t       *buf;
+    char           validator[PROBE_CACHE_STRING_SIZE];
+    unsigned       i;
+    int            size;
+
+    if (!s->probe_cache || !s->nb_streams || s->nb_streams > PROBE_CACHE_MAX_STREAMS)
+        return;
+    if (avio_open_dyn_buf(&pb) < 0)
+        return;
+
+    probe_cache_validator(s, validator, sizeof(validator));
+    avio_wl32(pb, PROBE_CACHE_MAGIC);
+    avio_wl32(pb, PROBE_CACHE_VERSION);
+    write_string(pb, validator);
+    write_string(pb, s->iformat->name);
+    avio_wl32(pb, s->nb_streams);
+    for (i = 0; i < s->nb_streams; i++)
+        write_stream(pb, s->streams[i]);
+    avio_wl32(pb, 0);
+    size = avio_close_dyn_buf(pb, &buf);
+    if (size < 4 || size > PROBE_CACHE_MAX_SIZE) {
+        av_free(buf);
+        return;
+    }
+    AV_WL32(buf + size - 4, av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), 0, buf, size - 4));
+
+    if (probe_cache_open(s, &file) >= 0) {
+        if (ff_disk_cache_write(file, 0, buf, size) >= 0)
+            ff_disk_cache_set_size(file, size);
+        ff_disk_cache_close(&file);
+    }
+    av_free(buf);
+}
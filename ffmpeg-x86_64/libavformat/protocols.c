@@ -62,6 +62,7 @@ extern const URLProtocol ff_srtp_protocol;
 extern const URLProtocol ff_subfile_protocol;
 extern const URLProtocol ff_tee_protocol;
 extern const URLProtocol ff_tcp_protocol;
+extern const URLProtocol ff_timeshift_protocol;
 extern const URLProtocol ff_tls_gnutls_protocol;
 extern const URLProtocol ff_tls_schannel_protocol;
 extern const URLProtocol ff_tls_securetransport_protocol;
@@ -157,7 +157,8 @@ int ff_rtmp_check_alloc_array(RTMPPacket **prev_pkt, int *nb_prev_pkt,
 }
 
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
-                        int chunk_size, RTMPPacket **prev_pkt, int *nb_prev_pkt)
+                        int chunk_size, RTMPPacket **prev_pkt, int *nb_prev_pkt,
+                        RTMPPacketPool *pool)
 {
     uint8_t hdr;
 
@@ -165,12 +166,13 @@ int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
         return AVERROR(EIO);
 
     return ff_rtmp_packet_read_internal(h, p, chunk_size, prev_pkt,
-                                        nb_prev_pkt, hdr);
+                                        nb_prev_pkt, pool, hdr);
 }
 
 static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
                                       int chunk_size, RTMPPacket **prev_pkt_ptr,
-                                      int *nb_prev_pkt, uint8_t hdr)
+                                      int *nb_prev_pkt, RTMPPacketPool *pool,
+                                      uint8_t hdr)
 {
 
     uint8_t buf[16];
@@ -244,8 +246,12 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
     }
 
     if (!prev_pkt[channel_id].read) {
-        if ((ret = ff_rtmp_packet_create(p, channel_id, type, timestamp,
-                                         size)) < 0)
+        if (pool)
+            ret = ff_rtmp_packet_create_pooled(p, pool, channel_id, type,
+                                               timestamp, size);
+        else
+            ret = ff_rtmp_packet_create(p, channel_id, type, timestamp, size);
+        if (ret < 0)
             return ret;
         p->read = written;
         p->offset = 0;
@@ -255,6 +261,7 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
         // previous packet in this channel hasn't completed reading
         RTMPPacket *prev = &prev_pkt[channel_id];
         p->data          = prev->data;
+        p->buf           = prev->buf;
         p->size          = prev->size;
         p->channel_id    = prev->channel_id;
         p->type          = prev->type;
@@ -264,6 +271,7 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
         p->read          = prev->read + written;
         p->timestamp     = prev->timestamp;
         prev->data       = NULL;
+        prev->buf        = NULL;
     }
     p->extra = extra;
     // save history
@@ -285,9 +293,11 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
     if (size > 0) {
        RTMPPacket *prev = &prev_pkt[channel_id];
        prev->data = p->data;
+       prev->buf  = p->buf;
        prev->read = p->read;
        prev->offset = p->offset;
        p->data      = NULL;
+       p->buf       = NULL;
        return AVERROR(EAGAIN);
     }
 
@@ -297,11 +307,11 @@ static int rtmp_packet_read_one_chunk(URLContext *h, RTMPPacket *p,
 
 int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
                                  RTMPPacket **prev_pkt, int *nb_prev_pkt,
-                                 uint8_t hdr)
+                                 RTMPPacketPool *pool, uint8_t hdr)
 {
     while (1) {
         int ret = rtmp_packet_read_one_chunk(h, p, chunk_size, prev_pkt,
-                                             nb_prev_pkt, hdr);
+                                             nb_prev_pkt, pool, hdr);
         if (ret > 0 || ret != AVERROR(EAGAIN))
             return ret;
 
@@ -415,6 +425,7 @@ int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
         if (!pkt->data)
             return AVERROR(ENOMEM);
     }
+    pkt->buf        = NULL;
     pkt->size       = size;
     pkt->channel_id = channel_id;
     pkt->type       = type;
@@ -425,11 +436,62 @@ int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
     return 0;
 }
 
+static const int rtmp_pool_sizes[RTMP_PKT_POOL_CLASSES] = {
+    1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20
+};
+
+int ff_rtmp_packet_create_pooled(RTMPPacket *pkt, RTMPPacketPool *pool,
+                                 int channel_id, RTMPPacketType type,
+                                 int timestamp, int size)
+{
+    int total = size + RTMP_PKT_HEADROOM + RTMP_PKT_TAILROOM;
+    int i;
+
+    if (!size)
+        return ff_rtmp_packet_create(pkt, channel_id, type, timestamp, 0);
+
+    for (i = 0; i < RTMP_PKT_POOL_CLASSES && total > rtmp_pool_sizes[i]; i++)
+        ;
+    if (i < RTMP_PKT_POOL_CLASSES) {
+        if (!pool->pools[i] &&
+            !(pool->pools[i] = av_buffer_pool_init(rtmp_pool_sizes[i], NULL)))
+            return AVERROR(ENOMEM);
+        pkt->buf = av_buffer_pool_get(pool->pools[i]);
+    } else {
+        pkt->buf = av_buffer_alloc(total);
+    }
+    if (!pkt->buf)
+        return AVERROR(ENOMEM);
+
+    pkt->data       = pkt->buf->data + RTMP_PKT_HEADROOM;
+    pkt->size       = size;
+    pkt->channel_id = channel_id;
+    pkt->type       = type;
+    pkt->timestamp  = timestamp;
+    pkt->extra      = 0;
+    pkt->ts_field   = 0;
+
+    return 0;
+}
+
+void ff_rtmp_packet_pool_uninit(RTMPPacketPool *pool)
+{
+    int i;
+
+    for (i = 0; i < RTMP_PKT_POOL_CLASSES; i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+}
+
 void ff_rtmp_packet_destroy(RTMPPacket *pkt)
 {
     if (!pkt)
         return;
-    av_freep(&pkt->data);
+    if (pkt->buf) {
+        av_buffer_unref(&pkt->buf);
+        pkt->data = NULL;
+    } else {
+        av_freep(&pkt->data);
+    }
     pkt->size = 0;
 }
 
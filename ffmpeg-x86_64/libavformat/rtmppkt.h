@@ -23,6 +23,7 @@
 #define AVFORMAT_RTMPPKT_H
 
 #include "libavcodec/bytestream.h"
+#include "libavutil/buffer.h"
 #include "avformat.h"
 #include "url.h"
 
@@ -71,6 +72,22 @@ enum RTMPPacketSize {
     RTMP_PS_ONEBYTE          ///< packet is really a next chunk of a packet
 };
 
+/**
+ * Room kept in front of and after the payload of pooled packets, so that
+ * an incoming media message can be framed as an FLV tag in place.
+ */
+#define RTMP_PKT_HEADROOM 11
+#define RTMP_PKT_TAILROOM 4
+
+#define RTMP_PKT_POOL_CLASSES 5
+
+/**
+ * Size classed pools for the payloads of incoming messages.
+ */
+typedef struct RTMPPacketPool {
+    AVBufferPool *pools[RTMP_PKT_POOL_CLASSES];
+} RTMPPacketPool;
+
 /**
  * structure for holding RTMP packets
  */
@@ -84,6 +101,7 @@ typedef struct RTMPPacket {
     int            size;       ///< packet payload size
     int            offset;     ///< amount of data read so far
     int            read;       ///< amount read, including headers
+    AVBufferRef    *buf;       ///< pooled buffer data points into, NULL if data is allocated on its own
 } RTMPPacket;
 
 /**
@@ -99,6 +117,26 @@ typedef struct RTMPPacket {
 int ff_rtmp_packet_create(RTMPPacket *pkt, int channel_id, RTMPPacketType type,
                           int timestamp, int size);
 
+/**
+ * Create new RTMP packet with a payload taken from a pool, with
+ * RTMP_PKT_HEADROOM and RTMP_PKT_TAILROOM bytes around it.
+ *
+ * @param pkt        packet
+ * @param pool       pools to take the payload from
+ * @param channel_id packet channel ID
+ * @param type       packet type
+ * @param timestamp  packet timestamp
+ * @param size       packet size
+ */
+int ff_rtmp_packet_create_pooled(RTMPPacket *pkt, RTMPPacketPool *pool,
+                                 int channel_id, RTMPPacketType type,
+                                 int timestamp, int size);
+
+/**
+ * Release the pools, buffers still referenced are freed when unreferenced.
+ */
+void ff_rtmp_packet_pool_uninit(RTMPPacketPool *pool);
+
 /**
  * Free RTMP packet.
  *
@@ -115,11 +153,12 @@ void ff_rtmp_packet_destroy(RTMPPacket *pkt);
  * @param prev_pkt   previously read packet headers for all channels
  *                   (may be needed for restoring incomplete packet header)
  * @param nb_prev_pkt number of allocated elements in prev_pkt
+ * @param pool       pools for the payloads, NULL to allocate them on their own
  * @return number of bytes read on success, negative value otherwise
  */
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
                         int chunk_size, RTMPPacket **prev_pkt,
-                        int *nb_prev_pkt);
+                        int *nb_prev_pkt, RTMPPacketPool *pool);
 /**
  * Read internal RTMP packet sent by the server.
  *
@@ -129,12 +168,13 @@ int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
  * @param prev_pkt   previously read packet headers for all channels
  *                   (may be needed for restoring incomplete packet header)
  * @param nb_prev_pkt number of allocated elements in prev_pkt
+ * @param pool       pools for the payloads, NULL to allocate them on their own
  * @param c          the first byte already read
  * @return number of bytes read on success, negative value otherwise
  */
 int ff_rtmp_packet_read_internal(URLContext *h, RTMPPacket *p, int chunk_size,
                                  RTMPPacket **prev_pkt, int *nb_prev_pkt,
-                                 uint8_t c);
+                                 RTMPPacketPool *pool, uint8_t c);
 
 /**
  * Send RTMP packet to the server.
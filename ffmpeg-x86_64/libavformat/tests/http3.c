@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/avstring.h"
+#include "libavformat/http3.h"
+
+/* a transport with the response at hand after one EAGAIN each */
+typedef struct FakeRequest {
+    AVHTTP3Request *request;
+    int             head_polls;
+    int             body_polls;
+    int             pos;
+} FakeRequest;
+
+static FakeRequest fake;
+static const char  body[] = "0123456789";
+
+static int fake_open(void *opaque, AVHTTP3Request *request, const char *method,
+                     const char *url, const char *headers, void **handle)
+{
+    printf("open %s %s\n%s", method, url, headers);
+    fake.request = request;
+    *handle = &fake;
+    return 0;
+}
+
+static int fake_read_head(void *opaque, void *handle, int *status, char *headers, int size)
+{
+    FakeRequest *r = handle;
+
+    if (!r->head_polls++) {
+        av_http3_request_ready(r->request);
+        return AVERROR(EAGAIN);
+    }
+    *status = 206;
+    av_strlcpy(headers, "Content-Range: bytes 0-9/100\r\nContent-Length: 10\r\n", size);
+    return 0;
+}
+
+static int fake_read(void *opaque, void *handle, uint8_t *buf, int size)
+{
+    FakeRequest *r = handle;
+
+    if (!r->body_polls++) {
+        av_http3_request_ready(r->request);
+        return AVERROR(EAGAIN);
+    }
+    size = FFMIN(size, (int)sizeof(body) - 1 - r->pos);
+    memcpy(buf, body + r->pos, size);
+    r->pos += size;
+    return size;
+}
+
+static void fake_close(void *opaque, void *handle, AVHTTP3ConnectionStats *stats)
+{
+    FakeRequest *r = handle;
+
+    printf("close after %d bytes\n", r->pos);
+    av_strlcpy(stats->protocol, "h3", sizeof(stats->protocol));
+    stats->bytes = r->pos;
+}
+
+static const AVHTTP3TransportCallbacks callbacks = {
+    .open      = fake_open,
+    .read_head = fake_read_head,
+    .read      = fake_read,
+    .close     = fake_close,
+};
+
+int main(void)
+{
+    HTTP3Stream *st;
+    uint8_t      buf[16];
+    int          ret;
+
+    ret = ff_http3_open(&st, NULL, NULL);
+    printf("open without a transport: %s\n", ret == AVERROR(ENOPROTOOPT) ? "ENOPROTOOPT" : "unexpected");
+
+    av_http3_register_transport(&callbacks, NULL);
+    ret = av_http3_register_transport(&callbacks, NULL);
+    printf("second transport: %s\n", ret == AVERROR(EEXIST) ? "EEXIST" : "unexpected");
+
+    if ((ret = ff_http3_open(&st, NULL, NULL)) < 0)
+        return 1;
+    ret = ff_http3_send_request(st, "GET /seg/1.ts HTTP/1.1\r\n"
+                                    "User-Agent: test\r\n"
+                                    "Range: bytes=0-\r\n"
+                                    "Connection: keep-alive\r\n"
+                                    "Host: cdn.example.com:8443\r\n"
+                                    "\r\n");
+    printf("send: %d\n", ret);
+
+    // in pieces smaller than the head, to read across its end
+    while ((ret = ff_http3_read(st, buf, sizeof(buf) - 1)) > 0) {
+        buf[ret] = '\0';
+        printf("[%s]", buf);
+    }
+    printf("\nread: %s\n", ret == AVERROR_EOF ? "EOF" : "error");
+    ff_http3_close(&st);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Process wide network throughput and round trip time estimate
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_THROUGHPUT_H
+#define AVFORMAT_THROUGHPUT_H
+
+#include <stdint.h>
+
+/**
+ * Every download of every player in the process adds to one estimate per
+ * host, and to one for the process, so a new session starts from what the
+ * last one measured instead of from nothing.
+ *
+ * The bandwidth is the mean of the samples weighted by their download time,
+ * the round trip time the mean of the connect times. The weight of the past
+ * halves every THROUGHPUT_HALF_LIFE: an estimate nobody refreshed fades,
+ * and is unknown once too little of it is left. A host with no estimate of
+ * its own gets the one of the process. The application resets it all when
+ * the network interface changes.
+ */
+
+#define THROUGHPUT_HALF_LIFE        (60 * 1000000LL)
+
+typedef struct ThroughputEstimate {
+    int64_t bandwidth;      // bits per second, 0 if unknown
+    int64_t rtt;            // microseconds, 0 if unknown
+    int64_t age;            // microseconds since the bandwidth was last sampled
+} ThroughputEstimate;
+
+/**
+ * A download of bytes from the host of url in elapsed microseconds, waits
+ * for the reader excluded. Downloads too short to tell are ignored.
+ */
+void ff_throughput_add_sample(const char *url, int64_t bytes, int64_t elapsed);
+
+/**
+ * The time a tcp connect to the host of url took, in microseconds.
+ */
+void ff_throughput_add_rtt(const char *url, int64_t rtt);
+
+/**
+ * @param url the estimate of its host, NULL for the one of the process
+ * @return 0, or AVERROR(ENOENT) if neither the bandwidth nor the rtt is known
+ */
+int  av_throughput_get_estimate(const char *url, ThroughputEstimate *estimate);
+
+void av_throughput_reset(void);
+
+#endif /* AVFORMAT_THROUGHPUT_H */
@@ -0,0 +1,659 @@
+/*
+ * Live timeshift buffer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Keeps the last timeshift_size bytes of a live stream in a memory mapped
+ * file, so playback can pause, go back and return to the live edge without
+ * fetching anything again.
+ *
+ * The download never waits for the reader: the oldest bytes are overwritten,
+ * and a reader left behind the window goes on from its oldest keyframe. The
+ * written pages are written back every timeshift_hot_size bytes, after which
+ * the kernel may reclaim them, so the memory used does not grow with the
+ * window.
+ *
+ * FLV streams, from http or rtmp, are indexed by keyframe as they arrive,
+ * and url_read_seek then seeks by time within the window; a seek past its
+ * end goes to the newest keyframe, the live edge. A resource which is not
+ * streamed is read through as it is.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "flv.h"
+#include "io_reactor.h"
+#include "url.h"
+#include <fcntl.h>
+#include <stdint.h>
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_POLL_H
+#include <poll.h>
+#endif
+#if HAVE_MMAP && HAVE_MKSTEMP
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#define TIMESHIFT_HAVE_FILE 1
+#else
+#define TIMESHIFT_HAVE_FILE 0
+#endif
+
+#define TIMESHIFT_SIZE          (256 * 1024 * 1024)
+#define TIMESHIFT_SIZE_MIN      (16 * 1024 * 1024)
+#define TIMESHIFT_HOT_SIZE      (1 * 1024 * 1024)
+#define TIMESHIFT_CHUNK         (64 * 1024)     // the most one read writes
+#define TIMESHIFT_INDEX_MAX     16384           // keyframes, hours of a live stream
+#define READ_WAIT_MAX           (1000 * 1000)
+#define FLV_HEADER_SIZE         9
+#define FLV_TAG_HEADER_SIZE     11
+
+typedef struct TimeshiftKeyframe {
+    int64_t pos;
+    int64_t ts;                             // milliseconds, from the FLV tag
+} TimeshiftKeyframe;
+
+typedef struct TimeshiftContext {
+    const AVClass     *class;
+    URLContext        *inner;
+    int                passthrough;         // not live, or no file: read the inner directly
+
+    uint8_t           *map;
+    int64_t            size;
+    int64_t            write_pos;           // bytes received, only changed by the background
+    int64_t            read_pos;
+    int                io_error;
+    int                eof;
+    int                abort_request;
+
+    // the keyframes in the window, a ring, oldest first
+    TimeshiftKeyframe *index;
+    int                index_start;
+    int                index_count;
+
+    pthread_mutex_t    mutex;
+    pthread_cond_t     cond_read;
+    pthread_t          thread;
+    FFIOReactorSource *reactor;             // runs the download instead of the thread
+    AVIOInterruptCB    interrupt_callback;
+
+    /* background only */
+    int                flv;                 // 1 FLV, -1 not FLV or out of sync, 0 not known yet
+    int64_t            next_tag;            // position of the next FLV tag header
+    int64_t            synced_pos;          // written back up to here
+    int                read_short;
+    int64_t            read_wait_deadline;
+
+    /* options */
+    char              *dir;
+    int64_t            size_opt;
+    int                hot_size;
+    int                use_reactor;
+} TimeshiftContext;
+
+static int timeshift_check_interrupt(void *arg)
+{
+    URLContext       *h = arg;
+    TimeshiftContext *c = h->priv_data;
+
+    if (c->abort_request)
+        return 1;
+
+    if (ff_check_interrupt(&c->interrupt_callback))
+        c->abort_request = 1;
+
+    return c->abort_request;
+}
+
+/*
+ * The next read of the background may overwrite the oldest TIMESHIFT_CHUNK
+ * bytes at any time, so they are not the reader's anymore.
+ */
+static int64_t timeshift_window_start(TimeshiftContext *c)
+{
+    return FFMAX(0, c->write_pos - c->size + TIMESHIFT_CHUNK);
+}
+
+static void timeshift_copy(TimeshiftContext *c, uint8_t *dst, int64_t pos, int len)
+{
+    int64_t off = pos % c->size;
+    int     n   = FFMIN(len, c->size - off);
+
+    memcpy(dst, c->map + off, n);
+    if (len > n)
+        memcpy(dst + n, c->map, len - n);
+}
+
+static TimeshiftKeyframe *timeshift_keyframe(TimeshiftContext *c, int i)
+{
+    return &c->index[(c->index_start + i) % TIMESHIFT_INDEX_MAX];
+}
+
+// must be called locked
+static void timeshift_add_keyframe(TimeshiftContext *c, int64_t pos, int64_t ts)
+{
+    TimeshiftKeyframe *kf;
+
+    if (c->index_count == TIMESHIFT_INDEX_MAX) {
+        c->index_start = (c->index_start + 1) % TIMESHIFT_INDEX_MAX;
+        c->index_count--;
+    }
+    kf      = timeshift_keyframe(c, c->index_count++);
+    kf->pos = pos;
+    kf->ts  = ts;
+}
+
+// must be called locked
+static void timeshift_trim_index(TimeshiftContext *c)
+{
+    int64_t start = timeshift_window_start(c);
+
+    while (c->index_count && timeshift_keyframe(c, 0)->pos < start) {
+        c->index_start = (c->index_start + 1) % TIMESHIFT_INDEX_MAX;
+        c->index_count--;
+    }
+}
+
+// must be called locked: index the tags whose header has arrived
+static void timeshift_parse_flv(URLContext *h)
+{
+    TimeshiftContext *c = h->priv_data;
+    uint8_t           hdr[FLV_TAG_HEADER_SIZE + 1];     // and the video flags
+
+    if (!c->flv) {
+        if (c->write_pos < FLV_HEADER_SIZE)
+            return;
+        timeshift_copy(c, hdr, 0, FLV_HEADER_SIZE);
+        if (memcmp(hdr, "FLV", 3)) {
+            c->flv = -1;
+            return;
+        }
+        c->flv      = 1;
+        c->next_tag = AV_RB32(hdr + 5) + 4;             // then PreviousTagSize0
+    }
+
+    while (c->flv > 0 && c->next_tag + (int64_t)sizeof(hdr) <= c->write_pos) {
+        int64_t pos  = c->next_tag;
+        int     type, size;
+        int64_t ts;
+
+        timeshift_copy(c, hdr, pos, sizeof(hdr));
+        type = hdr[0] & 0x1f;
+        size = AV_RB24(hdr + 1);
+        ts   = AV_RB24(hdr + 4) | (int64_t)hdr[7] << 24;
+        if (type != FLV_TAG_TYPE_AUDIO && type != FLV_TAG_TYPE_VIDEO && type != FLV_TAG_TYPE_META) {
+            av_log(h, AV_LOG_WARNING, "lost the flv tags at %"PRId64", seeking by time disabled\n", pos);
+            c->flv         = -1;
+            c->index_count = 0;
+            break;
+        }
+        if (type == FLV_TAG_TYPE_VIDEO && size > 0 &&
+            (hdr[FLV_TAG_HEADER_SIZE] & FLV_VIDEO_FRAMETYPE_MASK) == FLV_FRAME_KEY)
+            timeshift_add_keyframe(c, pos, ts);
+        c->next_tag = pos + FLV_TAG_HEADER_SIZE + size + 4;
+    }
+}
+
+#if TIMESHIFT_HAVE_FILE
+static int timeshift_map_file(URLContext *h)
+{
+    TimeshiftContext *c    = h->priv_data;
+    char             *path;
+    struct statvfs    vfs;
+    size_t            size = c->size_opt;
+    void             *map  = MAP_FAILED;
+    int               fd;
+    int               ret  = 0;
+
+    path = av_asprintf("%s/ijktimeshift-XXXXXX", c->dir);
+    if (!path)
+        return AVERROR(ENOMEM);
+    fd = mkstemp(path);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_WARNING, "mkstemp(%s) failed: %s\n", path, av_err2str(ret));
+        av_free(path);
+        return ret;
+    }
+    // the file only lives as long as the mapping
+    unlink(path);
+    av_free(path);
+
+    /* a store into a page the file system can not back raises SIGBUS,
+     * so make sure the space is there before mapping a sparse file */
+    if (fstatvfs(fd, &vfs) == 0 && (uint64_t)vfs.f_bavail * vfs.f_frsize < 2 * (uint64_t)size) {
+        av_log(h, AV_LOG_WARNING, "not enough free space for a %zu bytes timeshift file\n", size);
+        ret = AVERROR(ENOSPC);
+        goto end;
+    }
+#ifdef F_PREALLOCATE
+    {
+        fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, size };
+        if (fcntl(fd, F_PREALLOCATE, &store) < 0) {
+            ret = AVERROR(errno);
+            av_log(h, AV_LOG_WARNING, "F_PREALLOCATE failed: %s\n", av_err2str(ret));
+            goto end;
+        }
+    }
+#endif
+    if (ftruncate(fd, size) < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_WARNING, "ftruncate failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_WARNING, "mmap failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    c->map  = map;
+    c->size = size;
+end:
+    close(fd);
+    return ret;
+}
+
+static void timeshift_sync_range(uint8_t *start, uint8_t *end)
+{
+    uintptr_t page  = sysconf(_SC_PAGESIZE);
+    uint8_t  *first = (uint8_t *)((uintptr_t)start & ~(page - 1));
+
+    if (end > first)
+        msync(first, end - first, MS_ASYNC);
+}
+
+// start writing back what was stored since the last call
+static void timeshift_sync(TimeshiftContext *c)
+{
+    int64_t from = c->synced_pos % c->size;
+    int64_t to   = c->write_pos % c->size;
+
+    if (c->write_pos - c->synced_pos < c->hot_size)
+        return;
+
+    if (to > from) {
+        timeshift_sync_range(c->map + from, c->map + to);
+    } else {
+        timeshift_sync_range(c->map + from, c->map + c->size);
+        timeshift_sync_range(c->map, c->map + to);
+    }
+    c->synced_pos = c->write_pos;
+}
+#endif
+
+/*
+ * As the async protocol: after a short read, which leaves the http and tls
+ * buffers empty, a reactor worker waits for the descriptor instead of
+ * blocking in the read, for READ_WAIT_MAX at most.
+ */
+static int timeshift_wait_readable(TimeshiftContext *c, int *fd, int64_t *timeout)
+{
+#if HAVE_POLL_H
+    struct pollfd pfd = { 0 };
+    int64_t       now;
+
+    if (!c->reactor || !c->read_short)
+        return 0;
+    pfd.fd     = ffurl_get_file_handle(c->inner);
+    pfd.events = POLLIN;
+    if (pfd.fd < 0 || poll(&pfd, 1, 0) != 0)
+        goto read;
+
+    now = av_gettime_relative();
+    if (!c->read_wait_deadline)
+        c->read_wait_deadline = now + READ_WAIT_MAX;
+    if (now >= c->read_wait_deadline)
+        goto read;
+    *fd      = pfd.fd;
+    *timeout = c->read_wait_deadline - now;
+    return 1;
+read:
+    c->read_short         = 0;
+    c->read_wait_deadline = 0;
+#endif
+    return 0;
+}
+
+static int timeshift_step(void *arg, int *fd, int64_t *timeout)
+{
+    URLContext       *h = arg;
+    TimeshiftContext *c = h->priv_data;
+    int64_t           off;
+    int               to_read, ret;
+
+    if (!timeshift_check_interrupt(h) && timeshift_wait_readable(c, fd, timeout))
+        return FF_IO_REACTOR_WAIT_READ;
+
+    // nobody reads the part past the window start, see timeshift_window_start()
+    off     = c->write_pos % c->size;
+    to_read = FFMIN(TIMESHIFT_CHUNK, c->size - off);
+    ret     = timeshift_check_interrupt(h) ? AVERROR_EXIT : ffurl_read(c->inner, c->map + off, to_read);
+    c->read_short = ret < to_read;
+
+    pthread_mutex_lock(&c->mutex);
+    if (ret > 0) {
+        c->write_pos += ret;
+        if (c->flv >= 0)
+            timeshift_parse_flv(h);
+        timeshift_trim_index(c);
+    } else {
+        c->eof = 1;
+        if (ret < 0 && ret != AVERROR_EOF)
+            c->io_error = ret;
+    }
+    pthread_cond_signal(&c->cond_read);
+    pthread_mutex_unlock(&c->mutex);
+
+    if (ret <= 0)
+        return FF_IO_REACTOR_DONE;
+#if TIMESHIFT_HAVE_FILE
+    timeshift_sync(c);
+#endif
+    return FF_IO_REACTOR_RUN;
+}
+
+static void *timeshift_task(void *arg)
+{
+    int     fd;
+    int64_t timeout;
+
+    // without the reactor the reads block, the step never waits
+    while (timeshift_step(arg, &fd, &timeout) != FF_IO_REACTOR_DONE)
+        ;
+    return NULL;
+}
+
+static int timeshift_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    TimeshiftContext *c = h->priv_data;
+    AVIOInterruptCB   interrupt_callback = {.callback = timeshift_check_interrupt, .opaque = h};
+    int               ret;
+
+    av_strstart(arg, "timeshift:", &arg);
+
+    c->interrupt_callback = h->interrupt_callback;
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &interrupt_callback, options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret != 0) {
+        av_log(h, AV_LOG_ERROR, "ffurl_open failed : %s, %s\n", av_err2str(ret), arg);
+        return ret;
+    }
+    h->is_streamed = c->inner->is_streamed;
+    if (!h->is_streamed) {
+        c->passthrough = 1;
+        return 0;
+    }
+
+    ret = AVERROR(ENOSYS);
+#if TIMESHIFT_HAVE_FILE
+    if (c->dir && c->dir[0])
+        ret = timeshift_map_file(h);
+#endif
+    if (ret < 0) {
+        av_log(h, AV_LOG_WARNING, "no timeshift file, playing live only\n");
+        c->passthrough = 1;
+        return 0;
+    }
+
+    c->index = av_malloc_array(TIMESHIFT_INDEX_MAX, sizeof(*c->index));
+    if (!c->index) {
+        ret = AVERROR(ENOMEM);
+        goto index_fail;
+    }
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret != 0) {
+        ret = AVERROR(ret);
+        av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", av_err2str(ret));
+        goto mutex_fail;
+    }
+
+    ret = pthread_cond_init(&c->cond_read, NULL);
+    if (ret != 0) {
+        ret = AVERROR(ret);
+        av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(ret));
+        goto cond_fail;
+    }
+
+    if (!c->use_reactor || ff_io_reactor_add(&c->reactor, timeshift_step, h) < 0) {
+        ret = pthread_create(&c->thread, NULL, timeshift_task, h);
+        if (ret) {
+            ret = AVERROR(ret);
+            av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(ret));
+            goto thread_fail;
+        }
+    }
+    return 0;
+
+thread_fail:
+    pthread_cond_destroy(&c->cond_read);
+cond_fail:
+    pthread_mutex_destroy(&c->mutex);
+mutex_fail:
+    av_freep(&c->index);
+index_fail:
+#if TIMESHIFT_HAVE_FILE
+    munmap(c->map, c->size);
+#endif
+    ffurl_closep(&c->inner);
+    return ret;
+}
+
+static int timeshift_close(URLContext *h)
+{
+    TimeshiftContext *c = h->priv_data;
+    int               ret;
+
+    if (!c->passthrough) {
+        pthread_mutex_lock(&c->mutex);
+        c->abort_request = 1;
+        pthread_mutex_unlock(&c->mutex);
+
+        if (c->reactor) {
+            // out of a wait for the socket
+            ff_io_reactor_wake(c->reactor);
+            ff_io_reactor_join(&c->reactor);
+        } else {
+            ret = pthread_join(c->thread, NULL);
+            if (ret != 0)
+                av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(AVERROR(ret)));
+        }
+
+        pthread_cond_destroy(&c->cond_read);
+        pthread_mutex_destroy(&c->mutex);
+        av_freep(&c->index);
+#if TIMESHIFT_HAVE_FILE
+        munmap(c->map, c->size);
+#endif
+    }
+    ffurl_closep(&c->inner);
+    return 0;
+}
+
+// must be called locked: paused for longer than the window holds
+static void timeshift_catch_up(URLContext *h)
+{
+    TimeshiftContext *c   = h->priv_data;
+    int64_t           pos = timeshift_window_start(c);
+
+    // the index is trimmed to the window
+    if (c->index_count)
+        pos = timeshift_keyframe(c, 0)->pos;
+    av_log(h, AV_LOG_WARNING, "left behind the timeshift window, %"PRId64" bytes lost\n",
+           pos - c->read_pos);
+    c->read_pos = pos;
+}
+
+static int timeshift_read(URLContext *h, unsigned char *buf, int size)
+{
+    TimeshiftContext *c = h->priv_data;
+    int64_t           pos;
+    int               ret;
+
+    if (c->passthrough)
+        return ffurl_read(c->inner, buf, size);
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        if (timeshift_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (c->read_pos < timeshift_window_start(c))
+            timeshift_catch_up(h);
+        if (c->read_pos >= c->write_pos) {
+            if (c->eof) {
+                ret = c->io_error ? c->io_error : AVERROR_EOF;
+                break;
+            }
+            pthread_cond_wait(&c->cond_read, &c->mutex);
+            continue;
+        }
+
+        // copied unlocked, then checked against what the download overwrote meanwhile
+        pos = c->read_pos;
+        ret = FFMIN(size, c->write_pos - pos);
+        pthread_mutex_unlock(&c->mutex);
+        timeshift_copy(c, buf, pos, ret);
+        pthread_mutex_lock(&c->mutex);
+        if (pos >= timeshift_window_start(c)) {
+            c->read_pos = pos + ret;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int64_t timeshift_seek(URLContext *h, int64_t pos, int whence)
+{
+    TimeshiftContext *c = h->priv_data;
+    int64_t           ret;
+
+    if (c->passthrough)
+        return ffurl_seek(c->inner, pos, whence);
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        return AVERROR(ENOSYS);
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == SEEK_CUR)
+        pos += c->read_pos;
+    else if (whence == SEEK_END)
+        pos += c->write_pos;
+    else if (whence != SEEK_SET)
+        pos = -1;
+
+    if (pos < timeshift_window_start(c) || pos > c->write_pos) {
+        ret = AVERROR(EINVAL);
+    } else {
+        c->read_pos = pos;
+        ret         = pos;
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+/*
+ * timestamp in milliseconds, the time base of FLV: to the keyframe at or
+ * before it with AVSEEK_FLAG_BACKWARD, else at or after it. Past either
+ * end of the window, to the oldest or the newest keyframe.
+ */
+static int64_t timeshift_read_seek(URLContext *h, int stream_index, int64_t timestamp, int flags)
+{
+    TimeshiftContext  *c  = h->priv_data;
+    TimeshiftKeyframe *kf = NULL;
+    int64_t            ret;
+    int                i;
+
+    if (c->passthrough) {
+        if (!c->inner->prot->url_read_seek)
+            return AVERROR(ENOSYS);
+        return c->inner->prot->url_read_seek(c->inner, stream_index, timestamp, flags);
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    if (c->flv <= 0 || !c->index_count) {
+        pthread_mutex_unlock(&c->mutex);
+        return AVERROR(ENOSYS);
+    }
+    for (i = 0; i < c->index_count; i++) {
+        TimeshiftKeyframe *e = timeshift_keyframe(c, i);
+        if (flags & AVSEEK_FLAG_BACKWARD) {
+            if (e->ts <= timestamp)
+                kf = e;
+        } else if (e->ts >= timestamp) {
+            kf = e;
+            break;
+        }
+    }
+    if (!kf)
+        kf = timeshift_keyframe(c, (flags & AVSEEK_FLAG_BACKWARD) ? 0 : c->index_count - 1);
+    c->read_pos = kf->pos;
+    ret         = kf->ts;
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(TimeshiftContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+
+static const AVOption options[] = {
+    { "timeshift_dir",          "directory of the memory mapped file holding the window, none to play live only",
+        OFFSET(dir),            AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "timeshift_size",         "bytes of the live stream kept to go back in",
+        OFFSET(size_opt),       AV_OPT_TYPE_INT64, { .i64 = TIMESHIFT_SIZE }, TIMESHIFT_SIZE_MIN, INT64_C(1) << 34, D },
+    { "timeshift_hot_size",     "bytes written to the file before they are written back",
+        OFFSET(hot_size),       AV_OPT_TYPE_INT, { .i64 = TIMESHIFT_HOT_SIZE }, 64 * 1024, INT_MAX, D },
+    { "io_reactor",             "download on the shared reactor threads instead of a thread of its own",
+        OFFSET(use_reactor),    AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
+    {NULL},
+};
+
+#undef D
+#undef OFFSET
+
+static const AVClass timeshift_context_class = {
+    .class_name = "Timeshift",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_timeshift_protocol = {
+    .name                = "timeshift",
+    .url_open2           = timeshift_open,
+    .url_read            = timeshift_read,
+    .url_seek            = timeshift_seek,
+    .url_read_seek       = timeshift_read_seek,
+    .url_close           = timeshift_close,
+    .priv_data_size      = sizeof(TimeshiftContext),
+    .priv_data_class     = &timeshift_context_class,
+};
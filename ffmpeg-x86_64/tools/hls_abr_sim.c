@@ -0,0 +1,440 @@
+/*
+ * Offline simulation of the HLS variant selection on recorded traces
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Plays a stream described by its segment sizes over recorded network
+ * traces, faster than real time, with the variant selection of the HLS
+ * demuxer (libavformat/hls_abr.c) and the buffering of the player: playback
+ * starts once start_ms are buffered and resumes after a stall once
+ * resume_ms are, the resume mark doubling with each stall up to
+ * resume_max_ms, as the high water marks of ijkplayer do. Downloads stop
+ * while max_buffer_ms are buffered.
+ *
+ * The segments file has one line per variant, in the order of the master
+ * playlist: the BANDWIDTH of the variant, "a" after it for an audio only
+ * one, then the bytes of each segment. A "duration" line gives the
+ * milliseconds of the segments, one for all or one each. Lines starting
+ * with # are ignored.
+ *
+ * A trace has one sample per line, "seconds kbps": the time it starts at
+ * and the bandwidth until the next one. The last one lasts as long as the
+ * one before it, and the trace starts over at its end.
+ *
+ * One line of CSV per trace, and one with the mean of them all.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavformat/hls_abr.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define MAX_LINE 65536
+
+typedef struct Variant {
+    HLSABRVariant abr;
+    int64_t      *sizes;
+    int           nb_sizes;
+} Variant;
+
+typedef struct Stream {
+    Variant *variants;
+    int      nb_variants;
+    int     *durations;     ///< ms of each segment
+    int      nb_segments;
+} Stream;
+
+typedef struct Trace {
+    double *times;          ///< seconds
+    double *rates;          ///< bits per second
+    int     nb_samples;
+    double  period;
+} Trace;
+
+typedef struct Config {
+    const char  *name;
+    HLSABRPolicy policy;
+    double       start_ms;
+    double       resume_ms;
+    double       resume_max_ms;
+    double       max_buffer_ms;
+    int          prefetch;
+    double       rtt_ms;
+    int64_t      initial_estimate;
+} Config;
+
+typedef struct Result {
+    double startup_ms;
+    double play_ms;
+    double stall_ms;
+    int    stalls;
+    double bits;            ///< bitrate times duration of the segments played
+    int    switches;
+} Result;
+
+typedef struct Player {
+    const Config *cfg;
+    Result       *res;
+    double        now;      ///< ms
+    double        buffer;   ///< ms of media downloaded and not played
+    double        resume;   ///< ms to buffer before playing, now
+    int           playing;
+    int           started;
+} Player;
+
+static void usage(int ret)
+{
+    fprintf(ret ? stderr : stdout,
+            "Usage: hls_abr_sim [options] segments trace ...\n"
+            "Options:\n"
+            "    -n name           of the policy in the output\n"
+            "    -u ms             ABR: buffered before switching up (%d)\n"
+            "    -H ms             ABR: buffered to hold through a dip (%d)\n"
+            "    -P ms             ABR: buffered below which the estimate is halved (%d)\n"
+            "    -U percent        ABR: of the estimate a variant may take (%d)\n"
+            "    -e bps            ABR: estimate to start from, 0 for the first variant (0)\n"
+            "    -s ms             buffered before playback starts (100)\n"
+            "    -r ms             buffered before playback resumes after a stall (1000)\n"
+            "    -R ms             the most the resume mark doubles to (5000)\n"
+            "    -b ms             buffered at most, downloads wait above (30000)\n"
+            "    -p segments       requested together, one round trip for them (1)\n"
+            "    -t ms             round trip of a request (50)\n",
+            HLS_ABR_UPSWITCH_BUFFER, HLS_ABR_HOLD_BUFFER, HLS_ABR_PANIC_BUFFER,
+            HLS_ABR_USABLE_PERCENT);
+    exit(ret);
+}
+
+static int append(void *parray, int *nb, size_t size, const void *elem)
+{
+    void **array = parray;
+    void  *tmp   = av_realloc_array(*array, *nb + 1, size);
+    if (!tmp)
+        return -1;
+    *array = tmp;
+    memcpy((uint8_t *)tmp + *nb * size, elem, size);
+    (*nb)++;
+    return 0;
+}
+
+static int read_stream(const char *path, Stream *st)
+{
+    FILE *f = fopen(path, "r");
+    char *line = av_malloc(MAX_LINE), *p, *end;
+    int  *durations = NULL, nb_durations = 0, i, ret = -1;
+    Variant v;
+
+    if (!f || !line)
+        goto fail;
+
+    while (fgets(line, MAX_LINE, f)) {
+        p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || !*p)
+            continue;
+        if (!strncmp(p, "duration", 8)) {
+            for (p += 8; ; p = end) {
+                int d = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+                if (d <= 0 || append(&durations, &nb_durations, sizeof(d), &d) < 0)
+                    goto fail;
+            }
+            continue;
+        }
+
+        memset(&v, 0, sizeof(v));
+        v.abr.bandwidth = strtol(p, &end, 10);
+        if (end == p || v.abr.bandwidth <= 0)
+            goto fail;
+        p = end + strspn(end, " \t");
+        if (*p == 'a') {
+            v.abr.audio_only = 1;
+            p++;
+        }
+        for (;; p = end) {
+            int64_t size = strtoll(p, &end, 10);
+            if (end == p)
+                break;
+            if (size <= 0 || append(&v.sizes, &v.nb_sizes, sizeof(size), &size) < 0)
+                goto fail;
+        }
+        if (!v.nb_sizes || append(&st->variants, &st->nb_variants, sizeof(v), &v) < 0)
+            goto fail;
+    }
+    if (!st->nb_variants || !nb_durations)
+        goto fail;
+
+    st->nb_segments = INT_MAX;
+    for (i = 0; i < st->nb_variants; i++)
+        st->nb_segments = FFMIN(st->nb_segments, st->variants[i].nb_sizes);
+    st->durations = av_malloc_array(st->nb_segments, sizeof(*st->durations));
+    if (!st->durations)
+        goto fail;
+    for (i = 0; i < st->nb_segments; i++)
+        st->durations[i] = durations[FFMIN(i, nb_durations - 1)];
+    ret = 0;
+
+fail:
+    if (f)
+        fclose(f);
+    av_free(line);
+    av_free(durations);
+    return ret;
+}
+
+static int read_trace(const char *path, Trace *tr)
+{
+    FILE  *f = fopen(path, "r");
+    char   line[256];
+    double bits = 0;
+    int    i;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        double time, kbps;
+        if (line[0] == '#' || sscanf(line, "%lf %lf", &time, &kbps) != 2)
+            continue;
+        if ((tr->nb_samples && time <= tr->times[tr->nb_samples - 1]) || kbps < 0 ||
+            append(&tr->times, &tr->nb_samples, sizeof(time), &time) < 0 ||
+            !(tr->rates = av_realloc_array(tr->rates, tr->nb_samples, sizeof(double)))) {
+            fclose(f);
+            return -1;
+        }
+        tr->rates[tr->nb_samples - 1] = kbps * 1000;
+    }
+    fclose(f);
+    if (!tr->nb_samples)
+        return -1;
+
+    tr->period = tr->times[tr->nb_samples - 1] - tr->times[0] +
+                 (tr->nb_samples > 1 ? tr->times[tr->nb_samples - 1] - tr->times[tr->nb_samples - 2] : 1);
+    for (i = 0; i < tr->nb_samples; i++)
+        bits += tr->rates[i];
+    return bits > 0 ? 0 : -1;
+}
+
+static void free_trace(Trace *tr)
+{
+    av_freep(&tr->times);
+    av_freep(&tr->rates);
+    tr->nb_samples = 0;
+}
+
+/* ms to download bytes from time ms on */
+static double download_time(const Trace *tr, double start, int64_t bytes)
+{
+    double bits = bytes * 8.0, t = start / 1000, offset;
+    int    k = 0;
+
+    offset = fmod(t - tr->times[0], tr->period);
+    while (k + 1 < tr->nb_samples && tr->times[k + 1] - tr->times[0] <= offset)
+        k++;
+
+    for (;;) {
+        double until = k + 1 < tr->nb_samples ? tr->times[k + 1] - tr->times[0] : tr->period;
+        double span  = until - offset;
+        if (tr->rates[k] * span >= bits)
+            return (t + bits / tr->rates[k]) * 1000 - start;
+        bits   -= tr->rates[k] * span;
+        t      += span;
+        offset  = until;
+        if (++k == tr->nb_samples) {
+            k      = 0;
+            offset = 0;
+        }
+    }
+}
+
+/* the wall clock moves on, playback drains the buffer or stalls */
+static void advance(Player *p, double ms)
+{
+    p->now += ms;
+    if (!p->playing) {
+        if (p->started)
+            p->res->stall_ms += ms;
+        return;
+    }
+    if (p->buffer >= ms) {
+        p->buffer       -= ms;
+        p->res->play_ms += ms;
+        return;
+    }
+    p->res->play_ms  += p->buffer;
+    p->res->stall_ms += ms - p->buffer;
+    p->res->stalls++;
+    p->buffer  = 0;
+    p->playing = 0;
+}
+
+static void simulate(const Config *cfg, const Stream *st, const Trace *tr, Result *res)
+{
+    HLSABREstimate estimate = { 0 };
+    HLSABRVariant *variants = av_malloc_array(st->nb_variants, sizeof(*variants));
+    Player p = { cfg, res };
+    int    cur, i, next;
+
+    memset(res, 0, sizeof(*res));
+    if (!variants)
+        return;
+    for (i = 0; i < st->nb_variants; i++)
+        variants[i] = st->variants[i].abr;
+
+    p.resume = cfg->start_ms;
+    cur = ff_hls_abr_initial_variant(&cfg->policy, &estimate, variants, st->nb_variants,
+                                     cfg->initial_estimate, 0);
+    for (i = 0; i < st->nb_segments; i++) {
+        int64_t bytes = st->variants[cur].sizes[i];
+        double  elapsed;
+
+        if (p.playing && p.buffer + st->durations[i] > cfg->max_buffer_ms)
+            advance(&p, p.buffer + st->durations[i] - cfg->max_buffer_ms);
+
+        elapsed = (i % cfg->prefetch ? 0 : cfg->rtt_ms);
+        elapsed += download_time(tr, p.now + elapsed, bytes);
+        advance(&p, elapsed);
+        p.buffer  += st->durations[i];
+        res->bits += (double)variants[cur].bandwidth * st->durations[i];
+
+        if (!p.playing && (p.buffer >= p.resume || i == st->nb_segments - 1)) {
+            if (!p.started)
+                res->startup_ms = p.now;
+            p.resume  = p.started ? FFMIN(p.resume * 2, cfg->resume_max_ms) : cfg->resume_ms;
+            p.playing = p.started = 1;
+        }
+
+        ff_hls_abr_add_sample(&estimate, bytes, (int64_t)(elapsed * 1000));
+        if (i + 1 < st->nb_segments) {
+            AVAppBufferLevel level = { sizeof(level) };
+            level.cached_duration_milli = (int64_t)p.buffer;
+            next = ff_hls_abr_check_switch(&cfg->policy, &estimate, variants, st->nb_variants, cur,
+                                           &level, NULL);
+            if (next >= 0) {
+                cur = next;
+                res->switches++;
+            }
+        }
+    }
+    res->play_ms += p.buffer;
+    av_free(variants);
+}
+
+static double rebuffer_ratio(const Result *res)
+{
+    return res->play_ms + res->stall_ms > 0 ? res->stall_ms / (res->play_ms + res->stall_ms) : 0;
+}
+
+static double average_bitrate(const Result *res)
+{
+    return res->play_ms > 0 ? res->bits / res->play_ms : 0;
+}
+
+int main(int argc, char **argv)
+{
+    Config cfg = {
+        .name             = "default",
+        .policy           = HLS_ABR_DEFAULT_POLICY,
+        .start_ms         = 100,
+        .resume_ms        = 1000,
+        .resume_max_ms    = 5000,
+        .max_buffer_ms    = 30000,
+        .prefetch         = 1,
+        .rtt_ms           = 50,
+    };
+    Stream st    = { 0 };
+    Result total = { 0 };
+    double ratio = 0, bitrate = 0;
+    int    opt, i, nb_traces = 0;
+
+    while ((opt = getopt(argc, argv, "hn:u:H:P:U:e:s:r:R:b:p:t:")) != -1) {
+        switch (opt) {
+        case 'n': cfg.name                  = optarg;         break;
+        case 'u': cfg.policy.upswitch_buffer = atoll(optarg); break;
+        case 'H': cfg.policy.hold_buffer    = atoll(optarg);  break;
+        case 'P': cfg.policy.panic_buffer   = atoll(optarg);  break;
+        case 'U': cfg.policy.usable_percent = atoi(optarg);   break;
+        case 'e': cfg.initial_estimate      = atoll(optarg);  break;
+        case 's': cfg.start_ms              = atof(optarg);   break;
+        case 'r': cfg.resume_ms             = atof(optarg);   break;
+        case 'R': cfg.resume_max_ms         = atof(optarg);   break;
+        case 'b': cfg.max_buffer_ms         = atof(optarg);   break;
+        case 'p': cfg.prefetch              = atoi(optarg);   break;
+        case 't': cfg.rtt_ms                = atof(optarg);   break;
+        case 'h':
+            usage(0);
+        default:
+            usage(1);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 2 || cfg.prefetch < 1 || cfg.policy.usable_percent < 1)
+        usage(1);
+
+    if (read_stream(argv[0], &st) < 0) {
+        fprintf(stderr, "%s: could not read the segments\n", argv[0]);
+        return 1;
+    }
+
+    printf("policy,trace,startup_ms,rebuffer_ratio,rebuffers,avg_bitrate,switches\n");
+    for (i = 1; i < argc; i++) {
+        Trace  tr = { 0 };
+        Result res;
+
+        if (read_trace(argv[i], &tr) < 0) {
+            fprintf(stderr, "%s: could not read the trace, skipped\n", argv[i]);
+            free_trace(&tr);
+            continue;
+        }
+        simulate(&cfg, &st, &tr, &res);
+        printf("%s,%s,%.0f,%.4f,%d,%.0f,%d\n", cfg.name, argv[i], res.startup_ms,
+               rebuffer_ratio(&res), res.stalls, average_bitrate(&res), res.switches);
+        free_trace(&tr);
+
+        /* the ratios are averaged per trace, not weighted by their length */
+        total.startup_ms += res.startup_ms;
+        total.stalls     += res.stalls;
+        total.switches   += res.switches;
+        ratio   += rebuffer_ratio(&res);
+        bitrate += average_bitrate(&res);
+        nb_traces++;
+    }
+    if (nb_traces) {
+        printf("%s,*,%.0f,%.4f,%.2f,%.0f,%.2f\n", cfg.name, total.startup_ms / nb_traces,
+               ratio / nb_traces, (double)total.stalls / nb_traces, bitrate / nb_traces,
+               (double)total.switches / nb_traces);
+    }
+
+    for (i = 0; i < st.nb_variants; i++)
+        av_free(st.variants[i].sizes);
+    av_free(st.variants);
+    av_free(st.durations);
+    return nb_traces ? 0 : 1;
+}
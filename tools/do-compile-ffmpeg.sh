@@ -55,6 +55,29 @@ source $FF_BUILD_ROOT/../config/module.sh
 FFMPEG_CFG_FLAGS=
 FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS $COMMON_FF_CFG_FLAGS"
 
+# AudioToolbox decoders, registered ahead of the software ones they fall
+# back to, see libavcodec/allcodecs.c
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-audiotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-decoder=aac_at"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-decoder=mp3_at"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-decoder=ac3_at"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-decoder=eac3_at"
+
+# VideoToolbox hwaccel, for the codecs IJKVideoToolBox does not decode
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-videotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-hwaccel=h263_videotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-hwaccel=h264_videotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-hwaccel=mpeg1_videotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-hwaccel=mpeg2_videotoolbox"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-hwaccel=mpeg4_videotoolbox"
+
+# DASH demuxer, the manifest is parsed with the SDK's libxml2
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-libxml2"
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-demuxer=dash"
+
+# replay of the packet captures of the player, libavformat/pktcap.h
+FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-demuxer=pktcap"
+
 # Optimization options (experts only):
 # FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --disable-armv5te"
 # FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --disable-armv6"
@@ -125,18 +148,21 @@ FF_XCODE_BITCODE=
 if [ "$FF_ARCH" = "i386" ]; then
     FF_BUILD_NAME="ffmpeg-i386"
     FF_BUILD_NAME_OPENSSL=openssl-i386
+    FF_BUILD_NAME_DAV1D=dav1d-i386
     FF_XCRUN_PLATFORM="iPhoneSimulator"
     FF_XCRUN_OSVERSION="-mios-simulator-version-min=6.0"
     FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS $FFMPEG_CFG_FLAGS_SIMULATOR"
 elif [ "$FF_ARCH" = "x86_64" ]; then
     FF_BUILD_NAME="ffmpeg-x86_64"
     FF_BUILD_NAME_OPENSSL=openssl-x86_64
+    FF_BUILD_NAME_DAV1D=dav1d-x86_64
     FF_XCRUN_PLATFORM="iPhoneSimulator"
     FF_XCRUN_OSVERSION="-mios-simulator-version-min=7.0"
     FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS $FFMPEG_CFG_FLAGS_SIMULATOR"
 elif [ "$FF_ARCH" = "armv7" ]; then
     FF_BUILD_NAME="ffmpeg-armv7"
     FF_BUILD_NAME_OPENSSL=openssl-armv7
+    FF_BUILD_NAME_DAV1D=dav1d-armv7
     FF_XCRUN_OSVERSION="-miphoneos-version-min=6.0"
     FF_XCODE_BITCODE="-fembed-bitcode"
     FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS $FFMPEG_CFG_FLAGS_ARM"
@@ -144,6 +170,7 @@ elif [ "$FF_ARCH" = "armv7" ]; then
 elif [ "$FF_ARCH" = "armv7s" ]; then
     FF_BUILD_NAME="ffmpeg-armv7s"
     FF_BUILD_NAME_OPENSSL=openssl-armv7s
+    FF_BUILD_NAME_DAV1D=dav1d-armv7s
     FFMPEG_CFG_CPU="--cpu=swift"
     FF_XCRUN_OSVERSION="-miphoneos-version-min=6.0"
     FF_XCODE_BITCODE="-fembed-bitcode"
@@ -151,6 +178,7 @@ elif [ "$FF_ARCH" = "armv7s" ]; then
 elif [ "$FF_ARCH" = "arm64" ]; then
     FF_BUILD_NAME="ffmpeg-arm64"
     FF_BUILD_NAME_OPENSSL=openssl-arm64
+    FF_BUILD_NAME_DAV1D=dav1d-arm64
     FF_XCRUN_OSVERSION="-miphoneos-version-min=7.0"
     FF_XCODE_BITCODE="-fembed-bitcode"
     FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS $FFMPEG_CFG_FLAGS_ARM"
@@ -193,6 +221,7 @@ FFMPEG_CFLAGS="$FFMPEG_CFLAGS -arch $FF_ARCH"
 FFMPEG_CFLAGS="$FFMPEG_CFLAGS $FF_XCRUN_OSVERSION"
 FFMPEG_CFLAGS="$FFMPEG_CFLAGS $FFMPEG_EXTRA_CFLAGS"
 FFMPEG_CFLAGS="$FFMPEG_CFLAGS $FF_XCODE_BITCODE"
+FFMPEG_CFLAGS="$FFMPEG_CFLAGS -I`xcrun -sdk $FF_XCRUN_SDK --show-sdk-path`/usr/include/libxml2"
 FFMPEG_LDFLAGS="$FFMPEG_CFLAGS"
 FFMPEG_DEP_LIBS=
 
@@ -211,6 +240,24 @@ if [ -f "${FFMPEG_DEP_OPENSSL_LIB}/libssl.a" ]; then
     FFMPEG_DEP_LIBS="$FFMPEG_CFLAGS -L${FFMPEG_DEP_OPENSSL_LIB} -lssl -lcrypto"
 fi
 
+#--------------------
+echo "\n--------------------"
+echo "[*] check dav1d"
+echo "----------------------"
+# AV1 decoder, libavcodec/libdav1d.c: dav1d built with meson, NEON and
+# all, installed to build/dav1d-$FF_ARCH/output
+FFMPEG_DEP_DAV1D_INC=$FF_BUILD_ROOT/build/$FF_BUILD_NAME_DAV1D/output/include
+FFMPEG_DEP_DAV1D_LIB=$FF_BUILD_ROOT/build/$FF_BUILD_NAME_DAV1D/output/lib
+#--------------------
+# with dav1d
+if [ -f "${FFMPEG_DEP_DAV1D_LIB}/libdav1d.a" ]; then
+    FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-libdav1d"
+    FFMPEG_CFG_FLAGS="$FFMPEG_CFG_FLAGS --enable-decoder=libdav1d"
+
+    FFMPEG_CFLAGS="$FFMPEG_CFLAGS -I${FFMPEG_DEP_DAV1D_INC}"
+    FFMPEG_DEP_LIBS="$FFMPEG_DEP_LIBS -L${FFMPEG_DEP_DAV1D_LIB} -ldav1d"
+fi
+
 #--------------------
 echo "\n--------------------"
 echo "[*] configure"
@@ -252,3 +299,9 @@ make -j3 $FF_GASPP_EXPORT
 make install
 mkdir -p $FF_BUILD_PREFIX/include/libffmpeg
 cp -f config.h $FF_BUILD_PREFIX/include/libffmpeg/config.h
+
+# checkasm as a library for IJKMediaFrameworkTests, which runs it on devices
+if [ "$FF_ARCH" = "arm64" ]; then
+    make checkasm-lib $FF_GASPP_EXPORT
+    cp -f tests/checkasm/libcheckasm.a $FF_BUILD_PREFIX/lib/libcheckasm.a
+fi
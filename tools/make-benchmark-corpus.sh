@@ -0,0 +1,64 @@
+#! /usr/bin/env bash
+#
+# Copyright (C) 2013-2014 Bilibili
+# Copyright (C) 2013-2014 Zhang Rui <bbcallen@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Generates the media played by the playback benchmark of
+# IJKMediaFrameworkTests, from synthetic sources only, so that every machine
+# with the same ffmpeg build gets the same bytes.
+#
+# usage: make-benchmark-corpus.sh <output-dir>
+# then run the tests with IJK_BENCH_CORPUS_DIR=<output-dir>
+
+set -e
+
+OUT=$1
+if [ -z "$OUT" ]; then
+    echo "usage: $0 <output-dir>"
+    exit 1
+fi
+
+FFMPEG=${FFMPEG:-ffmpeg}
+DURATION=20
+mkdir -p "$OUT/hls_720p"
+
+# $1 size, $2 rate
+source_args() {
+    echo "-f lavfi -i testsrc2=size=$1:rate=$2:duration=$DURATION -f lavfi -i sine=frequency=440:sample_rate=48000:duration=$DURATION"
+}
+
+H264="-c:v libx264 -preset medium -profile:v high -g 60 -bf 2 -pix_fmt yuv420p -threads 1"
+HEVC="-c:v libx265 -preset medium -x265-params keyint=60:pools=1 -tag:v hvc1 -pix_fmt yuv420p"
+AAC="-c:a aac -b:a 128k"
+COMMON="-y -fflags +bitexact -flags:v +bitexact -flags:a +bitexact -map_metadata -1"
+
+$FFMPEG $COMMON $(source_args 854x480   30) $H264 -b:v 1500k $AAC -movflags +faststart "$OUT/h264_480p.mp4"
+$FFMPEG $COMMON $(source_args 1280x720  30) $H264 -b:v 3000k $AAC -movflags +faststart "$OUT/h264_720p.mp4"
+$FFMPEG $COMMON $(source_args 1920x1080 30) $H264 -b:v 6000k $AAC -movflags +faststart "$OUT/h264_1080p.mp4"
+$FFMPEG $COMMON $(source_args 1920x1080 60) $H264 -b:v 9000k $AAC -movflags +faststart "$OUT/h264_1080p60.mp4"
+$FFMPEG $COMMON $(source_args 1920x1080 30) $HEVC -b:v 4000k $AAC -movflags +faststart "$OUT/hevc_1080p.mp4"
+$FFMPEG $COMMON $(source_args 3840x2160 30) $HEVC -b:v 15000k $AAC -movflags +faststart "$OUT/hevc_2160p.mp4"
+
+# moov after mdat: the player has to seek to the end before the first frame
+$FFMPEG $COMMON $(source_args 1920x1080 30) $H264 -b:v 6000k $AAC "$OUT/h264_1080p_moov_at_end.mp4"
+
+$FFMPEG $COMMON $(source_args 1280x720  30) $H264 -b:v 3000k $AAC -f flv "$OUT/h264_720p.flv"
+
+$FFMPEG $COMMON $(source_args 1280x720  30) $H264 -b:v 3000k $AAC \
+    -f hls -hls_time 4 -hls_playlist_type vod \
+    -hls_segment_filename "$OUT/hls_720p/segment_%03d.ts" "$OUT/hls_720p/index.m3u8"
+
+echo "corpus written to $OUT"